@@ -89,14 +89,41 @@ typedef int (*ngsProgressFunc)(enum ngsCode status, double complete,
                                const char *message, void *progressArguments);
 /**
  * @brief Prototype of function, which executed when changes occurred.
+ * Functions added by ngsAddNotifyFunction are executed from library notify
+ * thread, subsequent feature events of one table come there as one event with
+ * uri ended with {min feature ID}-{max feature ID}.
  * @param uri Catalog path (for features/rows ended with feature ID, for
  * attachments ended with attachments/{int:id}).
  * @param operation Operation which trigger notification.
  */
 typedef void (*ngsNotifyFunc)(const char *uri, enum ngsChangeCode operation);
+/**
+ * @brief Prototype of function, which executed when asynchronous web request
+ * completed. Executed from library network thread.
+ * @param result Request result. Must be freed by callee via
+ * ngsURLRequestResultFree.
+ * @param callbackArguments Some user data or null pointer
+ */
+typedef void (*ngsURLRequestFunc)(ngsURLRequestResult *result,
+                                  void *callbackArguments);
+/**
+ * @brief Prototype of function, which executed when connection check
+ * completed. Executed from library worker threads, but not simultaneously.
+ * @param path Connection catalog path
+ * @param result 1 if connection is valid or 0
+ * @param message Error message if connection is not valid
+ * @param callbackArguments Some user data or null pointer
+ */
+typedef void (*ngsConnectionCheckFunc)(const char *path, char result,
+                                       const char *message,
+                                       void *callbackArguments);
 
 /*
  * Common functions
+ *
+ * Strings returned by functions are owned by the library. They are kept per
+ * calling thread and stay valid at least for the next 15 calls returning
+ * strings on the same thread. Copy them to keep longer.
  */
 
 NGS_EXTERNC int ngsGetVersion(const char *request);
@@ -104,8 +131,14 @@ NGS_EXTERNC const char *ngsGetVersionString(const char *request);
 NGS_EXTERNC int ngsInit(char **options);
 NGS_EXTERNC void ngsUnInit();
 NGS_EXTERNC void ngsFreeResources(char full);
+NGS_EXTERNC void ngsOnMemoryPressure(enum ngsMemoryPressure level);
+NGS_EXTERNC long long ngsGetMemoryUsage();
 NGS_EXTERNC const char *ngsGetLastErrorMessage();
+NGS_EXTERNC unsigned long ngsGetErrorCount(enum ngsCode code);
+NGS_EXTERNC void ngsTraceEnable(char enable);
+NGS_EXTERNC int ngsTraceSave(const char *path, char clear);
 NGS_EXTERNC void ngsAddNotifyFunction(ngsNotifyFunc function, int notifyTypes);
+NGS_EXTERNC void ngsAddSyncNotifyFunction(ngsNotifyFunc function, int notifyTypes);
 NGS_EXTERNC void ngsRemoveNotifyFunction(ngsNotifyFunc function);
 NGS_EXTERNC const char *ngsSettingsGetString(const char *key, const char *defaultVal);
 NGS_EXTERNC void ngsSettingsSetString(const char *key, const char *value);
@@ -135,6 +168,10 @@ NGS_EXTERNC ngsURLRequestResult *ngsURLRequest(enum ngsURLRequestType type,
                                               char **options,
                                                ngsProgressFunc callback,
                                                void *callbackData);
+NGS_EXTERNC int ngsURLRequestAsync(enum ngsURLRequestType type,
+                                   const char *url, char **options,
+                                   ngsURLRequestFunc callback,
+                                   void *callbackArguments);
 NGS_EXTERNC ngsURLRequestResult *ngsURLUploadFile(const char *path,
                                                   const char *url,
                                                   char **options,
@@ -213,6 +250,9 @@ NGS_EXTERNC ngsCatalogObjectInfo *ngsCatalogObjectQuery(CatalogObjectH object,
     int filter);
 NGS_EXTERNC ngsCatalogObjectInfo *ngsCatalogObjectQueryMultiFilter(
     CatalogObjectH object, int *filters, int filterCount);
+NGS_EXTERNC ngsCatalogObjectInfo *ngsCatalogObjectQueryPaged(
+    CatalogObjectH object, int *filters, int filterCount,
+    const char *namePattern, int offset, int limit);
 NGS_EXTERNC int ngsCatalogObjectDelete(CatalogObjectH object);
 NGS_EXTERNC char ngsCatalogObjectCanCreate(CatalogObjectH object,
     enum ngsCatalogObjectType type);
@@ -236,8 +276,13 @@ NGS_EXTERNC const char *ngsCatalogObjectProperty(CatalogObjectH object,
 NGS_EXTERNC int ngsCatalogObjectSetProperty(CatalogObjectH object,
     const char *name, const char *value, const char *domain);
 NGS_EXTERNC void ngsCatalogObjectRefresh(CatalogObjectH object);
+NGS_EXTERNC int ngsCatalogObjectLoadChildren(CatalogObjectH object,
+                                             ngsProgressFunc callback,
+                                             void *callbackData);
 NGS_EXTERNC char ngsCatalogCheckConnection(enum ngsCatalogObjectType type,
     char **options);
+NGS_EXTERNC int ngsCatalogCheckConnections(CatalogObjectH *connections,
+    char **options, ngsConnectionCheckFunc callback, void *callbackArguments);
 NGS_EXTERNC char ngsCatalogObjectOpen(CatalogObjectH object, char **openOptions);
 NGS_EXTERNC char ngsCatalogObjectIsOpened(CatalogObjectH object);
 NGS_EXTERNC char ngsCatalogObjectClose(CatalogObjectH object);
@@ -264,6 +309,31 @@ typedef struct _ngsEditOperation {
     long long arid;
 } ngsEditOperation;
 
+/**
+ * @brief The ngsChangeRange struct Features with identifiers from fromFid to
+ * toFid changed by the operation. The sequence is the number of the last
+ * change in the range.
+ */
+typedef struct _ngsChangeRange {
+    long long sequence;
+    long long fromFid;
+    long long toFid;
+    enum ngsChangeCode code;
+    ngsExtent extent;
+} ngsChangeRange;
+
+/**
+ * @brief The ngsFieldColumn struct Caller provided column for
+ * ngsFeatureClassReadColumns. The values array item type depends on field
+ * type: int for integer, long long for integer64, double for real and
+ * const char* for other types.
+ */
+typedef struct _ngsFieldColumn {
+    int field;
+    void *values;
+    char *isSet;
+} ngsFieldColumn;
+
 NGS_EXTERNC ngsField *ngsFeatureClassFields(CatalogObjectH object);
 NGS_EXTERNC ngsGeometryType ngsFeatureClassGeometryType(CatalogObjectH object);
 NGS_EXTERNC FeatureH ngsFeatureClassCreateFeature(CatalogObjectH object);
@@ -278,6 +348,24 @@ NGS_EXTERNC int ngsFeatureClassDeleteFeatures(CatalogObjectH object, char logEdi
 NGS_EXTERNC long long ngsFeatureClassCount(CatalogObjectH object);
 NGS_EXTERNC void ngsFeatureClassResetReading(CatalogObjectH object);
 NGS_EXTERNC FeatureH ngsFeatureClassNextFeature(CatalogObjectH object);
+NGS_EXTERNC int ngsFeatureClassReadColumns(CatalogObjectH object,
+                                           long long *fids,
+                                           ngsFieldColumn *columns,
+                                           int columnCount, int maxCount);
+NGS_EXTERNC int ngsFeatureClassReadPage(CatalogObjectH object, void *buffer,
+                                        long long bufferSize, int maxCount,
+                                        char withGeometry);
+NGS_EXTERNC int ngsFeatureClassLoadGeoJson(CatalogObjectH object,
+                                           const char *path, char **options,
+                                           ngsProgressFunc callback,
+                                           void *callbackData);
+NGS_EXTERNC int ngsFeatureClassSpatialJoin(CatalogObjectH object,
+                                           CatalogObjectH polygons,
+                                           const char *sourceField,
+                                           const char *targetField,
+                                           char **options,
+                                           ngsProgressFunc callback,
+                                           void *callbackData);
 NGS_EXTERNC FeatureH ngsFeatureClassGetFeature(CatalogObjectH object,
                                                long long id);
 NGS_EXTERNC int ngsFeatureClassSetFilter(CatalogObjectH object,
@@ -286,9 +374,37 @@ NGS_EXTERNC int ngsFeatureClassSetFilter(CatalogObjectH object,
 NGS_EXTERNC int ngsFeatureClassSetSpatialFilter(CatalogObjectH object,
                                                 double minX, double minY,
                                                 double maxX, double maxY);
+NGS_EXTERNC int ngsFeatureClassCreateIndex(CatalogObjectH object,
+                                           const char *fieldName);
+NGS_EXTERNC int ngsFeatureClassDropIndex(CatalogObjectH object,
+                                         const char *fieldName);
+NGS_EXTERNC int ngsFeatureClassCreateSearchIndex(CatalogObjectH object,
+                                                 char **fields, char **options);
+NGS_EXTERNC long long *ngsFeatureClassSearch(CatalogObjectH object,
+                                             const char *query, int offset,
+                                             int limit);
 NGS_EXTERNC int ngsFeatureClassDeleteEditOperation(CatalogObjectH object,
                                                   ngsEditOperation operation);
 NGS_EXTERNC ngsEditOperation *ngsFeatureClassGetEditOperations(CatalogObjectH object);
+NGS_EXTERNC long long ngsFeatureClassChangeSequence(CatalogObjectH object);
+NGS_EXTERNC ngsChangeRange *ngsFeatureClassChangesSince(CatalogObjectH object,
+                                                       long long sequence);
+NGS_EXTERNC int ngsFeatureClassSendEditOperations(CatalogObjectH object,
+                                                  char **options,
+                                                  ngsProgressFunc callback,
+                                                  void *callbackData);
+NGS_EXTERNC int ngsFeatureClassDownloadChanges(CatalogObjectH object,
+                                               char **options,
+                                               ngsProgressFunc callback,
+                                               void *callbackData);
+NGS_EXTERNC int ngsFeatureClassTransferAttachments(CatalogObjectH object,
+                                                   char **options,
+                                                   ngsProgressFunc callback,
+                                                   void *callbackData);
+NGS_EXTERNC int ngsCatalogObjectSyncLayers(CatalogObjectH object,
+                                           char **options,
+                                           ngsProgressFunc callback,
+                                           void *callbackData);
 
 NGS_EXTERNC int ngsFeatureClassCreateOverviews(CatalogObjectH object,
                                                char **options,
@@ -300,6 +416,8 @@ NGS_EXTERNC int ngsFeatureFieldCount(FeatureH feature);
 NGS_EXTERNC char ngsFeatureIsFieldSet(FeatureH feature, int fieldIndex);
 NGS_EXTERNC long long ngsFeatureGetId(FeatureH feature);
 NGS_EXTERNC GeometryH ngsFeatureGetGeometry(FeatureH feature);
+NGS_EXTERNC int ngsFeatureGetGeometryWKB(FeatureH feature, void *buffer,
+                                         int bufferSize);
 NGS_EXTERNC int ngsFeatureGetFieldAsInteger(FeatureH feature, int field);
 NGS_EXTERNC double ngsFeatureGetFieldAsDouble(FeatureH feature, int field);
 NGS_EXTERNC const char *ngsFeatureGetFieldAsString(FeatureH feature, int field);
@@ -328,6 +446,8 @@ NGS_EXTERNC ngsExtent ngsGeometryGetEnvelope(GeometryH geometry);
 NGS_EXTERNC int ngsGeometryTransformTo(GeometryH geometry, int EPSG);
 NGS_EXTERNC int ngsGeometryTransform(GeometryH geometry,
                                      CoordinateTransformationH ct);
+NGS_EXTERNC int ngsGeometryGetWKB(GeometryH geometry, void *buffer,
+                                  int bufferSize);
 NGS_EXTERNC char ngsGeometryIsEmpty(GeometryH geometry);
 NGS_EXTERNC ngsGeometryType ngsGeometryGetType(GeometryH geometry);
 NGS_EXTERNC const char *ngsGeometryToJson(GeometryH geometry);
@@ -337,6 +457,9 @@ NGS_EXTERNC CoordinateTransformationH ngsCoordinateTransformationCreate(
 NGS_EXTERNC void ngsCoordinateTransformationFree(CoordinateTransformationH ct);
 NGS_EXTERNC ngsCoordinate ngsCoordinateTransformationDo(
         CoordinateTransformationH ct, ngsCoordinate coordinates);
+NGS_EXTERNC int ngsCoordinateTransformationDoArray(CoordinateTransformationH ct,
+                                                   ngsCoordinate *coordinates,
+                                                   int count);
 
 typedef struct _ngsFeatureAttachmentInfo {
     long long id;
@@ -367,6 +490,11 @@ NGS_EXTERNC char ngsFeatureAttachmentUpdate(FeatureH feature,
  */
 NGS_EXTERNC int ngsRasterCacheArea(CatalogObjectH object, char **options,
                                    ngsProgressFunc callback, void *callbackData);
+NGS_EXTERNC double ngsRasterCacheAreaProgress(CatalogObjectH object,
+                                              char **options);
+NGS_EXTERNC int ngsRasterCreateOverviews(CatalogObjectH object, char **options,
+                                         ngsProgressFunc callback,
+                                         void *callbackData);
 
 /*
  * Map functions
@@ -380,6 +508,7 @@ NGS_EXTERNC char ngsMapCreate(const char *name, const char *description,
                              unsigned short epsg, double minX, double minY,
                              double maxX, double maxY);
 NGS_EXTERNC char ngsMapOpen(const char *path);
+NGS_EXTERNC char ngsMapOpenWithOptions(const char *path, char **options);
 NGS_EXTERNC int ngsMapSave(char mapId, const char *path);
 NGS_EXTERNC int ngsMapClose(char mapId);
 NGS_EXTERNC int ngsMapReopen(char mapId, const char *path);
@@ -391,7 +520,14 @@ NGS_EXTERNC int ngsMapLayerReorder(char mapId, LayerH beforeLayer, LayerH movedL
 NGS_EXTERNC int ngsMapSetSize(char mapId, int width, int height, char YAxisInverted);
 NGS_EXTERNC int ngsMapDraw(char mapId, enum ngsDrawState state,
                            ngsProgressFunc callback, void *callbackData);
+NGS_EXTERNC int ngsMapDrawToBuffer(char mapId, int width, int height,
+                                   void *rgbaBuffer, ngsProgressFunc callback,
+                                   void *callbackData);
+NGS_EXTERNC int ngsMapExport(char mapId, const char *path, int width,
+                             int height, ngsExtent extent, char **options,
+                             ngsProgressFunc callback, void *callbackData);
 NGS_EXTERNC int ngsMapInvalidate(char mapId, ngsExtent bounds);
+NGS_EXTERNC int ngsMapInvalidateLayer(char mapId, LayerH layer, ngsExtent bounds);
 NGS_EXTERNC int ngsMapSetBackgroundColor(char mapId, const ngsRGBA color);
 NGS_EXTERNC ngsRGBA ngsMapGetBackgroundColor(char mapId);
 NGS_EXTERNC int ngsMapSetCenter(char mapId, double x, double y);
@@ -404,6 +540,25 @@ NGS_EXTERNC int ngsMapSetScale(char mapId, double scale);
 NGS_EXTERNC double ngsMapGetScale(char mapId);
 
 NGS_EXTERNC int ngsMapSetOptions(char mapId, char **options);
+
+/**
+ * @brief Renderer counters of the last map draw. Latencies are in
+ * milliseconds from tile fill job creation to its finish, memory is in bytes.
+ */
+typedef struct _ngsRenderStats {
+    int drawCalls;
+    int stateChanges;
+    long long uploadedBytes;
+    int tilesFilled;
+    int tilesPending;
+    double fillLatency50;
+    double fillLatency90;
+    double fillLatency99;
+    long long bufferMemory;
+    long long textureMemory;
+} ngsRenderStats;
+
+NGS_EXTERNC ngsRenderStats ngsMapGetRenderStats(char mapId);
 NGS_EXTERNC int ngsMapSetExtentLimits(char mapId, double minX, double minY, double maxX, double maxY);
 NGS_EXTERNC ngsExtent ngsMapGetExtent(char mapId, int epsg);
 NGS_EXTERNC int ngsMapSetExtent(char mapId, ngsExtent extent);
@@ -417,6 +572,28 @@ NGS_EXTERNC int ngsMapIconSetAdd(char mapId, const char *name, const char *path,
 NGS_EXTERNC int ngsMapIconSetRemove(char mapId, const char *name);
 NGS_EXTERNC char ngsMapIconSetExists(char mapId, const char *name);
 
+/**
+ * @brief Layer features found by ngsMapIdentify.
+ */
+typedef struct _ngsIdentifyResult {
+    LayerH layer;
+    long long *ids;
+    int count;
+} ngsIdentifyResult;
+
+/**
+ * @brief Prototype of function, which executed when map identify completed.
+ * Executed from library worker thread.
+ * @param results Layers with found features ordered from the top layer. Valid
+ * only during the call.
+ * @param count Results count
+ * @param callbackArguments Some user data or null pointer
+ */
+typedef void (*ngsIdentifyFunc)(ngsIdentifyResult *results, int count,
+                                void *callbackArguments);
+NGS_EXTERNC int ngsMapIdentify(char mapId, double x, double y, double tolerance,
+                               ngsIdentifyFunc callback, void *callbackArguments);
+
 /*
  * Layer functions
  */
@@ -429,13 +606,20 @@ NGS_EXTERNC float ngsLayerGetMaxZoom(LayerH layer);
 NGS_EXTERNC int ngsLayerSetMaxZoom(LayerH layer, float zoom);
 NGS_EXTERNC float ngsLayerGetMinZoom(LayerH layer);
 NGS_EXTERNC int ngsLayerSetMinZoom(LayerH layer, float zoom);
+NGS_EXTERNC float ngsLayerGetOpacity(LayerH layer);
+NGS_EXTERNC int ngsLayerSetOpacity(LayerH layer, float opacity);
 NGS_EXTERNC CatalogObjectH ngsLayerGetDataSource(LayerH layer);
 NGS_EXTERNC JsonObjectH ngsLayerGetStyle(LayerH layer);
 NGS_EXTERNC int ngsLayerSetStyle(LayerH layer, JsonObjectH style);
 NGS_EXTERNC const char *ngsLayerGetStyleName(LayerH layer);
 NGS_EXTERNC int ngsLayerSetStyleName(LayerH layer, const char *name);
+NGS_EXTERNC double ngsLayerGetFillLatency(LayerH layer, double percentile);
 NGS_EXTERNC int ngsLayerSetSelectionIds(LayerH layer, long long *ids, int size);
 NGS_EXTERNC int ngsLayerSetHideIds(LayerH layer, long long *ids, int size);
+NGS_EXTERNC char ngsLayerGetSnapping(LayerH layer);
+NGS_EXTERNC int ngsLayerSetSnapping(LayerH layer, char enable);
+NGS_EXTERNC JsonObjectH ngsLayerGetLabelStyle(LayerH layer);
+NGS_EXTERNC int ngsLayerSetLabelStyle(LayerH layer, JsonObjectH style);
 
 /*
  * Overlay functions
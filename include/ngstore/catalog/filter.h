@@ -50,6 +50,8 @@ public:
     static bool isLocalDir(const enum ngsCatalogObjectType type);
     static bool isConnection(const enum ngsCatalogObjectType type);
     static GDALDriver *getGDALDriver(const enum ngsCatalogObjectType type);
+    static GDALDriver *getGDALDriver(const char *name);
+    static void registerGDALDrivers();
     static std::string extension(const enum ngsCatalogObjectType type);
 protected:
     static bool canDisplay(enum ngsCatalogObjectType type, ObjectPtr object);
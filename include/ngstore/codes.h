@@ -79,7 +79,10 @@ enum ngsChangeCode {
     CC_CHANGE_LAYER         = 1 << 16,
     CC_TOKEN_EXPIRED        = 1 << 17,
     CC_TOKEN_CHANGED        = 1 << 18,
-    CC_ALL = CC_CREATE_OBJECT | CC_DELETE_OBJECT | CC_CHANGE_OBJECT | CC_CREATE_FEATURE | CC_CHANGE_FEATURE | CC_DELETE_FEATURE | CC_DELETEALL_FEATURES | CC_CREATE_ATTACHMENT | CC_CHANGE_ATTACHMENT | CC_DELETE_ATTACHMENT | CC_DELETEALL_ATTACHMENTS | CC_CREATE_MAP | CC_CHANGE_MAP | CC_CREATE_LAYER | CC_DELETE_LAYER | CC_CHANGE_LAYER | CC_TOKEN_EXPIRED | CC_TOKEN_CHANGED
+    CC_SYNC_STARTED         = 1 << 19,
+    CC_SYNC_FINISHED        = 1 << 20,
+    CC_SYNC_FAILED          = 1 << 21,
+    CC_ALL = CC_CREATE_OBJECT | CC_DELETE_OBJECT | CC_CHANGE_OBJECT | CC_CREATE_FEATURE | CC_CHANGE_FEATURE | CC_DELETE_FEATURE | CC_DELETEALL_FEATURES | CC_CREATE_ATTACHMENT | CC_CHANGE_ATTACHMENT | CC_DELETE_ATTACHMENT | CC_DELETEALL_ATTACHMENTS | CC_CREATE_MAP | CC_CHANGE_MAP | CC_CREATE_LAYER | CC_DELETE_LAYER | CC_CHANGE_LAYER | CC_TOKEN_EXPIRED | CC_TOKEN_CHANGED | CC_SYNC_STARTED | CC_SYNC_FINISHED | CC_SYNC_FAILED
 };
 
 /**
@@ -90,7 +93,14 @@ enum ngsDrawState {
     DS_REDRAW,      /**< Free all caches and draw from the scratch */
     DS_REFILL,      /**< Refill tiles from layers */
     DS_PRESERVED,   /**< Draw from caches */
-    DS_NOTHING      /**< Draw nothing */
+    DS_NOTHING,     /**< Draw nothing */
+    DS_RESTYLE      /**< Draw tiles from layers data without refill. Used after
+                         style changes which do not change geometry, i.e.
+                         width or color. Same as DS_REFILL if KEEP_TILE_BUFFERS
+                         map option is not set */
+    DS_OVERLAY_ONLY /**< Draw overlays over the map frame of previous draw.
+                         Used after overlay changes, i.e. location update.
+                         Same as DS_PRESERVED if the frame is not valid */
 };
 
 /**
@@ -105,6 +115,15 @@ enum ngsOptionType {
     OT_LOAD
 };
 
+/**
+ * @brief The memory pressure level enum. Android onTrimMemory levels
+ * TRIM_MEMORY_RUNNING_LOW and lower map to MP_MODERATE, others to MP_CRITICAL.
+ */
+enum ngsMemoryPressure {
+    MP_MODERATE = 1,    /**< Free half of cached data, oldest first */
+    MP_CRITICAL         /**< Free all cached data */
+};
+
 enum ngsDirection {
     DIR_X = 0,
     DIR_Y,
@@ -272,7 +291,8 @@ enum ngsStyleType {
     ST_POINT = 1,
     ST_LINE,
     ST_FILL,
-    ST_IMAGE
+    ST_IMAGE,
+    ST_MIXED    /**< Points, lines and polygons in one layer */
 };
 
 enum ngsEditElementType {
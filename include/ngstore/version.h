@@ -27,7 +27,7 @@
 
 #define NGS_VERSION_MAJOR 0
 #define NGS_VERSION_MINOR 11
-#define NGS_VERSION_REV   0
+#define NGS_VERSION_REV   2
 #define NGS_VERSION  STR(NGS_VERSION_MAJOR) "." STR(NGS_VERSION_MINOR) "." \
     STR(NGS_VERSION_REV)
 
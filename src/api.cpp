@@ -21,7 +21,9 @@
 #include "ngstore/api.h"
 
 // stl
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <cstring>
 
 // gdal
@@ -32,23 +34,32 @@
     #include "TargetConditionals.h"
 #endif
 
+#include "catalog/archive.h"
 #include "catalog/catalog.h"
 #include "catalog/ngw.h"
 #include "catalog/mapfile.h"
 #include "catalog/folder.h"
 #include "catalog/factories/connectionfactory.h"
+#include "ds/coordinatetransformation.h"
 #include "ds/simpledataset.h"
 #include "ds/storefeatureclass.h"
+#include "ds/tilecache.h"
+#include "ds/util.h"
 #include "map/mapstore.h"
 #include "ngstore/catalog/filter.h"
 #include "ngstore/version.h"
 #include "ngstore/util/constants.h"
 #include "util/account.h"
+#include "util/arena.h"
 #include "util/authstore.h"
 #include "util/error.h"
+#include "util/memorybudget.h"
 #include "util/notify.h"
+#include "util/qms.h"
 #include "util/settings.h"
 #include "util/stringutil.h"
+#include "util/threadpool.h"
+#include "util/trace.h"
 #include "util/url.h"
 #include "util/versionutil.h"
 
@@ -96,51 +107,75 @@ static void initGDAL(const char *dataPath, const char *cachePath)
         settings.set("crypt/iv", crypt_salt());
     }
 
-    // Register drivers
-#ifdef NGS_MOBILE // NOTE: Keep in sync with extlib.cmake gdal options. For mobile devices
-    GDALRegister_VRT();
-    GDALRegister_GTiff();
-    GDALRegister_HFA();
-    GDALRegister_PNG();
-    GDALRegister_JPEG();
-    GDALRegister_MEM();
-    GDALRegister_WMS();
-    RegisterOGRShape();
-    RegisterOGRTAB();
-    RegisterOGRVRT();
-    RegisterOGRMEM();
-    RegisterOGRGPX();
-    RegisterOGRKML();
-    RegisterOGRGeoJSON();
-    RegisterOGRGeoPackage();
-    RegisterOGRSQLite();
-    RegisterOGRNGW();
-#else
-    GDALAllRegister();
-#endif
+    // Register drivers. On mobile devices the drivers are registered on first
+    // use.
+    Filter::registerGDALDrivers();
+}
+
+// Returned C strings are kept in the calling thread ring of arenas, one arena
+// per call result. A string is valid until C_STRINGS_RING_SIZE more calls
+// returning strings are made on the same thread, so results of consecutive
+// calls may be used together. Calls returning several strings hold
+// CStringsHolder, so the strings of one result share one arena.
+constexpr size_t C_STRINGS_RING_SIZE = 16;
+constexpr size_t C_STRINGS_BLOCK_SIZE = 1024;
+static thread_local bool tCStringsHeld = false;
+static thread_local size_t tCStringsSlot = 0;
+
+static ScratchArena &cStringsArena()
+{
+    static thread_local std::vector<std::unique_ptr<ScratchArena>> arenas;
+    if(arenas.empty()) {
+        for(size_t i = 0; i < C_STRINGS_RING_SIZE; ++i) {
+            arenas.emplace_back(new ScratchArena(C_STRINGS_BLOCK_SIZE));
+        }
+    }
+    return *arenas[tCStringsSlot];
+}
+
+/**
+ * Start new result in the next ring arena, the oldest result is freed.
+ */
+static void nextCStrings()
+{
+    tCStringsSlot = (tCStringsSlot + 1) % C_STRINGS_RING_SIZE;
+    cStringsArena().reset();
 }
 
-static Mutex gMutex;
-static std::vector<void*> cStrings;
 static const char *storeCString(const std::string &str)
 {
-    char *data = CPLStrdup(str.c_str());
-    MutexHolder holder(gMutex);
-    cStrings.push_back(data);
+    if(!tCStringsHeld) {
+        nextCStrings();
+    }
+    char *data = static_cast<char*>(
+                cStringsArena().allocate(str.size() + 1, 1));
+    std::memcpy(data, str.c_str(), str.size() + 1);
     return data;
 }
 
 static void clearCStrings()
 {
-    if(cStrings.size() > 150) {
-        MutexHolder holder(gMutex);
-        for(size_t i = 0; i < 75; ++i) {
-            CPLFree(cStrings[i]);
-        }
-        cStrings.erase(cStrings.begin(), cStrings.begin() + 75);
+    if(!tCStringsHeld) {
+        nextCStrings();
     }
 }
 
+/**
+ * @brief The CStringsHolder class Keeps all strings stored during its
+ * lifetime for one result.
+ */
+class CStringsHolder
+{
+public:
+    CStringsHolder() {
+        clearCStrings();
+        tCStringsHeld = true;
+    }
+    ~CStringsHolder() { tCStringsHeld = false; }
+    CStringsHolder(const CStringsHolder &) = delete;
+    CStringsHolder &operator=(const CStringsHolder &) = delete;
+};
+
 /**
  * @brief ngsGetVersion Get library version number as major * 10000 + minor * 100 + rev
  * @param request may be gdal, proj, geos, curl, jpeg, png, zlib, iconv, sqlite3,
@@ -172,6 +207,10 @@ const char *ngsGetVersionString(const char *request)
  * - DEBUG_MODE ["ON", "OFF"] - May be ON or OFF strings to enable/disable debug mode
  * - LOCALE ["en_US.UTF-8", "de_DE", "ja_JP", ...] - Locale for error messages, etc.
  * - NUM_THREADS - Number threads in various functions (a positive number or "ALL_CPUS")
+ * - MAX_CPU_WORKERS - Cap of CPU workers of all thread pools, copy and
+ * overviews threads together. Service and I/O threads (notify, network loop,
+ * folder watch, writers) are not counted. One worker is kept for map render
+ * fill. Default is number of threads
  * - GL_MULTISAMPLE - Enable sampling if applicable
  * - SSL_CERT_FILE - Path to ssl cert file (*.pem)
  * - PROJ_DATA - Path to libproj data directory (may be skipped on Linux)
@@ -179,6 +218,26 @@ const char *ngsGetVersionString(const char *request)
  * - APP_NAME - Application name for logs and check function availability
  * - CRYPT_KEY - Key to encrypt/decrypt passwords
  * - NEXTGIS_TRACKER_API - Tracker API endpoint URL
+ * - TILE_CACHE_SIZE - Memory budget of decoded vector tiles cache in megabytes
+ * (0 disables cache)
+ * - MEMORY_BUDGET - Total memory budget of library caches, GDAL block cache and
+ * GL objects in megabytes. Least recently drawn data is freed to fit it.
+ * Default 0, budget is not enforced
+ * - CATALOG_SNAPSHOT ["ON", "OFF"] - Keep catalog root connections in binary
+ * snapshot file in settings directory for faster start. Default OFF
+ * - STORE_MMAP_SIZE - Data store memory mapped I/O size in megabytes. Default 64
+ * - STORE_CACHE_SIZE - Data store page cache size in kilobytes. Default 8192
+ * - STORE_PAGE_SIZE - Page size in bytes of new data stores. Default 4096
+ * - STORE_TEMP_STORE ["DEFAULT", "FILE", "MEMORY"] - Data store temporary
+ * tables location. Default MEMORY
+ * - STORE_CHECKPOINT_INTERVAL - Seconds between data store WAL checkpoints
+ * after writes. Default 60, 0 disables
+ * - MAPPED_SCAN ["ON", "OFF"] - Read local ESRI Shapefile and MapInfo files
+ * from memory mapped files on copy if they are read only. Default ON
+ * - MAPPED_SCAN_SIZE - Maximum size of files of one dataset read from memory
+ * mapped files in megabytes. Default 256, 0 disables
+ * - TRACE ["ON", "OFF"] - Collect timing spans of fill, fetch and sync
+ * operations. Save them by ngsTraceSave. Default OFF
  * @return ngsCode value - COD_SUCCESS if everything is OK
  */
 int ngsInit(char **options)
@@ -201,6 +260,11 @@ int ngsInit(char **options)
 
     // Number threads
     CPLSetConfigOption("GDAL_NUM_THREADS", CPLSPrintf("%d", getNumberThreads()));
+    const char *maxWorkers = CSLFetchNameValue(options, "MAX_CPU_WORKERS");
+    if(maxWorkers) {
+        WorkerLimiter::instance().setMaxWorkers(static_cast<unsigned char>(
+                std::max(1, std::min(atoi(maxWorkers), 255))));
+    }
     const char *multisample = CSLFetchNameValue(options, "GL_MULTISAMPLE");
     if(multisample) {
         CPLSetConfigOption("GL_MULTISAMPLE", multisample);
@@ -235,6 +299,48 @@ int ngsInit(char **options)
         Settings::instance().set("nextgis/track_api", trackerApiEndpoint);
         CPLDebug("ngstore", "NEXTGIS_TRACKER_API set to %s", trackerApiEndpoint);
     }
+
+    for(auto key : {"STORE_MMAP_SIZE", "STORE_CACHE_SIZE", "STORE_PAGE_SIZE",
+                    "STORE_TEMP_STORE", "STORE_CHECKPOINT_INTERVAL",
+                    "MAPPED_SCAN", "MAPPED_SCAN_SIZE"}) {
+        const char *value = CSLFetchNameValue(options, key);
+        if(value) {
+            CPLSetConfigOption(CPLSPrintf("NGS_%s", key), value);
+            CPLDebug("ngstore", "%s set to %s", key, value);
+        }
+    }
+
+    if(CPLFetchBool(options, "TRACE", false)) {
+        Trace::instance().setEnabled(true);
+        CPLDebug("ngstore", "Trace enabled");
+    }
+
+    if(CPLFetchBool(options, "CATALOG_SNAPSHOT", false)) {
+        CPLSetConfigOption("NGS_CATALOG_SNAPSHOT", "ON");
+        CPLDebug("ngstore", "Catalog snapshot enabled");
+    }
+
+    const char *tileCacheSize = CSLFetchNameValue(options, "TILE_CACHE_SIZE");
+    if(tileCacheSize) {
+        int size = atoi(tileCacheSize);
+        if(size < 0) {
+            size = 0;
+        }
+        Settings::instance().set("common/tile_cache_size", size);
+        TileCache::instance().setMaxSize(static_cast<size_t>(size) * 1024 * 1024);
+        CPLDebug("ngstore", "TILE_CACHE_SIZE set to %d Mb", size);
+    }
+
+    const char *memoryBudget = CSLFetchNameValue(options, "MEMORY_BUDGET");
+    if(memoryBudget) {
+        int size = atoi(memoryBudget);
+        if(size < 0) {
+            size = 0;
+        }
+        Settings::instance().set("common/memory_budget", size);
+        MemoryBudget::instance().setMaxSize(static_cast<size_t>(size) * 1024 * 1024);
+        CPLDebug("ngstore", "MEMORY_BUDGET set to %d Mb", size);
+    }
 #ifdef HAVE_LIBINTL_H
     const char* locale = CSLFetchNameValue(options, "LOCALE");
     //TODO: Do we need std::setlocale(LC_ALL, locale); execution here in library or it will call from programm?
@@ -273,8 +379,15 @@ int ngsInit(char **options)
  */
 void ngsUnInit()
 {
+    http::stopAsyncRequests();
+    Notify::instance().stop();
+    resetErrorCounts();
     MapStore::setInstance(nullptr);
+    TileCache::instance().clear();
     Catalog::setInstance(nullptr);
+    TransformationCache::instance().clear();
+    clearCryptCache();
+    ConnectionFactory::clearConnectionChecks();
     GDALDestroyDriverManager();
 }
 
@@ -288,6 +401,7 @@ void ngsFreeResources(char full)
     if(nullptr != mapStore) {
         mapStore->freeResources();
     }
+    TileCache::instance().clear();
     if(full) {
         CatalogPtr catalog = Catalog::instance();
         if(catalog) {
@@ -297,6 +411,27 @@ void ngsFreeResources(char full)
     clearCStrings();
 }
 
+/**
+ * @brief ngsOnMemoryPressure Free cached data on system memory pressure, i.e.
+ * from Android onTrimMemory. GDAL blocks are freed first, then decoded tiles
+ * and images least recently drawn. Maps drop prefetched tiles on next draw.
+ * @param level Pressure level
+ */
+void ngsOnMemoryPressure(enum ngsMemoryPressure level)
+{
+    MemoryBudget::instance().onPressure(level);
+}
+
+/**
+ * @brief ngsGetMemoryUsage Memory used by library caches, GDAL block cache and
+ * GL objects.
+ * @return Size in bytes
+ */
+long long ngsGetMemoryUsage()
+{
+    return static_cast<long long>(MemoryBudget::instance().size());
+}
+
 /**
  * @brief ngsGetLastErrorMessage Fetches the last error message posted with
  * returnError, CPLError, etc.
@@ -308,7 +443,52 @@ const char *ngsGetLastErrorMessage()
 }
 
 /**
- * @brief ngsAddNotifyFunction Add function triggered on some events
+ * @brief ngsGetErrorCount Number of errors with the code occurred in all
+ * threads since library init. Use it to watch the error rate of long
+ * operations, like failed tile downloads of the area cache.
+ * @param code Error code, COD_UNEXPECTED_ERROR and above.
+ * @return Errors count.
+ */
+unsigned long ngsGetErrorCount(enum ngsCode code)
+{
+    return errorCount(code);
+}
+
+/**
+ * @brief ngsTraceEnable Start or stop collecting the library trace spans.
+ * Trace is also enabled by TRACE option of ngsInit.
+ * @param enable 1 to start, 0 to stop
+ */
+void ngsTraceEnable(char enable)
+{
+    Trace::instance().setEnabled(enable != 0);
+}
+
+/**
+ * @brief ngsTraceSave Write the collected trace spans to the file in Chrome
+ * trace event format. Open it in chrome://tracing or Perfetto UI.
+ * @param path File path
+ * @param clear 1 to remove the saved spans from the trace
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsTraceSave(const char *path, char clear)
+{
+    if(nullptr == path) {
+        return outMessage(COD_NOT_SPECIFIED, _("Path is not specified"));
+    }
+    if(!Trace::instance().save(path)) {
+        return outMessage(COD_SAVE_FAILED, _("Failed to save trace to %s"),
+                          path);
+    }
+    if(clear != 0) {
+        Trace::instance().clear();
+    }
+    return COD_SUCCESS;
+}
+
+/**
+ * @brief ngsAddNotifyFunction Add function triggered on some events. Function
+ * is executed from library notify thread, feature events are coalesced.
  * @param function Function executed on event occurred
  * @param notifyTypes The OR combination of ngsChangeCode
  */
@@ -317,6 +497,17 @@ void ngsAddNotifyFunction(ngsNotifyFunc function, int notifyTypes)
     Notify::instance().addNotifyReceiver(function, notifyTypes);
 }
 
+/**
+ * @brief ngsAddSyncNotifyFunction Add function triggered on some events.
+ * Function is executed for each event from the thread made the change.
+ * @param function Function executed on event occurred
+ * @param notifyTypes The OR combination of ngsChangeCode
+ */
+void ngsAddSyncNotifyFunction(ngsNotifyFunc function, int notifyTypes)
+{
+    Notify::instance().addNotifyReceiver(function, notifyTypes, true);
+}
+
 /**
  * @brief ngsRemoveNotifyFunction Remove function. No events will be occurred.
  * @param function The function to remove
@@ -350,6 +541,8 @@ void ngsSettingsSetString(const char *key, const char *value)
 
 /**
  * ngsBackup create ZIP archive of settings directory and other directories provided in input. It is expected that each directory name is unique.
+ * The files are streamed directly into archive. The opened data stores are
+ * checkpointed and locked for writes while copied, so they stay opened.
  * @param name Backup file name. If extension is not set it will append.
  * @param dstObjectContainer Directory to create archive.
  * @param objects List of CatalogObjectH handles. The last element must be 0.
@@ -390,33 +583,28 @@ int ngsBackup(const char *name, CatalogObjectH dstObjectContainer, CatalogObject
         return outMessage(COD_CREATE_FAILED, _("Failed to create backup archive"));
     }
 
-    ObjectContainer *archiveCont = ngsDynamicCast(ObjectContainer, archive);
-    if(!archiveCont) {
-        return outMessage(COD_CREATE_FAILED, _("Failed to create backup archive"));
-    }
-
     std::string settingPath = CPLGetConfigOption("NGS_SETTINGS_PATH", "");
 
     CatalogPtr catalog = Catalog::instance();
-    std::vector<ObjectPtr> objectsArr;
-    objectsArr.push_back(catalog->getObjectBySystemPath(settingPath));
+    BackupWriter writer(File::formFileName(dstCatalogObjectContainer->path(),
+                                           archive->name()));
+    ObjectPtr settingsObject = catalog->getObjectBySystemPath(settingPath);
+    if(settingsObject && !writer.addObject(settingsObject)) {
+        return COD_COPY_FAILED;
+    }
     int counter = 0;
     while(objects[counter] != nullptr) {
-        ObjectPtr copyObjectContainer = static_cast<Object*>(objects[counter])->pointer();
-        objectsArr.push_back(copyObjectContainer);
+        ObjectPtr copyObject = static_cast<Object*>(objects[counter])->pointer();
+        if(!writer.addObject(copyObject)) {
+            return COD_COPY_FAILED;
+        }
         counter++;
     }
 
     Progress progress(callback, callbackData);
-    progress.setTotalSteps(static_cast<unsigned char>(objectsArr.size()));
-    unsigned char step = 0;
-    progress.setStep(step);
-    for(const auto &objectToCopy : objectsArr) {
-        int code = archiveCont->paste(objectToCopy);
-        if(code != COD_SUCCESS) {
-            return code;
-        }
-        progress.setStep(++step);
+    if(!writer.write(progress)) {
+        dstCatalogObjectContainer->refresh();
+        return COD_COPY_FAILED;
     }
 
     return COD_SUCCESS;
@@ -496,6 +684,24 @@ void ngsFree(void *pointer)
 // Miscellaneous functions
 //------------------------------------------------------------------------------
 
+static void addRequestType(enum ngsURLRequestType type, Options &options)
+{
+    switch (type) {
+    case URT_GET:
+        options.add("CUSTOMREQUEST", "GET");
+        break;
+    case URT_POST:
+        options.add("CUSTOMREQUEST", "POST");
+        break;
+    case URT_PUT:
+        options.add("CUSTOMREQUEST", "PUT");
+        break;
+    case URT_DELETE:
+        options.add("CUSTOMREQUEST", "DELETE");
+        break;
+    }
+}
+
 /**
  * @brief ngsURLRequest Perform web request
  * @param type Request type (GET, POST, PUT, DELETE)
@@ -542,25 +748,43 @@ ngsURLRequestResult *ngsURLRequest(enum ngsURLRequestType type, const char *url,
                                    void *callbackData)
 {
     Options requestOptions(options);
-    switch (type) {
-    case URT_GET:
-        requestOptions.add("CUSTOMREQUEST", "GET");
-        break;
-    case URT_POST:
-        requestOptions.add("CUSTOMREQUEST", "POST");
-        break;
-    case URT_PUT:
-        requestOptions.add("CUSTOMREQUEST", "PUT");
-        break;
-    case URT_DELETE:
-        requestOptions.add("CUSTOMREQUEST", "DELETE");
-        break;
-    }
+    addRequestType(type, requestOptions);
 
     Progress progress(callback, callbackData);
     return http::fetch(fromCString(url), progress, requestOptions);
 }
 
+/**
+ * @brief ngsURLRequestAsync Perform web request without blocking the caller.
+ * Requests are executed one by one or several simultaneously on the library
+ * network thread.
+ * @param type Request type (GET, POST, PUT, DELETE)
+ * @param url Request URL
+ * @param options Available options see in ngsURLRequest.
+ * @param callback Function executed from network thread when the request
+ * completed or canceled on ngsUnInit. The result must be freed by callee via
+ * ngsURLRequestResultFree.
+ * @param callbackArguments Callback function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if request queued, or error code
+ */
+int ngsURLRequestAsync(enum ngsURLRequestType type, const char *url,
+                       char **options, ngsURLRequestFunc callback,
+                       void *callbackArguments)
+{
+    if(nullptr == callback) {
+        return outMessage(COD_INVALID, _("Callback is not set"));
+    }
+
+    Options requestOptions(options);
+    addRequestType(type, requestOptions);
+
+    bool queued = http::fetchAsync(fromCString(url),
+        [callback, callbackArguments](const http::HTTPResultPtr &result) {
+            callback(http::requestResult(result), callbackArguments);
+        }, requestOptions);
+    return queued ? COD_SUCCESS : COD_REQUEST_FAILED;
+}
+
 /**
  * @brief uploadFile Upload file to url
  * @param path Path to file in operating system
@@ -1210,11 +1434,17 @@ JsonObjectH ngsJsonArrayItem(JsonObjectH object, int index)
  * @brief catalogObjectQuery Request the contents of some catalog container object.
  * @param object Catalog object. Must be container (contain some catalog objects).
  * @param objectFilter Filter output results
+ * @param namePattern Wildcard name pattern ('*' and '?'). Empty matches all.
+ * @param offset Count of matched children to skip.
+ * @param limit Max count of children to return. 0 for no limit.
  * @return List of ngsCatalogObjectInfo items or nullptr. The last element of list always nullptr.
  * The list must be freed using ngsFree function.
  */
 static ngsCatalogObjectInfo *catalogObjectQuery(CatalogObjectH object,
-                                                const Filter &objectFilter)
+                                                const Filter &objectFilter,
+                                                const std::string &namePattern = "",
+                                                size_t offset = 0,
+                                                size_t limit = 0)
 {
     Object *catalogObject = static_cast<Object*>(object);
     if(!catalogObject) {
@@ -1224,15 +1454,17 @@ static ngsCatalogObjectInfo *catalogObjectQuery(CatalogObjectH object,
     ObjectPtr catalogObjectPointer = catalogObject->pointer();
 
     ngsCatalogObjectInfo *output = nullptr;
-    size_t outputSize = 0;
     ObjectContainer * const container = dynamic_cast<ObjectContainer*>(catalogObject);
     if(!container || !objectFilter.canDisplay(catalogObjectPointer)) {
         return nullptr;
     }
 
-    clearCStrings();
+    CStringsHolder holder;
 
     if(container->type() == CAT_CONTAINER_SIMPLE) {
+        if(offset > 0 || !matchPattern(catalogObject->name(), namePattern)) {
+            return nullptr;
+        }
         SimpleDataset * const simpleDS = dynamic_cast<SimpleDataset*>(container);
         output = static_cast<ngsCatalogObjectInfo*>(
                                 CPLMalloc(sizeof(ngsCatalogObjectInfo) * 2));
@@ -1246,35 +1478,30 @@ static ngsCatalogObjectInfo *catalogObjectQuery(CatalogObjectH object,
         errorMessage(_("Failed to load children."));
         return nullptr;
     }
-    auto children = container->getChildren();
+    auto children = container->queryChildren(objectFilter, namePattern,
+                                             offset, limit);
     if(children.empty()) {
         return nullptr;
     }
 
+    output = static_cast<ngsCatalogObjectInfo*>(
+                CPLMalloc(sizeof(ngsCatalogObjectInfo) * (children.size() + 1)));
+    size_t outputSize = 0;
     for(const auto &child : children) {
-        if(objectFilter.canDisplay(child)) {
-            SimpleDataset *simpleDS = nullptr;
-            if(child->type() == CAT_CONTAINER_SIMPLE) {
-                simpleDS = ngsDynamicCast(SimpleDataset, child);
-            }
-
-            outputSize++;
-            output = static_cast<ngsCatalogObjectInfo*>(CPLRealloc(output,
-                                sizeof(ngsCatalogObjectInfo) * (outputSize + 1)));
+        SimpleDataset *simpleDS = nullptr;
+        if(child->type() == CAT_CONTAINER_SIMPLE) {
+            simpleDS = ngsDynamicCast(SimpleDataset, child);
+        }
 
-            const char *name = storeCString(child->name());
-            if(simpleDS) {
-                output[outputSize - 1] = {name, simpleDS->subType(),
-                                          child.get()};
-            }
-            else {
-                output[outputSize - 1] = {name, child->type(), child.get()};
-            }
+        const char *name = storeCString(child->name());
+        if(simpleDS) {
+            output[outputSize++] = {name, simpleDS->subType(), child.get()};
+        }
+        else {
+            output[outputSize++] = {name, child->type(), child.get()};
         }
     }
-    if(outputSize > 0) {
-        output[outputSize] = {nullptr, -1, nullptr};
-    }
+    output[outputSize] = {nullptr, -1, nullptr};
     return output;
 }
 
@@ -1317,6 +1544,45 @@ ngsCatalogObjectInfo *ngsCatalogObjectQueryMultiFilter(CatalogObjectH object,
     return catalogObjectQuery(object, objectFilter);
 }
 
+/**
+ * @brief ngsCatalogObjectQueryPaged Query name and type of child objects for
+ * provided path filtered by types and name pattern. Only the requested page of
+ * matched children is returned.
+ * @param object The handle of catalog object
+ * @param filters Only objects correspondent to provided filters will be return.
+ * May be null to return objects of any type. User must delete filters array
+ * manually
+ * @param filterCount The filters count
+ * @param namePattern Wildcard name pattern ('*' - any characters, '?' - any
+ * one character), case insensitive. Null or empty matches any name.
+ * @param offset Count of matched objects to skip
+ * @param limit Max count of objects to return. 0 for no limit
+ * @return Array of ngsCatlogObjectInfo structures. Caller must free this array
+ * after using with ngsFree method
+ */
+ngsCatalogObjectInfo *ngsCatalogObjectQueryPaged(CatalogObjectH object,
+                                                 int *filters, int filterCount,
+                                                 const char *namePattern,
+                                                 int offset, int limit)
+{
+    if(offset < 0 || limit < 0) {
+        errorMessage(_("Offset and limit must be non negative"));
+        return nullptr;
+    }
+
+    MultiFilter objectFilter;
+    for(int i = 0; filters && i < filterCount; ++i) {
+        objectFilter.addType(static_cast<enum ngsCatalogObjectType>(filters[i]));
+    }
+    if(nullptr == filters || filterCount <= 0) {
+        objectFilter.addType(CAT_UNKNOWN);
+    }
+
+    return catalogObjectQuery(object, objectFilter, fromCString(namePattern),
+                              static_cast<size_t>(offset),
+                              static_cast<size_t>(limit));
+}
+
 /**
  * @brief ngsCatalogObjectDelete Delete catalog object at specified path
  * @param object The handle of catalog object
@@ -1740,6 +2006,39 @@ void ngsCatalogObjectRefresh(CatalogObjectH object)
     container->refresh();
 }
 
+/**
+ * @brief ngsCatalogObjectLoadChildren Loads object container contents. For
+ * folders the progress function is executed as each file format finished
+ * loading, so ngsCatalogObjectQuery executed from progress function returns the
+ * partial listing.
+ * @param object Object container to load
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsCatalogObjectLoadChildren(CatalogObjectH object,
+                                 ngsProgressFunc callback, void *callbackData)
+{
+    Object *catalogObject = static_cast<Object*>(object);
+    if(!catalogObject) {
+        return outMessage(COD_INVALID, _("The object handle is null"));
+    }
+
+    ObjectContainer *container = dynamic_cast<ObjectContainer*>(catalogObject);
+    if(!container) {
+        return outMessage(COD_INVALID, _("The object is not container"));
+    }
+
+    Folder *folder = dynamic_cast<Folder*>(catalogObject);
+    if(folder) {
+        Progress progress(callback, callbackData);
+        return folder->loadChildren(progress) ? COD_SUCCESS : COD_CANCELED;
+    }
+    return container->loadChildren() ? COD_SUCCESS : COD_LOAD_FAILED;
+}
+
 /**
  * @brief ngsCatalogCheckConnection Checks if connection is valid
  * @param type Catalog object type
@@ -1752,6 +2051,69 @@ char ngsCatalogCheckConnection(enum ngsCatalogObjectType type, char **options)
     return ConnectionFactory::checkRemoteConnection(type, checkOptions) ? 1 : 0;
 }
 
+/**
+ * @brief ngsCatalogCheckConnections Checks several connections simultaneously
+ * with short timeouts. The results are cached for a minute, so the connections
+ * list can be checked each time it is shown.
+ * @param connections List of connection CatalogObjectH handles. The last
+ * element must be 0.
+ * @param options The key=value list of options:
+ * - FORCE=ON - check connections even if recently checked. Default OFF.
+ * - CONNECTTIMEOUT=val - connect timeout in seconds. Default 5.
+ * - TIMEOUT=val - request timeout in seconds. Default 10.
+ * @param callback Function executed as soon as each connection checked. May
+ * be null.
+ * @param callbackArguments Callback function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if all connections are valid,
+ * COD_REQUEST_FAILED if some of them are not, or error code
+ */
+int ngsCatalogCheckConnections(CatalogObjectH *connections, char **options,
+                               ngsConnectionCheckFunc callback,
+                               void *callbackArguments)
+{
+    if(nullptr == connections) {
+        return outMessage(COD_INVALID, _("Connections array cannot be null."));
+    }
+
+    Options checkOptions(options);
+    bool force = checkOptions.asBool("FORCE", false);
+    checkOptions.remove("FORCE");
+
+    std::vector<ConnectionCheck> checks;
+    int i = 0;
+    while(nullptr != connections[i]) {
+        Object *object = static_cast<Object*>(connections[i++]);
+        NGWConnection *connection = dynamic_cast<NGWConnection*>(object);
+        if(nullptr == connection) {
+            if(callback) {
+                callback(object->fullName().c_str(), 0,
+                         _("The object is not connection"), callbackArguments);
+            }
+            continue;
+        }
+
+        Options connectionOptions = connection->connectionOptions();
+        connectionOptions.append(checkOptions);
+        checks.push_back({connection->type(), connection->fullName(),
+                          connectionOptions, false, ""});
+    }
+
+    ConnectionFactory::checkRemoteConnections(checks,
+        [callback, callbackArguments](const ConnectionCheck &check) {
+            if(callback) {
+                callback(check.path.c_str(), check.result ? 1 : 0,
+                         check.message.c_str(), callbackArguments);
+            }
+        }, !force);
+
+    for(const ConnectionCheck &check : checks) {
+        if(!check.result) {
+            return COD_REQUEST_FAILED;
+        }
+    }
+    return COD_SUCCESS;
+}
+
 //------------------------------------------------------------------------------
 // Feature class
 //------------------------------------------------------------------------------
@@ -1943,7 +2305,7 @@ ngsField *ngsFeatureClassFields(CatalogObjectH object)
         return nullptr;
     }
 
-    clearCStrings();
+    CStringsHolder holder;
 
     const std::vector<Field> &fields = table->fields();
     ngsField *fieldsList = static_cast<ngsField*>(
@@ -1981,10 +2343,31 @@ ngsGeometryType ngsFeatureClassGeometryType(CatalogObjectH object)
  * @brief ngsFeatureClassCreateOverviews Creates Gl optimized vector tiles
  * @param object Catalog object handle. Must be feature class or simple datasource.
  * @param options The options key-value array specific to operation.
+ * - ZOOM_LEVELS - comma separated values of zoom levels or AUTO to select
+ *   zoom levels from sampled features sizes, vertices count and density.
+ *   Zoom levels without overviews are read from the nearest generated level
+ * - SIMPLIFY_DP_MAX_ZOOM - lines on zoom levels up to this value are
+ *   simplified by Douglas-Peucker, on others are snapped to grid. Default -1
+ * - TILE_COMPRESSION - NONE, DEFLATE, ZSTD or LZ4 tiles compression. ZSTD and
+ *   LZ4 need GDAL 3.4 or newer built with these libraries. Default NONE
+ * - TILE_FORMAT - NATIVE or MVT. MVT tiles are stored as Mapbox Vector Tiles
+ *   readable by tile servers, TILE_COMPRESSION is not used. Default NATIVE
+ * - TILE_ATTRIBUTES - comma separated field names stored with tile items.
+ *   Styles and labels read these values from tiles instead of features
+ * - CLUSTER_RADIUS - point layers only. Points of the tile grid cell of this
+ *   size in pixels are merged to one cluster item. Styles and labels get the
+ *   cluster features count from the point_count field. Default 0 - no clusters
+ * - CLUSTER_MAX_ZOOM - points are clustered on zoom levels up to this value.
+ *   Default is the zoom level before the last overview zoom level
+ * - BACKGROUND - with FORCE rebuild existing overviews by the background
+ *   thread and return at once. The old tiles are drawn until the rebuilt ones
+ *   replace them in one transaction. The callback is executed from the
+ *   background thread and gets COD_FINISHED after the replace. Default NO
  * @param callback Progress function (template is ngsProgressFunc) executed
  * periodically to report progress and cancel. If returns 1 the execution will
  * continue, 0 - cancelled. May be null.
- * @param callbackData Progress function parameter. May be null.
+ * @param callbackData Progress function parameter. May be null. Must be valid
+ * until the background rebuild finish.
  * @return ngsCode value - COD_SUCCESS if everything is OK
  */
 int ngsFeatureClassCreateOverviews(CatalogObjectH object, char **options,
@@ -2180,6 +2563,144 @@ FeatureH ngsFeatureClassNextFeature(CatalogObjectH object)
     return nullptr;
 }
 
+/**
+ * @brief ngsFeatureClassReadColumns Reads next rows into caller provided typed
+ * arrays. Only requested fields are fetched, so this is much faster than
+ * ngsFeatureClassNextFeature and ngsFeatureGetFieldAs* calls per cell. Do not
+ * mix with ngsFeatureClassNextFeature, call ngsFeatureClassResetReading to
+ * finish reading columns.
+ * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
+ * @param fids Array of maxCount items for feature identifiers. May be null.
+ * @param columns Array of columns. Each column values array must have maxCount
+ * items of type according to field type: int for integer, long long for
+ * integer64, double for real and const char* for other types. String values are
+ * valid until next call or ngsFeatureClassResetReading. The isSet array may be
+ * null.
+ * @param columnCount Columns count
+ * @param maxCount Max count of rows to read
+ * @return Count of rows read, 0 if no more rows or -1 on error
+ */
+int ngsFeatureClassReadColumns(CatalogObjectH object, long long *fids,
+                               ngsFieldColumn *columns, int columnCount,
+                               int maxCount)
+{
+    Table *table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return -1;
+    }
+    if(nullptr == columns && columnCount > 0) {
+        errorMessage(_("The columns array is null"));
+        return -1;
+    }
+    return table->readColumns(fids, columns, columnCount, maxCount);
+}
+
+/**
+ * @brief ngsFeatureClassReadPage Writes next rows into caller memory in one
+ * call: identifiers, all field values and geometry as WKB. The layout is
+ * described in Table::readPage. The row which does not fit into the buffer is
+ * returned by next call. Do not mix with ngsFeatureClassNextFeature.
+ * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
+ * @param buffer Memory to write page
+ * @param bufferSize Memory size in bytes
+ * @param maxCount Max count of rows to write
+ * @param withGeometry If 1 geometry will be written
+ * @return Count of rows written, 0 if no more rows or -1 on error (i.e. buffer
+ * is too small for one row)
+ */
+int ngsFeatureClassReadPage(CatalogObjectH object, void *buffer,
+                            long long bufferSize, int maxCount,
+                            char withGeometry)
+{
+    Table *table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return -1;
+    }
+    if(bufferSize < 0) {
+        errorMessage(_("Invalid buffer size"));
+        return -1;
+    }
+    return table->readPage(static_cast<GByte*>(buffer),
+                           static_cast<size_t>(bufferSize), maxCount,
+                           withGeometry == 1);
+}
+
+/**
+ * @brief ngsFeatureClassLoadGeoJson Append features from GeoJSON
+ * FeatureCollection file. The file is read by chunks, so it may be larger than
+ * available memory.
+ * @param object Handle to FeatureClass or SimpleDataset catalog object
+ * @param path GeoJSON file path
+ * @param options The options key-value array specific to operation.
+ * COPY_CHUNK_SIZE - features count written in one transaction.
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassLoadGeoJson(CatalogObjectH object, const char *path,
+                               char **options, ngsProgressFunc callback,
+                               void *callbackData)
+{
+    FeatureClass *featureClass = getFeatureClassFromHandle(object);
+    if(nullptr == featureClass) {
+        return COD_INVALID;
+    }
+    if(nullptr == path) {
+        return outMessage(COD_INVALID, _("GeoJSON path must be set."));
+    }
+
+    Options loadOptions(options);
+    Progress loadProgress(callback, callbackData);
+    return featureClass->loadGeoJSON(path, loadProgress, loadOptions);
+}
+
+/**
+ * @brief ngsFeatureClassSpatialJoin Write to each feature the field value of
+ * the polygon it falls in. Features out of polygons get null value.
+ * @param object Handle to FeatureClass or SimpleDataset catalog object to
+ * write values to
+ * @param polygons Handle to polygon FeatureClass or SimpleDataset catalog
+ * object
+ * @param sourceField Polygons field name. If null or empty, polygon
+ * identifier is written
+ * @param targetField Field name to write value to
+ * @param options The options key-value array specific to operation.
+ * - JOIN_THREADS - worker thread count. Defaults to CPU count
+ * - COPY_CHUNK_SIZE - features count written in one transaction.
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassSpatialJoin(CatalogObjectH object, CatalogObjectH polygons,
+                               const char *sourceField, const char *targetField,
+                               char **options, ngsProgressFunc callback,
+                               void *callbackData)
+{
+    FeatureClass *featureClass = getFeatureClassFromHandle(object);
+    if(nullptr == featureClass) {
+        return COD_INVALID;
+    }
+    FeatureClass *polygonsClass = getFeatureClassFromHandle(polygons);
+    if(nullptr == polygonsClass) {
+        return COD_INVALID;
+    }
+    if(nullptr == targetField) {
+        return outMessage(COD_INVALID, _("Target field must be set."));
+    }
+
+    FeatureClassPtr polygonsPtr =
+            std::dynamic_pointer_cast<FeatureClass>(polygonsClass->pointer());
+    Options joinOptions(options);
+    Progress joinProgress(callback, callbackData);
+    return featureClass->spatialJoin(polygonsPtr,
+                                     nullptr == sourceField ? "" : sourceField,
+                                     targetField, joinProgress, joinOptions);
+}
+
 /**
  * @brief ngsFeatureClassGetFeature Returns feature by identifier
  * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
@@ -2235,28 +2756,116 @@ int ngsFeatureClassSetSpatialFilter(CatalogObjectH object, double minX,
     return COD_SUCCESS;
 }
 
-int ngsFeatureClassDeleteEditOperation(CatalogObjectH object,
-                                       ngsEditOperation operation)
+/**
+ * @brief ngsFeatureClassCreateIndex Create attribute index on field. Speeds up
+ * attribute filters on the field. Supported for data store tables.
+ * @param object Handle to Table or FeatureClass catalog object
+ * @param fieldName Field name
+ * @return COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassCreateIndex(CatalogObjectH object, const char *fieldName)
 {
     Table *table = getTableFromHandle(object);
     if(nullptr == table) {
         return COD_INVALID;
     }
-
-    table->deleteEditOperation(operation);
-
-    return COD_SUCCESS;
+    return table->createIndex(fromCString(fieldName)) ? COD_SUCCESS :
+                                                        COD_CREATE_FAILED;
 }
 
-ngsEditOperation *ngsFeatureClassGetEditOperations(CatalogObjectH object)
+/**
+ * @brief ngsFeatureClassDropIndex Drop attribute index created by
+ * ngsFeatureClassCreateIndex.
+ * @param object Handle to Table or FeatureClass catalog object
+ * @param fieldName Field name
+ * @return COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassDropIndex(CatalogObjectH object, const char *fieldName)
 {
     Table *table = getTableFromHandle(object);
     if(nullptr == table) {
-        return nullptr;
+        return COD_INVALID;
     }
+    return table->dropIndex(fromCString(fieldName)) ? COD_SUCCESS :
+                                                      COD_DELETE_FAILED;
+}
 
-    auto operations = table->editOperations();
-    ngsEditOperation *out = static_cast<ngsEditOperation*>(
+/**
+ * @brief ngsFeatureClassCreateSearchIndex Create full-text search index of
+ * data store feature class fields. The index follows feature edits.
+ * @param object Handle to data store FeatureClass catalog object
+ * @param fields Fields list to index. Empty list drops the index
+ * @param options The options key-value array:
+ * - LANG - language to normalize text and queries, i.e. ru. Default is empty
+ * @return COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassCreateSearchIndex(CatalogObjectH object, char **fields,
+                                     char **options)
+{
+    StoreFeatureClass *featureClass = dynamic_cast<StoreFeatureClass*>(
+                getFeatureClassFromHandle(object));
+    if(nullptr == featureClass) {
+        errorMessage(_("Search index is supported for data store feature classes"));
+        return COD_INVALID;
+    }
+    Options createOptions(options);
+    return featureClass->createSearchIndex(fillStringList(fields),
+                createOptions.asString("LANG", "")) ? COD_SUCCESS :
+                                                      COD_CREATE_FAILED;
+}
+
+/**
+ * @brief ngsFeatureClassSearch Find features which indexed fields contain all
+ * query words, best matches first.
+ * @param object Handle to data store FeatureClass catalog object
+ * @param query Search query
+ * @param offset Number of best matches to skip
+ * @param limit Maximum number of feature ids to return
+ * @return Feature ids array terminated by -1 or null on error. Free array with
+ * ngsFree
+ */
+long long *ngsFeatureClassSearch(CatalogObjectH object, const char *query,
+                                 int offset, int limit)
+{
+    StoreFeatureClass *featureClass = dynamic_cast<StoreFeatureClass*>(
+                getFeatureClassFromHandle(object));
+    if(nullptr == featureClass) {
+        errorMessage(_("Search index is supported for data store feature classes"));
+        return nullptr;
+    }
+    auto ids = featureClass->search(fromCString(query), offset, limit);
+    long long *out = static_cast<long long*>(
+                CPLMalloc((ids.size() + 1) * sizeof(long long)));
+    int counter = 0;
+    for(GIntBig id : ids) {
+        out[counter++] = id;
+    }
+    out[counter] = NOT_FOUND;
+    return out;
+}
+
+int ngsFeatureClassDeleteEditOperation(CatalogObjectH object,
+                                       ngsEditOperation operation)
+{
+    Table *table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return COD_INVALID;
+    }
+
+    table->deleteEditOperation(operation);
+
+    return COD_SUCCESS;
+}
+
+ngsEditOperation *ngsFeatureClassGetEditOperations(CatalogObjectH object)
+{
+    Table *table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return nullptr;
+    }
+
+    auto operations = table->editOperations();
+    ngsEditOperation *out = static_cast<ngsEditOperation*>(
                 CPLMalloc((operations.size() + 1) * sizeof(ngsEditOperation)));
     int counter = 0;
     for(const auto &op : operations) {
@@ -2266,6 +2875,225 @@ ngsEditOperation *ngsFeatureClassGetEditOperations(CatalogObjectH object)
     return out;
 }
 
+/**
+ * @brief ngsFeatureClassChangeSequence Returns number of the last change of
+ * table or feature class. The number increases on every feature insert,
+ * update and delete, including batch operations which send no notifies.
+ * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
+ * @return Change sequence number or -1 on error
+ */
+long long ngsFeatureClassChangeSequence(CatalogObjectH object)
+{
+    Table *table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return NOT_FOUND;
+    }
+    return static_cast<long long>(table->changeSequence());
+}
+
+/**
+ * @brief ngsFeatureClassChangesSince Returns changes made after the sequence
+ * number as feature identifier ranges. Use it to refresh caches after bulk
+ * operations instead of per feature notifies. The changes are kept in memory
+ * for the limited number of ranges. If the changes after the sequence number
+ * are dropped, the array has one range with CC_CHANGE_OBJECT code and the
+ * caller has to refresh all features.
+ * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
+ * @param sequence Sequence number the caller is up to date with, 0 for all
+ * kept changes
+ * @return Array of ranges ended with range with CC_NOP code. The caller have
+ * to free array with ngsFree. Returns null on error.
+ */
+ngsChangeRange *ngsFeatureClassChangesSince(CatalogObjectH object,
+                                            long long sequence)
+{
+    Table *table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return nullptr;
+    }
+
+    std::vector<ChangeRange> changes;
+    bool complete = table->changesSince(
+                static_cast<GUIntBig>(std::max(0LL, sequence)), changes);
+    ngsChangeRange *out = static_cast<ngsChangeRange*>(
+                CPLMalloc((changes.size() + 2) * sizeof(ngsChangeRange)));
+    int counter = 0;
+    if(!complete) {
+        out[counter++] = {static_cast<long long>(table->changeSequence()),
+                          NOT_FOUND, NOT_FOUND, CC_CHANGE_OBJECT,
+                          {0.0, 0.0, 0.0, 0.0}};
+    }
+    for(const ChangeRange &range : changes) {
+        ngsExtent extent = {0.0, 0.0, 0.0, 0.0};
+        if(range.extent.isInit()) {
+            extent = {range.extent.minX(), range.extent.minY(),
+                      range.extent.maxX(), range.extent.maxY()};
+        }
+        out[counter++] = {static_cast<long long>(range.sequence),
+                          range.fromFid, range.toFid, range.code, extent};
+    }
+    out[counter] = {NOT_FOUND, NOT_FOUND, NOT_FOUND, CC_NOP,
+                    {0.0, 0.0, 0.0, 0.0}};
+    return out;
+}
+
+/**
+ * @brief ngsFeatureClassSendEditOperations Send logged feature edits of store
+ * table or feature class to NextGIS Web with bulk requests. The sent
+ * operations are removed from edit log, remote ids of created features are
+ * stored. Attachment operations are left in log.
+ * @param object Catalog object handle. Must be store table or feature class
+ * connected to NextGIS Web layer.
+ * @param options The options key-value array specific to operation.
+ * - CHUNK_SIZE - Maximum request payload size in bytes. Default 1 Mb
+ * - RETRY_COUNT - Tries to send one chunk. Default 3
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassSendEditOperations(CatalogObjectH object, char **options,
+                                      ngsProgressFunc callback,
+                                      void *callbackData)
+{
+    StoreObject *storeObject = dynamic_cast<StoreObject*>(
+                getTableFromHandle(object));
+    if(nullptr == storeObject) {
+        return outMessage(COD_INVALID, _("Source object is not store table"));
+    }
+
+    Options sendOptions(options);
+    Progress sendProgress(callback, callbackData);
+    return ngw::uploadFeatureEdits(storeObject, sendProgress, sendOptions) ?
+                COD_SUCCESS : COD_REQUEST_FAILED;
+}
+
+/**
+ * @brief ngsFeatureClassDownloadChanges Download features changed on NextGIS
+ * Web since last download to store table or feature class. Only features with
+ * cursor field value greater than stored one are requested.
+ * @param object Catalog object handle. Must be store table or feature class
+ * connected to NextGIS Web layer.
+ * @param options The options key-value array specific to operation.
+ * - CURSOR_FIELD - Server field name with version number or modification time.
+ *   Stored for next calls. If not set all features are downloaded
+ * - MINX, MINY, MAXX, MAXY - Download only features intersecting this extent
+ * - PAGE_SIZE - Features count per request. Default 1000
+ * - RESET_CURSOR - Ignore stored cursor and download all features. Default NO
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassDownloadChanges(CatalogObjectH object, char **options,
+                                   ngsProgressFunc callback, void *callbackData)
+{
+    StoreObject *storeObject = dynamic_cast<StoreObject*>(
+                getTableFromHandle(object));
+    if(nullptr == storeObject) {
+        return outMessage(COD_INVALID, _("Source object is not store table"));
+    }
+
+    Options downloadOptions(options);
+    Progress downloadProgress(callback, callbackData);
+    return ngw::downloadFeatureChanges(storeObject, downloadProgress,
+                                       downloadOptions) ?
+                COD_SUCCESS : COD_REQUEST_FAILED;
+}
+
+/**
+ * @brief ngsFeatureClassTransferAttachments Upload new attachments of store
+ * table or feature class to NextGIS Web and download attachments absent
+ * locally. Several transfers run at once, interrupted downloads are resumed.
+ * @param object Catalog object handle. Must be store table or feature class
+ * connected to NextGIS Web layer.
+ * @param options The options key-value array specific to operation.
+ * - UPLOAD - Upload attachments created locally. Default YES
+ * - DOWNLOAD - Download attachments absent locally. Default YES
+ * - THREAD_COUNT - Concurrent transfers count. Default 4
+ * - RETRY_COUNT - Tries for one transfer. Default 3
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassTransferAttachments(CatalogObjectH object, char **options,
+                                       ngsProgressFunc callback,
+                                       void *callbackData)
+{
+    StoreObject *storeObject = dynamic_cast<StoreObject*>(
+                getTableFromHandle(object));
+    if(nullptr == storeObject) {
+        return outMessage(COD_INVALID, _("Source object is not store table"));
+    }
+
+    Options transferOptions(options);
+    Progress transferProgress(callback, callbackData);
+    return ngw::transferAttachments(storeObject, transferProgress,
+                                    transferOptions) ?
+                COD_SUCCESS : COD_REQUEST_FAILED;
+}
+
+/**
+ * @brief ngsCatalogObjectSyncLayers Sync store layers with NextGIS Web. The
+ * layers of different stores are synced in parallel. Each layer sync start
+ * and finish are notified with CC_SYNC_STARTED and CC_SYNC_FINISHED or
+ * CC_SYNC_FAILED codes, the duration in milliseconds is in NGW_SYNC_DURATION
+ * layer property of NG_ADDITIONS_KEY domain.
+ * @param object Catalog object handle. Store table or feature class, store or
+ * folder with stores.
+ * @param options The options key-value array specific to operation.
+ * - MAX_SERVER_CONNECTIONS - Parallel connections with one server, shared by
+ *   layer syncs and their attachments transfers. Default 2
+ * - Options of ngsFeatureClassSendEditOperations,
+ *   ngsFeatureClassDownloadChanges and ngsFeatureClassTransferAttachments
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK, COD_CANCELED if
+ * canceled by the callback
+ */
+int ngsCatalogObjectSyncLayers(CatalogObjectH object, char **options,
+                               ngsProgressFunc callback, void *callbackData)
+{
+    Object *catalogObject = static_cast<Object*>(object);
+    if(!catalogObject) {
+        return outMessage(COD_INVALID, _("The object handle is null"));
+    }
+
+    std::vector<ObjectPtr> layers;
+    ObjectContainer *container = dynamic_cast<ObjectContainer*>(catalogObject);
+    if(nullptr != container && nullptr == dynamic_cast<Table*>(catalogObject)) {
+        container->loadChildren();
+        for(const ObjectPtr &child : container->getChildren()) {
+            ObjectContainer *childContainer = ngsDynamicCast(ObjectContainer, child);
+            if(nullptr != childContainer && !ngsDynamicCast(Table, child)) {
+                childContainer->loadChildren();
+                auto grandChildren = childContainer->getChildren();
+                layers.insert(layers.end(), grandChildren.begin(),
+                              grandChildren.end());
+            }
+            else {
+                layers.push_back(child);
+            }
+        }
+    }
+    else {
+        layers.push_back(catalogObject->pointer());
+    }
+
+    Options syncOptions(options);
+    Progress syncProgress(callback, callbackData);
+    if(ngw::syncLayers(layers, syncProgress, syncOptions)) {
+        return COD_SUCCESS;
+    }
+    return syncProgress.isCanceled() ? COD_CANCELED : COD_REQUEST_FAILED;
+}
+
 void ngsFeatureFree(FeatureH feature)
 {
     FeaturePtr *featurePtrPointer = static_cast<FeaturePtr*>(feature);
@@ -2314,6 +3142,50 @@ GeometryH ngsFeatureGetGeometry(FeatureH feature)
     return (*featurePtrPointer)->GetGeometryRef()->clone();
 }
 
+/**
+ * @brief writeWKB Write geometry as ISO WKB little endian into caller memory.
+ * @param geom Geometry or null.
+ * @param buffer Memory to write or null to get required size.
+ * @param bufferSize Memory size in bytes.
+ * @return WKB size in bytes. If buffer is null or too small nothing is
+ * written. 0 if geometry is null.
+ */
+static int writeWKB(const OGRGeometry *geom, void *buffer, int bufferSize)
+{
+    if(nullptr == geom) {
+        return 0;
+    }
+    int size = geom->WkbSize();
+    if(nullptr == buffer || bufferSize < size) {
+        return size;
+    }
+    if(geom->exportToWkb(wkbNDR, static_cast<unsigned char*>(buffer),
+                         wkbVariantIso) != OGRERR_NONE) {
+        errorMessage(_("Failed to export geometry to WKB"));
+        return -1;
+    }
+    return size;
+}
+
+/**
+ * @brief ngsFeatureGetGeometryWKB Write feature geometry as WKB into caller
+ * memory without geometry copy. Call with null buffer to get required size.
+ * @param feature Feature handle
+ * @param buffer Memory to write WKB or null
+ * @param bufferSize Memory size in bytes
+ * @return WKB size in bytes, 0 if feature has no geometry or -1 on error. If
+ * return value is greater than bufferSize nothing is written.
+ */
+int ngsFeatureGetGeometryWKB(FeatureH feature, void *buffer, int bufferSize)
+{
+    FeaturePtr *featurePtrPointer = static_cast<FeaturePtr*>(feature);
+    if(!featurePtrPointer) {
+        errorMessage(_("The object handle is null"));
+        return -1;
+    }
+    return writeWKB((*featurePtrPointer)->GetGeometryRef(), buffer, bufferSize);
+}
+
 int ngsFeatureGetFieldAsInteger(FeatureH feature, int field)
 {
     FeaturePtr *featurePtrPointer = static_cast<FeaturePtr*>(feature);
@@ -2474,11 +3346,33 @@ int ngsGeometryTransformTo(GeometryH geometry, int EPSG)
 
 int ngsGeometryTransform(GeometryH geometry, CoordinateTransformationH ct)
 {
-    return static_cast<OGRGeometry*>(geometry)->transform(
-                static_cast<OGRCoordinateTransformation*>(ct)) == OGRERR_NONE ?
+    CoordinateTransformation *transform =
+            static_cast<CoordinateTransformation*>(ct);
+    if(nullptr == transform) {
+        return outMessage(COD_INVALID, _("The object handle is null"));
+    }
+    return transform->transform(static_cast<OGRGeometry*>(geometry)) ?
                 COD_SUCCESS : COD_UPDATE_FAILED;
 }
 
+/**
+ * @brief ngsGeometryGetWKB Write geometry as WKB into caller memory. Call with
+ * null buffer to get required size.
+ * @param geometry Geometry handle
+ * @param buffer Memory to write WKB or null
+ * @param bufferSize Memory size in bytes
+ * @return WKB size in bytes or -1 on error. If return value is greater than
+ * bufferSize nothing is written.
+ */
+int ngsGeometryGetWKB(GeometryH geometry, void *buffer, int bufferSize)
+{
+    if(nullptr == geometry) {
+        errorMessage(_("The object handle is null"));
+        return -1;
+    }
+    return writeWKB(static_cast<OGRGeometry*>(geometry), buffer, bufferSize);
+}
+
 char ngsGeometryIsEmpty(GeometryH geometry)
 {
     return static_cast<OGRGeometry*>(geometry)->IsEmpty() ? API_TRUE : API_FALSE;
@@ -2494,6 +3388,16 @@ const char *ngsGeometryToJson(GeometryH geometry)
     return storeCString(static_cast<OGRGeometry*>(geometry)->exportToJson());
 }
 
+/**
+ * @brief ngsCoordinateTransformationCreate Take coordinate transformation
+ * from the process wide cache. Spatial references and transformations are
+ * created once per EPSG codes pair and reused after
+ * ngsCoordinateTransformationFree.
+ * @param fromEPSG Source EPSG code.
+ * @param toEPSG Destination EPSG code.
+ * @return Transformation handle or null on error. Transformation is not thread
+ * safe, use one handle per thread.
+ */
 CoordinateTransformationH ngsCoordinateTransformationCreate(int fromEPSG,
                                                             int toEPSG)
 {
@@ -2502,40 +3406,80 @@ CoordinateTransformationH ngsCoordinateTransformationCreate(int fromEPSG,
         return nullptr;
     }
 
-    SpatialReferencePtr from = SpatialReferencePtr::importFromEPSG(fromEPSG);
-    if(from == nullptr) {
+    TransformationCache &cache = TransformationCache::instance();
+    if(cache.spatialReference(fromEPSG) == nullptr) {
         errorMessage(_("Unsupported from EPSG with code %d"), fromEPSG);
         return nullptr;
     }
 
-    SpatialReferencePtr to = SpatialReferencePtr::importFromEPSG(toEPSG);
-    if(to == nullptr) {
+    if(cache.spatialReference(toEPSG) == nullptr) {
         errorMessage(_("Unsupported from EPSG with code %d"), toEPSG);
         return nullptr;
     }
 
-    return OGRCreateCoordinateTransformation(from, to);
+    return cache.take(fromEPSG, toEPSG);
 }
 
+/**
+ * @brief ngsCoordinateTransformationFree Return coordinate transformation to
+ * the cache.
+ * @param ct Transformation handle.
+ */
 void ngsCoordinateTransformationFree(CoordinateTransformationH ct)
 {
-    OGRCoordinateTransformation::DestroyCT(
-                static_cast<OGRCoordinateTransformation*>(ct));
+    TransformationCache::instance().put(
+                static_cast<CoordinateTransformation*>(ct));
 }
 
 ngsCoordinate ngsCoordinateTransformationDo(CoordinateTransformationH ct,
                                             ngsCoordinate coordinates)
 {
-    OGRCoordinateTransformation *pct = static_cast<OGRCoordinateTransformation*>(ct);
+    CoordinateTransformation *pct = static_cast<CoordinateTransformation*>(ct);
     if(!pct) {
         errorMessage(_("The object handle is null"));
         return {0.0, 0.0, 0.0};
     }
 
-    pct->Transform(1, &coordinates.X, &coordinates.Y, &coordinates.Z);
+    pct->transform(1, &coordinates.X, &coordinates.Y, &coordinates.Z);
     return coordinates;
 }
 
+/**
+ * @brief ngsCoordinateTransformationDoArray Transform coordinates array in
+ * place.
+ * @param ct Transformation handle.
+ * @param coordinates Coordinates array.
+ * @param count Coordinates count.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsCoordinateTransformationDoArray(CoordinateTransformationH ct,
+                                       ngsCoordinate *coordinates, int count)
+{
+    CoordinateTransformation *pct = static_cast<CoordinateTransformation*>(ct);
+    if(!pct || (nullptr == coordinates && count > 0)) {
+        return outMessage(COD_INVALID, _("The object handle is null"));
+    }
+    if(count <= 0) {
+        return COD_SUCCESS;
+    }
+
+    std::vector<double> x(static_cast<size_t>(count));
+    std::vector<double> y(static_cast<size_t>(count));
+    std::vector<double> z(static_cast<size_t>(count));
+    for(size_t i = 0; i < x.size(); ++i) {
+        x[i] = coordinates[i].X;
+        y[i] = coordinates[i].Y;
+        z[i] = coordinates[i].Z;
+    }
+
+    bool result = pct->transform(count, x.data(), y.data(), z.data());
+    for(size_t i = 0; i < x.size(); ++i) {
+        coordinates[i] = {x[i], y[i], z[i]};
+    }
+    return result ? COD_SUCCESS : outMessage(COD_UPDATE_FAILED,
+                                             _("Transform coordinates failed"));
+}
+
 long long ngsFeatureAttachmentAdd(FeatureH feature, const char *name,
                                   const char *description, const char *path,
                                   char **options, char logEdits)
@@ -2600,7 +3544,7 @@ ngsFeatureAttachmentInfo *ngsFeatureAttachmentsGet(FeatureH feature)
         return nullptr;
     }
 
-    clearCStrings();
+    CStringsHolder holder;
 
     std::vector<FeaturePtr::AttachmentInfo> info = featurePtrPointer->attachments();
     ngsFeatureAttachmentInfo *out = static_cast<ngsFeatureAttachmentInfo*>(
@@ -2656,6 +3600,8 @@ char ngsFeatureAttachmentUpdate(FeatureH feature, long long aid,
  * - MAXX - maximum X coordinate of bounding box
  * - MAXY - maximum Y coordinate of bounding box
  * - ZOOM_LEVELS - comma separated values of zoom levels
+ * - RESUME - ON/OFF. Skip tiles downloaded by the stopped job with the same
+ * area and zoom levels. Default ON.
  * @param callback Progress function (template is ngsProgressFunc) executed
  * periodically to report progress and cancel. If returns 1 the execution will
  * continue, 0 - cancelled. May be null.
@@ -2677,6 +3623,55 @@ int ngsRasterCacheArea(CatalogObjectH object, char** options,
                 COD_SUCCESS : COD_CREATE_FAILED;
 }
 
+/**
+ * @brief ngsRasterCacheAreaProgress Get downloaded part of stopped or running
+ * area caching job
+ * @param object Raster to download tiles
+ * @param options The same MINX, MINY, MAXX, MAXY and ZOOM_LEVELS options as
+ * in ngsRasterCacheArea
+ * @return Value from 0 to 1 or -1 if there is no such job
+ */
+double ngsRasterCacheAreaProgress(CatalogObjectH object, char **options)
+{
+    Raster *raster = getRasterFromHandle(object);
+    if(!raster) {
+        outMessage(COD_INVALID, _("Source dataset type is incompatible"));
+        return -1.0;
+    }
+
+    return raster->cacheAreaProgress(Options(options));
+}
+
+/**
+ * @brief ngsRasterCreateOverviews Build overviews of local raster. Zoomed out
+ * map tiles are read from overviews instead of downsampling whole raster. The
+ * function may take long time for big rasters, so call it in separate thread.
+ * @param object Raster to create overviews
+ * @param options Key=value list of options.
+ * - RESAMPLING - overview resampling method (NEAREST, AVERAGE, CUBIC, etc.).
+ * Default AVERAGE.
+ * - FORCE - ON/OFF. Rebuild existing overviews. Default OFF.
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsRasterCreateOverviews(CatalogObjectH object, char **options,
+                             ngsProgressFunc callback, void *callbackData)
+{
+    Raster *raster = getRasterFromHandle(object);
+    if(!raster) {
+        return outMessage(COD_INVALID, _("Source dataset type is incompatible"));
+    }
+
+    Options createOptions(options);
+    Progress createProgress(callback, callbackData);
+
+    return raster->createOverviews(createProgress, createOptions) ?
+                COD_SUCCESS : COD_CREATE_FAILED;
+}
+
 
 //------------------------------------------------------------------------------
 // Map
@@ -2711,6 +3706,20 @@ char ngsMapCreate(const char *name, const char *description,
  * @return -1 if open failed or map id.
  */
 char ngsMapOpen(const char *path)
+{
+    return ngsMapOpenWithOptions(path, nullptr);
+}
+
+/**
+ * @brief ngsMapOpenWithOptions Opens existing map from file
+ * @param path Path to map file inside catalog in form ngc://some path/
+ * @param options Open options:
+ *  - LAZY_LAYERS=ON/OFF - open layers datasources in separate thread after
+ *    map open. Layers are drawn empty until their datasources are ready, so
+ *    the first frame is not delayed by datasources open. Default OFF.
+ * @return -1 if open failed or map id.
+ */
+char ngsMapOpenWithOptions(const char *path, char **options)
 {
     MapStore * const mapStore = MapStore::instance();
     if(nullptr == mapStore) {
@@ -2719,7 +3728,7 @@ char ngsMapOpen(const char *path)
     CatalogPtr catalog = Catalog::instance();
     ObjectPtr object = catalog->getObject(fromCString(path));
     MapFile * const mapFile = ngsDynamicCast(MapFile, object);
-    return mapStore->openMap(mapFile);
+    return mapStore->openMap(mapFile, Options(options));
 }
 
 /**
@@ -2824,7 +3833,8 @@ int ngsMapSetSize(char mapId, int width, int height, char isYAxisInverted)
 /**
  * @brief ngsDrawMap Starts drawing map in specified (in ngsInitMap) extent
  * @param mapId Map identifier received from create or open map functions
- * @param state Draw state (NORMAL, PRESERVED, REDRAW)
+ * @param state Draw state (NORMAL, PRESERVED, REDRAW, REFILL, RESTYLE,
+ * OVERLAY_ONLY)
  * @param callback Progress function (template is ngsProgressFunc) executed
  * periodically to report progress and cancel. If returns 1 the execution will
  * continue, 0 - cancelled. May be null.
@@ -2841,6 +3851,72 @@ int ngsMapDraw(char mapId, enum ngsDrawState state, ngsProgressFunc callback, vo
     return mapStore->drawMap(mapId, state, progress) ? COD_SUCCESS : COD_DRAW_FAILED;
 }
 
+/**
+ * @brief ngsMapDrawToBuffer Render map offscreen to caller memory, i.e. for
+ * thumbnails and map export. The Gl context (i.e. EGL pbuffer context) must be
+ * current in the calling thread. Tiles are filled by the fill pool in
+ * parallel, the call returns when all tiles are rendered.
+ * @param mapId Map identifier received from create or open map functions
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param rgbaBuffer Memory of width * height * 4 bytes for RGBA pixels, rows
+ * from top to bottom
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsMapDrawToBuffer(char mapId, int width, int height, void *rgbaBuffer,
+                       ngsProgressFunc callback, void *callbackData)
+{
+    MapStore * const mapStore = MapStore::instance();
+    if(nullptr == mapStore) {
+        return outMessage(COD_DRAW_FAILED, _("MapStore is not initialized"));
+    }
+    Progress progress(callback, callbackData);
+    return mapStore->drawMapToBuffer(mapId, width, height, rgbaBuffer,
+                                     progress) ? COD_SUCCESS : COD_DRAW_FAILED;
+}
+
+/**
+ * @brief ngsMapExport Render map extent to raster file of any size, i.e.
+ * 20000 x 20000 GeoTIFF. The map is rendered by tiles with
+ * ngsMapDrawToBuffer and tiles are written to the file in a worker thread, so
+ * memory use does not depend on the image size. The Gl context must be
+ * current in the calling thread.
+ * @param mapId Map identifier received from create or open map functions
+ * @param path File system path of the new raster
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param extent Map extent to export in map spatial reference
+ * @param options The options key-value array:
+ * DRIVER - GDAL raster driver name, default GTiff
+ * TILE_SIZE - size of rendered tile in pixels, default 2048
+ * Other options are passed to the driver as creation options (i.e.
+ * COMPRESS=DEFLATE). GeoTIFF is created tiled with multithreaded compression
+ * by default.
+ * @param callback Progress function (template is ngsProgressFunc) executed
+ * periodically to report progress and cancel. If returns 1 the execution will
+ * continue, 0 - cancelled. May be null.
+ * @param callbackData Progress function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsMapExport(char mapId, const char *path, int width, int height,
+                 ngsExtent extent, char **options, ngsProgressFunc callback,
+                 void *callbackData)
+{
+    MapStore * const mapStore = MapStore::instance();
+    if(nullptr == mapStore) {
+        return outMessage(COD_DRAW_FAILED, _("MapStore is not initialized"));
+    }
+    Progress progress(callback, callbackData);
+    Envelope env(extent.minX, extent.minY, extent.maxX, extent.maxY);
+    return mapStore->exportMap(mapId, fromCString(path), width, height, env,
+                               Options(options), progress) ?
+                COD_SUCCESS : COD_DRAW_FAILED;
+}
+
 int ngsMapInvalidate(char mapId, ngsExtent bounds)
 {
     MapStore * const mapStore = MapStore::instance();
@@ -2852,6 +3928,29 @@ int ngsMapInvalidate(char mapId, ngsExtent bounds)
     return COD_SUCCESS;
 }
 
+/**
+ * @brief ngsMapInvalidateLayer Invalidate only one layer data in bounds, i.e.
+ * after feature edit. Other layers data is not refilled if map keeps tile
+ * buffers. Tiles are drawn as before until the layer data is refilled.
+ * @param mapId Map identifier
+ * @param layer Layer handle get from ngsMapLayerGet() function.
+ * @param bounds Extent to invalidate
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsMapInvalidateLayer(char mapId, LayerH layer, ngsExtent bounds)
+{
+    MapStore * const mapStore = MapStore::instance();
+    if(nullptr == mapStore) {
+        return outMessage(COD_UPDATE_FAILED, _("MapStore is not initialized"));
+    }
+    if(nullptr == layer) {
+        return outMessage(COD_UPDATE_FAILED, _("Layer pointer is null"));
+    }
+    Envelope env(bounds.minX, bounds.minY, bounds.maxX, bounds.maxY);
+    return mapStore->invalidateMapLayer(mapId, static_cast<Layer*>(layer), env) ?
+                COD_SUCCESS : COD_UPDATE_FAILED;
+}
+
 /**
  * @brief ngsGetMapBackgroundColor Map background color
  * @param mapId Map identifier received from create or open map functions
@@ -3108,6 +4207,21 @@ int ngsMapLayerDelete(char mapId, LayerH layer)
  *   ZOOM_INCREMENT - Add integer value to zoom level correspondent to scale. May be negative
  *   VIEWPORT_REDUCE_FACTOR - Reduce view size on provided value. Make sense to
  *     reduce number of tiles in map extent. The tiles will be more pixelate
+ *   KEEP_TILE_BUFFERS - Keep layers GL buffers of rendered tiles. Uses more
+ *     GPU memory, but DS_RESTYLE redraws tiles without refill. Default NO
+ *   TEXTURE_UPLOADS_PER_FRAME - Maximum raster tile textures uploaded per one
+ *     draw call. The rest are uploaded in next draw calls. Default 0 - unlimited
+ *   TEXTURE_UPLOAD_TIME - Maximum time in milliseconds spent for raster tile
+ *     textures upload per one draw call. Default 0 - unlimited
+ *   BUFFER_UPLOAD_SIZE - Maximum vector tile buffers data in Kb uploaded per
+ *     one draw call. The rest are uploaded in next draw calls. Default 0 -
+ *     unlimited
+ *   PREFETCH_TILES - Fill layers data of tiles around the extent and of the
+ *     next and previous zoom levels while map is idle. Default YES
+ *   PREFETCH_MEMORY_LIMIT - GL memory in Mb above which prefetched data is
+ *     freed and prefetch is stopped. Default 128, 0 - unlimited
+ *   TILE_MEMORY_LIMIT - GL memory in Mb above which least recently drawn
+ *     tiles and kept tile buffers are freed after draw. Default 0 - unlimited
  * @return ngsCode value - COD_SUCCESS if everything is OK
  */
 int ngsMapSetOptions(char mapId, char **options)
@@ -3120,6 +4234,23 @@ int ngsMapSetOptions(char mapId, char **options)
     return mapStore->setOptions(mapId, mapOptions) ? COD_SUCCESS : COD_SET_FAILED;
 }
 
+/**
+ * @brief ngsMapGetRenderStats Renderer counters of the last ngsMapDraw call,
+ * tiles state of current extent and GPU memory estimate. Use to tune styles
+ * and tile budgets on real devices.
+ * @param mapId Map identifier
+ * @return ngsRenderStats struct. All values are zero if map not exists
+ */
+ngsRenderStats ngsMapGetRenderStats(char mapId)
+{
+    MapStore * const mapStore = MapStore::instance();
+    if(nullptr == mapStore) {
+        errorMessage(_("MapStore is not initialized"));
+        return {0, 0, 0, 0, 0, 0.0, 0.0, 0.0, 0, 0};
+    }
+    return mapStore->getMapRenderStats(mapId);
+}
+
 /**
  * @brief ngsMapSetExtentLimits Set limits to prevent pan out of them.
  * @param mapId Map identifier
@@ -3158,21 +4289,19 @@ ngsExtent ngsMapGetExtent(char mapId, int epsg)
             return {env.minX(), env.minY(), env.maxX(), env.maxY()};
         }
 
-        SpatialReferencePtr from = SpatialReferencePtr::importFromEPSG(fromEPSG);
-        if(from == nullptr) {
+        TransformationCache &cache = TransformationCache::instance();
+        if(cache.spatialReference(fromEPSG) == nullptr) {
             errorMessage(_("Unsupported from EPSG with code %d"), fromEPSG);
             return {0.0, 0.0, 0.0, 0.0};
         }
 
-        SpatialReferencePtr to = SpatialReferencePtr::importFromEPSG(epsg);
-        if(to == nullptr) {
+        if(cache.spatialReference(epsg) == nullptr) {
             errorMessage(_("Unsupported from EPSG with code %d"), epsg);
             return {0.0, 0.0, 0.0, 0.0};
         }
 
-        OGRCoordinateTransformation* ct =
-                OGRCreateCoordinateTransformation(from, to);
-        if(nullptr != ct) {
+        CachedTransformation ct(fromEPSG, epsg);
+        if(ct) {
             double x[4], y[4];
             x[0] = env.minX();
             y[0] = env.minY();
@@ -3182,7 +4311,7 @@ ngsExtent ngsMapGetExtent(char mapId, int epsg)
             y[2] = env.maxY();
             x[3] = env.maxX();
             y[3] = env.minY();
-            ct->Transform(4, x, y, nullptr);
+            ct->transform(4, x, y);
 
             ngsExtent out = {100000000.0, 100000000.0, -100000000.0, -100000000.0};
             for(int i = 0; i < 4; ++i) {
@@ -3330,6 +4459,49 @@ char ngsMapIconSetExists(char mapId, const char *name)
     return mapView->hasIconSet(fromCString(name));
 }
 
+/**
+ * @brief ngsMapIdentify Find features of visible vector layers under the
+ * display point without blocking the caller. Features are searched in the
+ * already loaded tiles, exact geometry is read only for the features which
+ * tile envelopes partially overlap the search area.
+ * @param mapId Map identifier
+ * @param x Display X coordinate
+ * @param y Display Y coordinate
+ * @param tolerance Search radius in display pixels
+ * @param callback Function executed from the library worker thread with
+ * results. Hidden features are excluded.
+ * @param callbackArguments Callback function parameter. May be null.
+ * @return ngsCode value - COD_SUCCESS if identify started, or error code
+ */
+int ngsMapIdentify(char mapId, double x, double y, double tolerance,
+                   ngsIdentifyFunc callback, void *callbackArguments)
+{
+    if(nullptr == callback) {
+        return outMessage(COD_INVALID, _("Callback is not set"));
+    }
+    MapStore * const mapStore = MapStore::instance();
+    if(nullptr == mapStore) {
+        return outMessage(COD_GET_FAILED, _("MapStore is not initialized"));
+    }
+
+    bool started = mapStore->identifyMap(mapId, x, y, tolerance,
+        [callback, callbackArguments](const std::vector<IdentifyResult> &results) {
+            std::vector<std::vector<long long>> ids;
+            std::vector<ngsIdentifyResult> out;
+            ids.reserve(results.size());
+            out.reserve(results.size());
+            for(const IdentifyResult &result : results) {
+                ids.push_back(std::vector<long long>(result.ids.begin(),
+                                                     result.ids.end()));
+                out.push_back({result.layer.get(), ids.back().data(),
+                               static_cast<int>(ids.back().size())});
+            }
+            callback(out.data(), static_cast<int>(out.size()),
+                     callbackArguments);
+        });
+    return started ? COD_SUCCESS : COD_GET_FAILED;
+}
+
 //------------------------------------------------------------------------------
 // Layer
 //------------------------------------------------------------------------------
@@ -3447,6 +4619,36 @@ int ngsLayerSetMinZoom(LayerH layer, float zoom)
     return COD_SUCCESS;
 }
 
+/**
+ * @brief ngsLayerGetOpacity Returns layer opacity
+ * @param layer Layer handle
+ * @return opacity from 0 to 1
+ */
+float ngsLayerGetOpacity(LayerH layer)
+{
+    if(nullptr == layer) {
+        return errorMessage(_("Layer pointer is null"));
+    }
+    return static_cast<Layer*>(layer)->opacity();
+}
+
+/**
+ * @brief ngsLayerSetOpacity Sets layer opacity. Semi-transparent layer is drawn
+ * off-screen and composed to tiles at once, so overlapped items are not
+ * blended with each other. Draw map with DS_RESTYLE state to apply.
+ * @param layer Layer handle
+ * @param opacity Opacity from 0 to 1
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsLayerSetOpacity(LayerH layer, float opacity)
+{
+    if(nullptr == layer) {
+        return outMessage(COD_SET_FAILED, _("Layer pointer is null"));
+    }
+    static_cast<Layer*>(layer)->setOpacity(opacity);
+    return COD_SUCCESS;
+}
+
 /**
  * @brief ngsLayerGetDataSource Layer datasource
  * @param layer Layer handle
@@ -3527,6 +4729,38 @@ int ngsLayerSetStyleName(LayerH layer, const char *name)
     return renderLayerPtr->setStyleName(fromCString(name)) ? COD_SUCCESS : COD_SET_FAILED;
 }
 
+/**
+ * @brief ngsLayerGetFillLatency Layer tile fill latency percentile of last
+ * fills
+ * @param layer Layer handle
+ * @param percentile Percentile value in range 0 - 100
+ * @return Latency in milliseconds or 0 if no tiles filled yet
+ */
+double ngsLayerGetFillLatency(LayerH layer, double percentile)
+{
+    if(nullptr == layer) {
+        errorMessage(_("Layer pointer is null"));
+        return 0.0;
+    }
+
+    Layer *layerPtr = static_cast<Layer*>(layer);
+    IRenderLayer *renderLayerPtr = dynamic_cast<IRenderLayer*>(layerPtr);
+    if(nullptr == renderLayerPtr) {
+        errorMessage(_("Layer type is unsupported. Mast be GlRenderLayer"));
+        return 0.0;
+    }
+
+    return renderLayerPtr->fillLatency(percentile);
+}
+
+/**
+ * @brief ngsLayerSetSelectionIds Set layer selected feature ids
+ * @param layer Layer handle
+ * @param ids Feature ids array. Ascending sorted array without duplicates is
+ * used as is, otherwise it is sorted
+ * @param size Feature ids array size
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
 int ngsLayerSetSelectionIds(LayerH layer, long long *ids, int size)
 {
     if(nullptr == layer) {
@@ -3539,14 +4773,19 @@ int ngsLayerSetSelectionIds(LayerH layer, long long *ids, int size)
         return outMessage(COD_UNSUPPORTED, _("Layer type is unsupported. Mast be GlFeatureLayer"));
     }
 
-    std::set<GIntBig> selectIds;
-    for(int i = 0; i < size; ++i) {
-        selectIds.insert(ids[i]);
-    }
-    renderLayerPtr->setSelectedIds(selectIds);
+    // Pre-sorted ids are copied as is
+    renderLayerPtr->setSelectedIds(FeatureIDs(ids, ids + std::max(size, 0)));
     return COD_SUCCESS;
 }
 
+/**
+ * @brief ngsLayerSetHideIds Set layer hidden feature ids
+ * @param layer Layer handle
+ * @param ids Feature ids array. Ascending sorted array without duplicates is
+ * used as is, otherwise it is sorted
+ * @param size Feature ids array size
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
 int ngsLayerSetHideIds(LayerH layer, long long *ids, int size)
 {
     if(nullptr == layer) {
@@ -3558,14 +4797,106 @@ int ngsLayerSetHideIds(LayerH layer, long long *ids, int size)
         return outMessage(COD_UNSUPPORTED, _("Layer type is unsupported. Mast be ISelectableFeatureLayer"));
     }
 
-    std::set<GIntBig> hideIds;
-    for(int i = 0; i < size; ++i) {
-        hideIds.insert(ids[i]);
+    renderLayerPtr->setHideIds(FeatureIDs(ids, ids + std::max(size, 0)));
+    return COD_SUCCESS;
+}
+
+/**
+ * @brief ngsLayerGetSnapping Get if edited geometry snaps to layer features
+ * @param layer Layer handle
+ * @return 1 if snapping is on, otherwise 0
+ */
+char ngsLayerGetSnapping(LayerH layer)
+{
+    if(nullptr == layer) {
+        return errorMessage(_("Layer pointer is null"));
     }
-    renderLayerPtr->setHideIds(hideIds);
+    FeatureLayer *featureLayer = dynamic_cast<FeatureLayer*>(
+                static_cast<Layer*>(layer));
+    if(nullptr == featureLayer) {
+        return API_FALSE;
+    }
+    return featureLayer->snapping() ? API_TRUE : API_FALSE;
+}
+
+/**
+ * @brief ngsLayerSetSnapping Set if edited geometry snaps to layer features.
+ * Layer caches vertices and segments of tiles on fill, so the map layer should
+ * be invalidated after snapping turned on.
+ * @param layer Layer handle
+ * @param enable 1 to turn snapping on, 0 to turn off
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsLayerSetSnapping(LayerH layer, char enable)
+{
+    if(nullptr == layer) {
+        return outMessage(COD_SET_FAILED, _("Layer pointer is null"));
+    }
+    FeatureLayer *featureLayer = dynamic_cast<FeatureLayer*>(
+                static_cast<Layer*>(layer));
+    if(nullptr == featureLayer) {
+        return outMessage(COD_UNSUPPORTED, _("Layer type is unsupported. Mast be FeatureLayer"));
+    }
+    featureLayer->setSnapping(enable == 1);
     return COD_SUCCESS;
 }
 
+/**
+ * @brief ngsLayerGetLabelStyle Get layer label style
+ * @param layer Layer handle
+ * @return Label style with the label field or invalid json object if labels
+ * are off. User must free returned value via ngsJsonObjectFree.
+ */
+JsonObjectH ngsLayerGetLabelStyle(LayerH layer)
+{
+    if(nullptr == layer) {
+        errorMessage(_("Layer pointer is null"));
+        return nullptr;
+    }
+
+    FeatureLayer *featureLayer = dynamic_cast<FeatureLayer*>(
+                static_cast<Layer*>(layer));
+    if(nullptr == featureLayer) {
+        errorMessage(_("Layer type is unsupported. Mast be FeatureLayer"));
+        return nullptr;
+    }
+
+    return new CPLJSONObject(featureLayer->labelStyle());
+}
+
+/**
+ * @brief ngsLayerSetLabelStyle Set layer label field and style. Labels are
+ * generated on tile fill, so the map layer should be invalidated after.
+ * @param layer Layer handle
+ * @param style Label style. Keys are:
+ *  field - label field name, empty to turn labels off
+ *  font - icon set name of the signed distance field glyph atlas
+ *  glyph_width, glyph_height - atlas glyph size in pixels
+ *  first_glyph - code point of the first atlas glyph
+ *  size - label height in pixels
+ *  color - label color in hex
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsLayerSetLabelStyle(LayerH layer, JsonObjectH style)
+{
+    if(nullptr == layer) {
+        return outMessage(COD_SET_FAILED, _("Layer pointer is null"));
+    }
+    if(nullptr == style) {
+        return outMessage(COD_SET_FAILED, _("Style pointer is null"));
+    }
+
+    FeatureLayer *featureLayer = dynamic_cast<FeatureLayer*>(
+                static_cast<Layer*>(layer));
+    if(nullptr == featureLayer) {
+        return outMessage(COD_UNSUPPORTED, _("Layer type is unsupported. Mast be FeatureLayer"));
+    }
+
+    CPLJSONObject *gdalJsonObject = static_cast<CPLJSONObject*>(style);
+    return featureLayer->setLabelStyle(*gdalJsonObject) ? COD_SUCCESS :
+                                                          COD_SET_FAILED;
+}
+
 //------------------------------------------------------------------------------
 // Overlay
 //------------------------------------------------------------------------------
@@ -3623,6 +4954,7 @@ char ngsOverlayGetVisible(char mapId, enum ngsMapOverlayType type)
  * @param options Key=Value list of options.
  *  Available options for edit overlay are:
  *   CROSS - ON/OFF, show or hide a cross in the map center
+ *   SNAP - ON/OFF, snap dragged points to features of layers with snapping on
  * @return ngsCode value - COD_SUCCESS if everything is OK
  */
 int ngsOverlaySetOptions(char mapId, enum ngsMapOverlayType type, char **options)
@@ -3945,6 +5277,15 @@ JsonObjectH ngsEditOverlayGetStyle(char mapId, enum ngsEditStyleType type)
     return new CPLJSONObject(overlay->style(type));
 }
 
+/**
+ * @brief ngsLocationOverlayUpdate Move location marker. Draw the map with
+ * DS_OVERLAY_ONLY state after update, so tiles are not redrawn.
+ * @param mapId Map identifier
+ * @param location Location in map coordinates
+ * @param direction Move direction in degrees or -1 if not moving
+ * @param accuracy Location accuracy in meters
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
 int ngsLocationOverlayUpdate(char mapId, ngsCoordinate location, float direction,
                              float accuracy)
 {
@@ -4013,8 +5354,6 @@ JsonObjectH ngsLocationOverlayGetStyle(char mapId)
 //    return gMapStore->getDisplayLength (mapId, w, h);
 //}
 
-constexpr const char *qmsAPIURL = "https://qms.nextgis.com/api/v1/";
-
 static enum ngsCode qmsStatusToCode(const std::string &status)
 {
     if(status.empty()) {
@@ -4080,7 +5419,9 @@ static ngsExtent qmsExtentToStruct(const std::string &extent)
 }
 
 /**
- * @brief ngsQMSQuery Query QuickMapServices for specific geoservices
+ * @brief ngsQMSQuery Query QuickMapServices for specific geoservices. The
+ * geoservices list is cached on disk and revalidated not often than once an
+ * hour, so the query works offline.
  * @param options key-value list. All keys are optional. Available keys are:
  *  type - services type. May be tms, wms, wfs, geojson
  *  epsg - services spatial reference EPSG code
@@ -4097,103 +5438,20 @@ static ngsExtent qmsExtentToStruct(const std::string &extent)
 ngsQMSItem *ngsQMSQuery(char **options)
 {
     Options opt(options);
-    std::string url(qmsAPIURL);
-    url.append("geoservices/");
-    bool firstParam = true;
-
-    std::string val = opt.asString("type");
-    if(!val.empty()) {
-        url.append("?type=" + val);
-        firstParam = false;
-    }
-
-    val = opt.asString("epsg");
-    if(!val.empty()) {
-        if(firstParam) {
-            url.append("?epsg=" + val);
-            firstParam = false;
-        }
-        else {
-            url.append("&epsg=" + val);
-        }
-    }
-
-    val = opt.asString("cumulative_status");
-    if(!val.empty()) {
-        if(firstParam) {
-            url.append("?cumulative_status=" + val);
-            firstParam = false;
-        }
-        else {
-            url.append("&cumulative_status=" + val);
-        }
-    }
-
-    val = opt.asString("search");
-    if(!val.empty()) {
-        if(firstParam) {
-            url.append("?search=" + val);
-            firstParam = false;
-        }
-        else {
-            url.append("&search=" + val);
-        }
-    }
-
-    val = opt.asString("intersects_extent");
-    if(!val.empty()) {
-        if(firstParam) {
-            url.append("?intersects_extent=" + val);
-            firstParam = false;
-        }
-        else {
-            url.append("&intersects_extent=" + val);
-        }
-    }
-
-    val = opt.asString("ordering");
-    if(!val.empty()) {
-        if(firstParam) {
-            url.append("?ordering=" + val);
-            firstParam = false;
-        }
-        else {
-            url.append("&ordering=" + val);
-        }
-    }
-
-    val = opt.asString("limit", "20");
-    if(firstParam) {
-        url.append("?limit=" + val);
-        firstParam = false;
-    }
-    else {
-        url.append("&limit=" + val);
-    }
-
-    val = opt.asString("offset", "0");
-    if(firstParam) {
-        url.append("?offset=" + val);
-    }
-    else {
-        url.append("&offset=" + val);
-    }
-
     ngsExtent ext = {0.0, 0.0, 0.0, 0.0};
     ngsQMSItem *out = nullptr;
-    CPLJSONObject root = http::fetchJson(url);
-    if(root.IsValid()) {
-        clearCStrings();
-        int count = root.GetInteger("count");
-        CPLJSONArray services = root.GetArray("results");
-        size_t size = static_cast<size_t>(services.Size() + 1);
+    std::vector<CPLJSONObject> services;
+    int count = 0;
+    if(QMSCatalog::instance().query(opt, services, count)) {
+        CStringsHolder holder;
+        size_t size = services.size() + 1;
         out = static_cast<ngsQMSItem*>(CPLMalloc(sizeof(ngsQMSItem) * size));
-        for(int i = 0; i < services.Size(); ++i) {
-            CPLJSONObject service = services[i];
+        for(size_t i = 0; i < services.size(); ++i) {
+            const CPLJSONObject &service = services[i];
             int iconId = service.GetInteger("icon", -1);
             std::string iconUrl;
             if(iconId != -1) {
-                iconUrl = storeCString(std::string(qmsAPIURL) + "icons/" +
+                iconUrl = storeCString(std::string(QMS_API_URL) + "icons/" +
                                        std::to_string(iconId) + "/content");
             }
 
@@ -4202,14 +5460,15 @@ ngsQMSItem *ngsQMSQuery(char **options)
                        storeCString(service.GetString("desc")),
                        qmsTypeToCode(service.GetString("type")),
                        storeCString(iconUrl),
-                       qmsStatusToCode(service.GetString("status")),
+                       qmsStatusToCode(service.GetString("status",
+                                service.GetString("cumulative_status"))),
                        qmsExtentToStruct(service.GetString("extent")),
                        count
                      };
 
         }
 
-        out[services.Size()] = {-1, "", "", CAT_UNKNOWN, "", COD_REQUEST_FAILED,
+        out[services.size()] = {-1, "", "", CAT_UNKNOWN, "", COD_REQUEST_FAILED,
                 ext, -1};
     }
     else {
@@ -4221,7 +5480,8 @@ ngsQMSItem *ngsQMSQuery(char **options)
 }
 
 /**
- * @brief ngsQMSQueryProperties Get QuickMapServices geoservice details
+ * @brief ngsQMSQueryProperties Get QuickMapServices geoservice details. The
+ * details are cached on disk the same way as the geoservices list.
  * @param itemId QuickMapServices geoservice identifier
  * @return struct of type ngsQMSItemProperties
  */
@@ -4229,10 +5489,9 @@ ngsQMSItemProperties ngsQMSQueryProperties(int itemId)
 {
     ngsQMSItemProperties out = {-1, COD_REQUEST_FAILED, "", "", "", CAT_UNKNOWN,
                                 -1, -1, -1, "", {0.0, 0.0, 0.0, 0.0}, 0};
-    CPLJSONObject root = http::fetchJson(std::string(qmsAPIURL) + "geoservices/" +
-                                         std::to_string(itemId));
+    CPLJSONObject root = QMSCatalog::instance().properties(itemId);
     if(root.IsValid()) {
-        clearCStrings();
+        CStringsHolder holder;
 
         out.id = itemId;
         out.status = qmsStatusToCode(root.GetString("cumulative_status", "failed"));
@@ -4245,7 +5504,7 @@ ngsQMSItemProperties ngsQMSQueryProperties(int itemId)
         out.z_max = root.GetInteger("z_max", 20);
         int iconId = root.GetInteger("icon", -1);
         if(iconId != -1) {
-            out.iconUrl = storeCString(std::string(qmsAPIURL) + "icons/" +
+            out.iconUrl = storeCString(std::string(QMS_API_URL) + "icons/" +
                                        std::to_string(iconId) + "/content");
         }
         out.y_origin_top = root.GetBool("y_origin_top");
@@ -4465,6 +5724,7 @@ ngsTrackInfo *ngsTrackGetList(CatalogObjectH tracksTable)
     ngsTrackInfo *outList = static_cast<ngsTrackInfo*>(
             CPLMalloc((list.size() + 1) * sizeof(ngsTrackInfo)));
 
+    CStringsHolder holder;
     int count = 0;
     for(const auto &listItem : list) {
         outList[count++] = {storeCString(listItem.name), listItem.startTimeStamp, listItem.stopTimeStamp, listItem.count};
@@ -4630,7 +5890,7 @@ ngsNGWServiceLayerInfo *ngsNGWServiceList(CatalogObjectH object)
     ngsNGWServiceLayerInfo *output =
             static_cast<ngsNGWServiceLayerInfo*>(
                 CPLMalloc(sizeof(ngsNGWServiceLayerInfo) * (outputSize + 1)));
-    clearCStrings();
+    CStringsHolder holder;
 
     for(size_t i = 0; i < outputSize; ++i) {
         const auto &layer = layers[i];
@@ -26,6 +26,9 @@
 #include "cpl_string.h"
 
 // std
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <vector>
 
 // project
@@ -40,30 +43,49 @@
 constexpr jboolean NGS_JNI_TRUE = JNI_TRUE;
 constexpr jboolean NGS_JNI_FALSE = JNI_FALSE;
 static JavaVM *g_vm;
+static bool g_classesLoaded = false;
+
+// Strings shorter than this are copied to stack without JVM allocation
+constexpr jsize JNI_STRING_BUFFER_SIZE = 256;
 
 class jniString
 {
 public:
-    jniString(JNIEnv *env, jstring str) : m_env(env), m_original(str) {
-        jboolean isCopy;
-        m_native = env->GetStringUTFChars(str, &isCopy);
+    jniString(JNIEnv *env, jstring str) : m_env(env), m_original(str),
+        m_native(nullptr) {
+        m_buffer[0] = '\0';
+        if(nullptr == str) {
+            return;
+        }
+        jsize size = env->GetStringUTFLength(str);
+        if(size < JNI_STRING_BUFFER_SIZE) {
+            env->GetStringUTFRegion(str, 0, env->GetStringLength(str), m_buffer);
+            m_buffer[size] = '\0';
+        }
+        else {
+            m_native = env->GetStringUTFChars(str, nullptr);
+        }
     }
 
     ~jniString() {
-        m_env->ReleaseStringUTFChars(m_original, m_native);
+        if(nullptr != m_native) {
+            m_env->ReleaseStringUTFChars(m_original, m_native);
+        }
     }
 
-    const char *c_str() const { return m_native; }
+    const char *c_str() const { return nullptr == m_native ? m_buffer : m_native; }
 
 private:
     JNIEnv *m_env;
-    const char *m_native;
     jstring m_original;
+    const char *m_native;
+    char m_buffer[JNI_STRING_BUFFER_SIZE];
 };
 
 static jclass g_APIClass;
 static jmethodID g_NotifyMid;
 static jmethodID g_ProgressMid;
+static jmethodID g_RequestCompleteMid;
 static jclass g_StringClass;
 static jclass g_EnvelopeClass;
 static jmethodID g_EnvelopeInitMid;
@@ -159,6 +181,44 @@ static int progressProxyFunc(enum ngsCode status, double complete,
     return res;
 }
 
+static void requestProxyFunc(ngsURLRequestResult *result,
+                             void *callbackArguments)
+{
+    JNIEnv *g_env;
+    JavaVMAttachArgs args;
+    args.version = JNI_VERSION_1_6;
+    args.name = "CPPJava";
+    args.group = nullptr;
+
+    int getEnvStat = g_vm->GetEnv((void **)&g_env, args.version);
+    bool isMainThread = true;
+    if(getEnvStat == JNI_EDETACHED) {
+        if(g_vm->AttachCurrentThread(&g_env, &args) != 0) {
+            ngsURLRequestResultFree(result);
+            return;
+        }
+        isMainThread = false;
+    }
+
+    jbyteArray barray = g_env->NewByteArray(result->dataLen);
+    g_env->SetByteArrayRegion(barray, 0, result->dataLen,
+                              reinterpret_cast<const jbyte *>(result->data));
+    auto callbackArgumentsDigit = reinterpret_cast<long long>(callbackArguments);
+    g_env->CallStaticVoidMethod(g_APIClass, g_RequestCompleteMid,
+                                static_cast<jint>(callbackArgumentsDigit),
+                                result->status, barray);
+    g_env->DeleteLocalRef(barray);
+    ngsURLRequestResultFree(result);
+
+    if (g_env->ExceptionCheck()) {
+        g_env->ExceptionDescribe();
+    }
+
+    if(!isMainThread) {
+        g_vm->DetachCurrentThread();
+    }
+}
+
 static char **toOptions(JNIEnv *env, jobjectArray optionsArray)
 {
     int count = env->GetArrayLength(optionsArray);
@@ -174,9 +234,11 @@ static char **toOptions(JNIEnv *env, jobjectArray optionsArray)
 static jobjectArray fromOptions(JNIEnv *env, CSLConstList options)
 {
     int count = CSLCount(options);
-    jobjectArray result = env->NewObjectArray(count, g_StringClass, env->NewStringUTF(""));
+    jobjectArray result = env->NewObjectArray(count, g_StringClass, nullptr);
     for(int i = 0; i < count; ++i) {
-        env->SetObjectArrayElement(result, i, env->NewStringUTF(options[i]));
+        jstring option = env->NewStringUTF(options[i]);
+        env->SetObjectArrayElement(result, i, option);
+        env->DeleteLocalRef(option);
     }
     return result;
 }
@@ -196,46 +258,31 @@ NGS_JNI_FUNC(jstring, getVersionString)(JNIEnv *env, jobject thisObj, jstring re
 
 NGS_JNI_FUNC(void, unInit)(JNIEnv *env, jobject thisObj)
 {
+    ngsUnused(env);
     ngsUnused(thisObj);
     ngsUnInit();
-
-    env->DeleteGlobalRef(g_APIClass);
-    env->DeleteGlobalRef(g_StringClass);
-    env->DeleteGlobalRef(g_PointClass);
-    env->DeleteGlobalRef(g_EnvelopeClass);
-    env->DeleteGlobalRef(g_CatalogObjectInfoClass);
-    env->DeleteGlobalRef(g_FieldClass);
-    env->DeleteGlobalRef(g_EditOperationClass);
-    env->DeleteGlobalRef(g_RequestResultClass);
-    env->DeleteGlobalRef(g_RequestResultJsonClass);
-    env->DeleteGlobalRef(g_RequestResultRawClass);
-    env->DeleteGlobalRef(g_AttachmentClass);
-    env->DeleteGlobalRef(g_RGBAClass);
-    env->DeleteGlobalRef(g_TouchResultClass);
-    env->DeleteGlobalRef(g_QMSItemClass);
-    env->DeleteGlobalRef(g_QMSItemPropertiesClass);
-    env->DeleteGlobalRef(g_TrackInfoClass);
 }
 
 static bool getClassInitMethod(JNIEnv *env, const char *className, const char *signature,
                                jclass &classVar, jmethodID &methodVar)
 {
     jclass clazz = env->FindClass(className);
+    if(nullptr == clazz) {
+        return false;
+    }
     classVar = reinterpret_cast<jclass>(env->NewGlobalRef(clazz));
+    env->DeleteLocalRef(clazz);
     methodVar = env->GetMethodID(classVar, "<init>", signature);
 
     return methodVar != nullptr;
 }
 
-NGS_JNI_FUNC(jboolean, init)(JNIEnv *env, jobject thisObj, jobjectArray optionsArray)
+/**
+ * @brief loadJavaClasses Find classes and methods used by bindings once on
+ * library load, so the calls do not look them up.
+ */
+static bool loadJavaClasses(JNIEnv *env)
 {
-    ngsUnused(thisObj);
-    env->GetJavaVM(&g_vm);
-
-    char **nativeOptions = toOptions(env, optionsArray);
-    int result = ngsInit(nativeOptions);
-    CSLDestroy(nativeOptions);
-
     jclass clazz = env->FindClass("com/nextgis/maplib/API");
     g_APIClass = reinterpret_cast<jclass>(env->NewGlobalRef(clazz));
 
@@ -245,72 +292,142 @@ NGS_JNI_FUNC(jboolean, init)(JNIEnv *env, jobject thisObj, jobjectArray optionsA
     // register callback function: notify
     g_NotifyMid = env->GetStaticMethodID(g_APIClass, "notifyBridgeFunction", "(Ljava/lang/String;I)V");
     if(g_NotifyMid == nullptr) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     // register callback function: progress
     g_ProgressMid = env->GetStaticMethodID(g_APIClass, "progressBridgeFunction", "(IDLjava/lang/String;I)I");
     if(g_ProgressMid == nullptr) {
-        return NGS_JNI_FALSE;
+        return false;
+    }
+
+    // register callback function: asynchronous request complete. Optional,
+    // without it URLRequestAsync is not available.
+    g_RequestCompleteMid = env->GetStaticMethodID(g_APIClass, "requestBridgeFunction", "(II[B)V");
+    if(g_RequestCompleteMid == nullptr) {
+        env->ExceptionClear();
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/Point", "(DD)V", g_PointClass, g_PointInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/Envelope", "(DDDD)V", g_EnvelopeClass, g_EnvelopeInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/CatalogObjectInfo", "(Ljava/lang/String;IJ)V", g_CatalogObjectInfoClass, g_CatalogObjectInfoInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/Field", "(Ljava/lang/String;Ljava/lang/String;ILjava/lang/String;)V", g_FieldClass, g_FieldInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/DateComponents", "(IIIIIII)V", g_DateComponentsClass, g_DateComponentsInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/EditOperation", "(JJJJI)V", g_EditOperationClass, g_EditOperationInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/RequestResult", "(ILjava/lang/String;)V", g_RequestResultClass, g_RequestResultInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/RequestResultJsonInt", "(IJ)V", g_RequestResultJsonClass, g_RequestResultJsonInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/RequestResultRaw", "(I[B)V", g_RequestResultRawClass, g_RequestResultRawInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/Attachment", "(JJLjava/lang/String;Ljava/lang/String;Ljava/lang/String;JJ)V", g_AttachmentClass, g_AttachmentInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/RGBA", "(IIII)V", g_RGBAClass, g_RGBAInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/TouchResult", "(IZ)V", g_TouchResultClass, g_TouchResultInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/QMSItemInt", "(ILjava/lang/String;Ljava/lang/String;ILjava/lang/String;ILcom/nextgis/maplib/Envelope;I)V", g_QMSItemClass, g_QMSItemInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/QMSItemPropertiesInt", "(IILjava/lang/String;Ljava/lang/String;Ljava/lang/String;IIIILjava/lang/String;Lcom/nextgis/maplib/Envelope;Z)V", g_QMSItemPropertiesClass, g_QMSItemPropertiesInitMid)) {
-        return NGS_JNI_FALSE;
+        return false;
     }
 
     if(!getClassInitMethod(env, "com/nextgis/maplib/TrackInfoInt", "(Ljava/lang/String;JJJ)V", g_TrackInfoClass, g_TrackInfoInitMid)) {
+        return false;
+    }
+
+    return true;
+}
+
+static void unloadJavaClasses(JNIEnv *env)
+{
+    env->DeleteGlobalRef(g_APIClass);
+    env->DeleteGlobalRef(g_StringClass);
+    env->DeleteGlobalRef(g_PointClass);
+    env->DeleteGlobalRef(g_EnvelopeClass);
+    env->DeleteGlobalRef(g_CatalogObjectInfoClass);
+    env->DeleteGlobalRef(g_FieldClass);
+    env->DeleteGlobalRef(g_DateComponentsClass);
+    env->DeleteGlobalRef(g_EditOperationClass);
+    env->DeleteGlobalRef(g_RequestResultClass);
+    env->DeleteGlobalRef(g_RequestResultJsonClass);
+    env->DeleteGlobalRef(g_RequestResultRawClass);
+    env->DeleteGlobalRef(g_AttachmentClass);
+    env->DeleteGlobalRef(g_RGBAClass);
+    env->DeleteGlobalRef(g_TouchResultClass);
+    env->DeleteGlobalRef(g_QMSItemClass);
+    env->DeleteGlobalRef(g_QMSItemPropertiesClass);
+    env->DeleteGlobalRef(g_TrackInfoClass);
+}
+
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved)
+{
+    ngsUnused(reserved);
+    g_vm = vm;
+    JNIEnv *env;
+    if(vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    g_classesLoaded = loadJavaClasses(env);
+    if(!g_classesLoaded) {
+        // init() reports failure, library is still loaded
+        env->ExceptionClear();
+        unloadJavaClasses(env);
+    }
+    return JNI_VERSION_1_6;
+}
+
+extern "C" JNIEXPORT void JNICALL JNI_OnUnload(JavaVM *vm, void *reserved)
+{
+    ngsUnused(reserved);
+    JNIEnv *env;
+    if(g_classesLoaded &&
+            vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        unloadJavaClasses(env);
+        g_classesLoaded = false;
+    }
+}
+
+NGS_JNI_FUNC(jboolean, init)(JNIEnv *env, jobject thisObj, jobjectArray optionsArray)
+{
+    ngsUnused(thisObj);
+    char **nativeOptions = toOptions(env, optionsArray);
+    int result = ngsInit(nativeOptions);
+    CSLDestroy(nativeOptions);
+
+    if(!g_classesLoaded) {
         return NGS_JNI_FALSE;
     }
 
@@ -324,12 +441,49 @@ NGS_JNI_FUNC(void, freeResources)(JNIEnv *env, jobject thisObj, jboolean full)
     ngsFreeResources(static_cast<char>(full ? 1 : 0));
 }
 
+NGS_JNI_FUNC(void, onMemoryPressure)(JNIEnv *env, jobject thisObj, jint level)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    ngsOnMemoryPressure(static_cast<enum ngsMemoryPressure>(level));
+}
+
+NGS_JNI_FUNC(jlong, getMemoryUsage)(JNIEnv *env, jobject thisObj)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return ngsGetMemoryUsage();
+}
+
 NGS_JNI_FUNC(jstring, getLastErrorMessage)(JNIEnv *env, jobject thisObj)
 {
     ngsUnused(thisObj);
     return env->NewStringUTF(ngsGetLastErrorMessage());
 }
 
+NGS_JNI_FUNC(jlong, getErrorCount)(JNIEnv *env, jobject thisObj, jint code)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return static_cast<jlong>(ngsGetErrorCount(static_cast<enum ngsCode>(code)));
+}
+
+NGS_JNI_FUNC(void, traceEnable)(JNIEnv *env, jobject thisObj, jboolean enable)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    ngsTraceEnable(static_cast<char>(enable ? 1 : 0));
+}
+
+NGS_JNI_FUNC(jboolean, traceSave)(JNIEnv *env, jobject thisObj, jstring path,
+                                  jboolean clear)
+{
+    ngsUnused(thisObj);
+    return ngsTraceSave(jniString(env, path).c_str(),
+                        static_cast<char>(clear ? 1 : 0)) == COD_SUCCESS ?
+                NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
 NGS_JNI_FUNC(jstring, settingsGetString)(JNIEnv *env, jobject thisObj, jstring key, jstring defaultVal)
 {
     ngsUnused(thisObj);
@@ -414,9 +568,9 @@ NGS_JNI_FUNC(jobject, URLRequest)(JNIEnv *env, jobject thisObj, jint type, jstri
                                reinterpret_cast<void *>(callbackId));
     }
     int status = result->status;
-    std::string value(reinterpret_cast<const char*>(result->data),
-                      static_cast<unsigned long>(result->dataLen));
-    jstring outStr = env->NewStringUTF(value.c_str());
+    // Response data is zero terminated by GDAL, no need to copy it
+    jstring outStr = env->NewStringUTF(nullptr == result->data ? "" :
+                                       reinterpret_cast<const char*>(result->data));
     ngsURLRequestResultFree(result);
 
     jvalue args[2];
@@ -480,6 +634,19 @@ NGS_JNI_FUNC(jobject, URLRequestRaw)(JNIEnv *env, jobject thisObj, jint type, js
     return env->NewObjectA(g_RequestResultRawClass, g_RequestResultRawInitMid, args);
 }
 
+NGS_JNI_FUNC(jboolean, URLRequestAsync)(JNIEnv *env, jobject thisObj, jint type, jstring url,
+        jobjectArray options, jint callbackId)
+{
+    ngsUnused(thisObj);
+    if(g_RequestCompleteMid == nullptr) {
+        return NGS_JNI_FALSE;
+    }
+    return ngsURLRequestAsync(static_cast<ngsURLRequestType>(type), jniString(env, url).c_str(),
+                              toOptions(env, options), requestProxyFunc,
+                              reinterpret_cast<void *>(callbackId)) == COD_SUCCESS ?
+                NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
 NGS_JNI_FUNC(jobject, URLUploadFile)(JNIEnv *env, jobject thisObj, jstring path, jstring url,
                                      jobjectArray options, jint callbackId)
 {
@@ -820,28 +987,76 @@ NGS_JNI_FUNC(jlong, catalogObjectGetByName)(JNIEnv *env, jobject thisObj, jlong
 
 static jobjectArray catalogObjectQueryToJobjectArray(JNIEnv *env, ngsCatalogObjectInfo *info)
 {
-    if(nullptr == info) {
-        return env->NewObjectArray(0, g_CatalogObjectInfoClass, nullptr);
+    int count = 0;
+    while(nullptr != info && info[count].name != nullptr) {
+        count++;
     }
 
-    std::vector<jobject> infoArray;
-    int counter = 0;
-    while(info[counter].name != nullptr) {
+    jobjectArray array = env->NewObjectArray(count, g_CatalogObjectInfoClass, nullptr);
+    for(int i = 0; i < count; ++i) {
         jvalue args[3];
-        args[0].l = env->NewStringUTF(info[counter].name);
-        args[1].i = info[counter].type;
-        args[2].j = reinterpret_cast<jlong>(info[counter].object);
+        args[0].l = env->NewStringUTF(info[i].name);
+        args[1].i = info[i].type;
+        args[2].j = reinterpret_cast<jlong>(info[i].object);
 
-        infoArray.push_back(env->NewObjectA(g_CatalogObjectInfoClass, g_CatalogObjectInfoInitMid, args));
-        counter++;
+        jobject item = env->NewObjectA(g_CatalogObjectInfoClass, g_CatalogObjectInfoInitMid, args);
+        env->SetObjectArrayElement(array, i, item);
+        // Large folders overflow local references table otherwise
+        env->DeleteLocalRef(item);
+        env->DeleteLocalRef(args[0].l);
     }
 
-    jobjectArray array = env->NewObjectArray(static_cast<jsize>(infoArray.size()), g_CatalogObjectInfoClass, nullptr);
-    for(int i = 0; i < infoArray.size(); ++i) {
-        env->SetObjectArrayElement(array, i, infoArray[i]);
+    return array;
+}
+
+/**
+ * @brief catalogObjectQueryToBuffer Pack query result into direct buffer in
+ * native byte order: items count (int), then for each item type (int), object
+ * handle (long), name size (int) and name UTF-8 bytes.
+ * @return Packed size in bytes. If it is greater than capacity nothing is
+ * written.
+ */
+static jint catalogObjectQueryToBuffer(JNIEnv *env, ngsCatalogObjectInfo *info,
+                                       jobject buffer)
+{
+    size_t size = sizeof(jint);
+    int count = 0;
+    while(nullptr != info && info[count].name != nullptr) {
+        size += sizeof(jint) + sizeof(jlong) + sizeof(jint) +
+                strlen(info[count].name);
+        count++;
+    }
+    if(size > INT_MAX) {
+        return -1;
     }
 
-    return array;
+    char *data = nullptr;
+    jlong capacity = 0;
+    if(nullptr != buffer) {
+        data = static_cast<char*>(env->GetDirectBufferAddress(buffer));
+        capacity = env->GetDirectBufferCapacity(buffer);
+    }
+    if(nullptr == data || capacity < static_cast<jlong>(size)) {
+        return static_cast<jint>(size);
+    }
+
+    auto put = [&data](const void *value, size_t valueSize) {
+        memcpy(data, value, valueSize);
+        data += valueSize;
+    };
+    jint value = count;
+    put(&value, sizeof(jint));
+    for(int i = 0; i < count; ++i) {
+        value = info[i].type;
+        put(&value, sizeof(jint));
+        jlong handle = reinterpret_cast<jlong>(info[i].object);
+        put(&handle, sizeof(jlong));
+        size_t nameSize = strlen(info[i].name);
+        value = static_cast<jint>(nameSize);
+        put(&value, sizeof(jint));
+        put(info[i].name, nameSize);
+    }
+    return static_cast<jint>(size);
 }
 
 NGS_JNI_FUNC(jobjectArray, catalogObjectQuery)(JNIEnv *env, jobject thisObj, jlong object, jint filter)
@@ -865,6 +1080,7 @@ NGS_JNI_FUNC(jobjectArray, catalogObjectQueryMultiFilter)(JNIEnv *env, jobject t
     jint *filtersArray = env->GetIntArrayElements(filters, &isCopy);
     ngsCatalogObjectInfo *info = ngsCatalogObjectQueryMultiFilter(
             reinterpret_cast<CatalogObjectH>(object), filtersArray, size);
+    env->ReleaseIntArrayElements(filters, filtersArray, JNI_ABORT);
     jobjectArray out = catalogObjectQueryToJobjectArray(env, info);
     if(nullptr != info) {
         ngsFree(info);
@@ -872,6 +1088,42 @@ NGS_JNI_FUNC(jobjectArray, catalogObjectQueryMultiFilter)(JNIEnv *env, jobject t
     return out;
 }
 
+NGS_JNI_FUNC(jobjectArray, catalogObjectQueryPaged)(JNIEnv *env, jobject thisObj,
+    jlong object, jintArray filters, jstring namePattern, jint offset, jint limit)
+{
+    ngsUnused(thisObj);
+    int size = env->GetArrayLength(filters);
+    jboolean isCopy;
+    jint *filtersArray = env->GetIntArrayElements(filters, &isCopy);
+    ngsCatalogObjectInfo *info = ngsCatalogObjectQueryPaged(
+            reinterpret_cast<CatalogObjectH>(object), filtersArray, size,
+            jniString(env, namePattern).c_str(), offset, limit);
+    env->ReleaseIntArrayElements(filters, filtersArray, JNI_ABORT);
+    jobjectArray out = catalogObjectQueryToJobjectArray(env, info);
+    if(nullptr != info) {
+        ngsFree(info);
+    }
+    return out;
+}
+
+NGS_JNI_FUNC(jint, catalogObjectQueryPacked)(JNIEnv *env, jobject thisObj,
+    jlong object, jintArray filters, jstring namePattern, jint offset, jint limit,
+    jobject buffer)
+{
+    ngsUnused(thisObj);
+    int size = env->GetArrayLength(filters);
+    jint *filtersArray = env->GetIntArrayElements(filters, nullptr);
+    ngsCatalogObjectInfo *info = ngsCatalogObjectQueryPaged(
+            reinterpret_cast<CatalogObjectH>(object), filtersArray, size,
+            jniString(env, namePattern).c_str(), offset, limit);
+    env->ReleaseIntArrayElements(filters, filtersArray, JNI_ABORT);
+    jint out = catalogObjectQueryToBuffer(env, info, buffer);
+    if(nullptr != info) {
+        ngsFree(info);
+    }
+    return out;
+}
+
 NGS_JNI_FUNC(jboolean, catalogObjectDelete)(JNIEnv *env, jobject thisObj, jlong object)
 {
     ngsUnused(env);
@@ -991,6 +1243,20 @@ NGS_JNI_FUNC(void, catalogObjectRefresh)(JNIEnv *env, jobject thisObj, jlong obj
     ngsCatalogObjectRefresh(reinterpret_cast<CatalogObjectH>(object));
 }
 
+NGS_JNI_FUNC(jint, catalogObjectLoadChildren)(JNIEnv *env, jobject thisObj, jlong object,
+                                             jlong callbackId)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    if(callbackId == 0) {
+        return ngsCatalogObjectLoadChildren(reinterpret_cast<CatalogObjectH>(object),
+                                            nullptr, nullptr);
+    }
+    return ngsCatalogObjectLoadChildren(reinterpret_cast<CatalogObjectH>(object),
+                                        progressProxyFunc,
+                                        reinterpret_cast<void *>(callbackId));
+}
+
 NGS_JNI_FUNC(jboolean, catalogCheckConnection)(JNIEnv *env, jobject thisObj, jint objectType, jobjectArray options)
 {
     ngsUnused(thisObj);
@@ -1152,6 +1418,19 @@ NGS_JNI_FUNC(jlong, featureClassNextFeature)(JNIEnv *env, jobject thisObj, jlong
     return reinterpret_cast<jlong>(ngsFeatureClassNextFeature(reinterpret_cast<CatalogObjectH>(object)));
 }
 
+NGS_JNI_FUNC(jint, featureClassReadPage)(JNIEnv *env, jobject thisObj, jlong object,
+                                         jobject buffer, jint maxCount, jboolean withGeometry)
+{
+    ngsUnused(thisObj);
+    void *data = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(nullptr == data || capacity <= 0) {
+        return -1;
+    }
+    return ngsFeatureClassReadPage(reinterpret_cast<CatalogObjectH>(object), data,
+                                   capacity, maxCount, withGeometry ? 1 : 0);
+}
+
 NGS_JNI_FUNC(jlong, featureClassGetFeature)(JNIEnv *env, jobject thisObj, jlong object, jlong id)
 {
     ngsUnused(env);
@@ -1179,6 +1458,55 @@ NGS_JNI_FUNC(jboolean, featureClassSetSpatialFilter)(JNIEnv *env, jobject thisOb
            NGS_JNI_TRUE : NGS_JNI_FALSE;
 }
 
+NGS_JNI_FUNC(jboolean, featureClassCreateIndex)(JNIEnv *env, jobject thisObj, jlong object,
+                                                jstring fieldName)
+{
+    ngsUnused(thisObj);
+    return ngsFeatureClassCreateIndex(reinterpret_cast<CatalogObjectH>(object),
+                                      jniString(env, fieldName).c_str()) == COD_SUCCESS ?
+           NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
+NGS_JNI_FUNC(jboolean, featureClassDropIndex)(JNIEnv *env, jobject thisObj, jlong object,
+                                              jstring fieldName)
+{
+    ngsUnused(thisObj);
+    return ngsFeatureClassDropIndex(reinterpret_cast<CatalogObjectH>(object),
+                                    jniString(env, fieldName).c_str()) == COD_SUCCESS ?
+           NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
+NGS_JNI_FUNC(jboolean, featureClassCreateSearchIndex)(JNIEnv *env, jobject thisObj, jlong object,
+                                                      jobjectArray fields, jobjectArray options)
+{
+    ngsUnused(thisObj);
+    char **nativeFields = toOptions(env, fields);
+    char **nativeOptions = toOptions(env, options);
+    int result = ngsFeatureClassCreateSearchIndex(reinterpret_cast<CatalogObjectH>(object),
+                                                  nativeFields, nativeOptions);
+    CSLDestroy(nativeFields);
+    CSLDestroy(nativeOptions);
+    return result == COD_SUCCESS ? NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
+NGS_JNI_FUNC(jlongArray, featureClassSearch)(JNIEnv *env, jobject thisObj, jlong object,
+                                             jstring query, jint offset, jint limit)
+{
+    ngsUnused(thisObj);
+    long long *ids = ngsFeatureClassSearch(reinterpret_cast<CatalogObjectH>(object),
+                                           jniString(env, query).c_str(), offset, limit);
+    jsize count = 0;
+    while(nullptr != ids && ids[count] != -1) {
+        count++;
+    }
+    jlongArray result = env->NewLongArray(count);
+    if(result && count > 0) {
+        env->SetLongArrayRegion(result, 0, count, reinterpret_cast<const jlong*>(ids));
+    }
+    ngsFree(ids);
+    return result;
+}
+
 NGS_JNI_FUNC(jboolean, featureClassDeleteEditOperation)(JNIEnv *env, jobject thisObj, jlong object,
                                                         jlong fid, jlong aid, jint code, jlong rid,
                                                         jlong arid)
@@ -1253,6 +1581,22 @@ NGS_JNI_FUNC(jlong, featureGetGeometry)(JNIEnv *env, jobject thisObj, jlong feat
     return reinterpret_cast<jlong>(ngsFeatureGetGeometry(reinterpret_cast<FeatureH>(feature)));
 }
 
+NGS_JNI_FUNC(jint, featureGetGeometryWKB)(JNIEnv *env, jobject thisObj, jlong feature,
+                                          jobject buffer)
+{
+    ngsUnused(thisObj);
+    // Direct ByteBuffer reused by caller, if returned size is greater than
+    // capacity nothing is written and the buffer must be enlarged
+    void *data = nullptr;
+    jlong capacity = 0;
+    if(nullptr != buffer) {
+        data = env->GetDirectBufferAddress(buffer);
+        capacity = env->GetDirectBufferCapacity(buffer);
+    }
+    return ngsFeatureGetGeometryWKB(reinterpret_cast<FeatureH>(feature), data,
+                                    static_cast<int>(std::min<jlong>(capacity, INT_MAX)));
+}
+
 NGS_JNI_FUNC(jint, featureGetFieldAsInteger)(JNIEnv *env, jobject thisObj, jlong feature, jint field)
 {
     ngsUnused(env);
@@ -1429,6 +1773,20 @@ NGS_JNI_FUNC(jint, geometryGetType)(JNIEnv *env, jobject thisObj, jlong geometry
     return ngsGeometryGetType(reinterpret_cast<GeometryH>(geometry));
 }
 
+NGS_JNI_FUNC(jint, geometryGetWKB)(JNIEnv *env, jobject thisObj, jlong geometry,
+                                   jobject buffer)
+{
+    ngsUnused(thisObj);
+    void *data = nullptr;
+    jlong capacity = 0;
+    if(nullptr != buffer) {
+        data = env->GetDirectBufferAddress(buffer);
+        capacity = env->GetDirectBufferCapacity(buffer);
+    }
+    return ngsGeometryGetWKB(reinterpret_cast<GeometryH>(geometry), data,
+                             static_cast<int>(std::min<jlong>(capacity, INT_MAX)));
+}
+
 NGS_JNI_FUNC(jstring, geometryToJson)(JNIEnv *env, jobject thisObj, jlong geometry)
 {
     ngsUnused(thisObj);
@@ -1462,6 +1820,23 @@ NGS_JNI_FUNC(jobject, coordinateTransformationDo)(JNIEnv *env, jobject thisObj,
     return  env->NewObjectA(g_PointClass, g_PointInitMid, args);
 }
 
+NGS_JNI_FUNC(jboolean, coordinateTransformationDoArray)(JNIEnv *env, jobject thisObj,
+                                                        jlong object, jobject buffer,
+                                                        jint count)
+{
+    ngsUnused(thisObj);
+    // Direct DoubleBuffer of x, y, z triples
+    void *data = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(nullptr == data || count < 0 || capacity / 3 < count) {
+        return NGS_JNI_FALSE;
+    }
+    return ngsCoordinateTransformationDoArray(
+                reinterpret_cast<CoordinateTransformationH>(object),
+                static_cast<ngsCoordinate*>(data), count) == COD_SUCCESS ?
+                NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
 NGS_JNI_FUNC(jlong, featureAttachmentAdd)(JNIEnv *env, jobject thisObj,
                                           jlong feature, jstring name, jstring description,
                                           jstring path, jobjectArray options, jboolean logEdits)
@@ -1574,6 +1949,18 @@ NGS_JNI_FUNC(jint, mapOpen)(JNIEnv *env, jobject thisObj, jstring path)
     return static_cast<jint>(ngsMapOpen(jniString(env, path).c_str()));
 }
 
+NGS_JNI_FUNC(jint, mapOpenWithOptions)(JNIEnv *env, jobject thisObj,
+                                       jstring path, jobjectArray options)
+{
+    ngsUnused(thisObj);
+    char **thisOptions = toOptions(env, options);
+    jint result = static_cast<jint>(ngsMapOpenWithOptions(
+                                        jniString(env, path).c_str(),
+                                        thisOptions));
+    ngsFree(thisOptions);
+    return result;
+}
+
 NGS_JNI_FUNC(jboolean, mapSave)(JNIEnv *env, jobject thisObj, jint mapId, jstring path)
 {
     ngsUnused(thisObj);
@@ -1658,6 +2045,40 @@ NGS_JNI_FUNC(jboolean, mapDraw)(JNIEnv *env, jobject thisObj, jint mapId, jint s
     return result == COD_SUCCESS ? NGS_JNI_TRUE : NGS_JNI_FALSE;
 }
 
+NGS_JNI_FUNC(jboolean, mapDrawToBuffer)(JNIEnv *env, jobject thisObj, jint mapId,
+                                        jint width, jint height, jobject buffer,
+                                        jint callbackId)
+{
+    ngsUnused(thisObj);
+    // Direct ByteBuffer of width * height * 4 bytes
+    void *data = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(nullptr == data || width < 1 || height < 1 ||
+            capacity < static_cast<jlong>(width) * height * 4) {
+        return NGS_JNI_FALSE;
+    }
+    int result = ngsMapDrawToBuffer(static_cast<char>(mapId), width, height, data,
+            callbackId == 0 ? nullptr : progressProxyFunc,
+            callbackId == 0 ? nullptr : reinterpret_cast<void *>(callbackId));
+    return result == COD_SUCCESS ? NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
+NGS_JNI_FUNC(jboolean, mapExport)(JNIEnv *env, jobject thisObj, jint mapId,
+                                  jstring path, jint width, jint height,
+                                  jdouble minX, jdouble minY, jdouble maxX,
+                                  jdouble maxY, jobjectArray options,
+                                  jint callbackId)
+{
+    ngsUnused(thisObj);
+    char **nativeOptions = toOptions(env, options);
+    int result = ngsMapExport(static_cast<char>(mapId), jniString(env, path).c_str(),
+            width, height, {minX, minY, maxX, maxY}, nativeOptions,
+            callbackId == 0 ? nullptr : progressProxyFunc,
+            callbackId == 0 ? nullptr : reinterpret_cast<void *>(callbackId));
+    CSLDestroy(nativeOptions);
+    return result == COD_SUCCESS ? NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
 NGS_JNI_FUNC(jboolean, mapInvalidate)(JNIEnv *env, jobject thisObj, jint mapId,
                                       jdouble minX, jdouble minY, jdouble maxX, jdouble maxY)
 {
@@ -1910,6 +2331,21 @@ NGS_JNI_FUNC(jboolean, layerSetMinZoom)(JNIEnv *env, jobject thisObj, jlong laye
            NGS_JNI_TRUE : NGS_JNI_FALSE;
 }
 
+NGS_JNI_FUNC(jfloat, layerGetOpacity)(JNIEnv *env, jobject thisObj, jlong layer)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return ngsLayerGetOpacity(reinterpret_cast<LayerH>(layer));
+}
+
+NGS_JNI_FUNC(jboolean, layerSetOpacity)(JNIEnv *env, jobject thisObj, jlong layer, jfloat opacity)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return ngsLayerSetOpacity(reinterpret_cast<LayerH>(layer), opacity) == COD_SUCCESS ?
+           NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
 NGS_JNI_FUNC(jlong, layerGetDataSource)(JNIEnv *env, jobject thisObj, jlong layer)
 {
     ngsUnused(env);
@@ -1973,6 +2409,36 @@ NGS_JNI_FUNC(jboolean, layerSetHideIds)(JNIEnv *env, jobject thisObj, jlong laye
                               idsStdArray.data(), size) == COD_SUCCESS ? NGS_JNI_TRUE : NGS_JNI_FALSE;
 }
 
+NGS_JNI_FUNC(jboolean, layerGetSnapping)(JNIEnv *env, jobject thisObj, jlong layer)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return ngsLayerGetSnapping(reinterpret_cast<LayerH>(layer)) == 1 ? NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
+NGS_JNI_FUNC(jboolean, layerSetSnapping)(JNIEnv *env, jobject thisObj, jlong layer, jboolean enable)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return ngsLayerSetSnapping(reinterpret_cast<LayerH>(layer), static_cast<char>(enable ? 1 : 0)) == COD_SUCCESS ?
+           NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
+NGS_JNI_FUNC(jlong, layerGetLabelStyle)(JNIEnv *env, jobject thisObj, jlong layer)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return reinterpret_cast<jlong>(ngsLayerGetLabelStyle(reinterpret_cast<LayerH>(layer)));
+}
+
+NGS_JNI_FUNC(jboolean, layerSetLabelStyle)(JNIEnv *env, jobject thisObj, jlong layer, jlong style)
+{
+    ngsUnused(env);
+    ngsUnused(thisObj);
+    return ngsLayerSetLabelStyle(reinterpret_cast<LayerH>(layer),
+                                 reinterpret_cast<JsonObjectH>(style)) == COD_SUCCESS ? NGS_JNI_TRUE : NGS_JNI_FALSE;
+}
+
 /*
  * Overlay functions
  */
@@ -20,12 +20,346 @@
  ****************************************************************************/
 #include "archive.h"
 
+// std
+#include <algorithm>
+#include <map>
+
 #include "api_priv.h"
+#include "catalog.h"
 #include "file.h"
+#include "ds/dataset.h"
+#include "ds/raster.h"
+#include "ds/simpledataset.h"
+#include "ngstore/catalog/filter.h"
+#include "util/error.h"
+#include "util/mutex.h"
 #include "util/notify.h"
+#include "util/stringutil.h"
 
 namespace ngs {
 
+constexpr size_t BACKUP_BUFFER_SIZE = 1024 * 1024;
+constexpr GUInt32 ZIP_EOCD_SIGNATURE = 0x06054b50;
+constexpr GUInt32 ZIP64_EOCD_LOCATOR_SIGNATURE = 0x07064b50;
+constexpr GUInt32 ZIP64_EOCD_SIGNATURE = 0x06064b50;
+constexpr GUInt32 ZIP_CENTRAL_SIGNATURE = 0x02014b50;
+constexpr size_t ZIP_EOCD_SIZE = 22;
+constexpr size_t ZIP64_EOCD_LOCATOR_SIZE = 20;
+constexpr size_t ZIP64_EOCD_SIZE = 56;
+constexpr size_t ZIP_CENTRAL_SIZE = 46;
+constexpr size_t ZIP_MAX_COMMENT_SIZE = 65535;
+constexpr GUIntBig ZIP_MAX_CENTRAL_DIR_SIZE = 512 * 1024 * 1024;
+constexpr GUInt32 ZIP_UINT32_MAX = 0xFFFFFFFF;
+constexpr GUInt16 ZIP64_EXTRA_ID = 0x0001;
+constexpr GUInt16 ZIP_FLAG_UTF8 = 0x0800;
+constexpr size_t MAX_ARCHIVE_INDEXES = 16;
+constexpr const char *ZIP_EXT = ".zip";
+static const std::string storedExtensions[] = {
+    "zip", "ngmd", "jpg", "jpeg", "png", "webp", "gz", "mbtiles"
+};
+
+static GUInt16 readUInt16(const GByte *data)
+{
+    return static_cast<GUInt16>(data[0] | (data[1] << 8));
+}
+
+static GUInt32 readUInt32(const GByte *data)
+{
+    return static_cast<GUInt32>(data[0]) |
+            (static_cast<GUInt32>(data[1]) << 8) |
+            (static_cast<GUInt32>(data[2]) << 16) |
+            (static_cast<GUInt32>(data[3]) << 24);
+}
+
+static GUIntBig readUInt64(const GByte *data)
+{
+    return static_cast<GUIntBig>(readUInt32(data)) |
+            (static_cast<GUIntBig>(readUInt32(data + 4)) << 32);
+}
+
+static bool readAt(VSILFILE *fp, GUIntBig offset, GByte *buffer, size_t size)
+{
+    return VSIFSeekL(fp, offset, SEEK_SET) == 0 &&
+            VSIFReadL(buffer, 1, size, fp) == size;
+}
+
+static std::string parentPath(const std::string &innerPath)
+{
+    auto pos = innerPath.rfind('/');
+    return pos == std::string::npos ? "" : innerPath.substr(0, pos);
+}
+
+//------------------------------------------------------------------------------
+// ArchiveIndex
+//------------------------------------------------------------------------------
+
+static Mutex gArchiveIndexesMutex;
+static std::map<std::string, ArchiveIndexPtr> gArchiveIndexes;
+
+/**
+ * @brief ArchiveIndex::get Returns the index of ZIP archive. The index is
+ * parsed on first request and is parsed again if archive file is modified.
+ * @param path Archive system path.
+ * @return Index or empty pointer if archive central directory cannot be read.
+ */
+ArchiveIndexPtr ArchiveIndex::get(const std::string &path)
+{
+    VSIStatBufL sbuf;
+    if(VSIStatL(path.c_str(), &sbuf) != 0) {
+        return ArchiveIndexPtr();
+    }
+
+    MutexHolder holder(gArchiveIndexesMutex);
+    auto it = gArchiveIndexes.find(path);
+    if(it != gArchiveIndexes.end()) {
+        if(it->second->m_mtime == sbuf.st_mtime &&
+           it->second->m_size == static_cast<GIntBig>(sbuf.st_size)) {
+            return it->second;
+        }
+        gArchiveIndexes.erase(it);
+    }
+
+    ArchiveIndexPtr index(new ArchiveIndex);
+    index->m_mtime = sbuf.st_mtime;
+    index->m_size = static_cast<GIntBig>(sbuf.st_size);
+    if(!index->read(path)) {
+        return ArchiveIndexPtr();
+    }
+
+    if(gArchiveIndexes.size() >= MAX_ARCHIVE_INDEXES) {
+        gArchiveIndexes.erase(gArchiveIndexes.begin());
+    }
+    gArchiveIndexes[path] = index;
+    return index;
+}
+
+/**
+ * @brief ArchiveIndex::splitPath Splits /vsizip/ path to the archive path and
+ * the path inside archive. Nested archives are not supported.
+ * @param path Path to split.
+ * @param archivePath Archive system path.
+ * @param innerPath Path inside archive without leading and trailing slashes.
+ * @return true if path is inside ZIP archive.
+ */
+bool ArchiveIndex::splitPath(const std::string &path, std::string &archivePath,
+                             std::string &innerPath)
+{
+    const std::string prefix = Archive::pathPrefix(CAT_CONTAINER_ARCHIVE_ZIP);
+    if(!startsWith(path, prefix)) {
+        return false;
+    }
+
+    std::string lowerPath = CPLString(path).tolower();
+    size_t extPos = lowerPath.find(ZIP_EXT, prefix.size());
+    while(extPos != std::string::npos) {
+        size_t endPos = extPos + static_cast<size_t>(length(ZIP_EXT));
+        if(endPos == path.size() || path[endPos] == '/') {
+            archivePath = path.substr(prefix.size(), endPos - prefix.size());
+            innerPath = endPos < path.size() ? path.substr(endPos + 1) : "";
+            while(!innerPath.empty() && innerPath.back() == '/') {
+                innerPath.pop_back();
+            }
+            return !startsWith(archivePath, "/vsi") &&
+                    lowerPath.find(ZIP_EXT + std::string("/"), endPos) ==
+                    std::string::npos;
+        }
+        extPos = lowerPath.find(ZIP_EXT, endPos);
+    }
+    return false;
+}
+
+const ArchiveIndex::Entry *ArchiveIndex::entry(const std::string &innerPath) const
+{
+    auto it = m_entries.find(innerPath);
+    return it == m_entries.end() ? nullptr : &it->second;
+}
+
+bool ArchiveIndex::isDir(const std::string &innerPath) const
+{
+    if(innerPath.empty()) {
+        return true;
+    }
+    const Entry *item = entry(innerPath);
+    return nullptr != item && item->isDir;
+}
+
+/**
+ * @brief ArchiveIndex::children Returns names of archive directory content.
+ * @param innerPath Directory path inside archive. Empty for archive root.
+ * @return File and directory names.
+ */
+std::vector<std::string> ArchiveIndex::children(const std::string &innerPath) const
+{
+    auto it = m_children.find(innerPath);
+    return it == m_children.end() ? std::vector<std::string>() : it->second;
+}
+
+void ArchiveIndex::addEntry(const std::string &name, const Entry &entry)
+{
+    if(name.empty()) {
+        return;
+    }
+
+    auto it = m_entries.find(name);
+    if(it != m_entries.end()) {
+        // The directory may be added before from the file path
+        it->second = entry;
+        return;
+    }
+    m_entries[name] = entry;
+
+    std::string parent = parentPath(name);
+    const std::string childName = parent.empty() ? name :
+                                                   name.substr(parent.size() + 1);
+    m_children[parent].push_back(childName);
+    if(!parent.empty() && m_entries.find(parent) == m_entries.end()) {
+        addEntry(parent, {0, 0, 0, true});
+    }
+}
+
+bool ArchiveIndex::read(const std::string &path)
+{
+    VSILFILE *fp = VSIFOpenL(path.c_str(), "rb");
+    if(nullptr == fp) {
+        return false;
+    }
+
+    // Find end of central directory record
+    GUIntBig fileSize = static_cast<GUIntBig>(m_size);
+    if(fileSize < ZIP_EOCD_SIZE) {
+        VSIFCloseL(fp);
+        return false;
+    }
+    size_t tailSize = static_cast<size_t>(
+                std::min(fileSize, static_cast<GUIntBig>(ZIP_EOCD_SIZE +
+                                                         ZIP_MAX_COMMENT_SIZE)));
+    GUIntBig tailOffset = fileSize - tailSize;
+    std::vector<GByte> tail(tailSize);
+    if(!readAt(fp, tailOffset, tail.data(), tailSize)) {
+        VSIFCloseL(fp);
+        return false;
+    }
+
+    size_t eocdPos = tailSize - ZIP_EOCD_SIZE + 1;
+    bool found = false;
+    while(eocdPos > 0) {
+        --eocdPos;
+        if(readUInt32(&tail[eocdPos]) == ZIP_EOCD_SIGNATURE) {
+            found = true;
+            break;
+        }
+    }
+    if(!found) {
+        VSIFCloseL(fp);
+        return false;
+    }
+
+    GUIntBig count = readUInt16(&tail[eocdPos + 10]);
+    GUIntBig centralSize = readUInt32(&tail[eocdPos + 12]);
+    GUIntBig centralOffset = readUInt32(&tail[eocdPos + 16]);
+
+    // Zip64 end of central directory
+    GUIntBig eocdOffset = tailOffset + eocdPos;
+    if(eocdOffset >= ZIP64_EOCD_LOCATOR_SIZE) {
+        GByte locator[ZIP64_EOCD_LOCATOR_SIZE];
+        if(readAt(fp, eocdOffset - ZIP64_EOCD_LOCATOR_SIZE, locator,
+                  ZIP64_EOCD_LOCATOR_SIZE) &&
+           readUInt32(locator) == ZIP64_EOCD_LOCATOR_SIGNATURE) {
+            GByte eocd64[ZIP64_EOCD_SIZE];
+            if(!readAt(fp, readUInt64(locator + 8), eocd64, ZIP64_EOCD_SIZE) ||
+               readUInt32(eocd64) != ZIP64_EOCD_SIGNATURE) {
+                VSIFCloseL(fp);
+                return false;
+            }
+            count = readUInt64(eocd64 + 32);
+            centralSize = readUInt64(eocd64 + 40);
+            centralOffset = readUInt64(eocd64 + 48);
+        }
+    }
+
+    if(centralSize > ZIP_MAX_CENTRAL_DIR_SIZE ||
+       centralOffset + centralSize > fileSize) {
+        VSIFCloseL(fp);
+        return false;
+    }
+
+    std::vector<GByte> central(static_cast<size_t>(centralSize));
+    bool result = readAt(fp, centralOffset, central.data(), central.size());
+    VSIFCloseL(fp);
+    if(!result) {
+        return false;
+    }
+
+    // Parse central directory entries
+    size_t pos = 0;
+    for(GUIntBig i = 0; i < count; ++i) {
+        if(pos + ZIP_CENTRAL_SIZE > central.size() ||
+           readUInt32(&central[pos]) != ZIP_CENTRAL_SIGNATURE) {
+            return false;
+        }
+        const GByte *header = &central[pos];
+        GUInt16 flags = readUInt16(header + 8);
+        Entry item;
+        item.compressedSize = readUInt32(header + 20);
+        item.size = readUInt32(header + 24);
+        size_t nameLength = readUInt16(header + 28);
+        size_t extraLength = readUInt16(header + 30);
+        size_t commentLength = readUInt16(header + 32);
+        item.offset = readUInt32(header + 42);
+
+        size_t namePos = pos + ZIP_CENTRAL_SIZE;
+        size_t extraPos = namePos + nameLength;
+        pos = extraPos + extraLength + commentLength;
+        if(pos > central.size()) {
+            return false;
+        }
+
+        // Zip64 extended information
+        size_t extraEnd = extraPos + extraLength;
+        while(extraPos + 4 <= extraEnd) {
+            GUInt16 id = readUInt16(&central[extraPos]);
+            size_t size = readUInt16(&central[extraPos + 2]);
+            size_t dataPos = extraPos + 4;
+            extraPos = dataPos + size;
+            if(id != ZIP64_EXTRA_ID || extraPos > extraEnd) {
+                continue;
+            }
+            if(item.size == ZIP_UINT32_MAX && dataPos + 8 <= extraPos) {
+                item.size = readUInt64(&central[dataPos]);
+                dataPos += 8;
+            }
+            if(item.compressedSize == ZIP_UINT32_MAX && dataPos + 8 <= extraPos) {
+                item.compressedSize = readUInt64(&central[dataPos]);
+                dataPos += 8;
+            }
+            if(item.offset == ZIP_UINT32_MAX && dataPos + 8 <= extraPos) {
+                item.offset = readUInt64(&central[dataPos]);
+            }
+        }
+
+        std::string name(reinterpret_cast<const char*>(&central[namePos]),
+                         nameLength);
+        if(!(flags & ZIP_FLAG_UTF8) && !CPLIsUTF8(name.c_str(), -1)) {
+            // Same conversion as /vsizip/ does
+            char *recoded = CPLRecode(name.c_str(), "CP437", CPL_ENC_UTF8);
+            name = recoded;
+            CPLFree(recoded);
+        }
+        std::replace(name.begin(), name.end(), '\\', '/');
+        item.isDir = !name.empty() && name.back() == '/';
+        while(!name.empty() && name.back() == '/') {
+            name.pop_back();
+        }
+        addEntry(name, item);
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// ArchiveFolder
+//------------------------------------------------------------------------------
+
 ArchiveFolder::ArchiveFolder(ObjectContainer * const parent,
                              const std::string &name,
                              const std::string &path) :
@@ -45,6 +379,31 @@ bool ArchiveFolder::canDestroy() const
     return false;
 }
 
+std::vector<std::string> ArchiveFolder::readChildrenNames() const
+{
+    std::string archivePath, innerPath;
+    ArchiveIndexPtr index;
+    if(ArchiveIndex::splitPath(m_path, archivePath, innerPath)) {
+        index = ArchiveIndex::get(archivePath);
+    }
+    if(!index) {
+        return Folder::readChildrenNames();
+    }
+
+    std::vector<std::string> names;
+    CatalogPtr catalog = Catalog::instance();
+    for(const std::string &name : index->children(innerPath)) {
+        if(!catalog->isFileHidden(m_path, name)) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+//------------------------------------------------------------------------------
+// Archive
+//------------------------------------------------------------------------------
+
 Archive::Archive(ObjectContainer * const parent,
                  const enum ngsCatalogObjectType type,
                  const std::string &name,
@@ -80,5 +439,217 @@ std::string Archive::pathPrefix(const enum ngsCatalogObjectType type)
     }
 }
 
+//------------------------------------------------------------------------------
+// BackupWriter
+//------------------------------------------------------------------------------
+
+BackupWriter::BackupWriter(const std::string &path) :
+    m_path(path),
+    m_totalSize(0)
+{
+}
+
+/**
+ * @brief BackupWriter::addObject Adds object files to archive. The folders are
+ * added recursively, the file based datasets are added with sibling files.
+ * @param object Object to add.
+ * @return false if object type is not supported.
+ */
+bool BackupWriter::addObject(ObjectPtr object)
+{
+    if(!object) {
+        return errorMessage(_("The object handle is null"));
+    }
+
+    if(Filter::isLocalDir(object->type())) {
+        addDir(object->path(), object->name());
+        return true;
+    }
+
+    if(!Filter::isFileBased(object->type())) {
+        return errorMessage(_("Backup of %s is not supported"),
+                            object->name().c_str());
+    }
 
+    std::vector<std::string> siblingFiles;
+    SimpleDataset *simpleDS = ngsDynamicCast(SimpleDataset, object);
+    Raster *raster = ngsDynamicCast(Raster, object);
+    Dataset *dataset = ngsDynamicCast(Dataset, object);
+    if(nullptr != simpleDS) {
+        siblingFiles = simpleDS->siblingFiles();
+    }
+    else if(nullptr != raster) {
+        siblingFiles = raster->siblingFiles();
+    }
+    else if(nullptr != dataset) {
+        std::string attachmentsPath = dataset->attachmentsFolderPath();
+        if(Folder::isExists(attachmentsPath)) {
+            addDir(attachmentsPath, File::getFileName(attachmentsPath));
+        }
+        addFile(object->path(), object->name(), object);
+        return true;
+    }
+
+    std::string parentPath = File::getPath(object->path());
+    for(const std::string &siblingFile : siblingFiles) {
+        addFile(File::formFileName(parentPath, siblingFile), siblingFile);
+    }
+    addFile(object->path(), object->name());
+    return true;
 }
+
+void BackupWriter::addDir(const std::string &path, const std::string &name)
+{
+    char **items = CPLReadDir(path.c_str());
+    if(nullptr == items) {
+        return;
+    }
+
+    CatalogPtr catalog = Catalog::instance();
+    for(int i = 0; items[i] != nullptr; ++i) {
+        if(compare(items[i], ".") || compare(items[i], "..")) {
+            continue;
+        }
+
+        std::string itemPath = File::formFileName(path, items[i]);
+        if(Folder::isCopySkipped(itemPath)) {
+            continue;
+        }
+
+        std::string itemName = name + "/" + items[i];
+        VSIStatBufL sbuf;
+        if(VSIStatL(itemPath.c_str(), &sbuf) != 0) {
+            continue;
+        }
+        if(VSI_ISDIR(sbuf.st_mode)) {
+            addDir(itemPath, itemName);
+            continue;
+        }
+
+        ObjectPtr object = catalog->getObjectBySystemPath(itemPath);
+        if(object && !Filter::isDatabase(object->type())) {
+            object = ObjectPtr();
+        }
+        addFile(itemPath, itemName, object);
+    }
+
+    CSLDestroy(items);
+}
+
+void BackupWriter::addFile(const std::string &path, const std::string &name,
+                           ObjectPtr dataset)
+{
+    GIntBig size = File::fileSize(path);
+    m_entries.push_back({path, name, size, dataset});
+    m_totalSize += size;
+}
+
+/**
+ * @brief BackupWriter::write Writes all added objects into archive. The
+ * archive file is overwritten. On cancel or error the archive is deleted.
+ * @param progress Progress reports written bytes.
+ * @return true on success.
+ */
+bool BackupWriter::write(const Progress &progress)
+{
+    void *zip = CPLCreateZip(m_path.c_str(), nullptr);
+    if(nullptr == zip) {
+        return errorMessage(_("Failed to create %s."), m_path.c_str());
+    }
+
+    bool result = true;
+    GIntBig written = 0;
+    for(const Entry &entry : m_entries) {
+        if(!writeEntry(zip, entry, written, progress)) {
+            result = false;
+            break;
+        }
+    }
+
+    if(CPLCloseZip(zip) != CE_None && result) {
+        result = errorMessage(_("Failed to create %s."), m_path.c_str());
+    }
+
+    if(!result) {
+        File::deleteFile(m_path);
+        return false;
+    }
+
+    progress.onProgress(COD_FINISHED, 1.0, _("Backup %s created"),
+                        m_path.c_str());
+    return true;
+}
+
+bool BackupWriter::writeEntry(void *zip, const Entry &entry, GIntBig &written,
+                              const Progress &progress)
+{
+    // The data store writes are locked till the file is copied. The WAL
+    // content is moved into the database file before.
+    Dataset *dataset = ngsDynamicCast(Dataset, entry.dataset);
+    if(nullptr != dataset && !dataset->isOpened()) {
+        dataset = nullptr;
+    }
+    DatasetWriteLockHolder writeHolder(dataset);
+    DatasetExecuteSQLLockHolder executeSQLHolder(dataset);
+    if(nullptr != dataset) {
+        dataset->flushCache();
+        dataset->executeSQL("PRAGMA wal_checkpoint(TRUNCATE)");
+    }
+
+    VSILFILE *fp = VSIFOpenL(entry.path.c_str(), "rb");
+    if(nullptr == fp) {
+        return errorMessage(_("Open input file %s failed"), entry.path.c_str());
+    }
+
+    const std::string ext = File::getExtension(entry.path);
+    bool compressed = true;
+    for(const std::string &storedExtension : storedExtensions) {
+        if(compare(storedExtension, ext)) {
+            compressed = false;
+            break;
+        }
+    }
+
+    Options options;
+    options.add("COMPRESSED", compressed);
+    auto optionsList = options.asCPLStringList();
+    if(CPLCreateFileInZip(zip, entry.name.c_str(), optionsList) != CE_None) {
+        VSIFCloseL(fp);
+        return errorMessage(_("Failed to add %s to archive"), entry.name.c_str());
+    }
+
+    double totalSize = std::max(1.0, static_cast<double>(m_totalSize));
+    GByte *buffer = static_cast<GByte*>(CPLMalloc(BACKUP_BUFFER_SIZE));
+    bool result = true;
+    while(true) {
+        size_t read = VSIFReadL(buffer, 1, BACKUP_BUFFER_SIZE, fp);
+        if(read > 0 && CPLWriteFileInZip(zip, buffer, static_cast<int>(read)) !=
+                CE_None) {
+            result = errorMessage(_("Failed to add %s to archive"),
+                                  entry.name.c_str());
+            break;
+        }
+
+        written += read;
+        if(!progress.onProgress(COD_IN_PROCESS,
+                                std::min(1.0, written / totalSize),
+                                _("Copying %s"), entry.name.c_str())) {
+            result = errorMessage(_("Backup canceled"));
+            break;
+        }
+
+        if(read < BACKUP_BUFFER_SIZE) {
+            break;
+        }
+    }
+
+    CPLFree(buffer);
+    VSIFCloseL(fp);
+    if(CPLCloseFileInZip(zip) != CE_None && result) {
+        result = errorMessage(_("Failed to add %s to archive"),
+                              entry.name.c_str());
+    }
+    return result;
+}
+
+} // namespace ngs
@@ -21,10 +21,53 @@
 #ifndef NGSARCHIVE_H
 #define NGSARCHIVE_H
 
+// std
+#include <unordered_map>
+
 #include "folder.h"
 
 namespace ngs {
 
+class ArchiveIndex;
+using ArchiveIndexPtr = std::shared_ptr<ArchiveIndex>;
+
+/**
+ * @brief The ArchiveIndex class Parsed ZIP central directory. The index is
+ * read once per archive file version and is used for archive listing and file
+ * type checks instead of the /vsizip/ directory reads.
+ */
+class ArchiveIndex
+{
+public:
+    typedef struct _entry {
+        GUIntBig size;
+        GUIntBig compressedSize;
+        GUIntBig offset; // Local header offset
+        bool isDir;
+    } Entry;
+
+public:
+    static ArchiveIndexPtr get(const std::string &path);
+    static bool splitPath(const std::string &path, std::string &archivePath,
+                          std::string &innerPath);
+
+public:
+    const Entry *entry(const std::string &innerPath) const;
+    bool isDir(const std::string &innerPath) const;
+    std::vector<std::string> children(const std::string &innerPath) const;
+    size_t size() const { return m_entries.size(); }
+
+protected:
+    bool read(const std::string &path);
+    void addEntry(const std::string &name, const Entry &entry);
+
+protected:
+    std::unordered_map<std::string, Entry> m_entries;
+    std::unordered_map<std::string, std::vector<std::string>> m_children;
+    time_t m_mtime;
+    GIntBig m_size;
+};
+
 class ArchiveFolder : public Folder
 {
 public:
@@ -34,6 +77,8 @@ public:
     // ObjectContainer interface
 public:
     virtual bool canCreate(const enum ngsCatalogObjectType type) const override;
+protected:
+    virtual std::vector<std::string> readChildrenNames() const override;
 
     // Object interface
 public:
@@ -59,6 +104,39 @@ public:
 
 };
 
+/**
+ * @brief The BackupWriter class Streams catalog objects into new ZIP archive.
+ * The files are read directly into the archive without intermediate copies.
+ * The opened data stores are checkpointed and locked for writes while copied,
+ * so they are not closed during backup.
+ */
+class BackupWriter
+{
+public:
+    explicit BackupWriter(const std::string &path);
+    bool addObject(ObjectPtr object);
+    bool write(const Progress &progress = Progress());
+
+protected:
+    typedef struct _entry {
+        std::string path;
+        std::string name;
+        GIntBig size;
+        ObjectPtr dataset;
+    } Entry;
+
+    void addDir(const std::string &path, const std::string &name);
+    void addFile(const std::string &path, const std::string &name,
+                 ObjectPtr dataset = ObjectPtr());
+    bool writeEntry(void *zip, const Entry &entry, GIntBig &written,
+                    const Progress &progress);
+
+protected:
+    std::string m_path;
+    std::vector<Entry> m_entries;
+    GIntBig m_totalSize;
+};
+
 }
 
 #endif // NGSARCHIVE_H
@@ -34,6 +34,7 @@
 #include "ngstore/common.h"
 #include "util/settings.h"
 #include "util/stringutil.h"
+#include "util/threadpool.h"
 
 // factories
 #include "factories/connectionfactory.h"
@@ -52,11 +53,61 @@ namespace ngs {
 static CatalogPtr gCatalog;
 
 constexpr const char *CONNECTIONS_DIR = "connections";
+constexpr const char *SNAPSHOT_FILE = "catalog";
+constexpr const char *SNAPSHOT_FILE_EXT = "snapshot";
 constexpr const char *CATALOG_PREFIX = "ngc:/";
 constexpr const char *CATALOG_PREFIX_FULL = "ngc://";
 constexpr int CATALOG_PREFIX_LEN = length(CATALOG_PREFIX_FULL);
+constexpr size_t MAX_PATH_CACHE_SIZE = 4096;
+constexpr size_t PARALLEL_PROBE_MIN_NAMES = 128;
 
-Catalog::Catalog() : ObjectContainer(nullptr, CAT_CONTAINER_ROOT, _("Catalog"))
+//------------------------------------------------------------------------------
+// ProbeData
+//------------------------------------------------------------------------------
+
+class ProbeData : public ThreadData
+{
+public:
+    ProbeData(ObjectFactory *factory, const std::string &path,
+              const std::string &name) : ThreadData(false),
+        m_factory(factory), m_path(path), m_name(name) {}
+    virtual ~ProbeData() = default;
+    ObjectFactory *m_factory;
+    std::string m_path;
+    std::string m_name;
+};
+
+static bool probeThreadFunc(ThreadData *threadData)
+{
+    ProbeData *data = static_cast<ProbeData*>(threadData);
+    data->m_factory->probe(data->m_path, data->m_name);
+    return true;
+}
+
+static void probeNames(ObjectFactory *factory, const std::string &path,
+                       const std::vector<std::string> &names)
+{
+    std::vector<ProbeData> probes;
+    probes.reserve(names.size());
+    for(const std::string &name : names) {
+        probes.emplace_back(factory, path, name);
+    }
+
+    ThreadPool threadPool;
+    threadPool.init(getNumberThreads(), probeThreadFunc, 1, false,
+                    WorkerClass::INTERACTIVE);
+    for(ProbeData &probe : probes) {
+        threadPool.addThreadData(&probe);
+    }
+    threadPool.waitComplete(Progress());
+}
+
+//------------------------------------------------------------------------------
+// Catalog
+//------------------------------------------------------------------------------
+
+Catalog::Catalog() : ObjectContainer(nullptr, CAT_CONTAINER_ROOT, _("Catalog")),
+    m_pathCacheVersion(treeVersion())
 {
     m_showHidden = Settings::instance().getBool("catalog/show_hidden", true);
 }
@@ -71,8 +122,59 @@ ObjectPtr Catalog::getObject(const std::string &path)
     if(compare(path, CATALOG_PREFIX_FULL))
         return std::static_pointer_cast<Object>(gCatalog);
 
+    std::string key = CPLString(path).tolower();
+    ObjectPtr object = getCachedObject(key);
+    if(object) {
+        return object;
+    }
+
     // Skip prefix ngc://
-    return ObjectContainer::getObject(path.substr(CATALOG_PREFIX_LEN));
+    unsigned int version = treeVersion();
+    object = ObjectContainer::getObject(path.substr(CATALOG_PREFIX_LEN));
+    if(object) {
+        addCachedObject(key, object, version);
+    }
+    return object;
+}
+
+ObjectPtr Catalog::getCachedObject(const std::string &key)
+{
+    MutexHolder holder(m_pathCacheMutex);
+    if(m_pathCacheVersion != treeVersion()) {
+        // Some object was removed or renamed, the paths may point to other
+        // objects now
+        m_pathCache.clear();
+        m_pathCacheVersion = treeVersion();
+        return ObjectPtr();
+    }
+
+    auto it = m_pathCache.find(key);
+    if(it == m_pathCache.end()) {
+        return ObjectPtr();
+    }
+    ObjectPtr object = it->second.lock();
+    if(!object) {
+        m_pathCache.erase(it);
+    }
+    return object;
+}
+
+void Catalog::addCachedObject(const std::string &key, ObjectPtr object,
+                              unsigned int version)
+{
+    MutexHolder holder(m_pathCacheMutex);
+    if(version != treeVersion()) {
+        // The tree was changed while path resolving
+        return;
+    }
+    if(m_pathCacheVersion != version) {
+        m_pathCache.clear();
+        m_pathCacheVersion = version;
+    }
+    if(m_pathCache.size() >= MAX_PATH_CACHE_SIZE) {
+        m_pathCache.clear();
+    }
+    m_pathCache[key] = object;
 }
 
 ObjectPtr Catalog::getObjectBySystemPath(const std::string &path)
@@ -111,20 +213,41 @@ bool Catalog::loadChildren()
     if(!Folder::mkDir(settingsPath, true)) {
         return false;
     }
-    // 1. Load factories
-    m_factories.push_back(ObjectFactoryUPtr(new ConnectionFactory()));
-    m_factories.push_back(ObjectFactoryUPtr(new DataStoreFactory()));
-    m_factories.push_back(ObjectFactoryUPtr(new SimpleDatasetFactory()));
-    m_factories.push_back(ObjectFactoryUPtr(new RasterFactory()));
-    m_factories.push_back(ObjectFactoryUPtr(new FileFactory()));
-    m_factories.push_back(ObjectFactoryUPtr(new FolderFactory()));
+
+    if(CatalogSnapshot::isEnabled()) {
+        m_snapshot.reset(new CatalogSnapshot(
+            File::formFileName(settingsPath, SNAPSHOT_FILE, SNAPSHOT_FILE_EXT)));
+        m_snapshot->load();
+    }
+
+    // 1. Load factories. The disabled factories are not created, so the GDAL
+    // drivers they need are not registered on mobile devices.
+    const Settings &settings = Settings::instance();
+    if(settings.getBool("catalog/factories/connections", true)) {
+        m_factories.push_back(ObjectFactoryUPtr(new ConnectionFactory()));
+    }
+    if(settings.getBool("catalog/factories/datastore", true)) {
+        m_factories.push_back(ObjectFactoryUPtr(new DataStoreFactory()));
+    }
+    if(settings.getBool("catalog/factories/simple_dataset", true)) {
+        m_factories.push_back(ObjectFactoryUPtr(new SimpleDatasetFactory()));
+    }
+    if(settings.getBool("catalog/factories/raster", true)) {
+        m_factories.push_back(ObjectFactoryUPtr(new RasterFactory()));
+    }
+    if(settings.getBool("catalog/factories/file", true)) {
+        m_factories.push_back(ObjectFactoryUPtr(new FileFactory()));
+    }
+    if(settings.getBool("catalog/factories/folder", true)) {
+        m_factories.push_back(ObjectFactoryUPtr(new FolderFactory()));
+    }
 
     // 2. Load root objects
     auto connectionsPath = File::formFileName(settingsPath, CONNECTIONS_DIR);
     auto parent = const_cast<Catalog*>(this);
-    m_children.push_back(ObjectPtr(new LocalConnections(parent, connectionsPath)));
-    m_children.push_back(ObjectPtr(new GISServerConnections(parent, connectionsPath)));
-    m_children.push_back(ObjectPtr(new DatabaseConnections(parent, connectionsPath)));
+    appendChild(ObjectPtr(new LocalConnections(parent, connectionsPath)));
+    appendChild(ObjectPtr(new GISServerConnections(parent, connectionsPath)));
+    appendChild(ObjectPtr(new DatabaseConnections(parent, connectionsPath)));
 
     m_childrenLoaded = true;
     return true;
@@ -141,22 +264,51 @@ void Catalog::freeResources()
     }
 }
 
-void Catalog::createObjects(ObjectPtr object, std::vector<std::string> &names)
+/**
+ * @brief Catalog::createObjects Creates catalog objects from folder listing.
+ * The factories add children one by one in the same order. For big folders the
+ * file system probes of factory are executed in parallel before the factory
+ * creates objects.
+ * @param object Container to add children.
+ * @param names Folder listing. The names of created objects are removed.
+ * @param progress Reports each factory finish. The children already created
+ * are available in container at this moment. If progress returns false the
+ * creation is canceled.
+ * @return false if canceled.
+ */
+bool Catalog::createObjects(ObjectPtr object, std::vector<std::string> &names,
+                            const Progress &progress)
 {
     if(names.empty()) {
-        return;
+        return true;
     }
 
     ObjectContainer * const container = ngsDynamicCast(ObjectContainer, object);
     if(nullptr == container) {
-        return;
+        return true;
     }
     // Check each factory for objects
+    double step = 0.0;
     for(const ObjectFactoryUPtr &factory : m_factories) {
-        if(factory->enabled()) {
-            factory->createObjects(container, names);
+        step++;
+        if(!factory->enabled()) {
+            continue;
+        }
+        if(names.size() >= PARALLEL_PROBE_MIN_NAMES && factory->hasProbe()) {
+            probeNames(factory.get(), container->path(), names);
+        }
+        factory->createObjects(container, names);
+
+        if(!progress.onProgress(COD_IN_PROCESS, step / m_factories.size(),
+                                _("%s loaded"), factory->name().c_str())) {
+            return false;
+        }
+        if(names.empty()) {
+            break;
         }
     }
+    progress.onProgress(COD_FINISHED, 1.0, _("Finished"));
+    return true;
 }
 
 std::string Catalog::separator()
@@ -21,9 +21,12 @@
 #ifndef NGSCATALOG_H
 #define NGSCATALOG_H
 
+#include "catalogsnapshot.h"
 #include "objectcontainer.h"
 #include "factories/objectfactory.h"
+#include "util/mutex.h"
 
+#include <map>
 #include <utility>
 
 namespace ngs {
@@ -39,13 +42,15 @@ public:
     virtual std::string fullName() const override;
     virtual ObjectPtr getObject(const std::string &path) override;
     virtual void freeResources();
-    virtual void createObjects(ObjectPtr object,
-                               std::vector<std::string> &names);
+    virtual bool createObjects(ObjectPtr object,
+                               std::vector<std::string> &names,
+                               const Progress &progress = Progress());
 
     bool isFileHidden(const std::string &path, const std::string &name) const;
     void setShowHidden(bool value);
     virtual ObjectPtr getObjectBySystemPath(const std::string &path);
     virtual bool loadChildren() override;
+    CatalogSnapshot *snapshot() const { return m_snapshot.get(); }
 
     // Object interface
 public:
@@ -66,9 +71,20 @@ private:
     Catalog(Catalog const&) = delete;
     Catalog &operator= (Catalog const&) = delete;
 
+private:
+    ObjectPtr getCachedObject(const std::string &key);
+    void addCachedObject(const std::string &key, ObjectPtr object,
+                         unsigned int version);
+
 protected:
     bool m_showHidden;
     mutable std::vector<ObjectFactoryUPtr> m_factories;
+    std::unique_ptr<CatalogSnapshot> m_snapshot;
+
+private:
+    std::map<std::string, std::weak_ptr<Object>> m_pathCache;
+    unsigned int m_pathCacheVersion;
+    Mutex m_pathCacheMutex;
 
 };
 
@@ -0,0 +1,301 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "catalogsnapshot.h"
+
+// std
+#include <cstring>
+
+// gdal
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include "file.h"
+#include "factories/objectfactory.h"
+#include "util/settings.h"
+
+namespace ngs {
+
+constexpr const char *SNAPSHOT_MAGIC = "NGCS";
+constexpr GUInt32 SNAPSHOT_VERSION = 1;
+constexpr GIntBig SNAPSHOT_MAX_SIZE = 16 * 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// SnapshotWriter
+//------------------------------------------------------------------------------
+
+class SnapshotWriter
+{
+public:
+    void add(GUInt32 value) { addData(&value, sizeof(value)); }
+    void add(GInt64 value) { addData(&value, sizeof(value)); }
+    void add(const std::string &value) {
+        add(static_cast<GUInt32>(value.size()));
+        addData(value.data(), value.size());
+    }
+    const std::string &data() const { return m_data; }
+
+private:
+    void addData(const void *value, size_t size) {
+        m_data.append(static_cast<const char*>(value), size);
+    }
+
+private:
+    std::string m_data;
+};
+
+//------------------------------------------------------------------------------
+// SnapshotReader
+//------------------------------------------------------------------------------
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(const GByte *data, size_t size) : m_data(data), m_size(size),
+        m_pos(0), m_failed(false) {}
+    bool isFailed() const { return m_failed; }
+    GUInt32 readUInt() {
+        GUInt32 value = 0;
+        readData(&value, sizeof(value));
+        return value;
+    }
+    GInt64 readInt64() {
+        GInt64 value = 0;
+        readData(&value, sizeof(value));
+        return value;
+    }
+    std::string readString() {
+        GUInt32 size = readUInt();
+        if(m_failed || size > m_size - m_pos) {
+            m_failed = true;
+            return "";
+        }
+        std::string value(reinterpret_cast<const char*>(m_data + m_pos), size);
+        m_pos += size;
+        return value;
+    }
+
+private:
+    void readData(void *value, size_t size) {
+        if(m_failed || size > m_size - m_pos) {
+            m_failed = true;
+            return;
+        }
+        std::memcpy(value, m_data + m_pos, size);
+        m_pos += size;
+    }
+
+private:
+    const GByte *m_data;
+    size_t m_size, m_pos;
+    bool m_failed;
+};
+
+//------------------------------------------------------------------------------
+// CatalogSnapshot
+//------------------------------------------------------------------------------
+
+CatalogSnapshot::CatalogSnapshot(const std::string &path) :
+    m_path(path),
+    m_foldersMtime(0),
+    m_foldersSize(0),
+    m_changed(false),
+    m_typesVersion(0)
+{
+}
+
+/**
+ * @brief CatalogSnapshot::load Reads snapshot file and fills the connection
+ * file types cache.
+ * @return true on success.
+ */
+bool CatalogSnapshot::load()
+{
+    GByte *data = nullptr;
+    vsi_l_offset size = 0;
+    if(!VSIIngestFile(nullptr, m_path.c_str(), &data, &size,
+                      SNAPSHOT_MAX_SIZE)) {
+        return false;
+    }
+
+    SnapshotReader reader(data, static_cast<size_t>(size));
+    std::string magic = reader.readString();
+    GUInt32 version = reader.readUInt();
+    if(magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) {
+        VSIFree(data);
+        CPLDebug("ngstore", "Catalog snapshot %s is not supported", m_path.c_str());
+        return false;
+    }
+
+    std::string foldersPath = reader.readString();
+    time_t foldersMtime = static_cast<time_t>(reader.readInt64());
+    GIntBig foldersSize = reader.readInt64();
+    std::vector<FolderItem> folders;
+    GUInt32 foldersCount = reader.readUInt();
+    for(GUInt32 i = 0; i < foldersCount && !reader.isFailed(); ++i) {
+        FolderItem folder;
+        folder.name = reader.readString();
+        folder.path = reader.readString();
+        folders.push_back(folder);
+    }
+
+    std::vector<ConnectionFileType> types;
+    GUInt32 typesCount = reader.readUInt();
+    for(GUInt32 i = 0; i < typesCount && !reader.isFailed(); ++i) {
+        ConnectionFileType type;
+        type.path = reader.readString();
+        type.mtime = static_cast<time_t>(reader.readInt64());
+        type.size = reader.readInt64();
+        type.type = static_cast<enum ngsCatalogObjectType>(reader.readUInt());
+        types.push_back(type);
+    }
+    VSIFree(data);
+
+    if(reader.isFailed()) {
+        CPLDebug("ngstore", "Catalog snapshot %s is corrupted", m_path.c_str());
+        return false;
+    }
+
+    addConnectionFileTypes(types);
+
+    MutexHolder holder(m_mutex);
+    m_foldersPath = foldersPath;
+    m_foldersMtime = foldersMtime;
+    m_foldersSize = foldersSize;
+    m_folders = folders;
+    m_typesVersion = connectionFileTypesVersion();
+    m_changed = false;
+    return true;
+}
+
+/**
+ * @brief CatalogSnapshot::save Writes snapshot to temporary file and renames it,
+ * so the snapshot file is always complete.
+ * @return true on success.
+ */
+bool CatalogSnapshot::save()
+{
+    std::vector<ConnectionFileType> types = connectionFileTypes();
+
+    SnapshotWriter writer;
+    writer.add(std::string(SNAPSHOT_MAGIC));
+    writer.add(SNAPSHOT_VERSION);
+    {
+        MutexHolder holder(m_mutex);
+        writer.add(m_foldersPath);
+        writer.add(static_cast<GInt64>(m_foldersMtime));
+        writer.add(static_cast<GInt64>(m_foldersSize));
+        writer.add(static_cast<GUInt32>(m_folders.size()));
+        for(const FolderItem &folder : m_folders) {
+            writer.add(folder.name);
+            writer.add(folder.path);
+        }
+        m_typesVersion = connectionFileTypesVersion();
+        m_changed = false;
+    }
+
+    writer.add(static_cast<GUInt32>(types.size()));
+    for(const ConnectionFileType &type : types) {
+        writer.add(type.path);
+        writer.add(static_cast<GInt64>(type.mtime));
+        writer.add(static_cast<GInt64>(type.size));
+        writer.add(static_cast<GUInt32>(type.type));
+    }
+
+    const std::string &data = writer.data();
+    return File::replaceFile(m_path, data.data(), data.size());
+}
+
+/**
+ * @brief CatalogSnapshot::saveIfChanged Saves snapshot if the folders or the
+ * connection file types were changed after load or previous save.
+ * @return true on success.
+ */
+bool CatalogSnapshot::saveIfChanged()
+{
+    {
+        MutexHolder holder(m_mutex);
+        if(!m_changed && m_typesVersion == connectionFileTypesVersion()) {
+            return true;
+        }
+    }
+    return save();
+}
+
+/**
+ * @brief CatalogSnapshot::folders Returns the folders stored for connections
+ * file.
+ * @param path Connections file path.
+ * @param items Folders array.
+ * @return false if the snapshot has no folders for this file or the file was
+ * changed.
+ */
+bool CatalogSnapshot::folders(const std::string &path,
+                              std::vector<FolderItem> &items) const
+{
+    time_t mtime;
+    GIntBig size;
+    if(!stamp(path, mtime, size)) {
+        return false;
+    }
+
+    MutexHolder holder(m_mutex);
+    if(m_foldersPath != path || m_foldersMtime != mtime ||
+            m_foldersSize != size) {
+        return false;
+    }
+    items = m_folders;
+    return true;
+}
+
+void CatalogSnapshot::setFolders(const std::string &path,
+                                 const std::vector<FolderItem> &items)
+{
+    time_t mtime = 0;
+    GIntBig size = 0;
+    stamp(path, mtime, size);
+
+    MutexHolder holder(m_mutex);
+    m_foldersPath = path;
+    m_foldersMtime = mtime;
+    m_foldersSize = size;
+    m_folders = items;
+    m_changed = true;
+}
+
+bool CatalogSnapshot::isEnabled()
+{
+    return CPLTestBool(Settings::getConfigOption("NGS_CATALOG_SNAPSHOT",
+                                                 "OFF").c_str());
+}
+
+bool CatalogSnapshot::stamp(const std::string &path, time_t &mtime,
+                            GIntBig &size)
+{
+    VSIStatBufL sbuf;
+    if(VSIStatL(path.c_str(), &sbuf) != 0) {
+        return false;
+    }
+    mtime = sbuf.st_mtime;
+    size = static_cast<GIntBig>(sbuf.st_size);
+    return true;
+}
+
+} // namespace ngs
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSCATALOGSNAPSHOT_H
+#define NGSCATALOGSNAPSHOT_H
+
+// std
+#include <ctime>
+#include <string>
+#include <vector>
+
+// gdal
+#include "cpl_port.h"
+
+#include "util/mutex.h"
+
+namespace ngs {
+
+/**
+ * @brief The CatalogSnapshot class Keeps the catalog root items in binary file
+ * loaded by one read on start. The snapshot has local connection folders
+ * and connection file types. Each item is checked with its source file time and
+ * size, so the snapshot never gives the outdated result. Enabled by
+ * CATALOG_SNAPSHOT option of ngsInit.
+ */
+class CatalogSnapshot
+{
+public:
+    typedef struct _folderItem {
+        std::string name;
+        std::string path;
+    } FolderItem;
+
+public:
+    explicit CatalogSnapshot(const std::string &path);
+    bool load();
+    bool save();
+    bool saveIfChanged();
+    bool folders(const std::string &path, std::vector<FolderItem> &items) const;
+    void setFolders(const std::string &path, const std::vector<FolderItem> &items);
+
+    // static
+public:
+    static bool isEnabled();
+
+private:
+    static bool stamp(const std::string &path, time_t &mtime, GIntBig &size);
+
+private:
+    std::string m_path;
+    std::string m_foldersPath;
+    time_t m_foldersMtime;
+    GIntBig m_foldersSize;
+    std::vector<FolderItem> m_folders;
+    bool m_changed;
+    unsigned int m_typesVersion;
+    mutable Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSCATALOGSNAPSHOT_H
@@ -22,12 +22,112 @@
 #include "catalog/file.h"
 #include "catalog/ngw.h"
 #include "ngstore/catalog/filter.h"
-#include "util/authstore.h"
 #include "util/error.h"
+#include "util/mutex.h"
 #include "util/stringutil.h"
+#include "util/threadpool.h"
+
+// std
+#include <algorithm>
+#include <ctime>
+#include <map>
+#include <memory>
 
 namespace ngs {
 
+constexpr const char *CHECK_CONNECT_TIMEOUT = "30";
+constexpr const char *CHECK_TIMEOUT = "65";
+constexpr const char *CHECK_MAX_RETRY = "5";
+constexpr const char *BATCH_CHECK_CONNECT_TIMEOUT = "5";
+constexpr const char *BATCH_CHECK_TIMEOUT = "10";
+constexpr const char *BATCH_CHECK_MAX_RETRY = "0";
+constexpr unsigned char BATCH_CHECK_THREAD_COUNT = 8;
+constexpr time_t CONNECTION_CHECK_TTL = 60; // seconds
+
+//------------------------------------------------------------------------------
+// Connection checks cache
+//------------------------------------------------------------------------------
+
+typedef struct _checkResult {
+    bool result;
+    std::string message;
+    time_t time;
+} CheckResult;
+
+static Mutex gChecksMutex;
+static std::map<std::string, CheckResult> gChecks;
+
+static std::string checkKey(const ConnectionCheck &check)
+{
+    // Password is kept in cache key as hash only
+    return std::to_string(check.type) + "|" +
+            check.options.asString(URL_KEY) + "|" +
+            check.options.asString(KEY_LOGIN) + "|" +
+            (check.options.asBool(KEY_IS_GUEST, false) ? "guest" :
+                md5(check.options.asString(KEY_PASSWORD)));
+}
+
+static bool cachedCheck(const std::string &key, ConnectionCheck &check)
+{
+    MutexHolder holder(gChecksMutex);
+    auto it = gChecks.find(key);
+    if(it == gChecks.end()) {
+        return false;
+    }
+    if(time(nullptr) - it->second.time > CONNECTION_CHECK_TTL) {
+        gChecks.erase(it);
+        return false;
+    }
+    check.result = it->second.result;
+    check.message = it->second.message;
+    return true;
+}
+
+static void storeCheck(const std::string &key, const ConnectionCheck &check)
+{
+    MutexHolder holder(gChecksMutex);
+    gChecks[key] = {check.result, check.message, time(nullptr)};
+}
+
+//------------------------------------------------------------------------------
+// CheckData
+//------------------------------------------------------------------------------
+
+class CheckData : public ThreadData
+{
+public:
+    CheckData(ConnectionCheck *check, const std::string &key,
+              const ConnectionCheckFunc &callback, Mutex *callbackMutex) :
+        ThreadData(false), m_check(check), m_key(key), m_callback(callback),
+        m_callbackMutex(callbackMutex) {}
+    virtual ~CheckData() = default;
+    ConnectionCheck *m_check;
+    std::string m_key;
+    ConnectionCheckFunc m_callback;
+    Mutex *m_callbackMutex;
+};
+
+static bool checkThreadFunc(ThreadData *threadData)
+{
+    CheckData *data = static_cast<CheckData*>(threadData);
+    ConnectionCheck *check = data->m_check;
+    check->result = ConnectionFactory::checkRemoteConnection(check->type,
+                                                             check->options);
+    check->message = check->result ? "" : getLastError();
+    storeCheck(data->m_key, *check);
+
+    if(data->m_callback) {
+        MutexHolder holder(*data->m_callbackMutex);
+        data->m_callback(*check);
+    }
+    // The result is reported, so the check is not repeated on fail
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// ConnectionFactory
+//------------------------------------------------------------------------------
+
 ConnectionFactory::ConnectionFactory() : ObjectFactory()
 {
     m_wmsSupported = Filter::getGDALDriver(CAT_CONTAINER_WMS);
@@ -76,6 +176,21 @@ void ConnectionFactory::createObjects(ObjectContainer * const container,
     }
 }
 
+bool ConnectionFactory::hasProbe() const
+{
+    return m_wmsSupported || m_wfsSupported || m_ngwSupported || m_pgSupported;
+}
+
+void ConnectionFactory::probe(const std::string &path, const std::string &name)
+{
+    std::string ext = File::getExtension(name);
+    if(compare(ext, Filter::extension(CAT_CONTAINER_NGW)) ||
+            compare(ext, Filter::extension(CAT_CONTAINER_POSTGRES))) {
+        // The type is cached by typeFromConnectionFile
+        typeFromConnectionFile(File::formFileName(path, name));
+    }
+}
+
 bool ConnectionFactory::createRemoteConnection(const enum ngsCatalogObjectType type,
                                                const std::string &path,
                                                const Options &options)
@@ -146,23 +261,23 @@ bool ConnectionFactory::checkRemoteConnection(const enum ngsCatalogObjectType ty
             }
         }
 
+        // Auth store is not used, as it holds the auth of opened connection to
+        // the same url, and several checks of one url may run simultaneously
         CPLStringList requestOptions;
         std::string headers = "Accept: */*";
-        Options authOptions;
-        authOptions.add(KEY_TYPE, "basic");
-        authOptions.add(KEY_LOGIN, login);
-        authOptions.add(KEY_PASSWORD, password);
-        AuthStore::authAdd(url, authOptions);
-        std::string auth = AuthStore::authHeader(url);
-        AuthStore::authRemove(url);
-        if(!auth.empty()) {
-            headers += "\r\n";
-            headers += auth;
-        }
+        std::string userPwd = login + ":" + password;
+        char *encoded = CPLBase64Encode(static_cast<int>(userPwd.size()),
+                                        reinterpret_cast<const GByte*>(userPwd.data()));
+        headers += "\r\nAuthorization: Basic ";
+        headers += encoded;
+        CPLFree(encoded);
         requestOptions.AddNameValue("HEADERS", headers.c_str());
-        requestOptions.AddNameValue("CONNECTTIMEOUT", "30");
-        requestOptions.AddNameValue("TIMEOUT", "65");
-        requestOptions.AddNameValue("MAX_RETRY", "5");
+        requestOptions.AddNameValue("CONNECTTIMEOUT",
+            options.asString("CONNECTTIMEOUT", CHECK_CONNECT_TIMEOUT).c_str());
+        requestOptions.AddNameValue("TIMEOUT",
+            options.asString("TIMEOUT", CHECK_TIMEOUT).c_str());
+        requestOptions.AddNameValue("MAX_RETRY",
+            options.asString("MAX_RETRY", CHECK_MAX_RETRY).c_str());
         requestOptions.AddNameValue("RETRY_DELAY", "5");
 
         CPLJSONDocument checkReq;
@@ -187,4 +302,68 @@ bool ConnectionFactory::checkRemoteConnection(const enum ngsCatalogObjectType ty
     }
 }
 
+/**
+ * @brief ConnectionFactory::checkRemoteConnections Check several connections
+ * simultaneously with short timeouts. Results are cached for
+ * CONNECTION_CHECK_TTL seconds, so repeated checks of the connections list do
+ * not go to the network.
+ * @param checks Connections to check. The result and message are set on
+ * return.
+ * @param callback Executed as soon as each check completed. Cached results are
+ * reported first from the caller thread.
+ * @param useCache If false the connections are checked even if cached result
+ * exists.
+ */
+void ConnectionFactory::checkRemoteConnections(
+        std::vector<ConnectionCheck> &checks, ConnectionCheckFunc callback,
+        bool useCache)
+{
+    Mutex callbackMutex;
+    std::vector<std::unique_ptr<CheckData>> jobs;
+    for(ConnectionCheck &check : checks) {
+        std::string key = checkKey(check);
+        if(useCache && cachedCheck(key, check)) {
+            if(callback) {
+                callback(check);
+            }
+            continue;
+        }
+
+        if(!check.options.hasKey("CONNECTTIMEOUT")) {
+            check.options.add("CONNECTTIMEOUT", BATCH_CHECK_CONNECT_TIMEOUT);
+        }
+        if(!check.options.hasKey("TIMEOUT")) {
+            check.options.add("TIMEOUT", BATCH_CHECK_TIMEOUT);
+        }
+        if(!check.options.hasKey("MAX_RETRY")) {
+            check.options.add("MAX_RETRY", BATCH_CHECK_MAX_RETRY);
+        }
+        jobs.emplace_back(new CheckData(&check, key, callback, &callbackMutex));
+    }
+
+    if(jobs.empty()) {
+        return;
+    }
+
+    ThreadPool threadPool;
+    threadPool.init(static_cast<unsigned char>(
+                        std::min(jobs.size(),
+                                 static_cast<size_t>(BATCH_CHECK_THREAD_COUNT))),
+                    checkThreadFunc, 1, false, WorkerClass::NETWORK);
+    for(auto &job : jobs) {
+        threadPool.addThreadData(job.get());
+    }
+    threadPool.waitComplete(Progress());
+}
+
+/**
+ * @brief ConnectionFactory::clearConnectionChecks Forget cached results of
+ * connection checks.
+ */
+void ConnectionFactory::clearConnectionChecks()
+{
+    MutexHolder holder(gChecksMutex);
+    gChecks.clear();
+}
+
 }
@@ -23,8 +23,28 @@
 
 #include "objectfactory.h"
 
+// std
+#include <functional>
+
 namespace ngs {
 
+/**
+ * @brief The ConnectionCheck struct Connection to check in batch and the check
+ * result.
+ */
+typedef struct _connectionCheck {
+    enum ngsCatalogObjectType type;
+    std::string path;
+    Options options;
+    bool result;
+    std::string message;
+} ConnectionCheck;
+
+/**
+ * Connection check completion function. Executed from worker threads, but not
+ * simultaneously.
+ */
+using ConnectionCheckFunc = std::function<void(const ConnectionCheck &check)>;
 
 class ConnectionFactory : public ObjectFactory
 {
@@ -36,6 +56,9 @@ public:
     virtual std::string name() const override;
     virtual void createObjects(ObjectContainer * const container,
                                std::vector<std::string> &names) override;
+    virtual bool hasProbe() const override;
+    virtual void probe(const std::string &path,
+                       const std::string &name) override;
     // static
 public:
     static bool createRemoteConnection(const enum ngsCatalogObjectType type,
@@ -43,6 +66,10 @@ public:
                                        const Options &options);
     static bool checkRemoteConnection(const enum ngsCatalogObjectType type,
                                       const Options &options);
+    static void checkRemoteConnections(std::vector<ConnectionCheck> &checks,
+                                       ConnectionCheckFunc callback,
+                                       bool useCache = true);
+    static void clearConnectionChecks();
 protected:
     bool m_wmsSupported, m_wfsSupported, m_ngwSupported, m_pgSupported;
 };
@@ -49,14 +49,13 @@ void FolderFactory::createObjects(ObjectContainer * const container,
     auto it = names.begin();
     while(it != names.end()) {
         std::string path = File::formFileName(container->path(), *it);
-        if(Folder::isDir(path)) {
-            if(container->type() == CAT_CONTAINER_ARCHIVE_DIR) { // Check if this is archive folder
+        if(isDir(path)) {
+            if(container->type() == CAT_CONTAINER_ARCHIVE_DIR ||
+               container->type() == CAT_CONTAINER_ARCHIVE_ZIP) { // Check if this is archive folder
+                // The container path already has archive prefix
                 if(m_zipSupported) {
-                    std::string vsiPath = Archive::pathPrefix(
-                                CAT_CONTAINER_ARCHIVE_ZIP);
-                    vsiPath += path;
                     addChild(container,
-                             ObjectPtr(new ArchiveFolder(container, *it, vsiPath)));
+                             ObjectPtr(new ArchiveFolder(container, *it, path)));
                     it = names.erase(it);
                     continue;
                 }
@@ -82,4 +81,31 @@ void FolderFactory::createObjects(ObjectContainer * const container,
     }
 }
 
+bool FolderFactory::hasProbe() const
+{
+    return true;
+}
+
+void FolderFactory::probe(const std::string &path, const std::string &name)
+{
+    std::string filePath = File::formFileName(path, name);
+    bool result = Folder::isDir(filePath);
+    MutexHolder holder(m_probedDirsMutex);
+    m_probedDirs[filePath] = result;
+}
+
+bool FolderFactory::isDir(const std::string &path)
+{
+    {
+        MutexHolder holder(m_probedDirsMutex);
+        auto it = m_probedDirs.find(path);
+        if(it != m_probedDirs.end()) {
+            bool result = it->second;
+            m_probedDirs.erase(it);
+            return result;
+        }
+    }
+    return Folder::isDir(path);
+}
+
 }
@@ -23,6 +23,8 @@
 
 #include "objectfactory.h"
 
+#include "util/mutex.h"
+
 namespace ngs {
 
 class FolderFactory : public ObjectFactory
@@ -35,8 +37,16 @@ public:
     virtual std::string name() const override;
     virtual void createObjects(ObjectContainer * const container,
                                std::vector<std::string> &names) override;
+    virtual bool hasProbe() const override;
+    virtual void probe(const std::string &path,
+                       const std::string &name) override;
+private:
+    bool isDir(const std::string &path);
+
 private:
     bool m_zipSupported;
+    std::map<std::string, bool> m_probedDirs;
+    Mutex m_probedDirsMutex;
 };
 
 }
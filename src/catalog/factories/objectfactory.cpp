@@ -25,9 +25,12 @@
 // gdal
 #include "cpl_json.h"
 #include "cpl_port.h"
+#include "cpl_vsi.h"
 
+#include "api_priv.h"
 #include "catalog/file.h"
 #include "catalog/folder.h"
+#include "util/mutex.h"
 #include "util/stringutil.h"
 
 namespace ngs {
@@ -47,14 +50,37 @@ void ObjectFactory::setEnabled(bool enabled)
     m_enabled = enabled;
 }
 
+/**
+ * @brief ObjectFactory::hasProbe Returns true if factory reads file system
+ * while creating objects. Such factory implements probe.
+ * @return true if probe should be executed before createObjects.
+ */
+bool ObjectFactory::hasProbe() const
+{
+    return false;
+}
+
+/**
+ * @brief ObjectFactory::probe Reads the file information which createObjects
+ * needs and keeps it in factory. For big folders the probes execute in
+ * parallel before createObjects.
+ * @param path Folder path.
+ * @param name File name in folder.
+ */
+void ObjectFactory::probe(const std::string &path, const std::string &name)
+{
+    ngsUnused(path);
+    ngsUnused(name);
+}
+
 void ObjectFactory::addChild(ObjectContainer * const container, ObjectPtr object)
 {
     container->addChild(object);
 }
 
 ObjectFactory::FORMAT_RESULT ObjectFactory::isFormatSupported(
-        const std::string &name, std::vector<std::string> extensions,
-        FORMAT_EXT testExts)
+        const std::string &name, const std::vector<std::string> &extensions,
+        const FORMAT_EXT &testExts)
 {
     ObjectFactory::FORMAT_RESULT out;
     out.isSupported = false;
@@ -96,43 +122,141 @@ ObjectFactory::FORMAT_RESULT ObjectFactory::isFormatSupported(
     return out;
 }
 
-void ObjectFactory::checkAdditionalSiblings(const std::string &path,
+/**
+ * @brief ObjectFactory::checkAdditionalSiblings Finds the sibling files like
+ * name + nameAdd in folder listing. The file system is not queried.
+ * @param nameExts Folder listing grouped by base name.
+ * @param name Main file name.
+ * @param nameAdds Sibling file suffixes.
+ * @param siblingFiles Found sibling names are added to this array.
+ */
+void ObjectFactory::checkAdditionalSiblings(const nameExtMap &nameExts,
                                             const std::string &name,
                                             const std::vector<std::string> &nameAdds,
                                             std::vector<std::string> &siblingFiles)
 {
     for(const std::string &nameAdd : nameAdds) {
         std::string newName = name + nameAdd;
-        if(Folder::isExists(File::formFileName(path, newName))) {
-            siblingFiles.push_back(newName);
+        auto it = nameExts.find(File::getBaseName(newName));
+        if(it == nameExts.end()) {
+            continue;
+        }
+        std::string ext = File::getExtension(newName);
+        for(const std::string &itemExt : it->second) {
+            if(itemExt == ext) {
+                siblingFiles.push_back(newName);
+                break;
+            }
         }
     }
 }
 
-void ObjectFactory::eraseNames(const std::string &name,
-                               const std::vector<std::string> &siblingFiles,
+void ObjectFactory::addProcessedNames(const std::string &name,
+                                      const std::vector<std::string> &siblingFiles,
+                                      std::set<std::string> &processedNames)
+{
+    processedNames.insert(name);
+    processedNames.insert(siblingFiles.begin(), siblingFiles.end());
+}
+
+/**
+ * @brief ObjectFactory::eraseNames Removes the names used by created objects
+ * from folder listing in one pass.
+ * @param processedNames Names of created objects and its sibling files.
+ * @param names Folder listing.
+ */
+void ObjectFactory::eraseNames(const std::set<std::string> &processedNames,
                                std::vector<std::string> &names)
 {
-    auto lastItem = names.end();
-    for(const auto& siblingFile : siblingFiles) {
-        lastItem = std::remove(names.begin(), lastItem, siblingFile);
+    if(processedNames.empty()) {
+        return;
     }
-    lastItem = std::remove(names.begin(), lastItem, name);
 
-    if(lastItem != names.end()) {
-        names.erase(lastItem, names.end());
-    }
+    auto lastItem = std::remove_if(names.begin(), names.end(),
+        [&processedNames](const std::string &name) {
+            return processedNames.find(name) != processedNames.end();
+        });
+    names.erase(lastItem, names.end());
 }
 
+static std::map<std::string, ConnectionFileType> gConnectionTypes;
+static unsigned int gConnectionTypesVersion = 0;
+static Mutex gConnectionTypesMutex;
+
+/**
+ * @brief typeFromConnectionFile Returns connection type stored in connection
+ * file. The type is cached while the file modification time and size are the
+ * same, so each connection file is parsed once by all factories.
+ * @param path Connection file path.
+ * @return Connection type or CAT_UNKNOWN.
+ */
 enum ngsCatalogObjectType typeFromConnectionFile(const std::string &path)
 {
+    VSIStatBufL sbuf;
+    if(VSIStatL(path.c_str(), &sbuf) != 0) {
+        return CAT_UNKNOWN;
+    }
+
+    {
+        MutexHolder holder(gConnectionTypesMutex);
+        auto it = gConnectionTypes.find(path);
+        if(it != gConnectionTypes.end() && it->second.mtime == sbuf.st_mtime &&
+                it->second.size == static_cast<GIntBig>(sbuf.st_size)) {
+            return it->second.type;
+        }
+    }
+
+    enum ngsCatalogObjectType type = CAT_UNKNOWN;
     CPLJSONDocument connectionFile;
     if(connectionFile.Load(path)) {
-        return static_cast<enum ngsCatalogObjectType>(
-                    connectionFile.GetRoot().GetInteger(
-                        KEY_TYPE, CAT_UNKNOWN));
+        type = static_cast<enum ngsCatalogObjectType>(
+                    connectionFile.GetRoot().GetInteger(KEY_TYPE, CAT_UNKNOWN));
+    }
+
+    MutexHolder holder(gConnectionTypesMutex);
+    gConnectionTypes[path] = {path, sbuf.st_mtime,
+                              static_cast<GIntBig>(sbuf.st_size), type};
+    gConnectionTypesVersion++;
+    return type;
+}
+
+/**
+ * @brief connectionFileTypes Returns the cached connection file types.
+ * @return Array of connection file types.
+ */
+std::vector<ConnectionFileType> connectionFileTypes()
+{
+    MutexHolder holder(gConnectionTypesMutex);
+    std::vector<ConnectionFileType> out;
+    out.reserve(gConnectionTypes.size());
+    for(const auto &item : gConnectionTypes) {
+        out.push_back(item.second);
     }
-    return CAT_UNKNOWN;
+    return out;
+}
+
+/**
+ * @brief addConnectionFileTypes Fills connection file types cache, i.e. from
+ * catalog snapshot. The types are checked with file time and size on use.
+ * @param types Array of connection file types.
+ */
+void addConnectionFileTypes(const std::vector<ConnectionFileType> &types)
+{
+    MutexHolder holder(gConnectionTypesMutex);
+    for(const ConnectionFileType &type : types) {
+        gConnectionTypes.insert(std::make_pair(type.path, type));
+    }
+}
+
+/**
+ * @brief connectionFileTypesVersion Returns the value changed when connection
+ * file is parsed.
+ * @return Cache version.
+ */
+unsigned int connectionFileTypesVersion()
+{
+    MutexHolder holder(gConnectionTypesMutex);
+    return gConnectionTypesVersion;
 }
 
 }
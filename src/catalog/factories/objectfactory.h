@@ -21,6 +21,8 @@
 #ifndef NGSOBJECTFACTORY_H
 #define NGSOBJECTFACTORY_H
 
+#include <ctime>
+#include <set>
 #include <vector>
 #include <utility>
 
@@ -45,6 +47,8 @@ public:
     virtual std::string name() const = 0;
     virtual void createObjects(ObjectContainer* const container,
                                std::vector<std::string> &names) = 0;
+    virtual bool hasProbe() const;
+    virtual void probe(const std::string &path, const std::string &name);
 
     bool enabled() const;
     void setEnabled(bool enabled);
@@ -58,14 +62,16 @@ protected:
     } FORMAT_RESULT;
 
     static FORMAT_RESULT isFormatSupported(const std::string &name,
-                           std::vector<std::string> extensions,
-                           FORMAT_EXT testExts);
-    static void checkAdditionalSiblings(const std::string &path,
+                           const std::vector<std::string> &extensions,
+                           const FORMAT_EXT &testExts);
+    static void checkAdditionalSiblings(const nameExtMap &nameExts,
                                         const std::string &name,
                                         const std::vector<std::string> &nameAdds,
                                         std::vector<std::string> &siblingFiles);
-    static void eraseNames(const std::string &name,
-                           const std::vector<std::string> &siblingFiles,
+    static void addProcessedNames(const std::string &name,
+                                  const std::vector<std::string> &siblingFiles,
+                                  std::set<std::string> &processedNames);
+    static void eraseNames(const std::set<std::string> &processedNames,
                            std::vector<std::string> &names);
 
 private:
@@ -75,6 +81,17 @@ private:
 using ObjectFactoryUPtr = std::unique_ptr<ObjectFactory>;
 enum ngsCatalogObjectType typeFromConnectionFile(const std::string &path);
 
+typedef struct _connectionFileType {
+    std::string path;
+    time_t mtime;
+    GIntBig size;
+    enum ngsCatalogObjectType type;
+} ConnectionFileType;
+
+std::vector<ConnectionFileType> connectionFileTypes();
+void addConnectionFileTypes(const std::vector<ConnectionFileType> &types);
+unsigned int connectionFileTypesVersion();
+
 }
 
 #endif // NGSOBJECTFACTORY_H
@@ -86,6 +86,7 @@ void RasterFactory::createObjects(ObjectContainer * const container,
         ++it;
     }
 
+    std::set<std::string> processedNames;
     for(const auto &nameExtsItem : nameExts) {
         if(m_tiffSupported) {
             FORMAT_RESULT result = isFormatSupported(
@@ -93,20 +94,20 @@ void RasterFactory::createObjects(ObjectContainer * const container,
             if(result.isSupported) {
                 std::string path = File::formFileName(container->path(),
                                                       result.name);
-                checkAdditionalSiblings(container->path(), result.name, tifAdds,
+                checkAdditionalSiblings(nameExts, result.name, tifAdds,
                                         result.siblingFiles);
                 addChildInternal(container, result.name, path, CAT_RASTER_TIFF,
-                         result.siblingFiles, names);
+                         result.siblingFiles, processedNames);
             }
             result = isFormatSupported(
                         nameExtsItem.first, nameExtsItem.second, tiffExt);
             if(result.isSupported) {
                 std::string path = File::formFileName(container->path(),
                                                       result.name);
-                checkAdditionalSiblings(container->path(), result.name, tifAdds,
+                checkAdditionalSiblings(nameExts, result.name, tifAdds,
                                         result.siblingFiles);
                 addChildInternal(container, result.name, path, CAT_RASTER_TIFF,
-                         result.siblingFiles, names);
+                         result.siblingFiles, processedNames);
             }
         }
 
@@ -120,11 +121,12 @@ void RasterFactory::createObjects(ObjectContainer * const container,
                     std::vector<std::string> siblingFiles;
                     addChildInternal(container, nameExtsItem.first + "." +
                          Filter::extension(type), path, type,
-                         siblingFiles, names);
+                         siblingFiles, processedNames);
                 }
             }
         }
     }
+    eraseNames(processedNames, names);
 }
 
 bool RasterFactory::createRemoteConnection(const enum ngsCatalogObjectType type,
@@ -182,7 +184,8 @@ bool RasterFactory::createRemoteConnection(const enum ngsCatalogObjectType type,
         CPLJSONObject user;
         for(auto it = options.begin(); it != options.end(); ++it) {
             if(comparePart(it->first, USER_PREFIX_KEY, USER_PREFIX_KEY_LEN)) {
-                user.Add(it->first.substr(USER_PREFIX_KEY_LEN), it->second);
+                user.Add(it->first.substr(USER_PREFIX_KEY_LEN),
+                         it->second.text);
             }
         }
         root.Add(USER_KEY, user);
@@ -200,12 +203,12 @@ void RasterFactory::addChildInternal(ObjectContainer * const container,
                                     const std::string &path,
                                     enum ngsCatalogObjectType subType,
                                     const std::vector<std::string> &siblingFiles,
-                                    std::vector<std::string> &names)
+                                    std::set<std::string> &processedNames)
 {
     ObjectFactory::addChild(container,
                             ObjectPtr(new Raster(siblingFiles, container,
                                                  subType, name, path)));
-    eraseNames(name, siblingFiles, names);
+    addProcessedNames(name, siblingFiles, processedNames);
 }
 
 } // namespace ngs
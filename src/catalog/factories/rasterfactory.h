@@ -46,7 +46,7 @@ private:
                           const std::string &path,
                           enum ngsCatalogObjectType subType,
                           const std::vector<std::string> &siblingFiles,
-                          std::vector<std::string> &names);
+                          std::set<std::string> &processedNames);
 
 private:
     bool m_tiffSupported, m_wmstmsSupported;
@@ -78,6 +78,7 @@ void SimpleDatasetFactory::createObjects(ObjectContainer * const container,
         ++it;
     }
 
+    std::set<std::string> processedNames;
     for(const auto& nameExtsItem : nameExts) {
 
         // Check if ESRI Shapefile
@@ -89,7 +90,7 @@ void SimpleDatasetFactory::createObjects(ObjectContainer * const container,
                                                       result.name, "");
                 addChildInternal(container, result.name, path,
                                  CAT_FC_ESRI_SHAPEFILE, result.siblingFiles,
-                                 names);
+                                 processedNames);
             }
         }
 
@@ -101,7 +102,8 @@ void SimpleDatasetFactory::createObjects(ObjectContainer * const container,
                 std::string path = File::formFileName(container->path(),
                                                       result.name, "");
                 addChildInternal(container, result.name, path,
-                                 CAT_FC_MAPINFO_TAB, result.siblingFiles, names);
+                                 CAT_FC_MAPINFO_TAB, result.siblingFiles,
+                                 processedNames);
             }
 
             // Check if MapInfo mif/mid
@@ -111,7 +113,8 @@ void SimpleDatasetFactory::createObjects(ObjectContainer * const container,
                 std::string path = File::formFileName(container->path(),
                                                       result.name, "");
                 addChildInternal(container, result.name, path,
-                                 CAT_FC_MAPINFO_MIF, result.siblingFiles, names);
+                                 CAT_FC_MAPINFO_MIF, result.siblingFiles,
+                                 processedNames);
             }
         }
 
@@ -124,10 +127,11 @@ void SimpleDatasetFactory::createObjects(ObjectContainer * const container,
                 std::string path = File::formFileName(container->path(),
                                                       result.name, "");
                 addChildInternal(container, result.name, path, CAT_FC_GEOJSON,
-                                 result.siblingFiles, names);
+                                 result.siblingFiles, processedNames);
             }
         }
     }
+    eraseNames(processedNames, names);
 }
 
 void SimpleDatasetFactory::addChildInternal(ObjectContainer * const container,
@@ -135,12 +139,12 @@ void SimpleDatasetFactory::addChildInternal(ObjectContainer * const container,
                                     const std::string &path,
                                     enum ngsCatalogObjectType subType,
                                     const std::vector<std::string> &siblingFiles,
-                                    std::vector<std::string> &names)
+                                    std::set<std::string> &processedNames)
 {
     ObjectFactory::addChild(container,
                             ObjectPtr(new SimpleDataset(subType, siblingFiles,
                                                         container, name, path)));
-    eraseNames(name, siblingFiles, names);
+    addProcessedNames(name, siblingFiles, processedNames);
 }
 
 } // namespace ngs
@@ -41,7 +41,7 @@ private:
                   const std::string &path,
                   enum ngsCatalogObjectType subType,
                   const std::vector<std::string> &siblingFiles,
-                  std::vector<std::string> &names);
+                  std::set<std::string> &processedNames);
 
 private:
     bool m_shpSupported, m_miSupported, m_geojsonSupported;
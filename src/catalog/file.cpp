@@ -20,6 +20,9 @@
  ****************************************************************************/
 #include "file.h"
 
+// std
+#include <algorithm>
+
 #include "util/error.h"
 #include "util/notify.h"
 #include "util/stringutil.h"
@@ -28,14 +31,126 @@
 #include "cpl_conv.h"
 
 #ifdef _WIN32
+#include <windows.h>
 #define	S_IWUSR	0000200
 #define	S_IWGRP	0000020
 #define	S_IWOTH	0000002
 #endif //_WIN32
 
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define NGS_NATIVE_COPY
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif // FICLONE
+#endif // __linux__
+
 namespace ngs {
 
 constexpr size_t BUFFER_SIZE = 1024 * 8;
+constexpr size_t COPY_BUFFER_SIZE = 1024 * 1024;
+constexpr size_t COPY_BUFFER_ALIGN = 4096;
+
+#ifdef NGS_NATIVE_COPY
+constexpr size_t NATIVE_COPY_CHUNK_SIZE = 8 * 1024 * 1024;
+
+enum class NativeCopyResult {
+    SUCCESS,
+    FAILED,
+    UNSUPPORTED // Nothing is copied, use generic copy
+};
+
+/**
+ * @brief nativeCopy Copies local file inside the kernel. Reflink is tried
+ * first, than copy_file_range and sendfile.
+ */
+static NativeCopyResult nativeCopy(const std::string &src,
+                                   const std::string &dst,
+                                   const File::CopyFunction &onCopied)
+{
+    if(startsWith(src, "/vsi") || startsWith(dst, "/vsi")) {
+        return NativeCopyResult::UNSUPPORTED;
+    }
+
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if(in == -1) {
+        return NativeCopyResult::UNSUPPORTED;
+    }
+
+    struct stat st;
+    if(fstat(in, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(in);
+        return NativeCopyResult::UNSUPPORTED;
+    }
+
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   st.st_mode & 0777);
+    if(out == -1) {
+        close(in);
+        return NativeCopyResult::UNSUPPORTED;
+    }
+
+    NativeCopyResult result = NativeCopyResult::SUCCESS;
+    if(ioctl(out, FICLONE, in) == 0) {
+        if(!onCopied(st.st_size)) {
+            result = NativeCopyResult::FAILED;
+        }
+    }
+    else {
+        off_t copied = 0;
+#ifdef __NR_copy_file_range
+        bool useCopyRange = true;
+#endif // __NR_copy_file_range
+        while(copied < st.st_size) {
+            size_t chunk = static_cast<size_t>(std::min(
+                static_cast<off_t>(NATIVE_COPY_CHUNK_SIZE), st.st_size - copied));
+            ssize_t written = -1;
+#ifdef __NR_copy_file_range
+            if(useCopyRange) {
+                written = syscall(__NR_copy_file_range, in, nullptr, out,
+                                  nullptr, chunk, 0);
+                if(written == -1 && copied == 0 &&
+                   (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                    errno == EOPNOTSUPP)) {
+                    useCopyRange = false;
+                }
+            }
+            if(!useCopyRange)
+#endif // __NR_copy_file_range
+            {
+                written = sendfile(out, in, nullptr, chunk);
+            }
+
+            if(written == 0) { // Source was truncated
+                break;
+            }
+            if(written < 0) {
+                result = copied == 0 ? NativeCopyResult::UNSUPPORTED :
+                                       NativeCopyResult::FAILED;
+                break;
+            }
+
+            copied += written;
+            if(!onCopied(written)) {
+                result = NativeCopyResult::FAILED;
+                break;
+            }
+        }
+    }
+
+    if(close(out) != 0 && result == NativeCopyResult::SUCCESS) {
+        result = NativeCopyResult::FAILED;
+    }
+    close(in);
+    return result;
+}
+#endif // NGS_NATIVE_COPY
 
 File::File(ObjectContainer * const parent,
            const enum ngsCatalogObjectType type,
@@ -78,71 +193,109 @@ bool File::copyFile(const std::string &src, const std::string &dst, const Progre
     }
 
     VSIStatBufL sbuf;
-    double totalCount = 1.0;
-    if(VSIStatL(src.c_str(), &sbuf) == 0) {
-        totalCount = double(sbuf.st_size) / BUFFER_SIZE;
-        if(totalCount < 1.0) {
-            totalCount = 1.0;
+    double totalBytes = 1.0;
+    if(VSIStatL(src.c_str(), &sbuf) == 0 && sbuf.st_size > 0) {
+        totalBytes = static_cast<double>(sbuf.st_size);
+    }
+
+    double copiedBytes = 0.0;
+    bool canceled = false;
+    bool ret = copyFileData(src, dst, [&](GIntBig bytes) {
+        copiedBytes += bytes;
+        if(!progress.onProgress(COD_IN_PROCESS,
+                                std::min(1.0, copiedBytes / totalBytes),
+                                _("Copying %s to %s"), src.c_str(), dst.c_str())) {
+            canceled = true;
+            return false;
         }
+        return true;
+    });
+
+    if(!ret && !canceled) {
+        progress.onProgress(COD_COPY_FAILED, 0.0, "%s", getLastError());
+        return false;
     }
 
-    VSILFILE *fpOld, *fpNew;
-    bool ret = true;
+    progress.onProgress(COD_FINISHED, 1.0,
+                        _("Copied %s to %s"), src.c_str(), dst.c_str());
+    return ret;
+}
+
+/**
+ * @brief File::copyFileData Copies file content. Local files are copied by the
+ * kernel where available (reflink, copy_file_range, sendfile), other files are
+ * copied through VSI with large aligned buffer.
+ * @param src Source file path.
+ * @param dst Destination file path.
+ * @param onCopied Function called after each written chunk.
+ * @return true on success.
+ */
+bool File::copyFileData(const std::string &src, const std::string &dst,
+                        const CopyFunction &onCopied)
+{
     resetError();
 
-    // Open old and new file
+#ifdef NGS_NATIVE_COPY
+    switch(nativeCopy(src, dst, onCopied)) {
+    case NativeCopyResult::SUCCESS:
+        return true;
+    case NativeCopyResult::FAILED:
+        return errorMessage(_("Copying of %s to %s failed"), src.c_str(),
+                            dst.c_str());
+    case NativeCopyResult::UNSUPPORTED:
+        break;
+    }
+#endif // NGS_NATIVE_COPY
 
-    fpOld = VSIFOpenL(src.c_str(), "rb");
+    // Open old and new file
+    VSILFILE *fpOld = VSIFOpenL(src.c_str(), "rb");
     if(fpOld == nullptr) {
-        progress.onProgress(COD_COPY_FAILED, 0.0, _("Open input file %s failed"),
-                            src.c_str());
         return errorMessage(_("Open input file %s failed"), src.c_str());
     }
 
-    fpNew = VSIFOpenL(dst.c_str(), "wb");
+    VSILFILE *fpNew = VSIFOpenL(dst.c_str(), "wb");
     if(fpNew == nullptr) {
         VSIFCloseL(fpOld);
-        const char *err = CPLGetLastErrorMsg();
-        progress.onProgress(COD_COPY_FAILED, 0.0, _("Open output file %s failed. Error: %s"),
-                            dst.c_str(), err);
-        return errorMessage(_("Open output file %s failed"), dst.c_str());
+        return errorMessage(_("Open output file %s failed. Error: %s"),
+                            dst.c_str(), CPLGetLastErrorMsg());
     }
 
     // Prepare buffer
-    GByte *buffer = static_cast<GByte*>(CPLMalloc(BUFFER_SIZE));
+    GByte *buffer = static_cast<GByte*>(
+                VSIMallocAligned(COPY_BUFFER_ALIGN, COPY_BUFFER_SIZE));
+    if(nullptr == buffer) {
+        VSIFCloseL(fpNew);
+        VSIFCloseL(fpOld);
+        return errorMessage(_("Not enough memory"));
+    }
 
     // Copy file over till we run out of stuff
-    double counter(0);
+    bool ret = true;
     while(true) {
-        size_t read = VSIFReadL(buffer, 1, BUFFER_SIZE, fpOld);
+        size_t read = VSIFReadL(buffer, 1, COPY_BUFFER_SIZE, fpOld);
         size_t written = VSIFWriteL(buffer, 1, read, fpNew);
         if(written != read) {
-            errorMessage("Copying of %s to %s failed", src.c_str(), dst.c_str());
-            ret = false;
+            ret = errorMessage(_("Copying of %s to %s failed"), src.c_str(),
+                               dst.c_str());
             break;
         }
 
-        counter++;
-
-        if(!progress.onProgress(COD_IN_PROCESS, counter / totalCount,
-                               _("Copying %s to %s"), src.c_str(), dst.c_str())) {
+        if(read > 0 && !onCopied(static_cast<GIntBig>(read))) {
             ret = false;
             break;
         }
-        if(read < BUFFER_SIZE) {
+        if(read < COPY_BUFFER_SIZE) {
             break;
         }
     }
 
-    progress.onProgress(COD_FINISHED, 1.0,
-                        _("Copied %s to %s"), src.c_str(), dst.c_str());
-
     // Cleanup
-
-    VSIFCloseL(fpNew);
+    if(VSIFCloseL(fpNew) != 0 && ret) {
+        ret = errorMessage(_("Copying of %s to %s failed"), src.c_str(),
+                           dst.c_str());
+    }
     VSIFCloseL(fpOld);
-
-    CPLFree(buffer);
+    VSIFreeAligned(buffer);
 
     return ret;
 }
@@ -211,6 +364,63 @@ bool File::writeFile(const std::string &file, const void *buffer, size_t size)
     return result;
 }
 
+/**
+ * @brief File::replaceFile Write the data to temporary file near the file and
+ * replace the file by it, so the file is either old or new one on failure.
+ * @param file File path.
+ * @param buffer Data to write.
+ * @param size Data size.
+ * @return True on success.
+ */
+bool File::replaceFile(const std::string &file, const void *buffer,
+                       size_t size)
+{
+    std::string tmpPath = file + ".tmp";
+    VSILFILE *fp = VSIFOpenL(tmpPath.c_str(), "wb");
+    if(nullptr == fp) {
+        return false;
+    }
+    bool result = VSIFWriteL(buffer, 1, size, fp) == size;
+    result = VSIFCloseL(fp) == 0 && result;
+    if(result) {
+        result = replaceByRename(tmpPath, file);
+    }
+    if(!result) {
+        VSIUnlink(tmpPath.c_str());
+    }
+    return result;
+}
+
+/**
+ * @brief File::replaceByRename Rename the file over existing one. Rename fails
+ * on Windows if destination exists, so the file is moved with replace there.
+ * @param src Source path.
+ * @param dst Destination path.
+ * @return True on success.
+ */
+bool File::replaceByRename(const std::string &src, const std::string &dst)
+{
+#ifdef _WIN32
+    if(!startsWith(dst, "/vsi")) {
+        wchar_t *srcW = CPLRecodeToWChar(src.c_str(), CPL_ENC_UTF8,
+                                         CPL_ENC_UCS2);
+        wchar_t *dstW = CPLRecodeToWChar(dst.c_str(), CPL_ENC_UTF8,
+                                         CPL_ENC_UCS2);
+        BOOL result = MoveFileExW(srcW, dstW, MOVEFILE_REPLACE_EXISTING |
+                                  MOVEFILE_WRITE_THROUGH);
+        CPLFree(srcW);
+        CPLFree(dstW);
+        return result != FALSE;
+    }
+    // Virtual file systems may not replace too
+    if(VSIRename(src.c_str(), dst.c_str()) == 0) {
+        return true;
+    }
+    VSIUnlink(dst.c_str());
+#endif // _WIN32
+    return VSIRename(src.c_str(), dst.c_str()) == 0;
+}
+
 std::string File::readFile(const std::string &file)
 {
     std::string out;
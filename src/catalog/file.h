@@ -21,6 +21,9 @@
 #ifndef NGSFILE_H
 #define NGSFILE_H
 
+// std
+#include <functional>
+
 #include "ngstore/codes.h"
 #include "objectcontainer.h"
 
@@ -31,6 +34,13 @@ namespace ngs {
 
 class File : public Object
 {
+public:
+    /**
+     * Called with the count of bytes written since the previous call. Return
+     * false to cancel copy.
+     */
+    typedef std::function<bool(GIntBig bytes)> CopyFunction;
+
 public:
     explicit File(ObjectContainer * const parent = nullptr,
          const enum ngsCatalogObjectType type = CAT_FILE_ANY,
@@ -43,12 +53,17 @@ public:
     static GIntBig fileSize(const std::string &path);
     static bool copyFile(const std::string &src, const std::string &dst,
                          const Progress &progress = Progress());
+    static bool copyFileData(const std::string &src, const std::string &dst,
+                             const CopyFunction &onCopied);
     static bool moveFile(const std::string &src, const std::string &dst,
                          const Progress &progress = Progress());
     static bool renameFile(const std::string &src, const std::string &dst,
                            const Progress &progress = Progress());
     static bool writeFile(const std::string &file, const void* buffer,
                           size_t size);
+    static bool replaceFile(const std::string &file, const void* buffer,
+                            size_t size);
+    static bool replaceByRename(const std::string &src, const std::string &dst);
     static std::string readFile(const std::string &file);
     static std::string formFileName(const std::string &path,
                                     const std::string &name,
@@ -20,14 +20,63 @@
  ****************************************************************************/
 #include "ngstore/catalog/filter.h"
 
+// gdal
+#ifdef NGS_MOBILE
+#include "gdal_frmts.h"
+#include "ogrsf_frmts.h"
+#endif // NGS_MOBILE
+
 #include "catalog/mapfile.h"
 #include "ds/datastore.h"
 #ifndef NGS_MOBILE
 #include "ds/mapinfodatastore.h"
 #endif // NGS_MOBILE
+#include "util/mutex.h"
 
 namespace ngs {
 
+#ifdef NGS_MOBILE
+typedef void (*RegisterDriverFunc)();
+typedef struct _driverRegistration {
+    const char *name;
+    RegisterDriverFunc func;
+} DriverRegistration;
+
+// WMS and GeoPackage tiles are decoded by image drivers.
+static void registerWMS()
+{
+    GDALRegister_PNG();
+    GDALRegister_JPEG();
+    GDALRegister_WMS();
+}
+
+static void registerGeoPackage()
+{
+    GDALRegister_PNG();
+    GDALRegister_JPEG();
+    RegisterOGRGeoPackage();
+}
+
+// NOTE: Keep in sync with extlib.cmake gdal options.
+static const DriverRegistration gDriverRegistrations[] = {
+    {"GTiff", GDALRegister_GTiff},
+    {"HFA", GDALRegister_HFA},
+    {"PNG", GDALRegister_PNG},
+    {"JPEG", GDALRegister_JPEG},
+    {"WMS", registerWMS},
+    {"ESRI Shapefile", RegisterOGRShape},
+    {"MapInfo File", RegisterOGRTAB},
+    {"GPX", RegisterOGRGPX},
+    {"KML", RegisterOGRKML},
+    {"GeoJSON", RegisterOGRGeoJSON},
+    {"GPKG", registerGeoPackage},
+    {"SQLite", RegisterOGRSQLite},
+    {"NGW", RegisterOGRNGW}
+};
+
+static Mutex gDriverMutex;
+#endif // NGS_MOBILE
+
 //-----------------------------------------------------------------------------
 // Filter
 //-----------------------------------------------------------------------------
@@ -148,6 +197,50 @@ bool Filter::isConnection(const enum ngsCatalogObjectType type)
             type == CAT_CONTAINER_POSTGRES;
 }
 
+/**
+ * @brief Filter::registerGDALDrivers Registers GDAL drivers on library init.
+ * On mobile devices only the drivers used internally by GDAL are registered,
+ * the others are registered by getGDALDriver on first request.
+ */
+void Filter::registerGDALDrivers()
+{
+#ifdef NGS_MOBILE
+    GDALRegister_VRT();
+    GDALRegister_MEM();
+    RegisterOGRVRT();
+    RegisterOGRMEM();
+#else
+    GDALAllRegister();
+#endif // NGS_MOBILE
+}
+
+/**
+ * @brief Filter::getGDALDriver Returns GDAL driver by short name. If the driver
+ * is not registered yet it is registered here.
+ * @param name Driver short name.
+ * @return Driver or nullptr if the driver is not supported in this build.
+ */
+GDALDriver *Filter::getGDALDriver(const char *name)
+{
+    GDALDriverManager *manager = GetGDALDriverManager();
+    GDALDriver *driver = manager->GetDriverByName(name);
+#ifdef NGS_MOBILE
+    if(nullptr != driver) {
+        return driver;
+    }
+
+    MutexHolder holder(gDriverMutex);
+    for(const DriverRegistration &registration : gDriverRegistrations) {
+        if(EQUAL(registration.name, name)) {
+            registration.func();
+            CPLDebug("ngstore", "GDAL driver %s registered", name);
+            return manager->GetDriverByName(name);
+        }
+    }
+#endif // NGS_MOBILE
+    return driver;
+}
+
 GDALDriver *Filter::getGDALDriver(const enum ngsCatalogObjectType type)
 {
 
@@ -157,90 +250,90 @@ GDALDriver *Filter::getGDALDriver(const enum ngsCatalogObjectType type)
     case CAT_FC_GPKG:
     case CAT_RASTER_GPKG:
     case CAT_CONTAINER_NGS:
-        return GetGDALDriverManager()->GetDriverByName("GPKG");
+        return getGDALDriver("GPKG");
     case CAT_CONTAINER_SQLITE:
     case CAT_TABLE_LITE:
     case CAT_FC_LITE:
     case CAT_RASTER_LITE:
     case CAT_CONTAINER_MAPINFO_STORE:
-        return GetGDALDriverManager()->GetDriverByName("SQLite");
+        return getGDALDriver("SQLite");
     case CAT_CONTAINER_GDB:
     case CAT_TABLE_GDB:
     case CAT_FC_GDB:
     case CAT_RASTER_GDB:
-        return GetGDALDriverManager()->GetDriverByName("OpenFileGDB");
+        return getGDALDriver("OpenFileGDB");
     case CAT_CONTAINER_POSTGRES:
     case CAT_FC_POSTGIS:
     case CAT_RASTER_POSTGIS:
     case CAT_TABLE_POSTGRES:
-        return GetGDALDriverManager()->GetDriverByName("PostgreSQL");
+        return getGDALDriver("PostgreSQL");
     case CAT_CONTAINER_WFS:
     case CAT_FC_WFS:
-        return GetGDALDriverManager()->GetDriverByName("WFS");
+        return getGDALDriver("WFS");
     case CAT_CONTAINER_MEM:
     case CAT_FC_MEM:
     case CAT_TABLE_MEM:
-        return GetGDALDriverManager()->GetDriverByName("Memory");
+        return getGDALDriver("Memory");
     case CAT_RASTER_MEM:
-        return GetGDALDriverManager()->GetDriverByName("MEM");
+        return getGDALDriver("MEM");
     case CAT_CONTAINER_WMS:
     case CAT_RASTER_WMS:
     case CAT_RASTER_TMS:
-        return GetGDALDriverManager()->GetDriverByName("WMS");
+        return getGDALDriver("WMS");
     case CAT_CONTAINER_KML:
-        return GetGDALDriverManager()->GetDriverByName("KML");
+        return getGDALDriver("KML");
     case CAT_CONTAINER_KMZ:
-        return GetGDALDriverManager()->GetDriverByName("LIBKML");
+        return getGDALDriver("LIBKML");
     case CAT_CONTAINER_SXF:
-        return GetGDALDriverManager()->GetDriverByName("SXF");
+        return getGDALDriver("SXF");
     case CAT_FC_ESRI_SHAPEFILE:
-        return GetGDALDriverManager()->GetDriverByName("ESRI Shapefile");
+        return getGDALDriver("ESRI Shapefile");
     case CAT_FC_MAPINFO_TAB:
     case CAT_FC_MAPINFO_MIF:
     case CAT_TABLE_MAPINFO_TAB:
     case CAT_TABLE_MAPINFO_MIF:
-        return GetGDALDriverManager()->GetDriverByName("MapInfo File");
+        return getGDALDriver("MapInfo File");
     case CAT_FC_DXF:
-        return GetGDALDriverManager()->GetDriverByName("DXF");
+        return getGDALDriver("DXF");
     case CAT_FC_GML:
-        return GetGDALDriverManager()->GetDriverByName("GML");
+        return getGDALDriver("GML");
     case CAT_FC_GEOJSON:
-        return GetGDALDriverManager()->GetDriverByName("GeoJSON");
+        return getGDALDriver("GeoJSON");
     case CAT_FC_S57:
-        return GetGDALDriverManager()->GetDriverByName("S57");
+        return getGDALDriver("S57");
     case CAT_FC_CSV:
-        return GetGDALDriverManager()->GetDriverByName("CSV");
+        return getGDALDriver("CSV");
     case CAT_FC_GPX:
-        return GetGDALDriverManager()->GetDriverByName("GPX");
+        return getGDALDriver("GPX");
     case CAT_RASTER_BMP:
-        return GetGDALDriverManager()->GetDriverByName("BMP");
+        return getGDALDriver("BMP");
     case CAT_RASTER_TIFF:
-        return GetGDALDriverManager()->GetDriverByName("GTiff");
+        return getGDALDriver("GTiff");
     case CAT_RASTER_TIL:
-        return GetGDALDriverManager()->GetDriverByName("TIL");
+        return getGDALDriver("TIL");
     case CAT_RASTER_IMG:
-        return GetGDALDriverManager()->GetDriverByName("HFA");
+        return getGDALDriver("HFA");
     case CAT_RASTER_JPEG:
-        return GetGDALDriverManager()->GetDriverByName("JPEG");
+        return getGDALDriver("JPEG");
     case CAT_RASTER_PNG:
-        return GetGDALDriverManager()->GetDriverByName("PNG");
+        return getGDALDriver("PNG");
     case CAT_RASTER_GIF:
-        return GetGDALDriverManager()->GetDriverByName("GIF");
+        return getGDALDriver("GIF");
     case CAT_RASTER_SAGA:
-        return GetGDALDriverManager()->GetDriverByName("SAGA");
+        return getGDALDriver("SAGA");
     case CAT_RASTER_VRT:
-        return GetGDALDriverManager()->GetDriverByName("VRT");
+        return getGDALDriver("VRT");
     case CAT_TABLE_CSV:
-        return GetGDALDriverManager()->GetDriverByName("CSV");
+        return getGDALDriver("CSV");
     case CAT_TABLE_ODS:
-        return GetGDALDriverManager()->GetDriverByName("ODS");
+        return getGDALDriver("ODS");
     case CAT_TABLE_XLS:
-        return GetGDALDriverManager()->GetDriverByName("XLS");
+        return getGDALDriver("XLS");
     case CAT_TABLE_XLSX:
-        return GetGDALDriverManager()->GetDriverByName("XLSX");
+        return getGDALDriver("XLSX");
     case CAT_NGW_VECTOR_LAYER:
     case CAT_NGW_POSTGIS_LAYER:
-        return GetGDALDriverManager()->GetDriverByName("NGW");
+        return getGDALDriver("NGW");
     default:
         return nullptr;
     }
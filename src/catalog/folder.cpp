@@ -21,6 +21,7 @@
 #include "folder.h"
 
 #include <algorithm>
+#include <atomic>
 
 #include "catalog.h"
 #include "file.h"
@@ -34,6 +35,7 @@
 #include "util/account.h"
 #include "util/notify.h"
 #include "util/error.h"
+#include "util/threadpool.h"
 #include "archive.h"
 
 
@@ -44,6 +46,166 @@
 
 namespace ngs {
 
+//------------------------------------------------------------------------------
+// CopyFileData
+//------------------------------------------------------------------------------
+
+constexpr size_t PARALLEL_COPY_MIN_FILES = 4;
+constexpr double BYTES_IN_MB = 1024.0 * 1024.0;
+
+typedef struct _copyState {
+    std::atomic<GIntBig> copied;
+    std::atomic<bool> canceled;
+    bool failed;
+    std::string error;
+    Mutex mutex;
+} CopyState;
+
+class CopyFileData : public ThreadData
+{
+public:
+    CopyFileData(const std::string &from, const std::string &to, GIntBig size,
+                 CopyState *state) : ThreadData(false, -static_cast<double>(size)),
+        m_from(from), m_to(to), m_state(state) {}
+    virtual ~CopyFileData() = default;
+    std::string m_from;
+    std::string m_to;
+    CopyState *m_state;
+};
+
+static bool copyFileThreadFunc(ThreadData *threadData)
+{
+    CopyFileData *data = static_cast<CopyFileData*>(threadData);
+    CopyState *state = data->m_state;
+    if(state->canceled) {
+        return true;
+    }
+
+    bool result = File::copyFileData(data->m_from, data->m_to,
+                                     [state](GIntBig bytes) {
+        state->copied += bytes;
+        return !state->canceled;
+    });
+
+    if(!result && !state->canceled) {
+        MutexHolder holder(state->mutex);
+        if(!state->failed) {
+            state->failed = true;
+            state->error = getLastError();
+        }
+        state->canceled = true;
+    }
+    // Failed copy is not repeated.
+    return true;
+}
+
+/**
+ * @brief The CopyProgress class Reports copied bytes of all files while the
+ * thread pool works.
+ */
+class CopyProgress : public Progress
+{
+public:
+    CopyProgress(const Progress &progress, CopyState *state, double totalSize) :
+        Progress(), m_progress(progress), m_state(state),
+        m_totalSize(totalSize) {}
+    virtual bool onProgress(enum ngsCode status, double complete,
+                            const char *format, ...) const override {
+        ngsUnused(complete);
+        ngsUnused(format);
+        if(m_state->canceled) {
+            return false;
+        }
+        if(!m_progress.onProgress(status, copied(), _("Copied %.1f of %.1f MB"),
+                                  m_state->copied / BYTES_IN_MB,
+                                  m_totalSize / BYTES_IN_MB)) {
+            m_state->canceled = true;
+            return false;
+        }
+        return true;
+    }
+    double copied() const {
+        return std::min(1.0, m_state->copied / m_totalSize);
+    }
+
+protected:
+    const Progress &m_progress;
+    CopyState *m_state;
+    double m_totalSize;
+};
+
+/**
+ * @brief prepareCopy Creates destination folders and collects files to copy.
+ * The opened databases are flushed before copy.
+ */
+static bool prepareCopy(const std::string &from, const std::string &to,
+                        std::vector<CopyFileData> &files, CopyState *state,
+                        GIntBig &totalSize, const Progress &progress)
+{
+    if(!Folder::isExists(to)) {
+        if(!Folder::mkDir(to)) {
+            return false;
+        }
+    }
+
+    char **items = CPLReadDir(from.c_str());
+    if(nullptr == items) {
+        return true;
+    }
+
+    CatalogPtr catalog = Catalog::instance();
+
+    int count = CSLCount(items);
+    bool result = true;
+    for(int i = count - 1; i >= 0; --i ) {
+        if(compare(items[i], ".") || compare(items[i], "..")) {
+            continue;
+        }
+
+        if(!progress.onProgress(COD_IN_PROCESS, 0.0, _("Prepare to copy %s"),
+                                items[i])) {
+            result = false;
+            break;
+        }
+
+        std::string pathFrom = File::formFileName(from, items[i]);
+
+        if(Folder::isCopySkipped(pathFrom)) {
+            continue;
+        }
+
+        ObjectPtr copyObjectContainer = catalog->getObjectBySystemPath(pathFrom);
+        if(copyObjectContainer) {
+            if(Filter::isDatabase(copyObjectContainer->type())) {
+                auto *base = ngsDynamicCast(DatasetBase, copyObjectContainer);
+                if(base) {
+//                    base->close();
+                    base->flushCache();
+                }
+            }
+        }
+
+        std::string pathTo = File::formFileName(to, items[i]);
+
+        VSIStatBufL sbuf;
+        if(VSIStatL(pathFrom.c_str(), &sbuf) == 0 && VSI_ISDIR(sbuf.st_mode)) {
+            if(!prepareCopy(pathFrom, pathTo, files, state, totalSize, progress)) {
+                result = false;
+                break;
+            }
+        }
+        else {
+            GIntBig size = static_cast<GIntBig>(sbuf.st_size);
+            files.emplace_back(pathFrom, pathTo, size, state);
+            totalSize += size;
+        }
+    }
+
+    CSLDestroy(items);
+
+    return result;
+}
+
 //------------------------------------------------------------------------------
 // FolderConnection
 //------------------------------------------------------------------------------
@@ -88,6 +250,17 @@ std::vector<std::string> Folder::fillChildrenNames(const std::string &path,
 }
 
 bool Folder::loadChildren()
+{
+    return loadChildren(Progress());
+}
+
+/**
+ * @brief Folder::loadChildren Loads folder children and reports progress. The
+ * children created so far can be queried from progress function.
+ * @param progress Progress to report and cancel loading.
+ * @return false if loading was canceled.
+ */
+bool Folder::loadChildren(const Progress &progress)
 {
     if(m_childrenLoaded) {
         return true;
@@ -95,18 +268,25 @@ bool Folder::loadChildren()
 
     if(m_parent) {
         m_childrenLoaded = true;
-        char **items = CPLReadDir(m_path.c_str());
+        // Watch before read to not miss the changes
+        FolderWatcher *folderWatcher = watcher();
+        if(nullptr != folderWatcher) {
+            folderWatcher->addWatch(m_path, fullName());
+        }
+
+        std::vector<std::string> objectNames = readChildrenNames();
 
         // No children in folder
-        if(nullptr == items) {
+        if(objectNames.empty()) {
             return true;
         }
 
-        std::vector<std::string> objectNames = fillChildrenNames(m_path, items);
-
-        Catalog::instance()->createObjects(m_parent->getChild(m_name), objectNames);
-
-        CSLDestroy(items);
+        if(!Catalog::instance()->createObjects(m_parent->getChild(m_name),
+                                               objectNames, progress)) {
+            clear();
+            return false;
+        }
+        m_otherNames.insert(objectNames.begin(), objectNames.end());
     }
 
     return true;
@@ -174,16 +354,14 @@ bool Folder::rmDir(const std::string &path)
     return true;
 }
 
-static const std::string skipExtensions[] = { "ngst-shm", "ngst-wal", "db-wal", "db-shm" };
-static bool skipCopy(const std::string &ext) {
-    for(const std::string &skipExtension : skipExtensions) {
-        if(skipExtension == ext) {
-            return true;
-        }
-    }
-    return false;
-}
-
+/**
+ * @brief Folder::copyDir Copies folder content. The folder tree is created
+ * first, then files are copied in parallel. The progress reports copied bytes.
+ * @param from Source folder path.
+ * @param to Destination folder path.
+ * @param progress Progress to report and cancel.
+ * @return true on success.
+ */
 bool Folder::copyDir(const std::string &from, const std::string &to,
                      const Progress& progress)
 {
@@ -191,69 +369,57 @@ bool Folder::copyDir(const std::string &from, const std::string &to,
         return true;
     }
 
-    if(!Folder::isExists(to)) {
-        if(!mkDir(to)) {
-            return false;
-        }
-    }
+    CopyState state;
+    state.copied = 0;
+    state.canceled = false;
+    state.failed = false;
 
-    char **items = CPLReadDir(from.c_str());
-    if(nullptr == items) {
-        return true;
+    std::vector<CopyFileData> files;
+    GIntBig totalSize = 0;
+    if(!prepareCopy(from, to, files, &state, totalSize, progress)) {
+        return false;
     }
 
-    CatalogPtr catalog = Catalog::instance();
-
-    int count = CSLCount(items);
-    bool result = true;
-    for(int i = count - 1; i >= 0; --i ) {
-        if(compare(items[i], ".") || compare(items[i], "..")) {
-            continue;
-        }
-
-        if(progress.onProgress(COD_IN_PROCESS, double(i) / count,
-                               _("Copy file %s"), items[i]) == 0) {
-            result = false;
-            break;
-        }
-
-
-        std::string pathFrom = File::formFileName(from, items[i]);
-
-        if(skipCopy(File::getExtension(pathFrom))) {
-            continue;
-        }
-
-        ObjectPtr copyObjectContainer = catalog->getObjectBySystemPath(pathFrom);
-        if(copyObjectContainer) {
-            if(Filter::isDatabase(copyObjectContainer->type())) {
-                auto *base = ngsDynamicCast(DatasetBase, copyObjectContainer);
-                if(base) {
-//                    base->close();
-                    base->flushCache();
+    CopyProgress copyProgress(progress, &state,
+                              std::max(1.0, static_cast<double>(totalSize)));
+    // Archive writers accept one opened file at a time.
+    if(files.size() < PARALLEL_COPY_MIN_FILES || startsWith(to, "/vsi")) {
+        for(const CopyFileData &file : files) {
+            if(!File::copyFileData(file.m_from, file.m_to, [&](GIntBig bytes) {
+                state.copied += bytes;
+                return copyProgress.onProgress(COD_IN_PROCESS, 0.0, "");
+            })) {
+                if(!state.canceled) {
+                    state.failed = true;
+                    state.error = getLastError();
                 }
-            }
-        }
-
-        std::string pathTo = File::formFileName(to, items[i]);
-
-        if(isDir(pathFrom)) {
-            if(!copyDir(pathFrom, pathTo, progress)) {
-                result = false;
                 break;
             }
         }
-        else {
-            if(!File::copyFile(pathFrom, pathTo, progress)) {
-                result = false;
-                break;
-            }
+    }
+    else {
+        ThreadPool threadPool;
+        threadPool.init(static_cast<unsigned char>(
+                            std::min(files.size(),
+                                     static_cast<size_t>(getNumberThreads()))),
+                        copyFileThreadFunc, 1);
+        for(CopyFileData &file : files) {
+            threadPool.addThreadData(&file);
         }
+        threadPool.waitComplete(copyProgress);
     }
 
-    CSLDestroy(items);
-
-    return result;
+    if(state.failed) {
+        progress.onProgress(COD_COPY_FAILED, copyProgress.copied(), "%s",
+                            state.error.c_str());
+        return errorMessage("%s", state.error.c_str());
+    }
+    if(state.canceled) {
+        return false;
+    }
+    progress.onProgress(COD_FINISHED, 1.0, _("Copied %s to %s"), from.c_str(),
+                        to.c_str());
+    return true;
 }
 
 bool Folder::moveDir(const std::string &from, const std::string &to,
@@ -278,6 +444,14 @@ bool Folder::moveDir(const std::string &from, const std::string &to,
 
 bool Folder::isDir(const std::string &path)
 {
+    std::string archivePath, innerPath;
+    if(ArchiveIndex::splitPath(path, archivePath, innerPath)) {
+        ArchiveIndexPtr index = ArchiveIndex::get(archivePath);
+        if(index) {
+            return index->isDir(innerPath);
+        }
+    }
+
     VSIStatBufL sbuf;
     return VSIStatL(path.c_str(), &sbuf) == 0 && VSI_ISDIR(sbuf.st_mode);
 }
@@ -298,6 +472,25 @@ bool Folder::isHidden(const std::string &path)
     return comparePart(File::getFileName(path), ".", 1);
 }
 
+static const std::string skipExtensions[] = { "ngst-shm", "ngst-wal", "db-wal", "db-shm" };
+
+/**
+ * @brief Folder::isCopySkipped Checks if file is not copied with folder. These
+ * are temporary files of the opened databases.
+ * @param path File path.
+ * @return true if file should be skipped.
+ */
+bool Folder::isCopySkipped(const std::string &path)
+{
+    const std::string ext = File::getExtension(path);
+    for(const std::string &skipExtension : skipExtensions) {
+        if(skipExtension == ext) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool Folder::destroy()
 {
     if(!rmDir(m_path)) {
@@ -321,19 +514,26 @@ void Folder::refresh()
 
     // Current names and new names arrays compare
     if(m_parent) {
+        FolderWatcher *folderWatcher = watcher();
+        if(nullptr != folderWatcher) {
+            FolderWatcher::FolderChanges changes;
+            if(folderWatcher->takeChanges(m_path, changes) && !changes.rescan) {
+                applyChanges(changes);
+                return;
+            }
+            folderWatcher->addWatch(m_path, fullName());
+        }
 
         // Fill add names array
-        char **items = CPLReadDir(m_path.c_str());
+        std::vector<std::string> deleteNames, addNames;
+        addNames = readChildrenNames();
 
         // No children in folder
-        if(nullptr == items) {
+        if(addNames.empty()) {
             clear();
             return;
         }
 
-        std::vector<std::string> deleteNames, addNames;
-        addNames = fillChildrenNames(m_path, items);
-
         // Fill delete names array
         for(const ObjectPtr& child : m_children) {
             deleteNames.push_back(child->name());
@@ -349,7 +549,7 @@ void Folder::refresh()
             auto itdn = std::find(deleteNames.begin(), deleteNames.end(), name);
             if(itdn != deleteNames.end()) {
                 deleteNames.erase(itdn);
-                it = m_children.erase(it);
+                it = removeChild(it);
             }
             else {
                 ++it;
@@ -358,11 +558,163 @@ void Folder::refresh()
 
         // Add objects
         Catalog::instance()->createObjects(m_parent->getChild(m_name), addNames);
+        m_otherNames.clear();
+        m_otherNames.insert(addNames.begin(), addNames.end());
 
         CSLDestroy(items);
     }
 }
 
+void Folder::clear()
+{
+    ObjectContainer::clear();
+    m_otherNames.clear();
+}
+
+/**
+ * @brief Folder::watcher Returns the watcher of the top folder in catalog
+ * tree. The watcher is created on first use.
+ * @return Watcher or nullptr if folder changes cannot be watched.
+ */
+FolderWatcher *Folder::watcher()
+{
+    if(startsWith(m_path, "/vsi")) {
+        return nullptr;
+    }
+
+    Folder *root = this;
+    Folder *parentFolder = dynamic_cast<Folder*>(root->m_parent);
+    while(nullptr != parentFolder) {
+        root = parentFolder;
+        parentFolder = dynamic_cast<Folder*>(root->m_parent);
+    }
+
+    if(!root->m_watcher) {
+        root->m_watcher.reset(new FolderWatcher());
+    }
+    return root->m_watcher->isActive() ? root->m_watcher.get() : nullptr;
+}
+
+static void childFiles(const ObjectPtr &child, std::vector<std::string> &files,
+                       bool &hasSiblings)
+{
+    files.push_back(child->name());
+    SimpleDataset *simpleDS = ngsDynamicCast(SimpleDataset, child);
+    if(nullptr != simpleDS) {
+        auto siblingFiles = simpleDS->siblingFiles();
+        files.insert(files.end(), siblingFiles.begin(), siblingFiles.end());
+        hasSiblings = true;
+        return;
+    }
+    Raster *raster = ngsDynamicCast(Raster, child);
+    if(nullptr != raster) {
+        const auto &siblingFiles = raster->siblingFiles();
+        files.insert(files.end(), siblingFiles.begin(), siblingFiles.end());
+        hasSiblings = true;
+        return;
+    }
+    hasSiblings = false;
+}
+
+/**
+ * @brief Folder::readChildrenNames Reads folder listing.
+ * @return Names of not hidden files and folders.
+ */
+std::vector<std::string> Folder::readChildrenNames() const
+{
+    char **items = CPLReadDir(m_path.c_str());
+    if(nullptr == items) {
+        return std::vector<std::string>();
+    }
+
+    std::vector<std::string> names = fillChildrenNames(m_path, items);
+    CSLDestroy(items);
+    return names;
+}
+
+/**
+ * @brief Folder::applyChanges Updates the children from the file names added
+ * and removed in folder. Only children which files are changed are recreated.
+ * @param changes Changed file names.
+ */
+void Folder::applyChanges(const FolderWatcher::FolderChanges &changes)
+{
+    if(changes.added.empty() && changes.removed.empty()) {
+        return;
+    }
+
+    std::set<std::string> changedBaseNames;
+    for(const std::string &name : changes.added) {
+        changedBaseNames.insert(File::getBaseName(name));
+    }
+    for(const std::string &name : changes.removed) {
+        changedBaseNames.insert(File::getBaseName(name));
+    }
+
+    // Remove children which files are changed. The multi file datasets are
+    // changed also if the file with the same base name is added.
+    std::set<std::string> names;
+    auto it = m_children.begin();
+    while(it != m_children.end()) {
+        std::vector<std::string> files;
+        bool hasSiblings = false;
+        childFiles(*it, files, hasSiblings);
+
+        bool changed = hasSiblings && changedBaseNames.find(
+                    File::getBaseName((*it)->name())) != changedBaseNames.end();
+        for(const std::string &file : files) {
+            if(changed) {
+                break;
+            }
+            changed = changes.added.find(file) != changes.added.end() ||
+                    changes.removed.find(file) != changes.removed.end();
+        }
+
+        if(changed) {
+            names.insert(files.begin(), files.end());
+            auto name = (*it)->fullName();
+            it = removeChild(it);
+            Notify::instance().onNotify(name, ngsChangeCode::CC_DELETE_OBJECT);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    // The files not used before may form the dataset now
+    auto otherIt = m_otherNames.begin();
+    while(otherIt != m_otherNames.end()) {
+        if(changedBaseNames.find(File::getBaseName(*otherIt)) !=
+                changedBaseNames.end()) {
+            names.insert(*otherIt);
+            otherIt = m_otherNames.erase(otherIt);
+        }
+        else {
+            ++otherIt;
+        }
+    }
+
+    CatalogPtr catalog = Catalog::instance();
+    for(const std::string &name : changes.added) {
+        if(!catalog->isFileHidden(m_path, name)) {
+            names.insert(name);
+        }
+    }
+    for(const std::string &name : changes.removed) {
+        names.erase(name);
+    }
+
+    std::vector<std::string> addNames(names.begin(), names.end());
+    size_t childrenCount = m_children.size();
+    catalog->createObjects(m_parent->getChild(m_name), addNames);
+    m_otherNames.insert(addNames.begin(), addNames.end());
+
+    for(size_t i = childrenCount; i < m_children.size(); ++i) {
+        Notify::instance().onNotify(m_children[i]->fullName(),
+                                    ngsChangeCode::CC_CREATE_OBJECT);
+    }
+}
+
 int Folder::pasteFileSource(ObjectPtr child, bool move, const std::string &newPath,
                             const Progress &progress)
 {
@@ -614,25 +966,25 @@ ObjectPtr Folder::create(const enum ngsCatalogObjectType type,
     case CAT_CONTAINER_DIR:
         if(mkDir(newPath)) {
             object = ObjectPtr(new Folder(this, newName, newPath));
-            m_children.push_back(object);
+            appendChild(object);
         }
         break;
     case CAT_CONTAINER_NGS:
         if(DataStore::create(newPath)) {
             object = ObjectPtr(new DataStore(this, newName, newPath));
-            m_children.push_back(object);
+            appendChild(object);
         }
         break;
     case CAT_RASTER_TMS:
         if(RasterFactory::createRemoteConnection(type, newPath, options)) {
             object = ObjectPtr(new Raster(siblingFiles, this, type, newName, newPath));
-            m_children.push_back(object);
+            appendChild(object);
         }
         break;
     case CAT_CONTAINER_MEM:
         if(MemoryStore::create(newPath, options)) {
             object = ObjectPtr(new MemoryStore(this, newName, newPath));
-            m_children.push_back(object);
+            appendChild(object);
         }
         break;
     case CAT_CONTAINER_ARCHIVE_ZIP:
@@ -648,13 +1000,13 @@ ObjectPtr Folder::create(const enum ngsCatalogObjectType type,
                 return ObjectPtr();
             }
             object = ObjectPtr(new Archive(this, CAT_CONTAINER_ARCHIVE_ZIP, newName, newPath));
-            m_children.push_back(object);
+            appendChild(object);
         }
         break;
     case CAT_CONTAINER_MAPINFO_STORE:
         if(MapInfoDataStore::create(newPath)) {
             object = ObjectPtr(new MapInfoDataStore(this, newName, newPath));
-            m_children.push_back(object);
+            appendChild(object);
         }
         break;
     default:
@@ -21,6 +21,11 @@
 #ifndef NGSFOLDER_H
 #define NGSFOLDER_H
 
+// std
+#include <memory>
+#include <set>
+
+#include "folderwatcher.h"
 #include "objectcontainer.h"
 
 namespace ngs {
@@ -31,6 +36,7 @@ public:
     explicit Folder(ObjectContainer * const parent = nullptr,
         const std::string &name = "", const std::string &path = "");
     virtual bool loadChildren() override;
+    bool loadChildren(const Progress &progress);
 
     // Static functions
 public:
@@ -46,6 +52,7 @@ public:
     static bool isDir(const std::string &path);
     static bool isSymlink(const std::string &path);
     static bool isHidden(const std::string &path);
+    static bool isCopySkipped(const std::string &path);
     static std::vector<std::string> fillChildrenNames(const std::string &path,
         char** items);
     static std::string createUniquePath(const std::string &path,
@@ -54,6 +61,7 @@ public:
     // ObjectContainer interface
 public:
     virtual bool canCreate(const enum ngsCatalogObjectType type) const override;
+    virtual void clear() override;
     virtual void refresh() override;
     virtual bool isReadOnly() const override;
     virtual int paste(ObjectPtr child, bool move = false,
@@ -73,6 +81,15 @@ protected:
         const Progress &progress);
     int pasteFeatureClass(ObjectPtr child, bool move, const std::string &newPath,
         const Options& options, const Progress& progress);
+    FolderWatcher *watcher();
+    void applyChanges(const FolderWatcher::FolderChanges &changes);
+    virtual std::vector<std::string> readChildrenNames() const;
+
+protected:
+    /// Folder file names not used by children
+    std::set<std::string> m_otherNames;
+    /// The watcher of the folder tree, created in the top folder
+    std::unique_ptr<FolderWatcher> m_watcher;
 };
 
 class FolderConnection : public Folder
@@ -0,0 +1,306 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "folderwatcher.h"
+
+#if defined(__linux__)
+#define NGS_INOTIFY
+#endif
+
+// std
+#include <cerrno>
+#include <vector>
+
+#ifdef NGS_INOTIFY
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif // NGS_INOTIFY
+
+#include "api_priv.h"
+#include "util/notify.h"
+
+namespace ngs {
+
+#ifdef NGS_INOTIFY
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+        IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+constexpr size_t EVENT_BUFFER_SIZE = 16384;
+constexpr int POLL_TIMEOUT = 1000;
+#endif // NGS_INOTIFY
+
+//------------------------------------------------------------------------------
+// FolderWatcher
+//------------------------------------------------------------------------------
+
+FolderWatcher::FolderWatcher() :
+    m_active(false),
+    m_fd(-1),
+    m_thread(nullptr),
+    m_stop(false)
+{
+    m_stopPipe[0] = -1;
+    m_stopPipe[1] = -1;
+#ifdef NGS_INOTIFY
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_fd < 0) {
+        CPLDebug("ngstore", "inotify is not available, folder changes are not watched");
+        return;
+    }
+    if(pipe(m_stopPipe) != 0) {
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    m_thread = CPLCreateJoinableThread(watchThread, this);
+    m_active = nullptr != m_thread;
+#endif // NGS_INOTIFY
+}
+
+FolderWatcher::~FolderWatcher()
+{
+#ifdef NGS_INOTIFY
+    if(nullptr != m_thread) {
+        m_stop = true;
+        char stop = 1;
+        if(write(m_stopPipe[1], &stop, 1) != 1) {
+            CPLDebug("ngstore", "Wait folder watch thread poll timeout");
+        }
+        CPLJoinThread(m_thread);
+    }
+    for(int i = 0; i < 2; ++i) {
+        if(m_stopPipe[i] >= 0) {
+            close(m_stopPipe[i]);
+        }
+    }
+    if(m_fd >= 0) {
+        close(m_fd); // Removes all watches
+    }
+#endif // NGS_INOTIFY
+}
+
+/**
+ * @brief FolderWatcher::addWatch Starts to watch folder. Call it before the
+ * folder listing is read to not miss the changes.
+ * @param path Folder path in file system.
+ * @param catalogPath Folder full name in catalog for notifications.
+ * @return true if folder is watched.
+ */
+bool FolderWatcher::addWatch(const std::string &path,
+                             const std::string &catalogPath)
+{
+    if(!m_active) {
+        return false;
+    }
+#ifdef NGS_INOTIFY
+    MutexHolder holder(m_mutex);
+    int watch = inotify_add_watch(m_fd, path.c_str(), WATCH_MASK);
+    if(watch < 0) {
+        return false;
+    }
+    // The same watch is returned for the same folder
+    m_watchPaths[watch] = path;
+    WatchData &data = m_folders[path];
+    data.watch = watch;
+    data.catalogPath = catalogPath;
+    data.changes.added.clear();
+    data.changes.removed.clear();
+    data.changes.rescan = false;
+    return true;
+#else
+    ngsUnused(path);
+    ngsUnused(catalogPath);
+    return false;
+#endif // NGS_INOTIFY
+}
+
+/**
+ * @brief FolderWatcher::takeChanges Returns the folder changes collected since
+ * previous call and resets them.
+ * @param path Folder path in file system.
+ * @param changes The changes. If rescan is true the changes are unknown and
+ * folder must be read again.
+ * @return false if the folder is not watched.
+ */
+bool FolderWatcher::takeChanges(const std::string &path, FolderChanges &changes)
+{
+    MutexHolder holder(m_mutex);
+    if(!m_active) {
+        return false;
+    }
+    auto it = m_folders.find(path);
+    if(it == m_folders.end()) {
+        return false;
+    }
+    changes = it->second.changes;
+    it->second.changes.added.clear();
+    it->second.changes.removed.clear();
+    it->second.changes.rescan = false;
+    if(it->second.watch < 0) {
+        // The folder was removed or moved, the watch is not valid any more
+        m_folders.erase(it);
+        changes.rescan = true;
+    }
+    return true;
+}
+
+void FolderWatcher::setRescan(WatchData &data)
+{
+    data.changes.added.clear();
+    data.changes.removed.clear();
+    data.changes.rescan = true;
+}
+
+void FolderWatcher::addChange(int watch, const std::string &name, bool added,
+                              std::set<std::string> &changedFolders)
+{
+    auto pathIt = m_watchPaths.find(watch);
+    if(pathIt == m_watchPaths.end()) {
+        return;
+    }
+    auto it = m_folders.find(pathIt->second);
+    if(it == m_folders.end()) {
+        return;
+    }
+
+    FolderChanges &changes = it->second.changes;
+    if(!changes.rescan) {
+        // Keep the final state of each name
+        if(added) {
+            changes.added.insert(name);
+        }
+        else {
+            changes.added.erase(name);
+            changes.removed.insert(name);
+        }
+        if(changes.added.size() + changes.removed.size() > MAX_FOLDER_CHANGES) {
+            setRescan(it->second);
+        }
+    }
+    changedFolders.insert(it->second.catalogPath);
+}
+
+void FolderWatcher::readEvents()
+{
+#ifdef NGS_INOTIFY
+    std::vector<char> buffer(EVENT_BUFFER_SIZE);
+    std::set<std::string> changedFolders;
+    {
+        MutexHolder holder(m_mutex);
+        ssize_t length;
+        while((length = read(m_fd, buffer.data(), buffer.size())) > 0) {
+            ssize_t pos = 0;
+            while(pos < length) {
+                const struct inotify_event *event =
+                    reinterpret_cast<const struct inotify_event *>(buffer.data() + pos);
+                pos += sizeof(struct inotify_event) + event->len;
+
+                if(event->mask & IN_Q_OVERFLOW) {
+                    // Some events are lost
+                    for(auto &folder : m_folders) {
+                        setRescan(folder.second);
+                        changedFolders.insert(folder.second.catalogPath);
+                    }
+                    continue;
+                }
+
+                if(event->mask & IN_IGNORED) {
+                    auto pathIt = m_watchPaths.find(event->wd);
+                    if(pathIt != m_watchPaths.end()) {
+                        auto it = m_folders.find(pathIt->second);
+                        if(it != m_folders.end() && it->second.watch == event->wd) {
+                            it->second.watch = -1;
+                            setRescan(it->second);
+                        }
+                        m_watchPaths.erase(pathIt);
+                    }
+                    continue;
+                }
+
+                if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    if(event->mask & IN_MOVE_SELF) {
+                        // The path is not valid, IN_IGNORED will follow
+                        inotify_rm_watch(m_fd, event->wd);
+                    }
+                    auto pathIt = m_watchPaths.find(event->wd);
+                    if(pathIt != m_watchPaths.end()) {
+                        auto it = m_folders.find(pathIt->second);
+                        if(it != m_folders.end()) {
+                            setRescan(it->second);
+                            changedFolders.insert(it->second.catalogPath);
+                        }
+                    }
+                    continue;
+                }
+
+                if(event->len == 0) {
+                    continue;
+                }
+                std::string name(event->name);
+                if(event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addChange(event->wd, name, true, changedFolders);
+                }
+                else if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    addChange(event->wd, name, false, changedFolders);
+                }
+            }
+        }
+    }
+
+    for(const std::string &catalogPath : changedFolders) {
+        Notify::instance().onNotify(catalogPath, ngsChangeCode::CC_CHANGE_OBJECT);
+    }
+#endif // NGS_INOTIFY
+}
+
+void FolderWatcher::watchThread(void *data)
+{
+#ifdef NGS_INOTIFY
+    FolderWatcher *watcher = static_cast<FolderWatcher*>(data);
+    struct pollfd fds[2];
+    fds[0].fd = watcher->m_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = watcher->m_stopPipe[0];
+    fds[1].events = POLLIN;
+
+    while(!watcher->m_stop) {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        int result = poll(fds, 2, POLL_TIMEOUT);
+        if(result < 0 && errno != EINTR) {
+            CPLDebug("ngstore", "Folder watch failed, errno %d", errno);
+            // Folders will be read on refresh
+            MutexHolder holder(watcher->m_mutex);
+            watcher->m_active = false;
+            break;
+        }
+        if(fds[1].revents & POLLIN) {
+            break;
+        }
+        if(fds[0].revents & POLLIN) {
+            watcher->readEvents();
+        }
+    }
+#else
+    ngsUnused(data);
+#endif // NGS_INOTIFY
+}
+
+} // namespace ngs
@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSFOLDERWATCHER_H
+#define NGSFOLDERWATCHER_H
+
+// std
+#include <map>
+#include <set>
+#include <string>
+
+// gdal
+#include "cpl_multiproc.h"
+
+#include "util/mutex.h"
+
+namespace ngs {
+
+constexpr size_t MAX_FOLDER_CHANGES = 10000;
+
+/**
+ * @brief The FolderWatcher class Watches folders for files added, removed and
+ * renamed. The changes are collected in background thread and applied to
+ * catalog by Folder::refresh. The CC_CHANGE_OBJECT notification is sent for
+ * the changed folder.
+ * Only inotify is supported now. On other platforms the watcher is not active
+ * and folders are rescanned on refresh.
+ */
+class FolderWatcher
+{
+public:
+    typedef struct _folderChanges {
+        std::set<std::string> added;
+        std::set<std::string> removed;
+        bool rescan;
+    } FolderChanges;
+
+public:
+    FolderWatcher();
+    ~FolderWatcher();
+    bool isActive() const { return m_active; }
+    bool addWatch(const std::string &path, const std::string &catalogPath);
+    bool takeChanges(const std::string &path, FolderChanges &changes);
+
+private:
+    typedef struct _watchData {
+        int watch;
+        std::string catalogPath;
+        FolderChanges changes;
+    } WatchData;
+
+    void readEvents();
+    void addChange(int watch, const std::string &name, bool added,
+                   std::set<std::string> &changedFolders);
+    void setRescan(WatchData &data);
+    static void watchThread(void *data);
+
+private:
+    FolderWatcher(FolderWatcher const&) = delete;
+    FolderWatcher &operator= (FolderWatcher const&) = delete;
+
+private:
+    bool m_active;
+    int m_fd;
+    int m_stopPipe[2];
+    CPLJoinableThread *m_thread;
+    volatile bool m_stop;
+    std::map<int, std::string> m_watchPaths;
+    std::map<std::string, WatchData> m_folders;
+    Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSFOLDERWATCHER_H
@@ -58,6 +58,8 @@ bool LocalConnections::loadChildren()
     }
 
     LocalConnections *parent = const_cast<LocalConnections *>(this);
+    CatalogPtr catalog = Catalog::instance();
+    CatalogSnapshot *snapshot = catalog ? catalog->snapshot() : nullptr;
 
 #if (TARGET_OS_IPHONE == 1) || (TARGET_IPHONE_SIMULATOR == 1)
     // NOTE: For iOS (Mobile?) we don't need to store connections in file as
@@ -70,11 +72,20 @@ bool LocalConnections::loadChildren()
            homeDir = pwd->pw_dir;
     }
 
-    m_children.push_back(ObjectPtr(new Folder(parent, "Home", homeDir)));
+    appendChild(ObjectPtr(new Folder(parent, "Home", homeDir)));
     m_childrenLoaded = true;
     return true;
 #endif // TARGET_OS_IPHONE || TARGET_IPHONE_SIMULATOR
 
+    std::vector<CatalogSnapshot::FolderItem> folders;
+    if(nullptr != snapshot && snapshot->folders(m_path, folders)) {
+        for(const auto &folder : folders) {
+            appendChild(ObjectPtr(new Folder(parent, folder.name, folder.path)));
+        }
+        m_childrenLoaded = true;
+        return true;
+    }
+
     CPLJSONDocument doc;
     if(doc.Load (m_path)) {
         CPLJSONObject root = doc.GetRoot();
@@ -87,8 +98,9 @@ bool LocalConnections::loadChildren()
                 }
                 std::string connName = connection.GetString("name");
                 std::string connPath = connection.GetString("path");
-                m_children.push_back(
+                appendChild(
                             ObjectPtr(new Folder(parent, connName, connPath)));
+                folders.push_back({connName, connPath});
             }
         }
     }
@@ -216,9 +228,10 @@ bool LocalConnections::loadChildren()
 
            connections.Add(connection);
 
-           m_children.push_back(
+           appendChild(
                        ObjectPtr(new Folder(parent, connectionPath.first,
                                             connectionPath.second)));
+           folders.push_back({connectionPath.first, connectionPath.second});
        }
        root.Add("connections", connections);
        doc.Save(m_path);
@@ -226,6 +239,11 @@ bool LocalConnections::loadChildren()
        CPLDebug("ngstore", "Save connections file to %s", m_path.c_str());
     }
 
+    if(nullptr != snapshot) {
+        snapshot->setFolders(m_path, folders);
+        snapshot->saveIfChanged();
+    }
+
     m_childrenLoaded = true;
     return true;
 }
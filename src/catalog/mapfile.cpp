@@ -42,13 +42,13 @@ MapViewPtr MapFile::map() const
     return m_mapView;
 }
 
-bool MapFile::open()
+bool MapFile::open(const Options &options)
 {
     if(m_mapView && !m_mapView->isClosed()) {
         return true;
     }
     m_mapView = MapStore::initMap();
-    return m_mapView->open(this);
+    return m_mapView->open(this, options);
 }
 
 bool MapFile::save(MapViewPtr mapView)
@@ -33,7 +33,7 @@ public:
                      const std::string &name = "",
                      const std::string &path = "");
     MapViewPtr map() const;
-    bool open();
+    bool open(const Options &options = Options());
     bool save(MapViewPtr mapView);
 
     // static
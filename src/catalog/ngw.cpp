@@ -41,20 +41,6 @@ namespace ngs {
 
 constexpr const char *NGW_METADATA_DOMAIN = "ngw";
 
-static void addResourceInt(ObjectPtr parent, CPLJSONObject resource)
-{
-    auto group = ngsDynamicCast(NGWResourceGroup, parent);
-    if(group) {
-        group->addResource(resource);
-    }
-    else {
-        auto layer = ngsDynamicCast(NGWLayerDataset, parent);
-        if(layer) {
-            layer->addResource(resource);
-        }
-    }
-}
-
 //------------------------------------------------------------------------------
 // NGWConnectionBase
 //------------------------------------------------------------------------------
@@ -84,6 +70,79 @@ SpatialReferencePtr NGWConnectionBase::spatialReference() const
     return out;
 }
 
+/**
+ * @brief NGWConnectionBase::childResources Get resource children descriptions.
+ * The server response is cached per connection and revalidated with ETag or
+ * Last-Modified on next request, so reopening already browsed groups does not
+ * download the descriptions again.
+ * @param resourceId Parent resource identifier
+ * @return JSON array of child resources or invalid array on error.
+ */
+CPLJSONArray NGWConnectionBase::childResources(const std::string &resourceId)
+{
+    std::string etag, lastModified;
+    CPLJSONArray cached;
+    {
+        MutexHolder holder(m_resourceCacheMutex);
+        auto it = m_resourceCache.find(resourceId);
+        if(it != m_resourceCache.end()) {
+            etag = it->second.etag;
+            lastModified = it->second.lastModified;
+            cached = it->second.resources;
+        }
+    }
+
+    bool notModified = false;
+    http::HTTPResultPtr result = http::fetchIfModified(
+                ngw::getChildrenUrl(m_url, resourceId), etag, lastModified,
+                notModified);
+    if(nullptr == result || result->nStatus != 0 ||
+            result->pszErrBuf != nullptr) {
+        outMessage(COD_REQUEST_FAILED, nullptr == result ?
+                       _("Unexpected error") : result->pszErrBuf);
+        return CPLJSONArray();
+    }
+
+    if(notModified && cached.IsValid()) {
+        return cached;
+    }
+
+    CPLJSONDocument doc;
+    if(result->nDataLen == 0 || !doc.LoadMemory(result->pabyData,
+                                                result->nDataLen)) {
+        return CPLJSONArray();
+    }
+    CPLJSONArray resources(doc.GetRoot());
+    if(!resources.IsValid()) {
+        return CPLJSONArray();
+    }
+
+    CachedResources item;
+    item.etag = fromCString(CSLFetchNameValue(result->papszHeaders, "ETag"));
+    item.lastModified =
+            fromCString(CSLFetchNameValue(result->papszHeaders, "Last-Modified"));
+    MutexHolder holder(m_resourceCacheMutex);
+    if(item.etag.empty() && item.lastModified.empty()) {
+        // Nothing to revalidate with
+        m_resourceCache.erase(resourceId);
+    }
+    else {
+        item.resources = resources;
+        m_resourceCache[resourceId] = item;
+    }
+    return resources;
+}
+
+/**
+ * @brief NGWConnectionBase::clearResourceCache Drop cached resource
+ * descriptions, i.e. on connection credentials change.
+ */
+void NGWConnectionBase::clearResourceCache()
+{
+    MutexHolder holder(m_resourceCacheMutex);
+    m_resourceCache.clear();
+}
+
 //------------------------------------------------------------------------------
 // NGWResourceBase
 //------------------------------------------------------------------------------
@@ -246,7 +305,7 @@ bool NGWResource::canDestroy() const
 bool NGWResource::rename(const std::string &newName)
 {
     if(NGWResourceBase::changeName(newName)) {
-        m_name = newName;
+        setName(newName);
         return true;
     }
     return false;
@@ -336,10 +395,41 @@ NGWResourceGroup::NGWResourceGroup(ObjectContainer * const parent,
                                    const CPLJSONObject &resource,
                                    NGWConnectionBase *connection) :
     ObjectContainer(parent, CAT_NGW_GROUP, name, ""), // Don't need file system path
-    NGWResourceBase(resource, connection)
+    NGWResourceBase(resource, connection),
+    m_hasRemoteChildren(resource.GetBool("resource/children", true))
+{
+    // Children are requested on first access
+    m_childrenLoaded = false;
+}
+
+bool NGWResourceGroup::loadChildren()
 {
-    // Expected search API is available
+    if(m_childrenLoaded) {
+        return true;
+    }
+
+    if(nullptr == m_connection) {
+        return false;
+    }
+
+    CPLJSONArray resources = m_connection->childResources(m_resourceId);
+    if(!resources.IsValid()) {
+        return false;
+    }
+
+    for(int i = 0; i < resources.Size(); ++i) {
+        addResource(resources[i]);
+    }
     m_childrenLoaded = true;
+    return true;
+}
+
+bool NGWResourceGroup::hasChildren() const
+{
+    if(!m_childrenLoaded) {
+        return m_hasRemoteChildren;
+    }
+    return ObjectContainer::hasChildren();
 }
 
 ObjectPtr NGWResourceGroup::getResource(const std::string &resourceId) const
@@ -459,7 +549,7 @@ bool NGWResourceGroup::canDestroy() const
 bool NGWResourceGroup::rename(const std::string &newName)
 {
     if(NGWResourceBase::changeName(newName)) {
-        m_name = newName;
+        setName(newName);
         return true;
     }
     return false;
@@ -901,55 +991,12 @@ bool NGWConnection::loadChildren()
     fillProperties();
 
     if(!m_url.empty()) {
-        fillCapabilities();
-        if(!m_searchApiUrl.empty()) {
-            CPLJSONDocument searchReq;
-            if(searchReq.LoadUrl(m_searchApiUrl + "?serialization=full",
-                                 http::getGDALHeaders(m_url))) {
-                CPLJSONArray root(searchReq.GetRoot());
-                if(root.IsValid()) {
-                    m_childrenLoaded = true;
-                    std::map<std::string, CPLJSONObject> noParentResources;
-                    for(int i = 0; i < root.Size(); ++i) {
-                        CPLJSONObject resource = root[i];
-                        std::string resourceId =
-                                resource.GetString("resource/parent/id", "-1");
-                        if(resourceId != "-1") {
-                            auto parent = getResource(resourceId);
-                            if(parent) {
-                                addResourceInt(parent, resource);
-                            }
-                            else {
-                                noParentResources[resourceId] = resource;
-                            }
-                        }
-                    }
-
-                    int counter = static_cast<int>(noParentResources.size() * 1.3);
-                    while(!noParentResources.empty()) {
-                        auto it = noParentResources.begin();
-                        ObjectPtr parent;
-                        while(it != noParentResources.end()) {
-                            if((parent = getResource(it->first))) {
-                                break;
-                            }
-                            ++it;
-                        }
-
-                        if(parent) {
-                            addResourceInt(parent, it->second);
-                            noParentResources.erase(it);
-                        }
-
-                        // Protect from infinity loop.
-                        counter--;
-                        if(counter < 0) {
-                            break;
-                        }
-                    }
-                }
-            }
+        if(m_availableCls.empty()) {
+            fillCapabilities();
         }
+        // Only the root level is loaded here, the groups load own children on
+        // first access.
+        NGWResourceGroup::loadChildren();
     }
 
     if(!isOpened()) {
@@ -1024,6 +1071,22 @@ void NGWConnection::fillProperties() const
     }
 }
 
+/**
+ * @brief NGWConnection::connectionOptions Options to check the connection via
+ * ConnectionFactory::checkRemoteConnection.
+ * @return url, login, password and is_guest options.
+ */
+Options NGWConnection::connectionOptions() const
+{
+    fillProperties();
+    Options out;
+    out.add(URL_KEY, m_url);
+    out.add(KEY_LOGIN, m_user);
+    out.add(KEY_PASSWORD, m_password);
+    out.add(KEY_IS_GUEST, m_user.empty() || compare(m_user, "guest"));
+    return out;
+}
+
 Properties NGWConnection::properties(const std::string &domain) const
 {
     fillProperties();
@@ -1112,6 +1175,8 @@ bool NGWConnection::setProperty(const std::string &key, const std::string &value
     }
 
     close();
+    clearResourceCache();
+    m_availableCls.clear();
 
     return true;
 }
@@ -24,6 +24,7 @@
 #include "ds/coordinatetransformation.h"
 #include "objectcontainer.h"
 #include "remoteconnections.h"
+#include "util/mutex.h"
 
 #include "cpl_json.h"
 
@@ -72,6 +73,13 @@ namespace ngw {
     bool updateFeature(const std::string &url, const std::string &resourceId,
                        const std::string &featureId, const std::string &payload,
                        char **httpOptions);
+    std::string getFeaturesUrl(const std::string &url,
+                               const std::string &resourceId);
+    bool patchFeatures(const std::string &url, const std::string &resourceId,
+                       const std::string &payload, char **httpOptions,
+                       std::vector<GIntBig> &ids);
+    bool deleteFeatures(const std::string &url, const std::string &resourceId,
+                        const std::string &payload, char **httpOptions);
 
     // Attachments
     std::string getAttachmentUrl(const std::string &url,
@@ -108,10 +116,21 @@ public:
     bool isClsSupported(const std::string &cls) const;
     std::string userPwd() const;
     SpatialReferencePtr spatialReference() const;
+    CPLJSONArray childResources(const std::string &resourceId);
+    void clearResourceCache();
+
+protected:
+    typedef struct _cachedResources {
+        std::string etag, lastModified;
+        CPLJSONArray resources;
+    } CachedResources;
+
 protected:
     mutable std::string m_url, m_user;
     mutable std::string m_password; // TODO: When move authstore to GDAL remove password storing.
     std::vector<std::string> m_availableCls;
+    std::map<std::string, CachedResources> m_resourceCache;
+    Mutex m_resourceCacheMutex;
 };
 
 /**
@@ -191,6 +210,8 @@ public:
                               NGWConnectionBase *connection = nullptr);
     virtual ObjectPtr getResource(const std::string &resourceId) const;
     virtual void addResource(const CPLJSONObject &resource);
+    virtual bool loadChildren() override;
+    virtual bool hasChildren() const override;
 
     // Object interface
 public:
@@ -216,6 +237,9 @@ public:
 private:
     std::string normalizeDatasetName(const std::string &name) const;
     bool isNameValid(const std::string &name) const;
+
+protected:
+    bool m_hasRemoteChildren;
 };
 
 /**
@@ -267,6 +291,7 @@ public:
 
 public:
     void fillProperties() const;
+    Options connectionOptions() const;
 
 private:
     void fillCapabilities();
@@ -327,6 +327,98 @@ bool updateFeature(const std::string &url, const std::string &resourceId,
     return result;
 }
 
+std::string getFeaturesUrl(const std::string &url,
+                           const std::string &resourceId)
+{
+    return getResourceUrl(url, resourceId) + "/feature/";
+}
+
+/**
+ * @brief patchFeatures Create and update features in one request.
+ * @param url NextGIS Web url
+ * @param resourceId Vector layer resource identifier
+ * @param payload JSON array of features. Features without id are created.
+ * @param httpOptions HTTP options. Will be destroyed inside function
+ * @param ids Identifiers of features in payload order returned by server
+ * @return True on success
+ */
+bool patchFeatures(const std::string &url, const std::string &resourceId,
+                   const std::string &payload, char **httpOptions,
+                   std::vector<GIntBig> &ids)
+{
+    CPLErrorReset();
+    std::string payloadInt = "POSTFIELDS=" + payload;
+
+    httpOptions = CSLAddString(httpOptions, "CUSTOMREQUEST=PATCH");
+    httpOptions = CSLAddString(httpOptions, payloadInt.c_str());
+    httpOptions = CSLAddString(httpOptions,
+        "HEADERS=Content-Type: application/json\r\nAccept: */*");
+
+    http::HTTPResultPtr httpResult = CPLHTTPFetch(
+                getFeaturesUrl(url, resourceId).c_str(), httpOptions);
+    CSLDestroy(httpOptions);
+    if(!httpResult) {
+        errorMessage(_("Update features in feature class %s failed"),
+                     resourceId.c_str());
+        return false;
+    }
+
+    if(httpResult->nStatus != 0 || httpResult->pszErrBuf != nullptr) {
+        reportError(httpResult->pabyData, httpResult->nDataLen);
+        return false;
+    }
+
+    CPLJSONDocument result;
+    if(!result.LoadMemory(httpResult->pabyData, httpResult->nDataLen)) {
+        errorMessage(_("Unexpected error occurred."));
+        return false;
+    }
+
+    CPLJSONArray items = result.GetRoot().ToArray();
+    ids.clear();
+    ids.reserve(static_cast<size_t>(items.Size()));
+    for(int i = 0; i < items.Size(); ++i) {
+        ids.push_back(items[i].GetLong("id", NOT_FOUND));
+    }
+    return true;
+}
+
+/**
+ * @brief deleteFeatures Delete features in one request.
+ * @param url NextGIS Web url
+ * @param resourceId Vector layer resource identifier
+ * @param payload JSON array of objects with feature id
+ * @param httpOptions HTTP options. Will be destroyed inside function
+ * @return True on success
+ */
+bool deleteFeatures(const std::string &url, const std::string &resourceId,
+                    const std::string &payload, char **httpOptions)
+{
+    CPLErrorReset();
+    std::string payloadInt = "POSTFIELDS=" + payload;
+
+    httpOptions = CSLAddString(httpOptions, "CUSTOMREQUEST=DELETE");
+    httpOptions = CSLAddString(httpOptions, payloadInt.c_str());
+    httpOptions = CSLAddString(httpOptions,
+        "HEADERS=Content-Type: application/json\r\nAccept: */*");
+
+    http::HTTPResultPtr httpResult = CPLHTTPFetch(
+                getFeaturesUrl(url, resourceId).c_str(), httpOptions);
+    CSLDestroy(httpOptions);
+    bool result = false;
+    if(httpResult) {
+        result = httpResult->nStatus == 0 && httpResult->pszErrBuf == nullptr;
+        if(!result) {
+            reportError(httpResult->pabyData, httpResult->nDataLen);
+        }
+    }
+    else {
+        errorMessage(_("Delete features in feature class %s failed"),
+                     resourceId.c_str());
+    }
+    return result;
+}
+
 bool deleteAttachments(const std::string &url, const std::string &resourceId,
                        const std::string &featureId, char **httpOptions)
 {
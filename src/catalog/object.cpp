@@ -147,7 +147,14 @@ bool Object::sync()
 
 void Object::setName(const std::string &value)
 {
+    if(m_name == value) {
+        return;
+    }
+    std::string oldName = m_name;
     m_name = value;
+    if(nullptr != m_parent) {
+        m_parent->onChildRenamed(this, oldName);
+    }
 }
 
 void Object::setPath(const std::string &value)
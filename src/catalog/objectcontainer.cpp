@@ -21,14 +21,20 @@
 #include "file.h"
 #include "objectcontainer.h"
 
+// std
+#include <atomic>
+
 #include "api_priv.h"
 #include "catalog.h"
+#include "filter.h"
 #include "util/stringutil.h"
 
 #include <util/notify.h>
 
 namespace ngs {
 
+static std::atomic<unsigned int> gTreeVersion(0);
+
 ObjectContainer::ObjectContainer(ObjectContainer * const parent,
                                  const enum ngsCatalogObjectType type,
                                  const std::string &name,
@@ -67,20 +73,15 @@ ObjectPtr ObjectContainer::getObject(const std::string &path)
     }
 
     // Search child with name searchName
-    for(const ObjectPtr &child : m_children) {
-        if(compare(child->name(), searchName)) {
-            if(pathRight.empty()) {
-                // No more path elements
-                return child;
-            }
-            else {
-                ObjectContainer * const container =
-                        ngsDynamicCast(ObjectContainer, child);
-                if(nullptr != container) {
-                    return container->getObject(pathRight);
-                }
-            }
-        }
+    ObjectPtr child = getChild(searchName);
+    if(!child || pathRight.empty()) {
+        // No more path elements
+        return child;
+    }
+
+    ObjectContainer * const container = ngsDynamicCast(ObjectContainer, child);
+    if(nullptr != container) {
+        return container->getObject(pathRight);
     }
     return ObjectPtr();
 }
@@ -88,7 +89,9 @@ ObjectPtr ObjectContainer::getObject(const std::string &path)
 void ObjectContainer::clear()
 {
     m_children.clear();
+    m_childrenIndex.clear();
     m_childrenLoaded = false;
+    increaseTreeVersion();
 }
 
 
@@ -142,12 +145,18 @@ int ObjectContainer::paste(ObjectPtr child, bool move, const Options &options,
 
 ObjectPtr ObjectContainer::getChild(const std::string &name) const
 {
-    for(const ObjectPtr &child : m_children) {
-        if(compare(child->name(), name)) {
-            return child;
-        }
+    auto it = m_childrenIndex.find(indexKey(name));
+    if(it == m_childrenIndex.end()) {
+        return ObjectPtr();
     }
-    return ObjectPtr();
+    if(compare(it->second->name(), name)) {
+        return it->second;
+    }
+
+    // The child name was changed without onChildRenamed, rebuild the entry
+    reindexName(name);
+    it = m_childrenIndex.find(indexKey(name));
+    return it == m_childrenIndex.end() ? ObjectPtr() : it->second;
 }
 
 bool ObjectContainer::loadChildren()
@@ -182,6 +191,15 @@ std::string ObjectContainer::createUniqueName(const std::string &name,
 
 bool ObjectContainer::hasChild(const std::string &name) const
 {
+    auto it = m_childrenIndex.find(indexKey(name));
+    if(it == m_childrenIndex.end()) {
+        return false;
+    }
+    if(compare(it->second->name(), name, true)) {
+        return true;
+    }
+
+    // Names differ in case only
     for(const auto &child : m_children) {
         if(compare(child->name(), name, true)) {
             return true;
@@ -199,7 +217,7 @@ void ObjectContainer::onChildDeleted(Object *child)
     while(it != m_children.end()) {
         if(it->get() == child) {
             auto name = child->fullName();
-            m_children.erase(it);
+            removeChild(it);
             Notify::instance().onNotify(name, ngsChangeCode::CC_DELETE_OBJECT);
             return;
         }
@@ -228,6 +246,23 @@ ObjectPtr ObjectContainer::onChildCreated(Object *child)
     return childPtr;
 }
 
+/**
+ * @brief ObjectContainer::onChildRenamed Updates the children name index.
+ * Executes from Object::setName.
+ * @param child The renamed child.
+ * @param oldName The child name before rename.
+ */
+void ObjectContainer::onChildRenamed(Object *child, const std::string &oldName)
+{
+    if(nullptr == child) {
+        return;
+    }
+
+    reindexName(oldName);
+    reindexName(child->name());
+    increaseTreeVersion();
+}
+
 void ObjectContainer::removeDuplicates(std::vector<std::string> &deleteNames,
                                        std::vector<std::string> &addNames)
 {
@@ -261,9 +296,102 @@ std::vector<ObjectPtr> ObjectContainer::getChildren() const
     return m_children;
 }
 
+/**
+ * @brief ObjectContainer::queryChildren Returns the page of children which
+ * pass the filter and the name pattern. Only the children of the page are
+ * copied.
+ * @param filter Type filter.
+ * @param namePattern Wildcard name pattern ('*' and '?'). Empty matches all.
+ * @param offset Count of matched children to skip.
+ * @param limit Max count of children to return. 0 for no limit.
+ * @return Children array.
+ */
+std::vector<ObjectPtr> ObjectContainer::queryChildren(const Filter &filter,
+                                                      const std::string &namePattern,
+                                                      size_t offset,
+                                                      size_t limit) const
+{
+    std::vector<ObjectPtr> out;
+    size_t matched = 0;
+    for(const ObjectPtr &child : m_children) {
+        if(!filter.canDisplay(child) ||
+           !matchPattern(child->name(), namePattern)) {
+            continue;
+        }
+        if(matched++ < offset) {
+            continue;
+        }
+        out.push_back(child);
+        if(limit > 0 && out.size() >= limit) {
+            break;
+        }
+    }
+    return out;
+}
+
 void ObjectContainer::addChild(ObjectPtr object)
+{
+    appendChild(object);
+}
+
+void ObjectContainer::appendChild(ObjectPtr object) const
 {
     m_children.push_back(object);
+    if(!object) {
+        return;
+    }
+    // Keep the first child with the same name as the linear search did
+    m_childrenIndex.insert(std::make_pair(indexKey(object->name()), object));
+}
+
+std::vector<ObjectPtr>::iterator ObjectContainer::removeChild(
+        std::vector<ObjectPtr>::iterator it) const
+{
+    ObjectPtr child = *it;
+    auto next = m_children.erase(it);
+    if(!child) {
+        return next;
+    }
+    auto indexIt = m_childrenIndex.find(indexKey(child->name()));
+    if(indexIt != m_childrenIndex.end() && indexIt->second == child) {
+        reindexName(child->name());
+    }
+    increaseTreeVersion();
+    return next;
+}
+
+/**
+ * @brief ObjectContainer::treeVersion Returns the value changed on any child
+ * remove or rename in the catalog tree. The cached paths are valid while the
+ * value is the same.
+ * @return Catalog tree version.
+ */
+unsigned int ObjectContainer::treeVersion()
+{
+    return gTreeVersion;
+}
+
+void ObjectContainer::increaseTreeVersion()
+{
+    ++gTreeVersion;
+}
+
+std::string ObjectContainer::indexKey(const std::string &name)
+{
+    // Same case folding as compare
+    return toLower(name);
+}
+
+void ObjectContainer::reindexName(const std::string &name) const
+{
+    std::string key = indexKey(name);
+    m_childrenIndex.erase(key);
+    for(const ObjectPtr &child : m_children) {
+        if(child && compare(child->name(), name)) {
+            m_childrenIndex.insert(std::make_pair(key, child));
+            return;
+        }
+    }
 }
 
 
@@ -21,12 +21,17 @@
 #ifndef NGSOBJECTCONTAINER_H
 #define NGSOBJECTCONTAINER_H
 
+// std
+#include <unordered_map>
+
 #include "object.h"
 
 #include "util/progress.h"
 
 namespace ngs {
 
+class Filter;
+
 constexpr const char *URL_KEY = "url";
 constexpr unsigned short MAX_EQUAL_NAMES = 100;
 
@@ -54,6 +59,10 @@ public:
                       const Progress &progress = Progress());
 
     std::vector<ObjectPtr> getChildren() const;
+    std::vector<ObjectPtr> queryChildren(const Filter &filter,
+                                         const std::string &namePattern = "",
+                                         size_t offset = 0,
+                                         size_t limit = 0) const;
     ObjectPtr getChild(const std::string &name) const;
     virtual bool loadChildren();
     virtual std::string createUniqueName(const std::string &name,
@@ -66,6 +75,7 @@ public:
 public:
     virtual void onChildDeleted(Object *child);
     virtual ObjectPtr onChildCreated(Object *child);
+    void onChildRenamed(Object *child, const std::string &oldName);
 
 protected:
     /**
@@ -74,14 +84,31 @@ protected:
      * @param object The child object to add.
      */
     virtual void addChild(ObjectPtr object);
+    /**
+     * @brief appendChild Adds child to children list and name index. Use it
+     * instead of direct m_children modification.
+     * @param object The child object to add.
+     */
+    void appendChild(ObjectPtr object) const;
+    std::vector<ObjectPtr>::iterator removeChild(
+            std::vector<ObjectPtr>::iterator it) const;
 
 protected:
     static void removeDuplicates(std::vector<std::string> &deleteNames,
                                  std::vector<std::string> &addNames);
+    static unsigned int treeVersion();
+
+private:
+    static std::string indexKey(const std::string &name);
+    void reindexName(const std::string &name) const;
+    static void increaseTreeVersion();
 
 protected:
     mutable std::vector<ObjectPtr> m_children;
     bool m_childrenLoaded;
+
+private:
+    mutable std::unordered_map<std::string, ObjectPtr> m_childrenIndex;
 };
 
 }
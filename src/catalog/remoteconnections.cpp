@@ -69,9 +69,14 @@ bool Connections::loadChildren()
         std::vector<std::string> objectNames =
                 Folder::fillChildrenNames(m_path, items);
 
-        Catalog::instance()->createObjects(m_parent->getChild(m_name),
-                                           objectNames);
+        CatalogPtr catalog = Catalog::instance();
+        catalog->createObjects(m_parent->getChild(m_name), objectNames);
 
+        // Connection file types may be parsed
+        CatalogSnapshot *snapshot = catalog->snapshot();
+        if(nullptr != snapshot) {
+            snapshot->saveIfChanged();
+        }
     }
 
     return true;
@@ -120,7 +125,7 @@ void Connections::refresh()
             auto itdn = std::find(deleteNames.begin(), deleteNames.end(), name);
             if(itdn != deleteNames.end()) {
                 deleteNames.erase(itdn);
-                it = m_children.erase(it);
+                it = removeChild(it);
             }
             else {
                 ++it;
@@ -257,7 +262,7 @@ ObjectPtr GISServerConnections::create(const enum ngsCatalogObjectType type,
     case CAT_CONTAINER_NGW:
         if(ConnectionFactory::createRemoteConnection(type, newPath, options)) {
             child = ObjectPtr(new NGWConnection(this, newName, newPath));
-            m_children.push_back(child);
+            appendChild(child);
         }
         break;
     default:
@@ -20,8 +20,21 @@
  ****************************************************************************/
 #include "coordinatetransformation.h"
 
+// std
+#include <cmath>
+
+// gdal
+#include "cpl_string.h"
+
+#include "api_priv.h"
+
 namespace ngs {
 
+// Idle transformations kept for each EPSG codes pair
+constexpr size_t MAX_CACHED_TRANSFORMATIONS = 8;
+constexpr double MERCATOR_RADIUS = 6378137.0;
+constexpr double RAD2DEG = 180.0 / M_PI;
+
 //------------------------------------------------------------------------------
 // SpatialReferencePtr
 //------------------------------------------------------------------------------
@@ -57,12 +70,40 @@ bool SpatialReferencePtr::setFromUserInput(const std::string &input)
     return false;
 }
 
+/**
+ * @brief SpatialReferencePtr::epsg Get EPSG code of spatial reference.
+ * @return EPSG code or 0 if spatial reference has no EPSG authority.
+ */
+int SpatialReferencePtr::epsg() const
+{
+    if(nullptr == get()) {
+        return 0;
+    }
+    const char *authority = get()->GetAuthorityName(nullptr);
+    if(nullptr == authority || !EQUAL(authority, "EPSG")) {
+        return 0;
+    }
+    const char *code = get()->GetAuthorityCode(nullptr);
+    return nullptr == code ? 0 : atoi(code);
+}
+
+/**
+ * @brief SpatialReferencePtr::importFromEPSG Create spatial reference by EPSG
+ * code. The definition is parsed once and cloned from the cache after.
+ * @param EPSG EPSG code.
+ * @return Spatial reference or null if EPSG code is not supported.
+ */
 SpatialReferencePtr SpatialReferencePtr::importFromEPSG(int EPSG)
+{
+    return TransformationCache::instance().spatialReference(EPSG);
+}
+
+static SpatialReferencePtr parseEPSG(int EPSG)
 {
     SpatialReferencePtr sr(new OGRSpatialReference());
     if(sr->importFromEPSG(EPSG) == OGRERR_NONE) {
         sr->SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
-        return sr;        
+        return sr;
     }
     return nullptr;
 }
@@ -90,14 +131,32 @@ SpatialReferencePtr SpatialDataset::spatialReference() const
 //------------------------------------------------------------------------------
 
 CoordinateTransformation::CoordinateTransformation(
-        SpatialReferencePtr srcSRS, SpatialReferencePtr dstSRS)
+        SpatialReferencePtr srcSRS, SpatialReferencePtr dstSRS) :
+    m_oCT(nullptr),
+    m_identity(false),
+    m_fastPath(FastPath::NONE),
+    m_srcEPSG(0),
+    m_dstEPSG(0)
 {
-    if (nullptr != srcSRS && nullptr != dstSRS && !srcSRS->IsSame(dstSRS)) {
-        m_oCT = static_cast<OGRCoordinateTransformation*>(
-                              OGRCreateCoordinateTransformation(srcSRS, dstSRS));
-    }
-    else {
-        m_oCT = nullptr;
+    if (nullptr != srcSRS && nullptr != dstSRS) {
+        if(srcSRS->IsSame(dstSRS)) {
+            m_identity = true;
+        }
+        else {
+            m_oCT = static_cast<OGRCoordinateTransformation*>(
+                        OGRCreateCoordinateTransformation(srcSRS, dstSRS));
+            // Closed form WGS84 <-> Web Mercator for longitude, latitude order
+            int srcEPSG = srcSRS.epsg();
+            int dstEPSG = dstSRS.epsg();
+            if(srcEPSG == 4326 && dstEPSG == 3857 &&
+                    srcSRS->GetAxisMappingStrategy() == OAMS_TRADITIONAL_GIS_ORDER) {
+                m_fastPath = FastPath::WGS84_TO_MERCATOR;
+            }
+            else if(srcEPSG == 3857 && dstEPSG == 4326 &&
+                    dstSRS->GetAxisMappingStrategy() == OAMS_TRADITIONAL_GIS_ORDER) {
+                m_fastPath = FastPath::MERCATOR_TO_WGS84;
+            }
+        }
     }
 }
 
@@ -110,9 +169,247 @@ CoordinateTransformation::~CoordinateTransformation()
 
 bool CoordinateTransformation::transform(OGRGeometry *geom)
 {
+    if(m_identity) {
+        return true;
+    }
+    if(m_fastPath != FastPath::NONE &&
+            wkbFlatten(geom->getGeometryType()) == wkbPoint) {
+        OGRPoint *pt = static_cast<OGRPoint*>(geom);
+        double x = pt->getX();
+        double y = pt->getY();
+        if(!transform(1, &x, &y)) {
+            return false;
+        }
+        pt->setX(x);
+        pt->setY(y);
+        if(nullptr != m_oCT) {
+            pt->assignSpatialReference(m_oCT->GetTargetCS());
+        }
+        return true;
+    }
     if(nullptr == m_oCT)
         return false;
     return geom->transform(m_oCT) == OGRERR_NONE;
 }
 
+/**
+ * @brief CoordinateTransformation::transform Transform coordinates in place.
+ * @param count Coordinates count.
+ * @param x X coordinates array.
+ * @param y Y coordinates array.
+ * @param z Z coordinates array or null.
+ * @return True if all coordinates transformed. Coordinates are left unchanged
+ * if source and destination spatial references are the same.
+ */
+bool CoordinateTransformation::transform(int count, double *x, double *y,
+                                         double *z)
+{
+    if(m_identity) {
+        return true;
+    }
+    switch(m_fastPath) {
+    case FastPath::WGS84_TO_MERCATOR:
+        return wgs84ToMercator(count, x, y);
+    case FastPath::MERCATOR_TO_WGS84:
+        mercatorToWgs84(count, x, y);
+        return true;
+    case FastPath::NONE:
+        break;
+    }
+    if(nullptr == m_oCT) {
+        return false;
+    }
+    return m_oCT->Transform(count, x, y, z) == TRUE;
+}
+
+static double wrapLongitude(double lon)
+{
+    if(lon > 180.0 || lon < -180.0) {
+        lon -= 360.0 * std::floor((lon + 180.0) / 360.0);
+    }
+    return lon;
+}
+
+/**
+ * @brief CoordinateTransformation::wgs84ToMercator Spherical Web Mercator
+ * forward projection. Plain loops over arrays, so compiler can vectorize them.
+ * @param count Coordinates count.
+ * @param x Longitudes array.
+ * @param y Latitudes array.
+ * @return False if some latitudes are poles or out of range, those points are
+ * set to HUGE_VAL as PROJ does.
+ */
+bool CoordinateTransformation::wgs84ToMercator(int count, double *x, double *y)
+{
+    bool result = true;
+    for(int i = 0; i < count; ++i) {
+        if(std::fabs(y[i]) >= 90.0) {
+            x[i] = HUGE_VAL;
+            y[i] = HUGE_VAL;
+            result = false;
+            continue;
+        }
+        x[i] = MERCATOR_RADIUS * DEG2RAD * wrapLongitude(x[i]);
+        y[i] = MERCATOR_RADIUS * std::asinh(std::tan(y[i] * DEG2RAD));
+    }
+    return result;
+}
+
+/**
+ * @brief CoordinateTransformation::mercatorToWgs84 Spherical Web Mercator
+ * inverse projection.
+ * @param count Coordinates count.
+ * @param x Eastings array.
+ * @param y Northings array.
+ */
+void CoordinateTransformation::mercatorToWgs84(int count, double *x, double *y)
+{
+    for(int i = 0; i < count; ++i) {
+        x[i] = wrapLongitude(x[i] / MERCATOR_RADIUS * RAD2DEG);
+        y[i] = std::atan(std::sinh(y[i] / MERCATOR_RADIUS)) * RAD2DEG;
+    }
+}
+
+//------------------------------------------------------------------------------
+// TransformationCache
+//------------------------------------------------------------------------------
+
+TransformationCache &TransformationCache::instance()
+{
+    static TransformationCache cache;
+    return cache;
+}
+
+TransformationCache::~TransformationCache()
+{
+    clear();
+}
+
+/**
+ * @brief TransformationCache::spatialReference Get spatial reference by EPSG
+ * code. Unsupported codes are cached too.
+ * @param EPSG EPSG code.
+ * @return Copy of cached spatial reference, so it can be modified by caller,
+ * or null if EPSG code is not supported.
+ */
+SpatialReferencePtr TransformationCache::spatialReference(int EPSG)
+{
+    MutexHolder holder(m_mutex);
+    auto it = m_spatialReferences.find(EPSG);
+    if(it == m_spatialReferences.end()) {
+        it = m_spatialReferences.insert(
+                    std::make_pair(EPSG, parseEPSG(EPSG))).first;
+    }
+    if(nullptr == it->second) {
+        return nullptr;
+    }
+    return SpatialReferencePtr(it->second->Clone());
+}
+
+/**
+ * @brief TransformationCache::take Take transformation for exclusive use.
+ * @param fromEPSG Source EPSG code.
+ * @param toEPSG Destination EPSG code.
+ * @return Transformation which must be returned by put() or null if EPSG codes
+ * are not supported.
+ */
+CoordinateTransformation *TransformationCache::take(int fromEPSG, int toEPSG)
+{
+    {
+        MutexHolder holder(m_mutex);
+        auto it = m_transformations.find(std::make_pair(fromEPSG, toEPSG));
+        if(it != m_transformations.end() && !it->second.empty()) {
+            CoordinateTransformation *ct = it->second.back();
+            it->second.pop_back();
+            return ct;
+        }
+    }
+
+    SpatialReferencePtr srcSRS = spatialReference(fromEPSG);
+    SpatialReferencePtr dstSRS = spatialReference(toEPSG);
+    if(nullptr == srcSRS || nullptr == dstSRS) {
+        return nullptr;
+    }
+    CoordinateTransformation *ct = new CoordinateTransformation(srcSRS, dstSRS);
+    ct->m_srcEPSG = fromEPSG;
+    ct->m_dstEPSG = toEPSG;
+    return ct;
+}
+
+/**
+ * @brief TransformationCache::take Take transformation for exclusive use.
+ * If spatial references have no EPSG codes, new uncached transformation is
+ * created.
+ * @param srcSRS Source spatial reference.
+ * @param dstSRS Destination spatial reference.
+ * @return Transformation which must be returned by put().
+ */
+CoordinateTransformation *TransformationCache::take(
+        const SpatialReferencePtr &srcSRS, const SpatialReferencePtr &dstSRS)
+{
+    int fromEPSG = srcSRS.epsg();
+    int toEPSG = dstSRS.epsg();
+    if(fromEPSG != 0 && toEPSG != 0) {
+        CoordinateTransformation *ct = take(fromEPSG, toEPSG);
+        if(nullptr != ct) {
+            return ct;
+        }
+    }
+    return new CoordinateTransformation(srcSRS, dstSRS);
+}
+
+/**
+ * @brief TransformationCache::put Return transformation taken by take().
+ * Uncached transformations and transformations over the limit are destroyed.
+ * @param ct Transformation.
+ */
+void TransformationCache::put(CoordinateTransformation *ct)
+{
+    if(nullptr == ct) {
+        return;
+    }
+    if(ct->m_srcEPSG != 0 && ct->m_dstEPSG != 0) {
+        MutexHolder holder(m_mutex);
+        auto &idle = m_transformations[std::make_pair(ct->m_srcEPSG,
+                                                      ct->m_dstEPSG)];
+        if(idle.size() < MAX_CACHED_TRANSFORMATIONS) {
+            idle.push_back(ct);
+            return;
+        }
+    }
+    delete ct;
+}
+
+void TransformationCache::clear()
+{
+    MutexHolder holder(m_mutex);
+    for(auto &item : m_transformations) {
+        for(CoordinateTransformation *ct : item.second) {
+            delete ct;
+        }
+    }
+    m_transformations.clear();
+    m_spatialReferences.clear();
+}
+
+//------------------------------------------------------------------------------
+// CachedTransformation
+//------------------------------------------------------------------------------
+
+CachedTransformation::CachedTransformation(int fromEPSG, int toEPSG) :
+    m_ct(TransformationCache::instance().take(fromEPSG, toEPSG))
+{
+}
+
+CachedTransformation::CachedTransformation(const SpatialReferencePtr &srcSRS,
+                                           const SpatialReferencePtr &dstSRS) :
+    m_ct(TransformationCache::instance().take(srcSRS, dstSRS))
+{
+}
+
+CachedTransformation::~CachedTransformation()
+{
+    TransformationCache::instance().put(m_ct);
+}
+
 }
@@ -21,12 +21,17 @@
 #ifndef NGSCOORDINATETRANSFORMATION_H
 #define NGSCOORDINATETRANSFORMATION_H
 
+// std
+#include <map>
 #include <memory>
+#include <vector>
 
 // gdal
 #include "ogr_spatialref.h"
 #include "ogrsf_frmts.h"
 
+#include "util/mutex.h"
+
 namespace ngs {
 
 class SpatialReferencePtr : public std::shared_ptr<OGRSpatialReference>
@@ -37,6 +42,7 @@ public:
     SpatialReferencePtr &operator=(OGRSpatialReference *srs);
     operator OGRSpatialReference*() const { return get(); }
     bool setFromUserInput(const std::string &input);
+    int epsg() const;
     //static
 public:
     static SpatialReferencePtr importFromEPSG(int EPSG);
@@ -65,11 +71,82 @@ public:
                                       SpatialReferencePtr dstSRS);
     ~CoordinateTransformation();
     bool transform(OGRGeometry *geom);
+    bool transform(int count, double *x, double *y, double *z = nullptr);
+    OGRCoordinateTransformation *handle() const { return m_oCT; }
+protected:
+    static bool wgs84ToMercator(int count, double *x, double *y);
+    static void mercatorToWgs84(int count, double *x, double *y);
 protected:
     // no copy constructor
     CoordinateTransformation(const CoordinateTransformation &other) = default;
+protected:
+    enum class FastPath {
+        NONE,
+        WGS84_TO_MERCATOR,
+        MERCATOR_TO_WGS84
+    };
+
 protected:
     OGRCoordinateTransformation *m_oCT;
+    bool m_identity;
+    FastPath m_fastPath;
+    // EPSG codes pair of cached transformation, 0 if not cached
+    int m_srcEPSG, m_dstEPSG;
+
+    friend class TransformationCache;
+};
+
+/**
+ * @brief The TransformationCache class Process wide cache of spatial
+ * references by EPSG code and coordinate transformations by EPSG codes pair.
+ * Transformation is not thread safe, so it is taken from cache for exclusive
+ * use and put back after.
+ */
+class TransformationCache
+{
+public:
+    static TransformationCache &instance();
+    SpatialReferencePtr spatialReference(int EPSG);
+    CoordinateTransformation *take(int fromEPSG, int toEPSG);
+    CoordinateTransformation *take(const SpatialReferencePtr &srcSRS,
+                                   const SpatialReferencePtr &dstSRS);
+    void put(CoordinateTransformation *ct);
+    void clear();
+
+private:
+    TransformationCache() = default;
+    ~TransformationCache();
+    TransformationCache(const TransformationCache &) = delete;
+    TransformationCache &operator=(const TransformationCache &) = delete;
+
+private:
+    Mutex m_mutex;
+    std::map<int, SpatialReferencePtr> m_spatialReferences;
+    std::map<std::pair<int, int>, std::vector<CoordinateTransformation*>>
+        m_transformations;
+};
+
+/**
+ * @brief The CachedTransformation class Takes transformation from cache and
+ * puts it back on destruction.
+ */
+class CachedTransformation
+{
+public:
+    CachedTransformation(int fromEPSG, int toEPSG);
+    CachedTransformation(const SpatialReferencePtr &srcSRS,
+                         const SpatialReferencePtr &dstSRS);
+    ~CachedTransformation();
+    CoordinateTransformation *get() const { return m_ct; }
+    CoordinateTransformation *operator->() const { return m_ct; }
+    explicit operator bool() const { return nullptr != m_ct; }
+
+private:
+    CachedTransformation(const CachedTransformation &) = delete;
+    CachedTransformation &operator=(const CachedTransformation &) = delete;
+
+private:
+    CoordinateTransformation *m_ct;
 };
 
 }
@@ -0,0 +1,275 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "copypipeline.h"
+
+#include "simpledataset.h"
+#include "catalog/folder.h"
+
+namespace ngs {
+
+//------------------------------------------------------------------------------
+// CopyPipeline
+//------------------------------------------------------------------------------
+
+CopyPipeline::CopyPipeline(const TablePtr &srcTable,
+                           const TransformFunction &transform,
+                           unsigned char workerCount, int chunkSize,
+                           bool readAhead) :
+    m_srcTable(srcTable),
+    m_mappedLayer(nullptr),
+    m_transform(transform),
+    m_chunkSize(chunkSize > 0 ? static_cast<size_t>(chunkSize) : 1),
+    m_readAhead(readAhead),
+    m_mutex(CPLCreateMutex()),
+    m_cond(CPLCreateCond()),
+    m_readCount(0),
+    m_nextChunk(0),
+    m_eof(false),
+    m_stop(false),
+    m_readThread(nullptr)
+{
+    // CPLCreateMutex returns acquired mutex
+    CPLReleaseMutex(m_mutex);
+
+    if(workerCount == 0) {
+        workerCount = 1;
+    }
+    // The first transform worker always starts, the pipeline needs it
+    m_workerSlots.reset(new WorkerSlots(WorkerClass::BACKGROUND, workerCount,
+                                        true));
+    workerCount = static_cast<unsigned char>(m_workerSlots->count());
+    // One chunk per worker in work and one ready for writer and reader
+    m_maxChunks = workerCount + 2;
+
+    m_srcTable->reset();
+    openMapped();
+
+    m_workerData.reserve(workerCount);
+    for(unsigned char i = 0; i < workerCount; ++i) {
+        m_workerData.push_back({this, i});
+    }
+    for(WorkerData &data : m_workerData) {
+        m_workerThreads.push_back(CPLCreateJoinableThread(transformThread,
+                                                          &data));
+    }
+    if(m_readAhead) {
+        m_readThread = CPLCreateJoinableThread(readThread, this);
+    }
+}
+
+CopyPipeline::~CopyPipeline()
+{
+    stop();
+    CPLDestroyCond(m_cond);
+    CPLDestroyMutex(m_mutex);
+}
+
+/**
+ * @brief CopyPipeline::next Wait for next transformed chunk.
+ * @param chunk Chunk to fill.
+ * @return false if all rows are processed or pipeline is stopped.
+ */
+bool CopyPipeline::next(CopyChunk &chunk)
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    while(true) {
+        auto it = m_output.find(m_nextChunk);
+        if(it != m_output.end()) {
+            chunk = std::move(it->second);
+            m_output.erase(it);
+            m_nextChunk++;
+            CPLCondBroadcast(m_cond);
+            CPLReleaseMutex(m_mutex);
+            return true;
+        }
+
+        if(m_stop || (m_eof && m_nextChunk == m_readCount)) {
+            CPLReleaseMutex(m_mutex);
+            return false;
+        }
+
+        if(!m_readAhead && canRead()) {
+            CPLReleaseMutex(m_mutex);
+            CopyChunk newChunk;
+            bool more = readChunk(newChunk);
+            CPLAcquireMutex(m_mutex, 1000.0);
+            pushChunk(std::move(newChunk), more);
+            continue;
+        }
+
+        CPLCondWait(m_cond, m_mutex);
+    }
+}
+
+/**
+ * @brief CopyPipeline::stop Stop reading and transform and wait threads exit.
+ * Not returned chunks are dropped.
+ */
+void CopyPipeline::stop()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    m_stop = true;
+    CPLCondBroadcast(m_cond);
+    CPLReleaseMutex(m_mutex);
+
+    if(nullptr != m_readThread) {
+        CPLJoinThread(m_readThread);
+        m_readThread = nullptr;
+    }
+    for(CPLJoinableThread *thread : m_workerThreads) {
+        CPLJoinThread(thread);
+    }
+    m_workerThreads.clear();
+}
+
+/**
+ * @brief CopyPipeline::openMapped Open own read only connection to memory
+ * mapped source files with the source open options. The source table is read
+ * as is if it is filtered, may be written (truncated file of the mapping
+ * raises SIGBUS) or files can not be mapped.
+ */
+void CopyPipeline::openMapped()
+{
+    SimpleDataset *dataset = dynamic_cast<SimpleDataset*>(m_srcTable->parent());
+    if(nullptr == dataset || nullptr == m_srcTable->m_layer ||
+            m_srcTable->m_attributeFilter || m_srcTable->m_spatialFilter) {
+        return;
+    }
+    if(!dataset->isReadOnly() && !Folder::isReadOnly(dataset->path())) {
+        return;
+    }
+
+    m_mapped.reset(new MappedFiles(dataset->path()));
+    if(m_mapped->isValid()) {
+        m_mappedDS = static_cast<GDALDataset*>(
+                    GDALOpenEx(m_mapped->path().c_str(),
+                               GDAL_OF_VECTOR|GDAL_OF_READONLY, nullptr,
+                               dataset->openOptions().asCPLStringList(),
+                               nullptr));
+    }
+    if(m_mappedDS) {
+        m_mappedLayer =
+                m_mappedDS->GetLayerByName(m_srcTable->m_layer->GetName());
+    }
+    if(nullptr == m_mappedLayer) {
+        m_mappedDS = GDALDatasetPtr();
+        m_mapped.reset();
+    }
+}
+
+bool CopyPipeline::readChunk(CopyChunk &chunk)
+{
+    MutexHolder holder(m_sourceMutex);
+    chunk.reserve(m_chunkSize);
+    FeaturePtr feature;
+    while(chunk.size() < m_chunkSize) {
+        feature = nullptr != m_mappedLayer ?
+                    FeaturePtr::pooled(m_mappedLayer->GetNextFeature(),
+                                       m_srcTable.get()) :
+                    m_srcTable->nextFeature();
+        if(!feature) {
+            return false;
+        }
+        chunk.push_back({feature, FeaturePtr(), ""});
+    }
+    return true;
+}
+
+/**
+ * Must be called with locked mutex.
+ */
+void CopyPipeline::pushChunk(CopyChunk &&chunk, bool more)
+{
+    if(!chunk.empty()) {
+        m_input.push_back(std::make_pair(m_readCount++, std::move(chunk)));
+    }
+    if(!more) {
+        m_eof = true;
+    }
+    CPLCondBroadcast(m_cond);
+}
+
+/**
+ * Must be called with locked mutex.
+ */
+bool CopyPipeline::canRead() const
+{
+    return !m_eof && m_readCount - m_nextChunk < m_maxChunks;
+}
+
+void CopyPipeline::readLoop()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    while(true) {
+        while(!m_stop && !canRead()) {
+            CPLCondWait(m_cond, m_mutex);
+        }
+        if(m_stop || m_eof) {
+            break;
+        }
+
+        CPLReleaseMutex(m_mutex);
+        CopyChunk chunk;
+        bool more = readChunk(chunk);
+        CPLAcquireMutex(m_mutex, 1000.0);
+        pushChunk(std::move(chunk), more);
+    }
+    CPLReleaseMutex(m_mutex);
+}
+
+void CopyPipeline::transformLoop(unsigned char worker)
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    while(true) {
+        while(!m_stop && !m_eof && m_input.empty()) {
+            CPLCondWait(m_cond, m_mutex);
+        }
+        if(m_stop || m_input.empty()) {
+            break;
+        }
+
+        std::pair<size_t, CopyChunk> item = std::move(m_input.front());
+        m_input.pop_front();
+        CPLReleaseMutex(m_mutex);
+
+        for(CopyRow &row : item.second) {
+            m_transform(row, worker);
+        }
+
+        CPLAcquireMutex(m_mutex, 1000.0);
+        m_output[item.first] = std::move(item.second);
+        CPLCondBroadcast(m_cond);
+    }
+    CPLReleaseMutex(m_mutex);
+}
+
+void CopyPipeline::readThread(void *data)
+{
+    static_cast<CopyPipeline*>(data)->readLoop();
+}
+
+void CopyPipeline::transformThread(void *data)
+{
+    WorkerData *workerData = static_cast<WorkerData*>(data);
+    workerData->pipeline->transformLoop(workerData->worker);
+}
+
+} // namespace ngs
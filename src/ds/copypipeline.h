@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSCOPYPIPELINE_H
+#define NGSCOPYPIPELINE_H
+
+// std
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "cpl_multiproc.h"
+
+#include "dataset.h"
+#include "mappedfiles.h"
+#include "table.h"
+#include "util/mutex.h"
+#include "util/threadpool.h"
+
+namespace ngs {
+
+constexpr int DEFAULT_COPY_CHUNK_SIZE = 1000;
+constexpr int MAX_COPY_THREADS = 16;
+
+/**
+ * @brief The CopyRow struct Source row and its destination counterpart. The
+ * transform leaves dstFeature empty to skip the row and sets warning to report
+ * a problem to the writer.
+ */
+typedef struct _copyRow {
+    FeaturePtr srcFeature;
+    FeaturePtr dstFeature;
+    std::string warning;
+} CopyRow;
+
+using CopyChunk = std::vector<CopyRow>;
+
+/**
+ * @brief The CopyPipeline class Producer/consumer copy of table rows. Source
+ * rows are read in chunks by a reader thread, transformed on worker threads
+ * and returned to the caller (writer) in source order by next().
+ * If readAhead is false the source is read on the caller thread inside next(),
+ * this is needed when source and destination share one dataset. Writer code
+ * which reads source dataset (i.e. attachments of source feature) must hold
+ * sourceMutex().
+ * Transform threads take CPU worker slots, so there may be fewer of them than
+ * asked. Not filtered table of local read only simple dataset (ESRI Shapefile,
+ * MapInfo TAB or MIF) is read from memory mapped files, see MappedFiles.
+ */
+class CopyPipeline
+{
+public:
+    /**
+     * Transform function. Called from worker threads, so it must not access
+     * datasets. Worker index is less than worker count.
+     */
+    using TransformFunction = std::function<void(CopyRow &row,
+                                                 unsigned char worker)>;
+public:
+    explicit CopyPipeline(const TablePtr &srcTable,
+                          const TransformFunction &transform,
+                          unsigned char workerCount = 1,
+                          int chunkSize = DEFAULT_COPY_CHUNK_SIZE,
+                          bool readAhead = true);
+    ~CopyPipeline();
+    bool next(CopyChunk &chunk);
+    void stop();
+    const Mutex &sourceMutex() const { return m_sourceMutex; }
+
+private:
+    typedef struct _workerData {
+        CopyPipeline *pipeline;
+        unsigned char worker;
+    } WorkerData;
+
+private:
+    void openMapped();
+    bool readChunk(CopyChunk &chunk);
+    void pushChunk(CopyChunk &&chunk, bool more);
+    bool canRead() const;
+    void readLoop();
+    void transformLoop(unsigned char worker);
+
+    // static
+    static void readThread(void *data);
+    static void transformThread(void *data);
+
+private:
+    TablePtr m_srcTable;
+    std::unique_ptr<MappedFiles> m_mapped;
+    GDALDatasetPtr m_mappedDS;
+    OGRLayer *m_mappedLayer;
+    TransformFunction m_transform;
+    size_t m_chunkSize, m_maxChunks;
+    bool m_readAhead;
+    Mutex m_sourceMutex;
+    CPLMutex *m_mutex;
+    CPLCond *m_cond;
+    std::deque<std::pair<size_t, CopyChunk>> m_input;
+    std::map<size_t, CopyChunk> m_output;
+    size_t m_readCount, m_nextChunk;
+    bool m_eof, m_stop;
+    CPLJoinableThread *m_readThread;
+    std::unique_ptr<WorkerSlots> m_workerSlots;
+    std::vector<CPLJoinableThread*> m_workerThreads;
+    std::vector<WorkerData> m_workerData;
+};
+
+}
+
+#endif // NGSCOPYPIPELINE_H
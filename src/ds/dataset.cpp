@@ -26,10 +26,12 @@
 #include <array>
 #include <stdio.h>
 
+#include "copypipeline.h"
 #include "featureclass.h"
 #include "raster.h"
 #include "simpledataset.h"
 #include "table.h"
+#include "catalog/archive.h"
 #include "catalog/file.h"
 #include "catalog/folder.h"
 #include "ngstore/api.h"
@@ -41,6 +43,7 @@
 #include "util/error.h"
 #include "util/notify.h"
 #include "util/stringutil.h"
+#include "util/threadpool.h"
 
 namespace ngs {
 
@@ -189,9 +192,25 @@ bool DatasetBase::open(const std::string &path, unsigned int openFlags,
     // NOTE: VALIDATE_OPEN_OPTIONS can be set to NO to avoid warnings
 
     resetError();
+    m_openOptions = options;
     auto openOptions = options.asCPLStringList();
+    // Archive directory listing from index, so GDAL does not read it on open
+    CPLStringList siblingFiles;
+    std::string archivePath, innerPath;
+    if(ArchiveIndex::splitPath(path, archivePath, innerPath)) {
+        ArchiveIndexPtr index = ArchiveIndex::get(archivePath);
+        if(index) {
+            auto pos = innerPath.rfind('/');
+            std::string dir = pos == std::string::npos ? "" :
+                                                         innerPath.substr(0, pos);
+            for(const std::string &name : index->children(dir)) {
+                siblingFiles.AddString(name.c_str());
+            }
+        }
+    }
+    char **siblings = siblingFiles.Count() == 0 ? nullptr : siblingFiles.List();
     m_DS = static_cast<GDALDataset*>(GDALOpenEx(path.c_str(), openFlags, nullptr,
-                                                openOptions, nullptr));
+                                                openOptions, siblings));
     if(nullptr == m_DS) {
         errorMessage(_("Failed to open dataset %s. %s"), path.c_str(), CPLGetLastErrorMsg());
         if(openFlags & GDAL_OF_UPDATE) {
@@ -200,7 +219,7 @@ bool DatasetBase::open(const std::string &path, unsigned int openFlags,
             openFlags |= GDAL_OF_READONLY;
             m_DS = static_cast<GDALDataset*>(GDALOpenEx( path.c_str(), openFlags,
                                                          nullptr, openOptions,
-                                                         nullptr));
+                                                         siblings));
             if(nullptr == m_DS) {
                 errorMessage(_("Failed to open dataset %s. %s"), path.c_str(), CPLGetLastErrorMsg());
                 return false; // Error message comes from GDALOpenEx
@@ -237,7 +256,8 @@ Dataset::Dataset(ObjectContainer * const parent,
                  const std::string &path) :
     ObjectContainer(parent, type, name, path),
     DatasetBase(),
-    m_metadata(nullptr)
+    m_metadata(nullptr),
+    m_metadataCached(false)
 {
 }
 
@@ -320,20 +340,34 @@ bool Dataset::setProperty(const std::string &key, const std::string &value,
 
     // Update or set property
     auto keyStr = domain + "." + key;
+    loadMetadataCache();
     MutexHolder holder(m_executeSQLMutex);
+    MutexHolder cacheHolder(m_metadataMutex);
 
-    m_metadata->SetAttributeFilter(CPLSPrintf("'%s' = \"%s\"", META_KEY, keyStr.c_str()));
-    FeaturePtr feature = m_metadata->GetNextFeature();
-    m_metadata->SetAttributeFilter(nullptr);
-    if(feature) {
-        feature->SetField(META_VALUE, value.c_str());
-        return m_metadata->SetFeature(feature) == OGRERR_NONE;
+    auto it = m_metadataCache.find(keyStr);
+    if(it != m_metadataCache.end()) {
+        if(it->second.value == value) {
+            return true;
+        }
+        FeaturePtr feature = m_metadata->GetFeature(it->second.fid);
+        if(feature) {
+            feature->SetField(META_VALUE, value.c_str());
+            if(m_metadata->SetFeature(feature) != OGRERR_NONE) {
+                return false;
+            }
+            it->second.value = value;
+            return true;
+        }
     }
 
-    feature = OGRFeature::CreateFeature(m_metadata->GetLayerDefn());
+    FeaturePtr feature = OGRFeature::CreateFeature(m_metadata->GetLayerDefn());
     feature->SetField(META_KEY, keyStr.c_str());
     feature->SetField(META_VALUE, value.c_str());
-    return m_metadata->CreateFeature(feature) == OGRERR_NONE;
+    if(m_metadata->CreateFeature(feature) != OGRERR_NONE) {
+        return false;
+    }
+    m_metadataCache[keyStr] = {feature->GetFID(), value};
+    return true;
 }
 
 std::string Dataset::property(const std::string &key,
@@ -354,20 +388,52 @@ std::string Dataset::property(const std::string &key,
     }
 
     auto keyStr = domain + "." + key;
-    MutexHolder holder(m_executeSQLMutex);
+    loadMetadataCache();
+    MutexHolder holder(m_metadataMutex);
 
-    m_metadata->SetAttributeFilter(CPLSPrintf("%s LIKE \"%s\"", META_KEY, keyStr.c_str()));
-    FeaturePtr feature = m_metadata->GetNextFeature();
-    m_metadata->SetAttributeFilter(nullptr);
-    if(feature) {
-        out = feature->GetFieldAsString(1);
+    auto it = m_metadataCache.find(keyStr);
+    if(it != m_metadataCache.end() && !it->second.value.empty()) {
+        return it->second.value;
     }
 
-    if(!out.empty()) {
-        return out;
+    return ObjectContainer::property(key, defaultValue, domain);
+}
+
+/**
+ * @brief Dataset::loadMetadataCache Read metadata table into memory at first
+ * access. Next property reads and writes use the cache, writes go to the
+ * table too. Locks the SQL execution before the metadata mutex as writes do.
+ */
+void Dataset::loadMetadataCache() const
+{
+    {
+        MutexHolder cacheHolder(m_metadataMutex);
+        if(m_metadataCached || nullptr == m_metadata) {
+            return;
+        }
     }
 
-    return ObjectContainer::property(key, defaultValue, domain);
+    MutexHolder holder(m_executeSQLMutex);
+    MutexHolder cacheHolder(m_metadataMutex);
+    if(m_metadataCached || nullptr == m_metadata) {
+        return;
+    }
+
+    m_metadata->SetAttributeFilter(nullptr);
+    m_metadata->ResetReading();
+    FeaturePtr feature;
+    while((feature = m_metadata->GetNextFeature())) {
+        m_metadataCache[feature->GetFieldAsString(0)] =
+            {feature->GetFID(), feature->GetFieldAsString(1)};
+    }
+    m_metadataCached = true;
+}
+
+void Dataset::clearMetadataCache()
+{
+    MutexHolder holder(m_metadataMutex);
+    m_metadataCache.clear();
+    m_metadataCached = false;
 }
 
 void Dataset::lockExecuteSql(bool lock)
@@ -380,6 +446,62 @@ void Dataset::lockExecuteSql(bool lock)
     }
 }
 
+/**
+ * @brief Dataset::extentQuery Select FID and geometry of table rows which
+ * envelopes intersect the extent using the spatial index only.
+ * @param name Table name.
+ * @param fidColumn FID column name.
+ * @param geometryColumn Geometry column name.
+ * @param extent Extent to intersect.
+ * @return Query result or empty pointer if dataset has no such index.
+ */
+TablePtr Dataset::extentQuery(const std::string &name,
+                              const std::string &fidColumn,
+                              const std::string &geometryColumn,
+                              const Envelope &extent)
+{
+    ngsUnused(name);
+    ngsUnused(fidColumn);
+    ngsUnused(geometryColumn);
+    ngsUnused(extent);
+    return TablePtr();
+}
+
+/**
+ * @brief Dataset::acquireReadConnection Get read only connection to dataset
+ * for using in one thread. The connection must be returned by
+ * releaseReadConnection.
+ * @return Connection or empty pointer if dataset has no free read connections.
+ */
+GDALDatasetPtr Dataset::acquireReadConnection()
+{
+    return GDALDatasetPtr();
+}
+
+/**
+ * @brief Dataset::releaseReadConnection Return read only connection to pool.
+ * @param connection Connection from acquireReadConnection.
+ */
+void Dataset::releaseReadConnection(GDALDatasetPtr connection)
+{
+    ngsUnused(connection);
+}
+
+/**
+ * @brief Dataset::lockWrite Lock or unlock dataset writes. Paste of several
+ * layers at once holds the lock while it creates tables and writes each chunk.
+ * @param lock True to lock, false to unlock.
+ */
+void Dataset::lockWrite(bool lock)
+{
+    if(lock) {
+        m_writeMutex.acquire();
+    }
+    else {
+        m_writeMutex.release();
+    }
+}
+
 bool Dataset::destroyTable(Table *table)
 {
     if(destroyTable(m_DS, table->m_layer)) {
@@ -396,6 +518,8 @@ bool Dataset::destroy()
     clear();
     m_DS = nullptr;
     m_addsDS = nullptr;
+    m_metadata = nullptr;
+    clearMetadataCache();
 
     if(Filter::isLocalDir(m_type)) {
         if(!Folder::rmDir(m_path)) {
@@ -455,16 +579,14 @@ Properties Dataset::properties(const std::string &domain) const {
     }
 
     // 2. Get ngs properties
-    m_metadata->SetAttributeFilter(CPLSPrintf("%s LIKE \"%s.%%\"", META_KEY,
-                                              domain.c_str()));
-    FeaturePtr feature;
-    while((feature = m_metadata->GetNextFeature())) {
-        std::string key = feature->GetFieldAsString(0) + domain.size() + 1;
-        std::string value = feature->GetFieldAsString(1);
-
-        out.add(key, value);
+    std::string prefix = domain + ".";
+    loadMetadataCache();
+    MutexHolder cacheHolder(m_metadataMutex);
+    for(auto it = m_metadataCache.lower_bound(prefix);
+        it != m_metadataCache.end() && startsWith(it->first, prefix, true);
+        ++it) {
+        out.add(it->first.substr(prefix.size()), it->second.value);
     }
-    m_metadata->SetAttributeFilter(nullptr);
 
     return out;
 }
@@ -478,6 +600,13 @@ void Dataset::deleteProperties(const std::string &domain)
     }
     executeSQL(CPLSPrintf("DELETE FROM %s WHERE %s LIKE \"%s.%%\"",
                           METADATA_TABLE_NAME, META_KEY, domain.c_str()));
+
+    std::string prefix = domain + ".";
+    MutexHolder holder(m_metadataMutex);
+    auto it = m_metadataCache.lower_bound(prefix);
+    while(it != m_metadataCache.end() && startsWith(it->first, prefix, true)) {
+        it = m_metadataCache.erase(it);
+    }
 }
 
 bool Dataset::isNameValid(const std::string &name) const
@@ -615,11 +744,11 @@ void Dataset::fillFeatureClasses() const
             Dataset *parent = const_cast<Dataset*>(this);
             OGRwkbGeometryType geometryType = layer->GetGeomType();
             if(geometryType == wkbNone) {
-                m_children.push_back(ObjectPtr(new Table(layer, parent,
+                appendChild(ObjectPtr(new Table(layer, parent,
                         CAT_TABLE_ANY, layerName)));
             }
             else {
-                m_children.push_back(ObjectPtr(new FeatureClass(layer, parent,
+                appendChild(ObjectPtr(new FeatureClass(layer, parent,
                             CAT_FC_ANY, layerName)));
             }
         }
@@ -681,9 +810,21 @@ std::string Dataset::options(enum ngsOptionType optionType) const
                "  <Option name='FORCE_GEOMETRY_TO_MULTI' type='boolean' description='Force input geometry to multi' default='NO'/>"
                "  <Option name='SKIP_EMPTY_GEOMETRY' type='boolean' description='Skip empty geometry' default='NO'/>"
                "  <Option name='SKIP_INVALID_GEOMETRY' type='boolean' description='Skip invalid geometry' default='NO'/>"
+               "  <Option name='MAKE_VALID_GEOMETRY' type='boolean' description='Try to make invalid geometry valid' default='NO'/>"
+               "  <Option name='COPY_THREADS' type='int' description='Worker thread count for geometry processing. Defaults to CPU count'/>"
+               "  <Option name='COPY_CHUNK_SIZE' type='int' description='Rows count written in one transaction' default='1000'/>"
+               "  <Option name='DEFER_INDEXES' type='boolean' description='Drop spatial index and overviews index before load and build them after' default='NO'/>"
+               "  <Option name='LAYER_THREADS' type='int' description='Count of container layers loaded at once. Defaults to CPU count'/>"
                "  <Option name='CREATE_OVERVIEWS_TABLE' type='boolean' description='Create empty overviews table' default='NO'/>"
                "  <Option name='CREATE_OVERVIEWS' type='boolean' description='Create overviews table and fill it with overviews. The level should be set by ZOOM_LEVELS option' default='NO'/>"
-               "  <Option name='ZOOM_LEVELS' type='string' description='Comma separated list of zoom level' default=''/>"
+               "  <Option name='ZOOM_LEVELS' type='string' description='Comma separated list of zoom level or AUTO' default=''/>"
+               "  <Option name='TILE_FORMAT' type='string-select' description='Overview tiles encoding' default='NATIVE'>"
+               "    <Value>NATIVE</Value>"
+               "    <Value>MVT</Value>"
+               "  </Option>"
+               "  <Option name='TILE_ATTRIBUTES' type='string' description='Comma separated list of fields stored in overview tiles' default=''/>"
+               "  <Option name='CLUSTER_RADIUS' type='int' description='Point clusters grid cell size in pixels of overview tiles' default='0'/>"
+               "  <Option name='CLUSTER_MAX_ZOOM' type='int' description='Max zoom level of overview tiles with point clusters'/>"
                "</LoadOptionList>";
     }
 
@@ -709,9 +850,203 @@ bool Dataset::isReadOnly() const
     return DatasetBase::isReadOnly(m_DS);
 }
 
+//------------------------------------------------------------------------------
+// Paste container layers
+//------------------------------------------------------------------------------
+
+typedef struct _pasteLayerProgressData {
+    struct _pasteLayersData *paste;
+    size_t layer;
+} PasteLayerProgressData;
+
+typedef struct _pasteLayersData {
+    Dataset *dataset;
+    Dataset *srcDataset;
+    std::vector<ObjectPtr> layers;
+    std::vector<int> results;
+    std::vector<double> completes;
+    std::vector<PasteLayerProgressData> progressData;
+    Options options;
+    const Progress *progress;
+    bool reopen;
+    bool canceled;
+    size_t next;
+    Mutex mutex;
+} PasteLayersData;
+
+static int pasteLayerProgress(enum ngsCode status, double complete,
+                              const char *message, void *progressArguments)
+{
+    ngsUnused(status);
+    PasteLayerProgressData *data =
+            static_cast<PasteLayerProgressData*>(progressArguments);
+    PasteLayersData *paste = data->paste;
+
+    MutexHolder holder(paste->mutex);
+    if(paste->canceled) {
+        return 0;
+    }
+    paste->completes[data->layer] = complete;
+    double total = 0.0;
+    for(double layerComplete : paste->completes) {
+        total += layerComplete;
+    }
+    total /= paste->completes.size();
+    if(!paste->progress->onProgress(COD_IN_PROCESS, total, "%s", message)) {
+        paste->canceled = true;
+        return 0;
+    }
+    return 1;
+}
+
+static void pasteLayersThread(void *data)
+{
+    PasteLayersData *paste = static_cast<PasteLayersData*>(data);
+    while(true) {
+        size_t index;
+        {
+            MutexHolder holder(paste->mutex);
+            if(paste->canceled || paste->next >= paste->layers.size()) {
+                return;
+            }
+            index = paste->next++;
+        }
+
+        // Layer must be released before the dataset it was read from
+        std::unique_ptr<Dataset> srcDataset;
+        ObjectPtr layer = paste->layers[index];
+        std::string layerName = layer->name();
+        if(paste->reopen) {
+            // Each layer is read through own dataset handle
+            layer = ObjectPtr();
+            srcDataset.reset(new Dataset(nullptr, paste->srcDataset->type(),
+                                         paste->srcDataset->name(),
+                                         paste->srcDataset->path()));
+            if(srcDataset->open(GDAL_OF_VECTOR|GDAL_OF_READONLY|GDAL_OF_VERBOSE_ERROR) &&
+                    srcDataset->loadChildren()) {
+                layer = srcDataset->getChild(layerName);
+            }
+        }
+        if(!layer) {
+            outMessage(COD_OPEN_FAILED, _("Failed to open layer '%s'"),
+                       layerName.c_str());
+            paste->results[index] = COD_OPEN_FAILED;
+            continue;
+        }
+
+        Options options(paste->options);
+        options.add("NEW_NAME", layerName);
+        Progress progress(pasteLayerProgress, &paste->progressData[index]);
+        paste->results[index] = paste->dataset->paste(layer, false, options,
+                                                      progress);
+        layer = ObjectPtr();
+    }
+}
+
 /**
- * @brief Dataset::paste Copy or move feature class or table to destination catalog object.
- * @param child Feature class or table to copy or move.
+ * @brief Dataset::pasteContainer Paste all tables and feature classes of
+ * container. Layers are pasted in LAYER_THREADS threads, each layer is read
+ * through own dataset handle and writes are serialized by dataset write lock.
+ * @param child Container to paste.
+ * @param move Delete container after successful paste.
+ * @param options Paste options.
+ * @param progress Progress of all layers.
+ * @return COD_SUCCESS or first layer error code.
+ */
+int Dataset::pasteContainer(ObjectPtr child, bool move, const Options &options,
+                            const Progress &progress)
+{
+    ObjectContainer *container = dynamic_cast<ObjectContainer*>(child.get());
+    if(nullptr == container || !container->loadChildren()) {
+        return outMessage(move ? COD_MOVE_FAILED : COD_COPY_FAILED,
+                          _("Source object is invalid"));
+    }
+
+    PasteLayersData paste;
+    for(const ObjectPtr &layer : container->getChildren()) {
+        if(Filter::isTable(layer->type()) ||
+                Filter::isFeatureClass(layer->type())) {
+            paste.layers.push_back(layer);
+        }
+    }
+    if(paste.layers.empty()) {
+        return outMessage(COD_UNSUPPORTED,
+                          _("'%s' has no tables or feature classes"),
+                          child->name().c_str());
+    }
+
+    paste.srcDataset = dynamic_cast<Dataset*>(child.get());
+    int threadCount = options.asInt("LAYER_THREADS", CPLGetNumCPUs());
+    if(nullptr == paste.srcDataset || paste.srcDataset->path().empty() ||
+            threadCount < 1) {
+        threadCount = 1;
+    }
+    if(threadCount > static_cast<int>(paste.layers.size())) {
+        threadCount = static_cast<int>(paste.layers.size());
+    }
+    if(threadCount > MAX_COPY_THREADS) {
+        threadCount = MAX_COPY_THREADS;
+    }
+    // Layer threads are CPU workers, one runs even if the cap is reached
+    WorkerSlots slots(WorkerClass::BACKGROUND, threadCount, true);
+    threadCount = slots.count();
+
+    paste.dataset = this;
+    paste.results.resize(paste.layers.size(), COD_SUCCESS);
+    paste.completes.resize(paste.layers.size(), 0.0);
+    for(size_t i = 0; i < paste.layers.size(); ++i) {
+        paste.progressData.push_back({&paste, i});
+    }
+    paste.options = options;
+    paste.options.remove("NEW_NAME");
+    if(!options.hasKey("COPY_THREADS")) {
+        paste.options.add("COPY_THREADS",
+                          static_cast<long>(std::max(1, CPLGetNumCPUs() / threadCount)));
+    }
+    paste.progress = &progress;
+    paste.reopen = threadCount > 1;
+    paste.canceled = false;
+    paste.next = 0;
+
+    if(threadCount == 1) {
+        pasteLayersThread(&paste);
+    }
+    else {
+        std::vector<CPLJoinableThread*> threads;
+        for(int i = 0; i < threadCount; ++i) {
+            CPLJoinableThread *thread =
+                    CPLCreateJoinableThread(pasteLayersThread, &paste);
+            if(nullptr == thread) {
+                // Copy the rest of layers here with the started threads
+                pasteLayersThread(&paste);
+                break;
+            }
+            threads.push_back(thread);
+        }
+        for(CPLJoinableThread *thread : threads) {
+            CPLJoinThread(thread);
+        }
+    }
+
+    if(paste.canceled) {
+        return COD_CANCELED;
+    }
+    for(int result : paste.results) {
+        if(result != COD_SUCCESS) {
+            return result;
+        }
+    }
+    progress.onProgress(COD_FINISHED, 1.0, "");
+
+    if(move) {
+        return child->destroy() ? COD_SUCCESS : COD_DELETE_FAILED;
+    }
+    return COD_SUCCESS;
+}
+
+/**
+ * @brief Dataset::paste Copy or move feature class, table or all layers of container to destination catalog object.
+ * @param child Feature class, table or container to copy or move.
  * @param move Copy or move.
  * @param options Key - value list. The available values are:
  * - NEW_NAME - new table/featureClass name. If not present, the original Object name will use.
@@ -720,6 +1055,11 @@ bool Dataset::isReadOnly() const
  * - FORCE_GEOMETRY_TO_MULTI - if feature class has mixed geometry types (i.e. polygons and multypolygons) the non multi types will force to multi.
  * - SKIP_EMPTY_GEOMETRY - if geometry is empty, skip to add feature to destination table/featureClass.
  * - SKIP_INVALID_GEOMETRY - if true, check validity of source geometry. Features with invalid geometries will skip.
+ * - MAKE_VALID_GEOMETRY - if true, invalid geometries are fixed before copy. If fix failed and SKIP_INVALID_GEOMETRY is true the feature will skip.
+ * - COPY_THREADS - worker thread count to reproject and check geometries. Defaults to CPU count.
+ * - COPY_CHUNK_SIZE - rows count written in one transaction. Defaults to 1000.
+ * - DEFER_INDEXES - drop spatial index and overviews index before copy and build them in one pass after copy.
+ * - LAYER_THREADS - count of layers pasted at once if child is a container. Defaults to CPU count.
  * - DESCRIPTION - If supported by Object the description will add.
  * - ACCEPT_GEOMETRY - limit accepted geometry type. Defaults to ALL: no limits.
  * @param progress
@@ -730,9 +1070,16 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
 {
     loadChildren();
 
+    if(Filter::isContainer(child->type())) {
+        return pasteContainer(child, move, options, progress);
+    }
+
     std::string newName = options.asString("NEW_NAME",
                                            File::getBaseName(child->name()));
-    newName = normalizeDatasetName(newName);
+    {
+        DatasetWriteLockHolder writeHolder(this);
+        newName = normalizeDatasetName(newName);
+    }
     if(newName.empty()) {
         errorMessage(_("Failed to create unique name."));
         return COD_LOAD_FAILED;
@@ -774,7 +1121,11 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
         }
 
         auto srcDefinition = srcTable->definition();
-        auto dstTable = createTable(newName, CAT_TABLE_ANY, srcDefinition, options);
+        Table *dstTable;
+        {
+            DatasetWriteLockHolder writeHolder(this);
+            dstTable = createTable(newName, CAT_TABLE_ANY, srcDefinition, options);
+        }
         if(nullptr == dstTable) {
             return move ? COD_MOVE_FAILED : COD_COPY_FAILED;
         }
@@ -793,6 +1144,7 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
 
         auto fullNameStr = dstTable->fullName();
         progressMulti.setStep(1);
+        DatasetWriteLockHolder writeHolder(this);
         // Execute postprocess after features copied.
         if(!dstTable->onRowsCopied(srcTable, progressMulti, options)) {
             warningMessage(_("Postprocess features after copy in feature class '%s' failed."),
@@ -827,8 +1179,19 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
             srcDefinition->DeleteFieldDefn(srcDefinition->GetFieldIndex(OGR_STYLE_FIELD));
         }
 
-        std::vector<OGRwkbGeometryType> geometryTypes =
-                srcFClass->geometryTypes();
+        // Points, lines and polygons of the source go to one feature class
+        // on request, it is tiled and drawn with the mixed style
+        std::vector<OGRwkbGeometryType> geometryTypes;
+        OGRwkbGeometryType srcGeometryType =
+                OGR_GT_Flatten(srcFClass->geometryType());
+        if(options.asBool("MIXED_GEOMETRY", false) &&
+                (srcGeometryType == wkbUnknown ||
+                 srcGeometryType == wkbGeometryCollection)) {
+            geometryTypes.push_back(wkbUnknown);
+        }
+        else {
+            geometryTypes = srcFClass->geometryTypes();
+        }
         OGRwkbGeometryType filterGeometryType =
                 FeatureClass::geometryTypeFromName(
                     options.asString("ACCEPT_GEOMETRY", "ANY"));
@@ -849,9 +1212,13 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
                 }
             }
 
-            auto dstFClass = createFeatureClass(createName,
-                CAT_FC_ANY, srcDefinition, srcFClass->spatialReference(),
-                newGeometryType, options);
+            FeatureClass *dstFClass;
+            {
+                DatasetWriteLockHolder writeHolder(this);
+                dstFClass = createFeatureClass(createName, CAT_FC_ANY,
+                    srcDefinition, srcFClass->spatialReference(),
+                    newGeometryType, options);
+            }
             if(nullptr == dstFClass) {
                 return move ? COD_MOVE_FAILED : COD_COPY_FAILED;
             }
@@ -873,6 +1240,7 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
             auto fullNameStr = dstFClass->fullName();
 
             progressMulti.setStep(1);
+            DatasetWriteLockHolder writeHolder(this);
             // Execute postprocess after features copied.
             if(!dstFClass->onRowsCopied(srcFClass, progressMulti, options)) {
                 warningMessage(_("Postprocess features after copy in feature class '%s' failed."),
@@ -900,7 +1268,8 @@ bool Dataset::canPaste(const enum ngsCatalogObjectType type) const
     if(!isOpened() || isReadOnly()) {
         return false;
     }
-    return Filter::isFeatureClass(type) || Filter::isTable(type);
+    return Filter::isFeatureClass(type) || Filter::isTable(type) ||
+            Filter::isDatabase(type);
 }
 
 bool Dataset::canCreate(const enum ngsCatalogObjectType type) const
@@ -1261,7 +1630,7 @@ void Dataset::refresh()
         auto itdn = std::find(deleteNames.begin(), deleteNames.end(), name);
         if(itdn != deleteNames.end()) {
             deleteNames.erase(itdn);
-            it = m_children.erase(it);
+            it = removeChild(it);
         }
         else {
             ++it;
@@ -1274,11 +1643,11 @@ void Dataset::refresh()
         if(nullptr != layer) {
             OGRwkbGeometryType geometryType = layer->GetGeomType();
             if(geometryType == wkbNone) {
-                m_children.push_back(ObjectPtr(new Table(layer, this,
+                appendChild(ObjectPtr(new Table(layer, this,
                         CAT_TABLE_ANY, layerName)));
             }
             else {
-                m_children.push_back(ObjectPtr(new FeatureClass(layer, this,
+                appendChild(ObjectPtr(new FeatureClass(layer, this,
                             CAT_FC_ANY, layerName)));
             }
         }
@@ -1315,7 +1684,7 @@ bool Dataset::loadChildren()
                 CPLStringList pathPortions(CSLTokenizeString2( rasterPath, ":", 0 ));
                 const char *rasterName = pathPortions[pathPortions.size() - 1];
                 Dataset *parent = const_cast<Dataset *>(this);
-                m_children.push_back(ObjectPtr(new Raster(siblingFiles, parent,
+                appendChild(ObjectPtr(new Raster(siblingFiles, parent,
                     CAT_RASTER_ANY, rasterName, rasterPath)));
             }
         }
@@ -1344,6 +1713,23 @@ DatasetBatchOperationHolder::~DatasetBatchOperationHolder()
         m_dataset->stopBatchOperation();
 }
 
+//------------------------------------------------------------------------------
+// DatasetWriteLockHolder
+//------------------------------------------------------------------------------
+
+DatasetWriteLockHolder::DatasetWriteLockHolder(Dataset* dataset) :
+    m_dataset(dataset)
+{
+    if(nullptr != m_dataset)
+        m_dataset->lockWrite(true);
+}
+
+DatasetWriteLockHolder::~DatasetWriteLockHolder()
+{
+    if(nullptr != m_dataset)
+        m_dataset->lockWrite(false);
+}
+
 //------------------------------------------------------------------------------
 // DatasetExecuteSQLLockHolder
 //------------------------------------------------------------------------------
@@ -1361,4 +1747,30 @@ DatasetExecuteSQLLockHolder::~DatasetExecuteSQLLockHolder()
         m_dataset->lockExecuteSql(false);
 }
 
+//------------------------------------------------------------------------------
+// DatasetReadConnectionHolder
+//------------------------------------------------------------------------------
+
+DatasetReadConnectionHolder::DatasetReadConnectionHolder(Dataset* dataset) :
+    m_dataset(dataset)
+{
+    if(nullptr == m_dataset)
+        return;
+
+    m_connection = m_dataset->acquireReadConnection();
+    if(!m_connection)
+        m_dataset->lockExecuteSql(true);
+}
+
+DatasetReadConnectionHolder::~DatasetReadConnectionHolder()
+{
+    if(nullptr == m_dataset)
+        return;
+
+    if(m_connection)
+        m_dataset->releaseReadConnection(m_connection);
+    else
+        m_dataset->lockExecuteSql(false);
+}
+
 } // namespace ngs
@@ -21,6 +21,7 @@
 #ifndef NGSDATASET_H
 #define NGSDATASET_H
 
+#include <map>
 #include <memory>
 
 #include "api_priv.h"
@@ -87,6 +88,7 @@ public:
     void flushCache();
     // is checks
     virtual bool isOpened() const;
+    const Options &openOptions() const { return m_openOptions; }
 
 public: // static
     static const unsigned int defaultOpenFlags = GDAL_OF_SHARED|GDAL_OF_UPDATE|GDAL_OF_VERBOSE_ERROR;
@@ -100,6 +102,7 @@ protected:
 
 protected:
     mutable GDALDatasetPtr m_DS;
+    Options m_openOptions;
 };
 
 /**
@@ -145,6 +148,13 @@ public:
     virtual void stopBatchOperation() {}
     virtual bool isBatchOperation() const { return false; }
     virtual void lockExecuteSql(bool lock);
+    void lockWrite(bool lock);
+    virtual GDALDatasetPtr acquireReadConnection();
+    virtual void releaseReadConnection(GDALDatasetPtr connection);
+    virtual TablePtr extentQuery(const std::string &name,
+                                 const std::string &fidColumn,
+                                 const std::string &geometryColumn,
+                                 const Envelope &extent);
 
     // Object interface
 public:
@@ -217,10 +227,31 @@ protected:
     virtual void clearEditHistoryTable(const std::string &name);
     virtual std::string historyTableName(const std::string &name) const;
 
+    int pasteContainer(ObjectPtr child, bool move, const Options &options,
+                       const Progress &progress);
+
+    /// Metadata
+    void loadMetadataCache() const;
+    void clearMetadataCache();
+
+protected:
+    /**
+     * @brief The MetadataItem struct Cached row of metadata table
+     */
+    typedef struct _metadataItem {
+        GIntBig fid;
+        std::string value;
+    } MetadataItem;
+
 protected:
     GDALDatasetPtr m_addsDS;
     OGRLayer *m_metadata;
+    // Sorted by key, so domain properties are a key range
+    mutable std::map<std::string, MetadataItem> m_metadataCache;
+    mutable bool m_metadataCached;
+    mutable Mutex m_metadataMutex;
     Mutex m_executeSQLMutex;
+    Mutex m_writeMutex;
 };
 
 /**
@@ -237,7 +268,22 @@ protected:
 };
 
 /**
- * @brief The DatasetExecuteSQLLockHolder class lock sql excution in dataset
+ * @brief The DatasetWriteLockHolder class serializes writes to dataset from
+ * several threads
+ */
+class DatasetWriteLockHolder
+{
+public:
+    DatasetWriteLockHolder(Dataset* dataset);
+    ~DatasetWriteLockHolder();
+
+protected:
+    Dataset *m_dataset;
+};
+
+/**
+ * @brief The DatasetExecuteSQLLockHolder class lock sql excution in dataset.
+ * Serializes writes and the reads which use the main dataset connection.
  */
 class DatasetExecuteSQLLockHolder
 {
@@ -249,6 +295,24 @@ protected:
     Dataset *m_dataset;
 };
 
+/**
+ * @brief The DatasetReadConnectionHolder class holds read only connection
+ * from dataset pool. If dataset has no free connection, the holder locks sql
+ * execution and connection() returns nullptr, so caller reads using the main
+ * dataset connection.
+ */
+class DatasetReadConnectionHolder
+{
+public:
+    DatasetReadConnectionHolder(Dataset* dataset);
+    ~DatasetReadConnectionHolder();
+    GDALDataset *connection() const { return m_connection; }
+
+protected:
+    Dataset *m_dataset;
+    GDALDatasetPtr m_connection;
+};
+
 }
 
 #endif // NGSDATASET_H
@@ -26,6 +26,8 @@
 #include "cpl_vsi.h"
 
 // stl
+#include <algorithm>
+#include <ctime>
 #include <iostream>
 
 #include "api_priv.h"
@@ -54,6 +56,21 @@ constexpr int STORE_EXT_LEN = length(STORE_EXT);
 
 // Overviews
 constexpr const char *OVR_SUFFIX = "overviews";
+constexpr const char *OVR_SHADOW_SUFFIX = "new"; // Rebuilt overviews
+
+// Full-text search
+constexpr const char *SEARCH_SUFFIX = "search";
+constexpr const char *SEARCH_TEXT_KEY = "text";
+
+static void executePragma(GDALDataset *ds, const std::string &pragma)
+{
+    std::string statement = compare(pragma, "VACUUM") ? pragma :
+                                                       "PRAGMA " + pragma;
+    OGRLayer *result = ds->ExecuteSQL(statement.c_str(), nullptr, "SQLite");
+    if(nullptr != result) {
+        ds->ReleaseResultSet(result);
+    }
+}
 
 //------------------------------------------------------------------------------
 // DataStore
@@ -64,11 +81,21 @@ DataStore::DataStore(ObjectContainer * const parent,
                      const std::string &path) :
     Dataset(parent, CAT_CONTAINER_NGS, name, path), 
     SpatialDataset(),
-    m_disableJournalCounter(0)
+    m_batchCounter(0),
+    m_readConnectionsCount(0),
+    m_ioProfile(ioProfile()),
+    m_lastCheckpoint(0),
+    m_overviewsTileKeys(true)
 {
     m_spatialReference = SpatialReferencePtr::importFromEPSG(DEFAULT_EPSG);
 }
 
+DataStore::~DataStore()
+{
+    // Children may outlive the store, write pending tiles while it is open
+    flushOverviews();
+}
+
 bool DataStore::isNameValid(const std::string &name) const
 {
     if(comparePart(name, STORE_EXT, STORE_EXT_LEN)) {
@@ -121,10 +148,10 @@ void DataStore::fillFeatureClasses() const
             }
             DataStore *parent = const_cast<DataStore*>(this);
             if(geometryType == wkbNone) {
-                m_children.push_back(ObjectPtr(new StoreTable(layer, parent, layerName)));
+                appendChild(ObjectPtr(new StoreTable(layer, parent, layerName)));
             }
             else {
-                m_children.push_back(ObjectPtr(new StoreFeatureClass(layer, parent, layerName)));
+                appendChild(ObjectPtr(new StoreFeatureClass(layer, parent, layerName)));
             }
         }
     }
@@ -147,6 +174,13 @@ bool DataStore::create(const std::string &path)
         return errorMessage(_("Failed to create datastore. %s"), CPLGetLastErrorMsg());
     }
 
+    // Page size changes on vacuum only, the new store is small and not in WAL
+    StoreIOProfile profile = ioProfile();
+    if(profile.pageSize > 0) {
+        executePragma(DS, CPLSPrintf("page_size = %d", profile.pageSize));
+        executePragma(DS, "VACUUM");
+    }
+
     createMetadataTable(DS);
 
     return true;
@@ -157,18 +191,99 @@ std::string DataStore::extension()
     return STORE_EXT;
 }
 
+/**
+ * @brief DataStore::ioProfile Get store I/O profile. The option values are
+ * taken from options or else from ngsInit options.
+ * @param options Options:
+ * - STORE_MMAP_SIZE - Memory mapped I/O size in megabytes. Default 64
+ * - STORE_CACHE_SIZE - Page cache size in kilobytes. Default 8192
+ * - STORE_PAGE_SIZE - Page size in bytes for new stores. Default 4096
+ * - STORE_TEMP_STORE - Temporary tables location: DEFAULT, FILE or MEMORY.
+ * Default MEMORY
+ * - STORE_CHECKPOINT_INTERVAL - Seconds between passive WAL checkpoints after
+ * writes. Default 60, 0 disables
+ * @return Profile structure.
+ */
+StoreIOProfile DataStore::ioProfile(const Options &options)
+{
+    auto value = [&options](const char *key, const char *defaultValue) {
+        return options.asString(key, CPLGetConfigOption(
+                                    CPLSPrintf("NGS_%s", key), defaultValue));
+    };
+
+    StoreIOProfile profile;
+    profile.mmapSize = std::max(0, atoi(value("STORE_MMAP_SIZE", "64").c_str()));
+    profile.cacheSize = std::max(0, atoi(value("STORE_CACHE_SIZE", "8192").c_str()));
+    profile.pageSize = std::max(0, atoi(value("STORE_PAGE_SIZE", "4096").c_str()));
+    profile.tempStore = value("STORE_TEMP_STORE", "MEMORY");
+    profile.checkpointInterval =
+            std::max(0, atoi(value("STORE_CHECKPOINT_INTERVAL", "60").c_str()));
+    return profile;
+}
+
+void DataStore::applyIOProfile(GDALDataset *ds, const StoreIOProfile &profile,
+                               bool readOnly)
+{
+    if(nullptr == ds) {
+        return;
+    }
+
+    executePragma(ds, CPLSPrintf("mmap_size = " CPL_FRMT_GIB,
+                                 static_cast<GIntBig>(profile.mmapSize) * 1024 * 1024));
+    // Negative value is the cache size in kilobytes
+    executePragma(ds, CPLSPrintf("cache_size = -%d", profile.cacheSize));
+    executePragma(ds, CPLSPrintf("temp_store = %s", profile.tempStore.c_str()));
+    if(!readOnly) {
+        // WAL is consistent with NORMAL, only last commits may roll back on
+        // power loss
+        executePragma(ds, "synchronous = NORMAL");
+    }
+}
+
+/**
+ * @brief DataStore::checkpoint Run passive WAL checkpoint if the checkpoint
+ * interval elapsed since the last one. Passive checkpoint does not wait for
+ * readers and writers.
+ * @param force Run checkpoint regardless of the interval.
+ */
+void DataStore::checkpoint(bool force)
+{
+    if(!isOpened() || isBatchOperation() ||
+       (m_ioProfile.checkpointInterval == 0 && !force)) {
+        return;
+    }
+
+    time_t now = time(nullptr);
+    if(!force && now - m_lastCheckpoint < m_ioProfile.checkpointInterval) {
+        return;
+    }
+    m_lastCheckpoint = now;
+
+    MutexHolder holder(m_executeSQLMutex);
+    executePragma(m_DS, "wal_checkpoint(PASSIVE)");
+}
+
 bool DataStore::open(unsigned int openFlags, const Options &options)
 {
     if(isOpened()) {
         return true;
     }
 
-    if(!Dataset::open(openFlags, options)) {
+    // I/O profile options are not GDAL open options
+    m_ioProfile = ioProfile(options);
+    Options openOptions(options);
+    for(auto key : {"STORE_MMAP_SIZE", "STORE_CACHE_SIZE", "STORE_PAGE_SIZE",
+                    "STORE_TEMP_STORE", "STORE_CHECKPOINT_INTERVAL"}) {
+        openOptions.remove(key);
+    }
+
+    if(!Dataset::open(openFlags, openOptions)) {
         return false;
     }
 
     executeSQL("PRAGMA journal_mode=WAL", "SQLite");
     executeSQL("PRAGMA busy_timeout = 120000", "SQLite"); // 2m timeout
+    applyIOProfile(m_DS, m_ioProfile, false);
 
     resetError();
 
@@ -177,6 +292,8 @@ bool DataStore::open(unsigned int openFlags, const Options &options)
     if(version < NGS_VERSION_NUM && !upgrade(version)) {
         return errorMessage(_("Upgrade storage failed"));
     }
+    m_overviewsTileKeys = !isReadOnly() ||
+            version >= NGS_COMPUTE_VERSION(0, 11, 2);
 
     return true;
 }
@@ -355,6 +472,11 @@ ObjectPtr DataStore::create(const enum ngsCatalogObjectType type,
                              options);
     }
 
+    // Sync looks up features by remote id
+    if(nullptr != object) {
+        createAttributeIndex(newName, ngw::REMOTE_ID_KEY);
+    }
+
     ObjectPtr objectPtr = onChildCreated(object);
     setMetadata(objectPtr, featureDefnStruct.fields, options);
     return objectPtr;
@@ -362,31 +484,175 @@ ObjectPtr DataStore::create(const enum ngsCatalogObjectType type,
 
 bool DataStore::upgrade(int oldVersion)
 {
+    if(isReadOnly()) {
+        return true; // Old data is still readable
+    }
+
+    // Version 0.11.1 stores overview tiles in the in place readable format
+    if(oldVersion < NGS_COMPUTE_VERSION(0, 11, 1) && !upgradeOverviews()) {
+        return false;
+    }
+
+    // Version 0.11.2 keys overview tiles by zoom and Morton code
+    if(oldVersion < NGS_COMPUTE_VERSION(0, 11, 2) &&
+            !upgradeOverviewsTileKeys()) {
+        return false;
+    }
+
     executeSQL("VACUUM", "SQLite");
-    ngsUnused(oldVersion);
-    // no structure changes for version 1
+    setProperty(NGS_VERSION_KEY, std::to_string(NGS_VERSION_NUM),
+                NG_ADDITIONS_KEY);
+    return true;
+}
+
+bool DataStore::upgradeOverviews()
+{
+    if(!m_addsDS) {
+        return true;
+    }
+
+    std::string suffix = std::string("_") + OVR_SUFFIX;
+    for(int i = 0; i < m_addsDS->GetLayerCount(); ++i) {
+        OGRLayer *layer = m_addsDS->GetLayer(i);
+        if(nullptr == layer ||
+                !startsWith(layer->GetName(), NG_PREFIX) ||
+                !endsWith(layer->GetName(), suffix)) {
+            continue;
+        }
+
+        int tileIndex = layer->GetLayerDefn()->GetFieldIndex(OVR_TILE_KEY);
+        if(tileIndex < 0) {
+            continue;
+        }
+
+        CPLDebug("ngstore", "Upgrade overview tiles in %s", layer->GetName());
+        // Collect old tiles first, the layer is not updated during reading
+        std::vector<GIntBig> fids;
+        layer->ResetReading();
+        FeaturePtr feature;
+        while((feature = layer->GetNextFeature())) {
+            int size = 0;
+            GByte *data = feature->GetFieldAsBinary(tileIndex, &size);
+            Buffer buff(data, size, false);
+            GUInt32 magic = size < 4 ? 0 : buff.getULong();
+            if(size < 4 || magic == VECTOR_TILE_MAGIC ||
+                    magic == VECTOR_TILE_COMPRESSED_MAGIC) {
+                continue; // Empty or already upgraded
+            }
+            fids.push_back(feature->GetFID());
+        }
+        layer->ResetReading();
+
+        m_addsDS->StartTransaction();
+        for(GIntBig fid : fids) {
+            feature = layer->GetFeature(fid);
+            if(!feature) {
+                continue;
+            }
+            int size = 0;
+            GByte *data = feature->GetFieldAsBinary(tileIndex, &size);
+            Buffer buff(data, size, false);
+            FlatVectorTile vtile;
+            if(!vtile.load(buff)) {
+                continue;
+            }
+
+            BufferPtr newData = vtile.save(true);
+            feature->SetField(tileIndex, newData->size(), newData->data());
+            if(layer->SetFeature(feature) != OGRERR_NONE) {
+                m_addsDS->RollbackTransaction();
+                return errorMessage(_("Failed to upgrade overview tile. %s"),
+                                    CPLGetLastErrorMsg());
+            }
+        }
+        m_addsDS->CommitTransaction();
+    }
+    return true;
+}
+
+/**
+ * @brief DataStore::upgradeOverviewsTileKeys Set overview tile row identifiers
+ * to tile keys, so tiles are read by primary key. Tiles are ordered by the
+ * keys on VACUUM after upgrade. Index by tile coordinates is dropped.
+ * @return True on success.
+ */
+bool DataStore::upgradeOverviewsTileKeys()
+{
+    if(!m_addsDS) {
+        return true;
+    }
+
+    std::string suffix = std::string("_") + OVR_SUFFIX;
+    for(int i = 0; i < m_addsDS->GetLayerCount(); ++i) {
+        OGRLayer *layer = m_addsDS->GetLayer(i);
+        if(nullptr == layer ||
+                !startsWith(layer->GetName(), NG_PREFIX) ||
+                !endsWith(layer->GetName(), suffix)) {
+            continue;
+        }
+
+        CPLDebug("ngstore", "Upgrade overview tile keys in %s", layer->GetName());
+        std::vector<std::pair<GIntBig, GIntBig>> keys;
+        layer->ResetReading();
+        FeaturePtr feature;
+        while((feature = layer->GetNextFeature())) {
+            Tile tile = { feature->GetFieldAsInteger(OVR_X_KEY),
+                          feature->GetFieldAsInteger(OVR_Y_KEY),
+                          static_cast<unsigned char>(
+                              feature->GetFieldAsInteger(OVR_ZOOM_KEY)), 0 };
+            GIntBig key = FeatureClassOverview::tileKey(tile);
+            if(key != feature->GetFID()) {
+                keys.push_back(std::make_pair(feature->GetFID(), key));
+            }
+        }
+        layer->ResetReading();
+
+        // Old identifiers start from 1, keys are 0 or greater than any of them
+        std::string fidColumn = layer->GetFIDColumn();
+        m_addsDS->StartTransaction();
+        for(const auto &key : keys) {
+            resetError();
+            m_addsDS->ExecuteSQL(CPLSPrintf(
+                "UPDATE \"%s\" SET \"%s\" = " CPL_FRMT_GIB " WHERE \"%s\" = " CPL_FRMT_GIB,
+                layer->GetName(), fidColumn.c_str(), key.second,
+                fidColumn.c_str(), key.first), nullptr, nullptr);
+            if(CPLGetLastErrorType() >= CE_Failure) {
+                // Duplicate tile
+                layer->DeleteFeature(key.first);
+            }
+        }
+        dropOverviewsTableIndex(m_addsDS, layer->GetName());
+        if(m_addsDS->CommitTransaction() != OGRERR_NONE) {
+            return errorMessage(_("Failed to upgrade overview tile keys. %s"),
+                                CPLGetLastErrorMsg());
+        }
+    }
     return true;
 }
 
-void DataStore::enableJournal(bool enable)
+/**
+ * @brief DataStore::enableBatchMode Enter or leave batch mode. The store stays
+ * in WAL mode, so batch is crash safe: writers commit rows in chunks and a
+ * killed process loses only the uncommitted chunk. Only fsync is off while in
+ * batch.
+ * @param enable True to enter batch mode, false to leave.
+ */
+void DataStore::enableBatchMode(bool enable)
 {
+    // Several layers can be loaded at once from different threads
+    MutexHolder holder(m_executeSQLMutex);
     if(enable) {
-        m_disableJournalCounter--;
-        if(m_disableJournalCounter == 0) {
-            // executeSQL("PRAGMA synchronous = FULL", "SQLite");
-            executeSQL("PRAGMA journal_mode = WAL", "SQLite");
-            //executeSQL("PRAGMA count_changes=ON", "SQLite"); // This pragma is deprecated
+        CPLAssert(m_batchCounter < 255); // only 255 layers can simultanious load geodata
+        m_batchCounter++;
+        if(m_batchCounter == 1) {
+            executeSQL("PRAGMA synchronous = OFF", "SQLite");
         }
     }
     else {
-        CPLAssert(m_disableJournalCounter < 255); // only 255 layers can simultanious load geodata
-        m_disableJournalCounter++;
-        if(m_disableJournalCounter == 1) {
-            // executeSQL("PRAGMA synchronous = OFF", "SQLite");
-            executeSQL("PRAGMA journal_mode = OFF", "SQLite");
-            //executeSQL("PRAGMA count_changes=OFF", "SQLite"); // This pragma is deprecated
-            // executeSQL ("PRAGMA locking_mode=EXCLUSIVE", "SQLite");
-            // executeSQL ("PRAGMA cache_size=15000", "SQLite");
+        m_batchCounter--;
+        if(m_batchCounter == 0) {
+            executeSQL("PRAGMA synchronous = NORMAL", "SQLite");
+            checkpoint(true);
         }
     }
 }
@@ -419,9 +685,89 @@ OGRLayer *DataStore::createEditHistoryTable(const std::string &name)
     return ngw::createEditHistoryTable(m_addsDS, logLayerName);
 }
 
+void DataStore::stopBatchOperation()
+{
+    MutexHolder holder(m_executeSQLMutex);
+    // Write overview changes deferred while in batch
+    if(m_batchCounter == 1) {
+        flushOverviews();
+    }
+    enableBatchMode(false);
+}
+
+void DataStore::close()
+{
+    closeReadConnections();
+    Dataset::close();
+}
+
+/**
+ * @brief DataStore::acquireReadConnection Get read only connection from pool.
+ * The pool opens one connection per worker thread at most.
+ * @return Connection or empty pointer.
+ */
+GDALDatasetPtr DataStore::acquireReadConnection()
+{
+    MutexHolder holder(m_readConnectionsMutex);
+    if(!isOpened()) {
+        return GDALDatasetPtr();
+    }
+
+    if(!m_readConnections.empty()) {
+        GDALDatasetPtr connection = m_readConnections.back();
+        m_readConnections.pop_back();
+        return connection;
+    }
+
+    if(m_readConnectionsCount >= getNumberThreads()) {
+        return GDALDatasetPtr();
+    }
+
+    GDALDatasetPtr connection = static_cast<GDALDataset*>(
+                GDALOpenEx(m_path.c_str(), GDAL_OF_VECTOR|GDAL_OF_READONLY,
+                           nullptr, nullptr, nullptr));
+    if(connection) {
+        applyIOProfile(connection, m_ioProfile, true);
+        m_readConnectionsCount++;
+    }
+    return connection;
+}
+
+void DataStore::releaseReadConnection(GDALDatasetPtr connection)
+{
+    if(!connection) {
+        return;
+    }
+
+    MutexHolder holder(m_readConnectionsMutex);
+    if(!isOpened()) {
+        m_readConnectionsCount--;
+        return;
+    }
+    m_readConnections.push_back(connection);
+}
+
+void DataStore::closeReadConnections()
+{
+    MutexHolder holder(m_readConnectionsMutex);
+    m_readConnectionsCount -= static_cast<unsigned char>(m_readConnections.size());
+    m_readConnections.clear();
+}
+
+void DataStore::flushOverviews()
+{
+    for(const auto &child : m_children) {
+        FeatureClassOverview *featureClass =
+                dynamic_cast<FeatureClassOverview*>(child.get());
+        if(nullptr != featureClass) {
+            featureClass->flushDirtyTiles();
+        }
+    }
+}
+
 bool DataStore::isBatchOperation() const
 {
-    return m_disableJournalCounter > 0;
+    return m_batchCounter > 0;
 }
 
 bool DataStore::hasTracksTable() const
@@ -643,6 +989,19 @@ bool DataStore::createTracksTable()
         return false;
     }
 
+    // Same as time_stamp in seconds since epoch, for indexed range queries
+    OGRFieldDefn epochField("time_stamp_epoch", OFTInteger64);
+    epochField.SetDefault("0");
+    if(layer->CreateField(&epochField) != OGRERR_NONE) {
+        m_DS->RollbackTransaction();
+        return false;
+    }
+
+    if(!createTracksPointsIndex()) {
+        m_DS->RollbackTransaction();
+        return false;
+    }
+
     layer = m_DS->CreateLayer(TRACKS_TABLE, m_spatialReference, wkbMultiLineString);
     if(layer == nullptr) {
         m_DS->RollbackTransaction();
@@ -679,9 +1038,109 @@ bool DataStore::createTracksTable()
         return false;
     }
 
+    if(createTracksOverviewTable() == nullptr) {
+        m_DS->RollbackTransaction();
+        return false;
+    }
+
     return m_DS->CommitTransaction() == OGRERR_NONE;
 }
 
+/**
+ * @brief DataStore::createTracksPointsIndex Create indexes for time range
+ * queries and for the points left to sync.
+ * @return True on success.
+ */
+bool DataStore::createTracksPointsIndex()
+{
+    MutexHolder holder(m_executeSQLMutex);
+    CPLErrorReset();
+    m_DS->ExecuteSQL(CPLSPrintf("CREATE INDEX IF NOT EXISTS %s_epoch_idx on %s (time_stamp_epoch)",
+                                TRACKS_POINTS_TABLE, TRACKS_POINTS_TABLE),
+                     nullptr, nullptr);
+    m_DS->ExecuteSQL(CPLSPrintf("CREATE INDEX IF NOT EXISTS %s_sync_idx on %s (synced) WHERE synced = 0",
+                                TRACKS_POINTS_TABLE, TRACKS_POINTS_TABLE),
+                     nullptr, nullptr);
+    return CPLGetLastErrorType() < CE_Failure;
+}
+
+/**
+ * @brief DataStore::upgradeTracksPointsTable Add epoch column and indexes to
+ * points table of stores created before them.
+ * @param layer Tracks points layer.
+ * @return True on success.
+ */
+bool DataStore::upgradeTracksPointsTable(OGRLayer *layer)
+{
+    if(nullptr == layer ||
+            layer->GetLayerDefn()->GetFieldIndex("time_stamp_epoch") >= 0) {
+        return true;
+    }
+
+    if(isReadOnly()) {
+        return true; // Queries fall back to full scan
+    }
+
+    CPLDebug("ngstore", "Upgrade tracks points table");
+    MutexHolder holder(m_executeSQLMutex);
+    m_DS->StartTransaction();
+
+    OGRFieldDefn epochField("time_stamp_epoch", OFTInteger64);
+    epochField.SetDefault("0");
+    if(layer->CreateField(&epochField) != OGRERR_NONE) {
+        m_DS->RollbackTransaction();
+        return errorMessage(_("Failed to upgrade tracks points table. %s"),
+                            CPLGetLastErrorMsg());
+    }
+
+    m_DS->ExecuteSQL(CPLSPrintf("UPDATE %s SET time_stamp_epoch = CAST(strftime('%%s', time_stamp) AS INTEGER)",
+                                TRACKS_POINTS_TABLE), nullptr, nullptr);
+
+    if(!createTracksPointsIndex()) {
+        m_DS->RollbackTransaction();
+        return errorMessage(_("Failed to upgrade tracks points table. %s"),
+                            CPLGetLastErrorMsg());
+    }
+
+    return m_DS->CommitTransaction() == OGRERR_NONE;
+}
+
+/**
+ * @brief DataStore::createTracksOverviewTable Create table for simplified
+ * track lines. Each track has one row per overview zoom level.
+ * @return Created layer or nullptr.
+ */
+OGRLayer *DataStore::createTracksOverviewTable()
+{
+    MutexHolder holder(m_executeSQLMutex);
+
+    CPLStringList options;
+    options.AddString("SPATIAL_INDEX=NO");
+    OGRLayer *layer = m_DS->CreateLayer(TRACKS_OVR_TABLE, m_spatialReference,
+                                        wkbMultiLineString, options);
+    if(layer == nullptr) {
+        errorMessage(CPLGetLastErrorMsg());
+        return nullptr;
+    }
+
+    OGRFieldDefn trackFIDField("track_fid", OFTInteger);
+    trackFIDField.SetNullable(FALSE);
+    if(layer->CreateField(&trackFIDField) != OGRERR_NONE) {
+        return nullptr;
+    }
+
+    OGRFieldDefn zoomField("zoom", OFTInteger);
+    zoomField.SetNullable(FALSE);
+    if(layer->CreateField(&zoomField) != OGRERR_NONE) {
+        return nullptr;
+    }
+
+    m_DS->ExecuteSQL(CPLSPrintf("CREATE INDEX IF NOT EXISTS %s_idx on %s (track_fid, zoom)",
+                                TRACKS_OVR_TABLE, TRACKS_OVR_TABLE),
+                     nullptr, nullptr);
+    return layer;
+}
+
 ObjectPtr DataStore::getTracksTable()
 {
     if(m_tracksTable) {
@@ -694,13 +1153,29 @@ ObjectPtr DataStore::getTracksTable()
         }
     }
 
+    OGRLayer *pointsLayer = m_DS->GetLayerByName(TRACKS_POINTS_TABLE);
+    if(!upgradeTracksPointsTable(pointsLayer)) {
+        return ObjectPtr();
+    }
+
+    // Stores created before track overviews were added
+    OGRLayer *ovrLayer = m_DS->GetLayerByName(TRACKS_OVR_TABLE);
+    if(nullptr == ovrLayer) {
+        ovrLayer = createTracksOverviewTable();
+    }
+
     m_tracksTable = ObjectPtr(new TracksTable(m_DS->GetLayerByName(TRACKS_TABLE),
-            m_DS->GetLayerByName(TRACKS_POINTS_TABLE), this));
+            pointsLayer, ovrLayer, this));
     return m_tracksTable;
 }
 
 bool DataStore::destroyTracksTable()
 {
+    OGRLayer *ovrLayer = m_DS->GetLayerByName(TRACKS_OVR_TABLE);
+    if(ovrLayer) {
+        destroyTable(m_DS, ovrLayer);
+    }
+
     OGRLayer *layer = m_DS->GetLayerByName(TRACKS_POINTS_TABLE);
     if(!layer) {
         return false;
@@ -725,35 +1200,271 @@ OGRLayer *DataStore::createOverviewsTable(const std::string &name)
     return createOverviewsTable(m_addsDS, overviewsTableName(name));
 }
 
-bool DataStore::createOverviewsTableIndex(const std::string &name)
+/**
+ * @brief DataStore::hasSpatialIndex Check if feature class has R-tree.
+ * @param name Feature class name.
+ * @param geometryColumn Geometry column name.
+ * @return true if spatial index exists.
+ */
+bool DataStore::hasSpatialIndex(const std::string &name,
+                                const std::string &geometryColumn)
 {
-    if(!m_addsDS)
+    TablePtr result = executeSQL(CPLSPrintf("SELECT HasSpatialIndex('%s', '%s')",
+                                            name.c_str(),
+                                            geometryColumn.c_str()));
+    if(!result) {
         return false;
+    }
+    FeaturePtr feature = result->nextFeature();
+    return feature && feature->GetFieldAsInteger(0) != 0;
+}
 
-    return createOverviewsTableIndex(m_addsDS, overviewsTableName(name));
+/**
+ * @brief DataStore::dropSpatialIndex Drop R-tree and its triggers of feature
+ * class.
+ * @param name Feature class name.
+ * @param geometryColumn Geometry column name.
+ * @return true if spatial index existed and was dropped.
+ */
+bool DataStore::dropSpatialIndex(const std::string &name,
+                                 const std::string &geometryColumn)
+{
+    if(!hasSpatialIndex(name, geometryColumn)) {
+        return false;
+    }
+
+    executeSQL(CPLSPrintf("SELECT DisableSpatialIndex('%s', '%s')",
+                          name.c_str(), geometryColumn.c_str()));
+    return true;
 }
 
-bool DataStore::dropOverviewsTableIndex(const std::string &name)
+/**
+ * @brief DataStore::createSpatialIndex Create R-tree and its triggers of
+ * feature class and fill it with existing features in one pass.
+ * @param name Feature class name.
+ * @param geometryColumn Geometry column name.
+ * @return true on success.
+ */
+bool DataStore::createSpatialIndex(const std::string &name,
+                                   const std::string &geometryColumn)
 {
-    if(!m_addsDS)
+    TablePtr result = executeSQL(CPLSPrintf("SELECT CreateSpatialIndex('%s', '%s')",
+                                            name.c_str(),
+                                            geometryColumn.c_str()));
+    if(!result) {
+        return errorMessage(_("Failed to create spatial index for %s. %s"),
+                            name.c_str(), CPLGetLastErrorMsg());
+    }
+    FeaturePtr feature = result->nextFeature();
+    return feature && feature->GetFieldAsInteger(0) == 1;
+}
+
+/**
+ * @brief DataStore::recomputeExtent Update feature class extent in
+ * gpkg_contents from the remaining features.
+ * @param name Feature class name.
+ * @return true on success.
+ */
+bool DataStore::recomputeExtent(const std::string &name)
+{
+    if(!isOpened() || isReadOnly()) {
         return false;
+    }
 
-    return dropOverviewsTableIndex(m_addsDS, overviewsTableName(name));
+    // The statement is handled by driver and returns no result set
+    MutexHolder holder(m_executeSQLMutex);
+    resetError();
+    m_DS->ExecuteSQL(CPLSPrintf("RECOMPUTE EXTENT ON \"%s\"", name.c_str()),
+                     nullptr, nullptr);
+    return CPLGetLastErrorType() < CE_Failure;
 }
 
-std::string DataStore::overviewsTableName(const std::string &name) const
+static std::string attributeIndexName(const std::string &name,
+                                      const std::string &field)
 {
-    return NG_PREFIX + name + "_" + OVR_SUFFIX;
+    return name + "_" + field + "_idx";
+}
+
+/**
+ * @brief DataStore::createAttributeIndex Create index on table field if not
+ * exists. Attribute filters on indexed field do not scan the table.
+ * @param name Table name.
+ * @param field Field name.
+ * @return true on success.
+ */
+bool DataStore::createAttributeIndex(const std::string &name,
+                                     const std::string &field)
+{
+    if(!isOpened() || isReadOnly()) {
+        return errorMessage(_("Failed to create index for %s. Data store is read only"),
+                            name.c_str());
+    }
+
+    MutexHolder holder(m_executeSQLMutex);
+    resetError();
+    m_DS->ExecuteSQL(CPLSPrintf("CREATE INDEX IF NOT EXISTS \"%s\" ON \"%s\" (\"%s\")",
+                                attributeIndexName(name, field).c_str(),
+                                name.c_str(), field.c_str()), nullptr, nullptr);
+    if(CPLGetLastErrorType() >= CE_Failure) {
+        return errorMessage(_("Failed to create index for %s. %s"),
+                            name.c_str(), CPLGetLastErrorMsg());
+    }
+    return true;
 }
 
-bool DataStore::createOverviewsTableIndex(GDALDataset *ds, const std::string &name)
+bool DataStore::dropAttributeIndex(const std::string &name,
+                                   const std::string &field)
 {
-    ds->ExecuteSQL(CPLSPrintf("CREATE INDEX IF NOT EXISTS %s_idx on %s (%s, %s, %s)",
-                              name.c_str(), name.c_str(), OVR_X_KEY, OVR_Y_KEY,
-                              OVR_ZOOM_KEY), nullptr, nullptr);
+    if(!isOpened() || isReadOnly()) {
+        return errorMessage(_("Failed to drop index for %s. Data store is read only"),
+                            name.c_str());
+    }
+
+    MutexHolder holder(m_executeSQLMutex);
+    resetError();
+    m_DS->ExecuteSQL(CPLSPrintf("DROP INDEX IF EXISTS \"%s\"",
+                                attributeIndexName(name, field).c_str()),
+                     nullptr, nullptr);
+    if(CPLGetLastErrorType() >= CE_Failure) {
+        return errorMessage(_("Failed to drop index for %s. %s"),
+                            name.c_str(), CPLGetLastErrorMsg());
+    }
     return true;
 }
 
+/**
+ * @brief DataStore::executeStatement Execute SQL statement which returns no
+ * result set.
+ * @param statement SQL statement.
+ * @return true on success.
+ */
+bool DataStore::executeStatement(const std::string &statement)
+{
+    if(!isOpened() || isReadOnly()) {
+        return false;
+    }
+
+    MutexHolder holder(m_executeSQLMutex);
+    resetError();
+    m_DS->ExecuteSQL(statement.c_str(), nullptr, nullptr);
+    return CPLGetLastErrorType() < CE_Failure;
+}
+
+std::string DataStore::searchTableName(const std::string &name) const
+{
+    return NG_PREFIX + name + "_" + SEARCH_SUFFIX;
+}
+
+/**
+ * @brief DataStore::createSearchTable Create FTS5 table for feature class
+ * search text. Table row id is the feature id.
+ * @param name Feature class name.
+ * @return true on success.
+ */
+bool DataStore::createSearchTable(const std::string &name)
+{
+    if(!executeStatement(CPLSPrintf(
+            "CREATE VIRTUAL TABLE IF NOT EXISTS \"%s\" USING "
+            "fts5(%s, tokenize = 'unicode61')",
+            searchTableName(name).c_str(), SEARCH_TEXT_KEY))) {
+        return errorMessage(_("Failed to create search table for %s. %s"),
+                            name.c_str(), CPLGetLastErrorMsg());
+    }
+    return true;
+}
+
+bool DataStore::destroySearchTable(const std::string &name)
+{
+    return executeStatement(CPLSPrintf("DROP TABLE IF EXISTS \"%s\"",
+                                       searchTableName(name).c_str()));
+}
+
+bool DataStore::clearSearchTable(const std::string &name)
+{
+    return executeStatement(CPLSPrintf("DELETE FROM \"%s\"",
+                                       searchTableName(name).c_str()));
+}
+
+bool DataStore::setSearchText(const std::string &name, GIntBig fid,
+                              const std::string &text)
+{
+    if(!deleteSearchText(name, fid)) {
+        return false;
+    }
+    if(text.empty()) {
+        return true;
+    }
+    CPLString value(text);
+    return executeStatement(CPLSPrintf(
+            "INSERT INTO \"%s\" (rowid, %s) VALUES (" CPL_FRMT_GIB ", '%s')",
+            searchTableName(name).c_str(), SEARCH_TEXT_KEY, fid,
+            value.replaceAll("'", "''").c_str()));
+}
+
+bool DataStore::deleteSearchText(const std::string &name, GIntBig fid)
+{
+    return executeStatement(CPLSPrintf(
+            "DELETE FROM \"%s\" WHERE rowid = " CPL_FRMT_GIB,
+            searchTableName(name).c_str(), fid));
+}
+
+/**
+ * @brief DataStore::search Find feature ids by FTS5 match expression. Best
+ * matches go first.
+ * @param name Feature class name.
+ * @param match FTS5 match expression.
+ * @param offset Number of matches to skip.
+ * @param limit Maximum number of feature ids to return.
+ * @return Feature ids.
+ */
+std::vector<GIntBig> DataStore::search(const std::string &name,
+                                       const std::string &match, int offset,
+                                       int limit)
+{
+    std::vector<GIntBig> out;
+    std::string tableName = searchTableName(name);
+    CPLString value(match);
+    // Expression keeps rowid an ordinary result field
+    TablePtr result = executeSQL(CPLSPrintf(
+            "SELECT CAST(rowid AS INTEGER) AS search_fid FROM \"%s\" "
+            "WHERE \"%s\" MATCH '%s' ORDER BY rank LIMIT %d OFFSET %d",
+            tableName.c_str(), tableName.c_str(),
+            value.replaceAll("'", "''").c_str(), limit, offset));
+    if(!result) {
+        return out;
+    }
+
+    FeaturePtr feature;
+    while((feature = result->nextFeature())) {
+        out.push_back(feature->GetFieldAsInteger64(0));
+    }
+    return out;
+}
+
+TablePtr DataStore::extentQuery(const std::string &name,
+                                const std::string &fidColumn,
+                                const std::string &geometryColumn,
+                                const Envelope &extent)
+{
+    if(!hasSpatialIndex(name, geometryColumn)) {
+        return TablePtr();
+    }
+    return executeSQL(CPLSPrintf("SELECT \"%s\", \"%s\" FROM \"%s\" WHERE \"%s\" IN "
+                                 "(SELECT id FROM \"rtree_%s_%s\" WHERE "
+                                 "minx <= %.17g AND maxx >= %.17g AND "
+                                 "miny <= %.17g AND maxy >= %.17g)",
+                                 fidColumn.c_str(), geometryColumn.c_str(),
+                                 name.c_str(), fidColumn.c_str(),
+                                 name.c_str(), geometryColumn.c_str(),
+                                 extent.maxX(), extent.minX(),
+                                 extent.maxY(), extent.minY()));
+}
+
+std::string DataStore::overviewsTableName(const std::string &name) const
+{
+    return NG_PREFIX + name + "_" + OVR_SUFFIX;
+}
+
 bool DataStore::dropOverviewsTableIndex(GDALDataset *ds, const std::string &name)
 {
     ds->ExecuteSQL(CPLSPrintf("DROP INDEX IF EXISTS %s_idx", name.c_str()),
@@ -803,6 +1514,119 @@ OGRLayer *DataStore::getOverviewsTable(const std::string &name)
     return m_addsDS->GetLayerByName(overviewsTableName(name).c_str());
 }
 
+std::string DataStore::overviewsShadowTableName(const std::string &name) const
+{
+    return overviewsTableName(name) + "_" + OVR_SHADOW_SUFFIX;
+}
+
+/**
+ * @brief DataStore::createOverviewsShadowTable Create table for overviews
+ * rebuilt while the overviews table is read. The table of interrupted rebuild
+ * is replaced.
+ * @param name Feature class name.
+ * @return Shadow overviews table or nullptr.
+ */
+OGRLayer *DataStore::createOverviewsShadowTable(const std::string &name)
+{
+    if(!m_addsDS) {
+        createAdditionsDataset();
+    }
+
+    if(!m_addsDS)
+        return nullptr;
+
+    destroyOverviewsShadowTable(name);
+    return createOverviewsTable(m_addsDS, overviewsShadowTableName(name));
+}
+
+bool DataStore::destroyOverviewsShadowTable(const std::string &name)
+{
+    if(!m_addsDS)
+        return false;
+
+    OGRLayer *layer = m_addsDS->GetLayerByName(
+                overviewsShadowTableName(name).c_str());
+    if(!layer)
+        return false;
+    return destroyTable(m_addsDS, layer);
+}
+
+/**
+ * @brief DataStore::swapOverviewsTable Replace the overviews table by the
+ * shadow table in one transaction, so readers get either old or new tiles.
+ * Pool connections are closed as they cache the old table.
+ * @param name Feature class name.
+ * @return New overviews table or nullptr. On fail the overviews table
+ * pointers got before are not valid.
+ */
+OGRLayer *DataStore::swapOverviewsTable(const std::string &name)
+{
+    if(!m_addsDS)
+        return nullptr;
+
+    std::string tableName = overviewsTableName(name);
+    OGRLayer *shadowLayer = m_addsDS->GetLayerByName(
+                overviewsShadowTableName(name).c_str());
+    if(nullptr == shadowLayer) {
+        return nullptr;
+    }
+
+    if(m_addsDS->StartTransaction() != OGRERR_NONE) {
+        outMessage(COD_UPDATE_FAILED, CPLGetLastErrorMsg());
+        return nullptr;
+    }
+
+    resetError();
+    OGRLayer *layer = m_addsDS->GetLayerByName(tableName.c_str());
+    bool result = nullptr == layer || destroyTable(m_addsDS, layer);
+    if(result) {
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,5,0)
+        result = shadowLayer->Rename(tableName.c_str()) == OGRERR_NONE;
+#else
+        // GeoPackage driver renames the layer and updates gpkg_contents
+        m_addsDS->ExecuteSQL(CPLSPrintf("ALTER TABLE \"%s\" RENAME TO \"%s\"",
+                                        shadowLayer->GetName(),
+                                        tableName.c_str()), nullptr, nullptr);
+        result = CPLGetLastErrorType() < CE_Failure;
+#endif
+    }
+
+    if(result) {
+        result = m_addsDS->CommitTransaction() == OGRERR_NONE;
+    }
+
+    if(!result) {
+        outMessage(COD_UPDATE_FAILED, _("Failed to swap overviews table. %s"),
+                   CPLGetLastErrorMsg());
+        m_addsDS->RollbackTransaction();
+        return nullptr;
+    }
+
+    closeReadConnections();
+    checkpoint();
+    return m_addsDS->GetLayerByName(tableName.c_str());
+}
+
+bool DataStore::startOverviewsTransaction()
+{
+    if(!m_addsDS)
+        return false;
+
+    return m_addsDS->StartTransaction() == OGRERR_NONE;
+}
+
+bool DataStore::commitOverviewsTransaction()
+{
+    if(!m_addsDS)
+        return false;
+
+    if(m_addsDS->CommitTransaction() != OGRERR_NONE) {
+        return false;
+    }
+    checkpoint();
+    return true;
+}
+
 
 OGRLayer *DataStore::createOverviewsTable(GDALDataset *ds, const std::string &name)
 {
@@ -27,6 +27,19 @@ namespace ngs {
 
 constexpr const char *TRACKS_POINTS_TABLE = "nga_tracks_pt";
 constexpr const char *TRACKS_TABLE = "nga_tracks";
+constexpr const char *TRACKS_OVR_TABLE = "nga_tracks_ovr";
+
+/**
+ * @brief The StoreIOProfile struct SQLite I/O settings of data store. Values
+ * come from store open options or ngsInit options.
+ */
+typedef struct _storeIOProfile {
+    int mmapSize;           // Mb, 0 - disable memory mapped I/O
+    int cacheSize;          // Kb of page cache per connection
+    int pageSize;           // bytes, applied on store creation only
+    std::string tempStore;  // DEFAULT, FILE or MEMORY
+    int checkpointInterval; // seconds between WAL checkpoints, 0 - disabled
+} StoreIOProfile;
 
 /**
  * @brief The storage and manipulation class for raster and vector spatial data
@@ -40,23 +53,51 @@ public:
     explicit DataStore(ObjectContainer * const parent = nullptr,
               const std::string &name = "",
               const std::string &path = "");
-    virtual ~DataStore() override = default;
+    virtual ~DataStore() override;
     bool hasTracksTable() const;
     ObjectPtr getTracksTable();
     bool destroyTracksTable();
+    bool hasSpatialIndex(const std::string &name,
+                         const std::string &geometryColumn);
+    bool dropSpatialIndex(const std::string &name,
+                          const std::string &geometryColumn);
+    bool createSpatialIndex(const std::string &name,
+                            const std::string &geometryColumn);
+    bool recomputeExtent(const std::string &name);
+    bool createAttributeIndex(const std::string &name, const std::string &field);
+    bool dropAttributeIndex(const std::string &name, const std::string &field);
+    // Full-text search
+    bool createSearchTable(const std::string &name);
+    bool destroySearchTable(const std::string &name);
+    bool clearSearchTable(const std::string &name);
+    bool setSearchText(const std::string &name, GIntBig fid,
+                       const std::string &text);
+    bool deleteSearchText(const std::string &name, GIntBig fid);
+    std::vector<GIntBig> search(const std::string &name,
+                                const std::string &match, int offset,
+                                int limit);
 
     // static
 public:
     static bool create(const std::string &path);
     static std::string extension();
+    static StoreIOProfile ioProfile(const Options &options = Options());
 
     // Dataset interface
 public:
     virtual bool open(unsigned int openFlags = DatasetBase::defaultOpenFlags,
                       const Options &options = Options()) override;
-    virtual void startBatchOperation() override { enableJournal(false); }
-    virtual void stopBatchOperation() override { enableJournal(true); }
+    virtual void startBatchOperation() override { enableBatchMode(true); }
+    virtual void stopBatchOperation() override;
     virtual bool isBatchOperation() const override;
+    virtual void close() override;
+    virtual GDALDatasetPtr acquireReadConnection() override;
+    virtual void releaseReadConnection(GDALDatasetPtr connection) override;
+    void checkpoint(bool force = false);
+    virtual TablePtr extentQuery(const std::string &name,
+                                 const std::string &fidColumn,
+                                 const std::string &geometryColumn,
+                                 const Envelope &extent) override;
 
     virtual FeatureClass *createFeatureClass(const std::string &name,
                                              enum ngsCatalogObjectType objectType,
@@ -92,8 +133,6 @@ public:
 protected:
     static OGRLayer *createOverviewsTable(GDALDataset *ds,
                                           const std::string &name);
-    static bool createOverviewsTableIndex(GDALDataset *ds,
-                                          const std::string &name);
     static bool dropOverviewsTableIndex(GDALDataset *ds,
                                         const std::string &name);
     // StoreObjectContainer interface
@@ -107,22 +146,47 @@ protected:
                                            int counter = 0) const override;
     virtual void fillFeatureClasses() const override;
     bool createTracksTable();
+    OGRLayer *createTracksOverviewTable();
+    bool createTracksPointsIndex();
+    bool upgradeTracksPointsTable(OGRLayer *layer);
 
     virtual OGRLayer *createOverviewsTable(const std::string &name);
     virtual bool destroyOverviewsTable(const std::string &name);
     virtual bool clearOverviewsTable(const std::string &name);
     virtual OGRLayer *getOverviewsTable(const std::string &name);
-    virtual bool createOverviewsTableIndex(const std::string &name);
-    virtual bool dropOverviewsTableIndex(const std::string &name);
+    virtual bool startOverviewsTransaction();
+    virtual bool commitOverviewsTransaction();
     virtual std::string overviewsTableName(const std::string &name) const;
+    virtual OGRLayer *createOverviewsShadowTable(const std::string &name);
+    virtual bool destroyOverviewsShadowTable(const std::string &name);
+    virtual OGRLayer *swapOverviewsTable(const std::string &name);
+    std::string overviewsShadowTableName(const std::string &name) const;
+    bool overviewsTileKeys() const { return m_overviewsTileKeys; }
+    std::string searchTableName(const std::string &name) const;
+    bool executeStatement(const std::string &statement);
 
 protected:
-    void enableJournal(bool enable);
+    void enableBatchMode(bool enable);
+    void closeReadConnections();
+    static void applyIOProfile(GDALDataset *ds, const StoreIOProfile &profile,
+                               bool readOnly);
+    void flushOverviews();
     bool upgrade(int oldVersion);
+    bool upgradeOverviews();
+    bool upgradeOverviewsTileKeys();
 
 protected:
-    unsigned char m_disableJournalCounter;
+    unsigned char m_batchCounter;
     ObjectPtr m_tracksTable;
+    // Idle read only connections, WAL allows to read while writing
+    std::vector<GDALDatasetPtr> m_readConnections;
+    unsigned char m_readConnectionsCount;
+    Mutex m_readConnectionsMutex;
+    StoreIOProfile m_ioProfile;
+    time_t m_lastCheckpoint;
+    // Overview tile row identifiers are tile keys, old read only stores
+    // are read by tile coordinates
+    bool m_overviewsTileKeys;
 
 };
 
@@ -20,9 +20,17 @@
  ****************************************************************************/
 #include "featureclass.h"
 
+// std
+#include <map>
+
+// gdal
+#include "geos_c.h"
+
 #include "api_priv.h"
 #include "coordinatetransformation.h"
+#include "copypipeline.h"
 #include "dataset.h"
+#include "geojsonreader.h"
 #include "ngstore/catalog/filter.h"
 #include "util/error.h"
 
@@ -36,6 +44,199 @@
 
 namespace ngs {
 
+constexpr size_t SPATIAL_JOIN_CHUNK_SIZE = 1024; // Features per join job
+
+//------------------------------------------------------------------------------
+// SpatialJoinIndex
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The SpatialJoinIndex class Polygons of the spatial join with the STR
+ * tree of their envelopes. The tree is built before workers start and is only
+ * read after that. Prepared geometries are not thread safe, so every worker
+ * prepares the polygons it tests in own cache.
+ */
+class SpatialJoinIndex
+{
+public:
+    typedef struct _preparedCache {
+        GEOSContextHandlePtr handle;
+        std::map<size_t, const GEOSPreparedGeometry*> prepared;
+    } PreparedCache;
+
+public:
+    SpatialJoinIndex() : m_tree(GEOSSTRtree_create_r(m_handle.get(), 10)) {}
+    ~SpatialJoinIndex();
+    void add(OGRGeometry *geom, const std::string &value, bool isNull);
+    void build();
+    size_t size() const { return m_polygons.size(); }
+    int find(const GEOSGeometry *geom, PreparedCache *cache) const;
+    PreparedCache *takeCache();
+    void releaseCache(PreparedCache *cache);
+    void addResults(const std::vector<std::pair<GIntBig, int>> &results);
+    std::vector<std::pair<GIntBig, int>> &results() { return m_results; }
+    const std::string &value(size_t index) const { return m_values[index]; }
+    bool isNull(size_t index) const { return m_nulls[index]; }
+
+private:
+    static void addCandidate(void *item, void *userdata);
+
+private:
+    GEOSContextHandlePtr m_handle;
+    GEOSSTRtree *m_tree;
+    std::vector<GEOSGeometry*> m_polygons;
+    std::vector<std::string> m_values;
+    std::vector<bool> m_nulls;
+    std::vector<std::unique_ptr<PreparedCache>> m_caches;
+    std::vector<PreparedCache*> m_freeCaches;
+    std::vector<std::pair<GIntBig, int>> m_results;
+    Mutex m_mutex;
+};
+
+SpatialJoinIndex::~SpatialJoinIndex()
+{
+    for(const auto &cache : m_caches) {
+        for(const auto &prepared : cache->prepared) {
+            GEOSPreparedGeom_destroy_r(cache->handle.get(), prepared.second);
+        }
+    }
+    GEOSSTRtree_destroy_r(m_handle.get(), m_tree);
+    for(GEOSGeometry *polygon : m_polygons) {
+        GEOSGeom_destroy_r(m_handle.get(), polygon);
+    }
+}
+
+void SpatialJoinIndex::add(OGRGeometry *geom, const std::string &value,
+                           bool isNull)
+{
+    GEOSGeometry *polygon = geom->exportToGEOS(m_handle.get());
+    if(nullptr == polygon) {
+        return;
+    }
+    // Tree items are polygon indexes
+    GEOSSTRtree_insert_r(m_handle.get(), m_tree, polygon,
+                         reinterpret_cast<void*>(m_polygons.size()));
+    m_polygons.push_back(polygon);
+    m_values.push_back(value);
+    m_nulls.push_back(isNull);
+}
+
+/**
+ * @brief SpatialJoinIndex::build The tree is built on the first query, so
+ * query it once before it is shared with workers.
+ */
+void SpatialJoinIndex::build()
+{
+    OGRPoint origin(0.0, 0.0);
+    GEOSGeometry *point = origin.exportToGEOS(m_handle.get());
+    std::vector<size_t> candidates;
+    GEOSSTRtree_query_r(m_handle.get(), m_tree, point, addCandidate,
+                        &candidates);
+    GEOSGeom_destroy_r(m_handle.get(), point);
+}
+
+void SpatialJoinIndex::addCandidate(void *item, void *userdata)
+{
+    static_cast<std::vector<size_t>*>(userdata)->push_back(
+                reinterpret_cast<size_t>(item));
+}
+
+/**
+ * @brief SpatialJoinIndex::find Search the polygon the geometry falls in.
+ * @param geom Geometry to test.
+ * @param cache Worker prepared geometries cache.
+ * @return The first added polygon intersecting the geometry or -1.
+ */
+int SpatialJoinIndex::find(const GEOSGeometry *geom, PreparedCache *cache) const
+{
+    std::vector<size_t> candidates;
+    GEOSSTRtree_query_r(cache->handle.get(), m_tree, geom, addCandidate,
+                        &candidates);
+    // Result must not depend on the tree order
+    std::sort(candidates.begin(), candidates.end());
+    for(size_t index : candidates) {
+        const GEOSPreparedGeometry *prepared;
+        auto it = cache->prepared.find(index);
+        if(it == cache->prepared.end()) {
+            prepared = GEOSPrepare_r(cache->handle.get(), m_polygons[index]);
+            cache->prepared[index] = prepared;
+        }
+        else {
+            prepared = it->second;
+        }
+        if(nullptr != prepared &&
+                GEOSPreparedIntersects_r(cache->handle.get(), prepared, geom) == 1) {
+            return static_cast<int>(index);
+        }
+    }
+    return -1;
+}
+
+SpatialJoinIndex::PreparedCache *SpatialJoinIndex::takeCache()
+{
+    MutexHolder holder(m_mutex);
+    if(m_freeCaches.empty()) {
+        m_caches.emplace_back(new PreparedCache);
+        return m_caches.back().get();
+    }
+    PreparedCache *cache = m_freeCaches.back();
+    m_freeCaches.pop_back();
+    return cache;
+}
+
+void SpatialJoinIndex::releaseCache(PreparedCache *cache)
+{
+    MutexHolder holder(m_mutex);
+    m_freeCaches.push_back(cache);
+}
+
+void SpatialJoinIndex::addResults(
+        const std::vector<std::pair<GIntBig, int>> &results)
+{
+    MutexHolder holder(m_mutex);
+    m_results.insert(m_results.end(), results.begin(), results.end());
+}
+
+//------------------------------------------------------------------------------
+// SpatialJoinData
+//------------------------------------------------------------------------------
+
+class SpatialJoinData : public ThreadData {
+public:
+    SpatialJoinData(SpatialJoinIndex *index, bool own) :
+        ThreadData(own), m_index(index) {
+        m_features.reserve(SPATIAL_JOIN_CHUNK_SIZE);
+    }
+    std::vector<FeaturePtr> m_features;
+    SpatialJoinIndex *m_index;
+};
+
+static bool spatialJoinJobThreadFunc(ThreadData *threadData)
+{
+    SpatialJoinData *data = static_cast<SpatialJoinData*>(threadData);
+    SpatialJoinIndex *index = data->m_index;
+    SpatialJoinIndex::PreparedCache *cache = index->takeCache();
+
+    std::vector<std::pair<GIntBig, int>> results;
+    results.reserve(data->m_features.size());
+    for(const FeaturePtr &feature : data->m_features) {
+        int polygon = -1;
+        OGRGeometry *geom = feature->GetGeometryRef();
+        if(nullptr != geom && !geom->IsEmpty()) {
+            GEOSGeometry *geosGeom = geom->exportToGEOS(cache->handle.get());
+            if(nullptr != geosGeom) {
+                polygon = index->find(geosGeom, cache);
+                GEOSGeom_destroy_r(cache->handle.get(), geosGeom);
+            }
+        }
+        results.push_back(std::make_pair(feature->GetFID(), polygon));
+    }
+
+    index->releaseCache(cache);
+    index->addResults(results);
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // FeatureClass
 //------------------------------------------------------------------------------
@@ -43,7 +244,8 @@ namespace ngs {
 FeatureClass::FeatureClass(OGRLayer *layer, ObjectContainer * const parent,
                            const enum ngsCatalogObjectType type,
                            const std::string &name) :
-    Table(layer, parent, type, name)
+    Table(layer, parent, type, name),
+    m_extentDirty(false)
 {
     init();
 }
@@ -94,87 +296,156 @@ int FeatureClass::copyFeatures(const FeatureClassPtr srcFClass,
 
     bool skipEmpty = options.asBool("SKIP_EMPTY_GEOMETRY", false);
     bool skipInvalid = options.asBool("SKIP_INVALID_GEOMETRY", false);
+    bool makeValid = options.asBool("MAKE_VALID_GEOMETRY", false);
     bool toMulti = options.asBool("FORCE_GEOMETRY_TO_MULTI", false);
+    bool ogrStyleToField = options.asBool("OGR_STYLE_STRING_TO_FIELD", false);
+    bool ogrStyleFieldToStyle = options.asBool("OGR_STYLE_FIELD_TO_STRING", false);
+#if GDAL_VERSION_NUM < GDAL_COMPUTE_VERSION(3,0,0)
+    makeValid = false;
+#endif
 
-    DatasetBatchOperationHolder holder(dynamic_cast<Dataset*>(m_parent));
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetBatchOperationHolder holder(dataset);
 
+    // One coordinate transformation per worker, they are not thread safe
+    int workerCount = options.asInt("COPY_THREADS", CPLGetNumCPUs());
+    if(workerCount < 1) {
+        workerCount = 1;
+    }
+    if(workerCount > MAX_COPY_THREADS) {
+        workerCount = MAX_COPY_THREADS;
+    }
     SpatialReferencePtr srcSRS = srcFClass->spatialReference();
     SpatialReferencePtr dstSRS = spatialReference();
-    CoordinateTransformation CT(srcSRS, dstSRS);
-    GIntBig featureCount = srcFClass->featureCount();
+    // Transformations are taken from the cache, so repeated copies between
+    // the same spatial references reuse them
+    std::vector<std::unique_ptr<CachedTransformation>> transforms;
+    for(int i = 0; i < workerCount; ++i) {
+        transforms.emplace_back(new CachedTransformation(srcSRS, dstSRS));
+    }
     OGRwkbGeometryType dstGeomType = geometryType();
-    double counter = 0;
-    srcFClass->reset();
-    FeaturePtr feature;
-    bool ogrStyleToField = options.asBool("OGR_STYLE_STRING_TO_FIELD", false);
-    bool ogrStyleFieldToStyle = options.asBool("OGR_STYLE_FIELD_TO_STRING", false);
-    while((feature = srcFClass->nextFeature())) {
-        double complete = counter / featureCount;
-        if(!progress.onProgress(COD_IN_PROCESS, complete,
-                                _("Copy in process ..."))) {
-            return COD_CANCELED;
-        }
 
+    auto transform = [&](CopyRow &row, unsigned char worker) {
+        const FeaturePtr &feature = row.srcFeature;
         OGRGeometry *geom = feature->GetGeometryRef();
         OGRGeometry *newGeom = nullptr;
         if(nullptr == geom) {
             if(skipEmpty) {
-                continue;
+                return;
             }
         }
         else {
             if(skipEmpty && geom->IsEmpty()) {
-                continue;
+                return;
             }
-            if(skipInvalid && !geom->IsValid()) {
-                continue;
+            if((skipInvalid || makeValid) && !geom->IsValid()) {
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,0,0)
+                if(makeValid) {
+                    newGeom = geom->MakeValid();
+                }
+#endif
+                if(nullptr == newGeom && skipInvalid) {
+                    return;
+                }
             }
 
-            OGRwkbGeometryType geomType = geom->getGeometryType();
+            OGRwkbGeometryType geomType = nullptr == newGeom ?
+                        geom->getGeometryType() : newGeom->getGeometryType();
             OGRwkbGeometryType multiGeomType = geomType;
             if(OGR_GT_Flatten(geomType) < wkbPolygon && toMulti) {
                 multiGeomType = static_cast<OGRwkbGeometryType>(geomType + 3);
             }
             if(filterGeomType != wkbUnknown && filterGeomType != multiGeomType) {
-                continue;
+                delete newGeom;
+                return;
             }
 
-            newGeom = geom->clone();
-            if (dstGeomType != geomType) {
+            if(nullptr == newGeom) {
+                newGeom = geom->clone();
+            }
+            // Mixed geometry feature class keeps any geometry type
+            if (dstGeomType != geomType && dstGeomType != wkbUnknown) {
                 newGeom = OGRGeometryFactory::forceTo(newGeom, dstGeomType);
             }
 
-            CT.transform(newGeom);
+            (*transforms[worker])->transform(newGeom);
         }
 
-        FeaturePtr dstFeature = createFeature();
+        row.dstFeature = createFeature();
+        if(!row.dstFeature) {
+            delete newGeom;
+            return;
+        }
         if(nullptr != newGeom) {
-            dstFeature->SetGeometryDirectly(newGeom);
+            row.dstFeature->SetGeometryDirectly(newGeom);
         }
-        if(dstFeature->SetFieldsFrom(feature, fieldMap.get()) != OGRERR_NONE) {
-            if(!progress.onProgress(COD_WARNING, complete,
-                               _("Set feature fields failed. Source feature FID:" CPL_FRMT_GIB ". Error: %s"),
-                               feature->GetFID (), CPLGetLastErrorMsg())) {
-                return COD_CANCELED;
-            }
+        if(row.dstFeature->SetFieldsFrom(feature, fieldMap.get()) != OGRERR_NONE) {
+            row.warning = CPLGetLastErrorMsg();
         }
 
         if(ogrStyleToField) {
-            dstFeature->SetField(OGR_STYLE_FIELD, feature->GetStyleString());
+            row.dstFeature->SetField(OGR_STYLE_FIELD, feature->GetStyleString());
         }
         if(ogrStyleFieldToStyle) {
-            dstFeature->SetStyleString(feature->GetFieldAsString(OGR_STYLE_FIELD));
+            row.dstFeature->SetStyleString(feature->GetFieldAsString(OGR_STYLE_FIELD));
         }
+    };
 
-        if(!insertFeature(dstFeature, false)) {
-            if(!progress.onProgress(COD_WARNING, complete,
-                               _("Create feature failed. Source feature FID:" CPL_FRMT_GIB),
-                               feature->GetFID ())) {
+    int chunkSize = options.asInt("COPY_CHUNK_SIZE", DEFAULT_COPY_CHUNK_SIZE);
+    CopyPipeline pipeline(srcFClass, transform,
+                          static_cast<unsigned char>(workerCount), chunkSize,
+                          canReadAhead(srcFClass));
+
+    GIntBig featureCount = srcFClass->featureCount();
+    double counter = 0;
+    CopyChunk chunk;
+    while(pipeline.next(chunk)) {
+        DatasetWriteLockHolder writeHolder(dataset);
+        bool transaction = nullptr != dataset && dataset->startTransaction();
+        for(const CopyRow &row : chunk) {
+            double complete = counter / featureCount;
+            if(!progress.onProgress(COD_IN_PROCESS, complete,
+                                    _("Copy in process ..."))) {
+                if(transaction) {
+                    dataset->commitTransaction();
+                }
                 return COD_CANCELED;
             }
+
+            if(!row.dstFeature) {
+                continue;
+            }
+
+            if(!row.warning.empty()) {
+                if(!progress.onProgress(COD_WARNING, complete,
+                                   _("Set feature fields failed. Source feature FID:" CPL_FRMT_GIB ". Error: %s"),
+                                   row.srcFeature->GetFID (), row.warning.c_str())) {
+                    if(transaction) {
+                        dataset->commitTransaction();
+                    }
+                    return COD_CANCELED;
+                }
+            }
+
+            if(!insertFeature(row.dstFeature, false)) {
+                if(!progress.onProgress(COD_WARNING, complete,
+                                   _("Create feature failed. Source feature FID:" CPL_FRMT_GIB),
+                                   row.srcFeature->GetFID ())) {
+                    if(transaction) {
+                        dataset->commitTransaction();
+                    }
+                    return COD_CANCELED;
+                }
+            }
+            {
+                MutexHolder sourceHolder(pipeline.sourceMutex());
+                onRowCopied(row.srcFeature, row.dstFeature, options);
+            }
+            counter++;
+        }
+        if(transaction) {
+            dataset->commitTransaction();
         }
-        onRowCopied(feature, dstFeature, options);
-        counter++;
     }
     progress.onProgress(COD_FINISHED, 1.0, _("Done. Copied %d features"),
                         static_cast<int>(counter));
@@ -182,23 +453,347 @@ int FeatureClass::copyFeatures(const FeatureClassPtr srcFClass,
     return COD_SUCCESS;
 }
 
-bool FeatureClass::setIgnoredFields(const std::vector<std::string> &fields)
+/**
+ * @brief FeatureClass::loadGeoJSON Append features from GeoJSON
+ * FeatureCollection. The file is parsed by chunks and only one feature is kept
+ * in memory. Properties are written to fields with the same names, geometries
+ * are transformed from EPSG:4326.
+ * @param path File path, may be GDAL virtual file system path.
+ * @param progress Progress of file read.
+ * @param options Key - value list. The available values are:
+ * - COPY_CHUNK_SIZE - features count written in one transaction. Defaults to 1000.
+ * @return COD_SUCCESS or error code.
+ */
+int FeatureClass::loadGeoJSON(const std::string &path, const Progress &progress,
+                              const Options &options)
 {
-    if(nullptr == m_layer) {
-        return false;
+    VSIStatBufL sbuf;
+    VSILFILE *fp = nullptr;
+    if(VSIStatL(path.c_str(), &sbuf) == 0) {
+        fp = VSIFOpenL(path.c_str(), "rb");
     }
-    if(fields.empty()) {
-        return m_layer->SetIgnoredFields(nullptr) == OGRERR_NONE;
+    if(nullptr == fp) {
+        return outMessage(COD_OPEN_FAILED, _("Failed to open file %s"),
+                          path.c_str());
     }
 
-    char** ignoreFields = nullptr;
-    for(const std::string &fieldName : fields) {
-        ignoreFields = CSLAddString(ignoreFields, fieldName.c_str());
+    progress.onProgress(COD_IN_PROCESS, 0.0,
+                        _("Start load features from '%s' to '%s'"),
+                        path.c_str(), name().c_str());
+
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetBatchOperationHolder holder(dataset);
+
+    CachedTransformation transform(
+                SpatialReferencePtr::importFromEPSG(4326), spatialReference());
+    OGRwkbGeometryType dstGeomType = geometryType();
+    int chunkSize = options.asInt("COPY_CHUNK_SIZE", DEFAULT_COPY_CHUNK_SIZE);
+    if(chunkSize < 1) {
+        chunkSize = 1;
     }
-    bool result = m_layer->SetIgnoredFields(
-                const_cast<const char**>(ignoreFields)) == OGRERR_NONE;
-    CSLDestroy(ignoreFields);
-    return result;
+    double complete = 0.0;
+    GIntBig counter = 0;
+    bool transaction = false;
+    bool canceled = false;
+
+    GeoJSONReader reader([&](const CPLJSONObject &json) {
+        FeaturePtr feature = createFeature();
+        if(!feature) {
+            return false;
+        }
+
+        CPLJSONObject geometry = json.GetObj("geometry");
+        if(geometry.IsValid()) {
+            OGRGeometry *geom = ngsCreateGeometryFromGeoJson(geometry);
+            if(nullptr != geom) {
+                if(dstGeomType != wkbUnknown &&
+                        dstGeomType != geom->getGeometryType()) {
+                    geom = OGRGeometryFactory::forceTo(geom, dstGeomType);
+                }
+                transform->transform(geom);
+                feature->SetGeometryDirectly(geom);
+            }
+        }
+
+        CPLJSONObject properties = json.GetObj("properties");
+        for(const CPLJSONObject &property : properties.GetChildren()) {
+            int index = feature->GetFieldIndex(property.GetName().c_str());
+            if(index < 0) {
+                continue;
+            }
+            switch(property.GetType()) {
+            case CPLJSONObject::Type::Null:
+                break;
+            case CPLJSONObject::Type::Boolean:
+                feature->SetField(index, property.ToBool() ? 1 : 0);
+                break;
+            case CPLJSONObject::Type::Integer:
+            case CPLJSONObject::Type::Long:
+                feature->SetField(index, static_cast<GIntBig>(property.ToLong()));
+                break;
+            case CPLJSONObject::Type::Double:
+                feature->SetField(index, property.ToDouble());
+                break;
+            case CPLJSONObject::Type::String:
+                feature->SetField(index, property.ToString().c_str());
+                break;
+            default:
+                feature->SetField(index, property.Format(
+                                      CPLJSONObject::PrettyFormat::Plain).c_str());
+                break;
+            }
+        }
+
+        if(!transaction && nullptr != dataset) {
+            dataset->lockWrite(true);
+            transaction = dataset->startTransaction();
+            if(!transaction) {
+                dataset->lockWrite(false);
+            }
+        }
+        if(!insertFeature(feature, false)) {
+            if(!progress.onProgress(COD_WARNING, complete,
+                                    _("Create feature failed. Feature number " CPL_FRMT_GIB),
+                                    counter)) {
+                canceled = true;
+                return false;
+            }
+        }
+        counter++;
+        if(transaction && counter % chunkSize == 0) {
+            dataset->commitTransaction();
+            dataset->lockWrite(false);
+            transaction = false;
+        }
+        return true;
+    });
+
+    std::vector<char> buffer(GEOJSON_READ_BUFFER_SIZE);
+    bool parsed = true;
+    while(parsed && !reader.isStopped()) {
+        size_t read = VSIFReadL(buffer.data(), 1, buffer.size(), fp);
+        bool finished = read < buffer.size();
+        parsed = reader.Parse(buffer.data(), read, finished);
+        if(finished) {
+            break;
+        }
+        if(sbuf.st_size > 0) {
+            complete = static_cast<double>(VSIFTellL(fp)) / sbuf.st_size;
+        }
+        if(!progress.onProgress(COD_IN_PROCESS, complete,
+                                _("Load in process ..."))) {
+            canceled = true;
+            break;
+        }
+    }
+    VSIFCloseL(fp);
+
+    if(transaction) {
+        dataset->commitTransaction();
+        dataset->lockWrite(false);
+    }
+
+    if(canceled) {
+        return COD_CANCELED;
+    }
+    if(!parsed && !reader.isStopped()) {
+        return outMessage(COD_LOAD_FAILED, _("Failed to parse GeoJSON %s"),
+                          path.c_str());
+    }
+    if(reader.isStopped()) {
+        return outMessage(COD_INSERT_FAILED, _("Failed to create feature"));
+    }
+
+    progress.onProgress(COD_FINISHED, 1.0, _("Done. Loaded %d features"),
+                        static_cast<int>(counter));
+    return COD_SUCCESS;
+}
+
+/**
+ * @brief FeatureClass::spatialJoin Write to each feature a value of the
+ * polygon it falls in. Polygons are indexed by STR tree of their envelopes,
+ * features are tested by prepared polygon geometries in parallel chunks.
+ * Features out of polygons get null value. If feature intersects several
+ * polygons, the first read polygon wins.
+ * @param polygons Polygon feature class. Its geometries are transformed to
+ * this feature class spatial reference.
+ * @param sourceField Polygons field to read value from. If empty, polygon
+ * identifier is used.
+ * @param targetField This feature class field to write value to.
+ * @param progress Progress of join.
+ * @param options Key - value list. The available values are:
+ * - JOIN_THREADS - worker thread count. Defaults to CPU count
+ * - COPY_CHUNK_SIZE - features count written in one transaction. Defaults to 1000.
+ * @return COD_SUCCESS or error code.
+ */
+int FeatureClass::spatialJoin(const FeatureClassPtr polygons,
+                              const std::string &sourceField,
+                              const std::string &targetField,
+                              const Progress &progress, const Options &options)
+{
+    if(!polygons || polygons.get() == this) {
+        return outMessage(COD_INVALID, _("Polygons feature class is invalid"));
+    }
+    OGRwkbGeometryType polygonsType = OGR_GT_Flatten(polygons->geometryType());
+    if(polygonsType != wkbPolygon && polygonsType != wkbMultiPolygon) {
+        return outMessage(COD_INVALID, _("Feature class '%s' is not polygon"),
+                          polygons->name().c_str());
+    }
+    int sourceIndex = -1;
+    if(!sourceField.empty()) {
+        sourceIndex = polygons->definition()->GetFieldIndex(sourceField.c_str());
+        if(sourceIndex < 0) {
+            return outMessage(COD_INVALID, _("Field '%s' not found in '%s'"),
+                              sourceField.c_str(), polygons->name().c_str());
+        }
+    }
+    int targetIndex = definition()->GetFieldIndex(targetField.c_str());
+    if(targetIndex < 0) {
+        return outMessage(COD_INVALID, _("Field '%s' not found in '%s'"),
+                          targetField.c_str(), name().c_str());
+    }
+
+    progress.onProgress(COD_IN_PROCESS, 0.0,
+                        _("Start spatial join of '%s' to '%s'"),
+                        polygons->name().c_str(), name().c_str());
+
+    // Index polygons
+    SpatialJoinIndex index;
+    CachedTransformation transform(polygons->spatialReference(),
+                                   spatialReference());
+    polygons->forEachFeature([&](const FeaturePtr &feature) {
+        OGRGeometry *geom = feature->GetGeometryRef();
+        if(nullptr == geom || geom->IsEmpty()) {
+            return true;
+        }
+        std::unique_ptr<OGRGeometry> polygon(geom->clone());
+        transform->transform(polygon.get());
+        if(sourceIndex < 0) {
+            index.add(polygon.get(), std::to_string(feature->GetFID()), false);
+        }
+        else {
+            index.add(polygon.get(), feature->GetFieldAsString(sourceIndex),
+                      !feature->IsFieldSetAndNotNull(sourceIndex));
+        }
+        return true;
+    });
+    index.build();
+
+    // Test features
+    int workerCount = options.asInt("JOIN_THREADS", CPLGetNumCPUs());
+    if(workerCount < 1) {
+        workerCount = 1;
+    }
+    if(workerCount > MAX_COPY_THREADS) {
+        workerCount = MAX_COPY_THREADS;
+    }
+    ThreadPool threadPool;
+    threadPool.init(static_cast<unsigned char>(workerCount),
+                    spatialJoinJobThreadFunc);
+
+    GIntBig total = featureCount();
+    double counter = 0.0;
+    bool canceled = false;
+    SpatialJoinData *joinData = nullptr;
+    forEachFeature([&](const FeaturePtr &feature) {
+        if(nullptr == joinData) {
+            joinData = new SpatialJoinData(&index, true);
+        }
+        joinData->m_features.push_back(feature);
+        if(joinData->m_features.size() >= SPATIAL_JOIN_CHUNK_SIZE) {
+            // Keep a few chunks per worker in memory
+            while(threadPool.dataCount() >=
+                  static_cast<size_t>(workerCount) * 2) {
+                CPLSleep(0.01);
+            }
+            threadPool.addThreadData(joinData);
+            joinData = nullptr;
+        }
+        counter++;
+        if(!progress.onProgress(COD_IN_PROCESS, counter / total * 0.5,
+                                _("Spatial join in process ..."))) {
+            canceled = true;
+            return false;
+        }
+        return true;
+    });
+    if(canceled) {
+        delete joinData;
+        threadPool.clearThreadData();
+        threadPool.waitComplete(Progress());
+        return COD_CANCELED;
+    }
+    threadPool.addThreadData(joinData);
+    threadPool.waitComplete(Progress());
+
+    // Write values by identifiers order
+    std::vector<std::pair<GIntBig, int>> &results = index.results();
+    std::sort(results.begin(), results.end());
+
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetBatchOperationHolder holder(dataset);
+    int chunkSize = options.asInt("COPY_CHUNK_SIZE", DEFAULT_COPY_CHUNK_SIZE);
+    if(chunkSize < 1) {
+        chunkSize = 1;
+    }
+    counter = 0.0;
+    int joined = 0;
+    bool transaction = false;
+    for(const auto &result : results) {
+        double complete = 0.5 + counter / results.size() * 0.5;
+        if(!progress.onProgress(COD_IN_PROCESS, complete,
+                                _("Write joined values ..."))) {
+            canceled = true;
+            break;
+        }
+        counter++;
+
+        FeaturePtr feature = getFeature(result.first);
+        if(!feature) {
+            continue;
+        }
+        if(result.second < 0 || index.isNull(static_cast<size_t>(result.second))) {
+            feature->SetFieldNull(targetIndex);
+        }
+        else {
+            feature->SetField(targetIndex,
+                    index.value(static_cast<size_t>(result.second)).c_str());
+            joined++;
+        }
+
+        if(!transaction && nullptr != dataset) {
+            dataset->lockWrite(true);
+            transaction = dataset->startTransaction();
+            if(!transaction) {
+                dataset->lockWrite(false);
+            }
+        }
+        if(!updateFeature(feature)) {
+            if(!progress.onProgress(COD_WARNING, complete,
+                                    _("Update feature failed. Feature FID:" CPL_FRMT_GIB),
+                                    result.first)) {
+                canceled = true;
+                break;
+            }
+        }
+        if(transaction && static_cast<GIntBig>(counter) % chunkSize == 0) {
+            dataset->commitTransaction();
+            dataset->lockWrite(false);
+            transaction = false;
+        }
+    }
+    if(transaction) {
+        dataset->commitTransaction();
+        dataset->lockWrite(false);
+    }
+
+    if(canceled) {
+        return COD_CANCELED;
+    }
+    progress.onProgress(COD_FINISHED, 1.0,
+                        _("Done. Joined %d of %d features"), joined,
+                        static_cast<int>(results.size()));
+    return COD_SUCCESS;
 }
 
 void FeatureClass::setSpatialFilter(const GeometryPtr &geom)
@@ -210,6 +805,7 @@ void FeatureClass::setSpatialFilter(const GeometryPtr &geom)
         else {
             m_layer->SetSpatialFilter(nullptr);
         }
+        m_spatialFilter = static_cast<bool>(geom);
     }
 }
 
@@ -218,14 +814,107 @@ void FeatureClass::setSpatialFilter(double minX, double minY,
 {
     if(nullptr != m_layer) {
         m_layer->SetSpatialFilterRect(minX, minY, maxX, maxY);
+        m_spatialFilter = true;
+    }
+}
+
+/**
+ * @brief FeatureClass::featuresInExtent Get features which envelopes intersect
+ * the extent. If dataset can query spatial index, candidates are selected by
+ * R-tree envelopes and only their geometries are decoded. Otherwise the layer
+ * rectangle spatial filter is used. Exact intersection is not checked, features
+ * have only FID and geometry.
+ * @param extent Extent in feature class spatial reference.
+ * @param cancel Cancel token.
+ * @return Features array, empty if canceled.
+ */
+std::vector<FeaturePtr> FeatureClass::featuresInExtent(const Envelope &extent,
+                                                       const CancelToken &cancel)
+{
+    std::vector<FeaturePtr> out;
+    if(nullptr == m_layer) {
+        return out;
+    }
+
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    TablePtr candidates;
+    if(nullptr != dataset && m_fastSpatialFilter) {
+        candidates = dataset->extentQuery(m_layer->GetName(), fidColumn(),
+                                          geometryColumn(), extent);
+    }
+
+    MutexHolder holder(m_featureMutex);
+    if(!candidates) {
+        emptyFields(true);
+        setSpatialFilter(extent.minX(), extent.minY(), extent.maxX(),
+                         extent.maxY());
+    }
+
+    FeaturePtr feature;
+    while((feature = candidates ? candidates->nextFeature() : nextFeature())) {
+        if(cancel.isCanceled()) {
+            out.clear();
+            break;
+        }
+        if(nullptr == feature->GetGeometryRef()) {
+            continue;
+        }
+        if(candidates) {
+            if(feature->GetFID() == OGRNullFID) {
+                feature->SetFID(feature->GetFieldAsInteger64(0));
+            }
+            feature.setTable(this);
+        }
+        out.push_back(feature);
+    }
+
+    if(!candidates) {
+        emptyFields(false);
+        setSpatialFilter();
     }
+    return out;
 }
 
+/**
+ * @brief FeatureClass::extent Returns features extent. The extent grows on
+ * insert and update, and is recomputed once after features on its border were
+ * deleted.
+ * @return Extent in feature class spatial reference.
+ */
 Envelope FeatureClass::extent() const
 {
+    if(m_extentDirty.exchange(false)) {
+        Envelope extent;
+        if(recomputeExtent(extent)) {
+            m_extent = extent;
+        }
+        else {
+            m_extentDirty = true;
+        }
+    }
     return m_extent;
 }
 
+/**
+ * @brief FeatureClass::recomputeExtent Get extent of remaining features from
+ * layer.
+ * @param extent Extent to fill.
+ * @return True on success.
+ */
+bool FeatureClass::recomputeExtent(Envelope &extent) const
+{
+    if(nullptr == m_layer) {
+        return false;
+    }
+    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    OGREnvelope env;
+    if(m_layer->GetExtent(&env, TRUE) != OGRERR_NONE) {
+        return false;
+    }
+    extent = env;
+    return true;
+}
+
 std::string FeatureClass::geometryTypeName(OGRwkbGeometryType type,
                                            enum GeometryReportType reportType)
 {
@@ -425,7 +1114,44 @@ void FeatureClass::onFeatureUpdated(FeaturePtr oldFeature, FeaturePtr newFeature
 
     extentBase.fix();
     m_extent.merge(extentBase);
+    checkExtentShrink(originalGeom);
+}
+
+void FeatureClass::onFeatureDeleted(FeaturePtr delFeature)
+{
+    Table::onFeatureDeleted(delFeature);
+    if(delFeature) {
+        checkExtentShrink(delFeature->GetGeometryRef());
+    }
+}
+
+void FeatureClass::onFeaturesDeleted()
+{
+    Table::onFeaturesDeleted();
+    m_extent.clear();
+    m_extentDirty = false;
+}
 
+/**
+ * @brief FeatureClass::checkExtentShrink Mark extent for recompute if removed
+ * geometry lies on its border. Geometries inside the extent do not change it.
+ * @param geom Removed or replaced geometry.
+ */
+void FeatureClass::checkExtentShrink(const OGRGeometry *geom)
+{
+    if(nullptr == geom || m_extentDirty) {
+        return;
+    }
+    OGREnvelope env;
+    geom->getEnvelope(&env);
+    Envelope geomExtent = env;
+    geomExtent.fix();
+    if(geomExtent.minX() <= m_extent.minX() ||
+            geomExtent.minY() <= m_extent.minY() ||
+            geomExtent.maxX() >= m_extent.maxX() ||
+            geomExtent.maxY() >= m_extent.maxY()) {
+        m_extentDirty = true;
+    }
 }
 
 } // namespace ngs
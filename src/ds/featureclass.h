@@ -58,10 +58,10 @@ public:
     virtual std::vector<OGRwkbGeometryType> geometryTypes() const;
     std::string geometryColumn() const;
     std::vector<std::string> geometryColumns() const;
-    bool setIgnoredFields(const std::vector<std::string> &fields =
-            std::vector<std::string>());
     void setSpatialFilter(const GeometryPtr &geom = GeometryPtr());
     void setSpatialFilter(double minX, double minY, double maxX, double maxY);
+    std::vector<FeaturePtr> featuresInExtent(const Envelope &extent,
+                                    const CancelToken &cancel = CancelToken());
 
     virtual Envelope extent() const;
     virtual int copyFeatures(const FeatureClassPtr srcFClass,
@@ -69,6 +69,14 @@ public:
                              OGRwkbGeometryType filterGeomType,
                              const Progress &progress = Progress(),
                              const Options &options = Options());
+    int loadGeoJSON(const std::string &path,
+                    const Progress &progress = Progress(),
+                    const Options &options = Options());
+    int spatialJoin(const FeatureClassPtr polygons,
+                    const std::string &sourceField,
+                    const std::string &targetField,
+                    const Progress &progress = Progress(),
+                    const Options &options = Options());
 
     // static
     static std::string geometryTypeName(OGRwkbGeometryType type,
@@ -80,15 +88,21 @@ protected:
     virtual void onFeatureInserted(FeaturePtr feature) override;
     virtual void onFeatureUpdated(FeaturePtr oldFeature,
                                   FeaturePtr newFeature) override;
+    virtual void onFeatureDeleted(FeaturePtr delFeature) override;
+    virtual void onFeaturesDeleted() override;
 
 protected:
     void emptyFields(bool enable = true) const;
     void init();
+    void checkExtentShrink(const OGRGeometry *geom);
+    virtual bool recomputeExtent(Envelope &extent) const;
 
 protected:
     std::vector<std::string> m_ignoreFields;
     mutable Envelope m_extent;
     bool m_fastSpatialFilter;
+    // Removed geometry touched extent border
+    mutable std::atomic_bool m_extentDirty;
 };
 
 } // namespace ngs
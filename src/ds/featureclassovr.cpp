@@ -19,17 +19,306 @@
  *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ****************************************************************************/
 
-#include "datastore.h"
 #include "featureclassovr.h"
 
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <queue>
+
+#include "datastore.h"
+#include "tablecursor.h"
+#include "tilecache.h"
+
 #include "map/maptransform.h"
+#include "util/arena.h"
 #include "util/error.h"
+#include "util/notify.h"
+#include "util/threadpool.h"
+#include "util/trace.h"
 
 namespace ngs {
 
 constexpr const char *ZOOM_LEVELS_OPTION = "ZOOM_LEVELS";
+constexpr const char *DP_MAX_ZOOM_OPTION = "SIMPLIFY_DP_MAX_ZOOM";
+constexpr const char *DP_MAX_ZOOM_KEY = "simplify_dp_max_zoom";
+constexpr const char *TILE_COMPRESSION_OPTION = "TILE_COMPRESSION";
+constexpr const char *TILE_COMPRESSION_KEY = "tile_compression";
+constexpr const char *TILE_FORMAT_OPTION = "TILE_FORMAT";
+constexpr const char *TILE_FORMAT_KEY = "tile_format";
+constexpr const char *TILE_ATTRIBUTES_OPTION = "TILE_ATTRIBUTES";
+constexpr const char *TILE_ATTRIBUTES_KEY = "tile_attributes";
+constexpr const char *CLUSTER_RADIUS_OPTION = "CLUSTER_RADIUS";
+constexpr const char *CLUSTER_RADIUS_KEY = "cluster_radius";
+constexpr const char *CLUSTER_MAX_ZOOM_OPTION = "CLUSTER_MAX_ZOOM";
+constexpr const char *CLUSTER_MAX_ZOOM_KEY = "cluster_max_zoom";
+constexpr const char *BACKGROUND_OPTION = "BACKGROUND";
 constexpr unsigned short TILE_SIZE = 256; //240; //512;// 160; // Only use for overviews now in pixelSize
 constexpr double WORLD_WIDTH = DEFAULT_BOUNDS_X2.width();
+constexpr size_t TILING_BATCH_SIZE = 64; // Features per tiling job
+constexpr size_t SAVE_BATCH_SIZE = 1000; // Tiles per write transaction
+constexpr const char *MEMORY_BUDGET_OPTION = "MEMORY_BUDGET";
+constexpr int OVR_DEFAULT_MEMORY_BUDGET = 256; // Megabytes of generated tiles
+constexpr const char *OVR_RUN_EXT = "ovrrun";
+constexpr const char *AUTO_ZOOM_LEVELS = "AUTO";
+constexpr size_t OVR_SAMPLE_COUNT = 256; // Features sampled by estimate
+constexpr size_t OVR_SAMPLE_MAX_TILES = 16; // Tiles per sampled feature
+// Tiles with less vertices are fast enough to tile on the fly
+constexpr double OVR_FLY_MAX_VERTICES = 50000.0;
+constexpr unsigned char OVR_MAX_ZOOM = 18;
+// Each generated level serves the next zoom too
+constexpr unsigned char OVR_LEVEL_STEP = 2;
+// Finer level tiles are merged for not more than 2 zoom levels difference
+constexpr int OVR_MAX_MERGE_SHIFT = 2;
+// Deeper zoom levels are overzoomed from the deepest generated level
+constexpr int OVR_MAX_OVERZOOM = 3;
+// Zoom levels built in one pass after the first one
+constexpr size_t OVR_PASS_LEVELS = 3;
+// Tile key bits: zoom level above Morton code of 29 bit x and y
+constexpr int OVR_KEY_ZOOM_SHIFT = 58;
+constexpr size_t OVR_BATCH_TILES = 256; // Tile keys per batch read query
+constexpr size_t OVR_ITEM_OVERHEAD = 32; // Item offsets in tile blob
+
+static Envelope tileExtent(const Tile &tile)
+{
+    double tileSize = DEFAULT_BOUNDS.width() / (1 << tile.z);
+    double minX = DEFAULT_BOUNDS.minX() + tile.x * tileSize;
+    double minY = DEFAULT_BOUNDS.minY() + tile.y * tileSize;
+    return Envelope(minX, minY, minX + tileSize, minY + tileSize);
+}
+
+static double tileSize(unsigned char zoom)
+{
+    return DEFAULT_BOUNDS.width() / (1 << zoom);
+}
+
+static size_t vertexCount(const OGRGeometry *geom)
+{
+    OGRwkbGeometryType type = OGR_GT_Flatten(geom->getGeometryType());
+    switch(type) {
+    case wkbPoint:
+        return 1;
+    case wkbLineString:
+    case wkbLinearRing:
+        return static_cast<size_t>(
+                    static_cast<const OGRSimpleCurve*>(geom)->getNumPoints());
+    case wkbPolygon:
+    {
+        const OGRPolygon *polygon = static_cast<const OGRPolygon*>(geom);
+        if(nullptr == polygon->getExteriorRing()) {
+            return 0;
+        }
+        size_t count = vertexCount(polygon->getExteriorRing());
+        for(int i = 0; i < polygon->getNumInteriorRings(); ++i) {
+            count += vertexCount(polygon->getInteriorRing(i));
+        }
+        return count;
+    }
+    default:
+        if(OGR_GT_IsSubClassOf(type, wkbGeometryCollection)) {
+            const OGRGeometryCollection *collection =
+                    static_cast<const OGRGeometryCollection*>(geom);
+            size_t count = 0;
+            for(int i = 0; i < collection->getNumGeometries(); ++i) {
+                count += vertexCount(collection->getGeometryRef(i));
+            }
+            return count;
+        }
+    }
+    return 0;
+}
+
+static std::vector<OGRRawPoint> itemRing(const FlatVectorTileItem &item,
+                                         size_t ring)
+{
+    ArrayView<unsigned short> border = item.borderIndices(ring);
+    std::vector<OGRRawPoint> out;
+    out.reserve(border.size() + 1);
+    for(auto index : border) {
+        const SimplePoint &pt = item.point(index);
+        out.push_back(OGRRawPoint(pt.x, pt.y));
+    }
+    if(!out.empty() && (out.front().x != out.back().x ||
+                        out.front().y != out.back().y)) {
+        out.push_back(out.front());
+    }
+    return out;
+}
+
+static std::vector<SimplePoint> openRing(const std::vector<OGRRawPoint> &ring)
+{
+    std::vector<SimplePoint> out;
+    for(size_t i = 0; i + 1 < ring.size(); ++i) {
+        out.push_back({ static_cast<float>(ring[i].x),
+                        static_cast<float>(ring[i].y) });
+    }
+    return out;
+}
+
+/**
+ * @brief isMixedGeometry Check if feature class stores points, lines and
+ * polygons together.
+ * @param type Feature class geometry type.
+ */
+static bool isMixedGeometry(OGRwkbGeometryType type)
+{
+    type = OGR_GT_Flatten(type);
+    return type == wkbUnknown || type == wkbGeometryCollection;
+}
+
+/**
+ * @brief isPrecisePixelSize Check if geometry is simplified with the precise
+ * pixel size. Points use the coarser one.
+ * @param type Geometry type.
+ */
+static bool isPrecisePixelSize(OGRwkbGeometryType type)
+{
+    type = OGR_GT_Flatten(type);
+    return !(type == wkbPoint || type == wkbMultiPoint);
+}
+
+/**
+ * @brief clipTileItem Clip the item of coarser level tile by the tile extent.
+ * Points are not clipped, lines and polygons crossing the extent are cut by
+ * it. Polygon without borders is taken as is.
+ * @param item Item to clip.
+ * @param env Tile extent.
+ * @param type Flatten geometry type of feature class. Type of mixed geometry
+ * feature class item is taken from the item: polygons have triangle indices,
+ * points have the only point.
+ * @param out Array to add items inside extent to.
+ */
+static void clipTileItem(const FlatVectorTileItem &item, const Envelope &env,
+                         OGRwkbGeometryType type, VectorTileItemArray &out)
+{
+    if(item.pointCount() == 0) {
+        return;
+    }
+    if(isMixedGeometry(type)) {
+        type = !item.indices().empty() ? wkbPolygon :
+                                         item.pointCount() == 1 ? wkbPoint :
+                                                                  wkbLineString;
+    }
+
+    Envelope itemExtent;
+    for(const auto &pt : item.points()) {
+        itemExtent.merge(Envelope(pt.x, pt.y, pt.x, pt.y));
+    }
+    if(!env.intersects(itemExtent)) {
+        return;
+    }
+    bool isPoint = type == wkbPoint || type == wkbMultiPoint;
+    bool isPolygon = type == wkbPolygon || type == wkbMultiPolygon;
+    if(isPoint || env.contains(itemExtent) ||
+            (isPolygon && item.borderCount() == 0)) {
+        out.push_back(VectorTileItem(item));
+        return;
+    }
+
+    VectorTileItemArray parts;
+    if(isPolygon) {
+        std::vector<OGRRawPoint> clipped;
+        if(!clipRingByRect(itemRing(item, 0), env, clipped)) {
+            return;
+        }
+        std::vector<std::vector<SimplePoint>> rings;
+        rings.push_back(openRing(clipped));
+        double envArea = env.width() * env.height();
+        for(size_t ring = 1; ring < item.borderCount(); ++ring) {
+            if(!clipRingByRect(itemRing(item, ring), env, clipped)) {
+                continue; // Hole is out of rectangle
+            }
+            std::vector<SimplePoint> hole = openRing(clipped);
+            double area = 0.0;
+            for(size_t i = 0; i < hole.size(); ++i) {
+                const SimplePoint &pt1 = hole[i];
+                const SimplePoint &pt2 = hole[(i + 1) % hole.size()];
+                area += static_cast<double>(pt1.x) * pt2.y -
+                        static_cast<double>(pt2.x) * pt1.y;
+            }
+            if(std::fabs(std::fabs(area) * 0.5 - envArea) <= envArea * 1e-6) {
+                return; // Rectangle is inside the hole
+            }
+            rings.emplace_back(hole);
+        }
+        if(rings[0].size() < 3) {
+            return;
+        }
+        if(item.ids().empty()) {
+            return;
+        }
+        fillPolygonTile(item.ids()[0], rings, parts);
+    }
+    else {
+        std::vector<OGRRawPoint> line;
+        line.reserve(item.pointCount());
+        for(const auto &pt : item.points()) {
+            line.push_back(OGRRawPoint(pt.x, pt.y));
+        }
+        std::vector<std::vector<OGRRawPoint>> lines;
+        clipLineByRect(line, env, lines);
+        for(const auto &linePart : lines) {
+            VectorTileItem part;
+            part.addPoints(linePart);
+            part.setValid(true);
+            parts.push_back(std::move(part));
+        }
+    }
+
+    if(parts.empty()) {
+        return;
+    }
+    TileAttributesPtr attributes = VectorTileItem(item).attributes();
+    for(auto &part : parts) {
+        for(GIntBig id : item.ids()) {
+            part.addId(id);
+        }
+        part.setAttributes(attributes);
+        out.push_back(std::move(part));
+    }
+}
+
+static std::string zoomLevelsString(const std::set<unsigned char> &zoomLevels)
+{
+    std::string out;
+    for(unsigned char zoomLevel : zoomLevels) {
+        if(!out.empty()) {
+            out += ",";
+        }
+        out += std::to_string(zoomLevel);
+    }
+    return out;
+}
+
+static size_t tileItemsSize(const VectorTileItemArray &items)
+{
+    size_t size = 0;
+    for(const auto &item : items) {
+        size += OVR_ITEM_OVERHEAD + item.pointCount() * sizeof(SimplePoint) +
+                item.indices().size() * sizeof(unsigned short);
+        for(const auto &border : item.borderIndices()) {
+            size += border.size() * sizeof(unsigned short);
+        }
+    }
+    return size;
+}
+
+static void setItemsAttributes(VectorTileItemArray &items,
+                               const TileAttributesPtr &attributes)
+{
+    if(!attributes) {
+        return;
+    }
+    for(VectorTileItem &item : items) {
+        item.setAttributes(attributes);
+    }
+}
 
 //------------------------------------------------------------------------------
 // TilingData
@@ -37,14 +326,117 @@ constexpr double WORLD_WIDTH = DEFAULT_BOUNDS_X2.width();
 
 class TilingData : public ThreadData {
 public:
-    TilingData(FeatureClassOverview *featureClass, FeaturePtr feature, bool own) :
-        ThreadData(own), m_feature(feature), m_featureClass(featureClass) {
-
+    TilingData(FeatureClassOverview *featureClass, bool own) :
+        ThreadData(own), m_featureClass(featureClass) {
+        m_features.reserve(TILING_BATCH_SIZE);
     }
-    FeaturePtr m_feature;
+    std::vector<FeaturePtr> m_features;
     FeatureClassOverview *m_featureClass;
 };
 
+//------------------------------------------------------------------------------
+// TileSaveData
+//------------------------------------------------------------------------------
+
+class TileSaveData : public ThreadData {
+public:
+    TileSaveData(OGRLayer *ovrTable, DataStore *dataStore, bool own) :
+        ThreadData(own), m_ovrTable(ovrTable), m_dataStore(dataStore) {
+        m_tiles.reserve(SAVE_BATCH_SIZE);
+    }
+    std::vector<std::pair<Tile, BufferPtr>> m_tiles;
+    OGRLayer *m_ovrTable;
+    DataStore *m_dataStore;
+};
+
+//------------------------------------------------------------------------------
+// TileRunReader
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The TileRunReader class Reads the tiles run file written by
+ * FeatureClassOverview::spillTiles. Each record is tile key, tile, blob size
+ * and blob, records go in tile key order.
+ */
+class TileRunReader
+{
+public:
+    explicit TileRunReader(const std::string &path) :
+        m_fp(VSIFOpenL(path.c_str(), "rb")), m_key(0) {
+        m_tile = { 0, 0, 0, 0 };
+    }
+    ~TileRunReader() {
+        if(nullptr != m_fp) {
+            VSIFCloseL(m_fp);
+        }
+    }
+    TileRunReader(const TileRunReader &) = delete;
+    TileRunReader &operator=(const TileRunReader &) = delete;
+
+    bool next() {
+        GUInt32 size = 0;
+        GInt32 x = 0, y = 0;
+        GByte z = 0, crossExtent = 0;
+        if(nullptr == m_fp ||
+                VSIFReadL(&m_key, sizeof(m_key), 1, m_fp) != 1 ||
+                VSIFReadL(&x, sizeof(x), 1, m_fp) != 1 ||
+                VSIFReadL(&y, sizeof(y), 1, m_fp) != 1 ||
+                VSIFReadL(&z, sizeof(z), 1, m_fp) != 1 ||
+                VSIFReadL(&crossExtent, sizeof(crossExtent), 1, m_fp) != 1 ||
+                VSIFReadL(&size, sizeof(size), 1, m_fp) != 1) {
+            return false;
+        }
+        m_tile = { x, y, z, static_cast<char>(crossExtent) };
+        m_data.resize(size);
+        return 0 == size || VSIFReadL(m_data.data(), size, 1, m_fp) == 1;
+    }
+    GIntBig key() const { return m_key; }
+    const Tile &tile() const { return m_tile; }
+    bool load(VectorTile &vtile) {
+        Buffer buffer(m_data.data(), static_cast<int>(m_data.size()), false);
+        return vtile.load(buffer);
+    }
+
+private:
+    VSILFILE *m_fp;
+    GIntBig m_key;
+    Tile m_tile;
+    std::vector<GByte> m_data;
+};
+
+static bool writeTileRecord(VSILFILE *fp, GIntBig key, const Tile &tile,
+                            const Buffer &data)
+{
+    GInt32 x = tile.x, y = tile.y;
+    GByte z = tile.z, crossExtent = static_cast<GByte>(tile.crossExtent);
+    GUInt32 size = static_cast<GUInt32>(data.size());
+    return VSIFWriteL(&key, sizeof(key), 1, fp) == 1 &&
+            VSIFWriteL(&x, sizeof(x), 1, fp) == 1 &&
+            VSIFWriteL(&y, sizeof(y), 1, fp) == 1 &&
+            VSIFWriteL(&z, sizeof(z), 1, fp) == 1 &&
+            VSIFWriteL(&crossExtent, sizeof(crossExtent), 1, fp) == 1 &&
+            VSIFWriteL(&size, sizeof(size), 1, fp) == 1 &&
+            (0 == size || VSIFWriteL(data.data(), size, 1, fp) == 1);
+}
+
+/**
+ * @brief The OverviewsReadHolder class Counts tile readers, so the overviews
+ * table swap waits for them.
+ */
+class OverviewsReadHolder
+{
+public:
+    explicit OverviewsReadHolder(std::atomic<int> &readers) : m_readers(readers) {
+        ++m_readers;
+    }
+    ~OverviewsReadHolder() {
+        --m_readers;
+    }
+
+private:
+    std::atomic<int> &m_readers;
+};
+
 //------------------------------------------------------------------------------
 // FeatureClass
 //------------------------------------------------------------------------------
@@ -55,15 +447,101 @@ FeatureClassOverview::FeatureClassOverview(OGRLayer *layer,
                                            const std::string &name) :
     FeatureClass(layer, parent, type, name),
     m_ovrTable(nullptr),
-    m_creatingOvr(false)
+    m_dpMaxZoom(-1),
+    m_clusterRadius(0),
+    m_clusterMaxZoom(-1),
+    m_tileCompression(TileCompression::NONE),
+    m_tileFormat(TileFormat::NATIVE),
+    m_creatingOvr(false),
+    m_readyLevels(0),
+    m_shadowBuild(false),
+    m_tilesVersion(1),
+    m_lastTileVersion(1),
+    m_shardBudget(0),
+    m_runTileCount(0),
+    m_rebuildThread(nullptr),
+    m_stopRebuild(false),
+    m_rebuilding(false),
+    m_swappingOvr(false),
+    m_ovrReaders(0)
 {
     if(nullptr != m_layer) {
         fillZoomLevels();
+        fillTileColumns();
+        m_dpMaxZoom = atoi(property(DP_MAX_ZOOM_KEY, "-1",
+                                    NG_ADDITIONS_KEY).c_str());
+        m_tileCompression = tileCompressionFromString(
+                    property(TILE_COMPRESSION_KEY, "NONE", NG_ADDITIONS_KEY));
+        m_tileFormat = tileFormatFromString(
+                    property(TILE_FORMAT_KEY, "NATIVE", NG_ADDITIONS_KEY));
+        m_clusterRadius = atoi(property(CLUSTER_RADIUS_KEY, "0",
+                                        NG_ADDITIONS_KEY).c_str());
+        m_clusterMaxZoom = atoi(property(CLUSTER_MAX_ZOOM_KEY, "-1",
+                                         NG_ADDITIONS_KEY).c_str());
     }
 
     hasTilesTable();
 }
 
+FeatureClassOverview::~FeatureClassOverview()
+{
+    stopRebuild();
+    TileCache::instance().release(this);
+}
+
+/**
+ * @brief FeatureClassOverview::copyFeatures Copy features from source feature
+ * class. Overviews are not updated per feature in batch operation, so if
+ * overviews exist and DEFER_INDEXES option is true, overviews are built again
+ * in one pass after copy.
+ */
+int FeatureClassOverview::copyFeatures(const FeatureClassPtr srcFClass,
+                                       const FieldMapPtr fieldMap,
+                                       OGRwkbGeometryType filterGeomType,
+                                       const Progress &progress,
+                                       const Options &options)
+{
+    DataStore *parentDS = dynamic_cast<DataStore*>(m_parent);
+    bool rebuildOvr = nullptr != parentDS &&
+            options.asBool("DEFER_INDEXES", false) && hasOverviews();
+
+    int result = FeatureClass::copyFeatures(srcFClass, fieldMap,
+                                            filterGeomType, progress, options);
+
+    if(rebuildOvr) {
+        Options ovrOptions(options);
+        ovrOptions.add("FORCE", true);
+        if(options.asString(ZOOM_LEVELS_OPTION, "").empty()) {
+            ovrOptions.add(ZOOM_LEVELS_OPTION,
+                           property("zoom_levels", "", NG_ADDITIONS_KEY));
+        }
+        if(options.asString(DP_MAX_ZOOM_OPTION, "").empty()) {
+            ovrOptions.add(DP_MAX_ZOOM_OPTION, std::to_string(m_dpMaxZoom));
+        }
+        if(options.asString(TILE_COMPRESSION_OPTION, "").empty()) {
+            ovrOptions.add(TILE_COMPRESSION_OPTION,
+                           tileCompressionToString(m_tileCompression));
+        }
+        if(options.asString(TILE_FORMAT_OPTION, "").empty()) {
+            ovrOptions.add(TILE_FORMAT_OPTION, tileFormatToString(m_tileFormat));
+        }
+        if(options.asString(TILE_ATTRIBUTES_OPTION, "").empty()) {
+            ovrOptions.add(TILE_ATTRIBUTES_OPTION,
+                           property(TILE_ATTRIBUTES_KEY, "", NG_ADDITIONS_KEY));
+        }
+        if(options.asString(CLUSTER_RADIUS_OPTION, "").empty()) {
+            ovrOptions.add(CLUSTER_RADIUS_OPTION, std::to_string(m_clusterRadius));
+            ovrOptions.add(CLUSTER_MAX_ZOOM_OPTION,
+                           std::to_string(m_clusterMaxZoom));
+        }
+        if(!createOverviews(progress, ovrOptions)) {
+            warningMessage(_("Failed to rebuild overviews of '%s'"),
+                           name().c_str());
+        }
+    }
+    return result;
+}
+
 bool FeatureClassOverview::onRowsCopied(const TablePtr srcTable,
                                         const Progress &progress,
                                         const Options &options)
@@ -107,6 +585,25 @@ double FeatureClassOverview::pixelSize(int zoom, bool precize)
     return WORLD_WIDTH / sizeOneDimPixels;
 }
 
+/**
+ * @brief FeatureClassOverview::tileKey Overview tile row identifier. Zoom
+ * level is in high bits and x, y bits are interleaved (Morton order) below, so
+ * rows of one zoom level go together and tiles close on map are close in the
+ * table.
+ * @param tile Tile of zoom level up to 29.
+ * @return Tile key.
+ */
+GIntBig FeatureClassOverview::tileKey(const Tile &tile)
+{
+    GUIntBig code = 0;
+    for(unsigned char bit = 0; bit < tile.z; ++bit) {
+        code |= static_cast<GUIntBig>((tile.x >> bit) & 1) << (2 * bit);
+        code |= static_cast<GUIntBig>((tile.y >> bit) & 1) << (2 * bit + 1);
+    }
+    return static_cast<GIntBig>(
+                (static_cast<GUIntBig>(tile.z) << OVR_KEY_ZOOM_SHIFT) | code);
+}
+
 bool FeatureClassOverview::hasTilesTable()
 {
     if(m_ovrTable) {
@@ -132,32 +629,145 @@ FeaturePtr FeatureClassOverview::getTileFeature(const Tile &tile)
         return FeaturePtr();
     }
 
-    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    // Read from pool connection not to wait writers
+    DatasetReadConnectionHolder holder(dynamic_cast<Dataset*>(m_parent));
+    OGRLayer *ovrTable = m_ovrTable;
+    if(nullptr != holder.connection()) {
+        ovrTable = holder.connection()->GetLayerByName(m_ovrTable->GetName());
+        if(nullptr == ovrTable) {
+            return FeaturePtr();
+        }
+    }
+
+    DataStore * const dataStore = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr != dataStore && dataStore->overviewsTileKeys()) {
+        return FeaturePtr(ovrTable->GetFeature(tileKey(tile)));
+    }
 
-    m_ovrTable->SetAttributeFilter(CPLSPrintf("%s = %d AND %s = %d AND %s = %d",
-                                              OVR_X_KEY, tile.x,
-                                              OVR_Y_KEY, tile.y,
-                                              OVR_ZOOM_KEY, tile.z));
-    FeaturePtr out(m_ovrTable->GetNextFeature());
-    m_ovrTable->SetAttributeFilter(nullptr);
+    ovrTable->SetAttributeFilter(CPLSPrintf("%s = %d AND %s = %d AND %s = %d",
+                                            OVR_X_KEY, tile.x,
+                                            OVR_Y_KEY, tile.y,
+                                            OVR_ZOOM_KEY, tile.z));
+    FeaturePtr out(ovrTable->GetNextFeature());
+    ovrTable->SetAttributeFilter(nullptr);
 
     return out;
 }
 
-VectorTile FeatureClassOverview::getTileInternal(const Tile &tile)
+FlatVectorTile FeatureClassOverview::getTileInternal(const Tile &tile)
 {
-    VectorTile vtile;
-    FeaturePtr ovrTile = getTileFeature(tile);
+    return tileFromFeature(tile, getTileFeature(tile));
+}
+
+/**
+ * @brief FeatureClassOverview::tileFromFeature Read tile items from the
+ * overviews table row.
+ * @param tile Tile of the row.
+ * @param ovrTile Overviews table row or empty pointer.
+ * @return Tile items.
+ */
+FlatVectorTile FeatureClassOverview::tileFromFeature(const Tile &tile,
+                                                     const FeaturePtr &ovrTile) const
+{
+    FlatVectorTile vtile;
     if(ovrTile) {
         int size = 0;
         GByte *data = ovrTile->GetFieldAsBinary(ovrTile->GetFieldIndex(OVR_TILE_KEY),
                                                 &size);
-        Buffer buff(data, size, false);
-        vtile.load(buff);
+        if(TileFormat::MVT == m_tileFormat) {
+            VectorTile decoded;
+            decodeTile(tile, data, static_cast<size_t>(size), decoded);
+            return FlatVectorTile(decoded);
+        }
+        // Read tile in place, the feature holds the blob memory
+        if(!vtile.attach(data, static_cast<size_t>(size), ovrTile)) {
+            BufferPtr raw = decompressTileBlob(data, static_cast<size_t>(size));
+            if(raw) {
+                // The decompressed buffer holds the blob memory
+                if(!vtile.attach(raw->data(), static_cast<size_t>(raw->size()),
+                                 raw)) {
+                    vtile.load(*raw.get());
+                }
+            }
+            else {
+                Buffer buff(data, size, false);
+                vtile.load(buff);
+            }
+        }
     }
     return vtile;
 }
 
+/**
+ * @brief FeatureClassOverview::getParentLevelTile Get tile from the tile of
+ * coarser level, which contains it. Parent tile items are clipped by this
+ * tile extent. Tile items are in map coordinates, so no rescale is needed.
+ * @param tile Tile to get.
+ * @param level Generated zoom level less than tile zoom.
+ * @return Tile items.
+ */
+FlatVectorTile FeatureClassOverview::getParentLevelTile(const Tile &tile,
+                                                        unsigned char level)
+{
+    int shift = tile.z - level;
+    Tile parentTile = { tile.x >> shift, tile.y >> shift, level,
+                        tile.crossExtent };
+    if(!m_creatingOvr) {
+        flushDirtyTile(parentTile);
+    }
+    FlatVectorTile parent = getTileInternal(parentTile);
+
+    Envelope extent = tileExtent(tile);
+    extent.resize(TILE_RESIZE);
+    OGRwkbGeometryType type = OGR_GT_Flatten(geometryType());
+    VectorTileItemArray items;
+    for(auto it = parent.begin(); it != parent.end(); ++it) {
+        clipTileItem(*it, extent, type, items);
+    }
+    VectorTile vtile;
+    vtile.add(std::move(items));
+    return FlatVectorTile(vtile);
+}
+
+/**
+ * @brief FeatureClassOverview::getNearestLevelTile Get tile of zoom level
+ * without overviews from the nearest generated level. The coarser level is
+ * preferred, see getParentLevelTile. If there is no coarser level, tiles of
+ * the finer level, which this tile contains, are merged.
+ * @param tile Tile of zoom level without overviews.
+ * @return Tile items or empty tile if the finer level is too deep.
+ */
+FlatVectorTile FeatureClassOverview::getNearestLevelTile(const Tile &tile)
+{
+    auto upper = m_zoomLevels.upper_bound(tile.z);
+    if(upper != m_zoomLevels.begin()) {
+        return getParentLevelTile(tile, *std::prev(upper));
+    }
+
+    unsigned char level = *upper;
+    int shift = level - tile.z;
+    if(shift > OVR_MAX_MERGE_SHIFT) {
+        return FlatVectorTile();
+    }
+
+    VectorTile vtile;
+    int count = 1 << shift;
+    for(int x = 0; x < count; ++x) {
+        for(int y = 0; y < count; ++y) {
+            Tile childTile = { (tile.x << shift) + x, (tile.y << shift) + y,
+                               level, tile.crossExtent };
+            flushDirtyTile(childTile);
+            FlatVectorTile child = getTileInternal(childTile);
+            VectorTileItemArray items;
+            for(auto it = child.begin(); it != child.end(); ++it) {
+                items.push_back(VectorTileItem(*it));
+            }
+            vtile.add(std::move(items));
+        }
+    }
+    return FlatVectorTile(vtile);
+}
+
 bool FeatureClassOverview::setTileFeature(FeaturePtr tile)
 {
     if(!hasTilesTable()) {
@@ -178,50 +788,454 @@ bool FeatureClassOverview::createTileFeature(FeaturePtr tile)
     return m_ovrTable->CreateFeature(tile) == OGRERR_NONE;
 }
 
+/**
+ * @brief geometryFitsTile Check if geometry lies inside the only tile of zoom
+ * level, so it needs no clipping on this level.
+ * @param items Tiles of geometry extent.
+ * @param extent Geometry extent.
+ * @return True if no clipping is needed.
+ */
+static bool geometryFitsTile(const std::vector<TileItem> &items,
+                             const Envelope &extent)
+{
+    if(items.size() != 1) {
+        return false;
+    }
+    Envelope ext = items.front().env;
+    ext.resize(TILE_RESIZE);
+    return ext.contains(extent);
+}
+
 bool FeatureClassOverview::tilingDataJobThreadFunc(ThreadData *threadData)
 {
     TilingData *data = static_cast<TilingData*>(threadData);
-    // Get tiles for geometry
-    OGRGeometry *geom = data->m_feature->GetGeometryRef();
-    if(nullptr == geom) {
-        return true;
+    FeatureClassOverview *featureClass = data->m_featureClass;
+    const auto &zoomLevels = featureClass->m_tilingLevels;
+
+    // Tiles go to the worker shard, no lock per tile
+    TilingShard *shard = featureClass->takeShard();
+    for(const FeaturePtr &feature : data->m_features) {
+        // Get tiles for geometry
+        OGRGeometry *geom = feature->GetGeometryRef();
+        if(nullptr == geom) {
+            continue;
+        }
+
+        // GEOS geometry is created only if some tile needs clipping
+        GEOSGeometryPtr geosGeom;
+        GIntBig fid = feature->GetFID();
+        TileAttributesPtr attributes = featureClass->tileAttributes(feature);
+
+        OGREnvelope env;
+        geom->getEnvelope(&env);
+        Envelope geomExtent = env;
+        bool precisePixelSize = !(OGR_GT_Flatten(geom->getGeometryType()) == wkbPoint ||
+                                  OGR_GT_Flatten(geom->getGeometryType()) == wkbMultiPoint);
+
+        // Geometry clipped on the last level is simplified once with its
+        // step. Coarser levels simplify this output instead of the full
+        // geometry and the pieces are clipped from it.
+        unsigned char lastZoom = *zoomLevels.rbegin();
+        std::vector<TileItem> lastItems = MapTransform::getTilesForExtent(
+                    extraExtentForZoom(lastZoom, env), lastZoom, false, true);
+        if(precisePixelSize && !geometryFitsTile(lastItems, geomExtent)) {
+            geosGeom = GEOSGeometryPtr(new GEOSGeometryWrap(geom));
+            geosGeom->simplify(FeatureClassOverview::pixelSize(lastZoom, true),
+                               featureClass->simplifyType(lastZoom));
+        }
+
+        // Go from small to large scale. Each tile is clipped from the piece
+        // of its parent tile on the previous zoom level. So the full geometry
+        // is clipped only on the first zoom level, the deeper levels clip
+        // small pieces.
+        std::map<Tile, TilePiece> parentPieces;
+        unsigned char parentZoom = 0;
+        for(unsigned char zoomLevel : zoomLevels) {
+            bool lastLevel = zoomLevel == lastZoom;
+            std::vector<TileItem> items = lastLevel ? std::move(lastItems) :
+                MapTransform::getTilesForExtent(
+                        extraExtentForZoom(zoomLevel, env), zoomLevel, false,
+                        true);
+
+            double step = FeatureClassOverview::pixelSize(zoomLevel, precisePixelSize);
+            auto simplifyType = featureClass->simplifyType(zoomLevel);
+            std::map<Tile, TilePiece> pieces;
+            for(auto tileItem : items) {
+                Envelope ext = tileItem.env;
+                ext.resize(TILE_RESIZE);
+
+                VectorTileItemArray vItems;
+                if(ext.contains(geomExtent)) {
+                    bool filled = false;
+                    if(geosGeom) {
+                        GEOSGeometryPtr tileGeom = geosGeom->clone();
+                        tileGeom->simplify(step, simplifyType);
+                        tileGeom->fillTile(fid, vItems);
+                        filled = true;
+                    }
+                    else {
+                        filled = fillTileFromOGR(fid, geom, step, simplifyType,
+                                                 vItems);
+                    }
+                    if(filled) {
+                        setItemsAttributes(vItems, attributes);
+                        shard->size += tileItemsSize(vItems);
+                        shard->tiles[tileItem.tile].add(std::move(vItems), true);
+                        continue;
+                    }
+                }
+
+                if(!geosGeom) {
+                    geosGeom = GEOSGeometryPtr(new GEOSGeometryWrap(geom));
+                }
+                GEOSGeometryPtr source = geosGeom;
+                if(!parentPieces.empty()) {
+                    int shift = zoomLevel - parentZoom;
+                    Tile parentTile = { tileItem.tile.x >> shift,
+                                        tileItem.tile.y >> shift, parentZoom,
+                                        tileItem.tile.crossExtent };
+                    auto parent = parentPieces.find(parentTile);
+                    if(parent != parentPieces.end() &&
+                            parent->second.extent.contains(ext)) {
+                        source = parent->second.geom;
+                    }
+                }
+
+                GEOSGeometryPtr piece = source->clip(ext);
+                if(!piece->isValid()) {
+                    continue;
+                }
+
+                GEOSGeometryPtr tileGeom = piece;
+                if(!lastLevel) {
+                    pieces[tileItem.tile] = { ext, piece };
+                    tileGeom = piece->clone();
+                }
+                tileGeom->simplify(step, simplifyType);
+                tileGeom->fillTile(fid, vItems);
+                setItemsAttributes(vItems, attributes);
+                shard->size += tileItemsSize(vItems);
+                shard->tiles[tileItem.tile].add(std::move(vItems), true);
+            }
+            parentPieces = std::move(pieces);
+            parentZoom = zoomLevel;
+        }
+        ScratchArena::threadArena().reset();
     }
 
-    GEOSGeometryPtr geosGeom(new GEOSGeometryWrap(geom));
-    GIntBig fid = data->m_feature->GetFID();
+    // Tiles over the worker budget go to the sorted run file
+    if(featureClass->m_shardBudget > 0 &&
+            shard->size > featureClass->m_shardBudget &&
+            featureClass->spillTiles(shard->tiles)) {
+        shard->size = 0;
+    }
+    featureClass->releaseShard(shard);
+    data->m_features.clear();
 
-    OGREnvelope env;
-    geom->getEnvelope(&env);
-    bool precisePixelSize = !(OGR_GT_Flatten(geom->getGeometryType()) == wkbPoint ||
-                              OGR_GT_Flatten(geom->getGeometryType()) == wkbMultiPoint);
+    return true;
+}
 
-    auto zoomLevels = data->m_featureClass->zoomLevels();
-    for(auto it = zoomLevels.rbegin(); it != zoomLevels.rend(); ++it) {
-        unsigned char zoomLevel = *it;
-        CPLDebug("ngstore", "tilingDataJobThreadFunc for zoom %d", zoomLevel);
-        Envelope extent = extraExtentForZoom(zoomLevel, env);
+bool FeatureClassOverview::tileSaveJobThreadFunc(ThreadData *threadData)
+{
+    TileSaveData *data = static_cast<TileSaveData*>(threadData);
+    OGRLayer *ovrTable = data->m_ovrTable;
+    bool transaction = data->m_dataStore->startOverviewsTransaction();
+    for(const auto &item : data->m_tiles) {
+        FeaturePtr newFeature = OGRFeature::CreateFeature(
+                    ovrTable->GetLayerDefn());
 
-        std::vector<TileItem> items = MapTransform::getTilesForExtent(
-                    extent, zoomLevel, false, true);
+        newFeature->SetFID(tileKey(item.first));
+        newFeature->SetField(OVR_ZOOM_KEY, item.first.z);
+        newFeature->SetField(OVR_X_KEY, item.first.x);
+        newFeature->SetField(OVR_Y_KEY, item.first.y);
+        newFeature->SetField(newFeature->GetFieldIndex(OVR_TILE_KEY),
+                             item.second->size(), item.second->data());
 
-        double step = FeatureClassOverview::pixelSize(zoomLevel, precisePixelSize);
-        geosGeom->simplify(step);
-        for(auto tileItem : items) {
-            Envelope ext = tileItem.env;
-            ext.resize(TILE_RESIZE);
+        if(ovrTable->CreateFeature(newFeature) != OGRERR_NONE) {
+            outMessage(COD_INSERT_FAILED, _("Failed to create feature"));
+        }
+    }
+
+    if(transaction && !data->m_dataStore->commitOverviewsTransaction()) {
+        outMessage(COD_INSERT_FAILED, _("Failed to save tiles. %s"),
+                   CPLGetLastErrorMsg());
+    }
+    data->m_tiles.clear();
 
-            auto vItems = data->m_featureClass->tileGeometry(fid, geosGeom, ext);
-            data->m_featureClass->addOverviewItem(tileItem.tile, vItems);
+    return true;
+}
+
+FeatureClassOverview::TilingShard *FeatureClassOverview::takeShard()
+{
+    SpinLockHolder holder(m_genTileMutex);
+    if(m_freeShards.empty()) {
+        m_shards.emplace_back(TilingShardPtr(new TilingShard));
+        m_shards.back()->size = 0;
+        return m_shards.back().get();
+    }
+    TilingShard *shard = m_freeShards.back();
+    m_freeShards.pop_back();
+    return shard;
+}
+
+void FeatureClassOverview::releaseShard(TilingShard *shard)
+{
+    SpinLockHolder holder(m_genTileMutex);
+    m_freeShards.push_back(shard);
+}
+
+void FeatureClassOverview::mergeShards()
+{
+    m_freeShards.clear();
+    for(const TilingShardPtr &shard : m_shards) {
+        auto it = shard->tiles.begin();
+        while(it != shard->tiles.end()) {
+            auto genIt = m_genTiles.find(it->first);
+            if(genIt == m_genTiles.end()) {
+                m_genTiles.insert(std::make_pair(it->first,
+                                                 std::move(it->second)));
+            }
+            else {
+                genIt->second.add(std::move(it->second), true);
+            }
+            it = shard->tiles.erase(it);
         }
     }
+    m_shards.clear();
+}
 
+/**
+ * @brief FeatureClassOverview::spillTiles Write generated tiles to the new run
+ * file in tile key order and free them. Items are stored not quantized, as
+ * the tiles of several runs are merged before encoding.
+ * @param tiles Tiles to write.
+ * @return True on success, else tiles stay in memory.
+ */
+bool FeatureClassOverview::spillTiles(TileMap &tiles)
+{
+    std::vector<std::pair<GIntBig, TileMap::iterator>> keys;
+    keys.reserve(tiles.size());
+    for(auto it = tiles.begin(); it != tiles.end(); ++it) {
+        keys.push_back(std::make_pair(tileKey(it->first), it));
+    }
+    std::sort(keys.begin(), keys.end(),
+              [](const std::pair<GIntBig, TileMap::iterator> &a,
+                 const std::pair<GIntBig, TileMap::iterator> &b) {
+                  return a.first < b.first; });
+
+    std::string path;
+    {
+        SpinLockHolder holder(m_genTileMutex);
+        path = CPLSPrintf("%s_%d.%s", m_runPrefix.c_str(),
+                          static_cast<int>(m_runFiles.size()), OVR_RUN_EXT);
+        m_runFiles.push_back(path);
+    }
+
+    VSILFILE *fp = VSIFOpenL(path.c_str(), "wb");
+    if(nullptr == fp) {
+        return errorMessage(_("Failed to create file %s"), path.c_str());
+    }
+    bool result = true;
+    for(const auto &key : keys) {
+        BufferPtr data = key.second->second.save(false);
+        if(!writeTileRecord(fp, key.first, key.second->first, *data)) {
+            result = false;
+            break;
+        }
+    }
+    VSIFCloseL(fp);
+    if(!result) {
+        // The run is read up to the failed record, so it must be empty
+        VSIUnlink(path.c_str());
+        fp = VSIFOpenL(path.c_str(), "wb");
+        if(nullptr != fp) {
+            VSIFCloseL(fp);
+        }
+        return errorMessage(_("Failed to write file %s"), path.c_str());
+    }
+
+    m_runTileCount += tiles.size();
+    tiles.clear();
     return true;
 }
 
+void FeatureClassOverview::removeTileRuns()
+{
+    for(const std::string &path : m_runFiles) {
+        VSIUnlink(path.c_str());
+    }
+    m_runFiles.clear();
+    m_runTileCount = 0;
+}
+
+/**
+ * @brief FeatureClassOverview::estimateOverviews Recommend overview zoom levels
+ * for the feature class data. Overviews are needed on zoom levels where tiles
+ * have more vertices than can be tiled on the fly quickly. Features per tile
+ * are estimated from the number of distinct tiles of sampled features
+ * centers, or from the data extent if each sampled feature falls in its own
+ * tile. The deepest needed level and every OVR_LEVEL_STEP level above it down
+ * to the level where data extent fits one tile are recommended, getTile reads
+ * the zoom levels between them from the nearest level. Build time and size
+ * are measured by tiling the sampled features on recommended levels.
+ * @param cancel Token to stop the estimate.
+ * @return Recommended zoom levels with estimated tiling time and tiles size.
+ * Zoom levels are empty if the data can be tiled on the fly on all zooms.
+ */
+OverviewsEstimate FeatureClassOverview::estimateOverviews(
+        const CancelToken &cancel) const
+{
+    OverviewsEstimate out = { std::set<unsigned char>(), 0.0, 0 };
+    GIntBig count = featureCount();
+    Envelope dataExtent = extent();
+    if(count <= 0 || !dataExtent.isInit()) {
+        return out;
+    }
+
+    // Sample features evenly over the table
+    GIntBig stride = std::max(count / static_cast<GIntBig>(OVR_SAMPLE_COUNT),
+                              static_cast<GIntBig>(1));
+    GIntBig index = 0;
+    double vertices = 0.0;
+    std::vector<FeaturePtr> samples;
+    forEachFeature([&](const FeaturePtr &feature) {
+        if(cancel.isCanceled()) {
+            return false;
+        }
+        if(index++ % stride != 0 || nullptr == feature->GetGeometryRef()) {
+            return true;
+        }
+        vertices += vertexCount(feature->GetGeometryRef());
+        samples.push_back(feature);
+        return samples.size() < OVR_SAMPLE_COUNT;
+    });
+    if(samples.empty() || cancel.isCanceled()) {
+        return out;
+    }
+
+    double meanVertices = vertices / samples.size();
+    double dataSize = std::max(dataExtent.width(), dataExtent.height());
+    double dataArea = std::max(dataExtent.width() * dataExtent.height(),
+                               std::numeric_limits<double>::epsilon());
+    unsigned char minLevel = 0;
+    while(minLevel < OVR_MAX_ZOOM && tileSize(minLevel + 1) >= dataSize) {
+        minLevel++;
+    }
+
+    int maxLevel = -1;
+    for(int zoom = OVR_MAX_ZOOM; zoom >= minLevel; --zoom) {
+        double size = tileSize(static_cast<unsigned char>(zoom));
+        std::set<std::pair<GIntBig, GIntBig>> cells;
+        for(const FeaturePtr &feature : samples) {
+            OGREnvelope env;
+            feature->GetGeometryRef()->getEnvelope(&env);
+            double x = (env.MinX + env.MaxX) * 0.5 - DEFAULT_BOUNDS.minX();
+            double y = (env.MinY + env.MaxY) * 0.5 - DEFAULT_BOUNDS.minY();
+            cells.insert(std::make_pair(static_cast<GIntBig>(x / size),
+                                        static_cast<GIntBig>(y / size)));
+        }
+
+        double perTile = cells.size() < samples.size() ?
+                    static_cast<double>(count) / cells.size() :
+                    count * std::min(1.0, size * size / dataArea);
+        if(perTile * meanVertices > OVR_FLY_MAX_VERTICES) {
+            maxLevel = zoom;
+            break;
+        }
+    }
+
+    for(int zoom = maxLevel; zoom >= minLevel; zoom -= OVR_LEVEL_STEP) {
+        out.zoomLevels.insert(static_cast<unsigned char>(zoom));
+    }
+
+    // Tile the sample as createOverviews does and scale to all features
+    double scale = static_cast<double>(count) / samples.size();
+    double seconds = 0.0;
+    double bytes = 0.0;
+    for(unsigned char zoomLevel : out.zoomLevels) {
+        auto simplify = simplifyType(zoomLevel);
+        for(const FeaturePtr &feature : samples) {
+            if(cancel.isCanceled()) {
+                return out;
+            }
+
+            ScratchArenaScope scope;
+            auto start = std::chrono::steady_clock::now();
+            OGRGeometry *geom = feature->GetGeometryRef();
+            OGREnvelope env;
+            geom->getEnvelope(&env);
+            Envelope geomExtent = env;
+            bool precisePixelSize =
+                    !(OGR_GT_Flatten(geom->getGeometryType()) == wkbPoint ||
+                      OGR_GT_Flatten(geom->getGeometryType()) == wkbMultiPoint);
+            double step = pixelSize(zoomLevel, precisePixelSize);
+            std::vector<TileItem> tiles = MapTransform::getTilesForExtent(
+                        extraExtentForZoom(zoomLevel, env), zoomLevel, false,
+                        true);
+            size_t tileCount = std::min(tiles.size(), OVR_SAMPLE_MAX_TILES);
+            if(tileCount == 0) {
+                continue;
+            }
+
+            GEOSGeometryPtr geosGeom;
+            size_t featureBytes = 0;
+            for(size_t i = 0; i < tileCount; ++i) {
+                Envelope ext = tiles[i].env;
+                ext.resize(TILE_RESIZE);
+                VectorTileItemArray items;
+                if(!(ext.contains(geomExtent) &&
+                     fillTileFromOGR(feature->GetFID(), geom, step, simplify,
+                                     items))) {
+                    if(!geosGeom) {
+                        geosGeom = GEOSGeometryPtr(new GEOSGeometryWrap(geom));
+                    }
+                    GEOSGeometryPtr piece = geosGeom->clip(ext);
+                    if(!piece->isValid()) {
+                        continue;
+                    }
+                    piece->simplify(step, simplify);
+                    piece->fillTile(feature->GetFID(), items);
+                }
+                featureBytes += tileItemsSize(items);
+            }
+
+            double tilesScale = static_cast<double>(tiles.size()) / tileCount;
+            seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count() *
+                    tilesScale;
+            bytes += featureBytes * tilesScale;
+        }
+    }
+
+    out.buildTime = seconds * scale / getNumberThreads();
+    out.storageSize = static_cast<GIntBig>(bytes * scale);
+    return out;
+}
+
+/**
+ * @brief FeatureClassOverview::createOverviews Tile features to the overviews
+ * table. If the overviews exist and BACKGROUND option is true, they are
+ * rebuilt to the shadow table by the background thread and the function
+ * returns at once. Old tiles are drawn until the shadow table replaces them.
+ * @param progress Progress. In background rebuild it is executed from the
+ * rebuild thread.
+ * @param options Overviews options, see ngsFeatureClassCreateOverviews.
+ * @return True on success or if the background rebuild is started.
+ */
 bool FeatureClassOverview::createOverviews(const Progress &progress, const Options &options)
 {
     CPLDebug("ngstore", "start create overviews");
+    if(!m_shadowBuild) {
+        if(options.asBool(BACKGROUND_OPTION, false) && hasOverviews() &&
+                startRebuild(progress, options)) {
+            return true;
+        }
+        stopRebuild();
+    }
+
     m_genTiles.clear();
+    clearDirtyTiles();
+    TileCache::instance().remove(this);
     bool force = options.asBool("FORCE", false);
     if(!force && hasOverviews()) {
         return true;
@@ -234,108 +1248,533 @@ bool FeatureClassOverview::createOverviews(const Progress &progress, const Optio
         return errorMessage(_("Unsupported feature class"));
     }
 
-    if(nullptr == m_ovrTable) {
-        m_ovrTable = parentDS->getOverviewsTable(name());
-    }
+    // Tiles are read only from committed levels from here
+    m_readyLevels = 0;
+    m_creatingOvr = true;
 
-    if(nullptr == m_ovrTable) {
-        m_ovrTable = parentDS->createOverviewsTable(name());
-    }
-    else {
-        parentDS->clearOverviewsTable(name());
-    }
+    // Shadow table is empty
+    if(!m_shadowBuild) {
+        if(nullptr == m_ovrTable) {
+            m_ovrTable = parentDS->getOverviewsTable(name());
+        }
 
-    // Drop index
-    parentDS->dropOverviewsTableIndex(name());
+        if(nullptr == m_ovrTable) {
+            m_ovrTable = parentDS->createOverviewsTable(name());
+        }
+        else {
+            parentDS->clearOverviewsTable(name());
+        }
+    }
 
     // Fill overview layer with data
     std::string zoomLevelListStr = options.asString(ZOOM_LEVELS_OPTION, "");
+    if(compare(zoomLevelListStr, AUTO_ZOOM_LEVELS)) {
+        OverviewsEstimate estimate = estimateOverviews();
+        zoomLevelListStr = zoomLevelsString(estimate.zoomLevels);
+        CPLDebug("ngstore", "Overviews zoom levels of %s: %s, estimated %.1f s and %lld bytes",
+                 m_name.c_str(), zoomLevelListStr.c_str(), estimate.buildTime,
+                 static_cast<long long>(estimate.storageSize));
+        if(zoomLevelListStr.empty()) {
+            m_zoomLevels.clear();
+            if(!m_shadowBuild) {
+                setProperty("zoom_levels", "", NG_ADDITIONS_KEY);
+            }
+            m_creatingOvr = false;
+            return true;
+        }
+    }
     fillZoomLevels(zoomLevelListStr);
     if(m_zoomLevels.empty()) {
+        m_creatingOvr = false;
         return true;
     }
 
-    setProperty("zoom_levels", zoomLevelListStr, NG_ADDITIONS_KEY);
+    m_dpMaxZoom = options.asInt(DP_MAX_ZOOM_OPTION, -1);
+    m_tileCompression = tileCompressionFromString(
+                options.asString(TILE_COMPRESSION_OPTION, "NONE"));
+    if(!isTileCompressionAvailable(m_tileCompression)) {
+        warningMessage(_("Tile compression %s is not available, use DEFLATE"),
+                       tileCompressionToString(m_tileCompression));
+        m_tileCompression = TileCompression::DEFLATE;
+    }
+    m_tileFormat = tileFormatFromString(
+                options.asString(TILE_FORMAT_OPTION, "NATIVE"));
+    fillTileColumns(options.asString(TILE_ATTRIBUTES_OPTION, ""));
+
+    // Points are clustered on all overview zoom levels except the last by
+    // default
+    bool isPoint = OGR_GT_Flatten(geometryType()) == wkbPoint ||
+            OGR_GT_Flatten(geometryType()) == wkbMultiPoint;
+    m_clusterRadius = isPoint ? options.asInt(CLUSTER_RADIUS_OPTION, 0) : 0;
+    m_clusterMaxZoom = options.asInt(CLUSTER_MAX_ZOOM_OPTION, -1);
+    if(m_clusterMaxZoom < 0) {
+        m_clusterMaxZoom = *m_zoomLevels.rbegin() - 1;
+    }
+
+    // Each tiling worker keeps its part of the memory budget
+    int memoryBudget = options.asInt(MEMORY_BUDGET_OPTION,
+                                     OVR_DEFAULT_MEMORY_BUDGET);
+    m_shardBudget = memoryBudget > 0 ?
+                static_cast<size_t>(memoryBudget) * 1024 * 1024 /
+                static_cast<size_t>(getNumberThreads()) : 0;
+    m_runPrefix = CPLFormFilename(CPLGetPath(parentDS->path().c_str()),
+                                  CPLSPrintf("%s_%s", m_name.c_str(),
+                                             m_shadowBuild ? "rebuild" : "build"),
+                                  nullptr);
+
+    // Rebuild properties are saved with the swap
+    if(!m_shadowBuild) {
+        saveOverviewsProperties();
+    }
 
     // Tile and simplify geometry
     progress.onProgress(COD_IN_PROCESS, 0.0,
                         _("Start tiling and simplifying geometry"));
 
-    // Multithreaded thread pool
-    CPLDebug("ngstore", "fill pool create overviews");
-    ThreadPool threadPool;
-    threadPool.init(getNumberThreads(), tilingDataJobThreadFunc);
-    emptyFields(true);
-    reset();
-
-    FeaturePtr feature;
-    while((feature = nextFeature())) {
-        threadPool.addThreadData(new TilingData(this, feature, true));
+    // Levels are built and committed lowest first, so the layer is drawn
+    // from the committed levels while deeper ones are built. The first pass
+    // builds only the lowest level to show the layer as soon as possible.
+    // Next passes build several levels each, as the deeper level tiles are
+    // clipped from the pieces of the previous level in one pass.
+    std::vector<std::set<unsigned char>> passes;
+    for(unsigned char zoomLevel : m_zoomLevels) {
+        if(passes.size() < 2 || passes.back().size() >= OVR_PASS_LEVELS) {
+            passes.push_back(std::set<unsigned char>());
+        }
+        passes.back().insert(zoomLevel);
     }
 
     Progress newProgress(progress);
-    newProgress.setTotalSteps(2);
-    newProgress.setStep(0);
-    threadPool.waitComplete(newProgress);
-    threadPool.clearThreadData();
+    newProgress.setTotalSteps(static_cast<unsigned char>(passes.size() * 2));
+    unsigned char step = 0;
+    std::set<unsigned char> readyLevels;
+    for(const auto &passLevels : passes) {
+        m_tilingLevels = passLevels;
+
+        // Multithreaded thread pool
+        CPLDebug("ngstore", "fill pool create overviews");
+        ThreadPool threadPool;
+        threadPool.init(getNumberThreads(), tilingDataJobThreadFunc);
+        emptyFields(true);
+
+        TilingData *tilingData = nullptr;
+        forEachFeature([&](const FeaturePtr &feature) {
+            if(nullptr == tilingData) {
+                tilingData = new TilingData(this, true);
+            }
+            tilingData->m_features.push_back(feature);
+            if(tilingData->m_features.size() >= TILING_BATCH_SIZE) {
+                threadPool.addThreadData(tilingData);
+                tilingData = nullptr;
+            }
+            return true;
+        });
+        if(nullptr != tilingData) {
+            threadPool.addThreadData(tilingData);
+        }
 
-    emptyFields(false);
-    reset();
+        newProgress.setStep(step++);
+        threadPool.waitComplete(newProgress);
+        threadPool.clearThreadData();
+
+        emptyFields(false);
+        reset();
+
+        mergeShards();
+
+        newProgress.setStep(step++);
+        saveGeneratedTiles(parentDS, newProgress);
+
+        readyLevels.insert(passLevels.begin(), passLevels.end());
+        for(unsigned char zoomLevel : passLevels) {
+            m_readyLevels |= 1u << zoomLevel;
+        }
+        // Drop tiles tiled from the previous levels
+        TileCache::instance().remove(this);
+        if(!m_shadowBuild) {
+            Notify::instance().onNotify(fullName(),
+                                        ngsChangeCode::CC_CHANGE_OBJECT);
+        }
+
+        if(!progress.onProgress(COD_IN_PROCESS,
+                                static_cast<double>(step) / (passes.size() * 2),
+                                _("Zoom levels %s are ready"),
+                                zoomLevelsString(passLevels).c_str())) {
+            break;
+        }
+    }
+
+    // Canceled build keeps the committed levels. Canceled rebuild is dropped.
+    if(readyLevels.size() < m_zoomLevels.size()) {
+        m_zoomLevels = readyLevels;
+        if(!m_shadowBuild) {
+            setProperty("zoom_levels", zoomLevelsString(readyLevels),
+                        NG_ADDITIONS_KEY);
+        }
+    }
+
+    m_tilingLevels.clear();
+    resetTileVersions();
+    m_creatingOvr = false;
+    TileCache::instance().remove(this);
+
+    progress.onProgress(COD_FINISHED, 1.0,
+                        _("Finish tiling and simplifying geometry"));
+
+    CPLDebug("ngstore", "finish create overviews");
+    return true;
+}
+
+/**
+ * @brief FeatureClassOverview::saveGeneratedTiles Encode generated tiles and
+ * write them to the overviews table in one batch. Tiles are written by the
+ * writer thread in large transactions in tile key order, so the tiles of one
+ * zoom level close on map are stored in the same pages. The tiles in memory
+ * and the spilled runs are merged in one streaming pass, only one merged tile
+ * is kept at a time.
+ * @param parentDS Overviews table datastore.
+ * @param progress Progress of tiles save.
+ */
+void FeatureClassOverview::saveGeneratedTiles(DataStore *parentDS,
+                                              const Progress &progress)
+{
+    std::vector<std::pair<GIntBig, TileMap::iterator>> keys;
+    keys.reserve(m_genTiles.size());
+    for(auto it = m_genTiles.begin(); it != m_genTiles.end(); ++it) {
+        keys.push_back(std::make_pair(tileKey(it->first), it));
+    }
+    std::sort(keys.begin(), keys.end(),
+              [](const std::pair<GIntBig, TileMap::iterator> &a,
+                 const std::pair<GIntBig, TileMap::iterator> &b) {
+                  return a.first < b.first; });
 
-    // Save tiles
-    m_creatingOvr = true;
     parentDS->lockExecuteSql(true);
     parentDS->startBatchOperation();
 
-    CPLDebug("ngstore", "finish create overviews");
-    double counter = 0.0;
-    newProgress.setStep(1);
-    for(auto item : m_genTiles) {
-        if(!item.second.isValid() || item.second.empty()) {
-            continue;
+    // Run readers ordered by the current record key
+    std::vector<std::unique_ptr<TileRunReader>> runs;
+    using RunKey = std::pair<GIntBig, size_t>;
+    std::priority_queue<RunKey, std::vector<RunKey>, std::greater<RunKey>> runKeys;
+    for(const std::string &path : m_runFiles) {
+        runs.emplace_back(new TileRunReader(path));
+        if(runs.back()->next()) {
+            runKeys.push(std::make_pair(runs.back()->key(), runs.size() - 1));
         }
-        BufferPtr data = item.second.save();
-
-        FeaturePtr newFeature = OGRFeature::CreateFeature(
-                    m_ovrTable->GetLayerDefn() );
+    }
 
-        newFeature->SetField(OVR_ZOOM_KEY, item.first.z);
-        newFeature->SetField(OVR_X_KEY, item.first.x);
-        newFeature->SetField(OVR_Y_KEY, item.first.y);
-        newFeature->SetField(newFeature->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                          data->data());
+    ThreadPool writerPool;
+    writerPool.init(1, tileSaveJobThreadFunc);
+    TileSaveData *saveData = nullptr;
+    double counter = 0.0;
+    double total = m_genTiles.size() + m_runTileCount;
+    auto keyIt = keys.begin();
+    while(keyIt != keys.end() || !runKeys.empty()) {
+        GIntBig key = keyIt != keys.end() ? keyIt->first :
+                                            std::numeric_limits<GIntBig>::max();
+        if(!runKeys.empty()) {
+            key = std::min(key, runKeys.top().first);
+        }
 
-//        CPLDebug("ngstore", "Tile size to store %d", data->size());
+        Tile tile;
+        VectorTile vtile;
+        if(keyIt != keys.end() && keyIt->first == key) {
+            tile = keyIt->second->first;
+            vtile = std::move(keyIt->second->second);
+            m_genTiles.erase(keyIt->second);
+            ++keyIt;
+            counter++;
+        }
+        while(!runKeys.empty() && runKeys.top().first == key) {
+            size_t runIndex = runKeys.top().second;
+            TileRunReader *run = runs[runIndex].get();
+            runKeys.pop();
+            tile = run->tile();
+            VectorTile part;
+            if(run->load(part)) {
+                vtile.add(std::move(part), true);
+            }
+            if(run->next()) {
+                runKeys.push(std::make_pair(run->key(), runIndex));
+            }
+            counter++;
+        }
 
-        if(m_ovrTable->CreateFeature(newFeature) != OGRERR_NONE) {
-            outMessage(COD_INSERT_FAILED, _("Failed to create feature"));
+        clusterTile(tile, vtile);
+        if(vtile.isValid() && !vtile.empty()) {
+            BufferPtr data = encodeTile(tile, vtile);
+            if(data) {
+                if(nullptr == saveData) {
+                    saveData = new TileSaveData(m_ovrTable, parentDS, true);
+                }
+                saveData->m_tiles.push_back(std::make_pair(tile, data));
+                if(saveData->m_tiles.size() >= SAVE_BATCH_SIZE) {
+                    writerPool.addThreadData(saveData);
+                    saveData = nullptr;
+                }
+            }
         }
 
-        newProgress.onProgress(COD_IN_PROCESS, counter/m_genTiles.size(),
-                               _("Save tiles ..."));
-        counter++;
+        progress.onProgress(COD_IN_PROCESS, counter/total, _("Save tiles ..."));
+    }
+    runs.clear();
+    removeTileRuns();
+    if(nullptr != saveData) {
+        writerPool.addThreadData(saveData);
     }
+    writerPool.waitComplete(Progress());
 
     parentDS->stopBatchOperation();
     m_genTiles.clear();
+    parentDS->lockExecuteSql(false);
+}
+
+void FeatureClassOverview::saveOverviewsProperties()
+{
+    std::string tileAttributes;
+    if(m_tileColumns) {
+        for(const auto &column : *m_tileColumns) {
+            if(!tileAttributes.empty()) {
+                tileAttributes += ",";
+            }
+            tileAttributes += column.name;
+        }
+    }
 
-    // Create index
-    parentDS->createOverviewsTableIndex(name());
+    setProperty("zoom_levels", zoomLevelsString(m_zoomLevels), NG_ADDITIONS_KEY);
+    setProperty(DP_MAX_ZOOM_KEY, std::to_string(m_dpMaxZoom), NG_ADDITIONS_KEY);
+    setProperty(TILE_COMPRESSION_KEY,
+                tileCompressionToString(m_tileCompression), NG_ADDITIONS_KEY);
+    setProperty(TILE_FORMAT_KEY, tileFormatToString(m_tileFormat),
+                NG_ADDITIONS_KEY);
+    setProperty(TILE_ATTRIBUTES_KEY, tileAttributes, NG_ADDITIONS_KEY);
+    setProperty(CLUSTER_RADIUS_KEY, std::to_string(m_clusterRadius),
+                NG_ADDITIONS_KEY);
+    setProperty(CLUSTER_MAX_ZOOM_KEY, std::to_string(m_clusterMaxZoom),
+                NG_ADDITIONS_KEY);
+}
+
+/**
+ * @brief FeatureClassOverview::startRebuild Start overviews rebuild by the
+ * background thread. Features are tiled by other instance of this class,
+ * which reads own pool connection and writes to the shadow overviews table.
+ * The running rebuild is canceled.
+ * @param progress Progress executed from the rebuild thread.
+ * @param options Overviews options.
+ * @return False if no pool connection is available, the overviews should be
+ * created in place then.
+ */
+bool FeatureClassOverview::startRebuild(const Progress &progress,
+                                        const Options &options)
+{
+    stopRebuild();
+
+    DataStore * const parentDS = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr == parentDS || nullptr == m_layer) {
+        return false;
+    }
+
+    m_rebuildConnection = parentDS->acquireReadConnection();
+    if(!m_rebuildConnection) {
+        CPLDebug("ngstore", "No read connection to rebuild overviews of %s",
+                 m_name.c_str());
+        return false;
+    }
+
+    m_rebuildProgress = progress;
+    m_rebuildOptions = options;
+    m_rebuildOptions.add("FORCE", true);
+    m_stopRebuild = false;
+    m_dirtyTilesMutex.acquire();
+    m_rebuilding = true;
+    m_rebuildChanges.clear();
+    m_dirtyTilesMutex.release();
+
+    m_rebuildThread = CPLCreateJoinableThread(rebuildThread, this);
+    if(nullptr == m_rebuildThread) {
+        m_dirtyTilesMutex.acquire();
+        m_rebuilding = false;
+        m_dirtyTilesMutex.release();
+        parentDS->releaseReadConnection(m_rebuildConnection);
+        m_rebuildConnection.reset();
+        return false;
+    }
+    return true;
+}
+
+void FeatureClassOverview::stopRebuild()
+{
+    if(nullptr == m_rebuildThread) {
+        return;
+    }
+
+    m_stopRebuild = true;
+    CPLJoinThread(m_rebuildThread);
+    m_rebuildThread = nullptr;
+}
+
+void FeatureClassOverview::rebuildThread(void *data)
+{
+    FeatureClassOverview *featureClass = static_cast<FeatureClassOverview*>(data);
+    // Counted as CPU worker, but is not delayed by the cap
+    WorkerSlots slot(WorkerClass::BACKGROUND, 1, true);
+    featureClass->rebuildOverviews();
+}
+
+/**
+ * @brief FeatureClassOverview::rebuildProgressFunc Pass rebuild progress to the
+ * caller progress. The finish is reported after the swap.
+ * @return 0 if the rebuild is canceled.
+ */
+int FeatureClassOverview::rebuildProgressFunc(enum ngsCode status,
+                                              double complete,
+                                              const char *message,
+                                              void *progressArguments)
+{
+    FeatureClassOverview *featureClass =
+            static_cast<FeatureClassOverview*>(progressArguments);
+    if(featureClass->m_stopRebuild) {
+        return 0;
+    }
+    if(status == COD_FINISHED) {
+        status = COD_IN_PROCESS;
+    }
+    return featureClass->m_rebuildProgress.onProgress(
+                status, complete, "%s", nullptr == message ? "" : message) ? 1 : 0;
+}
+
+void FeatureClassOverview::rebuildOverviews()
+{
+    DataStore * const parentDS = dynamic_cast<DataStore*>(m_parent);
+    OGRLayer *layer = m_rebuildConnection->GetLayerByName(m_layer->GetName());
+    Progress progress(rebuildProgressFunc, this);
+    bool result = false;
+    if(nullptr != layer) {
+        // The builder layer is not valid after the connection release, only
+        // tiling results are read from the builder then
+        FeatureClassOverview builder(layer, m_parent, m_type, m_name);
+        builder.m_shadowBuild = true;
+
+        parentDS->lockExecuteSql(true);
+        builder.m_ovrTable = parentDS->createOverviewsShadowTable(m_name);
+        parentDS->lockExecuteSql(false);
+
+        result = nullptr != builder.m_ovrTable &&
+                builder.createOverviews(progress, m_rebuildOptions) &&
+                !progress.isCanceled();
+
+        parentDS->releaseReadConnection(m_rebuildConnection);
+        m_rebuildConnection.reset();
+
+        if(result) {
+            result = swapOverviews(builder);
+        }
+    }
+    else {
+        parentDS->releaseReadConnection(m_rebuildConnection);
+        m_rebuildConnection.reset();
+    }
+
+    if(!result) {
+        m_dirtyTilesMutex.acquire();
+        m_rebuilding = false;
+        m_rebuildChanges.clear();
+        m_dirtyTilesMutex.release();
+        parentDS->lockExecuteSql(true);
+        parentDS->destroyOverviewsShadowTable(m_name);
+        parentDS->lockExecuteSql(false);
+        if(!m_stopRebuild && !progress.isCanceled()) {
+            m_rebuildProgress.onProgress(COD_CREATE_FAILED, 0.0,
+                                         _("Failed to rebuild overviews"));
+        }
+        return;
+    }
+
+    m_rebuildProgress.onProgress(COD_FINISHED, 1.0,
+                                 _("Finish tiling and simplifying geometry"));
+}
+
+/**
+ * @brief FeatureClassOverview::swapOverviews Replace the overviews table by
+ * the rebuilt shadow table and take the builder settings. Tile readers get
+ * empty tiles while the tables are swapped, the change notify redraws them.
+ * Features changed while rebuilding are tiled again to the new table.
+ * @param builder Feature class, which tiled the shadow table.
+ * @return True on success.
+ */
+bool FeatureClassOverview::swapOverviews(const FeatureClassOverview &builder)
+{
+    DataStore * const parentDS = dynamic_cast<DataStore*>(m_parent);
+
+    m_swappingOvr = true;
+    while(m_ovrReaders > 0) {
+        CPLSleep(0.001);
+    }
+
+    std::map<GIntBig, Envelope> changes;
+    parentDS->lockExecuteSql(true);
+    OGRLayer *ovrTable = m_stopRebuild ? nullptr :
+                                         parentDS->swapOverviewsTable(m_name);
+    if(nullptr != ovrTable) {
+        MutexHolder holder(m_dirtyTilesMutex);
+        // Not flushed changes are for the old tiles
+        m_dirtyTiles.clear();
+        m_tileVersions.clear();
+        m_tilesVersion = ++m_lastTileVersion;
+        m_ovrTable = ovrTable;
+        m_zoomLevels = builder.m_zoomLevels;
+        m_tileColumns = builder.m_tileColumns;
+        m_ignoreFields = builder.m_ignoreFields;
+        m_dpMaxZoom = builder.m_dpMaxZoom;
+        m_clusterRadius = builder.m_clusterRadius;
+        m_clusterMaxZoom = builder.m_clusterMaxZoom;
+        m_tileCompression = builder.m_tileCompression;
+        m_tileFormat = builder.m_tileFormat;
+        changes = std::move(m_rebuildChanges);
+        m_rebuildChanges.clear();
+        m_rebuilding = false;
+    }
+    else if(!m_stopRebuild) {
+        // Table pointer may be invalid after failed swap
+        m_ovrTable = parentDS->getOverviewsTable(m_name);
+    }
     parentDS->lockExecuteSql(false);
-    m_creatingOvr = false;
 
-    progress.onProgress(COD_FINISHED, 1.0,
-                        _("Finish tiling and simplifying geometry"));
+    TileCache::instance().remove(this);
+    m_swappingOvr = false;
+    if(nullptr == ovrTable) {
+        return false;
+    }
 
-    CPLDebug("ngstore", "finish create overviews");
+    saveOverviewsProperties();
+    for(const auto &change : changes) {
+        addFeatureDirtyTiles(change.first, getFeature(change.first),
+                             change.second);
+    }
+    checkDirtyTiles();
+
+    Notify::instance().onNotify(fullName(), ngsChangeCode::CC_CHANGE_OBJECT);
     return true;
 }
 
-VectorTile FeatureClassOverview::getTile(const Tile &tile, const Envelope &tileExtent)
+void FeatureClassOverview::addRebuildChange(GIntBig fid, const Envelope &extent)
 {
-    VectorTile vtile;
+    if(!extent.isInit()) {
+        return;
+    }
+    MutexHolder holder(m_dirtyTilesMutex);
+    if(m_rebuilding) {
+        m_rebuildChanges[fid].merge(extent);
+    }
+}
+
+FlatVectorTile FeatureClassOverview::getTile(const Tile &tile,
+                                             const Envelope &tileExtent,
+                                             const CancelToken &cancel)
+{
+    ngsTraceSpan("FeatureClassOverview::getTile");
+    FlatVectorTile vtile;
     Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
-    if(nullptr == dataset || m_creatingOvr) {
+    if(nullptr == dataset || cancel.isCanceled()) {
         return vtile;
     }
 
@@ -343,27 +1782,59 @@ VectorTile FeatureClassOverview::getTile(const Tile &tile, const Envelope &tileE
         return vtile;
     }
 
+    // Not cached empty tile is returned while the rebuilt overviews replace
+    // the old ones
+    OverviewsReadHolder readHolder(m_ovrReaders);
+    if(m_swappingOvr) {
+        return vtile;
+    }
+
+    if(m_creatingOvr) {
+        // Committed levels are read by pool connection while the overviews
+        // are built. Tiles are not cached as the next levels replace them.
+        GUInt32 readyLevels = m_readyLevels;
+        for(int level = std::min(static_cast<int>(tile.z), 31);
+            level >= 0 && tile.z - level <= OVR_MAX_OVERZOOM; --level) {
+            if(readyLevels & (1u << level)) {
+                return level == tile.z ? getTileInternal(tile) :
+                    getParentLevelTile(tile, static_cast<unsigned char>(level));
+            }
+        }
+        return vtile;
+    }
+
+    TileCache &cache = TileCache::instance();
+    // Tile read before concurrent edit is not cached
+    GUIntBig generation = cache.generation(this);
+    if(cache.get(this, tile, vtile)) {
+        return vtile;
+    }
+
     if(hasOverviews()) {
-        if(tile.z <= *m_zoomLevels.rbegin()) {
-//
-//            // Get closest zoom level
-//            unsigned char diff = 127;
-//            unsigned char z = 0;
-//            for(auto zoomLevel : m_zoomLevels) {
-//                unsigned char newDiff = static_cast<unsigned char>(
-//                            ABS(zoomLevel - tile.z));
-//                if(newDiff < diff) {
-//                    z = zoomLevel;
-//                    diff = newDiff;
-//                    if(diff == 0)
-//                        break;
-//                }
-//            }
+        unsigned char maxLevel = *m_zoomLevels.rbegin();
+        if(tile.z <= maxLevel) {
+            if(m_zoomLevels.find(tile.z) != m_zoomLevels.end()) {
+                flushDirtyTile(tile);
+                vtile = getTileInternal(tile);
+            }
+            else {
+                vtile = getNearestLevelTile(tile);
+            }
+            if(!cancel.isCanceled()) {
+                cache.put(this, tile, vtile, generation);
+            }
+            return vtile;
+        }
 
-            vtile = getTileInternal(tile);
-//            if(vtile.isValid()) {
-                return vtile;
-//            }
+        // Overzoom the deepest level tile while its simplification differs
+        // from the tile one in a few pixels. Clustered points can't be used.
+        bool clustered = m_clusterRadius > 0 && maxLevel <= m_clusterMaxZoom;
+        if(!clustered && tile.z - maxLevel <= OVR_MAX_OVERZOOM) {
+            vtile = getParentLevelTile(tile, maxLevel);
+            if(!cancel.isCanceled()) {
+                cache.put(this, tile, vtile, generation);
+            }
+            return vtile;
         }
     }
 
@@ -375,54 +1846,64 @@ VectorTile FeatureClassOverview::getTile(const Tile &tile, const Envelope &tileE
                               OGR_GT_Flatten(geometryType()) == wkbMultiPoint);
 
     double step = pixelSize(tile.z, precisePixelSize);
+    // Mixed geometry features are simplified by own type step
+    bool mixed = isMixedGeometry(geometryType());
 
+    // Features are read by own connection cursor, so the dataset lock and
+    // feature mutex are not held while scanning
     std::vector<FeaturePtr> features;
-    OGREnvelope extEnv;
-    if(!m_fastSpatialFilter) {
-        extEnv = tileExtent.toOgrEnvelope();
-    }
-
-    // Lock threads here
-    dataset->lockExecuteSql(true);
-    m_featureMutex.acquire(10.5);
-    emptyFields(true);
-    GeometryPtr extGeom = tileExtent.toGeometry(spatialReference());
-    setSpatialFilter(extGeom);
-    //reset();
-    FeaturePtr feature;
-    while((feature = nextFeature())) {
-        if(m_fastSpatialFilter) {
-            features.push_back(feature);
-        }
-        else {
-            OGRGeometry* geom = feature->GetGeometryRef();
-            if(geom) {
-                OGREnvelope env;
-                geom->getEnvelope(&env);
-                if(env.IsInit() && env.Intersects(extEnv)) {
-                    features.push_back(feature);
-                }
+    TableCursorPtr featureCursor = cursor("", tileExtent);
+    if(featureCursor) {
+        FeaturePtr feature;
+        while((feature = featureCursor->next())) {
+            if(cancel.isCanceled()) {
+                return FlatVectorTile();
+            }
+            if(nullptr != feature->GetGeometryRef()) {
+                features.push_back(feature);
             }
         }
     }
-    emptyFields(false);
-    setSpatialFilter();
-    dataset->lockExecuteSql(false);
-    m_featureMutex.release();
+    else {
+        dataset->lockExecuteSql(true);
+        features = featuresInExtent(tileExtent, cancel);
+        dataset->lockExecuteSql(false);
+    }
 
+    FeaturePtr feature;
     while(!features.empty()) {
+        if(cancel.isCanceled()) {
+            CPLDebug("ngstore", "Tiling on the fly in %s canceled", m_name.c_str());
+            return FlatVectorTile();
+        }
         feature = features.back();
 
         OGRGeometry* geom = feature->GetGeometryRef();
         if(nullptr != geom) {
+            GIntBig fid = feature->GetFID();
+            TileAttributesPtr attributes = tileAttributes(feature);
+            VectorTileItemArray items;
+            OGREnvelope env;
+            geom->getEnvelope(&env);
+            double featureStep = mixed ?
+                        pixelSize(tile.z, isPrecisePixelSize(
+                                      geom->getGeometryType())) : step;
+            if(tileExtent.contains(Envelope(env)) &&
+                    fillTileFromOGR(fid, geom, featureStep, simplifyType(tile.z),
+                                    items)) {
+                setItemsAttributes(items, attributes);
+                vtile.add(items);
+                features.pop_back();
+                continue;
+            }
 
             GEOSGeometryPtr geosGeom(new GEOSGeometryWrap(geom));
-            GIntBig fid = feature->GetFID();
-            geosGeom->simplify(step);
+            geosGeom->simplify(featureStep, simplifyType(tile.z));
 
-            VectorTileItemArray items = tileGeometry(fid, geosGeom, tileExtent);
+            items = tileGeometry(fid, geosGeom, tileExtent, cancel);
             if(!items.empty()) {
-                vtile.add(items, false);
+                setItemsAttributes(items, attributes);
+                vtile.add(items);
             }
         }
         features.pop_back();
@@ -445,12 +1926,123 @@ VectorTile FeatureClassOverview::getTile(const Tile &tile, const Envelope &tileE
 //        }
 //    }
 
+    if(!cancel.isCanceled()) {
+        cache.put(this, tile, vtile, generation);
+    }
     return vtile;
 }
 
+/**
+ * @brief FeatureClassOverview::getTiles Get tiles of the generated zoom levels
+ * by one query per OVR_BATCH_TILES tiles instead of the query per tile. The
+ * tile keys are the overviews table primary keys, so the rows are selected by
+ * the key list. Other tiles are got by getTile.
+ * @param tiles Tiles to get.
+ * @param cancel Cancel token.
+ * @return Tiles items in the order of tiles.
+ */
+std::vector<FlatVectorTile> FeatureClassOverview::getTiles(
+        const std::vector<Tile> &tiles, const CancelToken &cancel)
+{
+    ngsTraceSpan("FeatureClassOverview::getTiles");
+    std::vector<FlatVectorTile> out(tiles.size());
+    if(cancel.isCanceled()) {
+        return out;
+    }
+
+    TileCache &cache = TileCache::instance();
+    GUIntBig generation = cache.generation(this);
+    // Tile key to the tile indexes. The tiles crossing the extent share key.
+    std::map<GIntBig, std::vector<size_t>> batch;
+    std::vector<size_t> other;
+    {
+        OverviewsReadHolder readHolder(m_ovrReaders);
+        DataStore * const dataStore = dynamic_cast<DataStore*>(m_parent);
+        bool canBatch = nullptr != dataStore && dataStore->overviewsTileKeys() &&
+                !m_creatingOvr && !m_swappingOvr && hasOverviews() &&
+                hasTilesTable();
+        for(size_t i = 0; i < tiles.size(); ++i) {
+            const Tile &tile = tiles[i];
+            if(cache.get(this, tile, out[i])) {
+                continue;
+            }
+            if(canBatch && m_zoomLevels.find(tile.z) != m_zoomLevels.end() &&
+                    extent().intersects(tileExtent(tile))) {
+                flushDirtyTile(tile);
+                batch[tileKey(tile)].push_back(i);
+            }
+            else {
+                other.push_back(i);
+            }
+        }
+
+        auto it = batch.begin();
+        while(it != batch.end() && !cancel.isCanceled() && !m_swappingOvr) {
+            DatasetReadConnectionHolder holder(dynamic_cast<Dataset*>(m_parent));
+            OGRLayer *ovrTable = m_ovrTable;
+            if(nullptr != holder.connection()) {
+                ovrTable = holder.connection()->GetLayerByName(
+                            m_ovrTable->GetName());
+                if(nullptr == ovrTable) {
+                    break;
+                }
+            }
+
+            std::string keys;
+            auto first = it;
+            for(size_t count = 0; it != batch.end() && count < OVR_BATCH_TILES;
+                ++it, ++count) {
+                if(!keys.empty()) {
+                    keys += ",";
+                }
+                keys += CPLSPrintf(CPL_FRMT_GIB, it->first);
+            }
+
+            const char *fidColumn = ovrTable->GetFIDColumn();
+            ovrTable->SetAttributeFilter(CPLSPrintf("\"%s\" IN (%s)",
+                EQUAL(fidColumn, "") ? "fid" : fidColumn, keys.c_str()));
+            ovrTable->ResetReading();
+            FeaturePtr ovrTile;
+            while((ovrTile = ovrTable->GetNextFeature())) {
+                auto indexes = batch.find(ovrTile->GetFID());
+                if(indexes == batch.end()) {
+                    continue;
+                }
+                for(size_t index : indexes->second) {
+                    out[index] = tileFromFeature(tiles[index], ovrTile);
+                }
+            }
+            ovrTable->SetAttributeFilter(nullptr);
+
+            // Absent keys are empty tiles
+            if(!cancel.isCanceled()) {
+                for(auto cached = first; cached != it; ++cached) {
+                    for(size_t index : cached->second) {
+                        cache.put(this, tiles[index], out[index], generation);
+                    }
+                }
+            }
+        }
+
+        // Not read keys are got one by one
+        for(; it != batch.end(); ++it) {
+            other.insert(other.end(), it->second.begin(), it->second.end());
+        }
+    }
+
+    for(size_t index : other) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        out[index] = getTile(tiles[index], tileExtent(tiles[index]), cancel);
+    }
+    return out;
+}
+
 VectorTileItemArray FeatureClassOverview::tileGeometry(GIntBig fid,
                                                        GEOSGeometryPtr geom,
-                                                       const Envelope &env) const
+                                                       const Envelope &env,
+                                                       const CancelToken &cancel) const
 {
     VectorTileItemArray out;
     if(!geom->isValid()) {
@@ -458,7 +2050,7 @@ VectorTileItemArray FeatureClassOverview::tileGeometry(GIntBig fid,
     }
 
     GEOSGeometryPtr clipGeom = geom->clip(env);
-    clipGeom->fillTile(fid, out);
+    clipGeom->fillTile(fid, out, cancel);
 
     return out;
 }
@@ -474,12 +2066,16 @@ bool FeatureClassOverview::destroy()
         return dataset->destroy();
     }
 
+    stopRebuild();
+    TileCache::instance().remove(this);
+    clearDirtyTiles();
     std::string name = m_name;
     if(!Table::destroy()) {
         return false;
     }
 
     dataset->destroyOverviewsTable(name); // Overviews table maybe not exists
+    dataset->destroyOverviewsShadowTable(name); // Left by interrupted rebuild
 
     return true;
 }
@@ -505,6 +2101,166 @@ void FeatureClassOverview::fillZoomLevels(const std::string &zoomLevels)
     }
 }
 
+/**
+ * @brief FeatureClassOverview::fillTileColumns Set feature fields stored with
+ * overview tile items. These fields are not ignored on features read, so
+ * tiles get the values whatever way the features are tiled.
+ * @param tileAttributes Comma separated field names. If empty, the names
+ * stored in properties are used.
+ */
+void FeatureClassOverview::fillTileColumns(const std::string &tileAttributes)
+{
+    std::string _tileAttributes;
+    if(tileAttributes.empty()) {
+        _tileAttributes = property(TILE_ATTRIBUTES_KEY, "", NG_ADDITIONS_KEY);
+    }
+    else {
+        _tileAttributes = tileAttributes;
+    }
+
+    std::shared_ptr<TileColumns> columns(new TileColumns);
+    OGRFeatureDefn *defn = m_layer->GetLayerDefn();
+    char **fieldNames = CSLTokenizeString2(_tileAttributes.c_str(), ",",
+                                           CSLT_STRIPLEADSPACES |
+                                           CSLT_STRIPENDSPACES);
+    for(int i = 0; nullptr != fieldNames && nullptr != fieldNames[i]; ++i) {
+        int index = defn->GetFieldIndex(fieldNames[i]);
+        if(index < 0) {
+            warningMessage(_("Field '%s' not found in '%s'"), fieldNames[i],
+                           name().c_str());
+            continue;
+        }
+        OGRFieldDefn *fieldDefn = defn->GetFieldDefn(index);
+        OGRFieldType fieldType = fieldDefn->GetType();
+        bool number = fieldType == OFTInteger || fieldType == OFTInteger64 ||
+                fieldType == OFTReal;
+        columns->push_back({fieldDefn->GetNameRef(),
+                            number ? TileColumnType::NUMBER :
+                                     TileColumnType::STRING});
+    }
+    CSLDestroy(fieldNames);
+
+    m_ignoreFields.clear();
+    for(int i = 0; i < defn->GetFieldCount(); ++i) {
+        const char *fieldName = defn->GetFieldDefn(i)->GetNameRef();
+        if(std::find_if(columns->begin(), columns->end(),
+                        [fieldName](const TileColumn &column) {
+                            return column.name == fieldName; }) ==
+                columns->end()) {
+            m_ignoreFields.emplace_back(fieldName);
+        }
+    }
+    m_ignoreFields.emplace_back(OGR_STYLE_FIELD);
+
+    if(columns->empty()) {
+        m_tileColumns.reset();
+    }
+    else {
+        m_tileColumns = columns;
+    }
+}
+
+/**
+ * @brief FeatureClassOverview::tileAttributes Feature values of the tile
+ * columns.
+ * @param feature Feature to get values from.
+ * @return Attributes shared by all feature tile items or empty pointer if
+ * tiles have no attributes.
+ */
+TileAttributesPtr FeatureClassOverview::tileAttributes(
+        const FeaturePtr &feature) const
+{
+    if(!m_tileColumns) {
+        return TileAttributesPtr();
+    }
+
+    std::shared_ptr<TileAttributes> out(new TileAttributes);
+    out->columns = m_tileColumns;
+    out->values.resize(m_tileColumns->size());
+    out->nulls.resize(m_tileColumns->size());
+    for(size_t i = 0; i < m_tileColumns->size(); ++i) {
+        int index = feature->GetFieldIndex((*m_tileColumns)[i].name.c_str());
+        out->nulls[i] = index < 0 || !feature->IsFieldSetAndNotNull(index);
+        if(!out->nulls[i]) {
+            out->values[i] = feature->GetFieldAsString(index);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief FeatureClassOverview::clusterTile Merge points of overview tile to
+ * clusters if clustering is on for the tile zoom level. Grid cells are
+ * cluster radius wide, so a cluster stands for the points of one cell.
+ * @param tile Tile to get extent and zoom level.
+ * @param vtile Tile items.
+ */
+void FeatureClassOverview::clusterTile(const Tile &tile, VectorTile &vtile) const
+{
+    if(m_clusterRadius <= 0 || tile.z > m_clusterMaxZoom) {
+        return;
+    }
+
+    unsigned short cells = static_cast<unsigned short>(
+                std::max(1, TILE_SIZE / m_clusterRadius));
+    vtile.clusterPoints(tileExtent(tile), cells);
+}
+
+/**
+ * @brief FeatureClassOverview::encodeTile Encode tile to the overview table
+ * blob in the tile format of the overviews.
+ * @param tile Tile to get extent.
+ * @param vtile Tile items.
+ * @return Tile blob or empty pointer if tile has nothing to store.
+ */
+BufferPtr FeatureClassOverview::encodeTile(const Tile &tile,
+                                           const VectorTile &vtile) const
+{
+    if(TileFormat::MVT == m_tileFormat) {
+        return encodeMVT(FlatVectorTile(vtile), tileExtent(tile), name(),
+                         geometryType());
+    }
+    return compressTileBlob(vtile.save(true), m_tileCompression);
+}
+
+/**
+ * @brief FeatureClassOverview::decodeTile Decode the overview table blob.
+ * @param tile Tile to get extent.
+ * @param data Tile blob.
+ * @param size Tile blob size.
+ * @param vtile Tile to add items to.
+ * @return True on success.
+ */
+bool FeatureClassOverview::decodeTile(const Tile &tile, GByte *data,
+                                      size_t size, VectorTile &vtile) const
+{
+    if(TileFormat::MVT == m_tileFormat) {
+        TileColumnsPtr columns = m_tileColumns ? m_tileColumns :
+                                                 TileColumnsPtr(new TileColumns);
+        return decodeMVT(data, size, tileExtent(tile), name(), columns, vtile);
+    }
+    BufferPtr raw = decompressTileBlob(data, size);
+    if(raw) {
+        return vtile.load(*raw.get());
+    }
+    Buffer buff(data, static_cast<int>(size), false);
+    return vtile.load(buff);
+}
+
+/**
+ * @brief FeatureClassOverview::simplifyType Lines simplification type for zoom
+ * level. Douglas-Peucker keeps line shape better on small scales, the grid
+ * snap is faster and used for other zoom levels.
+ * @param zoom Zoom level
+ * @return Simplification type
+ */
+GEOSGeometryWrap::SimplifyType FeatureClassOverview::simplifyType(
+        unsigned char zoom) const
+{
+    return zoom <= m_dpMaxZoom ? GEOSGeometryWrap::SimplifyType::DOUGLAS_PEUCKER :
+                                 GEOSGeometryWrap::SimplifyType::GRID;
+}
+
 Envelope FeatureClassOverview::extraExtentForZoom(unsigned char zoom, const Envelope &env)
 {
     Envelope extent = env;
@@ -522,6 +2278,7 @@ Envelope FeatureClassOverview::extraExtentForZoom(unsigned char zoom, const Enve
 void FeatureClassOverview::onFeatureInserted(FeaturePtr feature)
 {
     FeatureClass::onFeatureInserted(feature);
+    TileCache::instance().remove(this);
     Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
     if(nullptr == dataset || dataset->isBatchOperation()) {
         return;
@@ -536,11 +2293,13 @@ void FeatureClassOverview::onFeatureInserted(FeaturePtr feature)
 
     GEOSGeometryPtr geosGeom(new GEOSGeometryWrap(geom));
     GIntBig fid = feature->GetFID();
+    TileAttributesPtr attributes = tileAttributes(feature);
 
     OGREnvelope env;
     geom->getEnvelope(&env);
     Envelope extentBase = env;
     extentBase.fix();
+    addRebuildChange(fid, extentBase);
 
     auto zoomLevelsList = zoomLevels();
     for(auto it = zoomLevelsList.rbegin(); it != zoomLevelsList.rend(); ++it) {
@@ -550,65 +2309,30 @@ void FeatureClassOverview::onFeatureInserted(FeaturePtr feature)
                 MapTransform::getTilesForExtent(extent, zoomLevel, false, true);
 
         double step = FeatureClassOverview::pixelSize(zoomLevel, precisePixelSize);
-        geosGeom->simplify(step);
+        geosGeom->simplify(step, simplifyType(zoomLevel));
 
         for(auto tileItem : items) {
-
             Envelope ext = tileItem.env;
             ext.resize(TILE_RESIZE);
 
-            auto vItem = tileGeometry(fid, geosGeom, ext);
-
-            FeaturePtr tile = getTileFeature(tileItem.tile);
-            VectorTile  vtile;
-            bool create = true;
-            if(tile) {
-                int size = 0;
-                GByte *data = tile->GetFieldAsBinary(
-                            tile->GetFieldIndex(OVR_TILE_KEY), &size);
-                Buffer buff(data, size, false);
-                vtile.load(buff);
-                create = false;
-            }
-            else {
-                tile = OGRFeature::CreateFeature(m_ovrTable->GetLayerDefn());
-
-                tile->SetField(OVR_ZOOM_KEY, tileItem.tile.z);
-                tile->SetField(OVR_X_KEY, tileItem.tile.x);
-                tile->SetField(OVR_Y_KEY, tileItem.tile.y);
-            }
-            vtile.add(vItem, true);
-
-            // Add tile back
-            if(vtile.isValid()) {
-                BufferPtr data = vtile.save();
-                tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                               data->data());
-
-                if(create) {
-                    createTileFeature(tile);
-                }
-                else {
-                    setTileFeature(tile);
-                }
-            }
+            VectorTileItemArray tileItems = tileGeometry(fid, geosGeom, ext);
+            setItemsAttributes(tileItems, attributes);
+            addDirtyTile(tileItem.tile, NOT_FOUND, std::move(tileItems));
         }
     }
+    checkDirtyTiles();
 }
 
 void FeatureClassOverview::onFeatureUpdated(FeaturePtr oldFeature,
                                             FeaturePtr newFeature)
 {
     FeatureClass::onFeatureUpdated(oldFeature, newFeature);
+    TileCache::instance().remove(this);
     Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
     if(nullptr == dataset || dataset->isBatchOperation()) {
         return;
     }
 
-    bool precisePixelSize = !(OGR_GT_Flatten(geometryType()) == wkbPoint ||
-                              OGR_GT_Flatten(geometryType()) == wkbMultiPoint);
-
-
     OGRGeometry *originalGeom = oldFeature->GetGeometryRef();
     OGRGeometry *newGeom = newFeature->GetGeometryRef();
     Envelope extentBase;
@@ -625,62 +2349,63 @@ void FeatureClassOverview::onFeatureUpdated(FeaturePtr oldFeature,
         extentBase.merge(env);
     }
 
-    extentBase.fix();
+    addRebuildChange(oldFeature->GetFID(), extentBase);
+    addFeatureDirtyTiles(oldFeature->GetFID(), newFeature, extentBase);
+    checkDirtyTiles();
+}
+
+/**
+ * @brief FeatureClassOverview::addFeatureDirtyTiles Replace feature items in
+ * overview tiles.
+ * @param removeId Feature identifier to remove from tiles or NOT_FOUND.
+ * @param feature Feature to add to tiles. May be empty.
+ * @param extent Extent of the changed tiles.
+ */
+void FeatureClassOverview::addFeatureDirtyTiles(GIntBig removeId,
+                                                const FeaturePtr &feature,
+                                                Envelope extent)
+{
+    if(!extent.isInit()) {
+        return;
+    }
+    extent.fix();
+    bool precisePixelSize = !(OGR_GT_Flatten(geometryType()) == wkbPoint ||
+                              OGR_GT_Flatten(geometryType()) == wkbMultiPoint);
 
-    GEOSGeometryPtr geosGeom(new GEOSGeometryWrap(newGeom));
-    GIntBig fid = newFeature->GetFID();
+    OGRGeometry *geom = feature ? feature->GetGeometryRef() : nullptr;
+    GEOSGeometryPtr geosGeom;
+    TileAttributesPtr attributes;
+    if(nullptr != geom) {
+        geosGeom.reset(new GEOSGeometryWrap(geom));
+        attributes = tileAttributes(feature);
+        if(isMixedGeometry(geometryType())) {
+            precisePixelSize = isPrecisePixelSize(geom->getGeometryType());
+        }
+    }
 
     auto zoomLevelsList = zoomLevels();
     for(auto it = zoomLevelsList.rbegin(); it != zoomLevelsList.rend(); ++it) {
         unsigned char zoomLevel = *it;
-        Envelope extent = extraExtentForZoom(zoomLevel, extentBase);
+        Envelope zoomExtent = extraExtentForZoom(zoomLevel, extent);
 
         std::vector<TileItem> items =
-                MapTransform::getTilesForExtent(extent, zoomLevel, false, true);
+                MapTransform::getTilesForExtent(zoomExtent, zoomLevel, false, true);
 
-        double step = FeatureClassOverview::pixelSize(zoomLevel, precisePixelSize);
-        geosGeom->simplify(step);
+        if(geosGeom) {
+            double step = FeatureClassOverview::pixelSize(zoomLevel,
+                                                          precisePixelSize);
+            geosGeom->simplify(step, simplifyType(zoomLevel));
+        }
 
         for(auto tileItem : items) {
-            FeaturePtr tile = getTileFeature(tileItem.tile);
-            VectorTile  vtile;
-            bool create = true;
-            if(tile) {
-                int size = 0;
-                GByte *data = tile->GetFieldAsBinary(
-                            tile->GetFieldIndex(OVR_TILE_KEY), &size);
-                Buffer buff(data, size, false);
-                vtile.load(buff);
-                create = false;
-            }
-            else {
-                tile = OGRFeature::CreateFeature(m_ovrTable->GetLayerDefn());
-
-                tile->SetField(OVR_ZOOM_KEY, tileItem.tile.z);
-                tile->SetField(OVR_X_KEY, tileItem.tile.x);
-                tile->SetField(OVR_Y_KEY, tileItem.tile.y);
-            }
-
-            vtile.remove(oldFeature->GetFID());
-
-            Envelope env = tileItem.env;
-            env.resize(TILE_RESIZE);
-            auto vItem = tileGeometry(fid, geosGeom, env);
-            vtile.add(vItem, true);
-
-            // Add tile back
-            if(vtile.isValid()) {
-                BufferPtr data = vtile.save();
-                tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                                                     data->data());
-
-                if(create) {
-                    createTileFeature(tile);
-                }
-                else {
-                    setTileFeature(tile);
-                }
+            VectorTileItemArray tileItems;
+            if(geosGeom) {
+                Envelope env = tileItem.env;
+                env.resize(TILE_RESIZE);
+                tileItems = tileGeometry(feature->GetFID(), geosGeom, env);
+                setItemsAttributes(tileItems, attributes);
             }
+            addDirtyTile(tileItem.tile, removeId, std::move(tileItems));
         }
     }
 }
@@ -688,59 +2413,258 @@ void FeatureClassOverview::onFeatureUpdated(FeaturePtr oldFeature,
 void FeatureClassOverview::onFeatureDeleted(FeaturePtr delFeature)
 {
     FeatureClass::onFeatureDeleted(delFeature);
+    TileCache::instance().remove(this);
     Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
     if(nullptr == dataset || dataset->isBatchOperation()) {
         return;
     }
 
-    OGREnvelope env;OGRGeometry *geom = delFeature->GetGeometryRef();
+    OGRGeometry *geom = delFeature->GetGeometryRef();
+    if(nullptr == geom) {
+        return;
+    }
+    OGREnvelope env;
     geom->getEnvelope(&env);
+    addRebuildChange(delFeature->GetFID(), env);
 
     for(auto zoomLevel : zoomLevels()) {
         Envelope extent = extraExtentForZoom(zoomLevel, env);
         std::vector<TileItem> items =
                 MapTransform::getTilesForExtent(extent, zoomLevel, false, true);
         for(auto tileItem : items) {
-            FeaturePtr tile = getTileFeature(tileItem.tile);
+            addDirtyTile(tileItem.tile, delFeature->GetFID(),
+                         VectorTileItemArray());
+        }
+    }
+    checkDirtyTiles();
+}
 
-            VectorTile  vtile;
-            if(tile) {
-                int size = 0;
-                GByte *data = tile->GetFieldAsBinary(
-                            tile->GetFieldIndex(OVR_TILE_KEY), &size);
-                Buffer buff(data, size, false);
-                if(vtile.load(buff)) {
-                    vtile.remove(delFeature->GetFID());
-                }
-            }
+void FeatureClassOverview::addDirtyTile(const Tile &tile, GIntBig removeId,
+                                        VectorTileItemArray &&items)
+{
+    MutexHolder holder(m_dirtyTilesMutex);
+    DirtyTile &dirtyTile = m_dirtyTiles[tile];
+    if(removeId != NOT_FOUND) {
+        dirtyTile.removeIds.insert(removeId);
+        // Drop not flushed items of the feature
+        dirtyTile.tile.remove(removeId);
+    }
+    dirtyTile.tile.add(std::move(items));
+}
+
+void FeatureClassOverview::checkDirtyTiles()
+{
+    size_t count = 0;
+    m_dirtyTilesMutex.acquire();
+    count = m_dirtyTiles.size();
+    m_dirtyTilesMutex.release();
 
-            // Add tile back
-            if(vtile.isValid()) {
-                BufferPtr data = vtile.save();
-                tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                               data->data());
+    if(count > MAX_DIRTY_TILES) {
+        flushDirtyTiles();
+    }
+}
 
-                setTileFeature(tile);
-            }
-            else if(tile) {
-                ngsUnused(m_ovrTable->DeleteFeature(tile->GetFID()));
-            }
+bool FeatureClassOverview::flushDirtyTiles()
+{
+    // Lock order is the same as in edit operations: SQL lock, journal lock
+    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    MutexHolder journalHolder(m_dirtyTilesMutex);
+    if(m_dirtyTiles.empty()) {
+        return true;
+    }
+
+    CPLDebug("ngstore", "Flush %ld overview tiles of %s",
+             static_cast<long>(m_dirtyTiles.size()), m_name.c_str());
+    DataStore * const dataStore = dynamic_cast<DataStore*>(m_parent);
+    bool transaction = nullptr != dataStore &&
+            dataStore->startOverviewsTransaction();
+
+    bool result = true;
+    for(auto &item : m_dirtyTiles) {
+        if(!flushDirtyTile(item.first, item.second)) {
+            result = false;
+        }
+    }
+    m_dirtyTiles.clear();
+
+    if(transaction && !dataStore->commitOverviewsTransaction()) {
+        return errorMessage(_("Failed to save tiles. %s"), CPLGetLastErrorMsg());
+    }
+    return result;
+}
+
+bool FeatureClassOverview::flushDirtyTile(const Tile &tile)
+{
+    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    MutexHolder journalHolder(m_dirtyTilesMutex);
+    auto it = m_dirtyTiles.find(tile);
+    if(it == m_dirtyTiles.end()) {
+        return true;
+    }
+
+    bool result = flushDirtyTile(it->first, it->second);
+    m_dirtyTiles.erase(it);
+    return result;
+}
+
+bool FeatureClassOverview::flushDirtyTile(const Tile &tile,
+                                          DirtyTile &dirtyTile)
+{
+    if(!hasTilesTable()) {
+        return false;
+    }
+
+    FeaturePtr tileFeature = getTileFeature(tile);
+    VectorTile vtile;
+    bool create = true;
+    if(tileFeature) {
+        int size = 0;
+        GByte *data = tileFeature->GetFieldAsBinary(
+                    tileFeature->GetFieldIndex(OVR_TILE_KEY), &size);
+        decodeTile(tile, data, static_cast<size_t>(size), vtile);
+        create = false;
+    }
+
+    vtile.remove(dirtyTile.removeIds);
+    vtile.add(std::move(dirtyTile.tile), true);
+    clusterTile(tile, vtile);
+
+    if(vtile.empty()) {
+        if(!create) {
+            m_tileVersions[tile] = ++m_lastTileVersion;
+            return m_ovrTable->DeleteFeature(tileFeature->GetFID()) == OGRERR_NONE;
+        }
+        return true;
+    }
+
+    if(create) {
+        tileFeature = OGRFeature::CreateFeature(m_ovrTable->GetLayerDefn());
+
+        DataStore * const dataStore = dynamic_cast<DataStore*>(m_parent);
+        if(nullptr != dataStore && dataStore->overviewsTileKeys()) {
+            tileFeature->SetFID(tileKey(tile));
+        }
+        tileFeature->SetField(OVR_ZOOM_KEY, tile.z);
+        tileFeature->SetField(OVR_X_KEY, tile.x);
+        tileFeature->SetField(OVR_Y_KEY, tile.y);
+    }
+
+    BufferPtr data = encodeTile(tile, vtile);
+    if(!data) {
+        if(!create) {
+            m_tileVersions[tile] = ++m_lastTileVersion;
+            return m_ovrTable->DeleteFeature(tileFeature->GetFID()) == OGRERR_NONE;
+        }
+        return true;
+    }
+
+    // Features changed near the tile may leave its content as is
+    int field = tileFeature->GetFieldIndex(OVR_TILE_KEY);
+    if(!create) {
+        int size = 0;
+        GByte *oldData = tileFeature->GetFieldAsBinary(field, &size);
+        if(size == data->size() &&
+                std::memcmp(oldData, data->data(),
+                            static_cast<size_t>(data->size())) == 0) {
+            return true;
+        }
+    }
+    m_tileVersions[tile] = ++m_lastTileVersion;
+    tileFeature->SetField(field, data->size(), data->data());
+
+    if(create) {
+        return createTileFeature(tileFeature);
+    }
+    return setTileFeature(tileFeature);
+}
+
+void FeatureClassOverview::clearDirtyTiles()
+{
+    MutexHolder holder(m_dirtyTilesMutex);
+    m_dirtyTiles.clear();
+    m_tileVersions.clear();
+    m_tilesVersion = ++m_lastTileVersion;
+}
+
+void FeatureClassOverview::resetTileVersions()
+{
+    MutexHolder holder(m_dirtyTilesMutex);
+    m_tileVersions.clear();
+    m_tilesVersion = ++m_lastTileVersion;
+}
+
+/**
+ * @brief FeatureClassOverview::sourceTile Get the stored tile the tile items
+ * are read from, see getTile.
+ * @param tile Tile to get.
+ * @param source Stored tile of the same or coarser zoom level.
+ * @return False if the tile is tiled on the fly or merged from finer tiles.
+ */
+bool FeatureClassOverview::sourceTile(const Tile &tile, Tile &source) const
+{
+    if(m_zoomLevels.empty()) {
+        return false;
+    }
+
+    unsigned char level = *m_zoomLevels.rbegin();
+    if(tile.z <= level) {
+        auto upper = m_zoomLevels.upper_bound(tile.z);
+        if(upper == m_zoomLevels.begin()) {
+            return false;
         }
+        level = *std::prev(upper);
     }
+    else {
+        bool clustered = m_clusterRadius > 0 && level <= m_clusterMaxZoom;
+        if(clustered || tile.z - level > OVR_MAX_OVERZOOM) {
+            return false;
+        }
+    }
+
+    int shift = tile.z - level;
+    source = { tile.x >> shift, tile.y >> shift, level, tile.crossExtent };
+    return true;
+}
+
+/**
+ * @brief FeatureClassOverview::tileVersion Get version of the tile content.
+ * The version changes only if the stored tile the items are read from is
+ * changed, so the tile data made from the items of the same version may be
+ * used again. Not flushed changes of the stored tile are flushed first.
+ * @param tile Tile to check.
+ * @return Tile version or 0 if it is unknown, e.g. for tiles tiled on the fly.
+ */
+GUIntBig FeatureClassOverview::tileVersion(const Tile &tile)
+{
+    OverviewsReadHolder readHolder(m_ovrReaders);
+    Tile source;
+    if(m_creatingOvr || m_swappingOvr || !hasOverviews() ||
+            !sourceTile(tile, source)) {
+        return 0;
+    }
+
+    flushDirtyTile(source);
+    MutexHolder holder(m_dirtyTilesMutex);
+    auto it = m_tileVersions.find(source);
+    return it == m_tileVersions.end() ? m_tilesVersion : it->second;
+}
+
+bool FeatureClassOverview::sync()
+{
+    flushDirtyTiles();
+    return FeatureClass::sync();
 }
 
 void FeatureClassOverview::onFeaturesDeleted()
 {
+    FeatureClass::onFeaturesDeleted();
+    TileCache::instance().remove(this);
+    clearDirtyTiles();
+    m_stopRebuild = true; // Rebuilt tiles have the deleted features
     DataStore *dataset = dynamic_cast<DataStore*>(m_parent);
     if(nullptr != dataset) {
         dataset->clearOverviewsTable(name());
     }
 }
 
-void FeatureClassOverview::addOverviewItem(const Tile &tile, const VectorTileItemArray &items)
-{
-    MutexHolder holder(m_genTileMutex, 150.0);
-    m_genTiles[tile].add(items, true);
-}
-
 } // namespace ngs
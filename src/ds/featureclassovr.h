@@ -21,11 +21,26 @@
 #ifndef NGSFEATUREDATASETOVR_H
 #define NGSFEATUREDATASETOVR_H
 
+#include "dataset.h"
 #include "featureclass.h"
+#include "mvt.h"
 
 namespace ngs {
 
 constexpr double TILE_RESIZE = 1.1;
+constexpr size_t MAX_DIRTY_TILES = 512;
+
+class DataStore;
+
+/**
+ * @brief The OverviewsEstimate struct Overview zoom levels recommended for the
+ * feature class data with estimated tiling time and tiles size.
+ */
+typedef struct _overviewsEstimate {
+    std::set<unsigned char> zoomLevels;
+    double buildTime;       // Seconds
+    GIntBig storageSize;    // Bytes, without compression
+} OverviewsEstimate;
 
 /**
  * @brief The FeatureClassOverview class
@@ -37,24 +52,40 @@ public:
                           ObjectContainer * const parent = nullptr,
                           const enum ngsCatalogObjectType type = CAT_FC_ANY,
                           const std::string &name = "");
-    virtual ~FeatureClassOverview() override = default;
+    virtual ~FeatureClassOverview() override;
+    virtual int copyFeatures(const FeatureClassPtr srcFClass,
+                             const FieldMapPtr fieldMap,
+                             OGRwkbGeometryType filterGeomType,
+                             const Progress &progress = Progress(),
+                             const Options &options = Options()) override;
     virtual bool onRowsCopied(const TablePtr srcTable,
                               const Progress &progress = Progress(),
                               const Options &options = Options()) override;
     bool hasOverviews() const;
     bool createOverviews(const Progress &progress = Progress(),
                          const Options &options = Options());
-    VectorTile getTile(const Tile &tile, const Envelope &tileExtent = Envelope());
+    OverviewsEstimate estimateOverviews(
+            const CancelToken &cancel = CancelToken()) const;
+    FlatVectorTile getTile(const Tile &tile,
+                           const Envelope &tileExtent = Envelope(),
+                           const CancelToken &cancel = CancelToken());
+    std::vector<FlatVectorTile> getTiles(const std::vector<Tile> &tiles,
+                                         const CancelToken &cancel = CancelToken());
     std::set<unsigned char> zoomLevels() const { return m_zoomLevels; }
-    void addOverviewItem(const Tile &tile, const VectorTileItemArray &items);
+    const TileColumnsPtr &tileColumns() const { return m_tileColumns; }
+    GEOSGeometryWrap::SimplifyType simplifyType(unsigned char zoom) const;
+    bool flushDirtyTiles();
+    GUIntBig tileVersion(const Tile &tile);
 
     // static
     static double pixelSize(int zoom, bool precize = false);
     static Envelope extraExtentForZoom(unsigned char zoom, const Envelope &env);
+    static GIntBig tileKey(const Tile &tile);
 
     // Object interface
 public:
     virtual bool destroy() override;
+    virtual bool sync() override;
 
     // Table interface
 protected:
@@ -65,8 +96,15 @@ protected:
 
 protected:
     VectorTileItemArray tileGeometry(GIntBig fid, GEOSGeometryPtr geom,
-                                     const Envelope &env) const;
+                                     const Envelope &env,
+                                     const CancelToken &cancel = CancelToken()) const;
     void fillZoomLevels(const std::string &zoomLevels = "");
+    void fillTileColumns(const std::string &tileAttributes = "");
+    TileAttributesPtr tileAttributes(const FeaturePtr &feature) const;
+    void clusterTile(const Tile &tile, VectorTile &vtile) const;
+    BufferPtr encodeTile(const Tile &tile, const VectorTile &vtile) const;
+    bool decodeTile(const Tile &tile, GByte *data, size_t size,
+                    VectorTile &vtile) const;
 
 /*
     void tileLine(GIntBig fid, OGRGeometry* geom, OGRGeometry* extent,
@@ -81,22 +119,125 @@ protected:
 
     bool hasTilesTable();
     FeaturePtr getTileFeature(const Tile &tile);
-    VectorTile getTileInternal(const Tile &tile);
+    FlatVectorTile getTileInternal(const Tile &tile);
+    FlatVectorTile tileFromFeature(const Tile &tile,
+                                   const FeaturePtr &ovrTile) const;
+    FlatVectorTile getParentLevelTile(const Tile &tile, unsigned char level);
+    FlatVectorTile getNearestLevelTile(const Tile &tile);
     bool setTileFeature(FeaturePtr tile);
     bool createTileFeature(FeaturePtr tile);
 
     // static
 protected:
     static bool tilingDataJobThreadFunc(ThreadData *threadData);
+    static bool tileSaveJobThreadFunc(ThreadData *threadData);
 
 protected:
     OGRLayer *m_ovrTable;
     std::set<unsigned char> m_zoomLevels;
-    Mutex m_genTileMutex;
-    bool m_creatingOvr;
+    TileColumnsPtr m_tileColumns;
+    int m_dpMaxZoom;
+    int m_clusterRadius, m_clusterMaxZoom;
+    TileCompression m_tileCompression;
+    TileFormat m_tileFormat;
+    SpinLock m_genTileMutex;
+    std::atomic<bool> m_creatingOvr;
+    // Bit per zoom level committed while overviews are created
+    std::atomic<GUInt32> m_readyLevels;
+    // Zoom levels of the current tiling pass
+    std::set<unsigned char> m_tilingLevels;
+    // Overviews are tiled to the shadow table by rebuild
+    bool m_shadowBuild;
+
+private:
+    using TileMap = std::map<Tile, VectorTile>;
+
+    /**
+     * @brief The TilingShard struct Tiling state owned by one worker at a time:
+     * tiles generated by this worker.
+     */
+    typedef struct _tilingShard {
+        TileMap tiles;
+        size_t size; // Approximate tiles size in bytes
+    } TilingShard;
+
+    using TilingShardPtr = std::unique_ptr<TilingShard>;
+
+    /**
+     * @brief The TilePiece struct Not simplified part of geometry clipped by
+     * tile extent. Tiles of the next zoom level are clipped from it.
+     */
+    typedef struct _tilePiece {
+        Envelope extent;
+        GEOSGeometryPtr geom;
+    } TilePiece;
+
+    /**
+     * @brief The DirtyTile struct Not flushed changes of overview tile: ids
+     * to remove from the stored tile and items to add to it.
+     */
+    typedef struct _dirtyTile {
+        FeatureIDs removeIds;
+        VectorTile tile;
+    } DirtyTile;
+
+private:
+    TilingShard *takeShard();
+    void releaseShard(TilingShard *shard);
+    void mergeShards();
+    bool spillTiles(TileMap &tiles);
+    void removeTileRuns();
+    void addDirtyTile(const Tile &tile, GIntBig removeId,
+                      VectorTileItemArray &&items);
+    void checkDirtyTiles();
+    bool flushDirtyTile(const Tile &tile);
+    bool flushDirtyTile(const Tile &tile, DirtyTile &dirtyTile);
+    void clearDirtyTiles();
+    void resetTileVersions();
+    bool sourceTile(const Tile &tile, Tile &source) const;
+    void saveGeneratedTiles(DataStore *parentDS, const Progress &progress);
+    void saveOverviewsProperties();
+    void addFeatureDirtyTiles(GIntBig removeId, const FeaturePtr &feature,
+                              Envelope extent);
+    bool startRebuild(const Progress &progress, const Options &options);
+    void stopRebuild();
+    void rebuildOverviews();
+    bool swapOverviews(const FeatureClassOverview &builder);
+    void addRebuildChange(GIntBig fid, const Envelope &extent);
+
+    // static
+private:
+    static void rebuildThread(void *data);
+    static int rebuildProgressFunc(enum ngsCode status, double complete,
+                                   const char *message, void *progressArguments);
 
 private:
-    std::map<Tile, VectorTile> m_genTiles;
+    TileMap m_genTiles;
+    std::vector<TilingShardPtr> m_shards;
+    std::vector<TilingShard*> m_freeShards;
+    // Sorted runs of generated tiles spilled to files over the memory budget
+    size_t m_shardBudget;
+    std::string m_runPrefix;
+    std::vector<std::string> m_runFiles;
+    std::atomic<size_t> m_runTileCount;
+    std::map<Tile, DirtyTile> m_dirtyTiles;
+    Mutex m_dirtyTilesMutex;
+    // Version of the stored tiles content, guarded by dirty tiles mutex.
+    // Tiles not changed since the overviews were built have m_tilesVersion.
+    std::map<Tile, GUIntBig> m_tileVersions;
+    GUIntBig m_tilesVersion;
+    GUIntBig m_lastTileVersion;
+    // Background rebuild. Features changed while rebuilding are tiled again
+    // after the swap, the changes are guarded by dirty tiles mutex.
+    CPLJoinableThread *m_rebuildThread;
+    GDALDatasetPtr m_rebuildConnection;
+    std::atomic<bool> m_stopRebuild;
+    bool m_rebuilding;
+    std::map<GIntBig, Envelope> m_rebuildChanges;
+    Progress m_rebuildProgress;
+    Options m_rebuildOptions;
+    std::atomic<bool> m_swappingOvr;
+    std::atomic<int> m_ovrReaders;
 };
 
 using FeatureClassOverviewPtr = std::shared_ptr<FeatureClassOverview>;
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "geojsonreader.h"
+
+namespace ngs {
+
+constexpr const char *FEATURES_KEY = "features";
+
+//------------------------------------------------------------------------------
+// GeoJSONReader
+//------------------------------------------------------------------------------
+
+GeoJSONReader::GeoJSONReader(FeatureFunction onFeature) :
+    CPLJSonStreamingParser(),
+    m_onFeature(onFeature),
+    m_depth(0),
+    m_featuresDepth(0),
+    m_stopped(false)
+{
+
+}
+
+void GeoJSONReader::String(const char *value, size_t length)
+{
+    addSimpleValue(std::string(value, length));
+}
+
+void GeoJSONReader::Number(const char *value, size_t length)
+{
+    std::string number(value, length);
+    if(number.find_first_of(".eE") == std::string::npos) {
+        addSimpleValue(static_cast<GInt64>(CPLAtoGIntBig(number.c_str())));
+    }
+    else {
+        addSimpleValue(CPLAtof(number.c_str()));
+    }
+}
+
+void GeoJSONReader::Boolean(bool value)
+{
+    addSimpleValue(value);
+}
+
+void GeoJSONReader::Null()
+{
+    // Null members are not added, the fields stay unset.
+}
+
+void GeoJSONReader::StartObject()
+{
+    m_depth++;
+    if(inFeature()) {
+        Node node;
+        node.isArray = false;
+        addValue(node.object);
+        m_nodes.push_back(node);
+    }
+    else if(m_featuresDepth > 0 && m_depth == m_featuresDepth + 1) {
+        Node node;
+        node.isArray = false;
+        m_nodes.push_back(node);
+    }
+}
+
+void GeoJSONReader::EndObject()
+{
+    m_depth--;
+    if(!inFeature()) {
+        return;
+    }
+
+    CPLJSONObject object = m_nodes.back().object;
+    m_nodes.pop_back();
+    if(m_nodes.empty() && !m_onFeature(object)) {
+        m_stopped = true;
+        StopParsing();
+    }
+}
+
+void GeoJSONReader::StartObjectMember(const char *key, size_t length)
+{
+    m_key = std::string(key, length);
+}
+
+void GeoJSONReader::StartArray()
+{
+    m_depth++;
+    if(inFeature()) {
+        Node node;
+        node.isArray = true;
+        addValue(node.array);
+        m_nodes.push_back(node);
+    }
+    else if(m_depth == 2 && m_key == FEATURES_KEY) {
+        m_featuresDepth = m_depth;
+    }
+}
+
+void GeoJSONReader::EndArray()
+{
+    if(inFeature()) {
+        m_nodes.pop_back();
+    }
+    else if(m_depth == m_featuresDepth) {
+        m_featuresDepth = 0;
+    }
+    m_depth--;
+}
+
+void GeoJSONReader::addValue(const CPLJSONObject &value)
+{
+    Node &parent = m_nodes.back();
+    if(parent.isArray) {
+        parent.array.Add(value);
+    }
+    else {
+        parent.object.Add(m_key, value);
+    }
+}
+
+template<class T>
+void GeoJSONReader::addSimpleValue(T value)
+{
+    if(!inFeature()) {
+        return;
+    }
+    Node &parent = m_nodes.back();
+    if(parent.isArray) {
+        parent.array.Add(value);
+    }
+    else {
+        parent.object.Add(m_key, value);
+    }
+}
+
+} // namespace ngs
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSGEOJSONREADER_H
+#define NGSGEOJSONREADER_H
+
+// std
+#include <functional>
+#include <vector>
+
+// gdal
+#include "cpl_json.h"
+#include "cpl_json_streaming_parser.h"
+
+namespace ngs {
+
+constexpr size_t GEOJSON_READ_BUFFER_SIZE = 65536;
+
+/**
+ * @brief The GeoJSONReader class Streaming reader of GeoJSON FeatureCollection.
+ * Only the feature being parsed is kept in memory as JSON object, each
+ * completed feature is passed to the function set in constructor.
+ */
+class GeoJSONReader : public CPLJSonStreamingParser
+{
+public:
+    typedef std::function<bool(const CPLJSONObject &feature)> FeatureFunction;
+
+public:
+    explicit GeoJSONReader(FeatureFunction onFeature);
+    bool isStopped() const { return m_stopped; }
+
+    // CPLJSonStreamingParser interface
+protected:
+    virtual void String(const char *value, size_t length) override;
+    virtual void Number(const char *value, size_t length) override;
+    virtual void Boolean(bool value) override;
+    virtual void Null() override;
+    virtual void StartObject() override;
+    virtual void EndObject() override;
+    virtual void StartObjectMember(const char *key, size_t length) override;
+    virtual void StartArray() override;
+    virtual void EndArray() override;
+
+private:
+    typedef struct _node {
+        CPLJSONObject object;
+        CPLJSONArray array;
+        bool isArray;
+    } Node;
+
+    bool inFeature() const { return !m_nodes.empty(); }
+    void addValue(const CPLJSONObject &value);
+    template<class T> void addSimpleValue(T value);
+
+private:
+    FeatureFunction m_onFeature;
+    std::vector<Node> m_nodes;
+    std::string m_key;
+    int m_depth;
+    int m_featuresDepth;
+    bool m_stopped;
+};
+
+} // namespace ngs
+
+#endif // NGSGEOJSONREADER_H
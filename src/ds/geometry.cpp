@@ -20,10 +20,28 @@
  ****************************************************************************/
 #include "geometry.h"
 
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <map>
+
+// gdal
+#include "cpl_conv.h"
+#include "gdal_version.h"
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+#include "cpl_compressor.h"
+#endif
+
 #include "earcut.hpp"
 #include "geos_c.h"
 
 #include "api_priv.h"
+#include "util/arena.h"
+#include "util/stringutil.h"
 
 namespace ngs {
 
@@ -35,6 +53,11 @@ constexpr const char *MAP_MAX_X_KEY = "max_x";
 constexpr const char *MAP_MAX_Y_KEY = "max_y";
 
 constexpr unsigned short MAX_EDGE_INDEX = 65534;
+// Douglas-Peucker tolerance in pixels
+constexpr double DP_TOLERANCE_FACTOR = 0.5;
+constexpr size_t MAX_EDIT_HISTORY = 100;
+constexpr unsigned MAX_EDIT_INDEX_CELL_SEGMENTS = 4;
+constexpr unsigned short MAX_EDIT_INDEX_SIDE = 512;
 
 //------------------------------------------------------------------------------
 // GeometryPtr
@@ -62,85 +85,218 @@ ngs::GeometryPtr::operator OGRGeometry *() const
 }
 
 //------------------------------------------------------------------------------
-// VectorTileItem
+// FeatureIDs
 //------------------------------------------------------------------------------
 
-VectorTileItem::VectorTileItem() :
-     m_valid(false),
-     m_2d(true)
+FeatureIDs::FeatureIDs(std::initializer_list<GIntBig> ids) :
+    m_ids(ids)
 {
+    normalize();
 }
 
-void VectorTileItem::removeId(GIntBig id)
+FeatureIDs::FeatureIDs(const std::set<GIntBig> &ids) :
+    m_ids(ids.begin(), ids.end())
 {
-    auto it = m_ids.find(id);
-    if(it != m_ids.end()) {
-        m_ids.erase(it);
-        if(m_ids.empty()) {
-            m_valid = false;
-        }
+}
+
+/**
+ * @brief FeatureIDs::normalize Sort and remove duplicates. Already sorted
+ * unique input (i.e. from the std::set or the pre-sorted array) is kept as is.
+ */
+void FeatureIDs::normalize()
+{
+    if(std::adjacent_find(m_ids.begin(), m_ids.end(),
+                          std::greater_equal<GIntBig>()) == m_ids.end()) {
+        return;
     }
+    std::sort(m_ids.begin(), m_ids.end());
+    m_ids.erase(std::unique(m_ids.begin(), m_ids.end()), m_ids.end());
 }
 
-void VectorTileItem::addBorderIndex(unsigned short ring, unsigned short index)
+void FeatureIDs::insert(GIntBig id)
 {
-    if(m_borderIndices.size() <= ring) {
-       for(unsigned short i = static_cast<unsigned short>(m_borderIndices.size());
-           i < ring + 1; ++i) {
-            m_borderIndices.push_back(std::vector<unsigned short>());
+    // Most of the ids are added in ascending order
+    if(m_ids.empty() || m_ids.back() < id) {
+        m_ids.push_back(id);
+        return;
+    }
+    auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if(*it != id) {
+        m_ids.insert(it, id);
+    }
+}
+
+bool FeatureIDs::erase(GIntBig id)
+{
+    auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if(it == m_ids.end() || *it != id) {
+        return false;
+    }
+    m_ids.erase(it);
+    return true;
+}
+
+void FeatureIDs::erase(const FeatureIDs &other)
+{
+    if(m_ids.empty() || other.empty()) {
+        return;
+    }
+    std::vector<GIntBig> result;
+    result.reserve(m_ids.size());
+    std::set_difference(m_ids.begin(), m_ids.end(),
+                        other.m_ids.begin(), other.m_ids.end(),
+                        std::back_inserter(result));
+    m_ids.swap(result);
+}
+
+FeatureIDs::const_iterator FeatureIDs::find(GIntBig id) const
+{
+    auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if(it != m_ids.end() && *it == id) {
+        return it;
+    }
+    return m_ids.end();
+}
+
+/**
+ * @brief FeatureIDs::includes Check if all ids from sorted range are present.
+ * @param first Sorted range begin.
+ * @param last Sorted range end.
+ * @return True if all ids present. Empty range is always included.
+ */
+bool FeatureIDs::includes(const GIntBig *first, const GIntBig *last) const
+{
+    auto it = m_ids.begin();
+    for(; first != last; ++first) {
+        // Range is sorted, so continue search from the previous position
+        it = std::lower_bound(it, m_ids.end(), *first);
+        if(it == m_ids.end() || *it != *first) {
+            return false;
         }
     }
-    m_borderIndices[ring].push_back(index);
+    return true;
 }
 
-void VectorTileItem::save(Buffer *buffer)
+/**
+ * @brief FeatureIDs::intersects Check if any id from sorted range is present.
+ * @param first Sorted range begin.
+ * @param last Sorted range end.
+ * @return True if at least one id present.
+ */
+bool FeatureIDs::intersects(const GIntBig *first, const GIntBig *last) const
 {
-    buffer->put(static_cast<GByte>(m_2d));
+    if(m_ids.empty() || first == last || *first > m_ids.back() ||
+            *(last - 1) < m_ids.front()) {
+        return false;
+    }
 
-    // vector<SimplePoint> m_points
-    buffer->put(static_cast<GUInt32>(m_points.size()));
-    for(auto point : m_points) {
-        if(m_2d) {
-            buffer->put(point.x);
-            buffer->put(point.y);
+    auto it = m_ids.begin();
+    for(; first != last; ++first) {
+        it = std::lower_bound(it, m_ids.end(), *first);
+        if(it == m_ids.end()) {
+            return false;
         }
-        else {
-            // TODO: Add point with z support
+        if(*it == *first) {
+            return true;
         }
     }
+    return false;
+}
 
-    // vector<unsigned short> m_indices
-    buffer->put(static_cast<GUInt32>(m_indices.size()));
-    for(auto index : m_indices) {
-        buffer->put(index);
+FeatureIDs FeatureIDs::intersection(const FeatureIDs &other) const
+{
+    FeatureIDs result;
+    std::set_intersection(m_ids.begin(), m_ids.end(),
+                          other.m_ids.begin(), other.m_ids.end(),
+                          std::back_inserter(result.m_ids));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// VectorTileItem
+//------------------------------------------------------------------------------
+
+/**
+ * @brief readArray Append count values from buffer to array with one copy.
+ * @param buffer Buffer to read.
+ * @param array Array to append values.
+ * @param count Values count.
+ * @return False if buffer has less than count values left.
+ */
+template<class T>
+static bool readArray(Buffer &buffer, std::vector<T> &array, GUInt32 count)
+{
+    if(count > buffer.remaining() / sizeof(T)) {
+        return false;
     }
+    size_t offset = array.size();
+    array.resize(offset + count);
+    return buffer.getArray(array.data() + offset, count);
+}
 
-    //vector<vector<unsigned short>> m_borderIndices
-    buffer->put(static_cast<GUInt32>(m_borderIndices.size()));
-    for(auto borderIndexArray : m_borderIndices) {
-        buffer->put(static_cast<GUInt32>(borderIndexArray.size()));
-        for(auto borderIndex : borderIndexArray) {
-            buffer->put(borderIndex);
+VectorTileItem::VectorTileItem() :
+     m_valid(false),
+     m_2d(true)
+{
+}
+
+VectorTileItem::VectorTileItem(const FlatVectorTileItem &item) :
+    m_points(item.points().begin(), item.points().end()),
+    m_indices(item.indices().begin(), item.indices().end()),
+    m_centroids(item.centroids().begin(), item.centroids().end()),
+    m_ids(item.ids().begin(), item.ids().end()),
+    m_valid(true),
+    m_2d(true)
+{
+    m_borderIndices.reserve(item.borderCount());
+    for(size_t i = 0; i < item.borderCount(); ++i) {
+        ArrayView<unsigned short> border = item.borderIndices(i);
+        m_borderIndices.push_back(
+                    std::vector<unsigned short>(border.begin(), border.end()));
+    }
+
+    size_t count = item.attributeCount();
+    if(count > 0) {
+        std::shared_ptr<TileAttributes> attributes(new TileAttributes);
+        attributes->columns = item.m_tile->columns();
+        attributes->values.resize(count);
+        attributes->nulls.resize(count);
+        for(size_t i = 0; i < count; ++i) {
+            attributes->nulls[i] = item.isAttributeNull(i);
+            if(!attributes->nulls[i]) {
+                attributes->values[i] = item.attributeString(i);
+            }
         }
+        m_attributes = attributes;
     }
+}
 
-    // vector<SimplePoint> m_centroids
-    buffer->put(static_cast<GUInt32>(m_centroids.size()));
-    for(auto centroid : m_centroids) {
-        if(m_2d) {
-            buffer->put(centroid.x);
-            buffer->put(centroid.y);
-        }
-        else {
-            // TODO: Add point with z support
-        }
+void VectorTileItem::removeId(GIntBig id)
+{
+    if(m_ids.erase(id) && m_ids.empty()) {
+        m_valid = false;
     }
+}
 
-    // set<GIntBig> m_ids
-    buffer->put(static_cast<GUInt32>(m_ids.size()));
-    for(auto id : m_ids) {
-        buffer->put(id);
+void VectorTileItem::addPoints(const std::vector<OGRRawPoint> &points)
+{
+    size_t offset = m_points.size();
+    m_points.resize(offset + points.size());
+    for(size_t i = 0; i < points.size(); ++i) {
+        m_points[offset + i] = { static_cast<float>(points[i].x),
+                                 static_cast<float>(points[i].y) };
+    }
+}
+
+void VectorTileItem::addBorderIndex(unsigned short ring, unsigned short index)
+{
+    if(m_borderIndices.size() <= ring) {
+       for(unsigned short i = static_cast<unsigned short>(m_borderIndices.size());
+           i < ring + 1; ++i) {
+            m_borderIndices.push_back(std::vector<unsigned short>());
+        }
     }
+    m_borderIndices[ring].push_back(index);
 }
 
 bool VectorTileItem::load(Buffer &buffer)
@@ -148,22 +304,15 @@ bool VectorTileItem::load(Buffer &buffer)
     m_2d = buffer.getByte();
     // vector<SimplePoint> m_points
     GUInt32 size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
-        if(m_2d) {
-            float x = buffer.getFloat();
-            float y = buffer.getFloat();
-            SimplePoint pt = {x, y};
-            m_points.push_back(pt);
-        }
-        else {
-            // TODO: Add point with z support
-        }
+    if(m_2d && !readArray(buffer, m_points, size)) {
+        return false;
     }
+    // TODO: Add point with z support
 
     // vector<unsigned short> m_indices
     size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
-        m_indices.push_back(buffer.getUShort());
+    if(!readArray(buffer, m_indices, size)) {
+        return false;
     }
 
     //vector<vector<unsigned short>> m_borderIndices
@@ -171,40 +320,62 @@ bool VectorTileItem::load(Buffer &buffer)
     for(GUInt32 i = 0; i < size; ++i) {
         GUInt32 size1 = buffer.getULong();
         std::vector<unsigned short> array;
-        for(GUInt32 j = 0; j < size1; ++j) {
-            array.push_back(buffer.getUShort());
+        if(!readArray(buffer, array, size1)) {
+            return false;
         }
         if(!array.empty()) {
-            m_borderIndices.push_back(array);
+            m_borderIndices.push_back(std::move(array));
         }
     }
 
     // vector<SimplePoint> m_centroids
     size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
-        if(m_2d) {
-            float x = buffer.getFloat();
-            float y = buffer.getFloat();
-            SimplePoint pt = {x, y};
-            m_centroids.push_back(pt);
-        }
-        else {
-            // TODO: Add point with z support
-        }
+    if(m_2d && !readArray(buffer, m_centroids, size)) {
+        return false;
     }
 
     // set<GIntBig> m_ids
     size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
-        m_ids.insert(buffer.getBig());
+    std::vector<GIntBig> ids;
+    if(!readArray(buffer, ids, size)) {
+        return false;
     }
+    m_ids = FeatureIDs(ids.begin(), ids.end());
 
     m_valid = true;
     return true;
 }
 
+/**
+ * @brief VectorTileItem::isSameAttributes Compare items attributes. Items of
+ * different features are merged on tile add only if their attributes are the
+ * same.
+ * @param other Item to compare with.
+ * @return True if both items have no attributes or the same values.
+ */
+bool VectorTileItem::isSameAttributes(const VectorTileItem &other) const
+{
+    if(m_attributes == other.m_attributes) {
+        return true;
+    }
+    if(!m_attributes || !other.m_attributes) {
+        return false;
+    }
+    const TileColumnsPtr &columns = m_attributes->columns;
+    const TileColumnsPtr &otherColumns = other.m_attributes->columns;
+    if(columns != otherColumns &&
+            (!columns || !otherColumns || !(*columns == *otherColumns))) {
+        return false;
+    }
+    return m_attributes->nulls == other.m_attributes->nulls &&
+            m_attributes->values == other.m_attributes->values;
+}
+
 bool VectorTileItem::isClosed() const
 {
+    if(m_points.empty()) {
+        return false;
+    }
     return isEqual(m_points.front().x, m_points.back().x) &&
             isEqual(m_points.front().y, m_points.back().y);
 }
@@ -216,36 +387,20 @@ void VectorTileItem::loadIds(const VectorTileItem &item)
     }
 }
 
-bool VectorTileItem::isIdsPresent(const std::set<GIntBig> &other, bool full) const
+bool VectorTileItem::isIdsPresent(const FeatureIDs &other, bool full) const
 {
     if(other.empty()) {
         return false;
     }
     if(full) {
-        return  std::includes(other.begin(), other.end(),
-                             m_ids.begin(), m_ids.end());
-    }
-    else {
-        for(auto id : other) {
-            if(m_ids.find(id) != m_ids.end()) {
-                return true;
-            }
-        }
-//        result = std::search(other.begin(), other.end(),
-//                           m_ids.begin(), m_ids.end()) != other.end();
+        return other.includes(m_ids.data(), m_ids.data() + m_ids.size());
     }
-
-    return false;
+    return other.intersects(m_ids.data(), m_ids.data() + m_ids.size());
 }
-std::set<GIntBig> VectorTileItem::idsIntesect(const std::set<GIntBig> &other) const
+
+FeatureIDs VectorTileItem::idsIntesect(const FeatureIDs &other) const
 {
-    std::set<GIntBig> common_data;
-    if(other.empty())
-        return common_data;
-    std::set_intersection(other.begin(), other.end(),
-                          m_ids.begin(), m_ids.end(),
-                          std::inserter(common_data, common_data.begin()));
-    return common_data;
+    return other.intersection(m_ids);
 }
 
 
@@ -271,64 +426,1269 @@ void VectorTile::add(const VectorTileItem &item, bool checkDuplicates)
         m_items.push_back(item);
     }
 
-    if(!m_valid) {
-        m_valid = !m_items.empty();
+    if(!m_valid) {
+        m_valid = !m_items.empty();
+    }
+}
+
+void VectorTile::add(VectorTileItem &&item, bool checkDuplicates)
+{
+    if(!item.isValid()) {
+        return;
+    }
+    if(checkDuplicates) {
+        auto it = std::find(m_items.begin(), m_items.end(), item);
+        if(it == m_items.end()) {
+            m_items.push_back(std::move(item));
+        }
+        else {
+            (*it).loadIds(item);
+        }
+    }
+    else {
+        m_items.push_back(std::move(item));
+    }
+
+    if(!m_valid) {
+        m_valid = !m_items.empty();
+    }
+}
+
+void VectorTile::add(const VectorTileItemArray &items, bool checkDuplicates)
+{
+    m_items.reserve(m_items.size() + items.size());
+    for(const auto &item : items) {
+        add(item, checkDuplicates);
+    }
+}
+
+void VectorTile::add(VectorTileItemArray &&items, bool checkDuplicates)
+{
+    if(m_items.empty() && !checkDuplicates) {
+        // Take the whole array without per item copy
+        items.erase(std::remove_if(items.begin(), items.end(),
+                                   [](const VectorTileItem &item) {
+                                       return !item.isValid(); }),
+                    items.end());
+        m_items = std::move(items);
+        m_valid = !m_items.empty();
+        return;
+    }
+
+    m_items.reserve(m_items.size() + items.size());
+    for(auto &item : items) {
+        add(std::move(item), checkDuplicates);
+    }
+    items.clear();
+}
+
+void VectorTile::add(VectorTile &&tile, bool checkDuplicates)
+{
+    add(std::move(tile.m_items), checkDuplicates);
+    tile.m_items.clear();
+    tile.m_valid = false;
+}
+
+void VectorTile::remove(GIntBig id)
+{
+    auto it = m_items.begin();
+    while(it != m_items.end()) {
+        (*it).removeId(id);
+        if((*it).isValid() == false) {
+            it = m_items.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void VectorTile::remove(const FeatureIDs &ids)
+{
+    if(ids.empty()) {
+        return;
+    }
+
+    auto it = m_items.begin();
+    while(it != m_items.end()) {
+        size_t count = (*it).m_ids.size();
+        (*it).m_ids.erase(ids);
+        if(count != (*it).m_ids.size() && (*it).m_ids.empty()) {
+            (*it).m_valid = false;
+        }
+        if((*it).isValid() == false) {
+            it = m_items.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief VectorTile::clusterPoints Merge point items in the grid cells of the
+ * extent to cluster items. Cluster point is the mean of the member points
+ * weighted by their features count, so clustered tile can be clustered again
+ * with new items. Cluster ids are the ids of all members and attributes are
+ * dropped. Cells with one item are not changed. Point items outside of the
+ * extent are removed as they are clustered by the neighbour tile. Items of
+ * other geometry types are kept.
+ * @param extent Tile extent.
+ * @param cells Grid cells count in one dimension.
+ */
+void VectorTile::clusterPoints(const Envelope &extent, unsigned short cells)
+{
+    if(0 == cells || extent.width() <= 0.0 || extent.height() <= 0.0) {
+        return;
+    }
+
+    typedef struct _cluster {
+        double x, y, weight;
+        size_t count;
+        std::vector<GIntBig> ids;
+        VectorTileItem first;
+    } Cluster;
+
+    std::map<size_t, Cluster> clusters;
+    VectorTileItemArray items;
+    for(VectorTileItem &item : m_items) {
+        if(item.pointCount() != 1 || !item.m_indices.empty()) {
+            items.push_back(std::move(item));
+            continue;
+        }
+
+        const SimplePoint &pt = item.point(0);
+        double x = (static_cast<double>(pt.x) - extent.minX()) / extent.width();
+        double y = (static_cast<double>(pt.y) - extent.minY()) / extent.height();
+        if(x < 0.0 || x >= 1.0 || y < 0.0 || y >= 1.0) {
+            continue;
+        }
+        size_t cellX = std::min(static_cast<size_t>(x * cells),
+                                static_cast<size_t>(cells - 1));
+        size_t cellY = std::min(static_cast<size_t>(y * cells),
+                                static_cast<size_t>(cells - 1));
+
+        Cluster &cluster = clusters[cellY * cells + cellX];
+        double weight = std::max(static_cast<size_t>(1), item.m_ids.size());
+        cluster.x += static_cast<double>(pt.x) * weight;
+        cluster.y += static_cast<double>(pt.y) * weight;
+        cluster.weight += weight;
+        cluster.ids.insert(cluster.ids.end(), item.m_ids.begin(),
+                           item.m_ids.end());
+        if(0 == cluster.count++) {
+            cluster.first = std::move(item);
+        }
+    }
+
+    for(auto &cell : clusters) {
+        Cluster &cluster = cell.second;
+        if(1 == cluster.count) {
+            items.push_back(std::move(cluster.first));
+            continue;
+        }
+
+        VectorTileItem item;
+        item.addPoint({static_cast<float>(cluster.x / cluster.weight),
+                       static_cast<float>(cluster.y / cluster.weight)});
+        item.m_ids = FeatureIDs(cluster.ids.begin(), cluster.ids.end());
+        item.m_valid = true;
+        items.push_back(std::move(item));
+    }
+
+    m_items = std::move(items);
+    m_valid = !m_items.empty();
+}
+
+BufferPtr VectorTile::save(bool quantize) const
+{
+    return FlatVectorTile(*this).save(quantize);
+}
+
+bool VectorTile::load(Buffer &buffer)
+{
+    size_t start = buffer.position();
+    GUInt32 size = buffer.getULong();
+    if(size == VECTOR_TILE_MAGIC || size == VECTOR_TILE_SWAPPED_MAGIC) {
+        buffer.seek(start);
+        FlatVectorTile flatTile;
+        if(!flatTile.load(buffer)) {
+            return false;
+        }
+        m_items.reserve(m_items.size() + flatTile.itemCount());
+        for(auto it = flatTile.begin(); it != flatTile.end(); ++it) {
+            m_items.push_back(VectorTileItem(*it));
+        }
+        m_valid = true;
+        return true;
+    }
+
+    // Version 1 blob
+    m_items.reserve(m_items.size() + size);
+    for(GUInt32 i = 0; i < size; ++i) {
+        VectorTileItem item;
+        item.load(buffer);
+        m_items.push_back(std::move(item));
+    }
+    m_valid = true;
+    return true;
+}
+
+bool VectorTile::empty() const
+{
+    if(!m_items.empty()) {
+        for(const auto &item : m_items) {
+            if(item.pointCount() > 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// FlatVectorTileItem
+//------------------------------------------------------------------------------
+
+FlatVectorTileItem::FlatVectorTileItem() :
+    m_borderOffsets(nullptr),
+    m_borderIndices(nullptr),
+    m_borderCount(0),
+    m_tile(nullptr),
+    m_attributes(nullptr)
+{
+}
+
+bool FlatVectorTileItem::isClosed() const
+{
+    if(m_points.empty()) {
+        return false;
+    }
+    return isEqual(m_points[0].x, m_points[m_points.size() - 1].x) &&
+            isEqual(m_points[0].y, m_points[m_points.size() - 1].y);
+}
+
+bool FlatVectorTileItem::isIdsPresent(const FeatureIDs &other, bool full) const
+{
+    if(other.empty()) {
+        return false;
+    }
+    // Item ids are sorted as they come from the VectorTileItem
+    if(full) {
+        return other.includes(m_ids.begin(), m_ids.end());
+    }
+    return other.intersects(m_ids.begin(), m_ids.end());
+}
+
+size_t FlatVectorTileItem::attributeCount() const
+{
+    return nullptr == m_attributes ? 0 : m_tile->columnCount();
+}
+
+/**
+ * @brief FlatVectorTileItem::attributeString Item attribute value as stored.
+ * @param column Tile column index.
+ * @return Value or empty string for null.
+ */
+const std::string &FlatVectorTileItem::attributeString(size_t column) const
+{
+    static const std::string empty;
+    if(isAttributeNull(column)) {
+        return empty;
+    }
+    return m_tile->m_dictionaries[column][m_attributes[column] - 1];
+}
+
+/**
+ * @brief FlatVectorTileItem::attributeNumber Item attribute value as number.
+ * Values of number columns are parsed once per tile.
+ * @param column Tile column index.
+ * @return Value or 0 for null.
+ */
+double FlatVectorTileItem::attributeNumber(size_t column) const
+{
+    if(isAttributeNull(column)) {
+        return 0.0;
+    }
+    GUInt32 index = m_attributes[column] - 1;
+    if((*m_tile->m_columns)[column].type == TileColumnType::NUMBER) {
+        return m_tile->m_numbers[column][index];
+    }
+    return CPLAtof(m_tile->m_dictionaries[column][index].c_str());
+}
+
+//------------------------------------------------------------------------------
+// FlatVectorTile
+//------------------------------------------------------------------------------
+
+template<class T>
+static ArrayView<T> vectorView(const std::vector<T> &array)
+{
+    return ArrayView<T>(array.data(), array.size());
+}
+
+template<class T>
+static void putArray(Buffer *buffer, const ArrayView<T> &array)
+{
+    buffer->putArray(array.data(), array.size());
+}
+
+static size_t alignedSize(size_t size)
+{
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+constexpr double QUANTIZE_MAX = 65535.0;
+
+// Version 3 blob: goes after the header, point = min + quantized * scale
+typedef struct _quantization {
+    double minX;
+    double minY;
+    double scaleX;
+    double scaleY;
+} Quantization;
+
+typedef struct _quantizedPoint {
+    GUInt16 x;
+    GUInt16 y;
+} QuantizedPoint;
+
+static void extendBounds(const ArrayView<SimplePoint> &points, Envelope &env)
+{
+    for(const SimplePoint &pt : points) {
+        env.setMinX(std::min(env.minX(), static_cast<double>(pt.x)));
+        env.setMinY(std::min(env.minY(), static_cast<double>(pt.y)));
+        env.setMaxX(std::max(env.maxX(), static_cast<double>(pt.x)));
+        env.setMaxY(std::max(env.maxY(), static_cast<double>(pt.y)));
+    }
+}
+
+static Quantization quantization(const ArrayView<SimplePoint> &points,
+                                 const ArrayView<SimplePoint> &centroids)
+{
+    Envelope env(BIG_VALUE, BIG_VALUE, -BIG_VALUE, -BIG_VALUE);
+    extendBounds(points, env);
+    extendBounds(centroids, env);
+
+    Quantization out = { 0.0, 0.0, 1.0, 1.0 };
+    if(env.minX() > env.maxX()) {
+        return out;
+    }
+    out.minX = env.minX();
+    out.minY = env.minY();
+    if(env.width() > 0.0) {
+        out.scaleX = env.width() / QUANTIZE_MAX;
+    }
+    if(env.height() > 0.0) {
+        out.scaleY = env.height() / QUANTIZE_MAX;
+    }
+    return out;
+}
+
+static GUInt16 quantize(double value, double min, double scale)
+{
+    double out = std::round((value - min) / scale);
+    return static_cast<GUInt16>(std::max(0.0, std::min(out, QUANTIZE_MAX)));
+}
+
+static void putQuantized(Buffer *buffer, const ArrayView<SimplePoint> &points,
+                         const Quantization &q)
+{
+    std::vector<QuantizedPoint> out(points.size());
+    for(size_t i = 0; i < points.size(); ++i) {
+        out[i].x = quantize(points[i].x, q.minX, q.scaleX);
+        out[i].y = quantize(points[i].y, q.minY, q.scaleY);
+    }
+    buffer->putArray(out.data(), out.size());
+}
+
+static void dequantize(const GByte *data, size_t count, const Quantization &q,
+                       std::vector<SimplePoint> &points)
+{
+    const QuantizedPoint *qpoints = reinterpret_cast<const QuantizedPoint*>(data);
+    points.resize(count);
+    for(size_t i = 0; i < count; ++i) {
+        points[i].x = static_cast<float>(q.minX + qpoints[i].x * q.scaleX);
+        points[i].y = static_cast<float>(q.minY + qpoints[i].y * q.scaleY);
+    }
+}
+
+FlatVectorTile::FlatVectorTile() :
+    m_borderOffsets(1, 0),
+    m_valid(false)
+{
+    updateViews();
+}
+
+FlatVectorTile::FlatVectorTile(const VectorTile &tile) :
+    m_borderOffsets(1, 0),
+    m_valid(false)
+{
+    add(tile.items());
+    m_valid = tile.isValid();
+}
+
+FlatVectorTile::FlatVectorTile(const FlatVectorTile &other) :
+    m_items(other.m_items),
+    m_points(other.m_points),
+    m_indices(other.m_indices),
+    m_borderOffsets(other.m_borderOffsets),
+    m_borderIndices(other.m_borderIndices),
+    m_centroids(other.m_centroids),
+    m_ids(other.m_ids),
+    m_holder(other.m_holder),
+    m_columns(other.m_columns),
+    m_dictionaries(other.m_dictionaries),
+    m_numbers(other.m_numbers),
+    m_attributeIndices(other.m_attributeIndices),
+    m_valid(other.m_valid)
+{
+    if(m_holder) {
+        m_itemsView = other.m_itemsView;
+        m_pointsView = other.m_pointsView;
+        m_indicesView = other.m_indicesView;
+        m_borderOffsetsView = other.m_borderOffsetsView;
+        m_borderIndicesView = other.m_borderIndicesView;
+        m_centroidsView = other.m_centroidsView;
+        m_idsView = other.m_idsView;
+        // Points of version 3 blob are decoded, not in place
+        if(other.m_pointsView.data() == other.m_points.data()) {
+            m_pointsView = vectorView(m_points);
+        }
+        if(other.m_centroidsView.data() == other.m_centroids.data()) {
+            m_centroidsView = vectorView(m_centroids);
+        }
+    }
+    else {
+        updateViews();
+    }
+}
+
+FlatVectorTile &FlatVectorTile::operator=(const FlatVectorTile &other)
+{
+    if(this != &other) {
+        FlatVectorTile copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+void FlatVectorTile::updateViews()
+{
+    m_itemsView = vectorView(m_items);
+    m_pointsView = vectorView(m_points);
+    m_indicesView = vectorView(m_indices);
+    m_borderOffsetsView = vectorView(m_borderOffsets);
+    m_borderIndicesView = vectorView(m_borderIndices);
+    m_centroidsView = vectorView(m_centroids);
+    m_idsView = vectorView(m_ids);
+}
+
+void FlatVectorTile::detach()
+{
+    if(!m_holder) {
+        return;
+    }
+
+    m_items.assign(m_itemsView.begin(), m_itemsView.end());
+    if(m_pointsView.data() != m_points.data()) {
+        m_points.assign(m_pointsView.begin(), m_pointsView.end());
+    }
+    m_indices.assign(m_indicesView.begin(), m_indicesView.end());
+    m_borderOffsets.assign(m_borderOffsetsView.begin(),
+                           m_borderOffsetsView.end());
+    m_borderIndices.assign(m_borderIndicesView.begin(),
+                           m_borderIndicesView.end());
+    if(m_centroidsView.data() != m_centroids.data()) {
+        m_centroids.assign(m_centroidsView.begin(), m_centroidsView.end());
+    }
+    m_ids.assign(m_idsView.begin(), m_idsView.end());
+    m_holder.reset();
+    updateViews();
+}
+
+void FlatVectorTile::add(const VectorTileItem &item)
+{
+    if(!item.isValid()) {
+        return;
+    }
+
+    detach();
+
+    ItemOffsets offsets;
+    offsets.pointOffset = static_cast<GUInt32>(m_points.size());
+    offsets.pointCount = static_cast<GUInt32>(item.m_points.size());
+    m_points.insert(m_points.end(), item.m_points.begin(), item.m_points.end());
+
+    offsets.indexOffset = static_cast<GUInt32>(m_indices.size());
+    offsets.indexCount = static_cast<GUInt32>(item.m_indices.size());
+    m_indices.insert(m_indices.end(), item.m_indices.begin(),
+                     item.m_indices.end());
+
+    offsets.borderOffset = static_cast<GUInt32>(m_borderOffsets.size() - 1);
+    offsets.borderCount = 0;
+    for(const auto &border : item.m_borderIndices) {
+        if(border.empty()) {
+            continue;
+        }
+        m_borderIndices.insert(m_borderIndices.end(), border.begin(),
+                               border.end());
+        m_borderOffsets.push_back(static_cast<GUInt32>(m_borderIndices.size()));
+        offsets.borderCount++;
+    }
+
+    offsets.centroidOffset = static_cast<GUInt32>(m_centroids.size());
+    offsets.centroidCount = static_cast<GUInt32>(item.m_centroids.size());
+    m_centroids.insert(m_centroids.end(), item.m_centroids.begin(),
+                       item.m_centroids.end());
+
+    offsets.idOffset = static_cast<GUInt32>(m_ids.size());
+    offsets.idCount = static_cast<GUInt32>(item.m_ids.size());
+    m_ids.insert(m_ids.end(), item.m_ids.begin(), item.m_ids.end());
+
+    addAttributes(item.m_attributes);
+    m_items.push_back(offsets);
+    m_valid = true;
+    updateViews();
+}
+
+void FlatVectorTile::add(const VectorTileItemArray &items)
+{
+    detach();
+    m_items.reserve(m_items.size() + items.size());
+    for(const auto &item : items) {
+        add(item);
+    }
+}
+
+/**
+ * @brief FlatVectorTile::addAttributes Add the item row of column value
+ * indices. The first item with attributes sets the tile columns, items with
+ * other columns get nulls.
+ * @param attributes Item attributes or empty pointer.
+ */
+void FlatVectorTile::addAttributes(const TileAttributesPtr &attributes)
+{
+    if(!m_columns) {
+        if(!attributes || !attributes->columns ||
+                attributes->columns->empty()) {
+            return;
+        }
+        m_columns = attributes->columns;
+        m_dictionaries.assign(m_columns->size(), std::vector<std::string>());
+        m_numbers.assign(m_columns->size(), std::vector<double>());
+        // Items added before have no attributes
+        m_attributeIndices.assign(m_items.size() * m_columns->size(), 0);
+    }
+
+    size_t count = m_columns->size();
+    if(m_dictionaryIndices.size() != count) {
+        m_dictionaryIndices.assign(
+                    count, std::unordered_map<std::string, GUInt32>());
+        for(size_t i = 0; i < count; ++i) {
+            for(size_t j = 0; j < m_dictionaries[i].size(); ++j) {
+                m_dictionaryIndices[i][m_dictionaries[i][j]] =
+                        static_cast<GUInt32>(j);
+            }
+        }
+    }
+
+    bool sameColumns = attributes && attributes->columns &&
+            (attributes->columns == m_columns ||
+             *attributes->columns == *m_columns);
+    for(size_t i = 0; i < count; ++i) {
+        if(!sameColumns || attributes->nulls[i]) {
+            m_attributeIndices.push_back(0);
+            continue;
+        }
+
+        const std::string &value = attributes->values[i];
+        auto result = m_dictionaryIndices[i].insert(
+                    std::make_pair(value, static_cast<GUInt32>(
+                                       m_dictionaries[i].size())));
+        if(result.second) {
+            m_dictionaries[i].push_back(value);
+            if((*m_columns)[i].type == TileColumnType::NUMBER) {
+                m_numbers[i].push_back(CPLAtof(value.c_str()));
+            }
+        }
+        m_attributeIndices.push_back(result.first->second + 1);
+    }
+}
+
+/**
+ * @brief FlatVectorTile::columnIndex Find tile column by feature field name.
+ * @param name Field name.
+ * @return Column index or -1.
+ */
+int FlatVectorTile::columnIndex(const std::string &name) const
+{
+    if(!m_columns) {
+        return -1;
+    }
+    for(size_t i = 0; i < m_columns->size(); ++i) {
+        if((*m_columns)[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool FlatVectorTile::load(Buffer &buffer)
+{
+    size_t start = buffer.position();
+    GUInt32 value = buffer.getULong();
+    if(value == VECTOR_TILE_SWAPPED_MAGIC) {
+        CPLError(CE_Warning, CPLE_AppDefined,
+                 "Vector tile byte order differs from host one");
+        return false;
+    }
+    if(value != VECTOR_TILE_MAGIC) {
+        return loadVersion1(buffer, value);
+    }
+
+    // Version 2 or 3 blob from the memory not owned by tile, so copy it
+    const GByte *data = buffer.data() + start;
+    size_t size = static_cast<size_t>(buffer.size()) - start;
+    std::vector<GIntBig> alignedData;
+    if(reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+        alignedData.resize(alignedSize(size) / sizeof(GIntBig));
+        std::memcpy(alignedData.data(), data, size);
+        data = reinterpret_cast<const GByte*>(alignedData.data());
+    }
+
+    FlatVectorTile attached;
+    if(!attached.attach(data, size,
+                        std::shared_ptr<void>(const_cast<GByte*>(data),
+                                              [](void*){}))) {
+        return false;
+    }
+    attached.detach();
+    *this = std::move(attached);
+    buffer.seek(start + size);
+    return true;
+}
+
+bool FlatVectorTile::loadVersion1(Buffer &buffer, GUInt32 itemCount)
+{
+    detach();
+    // The same layout as VectorTileItem::save writes
+    m_items.reserve(m_items.size() + itemCount);
+    for(GUInt32 i = 0; i < itemCount; ++i) {
+        ItemOffsets offsets;
+        bool is2d = buffer.getByte() != 0;
+
+        // vector<SimplePoint> m_points
+        GUInt32 size = buffer.getULong();
+        offsets.pointOffset = static_cast<GUInt32>(m_points.size());
+        if(is2d && !readArray(buffer, m_points, size)) {
+            return false;
+        }
+        // TODO: Add point with z support
+        offsets.pointCount = static_cast<GUInt32>(m_points.size()) -
+                offsets.pointOffset;
+
+        // vector<unsigned short> m_indices
+        size = buffer.getULong();
+        offsets.indexOffset = static_cast<GUInt32>(m_indices.size());
+        offsets.indexCount = size;
+        if(!readArray(buffer, m_indices, size)) {
+            return false;
+        }
+
+        //vector<vector<unsigned short>> m_borderIndices
+        size = buffer.getULong();
+        offsets.borderOffset = static_cast<GUInt32>(m_borderOffsets.size() - 1);
+        offsets.borderCount = 0;
+        for(GUInt32 j = 0; j < size; ++j) {
+            GUInt32 ringSize = buffer.getULong();
+            if(!readArray(buffer, m_borderIndices, ringSize)) {
+                return false;
+            }
+            if(ringSize > 0) {
+                m_borderOffsets.push_back(
+                            static_cast<GUInt32>(m_borderIndices.size()));
+                offsets.borderCount++;
+            }
+        }
+
+        // vector<SimplePoint> m_centroids
+        size = buffer.getULong();
+        offsets.centroidOffset = static_cast<GUInt32>(m_centroids.size());
+        if(is2d && !readArray(buffer, m_centroids, size)) {
+            return false;
+        }
+        offsets.centroidCount = static_cast<GUInt32>(m_centroids.size()) -
+                offsets.centroidOffset;
+
+        // set<GIntBig> m_ids
+        size = buffer.getULong();
+        offsets.idOffset = static_cast<GUInt32>(m_ids.size());
+        offsets.idCount = size;
+        if(!readArray(buffer, m_ids, size)) {
+            return false;
+        }
+
+        m_items.push_back(offsets);
+    }
+
+    m_valid = true;
+    updateViews();
+    return true;
+}
+
+bool FlatVectorTile::attach(const GByte *data, size_t size,
+                            const std::shared_ptr<void> &holder)
+{
+    if(nullptr == data || size < sizeof(Header) ||
+            reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header*>(data);
+    if(header->magic == VECTOR_TILE_SWAPPED_MAGIC) {
+        CPLError(CE_Warning, CPLE_AppDefined,
+                 "Vector tile byte order differs from host one");
+        return false;
+    }
+    bool quantized = header->version == VECTOR_TILE_QUANTIZED_VERSION;
+    if(header->magic != VECTOR_TILE_MAGIC ||
+            (header->version != VECTOR_TILE_VERSION && !quantized)) {
+        return false;
+    }
+
+    // Sections go from the biggest alignment to the smallest one
+    size_t pointSize = quantized ? sizeof(QuantizedPoint) : sizeof(SimplePoint);
+    size_t idsPos = sizeof(Header) + (quantized ? sizeof(Quantization) : 0);
+    size_t itemsPos = idsPos + header->idCount * sizeof(GIntBig);
+    size_t pointsPos = itemsPos + header->itemCount * sizeof(ItemOffsets);
+    size_t centroidsPos = pointsPos + header->pointCount * pointSize;
+    size_t borderOffsetsPos = centroidsPos + header->centroidCount * pointSize;
+    size_t indicesPos = borderOffsetsPos +
+            (header->borderCount + 1) * sizeof(GUInt32);
+    size_t borderIndicesPos = indicesPos +
+            header->indexCount * sizeof(unsigned short);
+    if(blobSize(*header) != size) {
+        CPLError(CE_Warning, CPLE_AppDefined, "Unexpected vector tile size");
+        return false;
+    }
+    // Damaged blob from the cache must not lead to reads out of it on draw
+    if(!checkItems(*header,
+                   reinterpret_cast<const ItemOffsets*>(data + itemsPos),
+                   reinterpret_cast<const GUInt32*>(data + borderOffsetsPos),
+                   reinterpret_cast<const unsigned short*>(data + indicesPos),
+                   reinterpret_cast<const unsigned short*>(data + borderIndicesPos))) {
+        CPLError(CE_Warning, CPLE_AppDefined, "Unexpected vector tile offsets");
+        return false;
+    }
+    if(!loadAttributes(data + size - header->attributesSize,
+                       header->attributesSize, header->itemCount)) {
+        CPLError(CE_Warning, CPLE_AppDefined,
+                 "Unexpected vector tile attributes");
+        return false;
+    }
+
+    m_items.clear();
+    m_points.clear();
+    m_indices.clear();
+    m_borderOffsets.clear();
+    m_borderIndices.clear();
+    m_centroids.clear();
+    m_ids.clear();
+
+    m_idsView = ArrayView<GIntBig>(
+                reinterpret_cast<const GIntBig*>(data + idsPos),
+                header->idCount);
+    m_itemsView = ArrayView<ItemOffsets>(
+                reinterpret_cast<const ItemOffsets*>(data + itemsPos),
+                header->itemCount);
+    if(quantized) {
+        const Quantization *q =
+                reinterpret_cast<const Quantization*>(data + sizeof(Header));
+        dequantize(data + pointsPos, header->pointCount, *q, m_points);
+        dequantize(data + centroidsPos, header->centroidCount, *q, m_centroids);
+        m_pointsView = vectorView(m_points);
+        m_centroidsView = vectorView(m_centroids);
+    }
+    else {
+        m_pointsView = ArrayView<SimplePoint>(
+                    reinterpret_cast<const SimplePoint*>(data + pointsPos),
+                    header->pointCount);
+        m_centroidsView = ArrayView<SimplePoint>(
+                    reinterpret_cast<const SimplePoint*>(data + centroidsPos),
+                    header->centroidCount);
+    }
+    m_borderOffsetsView = ArrayView<GUInt32>(
+                reinterpret_cast<const GUInt32*>(data + borderOffsetsPos),
+                header->borderCount + 1);
+    m_indicesView = ArrayView<unsigned short>(
+                reinterpret_cast<const unsigned short*>(data + indicesPos),
+                header->indexCount);
+    m_borderIndicesView = ArrayView<unsigned short>(
+                reinterpret_cast<const unsigned short*>(data + borderIndicesPos),
+                header->borderIndexCount);
+    m_holder = holder;
+    m_valid = true;
+    return true;
+}
+
+/**
+ * @brief FlatVectorTile::checkItems Check the blob arrays refer inside each
+ * other: item ranges are inside the arrays, border offsets grow and are inside
+ * border indices, triangle and border indices are less than item point count.
+ * @param header Blob header.
+ * @param items Blob items.
+ * @param borderOffsets Blob border offsets, header.borderCount + 1 values.
+ * @param indices Blob triangle indices.
+ * @param borderIndices Blob border indices.
+ * @return True if the arrays are consistent.
+ */
+bool FlatVectorTile::checkItems(const Header &header, const ItemOffsets *items,
+                                const GUInt32 *borderOffsets,
+                                const unsigned short *indices,
+                                const unsigned short *borderIndices)
+{
+    auto inside = [](GUInt32 offset, GUInt32 count, GUInt32 size) {
+        return static_cast<GUIntBig>(offset) + count <= size;
+    };
+
+    for(GUInt32 i = 0; i < header.borderCount; ++i) {
+        if(borderOffsets[i] > borderOffsets[i + 1]) {
+            return false;
+        }
+    }
+    if(borderOffsets[header.borderCount] > header.borderIndexCount) {
+        return false;
+    }
+
+    for(GUInt32 i = 0; i < header.itemCount; ++i) {
+        const ItemOffsets &item = items[i];
+        if(!inside(item.pointOffset, item.pointCount, header.pointCount) ||
+                !inside(item.indexOffset, item.indexCount, header.indexCount) ||
+                !inside(item.borderOffset, item.borderCount,
+                        header.borderCount) ||
+                !inside(item.centroidOffset, item.centroidCount,
+                        header.centroidCount) ||
+                !inside(item.idOffset, item.idCount, header.idCount)) {
+            return false;
+        }
+
+        // Indices are relative to the item points
+        for(GUInt32 j = 0; j < item.indexCount; ++j) {
+            if(indices[item.indexOffset + j] >= item.pointCount) {
+                return false;
+            }
+        }
+        GUInt32 borderEnd = borderOffsets[item.borderOffset + item.borderCount];
+        for(GUInt32 j = borderOffsets[item.borderOffset]; j < borderEnd; ++j) {
+            if(borderIndices[j] >= item.pointCount) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief FlatVectorTile::blobSize Size of the version 2 or 3 blob with the
+ * header counts including the trailing padding.
+ * @param header Blob header.
+ * @return Blob size in bytes.
+ */
+size_t FlatVectorTile::blobSize(const Header &header)
+{
+    bool quantized = header.version == VECTOR_TILE_QUANTIZED_VERSION;
+    size_t pointSize = quantized ? sizeof(QuantizedPoint) : sizeof(SimplePoint);
+    size_t size = sizeof(Header) + (quantized ? sizeof(Quantization) : 0) +
+            header.idCount * sizeof(GIntBig) +
+            header.itemCount * sizeof(ItemOffsets) +
+            (header.pointCount + header.centroidCount) * pointSize +
+            (header.borderCount + 1) * sizeof(GUInt32) +
+            (header.indexCount + header.borderIndexCount) *
+            sizeof(unsigned short);
+    return alignedSize(size) + header.attributesSize;
+}
+
+/**
+ * @brief FlatVectorTile::save Save tile to blob.
+ * @param quantize If true, points are stored as 16 bit integers (version 3
+ * blob). It is half the points size and enough for tile sized extent, but the
+ * points have to be decoded by attach().
+ * @return Blob buffer
+ */
+BufferPtr FlatVectorTile::save(bool quantize) const
+{
+    Header header;
+    header.magic = VECTOR_TILE_MAGIC;
+    header.version = quantize ? VECTOR_TILE_QUANTIZED_VERSION :
+                                VECTOR_TILE_VERSION;
+    header.itemCount = static_cast<GUInt32>(m_itemsView.size());
+    header.pointCount = static_cast<GUInt32>(m_pointsView.size());
+    header.indexCount = static_cast<GUInt32>(m_indicesView.size());
+    header.borderCount = static_cast<GUInt32>(m_borderOffsetsView.size() - 1);
+    header.borderIndexCount = static_cast<GUInt32>(m_borderIndicesView.size());
+    header.centroidCount = static_cast<GUInt32>(m_centroidsView.size());
+    header.idCount = static_cast<GUInt32>(m_idsView.size());
+    BufferPtr attributes = saveAttributes();
+    header.attributesSize = attributes ?
+                static_cast<GUInt32>(alignedSize(
+                                         static_cast<size_t>(attributes->size()))) :
+                0;
+
+    BufferPtr buff(new Buffer(blobSize(header)));
+    buff->put(&header, sizeof(Header));
+    Quantization q = { 0.0, 0.0, 1.0, 1.0 };
+    if(quantize) {
+        q = quantization(m_pointsView, m_centroidsView);
+        buff->put(&q, sizeof(Quantization));
+    }
+    putArray(buff.get(), m_idsView);
+    putArray(buff.get(), m_itemsView);
+    if(quantize) {
+        putQuantized(buff.get(), m_pointsView, q);
+        putQuantized(buff.get(), m_centroidsView, q);
+    }
+    else {
+        putArray(buff.get(), m_pointsView);
+        putArray(buff.get(), m_centroidsView);
+    }
+    putArray(buff.get(), m_borderOffsetsView);
+    putArray(buff.get(), m_indicesView);
+    putArray(buff.get(), m_borderIndicesView);
+
+    // Pad to 8 bytes so the next blob in memory is aligned too
+    const GByte padding[8] = {0};
+    size_t size = static_cast<size_t>(buff->size());
+    buff->put(padding, alignedSize(size) - size);
+    if(attributes) {
+        size = static_cast<size_t>(attributes->size());
+        buff->put(attributes->data(), size);
+        buff->put(padding, alignedSize(size) - size);
+    }
+    return buff;
+}
+
+/**
+ * @brief FlatVectorTile::saveAttributes Write attributes section: column
+ * count, then type, name and dictionary values of each column, then the
+ * column value indices of each item. Strings are stored as size and chars.
+ * @return Attributes section without padding or empty pointer if tile has no
+ * attributes.
+ */
+BufferPtr FlatVectorTile::saveAttributes() const
+{
+    if(!m_columns) {
+        return BufferPtr();
+    }
+
+    auto putString = [](Buffer *buffer, const std::string &value) {
+        buffer->put(static_cast<GUInt32>(value.size()));
+        buffer->put(value.data(), value.size());
+    };
+
+    BufferPtr buff(new Buffer(m_attributeIndices.size() * sizeof(GUInt32)));
+    buff->put(static_cast<GUInt32>(m_columns->size()));
+    for(size_t i = 0; i < m_columns->size(); ++i) {
+        buff->put(static_cast<GUInt32>((*m_columns)[i].type));
+        putString(buff.get(), (*m_columns)[i].name);
+        buff->put(static_cast<GUInt32>(m_dictionaries[i].size()));
+        for(const std::string &value : m_dictionaries[i]) {
+            putString(buff.get(), value);
+        }
+    }
+    buff->putArray(m_attributeIndices.data(), m_attributeIndices.size());
+    return buff;
+}
+
+/**
+ * @brief FlatVectorTile::loadAttributes Decode attributes section written by
+ * saveAttributes().
+ * @param data Section data.
+ * @param size Section size including padding. Zero if blob has no attributes.
+ * @param itemCount Blob items count.
+ * @return False if section is invalid, else tile attributes are replaced.
+ */
+bool FlatVectorTile::loadAttributes(const GByte *data, size_t size,
+                                    GUInt32 itemCount)
+{
+    std::shared_ptr<TileColumns> columns;
+    std::vector<std::vector<std::string>> dictionaries;
+    std::vector<std::vector<double>> numbers;
+    std::vector<GUInt32> indices;
+    if(size > 0) {
+        Buffer buffer(const_cast<GByte*>(data), static_cast<int>(size), false);
+        auto getString = [&buffer](std::string &out) {
+            GUInt32 length = buffer.getULong();
+            const GByte *chars = buffer.view(length);
+            if(nullptr == chars) {
+                return false;
+            }
+            out.assign(reinterpret_cast<const char*>(chars), length);
+            return true;
+        };
+
+        GUInt32 columnCount = buffer.getULong();
+        if(0 == columnCount ||
+                columnCount > buffer.remaining() / (3 * sizeof(GUInt32))) {
+            return false;
+        }
+        columns.reset(new TileColumns(columnCount));
+        dictionaries.resize(columnCount);
+        numbers.resize(columnCount);
+        for(GUInt32 i = 0; i < columnCount; ++i) {
+            TileColumn &column = (*columns)[i];
+            column.type = buffer.getULong() == 0 ? TileColumnType::STRING :
+                                                   TileColumnType::NUMBER;
+            if(!getString(column.name)) {
+                return false;
+            }
+            GUInt32 valueCount = buffer.getULong();
+            if(valueCount > buffer.remaining() / sizeof(GUInt32)) {
+                return false;
+            }
+            dictionaries[i].resize(valueCount);
+            for(GUInt32 j = 0; j < valueCount; ++j) {
+                if(!getString(dictionaries[i][j])) {
+                    return false;
+                }
+            }
+            if(column.type == TileColumnType::NUMBER) {
+                numbers[i].reserve(valueCount);
+                for(const std::string &value : dictionaries[i]) {
+                    numbers[i].push_back(CPLAtof(value.c_str()));
+                }
+            }
+        }
+
+        size_t indexCount = static_cast<size_t>(itemCount) * columnCount;
+        if(!readArray(buffer, indices, static_cast<GUInt32>(indexCount))) {
+            return false;
+        }
+        for(size_t i = 0; i < indexCount; ++i) {
+            if(indices[i] > dictionaries[i % columnCount].size()) {
+                return false;
+            }
+        }
+    }
+
+    m_columns = columns;
+    m_dictionaries = std::move(dictionaries);
+    m_numbers = std::move(numbers);
+    m_attributeIndices = std::move(indices);
+    m_dictionaryIndices.clear();
+    return true;
+}
+
+size_t FlatVectorTile::dataSize() const
+{
+    return sizeof(FlatVectorTile) +
+            m_itemsView.size() * sizeof(ItemOffsets) +
+            m_pointsView.size() * sizeof(SimplePoint) +
+            m_indicesView.size() * sizeof(unsigned short) +
+            m_borderOffsetsView.size() * sizeof(GUInt32) +
+            m_borderIndicesView.size() * sizeof(unsigned short) +
+            m_centroidsView.size() * sizeof(SimplePoint) +
+            m_idsView.size() * sizeof(GIntBig) +
+            m_attributeIndices.size() * sizeof(GUInt32);
+}
+
+FlatVectorTileItem FlatVectorTile::item(size_t index) const
+{
+    const ItemOffsets &offsets = m_itemsView[index];
+    FlatVectorTileItem out;
+    out.m_points = ArrayView<SimplePoint>(
+                m_pointsView.data() + offsets.pointOffset, offsets.pointCount);
+    out.m_indices = ArrayView<unsigned short>(
+                m_indicesView.data() + offsets.indexOffset, offsets.indexCount);
+    out.m_borderOffsets = m_borderOffsetsView.data() + offsets.borderOffset;
+    out.m_borderIndices = m_borderIndicesView.data();
+    out.m_borderCount = offsets.borderCount;
+    out.m_centroids = ArrayView<SimplePoint>(
+                m_centroidsView.data() + offsets.centroidOffset,
+                offsets.centroidCount);
+    out.m_ids = ArrayView<GIntBig>(m_idsView.data() + offsets.idOffset,
+                                   offsets.idCount);
+    out.m_tile = this;
+    if(m_columns) {
+        out.m_attributes = m_attributeIndices.data() +
+                index * m_columns->size();
     }
+    return out;
 }
 
-void VectorTile::add(const VectorTileItemArray &items, bool checkDuplicates)
+//------------------------------------------------------------------------------
+// Tile blob compression
+//------------------------------------------------------------------------------
+
+typedef struct _compressedHeader {
+    GUInt32 magic;
+    GUInt32 compression;
+    GUInt32 size;
+    GUInt32 reserved;
+} CompressedHeader;
+
+TileCompression tileCompressionFromString(const std::string &name)
 {
-    for(const auto &item : items) {
-        add(item, checkDuplicates);
+    if(compare(name, "DEFLATE")) {
+        return TileCompression::DEFLATE;
+    }
+    if(compare(name, "ZSTD")) {
+        return TileCompression::ZSTD;
+    }
+    if(compare(name, "LZ4")) {
+        return TileCompression::LZ4;
     }
+    return TileCompression::NONE;
 }
 
-void VectorTile::remove(GIntBig id)
+const char *tileCompressionToString(TileCompression compression)
 {
-    auto it = m_items.begin();
-    while(it != m_items.end()) {
-        (*it).removeId(id);
-        if((*it).isValid() == false) {
-            it = m_items.erase(it);
-        }
-        else {
-            ++it;
-        }
+    switch(compression) {
+    case TileCompression::DEFLATE:
+        return "DEFLATE";
+    case TileCompression::ZSTD:
+        return "ZSTD";
+    case TileCompression::LZ4:
+        return "LZ4";
+    default:
+        return "NONE";
     }
 }
 
-BufferPtr VectorTile::save()
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+static const char *compressorId(TileCompression compression)
 {
-    BufferPtr buff(new Buffer);
-    buff->put(static_cast<GUInt32>(m_items.size()));
-    for(auto item : m_items) {
-        item.save(buff.get());
-    }
-    return buff;
+    return compression == TileCompression::ZSTD ? "zstd" : "lz4";
 }
+#endif
 
-bool VectorTile::load(Buffer &buffer)
+/**
+ * @brief isTileCompressionAvailable Check if GDAL is built with codec. Deflate
+ * is always present, ZSTD and LZ4 need GDAL 3.4 compressors API and the
+ * libraries.
+ * @param compression Codec
+ * @return true if tiles can be compressed and decompressed with this codec.
+ */
+bool isTileCompressionAvailable(TileCompression compression)
 {
-    GUInt32 size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
-        VectorTileItem item;
-        item.load(buffer);
-        m_items.push_back(item);
+    switch(compression) {
+    case TileCompression::NONE:
+    case TileCompression::DEFLATE:
+        return true;
+    default:
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+        return CPLGetCompressor(compressorId(compression)) != nullptr &&
+                CPLGetDecompressor(compressorId(compression)) != nullptr;
+#else
+        return false;
+#endif
     }
-    m_valid = true;
-    return true;
 }
 
-bool VectorTile::empty() const
+/**
+ * @brief compressTileBlob Compress vector tile blob.
+ * @param blob Blob from FlatVectorTile::save
+ * @param compression Codec
+ * @return Compressed blob or the same blob if codec is not available or the
+ * data not compressible.
+ */
+BufferPtr compressTileBlob(const BufferPtr &blob, TileCompression compression)
 {
-    if(!m_items.empty()) {
-        for(auto item : m_items) {
-            if(item.pointCount() > 0) {
-                return false;
-            }
+    if(!blob || TileCompression::NONE == compression) {
+        return blob;
+    }
+
+    size_t size = static_cast<size_t>(blob->size());
+    void *out = nullptr;
+    size_t outSize = 0;
+    if(TileCompression::DEFLATE == compression) {
+        out = CPLZLibDeflate(blob->data(), size, -1, nullptr, 0, &outSize);
+    }
+    else {
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+        const CPLCompressor *compressor = CPLGetCompressor(compressorId(compression));
+        if(nullptr != compressor &&
+                !compressor->pfnFunc(blob->data(), size, &out, &outSize,
+                                     nullptr, compressor->user_data)) {
+            VSIFree(out);
+            out = nullptr;
         }
+#endif
     }
-    return true;
+
+    if(nullptr == out) {
+        return blob;
+    }
+
+    if(outSize + sizeof(CompressedHeader) >= size) {
+        VSIFree(out);
+        return blob;
+    }
+
+    CompressedHeader header = { VECTOR_TILE_COMPRESSED_MAGIC,
+                                static_cast<GUInt32>(compression),
+                                static_cast<GUInt32>(size), 0 };
+    BufferPtr buff(new Buffer(sizeof(CompressedHeader) + outSize));
+    buff->put(&header, sizeof(CompressedHeader));
+    buff->put(out, outSize);
+    VSIFree(out);
+    return buff;
+}
+
+/**
+ * @brief decompressTileBlob Decompress vector tile blob.
+ * @param data Compressed blob data
+ * @param size Compressed blob size
+ * @return Blob to load or attach by FlatVectorTile or empty pointer if data
+ * is not compressed blob or decompression failed.
+ */
+BufferPtr decompressTileBlob(const GByte *data, size_t size)
+{
+    if(nullptr == data || size < sizeof(CompressedHeader)) {
+        return BufferPtr();
+    }
+
+    CompressedHeader header;
+    std::memcpy(&header, data, sizeof(CompressedHeader));
+    if(header.magic != VECTOR_TILE_COMPRESSED_MAGIC) {
+        return BufferPtr();
+    }
+
+    // Malloc memory is aligned enough for FlatVectorTile::attach
+    GByte *out = static_cast<GByte*>(VSIMalloc(header.size));
+    if(nullptr == out) {
+        return BufferPtr();
+    }
+
+    const GByte *payload = data + sizeof(CompressedHeader);
+    size_t payloadSize = size - sizeof(CompressedHeader);
+    size_t outSize = 0;
+    bool result = false;
+    TileCompression compression = static_cast<TileCompression>(header.compression);
+    if(TileCompression::DEFLATE == compression) {
+        result = CPLZLibInflate(payload, payloadSize, out, header.size,
+                                &outSize) != nullptr;
+    }
+    else if(TileCompression::ZSTD == compression ||
+            TileCompression::LZ4 == compression) {
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+        const CPLCompressor *decompressor =
+                CPLGetDecompressor(compressorId(compression));
+        if(nullptr != decompressor) {
+            void *outData = out;
+            outSize = header.size;
+            result = decompressor->pfnFunc(payload, payloadSize, &outData,
+                                           &outSize, nullptr,
+                                           decompressor->user_data) &&
+                    outData == out;
+        }
+#endif
+    }
+
+    if(!result || outSize != header.size) {
+        VSIFree(out);
+        return BufferPtr();
+    }
+    return BufferPtr(new Buffer(out, static_cast<int>(outSize)));
 }
 
 //------------------------------------------------------------------------------
@@ -601,45 +1961,582 @@ Normal ngsGetNormals(const SimplePoint &beg, const SimplePoint &end)
     if(isEqual(norm_length, 0.0f))
         norm_length = 0.01f;
 
-    //normalize the normal vector
-    normX /= norm_length;
-    normY /= norm_length;
+    //normalize the normal vector
+    normX /= norm_length;
+    normY /= norm_length;
+
+    return {normX, normY};
+}
+
+//------------------------------------------------------------------------------
+// Rectangle clipping
+//------------------------------------------------------------------------------
+
+// Liang-Barsky parameter clip for one rectangle side
+static bool clipParameter(double p, double q, double &t0, double &t1)
+{
+    if(p == 0.0) { // Parallel to the side
+        return q >= 0.0;
+    }
+    double r = q / p;
+    if(p < 0.0) {
+        if(r > t1) {
+            return false;
+        }
+        if(r > t0) {
+            t0 = r;
+        }
+    }
+    else {
+        if(r < t0) {
+            return false;
+        }
+        if(r < t1) {
+            t1 = r;
+        }
+    }
+    return true;
+}
+
+static void addLinePart(std::vector<OGRRawPoint> &part,
+                        std::vector<std::vector<OGRRawPoint>> &parts)
+{
+    if(part.size() > 1) {
+        parts.emplace_back(part);
+    }
+    part.clear();
+}
+
+/**
+ * @brief clipLineByRect Cut line by rectangle with Liang-Barsky algorithm.
+ * @param line Line points
+ * @param env Rectangle to clip by
+ * @param parts Line parts inside rectangle. The line leaving and entering the
+ * rectangle is split into several parts.
+ */
+void clipLineByRect(const std::vector<OGRRawPoint> &line, const Envelope &env,
+                    std::vector<std::vector<OGRRawPoint>> &parts)
+{
+    std::vector<OGRRawPoint> part;
+    for(size_t i = 1; i < line.size(); ++i) {
+        const OGRRawPoint &a = line[i - 1];
+        const OGRRawPoint &b = line[i];
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double t0 = 0.0, t1 = 1.0;
+        if(!clipParameter(-dx, a.x - env.minX(), t0, t1) ||
+                !clipParameter(dx, env.maxX() - a.x, t0, t1) ||
+                !clipParameter(-dy, a.y - env.minY(), t0, t1) ||
+                !clipParameter(dy, env.maxY() - a.y, t0, t1)) {
+            addLinePart(part, parts);
+            continue;
+        }
+
+        if(part.empty()) {
+            part.emplace_back(a.x + t0 * dx, a.y + t0 * dy);
+        }
+        part.emplace_back(a.x + t1 * dx, a.y + t1 * dy);
+
+        if(t1 < 1.0) { // Leave rectangle
+            addLinePart(part, parts);
+        }
+    }
+    addLinePart(part, parts);
+}
+
+typedef enum _rectSide {
+    RS_LEFT,
+    RS_RIGHT,
+    RS_BOTTOM,
+    RS_TOP
+} RectSide;
+
+static bool insideSide(const OGRRawPoint &pt, const Envelope &env, RectSide side)
+{
+    switch(side) {
+    case RS_LEFT:
+        return pt.x >= env.minX();
+    case RS_RIGHT:
+        return pt.x <= env.maxX();
+    case RS_BOTTOM:
+        return pt.y >= env.minY();
+    case RS_TOP:
+        return pt.y <= env.maxY();
+    }
+    return false;
+}
+
+static OGRRawPoint sideIntersection(const OGRRawPoint &a, const OGRRawPoint &b,
+                                    const Envelope &env, RectSide side)
+{
+    double t = 0.0;
+    switch(side) {
+    case RS_LEFT:
+        t = (env.minX() - a.x) / (b.x - a.x);
+        return OGRRawPoint(env.minX(), a.y + t * (b.y - a.y));
+    case RS_RIGHT:
+        t = (env.maxX() - a.x) / (b.x - a.x);
+        return OGRRawPoint(env.maxX(), a.y + t * (b.y - a.y));
+    case RS_BOTTOM:
+        t = (env.minY() - a.y) / (b.y - a.y);
+        return OGRRawPoint(a.x + t * (b.x - a.x), env.minY());
+    case RS_TOP:
+        t = (env.maxY() - a.y) / (b.y - a.y);
+        return OGRRawPoint(a.x + t * (b.x - a.x), env.maxY());
+    }
+    return a;
+}
+
+/**
+ * @brief clipRingByRect Cut closed ring by rectangle with Sutherland-Hodgman
+ * algorithm. Concave ring parts joined along rectangle side have zero width
+ * connection there.
+ * @param ring Closed ring points
+ * @param env Rectangle to clip by
+ * @param clipped Closed ring inside rectangle
+ * @return false if ring is out of rectangle
+ */
+bool clipRingByRect(const std::vector<OGRRawPoint> &ring, const Envelope &env,
+                    std::vector<OGRRawPoint> &clipped)
+{
+    clipped.clear();
+    if(ring.size() < 4) {
+        return false;
+    }
+
+    std::vector<OGRRawPoint> input(ring.begin(), ring.end() - 1); // Without last point
+    for(RectSide side : {RS_LEFT, RS_RIGHT, RS_BOTTOM, RS_TOP}) {
+        clipped.clear();
+        if(input.empty()) {
+            break;
+        }
+        OGRRawPoint prev = input.back();
+        bool prevInside = insideSide(prev, env, side);
+        for(const OGRRawPoint &pt : input) {
+            bool inside = insideSide(pt, env, side);
+            if(inside != prevInside) {
+                clipped.emplace_back(sideIntersection(prev, pt, env, side));
+            }
+            if(inside) {
+                clipped.emplace_back(pt);
+            }
+            prev = pt;
+            prevInside = inside;
+        }
+        std::swap(input, clipped);
+    }
+
+    // Remove repeated points
+    clipped.clear();
+    for(const OGRRawPoint &pt : input) {
+        if(clipped.empty() || !isEqual(clipped.back().x, pt.x) ||
+                !isEqual(clipped.back().y, pt.y)) {
+            clipped.emplace_back(pt);
+        }
+    }
+    while(clipped.size() > 1 && isEqual(clipped.back().x, clipped.front().x) &&
+          isEqual(clipped.back().y, clipped.front().y)) {
+        clipped.pop_back();
+    }
+
+    if(clipped.size() < 3) {
+        clipped.clear();
+        return false;
+    }
+    clipped.emplace_back(clipped.front()); // Close ring
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Line simplification
+//------------------------------------------------------------------------------
+
+/**
+ * @brief snapToGrid Snap points to grid and remove repeated points.
+ * @param points Points to simplify in place
+ * @param step Grid step
+ * @param isRing If true, any point already visited by ring is removed and
+ * closing point is not included to output
+ */
+void snapToGrid(std::vector<OGRRawPoint> &points, double step, bool isRing)
+{
+    using Cell = std::pair<long, long>;
+    ScratchArenaScope scope;
+    std::set<Cell, std::less<Cell>, ArenaAllocator<Cell>> cells(
+                std::less<Cell>(), ArenaAllocator<Cell>(scope.arena()));
+    size_t count = 0;
+    for(const OGRRawPoint &pt : points) {
+        long cellX = static_cast<long>(pt.x / step);
+        long cellY = static_cast<long>(pt.y / step);
+        OGRRawPoint gpoint(cellX * step, cellY * step);
+        if(count > 0 && isEqual(points[count - 1].x, gpoint.x) &&
+                isEqual(points[count - 1].y, gpoint.y)) {
+            continue;
+        }
+        if(isRing && !cells.insert(std::make_pair(cellX, cellY)).second) {
+            continue;
+        }
+        points[count++] = gpoint;
+    }
+    points.resize(count);
+}
+
+static double segmentDistance2(const OGRRawPoint &pt, const OGRRawPoint &beg,
+                               const OGRRawPoint &end)
+{
+    double dx = end.x - beg.x;
+    double dy = end.y - beg.y;
+    double length2 = dx * dx + dy * dy;
+    double t = 0.0;
+    if(length2 > 0.0) {
+        t = ((pt.x - beg.x) * dx + (pt.y - beg.y) * dy) / length2;
+        t = std::max(0.0, std::min(t, 1.0));
+    }
+    double x = beg.x + t * dx - pt.x;
+    double y = beg.y + t * dy - pt.y;
+    return x * x + y * y;
+}
+
+/**
+ * @brief simplifyDouglasPeucker Simplify line with Douglas-Peucker algorithm.
+ * Uses explicit stack instead of recursion to process long lines.
+ * @param points Points to simplify in place
+ * @param tolerance Maximum distance of removed point from simplified line
+ * @param isRing If true, closing point is not included to output
+ */
+void simplifyDouglasPeucker(std::vector<OGRRawPoint> &points, double tolerance,
+                            bool isRing)
+{
+    if(isRing && points.size() > 1 && isEqual(points.front().x, points.back().x) &&
+            isEqual(points.front().y, points.back().y)) {
+        points.pop_back();
+    }
+    if(points.size() < 3) {
+        return;
+    }
+
+    double tolerance2 = tolerance * tolerance;
+    ScratchArenaScope scope;
+    ScratchVector<char> keep(points.size(), 0, ArenaAllocator<char>(scope.arena()));
+    keep.front() = 1;
+    keep.back() = 1;
+    using Range = std::pair<size_t, size_t>;
+    ScratchVector<Range> ranges(ArenaAllocator<Range>(scope.arena()));
+    ranges.emplace_back(0, points.size() - 1);
+    while(!ranges.empty()) {
+        std::pair<size_t, size_t> range = ranges.back();
+        ranges.pop_back();
+
+        double maxDistance = 0.0;
+        size_t maxIndex = range.first;
+        for(size_t i = range.first + 1; i < range.second; ++i) {
+            double distance = segmentDistance2(points[i], points[range.first],
+                                               points[range.second]);
+            if(distance > maxDistance) {
+                maxDistance = distance;
+                maxIndex = i;
+            }
+        }
+
+        if(maxDistance > tolerance2) {
+            keep[maxIndex] = 1;
+            ranges.emplace_back(range.first, maxIndex);
+            ranges.emplace_back(maxIndex, range.second);
+        }
+    }
+
+    size_t count = 0;
+    for(size_t i = 0; i < points.size(); ++i) {
+        if(keep[i]) {
+            points[count++] = points[i];
+        }
+    }
+    points.resize(count);
+}
+
+//------------------------------------------------------------------------------
+// GEOSContextHandlePtr
+//------------------------------------------------------------------------------
+GEOSContextHandlePtr GEOSContextHandlePtr::threadContext()
+{
+    thread_local GEOSContextHandlePtr handle;
+    return handle;
+}
+
+//------------------------------------------------------------------------------
+// GEOSGeometryWrap
+//------------------------------------------------------------------------------
+GEOSGeometryWrap::GEOSGeometryWrap(GEOSGeom geom, GEOSContextHandlePtr handle) :
+    m_geom(geom),
+    m_geosHandle(handle)
+{
+}
+
+GEOSGeometryWrap::GEOSGeometryWrap(OGRGeometry *geom) :
+    m_geom(nullptr),
+    m_geosHandle(GEOSContextHandlePtr::threadContext())
+{
+    if(nullptr != geom) {
+        m_geom = geom->exportToGEOS(m_geosHandle.get());
+    }
+}
+
+GEOSGeometryWrap::GEOSGeometryWrap(OGRGeometry *geom,
+                                   GEOSContextHandlePtr handle) :
+    m_geom(nullptr),
+    m_geosHandle(handle)
+{
+    if(nullptr != geom) {
+        m_geom = geom->exportToGEOS(m_geosHandle.get());
+    }
+}
+
+GEOSGeometryWrap::~GEOSGeometryWrap()
+{
+    GEOSGeom_destroy_r(m_geosHandle.get(), m_geom);
+}
+
+int GEOSGeometryWrap::type() const
+{
+    return GEOSGeomTypeId_r(m_geosHandle.get(), m_geom);
+}
+
+/**
+ * @brief GEOSGeometryWrap::clip Cut geometry by rectangle. Points, lines and
+ * polygons are clipped by coordinates, GEOS is used only for other geometry
+ * types and for input which the clipper cannot process.
+ * @param env Rectangle to clip by
+ * @return Clipped geometry. May be empty.
+ */
+GEOSGeometryPtr GEOSGeometryWrap::clip(const Envelope& env) const
+{
+    GEOSGeom clipped = clipByRect(m_geom, env);
+    if(nullptr == clipped) {
+        clipped = GEOSClipByRect_r(m_geosHandle.get(), m_geom,
+                                   env.minX(), env.minY(),
+                                   env.maxX(), env.maxY());
+    }
+    return GEOSGeometryPtr(new GEOSGeometryWrap(clipped, m_geosHandle));
+}
+
+GEOSGeometryPtr GEOSGeometryWrap::clone() const
+{
+    GEOSGeom geom = nullptr;
+    if(nullptr != m_geom) {
+        geom = GEOSGeom_clone_r(m_geosHandle.get(), m_geom);
+    }
+    return GEOSGeometryPtr(new GEOSGeometryWrap(geom, m_geosHandle));
+}
+
+GEOSGeom GEOSGeometryWrap::clipByRect(const GEOSGeom_t *geom,
+                                      const Envelope &env) const
+{
+    if(nullptr == geom) {
+        return nullptr;
+    }
+
+    int geomType = GEOSGeomTypeId_r(m_geosHandle.get(), geom);
+    int multiType = geomType;
+    bool result = true;
+    std::vector<GEOSGeom> parts;
+    switch(geomType) {
+    case GEOS_POINT:
+        multiType = GEOS_MULTIPOINT;
+        result = clipPoint(geom, env, parts);
+        break;
+    case GEOS_LINESTRING:
+        multiType = GEOS_MULTILINESTRING;
+        result = clipLine(geom, env, parts);
+        break;
+    case GEOS_POLYGON:
+        multiType = GEOS_MULTIPOLYGON;
+        result = clipPolygon(geom, env, parts);
+        break;
+    case GEOS_MULTIPOINT:
+    case GEOS_MULTILINESTRING:
+    case GEOS_MULTIPOLYGON:
+    {
+        int count = GEOSGetNumGeometries_r(m_geosHandle.get(), geom);
+        for(int i = 0; i < count && result; ++i) {
+            result = clipPart(GEOSGetGeometryN_r(m_geosHandle.get(), geom, i),
+                              env, parts);
+        }
+        break;
+    }
+    default:
+        return nullptr;
+    }
+
+    if(!result) {
+        for(GEOSGeom part : parts) {
+            GEOSGeom_destroy_r(m_geosHandle.get(), part);
+        }
+        return nullptr;
+    }
+
+    if(parts.empty()) {
+        return GEOSGeom_createEmptyCollection_r(m_geosHandle.get(),
+                                                GEOS_GEOMETRYCOLLECTION);
+    }
+
+    if(parts.size() == 1 && multiType != geomType) {
+        return parts.front();
+    }
+
+    return GEOSGeom_createCollection_r(m_geosHandle.get(), multiType,
+                                       parts.data(),
+                                       static_cast<unsigned int>(parts.size()));
+}
+
+bool GEOSGeometryWrap::clipPart(const GEOSGeom_t *geom, const Envelope &env,
+                                std::vector<GEOSGeom> &parts) const
+{
+    switch(GEOSGeomTypeId_r(m_geosHandle.get(), geom)) {
+    case GEOS_POINT:
+        return clipPoint(geom, env, parts);
+    case GEOS_LINESTRING:
+        return clipLine(geom, env, parts);
+    case GEOS_POLYGON:
+        return clipPolygon(geom, env, parts);
+    default:
+        return false;
+    }
+}
+
+bool GEOSGeometryWrap::clipPoint(const GEOSGeom_t *geom, const Envelope &env,
+                                 std::vector<GEOSGeom> &parts) const
+{
+    std::vector<OGRRawPoint> points;
+    if(!coordinates(geom, points)) {
+        return false;
+    }
 
-    return {normX, normY};
+    for(const OGRRawPoint &pt : points) {
+        if(pt.x >= env.minX() && pt.x <= env.maxX() &&
+                pt.y >= env.minY() && pt.y <= env.maxY()) {
+            parts.push_back(GEOSGeom_clone_r(m_geosHandle.get(), geom));
+        }
+    }
+    return true;
 }
 
-//------------------------------------------------------------------------------
-// GEOSGeometryWrap
-//------------------------------------------------------------------------------
-GEOSGeometryWrap::GEOSGeometryWrap(GEOSGeom geom, GEOSContextHandlePtr handle) :
-    m_geom(geom),
-    m_geosHandle(handle)
+bool GEOSGeometryWrap::clipLine(const GEOSGeom_t *geom, const Envelope &env,
+                                std::vector<GEOSGeom> &parts) const
 {
+    std::vector<OGRRawPoint> points;
+    if(!coordinates(geom, points) || points.size() < 2) {
+        return false;
+    }
+
+    std::vector<std::vector<OGRRawPoint>> lines;
+    clipLineByRect(points, env, lines);
+    for(const auto &line : lines) {
+        parts.push_back(GEOSGeom_createLineString_r(m_geosHandle.get(),
+                                                    createCoordSeq(line)));
+    }
+    return true;
 }
 
-GEOSGeometryWrap::GEOSGeometryWrap(OGRGeometry *geom) : m_geom(nullptr)
+static double ringArea(const std::vector<OGRRawPoint> &ring)
 {
-    if(nullptr != geom) {
-        m_geom = geom->exportToGEOS(m_geosHandle.get());
+    double area = 0.0;
+    for(size_t i = 1; i < ring.size(); ++i) {
+        area += ring[i - 1].x * ring[i].y - ring[i].x * ring[i - 1].y;
     }
+    return std::fabs(area) * 0.5;
 }
 
-GEOSGeometryWrap::~GEOSGeometryWrap()
+static bool isClosedRing(const std::vector<OGRRawPoint> &ring)
 {
-    GEOSGeom_destroy_r(m_geosHandle.get(), m_geom);
+    return ring.size() > 3 && isEqual(ring.front().x, ring.back().x) &&
+            isEqual(ring.front().y, ring.back().y);
 }
 
-int GEOSGeometryWrap::type() const
+bool GEOSGeometryWrap::clipPolygon(const GEOSGeom_t *geom, const Envelope &env,
+                                   std::vector<GEOSGeom> &parts) const
 {
-    return GEOSGeomTypeId_r(m_geosHandle.get(), m_geom);
+    std::vector<OGRRawPoint> ring, clipped;
+    const GEOSGeometry *exteriorRing = GEOSGetExteriorRing_r(m_geosHandle.get(),
+                                                             geom);
+    if(!coordinates(exteriorRing, ring) || !isClosedRing(ring)) {
+        return false;
+    }
+
+    if(!clipRingByRect(ring, env, clipped) || isEqual(ringArea(clipped), 0.0)) {
+        return true; // Polygon is out of rectangle
+    }
+
+    // Check holes before create any GEOS object as invalid hole leads to
+    // GEOS clip
+    int holeCount = GEOSGetNumInteriorRings_r(m_geosHandle.get(), geom);
+    double envArea = env.width() * env.height();
+    std::vector<std::vector<OGRRawPoint>> holes;
+    for(int i = 0; i < holeCount; ++i) {
+        const GEOSGeometry *interiorRing = GEOSGetInteriorRingN_r(
+                    m_geosHandle.get(), geom, i);
+        std::vector<OGRRawPoint> clippedHole;
+        if(!coordinates(interiorRing, ring) || !isClosedRing(ring)) {
+            return false;
+        }
+        if(!clipRingByRect(ring, env, clippedHole)) {
+            continue; // Hole is out of rectangle
+        }
+        if(std::fabs(ringArea(clippedHole) - envArea) <= envArea * 1e-9) {
+            return true; // Rectangle is inside the hole
+        }
+        holes.emplace_back(clippedHole);
+    }
+
+    GEOSGeom shell = GEOSGeom_createLinearRing_r(m_geosHandle.get(),
+                                                 createCoordSeq(clipped));
+    std::vector<GEOSGeom> holeRings;
+    for(const auto &hole : holes) {
+        holeRings.push_back(GEOSGeom_createLinearRing_r(m_geosHandle.get(),
+                                                        createCoordSeq(hole)));
+    }
+    parts.push_back(GEOSGeom_createPolygon_r(m_geosHandle.get(), shell,
+                                             holeRings.data(),
+                                             static_cast<unsigned int>(holeRings.size())));
+    return true;
 }
 
-GEOSGeometryPtr GEOSGeometryWrap::clip(const Envelope& env) const
+bool GEOSGeometryWrap::coordinates(const GEOSGeom_t *geom,
+                                   std::vector<OGRRawPoint> &points) const
 {
-    GEOSGeom clipped = GEOSClipByRect_r(m_geosHandle.get(), m_geom,
-                                        env.minX(), env.minY(),
-                                        env.maxX(), env.maxY());
-    return GEOSGeometryPtr(new GEOSGeometryWrap(clipped, m_geosHandle));
+    points.clear();
+    if(nullptr == geom) {
+        return false;
+    }
+    const GEOSCoordSequence *cs = GEOSGeom_getCoordSeq_r(m_geosHandle.get(),
+                                                         geom);
+    if(nullptr == cs) {
+        return false;
+    }
+    unsigned int count = 0;
+    GEOSCoordSeq_getSize_r(m_geosHandle.get(), cs, &count);
+    points.reserve(count);
+
+    double x(0.0), y(0.0);
+    for(unsigned int i = 0; i < count; ++i) {
+        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, i, &x);
+        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, i, &y);
+        points.emplace_back(x, y);
+    }
+    return true;
+}
+
+GEOSCoordSequence *GEOSGeometryWrap::createCoordSeq(
+        const std::vector<OGRRawPoint> &points) const
+{
+    GEOSCoordSequence *cs = GEOSCoordSeq_create_r(m_geosHandle.get(),
+                                    static_cast<unsigned int>(points.size()), 2);
+    unsigned int counter = 0;
+    for(const OGRRawPoint &pt : points) {
+        GEOSCoordSeq_setX_r(m_geosHandle.get(), cs, counter, pt.x);
+        GEOSCoordSeq_setY_r(m_geosHandle.get(), cs, counter, pt.y);
+        counter++;
+    }
+    return cs;
 }
 
 static OGRRawPoint generalize(double x, double y, double step)
@@ -711,64 +2608,35 @@ GEOSGeom GEOSGeometryWrap::generalizeMultiPoint(const GEOSGeom_t *geom,
 }
 
 GEOSGeom GEOSGeometryWrap::generalizeLine(const GEOSGeom_t *geom, double step,
-                                          bool isRing)
+                                          bool isRing,
+                                          SimplifyType simplifyType)
 {
-    const GEOSCoordSequence *cs = GEOSGeom_getCoordSeq_r(m_geosHandle.get(),
-                                                         geom);
-    unsigned int count = 0;
-    GEOSCoordSeq_getSize_r(m_geosHandle.get(), cs, &count);
-
-    OGRRawPoint prevGpoint(BIG_VALUE, BIG_VALUE);
-    double x, y;
-    std::vector<OGRRawPoint> parts;
-    struct OGRRawPointIs {
-        OGRRawPointIs( OGRRawPoint s ) : toFind(s) { }
-        bool operator() (const OGRRawPoint &n) {
-            return isEqual(n.x, toFind.x) && isEqual(n.y, toFind.y);
-        }
-        OGRRawPoint toFind;
-    };
-
-    for(unsigned int i = 0; i < count; ++i) {
-        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, i, &x);
-        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, i, &y);
-        OGRRawPoint gpoint = generalize(x, y, step);
-
-        if(isRing && std::find_if(parts.begin(), parts.end(),
-                                  OGRRawPointIs(gpoint)) != parts.end()) {
-            continue;
-        }
-
-        if(isEqual(prevGpoint.x, gpoint.x) && isEqual(prevGpoint.y, gpoint.y)) {
-            continue;
-        }
+    // Coordinates are simplified in place and GEOS sequence is created once
+    // for the simplified line
+    std::vector<OGRRawPoint> points;
+    if(!coordinates(geom, points)) {
+        return nullptr;
+    }
 
-        parts.push_back(gpoint);
-        prevGpoint = gpoint;
+    if(simplifyType == SimplifyType::DOUGLAS_PEUCKER) {
+        simplifyDouglasPeucker(points, step * DP_TOLERANCE_FACTOR, isRing);
+    }
+    else {
+        snapToGrid(points, step, isRing);
     }
 
-    if(parts.size() < 2) {
+    if(points.size() < 2) {
         return nullptr;
     }
 
     if(isRing) {
-        if(parts.size() < 3) {
+        if(points.size() < 3) {
             return nullptr;
         }
-        parts.push_back(parts.front());
-    }
-
-    GEOSCoordSeq ncs = GEOSCoordSeq_create_r(m_geosHandle.get(),
-                                             static_cast<unsigned int>(parts.size()),
-                                             2);
-    unsigned int counter = 0;
-    CPLDebug("ngstore", "parts - %ld", parts.size());
-    for(const OGRRawPoint &pt : parts) {
-        GEOSCoordSeq_setX_r(m_geosHandle.get(), ncs, counter, pt.x);
-        GEOSCoordSeq_setY_r(m_geosHandle.get(), ncs, counter, pt.y);
-        counter++;
+        points.push_back(points.front());
     }
 
+    GEOSCoordSequence *ncs = createCoordSeq(points);
     if(isRing) {
         return GEOSGeom_createLinearRing_r(m_geosHandle.get(), ncs);
     }
@@ -777,7 +2645,8 @@ GEOSGeom GEOSGeometryWrap::generalizeLine(const GEOSGeom_t *geom, double step,
 }
 
 GEOSGeom GEOSGeometryWrap::generalizeMultiLine(const GEOSGeom_t *geom,
-                                               double step)
+                                               double step,
+                                               SimplifyType simplifyType)
 {
     int count = GEOSGetNumGeometries_r(m_geosHandle.get(), geom);
     if(0 == count) {
@@ -787,7 +2656,7 @@ GEOSGeom GEOSGeometryWrap::generalizeMultiLine(const GEOSGeom_t *geom,
     std::vector<GEOSGeom> parts;
     for(int i = 0; i < count; ++i) {
         const GEOSGeom_t* g = GEOSGetGeometryN_r(m_geosHandle.get(), geom, i);
-        GEOSGeom ng = generalizeLine(g, step);
+        GEOSGeom ng = generalizeLine(g, step, false, simplifyType);
         if(nullptr != ng) {
             parts.push_back(ng);
         }
@@ -960,7 +2829,7 @@ void GEOSGeometryWrap::fillPointTile(GIntBig fid, const GEOSGeom_t *geom,
 
     if(vitem.pointCount() > 0) {
         vitem.setValid(true);
-        vitemArray.push_back(vitem);
+        vitemArray.push_back(std::move(vitem));
     }
 }
 
@@ -986,7 +2855,7 @@ void GEOSGeometryWrap::fillMultiPointTile(GIntBig fid, const GEOSGeom_t *geom,
 
     if(vitem.pointCount() > 0) {
         vitem.setValid(true);
-        vitemArray.push_back(vitem);
+        vitemArray.push_back(std::move(vitem));
     }
 }
 
@@ -1011,12 +2880,13 @@ void GEOSGeometryWrap::fillLineTile(GIntBig fid, const GEOSGeom_t *geom,
 
     if(vitem.pointCount() > 1) {
         vitem.setValid(true);
-        vitemArray.push_back(vitem);
+        vitemArray.push_back(std::move(vitem));
     }
 }
 
 void GEOSGeometryWrap::fillMultiLineTile(GIntBig fid, const GEOSGeom_t *geom,
-                                         VectorTileItemArray &vitemArray)
+                                         VectorTileItemArray &vitemArray,
+                                         const CancelToken &cancel)
 {
     int count = GEOSGetNumGeometries_r(m_geosHandle.get(), geom);
     if(0 == count) {
@@ -1024,211 +2894,225 @@ void GEOSGeometryWrap::fillMultiLineTile(GIntBig fid, const GEOSGeom_t *geom,
     }
 
     for(int i = 0; i < count; ++i) {
+        if(cancel.isCanceled()) {
+            return;
+        }
         const GEOSGeom_t *g = GEOSGetGeometryN_r(m_geosHandle.get(), geom, i);
         fillLineTile(fid, g, vitemArray);
     }
 }
 
-// For MB ear cut alghorithm
-typedef struct _edgePt {
-    OGRRawPoint pr;
-    unsigned short index;
-} EDGE_PT;
+// Ear cut tessellation types. Points are tessellated in float, the same
+// values as stored in tile, so the triangles match the tile vertices.
+using MBPoint = std::array<float, 2>;
+using MBRing = std::vector<MBPoint>;
+using MBPolygon = std::vector<MBRing>;
 
-typedef std::map<int, std::vector<EDGE_PT>> EDGES;
+/**
+ * @brief The PolygonScratch struct Buffers for polygons tessellation. Tile is
+ * filled in one thread, so the buffers are reused by all polygons of the tile
+ * and grow only if a larger polygon comes.
+ */
+typedef struct _polygonScratch {
+    MBPolygon polygon;
+    mapbox::detail::Earcut<unsigned short> earcut;
+} PolygonScratch;
 
-void setEdgeIndex(unsigned short index, double x, double y, EDGES &edges)
+static PolygonScratch &polygonScratch()
 {
-    for(auto &edge : edges) {
-        for(EDGE_PT& edgeitem : edge.second) {
-            if(isEqual(edgeitem.pr.x, x) && isEqual(edgeitem.pr.y, y)) {
-                edgeitem.index = index;
-                return;
-            }
-        }
-    }
+    static thread_local PolygonScratch scratch;
+    return scratch;
 }
 
-// The number type to use for tessellation
-using Coord = double;
-
-// The index type. Defaults to uint32_t, but you can also pass uint16_t if you know that your
-// data won't have more than 65536 vertices.
-using N = unsigned short;
-
-// Create array
-using MBPoint = std::array<Coord, 2>;
-using MBVertices = std::vector<MBPoint>;
-using MBPolygon = std::vector<MBVertices>;
-
-OGRRawPoint findPointByIndex(N index, const MBPolygon &poly)
+static void readRing(GEOSContextHandle_t handle, const GEOSGeometry *ring,
+                     MBRing &points)
 {
-    N currentIndex = index;
-    for(const auto &vertices : poly) {
-        if(currentIndex >= vertices.size()) {
-            currentIndex -= vertices.size();
-            continue;
-        }
-
-        MBPoint pt = vertices[currentIndex];
-        return OGRRawPoint(pt[0], pt[1]);
+    points.clear();
+    const GEOSCoordSequence *cs = GEOSGeom_getCoordSeq_r(handle, ring);
+    unsigned int count = 0;
+    GEOSCoordSeq_getSize_r(handle, cs, &count);
+    double x(0.0), y(0.0);
+    // Without last point, it is the same as first one
+    for(unsigned int i = 0; i + 1 < count; ++i) {
+        GEOSCoordSeq_getX_r(handle, cs, i, &x);
+        GEOSCoordSeq_getY_r(handle, cs, i, &y);
+        points.push_back({ { static_cast<float>(x), static_cast<float>(y) } });
     }
-    return OGRRawPoint(BIG_VALUE, BIG_VALUE);
 }
 
-void GEOSGeometryWrap::fillPolygonTile(GIntBig fid, const GEOSGeom_t *geom,
-                                       VectorTileItemArray& vitemArray)
+static void addCenterTriangle(double x, double y, VectorTileItem &vitem)
 {
-    VectorTileItem vitem;
-    vitem.addId(fid);
     unsigned short index = 0;
-    double x(0.0), y(0.0);
-
-    int holeCount = GEOSGetNumInteriorRings_r(m_geosHandle.get(), geom);
+    SimplePoint pt1 = { static_cast<float>(x - 0.5), static_cast<float>(y - 0.5) };
+    vitem.addPoint(pt1);
+    vitem.addBorderIndex(0, index);
+    vitem.addIndex(index++);
 
-    const GEOSGeometry *exteriorRing = GEOSGetExteriorRing_r(m_geosHandle.get(),
-                                                             geom);
-    const GEOSCoordSequence *cs = GEOSGeom_getCoordSeq_r(m_geosHandle.get(),
-                                                         exteriorRing);
-    unsigned int count = 0;
-    GEOSCoordSeq_getSize_r(m_geosHandle.get(), cs, &count);
+    SimplePoint pt2 = { static_cast<float>(x + 0.5), static_cast<float>(y - 0.5) };
+    vitem.addPoint(pt2);
+    vitem.addBorderIndex(0, index);
+    vitem.addIndex(index++);
 
-    if(count == 4 && holeCount == 0) {
-        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, 0, &x);
-        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, 0, &y);
-        SimplePoint pt1 = { static_cast<float>(x), static_cast<float>(y) };
-        vitem.addPoint(pt1);
-        vitem.addBorderIndex(0, index);
-        vitem.addIndex(index++);
+    SimplePoint pt3 = { static_cast<float>(x + 0.5), static_cast<float>(y + 0.5) };
+    vitem.addPoint(pt3);
+    vitem.addBorderIndex(0, index);
+    vitem.addIndex(index++);
 
-        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, 1, &x);
-        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, 1, &y);
-        SimplePoint pt2 = { static_cast<float>(x), static_cast<float>(y) };
-        vitem.addPoint(pt2);
-        vitem.addBorderIndex(0, index);
-        vitem.addIndex(index++);
+    vitem.addBorderIndex(0, 0); // Close ring
+}
 
-        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, 2, &x);
-        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, 2, &y);
-        SimplePoint pt3 = { static_cast<float>(x), static_cast<float>(y) };
-        vitem.addPoint(pt3);
-        vitem.addBorderIndex(0, index);
-        vitem.addIndex(index++);
+static void fillCenterTriangle(GEOSContextHandle_t handle, const GEOSGeom_t *geom,
+                               VectorTileItem &vitem)
+{
+    double x(0.0), y(0.0);
+    GEOSGeom g = GEOSGetCentroid_r(handle, geom);
+    GEOSGeomGetX_r(handle, g, &x);
+    GEOSGeomGetY_r(handle, g, &y);
+    GEOSGeom_destroy_r(handle, g);
+    addCenterTriangle(x, y, vitem);
+}
 
-        vitem.addBorderIndex(0, 0); // Close ring
+/**
+ * @brief tessellatePolygon Add rings of the scratch polygon and their
+ * triangles to the tile item. Rings have no closing point, the first one is
+ * exterior.
+ * @param scratch Tessellation buffers with the polygon rings.
+ * @param vertexCount Vertices count of all rings.
+ * @param vitem Item to add points, border and triangle indices to.
+ * @return False if polygon is degenerate or too large for 16 bit indices.
+ * Nothing is added to the item in that case.
+ */
+static bool tessellatePolygon(PolygonScratch &scratch, size_t vertexCount,
+                              VectorTileItem &vitem)
+{
+    MBPolygon &polygon = scratch.polygon;
+    if(polygon.empty() || polygon[0].size() < 3 ||
+            vertexCount >= MAX_EDGE_INDEX) {
+        return false;
+    }
 
-        vitem.setValid(true);
-        vitemArray.push_back(vitem);
-        return;
+    // Run tessellation. Indices refer to the vertices of the input polygon
+    // in rings order, three subsequent indices form a triangle. The triangle
+    // needs no tessellation.
+    std::vector<unsigned short> &indices = scratch.earcut.indices;
+    if(polygon.size() == 1 && polygon[0].size() == 3) {
+        indices.assign({0, 1, 2});
+    }
+    else {
+        scratch.earcut(polygon);
     }
 
-    EDGES edges;
-    MBPolygon polygon;
-    std::vector<MBPoint> mbExteriorRing;
-    for(unsigned int i = 0; i < count; ++i) { // Without last point
-        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, i, &x);
-        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, i, &y);
+    if(indices.empty()) {
+        return false;
+    }
 
-        edges[0].push_back({OGRRawPoint(x, y), MAX_EDGE_INDEX});
+    // Vertices are shared by triangles and borders
+    unsigned short index = 0;
+    for(size_t ring = 0; ring < polygon.size(); ++ring) {
+        unsigned short ringIndex = static_cast<unsigned short>(ring);
+        unsigned short firstIndex = index;
+        for(const MBPoint &pt : polygon[ring]) {
+            SimplePoint spt = { pt[0], pt[1] };
+            vitem.addPoint(spt);
+            vitem.addBorderIndex(ringIndex, index++);
+        }
+        vitem.addBorderIndex(ringIndex, firstIndex); // Close ring
+    }
 
-        MBPoint mbpt{ { x, y } };
-        mbExteriorRing.emplace_back(mbpt);
+    for(auto triangleIndex : indices) {
+        vitem.addIndex(triangleIndex);
     }
+    return true;
+}
 
-    polygon.emplace_back(mbExteriorRing);
+void GEOSGeometryWrap::fillPolygonTile(GIntBig fid, const GEOSGeom_t *geom,
+                                       VectorTileItemArray& vitemArray)
+{
+    VectorTileItem vitem;
+    vitem.addId(fid);
 
+    PolygonScratch &scratch = polygonScratch();
+    MBPolygon &polygon = scratch.polygon;
+    int holeCount = GEOSGetNumInteriorRings_r(m_geosHandle.get(), geom);
+    if(polygon.empty()) {
+        polygon.emplace_back();
+    }
+    readRing(m_geosHandle.get(),
+             GEOSGetExteriorRing_r(m_geosHandle.get(), geom), polygon[0]);
+    size_t vertexCount = polygon[0].size();
+    size_t ringCount = 1;
     for(int i = 0; i < holeCount; ++i) {
-        const GEOSGeometry *interiorRing = GEOSGetInteriorRingN_r(
-                    m_geosHandle.get(), geom, i);
-        const GEOSCoordSequence* hcs = GEOSGeom_getCoordSeq_r(m_geosHandle.get(),
-                                                             interiorRing);
-        unsigned int hcount = 0;
-        GEOSCoordSeq_getSize_r(m_geosHandle.get(), hcs, &hcount);
-
-        std::vector<MBPoint> mbInteriorRing;
-        for(unsigned int j = 0; j < hcount; ++j) {
-            GEOSCoordSeq_getX_r(m_geosHandle.get(), hcs, j, &x);
-            GEOSCoordSeq_getY_r(m_geosHandle.get(), hcs, j, &y);
-
-            edges[i + 1].push_back({OGRRawPoint(x, y), MAX_EDGE_INDEX});
-
-            MBPoint mbpt{ { x, y } };
-            mbInteriorRing.emplace_back(mbpt);
+        if(polygon.size() <= ringCount) {
+            polygon.emplace_back();
+        }
+        MBRing &hole = polygon[ringCount];
+        readRing(m_geosHandle.get(),
+                 GEOSGetInteriorRingN_r(m_geosHandle.get(), geom, i), hole);
+        if(hole.size() < 3) {
+            continue;
         }
-        polygon.emplace_back(mbInteriorRing);
+        vertexCount += hole.size();
+        ringCount++;
     }
+    polygon.resize(ringCount);
 
-    // Run tessellation
-    // Returns array of indices that refer to the vertices of the input polygon.
-    // Three subsequent indices form a triangle.
-    std::vector<N> indices = mapbox::earcut<N>(polygon);
-    if(indices.empty()) {
-        GEOSGeom g = GEOSGetCentroid_r(m_geosHandle.get(), geom);
-        GEOSGeomGetX_r(m_geosHandle.get(), g, &x);
-        GEOSGeomGetY_r(m_geosHandle.get(), g, &y);
-        GEOSGeom_destroy_r(m_geosHandle.get(), g);
-
-        index = 0;
-        SimplePoint pt1 = { static_cast<float>(x - 0.5), static_cast<float>(y - 0.5) };
-        vitem.addPoint(pt1);
-        vitem.addBorderIndex(0, index);
-        vitem.addIndex(index++);
-
-        SimplePoint pt2 = { static_cast<float>(x + 0.5), static_cast<float>(y - 0.5) };
-        vitem.addPoint(pt2);
-        vitem.addBorderIndex(0, index);
-        vitem.addIndex(index++);
-
-        SimplePoint pt3 = { static_cast<float>(x + 0.5), static_cast<float>(y + 0.5) };
-        vitem.addPoint(pt3);
-        vitem.addBorderIndex(0, index);
-        vitem.addIndex(index++);
+    if(!tessellatePolygon(scratch, vertexCount, vitem)) {
+        fillCenterTriangle(m_geosHandle.get(), geom, vitem);
+    }
 
-        vitem.addBorderIndex(0, 0); // Close ring
+    vitem.setValid(true);
+    vitemArray.push_back(std::move(vitem));
+}
 
-        vitem.setValid(true);
-        vitemArray.push_back(vitem);
+/**
+ * @brief fillPolygonTile Tessellate polygon given by rings coordinates. Rings
+ * have no closing point, the first one is exterior. Gives the same item as
+ * GEOSGeometryWrap fillTile for the polygon.
+ * @param fid Feature identifier
+ * @param rings Polygon rings
+ * @param vitemArray Array to add item to
+ */
+void fillPolygonTile(GIntBig fid,
+                     const std::vector<std::vector<SimplePoint>> &rings,
+                     VectorTileItemArray &vitemArray)
+{
+    if(rings.empty() || rings[0].empty()) {
         return;
     }
 
-    unsigned char tinIndex = 0;
-    OGRRawPoint tin[3];
-    unsigned short vertexIndex = 0;
-
-    for(const auto &index : indices) {
-        tin[tinIndex] = findPointByIndex(index, polygon);
-        tinIndex++;
-
-        if(tinIndex == 3) {
-            tinIndex = 0;
-
-            for(unsigned char j = 0; j < 3; ++j) {
-                SimplePoint pt = { static_cast<float>(tin[j].x),
-                                   static_cast<float>(tin[j].y) };
-                vitem.addPoint(pt);
-                // Check each vertex belongs to exterior or interior ring
-                setEdgeIndex(vertexIndex, tin[j].x, tin[j].y, edges);
+    VectorTileItem vitem;
+    vitem.addId(fid);
 
-                vitem.addIndex(vertexIndex++);
-            }
+    PolygonScratch &scratch = polygonScratch();
+    MBPolygon &polygon = scratch.polygon;
+    polygon.resize(rings.size());
+    size_t vertexCount = 0;
+    size_t ringCount = 0;
+    for(size_t i = 0; i < rings.size(); ++i) {
+        // Degenerate holes are skipped
+        if(i > 0 && rings[i].size() < 3) {
+            continue;
         }
+        MBRing &ring = polygon[ringCount++];
+        ring.clear();
+        for(const SimplePoint &pt : rings[i]) {
+            ring.push_back({ { pt.x, pt.y } });
+        }
+        vertexCount += ring.size();
     }
+    polygon.resize(ringCount);
 
-    for(unsigned short i = 0; i < holeCount + 1; ++i) {
-        unsigned short firstIndex = MAX_EDGE_INDEX;
-        for(auto& edge : edges[i]) {
-            if(edge.index != MAX_EDGE_INDEX) {
-                if(firstIndex == MAX_EDGE_INDEX) {
-                    firstIndex = edge.index;
-                }
-                vitem.addBorderIndex(i, edge.index);
-            }
+    if(!tessellatePolygon(scratch, vertexCount, vitem)) {
+        double x = 0.0, y = 0.0;
+        for(const SimplePoint &pt : rings[0]) {
+            x += static_cast<double>(pt.x);
+            y += static_cast<double>(pt.y);
         }
-        vitem.addBorderIndex(i, firstIndex);
+        addCenterTriangle(x / rings[0].size(), y / rings[0].size(), vitem);
     }
 
     vitem.setValid(true);
-    vitemArray.push_back(vitem);
+    vitemArray.push_back(std::move(vitem));
 }
 
 
@@ -1419,7 +3303,8 @@ void FeatureClass::tilePolygon(GIntBig fid, OGRGeometry* geom,
 */
 
 void GEOSGeometryWrap::fillMultiPolygonTile(GIntBig fid, const GEOSGeom_t *geom,
-                                            VectorTileItemArray &vitemArray)
+                                            VectorTileItemArray &vitemArray,
+                                            const CancelToken &cancel)
 {
     int count = GEOSGetNumGeometries_r(m_geosHandle.get(), geom);
     if(0 == count) {
@@ -1427,13 +3312,17 @@ void GEOSGeometryWrap::fillMultiPolygonTile(GIntBig fid, const GEOSGeom_t *geom,
     }
 
     for(int i = 0; i < count; ++i) {
+        if(cancel.isCanceled()) {
+            return;
+        }
         const GEOSGeom_t *g = GEOSGetGeometryN_r(m_geosHandle.get(), geom, i);
         fillPolygonTile(fid, g, vitemArray);
     }
 }
 
 void GEOSGeometryWrap::fillCollectionTile(GIntBig fid, const GEOSGeom_t *geom,
-                                          VectorTileItemArray &vitemArray)
+                                          VectorTileItemArray &vitemArray,
+                                          const CancelToken &cancel)
 {
     int count = GEOSGetNumGeometries_r(m_geosHandle.get(), geom);
     if(0 == count) {
@@ -1441,6 +3330,9 @@ void GEOSGeometryWrap::fillCollectionTile(GIntBig fid, const GEOSGeom_t *geom,
     }
 
     for(int i = 0; i < count; ++i) {
+        if(cancel.isCanceled()) {
+            return;
+        }
         const GEOSGeom_t *g = GEOSGetGeometryN_r(m_geosHandle.get(), geom, i);
 
         switch(GEOSGeomTypeId_r(m_geosHandle.get(), g)) {
@@ -1451,13 +3343,13 @@ void GEOSGeometryWrap::fillCollectionTile(GIntBig fid, const GEOSGeom_t *geom,
                 fillPolygonTile(fid, g, vitemArray);
                 break;
             case GEOS_MULTILINESTRING:
-                fillMultiLineTile(fid, g, vitemArray);
+                fillMultiLineTile(fid, g, vitemArray, cancel);
                 break;
             case GEOS_MULTIPOLYGON:
-                fillMultiPolygonTile(fid, g, vitemArray);
+                fillMultiPolygonTile(fid, g, vitemArray, cancel);
                 break;
             case GEOS_GEOMETRYCOLLECTION:
-                fillCollectionTile(fid, g, vitemArray);
+                fillCollectionTile(fid, g, vitemArray, cancel);
                 break;
             case GEOS_MULTIPOINT:
             case GEOS_POINT:
@@ -1470,7 +3362,13 @@ void GEOSGeometryWrap::fillCollectionTile(GIntBig fid, const GEOSGeom_t *geom,
     }
 }
 
-void GEOSGeometryWrap::simplify(double step)
+/**
+ * @brief GEOSGeometryWrap::simplify Generalize geometry for map zoom
+ * @param step Map pixel size at zoom
+ * @param simplifyType Lines simplification type. Points are snapped to grid
+ * and polygons are simplified by GEOS in any case.
+ */
+void GEOSGeometryWrap::simplify(double step, SimplifyType simplifyType)
 {
     if(isEqual(step, 0.0) || nullptr == m_geom) {
         return;
@@ -1484,7 +3382,7 @@ void GEOSGeometryWrap::simplify(double step)
         m_geom = g;
         break;
     case GEOS_LINESTRING:
-        g = generalizeLine(m_geom, step);
+        g = generalizeLine(m_geom, step, false, simplifyType);
         if(nullptr == g) {
             setCentroid(GEOS_LINESTRING);
         }
@@ -1514,7 +3412,7 @@ void GEOSGeometryWrap::simplify(double step)
         }
         break;
     case GEOS_MULTILINESTRING:
-        g = generalizeMultiLine(m_geom, step);
+        g = generalizeMultiLine(m_geom, step, simplifyType);
         if(nullptr == g) {
             setCentroid(GEOS_LINESTRING);
         }
@@ -1542,7 +3440,8 @@ void GEOSGeometryWrap::simplify(double step)
     }
 }
 
-void GEOSGeometryWrap::fillTile(GIntBig fid, VectorTileItemArray &vitemArray)
+void GEOSGeometryWrap::fillTile(GIntBig fid, VectorTileItemArray &vitemArray,
+                                const CancelToken &cancel)
 {
     if(nullptr == m_geom || GEOSisEmpty_r(m_geosHandle.get(), m_geom) == 1) {
         return;
@@ -1562,13 +3461,13 @@ void GEOSGeometryWrap::fillTile(GIntBig fid, VectorTileItemArray &vitemArray)
         fillMultiPointTile(fid, m_geom, vitemArray);
         break;
     case GEOS_MULTILINESTRING:
-        fillMultiLineTile(fid, m_geom, vitemArray);
+        fillMultiLineTile(fid, m_geom, vitemArray, cancel);
         break;
     case GEOS_MULTIPOLYGON:
-        fillMultiPolygonTile(fid, m_geom, vitemArray);
+        fillMultiPolygonTile(fid, m_geom, vitemArray, cancel);
         break;
     case GEOS_GEOMETRYCOLLECTION:
-        fillCollectionTile(fid, m_geom, vitemArray);
+        fillCollectionTile(fid, m_geom, vitemArray, cancel);
         break;
     case GEOS_LINEARRING:
     default:
@@ -1601,6 +3500,96 @@ bool GEOSGeometryWrap::intersects(double x, double y) const
     return result;
 }
 
+/**
+ * @brief GEOSGeometryWrap::attachToThread Switch geometry to the GEOS context
+ * of the current thread. GEOS context must not be used by two threads at once,
+ * so a geometry passed to other thread has to be attached there before use.
+ * Geometries got by clip and clone share the context of the source.
+ */
+void GEOSGeometryWrap::attachToThread()
+{
+    m_geosHandle = GEOSContextHandlePtr::threadContext();
+}
+
+//------------------------------------------------------------------------------
+// OGR geometry tiling
+//------------------------------------------------------------------------------
+
+static bool fillSimpleLineTile(GIntBig fid, const OGRSimpleCurve *line,
+                               double step,
+                               GEOSGeometryWrap::SimplifyType simplifyType,
+                               VectorTileItemArray &vitemArray)
+{
+    std::vector<OGRRawPoint> points(static_cast<size_t>(line->getNumPoints()));
+    if(points.empty()) {
+        return false;
+    }
+    line->getPoints(points.data());
+
+    if(!isEqual(step, 0.0)) {
+        if(simplifyType == GEOSGeometryWrap::SimplifyType::DOUGLAS_PEUCKER) {
+            simplifyDouglasPeucker(points, step * DP_TOLERANCE_FACTOR, false);
+        }
+        else {
+            snapToGrid(points, step, false);
+        }
+    }
+
+    if(points.size() < 2) {
+        return false;
+    }
+
+    VectorTileItem vitem;
+    vitem.addId(fid);
+    vitem.addPoints(points);
+    vitem.setValid(true);
+    vitemArray.push_back(std::move(vitem));
+    return true;
+}
+
+/**
+ * @brief fillTileFromOGR Simplify and tile geometry reading OGR coordinates
+ * directly, without GEOS geometry. Geometry must lie inside the tile extent,
+ * so no clipping is needed. Gives the same items as GEOSGeometryWrap simplify
+ * and fillTile.
+ * @param fid Feature identifier
+ * @param geom Geometry to tile
+ * @param step Simplification step
+ * @param simplifyType Line simplification algorithm
+ * @param vitemArray Array to add items to
+ * @return False if the geometry needs GEOS: it is not a line or multiline or
+ * it collapses after simplification. Nothing is added to the array in that
+ * case.
+ */
+bool fillTileFromOGR(GIntBig fid, const OGRGeometry *geom, double step,
+                     GEOSGeometryWrap::SimplifyType simplifyType,
+                     VectorTileItemArray &vitemArray)
+{
+    if(nullptr == geom || geom->IsEmpty()) {
+        return false;
+    }
+
+    switch(OGR_GT_Flatten(geom->getGeometryType())) {
+    case wkbLineString:
+        return fillSimpleLineTile(fid, static_cast<const OGRLineString*>(geom),
+                                  step, simplifyType, vitemArray);
+    case wkbMultiLineString:
+    {
+        const OGRMultiLineString *mline =
+                static_cast<const OGRMultiLineString*>(geom);
+        size_t size = vitemArray.size();
+        for(int i = 0; i < mline->getNumGeometries(); ++i) {
+            fillSimpleLineTile(fid, static_cast<const OGRLineString*>(
+                                   mline->getGeometryRef(i)),
+                               step, simplifyType, vitemArray);
+        }
+        return vitemArray.size() > size;
+    }
+    default:
+        return false;
+    }
+}
+
 //------------------------------------------------------------------------------
 
 /**
@@ -1616,6 +3605,78 @@ bool GEOSGeometryWrap::intersects(double x, double y) const
 //    return {(pt2.x - pt1.x) / 2 + pt1.x, (pt2.y - pt1.y) / 2 + pt1.y};
 //}
 
+//------------------------------------------------------------------------------
+// EnvelopeArray
+//------------------------------------------------------------------------------
+
+void EnvelopeArray::reserve(size_t size)
+{
+    m_minX.reserve(size);
+    m_minY.reserve(size);
+    m_maxX.reserve(size);
+    m_maxY.reserve(size);
+}
+
+void EnvelopeArray::add(const Envelope &env)
+{
+    m_minX.push_back(env.minX());
+    m_minY.push_back(env.minY());
+    m_maxX.push_back(env.maxX());
+    m_maxY.push_back(env.maxY());
+}
+
+void EnvelopeArray::clear()
+{
+    m_minX.clear();
+    m_minY.clear();
+    m_maxX.clear();
+    m_maxY.clear();
+}
+
+/**
+ * @brief EnvelopeArray::intersects Test which envelopes intersect env.
+ * @param env Envelope to test
+ * @param mask Mask to OR results to. Resized with zeroes to the array size.
+ */
+void EnvelopeArray::intersects(const Envelope &env, std::vector<GByte> &mask) const
+{
+    size_t count = size();
+    mask.resize(count, 0);
+    const double *minX = m_minX.data();
+    const double *minY = m_minY.data();
+    const double *maxX = m_maxX.data();
+    const double *maxY = m_maxY.data();
+    GByte *out = mask.data();
+    double envMinX = env.minX(), envMinY = env.minY();
+    double envMaxX = env.maxX(), envMaxY = env.maxY();
+    for(size_t i = 0; i < count; ++i) {
+        out[i] |= static_cast<GByte>((minX[i] <= envMaxX) & (maxX[i] >= envMinX) &
+                                     (minY[i] <= envMaxY) & (maxY[i] >= envMinY));
+    }
+}
+
+/**
+ * @brief EnvelopeArray::contains Test which envelopes contain env.
+ * @param env Envelope to test
+ * @param mask Mask to OR results to. Resized with zeroes to the array size.
+ */
+void EnvelopeArray::contains(const Envelope &env, std::vector<GByte> &mask) const
+{
+    size_t count = size();
+    mask.resize(count, 0);
+    const double *minX = m_minX.data();
+    const double *minY = m_minY.data();
+    const double *maxX = m_maxX.data();
+    const double *maxY = m_maxY.data();
+    GByte *out = mask.data();
+    double envMinX = env.minX(), envMinY = env.minY();
+    double envMaxX = env.maxX(), envMaxY = env.maxY();
+    for(size_t i = 0; i < count; ++i) {
+        out[i] |= static_cast<GByte>((minX[i] <= envMinX) & (minY[i] <= envMinY) &
+                                     (maxX[i] >= envMaxX) & (maxY[i] >= envMaxY));
+    }
+}
+
 OGRGeometry *ngsCreateGeometryFromGeoJson(const CPLJSONObject &json)
 {
     return OGRGeometryFactory::createFromGeoJson(json);
@@ -1655,8 +3716,115 @@ OGRRawPoint ngsGetMiddlePoint(const OGRRawPoint &pt1, const OGRRawPoint &pt2)
 // EditGeometryData
 //------------------------------------------------------------------------------
 
+static bool isSameEditData(const OGRRawPoint &pt1, const OGRRawPoint &pt2)
+{
+    return std::memcmp(&pt1, &pt2, sizeof(OGRRawPoint)) == 0;
+}
+
+template<class T>
+static bool isSameEditData(const std::vector<T> &data1,
+                           const std::vector<T> &data2)
+{
+    if(data1.size() != data2.size()) {
+        return false;
+    }
+    for(size_t i = 0; i < data1.size(); ++i) {
+        if(!isSameEditData(data1[i], data2[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool diffEditData(const OGRRawPoint &from, const OGRRawPoint &to,
+                         EditDelta<OGRRawPoint> &delta)
+{
+    if(isSameEditData(from, to)) {
+        return false;
+    }
+    delta.removed = from;
+    delta.inserted = to;
+    return true;
+}
+
+/**
+ * @brief diffEditData Find the changed range of elements. Equal elements at
+ * the start and at the end are skipped, if one element is changed the delta
+ * goes down to it. So vertex move, insert or delete stores only the vertex.
+ * @param from Data before the change
+ * @param to Data after the change
+ * @param delta Delta to fill
+ * @return True if data changed
+ */
+template<class T>
+static bool diffEditData(const std::vector<T> &from, const std::vector<T> &to,
+                         EditDelta<std::vector<T>> &delta)
+{
+    size_t fromSize = from.size();
+    size_t toSize = to.size();
+    size_t prefix = 0;
+    while(prefix < fromSize && prefix < toSize &&
+          isSameEditData(from[prefix], to[prefix])) {
+        prefix++;
+    }
+    if(prefix == fromSize && prefix == toSize) {
+        return false;
+    }
+
+    size_t suffix = 0;
+    while(suffix < fromSize - prefix && suffix < toSize - prefix &&
+          isSameEditData(from[fromSize - suffix - 1], to[toSize - suffix - 1])) {
+        suffix++;
+    }
+
+    delta.offset = prefix;
+    if(fromSize - prefix - suffix == 1 && toSize - prefix - suffix == 1) {
+        delta.child.resize(1);
+        return diffEditData(from[prefix], to[prefix], delta.child[0]);
+    }
+
+    delta.removed.assign(from.begin() + static_cast<long>(prefix),
+                         from.end() - static_cast<long>(suffix));
+    delta.inserted.assign(to.begin() + static_cast<long>(prefix),
+                          to.end() - static_cast<long>(suffix));
+    return true;
+}
+
+static void applyEditDelta(OGRRawPoint &data,
+                           const EditDelta<OGRRawPoint> &delta, bool forward)
+{
+    data = forward ? delta.inserted : delta.removed;
+}
+
+template<class T>
+static void applyEditDelta(std::vector<T> &data,
+                           const EditDelta<std::vector<T>> &delta, bool forward)
+{
+    if(!delta.child.empty()) {
+        applyEditDelta(data[delta.offset], delta.child[0], forward);
+        return;
+    }
+
+    const std::vector<T> &from = forward ? delta.removed : delta.inserted;
+    const std::vector<T> &to = forward ? delta.inserted : delta.removed;
+    size_t common = std::min(from.size(), to.size());
+    auto it = data.begin() + static_cast<long>(delta.offset);
+    std::copy(to.begin(), to.begin() + static_cast<long>(common), it);
+    it += static_cast<long>(common);
+    if(to.size() > common) {
+        data.insert(it, to.begin() + static_cast<long>(common), to.end());
+    }
+    else {
+        data.erase(it, it + static_cast<long>(from.size() - common));
+    }
+}
+
 template<class T>
-EditGeometryData<T>::EditGeometryData() : m_currentEditStep(0)
+EditGeometryData<T>::EditGeometryData() :
+    m_currentEditStep(0),
+    m_hasBase(false),
+    m_pending(false),
+    m_version(0)
 {
 
 }
@@ -1664,13 +3832,13 @@ EditGeometryData<T>::EditGeometryData() : m_currentEditStep(0)
 template<class T>
 bool EditGeometryData<T>::canUndo() const
 {
-    return !m_history.empty() && m_currentEditStep > 0;
+    return m_currentEditStep > 0 || m_pending;
 }
 
 template<class T>
 bool EditGeometryData<T>::canRedo() const
 {
-    return !m_history.empty() && m_currentEditStep <= m_history.size();
+    return !m_pending && m_currentEditStep < m_history.size();
 }
 
 template<class T>
@@ -1679,7 +3847,18 @@ bool EditGeometryData<T>::undo()
     if(!canUndo()) {
         return false;
     }
-    m_data = m_history[--m_currentEditStep];
+    if(m_pending) {
+        // Store the current edit step to redo it
+        m_pending = false;
+        commitState();
+    }
+    m_version++;
+    if(m_currentEditStep == 0) {
+        return true;
+    }
+    const EditDelta<T> &delta = m_history[--m_currentEditStep];
+    applyEditDelta(m_base, delta, false);
+    applyEditDelta(m_data, delta, false);
     return true;
 }
 
@@ -1689,16 +3868,244 @@ bool EditGeometryData<T>::redo()
     if(!canRedo()) {
         return false;
     }
-    m_data = m_history[++m_currentEditStep];
+    const EditDelta<T> &delta = m_history[m_currentEditStep++];
+    applyEditDelta(m_base, delta, true);
+    applyEditDelta(m_data, delta, true);
+    m_version++;
     return true;
 }
 
 template<class T>
 void EditGeometryData<T>::saveState()
 {
-    m_history.resize(m_currentEditStep);
-    m_history.push_back(m_data);
-    m_currentEditStep++;
+    commitState();
+    m_pending = true;
+    m_version++;
+}
+
+/**
+ * @brief EditGeometryData::commitState Store changes since the last saved
+ * state as the new history step. Redo steps are dropped and the oldest steps
+ * are dropped over the history limit.
+ * @return True if data changed
+ */
+template<class T>
+bool EditGeometryData<T>::commitState()
+{
+    m_history.erase(m_history.begin() + static_cast<long>(m_currentEditStep),
+                    m_history.end());
+    if(!m_hasBase) {
+        m_base = m_data;
+        m_hasBase = true;
+        return false;
+    }
+
+    EditDelta<T> delta;
+    if(!diffEditData(m_base, m_data, delta)) {
+        return false;
+    }
+    applyEditDelta(m_base, delta, true);
+    m_history.push_back(std::move(delta));
+    if(m_history.size() > MAX_EDIT_HISTORY) {
+        m_history.erase(m_history.begin());
+    }
+    m_currentEditStep = m_history.size();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// EditVertexIndex
+//------------------------------------------------------------------------------
+
+EditVertexIndex::EditVertexIndex() :
+    m_cellWidth(1.0),
+    m_cellHeight(1.0),
+    m_cols(1),
+    m_rows(1),
+    m_version(0),
+    m_valid(false)
+{
+
+}
+
+/**
+ * @brief EditVertexIndex::build Put segments of rings to the grid. The grid
+ * has about four segments per cell.
+ * @param rings Rings of edit geometry. Ring points must not be reallocated
+ * while the version is the same.
+ * @param version Edit data version
+ */
+void EditVertexIndex::build(const std::vector<Ring> &rings, unsigned version)
+{
+    m_rings = rings;
+    m_ringOffsets.clear();
+    m_segmentRings.clear();
+    m_segmentCells.clear();
+    m_extent = Envelope();
+
+    unsigned count = 0;
+    bool hasExtent = false;
+    for(unsigned i = 0; i < m_rings.size(); ++i) {
+        const Line &points = *m_rings[i].points;
+        m_ringOffsets.push_back(count);
+        for(const OGRRawPoint &pt : points) {
+            if(!hasExtent) {
+                m_extent = Envelope(pt.x, pt.y, pt.x, pt.y);
+                hasExtent = true;
+                continue;
+            }
+            m_extent.setMinX(std::min(m_extent.minX(), pt.x));
+            m_extent.setMinY(std::min(m_extent.minY(), pt.y));
+            m_extent.setMaxX(std::max(m_extent.maxX(), pt.x));
+            m_extent.setMaxY(std::max(m_extent.maxY(), pt.y));
+        }
+        if(points.size() > 1) {
+            count += static_cast<unsigned>(points.size() - 1);
+            m_segmentRings.resize(count, i);
+        }
+    }
+
+    double side = std::sqrt(count / MAX_EDIT_INDEX_CELL_SEGMENTS) + 1.0;
+    m_cols = m_rows = static_cast<unsigned short>(
+                std::min(side, static_cast<double>(MAX_EDIT_INDEX_SIDE)));
+    m_cellWidth = m_extent.width() > 0.0 ? m_extent.width() / m_cols : 1.0;
+    m_cellHeight = m_extent.height() > 0.0 ? m_extent.height() / m_rows : 1.0;
+
+    m_cells.clear();
+    m_cells.resize(static_cast<size_t>(m_cols) * m_rows);
+    m_segmentCells.resize(count);
+    for(unsigned id = 0; id < count; ++id) {
+        addSegment(id);
+    }
+
+    m_version = version;
+    m_valid = true;
+}
+
+/**
+ * @brief EditVertexIndex::movePoint Update segments of moved vertex.
+ * @param part Vertex part
+ * @param ring Vertex ring
+ * @param point Vertex index
+ * @param version Data version the index was built for
+ * @param newVersion Data version after move
+ */
+void EditVertexIndex::movePoint(int part, int ring, int point, unsigned version,
+                                unsigned newVersion)
+{
+    if(!isValid(version)) {
+        return;
+    }
+
+    for(unsigned i = 0; i < m_rings.size(); ++i) {
+        if(m_rings[i].part != part || m_rings[i].ring != ring) {
+            continue;
+        }
+        size_t size = m_rings[i].points->size();
+        unsigned id = m_ringOffsets[i] + static_cast<unsigned>(point);
+        if(point > 0) { // Segment ending on point
+            removeSegment(id - 1);
+            addSegment(id - 1);
+        }
+        if(static_cast<size_t>(point) + 1 < size) { // Segment starting on point
+            removeSegment(id);
+            addSegment(id);
+        }
+        m_version = newVersion;
+        return;
+    }
+}
+
+/**
+ * @brief EditVertexIndex::search Find segments in cells near the point.
+ * @param pt Search point
+ * @param tolerance Search tolerance
+ * @return Segments ordered as in rings. The segment distance may be greater
+ * than the tolerance, but any vertex near the point (see ngsIsNear) is the end
+ * of one of the segments.
+ */
+std::vector<EditVertexIndex::Segment> EditVertexIndex::search(
+        const OGRRawPoint &pt, double tolerance) const
+{
+    CellRange range = cellRange(OGRRawPoint(pt.x - tolerance, pt.y - tolerance),
+                                OGRRawPoint(pt.x + tolerance, pt.y + tolerance));
+    std::vector<unsigned> ids;
+    for(unsigned short y = range.minY; y <= range.maxY; ++y) {
+        for(unsigned short x = range.minX; x <= range.maxX; ++x) {
+            const std::vector<unsigned> &cell =
+                    m_cells[static_cast<size_t>(y) * m_cols + x];
+            ids.insert(ids.end(), cell.begin(), cell.end());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<Segment> result;
+    result.reserve(ids.size());
+    for(unsigned id : ids) {
+        unsigned ring = m_segmentRings[id];
+        int point = static_cast<int>(id - m_ringOffsets[ring] + 1);
+        const Line &points = *m_rings[ring].points;
+        double distance2 = segmentDistance2(pt,
+                                            points[static_cast<size_t>(point - 1)],
+                                            points[static_cast<size_t>(point)]);
+        result.push_back({m_rings[ring].part, m_rings[ring].ring, point,
+                          distance2});
+    }
+    return result;
+}
+
+EditVertexIndex::CellRange EditVertexIndex::cellRange(const OGRRawPoint &pt1,
+                                                      const OGRRawPoint &pt2) const
+{
+    auto cell = [](double value, double min, double size,
+            unsigned short count) -> unsigned short {
+        double index = std::floor((value - min) / size);
+        if(index < 0.0) {
+            return 0;
+        }
+        if(index >= count) {
+            return count - 1;
+        }
+        return static_cast<unsigned short>(index);
+    };
+
+    CellRange range;
+    range.minX = cell(std::min(pt1.x, pt2.x), m_extent.minX(), m_cellWidth, m_cols);
+    range.maxX = cell(std::max(pt1.x, pt2.x), m_extent.minX(), m_cellWidth, m_cols);
+    range.minY = cell(std::min(pt1.y, pt2.y), m_extent.minY(), m_cellHeight, m_rows);
+    range.maxY = cell(std::max(pt1.y, pt2.y), m_extent.minY(), m_cellHeight, m_rows);
+    return range;
+}
+
+void EditVertexIndex::addSegment(unsigned id)
+{
+    unsigned ring = m_segmentRings[id];
+    size_t point = id - m_ringOffsets[ring] + 1;
+    const Line &points = *m_rings[ring].points;
+    CellRange range = cellRange(points[point - 1], points[point]);
+    m_segmentCells[id] = range;
+    for(unsigned short y = range.minY; y <= range.maxY; ++y) {
+        for(unsigned short x = range.minX; x <= range.maxX; ++x) {
+            m_cells[static_cast<size_t>(y) * m_cols + x].push_back(id);
+        }
+    }
+}
+
+void EditVertexIndex::removeSegment(unsigned id)
+{
+    const CellRange &range = m_segmentCells[id];
+    for(unsigned short y = range.minY; y <= range.maxY; ++y) {
+        for(unsigned short x = range.minX; x <= range.maxX; ++x) {
+            std::vector<unsigned> &cell =
+                    m_cells[static_cast<size_t>(y) * m_cols + x];
+            auto it = std::find(cell.begin(), cell.end(), id);
+            if(it != cell.end()) {
+                *it = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -2012,11 +4419,14 @@ void EditLine::updateSelectedPoint(const OGRRawPoint &pt, bool log)
         return;
     }
 
+    unsigned version = m_data.version();
     if(log) {
         m_data.saveState();
     }
 
     m_data.m_data[static_cast<size_t>(m_selectedPoint.pointId)] = pt;
+    m_index.movePoint(0, 0, m_selectedPoint.pointId, version,
+                      m_data.version());
 }
 
 static GEOSGeom createGEOSLineString(GEOSContextHandlePtr handle,
@@ -2035,41 +4445,123 @@ static GEOSGeom createGEOSLineString(GEOSContextHandlePtr handle,
     return GEOSGeom_createLineString_r(handle.get(), seq);
 }
 
-GEOSGeom EditLine::toGEOSGeometry(GEOSContextHandlePtr handle) const
+static bool isInsideRing(const Line &ring, const OGRRawPoint &pt)
 {
-    return createGEOSLineString(handle, m_data.m_data, 2);
+    bool inside = false;
+    for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+        const OGRRawPoint &pi = ring[i];
+        const OGRRawPoint &pj = ring[j];
+        if((pi.y > pt.y) != (pj.y > pt.y) &&
+                pt.x < (pj.x - pi.x) * (pt.y - pi.y) / (pj.y - pi.y) + pi.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
 }
 
-ngsPointId EditLine::selectNearestPoint(const OGRRawPoint &pt, double tolerance)
+/**
+ * @brief isInsidePolygon Check if point is inside exterior ring and outside
+ * the holes.
+ * @param poly Polygon rings
+ * @param pt Point
+ * @return true if point is inside polygon
+ */
+static bool isInsidePolygon(const Polygon &poly, const OGRRawPoint &pt)
 {
-    // Check if line selected
-    GEOSContextHandlePtr handle;
+    if(poly.empty() || poly[0].size() < 3 || !isInsideRing(poly[0], pt)) {
+        return false;
+    }
+    for(size_t i = 1; i < poly.size(); ++i) {
+        if(poly[i].size() >= 3 && isInsideRing(poly[i], pt)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    GEOSGeometryWrap geosLineString(toGEOSGeometry(handle), handle);
-    if(geosLineString.distance(pt.x, pt.y) > tolerance ) {
-        return {NOT_FOUND, 0};
+/**
+ * @brief nearestRingPoint Find vertex or segment middle point of the ring near
+ * the touch point among the vertex index search result.
+ * @param ring Ring points
+ * @param segments Vertex index search result
+ * @param part Ring part
+ * @param ringId Ring index in part
+ * @param minPoints Ring with less points is empty
+ * @param pt Touch point
+ * @param tolerance Touch tolerance
+ * @param insert Set to true if segment middle point should be inserted
+ * @param midPoint Segment middle point
+ * @return Vertex index, index to insert middle point, 0 if only the ring is
+ * near the touch point or NOT_FOUND if the ring is far
+ */
+static int nearestRingPoint(const Line &ring,
+                            const std::vector<EditVertexIndex::Segment> &segments,
+                            int part, int ringId, size_t minPoints,
+                            const OGRRawPoint &pt, double tolerance,
+                            bool &insert, OGRRawPoint &midPoint)
+{
+    insert = false;
+    if(ring.size() < 2 || ring.size() < minPoints) {
+        return NOT_FOUND;
+    }
+
+    // Check if line selected
+    double tolerance2 = tolerance * tolerance;
+    auto touched = std::find_if(segments.begin(), segments.end(),
+                                [part, ringId, tolerance2](
+                                const EditVertexIndex::Segment &segment) {
+        return segment.part == part && segment.ring == ringId &&
+                segment.distance2 < tolerance2;
+    });
+    if(touched == segments.end()) {
+        return NOT_FOUND;
     }
 
     // Check if vertex or mid point selected
-    int id = 0;
-    OGRRawPoint prevPoint;
-    for(const OGRRawPoint &point : m_data.m_data) {
-        if(ngsIsNear(point, pt, tolerance)) {
-            return {id, 0};
+    for(const EditVertexIndex::Segment &segment : segments) {
+        if(segment.part != part || segment.ring != ringId) {
+            continue;
         }
-
-        if(id > 0) {
-            OGRRawPoint midPoint = ngsGetMiddlePoint(point, prevPoint);
-            if(ngsIsNear(midPoint, pt, tolerance)) {
-                // insert new point
-                insertPoint(id, midPoint);
-                return {id, 0};
-            }
+        const OGRRawPoint &beg = ring[static_cast<size_t>(segment.point - 1)];
+        const OGRRawPoint &end = ring[static_cast<size_t>(segment.point)];
+        if(ngsIsNear(beg, pt, tolerance)) {
+            return segment.point - 1;
+        }
+        if(ngsIsNear(end, pt, tolerance)) {
+            return segment.point;
+        }
+        midPoint = ngsGetMiddlePoint(beg, end);
+        if(ngsIsNear(midPoint, pt, tolerance)) {
+            insert = true;
+            return segment.point;
         }
-        prevPoint = pt;
-        id++;
     }
-    return {0, 0};
+    return 0;
+}
+
+GEOSGeom EditLine::toGEOSGeometry(GEOSContextHandlePtr handle) const
+{
+    return createGEOSLineString(handle, m_data.m_data, 2);
+}
+
+ngsPointId EditLine::selectNearestPoint(const OGRRawPoint &pt, double tolerance)
+{
+    if(!m_index.isValid(m_data.version())) {
+        m_index.build({ {&m_data.m_data, 0, 0} }, m_data.version());
+    }
+
+    bool insert;
+    OGRRawPoint midPoint;
+    int id = nearestRingPoint(m_data.m_data, m_index.search(pt, tolerance), 0,
+                              0, 2, pt, tolerance, insert, midPoint);
+    if(id == NOT_FOUND) {
+        return {NOT_FOUND, 0};
+    }
+    if(insert) {
+        // insert new point
+        insertPoint(id, midPoint);
+    }
+    return {id, 0};
 }
 
 void EditLine::insertPoint(int index, const OGRRawPoint &pt)
@@ -2271,12 +4763,15 @@ void EditPolygon::updateSelectedPoint(const OGRRawPoint &pt, bool log)
         return;
     }
 
+    unsigned version = m_data.version();
     if(log) {
         m_data.saveState();
     }
 
     Line &selectedRing = m_data.m_data[static_cast<size_t>(m_selectedRing)];
     selectedRing[static_cast<size_t>(m_selectedPoint.pointId)] = pt;
+    m_index.movePoint(0, m_selectedRing, m_selectedPoint.pointId, version,
+                      m_data.version());
 }
 
 ngsPointId EditPolygon::selectNearestPoint(const OGRRawPoint &pt, double tolerance)
@@ -2285,72 +4780,38 @@ ngsPointId EditPolygon::selectNearestPoint(const OGRRawPoint &pt, double toleran
         return {NOT_FOUND, 0};
     }
 
-    // Check if hole selected
-    GEOSContextHandlePtr handle;
-    unsigned numHoles = static_cast<unsigned>(m_data.m_data.size() - 1);
-    for(unsigned i = 0; i < numHoles; ++i) {
-        Line &ring = m_data.m_data[i + 1];
-        GEOSGeometryWrap geosLineString(
-                    createGEOSLineString(handle, ring, 3), handle);
-        if(geosLineString.distance(pt.x, pt.y) < tolerance ) {
-            // Line is selected
-            m_selectedRing = static_cast<int>(i + 1);
-
-            // Check if vertex or mid point selected
-            int id = 0;
-            OGRRawPoint prevPoint;
-            for(const OGRRawPoint &point : ring) {
-                if(ngsIsNear(point, pt, tolerance)) {
-                    return {id, 1};
-                }
-
-                if(id > 0) {
-                    OGRRawPoint midPoint = ngsGetMiddlePoint(point, prevPoint);
-                    if(ngsIsNear(midPoint, pt, tolerance)) {
-                        // insert new point
-                        insertPoint(id, midPoint);
-                        return {id, 1};
-                    }
-                }
-                prevPoint = pt;
-                id++;
-            }
-            return {0, 1};
+    if(!m_index.isValid(m_data.version())) {
+        std::vector<EditVertexIndex::Ring> rings;
+        for(size_t i = 0; i < m_data.m_data.size(); ++i) {
+            rings.push_back({&m_data.m_data[i], 0, static_cast<int>(i)});
+        }
+        m_index.build(rings, m_data.version());
+    }
+    std::vector<EditVertexIndex::Segment> segments =
+            m_index.search(pt, tolerance);
+
+    // Check if hole selected, then outer ring
+    size_t numRings = m_data.m_data.size();
+    for(size_t i = 1; i <= numRings; ++i) {
+        int ringId = static_cast<int>(i % numRings);
+        bool insert;
+        OGRRawPoint midPoint;
+        int id = nearestRingPoint(m_data.m_data[i % numRings], segments, 0,
+                                  ringId, 3, pt, tolerance, insert, midPoint);
+        if(id == NOT_FOUND) {
+            continue;
         }
-    }
-
-    // Check if outer ring selected
-    GEOSGeometryWrap geosLineString(
-                createGEOSLineString(handle, m_data.m_data[0], 3), handle);
-    if(geosLineString.distance(pt.x, pt.y) < tolerance ) {
         // Line is selected
-        m_selectedRing = 0;
-
-        // Check if vertex or mid point selected
-        int id = 0;
-        OGRRawPoint prevPoint;
-        for(const OGRRawPoint &point : m_data.m_data[0]) {
-            if(ngsIsNear(point, pt, tolerance)) {
-                return {id, 0};
-            }
-
-            if(id > 0) {
-                OGRRawPoint midPoint = ngsGetMiddlePoint(point, prevPoint);
-                if(ngsIsNear(midPoint, pt, tolerance)) {
-                    // insert new point
-                    insertPoint(id, midPoint);
-                    return {id, 0};
-                }
-            }
-            prevPoint = pt;
-            id++;
+        m_selectedRing = ringId;
+        if(insert) {
+            // insert new point
+            insertPoint(id, midPoint);
         }
-        return {0, 0};
+        return {id, ringId == 0 ? 0 : 1};
     }
 
     // Check if clicked inside polygon
-    GEOSGeometryWrap geosPolygon(toGEOSGeometry(handle), handle);
-    if(geosPolygon.intersects(pt.x, pt.y)) {
+    if(isInsidePolygon(m_data.m_data, pt)) {
         m_selectedRing = 0;
         return {0, 0};
     }
@@ -2699,50 +5160,50 @@ void EditMultiLine::updateSelectedPoint(const OGRRawPoint &pt, bool log)
         return;
     }
 
+    unsigned version = m_data.version();
     if(log) {
         m_data.saveState();
     }
 
     Line &selectedPart = m_data.m_data[static_cast<size_t>(m_selectedPart)];
     selectedPart[static_cast<size_t>(m_selectedPoint.pointId)] = pt;
+    m_index.movePoint(m_selectedPart, 0, m_selectedPoint.pointId, version,
+                      m_data.version());
 }
 
 ngsPointId EditMultiLine::selectNearestPoint(const OGRRawPoint &pt,
                                              double tolerance)
 {
-    // Check if line selected
-    GEOSContextHandlePtr handle;
-
-    GEOSGeometryWrap geosLineString(toGEOSGeometry(handle), handle);
-    if(geosLineString.distance(pt.x, pt.y) > tolerance ) {
-        m_selectedPart = NOT_FOUND;
-        return {NOT_FOUND, 0};
+    if(!m_index.isValid(m_data.version())) {
+        std::vector<EditVertexIndex::Ring> rings;
+        for(size_t i = 0; i < m_data.m_data.size(); ++i) {
+            rings.push_back({&m_data.m_data[i], static_cast<int>(i), 0});
+        }
+        m_index.build(rings, m_data.version());
     }
+    std::vector<EditVertexIndex::Segment> segments =
+            m_index.search(pt, tolerance);
 
-    // Check if vertex or mid point selected
-    m_selectedPart = 0;
-    for(const Line &line : m_data.m_data) {
-        int id = 0;
-        OGRRawPoint prevPoint;
-        for(const OGRRawPoint &point : line) {
-            if(ngsIsNear(point, pt, tolerance)) {
-                return {id, 0};
-            }
-
-            if(id > 0) {
-                OGRRawPoint midPoint = ngsGetMiddlePoint(point, prevPoint);
-                if(ngsIsNear(midPoint, pt, tolerance)) {
-                    // insert new point
-                    insertPoint(id, midPoint);
-                    return {id, 0};
-                }
-            }
-            prevPoint = pt;
-            id++;
+    for(size_t i = 0; i < m_data.m_data.size(); ++i) {
+        bool insert;
+        OGRRawPoint midPoint;
+        int id = nearestRingPoint(m_data.m_data[i], segments,
+                                  static_cast<int>(i), 0, 2, pt, tolerance,
+                                  insert, midPoint);
+        if(id == NOT_FOUND) {
+            continue;
         }
-        m_selectedPart++;
+        // Line is selected
+        m_selectedPart = static_cast<int>(i);
+        if(insert) {
+            // insert new point
+            insertPoint(id, midPoint);
+        }
+        return {id, 0};
     }
-    return {0, 0};
+
+    m_selectedPart = NOT_FOUND;
+    return {NOT_FOUND, 0};
 }
 
 GEOSGeom EditMultiLine::toGEOSGeometry(GEOSContextHandlePtr handle) const
@@ -3006,6 +5467,7 @@ void EditMultiPolygon::updateSelectedPoint(const OGRRawPoint &pt, bool log)
         return;
     }
 
+    unsigned version = m_data.version();
     if(log) {
         m_data.saveState();
     }
@@ -3013,6 +5475,8 @@ void EditMultiPolygon::updateSelectedPoint(const OGRRawPoint &pt, bool log)
     Polygon &selectedPart = m_data.m_data[static_cast<size_t>(m_selectedPart)];
     Line &selectedRing = selectedPart[static_cast<size_t>(m_selectedRing)];
     selectedRing[static_cast<size_t>(m_selectedPoint.pointId)] = pt;
+    m_index.movePoint(m_selectedPart, m_selectedRing, m_selectedPoint.pointId,
+                      version, m_data.version());
 }
 
 ngsPointId EditMultiPolygon::selectNearestPoint(const OGRRawPoint &pt, double tolerance)
@@ -3023,74 +5487,45 @@ ngsPointId EditMultiPolygon::selectNearestPoint(const OGRRawPoint &pt, double to
         return {NOT_FOUND, 0};
     }
 
-    m_selectedPart = 0;
-    for(const Polygon &polygon : m_data.m_data) {
-        // Check if hole selected
-        GEOSContextHandlePtr handle;
-        unsigned numHoles = static_cast<unsigned>(polygon.size() - 1);
-        for(unsigned i = 0; i < numHoles; ++i) {
-
-            GEOSGeometryWrap geosLineString(
-                        createGEOSLineString(handle, polygon[i + 1], 3), handle);
-            if(geosLineString.distance(pt.x, pt.y) < tolerance ) {
-                // Line is selected
-                m_selectedRing = static_cast<int>(i + 1);
-
-                // Check if vertex or mid point selected
-                int id = 0;
-                OGRRawPoint prevPoint;
-                for(const OGRRawPoint &point : polygon[i + 1]) {
-                    if(ngsIsNear(point, pt, tolerance)) {
-                        return {id, 1};
-                    }
-
-                    if(id > 0) {
-                        OGRRawPoint midPoint = ngsGetMiddlePoint(point, prevPoint);
-                        if(ngsIsNear(midPoint, pt, tolerance)) {
-                            // insert new point
-                            insertPoint(id, midPoint);
-                            return {id, 1};
-                        }
-                    }
-                    prevPoint = pt;
-                    id++;
-                }
-                return {0, 1};
+    if(!m_index.isValid(m_data.version())) {
+        std::vector<EditVertexIndex::Ring> rings;
+        for(size_t i = 0; i < m_data.m_data.size(); ++i) {
+            Polygon &polygon = m_data.m_data[i];
+            for(size_t j = 0; j < polygon.size(); ++j) {
+                rings.push_back({&polygon[j], static_cast<int>(i),
+                                 static_cast<int>(j)});
             }
         }
+        m_index.build(rings, m_data.version());
+    }
+    std::vector<EditVertexIndex::Segment> segments =
+            m_index.search(pt, tolerance);
 
-        // Check if outer ring selected
-        GEOSGeometryWrap geosLineString(
-                    createGEOSLineString(handle, polygon[0], 3), handle);
-        if(geosLineString.distance(pt.x, pt.y) < tolerance ) {
+    m_selectedPart = 0;
+    for(const Polygon &polygon : m_data.m_data) {
+        // Check if hole selected, then outer ring
+        size_t numRings = polygon.size();
+        for(size_t i = 1; i <= numRings; ++i) {
+            int ringId = static_cast<int>(i % numRings);
+            bool insert;
+            OGRRawPoint midPoint;
+            int id = nearestRingPoint(polygon[i % numRings], segments,
+                                      m_selectedPart, ringId, 3, pt, tolerance,
+                                      insert, midPoint);
+            if(id == NOT_FOUND) {
+                continue;
+            }
             // Line is selected
-            m_selectedRing = 0;
-
-            // Check if vertex or mid point selected
-            int id = 0;
-            OGRRawPoint prevPoint;
-            for(const OGRRawPoint &point : polygon[0]) {
-                if(ngsIsNear(point, pt, tolerance)) {
-                    return {id, 0};
-                }
-
-                if(id > 0) {
-                    OGRRawPoint midPoint = ngsGetMiddlePoint(point, prevPoint);
-                    if(ngsIsNear(midPoint, pt, tolerance)) {
-                        // insert new point
-                        insertPoint(id, midPoint);
-                        return {id, 0};
-                    }
-                }
-                prevPoint = pt;
-                id++;
+            m_selectedRing = ringId;
+            if(insert) {
+                // insert new point
+                insertPoint(id, midPoint);
             }
-            return {0, 0};
+            return {id, ringId == 0 ? 0 : 1};
         }
 
         // Check if clicked inside polygon
-        GEOSGeometryWrap geosPolygon(toGEOSGeometry(handle), handle);
-        if(geosPolygon.intersects(pt.x, pt.y)) {
+        if(isInsidePolygon(polygon, pt)) {
             m_selectedRing = 0;
             return {0, 0};
         }
@@ -28,12 +28,18 @@
 
 // std
 #include <array>
+#include <initializer_list>
 #include <memory>
 #include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "api_priv.h"
 #include "ngstore/util/constants.h"
 #include "util/buffer.h"
+#include "util/progress.h"
 #include "coordinatetransformation.h"
 
 namespace ngs {
@@ -99,6 +105,26 @@ protected:
     double m_minX, m_minY, m_maxX, m_maxY;
 };
 
+/**
+ * @brief The EnvelopeArray class Envelopes stored as coordinate arrays. One
+ * envelope is tested against all of them in one branch free loop over
+ * contiguous arrays. Results are OR'ed to the mask, one byte per envelope, so
+ * several tests can be combined in one mask.
+ */
+class EnvelopeArray
+{
+public:
+    void reserve(size_t size);
+    void add(const Envelope &env);
+    void clear();
+    size_t size() const { return m_minX.size(); }
+    void intersects(const Envelope &env, std::vector<GByte> &mask) const;
+    void contains(const Envelope &env, std::vector<GByte> &mask) const;
+
+private:
+    std::vector<double> m_minX, m_minY, m_maxX, m_maxY;
+};
+
 constexpr unsigned short DEFAULT_EPSG = 3857;
 
 constexpr Envelope DEFAULT_BOUNDS = Envelope(-20037508.34, -20037508.34,
@@ -122,6 +148,14 @@ typedef struct _normal {
 
 Normal ngsGetNormals(const SimplePoint &beg, const SimplePoint &end);
 
+void clipLineByRect(const std::vector<OGRRawPoint> &line, const Envelope &env,
+                    std::vector<std::vector<OGRRawPoint>> &parts);
+bool clipRingByRect(const std::vector<OGRRawPoint> &ring, const Envelope &env,
+                    std::vector<OGRRawPoint> &clipped);
+void snapToGrid(std::vector<OGRRawPoint> &points, double step, bool isRing);
+void simplifyDouglasPeucker(std::vector<OGRRawPoint> &points, double tolerance,
+                            bool isRing);
+
 typedef struct _tile{
     int x, y;
     unsigned char z;
@@ -151,17 +185,102 @@ double ngsDistance(const OGRRawPoint &pt1, const OGRRawPoint &pt2);
 bool ngsIsNear(const OGRRawPoint &pt1, const OGRRawPoint &pt2, double tolerance);
 OGRRawPoint ngsGetMiddlePoint(const OGRRawPoint &pt1, const OGRRawPoint &pt2);
 
+/**
+ * @brief The FeatureIDs class Sorted set of unique feature identifiers stored
+ * in the contiguous array. Lookups are binary searches and set operations are
+ * linear merges without per node allocations.
+ */
+class FeatureIDs
+{
+public:
+    using const_iterator = std::vector<GIntBig>::const_iterator;
+
+public:
+    FeatureIDs() = default;
+    FeatureIDs(std::initializer_list<GIntBig> ids);
+    FeatureIDs(const std::set<GIntBig> &ids);
+    template<class InputIt> FeatureIDs(InputIt first, InputIt last) :
+        m_ids(first, last) { normalize(); }
+    void insert(GIntBig id);
+    bool erase(GIntBig id);
+    void erase(const FeatureIDs &other);
+    void clear() { m_ids.clear(); }
+    const_iterator find(GIntBig id) const;
+    bool contains(GIntBig id) const { return find(id) != m_ids.end(); }
+    bool includes(const GIntBig *first, const GIntBig *last) const;
+    bool intersects(const GIntBig *first, const GIntBig *last) const;
+    FeatureIDs intersection(const FeatureIDs &other) const;
+    const_iterator begin() const { return m_ids.begin(); }
+    const_iterator end() const { return m_ids.end(); }
+    const GIntBig *data() const { return m_ids.data(); }
+    size_t size() const { return m_ids.size(); }
+    bool empty() const { return m_ids.empty(); }
+    bool operator==(const FeatureIDs &other) const {
+        return m_ids == other.m_ids;
+    }
+
+private:
+    void normalize();
+
+private:
+    std::vector<GIntBig> m_ids;
+};
+
+class FlatVectorTile;
+class FlatVectorTileItem;
+
+enum class TileColumnType : GUInt32 {
+    STRING,
+    NUMBER
+};
+
+/**
+ * @brief The TileColumn struct Feature field stored with the tile items.
+ */
+typedef struct _tileColumn {
+    std::string name;
+    TileColumnType type;
+    bool operator==(const struct _tileColumn &other) const {
+        return type == other.type && name == other.name;
+    }
+} TileColumn;
+
+using TileColumns = std::vector<TileColumn>;
+using TileColumnsPtr = std::shared_ptr<const TileColumns>;
+
+/**
+ * @brief The TileAttributes struct Feature field values in the columns order.
+ * Shared by all items the feature geometry is tiled to.
+ */
+typedef struct _tileAttributes {
+    TileColumnsPtr columns;
+    std::vector<std::string> values;
+    std::vector<bool> nulls;
+} TileAttributes;
+
+using TileAttributesPtr = std::shared_ptr<const TileAttributes>;
+
+// Virtual tile item field with the number of the item features
+constexpr const char *CLUSTER_COUNT_FIELD = "point_count";
+
 class VectorTileItem
 {
     friend class VectorTile;
+    friend class FlatVectorTile;
 public:
     VectorTileItem();
+    explicit VectorTileItem(const FlatVectorTileItem &item);
     void addId(GIntBig id) { m_ids.insert(id); }
     void removeId(GIntBig id);
     void addPoint(const SimplePoint &pt) { m_points.push_back(pt); }
+    void addPoints(const std::vector<OGRRawPoint> &points);
     void addIndex(unsigned short index) { m_indices.push_back(index); }
     void addBorderIndex(unsigned short ring, unsigned short index);
     void addCentroid(const SimplePoint &pt) { m_centroids.push_back(pt); }
+    void setAttributes(const TileAttributesPtr &attributes) {
+        m_attributes = attributes;
+    }
+    const TileAttributesPtr &attributes() const { return m_attributes; }
 
     size_t pointCount() const { return m_points.size(); }
     const SimplePoint &point(size_t index) const { return m_points[index]; }
@@ -174,21 +293,22 @@ public:
     bool isValid() const { return m_valid; }
     void setValid(bool valid) { m_valid = valid; }
     bool operator==(const VectorTileItem &other) const {
-        return m_points == other.m_points;
+        return m_points == other.m_points && isSameAttributes(other);
     }
-    bool isIdsPresent(const std::set<GIntBig> &other, bool full = true) const;
-    std::set<GIntBig> idsIntesect(const std::set<GIntBig> &other) const;
+    bool isIdsPresent(const FeatureIDs &other, bool full = true) const;
+    FeatureIDs idsIntesect(const FeatureIDs &other) const;
 
 protected:
     void loadIds(const VectorTileItem &item);
-    void save(Buffer *buffer);
     bool load(Buffer &buffer);
+    bool isSameAttributes(const VectorTileItem &other) const;
 private:
     std::vector<SimplePoint> m_points;
     std::vector<unsigned short> m_indices;
     std::vector<std::vector<unsigned short>> m_borderIndices; // NOTE: first array is exterior ring indices
     std::vector<SimplePoint> m_centroids;
-    std::set<GIntBig> m_ids;
+    FeatureIDs m_ids;
+    TileAttributesPtr m_attributes;
     bool m_valid;
     bool m_2d;
 };
@@ -200,11 +320,17 @@ class VectorTile
 public:
     VectorTile() : m_valid(false) {}
     void add(const VectorTileItem &item, bool checkDuplicates = false);
+    void add(VectorTileItem &&item, bool checkDuplicates = false);
     void add(const VectorTileItemArray &items, bool checkDuplicates = false);
+    void add(VectorTileItemArray &&items, bool checkDuplicates = false);
+    void add(VectorTile &&tile, bool checkDuplicates = false);
     void remove(GIntBig id);
-    BufferPtr save();
+    void remove(const FeatureIDs &ids);
+    void clusterPoints(const Envelope &extent, unsigned short cells);
+    BufferPtr save(bool quantize = false) const;
     bool load(Buffer &buffer);
-    VectorTileItemArray items() const { return m_items; }
+    const VectorTileItemArray &items() const { return m_items; }
+    size_t itemCount() const { return m_items.size(); }
     bool empty() const;
     bool isValid() const { return m_valid; }
 private:
@@ -212,35 +338,288 @@ private:
     bool m_valid;
 };
 
+/**
+ * @brief The ArrayView class Read only view to the contiguous array.
+ */
+template<class T> class ArrayView
+{
+public:
+    ArrayView() : m_data(nullptr), m_size(0) {}
+    ArrayView(const T *data, size_t size) : m_data(data), m_size(size) {}
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_size; }
+    const T &operator[](size_t index) const { return m_data[index]; }
+    const T *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return 0 == m_size; }
+
+private:
+    const T *m_data;
+    size_t m_size;
+};
+
+/**
+ * @brief The FlatVectorTileItem class View to the item stored in the
+ * FlatVectorTile. Valid until the tile is changed or destroyed.
+ */
+class FlatVectorTileItem
+{
+    friend class FlatVectorTile;
+    friend class VectorTileItem;
+public:
+    size_t pointCount() const { return m_points.size(); }
+    const SimplePoint &point(size_t index) const { return m_points[index]; }
+    bool isClosed() const;
+    const ArrayView<SimplePoint> &points() const { return m_points; }
+    const ArrayView<unsigned short> &indices() const { return m_indices; }
+    size_t borderCount() const { return m_borderCount; }
+    ArrayView<unsigned short> borderIndices(size_t ring) const {
+        return ArrayView<unsigned short>(m_borderIndices + m_borderOffsets[ring],
+            m_borderOffsets[ring + 1] - m_borderOffsets[ring]);
+    }
+    const ArrayView<SimplePoint> &centroids() const { return m_centroids; }
+    const ArrayView<GIntBig> &ids() const { return m_ids; }
+    bool isIdsPresent(const FeatureIDs &other, bool full = true) const;
+    size_t attributeCount() const;
+    bool isAttributeNull(size_t column) const {
+        return nullptr == m_attributes || 0 == m_attributes[column];
+    }
+    const std::string &attributeString(size_t column) const;
+    double attributeNumber(size_t column) const;
+
+protected:
+    FlatVectorTileItem();
+
+private:
+    ArrayView<SimplePoint> m_points;
+    ArrayView<unsigned short> m_indices;
+    const GUInt32 *m_borderOffsets;
+    const unsigned short *m_borderIndices;
+    size_t m_borderCount;
+    ArrayView<SimplePoint> m_centroids;
+    ArrayView<GIntBig> m_ids;
+    const FlatVectorTile *m_tile;
+    // Column value index + 1 or 0 for null
+    const GUInt32 *m_attributes;
+};
+
+constexpr GUInt32 VECTOR_TILE_MAGIC = 0x5456474E; // NGVT
+// The magic of blob saved on the host of other byte order
+constexpr GUInt32 VECTOR_TILE_SWAPPED_MAGIC = 0x4E475654;
+constexpr GUInt32 VECTOR_TILE_VERSION = 2;
+constexpr GUInt32 VECTOR_TILE_QUANTIZED_VERSION = 3;
+
+/**
+ * @brief The FlatVectorTile class Read only vector tile. All items share the
+ * same point, index, border, centroid and id arrays and are described by
+ * offsets into them. This keeps the tile in several allocations independent
+ * of the item count.
+ * The tile blob (version 2) stores these arrays as is, 8 byte aligned, so
+ * attach() reads the tile in place without decoding. Blobs of version 1 are
+ * decoded by load().
+ * The version 3 blob is the same, but points and centroids are stored as
+ * 16 bit integers relative to the tile points bounds. attach() decodes only
+ * these two arrays, the other ones are read in place.
+ * Item attributes are dictionary encoded per tile: each column keeps the
+ * distinct values, each item keeps the value index per column. They go after
+ * the geometry arrays, so blobs without attributes are unchanged.
+ * Blobs of version 2 and 3 are in the host byte order. The magic marks it, the
+ * blob of other byte order is rejected and the tile has to be rebuilt.
+ */
+class FlatVectorTile
+{
+    friend class FlatVectorTileItem;
+public:
+    class ConstIterator
+    {
+    public:
+        ConstIterator(const FlatVectorTile *tile, size_t index) :
+            m_tile(tile), m_index(index) {}
+        FlatVectorTileItem operator*() const { return m_tile->item(m_index); }
+        ConstIterator &operator++() { ++m_index; return *this; }
+        bool operator==(const ConstIterator &other) const {
+            return m_index == other.m_index && m_tile == other.m_tile;
+        }
+        bool operator!=(const ConstIterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const FlatVectorTile *m_tile;
+        size_t m_index;
+    };
+
+public:
+    FlatVectorTile();
+    explicit FlatVectorTile(const VectorTile &tile);
+    FlatVectorTile(const FlatVectorTile &other);
+    FlatVectorTile(FlatVectorTile &&other) = default;
+    FlatVectorTile &operator=(const FlatVectorTile &other);
+    FlatVectorTile &operator=(FlatVectorTile &&other) = default;
+    void add(const VectorTileItem &item);
+    void add(const VectorTileItemArray &items);
+    bool load(Buffer &buffer);
+    /**
+     * @brief attach Use the version 2 tile blob in place.
+     * @param data Blob data. Must be 8 byte aligned.
+     * @param size Blob size in bytes.
+     * @param holder Owner of the blob memory, kept while tile is alive.
+     * @return true if blob is version 2 or 3 and valid, i.e. all the offsets
+     * and indices are inside the arrays, else tile stays unchanged.
+     */
+    bool attach(const GByte *data, size_t size,
+                const std::shared_ptr<void> &holder);
+    BufferPtr save(bool quantize = false) const;
+    size_t itemCount() const { return m_itemsView.size(); }
+    FlatVectorTileItem item(size_t index) const;
+    ConstIterator begin() const { return ConstIterator(this, 0); }
+    ConstIterator end() const { return ConstIterator(this, itemCount()); }
+    bool empty() const { return m_pointsView.empty(); }
+    bool isValid() const { return m_valid; }
+    bool isAttached() const { return nullptr != m_holder; }
+    size_t dataSize() const;
+    const TileColumnsPtr &columns() const { return m_columns; }
+    size_t columnCount() const { return m_columns ? m_columns->size() : 0; }
+    int columnIndex(const std::string &name) const;
+
+private:
+    typedef struct _itemOffsets {
+        GUInt32 pointOffset;
+        GUInt32 pointCount;
+        GUInt32 indexOffset;
+        GUInt32 indexCount;
+        GUInt32 borderOffset;
+        GUInt32 borderCount;
+        GUInt32 centroidOffset;
+        GUInt32 centroidCount;
+        GUInt32 idOffset;
+        GUInt32 idCount;
+    } ItemOffsets;
+
+    typedef struct _header {
+        GUInt32 magic;
+        GUInt32 version;
+        GUInt32 itemCount;
+        GUInt32 pointCount;
+        GUInt32 indexCount;
+        GUInt32 borderCount;
+        GUInt32 borderIndexCount;
+        GUInt32 centroidCount;
+        GUInt32 idCount;
+        // Size of the attributes section after the geometry arrays
+        GUInt32 attributesSize;
+    } Header;
+
+private:
+    static size_t blobSize(const Header &header);
+    static bool checkItems(const Header &header, const ItemOffsets *items,
+                           const GUInt32 *borderOffsets,
+                           const unsigned short *indices,
+                           const unsigned short *borderIndices);
+    bool loadVersion1(Buffer &buffer, GUInt32 itemCount);
+    void updateViews();
+    void detach();
+    void addAttributes(const TileAttributesPtr &attributes);
+    BufferPtr saveAttributes() const;
+    bool loadAttributes(const GByte *data, size_t size, GUInt32 itemCount);
+
+private:
+    std::vector<ItemOffsets> m_items;
+    std::vector<SimplePoint> m_points;
+    std::vector<unsigned short> m_indices;
+    // NOTE: Ring N indices are in [m_borderOffsets[N], m_borderOffsets[N + 1])
+    std::vector<GUInt32> m_borderOffsets;
+    std::vector<unsigned short> m_borderIndices;
+    std::vector<SimplePoint> m_centroids;
+    std::vector<GIntBig> m_ids;
+    // Views to the owned arrays above or to the attached blob
+    ArrayView<ItemOffsets> m_itemsView;
+    ArrayView<SimplePoint> m_pointsView;
+    ArrayView<unsigned short> m_indicesView;
+    ArrayView<GUInt32> m_borderOffsetsView;
+    ArrayView<unsigned short> m_borderIndicesView;
+    ArrayView<SimplePoint> m_centroidsView;
+    ArrayView<GIntBig> m_idsView;
+    std::shared_ptr<void> m_holder;
+    // Attributes are always decoded to the owned arrays
+    TileColumnsPtr m_columns;
+    std::vector<std::vector<std::string>> m_dictionaries;
+    std::vector<std::vector<double>> m_numbers;
+    std::vector<GUInt32> m_attributeIndices;
+    // Built on add, not copied with the tile
+    std::vector<std::unordered_map<std::string, GUInt32>> m_dictionaryIndices;
+    bool m_valid;
+};
+
+constexpr GUInt32 VECTOR_TILE_COMPRESSED_MAGIC = 0x5A56474E; // NGVZ
+
+/**
+ * @brief The TileCompression enum Codec of the stored tile blob. Compressed
+ * blob has own header with codec and size, so it is recognized on read
+ * whatever codec the overviews were created with.
+ */
+enum class TileCompression {
+    NONE,
+    DEFLATE,
+    ZSTD,
+    LZ4
+};
+
+TileCompression tileCompressionFromString(const std::string &name);
+const char *tileCompressionToString(TileCompression compression);
+bool isTileCompressionAvailable(TileCompression compression);
+BufferPtr compressTileBlob(const BufferPtr &blob, TileCompression compression);
+BufferPtr decompressTileBlob(const GByte *data, size_t size);
+
+/**
+ * @brief The GEOSContextHandlePtr class GEOS context. The default constructor
+ * creates a new context, threadContext() returns the context shared by all
+ * GEOS calls in the current thread. The context is freed when the thread exits
+ * and no geometry references it.
+ */
 class GEOSContextHandlePtr : public std::shared_ptr<struct GEOSContextHandle_HS>
 {
 public:
     GEOSContextHandlePtr() : shared_ptr(OGRGeometry::createGEOSContext(),
                                         OGRGeometry::freeGEOSContext) {}
+    static GEOSContextHandlePtr threadContext();
 };
 
 class GEOSGeometryWrap;
 using  GEOSGeometryPtr = std::shared_ptr<GEOSGeometryWrap>;
 class GEOSGeometryWrap
 {
+public:
+    enum class SimplifyType {
+        GRID,
+        DOUGLAS_PEUCKER
+    };
+
 public:
     explicit GEOSGeometryWrap(GEOSGeom geom, GEOSContextHandlePtr handle);
     explicit GEOSGeometryWrap(OGRGeometry *geom);
+    GEOSGeometryWrap(OGRGeometry *geom, GEOSContextHandlePtr handle);
     ~GEOSGeometryWrap();
     GEOSGeom geom() const { return m_geom; }
     int type() const;
     GEOSGeometryPtr clip(const Envelope &env) const;
-    void simplify(double step);
+    GEOSGeometryPtr clone() const;
+    void simplify(double step, SimplifyType simplifyType = SimplifyType::GRID);
     bool isValid() const { return m_geom != nullptr; }
-    void fillTile(GIntBig fid, VectorTileItemArray &vitemArray);
+    void fillTile(GIntBig fid, VectorTileItemArray &vitemArray,
+                  const CancelToken &cancel = CancelToken());
     double distance(double x, double y) const;
     bool intersects(double x, double y) const;
+    void attachToThread();
 
 private:
     GEOSGeom generalizePoint(const GEOSGeom_t *geom, double step);
     GEOSGeom generalizeMultiPoint(const GEOSGeom_t *geom, double step);
-    GEOSGeom generalizeLine(const GEOSGeom_t *geom, double step, bool isRing = false);
-    GEOSGeom generalizeMultiLine(const GEOSGeom_t *geom, double step);
+    GEOSGeom generalizeLine(const GEOSGeom_t *geom, double step,
+                            bool isRing = false,
+                            SimplifyType simplifyType = SimplifyType::GRID);
+    GEOSGeom generalizeMultiLine(const GEOSGeom_t *geom, double step,
+                                 SimplifyType simplifyType);
     GEOSGeom generalizePolygon(const GEOSGeom_t *geom, double step);
     GEOSGeom generalizeMultiPolygon(const GEOSGeom_t *geom, double step);
     void setCentroid(int type);
@@ -251,21 +630,65 @@ private:
     void fillLineTile(GIntBig fid, const GEOSGeom_t *geom,
                        VectorTileItemArray &vitemArray);
     void fillMultiLineTile(GIntBig fid, const GEOSGeom_t *geom,
-                       VectorTileItemArray &vitemArray);
+                       VectorTileItemArray &vitemArray,
+                       const CancelToken &cancel);
     void fillPolygonTile(GIntBig fid, const GEOSGeom_t *geom,
                        VectorTileItemArray &vitemArray);
     void fillMultiPolygonTile(GIntBig fid, const GEOSGeom_t *geom,
-                       VectorTileItemArray &vitemArray);
+                       VectorTileItemArray &vitemArray,
+                       const CancelToken &cancel);
     void fillCollectionTile(GIntBig fid, const GEOSGeom_t *geom,
-                       VectorTileItemArray &vitemArray);
+                       VectorTileItemArray &vitemArray,
+                       const CancelToken &cancel);
+    GEOSGeom clipByRect(const GEOSGeom_t *geom, const Envelope &env) const;
+    bool clipPart(const GEOSGeom_t *geom, const Envelope &env,
+                  std::vector<GEOSGeom> &parts) const;
+    bool clipPoint(const GEOSGeom_t *geom, const Envelope &env,
+                   std::vector<GEOSGeom> &parts) const;
+    bool clipLine(const GEOSGeom_t *geom, const Envelope &env,
+                  std::vector<GEOSGeom> &parts) const;
+    bool clipPolygon(const GEOSGeom_t *geom, const Envelope &env,
+                     std::vector<GEOSGeom> &parts) const;
+    bool coordinates(const GEOSGeom_t *geom, std::vector<OGRRawPoint> &points) const;
+    struct GEOSCoordSeq_t *createCoordSeq(const std::vector<OGRRawPoint> &points) const;
 
 private:
     GEOSGeom m_geom;
     GEOSContextHandlePtr m_geosHandle;
 };
 
+bool fillTileFromOGR(GIntBig fid, const OGRGeometry *geom, double step,
+                     GEOSGeometryWrap::SimplifyType simplifyType,
+                     VectorTileItemArray &vitemArray);
+void fillPolygonTile(GIntBig fid,
+                     const std::vector<std::vector<SimplePoint>> &rings,
+                     VectorTileItemArray &vitemArray);
+
+/**
+ * @brief The EditDelta class. Change of the edit geometry data between two
+ * saved states. The range of elements at offset is replaced, if only one
+ * element is changed, its own change is stored in child.
+ */
+template<class T> struct EditDelta;
+
+template<> struct EditDelta<OGRRawPoint>
+{
+    OGRRawPoint removed, inserted;
+};
+
+template<class T> struct EditDelta<std::vector<T>>
+{
+    EditDelta() : offset(0) {}
+    size_t offset;
+    std::vector<T> removed, inserted;
+    std::vector<EditDelta<T>> child;
+};
+
 /**
- * @brief The EditGeometryData class.
+ * @brief The EditGeometryData class. Keeps the edit history as deltas between
+ * saved states, so an edit step of large geometry stores only changed
+ * vertices. m_base is a copy of the last saved state to compute the delta of
+ * the next step.
  */
 template<class T> class EditGeometryData
 {
@@ -277,12 +700,76 @@ public:
     bool undo();
     bool redo();
     void saveState();
+    unsigned version() const { return m_version; }
 
     T m_data;
-    std::vector<T> m_history;
-    
+
 protected:
+    bool commitState();
+
+protected:
+    T m_base;
+    std::vector<EditDelta<T>> m_history;
     size_t m_currentEditStep;
+    bool m_hasBase, m_pending;
+    unsigned m_version;
+};
+
+using Line = std::vector<OGRRawPoint>;
+
+/**
+ * @brief The EditVertexIndex class. Uniform grid of edit geometry segments, so
+ * touch hit test checks only segments near the touch point. Vertex move
+ * updates the grid in place, other edits change the data version and the grid
+ * is rebuilt on next search.
+ */
+class EditVertexIndex
+{
+public:
+    typedef struct _ring {
+        const Line *points;
+        int part;
+        int ring;
+    } Ring;
+    /**
+     * @brief The Segment struct. Segment from point - 1 to point vertex and
+     * squared distance to the search point.
+     */
+    typedef struct _segment {
+        int part;
+        int ring;
+        int point;
+        double distance2;
+    } Segment;
+
+public:
+    EditVertexIndex();
+    bool isValid(unsigned version) const {
+        return m_valid && m_version == version;
+    }
+    void build(const std::vector<Ring> &rings, unsigned version);
+    void movePoint(int part, int ring, int point, unsigned version,
+                   unsigned newVersion);
+    std::vector<Segment> search(const OGRRawPoint &pt, double tolerance) const;
+
+protected:
+    typedef struct _cellRange {
+        unsigned short minX, minY, maxX, maxY;
+    } CellRange;
+    CellRange cellRange(const OGRRawPoint &pt1, const OGRRawPoint &pt2) const;
+    void addSegment(unsigned id);
+    void removeSegment(unsigned id);
+
+protected:
+    std::vector<Ring> m_rings;
+    std::vector<unsigned> m_ringOffsets, m_segmentRings;
+    std::vector<CellRange> m_segmentCells;
+    std::vector<std::vector<unsigned>> m_cells;
+    Envelope m_extent;
+    double m_cellWidth, m_cellHeight;
+    unsigned short m_cols, m_rows;
+    unsigned m_version;
+    bool m_valid;
 };
 
 /**
@@ -335,7 +822,8 @@ protected:
 
 protected:
     ngsPointId m_selectedPoint;
-    bool m_isDragging;    
+    bool m_isDragging;
+    EditVertexIndex m_index;
 };
 
 using EditGeometryUPtr = std::unique_ptr<EditGeometry>;
@@ -375,14 +863,13 @@ protected:
 /**
  * @brief The EditLine class
  */
-using Line = std::vector<OGRRawPoint>;
 class EditLine : public EditGeometry
 {
 public:
     EditLine();
     explicit EditLine(OGRLineString *line);
     void init(double x1, double y1, double x2, double y2);
-    std::vector<OGRRawPoint> data() const { return m_data.m_data; }
+    const Line &data() const { return m_data.m_data; }
     int selectedPart() const { return m_selectedPoint.pointId == NOT_FOUND ? NOT_FOUND : 0; }
 
 protected:
@@ -423,7 +910,7 @@ public:
     EditPolygon();
     explicit EditPolygon(OGRPolygon *poly);
     void init(double x1, double y1, double x2, double y2);    
-    std::vector<Line> data() const { return m_data.m_data; }
+    const Polygon &data() const { return m_data.m_data; }
     int selectedRing() const { return m_selectedRing; }
     int selectedPart() const { return m_selectedRing == NOT_FOUND ? NOT_FOUND : 0; }
     
@@ -467,7 +954,7 @@ public:
     EditMultiPoint();
     explicit EditMultiPoint(OGRMultiPoint *mpoint);
     void init(double x, double y);
-    std::vector<OGRRawPoint> data() const { return m_data.m_data; }
+    const std::vector<OGRRawPoint> &data() const { return m_data.m_data; }
 
 protected:
     using MultiPoint = std::vector<OGRRawPoint>;
@@ -505,7 +992,7 @@ public:
     EditMultiLine();
     explicit EditMultiLine(OGRMultiLineString *mline);
     void init(double x1, double y1, double x2, double y2);
-    std::vector<Line> data() const { return m_data.m_data; }
+    const std::vector<Line> &data() const { return m_data.m_data; }
     int selectedPart() const { return m_selectedPart; }
 
 protected:
@@ -547,7 +1034,7 @@ public:
     EditMultiPolygon();
     explicit EditMultiPolygon(OGRMultiPolygon *mpoly);
     void init(double x1, double y1, double x2, double y2);  
-    std::vector<Polygon> data() const { return m_data.m_data; }
+    const std::vector<Polygon> &data() const { return m_data.m_data; }
     int selectedRing() const { return m_selectedRing; }
     int selectedPart() const { return m_selectedPart; }
 
@@ -0,0 +1,178 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "imagecache.h"
+
+// std
+#include <cstring>
+
+#include "util/settings.h"
+
+namespace ngs {
+
+constexpr size_t MB = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// ImageCache
+//------------------------------------------------------------------------------
+
+ImageCache &ImageCache::instance()
+{
+    static ImageCache cache;
+    return cache;
+}
+
+ImageCache::ImageCache() :
+    m_size(0),
+    m_maxSize(0)
+{
+    const Settings &settings = Settings::instance();
+    int maxSize = settings.getInteger("common/image_cache_size",
+                                      DEFAULT_IMAGE_CACHE_SIZE);
+    if(maxSize > 0) {
+        m_maxSize = static_cast<size_t>(maxSize) * MB;
+    }
+    MemoryBudget::instance().addConsumer(this);
+}
+
+ImageCache::~ImageCache()
+{
+    MemoryBudget::instance().removeConsumer(this);
+}
+
+/**
+ * @brief ImageCache::key Make cache key of raster window.
+ * @param path Raster path
+ * @param overview Overview index or -1 for raster itself
+ * @param xOff Window x offset in level pixels
+ * @param yOff Window y offset in level pixels
+ * @param width Window width
+ * @param height Window height
+ * @param style Bands and transparency the pixels are made with
+ * @return Key string.
+ */
+std::string ImageCache::key(const std::string &path, int overview, int xOff,
+                            int yOff, int width, int height,
+                            const std::string &style)
+{
+    return CPLSPrintf("%s|%d|%d|%d|%d|%d|%s", path.c_str(), overview, xOff,
+                      yOff, width, height, style.c_str());
+}
+
+/**
+ * @brief ImageCache::get Copy cached pixels.
+ * @param key Cache key
+ * @param data Buffer to copy pixels to
+ * @param size Buffer size in bytes
+ * @return True if the image is in cache and has the same size.
+ */
+bool ImageCache::get(const std::string &key, GByte *data, size_t size)
+{
+    MutexHolder holder(m_mutex);
+    auto it = m_index.find(key);
+    if(it == m_index.end() || it->second->data.size() != size) {
+        return false;
+    }
+
+    // Move to the front of the list
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    it->second->tick = MemoryBudget::tick();
+    std::memcpy(data, it->second->data.data(), size);
+    return true;
+}
+
+void ImageCache::put(const std::string &key, const GByte *data, size_t size)
+{
+    {
+        MutexHolder holder(m_mutex);
+        if(0 == m_maxSize || size > m_maxSize) {
+            return;
+        }
+
+        auto it = m_index.find(key);
+        if(it != m_index.end()) {
+            m_size -= it->second->data.size();
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+
+        evict(m_maxSize - size);
+        m_entries.push_front({ key, std::vector<GByte>(data, data + size),
+                               MemoryBudget::tick() });
+        m_index[key] = m_entries.begin();
+        m_size += size;
+    }
+    MemoryBudget::instance().enforce();
+}
+
+void ImageCache::clear()
+{
+    MutexHolder holder(m_mutex);
+    m_index.clear();
+    m_entries.clear();
+    m_size = 0;
+}
+
+void ImageCache::setMaxSize(size_t size)
+{
+    MutexHolder holder(m_mutex);
+    m_maxSize = size;
+    evict(m_maxSize);
+}
+
+size_t ImageCache::memoryUsed() const
+{
+    MutexHolder holder(m_mutex);
+    return m_size;
+}
+
+bool ImageCache::oldestAccess(GUIntBig &tick) const
+{
+    MutexHolder holder(m_mutex);
+    if(m_entries.empty()) {
+        return false;
+    }
+    tick = m_entries.back().tick;
+    return true;
+}
+
+size_t ImageCache::freeOldest()
+{
+    MutexHolder holder(m_mutex);
+    if(m_entries.empty()) {
+        return 0;
+    }
+    size_t size = m_entries.back().data.size();
+    m_size -= size;
+    m_index.erase(m_entries.back().key);
+    m_entries.pop_back();
+    return size;
+}
+
+void ImageCache::evict(size_t maxSize)
+{
+    while(m_size > maxSize && !m_entries.empty()) {
+        m_size -= m_entries.back().data.size();
+        m_index.erase(m_entries.back().key);
+        m_entries.pop_back();
+    }
+}
+
+} // namespace ngs
@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSIMAGECACHE_H
+#define NGSIMAGECACHE_H
+
+// std
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// gdal
+#include "cpl_port.h"
+
+#include "util/memorybudget.h"
+#include "util/mutex.h"
+
+namespace ngs {
+
+constexpr int DEFAULT_IMAGE_CACHE_SIZE = 64; // Mb
+
+/**
+ * @brief The ImageCache class Shared LRU cache of decoded raster tile pixels.
+ * Images are keyed by raster path, level window and style the pixels are made
+ * with, so maps showing the same raster copy pixels instead of reading and
+ * decoding them again. Budget is read from "common/image_cache_size" setting
+ * in megabytes, 0 disables cache. Images are also freed by the MemoryBudget,
+ * least recently drawn first.
+ */
+class ImageCache : public MemoryConsumer
+{
+public:
+    static ImageCache &instance();
+    static std::string key(const std::string &path, int overview, int xOff,
+                           int yOff, int width, int height,
+                           const std::string &style);
+
+public:
+    bool get(const std::string &key, GByte *data, size_t size);
+    void put(const std::string &key, const GByte *data, size_t size);
+    void clear();
+    void setMaxSize(size_t size);
+    size_t maxSize() const { return m_maxSize; }
+    size_t size() const { return m_size; }
+
+    // MemoryConsumer interface
+public:
+    virtual size_t memoryUsed() const override;
+    virtual bool oldestAccess(GUIntBig &tick) const override;
+    virtual size_t freeOldest() override;
+
+private:
+    ImageCache();
+    virtual ~ImageCache() override;
+    ImageCache(ImageCache const&) = delete;
+    ImageCache &operator= (ImageCache const&) = delete;
+
+private:
+    typedef struct _entry {
+        std::string key;
+        std::vector<GByte> data;
+        GUIntBig tick;
+    } Entry;
+
+    using EntryList = std::list<Entry>;
+
+private:
+    void evict(size_t maxSize);
+
+private:
+    EntryList m_entries; // NOTE: Most recently used first
+    std::map<std::string, EntryList::iterator> m_index;
+    size_t m_size;
+    size_t m_maxSize;
+    mutable Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSIMAGECACHE_H
@@ -32,9 +32,12 @@
 #include "util.h"
 #include "util/error.h"
 #include "util/notify.h"
+#include "util/threadpool.h"
 #include "util/url.h"
 
+#include <algorithm>
 #include <ctime>
+#include <map>
 
 
 namespace ngs {
@@ -44,6 +47,8 @@ constexpr const char *STORE_EXT = "ngmi"; // NextGIS MapInfo Store
 constexpr const char *STORE_META_DB = "sys.db";
 constexpr const char *HASH_SUFFIX = "hash";
 constexpr const char *HASH_FIELD = "hash";
+constexpr const char *HASH_STAMP_KEY = "stamp";
+constexpr GIntBig HASH_MIN_RANGE = 1000;
 
 // -----------------------------------------------------------------------------
 static const std::vector<std::string> tabExts = {"dat", "map", "id", "ind",
@@ -98,6 +103,68 @@ static OGRLayer *createHashTableInt(GDALDataset *ds, const std::string &name)
     return hashLayer;
 }
 
+/**
+ * @brief fileStamp Modification time and size of TAB files. If stamp is not
+ * changed the features are not changed too.
+ * @param path TAB file path.
+ * @return Stamp string.
+ */
+static std::string fileStamp(const std::string &path)
+{
+    std::string out;
+    for(const auto &ext : {"tab", "dat", "map", "id"}) {
+        auto filePath = File::resetExtension(path, ext);
+        out += CPLSPrintf("%ld:" CPL_FRMT_GIB ";",
+                          static_cast<long>(File::modificationDate(filePath)),
+                          File::fileSize(filePath));
+    }
+    return out;
+}
+
+/**
+ * @brief The HashingData class FID range of TAB file to hash in pool worker
+ */
+class HashingData : public ThreadData
+{
+public:
+    HashingData(const std::string &path, GIntBig start, GIntBig end) :
+        ThreadData(false),
+        m_path(path),
+        m_start(start),
+        m_end(end) {}
+    std::string m_path;
+    GIntBig m_start, m_end;
+    std::map<GIntBig, std::string> m_hashes;
+};
+
+static bool hashingDataThreadFunc(ThreadData *threadData)
+{
+    HashingData *data = static_cast<HashingData*>(threadData);
+    data->m_hashes.clear();
+
+    // Own read handle for each worker, TAB handles are not thread safe
+    GDALDatasetPtr DS = static_cast<GDALDataset*>(
+                GDALOpenEx(data->m_path.c_str(), GDAL_OF_VECTOR|GDAL_OF_READONLY,
+                           nullptr, nullptr, nullptr));
+    if(nullptr == DS) {
+        return false;
+    }
+    OGRLayer *layer = DS->GetLayer(0);
+    if(nullptr == layer) {
+        return false;
+    }
+
+    // TAB has random access by FID, deleted records return null
+    for(GIntBig fid = data->m_start; fid < data->m_end; ++fid) {
+        FeaturePtr feature(layer->GetFeature(fid));
+        if(feature) {
+            data->m_hashes[fid] =
+                    feature.dump(FeaturePtr::DumpOutputType::HASH_STYLE);
+        }
+    }
+    return true;
+}
+
 static bool isChildExists(const std::string &checkPath,
                           const std::vector<ObjectPtr> &list)
 {
@@ -535,6 +602,61 @@ void MapInfoStoreFeatureClass::close()
     m_layer = nullptr;
 }
 
+/**
+ * @brief MapInfoStoreFeatureClass::hashFeatures Hash all features of TAB file.
+ * FID ranges are hashed in parallel, each worker reads with own handle. The
+ * store files are written by the library, so they are not memory mapped.
+ * @param hashes Feature hashes by FID.
+ * @param progress Progress to report and cancel.
+ * @return False if canceled or failed.
+ */
+bool MapInfoStoreFeatureClass::hashFeatures(std::map<GIntBig, std::string> &hashes,
+                                            const Progress &progress)
+{
+    if(nullptr == m_layer) {
+        return false;
+    }
+
+    // Workers read the files, write pending changes
+    m_TABDS->FlushCache();
+
+    // TAB FIDs start from 1, the count includes deleted records
+    GIntBig maxFid = m_layer->GetFeatureCount(TRUE);
+    GIntBig range = std::max(HASH_MIN_RANGE, maxFid / getNumberThreads() + 1);
+
+    std::vector<std::unique_ptr<HashingData>> jobs;
+    ThreadPool threadPool;
+    threadPool.init(getNumberThreads(), hashingDataThreadFunc, 1, true);
+    for(GIntBig start = 1; start <= maxFid; start += range) {
+        jobs.emplace_back(new HashingData(m_path, start,
+                                          std::min(start + range, maxFid + 1)));
+        threadPool.addThreadData(jobs.back().get());
+    }
+    threadPool.waitComplete(progress);
+    threadPool.clearThreadData();
+
+    if(threadPool.isFailed()) {
+        return errorMessage(_("Failed to hash features of %s"), m_path.c_str());
+    }
+    if(!progress.onProgress(COD_IN_PROCESS, 1.0, _("Hash in process ..."))) {
+        return false;
+    }
+
+    for(const auto &job : jobs) {
+        hashes.insert(job->m_hashes.begin(), job->m_hashes.end());
+    }
+    return true;
+}
+
+void MapInfoStoreFeatureClass::saveHashStamp()
+{
+    MapInfoDataStore *parentDS = dynamic_cast<MapInfoDataStore*>(m_parent);
+    if(nullptr != parentDS) {
+        parentDS->setProperty(HASH_STAMP_KEY, fileStamp(m_path),
+                              hashTableName(storeName()));
+    }
+}
+
 int MapInfoStoreFeatureClass::fillHash(const Progress &progress,
                                         const Options &options)
 {
@@ -555,34 +677,29 @@ int MapInfoStoreFeatureClass::fillHash(const Progress &progress,
     }
 
     // Hash features.
-
-    emptyFields(true);
-    reset();
     progress.onProgress(COD_IN_PROCESS, 0.0, _("Start hashing features"));
-    double counter(0.0);
-    auto featureCountVal = featureCount();
-    FeaturePtr feature;
-    while((feature = nextFeature())) {
-        double complete = counter / featureCountVal;
-        if(!progress.onProgress(COD_IN_PROCESS, complete,
-                                _("Hash in process ..."))) {
-            return  COD_CANCELED;
-        }
-        auto hash = feature.dump(FeaturePtr::DumpOutputType::HASH_STYLE);
+    std::map<GIntBig, std::string> hashes;
+    if(!hashFeatures(hashes, progress)) {
+        return COD_CANCELED;
+    }
+
+    bool transaction = parentDS->startTransaction();
+    for(const auto &hash : hashes) {
         FeaturePtr newFeature = OGRFeature::CreateFeature(
                     hashTable->GetLayerDefn() );
-        newFeature->SetField(FEATURE_ID_FIELD, feature->GetFID());
-        newFeature->SetField(HASH_FIELD, hash.c_str());
+        newFeature->SetField(FEATURE_ID_FIELD, hash.first);
+        newFeature->SetField(HASH_FIELD, hash.second.c_str());
         if(hashTable->CreateFeature(newFeature) != OGRERR_NONE) {
             outMessage(COD_INSERT_FAILED, _("Failed to create feature"));
         }
     }
+    if(transaction) {
+        parentDS->commitTransaction();
+    }
+    saveHashStamp();
 
     progress.onProgress(COD_FINISHED, 1.0, _("Hashing features finished"));
 
-    emptyFields(false);
-    reset();
-
     return true;
 }
 
@@ -598,21 +715,47 @@ bool MapInfoStoreFeatureClass::updateHashAndEditLog()
         return true; // Hash table is not exists. Should never happen.
     }
 
+    // Files are not changed since last hashing
+    if(nullptr != m_TABDS) {
+        m_TABDS->FlushCache();
+    }
+    auto storedStamp = parentDS->property(HASH_STAMP_KEY, "",
+                                          hashTableName(storeName()));
+    if(!storedStamp.empty() && storedStamp == fileStamp(m_path)) {
+        return true;
+    }
+
     resetError();
 
+    std::map<GIntBig, std::string> currentHashes;
+    if(!hashFeatures(currentHashes, Progress())) {
+        return false;
+    }
+
+    bool transaction = parentDS->startTransaction();
     FeaturePtr feature;
     hashTable->ResetReading();
     std::vector<GIntBig> deleteIDs;
-    std::vector<GIntBig> presentIDs;
     while((feature = hashTable->GetNextFeature())) {
         // Check update or delete
         auto fid = feature->GetFieldAsInteger64(FEATURE_ID_FIELD);
         auto rid = feature->GetFieldAsInteger64(ngw::REMOTE_ID_KEY);
-        auto tabFeature = getFeature(fid);
+        auto it = currentHashes.find(fid);
         // Check update
-        if(tabFeature) {
-            auto storedHash = feature->GetFieldAsString(HASH_FIELD);
-            auto currentHash = tabFeature.dump(FeaturePtr::DumpOutputType::HASH_STYLE);
+        if(it != currentHashes.end()) {
+            std::string storedHash = feature->GetFieldAsString(HASH_FIELD);
+            const std::string &currentHash = it->second;
+            // Migrate hash of previous version, compare by the same algorithm
+            auto storedVersion = FeaturePtr::hashVersion(storedHash);
+            if(storedVersion != FEATURE_HASH_VERSION) {
+                auto tabFeature = getFeature(fid);
+                if(tabFeature && compare(storedHash, tabFeature.dump(
+                        FeaturePtr::DumpOutputType::HASH_STYLE, storedVersion))) {
+                    storedHash = currentHash;
+                    feature->SetField(HASH_FIELD, currentHash.c_str());
+                    hashTable->SetFeature(feature);
+                }
+            }
             if(!compare(storedHash, currentHash)) {
                 FeaturePtr opFeature = logEditFeature(FeaturePtr(), FeaturePtr(),
                                                   CC_CHANGE_FEATURE);
@@ -625,10 +768,11 @@ bool MapInfoStoreFeatureClass::updateHashAndEditLog()
                 feature->SetField(HASH_FIELD, currentHash.c_str());
                 if (hashTable->SetFeature(feature) != OGRERR_NONE) {
                     warningMessage(_("Failed to save new hash for feature " CPL_FRMT_GIB),
-                                   tabFeature->GetFID());
+                                   fid);
                 }
             }
-            presentIDs.push_back(fid);
+            // Left only features not present in hash table
+            currentHashes.erase(it);
         }
         else { // Feature deleted
             deleteIDs.push_back(feature->GetFID());
@@ -647,18 +791,29 @@ bool MapInfoStoreFeatureClass::updateHashAndEditLog()
     }
 
     // Check add
-    reset();
-    while((feature = nextFeature())) {
-        if(std::find(presentIDs.begin(), presentIDs.end(), feature->GetFID()) ==
-                presentIDs.end() ) {
-            // New feature added
-            FeaturePtr opFeature = logEditFeature(FeaturePtr(), FeaturePtr(),
-                                                  CC_CREATE_FEATURE);
-            opFeature->SetField(FEATURE_ID_FIELD, feature->GetFID());
-            logEditOperation(opFeature);
+    for(const auto &hash : currentHashes) {
+        // New feature added
+        FeaturePtr opFeature = logEditFeature(FeaturePtr(), FeaturePtr(),
+                                              CC_CREATE_FEATURE);
+        opFeature->SetField(FEATURE_ID_FIELD, hash.first);
+        logEditOperation(opFeature);
+
+        // Hash new feature, so it is not reported as added again
+        FeaturePtr newFeature = OGRFeature::CreateFeature(
+                    hashTable->GetLayerDefn() );
+        newFeature->SetField(FEATURE_ID_FIELD, hash.first);
+        newFeature->SetField(HASH_FIELD, hash.second.c_str());
+        if(hashTable->CreateFeature(newFeature) != OGRERR_NONE) {
+            warningMessage(_("Failed to save new hash for feature " CPL_FRMT_GIB),
+                           hash.first);
         }
     }
 
+    if(transaction) {
+        parentDS->commitTransaction();
+    }
+    saveHashStamp();
+
     return true;
 }
 
@@ -846,7 +1001,7 @@ ObjectPtr MapInfoDataStore::create(const enum ngsCatalogObjectType type,
     }
 
     setMetadata(object, featureDefnStruct.fields, options);
-    m_children.push_back(object);
+    appendChild(object);
 
     return object;
 }
@@ -941,12 +1096,12 @@ void MapInfoDataStore::fillFeatureClasses() const
                 geometryType = FeatureClass::geometryTypeFromName(geomTypeNameStr);
             }
             if(geometryType == wkbNone) {
-                m_children.push_back(
+                appendChild(
                             ObjectPtr(new MapInfoStoreTable(
                             DS, layer, parent, path, encoding)));
             }
             else {
-                m_children.push_back(
+                appendChild(
                             ObjectPtr(new MapInfoStoreFeatureClass(
                             DS, layer, parent, path, encoding)));
             }
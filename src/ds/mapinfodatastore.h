@@ -181,6 +181,9 @@ protected:
     void close();
     int fillHash(const Progress &progress, const Options &options);
     bool updateHashAndEditLog();
+    bool hashFeatures(std::map<GIntBig, std::string> &hashes,
+                      const Progress &progress);
+    void saveHashStamp();
 
 private:
    GDALDatasetPtr m_TABDS;
@@ -0,0 +1,210 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "mappedfiles.h"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NGS_HAVE_MMAP
+#endif
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+
+#include "api_priv.h"
+#include "catalog/file.h"
+#include "catalog/folder.h"
+#include "dataset.h"
+#include "util/stringutil.h"
+
+namespace ngs {
+
+// Default of mapped files size in megabytes, larger datasets are read as is.
+// Address space is limited on 32 bit platforms.
+constexpr const char *MAPPED_SIZE_DEFAULT = "256";
+constexpr unsigned long long MAX_MAPPED_SIZE = sizeof(void*) > 4 ?
+            4096ULL * 1024 * 1024 : 512ULL * 1024 * 1024;
+constexpr const char *MAPPED_DIR_PREFIX = "/vsimem/ngs_mapped_";
+
+static std::atomic<unsigned int> gMappedCounter(0);
+
+//------------------------------------------------------------------------------
+// MappedFiles
+//------------------------------------------------------------------------------
+
+/**
+ * @brief MappedFiles::MappedFiles Map dataset file and its sibling files.
+ * @param path Dataset file path.
+ * @param sequential Files are read from start to end. Otherwise they are read
+ * in ranges, i.e. by several threads.
+ */
+MappedFiles::MappedFiles(const std::string &path, bool sequential)
+{
+    if(!isEnabled(path)) {
+        return;
+    }
+
+    std::string dir = File::getPath(path);
+    std::string baseName = File::getBaseName(path);
+    std::string fileName = File::getFileName(path);
+    std::vector<std::string> names;
+    unsigned long long totalSize = 0;
+    for(const auto &name : Folder::listFiles(dir)) {
+        if(!compare(File::getBaseName(name), baseName) ||
+                compare(File::getExtension(name),
+                        Dataset::additionsDatasetExtension())) {
+            continue;
+        }
+        auto filePath = File::formFileName(dir, name);
+        if(Folder::isDir(filePath)) {
+            continue;
+        }
+        totalSize += static_cast<unsigned long long>(File::fileSize(filePath));
+        names.push_back(name);
+    }
+    if(totalSize > maxSize()) {
+        return;
+    }
+
+    // Keep file names, drivers look for siblings by them
+    std::string memDir = MAPPED_DIR_PREFIX + std::to_string(gMappedCounter++);
+    std::string memPath;
+    for(const auto &name : names) {
+        auto fileMemPath = memDir + "/" + name;
+        if(!map(File::formFileName(dir, name), fileMemPath, sequential)) {
+            return;
+        }
+        if(name == fileName) {
+            memPath = fileMemPath;
+        }
+    }
+    m_path = memPath;
+}
+
+MappedFiles::~MappedFiles()
+{
+    for(const MappedFile &file : m_files) {
+        VSIUnlink(file.memPath.c_str());
+#ifdef NGS_HAVE_MMAP
+        if(nullptr != file.data) {
+            munmap(file.data, file.size);
+        }
+#endif // NGS_HAVE_MMAP
+    }
+}
+
+/**
+ * @brief MappedFiles::isEnabled Check if files can be mapped. Only local files
+ * are mapped. NGS_MAPPED_SCAN configuration option disables the mapping.
+ * @param path Dataset file path.
+ * @return True if files of dataset can be mapped.
+ */
+bool MappedFiles::isEnabled(const std::string &path)
+{
+#ifdef NGS_HAVE_MMAP
+    return !path.empty() && !startsWith(path, "/vsi") &&
+            CPLTestBool(CPLGetConfigOption("NGS_MAPPED_SCAN", "ON"));
+#else
+    ngsUnused(path);
+    return false;
+#endif // NGS_HAVE_MMAP
+}
+
+/**
+ * @brief MappedFiles::maxSize Maximum size of mapped files of one dataset. It is
+ * set in megabytes by NGS_MAPPED_SCAN_SIZE configuration option.
+ * @return Size in bytes.
+ */
+unsigned long long MappedFiles::maxSize()
+{
+    long long size = std::atoll(CPLGetConfigOption("NGS_MAPPED_SCAN_SIZE",
+                                                   MAPPED_SIZE_DEFAULT));
+    if(size <= 0) {
+        return 0;
+    }
+    return std::min(static_cast<unsigned long long>(size) * 1024 * 1024,
+                    MAX_MAPPED_SIZE);
+}
+
+bool MappedFiles::map(const std::string &path, const std::string &memPath,
+                      bool sequential)
+{
+#ifdef NGS_HAVE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    if(size == 0) {
+        // Empty file can not be mapped
+        close(fd);
+        VSIFCloseL(VSIFOpenL(memPath.c_str(), "wb"));
+        m_files.push_back({memPath, nullptr, 0});
+        return true;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, sequential ? POSIX_FADV_SEQUENTIAL :
+                                         POSIX_FADV_NORMAL);
+#endif // POSIX_FADV_SEQUENTIAL
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(MAP_FAILED == data) {
+        return false;
+    }
+    // Start reading the whole file in background, records are read by the
+    // driver from page cache
+    madvise(data, size, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+    madvise(data, size, MADV_WILLNEED);
+
+    VSILFILE *fp = VSIFileFromMemBuffer(memPath.c_str(),
+                                        static_cast<GByte*>(data),
+                                        static_cast<vsi_l_offset>(size), FALSE);
+    if(nullptr == fp) {
+        munmap(data, size);
+        return false;
+    }
+    VSIFCloseL(fp);
+    m_files.push_back({memPath, data, size});
+    return true;
+#else
+    ngsUnused(path);
+    ngsUnused(memPath);
+    ngsUnused(sequential);
+    return false;
+#endif // NGS_HAVE_MMAP
+}
+
+} // namespace ngs
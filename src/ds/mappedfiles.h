@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSMAPPEDFILES_H
+#define NGSMAPPEDFILES_H
+
+// std
+#include <string>
+#include <vector>
+
+namespace ngs {
+
+/**
+ * @brief The MappedFiles class Memory mapped read only view of local dataset
+ * file and its sibling files (same base name) for full scans. Mappings are
+ * exposed to GDAL as /vsimem/ files without copy, so the driver reads them
+ * by memcpy instead of read syscall for each record, and the kernel is advised
+ * to read the files ahead. Open datasets from path() read only and close them
+ * before the object is destroyed. If mapping is not possible path() is empty.
+ * Truncation of the mapped file raises SIGBUS on read, so map only files which
+ * are not written while mapped.
+ */
+class MappedFiles
+{
+public:
+    explicit MappedFiles(const std::string &path, bool sequential = true);
+    ~MappedFiles();
+    MappedFiles(MappedFiles const&) = delete;
+    MappedFiles &operator= (MappedFiles const&) = delete;
+    bool isValid() const { return !m_path.empty(); }
+    const std::string &path() const { return m_path; }
+
+    static bool isEnabled(const std::string &path);
+    static unsigned long long maxSize();
+
+protected:
+    bool map(const std::string &path, const std::string &memPath,
+             bool sequential);
+
+private:
+    typedef struct _mappedFile {
+        std::string memPath;
+        void *data;
+        size_t size;
+    } MappedFile;
+    std::vector<MappedFile> m_files;
+    std::string m_path;
+};
+
+} // namespace ngs
+
+#endif // NGSMAPPEDFILES_H
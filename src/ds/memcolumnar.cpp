@@ -0,0 +1,744 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "memcolumnar.h"
+
+// stl
+#include <algorithm>
+#include <cstring>
+
+#include "ngstore/common.h"
+
+namespace ngs {
+
+constexpr GUInt32 HILBERT_MAX = (1 << 16) - 1;
+
+/**
+ * @brief hilbert Position of point on Hilbert curve of order 16
+ * (Fast Hilbert curve generation by rawrunprotected, public domain).
+ */
+static GUInt32 hilbert(GUInt32 x, GUInt32 y)
+{
+    GUInt32 a = x ^ y;
+    GUInt32 b = 0xFFFF ^ a;
+    GUInt32 c = 0xFFFF ^ (x | y);
+    GUInt32 d = x & (y ^ 0xFFFF);
+
+    GUInt32 A = a | (b >> 1);
+    GUInt32 B = (a >> 1) ^ a;
+    GUInt32 C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    GUInt32 D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    GUInt32 i0 = x ^ y;
+    GUInt32 i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+//------------------------------------------------------------------------------
+// PackedRTree
+//------------------------------------------------------------------------------
+
+PackedRTree::PackedRTree(unsigned short nodeSize) :
+    m_nodeSize(std::max<unsigned short>(nodeSize, 2)),
+    m_itemCount(0)
+{
+}
+
+void PackedRTree::clear()
+{
+    m_itemCount = 0;
+    m_boxes.clear();
+    m_indices.clear();
+    m_levelBounds.clear();
+}
+
+/**
+ * @brief PackedRTree::build Build tree.
+ * @param items Item envelopes.
+ * @param ids Item identifiers returned by search, same size as items.
+ */
+void PackedRTree::build(const std::vector<OGREnvelope> &items,
+                        const std::vector<size_t> &ids)
+{
+    clear();
+    m_itemCount = items.size();
+    if(m_itemCount == 0) {
+        return;
+    }
+
+    size_t count = m_itemCount;
+    size_t nodeCount = count;
+    m_levelBounds.push_back(nodeCount);
+    do {
+        count = (count + m_nodeSize - 1) / m_nodeSize;
+        nodeCount += count;
+        m_levelBounds.push_back(nodeCount);
+    } while(count != 1);
+
+    OGREnvelope extent;
+    for(const auto &item : items) {
+        extent.Merge(item);
+    }
+    double width = extent.MaxX - extent.MinX;
+    double height = extent.MaxY - extent.MinY;
+
+    std::vector<std::pair<GUInt32, size_t>> order;
+    order.reserve(m_itemCount);
+    for(size_t i = 0; i < m_itemCount; ++i) {
+        const OGREnvelope &item = items[i];
+        GUInt32 x = width > 0.0 ? static_cast<GUInt32>(HILBERT_MAX *
+                ((item.MinX + item.MaxX) / 2 - extent.MinX) / width) : 0;
+        GUInt32 y = height > 0.0 ? static_cast<GUInt32>(HILBERT_MAX *
+                ((item.MinY + item.MaxY) / 2 - extent.MinY) / height) : 0;
+        order.emplace_back(hilbert(x, y), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    m_boxes.reserve(nodeCount);
+    m_indices.reserve(nodeCount);
+    for(const auto &item : order) {
+        m_boxes.push_back(items[item.second]);
+        m_indices.push_back(ids[item.second]);
+    }
+
+    // Parent node keeps position of its first child
+    size_t pos = 0;
+    for(size_t level = 0; level < m_levelBounds.size() - 1; ++level) {
+        size_t end = m_levelBounds[level];
+        while(pos < end) {
+            OGREnvelope nodeBox;
+            size_t nodeIndex = pos;
+            for(unsigned short i = 0; i < m_nodeSize && pos < end; ++i) {
+                nodeBox.Merge(m_boxes[pos++]);
+            }
+            m_boxes.push_back(nodeBox);
+            m_indices.push_back(nodeIndex);
+        }
+    }
+}
+
+/**
+ * @brief PackedRTree::search Find items which envelopes intersect env.
+ * @param env Search envelope.
+ * @param out Found item identifiers in tree order.
+ */
+void PackedRTree::search(const OGREnvelope &env, std::vector<size_t> &out) const
+{
+    if(m_boxes.empty()) {
+        return;
+    }
+
+    std::vector<size_t> queue;
+    size_t nodeIndex = m_boxes.size() - 1;
+    size_t level = m_levelBounds.size() - 1;
+    while(true) {
+        size_t end = std::min(nodeIndex + m_nodeSize, m_levelBounds[level]);
+        for(size_t pos = nodeIndex; pos < end; ++pos) {
+            if(!env.Intersects(m_boxes[pos])) {
+                continue;
+            }
+            if(nodeIndex < m_itemCount) {
+                out.push_back(m_indices[pos]);
+            }
+            else {
+                queue.push_back(m_indices[pos]);
+                queue.push_back(level - 1);
+            }
+        }
+
+        if(queue.empty()) {
+            break;
+        }
+        level = queue.back();
+        queue.pop_back();
+        nodeIndex = queue.back();
+        queue.pop_back();
+    }
+}
+
+//------------------------------------------------------------------------------
+// ColumnarLayer
+//------------------------------------------------------------------------------
+
+ColumnarLayer::ColumnarLayer(const char *name,
+                             const OGRSpatialReference *spatialRef,
+                             OGRwkbGeometryType type) :
+    OGRLayer(),
+    m_defn(new OGRFeatureDefn(name)),
+    m_spatialRef(nullptr == spatialRef ? nullptr : spatialRef->Clone()),
+    m_points(wkbFlatten(type) == wkbPoint),
+    m_coordDimension(wkbHasZ(type) ? 3 : 2),
+    m_rowCount(0),
+    m_featureCount(0),
+    m_extentDirty(false),
+    m_treeDirty(false),
+    m_nextRow(0),
+    m_useCandidates(false)
+{
+    m_defn->Reference();
+    SetDescription(name);
+    m_defn->SetGeomType(type);
+    if(type != wkbNone) {
+        m_defn->GetGeomFieldDefn(0)->SetSpatialRef(m_spatialRef);
+    }
+}
+
+ColumnarLayer::~ColumnarLayer()
+{
+    m_defn->Release();
+    if(nullptr != m_spatialRef) {
+        m_spatialRef->Release();
+    }
+}
+
+bool ColumnarLayer::isTypeSupported(OGRFieldType type)
+{
+    switch(type) {
+    case OFTInteger:
+    case OFTInteger64:
+    case OFTReal:
+    case OFTString:
+    case OFTBinary:
+    case OFTDate:
+    case OFTTime:
+    case OFTDateTime:
+        return true;
+    default:
+        return false;
+    }
+}
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,7,0)
+OGRErr ColumnarLayer::CreateField(const OGRFieldDefn *field, int approxOK)
+#else
+OGRErr ColumnarLayer::CreateField(OGRFieldDefn *field, int approxOK)
+#endif
+{
+    OGRFieldDefn newField(field);
+    if(!isTypeSupported(newField.GetType())) {
+        if(!approxOK) {
+            CPLError(CE_Failure, CPLE_NotSupported,
+                     _("Field type %s is not supported by columnar layer"),
+                     OGRFieldDefn::GetFieldTypeName(newField.GetType()));
+            return OGRERR_FAILURE;
+        }
+        newField.SetType(OFTString);
+        newField.SetSubType(OFSTNone);
+    }
+
+    m_defn->AddFieldDefn(&newField);
+    Column column;
+    column.type = newField.GetType();
+    m_columns.emplace_back(column);
+    resize(m_rowCount);
+    return OGRERR_NONE;
+}
+
+void ColumnarLayer::resize(size_t rows)
+{
+    for(auto &column : m_columns) {
+        column.states.resize(rows, FS_UNSET);
+        switch(column.type) {
+        case OFTInteger:
+            column.integers.resize(rows);
+            break;
+        case OFTInteger64:
+            column.integers64.resize(rows);
+            break;
+        case OFTReal:
+            column.reals.resize(rows);
+            break;
+        case OFTDate:
+        case OFTTime:
+        case OFTDateTime:
+            column.dates.resize(rows);
+            break;
+        default:
+            column.sizes.resize(rows);
+            column.offsets.resize(rows);
+            break;
+        }
+    }
+
+    m_deleted.resize(rows, false);
+    m_emptyGeometry.resize(rows, true);
+    if(m_points) {
+        m_coords.resize(rows * static_cast<size_t>(m_coordDimension));
+    }
+    else if(m_defn->GetGeomType() != wkbNone) {
+        m_wkbOffsets.resize(rows);
+        m_wkbSizes.resize(rows);
+        m_envelopes.resize(rows);
+    }
+}
+
+void ColumnarLayer::writeRow(size_t row, OGRFeature *feature)
+{
+    for(int i = 0; i < static_cast<int>(m_columns.size()); ++i) {
+        Column &column = m_columns[static_cast<size_t>(i)];
+        if(!feature->IsFieldSet(i)) {
+            column.states[row] = FS_UNSET;
+            continue;
+        }
+        if(feature->IsFieldNull(i)) {
+            column.states[row] = FS_NULL;
+            continue;
+        }
+
+        column.states[row] = FS_SET;
+        switch(column.type) {
+        case OFTInteger:
+            column.integers[row] = feature->GetFieldAsInteger(i);
+            break;
+        case OFTInteger64:
+            column.integers64[row] = feature->GetFieldAsInteger64(i);
+            break;
+        case OFTReal:
+            column.reals[row] = feature->GetFieldAsDouble(i);
+            break;
+        case OFTDate:
+        case OFTTime:
+        case OFTDateTime:
+            column.dates[row] = *feature->GetRawFieldRef(i);
+            break;
+        case OFTBinary:
+        {
+            int size = 0;
+            GByte *data = feature->GetFieldAsBinary(i, &size);
+            column.offsets[row] = column.data.size();
+            column.sizes[row] = static_cast<GUInt32>(size);
+            column.data.insert(column.data.end(), data, data + size);
+            break;
+        }
+        default:
+        {
+            const char *value = feature->GetFieldAsString(i);
+            size_t size = std::strlen(value);
+            column.offsets[row] = column.data.size();
+            column.sizes[row] = static_cast<GUInt32>(size);
+            column.data.insert(column.data.end(), value, value + size);
+            break;
+        }
+        }
+    }
+
+    OGRGeometry *geom = feature->GetGeometryRef();
+    m_emptyGeometry[row] = nullptr == geom || geom->IsEmpty();
+    if(m_emptyGeometry[row]) {
+        return;
+    }
+
+    if(m_points) {
+        OGRPoint *pt = dynamic_cast<OGRPoint*>(geom);
+        if(nullptr == pt) {
+            m_emptyGeometry[row] = true;
+            return;
+        }
+        double *coords = &m_coords[row * static_cast<size_t>(m_coordDimension)];
+        coords[0] = pt->getX();
+        coords[1] = pt->getY();
+        if(m_coordDimension > 2) {
+            coords[2] = pt->getZ();
+        }
+    }
+    else {
+        size_t size = static_cast<size_t>(geom->WkbSize());
+        m_wkbOffsets[row] = m_wkb.size();
+        m_wkbSizes[row] = static_cast<GUInt32>(size);
+        m_wkb.resize(m_wkb.size() + size);
+        geom->exportToWkb(wkbNDR, &m_wkb[m_wkbOffsets[row]], wkbVariantIso);
+        geom->getEnvelope(&m_envelopes[row]);
+    }
+}
+
+OGRFeature *ColumnarLayer::readRow(size_t row) const
+{
+    OGRFeature *feature = new OGRFeature(m_defn);
+    feature->SetFID(static_cast<GIntBig>(row) + 1);
+    for(int i = 0; i < static_cast<int>(m_columns.size()); ++i) {
+        const Column &column = m_columns[static_cast<size_t>(i)];
+        if(column.states[row] == FS_UNSET) {
+            continue;
+        }
+        if(column.states[row] == FS_NULL) {
+            feature->SetFieldNull(i);
+            continue;
+        }
+
+        switch(column.type) {
+        case OFTInteger:
+            feature->SetField(i, column.integers[row]);
+            break;
+        case OFTInteger64:
+            feature->SetField(i, column.integers64[row]);
+            break;
+        case OFTReal:
+            feature->SetField(i, column.reals[row]);
+            break;
+        case OFTDate:
+        case OFTTime:
+        case OFTDateTime:
+        {
+            OGRField value = column.dates[row];
+            feature->SetField(i, &value);
+            break;
+        }
+        case OFTBinary:
+            feature->SetField(i, static_cast<int>(column.sizes[row]),
+                              const_cast<GByte*>(column.data.data() +
+                                                 column.offsets[row]));
+            break;
+        default:
+        {
+            std::string value(reinterpret_cast<const char*>(
+                                  column.data.data() + column.offsets[row]),
+                              column.sizes[row]);
+            feature->SetField(i, value.c_str());
+            break;
+        }
+        }
+    }
+
+    if(m_emptyGeometry[row]) {
+        return feature;
+    }
+
+    OGRGeometry *geom = nullptr;
+    if(m_points) {
+        const double *coords = &m_coords[row * static_cast<size_t>(m_coordDimension)];
+        geom = m_coordDimension > 2 ? new OGRPoint(coords[0], coords[1], coords[2]) :
+                                      new OGRPoint(coords[0], coords[1]);
+    }
+    else {
+        OGRGeometryFactory::createFromWkb(
+                    const_cast<GByte*>(&m_wkb[m_wkbOffsets[row]]), nullptr,
+                    &geom, static_cast<int>(m_wkbSizes[row]), wkbVariantIso);
+    }
+
+    if(nullptr != geom) {
+        geom->assignSpatialReference(m_spatialRef);
+        feature->SetGeometryDirectly(geom);
+    }
+    return feature;
+}
+
+bool ColumnarLayer::rowEnvelope(size_t row, OGREnvelope &env) const
+{
+    if(m_deleted[row] || m_emptyGeometry[row]) {
+        return false;
+    }
+
+    if(m_points) {
+        const double *coords = &m_coords[row * static_cast<size_t>(m_coordDimension)];
+        env.MinX = env.MaxX = coords[0];
+        env.MinY = env.MaxY = coords[1];
+    }
+    else {
+        env = m_envelopes[row];
+    }
+    return true;
+}
+
+void ColumnarLayer::updateExtent()
+{
+    if(!m_extentDirty) {
+        return;
+    }
+
+    m_extent = OGREnvelope();
+    OGREnvelope env;
+    for(size_t i = 0; i < m_rowCount; ++i) {
+        if(rowEnvelope(i, env)) {
+            m_extent.Merge(env);
+        }
+    }
+    m_extentDirty = false;
+}
+
+OGRErr ColumnarLayer::ICreateFeature(OGRFeature *feature)
+{
+    size_t row = m_rowCount;
+    resize(m_rowCount + 1);
+    m_rowCount++;
+    m_featureCount++;
+    writeRow(row, feature);
+    feature->SetFID(static_cast<GIntBig>(row) + 1);
+
+    OGREnvelope env;
+    if(rowEnvelope(row, env)) {
+        if(!m_extentDirty) {
+            m_extent.Merge(env);
+        }
+        m_treeDirty = true;
+    }
+    return OGRERR_NONE;
+}
+
+OGRErr ColumnarLayer::ISetFeature(OGRFeature *feature)
+{
+    GIntBig fid = feature->GetFID();
+    if(fid < 1 || fid > static_cast<GIntBig>(m_rowCount) ||
+            m_deleted[static_cast<size_t>(fid - 1)]) {
+        return OGRERR_NON_EXISTING_FEATURE;
+    }
+
+    // Old values stay in data buffers until layer is deleted
+    writeRow(static_cast<size_t>(fid - 1), feature);
+    m_extentDirty = true;
+    m_treeDirty = true;
+    return OGRERR_NONE;
+}
+
+OGRErr ColumnarLayer::DeleteFeature(GIntBig fid)
+{
+    if(fid < 1 || fid > static_cast<GIntBig>(m_rowCount) ||
+            m_deleted[static_cast<size_t>(fid - 1)]) {
+        return OGRERR_NON_EXISTING_FEATURE;
+    }
+
+    m_deleted[static_cast<size_t>(fid - 1)] = true;
+    m_featureCount--;
+    m_extentDirty = true;
+    return OGRERR_NONE;
+}
+
+OGRFeature *ColumnarLayer::GetFeature(GIntBig fid)
+{
+    if(fid < 1 || fid > static_cast<GIntBig>(m_rowCount) ||
+            m_deleted[static_cast<size_t>(fid - 1)]) {
+        return nullptr;
+    }
+    return readRow(static_cast<size_t>(fid - 1));
+}
+
+void ColumnarLayer::ResetReading()
+{
+    m_nextRow = 0;
+    m_candidates.clear();
+    m_useCandidates = nullptr != m_poFilterGeom;
+    if(!m_useCandidates) {
+        return;
+    }
+
+    if(m_treeDirty) {
+        std::vector<OGREnvelope> items;
+        std::vector<size_t> ids;
+        OGREnvelope env;
+        for(size_t i = 0; i < m_rowCount; ++i) {
+            if(rowEnvelope(i, env)) {
+                items.push_back(env);
+                ids.push_back(i);
+            }
+        }
+        m_tree.build(items, ids);
+        m_treeDirty = false;
+    }
+
+    m_tree.search(m_sFilterEnvelope, m_candidates);
+    // Return features in insert order as without filter
+    std::sort(m_candidates.begin(), m_candidates.end());
+}
+
+OGRFeature *ColumnarLayer::GetNextFeature()
+{
+    while(true) {
+        size_t row;
+        if(m_useCandidates) {
+            if(m_nextRow >= m_candidates.size()) {
+                return nullptr;
+            }
+            row = m_candidates[m_nextRow++];
+        }
+        else {
+            if(m_nextRow >= m_rowCount) {
+                return nullptr;
+            }
+            row = m_nextRow++;
+        }
+
+        if(row >= m_rowCount || m_deleted[row]) {
+            continue;
+        }
+
+        OGRFeature *feature = readRow(row);
+        if((nullptr == m_poFilterGeom ||
+            FilterGeometry(feature->GetGeometryRef())) &&
+                (nullptr == m_poAttrQuery || m_poAttrQuery->Evaluate(feature))) {
+            return feature;
+        }
+        delete feature;
+    }
+}
+
+GIntBig ColumnarLayer::GetFeatureCount(int force)
+{
+    if(nullptr == m_poFilterGeom && nullptr == m_poAttrQuery) {
+        return m_featureCount;
+    }
+    return OGRLayer::GetFeatureCount(force);
+}
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,11,0)
+OGRErr ColumnarLayer::IGetExtent(int geomField, OGREnvelope *extent, bool force)
+{
+    CPL_IGNORE_RET_VAL(force);
+    if(geomField != 0 || m_defn->GetGeomType() == wkbNone) {
+        return OGRERR_FAILURE;
+    }
+    updateExtent();
+    if(!m_extent.IsInit()) {
+        return OGRERR_FAILURE;
+    }
+    *extent = m_extent;
+    return OGRERR_NONE;
+}
+#else
+OGRErr ColumnarLayer::GetExtent(OGREnvelope *extent, int force)
+{
+    return GetExtent(0, extent, force);
+}
+
+OGRErr ColumnarLayer::GetExtent(int geomField, OGREnvelope *extent, int force)
+{
+    CPL_IGNORE_RET_VAL(force);
+    if(geomField != 0 || m_defn->GetGeomType() == wkbNone) {
+        return OGRERR_FAILURE;
+    }
+    updateExtent();
+    if(!m_extent.IsInit()) {
+        return OGRERR_FAILURE;
+    }
+    *extent = m_extent;
+    return OGRERR_NONE;
+}
+#endif
+
+int ColumnarLayer::TestCapability(const char *cap)
+{
+    if(EQUAL(cap, OLCRandomRead) || EQUAL(cap, OLCSequentialWrite) ||
+            EQUAL(cap, OLCRandomWrite) || EQUAL(cap, OLCDeleteFeature) ||
+            EQUAL(cap, OLCCreateField) || EQUAL(cap, OLCFastSpatialFilter) ||
+            EQUAL(cap, OLCFastGetExtent) || EQUAL(cap, OLCStringsAsUTF8)) {
+        return TRUE;
+    }
+    if(EQUAL(cap, OLCFastFeatureCount)) {
+        return nullptr == m_poFilterGeom && nullptr == m_poAttrQuery;
+    }
+    return FALSE;
+}
+
+//------------------------------------------------------------------------------
+// ColumnarDataset
+//------------------------------------------------------------------------------
+
+ColumnarDataset::ColumnarDataset(const std::string &path) : GDALDataset()
+{
+    SetDescription(path.c_str());
+    eAccess = GA_Update;
+}
+
+int ColumnarDataset::GetLayerCount()
+{
+    return static_cast<int>(m_layers.size());
+}
+
+OGRLayer *ColumnarDataset::GetLayer(int index)
+{
+    if(index < 0 || index >= GetLayerCount()) {
+        return nullptr;
+    }
+    return m_layers[static_cast<size_t>(index)].get();
+}
+
+OGRErr ColumnarDataset::DeleteLayer(int index)
+{
+    if(index < 0 || index >= GetLayerCount()) {
+        return OGRERR_FAILURE;
+    }
+    m_layers.erase(m_layers.begin() + index);
+    return OGRERR_NONE;
+}
+
+int ColumnarDataset::TestCapability(const char *cap)
+{
+    if(EQUAL(cap, ODsCCreateLayer) || EQUAL(cap, ODsCDeleteLayer) ||
+            EQUAL(cap, ODsCRandomLayerWrite)) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,9,0)
+OGRLayer *ColumnarDataset::ICreateLayer(const char *name,
+                                        const OGRGeomFieldDefn *geomFieldDefn,
+                                        CSLConstList options)
+{
+    CPL_IGNORE_RET_VAL(options);
+    OGRwkbGeometryType type = nullptr == geomFieldDefn ? wkbNone :
+                                                         geomFieldDefn->GetType();
+    const OGRSpatialReference *spatialRef = nullptr == geomFieldDefn ? nullptr :
+                                                geomFieldDefn->GetSpatialRef();
+    m_layers.emplace_back(new ColumnarLayer(name, spatialRef, type));
+    return m_layers.back().get();
+}
+#else
+OGRLayer *ColumnarDataset::ICreateLayer(const char *name,
+                                        OGRSpatialReference *spatialRef,
+                                        OGRwkbGeometryType type,
+                                        char **options)
+{
+    CPL_IGNORE_RET_VAL(options);
+    m_layers.emplace_back(new ColumnarLayer(name, spatialRef, type));
+    return m_layers.back().get();
+}
+#endif
+
+} // namespace ngs
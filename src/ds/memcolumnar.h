@@ -0,0 +1,187 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSMEMCOLUMNAR_H
+#define NGSMEMCOLUMNAR_H
+
+// stl
+#include <memory>
+#include <string>
+#include <vector>
+
+// gdal
+#include "gdal_priv.h"
+#include "ogrsf_frmts.h"
+
+namespace ngs {
+
+/**
+ * @brief The PackedRTree class Static R-tree packed by Hilbert curve order of
+ * item centers. Tree is stored in flat arrays and rebuilt as a whole.
+ */
+class PackedRTree
+{
+public:
+    explicit PackedRTree(unsigned short nodeSize = 16);
+    void build(const std::vector<OGREnvelope> &items,
+               const std::vector<size_t> &ids);
+    void search(const OGREnvelope &env, std::vector<size_t> &out) const;
+    void clear();
+    bool empty() const { return m_boxes.empty(); }
+
+private:
+    unsigned short m_nodeSize;
+    size_t m_itemCount;
+    std::vector<OGREnvelope> m_boxes;
+    std::vector<size_t> m_indices;
+    std::vector<size_t> m_levelBounds;
+};
+
+/**
+ * @brief The ColumnarLayer class In memory layer which keeps attributes in
+ * typed column arrays and geometries in packed coordinate or WKB buffers
+ * instead of one OGRFeature per row. Features are created on read. Spatial
+ * filter is served by packed R-tree. FIDs are assigned sequentially.
+ */
+class ColumnarLayer : public OGRLayer
+{
+public:
+    ColumnarLayer(const char *name, const OGRSpatialReference *spatialRef,
+                  OGRwkbGeometryType type);
+    virtual ~ColumnarLayer() override;
+
+    // OGRLayer interface
+public:
+    virtual void ResetReading() override;
+    virtual OGRFeature *GetNextFeature() override;
+    virtual OGRFeature *GetFeature(GIntBig fid) override;
+    virtual OGRErr DeleteFeature(GIntBig fid) override;
+    virtual GIntBig GetFeatureCount(int force = TRUE) override;
+    virtual OGRFeatureDefn *GetLayerDefn() override { return m_defn; }
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,7,0)
+    virtual OGRErr CreateField(const OGRFieldDefn *field,
+                               int approxOK = TRUE) override;
+#else
+    virtual OGRErr CreateField(OGRFieldDefn *field,
+                               int approxOK = TRUE) override;
+#endif
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,11,0)
+    virtual OGRErr IGetExtent(int geomField, OGREnvelope *extent,
+                              bool force) override;
+#else
+    virtual OGRErr GetExtent(OGREnvelope *extent, int force = TRUE) override;
+    virtual OGRErr GetExtent(int geomField, OGREnvelope *extent,
+                             int force = TRUE) override;
+#endif
+    virtual int TestCapability(const char *cap) override;
+
+protected:
+    virtual OGRErr ICreateFeature(OGRFeature *feature) override;
+    virtual OGRErr ISetFeature(OGRFeature *feature) override;
+
+private:
+    enum FieldState : GByte {
+        FS_UNSET = 0,
+        FS_NULL,
+        FS_SET
+    };
+
+    typedef struct _column {
+        OGRFieldType type;
+        std::vector<GByte> states;
+        std::vector<int> integers;          // OFTInteger
+        std::vector<GIntBig> integers64;    // OFTInteger64
+        std::vector<double> reals;          // OFTReal
+        std::vector<OGRField> dates;        // OFTDate, OFTTime, OFTDateTime
+        std::vector<GUInt32> sizes;         // OFTString, OFTBinary
+        std::vector<size_t> offsets;
+        std::vector<GByte> data;
+    } Column;
+
+private:
+    void resize(size_t rows);
+    void writeRow(size_t row, OGRFeature *feature);
+    OGRFeature *readRow(size_t row) const;
+    bool rowEnvelope(size_t row, OGREnvelope &env) const;
+    void updateExtent();
+    static bool isTypeSupported(OGRFieldType type);
+
+private:
+    OGRFeatureDefn *m_defn;
+    OGRSpatialReference *m_spatialRef;
+    bool m_points;
+    int m_coordDimension;
+    size_t m_rowCount;
+    GIntBig m_featureCount;
+    std::vector<bool> m_deleted;
+    std::vector<Column> m_columns;
+    // Point coordinates, x, y[, z] per row
+    std::vector<double> m_coords;
+    // Other geometries as WKB with envelope per row
+    std::vector<GByte> m_wkb;
+    std::vector<size_t> m_wkbOffsets;
+    std::vector<GUInt32> m_wkbSizes;
+    std::vector<OGREnvelope> m_envelopes;
+    std::vector<bool> m_emptyGeometry;
+    OGREnvelope m_extent;
+    bool m_extentDirty;
+    PackedRTree m_tree;
+    bool m_treeDirty;
+    // Reading state
+    size_t m_nextRow;
+    bool m_useCandidates;
+    std::vector<size_t> m_candidates;
+};
+
+/**
+ * @brief The ColumnarDataset class GDAL dataset of columnar memory layers
+ */
+class ColumnarDataset : public GDALDataset
+{
+public:
+    explicit ColumnarDataset(const std::string &path);
+    virtual ~ColumnarDataset() override = default;
+
+    // GDALDataset interface
+public:
+    virtual int GetLayerCount() override;
+    virtual OGRLayer *GetLayer(int index) override;
+    virtual OGRErr DeleteLayer(int index) override;
+    virtual int TestCapability(const char *cap) override;
+
+protected:
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,9,0)
+    virtual OGRLayer *ICreateLayer(const char *name,
+                                   const OGRGeomFieldDefn *geomFieldDefn,
+                                   CSLConstList options) override;
+#else
+    virtual OGRLayer *ICreateLayer(const char *name,
+                                   OGRSpatialReference *spatialRef,
+                                   OGRwkbGeometryType type,
+                                   char **options) override;
+#endif
+
+private:
+    std::vector<std::unique_ptr<ColumnarLayer>> m_layers;
+};
+
+} // namespace ngs
+
+#endif // NGSMEMCOLUMNAR_H
@@ -30,6 +30,7 @@
 
 #include "api_priv.h"
 #include "geometry.h"
+#include "memcolumnar.h"
 
 #include "catalog/catalog.h"
 #include "catalog/file.h"
@@ -50,6 +51,7 @@ constexpr const char *MEMSTORE_EXT = "ngmem"; // NextGIS Memory store
 constexpr int MEMSTORE_EXT_LEN = length(MEMSTORE_EXT);
 constexpr const char *TYPE_VAL = "memory store";
 constexpr const char *KEY_LAYERS = "layers";
+constexpr const char *KEY_COLUMNAR = "columnar";
 constexpr const char *KEY_LCO_PREFIX = "LCO.";
 constexpr int KEY_LCO_PREFIX_LEN = length(KEY_LCO_PREFIX);
 
@@ -162,6 +164,8 @@ bool MemoryStore::create(const std::string &path, const Options &options)
     CPLJSONObject root = memDescriptionFile.GetRoot();
     root.Add(KEY_TYPE, TYPE_VAL);
     root.Add(NGS_VERSION_KEY, NGS_VERSION_NUM);
+    // Columnar layers use less memory for large temporary data
+    root.Add(KEY_COLUMNAR, options.asBool("COLUMNAR", false));
 
     CPLJSONArray layers;
     root.Add(KEY_LAYERS, layers);
@@ -206,14 +210,19 @@ bool MemoryStore::open(unsigned int openFlags, const Options &options)
 //        }
 
         // Create dataset
-        GDALDriver *poDriver = Filter::getGDALDriver(CAT_CONTAINER_MEM);
-        if(poDriver == nullptr) {
-            return errorMessage(_("Driver is not present"));
+        if(root.GetBool(KEY_COLUMNAR, false)) {
+            m_DS = new ColumnarDataset(m_path);
         }
-
-        m_DS = poDriver->Create(m_path.c_str(), 0, 0, 0, GDT_Unknown, nullptr);
-        if(m_DS == nullptr) {
-            return errorMessage(_("Failed to create memory store. %s"), CPLGetLastErrorMsg());
+        else {
+            GDALDriver *poDriver = Filter::getGDALDriver(CAT_CONTAINER_MEM);
+            if(poDriver == nullptr) {
+                return errorMessage(_("Driver is not present"));
+            }
+
+            m_DS = poDriver->Create(m_path.c_str(), 0, 0, 0, GDT_Unknown, nullptr);
+            if(m_DS == nullptr) {
+                return errorMessage(_("Failed to create memory store. %s"), CPLGetLastErrorMsg());
+            }
         }
         m_DS->MarkAsShared();
 
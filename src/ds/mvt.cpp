@@ -0,0 +1,1053 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "mvt.h"
+
+// std
+#include <cmath>
+#include <cstring>
+#include <map>
+
+// gdal
+#include "cpl_conv.h"
+#include "gdal_version.h"
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+#include "cpl_compressor.h"
+#endif
+
+#include "util/error.h"
+#include "util/stringutil.h"
+
+namespace ngs {
+
+// Protocol buffers wire types
+constexpr GUInt32 PBF_VARINT = 0;
+constexpr GUInt32 PBF_FIXED64 = 1;
+constexpr GUInt32 PBF_LENGTH = 2;
+constexpr GUInt32 PBF_FIXED32 = 5;
+
+// Vector tile messages fields
+constexpr GUInt32 MVT_TILE_LAYERS = 3;
+constexpr GUInt32 MVT_LAYER_NAME = 1;
+constexpr GUInt32 MVT_LAYER_FEATURES = 2;
+constexpr GUInt32 MVT_LAYER_KEYS = 3;
+constexpr GUInt32 MVT_LAYER_VALUES = 4;
+constexpr GUInt32 MVT_LAYER_EXTENT = 5;
+constexpr GUInt32 MVT_LAYER_VERSION = 15;
+constexpr GUInt32 MVT_FEATURE_ID = 1;
+constexpr GUInt32 MVT_FEATURE_TAGS = 2;
+constexpr GUInt32 MVT_FEATURE_TYPE = 3;
+constexpr GUInt32 MVT_FEATURE_GEOMETRY = 4;
+constexpr GUInt32 MVT_VALUE_STRING = 1;
+constexpr GUInt32 MVT_VALUE_FLOAT = 2;
+constexpr GUInt32 MVT_VALUE_DOUBLE = 3;
+constexpr GUInt32 MVT_VALUE_INT = 4;
+constexpr GUInt32 MVT_VALUE_UINT = 5;
+constexpr GUInt32 MVT_VALUE_SINT = 6;
+constexpr GUInt32 MVT_VALUE_BOOL = 7;
+
+constexpr GUInt32 MVT_VERSION = 2;
+constexpr GUInt32 MVT_POINT = 1;
+constexpr GUInt32 MVT_LINESTRING = 2;
+constexpr GUInt32 MVT_POLYGON = 3;
+constexpr GUInt32 MVT_MOVE_TO = 1;
+constexpr GUInt32 MVT_LINE_TO = 2;
+constexpr GUInt32 MVT_CLOSE_PATH = 7;
+// Integer values are exact in double up to 2^53
+constexpr double MVT_MAX_INTEGER = 9007199254740992.0;
+
+TileFormat tileFormatFromString(const std::string &name)
+{
+    if(compare(name, "MVT")) {
+        return TileFormat::MVT;
+    }
+    return TileFormat::NATIVE;
+}
+
+const char *tileFormatToString(TileFormat format)
+{
+    switch(format) {
+    case TileFormat::MVT:
+        return "MVT";
+    default:
+        return "NATIVE";
+    }
+}
+
+static GUInt32 zigzag(GInt32 value)
+{
+    return (static_cast<GUInt32>(value) << 1) ^ static_cast<GUInt32>(value >> 31);
+}
+
+static GInt32 unzigzag(GUInt32 value)
+{
+    return static_cast<GInt32>(value >> 1) ^ -static_cast<GInt32>(value & 1);
+}
+
+static GUInt32 command(GUInt32 id, size_t count)
+{
+    return (id & 0x7) | (static_cast<GUInt32>(count) << 3);
+}
+
+//------------------------------------------------------------------------------
+// PbfWriter
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The PbfWriter class Protocol buffers message writer. Nested messages
+ * are written to own writer and added as length delimited field.
+ */
+class PbfWriter
+{
+public:
+    const std::string &data() const { return m_data; }
+    bool empty() const { return m_data.empty(); }
+
+    void varint(GUIntBig value) {
+        while(value >= 0x80) {
+            m_data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        m_data.push_back(static_cast<char>(value));
+    }
+
+    void key(GUInt32 field, GUInt32 wireType) {
+        varint((field << 3) | wireType);
+    }
+
+    void uintField(GUInt32 field, GUIntBig value) {
+        key(field, PBF_VARINT);
+        varint(value);
+    }
+
+    void doubleField(GUInt32 field, double value) {
+        key(field, PBF_FIXED64);
+        CPL_LSBPTR64(&value);
+        m_data.append(reinterpret_cast<const char*>(&value), sizeof(double));
+    }
+
+    void bytesField(GUInt32 field, const std::string &value) {
+        key(field, PBF_LENGTH);
+        varint(value.size());
+        m_data.append(value);
+    }
+
+    void packedField(GUInt32 field, const std::vector<GUInt32> &values) {
+        PbfWriter packed;
+        for(GUInt32 value : values) {
+            packed.varint(value);
+        }
+        bytesField(field, packed.data());
+    }
+
+private:
+    std::string m_data;
+};
+
+//------------------------------------------------------------------------------
+// PbfReader
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The PbfReader class Protocol buffers message reader. Reads the
+ * message in place, length delimited fields are read by nested readers.
+ * Any read out of the message sets error and stops reading.
+ */
+class PbfReader
+{
+public:
+    PbfReader(const GByte *data, size_t size) : m_data(data),
+        m_end(data + size), m_field(0), m_wireType(0), m_error(false) {}
+    GUInt32 field() const { return m_field; }
+    GUInt32 wireType() const { return m_wireType; }
+    bool isError() const { return m_error; }
+    bool atEnd() const { return m_data >= m_end; }
+    const GByte *data() const { return m_data; }
+    size_t size() const { return static_cast<size_t>(m_end - m_data); }
+
+    bool next() {
+        if(m_error || atEnd()) {
+            return false;
+        }
+        GUIntBig key = varint();
+        m_field = static_cast<GUInt32>(key >> 3);
+        m_wireType = static_cast<GUInt32>(key & 0x7);
+        return !m_error;
+    }
+
+    GUIntBig varint() {
+        GUIntBig value = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            if(atEnd()) {
+                break;
+            }
+            GByte byte = *m_data++;
+            value |= static_cast<GUIntBig>(byte & 0x7F) << shift;
+            if((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        m_error = true;
+        return 0;
+    }
+
+    double fixed64() {
+        double value = 0.0;
+        if(!read(&value, sizeof(double))) {
+            return 0.0;
+        }
+        CPL_LSBPTR64(&value);
+        return value;
+    }
+
+    float fixed32() {
+        float value = 0.0f;
+        if(!read(&value, sizeof(float))) {
+            return 0.0f;
+        }
+        CPL_LSBPTR32(&value);
+        return value;
+    }
+
+    PbfReader message() {
+        size_t size = length();
+        PbfReader out(m_data, size);
+        m_data += size;
+        return out;
+    }
+
+    std::string string() {
+        size_t size = length();
+        std::string out(reinterpret_cast<const char*>(m_data), size);
+        m_data += size;
+        return out;
+    }
+
+    void skip() {
+        switch(m_wireType) {
+        case PBF_VARINT:
+            varint();
+            break;
+        case PBF_FIXED64:
+            advance(8);
+            break;
+        case PBF_LENGTH:
+            advance(length());
+            break;
+        case PBF_FIXED32:
+            advance(4);
+            break;
+        default:
+            m_error = true;
+        }
+    }
+
+private:
+    size_t length() {
+        GUIntBig size = varint();
+        if(m_error || size > static_cast<GUIntBig>(m_end - m_data)) {
+            m_error = true;
+            return 0;
+        }
+        return static_cast<size_t>(size);
+    }
+
+    bool read(void *out, size_t size) {
+        if(static_cast<size_t>(m_end - m_data) < size) {
+            m_error = true;
+            return false;
+        }
+        std::memcpy(out, m_data, size);
+        m_data += size;
+        return true;
+    }
+
+    void advance(size_t size) {
+        if(static_cast<size_t>(m_end - m_data) < size) {
+            m_error = true;
+            return;
+        }
+        m_data += size;
+    }
+
+private:
+    const GByte *m_data, *m_end;
+    GUInt32 m_field, m_wireType;
+    bool m_error;
+};
+
+//------------------------------------------------------------------------------
+// Encode
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The MVTLayerWriter class Keys, values and features of the encoded
+ * layer. Values are written once and referenced by index.
+ */
+class MVTLayerWriter
+{
+public:
+    explicit MVTLayerWriter(const Envelope &extent) : m_extent(extent),
+        m_scaleX(MVT_EXTENT / extent.width()),
+        m_scaleY(MVT_EXTENT / extent.height()) {}
+
+    GUInt32 addKey(const std::string &name) {
+        m_keys.bytesField(MVT_LAYER_KEYS, name);
+        return m_keyCount++;
+    }
+
+    GUInt32 stringValue(const std::string &value) {
+        auto it = m_strings.find(value);
+        if(it != m_strings.end()) {
+            return it->second;
+        }
+        PbfWriter message;
+        message.bytesField(MVT_VALUE_STRING, value);
+        m_values.bytesField(MVT_LAYER_VALUES, message.data());
+        m_strings[value] = m_valueCount;
+        return m_valueCount++;
+    }
+
+    GUInt32 numberValue(double value) {
+        auto it = m_numbers.find(value);
+        if(it != m_numbers.end()) {
+            return it->second;
+        }
+        PbfWriter message;
+        if(std::floor(value) == value && std::fabs(value) < MVT_MAX_INTEGER) {
+            if(value < 0.0) {
+                GIntBig number = static_cast<GIntBig>(value);
+                message.uintField(MVT_VALUE_SINT,
+                    (static_cast<GUIntBig>(number) << 1) ^
+                                  static_cast<GUIntBig>(number >> 63));
+            }
+            else {
+                message.uintField(MVT_VALUE_UINT, static_cast<GUIntBig>(value));
+            }
+        }
+        else {
+            message.doubleField(MVT_VALUE_DOUBLE, value);
+        }
+        m_values.bytesField(MVT_LAYER_VALUES, message.data());
+        m_numbers[value] = m_valueCount;
+        return m_valueCount++;
+    }
+
+    void addPoint(const SimplePoint &pt, std::vector<GInt32> &coordinates) const {
+        GInt32 x = static_cast<GInt32>(std::lround(
+                (static_cast<double>(pt.x) - m_extent.minX()) * m_scaleX));
+        GInt32 y = static_cast<GInt32>(std::lround(
+                (m_extent.maxY() - static_cast<double>(pt.y)) * m_scaleY));
+        // Skip repeated points, they are the same in tile coordinates
+        size_t size = coordinates.size();
+        if(size >= 2 && coordinates[size - 2] == x && coordinates[size - 1] == y) {
+            return;
+        }
+        coordinates.push_back(x);
+        coordinates.push_back(y);
+    }
+
+    void moveTo(const std::vector<GInt32> &coordinates, size_t offset,
+                size_t count, std::vector<GUInt32> &geometry) {
+        geometry.push_back(command(MVT_MOVE_TO, count));
+        addParameters(coordinates, offset, count, geometry);
+    }
+
+    void lineTo(const std::vector<GInt32> &coordinates, size_t offset,
+                size_t count, std::vector<GUInt32> &geometry) {
+        geometry.push_back(command(MVT_LINE_TO, count));
+        addParameters(coordinates, offset, count, geometry);
+    }
+
+    void addFeature(GUIntBig id, bool hasId, GUInt32 type,
+                    const std::vector<GUInt32> &tags,
+                    const std::vector<GUInt32> &geometry) {
+        PbfWriter feature;
+        if(hasId) {
+            feature.uintField(MVT_FEATURE_ID, id);
+        }
+        if(!tags.empty()) {
+            feature.packedField(MVT_FEATURE_TAGS, tags);
+        }
+        feature.uintField(MVT_FEATURE_TYPE, type);
+        feature.packedField(MVT_FEATURE_GEOMETRY, geometry);
+        m_features.bytesField(MVT_LAYER_FEATURES, feature.data());
+    }
+
+    bool empty() const { return m_features.empty(); }
+
+    std::string layer(const std::string &name) const {
+        PbfWriter layer;
+        layer.uintField(MVT_LAYER_VERSION, MVT_VERSION);
+        layer.bytesField(MVT_LAYER_NAME, name);
+        std::string out = layer.data() + m_features.data() + m_keys.data() +
+                m_values.data();
+        PbfWriter extent;
+        extent.uintField(MVT_LAYER_EXTENT, MVT_EXTENT);
+        return out + extent.data();
+    }
+
+    void resetCursor() { m_cursorX = 0; m_cursorY = 0; }
+
+private:
+    void addParameters(const std::vector<GInt32> &coordinates, size_t offset,
+                       size_t count, std::vector<GUInt32> &geometry) {
+        for(size_t i = offset; i < offset + count; ++i) {
+            GInt32 x = coordinates[i * 2];
+            GInt32 y = coordinates[i * 2 + 1];
+            geometry.push_back(zigzag(x - m_cursorX));
+            geometry.push_back(zigzag(y - m_cursorY));
+            m_cursorX = x;
+            m_cursorY = y;
+        }
+    }
+
+private:
+    Envelope m_extent;
+    double m_scaleX, m_scaleY;
+    PbfWriter m_keys, m_values, m_features;
+    GUInt32 m_keyCount = 0, m_valueCount = 0;
+    std::map<std::string, GUInt32> m_strings;
+    std::map<double, GUInt32> m_numbers;
+    GInt32 m_cursorX = 0, m_cursorY = 0;
+};
+
+static GIntBig ringArea(const std::vector<GInt32> &coordinates)
+{
+    GIntBig area = 0;
+    size_t count = coordinates.size() / 2;
+    for(size_t i = 0; i < count; ++i) {
+        size_t j = (i + 1) % count;
+        area += static_cast<GIntBig>(coordinates[i * 2]) * coordinates[j * 2 + 1] -
+                static_cast<GIntBig>(coordinates[j * 2]) * coordinates[i * 2 + 1];
+    }
+    return area;
+}
+
+static void reverseRing(std::vector<GInt32> &coordinates)
+{
+    size_t count = coordinates.size() / 2;
+    for(size_t i = 0; i < count / 2; ++i) {
+        std::swap(coordinates[i * 2], coordinates[(count - 1 - i) * 2]);
+        std::swap(coordinates[i * 2 + 1], coordinates[(count - 1 - i) * 2 + 1]);
+    }
+}
+
+/**
+ * @brief encodePolygon Encode item rings. Exterior ring is clockwise in tile
+ * coordinates (y axis down), holes are counterclockwise, as the
+ * specification requires.
+ * @return False if exterior ring collapses in tile coordinates.
+ */
+static bool encodePolygon(const FlatVectorTileItem &item, MVTLayerWriter &writer,
+                          std::vector<GUInt32> &geometry)
+{
+    std::vector<GInt32> coordinates;
+    for(size_t ring = 0; ring < item.borderCount(); ++ring) {
+        ArrayView<unsigned short> border = item.borderIndices(ring);
+        coordinates.clear();
+        // Last index closes the ring
+        for(size_t i = 0; i + 1 < border.size(); ++i) {
+            writer.addPoint(item.point(border[i]), coordinates);
+        }
+        if(coordinates.size() > 2 &&
+                coordinates[0] == coordinates[coordinates.size() - 2] &&
+                coordinates[1] == coordinates[coordinates.size() - 1]) {
+            coordinates.resize(coordinates.size() - 2);
+        }
+
+        GIntBig area = coordinates.size() < 6 ? 0 : ringArea(coordinates);
+        if(0 == area) {
+            if(0 == ring) {
+                return false;
+            }
+            continue;
+        }
+        if((0 == ring) != (area > 0)) {
+            reverseRing(coordinates);
+        }
+
+        size_t count = coordinates.size() / 2;
+        writer.moveTo(coordinates, 0, 1, geometry);
+        writer.lineTo(coordinates, 1, count - 1, geometry);
+        geometry.push_back(command(MVT_CLOSE_PATH, 1));
+    }
+    return true;
+}
+
+BufferPtr encodeMVT(const FlatVectorTile &tile, const Envelope &extent,
+                    const std::string &layerName,
+                    OGRwkbGeometryType geometryType)
+{
+    if(!extent.isInit() || isEqual(extent.width(), 0.0) ||
+            isEqual(extent.height(), 0.0)) {
+        return BufferPtr();
+    }
+
+    MVTLayerWriter writer(extent);
+    size_t columnCount = tile.columnCount();
+    for(size_t i = 0; i < columnCount; ++i) {
+        writer.addKey((*tile.columns())[i].name);
+    }
+    bool hasCountColumn = tile.columnIndex(CLUSTER_COUNT_FIELD) >= 0;
+    GUInt32 countKey = 0;
+    bool countKeyAdded = false;
+
+    OGRwkbGeometryType flatType = OGR_GT_Flatten(geometryType);
+    bool isPoint = flatType == wkbPoint || flatType == wkbMultiPoint;
+    // Mixed geometry layer points are items with the only point
+    bool isMixed = flatType == wkbUnknown || flatType == wkbGeometryCollection;
+    std::vector<GInt32> coordinates;
+    std::vector<GUInt32> geometry, tags;
+    for(const FlatVectorTileItem &item : tile) {
+        geometry.clear();
+        writer.resetCursor();
+        GUInt32 type;
+        if(item.borderCount() > 0) {
+            type = MVT_POLYGON;
+            if(!encodePolygon(item, writer, geometry)) {
+                continue;
+            }
+        }
+        else {
+            coordinates.clear();
+            for(const SimplePoint &pt : item.points()) {
+                writer.addPoint(pt, coordinates);
+            }
+            size_t count = coordinates.size() / 2;
+            if(isPoint || (isMixed && 1 == count)) {
+                type = MVT_POINT;
+                if(0 == count) {
+                    continue;
+                }
+                writer.moveTo(coordinates, 0, count, geometry);
+            }
+            else {
+                type = MVT_LINESTRING;
+                if(count < 2) {
+                    continue;
+                }
+                writer.moveTo(coordinates, 0, 1, geometry);
+                writer.lineTo(coordinates, 1, count - 1, geometry);
+            }
+        }
+
+        tags.clear();
+        for(size_t i = 0; i < item.attributeCount(); ++i) {
+            if(item.isAttributeNull(i)) {
+                continue;
+            }
+            tags.push_back(static_cast<GUInt32>(i));
+            if((*tile.columns())[i].type == TileColumnType::NUMBER) {
+                double value = item.attributeNumber(i);
+                if(std::isnan(value)) {
+                    tags.pop_back();
+                    continue;
+                }
+                tags.push_back(writer.numberValue(value));
+            }
+            else {
+                tags.push_back(writer.stringValue(item.attributeString(i)));
+            }
+        }
+
+        const ArrayView<GIntBig> &ids = item.ids();
+        if(isPoint && ids.size() > 1 && !hasCountColumn) {
+            if(!countKeyAdded) {
+                countKey = writer.addKey(CLUSTER_COUNT_FIELD);
+                countKeyAdded = true;
+            }
+            tags.push_back(countKey);
+            tags.push_back(writer.numberValue(static_cast<double>(ids.size())));
+        }
+
+        // Feature per identifier, decoder joins them back to one item
+        if(ids.empty()) {
+            writer.addFeature(0, false, type, tags, geometry);
+        }
+        for(GIntBig id : ids) {
+            writer.addFeature(static_cast<GUIntBig>(id), true, type, tags,
+                              geometry);
+        }
+    }
+
+    if(writer.empty()) {
+        return BufferPtr();
+    }
+
+    PbfWriter out;
+    out.bytesField(MVT_TILE_LAYERS, writer.layer(layerName));
+    BufferPtr buffer(new Buffer(out.data().size()));
+    buffer->put(out.data().data(), out.data().size());
+    return buffer;
+}
+
+//------------------------------------------------------------------------------
+// Decode
+//------------------------------------------------------------------------------
+
+typedef struct _mvtValue {
+    bool isNumber;
+    double number;
+    std::string string;
+} MVTValue;
+
+typedef struct _mvtFeature {
+    GUIntBig id;
+    bool hasId;
+    GUInt32 type;
+    std::vector<GUInt32> tags;
+    const GByte *geometry;
+    size_t geometrySize;
+} MVTFeature;
+
+typedef struct _mvtLayer {
+    std::string name;
+    GUInt32 extent;
+    std::vector<std::string> keys;
+    std::vector<MVTValue> values;
+    std::vector<MVTFeature> features;
+} MVTLayer;
+
+static std::string numberToString(double value)
+{
+    if(std::floor(value) == value && std::fabs(value) < MVT_MAX_INTEGER) {
+        return CPLSPrintf(CPL_FRMT_GIB, static_cast<GIntBig>(value));
+    }
+    return CPLSPrintf("%.15g", value);
+}
+
+static bool readValue(PbfReader reader, MVTValue &value)
+{
+    value.isNumber = true;
+    value.number = 0.0;
+    while(reader.next()) {
+        switch(reader.field()) {
+        case MVT_VALUE_STRING:
+            value.isNumber = false;
+            value.string = reader.string();
+            break;
+        case MVT_VALUE_FLOAT:
+            value.number = static_cast<double>(reader.fixed32());
+            break;
+        case MVT_VALUE_DOUBLE:
+            value.number = reader.fixed64();
+            break;
+        case MVT_VALUE_INT:
+            value.number = static_cast<double>(
+                        static_cast<GIntBig>(reader.varint()));
+            break;
+        case MVT_VALUE_UINT:
+            value.number = static_cast<double>(reader.varint());
+            break;
+        case MVT_VALUE_SINT:
+        {
+            GUIntBig raw = reader.varint();
+            value.number = static_cast<double>(
+                        static_cast<GIntBig>(raw >> 1) ^
+                        -static_cast<GIntBig>(raw & 1));
+            break;
+        }
+        case MVT_VALUE_BOOL:
+            value.number = reader.varint() != 0 ? 1.0 : 0.0;
+            break;
+        default:
+            reader.skip();
+        }
+    }
+    if(value.isNumber) {
+        value.string = numberToString(value.number);
+    }
+    return !reader.isError();
+}
+
+static bool readPacked(PbfReader reader, std::vector<GUInt32> &values)
+{
+    while(!reader.atEnd() && !reader.isError()) {
+        values.push_back(static_cast<GUInt32>(reader.varint()));
+    }
+    return !reader.isError();
+}
+
+static bool readFeature(PbfReader reader, MVTFeature &feature)
+{
+    feature.id = 0;
+    feature.hasId = false;
+    feature.type = 0;
+    feature.geometry = nullptr;
+    feature.geometrySize = 0;
+    while(reader.next()) {
+        switch(reader.field()) {
+        case MVT_FEATURE_ID:
+            feature.id = reader.varint();
+            feature.hasId = true;
+            break;
+        case MVT_FEATURE_TAGS:
+            if(!readPacked(reader.message(), feature.tags)) {
+                return false;
+            }
+            break;
+        case MVT_FEATURE_TYPE:
+            feature.type = static_cast<GUInt32>(reader.varint());
+            break;
+        case MVT_FEATURE_GEOMETRY:
+        {
+            // Geometry commands are read in place on decode
+            PbfReader message = reader.message();
+            feature.geometry = message.data();
+            feature.geometrySize = message.size();
+            break;
+        }
+        default:
+            reader.skip();
+        }
+    }
+    return !reader.isError();
+}
+
+static bool readLayer(PbfReader reader, MVTLayer &layer)
+{
+    layer.extent = MVT_EXTENT;
+    while(reader.next()) {
+        switch(reader.field()) {
+        case MVT_LAYER_NAME:
+            layer.name = reader.string();
+            break;
+        case MVT_LAYER_FEATURES:
+        {
+            MVTFeature feature;
+            if(!readFeature(reader.message(), feature)) {
+                return false;
+            }
+            layer.features.push_back(std::move(feature));
+            break;
+        }
+        case MVT_LAYER_KEYS:
+            layer.keys.push_back(reader.string());
+            break;
+        case MVT_LAYER_VALUES:
+        {
+            MVTValue value;
+            if(!readValue(reader.message(), value)) {
+                return false;
+            }
+            layer.values.push_back(std::move(value));
+            break;
+        }
+        case MVT_LAYER_EXTENT:
+            layer.extent = static_cast<GUInt32>(reader.varint());
+            break;
+        default:
+            reader.skip();
+        }
+    }
+    return !reader.isError() && layer.extent > 0;
+}
+
+/**
+ * @brief layerColumns Columns of the layer keys. Key is a number column if
+ * all its values are numbers.
+ */
+static TileColumnsPtr layerColumns(const MVTLayer &layer)
+{
+    std::vector<bool> numbers(layer.keys.size(), true);
+    for(const MVTFeature &feature : layer.features) {
+        for(size_t i = 0; i + 1 < feature.tags.size(); i += 2) {
+            GUInt32 key = feature.tags[i];
+            GUInt32 value = feature.tags[i + 1];
+            if(key < numbers.size() && value < layer.values.size() &&
+                    !layer.values[value].isNumber) {
+                numbers[key] = false;
+            }
+        }
+    }
+
+    std::shared_ptr<TileColumns> columns(new TileColumns);
+    for(size_t i = 0; i < layer.keys.size(); ++i) {
+        columns->push_back({ layer.keys[i], numbers[i] ?
+                             TileColumnType::NUMBER : TileColumnType::STRING });
+    }
+    return columns;
+}
+
+/**
+ * @brief The MVTGeometryDecoder class Reads geometry commands and converts
+ * tile coordinates to map coordinates.
+ */
+class MVTGeometryDecoder
+{
+public:
+    MVTGeometryDecoder(const MVTLayer &layer, const Envelope &extent) :
+        m_minX(extent.minX()), m_maxY(extent.maxY()),
+        m_scaleX(extent.width() / layer.extent),
+        m_scaleY(extent.height() / layer.extent) {}
+
+    bool decode(const MVTFeature &feature, GIntBig fid,
+                VectorTileItemArray &items) {
+        std::vector<GUInt32> commands;
+        if(!readPacked(PbfReader(feature.geometry, feature.geometrySize),
+                       commands)) {
+            return false;
+        }
+
+        m_x = 0;
+        m_y = 0;
+        m_area = 0;
+        m_part.clear();
+        m_rings.clear();
+        VectorTileItem points;
+        size_t i = 0;
+        while(i < commands.size()) {
+            GUInt32 id = commands[i] & 0x7;
+            size_t count = commands[i] >> 3;
+            ++i;
+            if(MVT_CLOSE_PATH == id) {
+                if(MVT_POLYGON == feature.type) {
+                    closeRing(fid, items);
+                }
+                continue;
+            }
+            if((MVT_MOVE_TO != id && MVT_LINE_TO != id) ||
+                    commands.size() - i < count * 2) {
+                return false;
+            }
+
+            for(size_t j = 0; j < count; ++j, i += 2) {
+                GInt32 prevX = m_x, prevY = m_y;
+                m_x += unzigzag(commands[i]);
+                m_y += unzigzag(commands[i + 1]);
+                SimplePoint pt = { static_cast<float>(m_minX + m_x * m_scaleX),
+                                   static_cast<float>(m_maxY - m_y * m_scaleY) };
+                if(MVT_POINT == feature.type) {
+                    points.addPoint(pt);
+                    continue;
+                }
+                if(MVT_MOVE_TO == id) {
+                    if(MVT_LINESTRING == feature.type) {
+                        addLine(fid, items);
+                    }
+                    m_part.clear();
+                    m_area = 0;
+                    m_startX = m_x;
+                    m_startY = m_y;
+                }
+                else {
+                    m_area += static_cast<GIntBig>(prevX) * m_y -
+                            static_cast<GIntBig>(m_x) * prevY;
+                }
+                m_part.push_back(pt);
+            }
+        }
+
+        if(MVT_POINT == feature.type && points.pointCount() > 0) {
+            points.addId(fid);
+            points.setValid(true);
+            items.push_back(std::move(points));
+        }
+        else if(MVT_LINESTRING == feature.type) {
+            addLine(fid, items);
+        }
+        else if(MVT_POLYGON == feature.type) {
+            addPolygon(fid, items);
+        }
+        return true;
+    }
+
+private:
+    void addLine(GIntBig fid, VectorTileItemArray &items) {
+        if(m_part.size() < 2) {
+            return;
+        }
+        VectorTileItem item;
+        item.addId(fid);
+        for(const SimplePoint &pt : m_part) {
+            item.addPoint(pt);
+        }
+        item.setValid(true);
+        items.push_back(std::move(item));
+    }
+
+    void closeRing(GIntBig fid, VectorTileItemArray &items) {
+        // Close the ring area with the segment to the first point
+        m_area += static_cast<GIntBig>(m_x) * m_startY -
+                static_cast<GIntBig>(m_startX) * m_y;
+        if(m_part.size() < 3 || 0 == m_area) {
+            return;
+        }
+        // Exterior ring has positive area, it starts the next polygon
+        if(m_area > 0) {
+            addPolygon(fid, items);
+            m_rings.push_back(m_part);
+        }
+        else if(!m_rings.empty()) {
+            m_rings.push_back(m_part);
+        }
+    }
+
+    void addPolygon(GIntBig fid, VectorTileItemArray &items) {
+        if(m_rings.empty()) {
+            return;
+        }
+        fillPolygonTile(fid, m_rings, items);
+        m_rings.clear();
+    }
+
+private:
+    double m_minX, m_maxY, m_scaleX, m_scaleY;
+    GInt32 m_x = 0, m_y = 0, m_startX = 0, m_startY = 0;
+    GIntBig m_area = 0;
+    std::vector<SimplePoint> m_part;
+    std::vector<std::vector<SimplePoint>> m_rings;
+};
+
+static bool isSameFeature(const MVTFeature &feature, const MVTFeature &other)
+{
+    return feature.type == other.type && feature.tags == other.tags &&
+            feature.geometrySize == other.geometrySize &&
+            std::memcmp(feature.geometry, other.geometry,
+                        feature.geometrySize) == 0;
+}
+
+static void decodeLayer(const MVTLayer &layer, const Envelope &extent,
+                        const TileColumnsPtr &tileColumns, VectorTile &tile)
+{
+    TileColumnsPtr columns = tileColumns ? tileColumns : layerColumns(layer);
+    // Column of each key or -1
+    std::vector<int> keyColumns(layer.keys.size(), -1);
+    for(size_t i = 0; i < layer.keys.size(); ++i) {
+        for(size_t j = 0; j < columns->size(); ++j) {
+            if((*columns)[j].name == layer.keys[i]) {
+                keyColumns[i] = static_cast<int>(j);
+                break;
+            }
+        }
+    }
+
+    MVTGeometryDecoder decoder(layer, extent);
+    VectorTileItemArray items;
+    const MVTFeature *prevFeature = nullptr;
+    size_t prevOffset = 0;
+    for(size_t i = 0; i < layer.features.size(); ++i) {
+        const MVTFeature &feature = layer.features[i];
+        GIntBig fid = static_cast<GIntBig>(feature.hasId ? feature.id : i);
+        if(nullptr != prevFeature && isSameFeature(feature, *prevFeature)) {
+            for(size_t j = prevOffset; j < items.size(); ++j) {
+                items[j].addId(fid);
+            }
+            continue;
+        }
+
+        prevOffset = items.size();
+        if(!decoder.decode(feature, fid, items)) {
+            items.resize(prevOffset);
+            prevFeature = nullptr;
+            continue;
+        }
+        prevFeature = &feature;
+
+        if(columns->empty() || prevOffset == items.size()) {
+            continue;
+        }
+        std::shared_ptr<TileAttributes> attributes(new TileAttributes);
+        attributes->columns = columns;
+        attributes->values.resize(columns->size());
+        attributes->nulls.assign(columns->size(), true);
+        for(size_t j = 0; j + 1 < feature.tags.size(); j += 2) {
+            GUInt32 key = feature.tags[j];
+            GUInt32 value = feature.tags[j + 1];
+            if(key >= keyColumns.size() || keyColumns[key] < 0 ||
+                    value >= layer.values.size()) {
+                continue;
+            }
+            size_t column = static_cast<size_t>(keyColumns[key]);
+            attributes->values[column] = layer.values[value].string;
+            attributes->nulls[column] = false;
+        }
+        for(size_t j = prevOffset; j < items.size(); ++j) {
+            items[j].setAttributes(attributes);
+        }
+    }
+    tile.add(std::move(items));
+}
+
+/**
+ * @brief gunzip Decompress gzip data.
+ * @return Decompressed data or empty pointer.
+ */
+static BufferPtr gunzip(const GByte *data, size_t size)
+{
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3,4,0)
+    const CPLCompressor *decompressor = CPLGetDecompressor("gzip");
+    if(nullptr == decompressor) {
+        return BufferPtr();
+    }
+    void *out = nullptr;
+    size_t outSize = 0;
+    if(!decompressor->pfnFunc(data, size, &out, &outSize, nullptr,
+                              decompressor->user_data)) {
+        VSIFree(out);
+        return BufferPtr();
+    }
+    return BufferPtr(new Buffer(static_cast<GByte*>(out),
+                                static_cast<int>(outSize)));
+#else
+    ngsUnused(data);
+    ngsUnused(size);
+    return BufferPtr();
+#endif
+}
+
+bool decodeMVT(const GByte *data, size_t size, const Envelope &extent,
+               const std::string &layerName, const TileColumnsPtr &columns,
+               VectorTile &tile)
+{
+    if(nullptr == data || 0 == size) {
+        return false;
+    }
+
+    if(size > 2 && data[0] == 0x1F && data[1] == 0x8B) {
+        BufferPtr raw = gunzip(data, size);
+        if(!raw) {
+            return errorMessage(_("Failed to decompress vector tile"));
+        }
+        return decodeMVT(raw->data(), static_cast<size_t>(raw->size()),
+                         extent, layerName, columns, tile);
+    }
+
+    PbfReader reader(data, size);
+    while(reader.next()) {
+        if(reader.field() != MVT_TILE_LAYERS || reader.wireType() != PBF_LENGTH) {
+            reader.skip();
+            continue;
+        }
+
+        MVTLayer layer;
+        if(!readLayer(reader.message(), layer)) {
+            return false;
+        }
+        if(layerName.empty() || layer.name == layerName) {
+            decodeLayer(layer, extent, columns, tile);
+            return true;
+        }
+    }
+    return !reader.isError();
+}
+
+} // namespace ngs
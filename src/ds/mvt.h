@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSMVT_H
+#define NGSMVT_H
+
+// std
+#include <string>
+
+// gdal
+#include "ogr_core.h"
+
+#include "geometry.h"
+
+namespace ngs {
+
+// Tile coordinates range of the encoded layer
+constexpr GUInt32 MVT_EXTENT = 4096;
+
+/**
+ * @brief The TileFormat enum Encoding of the stored overview tile. Native
+ * tiles are FlatVectorTile blobs, read in place. MVT tiles are Mapbox Vector
+ * Tiles, readable by tile servers and web clients, and are decoded on read.
+ */
+enum class TileFormat {
+    NATIVE,
+    MVT
+};
+
+TileFormat tileFormatFromString(const std::string &name);
+const char *tileFormatToString(TileFormat format);
+
+/**
+ * @brief encodeMVT Encode tile items to Mapbox Vector Tile with one layer.
+ * Items with borders are polygons, other items are points if geometry type
+ * is point, else lines. Tile columns are the layer keys. An item is encoded
+ * as a feature per item identifier, point items of several identifiers also
+ * get the point_count value, so clients see clusters.
+ * @param tile Tile to encode.
+ * @param extent Tile extent in map coordinates, without overlap. Items out of
+ * it are encoded in the tile buffer area.
+ * @param layerName Layer name.
+ * @param geometryType Geometry type of the tile items.
+ * @return Tile protobuf or empty pointer if tile has nothing to encode.
+ */
+BufferPtr encodeMVT(const FlatVectorTile &tile, const Envelope &extent,
+                    const std::string &layerName,
+                    OGRwkbGeometryType geometryType);
+
+/**
+ * @brief decodeMVT Decode Mapbox Vector Tile layer to tile items. Gzip
+ * compressed tiles (as stored in MBTiles) are decompressed first. Polygons
+ * are tessellated, the same as tiled features. Consecutive features with
+ * the same geometry and values are decoded to one item with their
+ * identifiers, features without identifier get their index in the layer.
+ * @param data Tile data.
+ * @param size Tile data size.
+ * @param extent Tile extent in map coordinates.
+ * @param layerName Layer to decode. Empty name means the first layer.
+ * @param columns Columns to decode values to. If empty, columns are the
+ * layer keys, number columns are the keys with only number values.
+ * @param tile Tile to add items to.
+ * @return False if data is not valid vector tile.
+ */
+bool decodeMVT(const GByte *data, size_t size, const Envelope &extent,
+               const std::string &layerName, const TileColumnsPtr &columns,
+               VectorTile &tile);
+
+} // namespace ngs
+
+#endif // NGSMVT_H
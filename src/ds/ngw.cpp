@@ -88,7 +88,8 @@ NGWLayerDataset::NGWLayerDataset(ObjectContainer * const parent,
                                  const CPLJSONObject &resource,
                                  NGWConnectionBase *connection) :
     SingleLayerDataset(type, parent, name),
-    NGWResourceBase(resource, connection)
+    NGWResourceBase(resource, connection),
+    m_resourcesLoaded(!resource.GetBool("resource/children", true))
 {
     m_geometryType = FeatureClass::geometryTypeFromName(
                 resource.GetString("vector_layer/geometry_type"));
@@ -101,7 +102,8 @@ NGWLayerDataset::NGWLayerDataset(ObjectContainer * const parent,
                                  OGRLayer *layer,
                                  NGWConnectionBase *connection) :
     SingleLayerDataset(type, parent, name),
-    NGWResourceBase(CPLJSONObject(), connection)
+    NGWResourceBase(CPLJSONObject(), connection),
+    m_resourcesLoaded(true) // Just created layer has no styles
 {
     m_DS = DS;
     m_FC = ObjectPtr(new NGWFeatureClass(this, type, name, layer));
@@ -132,6 +134,21 @@ void NGWLayerDataset::addResource(const CPLJSONObject &resource)
     }
 }
 
+bool NGWLayerDataset::loadChildren()
+{
+    // Styles and forms are requested on first access
+    if(!m_resourcesLoaded && nullptr != m_connection) {
+        CPLJSONArray resources = m_connection->childResources(m_resourceId);
+        if(resources.IsValid()) {
+            for(int i = 0; i < resources.Size(); ++i) {
+                addResource(resources[i]);
+            }
+            m_resourcesLoaded = true;
+        }
+    }
+    return SingleLayerDataset::loadChildren();
+}
+
 ObjectPtr NGWLayerDataset::internalObject()
 {
     if(!isOpened()) {
@@ -375,7 +392,7 @@ bool NGWFeatureClass::rename(const std::string &newName)
     }
 
     if(m_parent->rename(newName)) {
-        m_name = newName;
+        setName(newName);
         return true;
     }
     return false;
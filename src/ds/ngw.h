@@ -59,6 +59,7 @@ public:
 
     // ObjectContainer interface
 public:
+    virtual bool loadChildren() override;
     virtual bool canCreate(const enum ngsCatalogObjectType type) const override;
     virtual ObjectPtr create(const enum ngsCatalogObjectType type,
                              const std::string &name, const Options &options) override;
@@ -85,6 +86,7 @@ public:
 private:
     ObjectPtr m_FC;
     OGRwkbGeometryType m_geometryType;
+    bool m_resourcesLoaded;
 };
 
 /**
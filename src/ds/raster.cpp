@@ -20,6 +20,10 @@
  ****************************************************************************/
 #include "raster.h"
 
+// std
+#include <algorithm>
+#include <cstring>
+
 // gdal
 #include "cpl_http.h"
 
@@ -31,36 +35,258 @@
 #include "util/notify.h"
 #include "util/settings.h"
 #include "util/stringutil.h"
+#include "util/trace.h"
+#include "util/url.h"
 
 namespace ngs {
 
 //------------------------------------------------------------------------------
 // DownloadData
 //------------------------------------------------------------------------------
-constexpr unsigned short DOWNLOAD_THREAD_COUNT = 5;
-
+constexpr unsigned short DOWNLOAD_THREAD_COUNT = 2;
+constexpr unsigned short DOWNLOAD_CONNECTION_COUNT = 8;
+constexpr size_t DOWNLOAD_BATCH_SIZE = 64;
+
+/**
+ * @brief The DownloadData class Batch of tiles downloaded at once by one
+ * thread.
+ */
 class DownloadData : public ThreadData {
 public:
-    DownloadData(const std::string &basePath, const std::string &url, int expires,
-                 const Tile &tile, const Options &options, bool own);
-    Tile m_tile;
-    std::string m_basePath, m_url;
+    DownloadData(TileStore *store, CacheAreaJob *job, const std::string &url,
+                 int expires, bool reverseY, const std::vector<Tile> &tiles,
+                 const Options &options, bool own);
+    std::vector<Tile> m_tiles;
+    TileStore *m_store;
+    CacheAreaJob *m_job;
+    std::string m_url;
     int m_expires;
+    bool m_reverseY;
     Options m_options;
 };
 
-DownloadData::DownloadData(const std::string &basePath, const std::string &url,
-                           int expires, const Tile &tile, const Options &options,
-                           bool own) :
+DownloadData::DownloadData(TileStore *store, CacheAreaJob *job,
+                           const std::string &url, int expires, bool reverseY,
+                           const std::vector<Tile> &tiles,
+                           const Options &options, bool own) :
     ThreadData(own),
-    m_tile(tile),
-    m_basePath(basePath),
+    m_tiles(tiles),
+    m_store(store),
+    m_job(job),
     m_url(url),
     m_expires(expires),
+    m_reverseY(reverseY),
     m_options(options)
 {
 }
 
+//------------------------------------------------------------------------------
+// RasterBlockCache
+//------------------------------------------------------------------------------
+
+bool RasterBlockCache::_blockKey::operator<(const struct _blockKey &other) const
+{
+    if(generation != other.generation) {
+        return generation < other.generation;
+    }
+    if(overview != other.overview) {
+        return overview < other.overview;
+    }
+    if(y != other.y) {
+        return y < other.y;
+    }
+    return x < other.x;
+}
+
+RasterBlockCache::RasterBlockCache(size_t maxBlocks) :
+    m_maxBlocks(maxBlocks),
+    m_generation(0),
+    m_dataType(GDT_Unknown)
+{
+}
+
+void RasterBlockCache::clear()
+{
+    MutexHolder holder(m_mutex);
+    m_generation++;
+    m_index.clear();
+    m_blocks.clear();
+}
+
+static GDALRasterBand *levelBand(GDALDataset *DS, int band, int overview)
+{
+    GDALRasterBand *rasterBand = DS->GetRasterBand(band);
+    if(nullptr == rasterBand || overview < 0) {
+        return rasterBand;
+    }
+    return rasterBand->GetOverview(overview);
+}
+
+/**
+ * @brief RasterBlockCache::block Get block from cache or read it from raster.
+ * Last used block goes to the list front, the list tail is removed if cache is
+ * full. The block read from raster is not added to cache if cache was cleared
+ * while reading.
+ * @param DS Raster dataset
+ * @param key Block key
+ * @param dataType Block data type
+ * @param bands Raster bands to read
+ * @return Block or nullptr if read failed.
+ */
+RasterBlockCache::BlockPtr RasterBlockCache::block(GDALDataset *DS,
+                                                   const BlockKey &key,
+                                                   GDALDataType dataType,
+                                                   const std::vector<int> &bands)
+{
+    {
+        MutexHolder holder(m_mutex);
+        auto it = m_index.find(key);
+        if(it != m_index.end()) {
+            m_blocks.splice(m_blocks.begin(), m_blocks, it->second);
+            return m_blocks.front();
+        }
+    }
+
+    GDALRasterBand *firstBand = levelBand(DS, bands[0], key.overview);
+    if(nullptr == firstBand) {
+        return nullptr;
+    }
+    int xOff = key.x * RASTER_BLOCK_SIZE;
+    int yOff = key.y * RASTER_BLOCK_SIZE;
+
+    BlockPtr newBlock(new Block);
+    newBlock->key = key;
+    newBlock->width = std::min(RASTER_BLOCK_SIZE, firstBand->GetXSize() - xOff);
+    newBlock->height = std::min(RASTER_BLOCK_SIZE, firstBand->GetYSize() - yOff);
+    if(newBlock->width <= 0 || newBlock->height <= 0) {
+        return nullptr;
+    }
+
+    int dataSize = GDALGetDataTypeSizeBytes(dataType);
+    int pixelSpace = dataSize * static_cast<int>(bands.size());
+    int lineSpace = pixelSpace * newBlock->width;
+    newBlock->data.resize(static_cast<size_t>(lineSpace * newBlock->height));
+    for(size_t i = 0; i < bands.size(); ++i) {
+        GDALRasterBand *band = levelBand(DS, bands[i], key.overview);
+        if(nullptr == band ||
+           band->RasterIO(GF_Read, xOff, yOff, newBlock->width, newBlock->height,
+                          newBlock->data.data() + i * static_cast<size_t>(dataSize),
+                          newBlock->width, newBlock->height, dataType,
+                          pixelSpace, lineSpace) != CE_None) {
+            errorMessage(CPLGetLastErrorMsg());
+            return nullptr;
+        }
+    }
+
+    MutexHolder holder(m_mutex);
+    if(key.generation != m_generation || m_index.find(key) != m_index.end()) {
+        return newBlock;
+    }
+    m_blocks.push_front(newBlock);
+    m_index[key] = m_blocks.begin();
+    if(m_blocks.size() > m_maxBlocks) {
+        m_index.erase(m_blocks.back()->key);
+        m_blocks.pop_back();
+    }
+    return newBlock;
+}
+
+/**
+ * @brief RasterBlockCache::read Read window of raster or overview level pixels
+ * to the buffer without resampling. The blocks covering window are read once
+ * and copied to the buffer. The window part outside level is left untouched.
+ * @param DS Raster dataset
+ * @param data Buffer of xSize * ySize * bandCount pixels, bands interleaved
+ * @param overview Overview index or -1 for raster itself
+ * @param xOff Window x offset in level pixels
+ * @param yOff Window y offset in level pixels
+ * @param xSize Window width
+ * @param ySize Window height
+ * @param dataType Buffer data type
+ * @param bandCount Buffer band count
+ * @param bandList Raster bands to read
+ * @param skipLastBand If true, the last buffer band is not read
+ * @return True on success.
+ */
+bool RasterBlockCache::read(GDALDataset *DS, void *data, int overview,
+                            int xOff, int yOff, int xSize, int ySize,
+                            GDALDataType dataType, int bandCount,
+                            int *bandList, bool skipLastBand)
+{
+    int readBandCount = skipLastBand ? bandCount - 1 : bandCount;
+    if(readBandCount <= 0) {
+        return false;
+    }
+
+    std::vector<int> bands(bandList, bandList + readBandCount);
+    int generation;
+    {
+        MutexHolder holder(m_mutex);
+        if(dataType != m_dataType || bands != m_bands) {
+            m_generation++;
+            m_index.clear();
+            m_blocks.clear();
+            m_dataType = dataType;
+            m_bands = bands;
+        }
+        generation = m_generation;
+    }
+
+    GDALRasterBand *firstBand = levelBand(DS, bandList[0], overview);
+    if(nullptr == firstBand) {
+        return false;
+    }
+    int maxXOff = std::min(xOff + xSize, firstBand->GetXSize());
+    int maxYOff = std::min(yOff + ySize, firstBand->GetYSize());
+    if(maxXOff <= std::max(0, xOff) || maxYOff <= std::max(0, yOff)) {
+        return false;
+    }
+
+    size_t dataSize = static_cast<size_t>(GDALGetDataTypeSizeBytes(dataType));
+    size_t pixelSize = dataSize * static_cast<size_t>(bandCount);
+    size_t blockPixelSize = dataSize * static_cast<size_t>(readBandCount);
+    GByte *out = static_cast<GByte*>(data);
+
+    int minBlockX = std::max(0, xOff) / RASTER_BLOCK_SIZE;
+    int minBlockY = std::max(0, yOff) / RASTER_BLOCK_SIZE;
+    int maxBlockX = (maxXOff - 1) / RASTER_BLOCK_SIZE;
+    int maxBlockY = (maxYOff - 1) / RASTER_BLOCK_SIZE;
+    for(int by = minBlockY; by <= maxBlockY; ++by) {
+        for(int bx = minBlockX; bx <= maxBlockX; ++bx) {
+            BlockPtr cached = block(DS, { generation, overview, bx, by },
+                                    dataType, bands);
+            if(nullptr == cached) {
+                return false;
+            }
+
+            int blockXOff = bx * RASTER_BLOCK_SIZE;
+            int blockYOff = by * RASTER_BLOCK_SIZE;
+            int minX = std::max(xOff, blockXOff);
+            int maxX = std::min(xOff + xSize, blockXOff + cached->width);
+            int minY = std::max(yOff, blockYOff);
+            int maxY = std::min(yOff + ySize, blockYOff + cached->height);
+            for(int y = minY; y < maxY; ++y) {
+                const GByte *src = cached->data.data() +
+                        (static_cast<size_t>(y - blockYOff) * cached->width +
+                         static_cast<size_t>(minX - blockXOff)) * blockPixelSize;
+                GByte *dst = out + (static_cast<size_t>(y - yOff) * xSize +
+                                    static_cast<size_t>(minX - xOff)) * pixelSize;
+                if(pixelSize == blockPixelSize) {
+                    std::memcpy(dst, src, static_cast<size_t>(maxX - minX) * pixelSize);
+                }
+                else {
+                    for(int x = minX; x < maxX; ++x) {
+                        std::memcpy(dst, src, blockPixelSize);
+                        src += blockPixelSize;
+                        dst += pixelSize;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // Raster
 //------------------------------------------------------------------------------
@@ -73,7 +299,8 @@ Raster::Raster(std::vector<std::string> siblingFiles,
     DatasetBase(),
     SpatialDataset(),
     m_openFlags(GDAL_OF_SHARED|GDAL_OF_READONLY|GDAL_OF_VERBOSE_ERROR),
-    m_siblingFiles(siblingFiles)
+    m_siblingFiles(siblingFiles),
+    m_hasReadDatasets(false)
 {
 }
 
@@ -120,13 +347,14 @@ bool Raster::open(unsigned int openFlags, const Options &options)
             "<LowerRightX>%f</LowerRightX><LowerRightY>%f</LowerRightY>"
             "<TileLevel>%d</TileLevel><TileCountX>1</TileCountX>"
             "<TileCountY>1</TileCountY><YOrigin>%s</YOrigin></DataWindow>"
-            "<Projection>EPSG:%d</Projection><BlockSizeX>256</BlockSizeX>"
-            "<BlockSizeY>256</BlockSizeY><BandsCount>%d</BandsCount>"
+            "<Projection>EPSG:%d</Projection><BlockSizeX>%d</BlockSizeX>"
+            "<BlockSizeY>%d</BlockSizeY><BandsCount>%d</BandsCount>"
             "<Cache><Type>file</Type><Expires>%d</Expires><MaxSize>%d</MaxSize>"
             "</Cache><MaxConnections>1</MaxConnections><Timeout>%d</Timeout><AdviseRead>false</AdviseRead>"
             "<ZeroBlockHttpCodes>204,404</ZeroBlockHttpCodes></GDAL_WMS>",
             url.c_str(), extent.minX(), extent.maxY(), extent.maxX(), extent.minY(), z_max,
-            y_origin_top ? "top" : "bottom", epsg, bandCount, cacheExpires, cacheMaxSize, timeout);
+            y_origin_top ? "top" : "bottom", epsg, TMS_TILE_SIZE, TMS_TILE_SIZE,
+            bandCount, cacheExpires, cacheMaxSize, timeout);
 
         bool result = DatasetBase::open(connStr, openFlags, options);
         if(result) {
@@ -147,6 +375,13 @@ bool Raster::open(unsigned int openFlags, const Options &options)
             m_DS->SetMetadataItem("TMS_LIMIT_Y_MIN", CPLSPrintf("%f", m_extent.minY()), "");
             m_DS->SetMetadataItem("TMS_LIMIT_Y_MAX", CPLSPrintf("%f", m_extent.maxY()), "");
 
+            // Tiles of cached area are in one file in WMS cache folder
+            std::string cachePath = fromCString(m_DS->GetMetadataItem("CACHE_PATH"));
+            if(epsg == DEFAULT_EPSG && !cachePath.empty()) {
+                m_tileStore.reset(new TileStore(
+                    File::formFileName(cachePath, "tiles", TILE_STORE_EXT)));
+            }
+
             // Set USER metadata
             CPLJSONObject user = root.GetObj(USER_KEY);
             if(user.IsValid()) {
@@ -217,6 +452,10 @@ bool Raster::open(unsigned int openFlags, const Options &options)
             std::string spatRefStr = m_DS->GetProjectionRef();
             m_spatialReference.setFromUserInput(spatRefStr);
             setExtent();
+            // Local rasters are read by each thread with own dataset handle.
+            // Handles are opened on first read.
+            m_hasReadDatasets = Filter::isFileBased(m_type) &&
+                    (openFlags & GDAL_OF_UPDATE) == 0;
             return true;
         }
     }
@@ -228,6 +467,7 @@ bool Raster::pixelData(void *data, int xOff, int yOff, int xSize, int ySize,
                        int bandCount, int *bandList, bool read,
                        bool skipLastBand/*, unsigned char zoom*/)
 {
+    ngsTraceSpan("Raster::pixelData");
     if(!isOpened()) {
         return false;
     }
@@ -252,13 +492,29 @@ bool Raster::pixelData(void *data, int xOff, int yOff, int xSize, int ySize,
         return false;
     }
 
+    CPLErr result;
+    GDALDataset *DS = read ? readDataset() : nullptr;
+    if(nullptr != DS) {
+        result = DS->RasterIO(GF_Read, xOff, yOff, xSize, ySize, data,
+                              bufXSize, bufYSize, dataType,
+                              skipLastBand ? bandCount - 1 : bandCount,
+                              bandList, pixelSpace, lineSpace, bandSpace);
+        if(result != CE_None) {
+            return errorMessage(CPLGetLastErrorMsg());
+        }
+        return true;
+    }
+
     MutexHolder holder(m_dataLock, 0.05);
+    if(!read) {
+        m_blockCache.clear();
+    }
 
-    CPLErr result = m_DS->RasterIO(read ? GF_Read : GF_Write, xOff, yOff,
-                                   xSize, ySize, data, bufXSize, bufYSize,
-                                   dataType, skipLastBand ? bandCount - 1 :
-                                                            bandCount, bandList,
-                                   pixelSpace, lineSpace, bandSpace);
+    result = m_DS->RasterIO(read ? GF_Read : GF_Write, xOff, yOff,
+                            xSize, ySize, data, bufXSize, bufYSize,
+                            dataType, skipLastBand ? bandCount - 1 :
+                                                     bandCount, bandList,
+                            pixelSpace, lineSpace, bandSpace);
 
     if(result != CE_None) {
         return errorMessage(CPLGetLastErrorMsg());
@@ -267,9 +523,93 @@ bool Raster::pixelData(void *data, int xOff, int yOff, int xSize, int ySize,
     return true;
 }
 
+/**
+ * @brief Raster::levelPixelData Read pixels of raster or overview level without
+ * resampling. Reads go through the block cache, so neighbour tiles on the same
+ * level share block reads.
+ * @param data Buffer of xSize * ySize * bandCount pixels
+ * @param overview Overview index from getBestOverview or -1 for raster itself
+ * @param xOff Window x offset in level pixels
+ * @param yOff Window y offset in level pixels
+ * @param xSize Window width
+ * @param ySize Window height
+ * @param dataType Buffer data type
+ * @param bandCount Buffer band count
+ * @param bandList Raster bands to read
+ * @param skipLastBand If true, the last buffer band is not read
+ * @return True on success.
+ */
+bool Raster::levelPixelData(void *data, int overview, int xOff, int yOff,
+                            int xSize, int ySize, GDALDataType dataType,
+                            int bandCount, int *bandList, bool skipLastBand)
+{
+    if(!isOpened() || xSize <= 0 || ySize <= 0) {
+        return false;
+    }
+
+    CPLErrorReset();
+    GDALDataset *DS = readDataset();
+    if(nullptr != DS) {
+        return m_blockCache.read(DS, data, overview, xOff, yOff, xSize, ySize,
+                                 dataType, bandCount, bandList, skipLastBand);
+    }
+
+    MutexHolder holder(m_dataLock, 0.05);
+    return m_blockCache.read(m_DS, data, overview, xOff, yOff, xSize, ySize,
+                             dataType, bandCount, bandList, skipLastBand);
+}
+
+/**
+ * @brief Raster::readDataset Get read only dataset handle of current thread.
+ * The handle is opened without GDAL_OF_SHARED, so reads of different threads
+ * are not serialized by the raster data lock.
+ * @return Dataset or nullptr if raster is not local or it failed to open.
+ */
+GDALDataset *Raster::readDataset()
+{
+    if(!m_hasReadDatasets) {
+        return nullptr;
+    }
+
+    MutexHolder holder(m_readDatasetsLock);
+    std::thread::id threadId = std::this_thread::get_id();
+    auto it = m_readDatasets.find(threadId);
+    if(it != m_readDatasets.end()) {
+        return it->second;
+    }
+
+    unsigned int openFlags = GDAL_OF_RASTER|GDAL_OF_READONLY;
+    auto openOptions = m_openOptions.asCPLStringList();
+    GDALDatasetPtr DS = static_cast<GDALDataset*>(
+                GDALOpenEx(m_path.c_str(), openFlags, nullptr, openOptions,
+                           nullptr));
+    if(nullptr == DS) {
+        CPLDebug("ngstore", "Failed to open raster %s for thread read. %s",
+                 m_path.c_str(), CPLGetLastErrorMsg());
+        m_hasReadDatasets = false;
+        return nullptr;
+    }
+    m_readDatasets[threadId] = DS;
+    return DS;
+}
+
+void Raster::close()
+{
+    {
+        MutexHolder holder(m_readDatasetsLock);
+        m_hasReadDatasets = false;
+        m_readDatasets.clear();
+    }
+    m_blockCache.clear();
+    DatasetBase::close();
+}
+
 bool Raster::destroy()
 {
     if(Filter::isFileBased(m_type)) {
+        if(m_tileStore) {
+            m_tileStore->close();
+        }
         if(File::deleteFile(m_path)) {
             if(Folder::rmDir(fromCString(m_DS->GetMetadataItem("CACHE_PATH")))) {
                 return Object::destroy();
@@ -493,6 +833,69 @@ GDALDataType Raster::dataType(int band) const
     return  m_DS->GetRasterBand(band)->GetRasterDataType();
 }
 
+/**
+ * @brief Raster::colorTable Get band palette.
+ * @param rgba 256 RGBA entries. Entries missing in palette are transparent.
+ * @param band Band number
+ * @return False if band has no palette.
+ */
+bool Raster::colorTable(std::vector<GByte> &rgba, int band) const
+{
+    if(!isOpened() || m_DS->GetRasterCount() < band) {
+        return false;
+    }
+    GDALColorTable *table = m_DS->GetRasterBand(band)->GetColorTable();
+    if(nullptr == table) {
+        return false;
+    }
+
+    rgba.assign(256 * 4, 0);
+    int count = std::min(256, table->GetColorEntryCount());
+    for(int i = 0; i < count; ++i) {
+        GDALColorEntry entry;
+        if(!table->GetColorEntryAsRGB(i, &entry)) {
+            continue;
+        }
+        rgba[static_cast<size_t>(i) * 4] = static_cast<GByte>(entry.c1);
+        rgba[static_cast<size_t>(i) * 4 + 1] = static_cast<GByte>(entry.c2);
+        rgba[static_cast<size_t>(i) * 4 + 2] = static_cast<GByte>(entry.c3);
+        rgba[static_cast<size_t>(i) * 4 + 3] = static_cast<GByte>(entry.c4);
+    }
+    return true;
+}
+
+bool Raster::noData(double &value, int band) const
+{
+    if(!isOpened() || m_DS->GetRasterCount() < band) {
+        return false;
+    }
+    int hasNoData = FALSE;
+    value = m_DS->GetRasterBand(band)->GetNoDataValue(&hasNoData);
+    return hasNoData == TRUE;
+}
+
+/**
+ * @brief Raster::minMax Get band values range. Approximate range is computed
+ * from overview or sample if band has no statistics.
+ * @param min Minimum value
+ * @param max Maximum value
+ * @param band Band number
+ * @return True on success.
+ */
+bool Raster::minMax(double &min, double &max, int band) const
+{
+    if(!isOpened() || m_DS->GetRasterCount() < band) {
+        return false;
+    }
+    double range[2] = { 0.0, 0.0 };
+    if(m_DS->GetRasterBand(band)->ComputeRasterMinMax(TRUE, range) != CE_None) {
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+    min = range[0];
+    max = range[1];
+    return true;
+}
+
 int Raster::getBestOverview(int &xOff, int &yOff, int &xSize, int &ySize,
                             int bufXSize, int bufYSize) const
 {
@@ -503,7 +906,28 @@ int Raster::getBestOverview(int &xOff, int &yOff, int &xSize, int &ySize,
                                          xSize, ySize, bufXSize, bufYSize, nullptr);
 }
 
-static CPLLock *hLock = nullptr;
+static std::string tileUrl(const std::string &url, const Tile &tile)
+{
+    CPLString out(url);
+    out = out.replaceAll("${x}", std::to_string(tile.x));
+    out = out.replaceAll("${y}", std::to_string(tile.y));
+    out = out.replaceAll("${z}", std::to_string(tile.z));
+    return out;
+}
+
+static bool isResultValid(const http::HTTPResultPtr &result)
+{
+    if(nullptr == result) {
+        outMessage(COD_REQUEST_FAILED, _("Unexpected error"));
+        return false;
+    }
+    if(result->nStatus != 0 || result->pszErrBuf != nullptr) {
+        outMessage(COD_REQUEST_FAILED, "%s", nullptr == result->pszErrBuf ?
+                       _("Request failed") : result->pszErrBuf);
+        return false;
+    }
+    return true;
+}
 
 bool Raster::cacheAreaJobThreadFunc(ThreadData* threadData)
 {
@@ -512,57 +936,164 @@ bool Raster::cacheAreaJobThreadFunc(ThreadData* threadData)
         return true;
     }
 
-    CPLString url(data->m_url);
-    url = url.replaceAll("${x}", std::to_string(data->m_tile.x));
-    url = url.replaceAll("${y}", std::to_string(data->m_tile.y));
-    url = url.replaceAll("${z}", std::to_string(data->m_tile.z));
+    // Skip tiles which are in store and not expired. Store rows are counted
+    // from bottom. Expired tiles with ETag or Last-Modified are revalidated.
+    std::vector<std::string> urls;
+    std::vector<Tile> storeTiles, urlTiles, doneTiles;
+    std::vector<Tile> checkStoreTiles, checkUrlTiles;
+    std::vector<std::string> checkEtags, checkLastModified;
+    for(const Tile &tile : data->m_tiles) {
+        Tile storeTile = tile;
+        if(data->m_reverseY) {
+            storeTile.y = (1 << tile.z) - tile.y - 1;
+        }
+        if(data->m_store->isFresh(storeTile)) {
+            doneTiles.push_back(tile);
+            continue;
+        }
 
-    std::string fileName = md5(url);
-    std::string dirPath = CPLSPrintf("%c/%c", fileName[0], fileName[1]);
-    std::string path = File::formFileName(data->m_basePath, dirPath, "");
+        std::string etag, lastModified;
+        if(data->m_store->validators(storeTile, etag, lastModified)) {
+            checkStoreTiles.push_back(storeTile);
+            checkUrlTiles.push_back(tile);
+            checkEtags.push_back(etag);
+            checkLastModified.push_back(lastModified);
+            continue;
+        }
 
-    if(!Folder::isExists(path)) {
-        CPLLockHolderD(&hLock, LOCK_RECURSIVE_MUTEX);
+        urls.push_back(tileUrl(data->m_url, tile));
+        storeTiles.push_back(storeTile);
+        urlTiles.push_back(tile);
+    }
 
-        if(!Folder::mkDir(path, true)) {
-            return false;
+    // Download tiles and save them to store in one transaction
+    auto results = http::fetchMulti(urls, DOWNLOAD_CONNECTION_COUNT,
+                                    data->m_options);
+    bool out = true;
+    std::vector<TileStore::TileData> tiles;
+    std::vector<Tile> written, notModified;
+    for(size_t i = 0; i < results.size(); ++i) {
+        const http::HTTPResultPtr &result = results[i];
+        if(!isResultValid(result)) {
+            out = false;
+            continue;
         }
+        tiles.push_back({ storeTiles[i], result->pabyData, result->nDataLen,
+                          CSLFetchNameValue(result->papszHeaders, "ETag"),
+                          CSLFetchNameValue(result->papszHeaders, "Last-Modified") });
+        written.push_back(urlTiles[i]);
     }
 
-    path = File::formFileName(path, fileName, "");
-    File::modificationDate(path);
-    if(time(nullptr) - File::modificationDate(path) < data->m_expires) {
-        return true;
+    // Conditional requests differ in headers, so they are sent one by one
+    // over one kept alive connection
+    Options checkOptions(data->m_options);
+    std::string persistent = CPLSPrintf("ngs_tiles_%p", data);
+    checkOptions.add("PERSISTENT", persistent);
+    std::vector<http::HTTPResultPtr> checkResults;
+    std::vector<Tile> touched;
+    for(size_t i = 0; i < checkUrlTiles.size(); ++i) {
+        bool isNotModified = false;
+        http::HTTPResultPtr result =
+                http::fetchIfModified(tileUrl(data->m_url, checkUrlTiles[i]),
+                                      checkEtags[i], checkLastModified[i],
+                                      isNotModified, checkOptions);
+        if(!isResultValid(result)) {
+            out = false;
+            continue;
+        }
+        if(isNotModified) {
+            touched.push_back(checkStoreTiles[i]);
+            notModified.push_back(checkUrlTiles[i]);
+            continue;
+        }
+        checkResults.push_back(result);
+        tiles.push_back({ checkStoreTiles[i], result->pabyData, result->nDataLen,
+                          CSLFetchNameValue(result->papszHeaders, "ETag"),
+                          CSLFetchNameValue(result->papszHeaders, "Last-Modified") });
+        written.push_back(checkUrlTiles[i]);
     }
-
-    // Download tile and save it to cache
-    auto requestOptions = data->m_options.asCPLStringList();
-    CPLHTTPResult *result = CPLHTTPFetch(url, requestOptions);
-    if(result->nStatus != 0 || result->pszErrBuf != nullptr) {
-        outMessage(COD_REQUEST_FAILED, result->pszErrBuf);
-        CPLHTTPDestroyResult(result);
-        return false;
+    if(!checkUrlTiles.empty()) {
+        CPLStringList closeOptions;
+        closeOptions.AddNameValue("CLOSE_PERSISTENT", persistent.c_str());
+        CPLHTTPDestroyResult(CPLHTTPFetch(data->m_url.c_str(), closeOptions));
     }
 
-    bool out = File::writeFile(path, result->pabyData,
-                               static_cast<size_t>(result->nDataLen));
+    GIntBig expires = static_cast<GIntBig>(time(nullptr)) + data->m_expires;
+    if(data->m_store->put(tiles, expires)) {
+        doneTiles.insert(doneTiles.end(), written.begin(), written.end());
+    }
+    else {
+        out = false;
+    }
+    if(data->m_store->touch(touched, expires)) {
+        doneTiles.insert(doneTiles.end(), notModified.begin(), notModified.end());
+    }
+    else {
+        out = false;
+    }
 
-    CPLHTTPDestroyResult(result);
+    // Save job state, so the job resumes after this batch
+    data->m_job->setDone(doneTiles);
+    data->m_store->saveJob(*data->m_job);
 
     return out;
 }
 
-bool Raster::cacheArea(const Progress &progress, const Options &options)
+/**
+ * @brief Raster::storedTileData Read tile from the tile store filled by
+ * cacheArea.
+ * @param tile Tile with TMS row numbering, as map tiles
+ * @param data Buffer of TMS_TILE_SIZE x TMS_TILE_SIZE pixels, bandCount bytes
+ * per pixel
+ * @param bandCount Band count
+ * @param bandList Bands to read
+ * @param skipLastBand Do not read the last band
+ * @return False if the tile is not in store, expired or the tile image has no
+ * such bands.
+ */
+bool Raster::storedTileData(const Tile &tile, void *data, int bandCount,
+                            int *bandList, bool skipLastBand)
 {
-    if(!isOpened()) {
-        outMessage(COD_UNSUPPORTED, "Raster must be opened.");
+    std::vector<GByte> image;
+    if(!m_tileStore || !m_tileStore->tile(tile, image)) {
         return false;
     }
-    if(m_type != CAT_RASTER_TMS) {
-        outMessage(COD_UNSUPPORTED, "Unsupported type of raster. Mast be web based like TMS, WMS, etc.");
-        return false;
+
+    std::string memPath = CPLSPrintf("/vsimem/tilestore_%p", image.data());
+    VSIFCloseL(VSIFileFromMemBuffer(memPath.c_str(), image.data(),
+                                    static_cast<vsi_l_offset>(image.size()),
+                                    FALSE));
+    GDALDatasetPtr tileDS = static_cast<GDALDataset*>(
+                GDALOpenEx(memPath.c_str(), GDAL_OF_RASTER, nullptr, nullptr,
+                           nullptr));
+    int readBandCount = skipLastBand ? bandCount - 1 : bandCount;
+    bool result = nullptr != tileDS;
+    for(int i = 0; result && i < readBandCount; ++i) {
+        result = bandList[i] > 0 && bandList[i] <= tileDS->GetRasterCount();
+    }
+    if(result) {
+        result = tileDS->RasterIO(GF_Read, 0, 0, tileDS->GetRasterXSize(),
+                                  tileDS->GetRasterYSize(), data,
+                                  TMS_TILE_SIZE, TMS_TILE_SIZE, GDT_Byte,
+                                  readBandCount, bandList, bandCount,
+                                  TMS_TILE_SIZE * bandCount, 1) == CE_None;
     }
+    tileDS.reset();
+    VSIUnlink(memPath.c_str());
+
+    return result;
+}
 
+/**
+ * @brief Raster::cacheAreaJob Fill job tile ranges from area and zoom levels
+ * options. Job identifier is made from the tiles URL and the ranges, so the
+ * same area gives the same job.
+ * @param options MINX, MINY, MAXX, MAXY and ZOOM_LEVELS options
+ * @param job Job to fill
+ * @return False if options are wrong.
+ */
+bool Raster::cacheAreaJob(const Options &options, CacheAreaJob &job) const
+{
     double minX = options.asDouble("MINX", DEFAULT_BOUNDS.minX());
     double minY = options.asDouble("MINY", DEFAULT_BOUNDS.minY());
     double maxX = options.asDouble("MAXX", DEFAULT_BOUNDS.maxX());
@@ -583,19 +1114,77 @@ bool Raster::cacheArea(const Progress &progress, const Options &options)
     }
 
     if(zoomLevels.empty()) {
+        return false;
+    }
+
+    bool reverseY = false;
+    if(compare(fromCString(m_DS->GetMetadataItem("TMS_Y_ORIGIN_TOP")), "top")) {
+        reverseY = true;
+    }
+
+    // Tiles are not wrapped by X, so each tile is in the job once
+    std::string key = fromCString(m_DS->GetMetadataItem("TMS_URL"));
+    for(auto zoomLevel : zoomLevels) {
+        std::vector<TileItem> items =
+                MapTransform::getTilesForExtent(extent, zoomLevel, reverseY,
+                                                false);
+        if(items.empty()) {
+            continue;
+        }
+
+        int minTileX = items.front().tile.x, maxTileX = minTileX;
+        int minTileY = items.front().tile.y, maxTileY = minTileY;
+        for(const TileItem &item : items) {
+            minTileX = std::min(minTileX, item.tile.x);
+            maxTileX = std::max(maxTileX, item.tile.x);
+            minTileY = std::min(minTileY, item.tile.y);
+            maxTileY = std::max(maxTileY, item.tile.y);
+        }
+        job.addLevel(zoomLevel, minTileX, minTileY, maxTileX, maxTileY);
+        key += CPLSPrintf(";%d:%d:%d:%d:%d", zoomLevel, minTileX, minTileY,
+                          maxTileX, maxTileY);
+    }
+    job.setId(md5(key));
+    return true;
+}
+
+bool Raster::cacheArea(const Progress &progress, const Options &options)
+{
+    if(!isOpened()) {
+        outMessage(COD_UNSUPPORTED, "Raster must be opened.");
+        return false;
+    }
+    if(m_type != CAT_RASTER_TMS) {
+        outMessage(COD_UNSUPPORTED, "Unsupported type of raster. Mast be web based like TMS, WMS, etc.");
+        return false;
+    }
+    if(!m_tileStore) {
+        outMessage(COD_UNSUPPORTED, _("Tile cache is not available."));
+        return false;
+    }
+
+    CacheAreaJob job;
+    if(!cacheAreaJob(options, job)) {
         outMessage(COD_UNSUPPORTED, _("Zoom level list is empty."));
         return false;
     }
 
+    // Continue stopped job with the same area
+    if(options.asBool("RESUME", true)) {
+        CacheAreaJob savedJob(job.id());
+        if(m_tileStore->loadJob(savedJob)) {
+            job.setLevels(savedJob.levels());
+        }
+    }
+
     Options loadOptions(options);
     loadOptions.remove("MINX");
     loadOptions.remove("MINY");
     loadOptions.remove("MAXX");
     loadOptions.remove("MAXY");
     loadOptions.remove("ZOOM_LEVELS");
+    loadOptions.remove("RESUME");
 
-    // Get cache path
-    std::string basePath = fromCString(m_DS->GetMetadataItem("CACHE_PATH"));
     std::string url = fromCString(m_DS->GetMetadataItem("TMS_URL"));
     const char *strExpires = m_DS->GetMetadataItem("TMS_CACHE_EXPIRES");
     int expires = std::stoi(strExpires == nullptr ? "0" : strExpires);
@@ -612,32 +1201,150 @@ bool Raster::cacheArea(const Progress &progress, const Options &options)
     CPLDebug("ngstore", "cache area");
 
     ThreadPool threadPool;
-    threadPool.init(DOWNLOAD_THREAD_COUNT, cacheAreaJobThreadFunc, 3, true);
-
-    for(auto zoomLevel : zoomLevels) {
-        std::vector<TileItem> items =
-                MapTransform::getTilesForExtent(extent, zoomLevel, reverseY,
-                                                true);
-
-        for(auto item : items) {
-            threadPool.addThreadData(new DownloadData(basePath, url, expires,
-                                                      item.tile, loadOptions,
-                                                      true));
+    threadPool.init(DOWNLOAD_THREAD_COUNT, cacheAreaJobThreadFunc, 3, true,
+                    WorkerClass::NETWORK);
+
+    // Tiles are downloaded in batches, each batch reuses connections. Tiles
+    // done by previous run of the job are skipped.
+    std::vector<Tile> tiles;
+    for(const CacheAreaJob::Level &level : job.levels()) {
+        for(int x = level.minX; x <= level.maxX; ++x) {
+            for(int y = level.minY; y <= level.maxY; ++y) {
+                Tile tile = { x, y, level.z, 0 };
+                if(job.isDone(tile)) {
+                    continue;
+                }
+                tiles.push_back(tile);
+                if(tiles.size() == DOWNLOAD_BATCH_SIZE) {
+                    threadPool.addThreadData(new DownloadData(m_tileStore.get(),
+                                                              &job, url, expires,
+                                                              reverseY, tiles,
+                                                              loadOptions, true));
+                    tiles.clear();
+                }
+            }
         }
     }
+    if(!tiles.empty()) {
+        threadPool.addThreadData(new DownloadData(m_tileStore.get(), &job, url,
+                                                  expires, reverseY, tiles,
+                                                  loadOptions, true));
+    }
 
     threadPool.waitComplete(progress);
     threadPool.clearThreadData();
 
-    if(threadPool.isFailed()) {
+    if(threadPool.isFailed() || job.doneCount() < job.tileCount()) {
         progress.onProgress(COD_GET_FAILED, 1.0, _("Download area failed"));
         return false;
     }
+    m_tileStore->deleteJob(job.id());
     progress.onProgress(COD_FINISHED, 1.0, _("Finish download area"));
 
     CPLDebug("ngstore", "finish cache area");
     return true;
 }
 
+/**
+ * @brief Raster::cacheAreaProgress Downloaded part of area caching job which
+ * was stopped or is running.
+ * @param options The same area options as for cacheArea
+ * @return Value from 0 to 1 or -1 if there is no such job. Finished jobs are
+ * removed from store.
+ */
+double Raster::cacheAreaProgress(const Options &options) const
+{
+    if(!isOpened() || !m_tileStore) {
+        return -1.0;
+    }
+
+    CacheAreaJob job;
+    if(!cacheAreaJob(options, job)) {
+        return -1.0;
+    }
+    if(!m_tileStore->loadJob(job)) {
+        return -1.0;
+    }
+    size_t count = job.tileCount();
+    if(count == 0) {
+        return 1.0;
+    }
+    return static_cast<double>(job.doneCount()) / count;
+}
+
+/**
+ * @brief Raster::createOverviews Build overviews of local raster, so zoomed
+ * out tiles are read from overview levels instead of downsampling the full
+ * raster. GeoTIFF gets internal overviews if it can be opened for update,
+ * other formats or read only files get external .ovr file.
+ * @param progress Progress to report and cancel
+ * @param options Key=value list of options:
+ * - RESAMPLING - overview resampling method. Default AVERAGE.
+ * - FORCE - ON/OFF. Rebuild existing overviews. Default OFF.
+ * @return True on success.
+ */
+bool Raster::createOverviews(const Progress &progress, const Options &options)
+{
+    if(!isOpened()) {
+        outMessage(COD_UNSUPPORTED, _("Raster must be opened."));
+        return false;
+    }
+    if(!Filter::isFileBased(m_type) || m_type == CAT_RASTER_TMS) {
+        outMessage(COD_UNSUPPORTED, _("Overviews can be created only for local rasters."));
+        return false;
+    }
+    if(m_DS->GetRasterCount() == 0) {
+        outMessage(COD_UNSUPPORTED, _("Raster has no bands."));
+        return false;
+    }
+
+    bool force = options.asBool("FORCE", false);
+    if(!force && m_DS->GetRasterBand(1)->GetOverviewCount() > 0) {
+        progress.onProgress(COD_FINISHED, 1.0, _("Overviews already exist"));
+        return true;
+    }
+
+    // Halve raster until it fits in one block
+    std::vector<int> levels;
+    int size = std::max(width(), height());
+    for(int level = 2; size / level > RASTER_BLOCK_SIZE; level *= 2) {
+        levels.push_back(level);
+    }
+    if(levels.empty()) {
+        progress.onProgress(COD_FINISHED, 1.0, _("Raster is too small for overviews"));
+        return true;
+    }
+
+    std::string resampling = options.asString("RESAMPLING", "AVERAGE");
+    unsigned int openFlags = m_openFlags;
+    Options openOptions = m_openOptions;
+
+    // Reopen for update to write internal overviews
+    close();
+    if(!open(GDAL_OF_RASTER|GDAL_OF_UPDATE|GDAL_OF_VERBOSE_ERROR, openOptions)) {
+        open(openFlags, openOptions);
+        return false;
+    }
+
+    progress.onProgress(COD_IN_PROCESS, 0.0, _("Start create overviews..."));
+    Progress progressIn(progress);
+    CPLErrorReset();
+    bool result = m_DS->BuildOverviews(resampling.c_str(),
+                                       static_cast<int>(levels.size()),
+                                       levels.data(), 0, nullptr,
+                                       ngsGDALProgress, &progressIn) == CE_None;
+    if(!result) {
+        outMessage(COD_CREATE_FAILED, CPLGetLastErrorMsg());
+    }
+
+    close();
+    if(!open(openFlags, openOptions)) {
+        return false;
+    }
+    if(result) {
+        progress.onProgress(COD_FINISHED, 1.0, _("Finish create overviews"));
+    }
+    return result;
+}
 
 } // namespace ngs
@@ -21,8 +21,14 @@
 #ifndef NGSRASTERDATASET_H
 #define NGSRASTERDATASET_H
 
+// std
+#include <list>
+#include <map>
+#include <thread>
+
 #include "coordinatetransformation.h"
 #include "dataset.h"
+#include "tilestore.h"
 #include "ngstore/codes.h"
 
 namespace ngs {
@@ -39,6 +45,9 @@ constexpr const char *KEY_CACHE_MAX_SIZE = "cache_max_size";
 
 constexpr const int defaultCacheExpires = 7 * 24 * 60 * 60; // 7 days
 constexpr const int defaultCacheMaxSize = 32 * 1024 * 1024; // 32 Mb
+constexpr int TMS_TILE_SIZE = 256;
+constexpr int RASTER_BLOCK_SIZE = 256;
+constexpr size_t RASTER_BLOCK_CACHE_SIZE = 64;
 
 typedef struct _imageData {
     unsigned char *buffer;
@@ -46,6 +55,50 @@ typedef struct _imageData {
     int height;
 } ImageData;
 
+/**
+ * @brief The RasterBlockCache class Keeps decoded pixels of raster blocks on
+ * raster or overview level. Blocks are aligned to RASTER_BLOCK_SIZE grid, so
+ * the neighbouring windows on the same level are read from GDAL once and then
+ * copied from cache. Blocks are read with dataset given by caller outside of
+ * the cache lock, so each thread may use own dataset handle.
+ */
+class RasterBlockCache
+{
+public:
+    explicit RasterBlockCache(size_t maxBlocks = RASTER_BLOCK_CACHE_SIZE);
+    bool read(GDALDataset *DS, void *data, int overview, int xOff, int yOff,
+              int xSize, int ySize, GDALDataType dataType, int bandCount,
+              int *bandList, bool skipLastBand = false);
+    void clear();
+
+private:
+    typedef struct _blockKey {
+        int generation;
+        int overview;
+        int x, y;
+        bool operator<(const struct _blockKey &other) const;
+    } BlockKey;
+
+    typedef struct _block {
+        BlockKey key;
+        int width, height;
+        std::vector<GByte> data;
+    } Block;
+    typedef std::shared_ptr<Block> BlockPtr;
+
+    BlockPtr block(GDALDataset *DS, const BlockKey &key,
+                   GDALDataType dataType, const std::vector<int> &bands);
+
+private:
+    size_t m_maxBlocks;
+    int m_generation;
+    GDALDataType m_dataType;
+    std::vector<int> m_bands;
+    std::list<BlockPtr> m_blocks;
+    std::map<BlockKey, std::list<BlockPtr>::iterator> m_index;
+    Mutex m_mutex;
+};
+
 /**
  * @brief The Raster dataset class represents image or raster
  */
@@ -67,6 +120,7 @@ public:
     };
 
     bool writeWorldFile(enum WorldFileType type);
+    const std::vector<std::string> &siblingFiles() const { return m_siblingFiles; }
     const Envelope &extent() const { return m_extent; }
     bool geoTransform(double *transform) const;
     int width() const;
@@ -74,13 +128,24 @@ public:
     int dataSize() const;
     unsigned short bandCount() const;
     GDALDataType dataType(int band = 1) const;
+    bool colorTable(std::vector<GByte> &rgba, int band = 1) const;
+    bool noData(double &value, int band = 1) const;
+    bool minMax(double &min, double &max, int band = 1) const;
     int getBestOverview(int &xOff, int &yOff, int &xSize, int &ySize,
                         int bufXSize, int bufYSize) const;
     bool pixelData(void *data, int xOff, int yOff, int xSize, int ySize,
                    int bufXSize, int bufYSize, GDALDataType dataType,
                    int bandCount, int *bandList, bool read = true,
                    bool skipLastBand = false);
+    bool levelPixelData(void *data, int overview, int xOff, int yOff,
+                        int xSize, int ySize, GDALDataType dataType,
+                        int bandCount, int *bandList, bool skipLastBand = false);
     bool cacheArea(const Progress &progress, const Options &options);
+    double cacheAreaProgress(const Options &options) const;
+    bool createOverviews(const Progress &progress, const Options &options);
+    bool hasTileStore() const { return static_cast<bool>(m_tileStore); }
+    bool storedTileData(const Tile &tile, void *data, int bandCount,
+                        int *bandList, bool skipLastBand = false);
 
     // Object interface
     virtual bool destroy() override;
@@ -96,9 +161,12 @@ public:
     virtual bool open(unsigned int openFlags = DatasetBase::defaultOpenFlags,
                       const Options &options = Options()) override;
     virtual std::string options(ngsOptionType optionType) const override;
+    virtual void close() override;
 
 protected:
     void setExtent();
+    GDALDataset *readDataset();
+    bool cacheAreaJob(const Options &options, CacheAreaJob &job) const;
 
     // static
 protected:
@@ -112,6 +180,11 @@ protected:
 private:
     std::vector<std::string> m_siblingFiles;
     Mutex m_dataLock;
+    RasterBlockCache m_blockCache;
+    bool m_hasReadDatasets;
+    std::map<std::thread::id, GDALDatasetPtr> m_readDatasets;
+    Mutex m_readDatasetsLock;
+    std::unique_ptr<TileStore> m_tileStore;
 };
 
 using RasterPtr = std::shared_ptr<Raster>;
@@ -121,11 +121,11 @@ void SimpleDataset::fillFeatureClasses() const
             // layer->GetLayerDefn()->GetGeomFieldCount() == 0
             auto parent = const_cast<SimpleDataset*>(this);
             if(geometryType == wkbNone) {
-                m_children.push_back(
+                appendChild(
                     ObjectPtr(new Table(layer, parent, subType(), layerName)));
             }
             else {
-                m_children.push_back(
+                appendChild(
                     ObjectPtr(new FeatureClass(layer, parent, subType(), layerName)));
             }
             break;
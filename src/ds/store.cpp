@@ -20,8 +20,10 @@
  ****************************************************************************/
 #include "store.h"
 
+#include "datastore.h"
 #include "catalog/ngw.h"
 #include "util.h"
+#include "util/error.h"
 
 namespace ngs {
 
@@ -29,7 +31,10 @@ namespace ngs {
 // StoreObject
 //------------------------------------------------------------------------------
 
-StoreObject::StoreObject(OGRLayer *layer) : m_storeIntLayer(layer)
+StoreObject::StoreObject(OGRLayer *layer) :
+    m_storeIntLayer(layer),
+    m_remoteIdIndexChecked(false),
+    m_remoteIdsLoaded(false)
 {
 }
 
@@ -41,6 +46,26 @@ FeaturePtr StoreObject::getFeatureByRemoteId(GIntBig rid) const
     }
 
     Dataset *dataset = dynamic_cast<Dataset*>(table->parent());
+    {
+        MutexHolder holder(m_remoteIdsMutex);
+        if(m_remoteIdsLoaded) {
+            auto it = m_remoteIds.find(rid);
+            if(it == m_remoteIds.end()) {
+                return FeaturePtr();
+            }
+            DatasetExecuteSQLLockHolder sqlHolder(dataset);
+            return FeaturePtr(m_storeIntLayer->GetFeature(it->second), table);
+        }
+    }
+
+    if(!m_remoteIdIndexChecked.exchange(true)) {
+        DataStore *dataStore = dynamic_cast<DataStore*>(dataset);
+        if(nullptr != dataStore && !dataStore->isReadOnly()) {
+            dataStore->createAttributeIndex(m_storeIntLayer->GetName(),
+                                            ngw::REMOTE_ID_KEY);
+        }
+    }
+
     DatasetExecuteSQLLockHolder holder(dataset);
     auto attFilterStr = CPLSPrintf("%s = " CPL_FRMT_GIB, ngw::REMOTE_ID_KEY, rid);
     if(m_storeIntLayer->SetAttributeFilter(attFilterStr) != OGRERR_NONE) {
@@ -52,6 +77,126 @@ FeaturePtr StoreObject::getFeatureByRemoteId(GIntBig rid) const
     return intFeature;
 }
 
+/**
+ * @brief StoreObject::createFieldIndex Create attribute index on field of data
+ * store table.
+ * @param field Field name.
+ * @return True on success.
+ */
+bool StoreObject::createFieldIndex(const std::string &field)
+{
+    Table *table = dynamic_cast<Table*>(this);
+    if(nullptr == table) {
+        return false;
+    }
+
+    DataStore *dataStore = dynamic_cast<DataStore*>(table->parent());
+    if(nullptr == dataStore) {
+        return errorMessage(_("Table %s is not in data store"),
+                            table->name().c_str());
+    }
+
+    if(m_storeIntLayer->GetLayerDefn()->GetFieldIndex(field.c_str()) < 0) {
+        return errorMessage(_("Field %s not found in %s"), field.c_str(),
+                            table->name().c_str());
+    }
+    return dataStore->createAttributeIndex(m_storeIntLayer->GetName(), field);
+}
+
+bool StoreObject::dropFieldIndex(const std::string &field)
+{
+    Table *table = dynamic_cast<Table*>(this);
+    if(nullptr == table) {
+        return false;
+    }
+
+    DataStore *dataStore = dynamic_cast<DataStore*>(table->parent());
+    if(nullptr == dataStore) {
+        return errorMessage(_("Table %s is not in data store"),
+                            table->name().c_str());
+    }
+    return dataStore->dropAttributeIndex(m_storeIntLayer->GetName(), field);
+}
+
+/**
+ * @brief StoreObject::loadRemoteIds Read remote ids of all synced features to
+ * memory. Until clearRemoteIds, getFeatureByRemoteId uses the map and the map
+ * follows feature edits.
+ * @return True on success.
+ */
+bool StoreObject::loadRemoteIds()
+{
+    Table *table = dynamic_cast<Table*>(this);
+    if(nullptr == table) {
+        return false;
+    }
+    // Other stores keep remote ids in own tables
+    DataStore *dataset = dynamic_cast<DataStore*>(table->parent());
+    if(nullptr == dataset) {
+        return false;
+    }
+
+    std::string fidColumn = table->fidColumn();
+    if(fidColumn.empty()) {
+        fidColumn = "fid";
+    }
+    TablePtr result = dataset->executeSQL(
+                CPLSPrintf("SELECT \"%s\", \"%s\" FROM \"%s\" WHERE \"%s\" <> "
+                           CPL_FRMT_GIB, fidColumn.c_str(), ngw::REMOTE_ID_KEY,
+                           m_storeIntLayer->GetName(), ngw::REMOTE_ID_KEY,
+                           ngw::INIT_RID_COUNTER));
+    if(!result) {
+        return false;
+    }
+
+    MutexHolder holder(m_remoteIdsMutex);
+    m_remoteIds.clear();
+    FeaturePtr feature;
+    while((feature = result->nextFeature())) {
+        m_remoteIds[feature->GetFieldAsInteger64(1)] =
+                feature->GetFieldAsInteger64(0);
+    }
+    m_remoteIdsLoaded = true;
+    return true;
+}
+
+void StoreObject::clearRemoteIds()
+{
+    MutexHolder holder(m_remoteIdsMutex);
+    m_remoteIds.clear();
+    m_remoteIdsLoaded = false;
+}
+
+void StoreObject::updateRemoteId(const FeaturePtr &feature)
+{
+    MutexHolder holder(m_remoteIdsMutex);
+    if(!m_remoteIdsLoaded || !feature) {
+        return;
+    }
+    GIntBig rid = getRemoteId(feature);
+    if(rid != ngw::INIT_RID_COUNTER) {
+        m_remoteIds[rid] = feature->GetFID();
+    }
+}
+
+void StoreObject::removeRemoteId(const FeaturePtr &feature)
+{
+    MutexHolder holder(m_remoteIdsMutex);
+    if(!m_remoteIdsLoaded || !feature) {
+        return;
+    }
+    auto it = m_remoteIds.find(getRemoteId(feature));
+    if(it != m_remoteIds.end() && it->second == feature->GetFID()) {
+        m_remoteIds.erase(it);
+    }
+}
+
+void StoreObject::removeRemoteIds()
+{
+    MutexHolder holder(m_remoteIdsMutex);
+    m_remoteIds.clear();
+}
+
 bool StoreObject::setAttachmentRemoteId(GIntBig aid, GIntBig rid)
 {
     Table *table = dynamic_cast<Table*>(this);
@@ -81,6 +226,42 @@ void StoreObject::setRemoteId(FeaturePtr feature, GIntBig rid)
     feature->SetField(ngw::REMOTE_ID_KEY, rid);
 }
 
+/**
+ * @brief StoreObject::setDefaultFields Set unset fields to their default
+ * values. GeoPackage driver reuses prepared insert statement only if feature
+ * has no unset fields with default value, else new statement is prepared for
+ * each feature.
+ * @param feature Feature to fill.
+ */
+void StoreObject::setDefaultFields(FeaturePtr feature)
+{
+    if(!feature) {
+        return;
+    }
+
+    for(int i = 0; i < feature->GetFieldCount(); ++i) {
+        if(feature->IsFieldSet(i)) {
+            continue;
+        }
+        OGRFieldDefn *fieldDefn = feature->GetFieldDefnRef(i);
+        const char *defaultValue = fieldDefn->GetDefault();
+        if(nullptr == defaultValue || fieldDefn->IsDefaultDriverSpecific()) {
+            continue;
+        }
+
+        if(defaultValue[0] == '\'') {
+            CPLString value(defaultValue + 1);
+            if(!value.empty() && value.back() == '\'') {
+                value.pop_back();
+            }
+            feature->SetField(i, value.replaceAll("''", "'").c_str());
+        }
+        else {
+            feature->SetField(i, defaultValue);
+        }
+    }
+}
+
 GIntBig StoreObject::getRemoteId(FeaturePtr feature)
 {
     if(feature) {
@@ -153,5 +334,23 @@ std::string StoreObject::downloadAttachment(GIntBig fid, GIntBig aid,
     return ngw::downloadAttachment(this, fid, aid, progress);
 }
 
-} // namespace ngs
+//------------------------------------------------------------------------------
+// StoreRemoteIdsHolder
+//------------------------------------------------------------------------------
+
+StoreRemoteIdsHolder::StoreRemoteIdsHolder(StoreObject *storeObject) :
+    m_storeObject(storeObject)
+{
+    if(nullptr != m_storeObject) {
+        m_storeObject->loadRemoteIds();
+    }
+}
 
+StoreRemoteIdsHolder::~StoreRemoteIdsHolder()
+{
+    if(nullptr != m_storeObject) {
+        m_storeObject->clearRemoteIds();
+    }
+}
+
+} // namespace ngs
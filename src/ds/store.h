@@ -21,6 +21,10 @@
 #ifndef NGSSTORE_H
 #define NGSSTORE_H
 
+// std
+#include <atomic>
+#include <unordered_map>
+
 #include "dataset.h"
 
 namespace ngs {
@@ -50,14 +54,44 @@ public:
     virtual bool setAttachmentRemoteId(GIntBig aid, GIntBig rid);
     GIntBig getAttachmentRemoteId(GIntBig aid) const;
     GIntBig getRemoteId(GIntBig fid) const;
+    bool createFieldIndex(const std::string &field);
+    bool dropFieldIndex(const std::string &field);
+    bool loadRemoteIds();
+    void clearRemoteIds();
 
     // static
 public:
     static void setRemoteId(FeaturePtr feature, GIntBig rid);
     static GIntBig getRemoteId(FeaturePtr feature);
+    static void setDefaultFields(FeaturePtr feature);
+
+protected:
+    void updateRemoteId(const FeaturePtr &feature);
+    void removeRemoteId(const FeaturePtr &feature);
+    void removeRemoteIds();
 
 protected:
     OGRLayer *m_storeIntLayer;
+    // Stores created before remote id index was added are indexed on lookup
+    mutable std::atomic_bool m_remoteIdIndexChecked;
+    // Remote id to feature id map loaded while sync applies remote changes
+    mutable Mutex m_remoteIdsMutex;
+    bool m_remoteIdsLoaded;
+    std::unordered_map<GIntBig, GIntBig> m_remoteIds;
+};
+
+/**
+ * @brief The StoreRemoteIdsHolder class Keeps remote id map of store object
+ * loaded while holder exists.
+ */
+class StoreRemoteIdsHolder
+{
+public:
+    explicit StoreRemoteIdsHolder(StoreObject *storeObject);
+    ~StoreRemoteIdsHolder();
+
+protected:
+    StoreObject *m_storeObject;
 };
 
 
@@ -18,15 +18,20 @@
  *    You should have received a copy of the GNU General Public License
  *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ****************************************************************************/
+#include <algorithm>
+#include <cmath>
 #include <ctime>
+#include <sstream>
 #include "storefeatureclass.h"
 
 #include "datastore.h"
+#include "tablecursor.h"
 #include "catalog/file.h"
 #include "catalog/folder.h"
 #include "catalog/ngw.h"
 #include "ngstore/version.h"
 #include "util/error.h"
+#include "util/stringutil.h"
 #include "util.h"
 
 #ifdef WIN32
@@ -35,6 +40,9 @@
 
 namespace ngs {
 
+constexpr const char *SEARCH_FIELDS_KEY = "search_fields";
+constexpr const char *SEARCH_LANG_KEY = "search_lang";
+
 //------------------------------------------------------------------------------
 // StoreTable
 //------------------------------------------------------------------------------
@@ -43,6 +51,7 @@ StoreTable::StoreTable(OGRLayer *layer, ObjectContainer * const parent,
     Table(layer, parent, CAT_TABLE_GPKG, name),
     StoreObject(layer)
 {
+    m_cacheFeatureCount = true;
 }
 
 void StoreTable::fillFields() const
@@ -54,6 +63,13 @@ void StoreTable::fillFields() const
     }
 }
 
+FeaturePtr StoreTable::createFeature() const
+{
+    FeaturePtr feature = Table::createFeature();
+    StoreObject::setDefaultFields(feature);
+    return feature;
+}
+
 GIntBig StoreTable::addAttachment(GIntBig fid, const std::string &fileName,
                                   const std::string &description,
                                   const std::string &filePath,
@@ -113,6 +129,16 @@ std::vector<ngsEditOperation> StoreTable::editOperations()
     return fillEditOperations(m_editHistoryTable, dynamic_cast<Dataset*>(m_parent));
 }
 
+bool StoreTable::createIndex(const std::string &field)
+{
+    return createFieldIndex(field);
+}
+
+bool StoreTable::dropIndex(const std::string &field)
+{
+    return dropFieldIndex(field);
+}
+
 FeaturePtr StoreTable::logEditFeature(FeaturePtr feature,
                                       FeaturePtr attachFeature, ngsChangeCode code)
 {
@@ -125,6 +151,31 @@ FeaturePtr StoreTable::logEditFeature(FeaturePtr feature,
     return logFeature;
 }
 
+void StoreTable::onFeatureInserted(FeaturePtr feature)
+{
+    Table::onFeatureInserted(feature);
+    updateRemoteId(feature);
+}
+
+void StoreTable::onFeatureUpdated(FeaturePtr oldFeature, FeaturePtr newFeature)
+{
+    Table::onFeatureUpdated(oldFeature, newFeature);
+    removeRemoteId(oldFeature);
+    updateRemoteId(newFeature);
+}
+
+void StoreTable::onFeatureDeleted(FeaturePtr delFeature)
+{
+    Table::onFeatureDeleted(delFeature);
+    removeRemoteId(delFeature);
+}
+
+void StoreTable::onFeaturesDeleted()
+{
+    Table::onFeaturesDeleted();
+    removeRemoteIds();
+}
+
 //------------------------------------------------------------------------------
 // StoreFeatureClass
 //------------------------------------------------------------------------------
@@ -133,8 +184,10 @@ StoreFeatureClass::StoreFeatureClass(OGRLayer *layer,
                                      ObjectContainer * const parent,
                                      const std::string &name) :
     FeatureClass(layer, parent, CAT_FC_GPKG, name),
-    StoreObject(layer)
+    StoreObject(layer),
+    m_searchLoaded(false)
 {
+    m_cacheFeatureCount = true;
 }
 
 void StoreFeatureClass::fillFields() const
@@ -146,6 +199,13 @@ void StoreFeatureClass::fillFields() const
     }
 }
 
+FeaturePtr StoreFeatureClass::createFeature() const
+{
+    FeaturePtr feature = FeatureClass::createFeature();
+    StoreObject::setDefaultFields(feature);
+    return feature;
+}
+
 GIntBig StoreFeatureClass::addAttachment(GIntBig fid, const std::string &fileName,
                                          const std::string &description,
                                          const std::string &filePath,
@@ -206,6 +266,73 @@ std::vector<ngsEditOperation> StoreFeatureClass::editOperations()
     return fillEditOperations(m_editHistoryTable, dynamic_cast<Dataset*>(m_parent));
 }
 
+bool StoreFeatureClass::createIndex(const std::string &field)
+{
+    return createFieldIndex(field);
+}
+
+bool StoreFeatureClass::dropIndex(const std::string &field)
+{
+    return dropFieldIndex(field);
+}
+
+/**
+ * @brief StoreFeatureClass::copyFeatures Copy features from source feature
+ * class. If DEFER_INDEXES option is true, the spatial index is dropped before
+ * copy and build again in one pass after copy.
+ */
+int StoreFeatureClass::copyFeatures(const FeatureClassPtr srcFClass,
+                                    const FieldMapPtr fieldMap,
+                                    OGRwkbGeometryType filterGeomType,
+                                    const Progress &progress,
+                                    const Options &options)
+{
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    bool deferIndexes = nullptr != dataStore && nullptr != m_layer &&
+            options.asBool("DEFER_INDEXES", false);
+    std::string layerName, geometryColumn;
+    if(deferIndexes) {
+        layerName = m_layer->GetName();
+        geometryColumn = m_layer->GetGeometryColumn();
+        deferIndexes = dataStore->dropSpatialIndex(layerName, geometryColumn);
+    }
+
+    int result = FeatureClass::copyFeatures(srcFClass, fieldMap,
+                                            filterGeomType, progress, options);
+
+    // Restore index even if copy failed or canceled
+    if(deferIndexes) {
+        progress.onProgress(COD_IN_PROCESS, 1.0, _("Create spatial index ..."));
+        if(!dataStore->createSpatialIndex(layerName, geometryColumn) &&
+                result == COD_SUCCESS) {
+            return COD_COPY_FAILED;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief StoreFeatureClass::recomputeExtent Recompute extent stored in
+ * gpkg_contents as GeoPackage driver only grows it on edit.
+ */
+bool StoreFeatureClass::recomputeExtent(Envelope &extent) const
+{
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr == dataStore || !dataStore->recomputeExtent(m_layer->GetName())) {
+        return FeatureClass::recomputeExtent(extent);
+    }
+
+    DatasetExecuteSQLLockHolder holder(dataStore);
+    OGREnvelope env;
+    if(m_layer->GetExtent(&env, FALSE) != OGRERR_NONE) {
+        // No features left
+        extent.clear();
+        return true;
+    }
+    extent = env;
+    return true;
+}
+
 FeaturePtr StoreFeatureClass::logEditFeature(FeaturePtr feature,
                                              FeaturePtr attachFeature,
                                              ngsChangeCode code)
@@ -219,6 +346,246 @@ FeaturePtr StoreFeatureClass::logEditFeature(FeaturePtr feature,
     return logFeature;
 }
 
+void StoreFeatureClass::onFeatureInserted(FeaturePtr feature)
+{
+    FeatureClass::onFeatureInserted(feature);
+    updateRemoteId(feature);
+    updateSearchText(feature);
+}
+
+void StoreFeatureClass::onFeatureUpdated(FeaturePtr oldFeature, FeaturePtr newFeature)
+{
+    FeatureClass::onFeatureUpdated(oldFeature, newFeature);
+    removeRemoteId(oldFeature);
+    updateRemoteId(newFeature);
+    updateSearchText(newFeature);
+}
+
+void StoreFeatureClass::onFeatureDeleted(FeaturePtr delFeature)
+{
+    FeatureClass::onFeatureDeleted(delFeature);
+    removeRemoteId(delFeature);
+    if(delFeature && hasSearchIndex()) {
+        DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+        if(nullptr != dataStore) {
+            dataStore->deleteSearchText(name(), delFeature->GetFID());
+        }
+    }
+}
+
+void StoreFeatureClass::onFeaturesDeleted()
+{
+    FeatureClass::onFeaturesDeleted();
+    removeRemoteIds();
+    if(hasSearchIndex()) {
+        DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+        if(nullptr != dataStore) {
+            dataStore->clearSearchTable(name());
+        }
+    }
+}
+
+/**
+ * @brief StoreFeatureClass::createSearchIndex Create full-text search index of
+ * feature class fields. The index is filled from existing features and then
+ * follows feature edits.
+ * @param fields Fields to index. Empty list drops the index.
+ * @param lang Language to normalize the text, i.e. ru transliterates
+ * cyrillic, so latin query matches. Empty to index text as is.
+ * @return True on success.
+ */
+bool StoreFeatureClass::createSearchIndex(const std::vector<std::string> &fields,
+                                          const std::string &lang)
+{
+    if(fields.empty()) {
+        return dropSearchIndex();
+    }
+
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr == dataStore) {
+        return errorMessage(_("Feature class %s is not in data store"),
+                            name().c_str());
+    }
+
+    std::string fieldList;
+    for(const std::string &field : fields) {
+        if(m_layer->GetLayerDefn()->GetFieldIndex(field.c_str()) < 0) {
+            return errorMessage(_("Field %s not found in %s"), field.c_str(),
+                                name().c_str());
+        }
+        if(!fieldList.empty()) {
+            fieldList += ",";
+        }
+        fieldList += field;
+    }
+
+    TableCursorPtr fieldsCursor = cursor("", Envelope(), fields);
+    if(!fieldsCursor) {
+        return false;
+    }
+
+    dataStore->destroySearchTable(name());
+    if(!dataStore->createSearchTable(name())) {
+        return false;
+    }
+
+    {
+        MutexHolder holder(m_searchMutex);
+        m_searchFields = fields;
+        m_searchLang = lang;
+        m_searchLoaded = true;
+    }
+    setProperty(SEARCH_FIELDS_KEY, fieldList, NG_ADDITIONS_KEY);
+    setProperty(SEARCH_LANG_KEY, lang, NG_ADDITIONS_KEY);
+
+    bool transaction = dataStore->startTransaction();
+    FeaturePtr feature;
+    while((feature = fieldsCursor->next())) {
+        if(!dataStore->setSearchText(name(), feature->GetFID(),
+                                     searchText(feature))) {
+            if(transaction) {
+                dataStore->rollbackTransaction();
+            }
+            dropSearchIndex();
+            return errorMessage(_("Failed to fill search index of %s. %s"),
+                                name().c_str(), CPLGetLastErrorMsg());
+        }
+    }
+    if(transaction) {
+        dataStore->commitTransaction();
+    }
+    return true;
+}
+
+bool StoreFeatureClass::dropSearchIndex()
+{
+    {
+        MutexHolder holder(m_searchMutex);
+        m_searchFields.clear();
+        m_searchLang.clear();
+        m_searchLoaded = true;
+    }
+    setProperty(SEARCH_FIELDS_KEY, "", NG_ADDITIONS_KEY);
+
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr == dataStore) {
+        return false;
+    }
+    return dataStore->destroySearchTable(name());
+}
+
+bool StoreFeatureClass::hasSearchIndex() const
+{
+    loadSearchFields();
+    MutexHolder holder(m_searchMutex);
+    return !m_searchFields.empty();
+}
+
+/**
+ * @brief StoreFeatureClass::search Find features which indexed fields contain
+ * all query words. Words match as prefixes, so search works while typing.
+ * @param query Search query.
+ * @param offset Number of best matches to skip.
+ * @param limit Maximum number of feature ids to return.
+ * @return Feature ids, best matches first.
+ */
+std::vector<GIntBig> StoreFeatureClass::search(const std::string &query,
+                                               int offset, int limit) const
+{
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr == dataStore || !hasSearchIndex()) {
+        errorMessage(_("Feature class %s has no search index"), name().c_str());
+        return std::vector<GIntBig>();
+    }
+
+    std::string lang;
+    {
+        MutexHolder holder(m_searchMutex);
+        lang = m_searchLang;
+    }
+    std::string text = lang.empty() ? query : normalize(query, lang);
+
+    // Quote words to escape FTS5 syntax
+    std::string match;
+    std::istringstream words(text);
+    std::string word;
+    while(words >> word) {
+        word.erase(std::remove(word.begin(), word.end(), '"'), word.end());
+        if(word.empty()) {
+            continue;
+        }
+        if(!match.empty()) {
+            match += " ";
+        }
+        match += "\"" + word + "\"*";
+    }
+    if(match.empty()) {
+        return std::vector<GIntBig>();
+    }
+    return dataStore->search(name(), match, offset, limit);
+}
+
+bool StoreFeatureClass::destroy()
+{
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    std::string storeName = name();
+    bool searchIndex = hasSearchIndex();
+    if(!FeatureClass::destroy()) {
+        return false;
+    }
+    if(nullptr != dataStore && searchIndex) {
+        dataStore->destroySearchTable(storeName);
+    }
+    return true;
+}
+
+void StoreFeatureClass::loadSearchFields() const
+{
+    MutexHolder holder(m_searchMutex);
+    if(m_searchLoaded) {
+        return;
+    }
+    m_searchLoaded = true;
+    std::string fieldList = fromCString(
+                m_layer->GetMetadataItem(SEARCH_FIELDS_KEY, NG_ADDITIONS_KEY));
+    if(fieldList.empty()) {
+        return;
+    }
+    char **fields = CSLTokenizeString2(fieldList.c_str(), ",", 0);
+    m_searchFields = fillStringList(fields);
+    CSLDestroy(fields);
+    m_searchLang = fromCString(
+                m_layer->GetMetadataItem(SEARCH_LANG_KEY, NG_ADDITIONS_KEY));
+}
+
+std::string StoreFeatureClass::searchText(const FeaturePtr &feature) const
+{
+    MutexHolder holder(m_searchMutex);
+    std::string out;
+    for(const std::string &field : m_searchFields) {
+        int index = feature->GetFieldIndex(field.c_str());
+        if(index < 0 || !feature->IsFieldSetAndNotNull(index)) {
+            continue;
+        }
+        if(!out.empty()) {
+            out += " ";
+        }
+        out += feature->GetFieldAsString(index);
+    }
+    return m_searchLang.empty() ? out : normalize(out, m_searchLang);
+}
+
+void StoreFeatureClass::updateSearchText(const FeaturePtr &feature)
+{
+    if(!feature || !hasSearchIndex()) {
+        return;
+    }
+    DataStore *dataStore = dynamic_cast<DataStore*>(m_parent);
+    if(nullptr != dataStore) {
+        dataStore->setSearchText(name(), feature->GetFID(), searchText(feature));
+    }
+}
+
 //------------------------------------------------------------------------------
 // TrackPointsTable
 //------------------------------------------------------------------------------
@@ -254,8 +621,14 @@ ObjectPtr TrackPointsTable::pointer() const
 //------------------------------------------------------------------------------
 
 constexpr char POINT_BUFFER_SIZE = 30;
-
-TracksTable::TracksTable(OGRLayer *linesLayer, OGRLayer *pointsLayer, ObjectContainer * const parent) :
+constexpr double WRITER_WAKE_PERIOD = 1.0; // seconds
+constexpr unsigned char TRACK_OVR_ZOOMS[] = {5, 8, 11, 14};
+constexpr int TRACK_OVR_TILE_SIZE = 256;
+constexpr size_t POINT_JSON_SIZE = 160;
+constexpr size_t TRACKER_MAX_PAYLOAD_SIZE = 256 * 1024;
+
+TracksTable::TracksTable(OGRLayer *linesLayer, OGRLayer *pointsLayer,
+                         OGRLayer *ovrLayer, ObjectContainer * const parent) :
     FeatureClass(linesLayer, parent, CAT_FC_GPKG, "Tracks"),
     m_lastTrackId(0),
     m_lastSegmentId(0),
@@ -263,8 +636,22 @@ TracksTable::TracksTable(OGRLayer *linesLayer, OGRLayer *pointsLayer, ObjectCont
     m_lastGmtTimeStamp(0),
     m_newTrack(false),
     m_pointCount(0),
-    m_pointsLayer(new TrackPointsTable(pointsLayer, m_parent))
+    m_pointsLayer(new TrackPointsTable(pointsLayer, m_parent)),
+    m_ovrLayer(ovrLayer),
+    m_fixes(FIX_RING_SIZE),
+    m_fixHead(0),
+    m_fixTail(0),
+    m_writerMutex(CPLCreateMutex()),
+    m_writerCond(CPLCreateCond()),
+    m_writerThread(nullptr),
+    m_stopWriter(false),
+    m_wgs84Transform(new CoordinateTransformation(
+                         SpatialReferencePtr::importFromEPSG(4326),
+                         m_spatialReference))
 {
+    // CPLCreateMutex returns acquired mutex
+    CPLReleaseMutex(m_writerMutex);
+
     Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
     TablePtr result = dataset->executeSQL(
                 std::string("SELECT MAX(track_fid) FROM ") + TRACKS_TABLE, "SQLite");
@@ -278,13 +665,17 @@ TracksTable::TracksTable(OGRLayer *linesLayer, OGRLayer *pointsLayer, ObjectCont
 
         if(m_currentTrack) {
             m_pointCount = m_currentTrack->GetFieldAsInteger64("points_count");
+            loadCurrentTrackLines();
         }
     }
 }
 
 TracksTable::~TracksTable()
 {
+    stopWriter();
     flashBuffer();
+    CPLDestroyCond(m_writerCond);
+    CPLDestroyMutex(m_writerMutex);
 }
 
 static long dateFieldToLong(const FeaturePtr &feature, int field,
@@ -313,8 +704,8 @@ bool TracksTable::sync()
 {
     MutexHolder holder(m_syncMutex); // Don't allow simultaneous syncing
     m_pointsLayer->setAttributeFilter("synced = 0");
-    OGRCoordinateTransformation *ct = OGRCreateCoordinateTransformation(
-            m_pointsLayer->spatialReference(), OGRSpatialReference::GetWGS84SRS());
+    CachedTransformation ct(m_pointsLayer->spatialReference(),
+                            TransformationCache::instance().spatialReference(4326));
 
     int timeIndex = -1;
     int eleIndex = -1;
@@ -355,72 +746,81 @@ bool TracksTable::sync()
 
     std::string fid = m_pointsLayer->fidColumn();
 
-    CPLJSONArray *payload = new CPLJSONArray;
+    // Points are written to JSON text directly, without JSON objects tree
+    std::string payload;
+    payload.reserve(TRACKER_MAX_PAYLOAD_SIZE + POINT_JSON_SIZE);
+    int payloadCount = 0;
     FeaturePtr feature;
     std::vector<std::string> updateWhere;
     GIntBig first = std::numeric_limits<GIntBig>::max();
     GIntBig last = 0;
+    bool sendFailed = false;
 
     int maxPointCount = atoi(property("TRACKER_MAX_POINT_COUNT", "100",
                                       NG_ADDITIONS_KEY).c_str());
 
-    while((feature = m_pointsLayer->nextFeature())) {
+    auto sendPayload = [&]() {
+        payload += "]";
+        if(ngw::sendTrackPoints(payload)) {
+            updateWhere.emplace_back(
+                fid + " >= " + std::to_string(first) + " AND " +
+                fid + " <= " + std::to_string(last));
+        }
+        else {
+            sendFailed = true;
+        }
+        payload.clear();
+        payloadCount = 0;
+        first = std::numeric_limits<GIntBig>::max();
+        last = 0;
+    };
+
+    while(!sendFailed && (feature = m_pointsLayer->nextFeature())) {
         OGRGeometry *geom = feature->GetGeometryRef();
         OGRPoint *pt = dynamic_cast<OGRPoint*>(geom);
-        if(pt && pt->transform(ct) == OGRERR_NONE) {
+        if(pt && ct->transform(pt)) {
             if(first > feature->GetFID()) {
                 first = feature->GetFID();
             }
             if(last < feature->GetFID()) {
                 last = feature->GetFID();
             }
-            CPLJSONObject item;
-            item.Add("lt", pt->getY());
-            item.Add("ln", pt->getX());
             GInt64 timestamp = dateFieldToLong(feature, timeIndex, false);
-            item.Add("ts", timestamp);
-            item.Add("a", feature->GetFieldAsDouble(eleIndex));
-            item.Add("s", feature->GetFieldAsInteger(satIndex));
             int fix = compare(feature->GetFieldAsString(fixIndex), "3d", true) ? 3 : 2;
-            item.Add("ft", fix);
-            item.Add("sp", feature->GetFieldAsDouble(speedIndex) * 3.6); // Convert from meters pre second to kilometers per hour
-            item.Add("ha", feature->GetFieldAsDouble(accIndex));
-
-            payload->Add(item);
-
-            if(payload->Size() >= maxPointCount) {
-                if(ngw::sendTrackPoints(payload->Format(CPLJSONObject::Plain))) {
-                    updateWhere.emplace_back(
-                        fid + " >= " + std::to_string(first) + " AND " +
-                        fid + " <= " + std::to_string(last));
-                }
-                delete payload;
-                payload = new CPLJSONArray;
-
-                first = std::numeric_limits<GIntBig>::max();
-                last = 0;
+            payload += payloadCount == 0 ? "[" : ",";
+            payload += CPLSPrintf("{\"lt\":%.8f,\"ln\":%.8f,\"ts\":" CPL_FRMT_GIB
+                                  ",\"a\":%.3f,\"s\":%d,\"ft\":%d,\"sp\":%.3f,\"ha\":%.3f}",
+                                  pt->getY(), pt->getX(), timestamp,
+                                  feature->GetFieldAsDouble(eleIndex),
+                                  feature->GetFieldAsInteger(satIndex), fix,
+                                  feature->GetFieldAsDouble(speedIndex) * 3.6, // Convert from meters pre second to kilometers per hour
+                                  feature->GetFieldAsDouble(accIndex));
+            payloadCount++;
+
+            if(payloadCount >= maxPointCount ||
+                    payload.size() >= TRACKER_MAX_PAYLOAD_SIZE) {
+                sendPayload();
             }
         }
     }
     m_pointsLayer->setAttributeFilter();
-    OGRCoordinateTransformation::DestroyCT(ct);
 
-    if(payload->Size() > 0) {
-        if(ngw::sendTrackPoints(payload->Format(CPLJSONObject::Plain))) {
-            updateWhere.emplace_back(
-                fid + " >= " + std::to_string(first) + " AND " +
-                fid + " <= " + std::to_string(last));
-        }
+    if(!sendFailed && payloadCount > 0) {
+        sendPayload();
     }
-    delete payload;
 
     if(!updateWhere.empty()) {
+        // Mark all sent blocks in one transaction
         Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+        bool transaction = dataset->startTransaction();
         for(const auto &where : updateWhere) {
             dataset->executeSQL(
                         std::string("UPDATE ") + TRACKS_POINTS_TABLE + " SET synced = 1 WHERE " +
             where, "SQLite");
         }
+        if(transaction) {
+            dataset->commitTransaction();
+        }
 
         // Set last sync if we have send something.
         time_t rawTime = std::time(nullptr);
@@ -429,7 +829,7 @@ bool TracksTable::sync()
             setProperty("last_sync", buffer, NG_ADDITIONS_KEY);
         }
     }
-    return true;
+    return !sendFailed;
 }
 
 std::vector<TrackInfo> TracksTable::getTracks()
@@ -461,88 +861,296 @@ std::vector<TrackInfo> TracksTable::getTracks()
     return out;
 }
 
+/**
+ * @brief TracksTable::addPoint Add GPS fix to tracks. The fix is put to the
+ * ring buffer without locks and written to the store by the writer thread, so
+ * the location callback thread is not blocked by store writes.
+ * @return False if the fix was not added.
+ */
 bool TracksTable::addPoint(const std::string &name, double x, double y, double z, float accuracy, float speed,
         float course, long timeStamp, int satCount, bool newTrack, bool newSegment)
 {
-    FeaturePtr feature = m_pointsLayer->createFeature();
-    if(newTrack) {
+    size_t head = m_fixHead.load(std::memory_order_relaxed);
+    size_t next = (head + 1) % FIX_RING_SIZE;
+    if(next == m_fixTail.load(std::memory_order_acquire)) {
+        // Writer is behind, write on caller thread
         if(!flashBuffer()) {
             return false;
         }
+    }
 
-        m_currentTrack = createFeature();
-        m_currentTrack->SetField("track_fid", ++m_lastTrackId);
+    TrackFix &fix = m_fixes[head];
+    fix.x = x;
+    fix.y = y;
+    fix.z = z;
+    fix.accuracy = accuracy;
+    fix.speed = speed;
+    fix.course = course;
+    fix.timeStamp = timeStamp;
+    fix.arrivalTime = time(nullptr);
+    fix.satCount = satCount;
+    fix.newTrack = newTrack;
+    fix.newSegment = newSegment;
+    CPLStrlcpy(fix.name, name.c_str(), sizeof(fix.name));
+    m_fixHead.store(next, std::memory_order_release);
+
+    if(nullptr == m_writerThread) {
+        startWriter();
+    }
 
-        feature->SetField("track_fid", m_lastTrackId);
-        m_lastSegmentId = 0;
-        m_lastSegmentPtId = 0;
+    size_t tail = m_fixTail.load(std::memory_order_relaxed);
+    if((next + FIX_RING_SIZE - tail) % FIX_RING_SIZE >= POINT_BUFFER_SIZE) {
+        // May be lost if writer is busy, it wakes up by timeout then
+        CPLCondSignal(m_writerCond);
+    }
+    return true;
+}
 
-        m_newTrack = true;
-        m_pointCount = 1;
+void TracksTable::startWriter()
+{
+    CPLAcquireMutex(m_writerMutex, 1000.0);
+    if(nullptr == m_writerThread && !m_stopWriter) {
+        m_writerThread = CPLCreateJoinableThread(writerThread, this);
     }
-    else {
-        feature->SetField("track_fid", m_lastTrackId);
-        m_pointCount++;
+    CPLReleaseMutex(m_writerMutex);
+}
+
+void TracksTable::stopWriter()
+{
+    CPLAcquireMutex(m_writerMutex, 1000.0);
+    m_stopWriter = true;
+    CPLJoinableThread *thread = m_writerThread;
+    CPLCondBroadcast(m_writerCond);
+    CPLReleaseMutex(m_writerMutex);
+
+    if(nullptr != thread) {
+        CPLJoinThread(thread);
     }
+    m_writerThread = nullptr;
+}
+
+void TracksTable::writerThread(void *data)
+{
+    TracksTable *table = static_cast<TracksTable*>(data);
+    CPLAcquireMutex(table->m_writerMutex, 1000.0);
+    while(!table->m_stopWriter) {
+        CPLCondTimedWait(table->m_writerCond, table->m_writerMutex,
+                         WRITER_WAKE_PERIOD);
+        if(table->m_stopWriter) {
+            break;
+        }
+
+        size_t head = table->m_fixHead.load(std::memory_order_acquire);
+        size_t tail = table->m_fixTail.load(std::memory_order_relaxed);
+        if((head + FIX_RING_SIZE - tail) % FIX_RING_SIZE < POINT_BUFFER_SIZE) {
+            continue;
+        }
 
-    if(newSegment) {
-        feature->SetField("track_seg_id", ++m_lastSegmentId);
-        m_lastSegmentPtId = 0;
+        CPLReleaseMutex(table->m_writerMutex);
+        table->flashBuffer();
+        CPLAcquireMutex(table->m_writerMutex, 1000.0);
     }
-    else {
-        feature->SetField("track_seg_id", m_lastSegmentId);
+    CPLReleaseMutex(table->m_writerMutex);
+}
+
+static void setDateTimeField(const FeaturePtr &feature, const char *name,
+                             time_t value)
+{
+    std::tm *gmtTime = std::gmtime(&value);
+    feature->SetField(name, gmtTime->tm_year + 1900, gmtTime->tm_mon + 1,
+                      gmtTime->tm_mday, gmtTime->tm_hour, gmtTime->tm_min,
+                      gmtTime->tm_sec);
+}
+
+/**
+ * @brief TracksTable::saveCurrentTrack Write stop time and points count of
+ * current track. The dataset transaction must be started.
+ * @return True on success.
+ */
+bool TracksTable::saveCurrentTrack()
+{
+    if(!m_currentTrack) {
+        return true;
     }
 
-    feature->SetField("track_seg_point_id", ++m_lastSegmentPtId);
+    setDateTimeField(m_currentTrack, "stop_time", m_lastGmtTimeStamp);
+    m_currentTrack->SetField("points_count", m_pointCount);
 
-    feature->SetField("track_name", name.c_str());
-    m_lastGmtTimeStamp = timeStamp;
-	std::time_t lastGMTTS = m_lastGmtTimeStamp;
-    std::tm *gmtTime = std::gmtime(&lastGMTTS);
-    feature->SetField("time", gmtTime->tm_year + 1900, gmtTime->tm_mon + 1, gmtTime->tm_mday, gmtTime->tm_hour,
-            gmtTime->tm_min, gmtTime->tm_sec);
+    bool result;
+    if (m_newTrack) {
+        result = m_layer->CreateFeature(m_currentTrack) == OGRERR_NONE;
+        m_newTrack = false;
+    } else {
+        result = m_layer->SetFeature(m_currentTrack) == OGRERR_NONE;
+    }
 
-    if(newTrack) {
-        m_currentTrack->SetField("track_name", name.c_str());
-        m_currentTrack->SetField("start_time", gmtTime->tm_year + 1900, gmtTime->tm_mon + 1, gmtTime->tm_mday, gmtTime->tm_hour,
-                                 gmtTime->tm_min, gmtTime->tm_sec);
+    for(const auto &line : m_currentTrackLines) {
+        if(!result) {
+            break;
+        }
+        if(line.second->GetFID() == OGRNullFID) {
+            result = m_ovrLayer->CreateFeature(line.second) == OGRERR_NONE;
+        }
+        else {
+            result = m_ovrLayer->SetFeature(line.second) == OGRERR_NONE;
+        }
+    }
+    return result;
+}
 
+/**
+ * @brief TracksTable::loadCurrentTrackLines Read simplified lines of current
+ * track to continue them with new points.
+ */
+void TracksTable::loadCurrentTrackLines()
+{
+    m_currentTrackLines.clear();
+    if(nullptr == m_ovrLayer || !m_currentTrack) {
+        return;
     }
 
-    time_t rawTime;
-    time(&rawTime);
-    gmtTime = std::gmtime(&rawTime);
-    feature->SetField("time_stamp", gmtTime->tm_year + 1900, gmtTime->tm_mon + 1, gmtTime->tm_mday, gmtTime->tm_hour,
-                      gmtTime->tm_min, gmtTime->tm_sec);
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetExecuteSQLLockHolder holder(dataset);
+    m_ovrLayer->SetAttributeFilter(CPLSPrintf("track_fid = %d",
+                                   m_currentTrack->GetFieldAsInteger("track_fid")));
+    m_ovrLayer->ResetReading();
+    OGRFeature *feature;
+    while((feature = m_ovrLayer->GetNextFeature()) != nullptr) {
+        auto zoom = static_cast<unsigned char>(feature->GetFieldAsInteger("zoom"));
+        m_currentTrackLines[zoom] = FeaturePtr(feature);
+    }
+    m_ovrLayer->SetAttributeFilter(nullptr);
+}
 
-    feature->SetField("sat", satCount);
-    feature->SetField("speed", static_cast<double>(speed));
-    feature->SetField("course", static_cast<double>(course));
-    feature->SetField("pdop", static_cast<double>(accuracy));
-    feature->SetField("fix", satCount > 3 ? "3d" : "2d");
-    feature->SetField("ele", z);
-    feature->SetField("desc", NGS_USERAGENT);
-
-    OGRPoint *newPt = new OGRPoint(x, y);
-    newPt->assignSpatialReference(OGRSpatialReference::GetWGS84SRS());
-    newPt->transformTo(m_spatialReference);
-    feature->SetGeometryDirectly(newPt);
-
-    m_bufferMutex.acquire();
-    mPointBuffer.push_back(feature);
-    m_bufferMutex.release();
-    if(mPointBuffer.size() < POINT_BUFFER_SIZE) {
-        return true;
+/**
+ * @brief appendTrackPoint Append point to the last line of track. The last
+ * vertex always follows the newest point and becomes fixed when the point
+ * moves further than tolerance from the previous fixed vertex.
+ */
+static void appendTrackPoint(OGRFeature *feature, double x, double y,
+                             bool newSegment, double tolerance,
+                             OGRSpatialReference *spatialRef)
+{
+    OGRMultiLineString *lines =
+            dynamic_cast<OGRMultiLineString*>(feature->GetGeometryRef());
+    if(nullptr == lines) {
+        lines = new OGRMultiLineString;
+        lines->assignSpatialReference(spatialRef);
+        feature->SetGeometryDirectly(lines);
+    }
+
+    if(newSegment || lines->getNumGeometries() == 0) {
+        lines->addGeometryDirectly(new OGRLineString);
+    }
+
+    OGRLineString *line = static_cast<OGRLineString*>(
+                lines->getGeometryRef(lines->getNumGeometries() - 1));
+    int count = line->getNumPoints();
+    if(count > 1 && tolerance > 0.0) {
+        double dx = x - line->getX(count - 2);
+        double dy = y - line->getY(count - 2);
+        if(dx * dx + dy * dy < tolerance * tolerance) {
+            line->setPoint(count - 1, x, y);
+            return;
+        }
+    }
+    line->addPoint(x, y);
+}
+
+/**
+ * @brief TracksTable::appendToTrackLines Add point to full and simplified
+ * lines of current track.
+ */
+void TracksTable::appendToTrackLines(double x, double y, bool newSegment)
+{
+    if(!m_currentTrack) {
+        return;
+    }
+
+    appendTrackPoint(m_currentTrack.get(), x, y, newSegment, 0.0,
+                     m_spatialReference);
+
+    if(nullptr == m_ovrLayer) {
+        return;
     }
 
-    return flashBuffer();
+    for(auto zoom : TRACK_OVR_ZOOMS) {
+        FeaturePtr &line = m_currentTrackLines[zoom];
+        if(!line) {
+            line = FeaturePtr(OGRFeature::CreateFeature(m_ovrLayer->GetLayerDefn()));
+            line->SetField("track_fid", m_lastTrackId);
+            line->SetField("zoom", zoom);
+        }
+        // One pixel at zoom level
+        double tolerance = DEFAULT_BOUNDS.width() /
+                (TRACK_OVR_TILE_SIZE * std::pow(2.0, zoom));
+        appendTrackPoint(line.get(), x, y, newSegment, tolerance,
+                         m_spatialReference);
+    }
+}
+
+/**
+ * @brief TracksTable::trackLines Get track lines to draw at zoom level. Lines
+ * simplified to one pixel of the nearest overview zoom level are returned, or
+ * full lines if zoom is greater than all overview levels.
+ * @param zoom Map zoom level.
+ * @return Track line features.
+ */
+std::vector<FeaturePtr> TracksTable::trackLines(unsigned char zoom)
+{
+    std::vector<FeaturePtr> out;
+    flashBuffer();
+
+    OGRLayer *layer = m_layer;
+    std::string filter;
+    if(nullptr != m_ovrLayer) {
+        for(auto ovrZoom : TRACK_OVR_ZOOMS) {
+            if(zoom <= ovrZoom) {
+                layer = m_ovrLayer;
+                filter = "zoom = " + std::to_string(ovrZoom);
+                break;
+            }
+        }
+    }
+
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetExecuteSQLLockHolder holder(dataset);
+    layer->SetAttributeFilter(filter.empty() ? nullptr : filter.c_str());
+    layer->ResetReading();
+    OGRFeature *feature;
+    while((feature = layer->GetNextFeature()) != nullptr) {
+        out.emplace_back(FeaturePtr(feature));
+    }
+    layer->SetAttributeFilter(nullptr);
+    return out;
 }
 
 bool TracksTable::flashBuffer()
 {
-    if(mPointBuffer.empty()) {
+    // Several consumers: writer thread, caller thread if ring is full, reads
+    MutexHolder bufferHolder(m_bufferMutex);
+    size_t tail = m_fixTail.load(std::memory_order_relaxed);
+    size_t head = m_fixHead.load(std::memory_order_acquire);
+    if(tail == head) {
         return true; // Nothing to save.
     }
+
+    std::vector<TrackFix> fixes;
+    for(size_t i = tail; i != head; i = (i + 1) % FIX_RING_SIZE) {
+        fixes.push_back(m_fixes[i]);
+    }
+
+    // Transform all coordinates at once
+    std::vector<double> xs, ys;
+    xs.reserve(fixes.size());
+    ys.reserve(fixes.size());
+    for(const auto &fix : fixes) {
+        xs.push_back(fix.x);
+        ys.push_back(fix.y);
+    }
+    m_wgs84Transform->transform(static_cast<int>(fixes.size()), xs.data(),
+                                ys.data());
+
     // Lock all Dataset SQL queries here
     Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
     DatasetExecuteSQLLockHolder holder(dataset);
@@ -554,43 +1162,111 @@ bool TracksTable::flashBuffer()
                             CPLGetLastErrorMsg());
     }
 
-    MutexHolder bufferHolder(m_bufferMutex);
-    for(const auto &bufferedFeature : mPointBuffer) {
-        if (!m_pointsLayer->insertFeature(bufferedFeature, false)) {
-            dataset->rollbackTransaction();
-            return errorMessage(_("flashBuffer failed at insertFeature to points layer. %s"),
-                                CPLGetLastErrorMsg());
-        }
+    // Track state to restore if transaction is rolled back
+    int lastTrackId = m_lastTrackId;
+    int lastSegmentId = m_lastSegmentId;
+    int lastSegmentPtId = m_lastSegmentPtId;
+    FeaturePtr currentTrack = m_currentTrack ?
+                FeaturePtr(m_currentTrack->Clone()) : FeaturePtr();
+    long lastGmtTimeStamp = m_lastGmtTimeStamp;
+    bool newTrack = m_newTrack;
+    GIntBig pointCount = m_pointCount;
+    std::map<unsigned char, FeaturePtr> currentTrackLines;
+    for(const auto &line : m_currentTrackLines) {
+        currentTrackLines[line.first] = FeaturePtr(line.second->Clone());
     }
+    auto rollback = [&]() {
+        dataset->rollbackTransaction();
+        m_lastTrackId = lastTrackId;
+        m_lastSegmentId = lastSegmentId;
+        m_lastSegmentPtId = lastSegmentPtId;
+        m_currentTrack = currentTrack;
+        m_lastGmtTimeStamp = lastGmtTimeStamp;
+        m_newTrack = newTrack;
+        m_pointCount = pointCount;
+        m_currentTrackLines = currentTrackLines;
+    };
+
+    for(size_t i = 0; i < fixes.size(); ++i) {
+        const TrackFix &fix = fixes[i];
+        FeaturePtr feature = m_pointsLayer->createFeature();
+        if(fix.newTrack) {
+            if(!saveCurrentTrack()) {
+                rollback();
+                return errorMessage(_("flashBuffer failed at CreateFeature/SetFeature to tracks layer. %s"),
+                                    CPLGetLastErrorMsg());
+            }
+
+            m_currentTrack = createFeature();
+            m_currentTrack->SetField("track_fid", ++m_lastTrackId);
+            m_currentTrack->SetField("track_name", fix.name);
+            m_currentTrackLines.clear();
+            m_lastSegmentId = 0;
+            m_lastSegmentPtId = 0;
+
+            m_newTrack = true;
+            m_pointCount = 1;
+        }
+        else {
+            m_pointCount++;
+        }
+        feature->SetField("track_fid", m_lastTrackId);
+
+        if(fix.newSegment) {
+            feature->SetField("track_seg_id", ++m_lastSegmentId);
+            m_lastSegmentPtId = 0;
+        }
+        else {
+            feature->SetField("track_seg_id", m_lastSegmentId);
+        }
 
-    if(m_currentTrack) {
-        // Update stop_time in tracks table
-	    std::time_t lastGMTTS = m_lastGmtTimeStamp;
-        std::tm *gmtTime = std::gmtime(&lastGMTTS);
-        m_currentTrack->SetField("stop_time", gmtTime->tm_year + 1900, gmtTime->tm_mon + 1,
-                                 gmtTime->tm_mday, gmtTime->tm_hour,
-                                 gmtTime->tm_min, gmtTime->tm_sec);
-        m_currentTrack->SetField("points_count", m_pointCount);
+        feature->SetField("track_seg_point_id", ++m_lastSegmentPtId);
 
-        bool createUpdateResult;
-        if (m_newTrack) {
-            createUpdateResult = m_layer->CreateFeature(m_currentTrack) == OGRERR_NONE;
-            m_newTrack = false;
-        } else {
-            createUpdateResult = m_layer->SetFeature(m_currentTrack) == OGRERR_NONE;
+        feature->SetField("track_name", fix.name);
+        m_lastGmtTimeStamp = fix.timeStamp;
+        setDateTimeField(feature, "time", m_lastGmtTimeStamp);
+        if(fix.newTrack) {
+            setDateTimeField(m_currentTrack, "start_time", m_lastGmtTimeStamp);
         }
+        setDateTimeField(feature, "time_stamp", fix.arrivalTime);
+        feature->SetField("time_stamp_epoch", static_cast<GIntBig>(fix.arrivalTime));
 
-        if (!createUpdateResult) {
-            dataset->rollbackTransaction();
-            return errorMessage(_("flashBuffer failed at CreateFeature/SetFeature to tracks layer. %s"),
+        feature->SetField("sat", fix.satCount);
+        feature->SetField("speed", static_cast<double>(fix.speed));
+        feature->SetField("course", static_cast<double>(fix.course));
+        feature->SetField("pdop", static_cast<double>(fix.accuracy));
+        feature->SetField("fix", fix.satCount > 3 ? "3d" : "2d");
+        feature->SetField("ele", fix.z);
+        feature->SetField("desc", NGS_USERAGENT);
+
+        OGRPoint *newPt = new OGRPoint(xs[i], ys[i]);
+        newPt->assignSpatialReference(m_spatialReference);
+        feature->SetGeometryDirectly(newPt);
+
+        appendToTrackLines(xs[i], ys[i], fix.newTrack || fix.newSegment);
+
+        if (!m_pointsLayer->insertFeature(feature, false)) {
+            rollback();
+            return errorMessage(_("flashBuffer failed at insertFeature to points layer. %s"),
                                 CPLGetLastErrorMsg());
         }
     }
 
+    if (!saveCurrentTrack()) {
+        rollback();
+        return errorMessage(_("flashBuffer failed at CreateFeature/SetFeature to tracks layer. %s"),
+                            CPLGetLastErrorMsg());
+    }
+
     if(dataset->commitTransaction()) {
-        mPointBuffer.clear();
+        m_fixTail.store(head, std::memory_order_release);
+        DataStore *dataStore = dynamic_cast<DataStore*>(dataset);
+        if(nullptr != dataStore) {
+            dataStore->checkpoint();
+        }
         return true;
     }
+    rollback();
     return errorMessage(_("flashBuffer failed at commitTransaction. %s"),
                         CPLGetLastErrorMsg());
 }
@@ -606,6 +1282,8 @@ static std::string longToISO(long timeStamp)
 
 void TracksTable::deletePoints(long start, long end)
 {
+    // Keep writer thread away while track state is changed
+    MutexHolder bufferHolder(m_bufferMutex);
     flashBuffer();
 
     resetError();
@@ -613,10 +1291,14 @@ void TracksTable::deletePoints(long start, long end)
     if(dataset->startTransaction()) {
         std::string startStr = longToISO(start);
         std::string stopStr = longToISO(end);
+        // Indexed range delete
         dataset->executeSQL(std::string("DELETE FROM ") + TRACKS_POINTS_TABLE +
-        " WHERE time_stamp >= '" + startStr + "' AND time_stamp <= '" + stopStr + "'", "SQLite");
+        " WHERE time_stamp_epoch >= " + std::to_string(start) +
+        " AND time_stamp_epoch <= " + std::to_string(end), "SQLite");
         dataset->executeSQL(std::string("DELETE FROM ") + TRACKS_TABLE + " WHERE start_time >= '" +
         startStr + "' AND stop_time <= '" + stopStr + "'", "SQLite");
+        dataset->executeSQL(std::string("DELETE FROM ") + TRACKS_OVR_TABLE +
+        " WHERE track_fid NOT IN (SELECT track_fid FROM " + TRACKS_TABLE + ")", "SQLite");
 
         setAttributeFilter("(stop_time <= " +  startStr + " AND start_time >= " + startStr +
         ") OR (start_time >= " + stopStr + " AND stop_time <= " + stopStr + ")");
@@ -625,26 +1307,16 @@ void TracksTable::deletePoints(long start, long end)
         while ((feature = m_layer->GetNextFeature())) {
             std::string track_fid = feature->GetFieldAsString("track_fid");
 
-            TablePtr result = dataset->executeSQL(std::string("SELECT count(*), MAX(time_stamp), MIN(time_stamp) FROM ") +
+            TablePtr result = dataset->executeSQL(std::string("SELECT count(*), MAX(time_stamp_epoch), MIN(time_stamp_epoch) FROM ") +
                     TRACKS_POINTS_TABLE + " WHERE track_fid = " + track_fid, "SQLite");
             FeaturePtr countFeature = result->nextFeature();
             GIntBig count = countFeature->GetFieldAsInteger64(0);
             feature->SetField("points_count", count);
 
-            std::string maxTS = countFeature->GetFieldAsString(1);
-            std::string minTS = countFeature->GetFieldAsString(2);
-
-            int year = 0;
-            int month = 0;
-            int day = 0;
-            int hour = 0;
-            int minute = 0;
-            int second = 0;
-            sscanf(minTS.c_str(), "%d-%d-%dT%d:%d:%dZ", &year, &month, &day, &hour, &minute, &second);
-            feature->SetField("start_time", year, month, day, hour, minute, second);
-
-            sscanf(maxTS.c_str(), "%d-%d-%dT%d:%d:%dZ", &year, &month, &day, &hour, &minute, &second);
-            feature->SetField("stop_time", year, month, day, hour, minute, second);
+            setDateTimeField(feature, "stop_time",
+                             static_cast<time_t>(countFeature->GetFieldAsInteger64(1)));
+            setDateTimeField(feature, "start_time",
+                             static_cast<time_t>(countFeature->GetFieldAsInteger64(2)));
 
             if(m_layer->SetFeature(feature) != OGRERR_NONE) {
                 warningMessage(_("Update feature failed"));
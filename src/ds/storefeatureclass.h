@@ -21,6 +21,10 @@
 #ifndef NGSSTOREFEATURECLASS_H
 #define NGSSTOREFEATURECLASS_H
 
+// stl
+#include <atomic>
+#include <map>
+
 #include "store.h"
 #include "featureclassovr.h"
 #include "dataset.h"
@@ -39,6 +43,7 @@ public:
 
     // Table interface
 public:
+    virtual FeaturePtr createFeature() const override;
     virtual GIntBig addAttachment(GIntBig fid, const std::string &fileName,
                                   const std::string &description,
                                   const std::string &filePath,
@@ -47,11 +52,18 @@ public:
     virtual bool setProperty(const std::string &key, const std::string &value,
                              const std::string &domain) override;
     virtual std::vector<ngsEditOperation> editOperations() override;
+    virtual bool createIndex(const std::string &field) override;
+    virtual bool dropIndex(const std::string &field) override;
 
     // Table interface
 protected:
     virtual FeaturePtr logEditFeature(FeaturePtr feature, FeaturePtr attachFeature,
                                       enum ngsChangeCode code) override;
+    virtual void onFeatureInserted(FeaturePtr feature) override;
+    virtual void onFeatureUpdated(FeaturePtr oldFeature,
+                                  FeaturePtr newFeature) override;
+    virtual void onFeatureDeleted(FeaturePtr delFeature) override;
+    virtual void onFeaturesDeleted() override;
 
 protected:
     virtual void fillFields() const override;
@@ -66,9 +78,20 @@ public:
     StoreFeatureClass(OGRLayer *layer, ObjectContainer * const parent = nullptr,
                       const std::string &name = "");
     virtual ~StoreFeatureClass() override = default;
+    bool createSearchIndex(const std::vector<std::string> &fields,
+                           const std::string &lang = "");
+    bool dropSearchIndex();
+    bool hasSearchIndex() const;
+    std::vector<GIntBig> search(const std::string &query, int offset = 0,
+                                int limit = 100) const;
+
+    // Object interface
+public:
+    virtual bool destroy() override;
 
     // Table interface
 public:
+    virtual FeaturePtr createFeature() const override;
     virtual GIntBig addAttachment(GIntBig fid, const std::string &fileName,
                                   const std::string &description,
                                   const std::string &filePath,
@@ -77,14 +100,43 @@ public:
     virtual bool setProperty(const std::string &key, const std::string &value,
                              const std::string &domain) override;
     virtual std::vector<ngsEditOperation> editOperations() override;
+    virtual bool createIndex(const std::string &field) override;
+    virtual bool dropIndex(const std::string &field) override;
+
+    // FeatureClass interface
+public:
+    virtual int copyFeatures(const FeatureClassPtr srcFClass,
+                             const FieldMapPtr fieldMap,
+                             OGRwkbGeometryType filterGeomType,
+                             const Progress &progress = Progress(),
+                             const Options &options = Options()) override;
 
     // Table interface
 protected:
     virtual FeaturePtr logEditFeature(FeaturePtr feature, FeaturePtr attachFeature,
                                       enum ngsChangeCode code) override;
+    virtual void onFeatureInserted(FeaturePtr feature) override;
+    virtual void onFeatureUpdated(FeaturePtr oldFeature,
+                                  FeaturePtr newFeature) override;
+    virtual void onFeatureDeleted(FeaturePtr delFeature) override;
+    virtual void onFeaturesDeleted() override;
+
+    // FeatureClass interface
+protected:
+    virtual bool recomputeExtent(Envelope &extent) const override;
 
 protected:
     virtual void fillFields() const override;
+    void loadSearchFields() const;
+    std::string searchText(const FeaturePtr &feature) const;
+    void updateSearchText(const FeaturePtr &feature);
+
+private:
+    // Search index fields and normalize language read from properties
+    mutable Mutex m_searchMutex;
+    mutable bool m_searchLoaded;
+    mutable std::vector<std::string> m_searchFields;
+    mutable std::string m_searchLang;
 };
 
 /**
@@ -109,10 +161,27 @@ public:
     virtual ObjectPtr pointer() const override;
 };
 
+constexpr size_t FIX_RING_SIZE = 1024;
+constexpr size_t TRACK_NAME_SIZE = 256;
+
+/**
+ * @brief The TrackFix struct GPS fix waiting in ring buffer to be written
+ */
+typedef struct _trackFix {
+    double x, y, z;
+    float accuracy, speed, course;
+    long timeStamp;
+    time_t arrivalTime;
+    int satCount;
+    bool newTrack, newSegment;
+    char name[TRACK_NAME_SIZE];
+} TrackFix;
+
 class TracksTable : public FeatureClass
 {
 public:
-    TracksTable(OGRLayer *linesLayer, OGRLayer *pointsLayer, ObjectContainer * const parent = nullptr);
+    TracksTable(OGRLayer *linesLayer, OGRLayer *pointsLayer, OGRLayer *ovrLayer,
+                ObjectContainer * const parent = nullptr);
     virtual ~TracksTable() override;
 
     virtual bool sync() override;
@@ -121,6 +190,7 @@ public:
             long timeStamp, int satCount, bool newTrack, bool newSegment);
     void deletePoints(long start, long end);
     ObjectPtr getPointsLayer() const;
+    std::vector<FeaturePtr> trackLines(unsigned char zoom);
 
     // Object interface
 public:
@@ -133,18 +203,34 @@ public:
 
 private:
     bool flashBuffer();
+    bool saveCurrentTrack();
+    void loadCurrentTrackLines();
+    void appendToTrackLines(double x, double y, bool newSegment);
+    void startWriter();
+    void stopWriter();
+    static void writerThread(void *data);
 
 private:
     int m_lastTrackId;
     int m_lastSegmentId;
     int m_lastSegmentPtId;
     Mutex m_syncMutex, m_bufferMutex;
-    std::vector<FeaturePtr> mPointBuffer;
     FeaturePtr m_currentTrack;
     long m_lastGmtTimeStamp;
     bool m_newTrack;
     GIntBig m_pointCount;
     FeatureClassPtr m_pointsLayer;
+    OGRLayer *m_ovrLayer;
+    // Simplified lines of current track by zoom level
+    std::map<unsigned char, FeaturePtr> m_currentTrackLines;
+    // Single producer ring buffer, head is moved by addPoint, tail by writer
+    std::vector<TrackFix> m_fixes;
+    std::atomic<size_t> m_fixHead, m_fixTail;
+    CPLMutex *m_writerMutex;
+    CPLCond *m_writerCond;
+    CPLJoinableThread *m_writerThread;
+    bool m_stopWriter;
+    std::unique_ptr<CoordinateTransformation> m_wgs84Transform;
 };
 
 } // namespace ngs
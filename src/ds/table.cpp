@@ -20,17 +20,183 @@
  ****************************************************************************/
 #include "table.h"
 
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+
 #include "api_priv.h"
+#include "copypipeline.h"
 #include "dataset.h"
+#include "tablecursor.h"
 #include "catalog/file.h"
 #include "catalog/folder.h"
 #include "ngstore/api.h"
+#include "util/buffer.h"
 #include "util/error.h"
+#include "util/hash.h"
 #include "util/notify.h"
+#include "util/trace.h"
 
 namespace ngs {
 
 constexpr const char *FEATURE_SEPARATOR = "#";
+constexpr size_t MAX_POOLED_FEATURE_BLOCKS = 4096;
+constexpr size_t FEATURE_BLOCK_BATCH = 64;
+constexpr size_t MAX_CHANGE_RANGES = 4096;
+
+//------------------------------------------------------------------------------
+// FeatureBlockPool
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The FeatureBlockPool class Free list of shared pointer control blocks.
+ * All pooled features have the same control block type, so blocks of this size
+ * are reused and other sizes go to the heap. Each thread keeps own free list
+ * and exchanges blocks with the shared one in batches of FEATURE_BLOCK_BATCH,
+ * so the lock is not taken on each feature.
+ */
+class FeatureBlockPool
+{
+public:
+    static void *allocate(size_t size) {
+        FeatureBlockPool &pool = *instance();
+        size_t blockSize = 0;
+        pool.m_blockSize.compare_exchange_strong(blockSize, size);
+        if(blockSize != 0 && blockSize != size) {
+            return ::operator new(size);
+        }
+
+        if(tLocalBlocksClosed) {
+            void *block = nullptr;
+            pool.take(&block, 1);
+            return nullptr == block ? ::operator new(size) : block;
+        }
+
+        LocalBlocks &local = localBlocks();
+        if(local.blocks.empty()) {
+            local.blocks.resize(FEATURE_BLOCK_BATCH);
+            local.blocks.resize(pool.take(local.blocks.data(),
+                                          FEATURE_BLOCK_BATCH));
+            if(local.blocks.empty()) {
+                return ::operator new(size);
+            }
+        }
+        void *block = local.blocks.back();
+        local.blocks.pop_back();
+        return block;
+    }
+
+    static void deallocate(void *block, size_t size) {
+        FeatureBlockPool &pool = *instance();
+        if(pool.m_blockSize != size) {
+            ::operator delete(block);
+            return;
+        }
+
+        if(tLocalBlocksClosed) {
+            pool.give(&block, 1);
+            return;
+        }
+
+        LocalBlocks &local = localBlocks();
+        local.blocks.push_back(block);
+        if(local.blocks.size() >= 2 * FEATURE_BLOCK_BATCH) {
+            size_t keep = local.blocks.size() - FEATURE_BLOCK_BATCH;
+            pool.give(local.blocks.data() + keep, FEATURE_BLOCK_BATCH);
+            local.blocks.resize(keep);
+        }
+    }
+
+private:
+    FeatureBlockPool() : m_blockSize(0) {}
+
+    // Never destroyed as features may outlive static objects on exit.
+    static FeatureBlockPool *instance() {
+        static FeatureBlockPool *pool = new FeatureBlockPool;
+        return pool;
+    }
+
+    /**
+     * @brief The LocalBlocks struct Free list of the thread. Blocks are
+     * returned to the shared list on thread exit.
+     */
+    typedef struct _localBlocks {
+        std::vector<void*> blocks;
+        ~_localBlocks() {
+            tLocalBlocksClosed = true;
+            instance()->give(blocks.data(), blocks.size());
+        }
+    } LocalBlocks;
+
+    static LocalBlocks &localBlocks() {
+        static thread_local LocalBlocks local;
+        return local;
+    }
+
+    size_t take(void **blocks, size_t count) {
+        MutexHolder holder(m_mutex);
+        count = std::min(count, m_blocks.size());
+        std::copy(m_blocks.end() - static_cast<std::ptrdiff_t>(count),
+                  m_blocks.end(), blocks);
+        m_blocks.resize(m_blocks.size() - count);
+        return count;
+    }
+
+    void give(void **blocks, size_t count) {
+        size_t pooled = 0;
+        {
+            MutexHolder holder(m_mutex);
+            pooled = std::min(count, MAX_POOLED_FEATURE_BLOCKS - m_blocks.size());
+            m_blocks.insert(m_blocks.end(), blocks, blocks + pooled);
+        }
+        for(size_t i = pooled; i < count; ++i) {
+            ::operator delete(blocks[i]);
+        }
+    }
+
+private:
+    Mutex m_mutex;
+    std::vector<void*> m_blocks;
+    std::atomic<size_t> m_blockSize;
+    // Features freed by other thread local objects after the list is destroyed
+    // go to the shared list directly
+    static thread_local bool tLocalBlocksClosed;
+};
+
+thread_local bool FeatureBlockPool::tLocalBlocksClosed = false;
+
+template<class T>
+class FeatureBlockAllocator
+{
+public:
+    typedef T value_type;
+
+    FeatureBlockAllocator() {}
+    template<class U>
+    FeatureBlockAllocator(const FeatureBlockAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T*>(FeatureBlockPool::allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T *p, size_t n) {
+        FeatureBlockPool::deallocate(p, sizeof(T) * n);
+    }
+};
+
+template<class T, class U>
+bool operator==(const FeatureBlockAllocator<T> &, const FeatureBlockAllocator<U> &)
+{
+    return true;
+}
+
+template<class T, class U>
+bool operator!=(const FeatureBlockAllocator<T> &, const FeatureBlockAllocator<U> &)
+{
+    return false;
+}
 
 
 //------------------------------------------------------------------------------
@@ -97,6 +263,14 @@ FeaturePtr::FeaturePtr(OGRFeature *feature, const Table *table) :
 
 }
 
+FeaturePtr::FeaturePtr(std::shared_ptr<OGRFeature> &&feature,
+                       const Table *table) :
+    shared_ptr(std::move(feature)),
+    m_table(const_cast<Table*>(table))
+{
+
+}
+
 FeaturePtr:: FeaturePtr() :
     shared_ptr( nullptr, OGRFeature::DestroyFeature ),
     m_table(nullptr)
@@ -109,18 +283,49 @@ FeaturePtr &FeaturePtr::operator=(OGRFeature *feature) {
     return *this;
 }
 
+/**
+ * @brief FeaturePtr::pooled Wrap feature using the pooled control block. Use
+ * for table scans where a feature is created for each row.
+ * @param feature Feature to wrap. May be nullptr.
+ * @param table Feature table.
+ * @return FeaturePtr instance.
+ */
+FeaturePtr FeaturePtr::pooled(OGRFeature *feature, const Table *table)
+{
+    if(nullptr == feature) {
+        return FeaturePtr();
+    }
+    return FeaturePtr(std::shared_ptr<OGRFeature>(feature,
+        OGRFeature::DestroyFeature, FeatureBlockAllocator<OGRFeature>()), table);
+}
+
 ngs::FeaturePtr::operator OGRFeature *() const
 {
      return get();
 }
 
-std::string FeaturePtr::dump(FeaturePtr::DumpOutputType type) const
+/**
+ * @brief FeaturePtr::dump Dump feature geometry, fields and style to string or
+ * hash.
+ * @param type Output type.
+ * @param hashVersion Hash algorithm version. Hash of version 0 is md5 of
+ * simple dump string. Use version of stored hash to compare with it.
+ * @return Dump string or hash.
+ */
+std::string FeaturePtr::dump(FeaturePtr::DumpOutputType type,
+                             unsigned char hashVersion) const
 {
+    if(type != DumpOutputType::SIMPLE && hashVersion > 0) {
+        return fingerprint(type);
+    }
+
     std::string out;
     if(nullptr != get()) {
         OGRGeometry *geom = get()->GetGeometryRef();
         char *wkt = nullptr;
-        geom->exportToWkt(&wkt, wkbVariantIso);
+        if(nullptr != geom) {
+            geom->exportToWkt(&wkt, wkbVariantIso);
+        }
         if(wkt) {
             out += std::string(wkt);
         }
@@ -165,6 +370,112 @@ std::string FeaturePtr::dump(FeaturePtr::DumpOutputType type) const
     }
 }
 
+/**
+ * @brief FeaturePtr::hashVersion Get algorithm version of feature hash.
+ * @param hash Hash from dump.
+ * @return Version number. Hashes without version prefix are md5 (version 0).
+ */
+unsigned char FeaturePtr::hashVersion(const std::string &hash)
+{
+    auto pos = hash.find(':');
+    if(pos == std::string::npos || pos == 0) {
+        return 0;
+    }
+    return static_cast<unsigned char>(atoi(hash.substr(0, pos).c_str()));
+}
+
+/**
+ * @brief FeaturePtr::fingerprint Hash feature in one pass. Geometry WKB and
+ * field raw values are hashed without building intermediate string.
+ * @param type Hash type.
+ * @return Versioned hash string.
+ */
+std::string FeaturePtr::fingerprint(FeaturePtr::DumpOutputType type) const
+{
+    Hash64 hash;
+    OGRFeature *feature = get();
+    if(nullptr != feature) {
+        OGRGeometry *geom = feature->GetGeometryRef();
+        if(nullptr != geom) {
+            std::vector<unsigned char> wkb(static_cast<size_t>(geom->WkbSize()));
+            if(!wkb.empty() && geom->exportToWkb(wkbNDR, wkb.data(),
+                                                 wkbVariantIso) == OGRERR_NONE) {
+                hash.update(wkb.data(), wkb.size());
+            }
+        }
+
+        const char *style = nullptr;
+        int styleFieldId = -1;
+        if(type == DumpOutputType::HASH_STYLE) {
+            styleFieldId = feature->GetFieldIndex("ogr_style");
+        }
+
+        for(int i = 0; i < feature->GetFieldCount(); ++i) {
+            if(i == styleFieldId) {
+                style = feature->GetFieldAsString(i);
+                continue;
+            }
+
+            // Field separator and null flag
+            if(!feature->IsFieldSetAndNotNull(i)) {
+                hash.update(static_cast<GUInt64>(0));
+                continue;
+            }
+            hash.update(static_cast<GUInt64>(1));
+
+            OGRField *field = feature->GetRawFieldRef(i);
+            switch(feature->GetFieldDefnRef(i)->GetType()) {
+            case OFTInteger:
+                hash.update(static_cast<GUInt64>(field->Integer));
+                break;
+            case OFTInteger64:
+                hash.update(static_cast<GUInt64>(field->Integer64));
+                break;
+            case OFTReal:
+            {
+                GUInt64 value;
+                std::memcpy(&value, &field->Real, sizeof(value));
+                hash.update(value);
+                break;
+            }
+            case OFTString:
+            {
+                size_t size = std::strlen(field->String);
+                hash.update(static_cast<GUInt64>(size));
+                hash.update(field->String, size);
+                break;
+            }
+            case OFTBinary:
+                hash.update(static_cast<GUInt64>(field->Binary.nCount));
+                hash.update(field->Binary.paData,
+                            static_cast<size_t>(field->Binary.nCount));
+                break;
+            default:
+            {
+                std::string value = feature->GetFieldAsString(i);
+                hash.update(static_cast<GUInt64>(value.size()));
+                hash.update(value);
+                break;
+            }
+            }
+        }
+
+        if(type != DumpOutputType::HASH) {
+            style = feature->GetStyleString();
+            if(type != DumpOutputType::HASH_STYLE) {
+                const char *native = feature->GetNativeData();
+                if(native) {
+                    hash.update(std::string(native));
+                }
+            }
+        }
+        if(style) {
+            hash.update(std::string(style));
+        }
+    }
+    return std::to_string(FEATURE_HASH_VERSION) + ":" + hash.hexDigest();
+}
+
 GIntBig FeaturePtr::addAttachment(const std::string &fileName,
                                   const std::string &description,
                                   const std::string &filePath,
@@ -238,6 +549,102 @@ void FeaturePtr::setTable(Table *table)
     m_table = table;
 }
 
+//------------------------------------------------------------------------------
+// ChangeJournal
+//------------------------------------------------------------------------------
+
+GUIntBig ChangeJournal::sequence() const
+{
+    MutexHolder holder(m_mutex);
+    return m_sequence;
+}
+
+/**
+ * @brief ChangeJournal::add Add feature change. The change extends the last
+ * range if it has the same operation and the feature is in or next to it.
+ * @param fid Feature identifier.
+ * @param code Change operation.
+ * @param extent Changed geometries extent. May be not initialized.
+ */
+void ChangeJournal::add(GIntBig fid, enum ngsChangeCode code,
+                        const Envelope &extent)
+{
+    MutexHolder holder(m_mutex);
+    ++m_sequence;
+    if(!m_ranges.empty()) {
+        ChangeRange &last = m_ranges.back();
+        if(last.code == code && fid >= last.fromFid && fid <= last.toFid + 1) {
+            last.sequence = m_sequence;
+            last.toFid = std::max(last.toFid, fid);
+            if(extent.isInit()) {
+                last.extent.merge(extent);
+            }
+            return;
+        }
+    }
+
+    m_ranges.push_back({m_sequence, fid, fid, code, extent});
+    if(m_ranges.size() > MAX_CHANGE_RANGES) {
+        m_firstSequence = m_ranges.front().sequence + 1;
+        m_ranges.pop_front();
+    }
+}
+
+/**
+ * @brief ChangeJournal::addAll Add change of all features. Previous changes
+ * are dropped, they are covered by this one.
+ * @param code Change operation.
+ */
+void ChangeJournal::addAll(enum ngsChangeCode code)
+{
+    MutexHolder holder(m_mutex);
+    ++m_sequence;
+    m_ranges.clear();
+    m_ranges.push_back({m_sequence, NOT_FOUND, NOT_FOUND, code, Envelope()});
+    m_firstSequence = m_sequence;
+}
+
+/**
+ * @brief ChangeJournal::changesSince Get changes made after the sequence
+ * number. Ranges changed after the sequence may also have older changes.
+ * @param sequence Sequence number the consumer is up to date with.
+ * @param changes Output ranges ordered by sequence number.
+ * @return False if the journal has no changes that old and the consumer has
+ * to refresh everything.
+ */
+bool ChangeJournal::changesSince(GUIntBig sequence,
+                                 std::vector<ChangeRange> &changes) const
+{
+    MutexHolder holder(m_mutex);
+    changes.clear();
+    if(sequence + 1 < m_firstSequence) {
+        return false;
+    }
+    for(const ChangeRange &range : m_ranges) {
+        if(range.sequence > sequence) {
+            changes.push_back(range);
+        }
+    }
+    return true;
+}
+
+static Envelope featureExtent(const OGRFeature *feature)
+{
+    Envelope out;
+    if(nullptr == feature) {
+        return out;
+    }
+    for(int i = 0; i < feature->GetGeomFieldCount(); ++i) {
+        const OGRGeometry *geom = feature->GetGeomFieldRef(i);
+        if(nullptr != geom && !geom->IsEmpty()) {
+            OGREnvelope env;
+            geom->getEnvelope(&env);
+            out.merge(Envelope(env));
+        }
+    }
+    return out;
+}
+
 //------------------------------------------------------------------------------
 // Table
 //------------------------------------------------------------------------------
@@ -249,7 +656,12 @@ Table::Table(OGRLayer *layer,
     Object(parent, type, name, ""),
     m_layer(layer),
     m_attTable(nullptr),
-    m_editHistoryTable(nullptr)
+    m_editHistoryTable(nullptr),
+    m_deleteAllLogged(true),
+    m_cacheFeatureCount(false),
+    m_featureCount(-1),
+    m_attributeFilter(false),
+    m_spatialFilter(false)
 {
 }
 
@@ -307,6 +719,8 @@ bool Table::insertFeature(const FeaturePtr &feature, bool logEdits)
                                                   CC_CREATE_FEATURE);
             logEditOperation(opFeature);
         }
+        m_changes.add(feature->GetFID(), CC_CREATE_FEATURE,
+                      featureExtent(feature.get()));
         if(dataset && !dataset->isBatchOperation()) {
             Notify::instance().onNotify(fullName() + FEATURE_SEPARATOR +
                                         std::to_string(feature->GetFID()),
@@ -338,6 +752,9 @@ bool Table::updateFeature(const FeaturePtr &feature, bool logEdits)
                                                   CC_CHANGE_FEATURE);
             logEditOperation(opFeature);
         }
+        Envelope extent = featureExtent(oldFeature.get());
+        extent.merge(featureExtent(feature.get()));
+        m_changes.add(id, CC_CHANGE_FEATURE, extent);
         if(dataset && !dataset->isBatchOperation()) {
             Notify::instance().onNotify(fullName() + FEATURE_SEPARATOR +
                                         std::to_string(feature->GetFID()),
@@ -373,6 +790,7 @@ bool Table::deleteFeature(GIntBig id, bool logEdits)
         if(logEdits && saveEditHistory()) {
             logEditOperation(logFeature);
         }
+        m_changes.add(id, CC_DELETE_FEATURE, featureExtent(delFeature.get()));
         Notify::instance().onNotify(fullName() + FEATURE_SEPARATOR +
                                     std::to_string(id),
                                     ngsChangeCode::CC_DELETE_FEATURE);
@@ -397,12 +815,12 @@ bool Table::deleteFeatures(bool logEdits)
                                                    CC_DELETEALL_FEATURES);
             logEditOperation(logFeature);
         }
+        m_changes.addAll(CC_DELETEALL_FEATURES);
         Notify::instance().onNotify(fullName(),
                                     ngsChangeCode::CC_DELETEALL_FEATURES);
         dataset->destroyAttachmentsTable(storeName()); // Attachments table maybe not exists
         Folder::rmDir(getAttachmentsPath());
 
-        featureCount(true);
         onFeaturesDeleted();
         return true;
     }
@@ -410,20 +828,42 @@ bool Table::deleteFeatures(bool logEdits)
     return false;
 }
 
+/**
+ * @brief Table::featureCount Returns feature count. Stores keep the count of
+ * all features updated on edit, so without filters it is returned without
+ * layer access.
+ * @param force Count features if driver has no fast count.
+ * @return Feature count.
+ */
 GIntBig Table::featureCount(bool force) const
 {
     if(nullptr == m_layer) {
         return 0;
     }
 
+    bool filtered = m_attributeFilter || m_spatialFilter;
+    GIntBig count = m_featureCount;
+    if(count >= 0 && !force && !filtered) {
+        return count;
+    }
+
     MutexHolder holder(m_featureMutex);
-    return m_layer->GetFeatureCount(force ? TRUE : FALSE);
+    count = m_layer->GetFeatureCount(force ? TRUE : FALSE);
+    if(m_cacheFeatureCount && !filtered) {
+        m_featureCount = count;
+    }
+    return count;
 }
 
 void Table::reset() const
 {
     if(nullptr != m_layer) {
         MutexHolder holder(m_featureMutex);
+        if(!m_columnFields.empty()) {
+            m_layer->SetIgnoredFields(nullptr);
+            m_columnFields.clear();
+        }
+        m_pageFeature = FeaturePtr();
         m_layer->ResetReading();
     }
 }
@@ -434,12 +874,279 @@ FeaturePtr Table::nextFeature() const
         return FeaturePtr();
     }
     MutexHolder holder(m_featureMutex);
-    return FeaturePtr(m_layer->GetNextFeature(), this);
+    return FeaturePtr::pooled(m_layer->GetNextFeature(), this);
+}
+
+/**
+ * @brief Table::cursor Create independent read cursor. Cursor reads from the
+ * dataset read connections pool or from its own dataset connection if the pool
+ * has no free connections.
+ * @param filter Attribute filter in OGR SQL WHERE syntax or empty string.
+ * @param spatialFilter Features which envelopes intersect this extent are
+ * read. Not initialized envelope means no filter.
+ * @param fields Attribute fields to read, others are ignored. All fields are
+ * read if empty. Geometry is read if table has it.
+ * @return Cursor or empty pointer on error.
+ */
+TableCursorPtr Table::cursor(const std::string &filter,
+                             const Envelope &spatialFilter,
+                             const std::vector<std::string> &fields) const
+{
+    if(nullptr == m_layer) {
+        return TableCursorPtr();
+    }
+    TableCursorPtr out(new TableCursor(this));
+    if(!out->open(filter, spatialFilter, fields)) {
+        return TableCursorPtr();
+    }
+    return out;
+}
+
+/**
+ * @brief Table::forEachFeature Scan all table features from the first one.
+ * The feature mutex is not held while the function runs.
+ * @param func Function to call for each feature. Return false to stop scan.
+ * @return True if all features were scanned.
+ */
+bool Table::forEachFeature(
+        const std::function<bool(const FeaturePtr &feature)> &func) const
+{
+    if(nullptr == m_layer) {
+        return false;
+    }
+    reset();
+    FeaturePtr feature;
+    while((feature = nextFeature())) {
+        if(!func(feature)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Table::setIgnoredFields(const std::vector<std::string> &fields)
+{
+    if(nullptr == m_layer) {
+        return false;
+    }
+    if(fields.empty()) {
+        return m_layer->SetIgnoredFields(nullptr) == OGRERR_NONE;
+    }
+
+    char** ignoreFields = nullptr;
+    for(const std::string &fieldName : fields) {
+        ignoreFields = CSLAddString(ignoreFields, fieldName.c_str());
+    }
+    bool result = m_layer->SetIgnoredFields(
+                const_cast<const char**>(ignoreFields)) == OGRERR_NONE;
+    CSLDestroy(ignoreFields);
+    return result;
+}
+
+/**
+ * @brief Table::readColumns Read next rows into caller provided columns. Only
+ * requested fields are fetched, geometry and other fields are ignored until
+ * reset(). If set of fields differs from previous call, reading starts from the
+ * first row.
+ * @param fids Array of maxCount items for feature identifiers or nullptr.
+ * @param columns Columns to fill.
+ * @param columnCount Columns count.
+ * @param maxCount Max rows count to read.
+ * @return Count of read rows, 0 if there are no more rows or -1 on error.
+ * String values are valid until next call or reset().
+ */
+int Table::readColumns(long long *fids, ngsFieldColumn *columns,
+                       int columnCount, int maxCount)
+{
+    if(nullptr == m_layer) {
+        errorMessage(_("Table is not initialized"));
+        return -1;
+    }
+
+    if(maxCount <= 0) {
+        return 0;
+    }
+
+    OGRFeatureDefn *defn = m_layer->GetLayerDefn();
+    std::vector<int> fields;
+    for(int i = 0; i < columnCount; ++i) {
+        if(columns[i].field < 0 || columns[i].field >= defn->GetFieldCount() ||
+                nullptr == columns[i].values) {
+            errorMessage(_("Invalid column %d"), i);
+            return -1;
+        }
+        fields.push_back(columns[i].field);
+    }
+    std::sort(fields.begin(), fields.end());
+    fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+
+    MutexHolder holder(m_featureMutex);
+    if(fields != m_columnFields) {
+        std::vector<std::string> ignoreFields = { "OGR_GEOMETRY", "OGR_STYLE" };
+        for(int i = 0; i < defn->GetFieldCount(); ++i) {
+            if(!std::binary_search(fields.begin(), fields.end(), i)) {
+                ignoreFields.push_back(defn->GetFieldDefn(i)->GetNameRef());
+            }
+        }
+        setIgnoredFields(ignoreFields);
+        m_layer->ResetReading();
+        m_columnFields = fields;
+    }
+
+    m_columnStrings.clear();
+    int count = 0;
+    for(; count < maxCount; ++count) {
+        FeaturePtr feature = FeaturePtr::pooled(m_layer->GetNextFeature(),
+                                                this);
+        if(!feature) {
+            break;
+        }
+
+        if(nullptr != fids) {
+            fids[count] = feature->GetFID();
+        }
+        for(int i = 0; i < columnCount; ++i) {
+            ngsFieldColumn &column = columns[i];
+            if(nullptr != column.isSet) {
+                column.isSet[count] =
+                        feature->IsFieldSetAndNotNull(column.field) ? 1 : 0;
+            }
+            switch(defn->GetFieldDefn(column.field)->GetType()) {
+            case OFTInteger:
+                static_cast<int*>(column.values)[count] =
+                        feature->GetFieldAsInteger(column.field);
+                break;
+            case OFTInteger64:
+                static_cast<long long*>(column.values)[count] =
+                        feature->GetFieldAsInteger64(column.field);
+                break;
+            case OFTReal:
+                static_cast<double*>(column.values)[count] =
+                        feature->GetFieldAsDouble(column.field);
+                break;
+            default:
+                m_columnStrings.push_back(
+                            feature->GetFieldAsString(column.field));
+                static_cast<const char**>(column.values)[count] =
+                        m_columnStrings.back().c_str();
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Table::readPage Write next rows into caller memory. The page layout in
+ * native byte order is:
+ * - uint32 rows count
+ * - for each row: int64 fid, for each field uint8 is set flag and, if set, the
+ * value: int32 for integer, int64 for integer64, double for real, uint32 length
+ * and UTF-8 bytes without trailing zero for other types; then uint32 WKB size
+ * and ISO WKB (little endian) of geometry, size is 0 if there is no geometry or
+ * withGeometry is false.
+ * @param data Memory to write.
+ * @param size Memory size.
+ * @param maxCount Max rows count.
+ * @param withGeometry Write geometry or not.
+ * @return Count of written rows, 0 if there are no more rows or -1 if a row
+ * does not fit into empty page or on error.
+ */
+int Table::readPage(GByte *data, size_t size, int maxCount, bool withGeometry)
+{
+    if(nullptr == m_layer) {
+        errorMessage(_("Table is not initialized"));
+        return -1;
+    }
+
+    if(nullptr == data || size < sizeof(GUInt32)) {
+        errorMessage(_("Page buffer is too small"));
+        return -1;
+    }
+
+    OGRFeatureDefn *defn = m_layer->GetLayerDefn();
+    int fieldCount = static_cast<int>(fields().size());
+
+    MutexHolder holder(m_featureMutex);
+    Buffer page;
+    page.put(static_cast<GUInt32>(0));
+    size_t pageSize = page.position();
+    GUInt32 count = 0;
+    std::vector<unsigned char> wkb;
+    while(static_cast<int>(count) < maxCount) {
+        FeaturePtr feature = m_pageFeature;
+        m_pageFeature = FeaturePtr();
+        if(!feature) {
+            feature = FeaturePtr::pooled(m_layer->GetNextFeature(), this);
+        }
+        if(!feature) {
+            break;
+        }
+
+        page.put(static_cast<GIntBig>(feature->GetFID()));
+        for(int i = 0; i < fieldCount; ++i) {
+            bool isSet = feature->IsFieldSetAndNotNull(i);
+            page.put(static_cast<GByte>(isSet ? 1 : 0));
+            if(!isSet) {
+                continue;
+            }
+            switch(defn->GetFieldDefn(i)->GetType()) {
+            case OFTInteger:
+                page.put(static_cast<GUInt32>(feature->GetFieldAsInteger(i)));
+                break;
+            case OFTInteger64:
+                page.put(static_cast<GIntBig>(feature->GetFieldAsInteger64(i)));
+                break;
+            case OFTReal:
+            {
+                double value = feature->GetFieldAsDouble(i);
+                page.put(&value, sizeof(double));
+                break;
+            }
+            default:
+            {
+                const char *value = feature->GetFieldAsString(i);
+                GUInt32 length = static_cast<GUInt32>(std::strlen(value));
+                page.put(length);
+                page.put(value, length);
+                break;
+            }
+            }
+        }
+
+        OGRGeometry *geom = withGeometry ? feature->GetGeometryRef() : nullptr;
+        if(nullptr == geom) {
+            page.put(static_cast<GUInt32>(0));
+        }
+        else {
+            wkb.resize(static_cast<size_t>(geom->WkbSize()));
+            geom->exportToWkb(wkbNDR, wkb.data(), wkbVariantIso);
+            page.put(static_cast<GUInt32>(wkb.size()));
+            page.put(wkb.data(), wkb.size());
+        }
+
+        if(page.position() > size) {
+            m_pageFeature = feature;
+            if(count == 0) {
+                errorMessage(_("Page buffer is too small for feature " CPL_FRMT_GIB),
+                             feature->GetFID());
+                return -1;
+            }
+            break;
+        }
+        pageSize = page.position();
+        count++;
+    }
+
+    std::memcpy(page.data(), &count, sizeof(GUInt32));
+    std::memcpy(data, page.data(), pageSize);
+    return static_cast<int>(count);
 }
 
 int Table::copyRows(const TablePtr srcTable, const FieldMapPtr fieldMap,
                     const Progress& progress, const Options &options)
 {
+    ngsTraceSpan("Table::copyRows");
     if(!srcTable) {
         return outMessage(COD_COPY_FAILED, _("Source table is invalid"));
     }
@@ -449,31 +1156,68 @@ int Table::copyRows(const TablePtr srcTable, const FieldMapPtr fieldMap,
                        srcTable->name().c_str(), name().c_str());
 
     // Lock any SQL query in dataset
-    DatasetBatchOperationHolder holder(dynamic_cast<Dataset*>(m_parent));
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetBatchOperationHolder holder(dataset);
+
+    int chunkSize = options.asInt("COPY_CHUNK_SIZE", DEFAULT_COPY_CHUNK_SIZE);
+    CopyPipeline pipeline(srcTable, [this, &fieldMap](CopyRow &row,
+                                                      unsigned char) {
+            row.dstFeature = createFeature();
+            if(!row.dstFeature) {
+                return;
+            }
+            if(row.dstFeature->SetFieldsFrom(row.srcFeature,
+                                             fieldMap.get()) != OGRERR_NONE) {
+                row.warning = CPLGetLastErrorMsg();
+            }
+        }, 1, chunkSize, canReadAhead(srcTable));
 
     GIntBig featureCount = srcTable->featureCount();
     double counter = 0;
-    srcTable->reset();
-    FeaturePtr feature;
-    while((feature = srcTable->nextFeature())) {
-        double complete = counter / featureCount;
-        if(!progress.onProgress(COD_IN_PROCESS, complete,
-                                _("Copy in process ..."))) {
-            return  COD_CANCELED;
-        }
+    CopyChunk chunk;
+    while(pipeline.next(chunk)) {
+        DatasetWriteLockHolder writeHolder(dataset);
+        bool transaction = nullptr != dataset && dataset->startTransaction();
+        for(const CopyRow &row : chunk) {
+            double complete = counter / featureCount;
+            if(!progress.onProgress(COD_IN_PROCESS, complete,
+                                    _("Copy in process ..."))) {
+                if(transaction) {
+                    dataset->commitTransaction();
+                }
+                return  COD_CANCELED;
+            }
 
-        FeaturePtr dstFeature = createFeature();
-        dstFeature->SetFieldsFrom(feature, fieldMap.get());
+            if(!row.warning.empty()) {
+                if(!progress.onProgress(COD_WARNING, complete,
+                                   _("Set feature fields failed. Source feature FID:" CPL_FRMT_GIB ". Error: %s"),
+                                   row.srcFeature->GetFID (), row.warning.c_str())) {
+                    if(transaction) {
+                        dataset->commitTransaction();
+                    }
+                    return  COD_CANCELED;
+                }
+            }
 
-        if(!insertFeature(dstFeature, false)) {
-            if(!progress.onProgress(COD_WARNING, complete,
-                               _("Create feature failed. Source feature FID:" CPL_FRMT_GIB),
-                               feature->GetFID ())) {
-               return  COD_CANCELED;
+            if(!row.dstFeature || !insertFeature(row.dstFeature, false)) {
+                if(!progress.onProgress(COD_WARNING, complete,
+                                   _("Create feature failed. Source feature FID:" CPL_FRMT_GIB),
+                                   row.srcFeature->GetFID ())) {
+                    if(transaction) {
+                        dataset->commitTransaction();
+                    }
+                    return  COD_CANCELED;
+                }
+            }
+            if(row.dstFeature) {
+                MutexHolder sourceHolder(pipeline.sourceMutex());
+                onRowCopied(row.srcFeature, row.dstFeature, options);
             }
+            counter++;
+        }
+        if(transaction) {
+            dataset->commitTransaction();
         }
-        onRowCopied(feature, dstFeature, options);
-        counter++;
     }
 
     progress.onProgress(COD_FINISHED, 1.0, _("Done. Copied %d rows"),
@@ -482,6 +1226,19 @@ int Table::copyRows(const TablePtr srcTable, const FieldMapPtr fieldMap,
     return COD_SUCCESS;
 }
 
+/**
+ * @brief Table::canReadAhead Source may be read on other thread while this
+ * table is written, if source and this table are in different datasets.
+ * @param srcTable Source table.
+ * @return true if table rows can be read ahead.
+ */
+bool Table::canReadAhead(const TablePtr srcTable) const
+{
+    Dataset *dataset = dynamic_cast<Dataset*>(m_parent);
+    Dataset *srcDataset = dynamic_cast<Dataset*>(srcTable->parent());
+    return nullptr != dataset && nullptr != srcDataset && dataset != srcDataset;
+}
+
 bool Table::onRowsCopied(const TablePtr srcTable, const Progress &progress,
                          const Options &options)
 {
@@ -529,9 +1286,28 @@ void Table::setAttributeFilter(const std::string &filter)
         else {
             m_layer->SetAttributeFilter(filter.c_str());
         }
+        m_attributeFilter = !filter.empty();
     }
 }
 
+/**
+ * @brief Table::createIndex Create attribute index on field. Supported by the
+ * data store tables.
+ * @param field Field name.
+ * @return True on success.
+ */
+bool Table::createIndex(const std::string &field)
+{
+    return errorMessage(_("Attribute index on %s is not supported for %s"),
+                        field.c_str(), m_name.c_str());
+}
+
+bool Table::dropIndex(const std::string &field)
+{
+    return errorMessage(_("Attribute index on %s is not supported for %s"),
+                        field.c_str(), m_name.c_str());
+}
+
 OGRFeatureDefn *Table::definition() const
 {
     if(nullptr == m_layer) {
@@ -867,6 +1643,9 @@ std::string Table::storeName() const
 void Table::onFeatureInserted(FeaturePtr feature)
 {
     feature.setTable(this);
+    if(m_featureCount >= 0) {
+        ++m_featureCount;
+    }
 }
 
 void Table::onFeatureUpdated(FeaturePtr oldFeature, FeaturePtr newFeature)
@@ -878,11 +1657,16 @@ void Table::onFeatureUpdated(FeaturePtr oldFeature, FeaturePtr newFeature)
 void Table::onFeatureDeleted(FeaturePtr delFeature)
 {
     ngsUnused(delFeature);
+    if(m_featureCount > 0) {
+        --m_featureCount;
+    }
 }
 
 void Table::onFeaturesDeleted()
 {
-
+    if(m_cacheFeatureCount) {
+        m_featureCount = 0;
+    }
 }
 
 void Table::onRowCopied(FeaturePtr srcFeature, FeaturePtr dstFature,
@@ -998,6 +1782,7 @@ void Table::logEditOperation(const FeaturePtr &opFeature)
         if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
             CPLDebug("ngstore", "Log operation %d failed", code);
         }
+        m_deleteAllLogged = true;
 
         return;
     }
@@ -1018,11 +1803,15 @@ void Table::logEditOperation(const FeaturePtr &opFeature)
         return;
     }
 
-    // Check delete all
-    addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = %d",
-                                   parentDataset->historyTableName(m_name).c_str(),
-                                   OPERATION_FIELD, CC_DELETEALL_FEATURES),
-                       nullptr, nullptr);
+    // Check delete all. Skip the statement if there is no such operation,
+    // this is the most common case on each edit.
+    if(m_deleteAllLogged) {
+        addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = %d",
+                                       parentDataset->historyTableName(m_name).c_str(),
+                                       OPERATION_FIELD, CC_DELETEALL_FEATURES),
+                           nullptr, nullptr);
+        m_deleteAllLogged = false;
+    }
 
     if(code == CC_CREATE_ATTACHMENT || code == CC_CHANGE_ATTACHMENT) {
         if(fid == NOT_FOUND) {
@@ -1131,8 +1920,12 @@ void Table::logEditOperation(const FeaturePtr &opFeature)
         // Check if feature deleted - skip
         // Check if feature added. If added - skip
         // Check if feature changed. If changed - skip
-        if(!features.empty()) {
-            return;
+        // Attachment operations of the feature are not taken into account.
+        for(auto feature : features) {
+            GIntBig testAid = feature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
+            if(testAid == NOT_FOUND) {
+                return;
+            }
         }
         // Add new operation
         if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
@@ -1207,6 +2000,194 @@ std::vector<ngsEditOperation> Table::editOperations()
     return out;
 }
 
+/**
+ * @brief Table::compactEditOperations Collapse logged operations to the
+ * minimum needed to sync. Operations are squashed per feature and per
+ * attachment in log order:
+ * - create + change... -> create
+ * - change + change... -> change
+ * - change... + delete -> delete
+ * - create + ... + delete -> nothing (feature attachments operations too)
+ * - any operations before delete all features (attachments) -> delete all.
+ * The same rules are applied on each logged edit, this pass compacts logs
+ * written before, i.e. by earlier versions.
+ * @return Count of removed operations.
+ */
+int Table::compactEditOperations()
+{
+    if(!initEditHistoryTable()) {
+        return 0;
+    }
+
+    Dataset *parentDataset = dynamic_cast<Dataset*>(m_parent);
+    if(nullptr == parentDataset) {
+        return 0;
+    }
+
+    typedef struct _opsState {
+        GIntBig created;
+        GIntBig changed;
+    } OpsState;
+
+    std::vector<GIntBig> dropRows;
+    std::map<GIntBig, OpsState> featureOps;
+    std::map<std::pair<GIntBig, GIntBig>, OpsState> attachmentOps;
+    std::map<GIntBig, std::vector<GIntBig>> attachmentRows;
+    std::vector<GIntBig> seenRows;
+
+    DatasetExecuteSQLLockHolder holder(parentDataset);
+    FeaturePtr feature;
+    m_editHistoryTable->ResetReading();
+    while((feature = m_editHistoryTable->GetNextFeature())) {
+        GIntBig row = feature->GetFID();
+        GIntBig fid = feature->GetFieldAsInteger64(FEATURE_ID_FIELD);
+        GIntBig aid = feature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
+        enum ngsChangeCode code = static_cast<enum ngsChangeCode>(
+                    feature->GetFieldAsInteger64(OPERATION_FIELD));
+
+        switch(code) {
+        case CC_DELETEALL_FEATURES:
+            dropRows.insert(dropRows.end(), seenRows.begin(), seenRows.end());
+            seenRows.clear();
+            featureOps.clear();
+            attachmentOps.clear();
+            attachmentRows.clear();
+            break;
+        case CC_DELETEALL_ATTACHMENTS:
+        {
+            auto &rows = attachmentRows[fid];
+            dropRows.insert(dropRows.end(), rows.begin(), rows.end());
+            rows.clear();
+            auto it = attachmentOps.begin();
+            while(it != attachmentOps.end()) {
+                if(it->first.first == fid) {
+                    it = attachmentOps.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            rows.push_back(row);
+            break;
+        }
+        case CC_CREATE_FEATURE:
+            featureOps[fid] = {row, NOT_FOUND};
+            break;
+        case CC_CHANGE_FEATURE:
+        {
+            auto it = featureOps.find(fid);
+            if(it == featureOps.end()) {
+                featureOps[fid] = {NOT_FOUND, row};
+            }
+            else if(it->second.created != NOT_FOUND ||
+                    it->second.changed != NOT_FOUND) {
+                dropRows.push_back(row);
+            }
+            else {
+                it->second.changed = row;
+            }
+            break;
+        }
+        case CC_DELETE_FEATURE:
+        {
+            // Attachments are deleted together with feature
+            auto &rows = attachmentRows[fid];
+            dropRows.insert(dropRows.end(), rows.begin(), rows.end());
+            attachmentRows.erase(fid);
+            auto attIt = attachmentOps.begin();
+            while(attIt != attachmentOps.end()) {
+                if(attIt->first.first == fid) {
+                    attIt = attachmentOps.erase(attIt);
+                }
+                else {
+                    ++attIt;
+                }
+            }
+
+            auto it = featureOps.find(fid);
+            if(it != featureOps.end()) {
+                if(it->second.changed != NOT_FOUND) {
+                    dropRows.push_back(it->second.changed);
+                }
+                if(it->second.created != NOT_FOUND) {
+                    // Created and deleted locally - nothing to sync
+                    dropRows.push_back(it->second.created);
+                    dropRows.push_back(row);
+                }
+                featureOps.erase(it);
+            }
+            break;
+        }
+        case CC_CREATE_ATTACHMENT:
+            attachmentOps[std::make_pair(fid, aid)] = {row, NOT_FOUND};
+            attachmentRows[fid].push_back(row);
+            break;
+        case CC_CHANGE_ATTACHMENT:
+        {
+            auto key = std::make_pair(fid, aid);
+            auto it = attachmentOps.find(key);
+            if(it == attachmentOps.end()) {
+                attachmentOps[key] = {NOT_FOUND, row};
+                attachmentRows[fid].push_back(row);
+            }
+            else if(it->second.created != NOT_FOUND ||
+                    it->second.changed != NOT_FOUND) {
+                dropRows.push_back(row);
+            }
+            else {
+                it->second.changed = row;
+                attachmentRows[fid].push_back(row);
+            }
+            break;
+        }
+        case CC_DELETE_ATTACHMENT:
+        {
+            auto it = attachmentOps.find(std::make_pair(fid, aid));
+            if(it != attachmentOps.end()) {
+                if(it->second.changed != NOT_FOUND) {
+                    dropRows.push_back(it->second.changed);
+                }
+                if(it->second.created != NOT_FOUND) {
+                    dropRows.push_back(it->second.created);
+                    dropRows.push_back(row);
+                }
+                attachmentOps.erase(it);
+            }
+            if(dropRows.empty() || dropRows.back() != row) {
+                attachmentRows[fid].push_back(row);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        seenRows.push_back(row);
+    }
+
+    if(dropRows.empty()) {
+        return 0;
+    }
+
+    std::sort(dropRows.begin(), dropRows.end());
+    dropRows.erase(std::unique(dropRows.begin(), dropRows.end()),
+                   dropRows.end());
+
+    auto addsDS = parentDataset->m_addsDS;
+    bool transaction = addsDS->StartTransaction() == OGRERR_NONE;
+    for(GIntBig row : dropRows) {
+        if(m_editHistoryTable->DeleteFeature(row) != OGRERR_NONE) {
+            CPLDebug("ngstore", "Failed delete log item " CPL_FRMT_GIB, row);
+        }
+    }
+    if(transaction) {
+        addsDS->CommitTransaction();
+    }
+
+    CPLDebug("ngstore", "Edit log compacted by %d operations",
+             static_cast<int>(dropRows.size()));
+    return static_cast<int>(dropRows.size());
+}
+
 bool Table::sync()
 {
     if(nullptr != m_layer) {
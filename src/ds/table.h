@@ -21,9 +21,15 @@
 #ifndef NGSTABLE_H
 #define NGSTABLE_H
 
+// std
+#include <atomic>
+#include <deque>
+#include <functional>
+
 // gdal
 #include "ogrsf_frmts.h"
 
+#include "geometry.h"
 #include "catalog/object.h"
 #include "ngstore/codes.h"
 
@@ -34,6 +40,8 @@
 namespace ngs {
 
 constexpr const char* LOG_EDIT_HISTORY_KEY = "LOG_EDIT_HISTORY";
+// 0 - md5 of feature dump string, 1 - streaming xxHash64
+constexpr unsigned char FEATURE_HASH_VERSION = 1;
 
 typedef struct _Field {
     std::string m_name;
@@ -87,8 +95,11 @@ public:
     FeaturePtr(OGRFeature *feature, const Table *table);
     FeaturePtr();
     FeaturePtr &operator=(OGRFeature *feature);
+    static FeaturePtr pooled(OGRFeature *feature, const Table *table);
     operator OGRFeature*() const;
-    std::string dump(enum DumpOutputType type = DumpOutputType::HASH) const;
+    std::string dump(enum DumpOutputType type = DumpOutputType::HASH,
+                     unsigned char hashVersion = FEATURE_HASH_VERSION) const;
+    static unsigned char hashVersion(const std::string &hash);
     GIntBig addAttachment(const std::string &fileName,
                           const std::string &description,
                           const std::string &filePath,
@@ -106,12 +117,54 @@ public:
     Table *table() const;
     void setTable(Table *table);
 
+protected:
+    FeaturePtr(std::shared_ptr<OGRFeature> &&feature, const Table *table);
+    std::string fingerprint(enum DumpOutputType type) const;
+
 protected:
     Table *m_table;
 };
 
 using TablePtr = std::shared_ptr<Table>;
 
+/**
+ * @brief The ChangeRange struct Features with consecutive identifiers changed
+ * by the same operation.
+ */
+typedef struct _changeRange {
+    // Sequence number of the last change in the range
+    GUIntBig sequence;
+    GIntBig fromFid, toFid;
+    enum ngsChangeCode code;
+    // Old and new geometries extent
+    Envelope extent;
+} ChangeRange;
+
+/**
+ * @brief The ChangeJournal class In memory journal of table changes. Every
+ * change increases the sequence number, consecutive features changes are
+ * merged to ranges. Oldest ranges are dropped if the journal is full.
+ */
+class ChangeJournal
+{
+public:
+    ChangeJournal() : m_sequence(0), m_firstSequence(1) {}
+    GUIntBig sequence() const;
+    void add(GIntBig fid, enum ngsChangeCode code, const Envelope &extent);
+    void addAll(enum ngsChangeCode code);
+    bool changesSince(GUIntBig sequence, std::vector<ChangeRange> &changes) const;
+
+private:
+    std::deque<ChangeRange> m_ranges;
+    GUIntBig m_sequence;
+    // Oldest sequence number the journal has changes after
+    GUIntBig m_firstSequence;
+    mutable Mutex m_mutex;
+};
+
+class TableCursor;
+using TableCursorPtr = std::unique_ptr<TableCursor>;
+
 /**
  * Table class
  */
@@ -120,6 +173,8 @@ class Table : public Object
     friend class FeaturePtr;
     friend class Dataset;
     friend class Folder;
+    friend class TableCursor;
+    friend class CopyPipeline;
 public:
     explicit Table(OGRLayer *layer,
                    ObjectContainer * const parent = nullptr,
@@ -135,7 +190,20 @@ public:
     GIntBig featureCount(bool force = false) const;
     void reset() const;
     void setAttributeFilter(const std::string &filter = "");
+    bool setIgnoredFields(const std::vector<std::string> &fields =
+            std::vector<std::string>());
     virtual FeaturePtr nextFeature() const;
+    virtual bool createIndex(const std::string &field);
+    virtual bool dropIndex(const std::string &field);
+    TableCursorPtr cursor(const std::string &filter = "",
+                          const Envelope &spatialFilter = Envelope(),
+                          const std::vector<std::string> &fields =
+            std::vector<std::string>()) const;
+    bool forEachFeature(
+            const std::function<bool(const FeaturePtr &feature)> &func) const;
+    int readColumns(long long *fids, ngsFieldColumn *columns, int columnCount,
+                    int maxCount);
+    int readPage(GByte *data, size_t size, int maxCount, bool withGeometry);
     virtual int copyRows(const TablePtr srcTable,
                          const FieldMapPtr fieldMap,
                          const Progress &progress = Progress(),
@@ -166,6 +234,12 @@ public:
     // Edit log
     virtual void deleteEditOperation(const ngsEditOperation &op);
     virtual std::vector<ngsEditOperation> editOperations();
+    int compactEditOperations();
+    GUIntBig changeSequence() const { return m_changes.sequence(); }
+    bool changesSince(GUIntBig sequence,
+                      std::vector<ChangeRange> &changes) const {
+        return m_changes.changesSince(sequence, changes);
+    }
 
     virtual bool sync() override;
 
@@ -199,6 +273,7 @@ protected:
                                   const std::string &domain);
     virtual std::string fullPropertyDomain(const std::string &domain) const;
     virtual std::string storeName() const;
+    bool canReadAhead(const TablePtr srcTable) const;
     // Events
     virtual void onFeatureInserted(FeaturePtr feature);
     virtual void onFeatureUpdated(FeaturePtr oldFeature, FeaturePtr newFeature);
@@ -215,6 +290,18 @@ protected:
     mutable OGRLayer *m_editHistoryTable;
     mutable std::vector<Field> m_fields;
     Mutex m_featureMutex;
+    // Edit history may have delete all features operation
+    bool m_deleteAllLogged;
+    // Fields read by readColumns, others are ignored
+    mutable std::vector<int> m_columnFields;
+    std::deque<std::string> m_columnStrings;
+    // Feature not fit into previous page
+    mutable FeaturePtr m_pageFeature;
+    // Unfiltered feature count maintained on edit, -1 if unknown
+    bool m_cacheFeatureCount;
+    mutable std::atomic<GIntBig> m_featureCount;
+    std::atomic_bool m_attributeFilter, m_spatialFilter;
+    ChangeJournal m_changes;
 };
 
 }
@@ -0,0 +1,147 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "tablecursor.h"
+
+// std
+#include <algorithm>
+
+#include "util/error.h"
+
+namespace ngs {
+
+//------------------------------------------------------------------------------
+// TableCursor
+//------------------------------------------------------------------------------
+
+TableCursor::TableCursor(const Table *table) :
+    m_table(table),
+    m_dataset(dynamic_cast<Dataset*>(table->parent())),
+    m_layer(nullptr),
+    m_pooled(false)
+{
+}
+
+TableCursor::~TableCursor()
+{
+    if(!m_pooled || !m_connection) {
+        return; // Own connection is closed with the pointer
+    }
+    if(nullptr != m_layer) {
+        // Pooled connection is shared with other readers
+        m_layer->SetAttributeFilter(nullptr);
+        m_layer->SetSpatialFilter(nullptr);
+        m_layer->SetIgnoredFields(nullptr);
+        m_layer->ResetReading();
+    }
+    m_dataset->releaseReadConnection(m_connection);
+}
+
+/**
+ * @brief TableCursor::open Take dataset connection and set filters to the
+ * table layer of it.
+ * @param filter Attribute filter or empty string.
+ * @param spatialFilter Extent filter or not initialized envelope.
+ * @param fields Attribute fields to read or empty array to read all.
+ * @return True on success.
+ */
+bool TableCursor::open(const std::string &filter, const Envelope &spatialFilter,
+                       const std::vector<std::string> &fields)
+{
+    if(nullptr == m_dataset || nullptr == m_table->m_layer) {
+        return errorMessage(_("Table %s is not in dataset"),
+                            m_table->name().c_str());
+    }
+    // Other connections may block batch writes of the dataset
+    if(m_dataset->isBatchOperation()) {
+        return errorMessage(_("Table cursor is not available during batch operation"));
+    }
+
+    m_connection = m_dataset->acquireReadConnection();
+    m_pooled = nullptr != m_connection.get();
+    if(!m_pooled) {
+        m_connection = static_cast<GDALDataset*>(
+                    GDALOpenEx(m_dataset->path().c_str(),
+                               GDAL_OF_VECTOR|GDAL_OF_READONLY, nullptr,
+                               nullptr, nullptr));
+        if(!m_connection) {
+            return errorMessage(_("Failed to open dataset %s for table cursor"),
+                                m_dataset->path().c_str());
+        }
+    }
+
+    m_layer = m_connection->GetLayerByName(m_table->m_layer->GetName());
+    if(nullptr == m_layer) {
+        return errorMessage(_("Table %s not found in dataset"),
+                            m_table->name().c_str());
+    }
+
+    if(!filter.empty() &&
+            m_layer->SetAttributeFilter(filter.c_str()) != OGRERR_NONE) {
+        return errorMessage(_("Invalid attribute filter: %s"), filter.c_str());
+    }
+
+    if(spatialFilter.isInit() && m_layer->GetGeomType() != wkbNone) {
+        m_layer->SetSpatialFilterRect(spatialFilter.minX(), spatialFilter.minY(),
+                                      spatialFilter.maxX(), spatialFilter.maxY());
+    }
+
+    if(!fields.empty()) {
+        OGRFeatureDefn *defn = m_layer->GetLayerDefn();
+        char **ignoreFields = nullptr;
+        for(int i = 0; i < defn->GetFieldCount(); ++i) {
+            const char *name = defn->GetFieldDefn(i)->GetNameRef();
+            if(std::find(fields.begin(), fields.end(), name) == fields.end()) {
+                ignoreFields = CSLAddString(ignoreFields, name);
+            }
+        }
+        if(nullptr != ignoreFields) {
+            m_layer->SetIgnoredFields(const_cast<const char**>(ignoreFields));
+            CSLDestroy(ignoreFields);
+        }
+    }
+
+    m_layer->ResetReading();
+    return true;
+}
+
+/**
+ * @brief TableCursor::next Read next feature.
+ * @return Feature or empty pointer if there are no more features.
+ */
+FeaturePtr TableCursor::next()
+{
+    if(nullptr == m_layer) {
+        return FeaturePtr();
+    }
+    return FeaturePtr::pooled(m_layer->GetNextFeature(), m_table);
+}
+
+/**
+ * @brief TableCursor::reset Start read from the first feature.
+ */
+void TableCursor::reset()
+{
+    if(nullptr != m_layer) {
+        m_layer->ResetReading();
+    }
+}
+
+}
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSTABLECURSOR_H
+#define NGSTABLECURSOR_H
+
+// std
+#include <string>
+#include <vector>
+
+#include "dataset.h"
+
+namespace ngs {
+
+/**
+ * @brief The TableCursor class Independent read cursor over table rows. The
+ * cursor reads from its own dataset connection, so cursors of one table may be
+ * used in different threads at the same time and do not change the table read
+ * state (reset, nextFeature, attribute filter). One cursor must be used from
+ * one thread at a time and must not outlive the table. Cursor reads committed
+ * data only.
+ */
+class TableCursor
+{
+public:
+    explicit TableCursor(const Table *table);
+    ~TableCursor();
+    bool open(const std::string &filter, const Envelope &spatialFilter,
+              const std::vector<std::string> &fields);
+    FeaturePtr next();
+    void reset();
+
+private:
+    TableCursor(TableCursor const&) = delete;
+    TableCursor &operator= (TableCursor const&) = delete;
+
+private:
+    const Table *m_table;
+    Dataset *m_dataset;
+    GDALDatasetPtr m_connection;
+    OGRLayer *m_layer;
+    // Connection is taken from dataset read connections pool
+    bool m_pooled;
+};
+
+}
+
+#endif // NGSTABLECURSOR_H
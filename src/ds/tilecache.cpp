@@ -0,0 +1,256 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "tilecache.h"
+
+// std
+#include <iterator>
+
+#include "api_priv.h"
+#include "util/buffer.h"
+#include "util/settings.h"
+
+namespace ngs {
+
+constexpr size_t MB = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// TileCache
+//------------------------------------------------------------------------------
+
+TileCache &TileCache::instance()
+{
+    static TileCache cache;
+    return cache;
+}
+
+TileCache::TileCache() :
+    m_generation(0),
+    m_clearGeneration(0),
+    m_size(0),
+    m_maxSize(0)
+{
+    const Settings &settings = Settings::instance();
+    int maxSize = settings.getInteger("common/tile_cache_size",
+                                      DEFAULT_TILE_CACHE_SIZE);
+    if(maxSize > 0) {
+        m_maxSize = static_cast<size_t>(maxSize) * MB;
+    }
+    MemoryBudget::instance().addConsumer(this);
+}
+
+TileCache::~TileCache()
+{
+    MemoryBudget::instance().removeConsumer(this);
+}
+
+bool TileCache::get(const void *owner, const Tile &tile, FlatVectorTile &out)
+{
+    MutexHolder holder(m_mutex);
+    auto it = m_index.find({owner, tile});
+    if(it == m_index.end()) {
+        return false;
+    }
+
+    // Move to the front of the list
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    it->second->tick = MemoryBudget::tick();
+    out = it->second->vtile;
+    return true;
+}
+
+/**
+ * @brief TileCache::put Put tile to the cache.
+ * @param owner Tile owner.
+ * @param tile Tile coordinates.
+ * @param vtile Tile data.
+ * @param generation Generation taken before the tile data was read. The tile
+ * is not put if the owner was removed or the cache was cleared since.
+ */
+void TileCache::put(const void *owner, const Tile &tile,
+                    const FlatVectorTile &vtile, GUIntBig generation)
+{
+    if(0 == m_maxSize || !vtile.isValid()) {
+        return;
+    }
+
+    // Cached tile must be cheap to copy, so keep it as blob shared by copies
+    FlatVectorTile sharedTile;
+    if(vtile.isAttached()) {
+        sharedTile = vtile;
+    }
+    else {
+        BufferPtr blob = vtile.save();
+        if(!sharedTile.attach(blob->data(), static_cast<size_t>(blob->size()),
+                              blob)) {
+            return;
+        }
+    }
+
+    size_t size = sharedTile.dataSize();
+    {
+        MutexHolder holder(m_mutex);
+        if(size > m_maxSize) {
+            return;
+        }
+        if(generation != TILE_CACHE_ANY_GENERATION) {
+            auto generationIt = m_generations.find(owner);
+            if(generation < m_clearGeneration ||
+                    (generationIt != m_generations.end() &&
+                     generation < generationIt->second)) {
+                return; // Stale tile read before the owner data changed
+            }
+        }
+
+        Key key = {owner, tile};
+        auto it = m_index.find(key);
+        if(it != m_index.end()) {
+            erase(it->second);
+        }
+
+        evict(m_maxSize - size);
+
+        m_entries.push_front({key, std::move(sharedTile), size,
+                              MemoryBudget::tick()});
+        m_index[key] = m_entries.begin();
+        m_ownerCounts[owner]++;
+        m_size += size;
+    }
+    MemoryBudget::instance().enforce();
+}
+
+/**
+ * @brief TileCache::generation Current generation to take before the tile
+ * data read.
+ * @param owner Tile owner.
+ * @return Generation to pass to put().
+ */
+GUIntBig TileCache::generation(const void *owner) const
+{
+    ngsUnused(owner);
+    MutexHolder holder(m_mutex);
+    return m_generation;
+}
+
+/**
+ * @brief TileCache::remove Remove owner tiles on the owner data change.
+ * @param owner Tile owner.
+ */
+void TileCache::remove(const void *owner)
+{
+    MutexHolder holder(m_mutex);
+    m_generations[owner] = ++m_generation;
+    eraseOwner(owner);
+}
+
+/**
+ * @brief TileCache::release Remove owner tiles and forget the owner. Called
+ * on the owner destruction, the new owner may get the same address.
+ * @param owner Tile owner.
+ */
+void TileCache::release(const void *owner)
+{
+    MutexHolder holder(m_mutex);
+    m_generations.erase(owner);
+    eraseOwner(owner);
+}
+
+void TileCache::clear()
+{
+    MutexHolder holder(m_mutex);
+    m_index.clear();
+    m_ownerCounts.clear();
+    m_entries.clear();
+    m_generations.clear();
+    m_clearGeneration = ++m_generation;
+    m_size = 0;
+}
+
+/**
+ * Must be called with locked m_mutex.
+ */
+void TileCache::eraseOwner(const void *owner)
+{
+    if(m_ownerCounts.find(owner) == m_ownerCounts.end()) {
+        return;
+    }
+
+    auto it = m_entries.begin();
+    while(it != m_entries.end()) {
+        auto current = it++;
+        if(current->key.owner == owner) {
+            erase(current);
+        }
+    }
+}
+
+void TileCache::setMaxSize(size_t size)
+{
+    MutexHolder holder(m_mutex);
+    m_maxSize = size;
+    evict(m_maxSize);
+}
+
+size_t TileCache::memoryUsed() const
+{
+    MutexHolder holder(m_mutex);
+    return m_size;
+}
+
+bool TileCache::oldestAccess(GUIntBig &tick) const
+{
+    MutexHolder holder(m_mutex);
+    if(m_entries.empty()) {
+        return false;
+    }
+    tick = m_entries.back().tick;
+    return true;
+}
+
+size_t TileCache::freeOldest()
+{
+    MutexHolder holder(m_mutex);
+    if(m_entries.empty()) {
+        return 0;
+    }
+    size_t size = m_entries.back().size;
+    erase(std::prev(m_entries.end()));
+    return size;
+}
+
+void TileCache::evict(size_t maxSize)
+{
+    while(m_size > maxSize && !m_entries.empty()) {
+        erase(std::prev(m_entries.end()));
+    }
+}
+
+void TileCache::erase(EntryList::iterator it)
+{
+    auto countIt = m_ownerCounts.find(it->key.owner);
+    if(countIt != m_ownerCounts.end() && --countIt->second == 0) {
+        m_ownerCounts.erase(countIt);
+    }
+    m_index.erase(it->key);
+    m_size -= it->size;
+    m_entries.erase(it);
+}
+
+} // namespace ngs
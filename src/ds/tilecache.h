@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSTILECACHE_H
+#define NGSTILECACHE_H
+
+// std
+#include <atomic>
+#include <limits>
+#include <list>
+#include <map>
+
+#include "geometry.h"
+#include "util/memorybudget.h"
+#include "util/mutex.h"
+
+namespace ngs {
+
+constexpr int DEFAULT_TILE_CACHE_SIZE = 32; // Mb
+// Put tile without the owner generation check
+constexpr GUIntBig TILE_CACHE_ANY_GENERATION =
+        std::numeric_limits<GUIntBig>::max();
+
+/**
+ * @brief The TileCache class Shared LRU cache of decoded vector tiles.
+ * Tiles are keyed by owner (feature class) and tile coordinates. The cache
+ * evicts least recently used tiles to stay within memory budget. Budget is
+ * read from "common/tile_cache_size" setting in megabytes, 0 disables cache.
+ * Tiles are also freed by the MemoryBudget, least recently drawn first.
+ * Removals are numbered, so tile read before the owner data changed is not
+ * put: take generation() before the read and pass it to put(). The owner
+ * removal number is kept until the owner is released on destruction.
+ */
+class TileCache : public MemoryConsumer
+{
+public:
+    static TileCache &instance();
+
+public:
+    bool get(const void *owner, const Tile &tile, FlatVectorTile &out);
+    void put(const void *owner, const Tile &tile, const FlatVectorTile &vtile,
+             GUIntBig generation = TILE_CACHE_ANY_GENERATION);
+    GUIntBig generation(const void *owner) const;
+    void remove(const void *owner);
+    void release(const void *owner);
+    void clear();
+    void setMaxSize(size_t size);
+    size_t maxSize() const { return m_maxSize; }
+    size_t size() const { return m_size; }
+
+    // MemoryConsumer interface
+public:
+    virtual size_t memoryUsed() const override;
+    virtual bool oldestAccess(GUIntBig &tick) const override;
+    virtual size_t freeOldest() override;
+
+private:
+    TileCache();
+    virtual ~TileCache() override;
+    TileCache(TileCache const&) = delete;
+    TileCache &operator= (TileCache const&) = delete;
+
+private:
+    typedef struct _key {
+        const void *owner;
+        Tile tile;
+        bool operator<(const struct _key &other) const {
+            return owner < other.owner ||
+                    (owner == other.owner && tile < other.tile);
+        }
+    } Key;
+
+    typedef struct _entry {
+        Key key;
+        FlatVectorTile vtile;
+        size_t size;
+        GUIntBig tick;
+    } Entry;
+
+    using EntryList = std::list<Entry>;
+
+private:
+    void evict(size_t maxSize);
+    void erase(EntryList::iterator it);
+    void eraseOwner(const void *owner);
+
+private:
+    EntryList m_entries; // NOTE: Most recently used first
+    std::map<Key, EntryList::iterator> m_index;
+    std::map<const void*, size_t> m_ownerCounts;
+    // Number of the last removal of owner
+    std::map<const void*, GUIntBig> m_generations;
+    GUIntBig m_generation;
+    // Tiles read before clear are not put, as owners removals are forgotten
+    GUIntBig m_clearGeneration;
+    size_t m_size;
+    std::atomic<size_t> m_maxSize;
+    mutable Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSTILECACHE_H
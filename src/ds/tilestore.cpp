@@ -0,0 +1,560 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "tilestore.h"
+
+// std
+#include <ctime>
+
+#include "catalog/folder.h"
+#include "ngstore/catalog/filter.h"
+#include "util/error.h"
+
+namespace ngs {
+
+constexpr const char *TILES_TABLE = "tiles";
+constexpr const char *METADATA_TABLE = "metadata";
+constexpr const char *ZOOM_KEY = "zoom_level";
+constexpr const char *COLUMN_KEY = "tile_column";
+constexpr const char *ROW_KEY = "tile_row";
+constexpr const char *DATA_KEY = "tile_data";
+constexpr const char *EXPIRES_KEY = "expires";
+constexpr const char *ETAG_KEY = "etag";
+constexpr const char *LAST_MODIFIED_KEY = "last_modified";
+constexpr const char *JOBS_TABLE = "cache_jobs";
+constexpr const char *JOB_KEY = "job";
+constexpr const char *MIN_COLUMN_KEY = "min_column";
+constexpr const char *MIN_ROW_KEY = "min_row";
+constexpr const char *MAX_COLUMN_KEY = "max_column";
+constexpr const char *MAX_ROW_KEY = "max_row";
+constexpr const char *DONE_KEY = "done";
+
+//------------------------------------------------------------------------------
+// CacheAreaJob
+//------------------------------------------------------------------------------
+
+CacheAreaJob::CacheAreaJob(const std::string &id) : m_id(id)
+{
+}
+
+static size_t levelTileCount(const CacheAreaJob::Level &level)
+{
+    return static_cast<size_t>(level.maxX - level.minX + 1) *
+            static_cast<size_t>(level.maxY - level.minY + 1);
+}
+
+static size_t levelTileIndex(const CacheAreaJob::Level &level, const Tile &tile)
+{
+    return static_cast<size_t>(tile.x - level.minX) *
+            static_cast<size_t>(level.maxY - level.minY + 1) +
+            static_cast<size_t>(tile.y - level.minY);
+}
+
+void CacheAreaJob::addLevel(unsigned char z, int minX, int minY, int maxX,
+                            int maxY)
+{
+    MutexHolder holder(m_mutex);
+    Level level = { z, minX, minY, maxX, maxY, std::vector<GByte>() };
+    level.done.resize((levelTileCount(level) + 7) / 8, 0);
+    m_levels.push_back(level);
+}
+
+std::vector<CacheAreaJob::Level> CacheAreaJob::levels() const
+{
+    MutexHolder holder(m_mutex);
+    return m_levels;
+}
+
+void CacheAreaJob::setLevels(const std::vector<Level> &levels)
+{
+    MutexHolder holder(m_mutex);
+    m_levels = levels;
+}
+
+const CacheAreaJob::Level *CacheAreaJob::level(unsigned char z) const
+{
+    for(const Level &level : m_levels) {
+        if(level.z == z) {
+            return &level;
+        }
+    }
+    return nullptr;
+}
+
+bool CacheAreaJob::isDone(const Tile &tile) const
+{
+    MutexHolder holder(m_mutex);
+    const Level *tileLevel = level(tile.z);
+    if(nullptr == tileLevel || tile.x < tileLevel->minX ||
+            tile.x > tileLevel->maxX || tile.y < tileLevel->minY ||
+            tile.y > tileLevel->maxY) {
+        return false;
+    }
+    size_t index = levelTileIndex(*tileLevel, tile);
+    return (tileLevel->done[index / 8] & (1 << (index % 8))) != 0;
+}
+
+void CacheAreaJob::setDone(const std::vector<Tile> &tiles)
+{
+    MutexHolder holder(m_mutex);
+    for(const Tile &tile : tiles) {
+        Level *tileLevel = const_cast<Level*>(level(tile.z));
+        if(nullptr == tileLevel || tile.x < tileLevel->minX ||
+                tile.x > tileLevel->maxX || tile.y < tileLevel->minY ||
+                tile.y > tileLevel->maxY) {
+            continue;
+        }
+        size_t index = levelTileIndex(*tileLevel, tile);
+        tileLevel->done[index / 8] |= static_cast<GByte>(1 << (index % 8));
+    }
+}
+
+size_t CacheAreaJob::tileCount() const
+{
+    MutexHolder holder(m_mutex);
+    size_t count = 0;
+    for(const Level &level : m_levels) {
+        count += levelTileCount(level);
+    }
+    return count;
+}
+
+size_t CacheAreaJob::doneCount() const
+{
+    MutexHolder holder(m_mutex);
+    size_t count = 0;
+    for(const Level &level : m_levels) {
+        for(GByte bits : level.done) {
+            for(; bits != 0; bits &= bits - 1) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------
+// TileStore
+//------------------------------------------------------------------------------
+
+/**
+ * @brief addValidatorFields Add ETag and Last-Modified fields. Stores created
+ * before these fields get them on open.
+ * @param tiles Tiles table
+ * @return True on success.
+ */
+static bool addValidatorFields(OGRLayer *tiles)
+{
+    OGRFeatureDefn *defn = tiles->GetLayerDefn();
+    if(defn->GetFieldIndex(ETAG_KEY) < 0) {
+        OGRFieldDefn etagField(ETAG_KEY, OFTString);
+        if(tiles->CreateField(&etagField) != OGRERR_NONE) {
+            return false;
+        }
+    }
+    if(defn->GetFieldIndex(LAST_MODIFIED_KEY) < 0) {
+        OGRFieldDefn lastModifiedField(LAST_MODIFIED_KEY, OFTString);
+        if(tiles->CreateField(&lastModifiedField) != OGRERR_NONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TileStore::TileStore(const std::string &path) :
+    m_path(path),
+    m_tiles(nullptr)
+{
+}
+
+bool TileStore::open(bool create)
+{
+    if(nullptr != m_tiles) {
+        return true;
+    }
+
+    if(Folder::isExists(m_path)) {
+        m_DS = static_cast<GDALDataset*>(GDALOpenEx(m_path.c_str(),
+                                GDAL_OF_VECTOR|GDAL_OF_UPDATE, nullptr,
+                                nullptr, nullptr));
+        if(nullptr == m_DS) {
+            return errorMessage(_("Failed to open tile store %s"),
+                                m_path.c_str());
+        }
+        m_tiles = m_DS->GetLayerByName(TILES_TABLE);
+        if(nullptr == m_tiles) {
+            return false;
+        }
+        if(!addValidatorFields(m_tiles)) {
+            m_tiles = nullptr;
+            return errorMessage(CPLGetLastErrorMsg());
+        }
+        return true;
+    }
+
+    if(!create) {
+        return false;
+    }
+
+    GDALDriver *driver = Filter::getGDALDriver(CAT_CONTAINER_SQLITE);
+    if(nullptr == driver) {
+        return errorMessage(_("SQLite driver is not available"));
+    }
+
+    m_DS = driver->Create(m_path.c_str(), 0, 0, 0, GDT_Unknown, nullptr);
+    if(nullptr == m_DS) {
+        return errorMessage(_("Failed to create tile store %s"), m_path.c_str());
+    }
+
+    OGRLayer *metadata = m_DS->CreateLayer(METADATA_TABLE, nullptr, wkbNone,
+                                           nullptr);
+    m_tiles = m_DS->CreateLayer(TILES_TABLE, nullptr, wkbNone, nullptr);
+    if(nullptr == metadata || nullptr == m_tiles) {
+        m_tiles = nullptr;
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+
+    OGRFieldDefn nameField("name", OFTString);
+    OGRFieldDefn valueField("value", OFTString);
+    OGRFieldDefn zoomField(ZOOM_KEY, OFTInteger);
+    OGRFieldDefn columnField(COLUMN_KEY, OFTInteger);
+    OGRFieldDefn rowField(ROW_KEY, OFTInteger);
+    OGRFieldDefn dataField(DATA_KEY, OFTBinary);
+    OGRFieldDefn expiresField(EXPIRES_KEY, OFTInteger64);
+    if(metadata->CreateField(&nameField) != OGRERR_NONE ||
+       metadata->CreateField(&valueField) != OGRERR_NONE ||
+       m_tiles->CreateField(&zoomField) != OGRERR_NONE ||
+       m_tiles->CreateField(&columnField) != OGRERR_NONE ||
+       m_tiles->CreateField(&rowField) != OGRERR_NONE ||
+       m_tiles->CreateField(&dataField) != OGRERR_NONE ||
+       m_tiles->CreateField(&expiresField) != OGRERR_NONE ||
+       !addValidatorFields(m_tiles)) {
+        m_tiles = nullptr;
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+
+    m_DS->ExecuteSQL(CPLSPrintf("CREATE UNIQUE INDEX IF NOT EXISTS tile_index "
+                                "ON %s (%s, %s, %s)", TILES_TABLE, ZOOM_KEY,
+                                COLUMN_KEY, ROW_KEY), nullptr, nullptr);
+    return true;
+}
+
+OGRLayer *TileStore::jobsTable(bool create)
+{
+    OGRLayer *jobs = m_DS->GetLayerByName(JOBS_TABLE);
+    if(nullptr != jobs || !create) {
+        return jobs;
+    }
+
+    jobs = m_DS->CreateLayer(JOBS_TABLE, nullptr, wkbNone, nullptr);
+    if(nullptr == jobs) {
+        errorMessage(CPLGetLastErrorMsg());
+        return nullptr;
+    }
+
+    OGRFieldDefn jobField(JOB_KEY, OFTString);
+    OGRFieldDefn zoomField(ZOOM_KEY, OFTInteger);
+    OGRFieldDefn minColumnField(MIN_COLUMN_KEY, OFTInteger);
+    OGRFieldDefn minRowField(MIN_ROW_KEY, OFTInteger);
+    OGRFieldDefn maxColumnField(MAX_COLUMN_KEY, OFTInteger);
+    OGRFieldDefn maxRowField(MAX_ROW_KEY, OFTInteger);
+    OGRFieldDefn doneField(DONE_KEY, OFTBinary);
+    if(jobs->CreateField(&jobField) != OGRERR_NONE ||
+       jobs->CreateField(&zoomField) != OGRERR_NONE ||
+       jobs->CreateField(&minColumnField) != OGRERR_NONE ||
+       jobs->CreateField(&minRowField) != OGRERR_NONE ||
+       jobs->CreateField(&maxColumnField) != OGRERR_NONE ||
+       jobs->CreateField(&maxRowField) != OGRERR_NONE ||
+       jobs->CreateField(&doneField) != OGRERR_NONE) {
+        errorMessage(CPLGetLastErrorMsg());
+        return nullptr;
+    }
+    return jobs;
+}
+
+/**
+ * @brief TileStore::loadJob Load saved job levels and downloaded tiles.
+ * @param job Job with identifier set
+ * @return False if there is no such job in store.
+ */
+bool TileStore::loadJob(CacheAreaJob &job)
+{
+    MutexHolder holder(m_mutex);
+    if(!open(false)) {
+        return false;
+    }
+    OGRLayer *jobs = jobsTable(false);
+    if(nullptr == jobs) {
+        return false;
+    }
+
+    std::vector<CacheAreaJob::Level> levels;
+    jobs->SetAttributeFilter(CPLSPrintf("%s = '%s'", JOB_KEY, job.id().c_str()));
+    jobs->ResetReading();
+    FeaturePtr feature;
+    while((feature = jobs->GetNextFeature())) {
+        CacheAreaJob::Level level;
+        level.z = static_cast<unsigned char>(feature->GetFieldAsInteger(ZOOM_KEY));
+        level.minX = feature->GetFieldAsInteger(MIN_COLUMN_KEY);
+        level.minY = feature->GetFieldAsInteger(MIN_ROW_KEY);
+        level.maxX = feature->GetFieldAsInteger(MAX_COLUMN_KEY);
+        level.maxY = feature->GetFieldAsInteger(MAX_ROW_KEY);
+        int size = 0;
+        GByte *done = feature->GetFieldAsBinary(
+                    feature->GetFieldIndex(DONE_KEY), &size);
+        level.done.assign(done, done + size);
+        levels.push_back(level);
+    }
+    jobs->SetAttributeFilter(nullptr);
+
+    if(levels.empty()) {
+        return false;
+    }
+    job.setLevels(levels);
+    return true;
+}
+
+/**
+ * @brief TileStore::saveJob Save job levels and downloaded tiles, replacing
+ * previous state of the job.
+ * @param job Job to save
+ * @return True on success.
+ */
+bool TileStore::saveJob(const CacheAreaJob &job)
+{
+    std::vector<CacheAreaJob::Level> levels = job.levels();
+
+    MutexHolder holder(m_mutex);
+    if(!open(true)) {
+        return false;
+    }
+    OGRLayer *jobs = jobsTable(true);
+    if(nullptr == jobs) {
+        return false;
+    }
+
+    bool result = true;
+    m_DS->StartTransaction();
+    m_DS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = '%s'", JOBS_TABLE,
+                                JOB_KEY, job.id().c_str()), nullptr, nullptr);
+    for(const CacheAreaJob::Level &level : levels) {
+        FeaturePtr feature = OGRFeature::CreateFeature(jobs->GetLayerDefn());
+        feature->SetField(JOB_KEY, job.id().c_str());
+        feature->SetField(ZOOM_KEY, level.z);
+        feature->SetField(MIN_COLUMN_KEY, level.minX);
+        feature->SetField(MIN_ROW_KEY, level.minY);
+        feature->SetField(MAX_COLUMN_KEY, level.maxX);
+        feature->SetField(MAX_ROW_KEY, level.maxY);
+        feature->SetField(feature->GetFieldIndex(DONE_KEY),
+                          static_cast<int>(level.done.size()),
+                          level.done.data());
+        if(jobs->CreateFeature(feature) != OGRERR_NONE) {
+            result = false;
+        }
+    }
+    if(m_DS->CommitTransaction() != OGRERR_NONE) {
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+    return result;
+}
+
+void TileStore::deleteJob(const std::string &id)
+{
+    MutexHolder holder(m_mutex);
+    if(!open(false) || nullptr == jobsTable(false)) {
+        return;
+    }
+    m_DS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = '%s'", JOBS_TABLE,
+                                JOB_KEY, id.c_str()), nullptr, nullptr);
+}
+
+void TileStore::close()
+{
+    MutexHolder holder(m_mutex);
+    m_tiles = nullptr;
+    m_DS = nullptr;
+}
+
+FeaturePtr TileStore::getTileFeature(const Tile &tile, bool fresh)
+{
+    std::string filter = CPLSPrintf("%s = %d AND %s = %d AND %s = %d",
+                                    ZOOM_KEY, tile.z, COLUMN_KEY, tile.x,
+                                    ROW_KEY, tile.y);
+    if(fresh) {
+        filter += CPLSPrintf(" AND %s > " CPL_FRMT_GIB, EXPIRES_KEY,
+                             static_cast<GIntBig>(time(nullptr)));
+    }
+    m_tiles->SetAttributeFilter(filter.c_str());
+    FeaturePtr out(m_tiles->GetNextFeature());
+    m_tiles->SetAttributeFilter(nullptr);
+    return out;
+}
+
+/**
+ * @brief TileStore::isFresh Check if tile is in store and not expired.
+ * @param tile Tile with TMS row numbering
+ * @return True if tile need not be downloaded.
+ */
+bool TileStore::isFresh(const Tile &tile)
+{
+    MutexHolder holder(m_mutex);
+    if(!open(false)) {
+        return false;
+    }
+    return static_cast<bool>(getTileFeature(tile, true));
+}
+
+/**
+ * @brief TileStore::tile Get not expired tile image.
+ * @param tile Tile with TMS row numbering
+ * @param data Encoded image as downloaded
+ * @return True if tile is found.
+ */
+bool TileStore::tile(const Tile &tile, std::vector<GByte> &data)
+{
+    MutexHolder holder(m_mutex);
+    if(!open(false)) {
+        return false;
+    }
+    FeaturePtr feature = getTileFeature(tile, true);
+    if(!feature) {
+        return false;
+    }
+    int size = 0;
+    GByte *blob = feature->GetFieldAsBinary(feature->GetFieldIndex(DATA_KEY),
+                                            &size);
+    data.assign(blob, blob + size);
+    return size > 0;
+}
+
+/**
+ * @brief TileStore::put Insert or replace tiles in one transaction.
+ * @param tiles Tiles with TMS row numbering and encoded images
+ * @param expires Time the tiles expire, in seconds since epoch
+ * @return True on success.
+ */
+bool TileStore::put(const std::vector<TileData> &tiles, GIntBig expires)
+{
+    if(tiles.empty()) {
+        return true;
+    }
+
+    MutexHolder holder(m_mutex);
+    if(!open(true)) {
+        return false;
+    }
+
+    bool result = true;
+    m_DS->StartTransaction();
+    for(const TileData &data : tiles) {
+        FeaturePtr feature = getTileFeature(data.tile, false);
+        bool exists = static_cast<bool>(feature);
+        if(!exists) {
+            feature = OGRFeature::CreateFeature(m_tiles->GetLayerDefn());
+            feature->SetField(ZOOM_KEY, data.tile.z);
+            feature->SetField(COLUMN_KEY, data.tile.x);
+            feature->SetField(ROW_KEY, data.tile.y);
+        }
+        feature->SetField(feature->GetFieldIndex(DATA_KEY), data.size,
+                          data.data);
+        feature->SetField(EXPIRES_KEY, expires);
+        if(nullptr != data.etag) {
+            feature->SetField(ETAG_KEY, data.etag);
+        }
+        else {
+            feature->UnsetField(feature->GetFieldIndex(ETAG_KEY));
+        }
+        if(nullptr != data.lastModified) {
+            feature->SetField(LAST_MODIFIED_KEY, data.lastModified);
+        }
+        else {
+            feature->UnsetField(feature->GetFieldIndex(LAST_MODIFIED_KEY));
+        }
+
+        OGRErr err = exists ? m_tiles->SetFeature(feature) :
+                              m_tiles->CreateFeature(feature);
+        if(err != OGRERR_NONE) {
+            result = false;
+        }
+    }
+    if(m_DS->CommitTransaction() != OGRERR_NONE) {
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+
+    return result;
+}
+
+/**
+ * @brief TileStore::validators Get ETag and Last-Modified of the tile in
+ * store. The tile may be expired.
+ * @param tile Tile with TMS row numbering
+ * @param etag ETag value or empty string
+ * @param lastModified Last-Modified value or empty string
+ * @return True if tile is in store and has at least one of values.
+ */
+bool TileStore::validators(const Tile &tile, std::string &etag,
+                           std::string &lastModified)
+{
+    MutexHolder holder(m_mutex);
+    if(!open(false)) {
+        return false;
+    }
+    FeaturePtr feature = getTileFeature(tile, false);
+    if(!feature) {
+        return false;
+    }
+    etag = feature->GetFieldAsString(ETAG_KEY);
+    lastModified = feature->GetFieldAsString(LAST_MODIFIED_KEY);
+    return !etag.empty() || !lastModified.empty();
+}
+
+/**
+ * @brief TileStore::touch Set new expire time of tiles which server reported
+ * as not modified.
+ * @param tiles Tiles with TMS row numbering
+ * @param expires Time the tiles expire, in seconds since epoch
+ * @return True on success.
+ */
+bool TileStore::touch(const std::vector<Tile> &tiles, GIntBig expires)
+{
+    if(tiles.empty()) {
+        return true;
+    }
+
+    MutexHolder holder(m_mutex);
+    if(!open(false)) {
+        return false;
+    }
+
+    m_DS->StartTransaction();
+    for(const Tile &tile : tiles) {
+        m_DS->ExecuteSQL(CPLSPrintf("UPDATE %s SET %s = " CPL_FRMT_GIB
+                                    " WHERE %s = %d AND %s = %d AND %s = %d",
+                                    TILES_TABLE, EXPIRES_KEY, expires,
+                                    ZOOM_KEY, tile.z, COLUMN_KEY, tile.x,
+                                    ROW_KEY, tile.y), nullptr, nullptr);
+    }
+    if(m_DS->CommitTransaction() != OGRERR_NONE) {
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+    return true;
+}
+
+} // namespace ngs
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSTILESTORE_H
+#define NGSTILESTORE_H
+
+// std
+#include <vector>
+
+#include "dataset.h"
+#include "geometry.h"
+#include "util/mutex.h"
+
+namespace ngs {
+
+constexpr const char *TILE_STORE_EXT = "mbtiles";
+
+/**
+ * @brief The CacheAreaJob class Tiles of area caching job: tile range per
+ * zoom level and bitmap of downloaded tiles. The job is saved to tile store,
+ * so stopped job resumes from the tiles not downloaded yet.
+ */
+class CacheAreaJob
+{
+public:
+    typedef struct _level {
+        unsigned char z;
+        int minX, minY, maxX, maxY; // Inclusive
+        std::vector<GByte> done;
+    } Level;
+
+public:
+    explicit CacheAreaJob(const std::string &id = "");
+    CacheAreaJob(const CacheAreaJob&) = delete;
+    CacheAreaJob &operator=(const CacheAreaJob&) = delete;
+    const std::string &id() const { return m_id; }
+    void setId(const std::string &id) { m_id = id; }
+    void addLevel(unsigned char z, int minX, int minY, int maxX, int maxY);
+    std::vector<Level> levels() const;
+    void setLevels(const std::vector<Level> &levels);
+    bool isDone(const Tile &tile) const;
+    void setDone(const std::vector<Tile> &tiles);
+    size_t tileCount() const;
+    size_t doneCount() const;
+
+private:
+    const Level *level(unsigned char z) const;
+
+private:
+    std::string m_id;
+    std::vector<Level> m_levels;
+    Mutex m_mutex;
+};
+
+/**
+ * @brief The TileStore class Raster tiles cache in one SQLite file with
+ * MBTiles tables layout. Tile rows have TMS numbering (origin at bottom) as in
+ * MBTiles. Each tile has the time it expires, so cache checks are index
+ * lookups instead of file system calls. ETag and Last-Modified of tile response
+ * are kept to revalidate expired tile. The file is created on first write.
+ */
+class TileStore
+{
+public:
+    typedef struct _tileData {
+        Tile tile;
+        const GByte *data;
+        int size;
+        const char *etag; // May be null
+        const char *lastModified; // May be null
+    } TileData;
+
+public:
+    explicit TileStore(const std::string &path);
+    const std::string &path() const { return m_path; }
+    bool isFresh(const Tile &tile);
+    bool tile(const Tile &tile, std::vector<GByte> &data);
+    bool put(const std::vector<TileData> &tiles, GIntBig expires);
+    bool validators(const Tile &tile, std::string &etag,
+                    std::string &lastModified);
+    bool touch(const std::vector<Tile> &tiles, GIntBig expires);
+    bool loadJob(CacheAreaJob &job);
+    bool saveJob(const CacheAreaJob &job);
+    void deleteJob(const std::string &id);
+    void close();
+
+private:
+    bool open(bool create);
+    OGRLayer *jobsTable(bool create);
+    FeaturePtr getTileFeature(const Tile &tile, bool fresh);
+
+private:
+    std::string m_path;
+    GDALDatasetPtr m_DS;
+    OGRLayer *m_tiles;
+    Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSTILESTORE_H
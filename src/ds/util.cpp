@@ -21,11 +21,20 @@
 
 #include "util.h"
 
+// std
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include "api_priv.h"
 #include "catalog/catalog.h"
 #include "catalog/file.h"
 #include "catalog/folder.h"
 #include "catalog/ngw.h"
 #include "util/error.h"
+#include "util/notify.h"
+#include "util/threadpool.h"
+#include "util/trace.h"
 #include "util/url.h"
 
 namespace ngs {
@@ -90,7 +99,7 @@ void setMetadata(const ObjectPtr &object, std::vector<fieldData> fields,
     for(const auto &it : options) {
         if(comparePart(it.first, USER_PREFIX_KEY, USER_PREFIX_KEY_LEN)) {
             table->setProperty(it.first.substr(USER_PREFIX_KEY_LEN),
-                it.second, USER_KEY);
+                it.second.text, USER_KEY);
         }
     }
 }
@@ -154,19 +163,14 @@ OGRLayer *createEditHistoryTable(GDALDataset *ds, const std::string &name)
     return logLayer;
 }
 
-std::string downloadAttachment(StoreObject *storeObject, GIntBig fid, GIntBig aid,
-                               const Progress &progress)
+/**
+ * @brief tableConnectionUrl Url of NextGIS Web connection defined in table
+ * properties.
+ * @param table Table to get connection
+ * @return Url or empty string if connection is not defined or not present
+ */
+static std::string tableConnectionUrl(Table *table)
 {
-    if(nullptr == storeObject) {
-        return "";
-    }
-
-    auto table = dynamic_cast<Table*>(storeObject);
-    if(nullptr == table) {
-        return "";
-    }
-
-    resetError();
     auto connectionPath = table->property(NGW_CONNECTION, "", NG_ADDITIONS_KEY);
     if(connectionPath.empty()) {
         warningMessage(_("No remote NextGIS Web connection defined in feature class properties"));
@@ -187,7 +191,26 @@ std::string downloadAttachment(StoreObject *storeObject, GIntBig fid, GIntBig ai
         return "";
     }
     conn->fillProperties();
-    auto url = conn->connectionUrl();
+    return conn->connectionUrl();
+}
+
+std::string downloadAttachment(StoreObject *storeObject, GIntBig fid, GIntBig aid,
+                               const Progress &progress)
+{
+    if(nullptr == storeObject) {
+        return "";
+    }
+
+    auto table = dynamic_cast<Table*>(storeObject);
+    if(nullptr == table) {
+        return "";
+    }
+
+    resetError();
+    auto url = tableConnectionUrl(table);
+    if(url.empty()) {
+        return "";
+    }
 
     auto resourceId = table->property(NGW_ID, "", NG_ADDITIONS_KEY);
     auto rid = storeObject->getRemoteId(fid);
@@ -197,12 +220,943 @@ std::string downloadAttachment(StoreObject *storeObject, GIntBig fid, GIntBig ai
                                     std::to_string(rid), std::to_string(arid));
 
     auto dstPath = table->getAttachmentPath(fid, aid, true);
-    if(http::getFile(url, dstPath, progress)) {
+    auto partPath = dstPath + PART_FILE_SUFFIX;
+    Options options;
+    options.add("RESUME", true);
+    if(http::getFile(attachmentUrl, partPath, progress, options) &&
+            File::renameFile(partPath, dstPath)) {
         return dstPath;
     }
     return "";
 }
 
+//------------------------------------------------------------------------------
+// Feature edits upload
+//------------------------------------------------------------------------------
+
+typedef struct _featureEdit {
+    GIntBig fid;
+    GIntBig rid;
+    enum ngsChangeCode code;
+} FeatureEdit;
+
+/**
+ * @brief featureEdits Merge edit log feature operations to one operation per
+ * feature. Operations after delete all features are left in log.
+ */
+static std::vector<FeatureEdit> featureEdits(
+        const std::vector<ngsEditOperation> &operations)
+{
+    std::vector<FeatureEdit> out;
+    std::map<GIntBig, size_t> index;
+    for(const ngsEditOperation &op : operations) {
+        if(op.code == CC_DELETEALL_FEATURES) {
+            break;
+        }
+        if(op.aid != NOT_FOUND || (op.code != CC_CREATE_FEATURE &&
+                op.code != CC_CHANGE_FEATURE && op.code != CC_DELETE_FEATURE)) {
+            continue;
+        }
+
+        auto it = index.find(op.fid);
+        if(it == index.end()) {
+            index[op.fid] = out.size();
+            out.push_back({op.fid, op.rid, op.code});
+            continue;
+        }
+
+        FeatureEdit &edit = out[it->second];
+        if(op.rid != NOT_FOUND) {
+            edit.rid = op.rid;
+        }
+        if(op.code == CC_DELETE_FEATURE) {
+            // Feature was never sent, nothing to delete on server
+            edit.code = edit.code == CC_CREATE_FEATURE ? CC_NOP :
+                                                         CC_DELETE_FEATURE;
+        }
+        else if(op.code == CC_CREATE_FEATURE) {
+            edit.code = CC_CREATE_FEATURE;
+        }
+    }
+
+    for(FeatureEdit &edit : out) {
+        if(edit.rid != NOT_FOUND) {
+            continue;
+        }
+        if(edit.code == CC_CHANGE_FEATURE) {
+            edit.code = CC_CREATE_FEATURE;
+        }
+        else if(edit.code == CC_DELETE_FEATURE) {
+            edit.code = CC_NOP;
+        }
+    }
+    return out;
+}
+
+static CPLJSONObject featureToJson(const FeaturePtr &feature,
+                                   const std::vector<Field> &fields)
+{
+    CPLJSONObject out;
+    CPLJSONObject values("fields", out);
+    for(const Field &field : fields) {
+        int index = feature->GetFieldIndex(field.m_name.c_str());
+        if(index < 0) {
+            continue;
+        }
+        const std::string &name = field.m_originalName;
+        if(!feature->IsFieldSetAndNotNull(index)) {
+            values.AddNull(name);
+            continue;
+        }
+
+        switch(field.m_type) {
+        case OFTInteger:
+            values.Add(name, feature->GetFieldAsInteger(index));
+            break;
+        case OFTInteger64:
+            values.Add(name, static_cast<GInt64>(
+                           feature->GetFieldAsInteger64(index)));
+            break;
+        case OFTReal:
+            values.Add(name, feature->GetFieldAsDouble(index));
+            break;
+        case OFTDate:
+        case OFTTime:
+        case OFTDateTime:
+        {
+            int year, month, day, hour, minute, tzFlag;
+            float second;
+            feature->GetFieldAsDateTime(index, &year, &month, &day, &hour,
+                                        &minute, &second, &tzFlag);
+            CPLJSONObject value;
+            if(field.m_type != OFTTime) {
+                value.Add("year", year);
+                value.Add("month", month);
+                value.Add("day", day);
+            }
+            if(field.m_type != OFTDate) {
+                value.Add("hour", hour);
+                value.Add("minute", minute);
+                value.Add("second", static_cast<int>(second));
+            }
+            values.Add(name, value);
+            break;
+        }
+        default:
+            values.Add(name, feature->GetFieldAsString(index));
+        }
+    }
+
+    OGRGeometry *geometry = feature->GetGeometryRef();
+    if(nullptr != geometry) {
+        char *wkt = nullptr;
+        if(geometry->exportToWkt(&wkt, wkbVariantIso) == OGRERR_NONE) {
+            out.Add("geom", wkt);
+        }
+        CPLFree(wkt);
+    }
+    return out;
+}
+
+static bool patchEdits(Table *table, const std::string &url,
+                       const std::string &resourceId,
+                       const std::string &payload,
+                       const std::vector<FeatureEdit> &edits, int tries)
+{
+    std::vector<GIntBig> ids;
+    bool result = false;
+    for(int i = 0; i < tries && !result; ++i) {
+        result = patchFeatures(url, resourceId, payload,
+                               http::getGDALHeaders(url).StealList(), ids);
+    }
+    if(!result) {
+        return false;
+    }
+    if(ids.size() != edits.size()) {
+        errorMessage(_("Unexpected features count returned by server"));
+        return false;
+    }
+
+    // Store new remote ids in one transaction
+    Dataset *dataset = dynamic_cast<Dataset*>(table->parent());
+    bool transaction = nullptr != dataset && dataset->startTransaction();
+    for(size_t i = 0; i < edits.size(); ++i) {
+        if(edits[i].code != CC_CREATE_FEATURE) {
+            continue;
+        }
+        FeaturePtr feature = table->getFeature(edits[i].fid);
+        if(feature) {
+            StoreObject::setRemoteId(feature, ids[i]);
+            table->updateFeature(feature, false);
+        }
+    }
+    if(transaction) {
+        dataset->commitTransaction();
+    }
+    return true;
+}
+
+static bool deleteEdits(const std::string &url, const std::string &resourceId,
+                        const std::string &payload, int tries)
+{
+    for(int i = 0; i < tries; ++i) {
+        if(deleteFeatures(url, resourceId, payload,
+                          http::getGDALHeaders(url).StealList())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void deleteEditOperations(Table *table,
+                                 const std::vector<FeatureEdit> &edits)
+{
+    for(const FeatureEdit &edit : edits) {
+        ngsEditOperation op;
+        op.fid = edit.fid;
+        op.aid = NOT_FOUND;
+        op.code = edit.code;
+        op.rid = edit.rid;
+        op.arid = NOT_FOUND;
+        table->deleteEditOperation(op);
+    }
+}
+
+/**
+ * @brief uploadFeatureEdits Send logged feature edits to NextGIS Web with bulk
+ * requests. Created and changed features are sent in PATCH requests, deleted
+ * in DELETE requests, each limited by payload size. Only the failed chunk is
+ * retried, the sent chunks operations are removed from edit log. Attachment
+ * operations and operations after delete all features are left in log.
+ * @param storeObject Store table or feature class with edit log
+ * @param progress Progress and cancel
+ * @param options Options:
+ *   CHUNK_SIZE - Maximum payload size in bytes. Default 1 Mb
+ *   RETRY_COUNT - Tries to send one chunk. Default 3
+ * @return True on success
+ */
+bool uploadFeatureEdits(StoreObject *storeObject, const Progress &progress,
+                        const Options &options)
+{
+    ngsTraceSpan("uploadFeatureEdits");
+    Table *table = dynamic_cast<Table*>(storeObject);
+    if(nullptr == table) {
+        return false;
+    }
+
+    resetError();
+    auto url = tableConnectionUrl(table);
+    if(url.empty()) {
+        return false;
+    }
+    auto resourceId = table->property(NGW_ID, "", NG_ADDITIONS_KEY);
+    size_t chunkSize = static_cast<size_t>(options.asLong("CHUNK_SIZE",
+                                                          SYNC_CHUNK_SIZE));
+    int tries = std::max(1, options.asInt("RETRY_COUNT", SYNC_RETRY_COUNT));
+
+    table->compactEditOperations();
+    std::vector<FeatureEdit> edits = featureEdits(table->editOperations());
+    const std::vector<Field> &fields = table->fields();
+
+    std::vector<FeatureEdit> patchChunk, deleteChunk, nopEdits;
+    std::string patchPayload, deletePayload;
+    double total = edits.size() + 0.0000001;
+    size_t done = 0;
+
+    for(size_t i = 0; i <= edits.size(); ++i) {
+        bool last = i == edits.size();
+        std::string item;
+        enum ngsChangeCode code = CC_NOP;
+        if(!last) {
+            const FeatureEdit &edit = edits[i];
+            code = edit.code;
+            if(code == CC_DELETE_FEATURE) {
+                item = CPLSPrintf("{\"id\":" CPL_FRMT_GIB "}", edit.rid);
+            }
+            else if(code != CC_NOP) {
+                FeaturePtr feature = table->getFeature(edit.fid);
+                if(!feature) {
+                    code = CC_NOP;
+                }
+                else {
+                    CPLJSONObject json = featureToJson(feature, fields);
+                    if(code == CC_CHANGE_FEATURE) {
+                        json.Add("id", static_cast<GInt64>(edit.rid));
+                    }
+                    item = json.Format(CPLJSONObject::Plain);
+                }
+            }
+            if(code == CC_NOP) {
+                nopEdits.push_back(edit);
+            }
+        }
+
+        bool isPatch = code == CC_CREATE_FEATURE || code == CC_CHANGE_FEATURE;
+        if(!patchChunk.empty() && (last || (isPatch &&
+                patchPayload.size() + item.size() + 2 > chunkSize))) {
+            if(!patchEdits(table, url, resourceId, patchPayload + "]",
+                           patchChunk, tries)) {
+                return false;
+            }
+            deleteEditOperations(table, patchChunk);
+            done += patchChunk.size();
+            patchChunk.clear();
+        }
+
+        bool isDelete = code == CC_DELETE_FEATURE;
+        if(!deleteChunk.empty() && (last || (isDelete &&
+                deletePayload.size() + item.size() + 2 > chunkSize))) {
+            if(!deleteEdits(url, resourceId, deletePayload + "]", tries)) {
+                return false;
+            }
+            deleteEditOperations(table, deleteChunk);
+            done += deleteChunk.size();
+            deleteChunk.clear();
+        }
+
+        if(!progress.onProgress(COD_IN_PROCESS, done / total,
+                                _("Send features edits..."))) {
+            return false;
+        }
+
+        if(isPatch) {
+            patchPayload = (patchChunk.empty() ? "[" : patchPayload + ",") + item;
+            patchChunk.push_back(edits[i]);
+        }
+        else if(isDelete) {
+            deletePayload = (deleteChunk.empty() ? "[" : deletePayload + ",") + item;
+            deleteChunk.push_back(edits[i]);
+        }
+    }
+
+    deleteEditOperations(table, nopEdits);
+    progress.onProgress(COD_FINISHED, 1.0, _("Features edits sent"));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Feature changes download
+//------------------------------------------------------------------------------
+
+/**
+ * @brief cursorValue Format feature field JSON value for NGW filter parameter.
+ */
+static std::string cursorValue(const CPLJSONObject &value)
+{
+    switch(value.GetType()) {
+    case CPLJSONObject::Integer:
+    case CPLJSONObject::Long:
+        return std::to_string(value.ToLong());
+    case CPLJSONObject::Double:
+        return CPLSPrintf("%.17g", value.ToDouble());
+    case CPLJSONObject::Object:
+        return CPLSPrintf("%04d-%02d-%02dT%02d:%02d:%02d",
+                          value.GetInteger("year"), value.GetInteger("month"),
+                          value.GetInteger("day"), value.GetInteger("hour"),
+                          value.GetInteger("minute"), value.GetInteger("second"));
+    default:
+        return value.ToString();
+    }
+}
+
+static void jsonToFeature(const CPLJSONObject &json,
+                          const std::vector<Field> &fields, FeaturePtr &feature)
+{
+    CPLJSONObject values = json.GetObj("fields");
+    for(const Field &field : fields) {
+        int index = feature->GetFieldIndex(field.m_name.c_str());
+        if(index < 0) {
+            continue;
+        }
+        CPLJSONObject value = values.GetObj(field.m_originalName);
+        if(!value.IsValid() || value.GetType() == CPLJSONObject::Null) {
+            feature->SetFieldNull(index);
+            continue;
+        }
+
+        switch(field.m_type) {
+        case OFTInteger:
+            feature->SetField(index, value.ToInteger());
+            break;
+        case OFTInteger64:
+            feature->SetField(index, value.ToLong());
+            break;
+        case OFTReal:
+            feature->SetField(index, value.ToDouble());
+            break;
+        case OFTDate:
+        case OFTTime:
+        case OFTDateTime:
+            feature->SetField(index, value.GetInteger("year"),
+                              value.GetInteger("month"),
+                              value.GetInteger("day"),
+                              value.GetInteger("hour"),
+                              value.GetInteger("minute"),
+                              static_cast<float>(value.GetInteger("second")));
+            break;
+        default:
+            feature->SetField(index, value.ToString().c_str());
+        }
+    }
+
+    std::string wkt = json.GetString("geom");
+    if(!wkt.empty()) {
+        OGRGeometry *geometry = nullptr;
+        const char *wktPtr = wkt.c_str();
+        if(OGRGeometryFactory::createFromWkt(wktPtr, nullptr, &geometry) ==
+                OGRERR_NONE) {
+            feature->SetGeometryDirectly(geometry);
+        }
+    }
+}
+
+/**
+ * @brief downloadFeatureChanges Download features changed on NextGIS Web since
+ * last download. The last value of cursor field is stored in table properties
+ * and only features with greater value are requested next time. The cursor
+ * field should be a version number or modification time field maintained on
+ * server. Without cursor field all features are requested, this refreshes the
+ * region set by extent. Features are matched to local ones by remote id and
+ * the changes are not logged. Deleted on server features are not detected.
+ * @param storeObject Store table or feature class linked to NextGIS Web layer
+ * @param progress Progress and cancel
+ * @param options Options:
+ *   CURSOR_FIELD - Server field name used as sync cursor. Default is stored in
+ *     NGW_SYNC_CURSOR_FIELD table property
+ *   MINX, MINY, MAXX, MAXY - Request only features intersecting this extent.
+ *     In store spatial reference
+ *   PAGE_SIZE - Features count per request. Default 1000
+ *   RESET_CURSOR - Download all features ignoring stored cursor. Default NO
+ * @return True on success
+ */
+bool downloadFeatureChanges(StoreObject *storeObject, const Progress &progress,
+                            const Options &options)
+{
+    ngsTraceSpan("downloadFeatureChanges");
+    Table *table = dynamic_cast<Table*>(storeObject);
+    if(nullptr == table) {
+        return false;
+    }
+
+    resetError();
+    auto url = tableConnectionUrl(table);
+    if(url.empty()) {
+        return false;
+    }
+    auto resourceId = table->property(NGW_ID, "", NG_ADDITIONS_KEY);
+    std::string cursorField = options.asString("CURSOR_FIELD",
+        table->property(SYNC_CURSOR_FIELD_KEY, "", NG_ADDITIONS_KEY));
+    std::string cursor;
+    if(!cursorField.empty() && !options.asBool("RESET_CURSOR", false)) {
+        cursor = table->property(SYNC_CURSOR_KEY, "", NG_ADDITIONS_KEY);
+    }
+    int pageSize = std::max(1, options.asInt("PAGE_SIZE", SYNC_PAGE_SIZE));
+
+    std::string query = CPLSPrintf("?geom_format=wkt&extensions=&srs=%d",
+                                   DEFAULT_EPSG);
+    if(!cursorField.empty()) {
+        query += "&order_by=" + cursorField;
+        if(!cursor.empty()) {
+            char *escaped = CPLEscapeString(cursor.c_str(), -1, CPLES_URL);
+            query += "&fld_" + cursorField + "__gt=" + escaped;
+            CPLFree(escaped);
+        }
+    }
+    if(options.hasKey("MINX") && options.hasKey("MINY") &&
+       options.hasKey("MAXX") && options.hasKey("MAXY")) {
+        double minX = options.asDouble("MINX", 0.0);
+        double minY = options.asDouble("MINY", 0.0);
+        double maxX = options.asDouble("MAXX", 0.0);
+        double maxY = options.asDouble("MAXY", 0.0);
+        char *escaped = CPLEscapeString(
+            CPLSPrintf("POLYGON((%.17g %.17g,%.17g %.17g,%.17g %.17g,%.17g %.17g,%.17g %.17g))",
+                       minX, minY, maxX, minY, maxX, maxY, minX, maxY, minX, minY),
+            -1, CPLES_URL);
+        query += std::string("&intersects=") + escaped;
+        CPLFree(escaped);
+    }
+
+    const std::vector<Field> &fields = table->fields();
+    Dataset *dataset = dynamic_cast<Dataset*>(table->parent());
+    // Changed features are found by remote id in memory
+    StoreRemoteIdsHolder remoteIds(storeObject);
+    std::string lastCursor = cursor;
+    GIntBig count = 0;
+    for(int offset = 0;; offset += pageSize) {
+        std::string pageUrl = getFeaturesUrl(url, resourceId) + query +
+                CPLSPrintf("&limit=%d&offset=%d", pageSize, offset);
+        CPLJSONDocument pageReq;
+        if(!pageReq.LoadUrl(pageUrl, http::getGDALHeaders(url))) {
+            errorMessage(_("Download features from feature class %s failed"),
+                         resourceId.c_str());
+            return false;
+        }
+
+        CPLJSONArray features = pageReq.GetRoot().ToArray();
+        bool transaction = nullptr != dataset && dataset->startTransaction();
+        for(int i = 0; i < features.Size(); ++i) {
+            CPLJSONObject json = features[i];
+            GIntBig rid = json.GetLong("id", NOT_FOUND);
+            if(rid == NOT_FOUND) {
+                continue;
+            }
+
+            FeaturePtr feature = storeObject->getFeatureByRemoteId(rid);
+            bool exists = static_cast<bool>(feature);
+            if(!exists) {
+                feature = table->createFeature();
+                StoreObject::setRemoteId(feature, rid);
+            }
+            jsonToFeature(json, fields, feature);
+            if(exists) {
+                table->updateFeature(feature, false);
+            }
+            else {
+                table->insertFeature(feature, false);
+            }
+
+            if(!cursorField.empty()) {
+                lastCursor = cursorValue(json.GetObj("fields/" + cursorField));
+            }
+        }
+        if(transaction) {
+            dataset->commitTransaction();
+        }
+
+        count += features.Size();
+        if(!progress.onProgress(COD_IN_PROCESS, 0.0,
+                                CPLSPrintf(_("Downloaded %s features"),
+                                           std::to_string(count).c_str()))) {
+            return false;
+        }
+
+        if(features.Size() < pageSize) {
+            break;
+        }
+    }
+
+    if(!cursorField.empty()) {
+        table->setProperty(SYNC_CURSOR_FIELD_KEY, cursorField, NG_ADDITIONS_KEY);
+        table->setProperty(SYNC_CURSOR_KEY, lastCursor, NG_ADDITIONS_KEY);
+    }
+    progress.onProgress(COD_FINISHED, 1.0, _("Feature changes downloaded"));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Attachments transfer
+//------------------------------------------------------------------------------
+
+class AttachmentTransferData : public ThreadData {
+public:
+    AttachmentTransferData(const ngsEditOperation &op, bool upload) :
+        ThreadData(false), m_op(op), m_upload(upload), m_size(0),
+        m_result(NOT_FOUND), m_done(false) {}
+    ngsEditOperation m_op;
+    bool m_upload;
+    std::string m_url, m_resourceId, m_path, m_name, m_description;
+    GIntBig m_size;
+    GIntBig m_result;
+    bool m_done;
+};
+
+static bool attachmentTransferThreadFunc(ThreadData *threadData)
+{
+    AttachmentTransferData *data =
+            dynamic_cast<AttachmentTransferData*>(threadData);
+    if(nullptr == data) {
+        return true;
+    }
+
+    auto featureId = std::to_string(data->m_op.rid);
+    if(!data->m_upload) {
+        // Partially downloaded file is continued on retry and next sync
+        auto partPath = data->m_path + PART_FILE_SUFFIX;
+        Options options;
+        options.add("RESUME", true);
+        if(!http::getFile(getAttachmentDownloadUrl(data->m_url,
+                                                   data->m_resourceId, featureId,
+                                                   std::to_string(data->m_op.arid)),
+                          partPath, Progress(), options)) {
+            return false;
+        }
+        data->m_done = File::renameFile(partPath, data->m_path);
+        return data->m_done;
+    }
+
+    auto uploadInfo = http::uploadFile(getUploadUrl(data->m_url), data->m_path);
+    auto uploadMetaArray = uploadInfo.GetArray("upload_meta");
+    if(uploadMetaArray.Size() < 1) {
+        return false;
+    }
+    auto uploadMeta = uploadMetaArray[0];
+
+    CPLJSONObject newAttachment;
+    newAttachment.Set("name", data->m_name);
+    newAttachment.Set("size", uploadMeta.GetLong("size"));
+    newAttachment.Set("description", data->m_description);
+    newAttachment.Set("mime_type", uploadMeta.GetString("mime_type"));
+
+    CPLJSONObject fileUpload("file_upload", newAttachment);
+    fileUpload.Set("id", uploadMeta.GetString("id"));
+    fileUpload.Set("size", uploadMeta.GetLong("size"));
+
+    data->m_result = addAttachment(data->m_url, data->m_resourceId, featureId,
+                                   newAttachment.Format(CPLJSONObject::Plain),
+                                   http::getGDALHeaders(data->m_url).StealList());
+    data->m_done = data->m_result != NOT_FOUND;
+    return data->m_done;
+}
+
+/**
+ * @brief transferAttachments Upload new attachments to NextGIS Web and
+ * download attachments missing locally. Transfers run concurrently, the
+ * progress reports the share of finished transfers. Interrupted downloads are
+ * continued from the downloaded part on retry or next call. The remote ids of
+ * uploaded attachments are stored and their operations are removed from edit
+ * log after all transfers finish.
+ * @param storeObject Store table or feature class with attachments
+ * @param progress Progress and cancel
+ * @param options Options:
+ *   UPLOAD - Upload attachments created locally. Default YES
+ *   DOWNLOAD - Download attachments absent locally. Default YES
+ *   THREAD_COUNT - Concurrent transfers count. Default 4
+ *   RETRY_COUNT - Tries for one transfer. Default 3
+ * @return True if all attachments transferred
+ */
+bool transferAttachments(StoreObject *storeObject, const Progress &progress,
+                         const Options &options)
+{
+    ngsTraceSpan("transferAttachments");
+    Table *table = dynamic_cast<Table*>(storeObject);
+    if(nullptr == table) {
+        return false;
+    }
+
+    resetError();
+    auto url = tableConnectionUrl(table);
+    if(url.empty()) {
+        return false;
+    }
+    auto resourceId = table->property(NGW_ID, "", NG_ADDITIONS_KEY);
+
+    std::vector<std::unique_ptr<AttachmentTransferData>> transfers;
+    auto addTransfer = [&](const ngsEditOperation &op, bool upload,
+                           const FeaturePtr &attFeature) {
+        AttachmentTransferData *data = new AttachmentTransferData(op, upload);
+        data->m_url = url;
+        data->m_resourceId = resourceId;
+        data->m_path = table->getAttachmentPath(op.fid, op.aid, !upload);
+        data->m_name = attFeature->GetFieldAsString(ATTACH_FILE_NAME_FIELD);
+        data->m_description =
+                attFeature->GetFieldAsString(ATTACH_DESCRIPTION_FIELD);
+        transfers.emplace_back(data);
+    };
+
+    OGRLayer *attTable = table->attachmentsTable();
+    if(nullptr == attTable) {
+        return true;
+    }
+
+    if(options.asBool("UPLOAD", true)) {
+        for(ngsEditOperation op : table->editOperations()) {
+            if(op.code != CC_CREATE_ATTACHMENT) {
+                continue;
+            }
+            // Remote id of feature may be got after the operation logged
+            op.rid = storeObject->getRemoteId(op.fid);
+            FeaturePtr attFeature = attTable->GetFeature(op.aid);
+            if(op.rid == NOT_FOUND || !attFeature) {
+                continue;
+            }
+            addTransfer(op, true, attFeature);
+        }
+    }
+
+    if(options.asBool("DOWNLOAD", true)) {
+        Dataset *dataset = dynamic_cast<Dataset*>(table->parent());
+        std::vector<FeaturePtr> attFeatures;
+        {
+            DatasetExecuteSQLLockHolder holder(dataset);
+            FeaturePtr attFeature;
+            attTable->ResetReading();
+            while((attFeature = attTable->GetNextFeature())) {
+                attFeatures.push_back(attFeature);
+            }
+        }
+
+        for(const FeaturePtr &attFeature : attFeatures) {
+            ngsEditOperation op;
+            op.fid = attFeature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
+            op.aid = attFeature->GetFID();
+            op.code = CC_NOP;
+            op.arid = StoreObject::getRemoteId(attFeature);
+            if(op.arid == NOT_FOUND || Folder::isExists(
+                   table->getAttachmentPath(op.fid, op.aid))) {
+                continue;
+            }
+            op.rid = storeObject->getRemoteId(op.fid);
+            if(op.rid == NOT_FOUND) {
+                continue;
+            }
+            addTransfer(op, false, attFeature);
+        }
+    }
+
+    if(transfers.empty()) {
+        progress.onProgress(COD_FINISHED, 1.0, _("No attachments to transfer"));
+        return true;
+    }
+
+    int threadCount = options.asInt("THREAD_COUNT",
+                                    ATTACHMENTS_TRANSFER_THREAD_COUNT);
+    int tries = std::max(1, options.asInt("RETRY_COUNT", SYNC_RETRY_COUNT));
+    ThreadPool threadPool;
+    threadPool.init(static_cast<unsigned char>(std::max(1, std::min(threadCount, 255))),
+                    attachmentTransferThreadFunc,
+                    static_cast<unsigned char>(std::min(tries, 255)), false,
+                    WorkerClass::NETWORK);
+    for(const auto &transfer : transfers) {
+        threadPool.addThreadData(transfer.get());
+    }
+    threadPool.waitComplete(progress);
+
+    bool result = true;
+    for(const auto &transfer : transfers) {
+        if(!transfer->m_done) {
+            result = false;
+            continue;
+        }
+        if(transfer->m_upload) {
+            storeObject->setAttachmentRemoteId(transfer->m_op.aid,
+                                               transfer->m_result);
+            table->deleteEditOperation(transfer->m_op);
+        }
+    }
+
+    if(result) {
+        progress.onProgress(COD_FINISHED, 1.0, _("Attachments transferred"));
+    }
+    else {
+        errorMessage(_("Not all attachments were transferred"));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Sync scheduler
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The LayersSyncData class Layers of one dataset. They share dataset
+ * connection, so they are synced one by one in one thread.
+ */
+class LayersSyncData : public ThreadData {
+public:
+    explicit LayersSyncData(const Options &options, const Progress &progress) :
+        ThreadData(false), m_options(options), m_progress(progress),
+        m_result(false) {}
+    std::vector<ObjectPtr> m_layers;
+    Options m_options;
+    const Progress &m_progress;
+    bool m_result;
+};
+
+/**
+ * @brief The SyncCancelProgress class Progress of the layer sync steps running
+ * in the sync threads. The caller progress is executed on the caller thread
+ * only, the steps just see its cancel.
+ */
+class SyncCancelProgress : public Progress
+{
+public:
+    explicit SyncCancelProgress(const Progress &progress) :
+        Progress(), m_progress(progress) {}
+    virtual bool onProgress(enum ngsCode status, double complete,
+                            const char *format, ...) const override {
+        ngsUnused(status);
+        ngsUnused(complete);
+        ngsUnused(format);
+        return !m_progress.isCanceled();
+    }
+
+protected:
+    const Progress &m_progress;
+};
+
+static bool hasSyncDirection(const std::string &sync, const char *direction)
+{
+    return compare(sync, SYNC_BIDIRECTIONAL) || compare(sync, direction);
+}
+
+static bool syncLayer(const ObjectPtr &layer, const Progress &progress,
+                      const Options &options)
+{
+    ngsTraceSpan("syncLayer");
+    StoreObject *storeObject = dynamic_cast<StoreObject*>(layer.get());
+    Table *table = dynamic_cast<Table*>(layer.get());
+    if(nullptr == storeObject || nullptr == table) {
+        return true;
+    }
+
+    auto sync = table->property(SYNC_KEY, SYNC_DISABLE, NG_ADDITIONS_KEY);
+    auto syncAttachments = table->property(SYNC_ATT_KEY, SYNC_DISABLE,
+                                          NG_ADDITIONS_KEY);
+    std::string path = layer->fullName();
+    Notify::instance().onNotify(path, CC_SYNC_STARTED);
+    auto start = std::chrono::steady_clock::now();
+
+    // Local edits go first, the attachments need remote ids of new features
+    bool result = true;
+    if(hasSyncDirection(sync, SYNC_UPLOAD)) {
+        result = uploadFeatureEdits(storeObject, progress, options);
+    }
+    if(result && hasSyncDirection(sync, SYNC_DOWNLOAD)) {
+        result = downloadFeatureChanges(storeObject, progress, options);
+    }
+    if(result && !compare(syncAttachments, SYNC_DISABLE)) {
+        Options transferOptions(options);
+        transferOptions.add("UPLOAD", hasSyncDirection(syncAttachments, SYNC_UPLOAD));
+        transferOptions.add("DOWNLOAD", hasSyncDirection(syncAttachments, SYNC_DOWNLOAD));
+        result = transferAttachments(storeObject, progress, transferOptions);
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+    table->setProperty(SYNC_DURATION_KEY, std::to_string(duration),
+                       NG_ADDITIONS_KEY);
+    table->setProperty(SYNC_TIME_KEY, std::to_string(time(nullptr)),
+                       NG_ADDITIONS_KEY);
+    CPLDebug("ngstore", "Sync of %s %s in %lld ms", path.c_str(),
+             result ? "finished" : "failed", static_cast<long long>(duration));
+    Notify::instance().onNotify(path, result ? CC_SYNC_FINISHED : CC_SYNC_FAILED);
+    return result;
+}
+
+static bool layersSyncThreadFunc(ThreadData *threadData)
+{
+    LayersSyncData *data = dynamic_cast<LayersSyncData*>(threadData);
+    if(nullptr == data) {
+        return true;
+    }
+
+    SyncCancelProgress progress(data->m_progress);
+    data->m_result = true;
+    for(const ObjectPtr &layer : data->m_layers) {
+        if(data->m_progress.isCanceled()) {
+            data->m_result = false;
+            break;
+        }
+        if(!syncLayer(layer, progress, data->m_options)) {
+            data->m_result = false;
+        }
+    }
+    // Failed layers are reported and not retried as a whole
+    return true;
+}
+
+/**
+ * @brief syncLayers Sync store layers with NextGIS Web. The layers of
+ * different datasets are synced in parallel, not more than
+ * MAX_SERVER_CONNECTIONS per server. The layers of one dataset are synced one
+ * after another. For each layer the local edits are sent, then remote changes
+ * are downloaded, then the attachments are transferred, according to layer
+ * SYNC and SYNC_ATTACHMENTS properties. Each layer sync start and finish are
+ * notified with CC_SYNC_STARTED and CC_SYNC_FINISHED or CC_SYNC_FAILED codes.
+ * The duration in milliseconds and finish time are stored in NGW_SYNC_DURATION
+ * and NGW_SYNC_TIME layer properties.
+ * @param layers Store tables and feature classes. Layers without sync are
+ * skipped.
+ * @param progress Progress and cancel. Cancel stops the running layer syncs
+ * between requests, the layers not started are not synced.
+ * @param options Options:
+ *   MAX_SERVER_CONNECTIONS - Parallel connections with one server. Layer
+ *   syncs run in parallel up to this count and share it for the attachments
+ *   transfer, so THREAD_COUNT of transferAttachments is lowered. Default 2
+ *   Other options are passed to uploadFeatureEdits, downloadFeatureChanges
+ *   and transferAttachments.
+ * @return True if all layers synced.
+ */
+bool syncLayers(const std::vector<ObjectPtr> &layers, const Progress &progress,
+                const Options &options)
+{
+    resetError();
+    int maxConnections = std::max(1, std::min(
+            options.asInt("MAX_SERVER_CONNECTIONS", SYNC_SERVER_CONNECTIONS),
+            255));
+
+    // Connection urls are resolved here, so the catalog is not loaded from
+    // sync threads.
+    std::map<std::string, std::map<ObjectContainer*, LayersSyncData*>> jobs;
+    std::vector<std::unique_ptr<LayersSyncData>> data;
+    for(const ObjectPtr &layer : layers) {
+        Table *table = dynamic_cast<Table*>(layer.get());
+        if(nullptr == table || nullptr == dynamic_cast<StoreObject*>(table) ||
+                compare(table->property(SYNC_KEY, SYNC_DISABLE, NG_ADDITIONS_KEY),
+                        SYNC_DISABLE)) {
+            continue;
+        }
+        auto url = tableConnectionUrl(table);
+        if(url.empty()) {
+            continue;
+        }
+
+        LayersSyncData *&job = jobs[url][table->parent()];
+        if(nullptr == job) {
+            job = new LayersSyncData(options, progress);
+            data.emplace_back(job);
+        }
+        job->m_layers.push_back(layer);
+    }
+
+    if(data.empty()) {
+        progress.onProgress(COD_FINISHED, 1.0, _("No layers to sync"));
+        return true;
+    }
+
+    int transferThreads = std::max(1, options.asInt("THREAD_COUNT",
+                                        ATTACHMENTS_TRANSFER_THREAD_COUNT));
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    for(const auto &server : jobs) {
+        // Attachments of the parallel jobs share the server connections too
+        int activeJobs = std::min(maxConnections,
+                                  static_cast<int>(server.second.size()));
+        long jobTransferThreads = std::min(transferThreads,
+                                           std::max(1, maxConnections / activeJobs));
+        ThreadPool *pool = new ThreadPool;
+        pool->init(static_cast<unsigned char>(maxConnections),
+                   layersSyncThreadFunc, 1);
+        pools.emplace_back(pool);
+        for(const auto &job : server.second) {
+            job.second->m_options.add("THREAD_COUNT", jobTransferThreads);
+            pool->addThreadData(job.second);
+        }
+    }
+    for(const auto &pool : pools) {
+        pool->waitComplete(progress);
+    }
+
+    // Jobs removed from the queues on cancel are not synced
+    bool result = true;
+    for(const auto &job : data) {
+        if(!job->m_result) {
+            result = false;
+        }
+    }
+
+    if(progress.isCanceled()) {
+        progress.onProgress(COD_CANCELED, 1.0, _("Sync canceled"));
+        return errorMessage(_("Sync canceled"));
+    }
+    if(result) {
+        progress.onProgress(COD_FINISHED, 1.0, _("Sync finished"));
+    }
+    else {
+        errorMessage(_("Not all layers were synced"));
+    }
+    return result;
+}
+
 } // namespace ngw
 
 } // namespace ngs
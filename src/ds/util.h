@@ -67,12 +67,30 @@ constexpr const char *SYNC_UPLOAD = "UPLOAD";
 constexpr const char *SYNC_DOWNLOAD = "DOWNLOAD";
 constexpr const char *SYNC_DISABLE = "DISABLE";
 constexpr const char *ATTACHMENTS_DOWNLOAD_MAX_SIZE = "ATTACHMENTS_DOWNLOAD_MAX_SIZE";
+constexpr long SYNC_CHUNK_SIZE = 1024 * 1024; // 1 Mb
+constexpr int SYNC_RETRY_COUNT = 3;
+constexpr int SYNC_PAGE_SIZE = 1000;
+constexpr int ATTACHMENTS_TRANSFER_THREAD_COUNT = 4;
+constexpr const char *PART_FILE_SUFFIX = ".part";
+constexpr const char *SYNC_CURSOR_KEY = "NGW_SYNC_CURSOR";
+constexpr const char *SYNC_CURSOR_FIELD_KEY = "NGW_SYNC_CURSOR_FIELD";
+constexpr const char *SYNC_DURATION_KEY = "NGW_SYNC_DURATION";
+constexpr const char *SYNC_TIME_KEY = "NGW_SYNC_TIME";
+constexpr int SYNC_SERVER_CONNECTIONS = 2;
 
 OGRLayer *createAttachmentsTable(GDALDataset *ds, const std::string &name);
 OGRLayer *createEditHistoryTable(GDALDataset *ds, const std::string &name);
 
 std::string downloadAttachment(StoreObject *storeObject, GIntBig fid, GIntBig aid,
                                const Progress &progress);
+bool uploadFeatureEdits(StoreObject *storeObject, const Progress &progress,
+                        const Options &options = Options());
+bool downloadFeatureChanges(StoreObject *storeObject, const Progress &progress,
+                            const Options &options = Options());
+bool transferAttachments(StoreObject *storeObject, const Progress &progress,
+                         const Options &options = Options());
+bool syncLayers(const std::vector<ObjectPtr> &layers, const Progress &progress,
+                const Options &options = Options());
 } // namespace ngw
 
 } // namespace ngs
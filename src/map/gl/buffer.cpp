@@ -20,6 +20,9 @@
  ****************************************************************************/
 #include "buffer.h"
 
+// std
+#include <algorithm>
+
 #include "cpl_conv.h"
 
 namespace ngs {
@@ -32,10 +35,118 @@ constexpr unsigned char VERTEX_WITH_NORMAL_SIZE = 5;
 //GL_UNSIGNED_BYTE, with a maximum value of 255.
 //GL_UNSIGNED_SHORT, with a maximum value of 65,535
 constexpr unsigned short MAX_VERTEX_BUFFER_SIZE = 65535;
+// With GL_OES_element_index_uint all items of tile style are packed to one
+// buffer in most cases. The limit keeps buffer size up to 16 Mb.
+constexpr size_t MAX_UINT_INDEX_BUFFER_SIZE = 4194304;
+constexpr size_t MAX_UINT_VERTEX_BUFFER_SIZE = 4194304;
+// Buffer object sizes are rounded up to power of two from this value, so
+// released buffers fit to next tiles of near size.
+constexpr GLsizeiptr MIN_BUFFER_CAPACITY = 4096;
+// The reused buffer should not be more than this times bigger than needed.
+constexpr GLsizeiptr MAX_BUFFER_OVERSIZE = 4;
+constexpr GLsizeiptr MAX_POOLED_BUFFERS_SIZE = 64 * 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// GlBufferPool
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The GlBufferPool class Keeps released VBO/IBO objects to fill them by
+ * glBufferSubData for new tiles instead of glGenBuffers/glDeleteBuffers on
+ * each tile fill. Used only in GL context thread.
+ */
+class GlBufferPool
+{
+public:
+    GlBufferPool() : m_size(0) {}
+
+    GLuint acquire(GLenum target, GLsizeiptr size, GLsizeiptr &capacity) {
+        auto &buffers = m_buffers[target == GL_ARRAY_BUFFER ? 0 : 1];
+        auto best = buffers.end();
+        for(auto it = buffers.begin(); it != buffers.end(); ++it) {
+            if(it->capacity >= size && it->capacity <= size * MAX_BUFFER_OVERSIZE &&
+                    (best == buffers.end() || best->capacity > it->capacity)) {
+                best = it;
+            }
+        }
+
+        if(best != buffers.end()) {
+            GLuint id = best->id;
+            capacity = best->capacity;
+            m_size -= capacity;
+            *best = buffers.back();
+            buffers.pop_back();
+            return id;
+        }
+
+        capacity = MIN_BUFFER_CAPACITY;
+        while(capacity < size) {
+            capacity <<= 1;
+        }
+        GLuint id = GL_BUFFER_IVALID;
+        ngsCheckGLError(glGenBuffers(1, &id));
+        GlState::bindBuffer(target, id);
+        ngsCheckGLError(glBufferData(target, capacity, nullptr, GL_STATIC_DRAW));
+        glStats().bufferMemory += capacity;
+        return id;
+    }
+
+    void release(GLenum target, GLuint id, GLsizeiptr capacity) {
+        if(id == GL_BUFFER_IVALID) {
+            return;
+        }
+        if(m_size + capacity > MAX_POOLED_BUFFERS_SIZE) {
+            GlState::forgetBuffer(id);
+            ngsCheckGLError(glDeleteBuffers(1, &id));
+            glStats().bufferMemory -= capacity;
+            return;
+        }
+        m_size += capacity;
+        m_buffers[target == GL_ARRAY_BUFFER ? 0 : 1].push_back({id, capacity});
+    }
+
+    void clear() {
+        for(auto &buffers : m_buffers) {
+            for(const auto &buffer : buffers) {
+                GlState::forgetBuffer(buffer.id);
+                ngsCheckGLError(glDeleteBuffers(1, &buffer.id));
+                glStats().bufferMemory -= buffer.capacity;
+            }
+            buffers.clear();
+        }
+        m_size = 0;
+    }
+
+private:
+    typedef struct _pooledBuffer {
+        GLuint id;
+        GLsizeiptr capacity;
+    } PooledBuffer;
+
+private:
+    std::array<std::vector<PooledBuffer>, GL_BUFFERS_COUNT> m_buffers;
+    GLsizeiptr m_size;
+};
+
+static GlBufferPool gBufferPool;
+
+// Buffer upload budget per frame
+static size_t gMaxFrameUploadSize = 0;
+static size_t gFrameUploadSize = 0;
+
+//------------------------------------------------------------------------------
+// GlBuffer
+//------------------------------------------------------------------------------
 
 GlBuffer::GlBuffer(BufferType type) : GlObject(),
+    m_drawRange{0, -1},
+    m_changedBegin(0),
+    m_changedEnd(0),
     m_bufferIds{{GL_BUFFER_IVALID,GL_BUFFER_IVALID}},
-    m_type(type)
+    m_bufferCapacity{{0, 0}},
+    m_vertexArray(0),
+    m_type(type),
+    m_indexType(GL_UNSIGNED_SHORT)
 {
     m_vertices.reserve(MAX_VERTEX_BUFFER_SIZE);
     m_indices.reserve(MAX_INDEX_BUFFER_SIZE);
@@ -50,20 +161,116 @@ bool GlBuffer::canStoreVertices(size_t amount, bool withNormals) const
 {
     if(m_type == BF_TEX) {
         return (m_vertices.size() + amount * (
-                    withNormals ? 7 : 5)) <  MAX_VERTEX_BUFFER_SIZE;
+                    withNormals ? 7 : 5)) <  maxVertices();
     }
     else {
         return (m_vertices.size() + amount * (
                     withNormals ? VERTEX_WITH_NORMAL_SIZE : VERTEX_SIZE)) <
-                MAX_VERTEX_BUFFER_SIZE;
+                maxVertices();
     }
 }
 
 void GlBuffer::destroy()
 {
     if (m_bound) {
-        ngsCheckGLError(glDeleteBuffers(GL_BUFFERS_COUNT, m_bufferIds.data()));
+        GlState::deleteVertexArray(m_vertexArray);
+        m_vertexArray = 0;
+        gBufferPool.release(GL_ARRAY_BUFFER, m_bufferIds[0],
+                            m_bufferCapacity[0]);
+        gBufferPool.release(GL_ELEMENT_ARRAY_BUFFER, m_bufferIds[1],
+                            m_bufferCapacity[1]);
+        m_bufferIds.fill(GL_BUFFER_IVALID);
+        m_bound = false;
+    }
+}
+
+size_t GlBuffer::memorySize() const
+{
+    if(!m_bound) {
+        return 0;
+    }
+    return static_cast<size_t>(m_bufferCapacity[0] + m_bufferCapacity[1]);
+}
+
+/**
+ * @brief GlBuffer::clear Remove vertices and indices to fill buffer again.
+ * Bound buffer object is not changed.
+ */
+void GlBuffer::clear()
+{
+    m_vertices.clear();
+    m_indices.clear();
+    m_itemStarts.clear();
+}
+
+/**
+ * @brief GlBuffer::copy Not bound copy of the buffer data, which can be bound
+ * in other GL context.
+ * @return New buffer.
+ */
+GlBuffer *GlBuffer::copy() const
+{
+    GlBuffer *out = new GlBuffer(m_type);
+    // Copies keep only the memory they use
+    std::vector<GLfloat>(m_vertices).swap(out->m_vertices);
+    std::vector<GLuint>(m_indices).swap(out->m_indices);
+    out->m_itemStarts = m_itemStarts;
+    return out;
+}
+
+size_t GlBuffer::dataSize() const
+{
+    return sizeof(GLfloat) * m_vertices.size() +
+            sizeof(GLuint) * m_indices.size() +
+            sizeof(std::pair<GLuint, GLuint>) * m_itemStarts.size();
+}
+
+/**
+ * @brief GlBuffer::setVertices Replace vertices from offset with vertices of
+ * other buffer. Bound buffer uploads them on uploadChanged() call.
+ * @param offset Offset in vertex values
+ * @param other Buffer with new vertices
+ * @return False if other vertices do not fit in buffer
+ */
+bool GlBuffer::setVertices(size_t offset, const GlBuffer &other)
+{
+    size_t count = other.m_vertices.size();
+    if(offset + count > m_vertices.size()) {
+        return false;
+    }
+    std::copy(other.m_vertices.begin(), other.m_vertices.end(),
+              m_vertices.begin() + static_cast<long>(offset));
+    if(m_bound) {
+        if(m_changedBegin == m_changedEnd) {
+            m_changedBegin = offset;
+            m_changedEnd = offset + count;
+        }
+        else {
+            m_changedBegin = std::min(m_changedBegin, offset);
+            m_changedEnd = std::max(m_changedEnd, offset + count);
+        }
     }
+    return true;
+}
+
+/**
+ * @brief GlBuffer::uploadChanged Upload vertices changed by setVertices() to
+ * bound buffer object. Must be run in GL context.
+ */
+void GlBuffer::uploadChanged()
+{
+    if(!m_bound || m_changedBegin == m_changedEnd) {
+        return;
+    }
+
+    GLintptr offset = static_cast<GLintptr>(sizeof(GLfloat) * m_changedBegin);
+    GLsizeiptr size = static_cast<GLsizeiptr>(sizeof(GLfloat) *
+                                              (m_changedEnd - m_changedBegin));
+    GlState::bindBuffer(GL_ARRAY_BUFFER, m_bufferIds[0]);
+    ngsCheckGLError(glBufferSubData(GL_ARRAY_BUFFER, offset, size,
+                                    m_vertices.data() + m_changedBegin));
+    glStats().uploadedBytes += static_cast<size_t>(size);
+    m_changedBegin = m_changedEnd = 0;
 }
 
 GLuint GlBuffer::id(bool vertices) const
@@ -76,12 +283,104 @@ GLuint GlBuffer::id(bool vertices) const
 
 size_t GlBuffer::maxIndices()
 {
-    return MAX_INDEX_BUFFER_SIZE;
+    return isUIntIndexSupported() ? MAX_UINT_INDEX_BUFFER_SIZE :
+                                    MAX_INDEX_BUFFER_SIZE;
 }
 
 size_t GlBuffer::maxVertices()
 {
-    return MAX_VERTEX_BUFFER_SIZE;
+    return isUIntIndexSupported() ? MAX_UINT_VERTEX_BUFFER_SIZE :
+                                    MAX_VERTEX_BUFFER_SIZE;
+}
+
+/**
+ * @brief GlBuffer::itemRanges Get index ranges of items passed the filter.
+ * Ranges of neighbour items are merged to draw them in one call.
+ * @param filter Item filter.
+ * @return Index ranges.
+ */
+std::vector<GlBuffer::IndexRange> GlBuffer::itemRanges(const ItemFilter &filter) const
+{
+    std::vector<IndexRange> out;
+    for(size_t i = 0; i < m_itemStarts.size(); ++i) {
+        GLuint first = m_itemStarts[i].second;
+        GLuint end = i + 1 < m_itemStarts.size() ? m_itemStarts[i + 1].second :
+                                                   static_cast<GLuint>(m_indices.size());
+        if(end == first || !filter(m_itemStarts[i].first)) {
+            continue;
+        }
+
+        if(!out.empty() &&
+                out.back().first + static_cast<GLuint>(out.back().count) == first) {
+            out.back().count += static_cast<GLsizei>(end - first);
+        }
+        else {
+            out.push_back({first, static_cast<GLsizei>(end - first)});
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief GlBuffer::drawOffset Offset of draw range in bound index buffer.
+ */
+const GLvoid *GlBuffer::drawOffset() const
+{
+    if(m_drawRange.count < 0) {
+        return nullptr;
+    }
+    size_t indexBytes = m_indexType == GL_UNSIGNED_INT ? sizeof(GLuint) :
+                                                         sizeof(GLushort);
+    return reinterpret_cast<const GLvoid*>(m_drawRange.first * indexBytes);
+}
+
+/**
+ * @brief GlBuffer::clearPool Delete buffer objects kept for reuse. Must be
+ * run in GL context before it destroyed.
+ */
+void GlBuffer::clearPool()
+{
+    gBufferPool.clear();
+}
+
+/**
+ * @brief GlBuffer::setUploadBudget Limit buffer data uploads per one frame
+ * draw.
+ * @param size Maximum uploaded bytes. 0 - unlimited
+ */
+void GlBuffer::setUploadBudget(size_t size)
+{
+    gMaxFrameUploadSize = size;
+}
+
+/**
+ * @brief GlBuffer::startFrame Reset upload budget counter on new frame draw.
+ */
+void GlBuffer::startFrame()
+{
+    gFrameUploadSize = 0;
+}
+
+/**
+ * @brief GlBuffer::canUpload Check if buffer data upload fits in current frame
+ * budget. The first upload in frame is always allowed, so buffers larger than
+ * budget are uploaded too.
+ * @return true if upload is allowed
+ */
+bool GlBuffer::canUpload()
+{
+    return gMaxFrameUploadSize == 0 || gFrameUploadSize < gMaxFrameUploadSize;
+}
+
+void GlBuffer::upload(GLenum target, size_t index, const GLvoid *data,
+                      GLsizeiptr size)
+{
+    m_bufferIds[index] = gBufferPool.acquire(target, size,
+                                             m_bufferCapacity[index]);
+    GlState::bindBuffer(target, m_bufferIds[index]);
+    ngsCheckGLError(glBufferSubData(target, 0, size, data));
+    glStats().uploadedBytes += static_cast<size_t>(size);
+    gFrameUploadSize += static_cast<size_t>(size);
 }
 
 void GlBuffer::bind()
@@ -89,24 +388,37 @@ void GlBuffer::bind()
     if (m_bound || m_vertices.empty() || m_indices.empty())
         return;
 
-    ngsCheckGLError(glGenBuffers(GL_BUFFERS_COUNT, m_bufferIds.data()));
+    // Element buffer is bound to own vertex array
+    m_vertexArray = GlState::createVertexArray();
 
-    ngsCheckGLError(glBindBuffer(GL_ARRAY_BUFFER, id(true)));
     GLsizeiptr size = static_cast<GLsizeiptr>(sizeof(GLfloat) * m_vertices.size());
-    ngsCheckGLError(glBufferData(GL_ARRAY_BUFFER, size, m_vertices.data(),
-            GL_STATIC_DRAW));
+    upload(GL_ARRAY_BUFFER, 0, m_vertices.data(), size);
 
-    ngsCheckGLError(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id(false)));
-    size = static_cast<GLsizeiptr>(sizeof(GLushort) * m_indices.size());
-    ngsCheckGLError(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, m_indices.data(),
-            GL_STATIC_DRAW));
+    if(isUIntIndexSupported()) {
+        m_indexType = GL_UNSIGNED_INT;
+        size = static_cast<GLsizeiptr>(sizeof(GLuint) * m_indices.size());
+        upload(GL_ELEMENT_ARRAY_BUFFER, 1, m_indices.data(), size);
+    }
+    else {
+        // The buffer was filled within 16-bit limits
+        m_indexType = GL_UNSIGNED_SHORT;
+        std::vector<GLushort> indices(m_indices.begin(), m_indices.end());
+        size = static_cast<GLsizeiptr>(sizeof(GLushort) * indices.size());
+        upload(GL_ELEMENT_ARRAY_BUFFER, 1, indices.data(), size);
+    }
+    m_changedBegin = m_changedEnd = 0;
     m_bound = true;
 }
 
 void GlBuffer::rebind() const
 {
-    ngsCheckGLError(glBindBuffer(GL_ARRAY_BUFFER, id(true)));
-    ngsCheckGLError(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id(false)));
+    // Vertex attributes are set by style after rebind and are skipped if
+    // the vertex array has them already
+    if(m_vertexArray != 0) {
+        GlState::bindVertexArray(m_vertexArray);
+    }
+    GlState::bindBuffer(GL_ARRAY_BUFFER, id(true));
+    GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, id(false));
 }
 
 } // namespace ngs
@@ -24,6 +24,7 @@
 #include "functions.h"
 
 #include <array>
+#include <functional>
 #include <vector>
 
 namespace ngs {
@@ -39,6 +40,16 @@ public:
         BF_FILL,
         BF_TEX
     };
+
+    /**
+     * @brief The IndexRange struct Part of index buffer to draw
+     */
+    typedef struct _indexRange {
+        GLuint first;
+        GLsizei count;
+    } IndexRange;
+
+    typedef std::function<bool(GLuint item)> ItemFilter;
 public:
     explicit GlBuffer(enum BufferType type = BF_TEX);
     virtual ~GlBuffer() override;
@@ -53,24 +64,66 @@ public:
     }
 
     void addVertex(float value) { m_vertices.push_back(value); }
-    void addIndex(unsigned short value) { m_indices.push_back(value); }
+    void addIndex(GLuint value) { m_indices.push_back(value); }
+    void clear();
+    GlBuffer *copy() const;
+    /**
+     * @brief dataSize Memory of the vertices and indices kept on CPU side.
+     */
+    size_t dataSize() const;
+    bool setVertices(size_t offset, const GlBuffer &other);
+    void uploadChanged();
+    GLenum indexType() const { return m_indexType; }
 
     enum BufferType type() const { return m_type; }
+
+    /**
+     * @brief startItem Mark that next indices belong to the tile item. Must be
+     * called before item is added and again if item continues in new buffer.
+     * @param item Tile item index.
+     */
+    void startItem(GLuint item) {
+        m_itemStarts.push_back({item, static_cast<GLuint>(m_indices.size())});
+    }
+    std::vector<IndexRange> itemRanges(const ItemFilter &filter) const;
+    void setDrawRange(const IndexRange &range) const { m_drawRange = range; }
+    void resetDrawRange() const { m_drawRange = {0, -1}; }
+    GLsizei drawCount() const {
+        return m_drawRange.count < 0 ? indexSize() : m_drawRange.count;
+    }
+    const GLvoid *drawOffset() const;
     static size_t maxIndices();
     static size_t maxVertices();
+    static void clearPool();
+    static void setUploadBudget(size_t size);
+    static void startFrame();
+    static bool canUpload();
 
     // GlObject interface
 public:
     virtual void bind() override;
     virtual void rebind() const override;
     virtual void destroy() override;
+    virtual size_t memorySize() const override;
 
+private:
+    void upload(GLenum target, size_t index, const GLvoid *data,
+                GLsizeiptr size);
 
 private:
     std::vector<GLfloat> m_vertices;
-    std::vector<GLushort> m_indices;
+    std::vector<GLuint> m_indices;
+    // Tile item index and its first index in m_indices
+    std::vector<std::pair<GLuint, GLuint>> m_itemStarts;
+    mutable IndexRange m_drawRange;
+    // Vertices range changed after bind
+    size_t m_changedBegin, m_changedEnd;
     std::array<GLuint, GL_BUFFERS_COUNT> m_bufferIds;
+    std::array<GLsizeiptr, GL_BUFFERS_COUNT> m_bufferCapacity;
+    // Element buffer and vertex attributes set by the first draw
+    GLuint m_vertexArray;
     enum BufferType m_type;
+    GLenum m_indexType;
 };
 
 using GlBufferPtr = std::shared_ptr<GlBuffer>;
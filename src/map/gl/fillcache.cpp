@@ -0,0 +1,200 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "fillcache.h"
+
+// std
+#include <iterator>
+
+#include "layer.h"
+#include "util/settings.h"
+
+namespace ngs {
+
+constexpr size_t MB = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// FillCache
+//------------------------------------------------------------------------------
+
+FillCache &FillCache::instance()
+{
+    static FillCache cache;
+    return cache;
+}
+
+FillCache::FillCache() :
+    m_size(0),
+    m_maxSize(0)
+{
+    const Settings &settings = Settings::instance();
+    int maxSize = settings.getInteger("common/fill_cache_size",
+                                      DEFAULT_FILL_CACHE_SIZE);
+    if(maxSize > 0) {
+        m_maxSize = static_cast<size_t>(maxSize) * MB;
+    }
+    MemoryBudget::instance().addConsumer(this);
+}
+
+FillCache::~FillCache()
+{
+    MemoryBudget::instance().removeConsumer(this);
+}
+
+/**
+ * @brief FillCache::get Copy of the cached tile buffers.
+ * @param owner Feature class the tile was filled from.
+ * @param tile Tile coordinates.
+ * @param styleHash Hash of the layer styles used to fill.
+ * @param z Layer depth.
+ * @param tileVersion Current tile version, 0 if tile can not be cached.
+ * @return Not bound buffers copy or nullptr if tile is not cached or changed.
+ */
+VectorGlObject *FillCache::get(const FeatureClassOverviewPtr &owner,
+                               const Tile &tile, size_t styleHash, float z,
+                               GUIntBig tileVersion)
+{
+    if(0 == tileVersion) {
+        return nullptr;
+    }
+
+    std::shared_ptr<VectorGlObject> data;
+    {
+        MutexHolder holder(m_mutex);
+        auto it = m_index.find({owner.get(), styleHash, z, tile});
+        if(it == m_index.end()) {
+            return nullptr;
+        }
+
+        Entry &entry = *it->second;
+        if(entry.tileVersion != tileVersion || entry.owner.expired()) {
+            erase(it->second);
+            return nullptr;
+        }
+
+        // Move to the front of the list
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        entry.tick = MemoryBudget::tick();
+        data = entry.data;
+    }
+
+    // Cached buffers are never changed, so copy is made out of the lock
+    return data->copy();
+}
+
+/**
+ * @brief FillCache::put Store copy of the filled tile buffers. Must be called
+ * before the buffers are given to the map, which may bind and change them.
+ * @param owner Feature class the tile was filled from.
+ * @param tile Tile coordinates.
+ * @param styleHash Hash of the layer styles used to fill.
+ * @param z Layer depth.
+ * @param tileVersion Tile version the buffers were filled from.
+ * @param data Filled buffers.
+ */
+void FillCache::put(const FeatureClassOverviewPtr &owner, const Tile &tile,
+                    size_t styleHash, float z, GUIntBig tileVersion,
+                    const VectorGlObject *data)
+{
+    if(0 == m_maxSize || 0 == tileVersion || nullptr == data) {
+        return;
+    }
+
+    size_t size = data->dataSize();
+    if(size > m_maxSize) {
+        return;
+    }
+
+    std::shared_ptr<VectorGlObject> copy(data->copy());
+    {
+        MutexHolder holder(m_mutex);
+        Key key = {owner.get(), styleHash, z, tile};
+        auto it = m_index.find(key);
+        if(it != m_index.end()) {
+            erase(it->second);
+        }
+
+        evict(m_maxSize - size);
+
+        m_entries.push_front({key, owner, tileVersion, copy, size,
+                              MemoryBudget::tick()});
+        m_index[key] = m_entries.begin();
+        m_size += size;
+    }
+    MemoryBudget::instance().enforce();
+}
+
+void FillCache::clear()
+{
+    MutexHolder holder(m_mutex);
+    m_index.clear();
+    m_entries.clear();
+    m_size = 0;
+}
+
+void FillCache::setMaxSize(size_t size)
+{
+    MutexHolder holder(m_mutex);
+    m_maxSize = size;
+    evict(m_maxSize);
+}
+
+size_t FillCache::memoryUsed() const
+{
+    MutexHolder holder(m_mutex);
+    return m_size;
+}
+
+bool FillCache::oldestAccess(GUIntBig &tick) const
+{
+    MutexHolder holder(m_mutex);
+    if(m_entries.empty()) {
+        return false;
+    }
+    tick = m_entries.back().tick;
+    return true;
+}
+
+size_t FillCache::freeOldest()
+{
+    MutexHolder holder(m_mutex);
+    if(m_entries.empty()) {
+        return 0;
+    }
+    size_t size = m_entries.back().size;
+    erase(std::prev(m_entries.end()));
+    return size;
+}
+
+void FillCache::evict(size_t maxSize)
+{
+    while(m_size > maxSize && !m_entries.empty()) {
+        erase(std::prev(m_entries.end()));
+    }
+}
+
+void FillCache::erase(EntryList::iterator it)
+{
+    m_index.erase(it->key);
+    m_size -= it->size;
+    m_entries.erase(it);
+}
+
+} // namespace ngs
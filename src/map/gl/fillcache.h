@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSGLFILLCACHE_H
+#define NGSGLFILLCACHE_H
+
+// std
+#include <list>
+#include <map>
+#include <memory>
+
+#include "ds/featureclassovr.h"
+#include "util/memorybudget.h"
+#include "util/mutex.h"
+
+namespace ngs {
+
+constexpr int DEFAULT_FILL_CACHE_SIZE = 32; // Mb
+
+class VectorGlObject;
+
+/**
+ * @brief The FillCache class Shared LRU cache of filled vector tiles. Maps
+ * showing the same feature class with the same style get copies of buffers
+ * filled once, each map uploads its copy in own GL context. Tiles are keyed by
+ * feature class, style hash, layer depth and tile coordinates and are valid
+ * while the tile version is not changed. Budget is read from
+ * "common/fill_cache_size" setting in megabytes, 0 disables cache. Tiles are
+ * also freed by the MemoryBudget, least recently used first.
+ */
+class FillCache : public MemoryConsumer
+{
+public:
+    static FillCache &instance();
+
+public:
+    VectorGlObject *get(const FeatureClassOverviewPtr &owner, const Tile &tile,
+                        size_t styleHash, float z, GUIntBig tileVersion);
+    void put(const FeatureClassOverviewPtr &owner, const Tile &tile,
+             size_t styleHash, float z, GUIntBig tileVersion,
+             const VectorGlObject *data);
+    void clear();
+    void setMaxSize(size_t size);
+    size_t maxSize() const { return m_maxSize; }
+    size_t size() const { return m_size; }
+
+    // MemoryConsumer interface
+public:
+    virtual size_t memoryUsed() const override;
+    virtual bool oldestAccess(GUIntBig &tick) const override;
+    virtual size_t freeOldest() override;
+
+private:
+    FillCache();
+    virtual ~FillCache() override;
+    FillCache(FillCache const&) = delete;
+    FillCache &operator= (FillCache const&) = delete;
+
+private:
+    typedef struct _key {
+        const void *owner;
+        size_t styleHash;
+        float z;
+        Tile tile;
+        bool operator<(const struct _key &other) const {
+            if(owner != other.owner) {
+                return owner < other.owner;
+            }
+            if(styleHash != other.styleHash) {
+                return styleHash < other.styleHash;
+            }
+            if(z < other.z || other.z < z) {
+                return z < other.z;
+            }
+            return tile < other.tile;
+        }
+    } Key;
+
+    typedef struct _entry {
+        Key key;
+        // Address of destroyed feature class may be reused by new one
+        std::weak_ptr<FeatureClassOverview> owner;
+        GUIntBig tileVersion;
+        std::shared_ptr<VectorGlObject> data; // NOTE: Never bound
+        size_t size;
+        GUIntBig tick;
+    } Entry;
+
+    using EntryList = std::list<Entry>;
+
+private:
+    void evict(size_t maxSize);
+    void erase(EntryList::iterator it);
+
+private:
+    EntryList m_entries; // NOTE: Most recently used first
+    std::map<Key, EntryList::iterator> m_index;
+    size_t m_size;
+    size_t m_maxSize;
+    mutable Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSGLFILLCACHE_H
@@ -610,213 +610,4 @@ void LineStringFiller::addPieSliceLineVertex(const Vector2& currPt,
     }
 }
 
-PolygonTriangulator::PolygonTriangulator()
-        : m_numTriangles(0)
-        , m_numVertices(0)
-{
-}
-
-PolygonTriangulator::~PolygonTriangulator()
-{
-}
-
-void PolygonTriangulator::markDomains(CDT& ct,
-        CDT::Face_handle start,
-        int index,
-        std::list<CDT::Edge>& border)
-{
-    if (start->info().m_nestingLevel != -1) {
-        return;
-    }
-    std::list<CDT::Face_handle> queue;
-    queue.push_back(start);
-    while (!queue.empty()) {
-        CDT::Face_handle fh = queue.front();
-        queue.pop_front();
-        if (fh->info().m_nestingLevel == -1) {
-            fh->info().m_nestingLevel = index;
-            for (int i = 0; i < 3; i++) {
-                CDT::Edge e(fh, i);
-                CDT::Face_handle n = fh->neighbor(i);
-                if (n->info().m_nestingLevel == -1) {
-                    if (ct.is_constrained(e))
-                        border.push_back(e);
-                    else
-                        queue.push_back(n);
-                }
-            }
-        }
-    }
-}
-
-// Explore set of facets connected with non constrained edges,
-// and attribute to each such set a nesting level.
-// We start from facets incident to the infinite vertex, with a nesting
-// level of 0. Then we recursively consider the non-explored facets incident
-// to constrained edges bounding the former set
-// and increase the nesting level by 1.
-// Facets in the domain are those with an odd nesting level.
-void PolygonTriangulator::markDomains(CDT& cdt)
-{
-    std::list<CDT::Edge> border;
-    markDomains(cdt, cdt.infinite_face(), 0, border);
-    while (!border.empty()) {
-        CDT::Edge e = border.front();
-        border.pop_front();
-        CDT::Face_handle n = e.first->neighbor(e.second);
-        if (n->info().m_nestingLevel == -1) {
-            markDomains(cdt, n, e.first->info().m_nestingLevel + 1, border);
-        }
-    }
-}
-
-size_t PolygonTriangulator::insertConstraint(
-        const OGRLineString* line, const size_t startIndex)
-{
-    // Insert the line as constrains into a constrained triangulation.
-    // Based on Constrained_Delaunay_triangulation_2::insert_constraint().
-    // Work only for non-intersecting nested polygons/rings.
-    // TODO: Make for intersecting nested polygons/rings (we need it?).
-
-    int numPoints = line->getNumPoints();
-    size_t index = startIndex;
-
-    OGRPoint pt;
-    line->getPoint(0, &pt);
-    CDT::Point p0(pt.getX(), pt.getY());
-    CDT::Point p = p0;
-
-    CDT::Vertex_handle v0 = m_cdt.insert(p0);
-    v0->info().m_index = index;
-    ++index;
-
-    CDT::Vertex_handle v(v0), w(v0);
-
-    for (int i = 1; i < numPoints; ++i) {
-        line->getPoint(i, &pt);
-        const CDT::Point q(pt.getX(), pt.getY());
-        if (p != q) {
-
-            w = m_cdt.insert(q);
-            w->info().m_index = index;
-            ++index;
-
-            m_cdt.insert_constraint(v, w);
-            v = w;
-            p = q;
-        }
-    }
-
-    m_numVertices += (index - startIndex);
-    return index;
-}
-
-void PolygonTriangulator::markDomains()
-{
-    // Mark facets that are inside the domain bounded by the polygon.
-    markDomains(m_cdt);
-
-    // Get count of triangles that are inside the domain and mark their vertices.
-    for (CDT::Finite_faces_iterator fit = m_cdt.finite_faces_begin();
-            fit != m_cdt.finite_faces_end(); ++fit) {
-
-        if (fit->info().inDomain()) {
-            for (int i = 0; i < 3; ++i) {
-                // for additional vertices
-                if (!fit->vertex(i)->info().inDomain()) {
-                    fit->vertex(i)->info().setAsAdditionalVertexInDomain();
-                    ++m_numVertices;
-                }
-            }
-            ++m_numTriangles;
-        }
-    }
-}
-
-void PolygonTriangulator::insertVerticesToBuffer(float level,
-        int_least8_t crossExtent,
-        const GlBufferSharedPtr buffer,
-        const std::vector<size_t>* borderIndices)
-{
-    // Get vertices of triangles, set their indices and copy additional to buffer.
-    for (CDT::Finite_vertices_iterator vit = getCdt().finite_vertices_begin();
-            vit != getCdt().finite_vertices_end(); ++vit) {
-
-        if (vit->info().inDomain()) {
-            if (borderIndices) {
-                if (!vit->info().isAdditionalVertex()) {
-                    vit->info().m_index = (*borderIndices)[vit->info().m_index];
-                } else {
-                    // Set index by buffer
-                    vit->info().m_index = buffer->getVertexBufferSize()
-                            / VERTEX_WITH_NORMAL_SIZE;
-
-                    // Normal is not needed, but storage for normal must be occupied.
-                    float x = static_cast<float>(
-                            vit->point().x() + crossExtent * DEFAULT_MAX_X2);
-                    float y = static_cast<float>(vit->point().y());
-                    float z = level;
-                    buffer->addVertex(x, y, z, true, 0, 0);
-                }
-            } else {
-                float x = static_cast<float>(
-                        vit->point().x() + crossExtent * DEFAULT_MAX_X2);
-                float y = static_cast<float>(vit->point().y());
-                float z = level;
-                buffer->addVertex(x, y, z);
-
-                // Set index by buffer
-                vit->info().m_index =
-                        buffer->getVertexBufferSize() / VERTEX_SIZE - 1;
-            }
-        }
-    }
-
-    // Get indices of vertices and copy them to border index buffer.
-    for (CDT::Finite_faces_iterator fit = getCdt().finite_faces_begin();
-            fit != getCdt().finite_faces_end(); ++fit) {
-
-        if (fit->info().inDomain()) {
-            int i0 = fit->vertex(0)->info().m_index;
-            int i1 = fit->vertex(1)->info().m_index;
-            int i2 = fit->vertex(2)->info().m_index;
-            buffer->addTriangleIndices(i0, i1, i2);
-        }
-    }
-}
-
-void PolygonTriangulator::triangulate(const OGRPolygon* polygon)
-{
-    const int intRingCnt = polygon->getNumInteriorRings();
-    for (int i = -1; i < intRingCnt; ++i) {
-        const OGRLinearRing* ring;
-        if (-1 == i) {
-            ring = polygon->getExteriorRing();
-        } else {
-            ring = polygon->getInteriorRing(i);
-        }
-
-        int numPoints = ring->getNumPoints();
-        if (numPoints < 3) {
-            if (-1 == i)
-                return;
-            else
-                continue;
-        }
-
-        // TODO: cut line by x or y direction or
-        // tesselate to fill into array max size
-        if (numPoints > 21000) {
-            CPLDebug("GlBufferBucket", "Too many points - %d, need to divide",
-                    numPoints);
-            return;
-        }
-
-        insertConstraint(ring);
-    }
-
-    // Mark facets that are inside the domain bounded by the polygon.
-    markDomains();
-}
-
 */
@@ -24,6 +24,10 @@
 
 #include "util/error.h"
 
+// std
+#include <limits>
+#include <map>
+
 /* Links:
 //https://mkonrad.net/2014/12/08/android-off-screen-rendering-using-egl-pixelbuffers.html
 //http://stackoverflow.com/questions/214437/opengl-fast-off-screen-rendering
@@ -51,6 +55,78 @@
 
 namespace ngs {
 
+static bool gUIntIndexChecked = false;
+static bool gUIntIndexSupported = false;
+static GLfloat gMaxPointSize = 0.0f;
+static bool gHalfFloatTargetSupported = false;
+static bool gVertexArraySupported = false;
+static GlStats gStats = {0, 0, 0, 0, 0};
+
+constexpr GLuint GL_STATE_UNKNOWN = std::numeric_limits<GLuint>::max();
+constexpr size_t GL_STATE_TEXTURE_UNITS = 8;
+constexpr size_t GL_STATE_ATTRIBUTES = 8;
+
+/**
+ * @brief The GlAttributeState struct Vertex attribute pointer and the array
+ * buffer it was set with.
+ */
+typedef struct _glAttributeState {
+    GLuint buffer;
+    GLint size;
+    GLsizei stride;
+    const GLvoid *pointer;
+} GlAttributeState;
+
+/**
+ * @brief The GlVertexArrayState struct State kept by vertex array object: the
+ * element buffer and vertex attributes. Vertex array 0 is the default state.
+ */
+typedef struct _glVertexArrayState {
+    _glVertexArrayState() : elementBuffer(GL_STATE_UNKNOWN) {
+        for(GlAttributeState &attribute : attributes) {
+            attribute = {GL_STATE_UNKNOWN, 0, 0, nullptr};
+        }
+    }
+    GLuint elementBuffer;
+    GlAttributeState attributes[GL_STATE_ATTRIBUTES];
+} GlVertexArrayState;
+
+/**
+ * @brief The GlStateCache struct Known GL state. GL_STATE_UNKNOWN or missing
+ * map item means the state must be set.
+ */
+typedef struct _glStateCache {
+    GLuint program = GL_STATE_UNKNOWN;
+    GLuint arrayBuffer = GL_STATE_UNKNOWN;
+    GLuint vertexArray = GL_STATE_UNKNOWN;
+    GLuint activeTexture = GL_STATE_UNKNOWN;
+    GLuint textures[GL_STATE_TEXTURE_UNITS] = {
+        GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN,
+        GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN };
+    GLenum blendFunc[4] = {
+        GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN };
+    GLenum depthFunc = GL_STATE_UNKNOWN;
+    bool depthRangeSet = false;
+    GLfloat depthRange[2] = {0.0f, 0.0f};
+    bool clearColorSet = false;
+    GlColor clearColor = {0.0f, 0.0f, 0.0f, 0.0f};
+    bool viewportSet = false;
+    GLint viewport[4] = {0, 0, 0, 0};
+    std::map<GLenum, bool> capabilities;
+    std::map<GLenum, GLenum> hints;
+    std::map<GLuint, GlVertexArrayState> vertexArrays;
+} GlStateCache;
+
+static GlStateCache gState;
+
+static GlVertexArrayState &currentVertexArray()
+{
+    // Unknown binding is the default vertex array, as own vertex arrays are
+    // bound explicitly
+    return gState.vertexArrays[gState.vertexArray == GL_STATE_UNKNOWN ?
+                0 : gState.vertexArray];
+}
+
 bool checkGLError(const char *cmd) {
     const GLenum err = glGetError();
     if (err != GL_NO_ERROR) {
@@ -166,8 +242,42 @@ void prepareContext()
 //        ngsCheckGLError(glEnable(GL_MULTISAMPLE));
 //#endif
 
+    // The state may be changed by other GL code between frames
+    GlState::reset();
+
 // NOTE: In usual cases no need in depth test
-    ngsCheckGLError(glDisable(GL_DEPTH_TEST));
+    GlState::setEnabled(GL_DEPTH_TEST, false);
+
+    if(!gUIntIndexChecked) {
+        // Desktop OpenGL always supports 32-bit indices, OpenGL ES 2.0 only
+        // with extension.
+        const char *version =
+                reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        const char *extensions =
+                reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        if(nullptr != version) {
+            gUIntIndexSupported = !STARTS_WITH(version, "OpenGL ES") ||
+                    (nullptr != extensions &&
+                     strstr(extensions, "GL_OES_element_index_uint") != nullptr);
+            gUIntIndexChecked = true;
+
+            GLfloat pointSizeRange[2] = {0.0f, 0.0f};
+            ngsCheckGLError(glGetFloatv(GL_ALIASED_POINT_SIZE_RANGE,
+                                        pointSizeRange));
+            gMaxPointSize = pointSizeRange[1];
+
+            // Only OpenGL ES half float type is used
+            gHalfFloatTargetSupported = STARTS_WITH(version, "OpenGL ES") &&
+                    nullptr != extensions &&
+                    strstr(extensions, "GL_OES_texture_half_float") != nullptr &&
+                    strstr(extensions, "GL_EXT_color_buffer_half_float") != nullptr;
+
+#ifdef GL_OES_vertex_array_object
+            gVertexArraySupported = nullptr != extensions &&
+                    strstr(extensions, "GL_OES_vertex_array_object") != nullptr;
+#endif // GL_OES_vertex_array_object
+        }
+    }
 //    ngsCheckGLError(glEnable(GL_DEPTH_TEST));
 //    ngsCheckGLError(glDepthMask(GL_TRUE));
 //    ngsCheckGLError(glDepthFunc(GL_LEQUAL));
@@ -177,6 +287,329 @@ void prepareContext()
 //    ngsCheckGLError(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
 }
 
+/**
+ * @brief isUIntIndexSupported Check if GL_UNSIGNED_INT indices can be drawn.
+ * The value is set in prepareContext(), before it returns false.
+ * @return true if 32-bit indices supported.
+ */
+bool isUIntIndexSupported()
+{
+    return gUIntIndexSupported;
+}
+
+/**
+ * @brief maxPointSize Maximum size of point sprite in pixels.
+ * The value is set in prepareContext(), before it returns 0.
+ * @return Size in pixels.
+ */
+GLfloat maxPointSize()
+{
+    return gMaxPointSize;
+}
+
+/**
+ * @brief isHalfFloatTargetSupported Check if half float textures can be
+ * framebuffer color attachments. The value is set in prepareContext(), before
+ * it returns false.
+ * @return true if half float render targets supported.
+ */
+bool isHalfFloatTargetSupported()
+{
+#ifdef GL_HALF_FLOAT_OES
+    return gHalfFloatTargetSupported;
+#else
+    return false;
+#endif // GL_HALF_FLOAT_OES
+}
+
+/**
+ * @brief isVertexArraySupported Check if vertex array objects can be used. The
+ * value is set in prepareContext(), before it returns false.
+ * @return true if GL_OES_vertex_array_object supported.
+ */
+bool isVertexArraySupported()
+{
+    return gVertexArraySupported;
+}
+
+GlStats &glStats()
+{
+    return gStats;
+}
+
+void resetGlFrameStats()
+{
+    gStats.drawCalls = 0;
+    gStats.stateChanges = 0;
+    gStats.uploadedBytes = 0;
+}
+
+//------------------------------------------------------------------------------
+// GlState
+//------------------------------------------------------------------------------
+
+void GlState::reset()
+{
+    std::map<GLuint, GlVertexArrayState> vertexArrays;
+    vertexArrays.swap(gState.vertexArrays);
+    vertexArrays.erase(0);
+    gState = GlStateCache();
+    gState.vertexArrays.swap(vertexArrays);
+}
+
+void GlState::useProgram(GLuint id)
+{
+    if(gState.program != id) {
+        ngsCheckGLError(glUseProgram(id));
+        gState.program = id;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::bindVertexArray(GLuint id)
+{
+#ifdef GL_OES_vertex_array_object
+    if(gVertexArraySupported && gState.vertexArray != id) {
+        ngsCheckGLError(glBindVertexArrayOES(id));
+        gState.vertexArray = id;
+        gStats.stateChanges++;
+    }
+#else
+    ngsUnused(id);
+#endif // GL_OES_vertex_array_object
+}
+
+void GlState::bindBuffer(GLenum target, GLuint id)
+{
+    // Element buffer binding is the vertex array state
+    GLuint &current = target == GL_ARRAY_BUFFER ? gState.arrayBuffer :
+                                        currentVertexArray().elementBuffer;
+    if(current != id) {
+        ngsCheckGLError(glBindBuffer(target, id));
+        current = id;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::vertexAttribPointer(GLuint index, GLint size, GLsizei stride,
+                                  const GLvoid *pointer)
+{
+    GlAttributeState *attribute = nullptr;
+    if(index < GL_STATE_ATTRIBUTES) {
+        attribute = &currentVertexArray().attributes[index];
+        if(gState.arrayBuffer != GL_STATE_UNKNOWN &&
+                attribute->buffer == gState.arrayBuffer &&
+                attribute->size == size && attribute->stride == stride &&
+                attribute->pointer == pointer) {
+            return;
+        }
+    }
+
+    ngsCheckGLError(glEnableVertexAttribArray(index));
+    ngsCheckGLError(glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE,
+                                          stride, pointer));
+    if(nullptr != attribute) {
+        *attribute = {gState.arrayBuffer, size, stride, pointer};
+    }
+    gStats.stateChanges++;
+}
+
+void GlState::activeTexture(GLenum unit)
+{
+    GLuint index = unit - GL_TEXTURE0;
+    if(gState.activeTexture != index) {
+        ngsCheckGLError(glActiveTexture(unit));
+        gState.activeTexture = index;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::bindTexture(GLuint id)
+{
+    if(gState.activeTexture < GL_STATE_TEXTURE_UNITS) {
+        GLuint &current = gState.textures[gState.activeTexture];
+        if(current == id) {
+            return;
+        }
+        current = id;
+    }
+    // Binding to unknown or not cached unit is always done
+    ngsCheckGLError(glBindTexture(GL_TEXTURE_2D, id));
+    gStats.stateChanges++;
+}
+
+void GlState::setEnabled(GLenum capability, bool enabled)
+{
+    auto it = gState.capabilities.find(capability);
+    if(it != gState.capabilities.end() && it->second == enabled) {
+        return;
+    }
+    if(enabled) {
+        ngsCheckGLError(glEnable(capability));
+    }
+    else {
+        ngsCheckGLError(glDisable(capability));
+    }
+    gState.capabilities[capability] = enabled;
+    gStats.stateChanges++;
+}
+
+void GlState::blendFunc(GLenum source, GLenum destination)
+{
+    if(gState.blendFunc[0] != source || gState.blendFunc[1] != destination ||
+            gState.blendFunc[2] != source ||
+            gState.blendFunc[3] != destination) {
+        ngsCheckGLError(glBlendFunc(source, destination));
+        gState.blendFunc[0] = gState.blendFunc[2] = source;
+        gState.blendFunc[1] = gState.blendFunc[3] = destination;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB,
+                                GLenum sourceAlpha, GLenum destinationAlpha)
+{
+    if(gState.blendFunc[0] != sourceRGB ||
+            gState.blendFunc[1] != destinationRGB ||
+            gState.blendFunc[2] != sourceAlpha ||
+            gState.blendFunc[3] != destinationAlpha) {
+        ngsCheckGLError(glBlendFuncSeparate(sourceRGB, destinationRGB,
+                                            sourceAlpha, destinationAlpha));
+        gState.blendFunc[0] = sourceRGB;
+        gState.blendFunc[1] = destinationRGB;
+        gState.blendFunc[2] = sourceAlpha;
+        gState.blendFunc[3] = destinationAlpha;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::depthFunc(GLenum func)
+{
+    if(gState.depthFunc != func) {
+        ngsCheckGLError(glDepthFunc(func));
+        gState.depthFunc = func;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::depthRange(GLfloat nearValue, GLfloat farValue)
+{
+    if(!gState.depthRangeSet || gState.depthRange[0] != nearValue ||
+            gState.depthRange[1] != farValue) {
+        ngsCheckGLError(glDepthRange(nearValue, farValue));
+        gState.depthRange[0] = nearValue;
+        gState.depthRange[1] = farValue;
+        gState.depthRangeSet = true;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::hint(GLenum target, GLenum mode)
+{
+    auto it = gState.hints.find(target);
+    if(it != gState.hints.end() && it->second == mode) {
+        return;
+    }
+    ngsCheckGLError(glHint(target, mode));
+    gState.hints[target] = mode;
+    gStats.stateChanges++;
+}
+
+void GlState::clearColor(const GlColor &color)
+{
+    const GlColor &current = gState.clearColor;
+    if(!gState.clearColorSet || current.r != color.r ||
+            current.g != color.g || current.b != color.b ||
+            current.a != color.a) {
+        ngsCheckGLError(glClearColor(color.r, color.g, color.b, color.a));
+        gState.clearColor = color;
+        gState.clearColorSet = true;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    const GLint *current = gState.viewport;
+    if(!gState.viewportSet || current[0] != x || current[1] != y ||
+            current[2] != width || current[3] != height) {
+        ngsCheckGLError(glViewport(x, y, width, height));
+        gState.viewport[0] = x;
+        gState.viewport[1] = y;
+        gState.viewport[2] = width;
+        gState.viewport[3] = height;
+        gState.viewportSet = true;
+        gStats.stateChanges++;
+    }
+}
+
+void GlState::forgetProgram(GLuint id)
+{
+    if(gState.program == id) {
+        gState.program = GL_STATE_UNKNOWN;
+    }
+}
+
+void GlState::forgetBuffer(GLuint id)
+{
+    if(gState.arrayBuffer == id) {
+        gState.arrayBuffer = GL_STATE_UNKNOWN;
+    }
+    for(auto &vertexArray : gState.vertexArrays) {
+        if(vertexArray.second.elementBuffer == id) {
+            vertexArray.second.elementBuffer = GL_STATE_UNKNOWN;
+        }
+        for(GlAttributeState &attribute : vertexArray.second.attributes) {
+            if(attribute.buffer == id) {
+                attribute.buffer = GL_STATE_UNKNOWN;
+            }
+        }
+    }
+}
+
+void GlState::forgetTexture(GLuint id)
+{
+    for(GLuint &texture : gState.textures) {
+        if(texture == id) {
+            texture = GL_STATE_UNKNOWN;
+        }
+    }
+}
+
+/**
+ * @brief GlState::createVertexArray Create vertex array object and bind it.
+ * @return Vertex array id or 0 if vertex arrays are not supported.
+ */
+GLuint GlState::createVertexArray()
+{
+    GLuint id = 0;
+#ifdef GL_OES_vertex_array_object
+    if(gVertexArraySupported) {
+        ngsCheckGLError(glGenVertexArraysOES(1, &id));
+        gState.vertexArrays[id] = GlVertexArrayState();
+        bindVertexArray(id);
+    }
+#endif // GL_OES_vertex_array_object
+    return id;
+}
+
+void GlState::deleteVertexArray(GLuint id)
+{
+#ifdef GL_OES_vertex_array_object
+    if(0 == id) {
+        return;
+    }
+    ngsCheckGLError(glDeleteVertexArraysOES(1, &id));
+    gState.vertexArrays.erase(id);
+    if(gState.vertexArray == id) {
+        // Deleted bound vertex array reverts to the default one
+        gState.vertexArray = 0;
+    }
+#else
+    ngsUnused(id);
+#endif // GL_OES_vertex_array_object
+}
+
 GlObject::GlObject() : m_bound(false)
 {
 }
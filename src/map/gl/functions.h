@@ -98,6 +98,64 @@ inline ngsRGBA ngsGl2RGBA(const GlColor &color) {
 bool checkGLError(const char *cmd);
 void reportGlStatus(GLuint obj);
 void prepareContext();
+bool isUIntIndexSupported();
+GLfloat maxPointSize();
+bool isHalfFloatTargetSupported();
+bool isVertexArraySupported();
+
+/**
+ * @brief The GlStats struct Renderer counters. Frame counters are reset on
+ * each map draw, memory counters hold the size of allocated GL objects.
+ * Updated only in GL context thread.
+ */
+typedef struct _glStats {
+    unsigned int drawCalls;
+    unsigned int stateChanges;
+    size_t uploadedBytes;
+    long long bufferMemory;
+    long long textureMemory;
+} GlStats;
+
+GlStats &glStats();
+void resetGlFrameStats();
+
+/**
+ * @brief The GlState class Cache of GL context state: program in use, bound
+ * buffers and textures, vertex attributes, enabled capabilities, blend and
+ * depth functions, clear color and viewport. Calls which do not change the
+ * state are skipped. All values are unknown after reset(), which is called
+ * before each frame, as other GL code may change the state between frames.
+ * Only the attributes of own vertex arrays are kept, as they are unbound at
+ * frame end and other code can not change them. Objects must be unbound
+ * from cache with forget*() before deletion, as GL reuses the identifiers.
+ * Used only in GL context thread.
+ */
+class GlState
+{
+public:
+    static void reset();
+    static void useProgram(GLuint id);
+    static void bindVertexArray(GLuint id);
+    static void bindBuffer(GLenum target, GLuint id);
+    static void vertexAttribPointer(GLuint index, GLint size, GLsizei stride,
+                                    const GLvoid *pointer);
+    static void activeTexture(GLenum unit);
+    static void bindTexture(GLuint id);
+    static void setEnabled(GLenum capability, bool enabled);
+    static void blendFunc(GLenum source, GLenum destination);
+    static void blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB,
+                                  GLenum sourceAlpha, GLenum destinationAlpha);
+    static void depthFunc(GLenum func);
+    static void depthRange(GLfloat nearValue, GLfloat farValue);
+    static void hint(GLenum target, GLenum mode);
+    static void clearColor(const GlColor &color);
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void forgetProgram(GLuint id);
+    static void forgetBuffer(GLuint id);
+    static void forgetTexture(GLuint id);
+    static GLuint createVertexArray();
+    static void deleteVertexArray(GLuint id);
+};
 
 /**
  * @brief The GlObject class Base class for Gl objects
@@ -111,6 +169,10 @@ public:
     virtual void rebind() const = 0;
     virtual bool bound() const { return m_bound; }
     virtual void destroy() = 0;
+    /**
+     * @brief memorySize GL memory of the bound object in bytes.
+     */
+    virtual size_t memorySize() const { return 0; }
 
 protected:
     bool m_bound;
@@ -20,10 +20,100 @@
  ****************************************************************************/
 #include "image.h"
 
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 #include "cpl_conv.h"
 
 namespace ngs {
 
+constexpr size_t MAX_POOLED_TEXTURES_SIZE = 32 * 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// GlTexturePool
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The GlTexturePool class Keeps released texture objects to fill them
+ * by glTexSubImage2D for new tiles of the same size instead of
+ * glGenTextures/glDeleteTextures on each raster tile fill. Used only in GL
+ * context thread.
+ */
+class GlTexturePool
+{
+public:
+    static size_t textureSize(GLsizei width, GLsizei height) {
+        return static_cast<size_t>(width * height) * 4; // RGBA
+    }
+
+public:
+    GlTexturePool() : m_size(0) {}
+
+    GLuint acquire(GLsizei width, GLsizei height, bool &smooth) {
+        for(auto it = m_textures.begin(); it != m_textures.end(); ++it) {
+            if(it->width == width && it->height == height) {
+                GLuint id = it->id;
+                smooth = it->smooth;
+                m_size -= textureSize(width, height);
+                *it = m_textures.back();
+                m_textures.pop_back();
+                return id;
+            }
+        }
+        return 0;
+    }
+
+    void release(GLuint id, GLsizei width, GLsizei height, bool smooth) {
+        size_t size = textureSize(width, height);
+        if(m_size + size > MAX_POOLED_TEXTURES_SIZE) {
+            GlState::forgetTexture(id);
+            ngsCheckGLError(glDeleteTextures(1, &id));
+            glStats().textureMemory -= static_cast<long long>(size);
+            return;
+        }
+        m_size += size;
+        m_textures.push_back({id, width, height, smooth});
+    }
+
+    void clear() {
+        for(const auto &texture : m_textures) {
+            GlState::forgetTexture(texture.id);
+            ngsCheckGLError(glDeleteTextures(1, &texture.id));
+            glStats().textureMemory -= static_cast<long long>(
+                        textureSize(texture.width, texture.height));
+        }
+        m_textures.clear();
+        m_size = 0;
+    }
+
+private:
+    typedef struct _pooledTexture {
+        GLuint id;
+        GLsizei width, height;
+        bool smooth;
+    } PooledTexture;
+
+private:
+    std::vector<PooledTexture> m_textures;
+    size_t m_size;
+};
+
+static GlTexturePool gTexturePool;
+
+// Texture upload budget per frame
+static int gMaxUploadsPerFrame = 0;
+static double gMaxUploadTime = 0.0;
+static int gFrameUploads = 0;
+static double gFrameUploadTime = 0.0;
+
+//------------------------------------------------------------------------------
+// GlImage
+//------------------------------------------------------------------------------
+
 GlImage::GlImage() : GlObject(),
     m_imageData(nullptr),
     m_id(0),
@@ -43,29 +133,55 @@ void GlImage::bind()
 {
     if (m_bound)
         return;
-    ngsCheckGLError(glGenTextures(1, &m_id));
-    rebind();
-    ngsCheckGLError(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0,
-                    GL_RGBA, GL_UNSIGNED_BYTE, m_imageData));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool smooth = m_smooth;
+    m_id = gTexturePool.acquire(m_width, m_height, smooth);
+    if(m_id != 0) {
+        rebind();
+        if(smooth != m_smooth) {
+            setFilter();
+        }
+        if(m_imageData) {
+            ngsCheckGLError(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width,
+                                            m_height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                            m_imageData));
+        }
+    }
+    else {
+        ngsCheckGLError(glGenTextures(1, &m_id));
+        rebind();
+        // Texture parameters are the texture object state, so set them once
+        ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        setFilter();
+        ngsCheckGLError(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0,
+                        GL_RGBA, GL_UNSIGNED_BYTE, m_imageData));
+        glStats().textureMemory += static_cast<long long>(
+                    GlTexturePool::textureSize(m_width, m_height));
+    }
     m_bound = true;
 
-    CPLFree(m_imageData);
-    m_imageData = nullptr;
+    if(m_imageData) {
+        glStats().uploadedBytes += GlTexturePool::textureSize(m_width, m_height);
+        gFrameUploads++;
+        gFrameUploadTime += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+        CPLFree(m_imageData);
+        m_imageData = nullptr;
+    }
 }
 
 void GlImage::rebind() const
 {
-    ngsCheckGLError(glBindTexture(GL_TEXTURE_2D, m_id));
-    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_smooth ? GL_LINEAR : GL_NEAREST));
-    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_smooth ? GL_LINEAR : GL_NEAREST));
+    GlState::bindTexture(m_id);
 }
 
 void GlImage::destroy()
 {
     if (m_bound) {
-        ngsCheckGLError(glDeleteTextures(1, &m_id));
+        gTexturePool.release(m_id, m_width, m_height, m_smooth);
+        m_bound = false;
     }
 
     if(m_imageData) {
@@ -74,4 +190,226 @@ void GlImage::destroy()
     }
 }
 
+size_t GlImage::memorySize() const
+{
+    return m_bound ? GlTexturePool::textureSize(m_width, m_height) : 0;
+}
+
+void GlImage::setFilter() const
+{
+    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_smooth ? GL_LINEAR : GL_NEAREST));
+    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_smooth ? GL_LINEAR : GL_NEAREST));
+}
+
+/**
+ * @brief GlImage::clearPool Delete texture objects kept for reuse. Must be
+ * run in GL context before it destroyed.
+ */
+void GlImage::clearPool()
+{
+    gTexturePool.clear();
+}
+
+/**
+ * @brief GlImage::setUploadBudget Limit image data uploads per one frame draw.
+ * @param count Maximum uploads count. 0 - unlimited
+ * @param time Maximum uploads time in milliseconds. 0 - unlimited
+ */
+void GlImage::setUploadBudget(int count, double time)
+{
+    gMaxUploadsPerFrame = count;
+    gMaxUploadTime = time;
+}
+
+/**
+ * @brief GlImage::startFrame Reset upload budget counters on new frame draw.
+ */
+void GlImage::startFrame()
+{
+    gFrameUploads = 0;
+    gFrameUploadTime = 0.0;
+}
+
+/**
+ * @brief GlImage::canUpload Check if image data upload fits in current frame
+ * budget. Postponed images are uploaded in next frames.
+ * @return true if upload is allowed
+ */
+bool GlImage::canUpload()
+{
+    if(gMaxUploadsPerFrame > 0 && gFrameUploads >= gMaxUploadsPerFrame) {
+        return false;
+    }
+    if(gMaxUploadTime > 0.0 && gFrameUploadTime >= gMaxUploadTime) {
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Band conversion
+//------------------------------------------------------------------------------
+constexpr size_t CONVERT_CHUNK_SIZE = 256;
+constexpr double HILLSHADE_AZIMUTH = 315.0;
+constexpr double HILLSHADE_ALTITUDE = 45.0;
+constexpr float HILLSHADE_AMBIENT = 0.3f;
+
+ColorRamp::ColorRamp() :
+    m_min(0.0f),
+    m_scale(0.0f)
+{
+}
+
+/**
+ * @brief ColorRamp::setStops Set ramp colors and fill the lookup table.
+ * @param stops Values and colors. Values out of stops range get the first or
+ * the last color.
+ */
+void ColorRamp::setStops(const std::vector<ColorRampStop> &stops)
+{
+    m_stops = stops;
+    std::sort(m_stops.begin(), m_stops.end(),
+              [](const ColorRampStop &a, const ColorRampStop &b) {
+        return a.value < b.value;
+    });
+    m_table.clear();
+    if(m_stops.empty()) {
+        return;
+    }
+
+    double min = m_stops.front().value;
+    double max = m_stops.back().value;
+    m_min = static_cast<float>(min);
+    m_scale = max > min ? static_cast<float>(255.0 / (max - min)) : 0.0f;
+
+    m_table.resize(256 * 4);
+    size_t stop = 0;
+    for(int i = 0; i < 256; ++i) {
+        double value = m_scale > 0.0f ? min + i / static_cast<double>(m_scale) :
+                                        min;
+        while(stop + 1 < m_stops.size() && m_stops[stop + 1].value < value) {
+            stop++;
+        }
+        const ColorRampStop &from = m_stops[stop];
+        const ColorRampStop &to = m_stops[std::min(stop + 1, m_stops.size() - 1)];
+        double range = to.value - from.value;
+        double t = range > 0.0 ? (value - from.value) / range : 0.0;
+        t = std::max(0.0, std::min(1.0, t));
+        GLubyte *entry = &m_table[static_cast<size_t>(i) * 4];
+        entry[0] = static_cast<GLubyte>(from.color.R + (to.color.R - from.color.R) * t + 0.5);
+        entry[1] = static_cast<GLubyte>(from.color.G + (to.color.G - from.color.G) * t + 0.5);
+        entry[2] = static_cast<GLubyte>(from.color.B + (to.color.B - from.color.B) * t + 0.5);
+        entry[3] = static_cast<GLubyte>(from.color.A + (to.color.A - from.color.A) * t + 0.5);
+    }
+}
+
+/**
+ * @brief ColorRamp::apply Convert values to RGBA pixels. Values are turned to
+ * the table indexes in chunks by loop without branches, then colors are
+ * copied from the table.
+ * @param values Band values
+ * @param count Values count
+ * @param rgba Output pixels, 4 bytes per value
+ * @param hasNoData If true, noData values get transparent color
+ * @param noData No data value
+ */
+void ColorRamp::apply(const float *values, size_t count, GLubyte *rgba,
+                      bool hasNoData, float noData) const
+{
+    if(m_table.empty()) {
+        return;
+    }
+
+    GLubyte indexes[CONVERT_CHUNK_SIZE];
+    for(size_t start = 0; start < count; start += CONVERT_CHUNK_SIZE) {
+        size_t chunk = std::min(CONVERT_CHUNK_SIZE, count - start);
+        const float *chunkValues = values + start;
+        for(size_t i = 0; i < chunk; ++i) {
+            float index = (chunkValues[i] - m_min) * m_scale;
+            index = std::min(255.0f, std::max(0.0f, index));
+            indexes[i] = static_cast<GLubyte>(index + 0.5f);
+        }
+        paletteToRGBA(indexes, chunk, m_table.data(), rgba + start * 4);
+    }
+
+    for(size_t i = 0; i < count; ++i) {
+        // NaN values are not equal to themselves
+        if(values[i] != values[i] || (hasNoData && values[i] == noData)) {
+            rgba[i * 4 + 3] = 0;
+        }
+    }
+}
+
+/**
+ * @brief paletteToRGBA Convert palette indexes to RGBA pixels.
+ * @param indexes Palette indexes
+ * @param count Indexes count
+ * @param palette 256 RGBA entries
+ * @param rgba Output pixels, 4 bytes per index
+ */
+void paletteToRGBA(const GLubyte *indexes, size_t count,
+                   const GLubyte *palette, GLubyte *rgba)
+{
+    for(size_t i = 0; i < count; ++i) {
+        std::memcpy(rgba + i * 4, palette + indexes[i] * 4, 4);
+    }
+}
+
+/**
+ * @brief applyHillshade Darken RGB of pixels by the hillshade computed from
+ * heights with Horn's method. Light comes from north west at 45 degrees.
+ * Window edge pixels use the nearest heights inside window.
+ * @param values Heights
+ * @param width Window width
+ * @param height Window height
+ * @param xRes Pixel width in height units
+ * @param yRes Pixel height in height units
+ * @param rgba Pixels to shade
+ */
+void applyHillshade(const float *values, int width, int height, double xRes,
+                    double yRes, GLubyte *rgba)
+{
+    if(width <= 0 || height <= 0 || xRes == 0.0 || yRes == 0.0) {
+        return;
+    }
+
+    const float azimuth = static_cast<float>(HILLSHADE_AZIMUTH * M_PI / 180.0);
+    const float altitude = static_cast<float>(HILLSHADE_ALTITUDE * M_PI / 180.0);
+    const float sinAlt = std::sin(altitude);
+    const float cosAzCosAlt = std::cos(azimuth) * std::cos(altitude);
+    const float sinAzCosAlt = std::sin(azimuth) * std::cos(altitude);
+    const float xScale = static_cast<float>(1.0 / (8.0 * std::fabs(xRes)));
+    const float yScale = static_cast<float>(1.0 / (8.0 * std::fabs(yRes)));
+
+    std::vector<float> shade(static_cast<size_t>(width));
+    for(int y = 0; y < height; ++y) {
+        const float *up = values + static_cast<size_t>(std::max(y - 1, 0)) * width;
+        const float *mid = values + static_cast<size_t>(y) * width;
+        const float *down = values +
+                static_cast<size_t>(std::min(y + 1, height - 1)) * width;
+        for(int x = 0; x < width; ++x) {
+            int left = std::max(x - 1, 0);
+            int right = std::min(x + 1, width - 1);
+            float dx = ((up[right] + 2 * mid[right] + down[right]) -
+                        (up[left] + 2 * mid[left] + down[left])) * xScale;
+            // Rows go to south, so north gradient is up minus down
+            float dy = ((up[left] + 2 * up[x] + up[right]) -
+                        (down[left] + 2 * down[x] + down[right])) * yScale;
+            float light = (sinAlt - (dy * cosAzCosAlt - dx * sinAzCosAlt)) /
+                    std::sqrt(1.0f + dx * dx + dy * dy);
+            light = std::min(1.0f, std::max(0.0f, light));
+            shade[static_cast<size_t>(x)] = HILLSHADE_AMBIENT +
+                    (1.0f - HILLSHADE_AMBIENT) * light;
+        }
+
+        GLubyte *row = rgba + static_cast<size_t>(y) * width * 4;
+        for(int x = 0; x < width; ++x) {
+            float factor = shade[static_cast<size_t>(x)];
+            row[x * 4] = static_cast<GLubyte>(row[x * 4] * factor);
+            row[x * 4 + 1] = static_cast<GLubyte>(row[x * 4 + 1] * factor);
+            row[x * 4 + 2] = static_cast<GLubyte>(row[x * 4 + 2] * factor);
+        }
+    }
+}
+
 } // namespace ngs
@@ -21,6 +21,9 @@
 #ifndef NGSGLIMAGE_H
 #define NGSGLIMAGE_H
 
+// std
+#include <vector>
+
 #include "functions.h"
 
 #include "ds/raster.h"
@@ -51,10 +54,19 @@ public:
     virtual void bind() override;
     virtual void rebind() const override;
     virtual void destroy() override;
+    virtual size_t memorySize() const override;
 
     GLuint id() const { return m_id; }
     void setSmooth(bool smooth) { m_smooth = smooth; }
 
+    static void clearPool();
+    static void setUploadBudget(int count, double time);
+    static void startFrame();
+    static bool canUpload();
+
+protected:
+    void setFilter() const;
+
 protected:
     GLubyte *m_imageData;
     GLsizei m_width, m_height;
@@ -64,6 +76,41 @@ protected:
 
 using GlImagePtr = std::shared_ptr<GlImage>;
 
+//------------------------------------------------------------------------------
+// Band conversion
+//------------------------------------------------------------------------------
+
+typedef struct _colorRampStop {
+    double value;
+    ngsRGBA color;
+} ColorRampStop;
+
+/**
+ * @brief The ColorRamp class Maps single band values (DEM heights, etc.) to
+ * RGBA colors. Colors between stops are interpolated linearly to 256 entries
+ * lookup table.
+ */
+class ColorRamp
+{
+public:
+    ColorRamp();
+    void setStops(const std::vector<ColorRampStop> &stops);
+    const std::vector<ColorRampStop> &stops() const { return m_stops; }
+    bool isEmpty() const { return m_stops.empty(); }
+    void apply(const float *values, size_t count, GLubyte *rgba,
+               bool hasNoData = false, float noData = 0.0f) const;
+
+private:
+    std::vector<ColorRampStop> m_stops;
+    std::vector<GLubyte> m_table;
+    float m_min, m_scale;
+};
+
+void paletteToRGBA(const GLubyte *indexes, size_t count,
+                   const GLubyte *palette, GLubyte *rgba);
+void applyHillshade(const float *values, int width, int height, double xRes,
+                    double yRes, GLubyte *rgba);
+
 } // namespace ngs
 
 #endif // NGSGLIMAGE_H
@@ -0,0 +1,279 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "label.h"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <set>
+
+#include "layer.h"
+
+namespace ngs {
+
+constexpr double LABEL_INDEX_CELL_SIZE = 64.0;
+// Time to place labels in one frame, in milliseconds
+constexpr double LABEL_PLACEMENT_BUDGET = 4.0;
+constexpr size_t LABEL_BUDGET_CHECK_STEP = 64;
+constexpr unsigned int INVALID_GLYPH = 0xFFFD;
+
+/**
+ * @brief labelGlyphs Decode UTF-8 label text to code points. Invalid sequences
+ * are replaced by U+FFFD.
+ * @param text Label text.
+ * @return Code points.
+ */
+std::vector<unsigned int> labelGlyphs(const std::string &text)
+{
+    std::vector<unsigned int> out;
+    out.reserve(text.size());
+    size_t i = 0;
+    while(i < text.size()) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t extra;
+        unsigned int glyph;
+        if(lead < 0x80) {
+            extra = 0;
+            glyph = lead;
+        }
+        else if((lead & 0xE0) == 0xC0) {
+            extra = 1;
+            glyph = lead & 0x1F;
+        }
+        else if((lead & 0xF0) == 0xE0) {
+            extra = 2;
+            glyph = lead & 0x0F;
+        }
+        else if((lead & 0xF8) == 0xF0) {
+            extra = 3;
+            glyph = lead & 0x07;
+        }
+        else {
+            out.push_back(INVALID_GLYPH);
+            ++i;
+            continue;
+        }
+
+        ++i;
+        size_t j = 0;
+        for(; j < extra && i < text.size(); ++j, ++i) {
+            unsigned char next = static_cast<unsigned char>(text[i]);
+            if((next & 0xC0) != 0x80) {
+                break;
+            }
+            glyph = (glyph << 6) | (next & 0x3F);
+        }
+        out.push_back(j == extra ? glyph : INVALID_GLYPH);
+    }
+    return out;
+}
+
+//------------------------------------------------------------------------------
+// LabelCollisionIndex
+//------------------------------------------------------------------------------
+
+LabelCollisionIndex::LabelCollisionIndex() :
+    m_columns(0),
+    m_rows(0)
+{
+}
+
+void LabelCollisionIndex::reset(double width, double height)
+{
+    m_columns = std::max(1, static_cast<int>(
+                             std::ceil(width / LABEL_INDEX_CELL_SIZE)));
+    m_rows = std::max(1, static_cast<int>(
+                          std::ceil(height / LABEL_INDEX_CELL_SIZE)));
+    m_boxes.clear();
+    m_cells.assign(static_cast<size_t>(m_columns * m_rows),
+                   std::vector<size_t>());
+}
+
+/**
+ * @brief LabelCollisionIndex::insert Add label box if it does not overlap
+ * already added boxes.
+ * @param box Label box in display coordinates.
+ * @return True if box was added.
+ */
+bool LabelCollisionIndex::insert(const Envelope &box)
+{
+    auto cell = [](double value, int count) {
+        int out = static_cast<int>(std::floor(value / LABEL_INDEX_CELL_SIZE));
+        return std::max(0, std::min(out, count - 1));
+    };
+    int begX = cell(box.minX(), m_columns);
+    int endX = cell(box.maxX(), m_columns);
+    int begY = cell(box.minY(), m_rows);
+    int endY = cell(box.maxY(), m_rows);
+
+    for(int y = begY; y <= endY; ++y) {
+        for(int x = begX; x <= endX; ++x) {
+            for(size_t index : m_cells[static_cast<size_t>(y * m_columns + x)]) {
+                if(m_boxes[index].intersects(box)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    for(int y = begY; y <= endY; ++y) {
+        for(int x = begX; x <= endX; ++x) {
+            m_cells[static_cast<size_t>(y * m_columns + x)].push_back(
+                        m_boxes.size());
+        }
+    }
+    m_boxes.push_back(box);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// GlLabels
+//------------------------------------------------------------------------------
+
+GlLabels::GlLabels() :
+    m_complete(false)
+{
+}
+
+/**
+ * @brief GlLabels::update Place labels of visible feature layers if view or
+ * labels changed. Upper layers labels are placed first. Placement stops when
+ * the frame budget is exceeded and is repeated on next draw.
+ * @param layers Map layers.
+ * @param tiles View tiles.
+ * @param transform Map transform.
+ * @param width View width in pixels.
+ * @param height View height in pixels.
+ */
+void GlLabels::update(const std::vector<LayerPtr> &layers,
+                      const std::vector<GlTilePtr> &tiles,
+                      const MapTransform &transform, int width, int height)
+{
+    std::vector<GlFeatureLayer*> labelLayers;
+    std::vector<LayerVersion> versions;
+    for(const LayerPtr &layer : layers) {
+        GlFeatureLayer *featureLayer = ngsDynamicCast(GlFeatureLayer, layer);
+        if(nullptr == featureLayer || !featureLayer->visible() ||
+                !featureLayer->glLabelStyle()) {
+            continue;
+        }
+        labelLayers.push_back(featureLayer);
+        versions.push_back({layer.get(), featureLayer->labelsVersion()});
+    }
+
+    glm::mat4 sceneMatrix = transform.getSceneMatrix();
+    if(m_complete && versions == m_versions && sceneMatrix == m_sceneMatrix) {
+        return;
+    }
+
+    clear();
+    m_versions = versions;
+    m_sceneMatrix = sceneMatrix;
+    m_complete = true;
+    m_index.reset(width, height);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t checked = 0;
+    for(GlFeatureLayer *featureLayer : labelLayers) {
+        LabelStylePtr style = featureLayer->glLabelStyle();
+        LabelCandidates candidates;
+        featureLayer->labelCandidates(tiles, candidates);
+        if(candidates.empty()) {
+            continue;
+        }
+
+        m_buffers.push_back({style, std::vector<GlBufferPtr>(), 0});
+        StyleBuffers &styleBuffers = m_buffers.back();
+        GlBuffer *buffer = nullptr;
+        // Feature may have candidates in several tiles
+        std::set<GIntBig> placedIds;
+        for(const LabelCandidate &candidate : candidates) {
+            if(++checked % LABEL_BUDGET_CHECK_STEP == 0 &&
+                    std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count() >
+                    LABEL_PLACEMENT_BUDGET) {
+                m_complete = false;
+                return;
+            }
+
+            if(placedIds.find(candidate.fid) != placedIds.end()) {
+                continue;
+            }
+
+            OGRRawPoint pt = transform.worldToDisplay(
+                        OGRRawPoint(static_cast<double>(candidate.anchor.x),
+                                    static_cast<double>(candidate.anchor.y)));
+            OGRRawPoint size = style->labelSize(candidate.glyphs.size());
+            Envelope box(pt.x - size.x / 2, pt.y - size.y / 2,
+                         pt.x + size.x / 2, pt.y + size.y / 2);
+            if(box.maxX() < 0.0 || box.minX() > width ||
+                    box.maxY() < 0.0 || box.minY() > height) {
+                continue;
+            }
+            if(!m_index.insert(box)) {
+                continue;
+            }
+            placedIds.insert(candidate.fid);
+
+            size_t verticesCount =
+                    style->labelVerticesCount(candidate.glyphs.size());
+            if(nullptr == buffer ||
+                    !buffer->canStoreVertices(verticesCount, true)) {
+                buffer = new GlBuffer(GlBuffer::BF_TEX);
+                styleBuffers.buffers.push_back(GlBufferPtr(buffer));
+                styleBuffers.index = 0;
+            }
+            styleBuffers.index = style->addLabel(candidate.anchor,
+                                                 candidate.glyphs,
+                                                 styleBuffers.index, buffer);
+        }
+    }
+}
+
+void GlLabels::draw(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix) const
+{
+    for(const StyleBuffers &styleBuffers : m_buffers) {
+        for(const GlBufferPtr &buffer : styleBuffers.buffers) {
+            if(buffer->bound()) {
+                buffer->rebind();
+            }
+            else {
+                buffer->bind();
+            }
+            styleBuffers.style->prepare(msMatrix, vsMatrix, buffer->type());
+            styleBuffers.style->draw(*buffer);
+        }
+    }
+}
+
+void GlLabels::clear()
+{
+    for(StyleBuffers &styleBuffers : m_buffers) {
+        for(GlBufferPtr &buffer : styleBuffers.buffers) {
+            buffer->destroy();
+        }
+    }
+    m_buffers.clear();
+    m_complete = false;
+}
+
+} // namespace ngs
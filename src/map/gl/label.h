@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSGLLABEL_H
+#define NGSGLLABEL_H
+
+// std
+#include <vector>
+
+#include "style.h"
+#include "tile.h"
+#include "map/layer.h"
+#include "map/maptransform.h"
+
+namespace ngs {
+
+/**
+ * @brief The LabelCandidate struct Label of tile item. Generated on tile fill,
+ * placed on draw.
+ */
+typedef struct _labelCandidate {
+    SimplePoint anchor;
+    std::vector<unsigned int> glyphs;
+    GIntBig fid;
+} LabelCandidate;
+
+using LabelCandidates = std::vector<LabelCandidate>;
+
+std::vector<unsigned int> labelGlyphs(const std::string &text);
+
+/**
+ * @brief The LabelCollisionIndex class Screen space boxes of placed labels in
+ * uniform grid cells.
+ */
+class LabelCollisionIndex
+{
+public:
+    LabelCollisionIndex();
+    void reset(double width, double height);
+    bool insert(const Envelope &box);
+
+private:
+    int m_columns, m_rows;
+    std::vector<Envelope> m_boxes;
+    std::vector<std::vector<size_t>> m_cells;
+};
+
+/**
+ * @brief The GlLabels class Places label candidates of feature layers tiles
+ * and draws them with one draw call per label style. Run in Gl context.
+ */
+class GlLabels
+{
+public:
+    GlLabels();
+    void update(const std::vector<LayerPtr> &layers,
+                const std::vector<GlTilePtr> &tiles,
+                const MapTransform &transform, int width, int height);
+    void draw(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix) const;
+    void clear();
+
+private:
+    typedef struct _styleBuffers {
+        LabelStylePtr style;
+        std::vector<GlBufferPtr> buffers;
+        GLuint index;
+    } StyleBuffers;
+
+    typedef struct _layerVersion {
+        const Layer *layer;
+        unsigned int version;
+        bool operator==(const struct _layerVersion &other) const {
+            return layer == other.layer && version == other.version;
+        }
+    } LayerVersion;
+
+private:
+    std::vector<StyleBuffers> m_buffers;
+    std::vector<LayerVersion> m_versions;
+    glm::mat4 m_sceneMatrix;
+    bool m_complete;
+    LabelCollisionIndex m_index;
+};
+
+} // namespace ngs
+
+#endif // NGSGLLABEL_H
@@ -19,38 +19,132 @@
  *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ****************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
 #include <math.h>
 
 #include "cpl_conv.h"
+#include "cpl_multiproc.h"
 #include "ogr_core.h"
 
+#include "fillcache.h"
 #include "layer.h"
 #include "style.h"
 #include "view.h"
+#include "ds/imagecache.h"
+#include "util/arena.h"
 #include "util/error.h"
 #include "util/settings.h"
+#include "util/threadpool.h"
 
 namespace ngs {
 
-constexpr unsigned char MAX_ZOOM = 18;
 constexpr double LOCK_TIME = 5.0;
+constexpr size_t MAX_FILL_LATENCY_SAMPLES = 256;
+constexpr int SNAP_INDEX_SIDE = 32;
+constexpr ngsRGBA DEFAULT_RAMP_LOW_COLOR = {38, 115, 0, 255};
+constexpr ngsRGBA DEFAULT_RAMP_HIGH_COLOR = {255, 255, 255, 255};
+// Limits draw calls per tile for graduated styles, other items use first class
+constexpr size_t MAX_STYLE_CLASSES = 256;
+constexpr const char *LOD_MAX_ITEMS_KEY = "lod_max_items";
+constexpr unsigned int DEFAULT_LOD_MAX_ITEMS = 4096;
+// Thinned tile keeps one point per cell of this size in pixels
+constexpr double LOD_POINT_CELL = 2.0;
+// Tile items of about this points count are filled by one thread
+constexpr size_t FILL_CHUNK_POINTS = 65536;
+
+/**
+ * @brief uploadPostponed Check if buffers upload does not fit in frame budget.
+ * @param buffers Tile buffers to draw
+ * @return True if some buffer is not bound and budget is spent.
+ */
+static bool uploadPostponed(const std::vector<GlBufferPtr> &buffers)
+{
+    if(GlBuffer::canUpload()) {
+        return false;
+    }
+    for(const GlBufferPtr &buff : buffers) {
+        if(!buff->bound()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief fillKeyHash Hash of the fill key, 0 is reserved for not shared fills.
+ */
+static size_t fillKeyHash(const std::string &key)
+{
+    size_t hash = std::hash<std::string>()(key);
+    return hash == 0 ? 1 : hash;
+}
+
+/**
+ * @brief tileItemStyleType Geometry type of tile item in mixed geometry layer.
+ * Polygon items have triangle indices, point items have the only point.
+ */
+static enum ngsStyleType tileItemStyleType(const FlatVectorTileItem &item)
+{
+    if(!item.indices().empty()) {
+        return ST_FILL;
+    }
+    return item.pointCount() == 1 ? ST_POINT : ST_LINE;
+}
+
+/**
+ * @brief tileItemsOfType Tile with items of one geometry type.
+ */
+static FlatVectorTile tileItemsOfType(const FlatVectorTile &vtile,
+                                      enum ngsStyleType type)
+{
+    VectorTileItemArray items;
+    for(auto it = vtile.begin(); it != vtile.end(); ++it) {
+        if(tileItemStyleType(*it) == type) {
+            items.push_back(VectorTileItem(*it));
+        }
+    }
+
+    VectorTile out;
+    out.add(std::move(items));
+    return FlatVectorTile(out);
+}
 
 //------------------------------------------------------------------------------
 // GlRenderLayer
 //------------------------------------------------------------------------------
 
-GlRenderLayer::GlRenderLayer()
+GlRenderLayer::GlRenderLayer() :
+    m_styleVersion(0),
+    m_fillLatencyPos(0)
 {
 }
 
 GlRenderLayer::~GlRenderLayer()
 {
+    LockStats stats = m_dataMutex.stats();
+    if(stats.contended > 0) {
+        CPLDebug("ngstore", "Layer data lock: " CPL_FRMT_GUIB " acquired, "
+                 CPL_FRMT_GUIB " contended, " CPL_FRMT_GUIB " us waited",
+                 stats.acquired, stats.contended, stats.waitTime);
+    }
+}
+
+void GlRenderLayer::readTiles(const std::vector<GlTilePtr> &tiles,
+                              const CancelToken &cancel)
+{
+    ngsUnused(tiles);
+    ngsUnused(cancel);
 }
 
 void GlRenderLayer::free(const GlTilePtr &tile)
 {
-    MutexHolder holder(m_dataMutex, LOCK_TIME);
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
     auto it = m_tiles.find(tile->getTile());
     if(it != m_tiles.end()) {
         if(it->second) {
@@ -58,6 +152,13 @@ void GlRenderLayer::free(const GlTilePtr &tile)
         }
         m_tiles.erase(it);
     }
+    auto refillIt = m_refills.find(tile->getTile());
+    if(refillIt != m_refills.end()) {
+        if(refillIt->second) {
+            refillIt->second->destroy();
+        }
+        m_refills.erase(refillIt);
+    }
 
     for(const StylePtr &style : m_oldStyles) {
         style->destroy();
@@ -66,6 +167,151 @@ void GlRenderLayer::free(const GlTilePtr &tile)
     // CPLDebug("ngstore", "GlRenderLayer::free: %ld GlObject in layer", m_tiles.size());
 }
 
+void GlRenderLayer::markRefill(const GlTilePtr &tile)
+{
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    auto it = m_tiles.find(tile->getTile());
+    if(it == m_tiles.end()) {
+        return;
+    }
+    GlObjectPtr &refill = m_refills[tile->getTile()];
+    if(refill && refill != it->second) {
+        refill->destroy();
+    }
+    refill = it->second;
+    m_tiles.erase(it);
+}
+
+/**
+ * @brief GlRenderLayer::refillData Data of the tile marked for refill.
+ * Executed from separate thread.
+ * @param tile Tile to refill
+ * @return Gl object or empty pointer.
+ */
+GlObjectPtr GlRenderLayer::refillData(const GlTilePtr &tile) const
+{
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    auto it = m_refills.find(tile->getTile());
+    return it == m_refills.end() ? GlObjectPtr() : it->second;
+}
+
+bool GlRenderLayer::hasData(const GlTilePtr &tile) const
+{
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    return m_tiles.find(tile->getTile()) != m_tiles.end();
+}
+
+/**
+ * @brief GlRenderLayer::memorySize GL memory of bound layer data for tile.
+ * Run from Gl context.
+ * @param tile Tile to check
+ * @return Size in bytes.
+ */
+size_t GlRenderLayer::memorySize(const GlTilePtr &tile) const
+{
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    auto it = m_tiles.find(tile->getTile());
+    if(it == m_tiles.end() || !it->second) {
+        return 0;
+    }
+    return it->second->memorySize();
+}
+
+/**
+ * @brief GlRenderLayer::setTileData Pass filled tile data to Gl context.
+ * Executed from separate thread. The data is stored to the layer tiles on
+ * next applyFills() call.
+ * @param tile Filled tile
+ * @param data Gl object or empty pointer if tile has nothing to draw
+ * @param cancel Fill cancel token. Canceled data is dropped.
+ */
+void GlRenderLayer::setTileData(const GlTilePtr &tile, const GlObjectPtr &data,
+                                const CancelToken &cancel)
+{
+    m_fills.push({tile, data, cancel});
+}
+
+/**
+ * @brief GlRenderLayer::applyFills Move data of finished fills to the layer
+ * tiles. Run from Gl context on frame start.
+ * @return Applied fills count
+ */
+size_t GlRenderLayer::applyFills()
+{
+    if(m_fills.empty()) {
+        return 0;
+    }
+
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    return m_fills.drain([this](TileFill &fill) {
+        // Refill may pass the data taken aside as is
+        auto refill = m_refills.find(fill.tile->getTile());
+        if(fill.cancel.isCanceled()) {
+            if(fill.data && (refill == m_refills.end() ||
+                             refill->second != fill.data)) {
+                fill.data->destroy();
+            }
+            return;
+        }
+        GlObjectPtr &data = m_tiles[fill.tile->getTile()];
+        if(data && data != fill.data) {
+            data->destroy();
+        }
+        data = fill.data;
+        if(refill != m_refills.end()) {
+            if(refill->second && refill->second != fill.data) {
+                refill->second->destroy();
+            }
+            m_refills.erase(refill);
+        }
+    });
+}
+
+void GlRenderLayer::addFillLatency(double time)
+{
+    SpinLockHolder holder(m_fillLatencyMutex);
+    if(m_fillLatencies.size() < MAX_FILL_LATENCY_SAMPLES) {
+        m_fillLatencies.push_back(time);
+    }
+    else {
+        m_fillLatencies[m_fillLatencyPos] = time;
+    }
+    m_fillLatencyPos = (m_fillLatencyPos + 1) % MAX_FILL_LATENCY_SAMPLES;
+}
+
+std::vector<double> GlRenderLayer::fillLatencies() const
+{
+    SpinLockHolder holder(m_fillLatencyMutex);
+    return m_fillLatencies;
+}
+
+/**
+ * @brief GlRenderLayer::fillLatency Tile fill latency percentile of last fills.
+ * @param percentile Percentile value in range 0 - 100
+ * @return Latency in milliseconds or 0 if no tiles filled yet
+ */
+double GlRenderLayer::fillLatency(double percentile) const
+{
+    return percentileValue(fillLatencies(), percentile);
+}
+
+double GlRenderLayer::percentileValue(std::vector<double> values,
+                                      double percentile)
+{
+    if(values.empty()) {
+        return 0.0;
+    }
+    percentile = std::max(0.0, std::min(percentile, 100.0));
+    size_t index = static_cast<size_t>(
+                std::ceil(percentile / 100.0 * values.size()));
+    if(index > 0) {
+        index--;
+    }
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index),
+                     values.end());
+    return values[index];
+}
+
 CPLJSONObject GlRenderLayer::style() const
 {
 	if(m_style) {
@@ -85,6 +331,7 @@ std::string GlRenderLayer::styleName() const
 bool GlRenderLayer::setStyle(const CPLJSONObject &style)
 {
     if(m_style) {
+        ++m_styleVersion;
         return m_style->load(style);
     }
     return false;
@@ -96,49 +343,135 @@ bool GlRenderLayer::setStyle(const CPLJSONObject &style)
 
 GlFeatureLayer::GlFeatureLayer(Map *map, const std::string &name) :
     FeatureLayer(map, name),
-    GlRenderLayer()
+    GlRenderLayer(),
+    m_labelsVersion(0),
+    m_lodMaxItems(DEFAULT_LOD_MAX_ITEMS)
+{
+}
+
+/**
+ * @brief GlFeatureLayer::readTiles Read tiles of the overviews levels by one
+ * query, so the following tile fills get them from tile cache.
+ * @param tiles Tiles to read.
+ * @param cancel Token to stop reading.
+ */
+void GlFeatureLayer::readTiles(const std::vector<GlTilePtr> &tiles,
+                               const CancelToken &cancel)
 {
+    if(!(m_bound && m_visible) || cancel.isCanceled()) {
+        return;
+    }
+
+    std::set<unsigned char> zoomLevels = m_featureClass->zoomLevels();
+    std::vector<Tile> levelTiles;
+    for(const GlTilePtr &tile : tiles) {
+        const Tile &t = tile->getTile();
+        if(t.z > m_minZoom && t.z < m_maxZoom &&
+                zoomLevels.find(t.z) != zoomLevels.end()) {
+            levelTiles.push_back(t);
+        }
+    }
+    if(levelTiles.size() > 1) {
+        m_featureClass->getTiles(levelTiles, cancel);
+    }
 }
 
-bool GlFeatureLayer::fill(const GlTilePtr &tile, float z, bool isLastTry)
+bool GlFeatureLayer::fill(const GlTilePtr &tile, float z, bool isLastTry,
+                          const CancelToken &cancel)
 {
     ngsUnused(isLastTry);
-    if(!(m_visible && tile->getTile().z > m_minZoom && tile->getTile().z < m_maxZoom)) {
-        MutexHolder holder(m_dataMutex, LOCK_TIME);
-        m_tiles[tile->getTile()] = GlObjectPtr();
+    if(cancel.isCanceled()) {
         return true;
     }
 
+    // Layer is empty until the datasource is bound
+    if(!(m_bound && m_visible && tile->getTile().z > m_minZoom &&
+         tile->getTile().z < m_maxZoom)) {
+        setTileData(tile, GlObjectPtr(), cancel);
+        return true;
+    }
+
+    // Data taken aside for refill is used again if neither the tile content
+    // nor the layer style changed
+    GUIntBig tileVersion = m_featureClass->tileVersion(tile->getTile());
+    unsigned int styleVersion = m_styleVersion;
+    GlObjectPtr refill = refillData(tile);
+    VectorGlObject *refillObject = ngsDynamicCast(VectorGlObject, refill);
+    if(nullptr != refillObject &&
+            refillObject->isFillVersion(tileVersion, styleVersion)) {
+        setTileData(tile, refill, cancel);
+        return true;
+    }
+
+    // Scratch memory of the previous tile filled by this worker is not used
+    ScratchArena::threadArena().reset();
+
+    // Other map may have filled the tile with the same style already
+    size_t hash = fillHash();
     VectorGlObject *bufferArray = nullptr;
-    VectorTile vtile = m_featureClass->getTile(tile->getTile(), tile->getExtent());
+    if(hash != 0) {
+        bufferArray = FillCache::instance().get(m_featureClass, tile->getTile(),
+                                                hash, z, tileVersion);
+    }
+
+    // Labels are placed by this map, so tile items are read anyway. Decoded
+    // tiles are shared by the tile cache.
+    FlatVectorTile vtile = m_featureClass->getTile(tile->getTile(),
+                                               tile->getExtent(), cancel);
+    if(cancel.isCanceled()) {
+        delete bufferArray;
+        return true;
+    }
+
+    if(m_lodMaxItems > 0 && vtile.itemCount() > m_lodMaxItems) {
+        vtile = lodTile(tile->getTile(), tile->getExtent(), vtile, cancel);
+        if(cancel.isCanceled()) {
+            delete bufferArray;
+            return true;
+        }
+    }
+
+    fillLabels(tile->getTile(), vtile, cancel);
+
+    if(bufferArray) {
+        bufferArray->setFillVersion(tileVersion, styleVersion);
+        setTileData(tile, GlObjectPtr(bufferArray), cancel);
+        return true;
+    }
+
     if(vtile.empty()) {
-        MutexHolder holder(m_dataMutex, LOCK_TIME);
-        m_tiles[tile->getTile()] = GlObjectPtr();
+        setTileData(tile, GlObjectPtr(), cancel);
         return true;
     }
 
-    switch(m_style->type()) {
-    case ST_POINT:
-        bufferArray = fillPoints(vtile, z);
-        break;
-    case ST_LINE:
-        bufferArray = fillLines(vtile, z);
-        break;
-    case ST_FILL:
-        bufferArray = fillPolygons(vtile, z);
-        break;
-    case ST_IMAGE:
+    if(m_style->type() == ST_IMAGE) {
+        return true;
+    }
+    bufferArray = fillStyle(tile->getTile(), vtile, z, m_style, cancel);
+
+    // Tile was removed or invalidated while filling, drop partial data
+    if(cancel.isCanceled()) {
+        delete bufferArray;
         return true;
     }
 
     if(!bufferArray) {
-        MutexHolder holder(m_dataMutex, LOCK_TIME);
-        m_tiles[tile->getTile()] = GlObjectPtr();
+        setTileData(tile, GlObjectPtr(), cancel);
         return true;
     }
 
-    MutexHolder holder(m_dataMutex, LOCK_TIME);
-    m_tiles[tile->getTile()] = GlObjectPtr(bufferArray);
+    bufferArray->setFillVersion(tileVersion, styleVersion);
+    bufferArray->setIndex(new TileItemIndex(vtile));
+    if(m_snapping) {
+        bufferArray->setSnapIndex(new SnapIndex(vtile, m_style->type()));
+    }
+
+    if(hash != 0) {
+        FillCache::instance().put(m_featureClass, tile->getTile(), hash, z,
+                                  tileVersion, bufferArray);
+    }
+
+    setTileData(tile, GlObjectPtr(bufferArray), cancel);
 
     return true;
 }
@@ -152,7 +485,7 @@ bool GlFeatureLayer::draw(const GlTilePtr &tile)
         return true; // Should never happened
     }
 
-    MutexHolder holder(m_dataMutex, 5);
+    // Tiles are changed only in Gl context, no lock needed
     auto tileDataIt = m_tiles.find(tile->getTile());
     if(tileDataIt == m_tiles.end()) {
         return false; // Data not yet loaded
@@ -161,8 +494,46 @@ bool GlFeatureLayer::draw(const GlTilePtr &tile)
         return true; // Out of tile extent
     }
 
+    VectorMixedGlObject *mixed = ngsDynamicCast(VectorMixedGlObject,
+                                                tileDataIt->second);
+    if(mixed) {
+        if(mixed->uploadPostponed()) {
+            return false; // Upload in next frame
+        }
+        MixedStyle *style = ngsDynamicCast(MixedStyle, m_style);
+        if(nullptr == style) {
+            return true; // Filled before style change
+        }
+        for(const auto &part : mixed->parts()) {
+            drawObject(tile, ngsDynamicCast(VectorGlObject, part.second),
+                       style->style(part.first));
+        }
+        return true;
+    }
+
     VectorGlObject *vectorGlObject = ngsDynamicCast(VectorGlObject,
                                                     tileDataIt->second);
+    if(uploadPostponed(vectorGlObject->buffers())) {
+        return false; // Upload in next frame
+    }
+    drawObject(tile, vectorGlObject, m_style);
+    return true;
+}
+
+/**
+ * @brief GlFeatureLayer::drawObject Draw all buffers of tile data.
+ * @param tile Tile to draw.
+ * @param vectorGlObject Tile data.
+ * @param style Style to draw.
+ */
+void GlFeatureLayer::drawObject(const GlTilePtr &tile,
+                                const VectorGlObject *vectorGlObject,
+                                const StylePtr &style)
+{
+    HeatmapStyle *heatmap = ngsDynamicCast(HeatmapStyle, style);
+    if(heatmap) {
+        heatmap->beginDensity(tile->tileSize());
+    }
     for(const GlBufferPtr& buff : vectorGlObject->buffers()) {
 
         if(buff->bound()) {
@@ -172,11 +543,13 @@ bool GlFeatureLayer::draw(const GlTilePtr &tile)
             buff->bind();
         }
 
-        m_style->prepare(tile->getSceneMatrix(), tile->getInvViewMatrix(),
-                         buff->type());
-        m_style->draw(*buff);
+        style->prepare(tile->getSceneMatrix(), tile->getInvViewMatrix(),
+                       buff->type());
+        style->draw(*buff);
+    }
+    if(heatmap) {
+        heatmap->endDensity();
     }
-    return true;
 }
 
 bool GlFeatureLayer::setStyleName(const std::string &name)
@@ -190,10 +563,40 @@ bool GlFeatureLayer::setStyleName(const std::string &name)
     if(newStyle) {
         m_oldStyles.push_back(m_style);
         m_style = newStyle;
+        ++m_styleVersion;
     }
     return true;
 }
 
+/**
+ * @brief GlFeatureLayer::fillHash Hash of everything the filled buffers depend
+ * on besides the tile content, so layers of different maps with the same hash
+ * can share them.
+ * @return Hash value or 0 if filled buffers are not shared.
+ */
+size_t GlFeatureLayer::fillHash() const
+{
+    // Hidden items are skipped on fill
+    if(!m_style || !m_hideFIDs.empty()) {
+        return 0;
+    }
+    return fillKeyHash(fillKey());
+}
+
+std::string GlFeatureLayer::fillKey() const
+{
+    return m_style->name() + "/" + m_style->save().Format(CPLJSONObject::Plain) +
+            "/" + std::to_string(m_lodMaxItems) + "/" + (m_snapping ? "1" : "0");
+}
+
+void GlFeatureLayer::setHideIds(const FeatureIDs &hideIds)
+{
+    // Hidden items are skipped on fill
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    FeatureLayer::setHideIds(hideIds);
+    ++m_styleVersion;
+}
+
 bool GlFeatureLayer::load(const CPLJSONObject &store,
                           ObjectContainer *objectContainer)
 {
@@ -201,6 +604,13 @@ bool GlFeatureLayer::load(const CPLJSONObject &store,
     if(!result) {
         return false;
     }
+    m_lodMaxItems = static_cast<unsigned int>(
+                store.GetInteger(LOD_MAX_ITEMS_KEY,
+                                 static_cast<int>(m_lodMaxItems)));
+    CPLJSONObject label = store.GetObj("label");
+    if(label.IsValid()) {
+        setLabelStyle(label);
+    }
     std::string styleName = store.GetString("style_name", "");
     if(!styleName.empty()) {
         GlView *mapView = dynamic_cast<GlView*>(m_map);
@@ -217,6 +627,10 @@ CPLJSONObject GlFeatureLayer::save(const ObjectContainer *objectContainer) const
         out.Add("style_name", m_style->name());
         out.Add("style", m_style->save());
     }
+    if(m_labelStyle) {
+        out.Add("label", labelStyle());
+    }
+    out.Add(LOD_MAX_ITEMS_KEY, static_cast<int>(m_lodMaxItems));
     return out;
 }
 
@@ -237,152 +651,587 @@ void GlFeatureLayer::setFeatureClass(const FeatureClassOverviewPtr &featureClass
     case wkbMultiPolygon:
         m_style = StylePtr(Style::createStyle("simpleFillBordered", mapView->textureAtlas()));
         break;
+    case wkbUnknown:
+    case wkbGeometryCollection:
+        m_style = StylePtr(Style::createStyle("mixed", mapView->textureAtlas()));
+        break;
     }
 }
 
-VectorGlObject *GlFeatureLayer::fillPoints(const VectorTile &tile, float z)
+/**
+ * @brief GlFeatureLayer::identify Find features by items of loaded tiles.
+ * Items which envelopes are inside the extent are hits, items which envelopes
+ * only intersect the extent are checked by exact feature geometry. If no tiles
+ * loaded yet, the feature class is queried.
+ * @param env Extent in map coordinates.
+ * @param cancel Cancel token.
+ * @return Feature identifiers. Hidden features are not excluded.
+ */
+FeatureIDs GlFeatureLayer::identify(const Envelope &env,
+                                    const CancelToken &cancel) const
 {
-    VectorGlObject *bufferArray = new VectorGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
-    unsigned short index = 0;
-    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_PT);
-    PointStyle *style = ngsDynamicCast(PointStyle, m_style);
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
-        if(!m_hideFIDs.empty() && tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
-            continue;
-        }
-
-        if(tileItem.pointCount() < 1) {
-            ++it;
-            continue;
-        }
-
-        for(size_t i = 0; i < tileItem.pointCount(); ++i) {
-            if(!buffer->canStoreVertices(style->pointVerticesCount(), true)) {
-                bufferArray->addBuffer(buffer);
-                index = 0;
-                buffer = new GlBuffer(GlBuffer::BF_PT);
+    FeatureIDs hits, candidates;
+    bool indexed = false;
+    {
+        SharedHolder holder(m_dataMutex, LOCK_TIME);
+        for(const auto &tileData : m_tiles) {
+            if(!tileData.second) {
+                continue;
             }
+            VectorGlObject *vectorGlObject =
+                    ngsDynamicCast(VectorGlObject, tileData.second);
+            if(nullptr == vectorGlObject || nullptr == vectorGlObject->index()) {
+                continue;
+            }
+            indexed = true;
 
-            const SimplePoint& pt = tileItem.point(i);
-            index = style->addPoint(pt, z, index, buffer);
+            // Tile items of world copies have the original coordinates
+            Envelope tileEnv = env;
+            tileEnv.move(-tileData.first.crossExtent * DEFAULT_BOUNDS.width(),
+                         0.0);
+            vectorGlObject->index()->search(tileEnv, hits, candidates);
         }
-        ++it;
     }
 
-    bufferArray->addBuffer(buffer);
+    if(!indexed) {
+        return FeatureLayer::identify(env, cancel);
+    }
 
-    return bufferArray;
+    candidates.erase(hits);
+    for(GIntBig fid : refineIdentify(candidates, env, cancel)) {
+        hits.insert(fid);
+    }
+    return hits;
 }
 
-VectorGlObject *GlFeatureLayer::fillLines(const VectorTile &tile, float z)
+/**
+ * @brief GlFeatureLayer::snap Find the nearest vertex or segment point in
+ * snap indexes of loaded tiles. Indexes are built on tile fill only if layer
+ * snapping is on. Hidden features are skipped.
+ * @param pt Point in map coordinates.
+ * @param tolerance Snap distance in map units.
+ * @param result Nearest point found so far, updated if a better one is found.
+ * @return True if any point within tolerance was found in the layer.
+ */
+bool GlFeatureLayer::snap(const OGRRawPoint &pt, double tolerance,
+                          SnapResult &result) const
 {
-    VectorGlObject *bufferArray = new VectorGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
-    unsigned short index = 0;
-    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_LINE);
-    SimpleLineStyle *style = ngsStaticCast(SimpleLineStyle, m_style);
-
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
-        if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
+    bool found = false;
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    for(const auto &tileData : m_tiles) {
+        if(!tileData.second) {
             continue;
         }
-
-        if(tileItem.pointCount() < 2) {
-            ++it;
+        VectorGlObject *vectorGlObject =
+                ngsDynamicCast(VectorGlObject, tileData.second);
+        if(nullptr == vectorGlObject || nullptr == vectorGlObject->snapIndex()) {
             continue;
         }
 
-        // Check if line is closed or not
-        bool closed = tileItem.isClosed();
-
-        Normal prevNormal;
-        for(size_t i = 0; i < tileItem.pointCount() - 1; ++i) {
-            const SimplePoint& pt1 = tileItem.point(i);
-            const SimplePoint& pt2 = tileItem.point(i + 1);
-            Normal normal = ngsGetNormals(pt1, pt2);
-
-            if(i == 0 || i == tileItem.pointCount() - 2) { // Add cap
-                if(!closed) {
-                    if(i == 0) {
-                        if(!buffer->canStoreVertices(style->lineCapVerticesCount(),
-                                                     true)) {
-                            bufferArray->addBuffer(buffer);
-                            index = 0;
-                            buffer = new GlBuffer(GlBuffer::BF_LINE);
-                        }
-                        index = style->addLineCap(pt1, normal, z, index, buffer);
-                    }
-
-                    if(i == tileItem.pointCount() - 2) {
-                        if(!buffer->canStoreVertices(style->lineCapVerticesCount(),
-                                                     true)) {
-                            bufferArray->addBuffer(buffer);
-                            index = 0;
-                            buffer = new GlBuffer(GlBuffer::BF_LINE);
-                        }
-
-                        Normal reverseNormal;
-                        reverseNormal.x = -normal.x;
-                        reverseNormal.y = -normal.y;
-                        index = style->addLineCap(pt2, reverseNormal, z, index, buffer);
-                    }
-                }
-            }
+        // Tile items of world copies have the original coordinates
+        double shift = tileData.first.crossExtent * DEFAULT_BOUNDS.width();
+        SnapResult tileResult;
+        vectorGlObject->snapIndex()->snap(OGRRawPoint(pt.x - shift, pt.y),
+                                          tolerance, m_hideFIDs, tileResult);
+        if(tileResult.found) {
+            tileResult.point.x += shift;
+            result.update(tileResult.point, tileResult.distance2,
+                          tileResult.vertex);
+            found = true;
+        }
+    }
+    return found;
+}
 
-            if(i != 0) { // Add join
-                if(!buffer->canStoreVertices(style->lineJoinVerticesCount(),
-                                             true)) {
-                    bufferArray->addBuffer(buffer);
-                    index = 0;
-                    buffer = new GlBuffer(GlBuffer::BF_LINE);
-                }
-                index = style->addLineJoin(pt1, prevNormal, normal, z, index,
-                                           buffer);
-            }
+/**
+ * @brief GlFeatureLayer::setLabelStyle Set label field and style. Label
+ * candidates are generated on tile fill, so layer should be invalidated to
+ * show labels of the new field.
+ * @param style Label style with the field key. Empty field turns labels off.
+ * @return True on success.
+ */
+bool GlFeatureLayer::setLabelStyle(const CPLJSONObject &style)
+{
+    std::string field = style.GetString("field", "");
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    m_labelField = field;
+    m_labels.clear();
+    m_labelsVersion++;
+    ++m_styleVersion;
+    if(field.empty()) {
+        m_labelStyle.reset();
+        return true;
+    }
 
-            if(!buffer->canStoreVertices(12, true)) {
-                bufferArray->addBuffer(buffer);
-                index = 0;
-                buffer = new GlBuffer(GlBuffer::BF_LINE);
-            }
+    GlView *mapView = dynamic_cast<GlView*>(m_map);
+    if(nullptr == mapView) {
+        return false;
+    }
+    LabelStylePtr newStyle(new LabelStyle(mapView->textureAtlas()));
+    if(!newStyle->load(style)) {
+        m_labelStyle.reset();
+        return false;
+    }
+    if(m_labelStyle) {
+        m_oldStyles.push_back(m_labelStyle);
+    }
+    m_labelStyle = newStyle;
+    return true;
+}
 
-            index = style->addSegment(pt1, pt2, normal, z, index, buffer);
-            prevNormal = normal;
-        }
-        ++it;
+CPLJSONObject GlFeatureLayer::labelStyle() const
+{
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    if(!m_labelStyle) {
+        return CPLJSONObject();
     }
-    bufferArray->addBuffer(buffer);
+    CPLJSONObject out = m_labelStyle->save();
+    out.Add("field", m_labelField);
+    return out;
+}
 
-    return bufferArray;
+LabelStylePtr GlFeatureLayer::glLabelStyle() const
+{
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    return m_labelStyle;
 }
 
-VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
+unsigned int GlFeatureLayer::labelsVersion() const
 {
-    VectorGlObject *bufferArray = new VectorGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
-    unsigned short fillIndex = 0;
-    unsigned short lineIndex = 0;
-    GlBuffer *fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
-    GlBuffer *lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-    SimpleLineStyle *style = ngsStaticCast(SimpleLineStyle, m_style);
+    SharedHolder holder(m_dataMutex, LOCK_TIME);
+    return m_labelsVersion;
+}
 
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
-        if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
+/**
+ * @brief GlFeatureLayer::labelCandidates Get label candidates of the tiles.
+ * Candidates of other tiles are freed. Run in Gl context.
+ * @param tiles View tiles.
+ * @param candidates Output candidates in map coordinates.
+ */
+void GlFeatureLayer::labelCandidates(const std::vector<GlTilePtr> &tiles,
+                                     LabelCandidates &candidates)
+{
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    std::map<Tile, LabelCandidates> viewLabels;
+    for(const GlTilePtr &tile : tiles) {
+        auto it = m_labels.find(tile->getTile());
+        if(it == m_labels.end()) {
             continue;
         }
+        // Tile items of world copies have the original coordinates
+        float shift = static_cast<float>(it->first.crossExtent *
+                                         DEFAULT_BOUNDS.width());
+        for(const LabelCandidate &candidate : it->second) {
+            candidates.push_back(candidate);
+            candidates.back().anchor.x += shift;
+        }
+        viewLabels[it->first] = std::move(it->second);
+    }
+    m_labels.swap(viewLabels);
+}
 
-        auto points = tileItem.points();
-        auto indices = tileItem.indices();
+/**
+ * @brief labelAnchor Label point of tile item: the point, the middle of the
+ * line or the polygon centroid.
+ */
+static SimplePoint labelAnchor(const FlatVectorTileItem &item,
+                               enum ngsStyleType type)
+{
+    if(type == ST_FILL && !item.centroids().empty()) {
+        return item.centroids()[0];
+    }
+
+    if(type == ST_LINE && item.pointCount() > 1) {
+        float length = 0.0f;
+        for(size_t i = 1; i < item.pointCount(); ++i) {
+            length += std::hypot(item.point(i).x - item.point(i - 1).x,
+                                 item.point(i).y - item.point(i - 1).y);
+        }
+        float half = length / 2;
+        for(size_t i = 1; i < item.pointCount(); ++i) {
+            const SimplePoint &pt1 = item.point(i - 1);
+            const SimplePoint &pt2 = item.point(i);
+            float segment = std::hypot(pt2.x - pt1.x, pt2.y - pt1.y);
+            if(segment >= half && segment > 0.0f) {
+                float t = half / segment;
+                return {pt1.x + (pt2.x - pt1.x) * t, pt1.y + (pt2.y - pt1.y) * t};
+            }
+            half -= segment;
+        }
+    }
+    return item.point(0);
+}
+
+/**
+ * @brief GlFeatureLayer::fillLabels Generate label candidates of tile items.
+ * Label text is the label field value of the first item feature. The value is
+ * read from the tile if overviews store the label field. The point_count field
+ * labels point clusters by the features count. Executed from separate thread.
+ * @param tile Tile of the items.
+ * @param vtile Tile items.
+ * @param cancel Token to stop if tile is no longer needed.
+ */
+void GlFeatureLayer::fillLabels(const Tile &tile, const FlatVectorTile &vtile,
+                                const CancelToken &cancel)
+{
+    std::string field;
+    enum ngsStyleType type;
+    {
+        SharedHolder holder(m_dataMutex, LOCK_TIME);
+        if(m_labelField.empty() || !m_labelStyle || !m_style) {
+            return;
+        }
+        field = m_labelField;
+        type = m_style->type();
+    }
+
+    int column = vtile.columnIndex(field);
+    LabelCandidates candidates;
+    for(auto it = vtile.begin(); it != vtile.end(); ++it) {
+        if(cancel.isCanceled()) {
+            return;
+        }
+        const FlatVectorTileItem &tileItem = *it;
+        if(tileItem.ids().empty() || tileItem.pointCount() == 0) {
+            continue;
+        }
+        GIntBig fid = tileItem.ids()[0];
+        std::vector<unsigned int> glyphs;
+        if(column >= 0) {
+            if(tileItem.isAttributeNull(static_cast<size_t>(column))) {
+                continue;
+            }
+            glyphs = labelGlyphs(
+                        tileItem.attributeString(static_cast<size_t>(column)));
+        }
+        else if(field == CLUSTER_COUNT_FIELD) {
+            // Only clusters are labeled by count
+            if(tileItem.ids().size() < 2) {
+                continue;
+            }
+            glyphs = labelGlyphs(std::to_string(tileItem.ids().size()));
+        }
+        else {
+            FeaturePtr feature = m_featureClass->getFeature(fid);
+            if(!feature) {
+                continue;
+            }
+            int index = feature->GetFieldIndex(field.c_str());
+            if(index < 0 || !feature->IsFieldSetAndNotNull(index)) {
+                continue;
+            }
+            glyphs = labelGlyphs(feature->GetFieldAsString(index));
+        }
+        if(glyphs.empty()) {
+            continue;
+        }
+        enum ngsStyleType itemType = type == ST_MIXED ?
+                    tileItemStyleType(tileItem) : type;
+        candidates.push_back({labelAnchor(tileItem, itemType), glyphs, fid});
+    }
+
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    if(field != m_labelField) {
+        return; // Label field changed while filling
+    }
+    m_labels[tile] = std::move(candidates);
+    m_labelsVersion++;
+}
+
+/**
+ * @brief GlFeatureLayer::fillStyleClasses Evaluate data driven style properties
+ * of tile items and group items with equal values to style classes. Items of
+ * one class are drawn in one pass. Attributes are read from the tile columns,
+ * feature of item is read only if style needs a field the tile does not store.
+ * Executed from separate thread.
+ * @param tile Tile of the items, zoom level is used in expressions.
+ * @param vtile Tile items.
+ * @param bufferArray Tile buffers to store classes.
+ * @param style Data driven style of the items.
+ * @param cancel Token to stop if tile is no longer needed.
+ */
+void GlFeatureLayer::fillStyleClasses(const Tile &tile,
+                                      const FlatVectorTile &vtile,
+                                      VectorSelectableGlObject *bufferArray,
+                                      const StylePtr &style,
+                                      const CancelToken &cancel)
+{
+    ExpressionContext context(tile.z);
+    std::vector<StyleClass> classes;
+    std::vector<unsigned short> itemClasses;
+    StyleClass values;
+    if(!style->isFeatureDependent()) {
+        style->evaluate(context, values);
+        classes.push_back(values);
+        bufferArray->setStyleClasses(std::move(itemClasses), std::move(classes));
+        return;
+    }
+
+    std::map<StyleClass, unsigned short> classIndices;
+    itemClasses.reserve(vtile.itemCount());
+    for(auto it = vtile.begin(); it != vtile.end(); ++it) {
+        if(cancel.isCanceled()) {
+            return;
+        }
+        const FlatVectorTileItem &tileItem = *it;
+        context.setTileItem(&vtile, &tileItem);
+        values.clear();
+        style->evaluate(context, values);
+        if(context.isFieldMissing() && !tileItem.ids().empty()) {
+            FeaturePtr feature = m_featureClass->getFeature(tileItem.ids()[0]);
+            context.setFeature(feature.get());
+            values.clear();
+            style->evaluate(context, values);
+        }
+
+        auto classIt = classIndices.find(values);
+        if(classIt != classIndices.end()) {
+            itemClasses.push_back(classIt->second);
+        }
+        else if(classes.size() < MAX_STYLE_CLASSES) {
+            unsigned short index = static_cast<unsigned short>(classes.size());
+            classIndices[values] = index;
+            classes.push_back(values);
+            itemClasses.push_back(index);
+        }
+        else {
+            itemClasses.push_back(0);
+        }
+    }
+    bufferArray->setStyleClasses(std::move(itemClasses), std::move(classes));
+}
+
+/**
+ * @brief GlFeatureLayer::lodTile Thin the tile with too many items. Points are
+ * sampled to one item per LOD_POINT_CELL pixels grid cell, lines and polygons
+ * less than a pixel are dropped. The pixel is the overview one of the tile
+ * zoom. Heatmap keeps all points as they make the density. Executed from
+ * separate thread.
+ * @param tile Tile to fill.
+ * @param extent Tile extent.
+ * @param vtile Tile items.
+ * @param cancel Token to stop if tile is no longer needed.
+ * @return Tile with the kept items.
+ */
+FlatVectorTile GlFeatureLayer::lodTile(const Tile &tile, const Envelope &extent,
+                                       const FlatVectorTile &vtile,
+                                       const CancelToken &cancel) const
+{
+    if(!m_style || ngsDynamicCast(HeatmapStyle, m_style)) {
+        return vtile;
+    }
+
+    enum ngsStyleType type = m_style->type();
+    double pixel = FeatureClassOverview::pixelSize(tile.z);
+    double cellSize = pixel * LOD_POINT_CELL;
+    int cells = std::max(1, static_cast<int>(
+                             std::ceil(extent.width() / cellSize)));
+    std::vector<bool> occupied;
+    if(type == ST_POINT || type == ST_MIXED) {
+        occupied.resize(static_cast<size_t>(cells * cells), false);
+    }
+
+    VectorTileItemArray items;
+    for(auto it = vtile.begin(); it != vtile.end(); ++it) {
+        if(cancel.isCanceled()) {
+            return vtile;
+        }
+        const FlatVectorTileItem &tileItem = *it;
+        if(tileItem.pointCount() == 0) {
+            continue;
+        }
+
+        bool points = type == ST_MIXED ? tileItemStyleType(tileItem) == ST_POINT :
+                                         type == ST_POINT;
+        if(points) {
+            const SimplePoint &pt = tileItem.point(0);
+            int x = static_cast<int>((pt.x - extent.minX()) / cellSize);
+            int y = static_cast<int>((pt.y - extent.minY()) / cellSize);
+            x = std::min(std::max(x, 0), cells - 1);
+            y = std::min(std::max(y, 0), cells - 1);
+            size_t cell = static_cast<size_t>(y * cells + x);
+            if(occupied[cell]) {
+                continue;
+            }
+            occupied[cell] = true;
+        }
+        else {
+            const SimplePoint &first = tileItem.point(0);
+            float minX = first.x, maxX = first.x;
+            float minY = first.y, maxY = first.y;
+            for(const auto &pt : tileItem.points()) {
+                minX = std::min(minX, pt.x);
+                maxX = std::max(maxX, pt.x);
+                minY = std::min(minY, pt.y);
+                maxY = std::max(maxY, pt.y);
+            }
+            if(maxX - minX < pixel && maxY - minY < pixel) {
+                continue;
+            }
+        }
+        items.push_back(VectorTileItem(tileItem));
+    }
+
+    VectorTile out;
+    out.add(std::move(items));
+    return FlatVectorTile(out);
+}
+
+VectorGlObject *GlFeatureLayer::fillPoints(const FlatVectorTile &tile, float z,
+                                           const StylePtr &style,
+                                           const CancelToken &cancel)
+{
+    VectorGlObject *bufferArray = new VectorGlObject;
+    auto it = tile.begin();
+    GLuint index = 0;
+    PointStyle *pointStyle = ngsDynamicCast(PointStyle, style);
+    GlBuffer *buffer = new GlBuffer(pointStyle->bufferType());
+    while(it != tile.end()) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        const FlatVectorTileItem &tileItem = *it;
+        if(!m_hideFIDs.empty() && tileItem.isIdsPresent(m_hideFIDs)) {
+            ++it;
+            continue;
+        }
+
+        if(tileItem.pointCount() < 1) {
+            ++it;
+            continue;
+        }
+
+        for(size_t i = 0; i < tileItem.pointCount(); ++i) {
+            if(!buffer->canStoreVertices(pointStyle->pointVerticesCount(), true)) {
+                bufferArray->addBuffer(buffer);
+                index = 0;
+                buffer = new GlBuffer(pointStyle->bufferType());
+            }
+
+            const SimplePoint& pt = tileItem.point(i);
+            index = pointStyle->addPoint(pt, z, index, buffer);
+        }
+        ++it;
+    }
+
+    bufferArray->addBuffer(buffer);
+
+    return bufferArray;
+}
+
+VectorGlObject *GlFeatureLayer::fillLines(const FlatVectorTile &tile, float z,
+                                          const StylePtr &style,
+                                          const CancelToken &cancel)
+{
+    VectorGlObject *bufferArray = new VectorGlObject;
+    auto it = tile.begin();
+    GLuint index = 0;
+    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_LINE);
+    SimpleLineStyle *lineStyle = ngsStaticCast(SimpleLineStyle, style);
+
+    while(it != tile.end()) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        const FlatVectorTileItem &tileItem = *it;
+        if(tileItem.isIdsPresent(m_hideFIDs)) {
+            ++it;
+            continue;
+        }
+
+        if(tileItem.pointCount() < 2) {
+            ++it;
+            continue;
+        }
+
+        // Check if line is closed or not
+        bool closed = tileItem.isClosed();
+
+        Normal prevNormal;
+        for(size_t i = 0; i < tileItem.pointCount() - 1; ++i) {
+            const SimplePoint& pt1 = tileItem.point(i);
+            const SimplePoint& pt2 = tileItem.point(i + 1);
+            Normal normal = ngsGetNormals(pt1, pt2);
+
+            if(i == 0 || i == tileItem.pointCount() - 2) { // Add cap
+                if(!closed) {
+                    if(i == 0) {
+                        if(!buffer->canStoreVertices(lineStyle->lineCapVerticesCount(),
+                                                     true)) {
+                            bufferArray->addBuffer(buffer);
+                            index = 0;
+                            buffer = new GlBuffer(GlBuffer::BF_LINE);
+                        }
+                        index = lineStyle->addLineCap(pt1, normal, z, index, buffer);
+                    }
+
+                    if(i == tileItem.pointCount() - 2) {
+                        if(!buffer->canStoreVertices(lineStyle->lineCapVerticesCount(),
+                                                     true)) {
+                            bufferArray->addBuffer(buffer);
+                            index = 0;
+                            buffer = new GlBuffer(GlBuffer::BF_LINE);
+                        }
+
+                        Normal reverseNormal;
+                        reverseNormal.x = -normal.x;
+                        reverseNormal.y = -normal.y;
+                        index = lineStyle->addLineCap(pt2, reverseNormal, z, index, buffer);
+                    }
+                }
+            }
+
+            if(i != 0) { // Add join
+                if(!buffer->canStoreVertices(lineStyle->lineJoinVerticesCount(),
+                                             true)) {
+                    bufferArray->addBuffer(buffer);
+                    index = 0;
+                    buffer = new GlBuffer(GlBuffer::BF_LINE);
+                }
+                index = lineStyle->addLineJoin(pt1, prevNormal, normal, z, index,
+                                           buffer);
+            }
+
+            if(!buffer->canStoreVertices(12, true)) {
+                bufferArray->addBuffer(buffer);
+                index = 0;
+                buffer = new GlBuffer(GlBuffer::BF_LINE);
+            }
+
+            index = lineStyle->addSegment(pt1, pt2, normal, z, index, buffer);
+            prevNormal = normal;
+        }
+        ++it;
+    }
+    bufferArray->addBuffer(buffer);
+
+    return bufferArray;
+}
+
+VectorGlObject *GlFeatureLayer::fillPolygons(const FlatVectorTile &tile, float z,
+                                             const StylePtr &style,
+                                             const CancelToken &cancel)
+{
+    VectorGlObject *bufferArray = new VectorGlObject;
+    auto it = tile.begin();
+    GLuint fillIndex = 0;
+    GLuint lineIndex = 0;
+    GlBuffer *fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
+    GlBuffer *lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
+    SimpleLineStyle *lineStyle = ngsStaticCast(SimpleLineStyle, style);
+
+    while(it != tile.end()) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        const FlatVectorTileItem &tileItem = *it;
+        if(tileItem.isIdsPresent(m_hideFIDs)) {
+            ++it;
+            continue;
+        }
+
+        const auto &points = tileItem.points();
+        const auto &indices = tileItem.indices();
 
         if(points.size() < 3 || points.size() > GlBuffer::maxIndices() ||
                 points.size() > GlBuffer::maxVertices()) {
@@ -397,29 +1246,25 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
             fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
         }
 
-        for(auto point : points) {
+        for(const auto &point : points) {
             fillBuffer->addVertex(point.x);
             fillBuffer->addVertex(point.y);
             fillBuffer->addVertex(z);
         }
 
-        // FIXME: Expected indices should fit to buffer as points can
-        unsigned short maxFillIndex = 0;
         for(auto indexPoint : indices) {
             fillBuffer->addIndex(fillIndex + indexPoint);
-            if(maxFillIndex < indexPoint) {
-                maxFillIndex = indexPoint;
-            }
         }
-        fillIndex += maxFillIndex;
+        // Next item vertices start right after the points of this one
+        fillIndex += static_cast<GLuint>(points.size());
 
 
         // Fill borders
         // FIXME: May be more styles with borders
-        if(compare(m_style->name(), "simpleFillBordered")) {
+        if(compare(style->name(), "simpleFillBordered")) {
 
-        auto borders = (*it).borderIndices();
-        for(auto border : borders) {
+        for(size_t ring = 0; ring < tileItem.borderCount(); ++ring) {
+            ArrayView<unsigned short> border = tileItem.borderIndices(ring);
             Normal prevNormal;
             Normal firstNormal;
             bool firstNormalSet = false;
@@ -430,7 +1275,7 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
                                               points[borderIndex1]);
 
                 if(i == border.size() - 2) {
-                    if(!lineBuffer->canStoreVertices(style->lineCapVerticesCount(),
+                    if(!lineBuffer->canStoreVertices(lineStyle->lineCapVerticesCount(),
                                                      true)) {
                         bufferArray->addBuffer(lineBuffer);
                         lineIndex = 0;
@@ -440,18 +1285,18 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
                     Normal reverseNormal;
                     reverseNormal.x = -normal.x;
                     reverseNormal.y = -normal.y;
-                    lineIndex = style->addLineJoin(points[borderIndex1],
+                    lineIndex = lineStyle->addLineJoin(points[borderIndex1],
                            firstNormal, reverseNormal, z, lineIndex, lineBuffer);
                 }
 
                 if(i != 0) {
-                    if(!lineBuffer->canStoreVertices(style->lineJoinVerticesCount(),
+                    if(!lineBuffer->canStoreVertices(lineStyle->lineJoinVerticesCount(),
                                                      true)) {
                         bufferArray->addBuffer(lineBuffer);
                         lineIndex = 0;
                         lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
                     }
-                    lineIndex = style->addLineJoin(points[borderIndex],
+                    lineIndex = lineStyle->addLineJoin(points[borderIndex],
                                    prevNormal, normal, z, lineIndex, lineBuffer);
                 }
 
@@ -461,7 +1306,7 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
                     lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
                 }
 
-                lineIndex = style->addSegment(points[borderIndex],
+                lineIndex = lineStyle->addSegment(points[borderIndex],
                                               points[borderIndex1], normal, z,
                                               lineIndex, lineBuffer);
 
@@ -484,13 +1329,96 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
     return bufferArray;
 }
 
+/**
+ * @brief GlFeatureLayer::fillStyle Fill tile items with style of its type.
+ * Executed from separate thread.
+ * @param tile Tile of the items.
+ * @param vtile Tile items.
+ * @param z Layer depth.
+ * @param style Style of the items.
+ * @param cancel Token to stop if tile is no longer needed.
+ * @return Tile buffers or nullptr if style does not draw vector data.
+ */
+VectorGlObject *GlFeatureLayer::fillStyle(const Tile &tile,
+                                          const FlatVectorTile &vtile, float z,
+                                          const StylePtr &style,
+                                          const CancelToken &cancel)
+{
+    VectorGlObject *bufferArray = nullptr;
+    switch(style->type()) {
+    case ST_POINT:
+        bufferArray = fillPoints(vtile, z, style, cancel);
+        break;
+    case ST_LINE:
+        bufferArray = fillLines(vtile, z, style, cancel);
+        break;
+    case ST_FILL:
+        bufferArray = fillPolygons(vtile, z, style, cancel);
+        break;
+    case ST_MIXED:
+        return fillMixed(tile, vtile, z, cancel);
+    case ST_IMAGE:
+        return nullptr;
+    }
+
+    if(nullptr == bufferArray || cancel.isCanceled()) {
+        return bufferArray;
+    }
+
+    VectorSelectableGlObject *selectable =
+            dynamic_cast<VectorSelectableGlObject*>(bufferArray);
+    if(selectable && style->isDataDriven()) {
+        fillStyleClasses(tile, vtile, selectable, style, cancel);
+    }
+    return bufferArray;
+}
+
+/**
+ * @brief GlFeatureLayer::fillMixed Fill tile items of mixed geometry layer.
+ * Items are split by geometry type and each part is filled with the sub-style
+ * of its type. Polygons go first, so lines and points are drawn over them.
+ * Executed from separate thread.
+ * @param tile Tile of the items.
+ * @param vtile Tile items.
+ * @param z Layer depth.
+ * @param cancel Token to stop if tile is no longer needed.
+ * @return Tile buffers of all parts.
+ */
+VectorGlObject *GlFeatureLayer::fillMixed(const Tile &tile,
+                                          const FlatVectorTile &vtile, float z,
+                                          const CancelToken &cancel)
+{
+    MixedStyle *style = ngsDynamicCast(MixedStyle, m_style);
+    if(nullptr == style) {
+        return nullptr;
+    }
+
+    VectorMixedGlObject *bufferArray = new VectorMixedGlObject;
+    for(enum ngsStyleType type : {ST_FILL, ST_LINE, ST_POINT}) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        FlatVectorTile part = tileItemsOfType(vtile, type);
+        if(part.empty()) {
+            continue;
+        }
+        VectorGlObject *partArray = fillStyle(tile, part, z, style->style(type),
+                                              cancel);
+        if(nullptr != partArray) {
+            bufferArray->addPart(type, partArray);
+        }
+    }
+    return bufferArray;
+}
+
 //------------------------------------------------------------------------------
 // GlSelectableFeatureLayer
 //------------------------------------------------------------------------------
 
 GlSelectableFeatureLayer::GlSelectableFeatureLayer(Map *map,
                                                    const std::string &name) :
-    GlFeatureLayer(map, name)
+    GlFeatureLayer(map, name),
+    m_selectionVersion(0)
 {
     GlView *mapView = dynamic_cast<GlView*>(map);
     if(mapView) {
@@ -504,7 +1432,67 @@ StylePtr GlSelectableFeatureLayer::selectionStyle() const
         return StylePtr();
     }
 
-    return m_selectionStyles.find(m_style->type())->second;
+    // Mixed geometry layer selection is drawn by selection style of each type
+    if(m_style->type() == ST_MIXED) {
+        return m_style;
+    }
+    return selectionStyle(m_style->type());
+}
+
+StylePtr GlSelectableFeatureLayer::selectionStyle(enum ngsStyleType type) const
+{
+    auto it = m_selectionStyles.find(type);
+    if(it == m_selectionStyles.end()) {
+        return StylePtr();
+    }
+    return it->second;
+}
+
+void GlSelectableFeatureLayer::setSelectedIds(const FeatureIDs &selectedIds)
+{
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    GlFeatureLayer::setSelectedIds(selectedIds);
+    m_selectionVersion++;
+}
+
+/**
+ * @brief GlSelectableFeatureLayer::fillHash Selection buffers are filled with
+ * the selection styles, hidden items are skipped on draw.
+ * @return Hash value or 0 if filled buffers are not shared.
+ */
+size_t GlSelectableFeatureLayer::fillHash() const
+{
+    if(!m_style) {
+        return 0;
+    }
+
+    std::string key = fillKey();
+    for(const auto &selectionStyle : m_selectionStyles) {
+        if(selectionStyle.second) {
+            key += "/" + selectionStyle.second->name() + "/" +
+                    selectionStyle.second->save().Format(CPLJSONObject::Plain);
+        }
+    }
+    return fillKeyHash(key);
+}
+
+void GlSelectableFeatureLayer::setHideIds(const FeatureIDs &hideIds)
+{
+    ExclusiveHolder holder(m_dataMutex, LOCK_TIME);
+    // Hidden items are skipped on draw, filled data stays valid
+    FeatureLayer::setHideIds(hideIds);
+    m_selectionVersion++;
+}
+
+bool GlSelectableFeatureLayer::draw(const GlTilePtr &tile)
+{
+    if(!tile) {
+        return true;
+    }
+    if(!m_style) {
+        return true; // Should never happened
+    }
+    return drawItems(tile, m_style, false);
 }
 
 bool GlSelectableFeatureLayer::drawSelection(const GlTilePtr &tile)
@@ -516,8 +1504,22 @@ bool GlSelectableFeatureLayer::drawSelection(const GlTilePtr &tile)
     if(!style) {
         return true; // Not draw selected features if no style provided
     }
+    return drawItems(tile, style, true);
+}
 
-    MutexHolder holder(m_dataMutex, 5);
+/**
+ * @brief GlSelectableFeatureLayer::drawItems Draw not selected and not hidden
+ * or selected tile items. Only index ranges of these items are drawn.
+ * @param tile Tile to draw.
+ * @param style Style to draw.
+ * @param selection True to draw selected items.
+ * @return True if data for tile loaded, otherwise false.
+ */
+bool GlSelectableFeatureLayer::drawItems(const GlTilePtr &tile,
+                                         const StylePtr &style, bool selection)
+{
+    // Guards selected and hidden ids, tiles are changed only in Gl context
+    SharedHolder holder(m_dataMutex, 5);
     auto tileDataIt = m_tiles.find(tile->getTile());
     if(tileDataIt == m_tiles.end()) {
         return false; // Data not yet loaded
@@ -526,144 +1528,236 @@ bool GlSelectableFeatureLayer::drawSelection(const GlTilePtr &tile)
         return true; // Out of tile extent
     }
 
-    VectorSelectableGlObject *vectorGlObject =
-            ngsDynamicCast(VectorSelectableGlObject, tileDataIt->second);
-    for(const GlBufferPtr& buff : vectorGlObject->selectionBuffers()) {
-        if(buff->indexSize() == 0) {
-            continue;
+    VectorMixedGlObject *mixed = ngsDynamicCast(VectorMixedGlObject,
+                                                tileDataIt->second);
+    if(mixed) {
+        if(!selection && mixed->uploadPostponed()) {
+            return false; // Upload in next frame
         }
-        if(buff->bound()) {
-            buff->rebind();
+        MixedStyle *mixedStyle = ngsDynamicCast(MixedStyle, m_style);
+        if(nullptr == mixedStyle) {
+            return true; // Filled before style change
         }
-        else {
-            buff->bind();
+        for(const auto &part : mixed->parts()) {
+            StylePtr partStyle = selection ? selectionStyle(part.first) :
+                                             mixedStyle->style(part.first);
+            if(partStyle) {
+                drawObjectItems(tile, ngsDynamicCast(VectorSelectableGlObject,
+                                                     part.second),
+                                partStyle, selection);
+            }
         }
+        return true;
+    }
 
-        style->prepare(tile->getSceneMatrix(), tile->getInvViewMatrix(),
-                       buff->type());
-        style->draw(*buff);
+    VectorSelectableGlObject *vectorGlObject =
+            ngsDynamicCast(VectorSelectableGlObject, tileDataIt->second);
+    if(!selection && uploadPostponed(vectorGlObject->buffers())) {
+        return false; // Upload in next frame
     }
+    drawObjectItems(tile, vectorGlObject, style, selection);
     return true;
 }
 
-VectorGlObject* GlSelectableFeatureLayer::fillPoints(const VectorTile &tile,
-                                                     float z)
+/**
+ * @brief GlSelectableFeatureLayer::drawObjectItems Draw items of tile data.
+ * @param tile Tile to draw.
+ * @param vectorGlObject Tile data.
+ * @param style Style to draw.
+ * @param selection True to draw selected items.
+ */
+void GlSelectableFeatureLayer::drawObjectItems(const GlTilePtr &tile,
+        VectorSelectableGlObject *vectorGlObject, const StylePtr &style,
+        bool selection)
 {
-    VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
-    unsigned short index = 0;
-    GlBuffer *buffer = nullptr;
-    PointStyle *style = nullptr;
-
-    PointStyle *drawStyle = ngsDynamicCast(PointStyle, m_style);
-    PointStyle *selectStyle = ngsDynamicCast(PointStyle, selectionStyle());
-    GlBuffer *draw = new GlBuffer(drawStyle->bufferType());
-    GlBuffer *select = new GlBuffer(selectStyle->bufferType());
-    unsigned short drawIndex = 0;
-    unsigned short selectIndex = 0;
-
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
-        if(tileItem.isIdsPresent(m_hideFIDs, true)) {
-            ++it;
-            continue;
+    vectorGlObject->updateItemStates(m_selectedFIDs, m_hideFIDs,
+                                     m_selectionVersion);
+    if(selection && !vectorGlObject->hasSelectedItems()) {
+        return;
+    }
+
+    bool allItems = !selection && !vectorGlObject->hasSelectedItems() &&
+            !vectorGlObject->hasHiddenItems();
+    auto filter = [vectorGlObject, selection](GLuint item) {
+        return selection ? vectorGlObject->isItemSelected(item) :
+                           vectorGlObject->isItemNormal(item);
+    };
+
+    const std::vector<GlBufferPtr> &buffers = selection ?
+                vectorGlObject->selectionBuffers() : vectorGlObject->buffers();
+    auto drawBuffers = [&](const GlBuffer::ItemFilter &itemFilter, bool all) {
+        for(const GlBufferPtr& buff : buffers) {
+            if(buff->indexSize() == 0) {
+                continue;
+            }
+
+            std::vector<GlBuffer::IndexRange> ranges;
+            if(!all) {
+                ranges = buff->itemRanges(itemFilter);
+                if(ranges.empty()) {
+                    continue;
+                }
+            }
+
+            if(buff->bound()) {
+                buff->rebind();
+            }
+            else {
+                buff->bind();
+            }
+
+            style->prepare(tile->getSceneMatrix(), tile->getInvViewMatrix(),
+                           buff->type());
+            if(all) {
+                style->draw(*buff);
+                continue;
+            }
+
+            for(const auto &range : ranges) {
+                buff->setDrawRange(range);
+                style->draw(*buff);
+            }
+            buff->resetDrawRange();
         }
+    };
 
-        if(tileItem.pointCount() < 1) {
-            ++it;
-            continue;
+    // Heatmap items are summed off-screen and drawn to tile at once
+    HeatmapStyle *heatmap = ngsDynamicCast(HeatmapStyle, style);
+    if(heatmap) {
+        heatmap->beginDensity(tile->tileSize());
+    }
+
+    const std::vector<StyleClass> &classes = vectorGlObject->styleClasses();
+    if(selection || classes.empty()) {
+        drawBuffers(filter, allItems);
+    }
+    else {
+        // Items of data driven style are drawn by classes
+        for(size_t styleClass = 0; styleClass < classes.size(); ++styleClass) {
+            style->applyClass(classes[styleClass], 0);
+            drawBuffers([&filter, vectorGlObject, styleClass](GLuint item) {
+                return filter(item) &&
+                        vectorGlObject->itemStyleClass(item) == styleClass;
+            }, allItems && classes.size() == 1);
         }
+        style->resetClass();
+    }
+
+    if(heatmap) {
+        heatmap->endDensity();
+    }
+}
+
+/**
+ * @brief isSameGeometry Check if selection style makes the same vertices as
+ * draw style, so selected items can be drawn from draw buffers.
+ */
+static bool isSameGeometry(Style *drawStyle, Style *selectStyle)
+{
+    if(nullptr == selectStyle) {
+        return true;
+    }
+    if(nullptr == drawStyle || drawStyle->name() != selectStyle->name()) {
+        return false;
+    }
 
-        bool isSelect = false;
-        if(tileItem.isIdsPresent(m_selectedFIDs, false)) {
-            buffer = select;
-            style = selectStyle;
-            index = selectIndex;
-            isSelect = true;
+    PointStyle *drawPoint = dynamic_cast<PointStyle*>(drawStyle);
+    if(drawPoint) {
+        PointStyle *selectPoint = dynamic_cast<PointStyle*>(selectStyle);
+        // Marker texture coordinates are stored in vertices
+        if(drawPoint->pointType() != selectPoint->pointType() ||
+                drawPoint->pointType() == PT_MARKER ||
+                drawPoint->bufferType() != selectPoint->bufferType()) {
+            return false;
         }
-        else {
-            buffer = draw;
-            style = drawStyle;
-            index = drawIndex;
+        PrimitivePointStyle *drawPrimitive =
+                dynamic_cast<PrimitivePointStyle*>(drawStyle);
+        PrimitivePointStyle *selectPrimitive =
+                dynamic_cast<PrimitivePointStyle*>(selectStyle);
+        return nullptr == drawPrimitive || nullptr == selectPrimitive ||
+                drawPrimitive->segmentCount() == selectPrimitive->segmentCount();
+    }
+
+    SimpleLineStyle *drawLine = dynamic_cast<SimpleLineStyle*>(drawStyle);
+    if(drawLine) {
+        SimpleLineStyle *selectLine = dynamic_cast<SimpleLineStyle*>(selectStyle);
+        return drawLine->capType() == selectLine->capType() &&
+                drawLine->joinType() == selectLine->joinType() &&
+                drawLine->segmentCount() == selectLine->segmentCount();
+    }
+
+    SimpleFillBorderedStyle *drawFill =
+            dynamic_cast<SimpleFillBorderedStyle*>(drawStyle);
+    if(drawFill) {
+        SimpleFillBorderedStyle *selectFill =
+                dynamic_cast<SimpleFillBorderedStyle*>(selectStyle);
+        return drawFill->capType() == selectFill->capType() &&
+                drawFill->joinType() == selectFill->joinType() &&
+                drawFill->segmentCount() == selectFill->segmentCount();
+    }
+    return true;
+}
+
+static void fillPointItems(const FlatVectorTile &tile, size_t begin,
+                           size_t end, float z, PointStyle *style,
+                           std::vector<GlBuffer*> &buffers,
+                           const CancelToken &cancel)
+{
+    GLuint index = 0;
+    GLuint item = static_cast<GLuint>(begin);
+    GlBuffer *buffer = new GlBuffer(style->bufferType());
+    for(; item < end; ++item) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        const FlatVectorTileItem &tileItem = tile.item(item);
+        if(tileItem.pointCount() < 1) {
+            continue;
         }
 
+        buffer->startItem(item);
         for(size_t i = 0; i < tileItem.pointCount(); ++i) {
-            if(buffer->vertexSize() >= GlBuffer::maxVertices() - 7) {
-                if(isSelect) {
-                    bufferArray->addSelectionBuffer(select);
-                    select = new GlBuffer(style->bufferType());
-                    buffer = select;
-                    selectIndex = 0;
-                }
-                else {
-                    bufferArray->addBuffer(buffer);
-                    draw = new GlBuffer(style->bufferType());
-                    buffer = draw;
-                    drawIndex = 0;
-                }
+            if(!buffer->canStoreVertices(style->pointVerticesCount(), true)) {
+                buffers.push_back(buffer);
                 index = 0;
+                buffer = new GlBuffer(style->bufferType());
+                buffer->startItem(item);
             }
 
             const SimplePoint &pt = tileItem.point(i);
             index = style->addPoint(pt, z, index, buffer);
         }
-        ++it;
-
-        if(isSelect) {
-            selectIndex = index;
-        }
-        else {
-            drawIndex = index;
-        }
     }
-
-    bufferArray->addBuffer(draw);
-    bufferArray->addSelectionBuffer(select);
-
-    return bufferArray;
+    buffers.push_back(buffer);
 }
 
-VectorGlObject *GlSelectableFeatureLayer::fillLines(const VectorTile &tile,
-                                                    float z)
+static void fillLineItems(const FlatVectorTile &tile, size_t begin,
+                          size_t end, float z, SimpleLineStyle *style,
+                          std::vector<GlBuffer*> &buffers,
+                          const CancelToken &cancel)
 {
-    VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
-    unsigned short index = 0;
-    GlBuffer *buffer = nullptr;
-    GlBuffer *draw = new GlBuffer(GlBuffer::BF_LINE);
-    GlBuffer *select = new GlBuffer(GlBuffer::BF_LINE);
-    SimpleLineStyle *drawStyle = ngsDynamicCast(SimpleLineStyle, m_style);
-    SimpleLineStyle *selectStyle = ngsDynamicCast(SimpleLineStyle, selectionStyle());
-    SimpleLineStyle *style = nullptr;
-    unsigned short drawIndex = 0;
-    unsigned short selectIndex = 0;
-
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
-        if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
-            continue;
+    GLuint index = 0;
+    GLuint item = static_cast<GLuint>(begin);
+    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_LINE);
+    auto reserve = [&](size_t count) {
+        if(!buffer->canStoreVertices(count, true)) {
+            buffers.push_back(buffer);
+            index = 0;
+            buffer = new GlBuffer(GlBuffer::BF_LINE);
+            buffer->startItem(item);
         }
+    };
 
+    for(; item < end; ++item) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        const FlatVectorTileItem &tileItem = tile.item(item);
         if(tileItem.pointCount() < 2) {
-            ++it;
             continue;
         }
 
-        bool isSelect = false;
-        if(tileItem.isIdsPresent(m_selectedFIDs, false)) {
-            buffer = select;
-            style = selectStyle;
-            index = selectIndex;
-            isSelect = true;
-        }
-        else {
-            buffer = draw;
-            style = drawStyle;
-            index = drawIndex;
-        }
+        buffer->startItem(item);
 
         // Check if line is closed or not
         bool closed = tileItem.isClosed();
@@ -674,322 +1768,307 @@ VectorGlObject *GlSelectableFeatureLayer::fillLines(const VectorTile &tile,
             const SimplePoint& pt2 = tileItem.point(i + 1);
             Normal normal = ngsGetNormals(pt1, pt2);
 
-            if(i == 0 || i == tileItem.pointCount() - 2) { // Add cap
-                if(!closed) {
-                    if(i == 0) {
-                        if(!buffer->canStoreVertices(style->lineCapVerticesCount(),
-                                                     true)) {
-                            if(isSelect) {
-                                bufferArray->addSelectionBuffer(buffer);
-                                select = new GlBuffer(GlBuffer::BF_LINE);
-                                buffer = select;
-                                selectIndex = 0;
-                            }
-                            else {
-                                bufferArray->addBuffer(buffer);
-                                draw = new GlBuffer(GlBuffer::BF_LINE);
-                                buffer = draw;
-                                drawIndex = 0;
-                            }
-                            index = 0;
-                        }
-                        index = style->addLineCap(pt1, normal, z, index, buffer);
-                    }
-
-                    if(i == tileItem.pointCount() - 2) {
-                        if(!buffer->canStoreVertices(style->lineCapVerticesCount(),
-                                                     true)) {
-                            if(isSelect) {
-                                bufferArray->addSelectionBuffer(buffer);
-                                select = new GlBuffer(GlBuffer::BF_LINE);
-                                buffer = select;
-                                selectIndex = 0;
-                            }
-                            else {
-                                bufferArray->addBuffer(buffer);
-                                draw = new GlBuffer(GlBuffer::BF_LINE);
-                                buffer = draw;
-                                drawIndex = 0;
-                            }
-                            index = 0;
-                        }
+            if(!closed && i == 0) { // Add cap
+                reserve(style->lineCapVerticesCount());
+                index = style->addLineCap(pt1, normal, z, index, buffer);
+            }
 
-                        Normal reverseNormal;
-                        reverseNormal.x = -normal.x;
-                        reverseNormal.y = -normal.y;
-                        index = style->addLineCap(pt2, reverseNormal, z, index,
-                                                  buffer);
-                    }
-                }
+            if(!closed && i == tileItem.pointCount() - 2) {
+                reserve(style->lineCapVerticesCount());
+                Normal reverseNormal;
+                reverseNormal.x = -normal.x;
+                reverseNormal.y = -normal.y;
+                index = style->addLineCap(pt2, reverseNormal, z, index, buffer);
             }
 
             if(i != 0) { // Add join
-                if(!buffer->canStoreVertices(style->lineJoinVerticesCount(),
-                                             true)) {
-                    if(isSelect) {
-                        bufferArray->addSelectionBuffer(buffer);
-                        select = new GlBuffer(GlBuffer::BF_LINE);
-                        buffer = select;
-                        selectIndex = 0;
-                    }
-                    else {
-                        bufferArray->addBuffer(buffer);
-                        draw = new GlBuffer(GlBuffer::BF_LINE);
-                        buffer = draw;
-                        drawIndex = 0;
-                    }
-                    index = 0;
-                }
+                reserve(style->lineJoinVerticesCount());
                 index = style->addLineJoin(pt1, prevNormal, normal, z, index,
                                            buffer);
             }
 
-            if(!buffer->canStoreVertices(12, true)) {
-                if(isSelect) {
-                    bufferArray->addSelectionBuffer(buffer);
-                    select = new GlBuffer(GlBuffer::BF_LINE);
-                    buffer = select;
-                    selectIndex = 0;
-                }
-                else {
-                    bufferArray->addBuffer(buffer);
-                    draw = new GlBuffer(GlBuffer::BF_LINE);
-                    buffer = draw;
-                    drawIndex = 0;
-                }
-                index = 0;
-            }
-
+            reserve(12);
             index = style->addSegment(pt1, pt2, normal, z, index, buffer);
             prevNormal = normal;
         }
-        ++it;
-
-        if(isSelect) {
-            selectIndex = index;
-        }
-        else {
-            drawIndex = index;
-        }
     }
-    bufferArray->addBuffer(draw);
-    bufferArray->addSelectionBuffer(select);
-
-    return bufferArray;
+    buffers.push_back(buffer);
 }
 
-VectorGlObject *GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
-                                                       float z)
+static void fillPolygonItems(const FlatVectorTile &tile, size_t begin,
+                             size_t end, float z, const Style *style,
+                             SimpleLineStyle *lineStyle,
+                             std::vector<GlBuffer*> &buffers,
+                             const CancelToken &cancel)
 {
-    VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
-    unsigned short fillIndex = 0;
-    unsigned short lineIndex = 0;
-    GlBuffer *drawFillBuffer = new GlBuffer(GlBuffer::BF_FILL);
-    GlBuffer *drawLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-    GlBuffer *selectFillBuffer = new GlBuffer(GlBuffer::BF_FILL);
-    GlBuffer *selectLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-    GlBuffer *fillBuffer = nullptr;
-    GlBuffer *lineBuffer = nullptr;
-
-    SimpleFillBorderedStyle *drawStyle = ngsDynamicCast(SimpleFillBorderedStyle,
-                                                        m_style);
-    SimpleLineStyle *drawLineStyle = drawStyle->lineStyle();
-
-    SimpleFillBorderedStyle *selectStyle = ngsDynamicCast(SimpleFillBorderedStyle,
-                                                          selectionStyle());
-    SimpleLineStyle *selectLineStyle = selectStyle->lineStyle();
-
-    SimpleFillBorderedStyle *style;
-    SimpleLineStyle *lineStyle;
-
-    unsigned short selectFillIndex = 0;
-    unsigned short selectLineIndex = 0;
-    unsigned short drawFillIndex = 0;
-    unsigned short drawLineIndex = 0;
-
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
-        if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
-            continue;
+    GLuint fillIndex = 0;
+    GLuint lineIndex = 0;
+    GLuint item = static_cast<GLuint>(begin);
+    // Each item is drawn above the previous ones
+    z += 2.0f * static_cast<float>(begin);
+    GlBuffer *fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
+    GlBuffer *lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
+    // FIXME: May be more styles with borders
+    bool bordered = nullptr != lineStyle &&
+            compare(style->name(), "simpleFillBordered");
+    auto reserveLine = [&](size_t count) {
+        if(!lineBuffer->canStoreVertices(count, true)) {
+            buffers.push_back(lineBuffer);
+            lineIndex = 0;
+            lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
+            lineBuffer->startItem(item);
         }
+    };
 
-        auto points = tileItem.points();
-        auto indices = tileItem.indices();
+    for(; item < end; ++item) {
+        if(cancel.isCanceled()) {
+            break;
+        }
+        const FlatVectorTileItem &tileItem = tile.item(item);
+        const auto &points = tileItem.points();
+        const auto &indices = tileItem.indices();
 
         if(points.size() < 3 || points.size() > GlBuffer::maxIndices() ||
                 points.size() > GlBuffer::maxVertices()) {
-            ++it;
             continue;
         }
 
-        bool isSelect = false;
-        if(tileItem.isIdsPresent(m_selectedFIDs, false)) {
-            fillBuffer = selectFillBuffer;
-            lineBuffer = selectLineBuffer;
-            style = selectStyle;
-            lineStyle = selectLineStyle;
-            isSelect = true;
-            fillIndex = selectFillIndex;
-            lineIndex = selectLineIndex;
-        }
-        else {
-            fillBuffer = drawFillBuffer;
-            lineBuffer = drawLineBuffer;
-            style = drawStyle;
-            lineStyle = drawLineStyle;
-            fillIndex = drawFillIndex;
-            lineIndex = drawLineIndex;
-        }
-
         // Fill polygons
         if(!fillBuffer->canStoreVertices(points.size() * 3, false)) {
+            buffers.push_back(fillBuffer);
             fillIndex = 0;
-            if(isSelect) {
-                bufferArray->addSelectionBuffer(fillBuffer);
-                selectFillBuffer = new GlBuffer(GlBuffer::BF_FILL);
-                fillBuffer = selectFillBuffer;
-                selectFillIndex = 0;
-            }
-            else {
-                bufferArray->addBuffer(fillBuffer);
-                drawFillBuffer = new GlBuffer(GlBuffer::BF_FILL);
-                fillBuffer = drawFillBuffer;
-                drawFillIndex = 0;
-            }
+            fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
         }
+        fillBuffer->startItem(item);
 
-        for(auto point : points) {
+        for(const auto &point : points) {
             fillBuffer->addVertex(point.x);
             fillBuffer->addVertex(point.y);
             fillBuffer->addVertex(z);
         }
 
-        // FIXME: Expected indices should fit to buffer as points can
-//        unsigned short maxFillIndex = 0;
         for(auto indexPoint : indices) {
-            ngsUnused(indexPoint);
-            fillBuffer->addIndex(fillIndex++);
-//            fillBuffer->addIndex(fillIndex + indexPoint);
-//            if(maxFillIndex < indexPoint) {
-//                maxFillIndex = indexPoint;
-//            }
+            fillBuffer->addIndex(fillIndex + indexPoint);
         }
-//        fillIndex += maxFillIndex;
-
+        // Next item vertices start right after the points of this one
+        fillIndex += static_cast<GLuint>(points.size());
 
         // Fill borders
-        // FIXME: May be more styles with borders
-        if(compare(style->name(), "simpleFillBordered")) {
-
-        auto borders = (*it).borderIndices();
-        for(auto border : borders) {
-            Normal prevNormal;
-            Normal firstNormal;
-            bool firstNormalSet = false;
-            for(size_t i = 0; i < border.size() - 1; ++i) {
-                auto borderIndex = border[i];
-                auto borderIndex1 = border[i + 1];
-                Normal normal = ngsGetNormals(points[borderIndex],
-                                              points[borderIndex1]);
+        if(bordered) {
+            lineBuffer->startItem(item);
+            for(size_t ring = 0; ring < tileItem.borderCount(); ++ring) {
+                ArrayView<unsigned short> border = tileItem.borderIndices(ring);
+                Normal prevNormal;
+                Normal firstNormal;
+                bool firstNormalSet = false;
+                for(size_t i = 0; i < border.size() - 1; ++i) {
+                    auto borderIndex = border[i];
+                    auto borderIndex1 = border[i + 1];
+                    Normal normal = ngsGetNormals(points[borderIndex],
+                                                  points[borderIndex1]);
+
+                    if(i == border.size() - 2) {
+                        reserveLine(lineStyle->lineCapVerticesCount());
+                        Normal reverseNormal;
+                        reverseNormal.x = -normal.x;
+                        reverseNormal.y = -normal.y;
+                        lineIndex = lineStyle->addLineJoin(points[borderIndex1],
+                               firstNormal, reverseNormal, z, lineIndex, lineBuffer);
+                    }
 
-                if(i == border.size() - 2) {
-                    if(!lineBuffer->canStoreVertices(lineStyle->lineCapVerticesCount(),
-                                                     true)) {
-                        lineIndex = 0;
-                        if(isSelect) {
-                            bufferArray->addSelectionBuffer(lineBuffer);
-                            selectLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-                            lineBuffer = selectLineBuffer;
-                            selectLineIndex = 0;
-                        }
-                        else {
-                            bufferArray->addBuffer(lineBuffer);
-                            drawLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-                            lineBuffer = drawLineBuffer;
-                            drawLineIndex = 0;
-                        }
+                    if(i != 0) {
+                        reserveLine(lineStyle->lineJoinVerticesCount());
+                        lineIndex = lineStyle->addLineJoin(points[borderIndex],
+                                       prevNormal, normal, z, lineIndex, lineBuffer);
                     }
 
-                    Normal reverseNormal;
-                    reverseNormal.x = -normal.x;
-                    reverseNormal.y = -normal.y;
-                    lineIndex = lineStyle->addLineJoin(points[borderIndex1],
-                           firstNormal, reverseNormal, z, lineIndex, lineBuffer);
-                }
+                    reserveLine(12);
+                    lineIndex = lineStyle->addSegment(points[borderIndex],
+                                                      points[borderIndex1], normal,
+                                                      z, lineIndex, lineBuffer);
 
-                if(i != 0) {
-                    if(!lineBuffer->canStoreVertices(lineStyle->lineJoinVerticesCount(),
-                                                     true)) {
-                        lineIndex = 0;
-                        if(isSelect) {
-                            bufferArray->addSelectionBuffer(lineBuffer);
-                            selectLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-                            lineBuffer = selectLineBuffer;
-                            selectLineIndex = 0;
-                        }
-                        else {
-                            bufferArray->addBuffer(lineBuffer);
-                            drawLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-                            lineBuffer = drawLineBuffer;
-                            drawLineIndex = 0;
-                        }
+                    prevNormal = normal;
+                    if(!firstNormalSet) {
+                        firstNormal.x = -prevNormal.x;
+                        firstNormal.y = -prevNormal.y;
+                        firstNormalSet = true;
                     }
-                    lineIndex = lineStyle->addLineJoin(points[borderIndex],
-                                   prevNormal, normal, z, lineIndex, lineBuffer);
                 }
+            }
+        }
 
-                if(!lineBuffer->canStoreVertices(12, true)) {
-                    lineIndex = 0;
-                    if(isSelect) {
-                        bufferArray->addSelectionBuffer(lineBuffer);
-                        selectLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-                        lineBuffer = selectLineBuffer;
-                        selectLineIndex = 0;
-                    }
-                    else {
-                        bufferArray->addBuffer(lineBuffer);
-                        drawLineBuffer = new GlBuffer(GlBuffer::BF_LINE);
-                        lineBuffer = drawLineBuffer;
-                        drawLineIndex = 0;
-                    }
-                }
+        z += 2.0f;
+    }
 
-                lineIndex = lineStyle->addSegment(points[borderIndex],
-                                              points[borderIndex1], normal,
-                                              z, lineIndex, lineBuffer);
+    buffers.push_back(fillBuffer);
+    buffers.push_back(lineBuffer);
+}
 
-                prevNormal = normal;
-                if(!firstNormalSet) {
-                    firstNormal.x = -prevNormal.x;
-                    firstNormal.y = -prevNormal.y;
-                    firstNormalSet = true;
-                }
-            }
-        }
+/**
+ * @brief The FillChunk struct Tile items range filled by one thread and the
+ * buffers it made.
+ */
+typedef struct _fillChunk {
+    size_t begin;
+    size_t end;
+    std::vector<GlBuffer*> buffers;
+} FillChunk;
+
+using FillItemsFunc = std::function<void(size_t begin, size_t end,
+                                         std::vector<GlBuffer*> &buffers)>;
+
+typedef struct _fillItemsData {
+    std::vector<FillChunk> chunks;
+    std::atomic<size_t> next;
+    const FillItemsFunc *fill;
+} FillItemsData;
+
+static void fillItemsThread(void *data)
+{
+    FillItemsData *fillData = static_cast<FillItemsData*>(data);
+    size_t chunk;
+    while((chunk = fillData->next++) < fillData->chunks.size()) {
+        FillChunk &fillChunk = fillData->chunks[chunk];
+        (*fillData->fill)(fillChunk.begin, fillChunk.end, fillChunk.buffers);
+    }
+}
+
+/**
+ * @brief fillItems Fill buffers of the tile items. Items of the big tile are
+ * split to the ranges of about FILL_CHUNK_POINTS points filled by several
+ * threads, the ranges buffers are added in the items order.
+ * @param tile Tile to fill.
+ * @param fill Range fill function.
+ * @param bufferArray Buffers storage.
+ * @param selection Add buffers as selection ones.
+ */
+static void fillItems(const FlatVectorTile &tile, const FillItemsFunc &fill,
+                      VectorSelectableGlObject *bufferArray, bool selection)
+{
+    FillItemsData fillData;
+    fillData.next = 0;
+    fillData.fill = &fill;
+    size_t begin = 0;
+    size_t points = 0;
+    size_t itemCount = tile.itemCount();
+    for(size_t item = 0; item < itemCount; ++item) {
+        points += tile.item(item).pointCount();
+        if(points >= FILL_CHUNK_POINTS) {
+            fillData.chunks.push_back({begin, item + 1, {}});
+            begin = item + 1;
+            points = 0;
         }
+    }
+    if(begin < itemCount || fillData.chunks.empty()) {
+        fillData.chunks.push_back({begin, itemCount, {}});
+    }
 
-        ++it;
+    // Current thread fills chunks too. It is the map pool worker already, so
+    // helper threads start only on free worker slots, the rest is filled here.
+    int threadCount = std::min(CPLGetNumCPUs(),
+                               static_cast<int>(fillData.chunks.size())) - 1;
+    WorkerSlots slots(WorkerClass::INTERACTIVE, threadCount);
+    std::vector<CPLJoinableThread*> threads;
+    for(int i = 0; i < slots.count(); ++i) {
+        threads.push_back(CPLCreateJoinableThread(fillItemsThread, &fillData));
+    }
+    fillItemsThread(&fillData);
+    for(CPLJoinableThread *thread : threads) {
+        CPLJoinThread(thread);
+    }
 
-        if(isSelect) {
-            selectLineIndex = lineIndex;
-            selectFillIndex = fillIndex;
-        }
-        else {
-            drawLineIndex = lineIndex;
-            drawFillIndex = fillIndex;
+    bool split = fillData.chunks.size() > 1;
+    for(const FillChunk &chunk : fillData.chunks) {
+        for(GlBuffer *buffer : chunk.buffers) {
+            // Ranges end with partially filled buffers, skip empty ones
+            if(split && buffer->indexSize() == 0) {
+                delete buffer;
+                continue;
+            }
+            bufferArray->addBuffer(buffer, selection);
         }
+    }
+}
 
-        z += 2.0f;
+VectorGlObject* GlSelectableFeatureLayer::fillPoints(const FlatVectorTile &tile,
+                                                     float z,
+                                                     const StylePtr &style,
+                                                     const CancelToken &cancel)
+{
+    VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
+    bufferArray->setItems(tile);
+
+    PointStyle *drawStyle = ngsDynamicCast(PointStyle, style);
+    PointStyle *selectStyle = ngsDynamicCast(PointStyle,
+                                             selectionStyle(style->type()));
+    fillItems(tile, [&](size_t begin, size_t end, std::vector<GlBuffer*> &buffers) {
+        fillPointItems(tile, begin, end, z, drawStyle, buffers, cancel);
+    }, bufferArray, false);
+
+    bool shared = isSameGeometry(drawStyle, selectStyle);
+    bufferArray->setSelectionShared(shared);
+    if(!shared) {
+        fillItems(tile, [&](size_t begin, size_t end, std::vector<GlBuffer*> &buffers) {
+            fillPointItems(tile, begin, end, z, selectStyle, buffers, cancel);
+        }, bufferArray, true);
+    }
+    return bufferArray;
+}
+
+VectorGlObject *GlSelectableFeatureLayer::fillLines(const FlatVectorTile &tile,
+                                                    float z,
+                                                    const StylePtr &style,
+                                                    const CancelToken &cancel)
+{
+    VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
+    bufferArray->setItems(tile);
+
+    SimpleLineStyle *drawStyle = ngsDynamicCast(SimpleLineStyle, style);
+    SimpleLineStyle *selectStyle = ngsDynamicCast(SimpleLineStyle,
+                                                  selectionStyle(style->type()));
+    fillItems(tile, [&](size_t begin, size_t end, std::vector<GlBuffer*> &buffers) {
+        fillLineItems(tile, begin, end, z, drawStyle, buffers, cancel);
+    }, bufferArray, false);
+
+    bool shared = isSameGeometry(drawStyle, selectStyle);
+    bufferArray->setSelectionShared(shared);
+    if(!shared) {
+        fillItems(tile, [&](size_t begin, size_t end, std::vector<GlBuffer*> &buffers) {
+            fillLineItems(tile, begin, end, z, selectStyle, buffers, cancel);
+        }, bufferArray, true);
     }
+    return bufferArray;
+}
 
-    bufferArray->addBuffer(drawFillBuffer);
-    bufferArray->addBuffer(drawLineBuffer);
-    bufferArray->addSelectionBuffer(selectFillBuffer);
-    bufferArray->addSelectionBuffer(selectLineBuffer);
+VectorGlObject *GlSelectableFeatureLayer::fillPolygons(const FlatVectorTile& tile,
+                                                       float z,
+                                                       const StylePtr &style,
+                                                       const CancelToken &cancel)
+{
+    VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
+    bufferArray->setItems(tile);
 
+    StylePtr selection = selectionStyle(style->type());
+    SimpleFillBorderedStyle *drawStyle = ngsDynamicCast(SimpleFillBorderedStyle,
+                                                        style);
+    SimpleFillBorderedStyle *selectStyle = ngsDynamicCast(SimpleFillBorderedStyle,
+                                                          selection);
+    SimpleLineStyle *lineStyle = drawStyle ? drawStyle->lineStyle() : nullptr;
+    fillItems(tile, [&](size_t begin, size_t end, std::vector<GlBuffer*> &buffers) {
+        fillPolygonItems(tile, begin, end, z, style.get(), lineStyle, buffers,
+                         cancel);
+    }, bufferArray, false);
+
+    bool shared = isSameGeometry(style.get(), selection.get());
+    bufferArray->setSelectionShared(shared);
+    if(!shared) {
+        SimpleLineStyle *selectLineStyle =
+                selectStyle ? selectStyle->lineStyle() : nullptr;
+        fillItems(tile, [&](size_t begin, size_t end, std::vector<GlBuffer*> &buffers) {
+            fillPolygonItems(tile, begin, end, z, selection.get(),
+                             selectLineStyle, buffers, cancel);
+        }, bufferArray, true);
+    }
     return bufferArray;
 }
 
@@ -1005,19 +2084,29 @@ GlRasterLayer::GlRasterLayer(Map *map, const std::string &name) :
     m_blue(3),
     m_alpha(0),
     m_transparency(0),
-    m_dataType(GDT_Byte)
+    m_dataType(GDT_Byte),
+    m_renderType(RenderType::RGBA),
+    m_hillshade(false),
+    m_hasNoData(false),
+    m_noData(0.0f)
 {
 }
 
-bool GlRasterLayer::fill(const GlTilePtr &tile, float z, bool isLastTry)
+bool GlRasterLayer::fill(const GlTilePtr &tile, float z, bool isLastTry,
+                         const CancelToken &cancel)
 {
-    if(!(m_visible && tile->getTile().z > m_minZoom && tile->getTile().z < m_maxZoom)) {
-        MutexHolder holder(m_dataMutex, LOCK_TIME);
-        m_tiles[tile->getTile()] = GlObjectPtr();
+    if(cancel.isCanceled()) {
+        return true;
+    }
+
+    // Layer is empty until the datasource is bound
+    if(!(m_bound && m_visible && tile->getTile().z > m_minZoom &&
+         tile->getTile().z < m_maxZoom)) {
+        setTileData(tile, GlObjectPtr(), cancel);
         return true;
     }
 
-    if(m_tiles.find(tile->getTile()) != m_tiles.end()) { // Already filled
+    if(hasData(tile)) { // Already filled
         return true;
     }
 
@@ -1044,11 +2133,41 @@ bool GlRasterLayer::fill(const GlTilePtr &tile, float z, bool isLastTry)
     if(!outExt.isInit()) {
         CPLDebug("ngstore", "fill layer %s not intersect - x: %f, y: %f",
                  m_raster->name().c_str(), rasterExtent.minX(), rasterExtent.minY());
-        MutexHolder holder(m_dataMutex, LOCK_TIME);
-        m_tiles[tile->getTile()] = GlObjectPtr();
+        setTileData(tile, GlObjectPtr(), cancel);
         return true;
     }
 
+    // Memset 255 for buffer and read data skipping 4 byte
+    int bandCount = 4;
+    int bands[4];
+    bands[0] = m_red;
+    bands[1] = m_green;
+    bands[2] = m_blue;
+    bands[3] = m_alpha;
+
+    // Tiles downloaded to the raster tile store are read without GDAL WMS
+    if(m_raster->hasTileStore() && m_renderType == RenderType::RGBA &&
+            m_dataType == GDT_Byte &&
+            m_raster->extent().contains(tile->getExtent())) {
+        size_t storeBufferSize = static_cast<size_t>(TMS_TILE_SIZE *
+                                                     TMS_TILE_SIZE * 4);
+        GLubyte *storeData = static_cast<GLubyte*>(CPLMalloc(storeBufferSize));
+        if(m_alpha == 0) {
+            std::memset(storeData, 255 - m_transparency, storeBufferSize);
+        }
+        if(m_raster->storedTileData(tile->getTile(), storeData, bandCount,
+                                    bands, m_alpha == 0)) {
+            if(cancel.isCanceled()) {
+                CPLFree(storeData);
+                return true;
+            }
+            setTileImage(tile, storeData, TMS_TILE_SIZE, TMS_TILE_SIZE, true,
+                         tile->getExtent(), z, cancel);
+            return true;
+        }
+        CPLFree(storeData);
+    }
+
     // Create inverse geotransform to get pixel data
     double geoTransform[6] = { 0.0 };
     double invGeoTransform[6] = { 0.0 };
@@ -1106,15 +2225,11 @@ bool GlRasterLayer::fill(const GlTilePtr &tile, float z, bool isLastTry)
         height = m_raster->height() - minY;
     }
 
-    // Memset 255 for buffer and read data skipping 4 byte
-    int bandCount = 4;
-    int bands[4];
-    bands[0] = m_red;
-    bands[1] = m_green;
-    bands[2] = m_blue;
-    bands[3] = m_alpha;
-
-    int overview = MAX_ZOOM;
+    // Buffer pixels match pixels of raster or overview level, so the window
+    // is read from the level blocks shared with the neighbour tiles
+    int overview = -1;
+    int levelXOff = minX;
+    int levelYOff = minY;
     bool smooth = false;
     if(outWidth >= width && outHeight >= height ) { // Read original raster
         outWidth = width;
@@ -1126,78 +2241,221 @@ bool GlRasterLayer::fill(const GlTilePtr &tile, float z, bool isLastTry)
         int minYOv = minY;
         int outWidthOv = width;
         int outHeightOv = height;
-        overview = m_raster->getBestOverview(minXOv, minYOv,
-                                             outWidthOv, outHeightOv,
-                                             outWidth, outHeight);
-        if(overview >= -5) {
-            outWidth = outWidthOv;
-            outHeight = outHeightOv;
+        int bestOverview = m_raster->getBestOverview(minXOv, minYOv,
+                                                     outWidthOv, outHeightOv,
+                                                     outWidth, outHeight);
+        outWidth = outWidthOv;
+        outHeight = outHeightOv;
+        if(bestOverview >= 0) {
+            overview = bestOverview;
+            levelXOff = minXOv;
+            levelYOff = minYOv;
         }
     }
 
     int dataSize = GDALGetDataTypeSizeBytes(m_dataType);
     size_t bufferSize = static_cast<size_t>(outWidth * outHeight *
                                             dataSize * 4); // NOTE: We use RGBA to store textures
-    GLubyte *pixData = static_cast<GLubyte*>(CPLMalloc(bufferSize));
-
+    GLubyte *pixData = nullptr;
     if(m_alpha == 0) {
+        pixData = static_cast<GLubyte*>(CPLMalloc(bufferSize));
         std::memset(pixData, 255 - m_transparency, bufferSize);
-        if(!m_raster->pixelData(pixData, minX, minY, width, height, outWidth,
-                                outHeight, m_dataType, bandCount, bands, true, true)) {
+    }
+    else {
+        pixData = static_cast<GLubyte*>(CPLCalloc(1, bufferSize));
+    }
+
+    // Other maps may have read the same window already
+    std::string imageKey = ImageCache::key(m_raster->path(), overview,
+        levelXOff, levelYOff, outWidth, outHeight, m_imageStyle);
+    ImageCache &imageCache = ImageCache::instance();
+    if(imageCache.get(imageKey, pixData, bufferSize)) {
+        if(cancel.isCanceled()) {
             CPLFree(pixData);
+            return true;
+        }
+        setTileImage(tile, pixData, outWidth, outHeight, smooth, outExt, z,
+                     cancel);
+        return true;
+    }
 
-            if(isLastTry) {
-                MutexHolder holder(m_dataMutex, LOCK_TIME);
-                m_tiles[tile->getTile()] = GlObjectPtr();
-                return true;
-            }
+    // Level pixel size for hillshade
+    double xRes = 1.0, yRes = 1.0;
+    if(!noTransform) {
+        xRes = geoTransform[1] * width / outWidth;
+        yRes = geoTransform[5] * height / outHeight;
+        OGRSpatialReference *srs = m_raster->spatialReference();
+        if(nullptr != srs && srs->IsGeographic()) {
+            // Degrees to meters at window center
+            double lat = outExt.center().y * M_PI / 180.0;
+            xRes *= 111320.0 * std::cos(lat);
+            yRes *= 110540.0;
+        }
+    }
+
+    if(!readPixels(pixData, overview, levelXOff, levelYOff, outWidth,
+                   outHeight, bands, xRes, yRes)) {
+        CPLFree(pixData);
+
+        if(isLastTry) {
+            setTileData(tile, GlObjectPtr(), cancel);
+            return true;
+        }
+
+        // TODO: Get overzoom or underzoom pixels here
+
+        return false;
+    }
+    imageCache.put(imageKey, pixData, bufferSize);
+
+    if(cancel.isCanceled()) {
+        CPLFree(pixData);
+        return true;
+    }
 
-            // TODO: Get overzoom or underzoom pixels here
+    setTileImage(tile, pixData, outWidth, outHeight, smooth, outExt, z,
+                 cancel);
+    return true;
+}
 
+/**
+ * @brief GlRasterLayer::readPixels Read window pixels of raster or overview
+ * level and convert them to RGBA by render type.
+ * @param pixData RGBA buffer of width * height pixels
+ * @param overview Overview index or -1 for raster itself
+ * @param xOff Window x offset in level pixels
+ * @param yOff Window y offset in level pixels
+ * @param width Window width
+ * @param height Window height
+ * @param bands Raster bands for RGBA
+ * @param xRes Level pixel width in height units, used for hillshade
+ * @param yRes Level pixel height in height units, used for hillshade
+ * @return True on success.
+ */
+bool GlRasterLayer::readPixels(GLubyte *pixData, int overview, int xOff,
+                               int yOff, int width, int height, int *bands,
+                               double xRes, double yRes)
+{
+    size_t count = static_cast<size_t>(width) * static_cast<size_t>(height);
+    int band = m_red;
+    switch(m_renderType) {
+    case RenderType::PALETTE:
+    {
+        std::vector<GLubyte> indexes(count);
+        if(!m_raster->levelPixelData(indexes.data(), overview, xOff, yOff,
+                                     width, height, GDT_Byte, 1, &band)) {
             return false;
         }
+        paletteToRGBA(indexes.data(), count, m_palette.data(), pixData);
+        return true;
+    }
+    case RenderType::COLOR_RAMP:
+    {
+        std::vector<float> values(count);
+        if(!m_raster->levelPixelData(values.data(), overview, xOff, yOff,
+                                     width, height, GDT_Float32, 1, &band)) {
+            return false;
+        }
+        m_colorRamp.apply(values.data(), count, pixData, m_hasNoData, m_noData);
+        if(m_hillshade) {
+            applyHillshade(values.data(), width, height, xRes, yRes, pixData);
+        }
+        return true;
+    }
+    case RenderType::RGBA:
+        break;
     }
-    else {
-        if(!m_raster->pixelData(pixData, minX, minY, width, height, outWidth,
-                                outHeight, m_dataType, bandCount, bands)) {
-            CPLFree(pixData);
 
-            if(isLastTry) {
-                MutexHolder holder(m_dataMutex, LOCK_TIME);
-                m_tiles[tile->getTile()] = GlObjectPtr();
-                return true;
+    return m_raster->levelPixelData(pixData, overview, xOff, yOff, width,
+                                    height, m_dataType, 4, bands, m_alpha == 0);
+}
+
+/**
+ * @brief GlRasterLayer::initRenderType Select band conversion by raster band
+ * count and data type. One band raster with palette is drawn with palette
+ * colors, one band raster of other than Byte type (DEM, etc.) is drawn with
+ * color ramp. Default ramp is stretched to band values range.
+ */
+void GlRasterLayer::initRenderType()
+{
+    m_renderType = RenderType::RGBA;
+    if(m_raster && m_raster->bandCount() == 1) {
+        double noData = 0.0;
+        m_hasNoData = m_raster->noData(noData, m_red);
+        m_noData = static_cast<float>(noData);
+
+        if(m_raster->colorTable(m_palette, m_red)) {
+            m_renderType = RenderType::PALETTE;
+        }
+        else if(m_raster->dataType(m_red) != GDT_Byte) {
+            m_renderType = RenderType::COLOR_RAMP;
+            double min = 0.0, max = 0.0;
+            if(m_colorRamp.isEmpty() && m_raster->minMax(min, max, m_red)) {
+                m_colorRamp.setStops({ { min, DEFAULT_RAMP_LOW_COLOR },
+                                       { max, DEFAULT_RAMP_HIGH_COLOR } });
             }
+        }
+        else {
+            // Gray image
+            m_green = m_red;
+            m_blue = m_red;
+        }
+    }
 
-            return false;
+    m_imageStyle = CPLSPrintf("%d,%d,%d,%d,%d,%d,%d,%d", m_red, m_green,
+                              m_blue, m_alpha, m_transparency, m_dataType,
+                              static_cast<int>(m_renderType),
+                              m_hillshade ? 1 : 0);
+    if(m_renderType == RenderType::COLOR_RAMP) {
+        for(const ColorRampStop &stop : m_colorRamp.stops()) {
+            m_imageStyle += CPLSPrintf(",%f:%s", stop.value,
+                                       ngsRGBA2HEX(stop.color).c_str());
         }
     }
+}
 
+/**
+ * @brief GlRasterLayer::setTileImage Set tile texture and tile quad.
+ * @param tile Tile to set
+ * @param pixData RGBA pixels, the image takes ownership
+ * @param width Image width
+ * @param height Image height
+ * @param smooth Smooth texture
+ * @param extent Quad extent
+ * @param z Quad z
+ * @param cancel Fill cancel token
+ */
+void GlRasterLayer::setTileImage(const GlTilePtr &tile, GLubyte *pixData,
+                                 int width, int height, bool smooth,
+                                 const Envelope &extent, float z,
+                                 const CancelToken &cancel)
+{
     GlImage *image = new GlImage;
-    image->setImage(pixData, outWidth, outHeight); // NOTE: May be not working NOD
+    image->setImage(pixData, width, height); // NOTE: May be not working NOD
     image->setSmooth(smooth);
 
     // FIXME: Reproject intersect raster extent to tile extent
     GlBuffer *tileExtentBuff = new GlBuffer(GlBuffer::BF_TEX);
-    tileExtentBuff->addVertex(static_cast<float>(outExt.minX()));
-    tileExtentBuff->addVertex(static_cast<float>(outExt.minY()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.minX()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.minY()));
     tileExtentBuff->addVertex(z);
     tileExtentBuff->addVertex(0.0f);
     tileExtentBuff->addVertex(1.0f);
     tileExtentBuff->addIndex(0);
-    tileExtentBuff->addVertex(static_cast<float>(outExt.minX()));
-    tileExtentBuff->addVertex(static_cast<float>(outExt.maxY()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.minX()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.maxY()));
     tileExtentBuff->addVertex(z);
     tileExtentBuff->addVertex(0.0f);
     tileExtentBuff->addVertex(0.0f);
     tileExtentBuff->addIndex(1);
-    tileExtentBuff->addVertex(static_cast<float>(outExt.maxX()));
-    tileExtentBuff->addVertex(static_cast<float>(outExt.maxY()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.maxX()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.maxY()));
     tileExtentBuff->addVertex(z);
     tileExtentBuff->addVertex(1.0f);
     tileExtentBuff->addVertex(0.0f);
     tileExtentBuff->addIndex(2);
-    tileExtentBuff->addVertex(static_cast<float>(outExt.maxX()));
-    tileExtentBuff->addVertex(static_cast<float>(outExt.minY()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.maxX()));
+    tileExtentBuff->addVertex(static_cast<float>(extent.minY()));
     tileExtentBuff->addVertex(z);
     tileExtentBuff->addVertex(1.0f);
     tileExtentBuff->addVertex(1.0f);
@@ -1205,12 +2463,8 @@ bool GlRasterLayer::fill(const GlTilePtr &tile, float z, bool isLastTry)
     tileExtentBuff->addIndex(2);
     tileExtentBuff->addIndex(3);
 
-    GlObjectPtr tileData(new RasterGlObject(tileExtentBuff, image));
-
-    MutexHolder holder(m_dataMutex, LOCK_TIME);
-    m_tiles[tile->getTile()] = tileData;
-
-    return true;
+    setTileData(tile, GlObjectPtr(new RasterGlObject(tileExtentBuff, image)),
+                cancel);
 }
 
 bool GlRasterLayer::draw(const GlTilePtr &tile)
@@ -1222,15 +2476,12 @@ bool GlRasterLayer::draw(const GlTilePtr &tile)
         return true; // Should never happened
     }
 
-    m_dataMutex.acquire(LOCK_TIME);
     auto tileDataIt = m_tiles.find(tile->getTile());
     if(tileDataIt == m_tiles.end()) {
-        m_dataMutex.release();
         return false; // Data not yet loaded
     }
 
-    auto second = tileDataIt->second;
-    m_dataMutex.release();
+    const GlObjectPtr &second = tileDataIt->second;
 
     if(!second) {
         return true; // Out of tile extent
@@ -1240,6 +2491,9 @@ bool GlRasterLayer::draw(const GlTilePtr &tile)
 
     // Bind everything before call prepare and set matrices
     GlImage *img = rasterGlObject->getImageRef();
+    if(!img->bound() && !GlImage::canUpload()) {
+        return false; // Upload in next frame
+    }
     ngsStaticCast(SimpleImageStyle, m_style)->setImage(img);
     GlBuffer *extBuff = rasterGlObject->getBufferRef();
     if(extBuff->bound()) {
@@ -1347,6 +2601,18 @@ bool GlRasterLayer::load(const CPLJSONObject &store, ObjectContainer *objectCont
         m_alpha = static_cast<unsigned char>(raster.GetInteger("alpha", m_alpha));
         m_transparency = static_cast<unsigned char>(raster.GetInteger("transparency",
                                                                       m_transparency));
+        m_hillshade = raster.GetBool("hillshade", m_hillshade);
+        CPLJSONArray ramp = raster.GetArray("color_ramp");
+        if(ramp.IsValid()) {
+            std::vector<ColorRampStop> stops;
+            for(int i = 0; i < ramp.Size(); ++i) {
+                CPLJSONObject stop = ramp[i];
+                stops.push_back({ stop.GetDouble("value", 0.0),
+                                  ngsHEX2RGBA(stop.GetString("color",
+                                        ngsRGBA2HEX(DEFAULT_RAMP_HIGH_COLOR))) });
+            }
+            m_colorRamp.setStops(stops);
+        }
     }
 
     GlView *mapView = dynamic_cast<GlView*>(m_map);
@@ -1354,6 +2620,15 @@ bool GlRasterLayer::load(const CPLJSONObject &store, ObjectContainer *objectCont
     return true;
 }
 
+bool GlRasterLayer::bindDatasource()
+{
+    if(!RasterLayer::bindDatasource()) {
+        return false;
+    }
+    initRenderType();
+    return true;
+}
+
 CPLJSONObject GlRasterLayer::save(const ObjectContainer *objectContainer) const
 {
     CPLJSONObject out = RasterLayer::save(objectContainer);
@@ -1363,6 +2638,17 @@ CPLJSONObject GlRasterLayer::save(const ObjectContainer *objectContainer) const
     raster.Add("blue", m_blue);
     raster.Add("alpha", m_alpha);
     raster.Add("transparency", m_transparency);
+    raster.Add("hillshade", m_hillshade);
+    if(!m_colorRamp.isEmpty()) {
+        CPLJSONArray ramp;
+        for(const ColorRampStop &stop : m_colorRamp.stops()) {
+            CPLJSONObject rampStop;
+            rampStop.Add("value", stop.value);
+            rampStop.Add("color", ngsRGBA2HEX(stop.color));
+            ramp.Add(rampStop);
+        }
+        raster.Add("color_ramp", ramp);
+    }
     out.Add("raster", raster);
     return out;
 }
@@ -1377,6 +2663,7 @@ void GlRasterLayer::setRaster(const RasterPtr &raster)
     if(raster->bandCount() == 4) {
         m_alpha = 4;
     }
+    initRenderType();
 }
 
 //------------------------------------------------------------------------------
@@ -1409,12 +2696,274 @@ void RasterGlObject::destroy()
     m_image->destroy();
 }
 
+size_t RasterGlObject::memorySize() const
+{
+    return m_extentBuffer->memorySize() + m_image->memorySize();
+}
+
+//------------------------------------------------------------------------------
+// TileItemIndex
+//------------------------------------------------------------------------------
+
+TileItemIndex::TileItemIndex(const FlatVectorTile &tile)
+{
+    std::vector<size_t> items;
+    for(auto it = tile.begin(); it != tile.end(); ++it) {
+        const FlatVectorTileItem &tileItem = *it;
+        OGREnvelope env;
+        for(const SimplePoint &pt : tileItem.points()) {
+            env.Merge(static_cast<double>(pt.x), static_cast<double>(pt.y));
+        }
+        items.push_back(m_envelopes.size());
+        m_envelopes.push_back(env);
+        m_idOffsets.push_back(m_ids.size());
+        m_ids.insert(m_ids.end(), tileItem.ids().begin(), tileItem.ids().end());
+    }
+    m_idOffsets.push_back(m_ids.size());
+    m_tree.build(m_envelopes, items);
+}
+
+/**
+ * @brief TileItemIndex::search Find items which envelopes intersect extent.
+ * @param env Extent to search.
+ * @param hits Ids of items which envelopes are inside the extent.
+ * @param candidates Ids of items which envelopes intersect the extent.
+ */
+void TileItemIndex::search(const Envelope &env, FeatureIDs &hits,
+                           FeatureIDs &candidates) const
+{
+    std::vector<size_t> items;
+    OGREnvelope searchEnv = env.toOgrEnvelope();
+    m_tree.search(searchEnv, items);
+    for(size_t item : items) {
+        FeatureIDs &out = searchEnv.Contains(m_envelopes[item]) ? hits :
+                                                                  candidates;
+        for(size_t i = m_idOffsets[item]; i < m_idOffsets[item + 1]; ++i) {
+            out.insert(m_ids[i]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// SnapIndex
+//------------------------------------------------------------------------------
+
+SnapIndex::SnapIndex(const FlatVectorTile &tile, enum ngsStyleType type) :
+    m_cellWidth(0.0),
+    m_cellHeight(0.0)
+{
+    OGREnvelope env;
+    GLuint item = 0;
+    for(auto it = tile.begin(); it != tile.end(); ++it, ++item) {
+        const FlatVectorTileItem &tileItem = *it;
+        GLuint first = static_cast<GLuint>(m_points.size());
+        for(const SimplePoint &pt : tileItem.points()) {
+            env.Merge(static_cast<double>(pt.x), static_cast<double>(pt.y));
+            m_points.push_back(pt);
+            m_pointItems.push_back(item);
+        }
+
+        enum ngsStyleType itemType = type == ST_MIXED ?
+                    tileItemStyleType(tileItem) : type;
+        switch(itemType) {
+        case ST_LINE:
+            for(GLuint i = 1; i < tileItem.pointCount(); ++i) {
+                m_segments.push_back({first + i - 1, first + i});
+            }
+            break;
+        case ST_FILL:
+            for(size_t ring = 0; ring < tileItem.borderCount(); ++ring) {
+                ArrayView<unsigned short> border = tileItem.borderIndices(ring);
+                for(size_t i = 1; i < border.size(); ++i) {
+                    m_segments.push_back({first + border[i - 1],
+                                          first + border[i]});
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        m_idOffsets.push_back(m_ids.size());
+        m_ids.insert(m_ids.end(), tileItem.ids().begin(), tileItem.ids().end());
+    }
+    m_idOffsets.push_back(m_ids.size());
+
+    if(m_points.empty()) {
+        return;
+    }
+
+    m_extent = env;
+    m_cellWidth = m_extent.width() / SNAP_INDEX_SIDE;
+    m_cellHeight = m_extent.height() / SNAP_INDEX_SIDE;
+    if(isEqual(m_cellWidth, 0.0)) {
+        m_cellWidth = 1.0;
+    }
+    if(isEqual(m_cellHeight, 0.0)) {
+        m_cellHeight = 1.0;
+    }
+
+    // Count cell content, then store it at cell offsets
+    size_t cellCount = SNAP_INDEX_SIDE * SNAP_INDEX_SIDE;
+    m_pointOffsets.assign(cellCount + 1, 0);
+    m_segmentOffsets.assign(cellCount + 1, 0);
+    int begX, begY, endX, endY;
+    for(const SimplePoint &pt : m_points) {
+        cellRange(pt.x, pt.y, pt.x, pt.y, begX, begY, endX, endY);
+        m_pointOffsets[begY * SNAP_INDEX_SIDE + begX + 1]++;
+    }
+    for(const Segment &segment : m_segments) {
+        const SimplePoint &pt1 = m_points[segment.begin];
+        const SimplePoint &pt2 = m_points[segment.end];
+        cellRange(std::min(pt1.x, pt2.x), std::min(pt1.y, pt2.y),
+                  std::max(pt1.x, pt2.x), std::max(pt1.y, pt2.y),
+                  begX, begY, endX, endY);
+        for(int y = begY; y <= endY; ++y) {
+            for(int x = begX; x <= endX; ++x) {
+                m_segmentOffsets[y * SNAP_INDEX_SIDE + x + 1]++;
+            }
+        }
+    }
+    for(size_t i = 1; i <= cellCount; ++i) {
+        m_pointOffsets[i] += m_pointOffsets[i - 1];
+        m_segmentOffsets[i] += m_segmentOffsets[i - 1];
+    }
+
+    m_cellPoints.resize(m_pointOffsets[cellCount]);
+    m_cellSegments.resize(m_segmentOffsets[cellCount]);
+    std::vector<GLuint> pointPos(m_pointOffsets.begin(), m_pointOffsets.end() - 1);
+    std::vector<GLuint> segmentPos(m_segmentOffsets.begin(),
+                                   m_segmentOffsets.end() - 1);
+    for(GLuint i = 0; i < m_points.size(); ++i) {
+        cellRange(m_points[i].x, m_points[i].y, m_points[i].x, m_points[i].y,
+                  begX, begY, endX, endY);
+        m_cellPoints[pointPos[begY * SNAP_INDEX_SIDE + begX]++] = i;
+    }
+    for(GLuint i = 0; i < m_segments.size(); ++i) {
+        const SimplePoint &pt1 = m_points[m_segments[i].begin];
+        const SimplePoint &pt2 = m_points[m_segments[i].end];
+        cellRange(std::min(pt1.x, pt2.x), std::min(pt1.y, pt2.y),
+                  std::max(pt1.x, pt2.x), std::max(pt1.y, pt2.y),
+                  begX, begY, endX, endY);
+        for(int y = begY; y <= endY; ++y) {
+            for(int x = begX; x <= endX; ++x) {
+                m_cellSegments[segmentPos[y * SNAP_INDEX_SIDE + x]++] = i;
+            }
+        }
+    }
+}
+
+/**
+ * @brief SnapIndex::snap Find the nearest vertex within tolerance, or if no
+ * vertex found, the nearest point on segments.
+ * @param pt Point in tile items coordinates.
+ * @param tolerance Snap distance.
+ * @param skipIds Items which ids all present in this set are skipped.
+ * @param result Nearest point found so far, updated if a better one is found.
+ */
+void SnapIndex::snap(const OGRRawPoint &pt, double tolerance,
+                     const FeatureIDs &skipIds, SnapResult &result) const
+{
+    int begX, begY, endX, endY;
+    if(!cellRange(pt.x - tolerance, pt.y - tolerance,
+                  pt.x + tolerance, pt.y + tolerance,
+                  begX, begY, endX, endY)) {
+        return;
+    }
+
+    double tolerance2 = tolerance * tolerance;
+    for(int y = begY; y <= endY; ++y) {
+        for(int x = begX; x <= endX; ++x) {
+            int cell = y * SNAP_INDEX_SIDE + x;
+            for(GLuint i = m_pointOffsets[cell]; i < m_pointOffsets[cell + 1];
+                ++i) {
+                GLuint point = m_cellPoints[i];
+                if(isItemSkipped(m_pointItems[point], skipIds)) {
+                    continue;
+                }
+                double dx = m_points[point].x - pt.x;
+                double dy = m_points[point].y - pt.y;
+                double distance2 = dx * dx + dy * dy;
+                if(distance2 <= tolerance2) {
+                    result.update(OGRRawPoint(m_points[point].x,
+                                              m_points[point].y),
+                                  distance2, true);
+                }
+            }
+        }
+    }
+
+    if(result.found && result.vertex) {
+        return;
+    }
+
+    for(int y = begY; y <= endY; ++y) {
+        for(int x = begX; x <= endX; ++x) {
+            int cell = y * SNAP_INDEX_SIDE + x;
+            for(GLuint i = m_segmentOffsets[cell];
+                i < m_segmentOffsets[cell + 1]; ++i) {
+                const Segment &segment = m_segments[m_cellSegments[i]];
+                if(isItemSkipped(m_pointItems[segment.begin], skipIds)) {
+                    continue;
+                }
+                const SimplePoint &pt1 = m_points[segment.begin];
+                const SimplePoint &pt2 = m_points[segment.end];
+                double sx = static_cast<double>(pt2.x - pt1.x);
+                double sy = static_cast<double>(pt2.y - pt1.y);
+                double length2 = sx * sx + sy * sy;
+                if(isEqual(length2, 0.0)) {
+                    continue;
+                }
+                double t = ((pt.x - pt1.x) * sx + (pt.y - pt1.y) * sy) / length2;
+                t = std::max(0.0, std::min(t, 1.0));
+                OGRRawPoint projection(pt1.x + t * sx, pt1.y + t * sy);
+                double dx = projection.x - pt.x;
+                double dy = projection.y - pt.y;
+                double distance2 = dx * dx + dy * dy;
+                if(distance2 <= tolerance2) {
+                    result.update(projection, distance2, false);
+                }
+            }
+        }
+    }
+}
+
+bool SnapIndex::cellRange(double minX, double minY, double maxX, double maxY,
+                          int &begX, int &begY, int &endX, int &endY) const
+{
+    if(m_points.empty() || maxX < m_extent.minX() || minX > m_extent.maxX() ||
+            maxY < m_extent.minY() || minY > m_extent.maxY()) {
+        return false;
+    }
+
+    auto cell = [](double value, double origin, double size) {
+        int out = static_cast<int>(std::floor((value - origin) / size));
+        return std::max(0, std::min(out, SNAP_INDEX_SIDE - 1));
+    };
+    begX = cell(minX, m_extent.minX(), m_cellWidth);
+    endX = cell(maxX, m_extent.minX(), m_cellWidth);
+    begY = cell(minY, m_extent.minY(), m_cellHeight);
+    endY = cell(maxY, m_extent.minY(), m_cellHeight);
+    return true;
+}
+
+bool SnapIndex::isItemSkipped(GLuint item, const FeatureIDs &skipIds) const
+{
+    if(skipIds.empty() || m_idOffsets[item] == m_idOffsets[item + 1]) {
+        return false;
+    }
+    return skipIds.includes(m_ids.data() + m_idOffsets[item],
+                            m_ids.data() + m_idOffsets[item + 1]);
+}
+
 //------------------------------------------------------------------------------
 // VectorGlObject
 //------------------------------------------------------------------------------
 
 VectorGlObject::VectorGlObject() :
-    GlObject()
+    GlObject(),
+    m_tileVersion(0),
+    m_styleVersion(0)
 {
 
 }
@@ -1444,16 +2993,226 @@ void VectorGlObject::destroy()
     }
 }
 
+size_t VectorGlObject::memorySize() const
+{
+    size_t out = 0;
+    for(const GlBufferPtr& buffer : m_buffers) {
+        out += buffer->memorySize();
+    }
+    return out;
+}
+
+VectorGlObject *VectorGlObject::copy() const
+{
+    VectorGlObject *out = new VectorGlObject;
+    copyTo(out);
+    return out;
+}
+
+size_t VectorGlObject::dataSize() const
+{
+    size_t out = 0;
+    for(const GlBufferPtr& buffer : m_buffers) {
+        out += buffer->dataSize();
+    }
+    return out;
+}
+
+void VectorGlObject::copyTo(VectorGlObject *out) const
+{
+    for(const GlBufferPtr& buffer : m_buffers) {
+        out->addBuffer(buffer->copy());
+    }
+    out->m_index = m_index;
+    out->m_snapIndex = m_snapIndex;
+    out->m_tileVersion = m_tileVersion;
+    out->m_styleVersion = m_styleVersion;
+}
+
+//------------------------------------------------------------------------------
+// VectorMixedGlObject
+//------------------------------------------------------------------------------
+
+bool VectorMixedGlObject::uploadPostponed() const
+{
+    for(const Part &part : m_parts) {
+        VectorGlObject *vectorGlObject = ngsDynamicCast(VectorGlObject,
+                                                        part.second);
+        if(ngs::uploadPostponed(vectorGlObject->buffers())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void VectorMixedGlObject::bind()
+{
+    if(m_bound) {
+        return;
+    }
+    for(Part &part : m_parts) {
+        part.second->bind();
+    }
+    m_bound = true;
+}
+
+void VectorMixedGlObject::rebind() const
+{
+    for(const Part &part : m_parts) {
+        part.second->rebind();
+    }
+}
+
+void VectorMixedGlObject::destroy()
+{
+    for(Part &part : m_parts) {
+        part.second->destroy();
+    }
+}
+
+size_t VectorMixedGlObject::memorySize() const
+{
+    size_t out = 0;
+    for(const Part &part : m_parts) {
+        out += part.second->memorySize();
+    }
+    return out;
+}
+
+VectorGlObject *VectorMixedGlObject::copy() const
+{
+    VectorMixedGlObject *out = new VectorMixedGlObject;
+    copyTo(out);
+    for(const Part &part : m_parts) {
+        VectorGlObject *vectorGlObject = ngsDynamicCast(VectorGlObject,
+                                                        part.second);
+        out->addPart(part.first, vectorGlObject->copy());
+    }
+    return out;
+}
+
+size_t VectorMixedGlObject::dataSize() const
+{
+    size_t out = 0;
+    for(const Part &part : m_parts) {
+        VectorGlObject *vectorGlObject = ngsDynamicCast(VectorGlObject,
+                                                        part.second);
+        out += vectorGlObject->dataSize();
+    }
+    return out;
+}
+
 //------------------------------------------------------------------------------
 // VectorGlObject
 //------------------------------------------------------------------------------
 
 VectorSelectableGlObject::VectorSelectableGlObject() :
-    VectorGlObject()
+    VectorGlObject(),
+    m_selectionShared(false),
+    m_statesVersion(std::numeric_limits<unsigned int>::max()),
+    m_selectedCount(0),
+    m_hiddenCount(0)
 {
 
 }
 
+/**
+ * @brief VectorSelectableGlObject::setItems Store tile item ids. The item
+ * index is the item position in tile, the same as used in GlBuffer::startItem.
+ * @param tile Tile which items were filled to buffers.
+ */
+void VectorSelectableGlObject::setItems(const FlatVectorTile &tile)
+{
+    for(auto it = tile.begin(); it != tile.end(); ++it) {
+        const ArrayView<GIntBig> &ids = (*it).ids();
+        m_itemIdOffsets.push_back(m_itemIds.size());
+        m_itemIds.insert(m_itemIds.end(), ids.begin(), ids.end());
+    }
+    m_itemIdOffsets.push_back(m_itemIds.size());
+    m_itemStates.assign(m_itemIdOffsets.size() - 1, IS_NORMAL);
+}
+
+/**
+ * @brief VectorSelectableGlObject::setStyleClasses Store data driven style
+ * classes of tile items.
+ * @param itemClasses Class index of each tile item. May be empty if all items
+ * have the first class.
+ * @param classes Style property values of classes.
+ */
+void VectorSelectableGlObject::setStyleClasses(
+        std::vector<unsigned short> &&itemClasses,
+        std::vector<StyleClass> &&classes)
+{
+    m_itemClasses = std::move(itemClasses);
+    m_classes = std::move(classes);
+}
+
+/**
+ * @brief VectorSelectableGlObject::updateItemStates Recalculate items state if
+ * layer selection changed since last call.
+ * @param selectedIds Selected feature ids.
+ * @param hideIds Hidden feature ids.
+ * @param version Layer selection version.
+ */
+void VectorSelectableGlObject::updateItemStates(const FeatureIDs &selectedIds,
+                                                const FeatureIDs &hideIds,
+                                                unsigned int version)
+{
+    if(m_statesVersion == version) {
+        return;
+    }
+
+    m_selectedCount = 0;
+    m_hiddenCount = 0;
+    for(size_t item = 0; item < m_itemStates.size(); ++item) {
+        const GIntBig *begin = m_itemIds.data() + m_itemIdOffsets[item];
+        const GIntBig *end = m_itemIds.data() + m_itemIdOffsets[item + 1];
+        ItemState state = IS_NORMAL;
+        // Item ids are sorted, so both checks are merges
+        if(begin != end && !hideIds.empty() && hideIds.includes(begin, end)) {
+            state = IS_HIDDEN;
+            m_hiddenCount++;
+        }
+        else if(selectedIds.intersects(begin, end)) {
+            state = IS_SELECTED;
+            m_selectedCount++;
+        }
+        m_itemStates[item] = state;
+    }
+    m_statesVersion = version;
+}
+
+/**
+ * @brief VectorSelectableGlObject::copy Not bound copy of the data. Item states
+ * of the copy are calculated on first draw.
+ * @return New object.
+ */
+VectorGlObject *VectorSelectableGlObject::copy() const
+{
+    VectorSelectableGlObject *out = new VectorSelectableGlObject;
+    copyTo(out);
+    for(const GlBufferPtr& buffer : m_selectionBuffers) {
+        out->addSelectionBuffer(buffer->copy());
+    }
+    out->m_selectionShared = m_selectionShared;
+    out->m_itemIds = m_itemIds;
+    out->m_itemIdOffsets = m_itemIdOffsets;
+    out->m_itemStates.assign(m_itemStates.size(), IS_NORMAL);
+    out->m_classes = m_classes;
+    out->m_itemClasses = m_itemClasses;
+    return out;
+}
+
+size_t VectorSelectableGlObject::dataSize() const
+{
+    size_t out = VectorGlObject::dataSize();
+    for(const GlBufferPtr& buffer : m_selectionBuffers) {
+        out += buffer->dataSize();
+    }
+    return out + sizeof(GIntBig) * m_itemIds.size() +
+            sizeof(size_t) * m_itemIdOffsets.size();
+}
+
 void VectorSelectableGlObject::bind()
 {
     if(m_bound) {
@@ -1464,8 +3223,10 @@ void VectorSelectableGlObject::bind()
         buffer->bind();
     }
 
-    for(GlBufferPtr& buffer : m_selectionBuffers) {
-        buffer->bind();
+    if(!m_selectionShared) {
+        for(GlBufferPtr& buffer : m_selectionBuffers) {
+            buffer->bind();
+        }
     }
 
     m_bound = true;
@@ -1477,8 +3238,10 @@ void VectorSelectableGlObject::rebind() const
         buffer->rebind();
     }
 
-    for(const GlBufferPtr& buffer : m_selectionBuffers) {
-        buffer->rebind();
+    if(!m_selectionShared) {
+        for(const GlBufferPtr& buffer : m_selectionBuffers) {
+            buffer->rebind();
+        }
     }
 }
 
@@ -21,11 +21,15 @@
 #ifndef NGSGLMAPLAYER_H
 #define NGSGLMAPLAYER_H
 
+#include <atomic>
 #include <set>
 
+#include "label.h"
 #include "style.h"
 #include "tile.h"
+#include "ds/memcolumnar.h"
 #include "map/layer.h"
+#include "util/mpscqueue.h"
 
 namespace ngs {
 
@@ -40,13 +44,38 @@ public:
     /**
      * @brief fill Fill arrays for Gl drawing. Executed from separate thread.
      * @param tile Tile to load data
+     * @param cancel Token to stop filling if tile is no longer needed. The
+     * canceled fill must not store any data and should return true.
      */
-    virtual bool fill(const GlTilePtr &tile, float z, bool isLastTry) = 0;
+    virtual bool fill(const GlTilePtr &tile, float z, bool isLastTry,
+                      const CancelToken &cancel = CancelToken()) = 0;
+    /**
+     * @brief readTiles Read data of several tiles at once before they are
+     * filled. Executed from separate thread.
+     * @param tiles Tiles to read data
+     * @param cancel Token to stop reading
+     */
+    virtual void readTiles(const std::vector<GlTilePtr> &tiles,
+                           const CancelToken &cancel = CancelToken());
     /**
      * @brief free Free Gl objects. Run from Gl context.
      * @param tile Tile to free data
      */
     virtual void free(const GlTilePtr &tile);
+    /**
+     * @brief markRefill Take layer data of tile aside until the tile is
+     * filled again, so fill may use it if nothing changed. Run from Gl context.
+     * @param tile Tile to refill
+     */
+    void markRefill(const GlTilePtr &tile);
+    /**
+     * @brief hasData Check if layer data for tile is filled.
+     * @param tile Tile to check
+     * @return True if fill for the tile already finished.
+     */
+    bool hasData(const GlTilePtr &tile) const;
+    size_t memorySize(const GlTilePtr &tile) const;
+    size_t applyFills();
     /**
      * @brief draw Draw data for specific tile. Run from Gl context.
      * @param tile Tile to draw
@@ -58,13 +87,104 @@ public:
     virtual CPLJSONObject style() const override;
     virtual std::string styleName() const override;
     virtual bool setStyle(const CPLJSONObject &style) override;
+    virtual double fillLatency(double percentile) const override;
+    /**
+     * @brief addFillLatency Store time from fill job creation to its finish.
+     * Executed from separate thread.
+     * @param time Latency in milliseconds
+     */
+    void addFillLatency(double time);
+    std::vector<double> fillLatencies() const;
+    static double percentileValue(std::vector<double> values, double percentile);
+protected:
+    void setTileData(const GlTilePtr &tile, const GlObjectPtr &data,
+                     const CancelToken &cancel);
+    GlObjectPtr refillData(const GlTilePtr &tile) const;
+
+protected:
+    typedef struct _tileFill {
+        GlTilePtr tile;
+        GlObjectPtr data;
+        CancelToken cancel;
+    } TileFill;
+
 protected:
+    // Changed only in Gl context, so Gl context reads it without lock
     std::map<Tile, GlObjectPtr> m_tiles;
+    // Data of tiles waiting for refill, guarded by m_dataMutex
+    std::map<Tile, GlObjectPtr> m_refills;
+    MpscQueue<TileFill> m_fills;
     StylePtr m_style;
-    Mutex m_dataMutex;
+    SharedMutex m_dataMutex;
     std::vector<StylePtr> m_oldStyles;
+    // Changed with anything but tile content the filled data depends on
+    std::atomic<unsigned int> m_styleVersion;
+    // Last fill latencies ring buffer
+    std::vector<double> m_fillLatencies;
+    size_t m_fillLatencyPos;
+    SpinLock m_fillLatencyMutex;
+};
+
+/**
+ * @brief The TileItemIndex class Envelopes of the tile items packed to R-tree.
+ * Used to identify features by already loaded tile data.
+ */
+class TileItemIndex
+{
+public:
+    explicit TileItemIndex(const FlatVectorTile &tile);
+    void search(const Envelope &env, FeatureIDs &hits,
+                FeatureIDs &candidates) const;
+
+private:
+    PackedRTree m_tree;
+    std::vector<OGREnvelope> m_envelopes;
+    // Ids of tile items, item ids start at m_idOffsets[item]
+    std::vector<GIntBig> m_ids;
+    std::vector<size_t> m_idOffsets;
+};
+
+using TileItemIndexPtr = std::shared_ptr<TileItemIndex>;
+
+/**
+ * @brief The SnapIndex class Vertices and segments of the tile items hashed to
+ * a uniform grid over the items extent. Used to snap edited geometry to the
+ * neighbour features without queries to the feature class.
+ */
+class SnapIndex
+{
+public:
+    explicit SnapIndex(const FlatVectorTile &tile, enum ngsStyleType type);
+    void snap(const OGRRawPoint &pt, double tolerance,
+              const FeatureIDs &skipIds, SnapResult &result) const;
+    bool empty() const { return m_points.empty(); }
+
+private:
+    struct Segment {
+        GLuint begin, end;
+    };
+
+private:
+    bool cellRange(double minX, double minY, double maxX, double maxY,
+                   int &begX, int &begY, int &endX, int &endY) const;
+    bool isItemSkipped(GLuint item, const FeatureIDs &skipIds) const;
+
+private:
+    Envelope m_extent;
+    double m_cellWidth, m_cellHeight;
+    std::vector<SimplePoint> m_points;
+    std::vector<GLuint> m_pointItems;
+    std::vector<Segment> m_segments;
+    // Grid cells, cell content starts at m_...Offsets[cell]
+    std::vector<GLuint> m_pointOffsets, m_cellPoints;
+    std::vector<GLuint> m_segmentOffsets, m_cellSegments;
+    // Ids of tile items, item ids start at m_idOffsets[item]
+    std::vector<GIntBig> m_ids;
+    std::vector<size_t> m_idOffsets;
 };
 
+using SnapIndexPtr = std::shared_ptr<SnapIndex>;
+
 /**
  * @brief The VectorGlObject class Storage for vector data
  */
@@ -74,26 +194,124 @@ public:
     VectorGlObject();
     const std::vector<GlBufferPtr> &buffers() const { return m_buffers; }
     void addBuffer(GlBuffer *buffer) { m_buffers.push_back(GlBufferPtr(buffer)); }
+    const TileItemIndex *index() const { return m_index.get(); }
+    void setIndex(TileItemIndex *index) { m_index = TileItemIndexPtr(index); }
+    const SnapIndex *snapIndex() const { return m_snapIndex.get(); }
+    void setSnapIndex(SnapIndex *index) { m_snapIndex = SnapIndexPtr(index); }
+    /**
+     * @brief setFillVersion Store versions of tile content and layer style
+     * the data was filled from.
+     */
+    void setFillVersion(GUIntBig tileVersion, unsigned int styleVersion) {
+        m_tileVersion = tileVersion;
+        m_styleVersion = styleVersion;
+    }
+    bool isFillVersion(GUIntBig tileVersion, unsigned int styleVersion) const {
+        return tileVersion != 0 && m_tileVersion == tileVersion &&
+                m_styleVersion == styleVersion;
+    }
+    /**
+     * @brief copy Not bound copy of the data. Copy shares the item and snap
+     * indexes, as they are not changed after fill.
+     */
+    virtual VectorGlObject *copy() const;
+    /**
+     * @brief dataSize Memory of the buffers kept on CPU side.
+     */
+    virtual size_t dataSize() const;
 
     // GlObject interface
 public:
     virtual void bind() override;
     virtual void rebind() const override;
     virtual void destroy() override;
+    virtual size_t memorySize() const override;
+protected:
+    void copyTo(VectorGlObject *out) const;
 protected:
     std::vector<GlBufferPtr> m_buffers;
+    TileItemIndexPtr m_index;
+    SnapIndexPtr m_snapIndex;
+    GUIntBig m_tileVersion;
+    unsigned int m_styleVersion;
+};
+
+/**
+ * @brief The VectorMixedGlObject class Storage for vector data of mixed
+ * geometry layer. Tile items of each geometry type are stored in own part,
+ * which is drawn with the sub-style of this type. Item index and snap index
+ * are built for all tile items.
+ */
+class VectorMixedGlObject : public VectorGlObject
+{
+public:
+    using Part = std::pair<enum ngsStyleType, GlObjectPtr>;
+
+public:
+    VectorMixedGlObject() = default;
+    void addPart(enum ngsStyleType type, GlObject *part) {
+        m_parts.push_back(Part(type, GlObjectPtr(part)));
+    }
+    const std::vector<Part> &parts() const { return m_parts; }
+    bool uploadPostponed() const;
+    virtual VectorGlObject *copy() const override;
+    virtual size_t dataSize() const override;
+
+    // GlObject interface
+public:
+    virtual void bind() override;
+    virtual void rebind() const override;
+    virtual void destroy() override;
+    virtual size_t memorySize() const override;
+
+private:
+    std::vector<Part> m_parts;
 };
 
+/**
+ * @brief The VectorSelectableGlObject class Storage for vector data with
+ * selection. Buffers keep index ranges of each tile item, so selected and
+ * hidden items are chosen at draw time and selection change does not need
+ * tile refill.
+ */
 class VectorSelectableGlObject : public VectorGlObject
 {
 public:
     VectorSelectableGlObject();
     const std::vector<GlBufferPtr> &selectionBuffers() const {
-        return m_selectionBuffers;
+        return m_selectionShared ? m_buffers : m_selectionBuffers;
     }
     void addSelectionBuffer(GlBuffer *buffer) {
         m_selectionBuffers.push_back(GlBufferPtr(buffer));
     }
+    void addBuffer(GlBuffer *buffer, bool selection) {
+        if(selection) {
+            addSelectionBuffer(buffer);
+        }
+        else {
+            VectorGlObject::addBuffer(buffer);
+        }
+    }
+    void setItems(const FlatVectorTile &tile);
+    void setSelectionShared(bool shared) { m_selectionShared = shared; }
+    void updateItemStates(const FeatureIDs &selectedIds,
+                          const FeatureIDs &hideIds, unsigned int version);
+    bool hasSelectedItems() const { return m_selectedCount > 0; }
+    bool hasHiddenItems() const { return m_hiddenCount > 0; }
+    bool isItemSelected(GLuint item) const {
+        return item < m_itemStates.size() && m_itemStates[item] == IS_SELECTED;
+    }
+    bool isItemNormal(GLuint item) const {
+        return item >= m_itemStates.size() || m_itemStates[item] == IS_NORMAL;
+    }
+    void setStyleClasses(std::vector<unsigned short> &&itemClasses,
+                         std::vector<StyleClass> &&classes);
+    const std::vector<StyleClass> &styleClasses() const { return m_classes; }
+    size_t itemStyleClass(GLuint item) const {
+        return item < m_itemClasses.size() ? m_itemClasses[item] : 0;
+    }
+    virtual VectorGlObject *copy() const override;
+    virtual size_t dataSize() const override;
 
     // GlObject interface
 public:
@@ -101,8 +319,25 @@ public:
     virtual void rebind() const override;
     virtual void destroy() override;
 
+private:
+    enum ItemState : unsigned char {
+        IS_NORMAL,
+        IS_SELECTED,
+        IS_HIDDEN
+    };
+
 private:
     std::vector<GlBufferPtr> m_selectionBuffers;
+    bool m_selectionShared;
+    // Ids of tile items, item ids start at m_itemIdOffsets[item]
+    std::vector<GIntBig> m_itemIds;
+    std::vector<size_t> m_itemIdOffsets;
+    std::vector<ItemState> m_itemStates;
+    // Data driven style classes and class index of each tile item
+    std::vector<StyleClass> m_classes;
+    std::vector<unsigned short> m_itemClasses;
+    unsigned int m_statesVersion;
+    size_t m_selectedCount, m_hiddenCount;
 };
 
 /**
@@ -116,7 +351,10 @@ public:
 
     // GlRenderLayer interface
 public:
-    virtual bool fill(const GlTilePtr &tile, float z, bool isLastTry) override;
+    virtual bool fill(const GlTilePtr &tile, float z, bool isLastTry,
+                      const CancelToken &cancel = CancelToken()) override;
+    virtual void readTiles(const std::vector<GlTilePtr> &tiles,
+                           const CancelToken &cancel = CancelToken()) override;
     virtual bool draw(const GlTilePtr &tile) override;
     virtual bool setStyleName(const std::string &name) override;
 
@@ -128,11 +366,65 @@ public:
     // FeatureLayer interface
 public:
     virtual void setFeatureClass(const FeatureClassOverviewPtr &featureClass) override;
+    virtual FeatureIDs identify(const Envelope &env,
+                                const CancelToken &cancel = CancelToken()) const override;
+    virtual bool snap(const OGRRawPoint &pt, double tolerance,
+                      SnapResult &result) const override;
+
+    virtual bool setLabelStyle(const CPLJSONObject &style) override;
+    virtual CPLJSONObject labelStyle() const override;
+
+    // ISelectableFeatureLayer interface
+public:
+    virtual void setHideIds(const FeatureIDs &hideIds = FeatureIDs()) override;
+
+public:
+    LabelStylePtr glLabelStyle() const;
+    unsigned int labelsVersion() const;
+    void labelCandidates(const std::vector<GlTilePtr> &tiles,
+                         LabelCandidates &candidates);
+    /**
+     * @brief lodMaxItems Tile item count above which the tile is thinned at
+     * fill time. 0 disables thinning.
+     */
+    unsigned int lodMaxItems() const { return m_lodMaxItems; }
+    void setLodMaxItems(unsigned int count) { m_lodMaxItems = count; }
+
+protected:
+    virtual size_t fillHash() const;
+    std::string fillKey() const;
+    FlatVectorTile lodTile(const Tile &tile, const Envelope &extent,
+                           const FlatVectorTile &vtile,
+                           const CancelToken &cancel) const;
+    virtual VectorGlObject *fillPoints(const FlatVectorTile &tile, float z,
+                                       const StylePtr &style,
+                                       const CancelToken &cancel);
+    virtual VectorGlObject *fillLines(const FlatVectorTile &tile, float z,
+                                      const StylePtr &style,
+                                      const CancelToken &cancel);
+    virtual VectorGlObject *fillPolygons(const FlatVectorTile &tile, float z,
+                                         const StylePtr &style,
+                                         const CancelToken &cancel);
+    VectorGlObject *fillStyle(const Tile &tile, const FlatVectorTile &vtile,
+                              float z, const StylePtr &style,
+                              const CancelToken &cancel);
+    VectorGlObject *fillMixed(const Tile &tile, const FlatVectorTile &vtile,
+                              float z, const CancelToken &cancel);
+    void fillLabels(const Tile &tile, const FlatVectorTile &vtile,
+                    const CancelToken &cancel);
+    void fillStyleClasses(const Tile &tile, const FlatVectorTile &vtile,
+                          VectorSelectableGlObject *bufferArray,
+                          const StylePtr &style, const CancelToken &cancel);
+    void drawObject(const GlTilePtr &tile, const VectorGlObject *vectorGlObject,
+                    const StylePtr &style);
 
 protected:
-    virtual VectorGlObject *fillPoints(const VectorTile &tile, float z);
-    virtual VectorGlObject *fillLines(const VectorTile &tile, float z);
-    virtual VectorGlObject *fillPolygons(const VectorTile &tile, float z);
+    std::string m_labelField;
+    LabelStylePtr m_labelStyle;
+    // Label candidates of filled tiles, guarded by m_dataMutex
+    std::map<Tile, LabelCandidates> m_labels;
+    unsigned int m_labelsVersion;
+    unsigned int m_lodMaxItems;
 };
 
 using SelectionStyles = std::map<enum ngsStyleType, StylePtr>;
@@ -148,18 +440,39 @@ public:
                                       const std::string &name = DEFAULT_LAYER_NAME);
     virtual ~GlSelectableFeatureLayer() override = default;
     virtual StylePtr selectionStyle() const;
+    StylePtr selectionStyle(enum ngsStyleType type) const;
 
     // IGlRenderLayer interface
 public:
+    virtual bool draw(const GlTilePtr &tile) override;
     virtual bool drawSelection(const GlTilePtr &tile);
 
+    // ISelectableFeatureLayer interface
+public:
+    virtual void setSelectedIds(const FeatureIDs &selectedIds) override;
+    virtual void setHideIds(const FeatureIDs &hideIds = FeatureIDs()) override;
+
 protected:
-    virtual VectorGlObject *fillPoints(const VectorTile &tile, float z) override;
-    virtual VectorGlObject *fillLines(const VectorTile &tile, float z) override;
-    virtual VectorGlObject *fillPolygons(const VectorTile &tile, float z) override;
+    virtual size_t fillHash() const override;
+    virtual VectorGlObject *fillPoints(const FlatVectorTile &tile, float z,
+                                       const StylePtr &style,
+                                       const CancelToken &cancel) override;
+    virtual VectorGlObject *fillLines(const FlatVectorTile &tile, float z,
+                                      const StylePtr &style,
+                                      const CancelToken &cancel) override;
+    virtual VectorGlObject *fillPolygons(const FlatVectorTile &tile, float z,
+                                         const StylePtr &style,
+                                         const CancelToken &cancel) override;
+
+protected:
+    bool drawItems(const GlTilePtr &tile, const StylePtr &style, bool selection);
+    void drawObjectItems(const GlTilePtr &tile,
+                         VectorSelectableGlObject *vectorGlObject,
+                         const StylePtr &style, bool selection);
 
 protected:
     SelectionStyles m_selectionStyles;
+    unsigned int m_selectionVersion;
 };
 
 /**
@@ -177,6 +490,7 @@ public:
     virtual void bind() override;
     virtual void rebind() const override;
     virtual void destroy() override;
+    virtual size_t memorySize() const override;
 
 private:
     GlBufferPtr m_extentBuffer;
@@ -193,7 +507,8 @@ public:
 
     // GlRenderLayer interface
 public:
-    virtual bool fill(const GlTilePtr &tile, float z, bool isLastTry) override;
+    virtual bool fill(const GlTilePtr &tile, float z, bool isLastTry,
+                      const CancelToken &cancel = CancelToken()) override;
     virtual bool draw(const GlTilePtr &tile) override;
     virtual bool setStyleName(const std::string &name) override;
 
@@ -206,9 +521,35 @@ public:
 public:
     virtual void setRaster(const RasterPtr &raster) override;
 
+protected:
+    virtual bool bindDatasource() override;
+
+private:
+    enum class RenderType {
+        RGBA,       // Bands to RGBA
+        PALETTE,    // One band with color table
+        COLOR_RAMP  // One band values (DEM, etc.) with color ramp
+    };
+
+private:
+    void setTileImage(const GlTilePtr &tile, GLubyte *pixData, int width,
+                      int height, bool smooth, const Envelope &extent, float z,
+                      const CancelToken &cancel);
+    void initRenderType();
+    bool readPixels(GLubyte *pixData, int overview, int xOff, int yOff,
+                    int width, int height, int *bands, double xRes,
+                    double yRes);
+
 private:
     unsigned char m_red, m_green, m_blue, m_alpha, m_transparency;
     GDALDataType m_dataType;
+    RenderType m_renderType;
+    std::vector<GLubyte> m_palette;
+    ColorRamp m_colorRamp;
+    bool m_hillshade;
+    bool m_hasNoData;
+    float m_noData;
+    std::string m_imageStyle;
 };
 
 } // namespace ngs
@@ -22,11 +22,15 @@
 
 #include "overlay.h"
 
+// std
+#include <algorithm>
+
 // gdal
 #include "ogr_core.h"
 
 #include "ds/earcut.hpp"
 #include "map/gl/view.h"
+#include "map/glm/gtc/matrix_transform.hpp"
 #include "map/mapview.h"
 
 
@@ -47,7 +51,9 @@ GlRenderOverlay::GlRenderOverlay()
 //------------------------------------------------------------------------------
 
 GlEditLayerOverlay::GlEditLayerOverlay(MapView *map) : EditLayerOverlay(map),
-    GlRenderOverlay()
+    GlRenderOverlay(),
+    m_lineClosed(false),
+    m_moveBuffer(GlBuffer::BF_LINE)
 {
     GlView *mapView = dynamic_cast<GlView*>(m_map);
     if(mapView) {
@@ -252,8 +258,22 @@ enum ngsEditDeleteResult GlEditLayerOverlay::deleteGeometryPart()
 ngsPointId GlEditLayerOverlay::touch(double x, double y, enum ngsMapTouchType type)
 {
     ngsPointId out = EditLayerOverlay::touch(x, y, type);
-    if(type == ngsMapTouchType::MTT_SINGLE) {
+    switch(type) {
+    case MTT_SINGLE:
         fill();
+        break;
+    case MTT_ON_DOWN:
+    case MTT_ON_MOVE:
+        if(out.pointId != NOT_FOUND && !moveSelectedPoint()) {
+            fill();
+        }
+        break;
+    case MTT_ON_UP:
+        if(out.pointId != NOT_FOUND &&
+                (!moveSelectedPoint() || !fillSelectedPolygon())) {
+            fill();
+        }
+        break;
     }
     return out;
 }
@@ -334,15 +354,15 @@ void GlEditLayerOverlay::fillPointElements(const std::vector<OGRRawPoint> &point
                                            int selectedPointId)
 {
     EditPointStyle *editPointStyle = ngsDynamicCast(EditPointStyle, m_pointStyle);
-    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_PT);
+    GlBuffer *buffer = new GlBuffer(m_pointStyle->bufferType());
     VectorGlObject *bufferArray = new VectorGlObject();
-    GlBuffer *selBuffer = new GlBuffer(GlBuffer::BF_PT);
+    GlBuffer *selBuffer = new GlBuffer(m_pointStyle->bufferType());
     VectorGlObject *selBufferArray = new VectorGlObject();
 
     enum ngsEditElementType elementType = (m_walkingMode) ? EET_WALK_POINT :
                                                             EET_POINT;
 
-    unsigned short index = 0;
+    GLuint index = 0;
     int pointIndex = -1;
     for(const OGRRawPoint &point : points) {
         SimplePoint pt = {static_cast<float>(point.x),
@@ -359,7 +379,7 @@ void GlEditLayerOverlay::fillPointElements(const std::vector<OGRRawPoint> &point
         if(buffer->vertexSize() >= GlBuffer::maxVertices()) {
             bufferArray->addBuffer(buffer);
             index = 0;
-            buffer = new GlBuffer(GlBuffer::BF_PT);
+            buffer = new GlBuffer(m_pointStyle->bufferType());
         }
 
         if(editPointStyle) {
@@ -378,14 +398,15 @@ void GlEditLayerOverlay::fillMiddlePointElements(
         const std::vector<OGRRawPoint> &points)
 {
     EditPointStyle *editPointStyle = ngsDynamicCast(EditPointStyle, m_pointStyle);
-    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_PT);
+    GlBuffer *buffer = new GlBuffer(m_pointStyle->bufferType());
     VectorGlObject *bufferArray = new VectorGlObject();
-    GlBuffer *selBuffer = new GlBuffer(GlBuffer::BF_PT);
+    GlBuffer *selBuffer = new GlBuffer(m_pointStyle->bufferType());
     VectorGlObject *selBufferArray = new VectorGlObject();
 
-    int index = 0;
+    GLuint index = 0;
     size_t numPoints = points.size();
-    for(size_t i = 0; i < numPoints - 1; ++i) {
+    m_middlePointChunks.clear();
+    for(size_t i = 0; i + 1 < numPoints; ++i) {
         OGRRawPoint medianPoint = ngsGetMiddlePoint(points[i], points[i + 1]);
         SimplePoint pt = {static_cast<float>(medianPoint.x),
                           static_cast<float>(medianPoint.y)};
@@ -401,15 +422,16 @@ void GlEditLayerOverlay::fillMiddlePointElements(
         if(buffer->vertexSize() >= GlBuffer::maxVertices()) {
             bufferArray->addBuffer(buffer);
             index = 0;
-            buffer = new GlBuffer(GlBuffer::BF_PT);
+            buffer = new GlBuffer(m_pointStyle->bufferType());
         }
 
         if(editPointStyle) {
             editPointStyle->setEditElementType(EET_MEDIAN_POINT);
         }
-        index = m_pointStyle->addPoint(pt, 0.0f,
-                                       static_cast<unsigned short>(index),
-                                       buffer);
+        size_t offset = buffer->vertexSize();
+        index = m_pointStyle->addPoint(pt, 0.0f, index, buffer);
+        m_middlePointChunks.push_back({buffer, offset,
+                                       buffer->vertexSize() - offset});
     }
 
     bufferArray->addBuffer(buffer);
@@ -418,7 +440,7 @@ void GlEditLayerOverlay::fillMiddlePointElements(
     m_elements[EET_SELECTED_MEDIAN_POINT] = GlObjectPtr(selBufferArray);
 }
 
-void GlEditLayerOverlay::fillLineElements(std::vector<Line> lines,
+void GlEditLayerOverlay::fillLineElements(const std::vector<Line> &lines,
                                           int selectedLine, int selectedPoint,
                                           bool addToBuffer)
 {
@@ -450,8 +472,7 @@ void GlEditLayerOverlay::fillLineElements(std::vector<Line> lines,
                                                        EET_LINE);
 
         if(isSelected) {
-
-            fillLineBuffers(line, selBufferArray);
+            fillLineBuffers(line, selBufferArray, &m_lineChunks);
 
             if(!m_walkingMode) {
                 fillMiddlePointElements(line);
@@ -473,68 +494,89 @@ void GlEditLayerOverlay::fillLineElements(std::vector<Line> lines,
 }
 
 void GlEditLayerOverlay::fillLineBuffers(const Line &line,
-                                         VectorGlObject* bufferArray)
+                                         VectorGlObject* bufferArray,
+                                         std::vector<VertexChunk> *chunks)
 {
     GlBuffer *buffer = new GlBuffer(GlBuffer::BF_LINE);
     size_t numPoints = line.size();
+    if(chunks) {
+        chunks->clear();
+    }
 
     if(numPoints > 0) {
         bool isClosedLine = ngsIsNear(line.front(), line.back(), DELTA);
-        unsigned short index = 0;
-        Normal prevNormal;
-
-        auto createBufferIfNeed = [bufferArray, &buffer, &index](size_t amount) -> void {
-            if(!buffer->canStoreVertices(amount, true)) {
+        if(chunks) {
+            m_lineClosed = isClosedLine;
+        }
+        GLuint index = 0;
+        // Segment vertices are kept in one buffer to update them in place
+        size_t segmentVertices = m_lineStyle->lineCapVerticesCount() * 2 +
+                m_lineStyle->lineJoinVerticesCount() + 12;
+        for(size_t i = 0; i < numPoints - 1; ++i) {
+            if(!buffer->canStoreVertices(segmentVertices, true)) {
                 bufferArray->addBuffer(buffer);
                 index = 0;
                 buffer = new GlBuffer(GlBuffer::BF_LINE);
             }
-        };
 
-        for(size_t i = 0; i < numPoints - 1; ++i) {
-            SimplePoint pt1 = { static_cast<float>(line[i].x),
-                                static_cast<float>(line[i].y) };
-            SimplePoint pt2 = { static_cast<float>(line[i + 1].x),
-                                static_cast<float>(line[i + 1].y) };
-            Normal normal = ngsGetNormals(pt1, pt2);
-
-            if(i == 0 || i == numPoints - 2) { // Add cap
-                if(!isClosedLine) {
-                    if(i == 0) {
-                        createBufferIfNeed(m_lineStyle->lineCapVerticesCount());
-                        index = m_lineStyle->addLineCap(
-                                pt1, normal, 0.0f, index, buffer);
-                    }
-
-                    if(i == numPoints - 2) {
-                        createBufferIfNeed(m_lineStyle->lineCapVerticesCount());
-
-                        Normal reverseNormal;
-                        reverseNormal.x = -normal.x;
-                        reverseNormal.y = -normal.y;
-                        index = m_lineStyle->addLineCap(
-                                pt2, reverseNormal, 0.0f, index, buffer);
-                    }
-                }
+            size_t offset = buffer->vertexSize();
+            index = addLineSegment(line, i, isClosedLine, index, buffer);
+            if(chunks) {
+                chunks->push_back({buffer, offset, buffer->vertexSize() - offset});
             }
+        }
+    }
 
-            if(i != 0) { // Add join
-                createBufferIfNeed(m_lineStyle->lineJoinVerticesCount());
-                index = m_lineStyle->addLineJoin(
-                        pt1, prevNormal, normal, 0.0f, index, buffer);
-            }
+    bufferArray->addBuffer(buffer);
+}
+
+/**
+ * @brief GlEditLayerOverlay::addLineSegment Add segment with its caps and join
+ * with previous segment to the buffer.
+ * @param line Line points
+ * @param segment Segment index
+ * @param isClosedLine Closed line has no caps
+ * @param index First vertex index
+ * @param buffer Buffer to add vertices
+ * @return Next vertex index
+ */
+GLuint GlEditLayerOverlay::addLineSegment(const Line &line, size_t segment,
+                                          bool isClosedLine, GLuint index,
+                                          GlBuffer *buffer)
+{
+    size_t numPoints = line.size();
+    SimplePoint pt1 = { static_cast<float>(line[segment].x),
+                        static_cast<float>(line[segment].y) };
+    SimplePoint pt2 = { static_cast<float>(line[segment + 1].x),
+                        static_cast<float>(line[segment + 1].y) };
+    Normal normal = ngsGetNormals(pt1, pt2);
+
+    if(!isClosedLine) { // Add cap
+        if(segment == 0) {
+            index = m_lineStyle->addLineCap(pt1, normal, 0.0f, index, buffer);
+        }
 
-            createBufferIfNeed(12);
-            index = m_lineStyle->addSegment(
-                    pt1, pt2, normal, 0.0f, index, buffer);
-            prevNormal = normal;
+        if(segment == numPoints - 2) {
+            Normal reverseNormal;
+            reverseNormal.x = -normal.x;
+            reverseNormal.y = -normal.y;
+            index = m_lineStyle->addLineCap(pt2, reverseNormal, 0.0f, index,
+                                            buffer);
         }
     }
 
-    bufferArray->addBuffer(buffer);
+    if(segment != 0) { // Add join
+        SimplePoint pt0 = { static_cast<float>(line[segment - 1].x),
+                            static_cast<float>(line[segment - 1].y) };
+        Normal prevNormal = ngsGetNormals(pt0, pt1);
+        index = m_lineStyle->addLineJoin(pt1, prevNormal, normal, 0.0f, index,
+                                         buffer);
+    }
+
+    return m_lineStyle->addSegment(pt1, pt2, normal, 0.0f, index, buffer);
 }
 
-void GlEditLayerOverlay::fillPolygonElements(std::vector<Polygon> polygons,
+void GlEditLayerOverlay::fillPolygonElements(const std::vector<Polygon> &polygons,
                                              int selectedPart, int selectedRing,
                                              int selectedPoint)
 {
@@ -555,7 +597,7 @@ void GlEditLayerOverlay::fillPolygonElements(std::vector<Polygon> polygons,
         }
 
         fillPolygonBuffers(polygon, bufferArray);
-        fillLineElements(polygon, selectedRing, selectedPoint, true);
+        fillLineElements(polygon, NOT_FOUND, selectedPoint, true);
     }
 
     m_elements[EET_POLYGON] = GlObjectPtr(bufferArray);
@@ -592,7 +634,7 @@ void GlEditLayerOverlay::fillPolygonBuffers(const Polygon &polygon,
 
 	// Fill triangles.
     GlBuffer *fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
-    unsigned short index = 0;
+    GLuint index = 0;
     for(N mbIndex : mbIndices) {
         if(!fillBuffer->canStoreVertices(mbIndices.size() * 3)) {
             bufferArray->addBuffer(fillBuffer);
@@ -618,11 +660,51 @@ void GlEditLayerOverlay::fillPolygonBuffers(const Polygon &polygon,
     bufferArray->addBuffer(fillBuffer);
 }
 
+/**
+ * @brief GlEditLayerOverlay::fillSelectedPolygon Triangulate the selected
+ * polygon part again. Other parts are not changed by vertex drag.
+ * @return False if buffers must be refilled
+ */
+bool GlEditLayerOverlay::fillSelectedPolygon()
+{
+    const Polygon *polygon = nullptr;
+    switch(m_editGeometry->type()) {
+    case EditGeometry::Type::POLYGON: {
+        EditPolygon *eg = ngsDynamicCast(EditPolygon, m_editGeometry);
+        if(eg) {
+            polygon = &eg->data();
+        }
+        break;
+    }
+    case EditGeometry::Type::MULTIPOLYGON: {
+        EditMultiPolygon *eg = ngsDynamicCast(EditMultiPolygon, m_editGeometry);
+        if(eg && eg->selectedPart() != NOT_FOUND &&
+                static_cast<size_t>(eg->selectedPart()) < eg->data().size()) {
+            polygon = &eg->data()[static_cast<size_t>(eg->selectedPart())];
+        }
+        break;
+    }
+    default:
+        return true;
+    }
+
+    if(nullptr == polygon) {
+        return false;
+    }
+
+    freeGlBuffer(m_elements[EET_SELECTED_POLYGON]);
+    VectorGlObject *selBufferArray = new VectorGlObject();
+    m_fillStyle->setEditElementType(EET_SELECTED_POLYGON);
+    fillPolygonBuffers(*polygon, selBufferArray);
+    m_elements[EET_SELECTED_POLYGON] = GlObjectPtr(selBufferArray);
+    return true;
+}
+
 void GlEditLayerOverlay::fillCrossElement()
 {
     freeGlBuffer(m_elements[EET_CROSS]);
 
-    GlBuffer *buffer = new GlBuffer(GlBuffer::BF_PT);
+    GlBuffer *buffer = new GlBuffer(m_crossStyle->bufferType());
     VectorGlObject *bufferArray = new VectorGlObject();
 
     OGRRawPoint pt = m_map->getCenter();
@@ -635,6 +717,164 @@ void GlEditLayerOverlay::fillCrossElement()
     m_elements[EET_CROSS] = GlObjectPtr(bufferArray);
 }
 
+/**
+ * @brief GlEditLayerOverlay::selectedLine Selected line or ring of edit
+ * geometry.
+ * @return Line points or nullptr for points
+ */
+const Line *GlEditLayerOverlay::selectedLine() const
+{
+    switch(m_editGeometry->type()) {
+    case EditGeometry::Type::LINE: {
+        EditLine *eg = ngsDynamicCast(EditLine, m_editGeometry);
+        return eg ? &eg->data() : nullptr;
+    }
+    case EditGeometry::Type::MULTILINE: {
+        EditMultiLine *eg = ngsDynamicCast(EditMultiLine, m_editGeometry);
+        if(eg && eg->selectedPart() != NOT_FOUND &&
+                static_cast<size_t>(eg->selectedPart()) < eg->data().size()) {
+            return &eg->data()[static_cast<size_t>(eg->selectedPart())];
+        }
+        return nullptr;
+    }
+    case EditGeometry::Type::POLYGON: {
+        EditPolygon *eg = ngsDynamicCast(EditPolygon, m_editGeometry);
+        if(eg && eg->selectedRing() != NOT_FOUND &&
+                static_cast<size_t>(eg->selectedRing()) < eg->data().size()) {
+            return &eg->data()[static_cast<size_t>(eg->selectedRing())];
+        }
+        return nullptr;
+    }
+    case EditGeometry::Type::MULTIPOLYGON: {
+        EditMultiPolygon *eg = ngsDynamicCast(EditMultiPolygon, m_editGeometry);
+        if(nullptr == eg || eg->selectedPart() == NOT_FOUND ||
+                eg->selectedRing() == NOT_FOUND ||
+                static_cast<size_t>(eg->selectedPart()) >= eg->data().size()) {
+            return nullptr;
+        }
+        const Polygon &polygon = eg->data()[static_cast<size_t>(eg->selectedPart())];
+        if(static_cast<size_t>(eg->selectedRing()) >= polygon.size()) {
+            return nullptr;
+        }
+        return &polygon[static_cast<size_t>(eg->selectedRing())];
+    }
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * @brief GlEditLayerOverlay::moveSelectedPoint Update vertices of the dragged
+ * point in place: the selected point, neighbour segments of the selected line
+ * and its middle points. Changed vertices are uploaded on draw.
+ * @return False if buffers must be refilled
+ */
+bool GlEditLayerOverlay::moveSelectedPoint()
+{
+    int pointId = m_editGeometry->selectedPoint();
+    if(pointId == NOT_FOUND) {
+        return false;
+    }
+    size_t point = static_cast<size_t>(pointId);
+
+    OGRRawPoint movedPoint;
+    const Line *line = selectedLine();
+    if(line) {
+        if(point >= line->size()) {
+            return false;
+        }
+        movedPoint = (*line)[point];
+    }
+    else if(m_editGeometry->type() == EditGeometry::Type::POINT) {
+        EditPoint *eg = ngsDynamicCast(EditPoint, m_editGeometry);
+        if(nullptr == eg) {
+            return false;
+        }
+        movedPoint = eg->data();
+    }
+    else if(m_editGeometry->type() == EditGeometry::Type::MULTIPOINT) {
+        EditMultiPoint *eg = ngsDynamicCast(EditMultiPoint, m_editGeometry);
+        if(nullptr == eg || point >= eg->data().size()) {
+            return false;
+        }
+        movedPoint = eg->data()[point];
+    }
+    else {
+        return false;
+    }
+
+    auto selectedIt = m_elements.find(EET_SELECTED_POINT);
+    if(selectedIt == m_elements.end()) {
+        return false;
+    }
+    VectorGlObject *selBufferArray = ngsDynamicCast(VectorGlObject,
+                                                    selectedIt->second);
+    if(nullptr == selBufferArray || selBufferArray->buffers().empty()) {
+        return false;
+    }
+
+    EditPointStyle *editPointStyle = ngsDynamicCast(EditPointStyle, m_pointStyle);
+    if(editPointStyle) {
+        editPointStyle->setEditElementType(EET_SELECTED_POINT);
+    }
+    SimplePoint pt = { static_cast<float>(movedPoint.x),
+                       static_cast<float>(movedPoint.y) };
+    m_moveBuffer.clear();
+    m_pointStyle->addPoint(pt, 0.0f, 0, &m_moveBuffer);
+    if(!selBufferArray->buffers().front()->setVertices(0, m_moveBuffer)) {
+        return false;
+    }
+
+    if(nullptr == line) {
+        return true;
+    }
+
+    // Segments from previous point to next point. Caps appear if line is no
+    // more closed, so vertices count changes.
+    if(m_lineChunks.size() + 1 != line->size() ||
+            ngsIsNear(line->front(), line->back(), DELTA) != m_lineClosed) {
+        return false;
+    }
+    m_lineStyle->setEditElementType(EET_SELECTED_LINE);
+    size_t begin = point > 0 ? point - 1 : 0;
+    size_t end = std::min(point + 2, m_lineChunks.size());
+    for(size_t i = begin; i < end; ++i) {
+        const VertexChunk &chunk = m_lineChunks[i];
+        m_moveBuffer.clear();
+        addLineSegment(*line, i, m_lineClosed, 0, &m_moveBuffer);
+        if(m_moveBuffer.vertexSize() != chunk.count ||
+                !chunk.buffer->setVertices(chunk.offset, m_moveBuffer)) {
+            return false;
+        }
+    }
+
+    if(m_walkingMode) {
+        return true;
+    }
+
+    // Middle points of the segments
+    if(m_middlePointChunks.size() + 1 != line->size()) {
+        return false;
+    }
+    if(editPointStyle) {
+        editPointStyle->setEditElementType(EET_MEDIAN_POINT);
+    }
+    end = std::min(point + 1, m_middlePointChunks.size());
+    for(size_t i = begin; i < end; ++i) {
+        const VertexChunk &chunk = m_middlePointChunks[i];
+        OGRRawPoint middlePoint = ngsGetMiddlePoint((*line)[i], (*line)[i + 1]);
+        pt = { static_cast<float>(middlePoint.x),
+               static_cast<float>(middlePoint.y) };
+        m_moveBuffer.clear();
+        m_pointStyle->addPoint(pt, 0.0f, 0, &m_moveBuffer);
+        if(m_moveBuffer.vertexSize() != chunk.count ||
+                !chunk.buffer->setVertices(chunk.offset, m_moveBuffer)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void GlEditLayerOverlay::freeGlStyle(StylePtr style)
 {
     if(style) {
@@ -661,6 +901,8 @@ void GlEditLayerOverlay::freeGlBuffers()
         freeGlBuffer(it->second);
     }
     m_elements.clear();
+    m_lineChunks.clear();
+    m_middlePointChunks.clear();
 }
 
 bool GlEditLayerOverlay::draw()
@@ -719,6 +961,8 @@ bool GlEditLayerOverlay::draw()
         VectorGlObject *vectorGlBuffer = ngsDynamicCast(VectorGlObject, glBuffer);
         for(const GlBufferPtr& buff : vectorGlBuffer->buffers()) {
             if(buff->bound()) {
+                // Dragged vertex updates
+                buff->uploadChanged();
                 buff->rebind();
             }
             else {
@@ -744,6 +988,7 @@ GlLocationOverlay::GlLocationOverlay(MapView *map) : LocationOverlay(map),
 {
     m_style->setType(PT_DIAMOND);
     m_style->setColor({255,0,0,255});
+    m_markerDirection = 0.0f;
 }
 
 bool GlLocationOverlay::setStyleName(const std::string &name)
@@ -761,6 +1006,10 @@ bool GlLocationOverlay::setStyleName(const std::string &name)
         }
 
         mapView->freeResource(m_style);
+        if(m_marker) {
+            mapView->freeResource(m_marker);
+            m_marker.reset();
+        }
         m_style = PointStylePtr(style);
     }
     return true;
@@ -768,6 +1017,11 @@ bool GlLocationOverlay::setStyleName(const std::string &name)
 
 bool GlLocationOverlay::setStyle(const CPLJSONObject &style)
 {
+    GlView *mapView = dynamic_cast<GlView*>(m_map);
+    if(mapView && m_marker) {
+        mapView->freeResource(m_marker);
+        m_marker.reset();
+    }
     return m_style->load(style);
 }
 
@@ -777,20 +1031,33 @@ bool GlLocationOverlay::draw()
         return true;
     }
 
-    GlBuffer buffer(GlBuffer::BF_FILL);
-    m_style->setRotation(m_direction);
-    m_style->addPoint(m_location, 0.0f, 0, &buffer);
-    LocationStyle *lStyle = ngsDynamicCast(LocationStyle, m_style);
-    if(nullptr != lStyle) {
-        lStyle->setStatus(isEqual(m_direction, -1.0f) ? LocationStyle::LS_STAY :
-                                                        LocationStyle::LS_MOVE);
+    // Marker vertices depend on direction and status only, location change
+    // moves the marker by the matrix
+    if(!m_marker || !isEqual(m_markerDirection, m_direction)) {
+        if(m_marker) {
+            m_marker->destroy();
+        }
+        LocationStyle *lStyle = ngsDynamicCast(LocationStyle, m_style);
+        if(nullptr != lStyle) {
+            lStyle->setStatus(isEqual(m_direction, -1.0f) ?
+                                  LocationStyle::LS_STAY :
+                                  LocationStyle::LS_MOVE);
+        }
+        m_style->setRotation(m_direction);
+        m_marker = GlBufferPtr(new GlBuffer(GlBuffer::BF_FILL));
+        m_style->addPoint({0.0f, 0.0f}, 0.0f, 0, m_marker.get());
+        m_marker->bind();
+        m_markerDirection = m_direction;
+    }
+    else {
+        m_marker->rebind();
     }
 
-    buffer.bind();
-    m_style->prepare(m_map->getSceneMatrix(), m_map->getInvViewMatrix(),
-                     buffer.type());
-    m_style->draw(buffer);
-    buffer.destroy();
+    glm::mat4 msMatrix = glm::translate(m_map->getSceneMatrix(),
+                                        glm::vec3(m_location.x, m_location.y,
+                                                  0.0f));
+    m_style->prepare(msMatrix, m_map->getInvViewMatrix(), m_marker->type());
+    m_style->draw(*m_marker);
 
     return true;
 }
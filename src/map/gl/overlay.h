@@ -83,16 +83,33 @@ protected:
     void freeGlBuffers();
 
 private:
+    /**
+     * @brief The VertexChunk struct Vertices of one segment or middle point of
+     * the selected line in the buffer. Dragged vertex updates them in place.
+     */
+    typedef struct _vertexChunk {
+        GlBuffer *buffer;
+        size_t offset;
+        size_t count;
+    } VertexChunk;
+
     void fillPointElements(const std::vector<OGRRawPoint> &points, int selectedPointId);
     void fillMiddlePointElements(const std::vector<OGRRawPoint> &points);
-    void fillLineElements(std::vector<Line> lines, int selectedLine,
+    void fillLineElements(const std::vector<Line> &lines, int selectedLine,
                           int selectedPoint,
                           bool addToBuffer = false);
-    void fillLineBuffers(const Line &lineline, VectorGlObject* bufferArray);
-    void fillPolygonElements(std::vector<Polygon> polygons, int selectedPart,
-                             int selectedRing, int selectedPoint);
+    void fillLineBuffers(const Line &line, VectorGlObject* bufferArray,
+                         std::vector<VertexChunk> *chunks = nullptr);
+    GLuint addLineSegment(const Line &line, size_t segment, bool isClosedLine,
+                          GLuint index, GlBuffer *buffer);
+    void fillPolygonElements(const std::vector<Polygon> &polygons,
+                             int selectedPart, int selectedRing,
+                             int selectedPoint);
     void fillPolygonBuffers(const Polygon &polygon, VectorGlObject *bufferArray);
+    bool fillSelectedPolygon();
     void fillCrossElement();
+    bool moveSelectedPoint();
+    const Line *selectedLine() const;
 
 private:
     std::map<ngsEditElementType, GlObjectPtr> m_elements;
@@ -100,6 +117,9 @@ private:
     EditLineStylePtr m_lineStyle;
     EditFillStylePtr m_fillStyle;
     PointStylePtr m_crossStyle;
+    std::vector<VertexChunk> m_lineChunks, m_middlePointChunks;
+    bool m_lineClosed;
+    GlBuffer m_moveBuffer;
 };
 
 class GlLocationOverlay : public LocationOverlay, public GlRenderOverlay
@@ -120,6 +140,9 @@ public:
 private:
     PointStylePtr m_style;
     unsigned short m_stayIndex, m_moveIndex;
+    // Marker at origin, moved to location by the scene matrix
+    GlBufferPtr m_marker;
+    float m_markerDirection;
 };
 
 } // namespace ngs
@@ -20,17 +20,72 @@
  ****************************************************************************/
 #include "program.h"
 
+// std
+#include <cstring>
+
 #include "cpl_string.h"
+#include "cpl_vsi.h"
 
 #include "api_priv.h"
+#include "catalog/file.h"
+#include "catalog/folder.h"
 #include "map/glm/gtc/type_ptr.hpp"
 #include "util/error.h"
+#include "util/hash.h"
+#include "util/settings.h"
+#include "util/stringutil.h"
 
 namespace ngs {
 
+// NOTE: Keep in order of GlProgram::Uniform and GlProgram::Attribute
+constexpr const char *uniformNames[GlProgram::U_COUNT] = {
+    "u_msMatrix", "u_vsMatrix", "u_color", "u_type", "u_vSize",
+    "u_vLineWidth", "s_texture", "s_ramp", "u_intensity",
+    "u_opacity"
+};
+constexpr const char *attributeNames[GlProgram::A_COUNT] = {
+    "a_mPosition", "a_normal", "a_texCoord"
+};
+
+constexpr GUInt32 PROGRAM_BINARY_MAGIC = 0x4250474E; // NGPB
+constexpr const char *PROGRAM_BINARY_DIR = "shaders";
+constexpr const char *PROGRAM_BINARY_EXT = "bin";
+
+/**
+ * @brief The ProgramBinaryHeader struct Goes before the driver program binary
+ * in the cache file.
+ */
+typedef struct _programBinaryHeader {
+    GUInt32 magic;
+    GUInt32 format;
+} ProgramBinaryHeader;
+
+static bool isProgramBinarySupported()
+{
+#ifdef GL_OES_get_program_binary
+    static int supported = -1;
+    if(supported < 0) {
+        const char *extensions =
+                reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        GLint formats = 0;
+        if(nullptr != extensions &&
+                strstr(extensions, "GL_OES_get_program_binary") != nullptr) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+        }
+        supported = formats > 0 ? 1 : 0;
+    }
+    return supported == 1;
+#else
+    return false;
+#endif // GL_OES_get_program_binary
+}
+
 GlProgram::GlProgram() : m_id(0),
     m_loaded(false)
 {
+    m_uniforms.fill(-1);
+    m_attributes.fill(-1);
+    m_valueSet.fill(false);
 }
 
 GlProgram::~GlProgram()
@@ -41,11 +96,17 @@ GlProgram::~GlProgram()
 void GlProgram::destroy()
 {
     if(m_loaded) {
+        GlState::forgetProgram(m_id);
         glDeleteProgram(m_id);
         m_loaded = false;
     }
 }
 
+void GlProgram::use() const
+{
+    GlState::useProgram(m_id);
+}
+
 bool GlProgram::load(const GLchar * const vertexShader,
                      const GLchar * const fragmentShader)
 {
@@ -82,6 +143,12 @@ bool GlProgram::load(const GLchar * const vertexShader,
     glAttachShader(programId, vertexShaderId);
     glAttachShader(programId, fragmentShaderId);
 
+    // Same attribute locations in all programs, so the vertex attributes
+    // recorded for a buffer fit each style drawing it
+    for(GLuint i = 0; i < A_COUNT; ++i) {
+        glBindAttribLocation(programId, i, attributeNames[i]);
+    }
+
     glLinkProgram(programId);
 
     if(!checkLinkStatus(programId)) {
@@ -99,55 +166,177 @@ bool GlProgram::load(const GLchar * const vertexShader,
 
     m_id = programId;
     m_loaded = true;
+    resolveLocations();
 
     return true;
 }
 
-void GlProgram::setMatrix(const std::string &varName, const glm::mat4 &mat4f)
+/**
+ * @brief GlProgram::loadBinary Load program linked before and saved by
+ * saveBinary(). Fails without error message if file is absent or the binary
+ * is rejected by driver (i.e. after driver update).
+ * @param path Program binary file path.
+ * @return True on success.
+ */
+bool GlProgram::loadBinary(const std::string &path)
 {
-    if(m_loaded) {
-        ngsCheckGLError(glUniformMatrix4fv(getVariableId(varName),
-                                           1, GL_FALSE, glm::value_ptr(mat4f)));
+#ifdef GL_OES_get_program_binary
+    if(m_loaded || path.empty() || !isProgramBinarySupported()) {
+        return m_loaded;
+    }
+
+    VSIStatBufL sbuf;
+    if(VSIStatL(path.c_str(), &sbuf) != 0 ||
+            sbuf.st_size <= static_cast<vsi_l_offset>(
+                sizeof(ProgramBinaryHeader))) {
+        return false;
+    }
+    std::string data = File::readFile(path);
+    if(data.size() <= sizeof(ProgramBinaryHeader)) {
+        return false;
     }
+    ProgramBinaryHeader header;
+    std::memcpy(&header, data.data(), sizeof(ProgramBinaryHeader));
+    if(header.magic != PROGRAM_BINARY_MAGIC) {
+        return false;
+    }
+
+    GLuint programId = glCreateProgram();
+    if(!programId) {
+        return false;
+    }
+    glProgramBinaryOES(programId, header.format,
+                       data.data() + sizeof(ProgramBinaryHeader),
+                       static_cast<GLint>(data.size() -
+                                          sizeof(ProgramBinaryHeader)));
+    GLint status = GL_FALSE;
+    glGetProgramiv(programId, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE) {
+        glDeleteProgram(programId);
+        return false;
+    }
+
+    m_id = programId;
+    m_loaded = true;
+    resolveLocations();
+    return true;
+#else
+    ngsUnused(path);
+    return false;
+#endif // GL_OES_get_program_binary
 }
 
-void GlProgram::setColor(const std::string &varName, const GlColor &color)
+/**
+ * @brief GlProgram::saveBinary Save linked program binary to file.
+ * @param path Program binary file path.
+ * @return True on success.
+ */
+bool GlProgram::saveBinary(const std::string &path) const
 {
-    if(m_loaded) {
-        ngsCheckGLError(glUniform4f(getVariableId(varName),
-                                    color.r, color.g, color.b, color.a));
+#ifdef GL_OES_get_program_binary
+    if(!m_loaded || path.empty() || !isProgramBinarySupported()) {
+        return false;
     }
+
+    GLint length = 0;
+    glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if(length <= 0) {
+        return false;
+    }
+
+    std::string data(sizeof(ProgramBinaryHeader) +
+                     static_cast<size_t>(length), '\0');
+    ProgramBinaryHeader header = { PROGRAM_BINARY_MAGIC, 0 };
+    GLenum format = 0;
+    glGetProgramBinaryOES(m_id, length, &length, &format,
+                          &data[sizeof(ProgramBinaryHeader)]);
+    if(glGetError() != GL_NO_ERROR || length <= 0) {
+        return false;
+    }
+    header.format = format;
+    std::memcpy(&data[0], &header, sizeof(ProgramBinaryHeader));
+    return File::writeFile(path, data.data(), sizeof(ProgramBinaryHeader) +
+                           static_cast<size_t>(length));
+#else
+    ngsUnused(path);
+    return false;
+#endif // GL_OES_get_program_binary
 }
 
-void GlProgram::setInt(const std::string &varName, GLint value)
+/**
+ * @brief GlProgram::resolveLocations Get all uniform and attribute locations
+ * once, so style prepare and draw do not query them for each buffer. Absent
+ * in shader variables get -1 and are skipped by setters.
+ */
+void GlProgram::resolveLocations()
 {
-    if(m_loaded) {
-        ngsCheckGLError(glUniform1i(getVariableId(varName), value));
+    for(int i = 0; i < U_COUNT; ++i) {
+        m_uniforms[i] = glGetUniformLocation(m_id, uniformNames[i]);
     }
+    for(int i = 0; i < A_COUNT; ++i) {
+        m_attributes[i] = glGetAttribLocation(m_id, attributeNames[i]);
+    }
+    m_valueSet.fill(false);
 }
 
-void GlProgram::setInt(const std::string &varName, GLint value) const
+bool GlProgram::valueChanged(enum Uniform uniform, const GLfloat *value,
+                             size_t size) const
 {
-    if(m_loaded) {
-        ngsCheckGLError(glUniform1i(getVariableId(varName), value));
+    auto &stored = m_values[uniform];
+    if(m_valueSet[uniform] &&
+            memcmp(stored.data(), value, size * sizeof(GLfloat)) == 0) {
+        return false;
     }
+    memcpy(stored.data(), value, size * sizeof(GLfloat));
+    m_valueSet[uniform] = true;
+    glStats().stateChanges++;
+    return true;
 }
 
-void GlProgram::setFloat(const std::string &varName, GLfloat value)
+void GlProgram::setMatrix(enum Uniform uniform, const glm::mat4 &mat4f) const
 {
-    if(m_loaded) {
-        ngsCheckGLError(glUniform1f(getVariableId(varName), value));
+    if(m_loaded && m_uniforms[uniform] >= 0 &&
+            valueChanged(uniform, glm::value_ptr(mat4f), 16)) {
+        ngsCheckGLError(glUniformMatrix4fv(m_uniforms[uniform],
+                                           1, GL_FALSE, glm::value_ptr(mat4f)));
     }
 }
 
-void GlProgram::setVertexAttribPointer(const std::string &varName, GLint size,
-                                       GLsizei stride, const GLvoid *pointer)
+void GlProgram::setColor(enum Uniform uniform, const GlColor &color) const
 {
-    if(m_loaded) {
-        GLuint index = static_cast<GLuint>(getAttributeId(varName));
-        ngsCheckGLError(glEnableVertexAttribArray(index));
-        ngsCheckGLError(glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE,
-                                              stride, pointer));
+    const GLfloat value[4] = { color.r, color.g, color.b, color.a };
+    if(m_loaded && m_uniforms[uniform] >= 0 &&
+            valueChanged(uniform, value, 4)) {
+        ngsCheckGLError(glUniform4f(m_uniforms[uniform],
+                                    color.r, color.g, color.b, color.a));
+    }
+}
+
+void GlProgram::setInt(enum Uniform uniform, GLint value) const
+{
+    const GLfloat storeValue = static_cast<GLfloat>(value);
+    if(m_loaded && m_uniforms[uniform] >= 0 &&
+            valueChanged(uniform, &storeValue, 1)) {
+        ngsCheckGLError(glUniform1i(m_uniforms[uniform], value));
+    }
+}
+
+void GlProgram::setFloat(enum Uniform uniform, GLfloat value) const
+{
+    if(m_loaded && m_uniforms[uniform] >= 0 &&
+            valueChanged(uniform, &value, 1)) {
+        ngsCheckGLError(glUniform1f(m_uniforms[uniform], value));
+    }
+}
+
+void GlProgram::setVertexAttribPointer(enum Attribute attribute, GLint size,
+                                       GLsizei stride,
+                                       const GLvoid *pointer) const
+{
+    if(m_loaded && m_attributes[attribute] >= 0) {
+        GlState::vertexAttribPointer(
+                    static_cast<GLuint>(m_attributes[attribute]), size, stride,
+                    pointer);
     }
 }
 
@@ -202,51 +391,82 @@ GLuint GlProgram::loadShader(GLenum type, const std::string &shaderSrc)
     return shader;
 }
 
-GLint GlProgram::getVariableId(const std::string &varName)
+//------------------------------------------------------------------------------
+// GlProgramCache
+//------------------------------------------------------------------------------
+
+GlProgramCache &GlProgramCache::instance()
 {
-    auto it = m_variables.find(varName);
-    GLint variableId;
-    if(it != m_variables.end()) {
-        variableId = it->second;
+    static GlProgramCache cache;
+    return cache;
+}
+
+/**
+ * @brief GlProgramCache::program Get linked program for the shaders. The
+ * program is loaded from the binary file or compiled on first request.
+ * @param vertexShader Vertex shader source.
+ * @param fragmentShader Fragment shader source.
+ * @return Program or empty pointer if shaders failed to compile.
+ */
+GlProgramPtr GlProgramCache::program(const GLchar * const vertexShader,
+                                     const GLchar * const fragmentShader)
+{
+    Hash64 hash;
+    hash.update(vertexShader);
+    hash.update(fragmentShader);
+    GUInt64 key = hash.digest();
+    auto it = m_programs.find(key);
+    if(it != m_programs.end()) {
+        return it->second;
     }
-    else {
-        variableId = glGetUniformLocation(m_id, varName.c_str());
-        if(variableId > 0) {
-            m_variables[varName] = variableId;
+
+    GlProgramPtr out(new GlProgram);
+    std::string path = binaryPath(key);
+    if(!out->loadBinary(path)) {
+        if(!out->load(vertexShader, fragmentShader)) {
+            return GlProgramPtr();
         }
+        out->saveBinary(path);
     }
-    return variableId;
+    m_programs[key] = out;
+    return out;
 }
 
-
-GLint GlProgram::getVariableId(const std::string &varName) const
+/**
+ * @brief GlProgramCache::clear Forget cached programs. Programs are deleted
+ * when the last style using them is destroyed. Call on GL context close.
+ */
+void GlProgramCache::clear()
 {
-    auto it = m_variables.find(varName);
-    GLint variableId;
-    if(it != m_variables.end()) {
-        variableId = it->second;
-    }
-    else {
-        variableId = 0;
-    }
-    return variableId;
+    m_programs.clear();
 }
 
-GLint GlProgram::getAttributeId(const std::string &varName)
+/**
+ * @brief GlProgramCache::binaryPath Program binary file path. The binary is
+ * driver specific, so GL renderer and version are part of the file name.
+ * @param key Shader sources hash.
+ * @return Path or empty string if cache directory is not set or binaries are
+ * not supported.
+ */
+std::string GlProgramCache::binaryPath(GUInt64 key) const
 {
-    auto it = m_variables.find(varName);
-    GLint variableId;
-    if(it != m_variables.end()) {
-        variableId = it->second;
+    if(!isProgramBinarySupported()) {
+        return "";
     }
-    else {
-        variableId = glGetAttribLocation(m_id, varName.c_str());
-        if(variableId >= 0) {
-            m_variables[varName] = variableId;
-        }
+    std::string cachePath =
+            Settings::instance().getString("common/cache_path", "");
+    if(cachePath.empty()) {
+        return "";
     }
-    return variableId;
 
+    Hash64 hash(key);
+    hash.update(fromCString(
+                    reinterpret_cast<const char*>(glGetString(GL_RENDERER))));
+    hash.update(fromCString(
+                    reinterpret_cast<const char*>(glGetString(GL_VERSION))));
+    std::string dirPath = File::formFileName(cachePath, PROGRAM_BINARY_DIR);
+    Folder::mkDir(dirPath, true);
+    return File::formFileName(dirPath, hash.hexDigest(), PROGRAM_BINARY_EXT);
 }
 
 } // namespace ngs
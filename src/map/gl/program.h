@@ -23,8 +23,11 @@
 
 #include "functions.h"
 
+// std
 #include <array>
-#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "map/glm/mat4x4.hpp"
 
@@ -32,34 +35,98 @@ namespace ngs {
 
 class GlProgram
 {
+public:
+    /**
+     * Uniform variables used in style shaders. Locations are resolved at
+     * program load.
+     */
+    enum Uniform {
+        U_MS_MATRIX,
+        U_VS_MATRIX,
+        U_COLOR,
+        U_TYPE,
+        U_SIZE,
+        U_LINE_WIDTH,
+        U_TEXTURE,
+        U_RAMP,
+        U_INTENSITY,
+        U_OPACITY,
+        U_COUNT
+    };
+
+    /**
+     * Vertex attributes used in style shaders.
+     */
+    enum Attribute {
+        A_POSITION,
+        A_NORMAL,
+        A_TEX_COORD,
+        A_COUNT
+    };
+
 public:
     GlProgram();
     ~GlProgram();
     bool load(const GLchar * const vertexShader,
               const GLchar * const fragmentShader);
+    bool loadBinary(const std::string &path);
+    bool saveBinary(const std::string &path) const;
 
     bool loaded() const { return m_loaded; }
-    void use() const { ngsCheckGLError(glUseProgram(m_id)); }
-    void setMatrix(const std::string &varName, const glm::mat4 &mat4f);
-    void setColor(const std::string &varName, const GlColor &color);
-    void setInt(const std::string &varName, GLint value);
-    void setInt(const std::string &varName, GLint value) const;
-    void setFloat(const std::string &varName, GLfloat value);
-    void setVertexAttribPointer(const std::string &varName, GLint size,
-                                GLsizei stride, const GLvoid *pointer);
+    void use() const;
+    GLint location(enum Uniform uniform) const { return m_uniforms[uniform]; }
+    GLint location(enum Attribute attribute) const {
+        return m_attributes[attribute];
+    }
+    void setMatrix(enum Uniform uniform, const glm::mat4 &mat4f) const;
+    void setColor(enum Uniform uniform, const GlColor &color) const;
+    void setInt(enum Uniform uniform, GLint value) const;
+    void setFloat(enum Uniform uniform, GLfloat value) const;
+    void setVertexAttribPointer(enum Attribute attribute, GLint size,
+                                GLsizei stride, const GLvoid *pointer) const;
     void destroy();
 
 protected:
     bool checkLinkStatus(GLuint obj) const;
     bool checkShaderCompileStatus(GLuint obj) const;
     GLuint loadShader(GLenum type, const std::string &shaderSrc);
-    GLint getVariableId(const std::string &varName);
-    GLint getVariableId(const std::string &varName) const;
-    GLint getAttributeId(const std::string &varName);
+    void resolveLocations();
+    bool valueChanged(enum Uniform uniform, const GLfloat *value,
+                      size_t size) const;
 protected:
     GLuint m_id;
     bool m_loaded;
-    std::map<std::string, GLint> m_variables;
+    std::array<GLint, U_COUNT> m_uniforms;
+    std::array<GLint, A_COUNT> m_attributes;
+    // Last uploaded uniform values to skip equal uploads between draw calls
+    mutable std::array<std::array<GLfloat, 16>, U_COUNT> m_values;
+    mutable std::array<bool, U_COUNT> m_valueSet;
+};
+
+using GlProgramPtr = std::shared_ptr<GlProgram>;
+
+/**
+ * @brief The GlProgramCache class Linked programs shared by styles of all map
+ * views, keyed by shader sources hash. Styles with the same shaders use one
+ * program, so shaders are compiled once per process. If the cache directory
+ * is set and driver supports program binaries, linked programs are stored
+ * there and loaded on next start without compilation. Used only in GL context
+ * thread.
+ */
+class GlProgramCache
+{
+public:
+    static GlProgramCache &instance();
+    GlProgramPtr program(const GLchar * const vertexShader,
+                         const GLchar * const fragmentShader);
+    void clear();
+
+private:
+    GlProgramCache() = default;
+    std::string binaryPath(GUInt64 key) const;
+
+private:
+    std::unordered_map<GUInt64, GlProgramPtr> m_programs;
 };
 
 } // namespace ngs
@@ -22,6 +22,7 @@
 
 #include "style.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <math.h>
@@ -86,18 +87,19 @@ bool Style::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
                     enum GlBuffer::BufferType type)
 {
     ngsUnused(type);
-    if (!m_program.loaded()) {
-        bool result = m_program.load(shaderSource(Style::SH_VERTEX),
-                                     shaderSource(Style::SH_FRAGMENT));
-        if(!result) {
+    if(!m_program) {
+        m_program = GlProgramCache::instance().program(
+                    shaderSource(Style::SH_VERTEX),
+                    shaderSource(Style::SH_FRAGMENT));
+        if(!m_program) {
             return false;
         }
     }
 
-    m_program.use();
+    m_program->use();
 
-    m_program.setMatrix("u_msMatrix", msMatrix);
-    m_program.setMatrix("u_vsMatrix", vsMatrix);
+    m_program->setMatrix(GlProgram::U_MS_MATRIX, msMatrix);
+    m_program->setMatrix(GlProgram::U_VS_MATRIX, vsMatrix);
 
     return true;
 }
@@ -108,6 +110,7 @@ void Style::draw(const GlBuffer &buffer) const
         return;
 
     buffer.rebind();
+    glStats().drawCalls++;
 }
 
 Style *Style::createStyle(const std::string &name, const TextureAtlas &atlas)
@@ -123,10 +126,16 @@ Style *Style::createStyle(const std::string &name, const TextureAtlas &atlas)
         return new SimpleFillStyle;
     else if(compare(name, "simpleFillBordered"))
         return new SimpleFillBorderedStyle;
+    else if(compare(name, "mixed"))
+        return new MixedStyle(atlas);
     else if(compare(name, "primitivePoint"))
         return new PrimitivePointStyle;
     else if(compare(name, "marker"))
         return new MarkerStyle(atlas);
+    else if(compare(name, "heatmap"))
+        return new HeatmapStyle;
+    else if(compare(name, "label"))
+        return new LabelStyle(atlas);
     else if(compare(name, "simpleLocation"))
         return new SimpleLocationStyle;
     else if(compare(name, "markerLocation"))
@@ -151,8 +160,33 @@ Style *Style::createStyle(const std::string &name, const TextureAtlas &atlas)
 constexpr GlColor defaultGlColor = { 0.0, 1.0, 0.0, 1.0 };
 constexpr ngsRGBA defaultRGBAColor = { 0, 255, 0, 255 };
 
+/**
+ * @brief loadExpression Compile style property if it is an expression.
+ * @param store Style JSON.
+ * @param name Property name.
+ * @param out Compiled expression or empty pointer if property is plain value.
+ * @return False if expression is invalid.
+ */
+static bool loadExpression(const CPLJSONObject &store, const std::string &name,
+                           StyleExpressionPtr &out)
+{
+    out.reset();
+    CPLJSONObject property = store.GetObj(name);
+    if(!StyleExpression::isExpression(property)) {
+        return true;
+    }
+    StyleExpressionPtr expression(new StyleExpression);
+    if(!expression->compile(property)) {
+        return false;
+    }
+    out = expression;
+    return true;
+}
+
 SimpleVectorStyle::SimpleVectorStyle() : Style(),
-    m_color(defaultGlColor)
+    m_color(defaultGlColor),
+    m_classColor(defaultGlColor),
+    m_classApplied(false)
 {
 
 }
@@ -162,13 +196,22 @@ bool SimpleVectorStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMa
 {
     if(!Style::prepare(msMatrix, vsMatrix, type))
         return false;
-    m_program.setColor("u_color", m_color);
+    m_program->setColor(GlProgram::U_COLOR, drawColor());
 
     return true;
 }
 
 bool SimpleVectorStyle::load(const CPLJSONObject &store)
 {
+    if(!loadExpression(store, "color", m_colorExpression)) {
+        return false;
+    }
+    if(m_colorExpression) {
+        // Used if expression result is null or not a color
+        setColor(defaultRGBAColor);
+        return true;
+    }
+
     ngsRGBA color = ngsHEX2RGBA(
                 store.GetString("color", ngsRGBA2HEX(defaultRGBAColor)));
     setColor(color);
@@ -178,17 +221,78 @@ bool SimpleVectorStyle::load(const CPLJSONObject &store)
 CPLJSONObject SimpleVectorStyle::save() const
 {
     CPLJSONObject out;
-    out.Add("color", ngsRGBA2HEX(ngsGl2RGBA(m_color)));
+    if(m_colorExpression) {
+        out.Add("color", m_colorExpression->json());
+    }
+    else {
+        out.Add("color", ngsRGBA2HEX(ngsGl2RGBA(m_color)));
+    }
     return out;
 }
 
+bool SimpleVectorStyle::isDataDriven() const
+{
+    return m_colorExpression != nullptr;
+}
+
+bool SimpleVectorStyle::isFeatureDependent() const
+{
+    return m_colorExpression && m_colorExpression->isFeatureDependent();
+}
+
+/**
+ * @brief SimpleVectorStyle::evaluate Append values of data driven properties.
+ * Executed from fill threads, so style is not changed.
+ * @param context Tile zoom and item feature.
+ * @param out Style class values.
+ */
+void SimpleVectorStyle::evaluate(ExpressionContext &context,
+                                 StyleClass &out) const
+{
+    if(!m_colorExpression) {
+        return;
+    }
+    GlColor color = m_color;
+    ExpressionValue value;
+    ngsRGBA rgba;
+    if(m_colorExpression->evaluate(context, value) && value.toColor(rgba)) {
+        color = ngsRGBA2Gl(rgba);
+    }
+    out.insert(out.end(), {color.r, color.g, color.b, color.a});
+}
+
+/**
+ * @brief SimpleVectorStyle::applyClass Use style class values in next prepare
+ * calls until resetClass is called.
+ * @param values Style class values.
+ * @param offset Index of the first value of this style.
+ * @return Index of the next style values.
+ */
+size_t SimpleVectorStyle::applyClass(const StyleClass &values, size_t offset)
+{
+    m_classApplied = true;
+    m_classColor = m_color;
+    if(m_colorExpression && offset + 4 <= values.size()) {
+        m_classColor = {values[offset], values[offset + 1],
+                        values[offset + 2], values[offset + 3]};
+        offset += 4;
+    }
+    return offset;
+}
+
+void SimpleVectorStyle::resetClass()
+{
+    m_classApplied = false;
+}
+
 //------------------------------------------------------------------------------
 // PointStyle
 //------------------------------------------------------------------------------
 PointStyle::PointStyle(enum PointType type) : SimpleVectorStyle(),
     m_type(type),
     m_size(6.0f),
-    m_rotation(0.0f)
+    m_rotation(0.0f),
+    m_classSize(6.0f)
 {
     m_styleType = ST_POINT;
 }
@@ -197,7 +301,10 @@ bool PointStyle::load(const CPLJSONObject &store)
 {
     if(!SimpleVectorStyle::load(store))
         return false;
-    m_size = static_cast<float>(store.GetDouble("size", 6.0));
+    if(!loadExpression(store, "size", m_sizeExpression))
+        return false;
+    m_size = m_sizeExpression ? 6.0f :
+            static_cast<float>(store.GetDouble("size", 6.0));
     m_type = static_cast<enum PointType>(store.GetInteger("type", 3));
     m_rotation = static_cast<float>(store.GetDouble("rotate", 0.0));
     return true;
@@ -206,12 +313,58 @@ bool PointStyle::load(const CPLJSONObject &store)
 CPLJSONObject PointStyle::save() const
 {
     CPLJSONObject out = SimpleVectorStyle::save();
-    out.Add("size", static_cast<double>(m_size));
+    if(m_sizeExpression) {
+        out.Add("size", m_sizeExpression->json());
+    }
+    else {
+        out.Add("size", static_cast<double>(m_size));
+    }
     out.Add("type", m_type);
     out.Add("rotate", static_cast<double>(m_rotation));
     return out;
 }
 
+bool PointStyle::isDataDriven() const
+{
+    return SimpleVectorStyle::isDataDriven() || m_sizeExpression;
+}
+
+bool PointStyle::isFeatureDependent() const
+{
+    return SimpleVectorStyle::isFeatureDependent() ||
+            (m_sizeExpression && m_sizeExpression->isFeatureDependent());
+}
+
+/**
+ * @brief PointStyle::evaluate Append color and size values. Size of cluster
+ * points is usually an expression of the point_count field.
+ */
+void PointStyle::evaluate(ExpressionContext &context, StyleClass &out) const
+{
+    SimpleVectorStyle::evaluate(context, out);
+    if(!m_sizeExpression) {
+        return;
+    }
+    ExpressionValue value;
+    double size;
+    if(m_sizeExpression->evaluate(context, value) && value.toNumber(size)) {
+        out.push_back(static_cast<float>(size));
+    }
+    else {
+        out.push_back(m_size);
+    }
+}
+
+size_t PointStyle::applyClass(const StyleClass &values, size_t offset)
+{
+    offset = SimpleVectorStyle::applyClass(values, offset);
+    m_classSize = m_size;
+    if(m_sizeExpression && offset < values.size()) {
+        m_classSize = values[offset++];
+    }
+    return offset;
+}
+
 //------------------------------------------------------------------------------
 // SimplePointStyle
 //------------------------------------------------------------------------------
@@ -344,8 +497,8 @@ SimplePointStyle::SimplePointStyle(enum PointType type) : PointStyle(type)
     m_fragmentShaderSource = pointFragmentShaderSource;
 }
 
-unsigned short SimplePointStyle::addPoint(const SimplePoint &pt, float z,
-                                          unsigned short index, GlBuffer *buffer)
+GLuint SimplePointStyle::addPoint(const SimplePoint &pt, float z,
+                                  GLuint index, GlBuffer *buffer)
 {
     buffer->addVertex(pt.x);
     buffer->addVertex(pt.y);
@@ -360,9 +513,9 @@ bool SimplePointStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMat
     if (!SimpleVectorStyle::prepare(msMatrix, vsMatrix, type))
         return false;
 
-    m_program.setInt("u_type", m_type);
-    m_program.setFloat("u_vSize", m_size);
-    m_program.setVertexAttribPointer("a_mPosition", 3, 0, nullptr);
+    m_program->setInt(GlProgram::U_TYPE, m_type);
+    m_program->setFloat(GlProgram::U_SIZE, drawSize());
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 0, nullptr);
 
     return true;
 }
@@ -371,8 +524,8 @@ void SimplePointStyle::draw(const GlBuffer& buffer) const
 {
     SimpleVectorStyle::draw(buffer);
 
-    ngsCheckGLError(glDrawElements(GL_POINTS, buffer.indexSize(),
-                                   GL_UNSIGNED_SHORT, nullptr));
+    ngsCheckGLError(glDrawElements(GL_POINTS, buffer.drawCount(),
+                                   buffer.indexType(), buffer.drawOffset()));
 }
 
 
@@ -410,6 +563,7 @@ SimpleLineStyle::SimpleLineStyle() : SimpleVectorStyle(),
     m_normalId(-1),
     m_vLineWidthId(-1),
     m_width(1.0),
+    m_classWidth(1.0),
     m_capType(CT_BUTT), //CT_ROUND),
     m_joinType(JT_BEVELED), //JT_ROUND),
     m_segmentCount(6)
@@ -425,9 +579,10 @@ bool SimpleLineStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatr
     if (!SimpleVectorStyle::prepare(msMatrix, vsMatrix, type))
         return false;
 
-    m_program.setFloat("u_vLineWidth", m_width);
-    m_program.setVertexAttribPointer("a_mPosition", 3, 5 * sizeof(float), nullptr);
-    m_program.setVertexAttribPointer("a_normal", 2, 5 * sizeof(float),
+    m_program->setFloat(GlProgram::U_LINE_WIDTH,
+                       m_classApplied ? m_classWidth : m_width);
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 5 * sizeof(float), nullptr);
+    m_program->setVertexAttribPointer(GlProgram::A_NORMAL, 2, 5 * sizeof(float),
                             reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
     return true;
 }
@@ -437,15 +592,18 @@ void SimpleLineStyle::draw(const GlBuffer &buffer) const
     if(buffer.indexSize() == 0)
         return;
     SimpleVectorStyle::draw(buffer);
-    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.indexSize(),
-                                   GL_UNSIGNED_SHORT, nullptr));
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.drawCount(),
+                                   buffer.indexType(), buffer.drawOffset()));
 }
 
 bool SimpleLineStyle::load(const CPLJSONObject &store)
 {
     if(!SimpleVectorStyle::load(store))
         return false;
-    m_width = static_cast<float>(store.GetDouble("line_width", 3.0));
+    if(!loadExpression(store, "line_width", m_widthExpression))
+        return false;
+    m_width = m_widthExpression ? 3.0f :
+            static_cast<float>(store.GetDouble("line_width", 3.0));
     m_capType = static_cast<enum CapType>(store.GetInteger("cap", m_capType));
     m_joinType = static_cast<enum JoinType>(store.GetInteger("join", m_joinType));
     m_segmentCount = static_cast<unsigned char>(store.GetInteger("segments", m_segmentCount));
@@ -455,13 +613,55 @@ bool SimpleLineStyle::load(const CPLJSONObject &store)
 CPLJSONObject SimpleLineStyle::save() const
 {
     CPLJSONObject out = SimpleVectorStyle::save();
-    out.Add("line_width", static_cast<double>(m_width));
+    if(m_widthExpression) {
+        out.Add("line_width", m_widthExpression->json());
+    }
+    else {
+        out.Add("line_width", static_cast<double>(m_width));
+    }
     out.Add("cap", m_capType);
     out.Add("join", m_joinType);
     out.Add("segments", m_segmentCount);
     return out;
 }
 
+bool SimpleLineStyle::isDataDriven() const
+{
+    return SimpleVectorStyle::isDataDriven() || m_widthExpression;
+}
+
+bool SimpleLineStyle::isFeatureDependent() const
+{
+    return SimpleVectorStyle::isFeatureDependent() ||
+            (m_widthExpression && m_widthExpression->isFeatureDependent());
+}
+
+void SimpleLineStyle::evaluate(ExpressionContext &context, StyleClass &out) const
+{
+    SimpleVectorStyle::evaluate(context, out);
+    if(!m_widthExpression) {
+        return;
+    }
+    ExpressionValue value;
+    double width;
+    if(m_widthExpression->evaluate(context, value) && value.toNumber(width)) {
+        out.push_back(static_cast<float>(width));
+    }
+    else {
+        out.push_back(m_width);
+    }
+}
+
+size_t SimpleLineStyle::applyClass(const StyleClass &values, size_t offset)
+{
+    offset = SimpleVectorStyle::applyClass(values, offset);
+    m_classWidth = m_width;
+    if(m_widthExpression && offset < values.size()) {
+        m_classWidth = values[offset++];
+    }
+    return offset;
+}
+
 enum CapType SimpleLineStyle::capType() const
 {
     return m_capType;
@@ -492,9 +692,9 @@ void SimpleLineStyle::setSegmentCount(unsigned char segmentCount)
     m_segmentCount = segmentCount;
 }
 
-unsigned short SimpleLineStyle::addLineCap(const SimplePoint &point,
-                                           const Normal &normal, float z,
-                                           unsigned short index, GlBuffer *buffer)
+GLuint SimpleLineStyle::addLineCap(const SimplePoint &point,
+                                   const Normal &normal, float z,
+                                   GLuint index, GlBuffer *buffer)
 {
     switch(m_capType) {
         case CapType::CT_ROUND:
@@ -606,12 +806,12 @@ size_t SimpleLineStyle::lineCapVerticesCount() const
     return 0;
 }
 
-unsigned short SimpleLineStyle::addLineJoin(const SimplePoint &point,
-                                            const Normal &prevNormal,
-                                            const Normal &normal,
-                                            float z,
-                                            unsigned short index,
-                                            GlBuffer *buffer)
+GLuint SimpleLineStyle::addLineJoin(const SimplePoint &point,
+                                    const Normal &prevNormal,
+                                    const Normal &normal,
+                                    float z,
+                                    GLuint index,
+                                    GlBuffer *buffer)
 {
 //    float maxWidth = width() * 5;
     float start = angle(prevNormal);
@@ -762,12 +962,12 @@ size_t SimpleLineStyle::lineJoinVerticesCount() const
     return 0;
 }
 
-unsigned short SimpleLineStyle::addSegment(const SimplePoint &pt1,
-                                           const SimplePoint &pt2,
-                                           const Normal &normal,
-                                           float z,
-                                           unsigned short index,
-                                           GlBuffer *buffer)
+GLuint SimpleLineStyle::addSegment(const SimplePoint &pt1,
+                                   const SimplePoint &pt2,
+                                   const Normal &normal,
+                                   float z,
+                                   GLuint index,
+                                   GlBuffer *buffer)
 {
     // 0
     buffer->addVertex(pt1.x);
@@ -825,10 +1025,50 @@ void PrimitivePointStyle::setType(enum PointType type)
     PointStyle::setType(type);
 }
 
-unsigned short PrimitivePointStyle::addPoint(const SimplePoint &pt, float z,
-                                             unsigned short index,
-                                             GlBuffer *buffer)
+/**
+ * @brief PrimitivePointStyle::pointSpriteSize Get point sprite size with the
+ * same shape extent as triangles of the point type.
+ * @return Size in pixels or 0 if point type can not be drawn by sprite.
+ */
+float PrimitivePointStyle::pointSpriteSize() const
+{
+    switch(pointType()) {
+    case PT_SQUARE:
+        return 2.0f * normal45 * drawSize();
+    case PT_CIRCLE:
+    case PT_DIAMOND:
+        return 2.0f * drawSize();
+    case PT_TRIANGLE:
+        return 1.7320508f * drawSize();
+    default:
+        // Rectangle and star shapes differ from the sprite shader ones
+        return 0.0f;
+    }
+}
+
+/**
+ * @brief PrimitivePointStyle::bufferType Points are stored as one vertex point
+ * sprites (BF_PT) if the shape and size are supported by GL context,
+ * otherwise as triangles with normals (BF_FILL).
+ * @return Buffer type to fill point data.
+ */
+enum GlBuffer::BufferType PrimitivePointStyle::bufferType() const
 {
+    float spriteSize = pointSpriteSize();
+    if(spriteSize > 0.0f && spriteSize <= maxPointSize()) {
+        return GlBuffer::BF_PT;
+    }
+    return GlBuffer::BF_FILL;
+}
+
+GLuint PrimitivePointStyle::addPoint(const SimplePoint &pt, float z,
+                                     GLuint index,
+                                     GlBuffer *buffer)
+{
+    if(buffer->type() == GlBuffer::BF_PT) {
+        return m_pointSprite.addPoint(pt, z, index, buffer);
+    }
+
     switch(pointType()) {
     case PT_SQUARE:
         {
@@ -1089,12 +1329,20 @@ size_t PrimitivePointStyle::pointVerticesCount() const
 bool PrimitivePointStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
                               enum GlBuffer::BufferType type)
 {
+    if(type == GlBuffer::BF_PT) {
+        // Sync here as color and type may be changed by location and edit styles
+        m_pointSprite.setType(pointType());
+        m_pointSprite.setSize(pointSpriteSize());
+        m_pointSprite.setColor(ngsGl2RGBA(drawColor()));
+        return m_pointSprite.prepare(msMatrix, vsMatrix, type);
+    }
+
     if (!SimpleVectorStyle::prepare(msMatrix, vsMatrix, type))
         return false;
 
-    m_program.setFloat("u_vLineWidth", m_size);
-    m_program.setVertexAttribPointer("a_mPosition", 3, 5 * sizeof(float), nullptr);
-    m_program.setVertexAttribPointer("a_normal", 2, 5 * sizeof(float),
+    m_program->setFloat(GlProgram::U_LINE_WIDTH, drawSize());
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 5 * sizeof(float), nullptr);
+    m_program->setVertexAttribPointer(GlProgram::A_NORMAL, 2, 5 * sizeof(float),
                             reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
     return true;
 }
@@ -1103,9 +1351,13 @@ void PrimitivePointStyle::draw(const GlBuffer &buffer) const
 {
     if(buffer.indexSize() == 0)
         return;
+    if(buffer.type() == GlBuffer::BF_PT) {
+        m_pointSprite.draw(buffer);
+        return;
+    }
     SimpleVectorStyle::draw(buffer);
-    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.indexSize(),
-                                   GL_UNSIGNED_SHORT, nullptr));
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.drawCount(),
+                                   buffer.indexType(), buffer.drawOffset()));
 }
 
 bool PrimitivePointStyle::load(const CPLJSONObject &store)
@@ -1127,6 +1379,12 @@ CPLJSONObject PrimitivePointStyle::save() const
     return out;
 }
 
+void PrimitivePointStyle::destroy()
+{
+    PointStyle::destroy();
+    m_pointSprite.destroy();
+}
+
 //------------------------------------------------------------------------------
 // SimpleFillStyle
 //------------------------------------------------------------------------------
@@ -1162,7 +1420,7 @@ bool SimpleFillStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatr
 {
     if (!SimpleVectorStyle::prepare(msMatrix, vsMatrix, type))
         return false;
-    m_program.setVertexAttribPointer("a_mPosition", 3, 0, nullptr);
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 0, nullptr);
 
     return true;
 }
@@ -1170,8 +1428,8 @@ bool SimpleFillStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatr
 void SimpleFillStyle::draw(const GlBuffer& buffer) const
 {
     SimpleVectorStyle::draw(buffer);
-    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.indexSize(),
-            GL_UNSIGNED_SHORT, nullptr));
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.drawCount(),
+            buffer.indexType(), buffer.drawOffset()));
 }
 
 //------------------------------------------------------------------------------
@@ -1227,6 +1485,36 @@ CPLJSONObject SimpleFillBorderedStyle::save() const
     return out;
 }
 
+bool SimpleFillBorderedStyle::isDataDriven() const
+{
+    return m_fill.isDataDriven() || m_line.isDataDriven();
+}
+
+bool SimpleFillBorderedStyle::isFeatureDependent() const
+{
+    return m_fill.isFeatureDependent() || m_line.isFeatureDependent();
+}
+
+void SimpleFillBorderedStyle::evaluate(ExpressionContext &context,
+                                       StyleClass &out) const
+{
+    m_fill.evaluate(context, out);
+    m_line.evaluate(context, out);
+}
+
+size_t SimpleFillBorderedStyle::applyClass(const StyleClass &values,
+                                           size_t offset)
+{
+    offset = m_fill.applyClass(values, offset);
+    return m_line.applyClass(values, offset);
+}
+
+void SimpleFillBorderedStyle::resetClass()
+{
+    m_fill.resetClass();
+    m_line.resetClass();
+}
+
 unsigned char SimpleFillBorderedStyle::segmentCount() const
 {
     return m_line.segmentCount();
@@ -1257,6 +1545,136 @@ void SimpleFillBorderedStyle::setJoinType(const enum JoinType &joinType)
     m_line.setJoinType(joinType);
 }
 
+//------------------------------------------------------------------------------
+// MixedStyle
+//------------------------------------------------------------------------------
+
+MixedStyle::MixedStyle(const TextureAtlas &textureAtlas) : Style(),
+    m_textureAtlas(textureAtlas),
+    m_point(createStyle("primitivePoint", textureAtlas)),
+    m_line(createStyle("simpleLine", textureAtlas)),
+    m_fill(createStyle("simpleFillBordered", textureAtlas))
+{
+    m_styleType = ST_MIXED;
+}
+
+/**
+ * @brief MixedStyle::style Sub-style of geometry type.
+ * @param type Point, line or fill style type.
+ * @return Sub-style or empty pointer for other types.
+ */
+StylePtr MixedStyle::style(enum ngsStyleType type) const
+{
+    switch(type) {
+    case ST_POINT:
+        return m_point;
+    case ST_LINE:
+        return m_line;
+    case ST_FILL:
+        return m_fill;
+    default:
+        return StylePtr();
+    }
+}
+
+/**
+ * @brief MixedStyle::setStyleName Replace sub-style of geometry type with the
+ * new style of this name and default properties.
+ * @param type Point, line or fill style type.
+ * @param name New style name. The style must be of the same type.
+ * @return True on success.
+ */
+bool MixedStyle::setStyleName(enum ngsStyleType type, const std::string &name)
+{
+    StylePtr newStyle(createStyle(name, m_textureAtlas));
+    if(!newStyle || newStyle->type() != type) {
+        return false;
+    }
+
+    switch(type) {
+    case ST_POINT:
+        m_point = newStyle;
+        return true;
+    case ST_LINE:
+        m_line = newStyle;
+        return true;
+    case ST_FILL:
+        m_fill = newStyle;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool MixedStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
+                         enum GlBuffer::BufferType type)
+{
+    // Buffers are prepared and drawn by sub-styles
+    ngsUnused(msMatrix);
+    ngsUnused(vsMatrix);
+    ngsUnused(type);
+    return false;
+}
+
+void MixedStyle::draw(const GlBuffer &buffer) const
+{
+    ngsUnused(buffer);
+}
+
+bool MixedStyle::load(const CPLJSONObject &store)
+{
+    const std::vector<std::pair<enum ngsStyleType, const char*>> keys = {
+        {ST_POINT, "point"}, {ST_LINE, "line"}, {ST_FILL, "fill"} };
+    for(const auto &key : keys) {
+        CPLJSONObject styleStore = store.GetObj(key.second);
+        if(!styleStore.IsValid()) {
+            continue;
+        }
+        std::string styleName = styleStore.GetString("style_name", "");
+        if(!styleName.empty() && styleName != style(key.first)->name() &&
+                !setStyleName(key.first, styleName)) {
+            return false;
+        }
+        if(!style(key.first)->load(styleStore.GetObj("style"))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CPLJSONObject MixedStyle::save() const
+{
+    CPLJSONObject out;
+    const std::vector<std::pair<StylePtr, const char*>> keys = {
+        {m_point, "point"}, {m_line, "line"}, {m_fill, "fill"} };
+    for(const auto &key : keys) {
+        CPLJSONObject styleStore;
+        styleStore.Add("style_name", key.first->name());
+        styleStore.Add("style", key.first->save());
+        out.Add(key.second, styleStore);
+    }
+    return out;
+}
+
+bool MixedStyle::isDataDriven() const
+{
+    return m_point->isDataDriven() || m_line->isDataDriven() ||
+            m_fill->isDataDriven();
+}
+
+bool MixedStyle::isFeatureDependent() const
+{
+    return m_point->isFeatureDependent() || m_line->isFeatureDependent() ||
+            m_fill->isFeatureDependent();
+}
+
+void MixedStyle::destroy()
+{
+    m_point->destroy();
+    m_line->destroy();
+    m_fill->destroy();
+}
+
 //------------------------------------------------------------------------------
 // SimpleImageStyle
 //------------------------------------------------------------------------------
@@ -1300,9 +1718,9 @@ bool SimpleImageStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMat
     if(m_image && !m_image->bound()) {
         m_image->bind();
     }
-    m_program.setInt("s_texture", 0);
-    m_program.setVertexAttribPointer("a_mPosition", 3, 5 * sizeof(float), nullptr);
-    m_program.setVertexAttribPointer("a_texCoord", 2, 5 * sizeof(float),
+    m_program->setInt(GlProgram::U_TEXTURE, 0);
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 5 * sizeof(float), nullptr);
+    m_program->setVertexAttribPointer(GlProgram::A_TEX_COORD, 2, 5 * sizeof(float),
                             reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
 
     return true;
@@ -1316,11 +1734,11 @@ void SimpleImageStyle::draw(const GlBuffer &buffer) const
 
     Style::draw(buffer);
 
-    ngsCheckGLError(glActiveTexture(GL_TEXTURE0));
+    GlState::activeTexture(GL_TEXTURE0);
     m_image->rebind();
 
-    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.indexSize(),
-            GL_UNSIGNED_SHORT, nullptr));
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.drawCount(),
+            buffer.indexType(), buffer.drawOffset()));
 }
 
 bool SimpleImageStyle::load(const CPLJSONObject &store)
@@ -1400,8 +1818,8 @@ void MarkerStyle::setType(enum PointType type)
     ngsUnused(type);
 }
 
-unsigned short MarkerStyle::addPoint(const SimplePoint &pt, float z,
-                                     unsigned short index, GlBuffer *buffer)
+GLuint MarkerStyle::addPoint(const SimplePoint &pt, float z,
+                             GLuint index, GlBuffer *buffer)
 {
     float nx1, ny1, nx2, ny2;
 
@@ -1471,12 +1889,12 @@ bool MarkerStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
     if(m_iconSet && !m_iconSet->bound()) {
         m_iconSet->bind();
     }
-    m_program.setInt("s_texture", 0);
-    m_program.setFloat("u_vLineWidth", m_size);
-    m_program.setVertexAttribPointer("a_mPosition", 3, 7 * sizeof(float), nullptr);
-    m_program.setVertexAttribPointer("a_normal", 2, 7 * sizeof(float),
+    m_program->setInt(GlProgram::U_TEXTURE, 0);
+    m_program->setFloat(GlProgram::U_LINE_WIDTH, drawSize());
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 7 * sizeof(float), nullptr);
+    m_program->setVertexAttribPointer(GlProgram::A_NORMAL, 2, 7 * sizeof(float),
                             reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
-    m_program.setVertexAttribPointer("a_texCoord", 2, 7 * sizeof(float),
+    m_program->setVertexAttribPointer(GlProgram::A_TEX_COORD, 2, 7 * sizeof(float),
                             reinterpret_cast<const GLvoid*>(5 * sizeof(float)));
 
     return true;
@@ -1490,11 +1908,11 @@ void MarkerStyle::draw(const GlBuffer &buffer) const
 
     Style::draw(buffer);
 
-    ngsCheckGLError(glActiveTexture(GL_TEXTURE0));
+    GlState::activeTexture(GL_TEXTURE0);
     m_iconSet->rebind();
 
-    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.indexSize(),
-                                   GL_UNSIGNED_SHORT, nullptr));
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.drawCount(),
+                                   buffer.indexType(), buffer.drawOffset()));
 }
 
 bool MarkerStyle::load(const CPLJSONObject &store)
@@ -1524,6 +1942,432 @@ CPLJSONObject MarkerStyle::save() const
     return out;
 }
 
+//------------------------------------------------------------------------------
+// HeatmapStyle
+//------------------------------------------------------------------------------
+
+// Gaussian kernel with 3 sigma at the sprite border
+constexpr const GLchar * const heatmapFragmentShaderSource = R"(
+    uniform float u_intensity;
+
+    void main()
+    {
+        vec2 coord = gl_PointCoord * 2.0 - vec2(1.0);
+        float distance2 = dot(coord, coord);
+        if(distance2 > 1.0)
+            discard;
+        float density = u_intensity * exp(-4.5 * distance2);
+        gl_FragColor = vec4(density);
+    }
+)";
+
+constexpr const GLchar * const heatmapRampVertexShaderSource = R"(
+    attribute vec3 a_mPosition;
+    attribute vec2 a_texCoord;
+    varying vec2 v_texCoord;
+
+    void main()
+    {
+        gl_Position = vec4(a_mPosition, 1);
+        v_texCoord = a_texCoord;
+    }
+)";
+
+constexpr const GLchar * const heatmapRampFragmentShaderSource = R"(
+    uniform sampler2D s_texture;
+    uniform sampler2D s_ramp;
+    varying vec2 v_texCoord;
+
+    void main()
+    {
+        float density = texture2D(s_texture, v_texCoord).r;
+        if(density <= 0.0)
+            discard;
+        gl_FragColor = texture2D(s_ramp, vec2(clamp(density, 0.0, 1.0), 0.5));
+    }
+)";
+
+constexpr unsigned short HEATMAP_RAMP_SIZE = 256;
+const std::vector<ColorRampStop> defaultHeatmapRamp = {
+    { 0.0, { 0, 0, 255, 0 } },
+    { 0.2, { 65, 105, 225, 255 } },
+    { 0.4, { 0, 255, 255, 255 } },
+    { 0.6, { 0, 255, 0, 255 } },
+    { 0.8, { 255, 255, 0, 255 } },
+    { 1.0, { 255, 0, 0, 255 } }
+};
+
+HeatmapStyle::HeatmapStyle() : PointStyle(PT_CIRCLE),
+    m_intensity(0.1f),
+    m_rampChanged(true),
+    m_targetFramebuffer(0)
+{
+    m_vertexShaderSource = pointVertexShaderSource;
+    m_fragmentShaderSource = heatmapFragmentShaderSource;
+    m_size = 20.0f;
+    m_classSize = m_size;
+    m_colorRamp.setStops(defaultHeatmapRamp);
+}
+
+/**
+ * @brief HeatmapStyle::setColorRamp Set colors of density values. Density
+ * of one point in its center is equal to intensity, values from 0 to 1 are
+ * mapped to colors.
+ * @param stops Density values and colors.
+ */
+void HeatmapStyle::setColorRamp(const std::vector<ColorRampStop> &stops)
+{
+    m_colorRamp.setStops(stops.empty() ? defaultHeatmapRamp : stops);
+    m_rampChanged = true;
+}
+
+/**
+ * @brief HeatmapStyle::beginDensity Make the density frame the render target
+ * and clear it. Tile items drawn until endDensity() are summed. Run in Gl
+ * context.
+ * @param tileSize Tile size in pixels.
+ */
+void HeatmapStyle::beginDensity(GLsizei tileSize)
+{
+    // Tile or layer frame of semi-transparent layer
+    ngsCheckGLError(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_targetFramebuffer));
+    m_density.resize(tileSize);
+    if(m_density.bound()) {
+        m_density.rebind();
+    }
+    else {
+        m_density.bind();
+    }
+    GlState::clearColor({0.0f, 0.0f, 0.0f, 0.0f});
+    ngsCheckGLError(glClear(GL_COLOR_BUFFER_BIT));
+    GlState::blendFunc(GL_ONE, GL_ONE);
+}
+
+/**
+ * @brief HeatmapStyle::endDensity Draw the summed density through the color
+ * ramp to the render target which was current in beginDensity() and restore
+ * it. Run in Gl context.
+ */
+void HeatmapStyle::endDensity()
+{
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER,
+                                      static_cast<GLuint>(m_targetFramebuffer)));
+    GlState::blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if(!m_rampProgram) {
+        m_rampProgram = GlProgramCache::instance().program(
+                    heatmapRampVertexShaderSource,
+                    heatmapRampFragmentShaderSource);
+        if(!m_rampProgram) {
+            return;
+        }
+    }
+
+    if(m_rampChanged) {
+        m_ramp.destroy();
+        std::vector<float> values(HEATMAP_RAMP_SIZE);
+        for(size_t i = 0; i < values.size(); ++i) {
+            values[i] = static_cast<float>(i) / (HEATMAP_RAMP_SIZE - 1);
+        }
+        GLubyte *rgba = static_cast<GLubyte*>(
+                    CPLMalloc(HEATMAP_RAMP_SIZE * 4 * sizeof(GLubyte)));
+        m_colorRamp.apply(values.data(), values.size(), rgba);
+        m_ramp.setImage(rgba, HEATMAP_RAMP_SIZE, 1);
+        m_ramp.setSmooth(true);
+        m_rampChanged = false;
+    }
+    if(!m_ramp.bound()) {
+        m_ramp.bind();
+    }
+
+    const GlBuffer &frame = m_density.getBuffer();
+    frame.rebind();
+    m_rampProgram->use();
+    m_rampProgram->setInt(GlProgram::U_TEXTURE, 0);
+    m_rampProgram->setInt(GlProgram::U_RAMP, 1);
+    m_rampProgram->setVertexAttribPointer(GlProgram::A_POSITION, 3,
+                                          5 * sizeof(float), nullptr);
+    m_rampProgram->setVertexAttribPointer(GlProgram::A_TEX_COORD, 2,
+                                          5 * sizeof(float),
+                            reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
+
+    GlState::activeTexture(GL_TEXTURE1);
+    m_ramp.rebind();
+    GlState::activeTexture(GL_TEXTURE0);
+    GlState::bindTexture(m_density.textureId());
+
+    // Frame quad is drawn over the tile items of other layers
+    GlState::setEnabled(GL_DEPTH_TEST, false);
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, frame.drawCount(),
+                                   frame.indexType(), frame.drawOffset()));
+    GlState::setEnabled(GL_DEPTH_TEST, true);
+    glStats().drawCalls++;
+}
+
+GLuint HeatmapStyle::addPoint(const SimplePoint &pt, float z, GLuint index,
+                              GlBuffer *buffer)
+{
+    buffer->addVertex(pt.x);
+    buffer->addVertex(pt.y);
+    buffer->addVertex(z);
+    buffer->addIndex(index++);
+    return index;
+}
+
+bool HeatmapStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
+                           enum GlBuffer::BufferType type)
+{
+    if (!SimpleVectorStyle::prepare(msMatrix, vsMatrix, type))
+        return false;
+
+    // Sprite size is the kernel diameter
+    float size = std::min(2.0f * drawSize(), maxPointSize());
+    m_program->setFloat(GlProgram::U_SIZE, size);
+    m_program->setFloat(GlProgram::U_INTENSITY, m_intensity);
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 0, nullptr);
+    return true;
+}
+
+void HeatmapStyle::draw(const GlBuffer &buffer) const
+{
+    if(buffer.indexSize() == 0)
+        return;
+    SimpleVectorStyle::draw(buffer);
+    ngsCheckGLError(glDrawElements(GL_POINTS, buffer.drawCount(),
+                                   buffer.indexType(), buffer.drawOffset()));
+}
+
+bool HeatmapStyle::load(const CPLJSONObject &store)
+{
+    if(!PointStyle::load(store))
+        return false;
+    if(!store.GetObj("size").IsValid()) {
+        m_size = 20.0f;
+    }
+    m_intensity = static_cast<float>(store.GetDouble("intensity", 0.1));
+    std::vector<ColorRampStop> stops;
+    CPLJSONArray ramp = store.GetArray("color_ramp");
+    for(int i = 0; i < ramp.Size(); ++i) {
+        CPLJSONObject stop = ramp[i];
+        stops.push_back({ stop.GetDouble("value", 0.0),
+                          ngsHEX2RGBA(stop.GetString("color", "#FF0000FF")) });
+    }
+    setColorRamp(stops);
+    return true;
+}
+
+CPLJSONObject HeatmapStyle::save() const
+{
+    CPLJSONObject out = PointStyle::save();
+    out.Add("intensity", static_cast<double>(m_intensity));
+    CPLJSONArray ramp;
+    for(const ColorRampStop &stop : m_colorRamp.stops()) {
+        CPLJSONObject item;
+        item.Add("value", stop.value);
+        item.Add("color", ngsRGBA2HEX(stop.color));
+        ramp.Add(item);
+    }
+    out.Add("color_ramp", ramp);
+    return out;
+}
+
+void HeatmapStyle::destroy()
+{
+    PointStyle::destroy();
+    m_rampProgram.reset();
+    m_ramp.destroy();
+    m_density.destroy();
+    m_rampChanged = true;
+}
+
+//------------------------------------------------------------------------------
+// LabelStyle
+//------------------------------------------------------------------------------
+
+// Distance field edge smoothing for glyphs drawn in original size
+constexpr float LABEL_SDF_SMOOTHING = 0.1f;
+
+constexpr const GLchar * const labelFragmentShaderSource = R"(
+    varying vec2 v_texCoord;
+    uniform sampler2D s_texture;
+    uniform vec4 u_color;
+    uniform float u_vSize;
+
+    void main()
+    {
+        float distance = texture2D( s_texture, v_texCoord ).a;
+        float alpha = smoothstep(0.5 - u_vSize, 0.5 + u_vSize, distance);
+        gl_FragColor = vec4(u_color.rgb, u_color.a * alpha);
+    }
+)";
+
+LabelStyle::LabelStyle(const TextureAtlas &textureAtlas) : SimpleVectorStyle(),
+    m_font(nullptr),
+    m_glyphWidth(16),
+    m_glyphHeight(16),
+    m_firstGlyph(32),
+    m_size(12.0f),
+    m_textureAtlas(textureAtlas)
+{
+    m_vertexShaderSource = markerVertexShaderSource;
+    m_fragmentShaderSource = labelFragmentShaderSource;
+    m_styleType = ST_POINT;
+}
+
+void LabelStyle::setFont(const std::string &fontName, unsigned char glyphWidth,
+                         unsigned char glyphHeight, unsigned int firstGlyph)
+{
+    auto it = m_textureAtlas.find(fontName);
+    m_font = it == m_textureAtlas.end() ? nullptr : it->second.get();
+    m_fontName = fontName;
+    m_glyphWidth = std::max(glyphWidth, static_cast<unsigned char>(1));
+    m_glyphHeight = std::max(glyphHeight, static_cast<unsigned char>(1));
+    m_firstGlyph = firstGlyph;
+}
+
+/**
+ * @brief LabelStyle::labelSize Label size in pixels. Glyphs of the atlas have
+ * the same advance.
+ * @param glyphCount Label glyph count.
+ * @return Label width and height.
+ */
+OGRRawPoint LabelStyle::labelSize(size_t glyphCount) const
+{
+    double scale = static_cast<double>(m_size) / m_glyphHeight;
+    return OGRRawPoint(glyphCount * m_glyphWidth * scale,
+                       static_cast<double>(m_size));
+}
+
+/**
+ * @brief LabelStyle::addLabel Add glyph quads centered at the point. Quad
+ * corners are stored as pixel offsets from the point, so the label keeps its
+ * size on any scale.
+ * @param pt Label anchor point in map coordinates.
+ * @param glyphs Label code points.
+ * @param index First vertex index.
+ * @param buffer Buffer to add quads.
+ * @return Next vertex index.
+ */
+GLuint LabelStyle::addLabel(const SimplePoint &pt,
+                            const std::vector<unsigned int> &glyphs,
+                            GLuint index, GlBuffer *buffer) const
+{
+    if(nullptr == m_font) {
+        return index;
+    }
+
+    float scale = m_size / m_glyphHeight;
+    float advance = m_glyphWidth * scale;
+    float x = -0.5f * advance * glyphs.size();
+    float y = 0.5f * m_size;
+    size_t glyphsInLine = m_font->width() / m_glyphWidth;
+    size_t glyphCount = glyphsInLine * (m_font->height() / m_glyphHeight);
+    float atlasWidth = static_cast<float>(m_font->width());
+    float atlasHeight = static_cast<float>(m_font->height());
+
+    auto addVertex = [&](float dx, float dy, float u, float v) {
+        buffer->addVertex(pt.x);
+        buffer->addVertex(pt.y);
+        buffer->addVertex(0.0f);
+        buffer->addVertex(dx);
+        buffer->addVertex(dy);
+        buffer->addVertex(u);
+        buffer->addVertex(v);
+    };
+
+    for(unsigned int glyph : glyphs) {
+        if(glyph < m_firstGlyph || glyph - m_firstGlyph >= glyphCount) {
+            x += advance; // No glyph in atlas, skip as space
+            continue;
+        }
+        size_t glyphIndex = glyph - m_firstGlyph;
+        size_t line = glyphIndex / glyphsInLine;
+        size_t column = glyphIndex - line * glyphsInLine;
+        float u1 = column * m_glyphWidth / atlasWidth;
+        float u2 = (column + 1) * m_glyphWidth / atlasWidth;
+        float v1 = line * m_glyphHeight / atlasHeight;
+        float v2 = (line + 1) * m_glyphHeight / atlasHeight;
+
+        addVertex(x, -y, u1, v2);
+        addVertex(x + advance, -y, u2, v2);
+        addVertex(x + advance, y, u2, v1);
+        addVertex(x, y, u1, v1);
+
+        buffer->addIndex(index + 0);
+        buffer->addIndex(index + 1);
+        buffer->addIndex(index + 2);
+
+        buffer->addIndex(index + 0);
+        buffer->addIndex(index + 2);
+        buffer->addIndex(index + 3);
+
+        index += 4;
+        x += advance;
+    }
+    return index;
+}
+
+bool LabelStyle::prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
+                         enum GlBuffer::BufferType type)
+{
+    if (!SimpleVectorStyle::prepare(msMatrix, vsMatrix, type))
+        return false;
+
+    if(m_font && !m_font->bound()) {
+        m_font->bind();
+    }
+    float scale = m_size / m_glyphHeight;
+    m_program->setInt(GlProgram::U_TEXTURE, 0);
+    m_program->setFloat(GlProgram::U_LINE_WIDTH, 1.0f);
+    m_program->setFloat(GlProgram::U_SIZE,
+                       std::min(LABEL_SDF_SMOOTHING / scale, 0.5f));
+    m_program->setVertexAttribPointer(GlProgram::A_POSITION, 3, 7 * sizeof(float), nullptr);
+    m_program->setVertexAttribPointer(GlProgram::A_NORMAL, 2, 7 * sizeof(float),
+                            reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
+    m_program->setVertexAttribPointer(GlProgram::A_TEX_COORD, 2, 7 * sizeof(float),
+                            reinterpret_cast<const GLvoid*>(5 * sizeof(float)));
+
+    return true;
+}
+
+void LabelStyle::draw(const GlBuffer &buffer) const
+{
+    if(!m_font || !m_font->bound())
+        return;
+
+    Style::draw(buffer);
+
+    GlState::activeTexture(GL_TEXTURE0);
+    m_font->rebind();
+
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, buffer.drawCount(),
+                                   buffer.indexType(), buffer.drawOffset()));
+}
+
+bool LabelStyle::load(const CPLJSONObject &store)
+{
+    if(!SimpleVectorStyle::load(store))
+        return false;
+    setFont(store.GetString("font", ""),
+            static_cast<unsigned char>(store.GetInteger("glyph_width", 16)),
+            static_cast<unsigned char>(store.GetInteger("glyph_height", 16)),
+            static_cast<unsigned int>(store.GetInteger("first_glyph", 32)));
+    m_size = static_cast<float>(store.GetDouble("size", 12.0));
+    return true;
+}
+
+CPLJSONObject LabelStyle::save() const
+{
+    CPLJSONObject out = SimpleVectorStyle::save();
+    out.Add("font", m_fontName);
+    out.Add("glyph_width", m_glyphWidth);
+    out.Add("glyph_height", m_glyphHeight);
+    out.Add("first_glyph", static_cast<int>(m_firstGlyph));
+    out.Add("size", static_cast<double>(m_size));
+    return out;
+}
+
 //------------------------------------------------------------------------------
 // MarkerLocationStyle
 //------------------------------------------------------------------------------
@@ -1796,4 +2640,24 @@ void SimpleLocationStyle::setStatus(enum LocationStyle::Status status)
     ngsUnused(status);
 }
 
+/**
+ * @brief Style::loadPrograms Load programs of all style shaders to the
+ * program cache, so styles do not compile shaders on first draw. Run in GL
+ * context.
+ */
+void Style::loadPrograms()
+{
+    const GLchar * const shaders[][2] = {
+        { pointVertexShaderSource, pointFragmentShaderSource },
+        { lineVertexShaderSource, lineFragmentShaderSource },
+        { fillVertexShaderSource, fillFragmentShaderSource },
+        { imageVertexShaderSource, imageFragmentShaderSource },
+        { markerVertexShaderSource, markerFragmentShaderSource },
+        { markerVertexShaderSource, labelFragmentShaderSource }
+    };
+    for(const auto &shader : shaders) {
+        GlProgramCache::instance().program(shader[0], shader[1]);
+    }
+}
+
 } // namespace ngs
@@ -30,8 +30,10 @@
 #include "buffer.h"
 #include "image.h"
 #include "program.h"
+#include "tile.h"
 
 #include "ds/geometry.h"
+#include "map/styleexpression.h"
 #include "ngstore/api.h"
 
 namespace ngs
@@ -42,6 +44,12 @@ typedef std::map<std::string, GlImagePtr> TextureAtlas;
 // Style
 //------------------------------------------------------------------------------
 
+/**
+ * @brief StyleClass Values of data driven style properties shared by the group
+ * of tile items. Values are appended by Style::evaluate in properties order.
+ */
+using StyleClass = std::vector<float>;
+
 class Style : public GlObject
 {
 public:
@@ -61,16 +69,27 @@ public:
     virtual std::string name() const = 0;
     virtual enum ngsStyleType type() const { return m_styleType; }
 
+    // Data driven properties
+    virtual bool isDataDriven() const { return false; }
+    virtual bool isFeatureDependent() const { return false; }
+    virtual void evaluate(ExpressionContext &/*context*/,
+                          StyleClass &/*out*/) const {}
+    virtual size_t applyClass(const StyleClass &/*values*/, size_t offset) {
+        return offset;
+    }
+    virtual void resetClass() {}
+
     //static
 public:
     static Style *createStyle(const std::string &name, const TextureAtlas &atlas);
+    static void loadPrograms();
 
 
     // GlObject interface
 public:
     virtual void bind() override {}
     virtual void rebind() const override {}
-    virtual void destroy() override { m_program.destroy(); } // NOTE: Destroy only style stored GlObjects (i.e. program)
+    virtual void destroy() override { m_program.reset(); } // NOTE: Release only style stored GlObjects (i.e. shared program)
 
 protected:
     virtual const GLchar *shaderSource(enum ShaderType type);
@@ -78,7 +97,7 @@ protected:
 protected:
     const GLchar *m_vertexShaderSource;
     const GLchar *m_fragmentShaderSource;
-    GlProgram m_program;
+    GlProgramPtr m_program;
     enum ngsStyleType m_styleType;
 };
 
@@ -102,9 +121,24 @@ public:
                          enum GlBuffer::BufferType type) override;
     virtual bool load(const CPLJSONObject &store) override;
     virtual CPLJSONObject save() const override;
+    virtual bool isDataDriven() const override;
+    virtual bool isFeatureDependent() const override;
+    virtual void evaluate(ExpressionContext &context,
+                          StyleClass &out) const override;
+    virtual size_t applyClass(const StyleClass &values, size_t offset) override;
+    virtual void resetClass() override;
+
+protected:
+    const GlColor &drawColor() const {
+        return m_classApplied ? m_classColor : m_color;
+    }
 
 protected:
     GlColor m_color;
+    StyleExpressionPtr m_colorExpression;
+    // Values of the style class being drawn
+    GlColor m_classColor;
+    bool m_classApplied;
 };
 
 //------------------------------------------------------------------------------
@@ -134,20 +168,30 @@ public:
     float rotation() const { return m_rotation; }
     void setRotation(float rotation) { m_rotation = rotation; }
 
-    virtual unsigned short addPoint(const SimplePoint &pt, float z,
-                                    unsigned short index,
-                                    GlBuffer *buffer) = 0;
+    virtual GLuint addPoint(const SimplePoint &pt, float z,
+                            GLuint index,
+                            GlBuffer *buffer) = 0;
     virtual size_t pointVerticesCount() const = 0;
 
     // Style interface
 public:
     virtual bool load(const CPLJSONObject &store) override;
     virtual CPLJSONObject save() const override;
+    virtual bool isDataDriven() const override;
+    virtual bool isFeatureDependent() const override;
+    virtual void evaluate(ExpressionContext &context,
+                          StyleClass &out) const override;
+    virtual size_t applyClass(const StyleClass &values, size_t offset) override;
+
+protected:
+    float drawSize() const { return m_classApplied ? m_classSize : m_size; }
 
 protected:
     enum PointType m_type;
     float m_size;
     float m_rotation;
+    StyleExpressionPtr m_sizeExpression;
+    float m_classSize;
 };
 
 using PointStylePtr = std::shared_ptr<PointStyle>;
@@ -163,9 +207,9 @@ public:
 
     // PointStyle interface
 public:
-    virtual unsigned short addPoint(const SimplePoint &pt, float z,
-                                    unsigned short index,
-                                    GlBuffer *buffer) override;
+    virtual GLuint addPoint(const SimplePoint &pt, float z,
+                            GLuint index,
+                            GlBuffer *buffer) override;
     virtual size_t pointVerticesCount() const override { return 3; }
     virtual enum GlBuffer::BufferType bufferType() const override {
         return GlBuffer::BF_PT;
@@ -196,13 +240,11 @@ public:
     // PointStyle interface
 public:
     virtual void setType(enum PointType type) override;
-    virtual unsigned short addPoint(const SimplePoint &pt, float z,
-                                    unsigned short index,
-                                    GlBuffer *buffer) override;
+    virtual GLuint addPoint(const SimplePoint &pt, float z,
+                            GLuint index,
+                            GlBuffer *buffer) override;
     virtual size_t pointVerticesCount() const override;
-    virtual enum GlBuffer::BufferType bufferType() const override {
-        return GlBuffer::BF_FILL;
-    }
+    virtual enum GlBuffer::BufferType bufferType() const override;
 
     // Style interface
 public:
@@ -213,9 +255,17 @@ public:
     virtual CPLJSONObject save() const override;
     virtual std::string name() const override { return "primitivePoint"; }
 
+    // GlObject interface
+public:
+    virtual void destroy() override;
+
+protected:
+    float pointSpriteSize() const;
+
 protected:
     unsigned char m_segmentCount;
     unsigned char m_starEndsCount;
+    SimplePointStyle m_pointSprite;
 };
 
 //------------------------------------------------------------------------------
@@ -248,16 +298,16 @@ public:
     unsigned char segmentCount() const;
     void setSegmentCount(unsigned char segmentCount);
 
-    unsigned short addLineCap(const SimplePoint &point, const Normal &normal,
-                              float z, unsigned short index, GlBuffer *buffer);
+    GLuint addLineCap(const SimplePoint &point, const Normal &normal,
+                      float z, GLuint index, GlBuffer *buffer);
     size_t lineCapVerticesCount() const;
-    unsigned short addLineJoin(const SimplePoint &point, const Normal &prevNormal,
-                               const Normal &normal, float z, unsigned short index,
-                               GlBuffer *buffer);
+    GLuint addLineJoin(const SimplePoint &point, const Normal &prevNormal,
+                       const Normal &normal, float z, GLuint index,
+                       GlBuffer *buffer);
     size_t lineJoinVerticesCount() const;
-    virtual unsigned short addSegment(const SimplePoint &pt1, const SimplePoint &pt2,
+    virtual GLuint addSegment(const SimplePoint &pt1, const SimplePoint &pt2,
                               const Normal &normal, float z,
-                              unsigned short index, GlBuffer *buffer);
+                              GLuint index, GlBuffer *buffer);
 
     // SimpleVectorStyle
 public:
@@ -273,12 +323,19 @@ public:
     virtual bool load(const CPLJSONObject &store) override;
     virtual CPLJSONObject save() const override;
     virtual std::string name() const override { return "simpleLine"; }
+    virtual bool isDataDriven() const override;
+    virtual bool isFeatureDependent() const override;
+    virtual void evaluate(ExpressionContext &context,
+                          StyleClass &out) const override;
+    virtual size_t applyClass(const StyleClass &values, size_t offset) override;
 
 protected:
     GLint m_normalId;
     GLint m_vLineWidthId;
 
     float m_width;
+    StyleExpressionPtr m_widthExpression;
+    float m_classWidth;
     enum CapType m_capType;
     enum JoinType m_joinType;
     unsigned char m_segmentCount;
@@ -338,12 +395,53 @@ public:
     virtual bool load(const CPLJSONObject &store) override;
     virtual CPLJSONObject save() const override;
     virtual std::string name() const override { return "simpleFillBordered"; }
+    virtual bool isDataDriven() const override;
+    virtual bool isFeatureDependent() const override;
+    virtual void evaluate(ExpressionContext &context,
+                          StyleClass &out) const override;
+    virtual size_t applyClass(const StyleClass &values, size_t offset) override;
+    virtual void resetClass() override;
 
 protected:
     SimpleFillStyle m_fill;
     SimpleLineStyle m_line;
 };
 
+//------------------------------------------------------------------------------
+// MixedStyle
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The MixedStyle class Style of layer with points, lines and polygons.
+ * Tile items of each geometry type are filled and drawn with own sub-style.
+ */
+class MixedStyle : public Style
+{
+public:
+    explicit MixedStyle(const TextureAtlas &textureAtlas);
+    StylePtr style(enum ngsStyleType type) const;
+    bool setStyleName(enum ngsStyleType type, const std::string &name);
+
+    // Style interface
+public:
+    virtual bool prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
+                         enum GlBuffer::BufferType type) override;
+    virtual void draw(const GlBuffer &buffer) const override;
+    virtual bool load(const CPLJSONObject &store) override;
+    virtual CPLJSONObject save() const override;
+    virtual std::string name() const override { return "mixed"; }
+    virtual bool isDataDriven() const override;
+    virtual bool isFeatureDependent() const override;
+
+    // GlObject interface
+public:
+    virtual void destroy() override;
+
+protected:
+    TextureAtlas m_textureAtlas;
+    StylePtr m_point, m_line, m_fill;
+};
+
 //------------------------------------------------------------------------------
 // SimpleImageStyle
 //------------------------------------------------------------------------------
@@ -385,9 +483,9 @@ public:
 public:
     virtual void setType(enum PointType type) override;
     virtual size_t pointVerticesCount() const override { return 4; }
-    virtual unsigned short addPoint(const SimplePoint &pt, float z,
-                                    unsigned short index,
-                                    GlBuffer *buffer) override;
+    virtual GLuint addPoint(const SimplePoint &pt, float z,
+                            GLuint index,
+                            GlBuffer *buffer) override;
     virtual enum GlBuffer::BufferType bufferType() const override {
         return GlBuffer::BF_TEX;
     }
@@ -413,6 +511,110 @@ protected:
     float m_ulx, m_uly, m_lrx, m_lry;
 };
 
+//------------------------------------------------------------------------------
+// HeatmapStyle
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The HeatmapStyle class Draws points density. Points are drawn as
+ * kernel sprites of size radius summed in the density frame, then the frame
+ * is drawn to the tile through the color ramp. Tile image is rendered once, so
+ * the density is summed again only if tiles are rendered again, i.e. on zoom
+ * change.
+ */
+class HeatmapStyle : public PointStyle
+{
+public:
+    HeatmapStyle();
+    float intensity() const { return m_intensity; }
+    void setIntensity(float intensity) { m_intensity = intensity; }
+    void setColorRamp(const std::vector<ColorRampStop> &stops);
+    void beginDensity(GLsizei tileSize);
+    void endDensity();
+
+    // PointStyle interface
+public:
+    virtual GLuint addPoint(const SimplePoint &pt, float z,
+                            GLuint index,
+                            GlBuffer *buffer) override;
+    virtual size_t pointVerticesCount() const override { return 1; }
+    virtual enum GlBuffer::BufferType bufferType() const override {
+        return GlBuffer::BF_PT;
+    }
+
+    // Style interface
+public:
+    virtual bool prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
+                         enum GlBuffer::BufferType type) override;
+    virtual void draw(const GlBuffer &buffer) const override;
+    virtual bool load(const CPLJSONObject &store) override;
+    virtual CPLJSONObject save() const override;
+    virtual std::string name() const override { return "heatmap"; }
+
+    // GlObject interface
+public:
+    virtual void destroy() override;
+
+protected:
+    float m_intensity;
+    ColorRamp m_colorRamp;
+    bool m_rampChanged;
+    GlImage m_ramp;
+    GlDensityFrame m_density;
+    GLint m_targetFramebuffer;
+    GlProgramPtr m_rampProgram;
+};
+
+//------------------------------------------------------------------------------
+// LabelStyle
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The LabelStyle class Labels drawn from a signed distance field glyph
+ * atlas. The atlas is an icon set with glyphs of one size in rows, the first
+ * glyph in the atlas has the firstGlyph code point.
+ */
+class LabelStyle : public SimpleVectorStyle
+{
+public:
+    explicit LabelStyle(const TextureAtlas &textureAtlas);
+    void setFont(const std::string &fontName, unsigned char glyphWidth,
+                 unsigned char glyphHeight, unsigned int firstGlyph);
+    const CPLString &fontName() const { return m_fontName; }
+    void setSize(float size) { m_size = size; }
+    float size() const { return m_size; }
+    OGRRawPoint labelSize(size_t glyphCount) const;
+    size_t labelVerticesCount(size_t glyphCount) const { return glyphCount * 4; }
+    GLuint addLabel(const SimplePoint &pt, const std::vector<unsigned int> &glyphs,
+                    GLuint index, GlBuffer *buffer) const;
+
+    // SimpleVectorStyle
+public:
+    virtual enum GlBuffer::BufferType bufferType() const override {
+        return GlBuffer::BF_TEX;
+    }
+
+    // Style interface
+public:
+    virtual bool prepare(const glm::mat4 &msMatrix, const glm::mat4 &vsMatrix,
+                         enum GlBuffer::BufferType type) override;
+    virtual void draw(const GlBuffer &buffer) const override;
+    virtual bool load(const CPLJSONObject &store) override;
+    virtual CPLJSONObject save() const override;
+    virtual std::string name() const override { return "label"; }
+
+protected:
+    GlImage *m_font;
+    CPLString m_fontName;
+    unsigned char m_glyphWidth;
+    unsigned char m_glyphHeight;
+    unsigned int m_firstGlyph;
+    float m_size;
+    TextureAtlas m_textureAtlas;
+};
+
+using LabelStylePtr = std::shared_ptr<LabelStyle>;
+
 //------------------------------------------------------------------------------
 // LocationStyle
 //------------------------------------------------------------------------------
@@ -25,11 +25,22 @@
 
 namespace ngs {
 
+// Tile depth renderbuffer is GL_DEPTH_COMPONENT16
+static size_t depthSize(unsigned short tileSize)
+{
+    return static_cast<size_t>(tileSize) * tileSize * 2;
+}
+
 GlTile::GlTile(const GlTile other, bool initNew) : GlObject(),
     m_tileItem(other.m_tileItem),
     m_id(0),
     m_did(0),
-    m_filled(false)
+    m_filled(false),
+    m_outdated(false),
+    m_dirty(false),
+    m_prefetched(false),
+    m_drawNumber(0),
+    m_generation(0)
 {
     ngsUnused(initNew);
     m_originalTileSize = other.m_originalTileSize;
@@ -42,7 +53,12 @@ GlTile::GlTile(unsigned short tileSize, const TileItem &tileItem) : GlObject(),
     m_tileItem(tileItem),
     m_id(0),
     m_did(0),
-    m_filled(false)
+    m_filled(false),
+    m_outdated(false),
+    m_dirty(false),
+    m_prefetched(false),
+    m_drawNumber(0),
+    m_generation(0)
 {
     m_originalTileSize = tileSize;
     m_originalEnv = tileItem.env;
@@ -126,6 +142,7 @@ void GlTile::bind()
     ngsCheckGLError(glFramebufferRenderbuffer(GL_FRAMEBUFFER,
                                               GL_DEPTH_ATTACHMENT,
                                               GL_RENDERBUFFER, m_did));
+    glStats().textureMemory += static_cast<long long>(depthSize(m_tileSize));
 
     ngsCheckGLError(glCheckFramebufferStatus(GL_FRAMEBUFFER));
 
@@ -153,35 +170,220 @@ void GlTile::destroy()
     if (m_bound) {
         ngsCheckGLError(glDeleteRenderbuffers(1, &m_did));
         ngsCheckGLError(glDeleteFramebuffers(1, &m_id));
+        glStats().textureMemory -= static_cast<long long>(depthSize(m_tileSize));
+        m_bound = false;
     }
     m_image.destroy();
     m_tile.destroy();
 }
 
+size_t GlTile::memorySize() const
+{
+    if(!m_bound) {
+        return 0;
+    }
+    return depthSize(m_tileSize) + m_image.memorySize() + m_tile.memorySize();
+}
+
+/**
+ * @brief GlTile::prepareContext Set GL state to draw tile items. Executed for
+ * each tile, but the state is set only once per frame by GlState.
+ */
 void GlTile::prepareContext()
 {
     #ifdef GL_PROGRAM_POINT_SIZE_EXT
-        ngsCheckGLError(glEnable(GL_PROGRAM_POINT_SIZE_EXT));
+        GlState::setEnabled(GL_PROGRAM_POINT_SIZE_EXT, true);
     #endif
 
     #ifdef GL_MULTISAMPLE
         if(CPLTestBool(CPLGetConfigOption("GL_MULTISAMPLE", "OFF")))
-            ngsCheckGLError(glEnable(GL_MULTISAMPLE));
+            GlState::setEnabled(GL_MULTISAMPLE, true);
     #endif
 
     // NOTE: In usual cases no need in depth test
     //    ngsCheckGLError(glDisable(GL_DEPTH_TEST));
-        ngsCheckGLError(glEnable(GL_DEPTH_TEST));
+        GlState::setEnabled(GL_DEPTH_TEST, true);
     //    ngsCheckGLError(glDepthMask(GL_TRUE));
-        ngsCheckGLError(glDepthFunc(GL_LEQUAL));
-        ngsCheckGLError(glDepthRange(0.0, 1.0));
+        GlState::depthFunc(GL_LEQUAL);
+        GlState::depthRange(0.0f, 1.0f);
     #ifdef GL_POLYGON_SMOOTH_HINT
-        ngsCheckGLError(glHint(GL_POLYGON_SMOOTH_HINT, GL_NICEST));
+        GlState::hint(GL_POLYGON_SMOOTH_HINT, GL_NICEST);
     #endif
     #ifdef GL_LINE_SMOOTH_HINT
-        ngsCheckGLError(glHint(GL_LINE_SMOOTH_HINT, GL_NICEST));
+        GlState::hint(GL_LINE_SMOOTH_HINT, GL_NICEST);
     #endif
         //    ngsCheckGLError(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
 }
 
+//------------------------------------------------------------------------------
+// GlFrame
+//------------------------------------------------------------------------------
+
+GlFrame::GlFrame() : GlObject(),
+    m_id(0),
+    m_width(0),
+    m_height(0),
+    m_valid(false)
+{
+    // Full viewport quad in clip coordinates
+    const float vertices[] = { -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+                               -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+                                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+                                1.0f, -1.0f, 0.0f, 1.0f, 0.0f };
+    for(float vertex : vertices) {
+        m_frame.addVertex(vertex);
+    }
+    const GLuint indices[] = { 0, 1, 2, 0, 2, 3 };
+    for(GLuint index : indices) {
+        m_frame.addIndex(index);
+    }
+}
+
+/**
+ * @brief GlFrame::resize Set frame size equal to view size. On size change
+ * the framebuffer is recreated on next bind.
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ */
+void GlFrame::resize(GLsizei width, GLsizei height)
+{
+    if(m_width == width && m_height == height) {
+        return;
+    }
+    if(m_bound) {
+        ngsCheckGLError(glDeleteFramebuffers(1, &m_id));
+        m_image.destroy();
+        m_bound = false;
+    }
+    m_width = width;
+    m_height = height;
+    m_valid = false;
+}
+
+void GlFrame::bind()
+{
+    if (m_bound)
+        return;
+
+    ngsCheckGLError(glGenFramebuffers(1, &m_id));
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER, m_id));
+    m_image.setImage(nullptr, m_width, m_height);
+    m_image.bind();
+    ngsCheckGLError(glFramebufferTexture2D(GL_FRAMEBUFFER,
+                                           GL_COLOR_ATTACHMENT0,
+                                           GL_TEXTURE_2D, m_image.id(), 0));
+    ngsCheckGLError(glCheckFramebufferStatus(GL_FRAMEBUFFER));
+
+    m_frame.bind();
+
+    m_bound = true;
+}
+
+void GlFrame::rebind() const
+{
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER, m_id));
+}
+
+void GlFrame::destroy()
+{
+    if (m_bound) {
+        ngsCheckGLError(glDeleteFramebuffers(1, &m_id));
+        m_bound = false;
+    }
+    m_image.destroy();
+    m_frame.destroy();
+    m_valid = false;
+}
+
+//------------------------------------------------------------------------------
+// GlDensityFrame
+//------------------------------------------------------------------------------
+
+GlDensityFrame::GlDensityFrame() : GlObject(),
+    m_id(0),
+    m_textureId(0),
+    m_size(0)
+{
+    // Full viewport quad in clip coordinates
+    const float vertices[] = { -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+                               -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+                                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+                                1.0f, -1.0f, 0.0f, 1.0f, 0.0f };
+    for(float vertex : vertices) {
+        m_frame.addVertex(vertex);
+    }
+    const GLuint indices[] = { 0, 1, 2, 0, 2, 3 };
+    for(GLuint index : indices) {
+        m_frame.addIndex(index);
+    }
+}
+
+/**
+ * @brief GlDensityFrame::resize Set frame size equal to tile size. On size
+ * change the framebuffer is recreated on next bind.
+ * @param size Frame width and height in pixels
+ */
+void GlDensityFrame::resize(GLsizei size)
+{
+    if(m_size == size) {
+        return;
+    }
+    if(m_bound) {
+        ngsCheckGLError(glDeleteFramebuffers(1, &m_id));
+        GlState::forgetTexture(m_textureId);
+        ngsCheckGLError(glDeleteTextures(1, &m_textureId));
+        m_bound = false;
+    }
+    m_size = size;
+}
+
+void GlDensityFrame::bind()
+{
+    if (m_bound)
+        return;
+
+    GLenum type = GL_UNSIGNED_BYTE;
+#ifdef GL_HALF_FLOAT_OES
+    if(isHalfFloatTargetSupported()) {
+        type = GL_HALF_FLOAT_OES;
+    }
+#endif // GL_HALF_FLOAT_OES
+
+    ngsCheckGLError(glGenTextures(1, &m_textureId));
+    GlState::bindTexture(m_textureId);
+    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    ngsCheckGLError(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    ngsCheckGLError(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_size, m_size, 0,
+                                 GL_RGBA, type, nullptr));
+
+    ngsCheckGLError(glGenFramebuffers(1, &m_id));
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER, m_id));
+    ngsCheckGLError(glFramebufferTexture2D(GL_FRAMEBUFFER,
+                                           GL_COLOR_ATTACHMENT0,
+                                           GL_TEXTURE_2D, m_textureId, 0));
+    ngsCheckGLError(glCheckFramebufferStatus(GL_FRAMEBUFFER));
+
+    m_frame.bind();
+
+    m_bound = true;
+}
+
+void GlDensityFrame::rebind() const
+{
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER, m_id));
+}
+
+void GlDensityFrame::destroy()
+{
+    if (m_bound) {
+        ngsCheckGLError(glDeleteFramebuffers(1, &m_id));
+        GlState::forgetTexture(m_textureId);
+        ngsCheckGLError(glDeleteTextures(1, &m_textureId));
+        m_bound = false;
+    }
+    m_frame.destroy();
+}
+
 } // namespace ngs
@@ -21,6 +21,9 @@
 #ifndef NGSGLTILE_H
 #define NGSGLTILE_H
 
+// gdal
+#include "cpl_atomic_ops.h"
+
 #include "buffer.h"
 #include "image.h"
 #include "ds/geometry.h"
@@ -51,10 +54,42 @@ public:
     const Envelope &getExtent() const { return m_tileItem.env; }
     bool filled() const { return m_filled; }
     void setFilled(bool filled = true) { m_filled = filled; }
+    /**
+     * @brief outdated Tile image does not match layers data any more and can
+     * only be drawn until replacement tile is filled.
+     */
+    bool outdated() const { return m_outdated; }
+    void setOutdated() { m_outdated = true; }
+    /**
+     * @brief dirty Some layers data of filled tile is refilling. Tile image is
+     * drawn as is until all layers have data, than tile is rendered again.
+     */
+    bool dirty() const { return m_dirty; }
+    void setDirty(bool dirty = true) { m_dirty = dirty; }
+    /**
+     * @brief prefetched Layers data of tile was filled in advance while fill
+     * pool was idle, so only layers without data need fill.
+     */
+    bool prefetched() const { return m_prefetched; }
+    void setPrefetched(bool prefetched = true) { m_prefetched = prefetched; }
+    /**
+     * @brief cancel Cancel all fill jobs started for this tile.
+     */
+    void cancel() { CPLAtomicInc(&m_generation); }
+    CancelToken cancelToken(int generation) const {
+        return CancelToken(&m_generation, generation);
+    }
+    int generation() const { return m_generation; }
     size_t getSizeInPixels() const {
         return size_t(m_originalTileSize);///*m_image.getWidth()*/ * 256.0 / GLTILE_SIZE);
     }
     unsigned short tileSize() const { return  m_tileSize; }
+    /**
+     * @brief drawNumber Number of the view draw call the tile was last shown
+     * in, 0 if it was never shown.
+     */
+    unsigned int drawNumber() const { return m_drawNumber; }
+    void setDrawNumber(unsigned int drawNumber) { m_drawNumber = drawNumber; }
 
     static void prepareContext();
 
@@ -63,6 +98,7 @@ public:
     virtual void bind() override;
     virtual void rebind() const override;
     virtual void destroy() override;
+    virtual size_t memorySize() const override;
 
 protected:
     void init(unsigned short tileSize, const Envelope& tileItemEnv,
@@ -76,12 +112,81 @@ protected:
     glm::mat4 m_sceneMatrix;
     glm::mat4 m_invViewMatrix;
     bool m_filled;
+    bool m_outdated;
+    bool m_dirty;
+    bool m_prefetched;
+    unsigned int m_drawNumber;
     unsigned short m_tileSize, m_originalTileSize;
     Envelope m_originalEnv;
+    volatile int m_generation;
 };
 
 typedef std::shared_ptr<GlTile> GlTilePtr;
 
+/**
+ * @brief The GlFrame class Off-screen frame with composed map tiles. Used to
+ * draw the map without tiles when only overlays changed.
+ */
+class GlFrame : public GlObject
+{
+public:
+    GlFrame();
+    virtual ~GlFrame() override = default;
+
+    GlImage *getImageRef() const { return const_cast<GlImage*>(&m_image); }
+    const GlBuffer &getBuffer() const { return m_frame; }
+    void resize(GLsizei width, GLsizei height);
+    bool valid(const glm::mat4 &sceneMatrix) const {
+        return m_valid && m_sceneMatrix == sceneMatrix;
+    }
+    void setValid(const glm::mat4 &sceneMatrix) {
+        m_sceneMatrix = sceneMatrix;
+        m_valid = true;
+    }
+    void invalidate() { m_valid = false; }
+
+    // GlObject interface
+public:
+    virtual void bind() override;
+    virtual void rebind() const override;
+    virtual void destroy() override;
+
+protected:
+    GlImage m_image;
+    GLuint m_id;
+    GlBuffer m_frame;
+    GLsizei m_width, m_height;
+    glm::mat4 m_sceneMatrix;
+    bool m_valid;
+};
+
+/**
+ * @brief The GlDensityFrame class Off-screen tile size frame to sum heatmap
+ * kernels with additive blending. Half float texture is used if GL context can
+ * render to it, otherwise 8 bit one.
+ */
+class GlDensityFrame : public GlObject
+{
+public:
+    GlDensityFrame();
+    virtual ~GlDensityFrame() override = default;
+
+    GLuint textureId() const { return m_textureId; }
+    const GlBuffer &getBuffer() const { return m_frame; }
+    void resize(GLsizei size);
+
+    // GlObject interface
+public:
+    virtual void bind() override;
+    virtual void rebind() const override;
+    virtual void destroy() override;
+
+protected:
+    GLuint m_id, m_textureId;
+    GlBuffer m_frame;
+    GLsizei m_size;
+};
+
 } // namespace ngs
 
 #endif // NGSGLTILE_H
@@ -21,17 +21,63 @@
 
 #include "view.h"
 
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
 #include "ds/featureclassovr.h"
 #include "layer.h"
 #include "style.h"
 #include "map/overlay.h"
 #include "overlay.h"
 #include "util/error.h"
+#include "util/memorybudget.h"
+#include "util/trace.h"
 
 namespace ngs {
 
 constexpr unsigned char MAX_TRIES = 2;
 constexpr const char* SELECTION_KEY = "selection";
+// Prefetch jobs go after all jobs of visible tiles
+constexpr double PREFETCH_PRIORITY = 1000000.0;
+constexpr long long MB = 1024 * 1024;
+constexpr int DEFAULT_PREFETCH_MEMORY_LIMIT = 128; // Mb
+constexpr int DEFAULT_TILE_MEMORY_LIMIT = 0; // Mb, unlimited
+// Offscreen draw waits for tiles fill, in seconds
+constexpr double OFFSCREEN_DRAW_TIMEOUT = 60.0;
+constexpr int OFFSCREEN_DRAW_WAIT = 10; // ms
+// Invalidate all tiles including world copies
+constexpr Envelope WHOLE_EXTENT = Envelope(
+        -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+
+constexpr const GLchar * const layerVertexShaderSource = R"(
+    attribute vec3 a_mPosition;
+    attribute vec2 a_texCoord;
+    varying vec2 v_texCoord;
+
+    void main()
+    {
+        gl_Position = vec4(a_mPosition, 1);
+        v_texCoord = a_texCoord;
+    }
+)";
+
+// Layer frame colors are premultiplied by alpha
+constexpr const GLchar * const layerFragmentShaderSource = R"(
+    uniform sampler2D s_texture;
+    uniform float u_opacity;
+    varying vec2 v_texCoord;
+
+    void main()
+    {
+        gl_FragColor = texture2D(s_texture, v_texCoord) * u_opacity;
+    }
+)";
 
 //------------------------------------------------------------------------------
 // LayerFillData
@@ -39,12 +85,65 @@ constexpr const char* SELECTION_KEY = "selection";
 
 class LayerFillData : public ThreadData {
 public:
-    LayerFillData(GlTilePtr tile, LayerPtr layer, float z, bool own) :
-        ThreadData(own), m_tile(tile), m_layer(layer), m_zlevel(z) {
+    LayerFillData(GlTilePtr tile, LayerPtr layer, float z, bool own,
+                  double priority) :
+        ThreadData(own, priority), m_tile(tile), m_layer(layer), m_zlevel(z),
+        m_generation(tile->generation()),
+        m_created(std::chrono::steady_clock::now()) {
     }
     GlTilePtr m_tile;
     LayerPtr m_layer;
     float m_zlevel;
+    int m_generation;
+    std::chrono::steady_clock::time_point m_created;
+};
+
+//------------------------------------------------------------------------------
+// LayerTilesReadData
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The LayerTilesReadData class Tiles of one layer read at once before
+ * the tiles fill jobs.
+ */
+class LayerTilesReadData : public ThreadData {
+public:
+    LayerTilesReadData(const std::vector<GlTilePtr> &tiles, LayerPtr layer,
+                       bool own, double priority) :
+        ThreadData(own, priority), m_tiles(tiles), m_layer(layer) {
+        for(const GlTilePtr &tile : m_tiles) {
+            m_generations.push_back(tile->generation());
+        }
+    }
+    std::vector<GlTilePtr> m_tiles;
+    std::vector<int> m_generations;
+    LayerPtr m_layer;
+};
+
+//------------------------------------------------------------------------------
+// OffscreenProgress
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The OffscreenProgress class Catches draw progress to repeat offscreen
+ * draw until all tiles are rendered.
+ */
+class OffscreenProgress : public Progress {
+public:
+    OffscreenProgress() : m_finished(false), m_complete(0.0) {}
+    virtual bool onProgress(enum ngsCode status, double complete,
+                            const char *format, ...) const override {
+        ngsUnused(format);
+        m_finished = status == COD_FINISHED;
+        m_complete = complete;
+        return true;
+    }
+    bool finished() const { return m_finished; }
+    double complete() const { return m_complete; }
+
+private:
+    mutable bool m_finished;
+    mutable double m_complete;
 };
 
 //------------------------------------------------------------------------------
@@ -52,22 +151,43 @@ public:
 //------------------------------------------------------------------------------
 
 
-GlView::GlView() : MapView()
+GlView::GlView() : MapView(),
+    m_tileRangeRotate(0.0),
+    m_keepTileBuffers(false),
+    m_prefetch(true),
+    m_prefetchMemoryLimit(DEFAULT_PREFETCH_MEMORY_LIMIT * MB),
+    m_trimGeneration(MemoryBudget::instance().trimGeneration()),
+    m_tileMemoryLimit(DEFAULT_TILE_MEMORY_LIMIT * MB),
+    m_drawNumber(0),
+    m_programsLoaded(false)
 {
     initView();
 }
 
 GlView::GlView(const std::string &name, const std::string &description,
                unsigned short epsg, const Envelope &bounds) :
-    MapView(name, description, epsg, bounds)
+    MapView(name, description, epsg, bounds),
+    m_tileRangeRotate(0.0),
+    m_keepTileBuffers(false),
+    m_prefetch(true),
+    m_prefetchMemoryLimit(DEFAULT_PREFETCH_MEMORY_LIMIT * MB),
+    m_trimGeneration(MemoryBudget::instance().trimGeneration()),
+    m_tileMemoryLimit(DEFAULT_TILE_MEMORY_LIMIT * MB),
+    m_drawNumber(0),
+    m_programsLoaded(false)
 {
     initView();
 }
 
 void GlView::clearTiles()
 {
-    std::for_each(m_tiles.begin(), m_tiles.end(), [](GlTilePtr &tile){ tile->destroy(); });
+    m_threadPool.clearThreadData();
+    std::for_each(m_tiles.begin(), m_tiles.end(), [](GlTilePtr &tile){
+        tile->cancel();
+        tile->destroy();
+    });
     m_tiles.clear();
+    m_labels.clear();
 }
 
 void GlView::setBackgroundColor(const ngsRGBA &color)
@@ -77,20 +197,29 @@ void GlView::setBackgroundColor(const ngsRGBA &color)
     m_glBkColor.g = float(color.G) / 255;
     m_glBkColor.b = float(color.B) / 255;
     m_glBkColor.a = float(color.A) / 255;
+    m_frame.invalidate();
 }
 
 bool GlView::close()
 {
     freeOldTiles();
+    freePrefetchTiles();
     freeResources();
     clearTiles();
+    m_frame.destroy();
+    m_layerFrame.destroy();
+    m_layerProgram.reset();
+    GlBuffer::clearPool();
+    GlImage::clearPool();
+    GlProgramCache::instance().clear();
+    m_programsLoaded = false;
     return MapView::close();
 }
 
 // NOTE: Should be run on OpenGL current context
 void GlView::clearBackground()
 {
-    ngsCheckGLError(glClearColor(m_glBkColor.r, m_glBkColor.g, m_glBkColor.b, m_glBkColor.a));
+    GlState::clearColor(m_glBkColor);
     ngsCheckGLError(glClearDepth(1.0));
     ngsCheckGLError(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 }
@@ -123,22 +252,70 @@ LayerPtr GlView::createLayer(const std::string &name, Layer::Type type)
 
 bool GlView::layerDataFillJobThreadFunc(ThreadData* threadData)
 {
+    ngsTraceSpan("GlView::layerDataFill");
     LayerFillData *layerData = dynamic_cast<LayerFillData*>(threadData);
     if (nullptr != layerData) {
         GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer,layerData->m_layer);
         if (nullptr != renderLayer) {
-            return renderLayer->fill(layerData->m_tile, layerData->m_zlevel,
-                                     layerData->tries() >= MAX_TRIES);
+            const GlTilePtr &tile = layerData->m_tile;
+            CancelToken cancel = tile->cancelToken(layerData->m_generation);
+            bool result = renderLayer->fill(tile, layerData->m_zlevel,
+                                            layerData->tries() >= MAX_TRIES,
+                                            cancel);
+            if(result && !cancel.isCanceled()) {
+                renderLayer->addFillLatency(
+                            std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() -
+                                layerData->m_created).count());
+            }
+            return result;
+        }
+    }
+
+    LayerTilesReadData *readData = dynamic_cast<LayerTilesReadData*>(threadData);
+    if(nullptr != readData) {
+        GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, readData->m_layer);
+        if(nullptr != renderLayer) {
+            // Removed tiles are not read
+            std::vector<GlTilePtr> tiles;
+            for(size_t i = 0; i < readData->m_tiles.size(); ++i) {
+                const GlTilePtr &tile = readData->m_tiles[i];
+                if(!tile->cancelToken(readData->m_generations[i]).isCanceled()) {
+                    tiles.push_back(tile);
+                }
+            }
+            renderLayer->readTiles(tiles);
         }
     }
 
 	return true;
 }
 
+bool GlView::layerDataFillJobFilter(const ThreadData *threadData, void *tiles)
+{
+    const LayerFillData *layerData = dynamic_cast<const LayerFillData*>(threadData);
+    const std::vector<GlTilePtr> *removeTiles =
+            static_cast<const std::vector<GlTilePtr>*>(tiles);
+    if(nullptr == layerData || nullptr == removeTiles) {
+        return false;
+    }
+
+    return std::find(removeTiles->begin(), removeTiles->end(),
+                     layerData->m_tile) != removeTiles->end();
+}
+
 bool GlView::draw(ngsDrawState state, const Progress &progress)
 {
+    ngsTraceSpan("GlView::draw");
     // Prepare
     prepareContext();
+    resetGlFrameStats();
+    if(!m_programsLoaded) {
+        // Compile or load from binaries all style programs at once, so
+        // styles and layers added later do not stall the frame
+        Style::loadPrograms();
+        m_programsLoaded = true;
+    }
 
 #ifdef NGS_GL_DEBUG
 
@@ -163,34 +340,100 @@ bool GlView::draw(ngsDrawState state, const Progress &progress)
         return true;
     }
 
+    // Tiles are not touched, so frequent location updates cost the frame quad
+    // and overlays only
+    if(state == DS_OVERLAY_ONLY) {
+        if(drawPreserved()) {
+            freeResources();
+            progress.onProgress(COD_FINISHED, 1.0, _("Map render finished."));
+            return true;
+        }
+        state = DS_PRESERVED;
+    }
+
+    if(state == DS_RESTYLE) {
+        if(m_keepTileBuffers) {
+            // Line width and colors are applied in shaders, so layers buffers
+            // are drawn to tiles with the new style as is. Buffers freed to
+            // fit the tile memory limit are refilled first.
+            for(GlTilePtr& tile : m_tiles) {
+                if(!tile->filled() || hasLayersData(tile)) {
+                    tile->setFilled(false);
+                    continue;
+                }
+                tile->setDirty();
+                for(const LayerPtr &layer : m_layers) {
+                    GlRenderLayer *renderLayer =
+                            ngsDynamicCast(GlRenderLayer, layer);
+                    if(renderLayer && !renderLayer->hasData(tile)) {
+                        m_layerRefills.push_back({tile, layer});
+                    }
+                }
+            }
+            m_frame.invalidate();
+            state = DS_PRESERVED;
+        }
+        else {
+            state = DS_REFILL;
+        }
+    }
+
+    // Finished fills are moved to layers once per frame
+    for(const LayerPtr &layer : m_layers) {
+        GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
+        if(renderLayer) {
+            renderLayer->applyFills();
+        }
+    }
+
+    // Layers which datasources were opened after map open are refilled
+    for(const LayerPtr &layer : takeBoundLayers()) {
+        if(std::find(m_layers.begin(), m_layers.end(), layer) !=
+                m_layers.end()) {
+            invalidateLayer(WHOLE_EXTENT, layer);
+        }
+    }
+
+    // Invalidated layers data is freed in Gl context before refill
+    refillLayers();
+
     switch (state) {
+    case DS_RESTYLE: // Handled above
+    case DS_OVERLAY_ONLY:
     case DS_NOTHING: // Pleased compiler
         progress.onProgress(COD_FINISHED, 1.0, _("Nothing to render."));
         return true;
     case DS_REDRAW:
+        freeLayersData(m_tiles);
         clearTiles();
     [[clang::fallthrough]]; case DS_REFILL:
+        freeLayersData(m_tiles);
+        freePrefetchTiles();
+        m_layerRefills.clear();
         for(GlTilePtr& tile : m_tiles) {
+            tile->cancel();
             tile->setFilled(false);
+            tile->setDirty(false);
         }
     [[clang::fallthrough]]; case DS_NORMAL:
         // Get tiles for extent and mark to delete out of bounds tiles
         updateTilesList();
         // Start load layers data for tiles
         m_threadPool.clearThreadData();
-        for(const GlTilePtr& tile : m_tiles) {
-            if(tile->filled())
-                continue;
-            float z = 0.0f;
-            for(auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend();
-                 ++layerIt) {
-                const LayerPtr &layer = *layerIt;
-                m_threadPool.addThreadData(new LayerFillData(tile, layer, z, true));
-
-                z += 1000.0f;
+        addFillJobs(m_tiles);
+    [[clang::fallthrough]]; case DS_PRESERVED:
+        if(state == DS_PRESERVED && drawPreserved()) {
+            freeResources();
+            if(isBindingLayers()) {
+                progress.onProgress(COD_IN_PROCESS, 1.0,
+                                    _("Opening layers ..."));
             }
+            else {
+                progress.onProgress(COD_FINISHED, 1.0,
+                                    _("Map render finished."));
+            }
+            return true;
         }
-    [[clang::fallthrough]]; case DS_PRESERVED:
         bool result = drawTiles(progress);
         // Free unnecessary Gl objects as this call is in Gl context
         freeResources();
@@ -200,38 +443,210 @@ bool GlView::draw(ngsDrawState state, const Progress &progress)
     return true;
 }
 
+/**
+ * @brief GlView::drawToBuffer Render map to offscreen framebuffer in current
+ * Gl context (i.e. pbuffer context of server or export code) and read RGBA
+ * pixels. Draw is repeated until all tiles are filled by the fill pool and
+ * rendered. Map display size is restored after.
+ * @param width Image width in pixels.
+ * @param height Image height in pixels.
+ * @param buffer Memory of width * height * 4 bytes. Rows are written from top
+ * to bottom.
+ * @param progress Progress and cancel.
+ * @return True on success.
+ */
+bool GlView::drawToBuffer(int width, int height, void *buffer,
+                          const Progress &progress)
+{
+    ngsTraceSpan("GlView::drawToBuffer");
+    if(width < 1 || height < 1 || nullptr == buffer) {
+        return errorMessage(_("Invalid offscreen draw size or buffer"));
+    }
+
+    GLint viewport[4];
+    GLint currentFramebuffer = 0;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &currentFramebuffer);
+
+    int displayWidth = m_displayWidht;
+    int displayHeight = m_displayHeight;
+    double ratio = m_ratio;
+    setDisplaySize(width, height, m_YAxisInverted);
+
+    GlFrame target;
+    target.resize(width, height);
+    target.bind();
+    GlState::viewport(0, 0, width, height);
+
+    OffscreenProgress drawProgress;
+    bool result = true;
+    auto start = std::chrono::steady_clock::now();
+    while(true) {
+        // Each draw ends with target bound, as it was bound before
+        if(!draw(DS_NORMAL, drawProgress)) {
+            result = false;
+            break;
+        }
+        if(drawProgress.finished()) {
+            break;
+        }
+        if(!progress.onProgress(COD_IN_PROCESS, drawProgress.complete(),
+                                _("Rendering ..."))) {
+            result = errorMessage(_("Offscreen draw canceled"));
+            break;
+        }
+        if(std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start).count() > OFFSCREEN_DRAW_TIMEOUT) {
+            result = errorMessage(_("Offscreen draw timeout"));
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(OFFSCREEN_DRAW_WAIT));
+    }
+
+    if(result) {
+        // GLES2 has no pixel pack buffers, so pixels are read synchronously
+        target.rebind();
+        ngsCheckGLError(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+        ngsCheckGLError(glReadPixels(0, 0, width, height, GL_RGBA,
+                                     GL_UNSIGNED_BYTE, buffer));
+
+        // Gl rows go from bottom to top
+        size_t rowSize = static_cast<size_t>(width) * 4;
+        std::vector<GByte> row(rowSize);
+        GByte *data = static_cast<GByte*>(buffer);
+        for(int y = 0; y < height / 2; ++y) {
+            GByte *top = data + static_cast<size_t>(y) * rowSize;
+            GByte *bottom = data + static_cast<size_t>(height - 1 - y) * rowSize;
+            memcpy(row.data(), top, rowSize);
+            memcpy(top, bottom, rowSize);
+            memcpy(bottom, row.data(), rowSize);
+        }
+        progress.onProgress(COD_FINISHED, 1.0, _("Map render finished."));
+    }
+
+    target.destroy();
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER,
+                                      static_cast<GLuint>(currentFramebuffer)));
+    GlState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    m_displayWidht = displayWidth;
+    m_displayHeight = displayHeight;
+    m_ratio = ratio;
+    updateExtent();
+    m_frame.invalidate();
+
+    return result;
+}
+
+/**
+ * @brief invalidTilesMask Mask of tiles intersecting bounds or region
+ */
+static std::vector<GByte> invalidTilesMask(const std::vector<GlTilePtr> &tiles,
+                                           const Envelope &bounds,
+                                           const Envelope &region)
+{
+    EnvelopeArray extents;
+    extents.reserve(tiles.size());
+    for(const GlTilePtr &tile : tiles) {
+        Envelope env = tile->getExtent();
+        env.resize(TILE_RESIZE);
+        extents.add(env);
+    }
+
+    std::vector<GByte> mask;
+    extents.intersects(bounds, mask);
+    extents.intersects(region, mask);
+    return mask;
+}
+
 void GlView::invalidate(const Envelope &bounds)
 {
-    std::vector<GlTilePtr> newTiles;
+    invalidateTiles(bounds, LayerPtr());
+}
+
+/**
+ * @brief GlView::invalidateLayer Refill only the layer data of filled tiles in
+ * bounds. Tiles keep their images until the layer data is ready, so there is
+ * no flicker. Not yet filled tiles are replaced as on full invalidate.
+ * @param bounds Extent to invalidate
+ * @param layer Changed layer
+ */
+void GlView::invalidateLayer(const Envelope &bounds, const LayerPtr &layer)
+{
+    if(nullptr == ngsDynamicCast(GlRenderLayer, layer)) {
+        invalidate(bounds);
+        return;
+    }
+    invalidateTiles(bounds, layer);
+}
 
-    auto it = m_tiles.begin();
-    while(it != m_tiles.end()) {
-         GlTilePtr tile = *it;
-         Envelope env = tile->getExtent();
-         env.resize(TILE_RESIZE);
-         if(env.intersects(bounds) || env.intersects(m_invalidRegion)) {
-             m_oldTiles.push_back(tile);
-             it = m_tiles.erase(it);
+/**
+ * @brief GlView::invalidateTiles Replace tiles intersecting bounds or refill
+ * one layer data in them.
+ * @param bounds Extent to invalidate
+ * @param layer Changed layer or null if all layers changed
+ */
+void GlView::invalidateTiles(const Envelope &bounds, const LayerPtr &layer)
+{
+    std::vector<GlTilePtr> newTiles;
 
-             newTiles.push_back(GlTilePtr(new GlTile(*tile.get(), true)));
-         }
-         else {
-             ++it;
-         }
+    // Tiles of other zoom levels must not be taken back to view
+    std::vector<GByte> mask = invalidTilesMask(m_oldTiles, bounds,
+                                               m_invalidRegion);
+    for(size_t i = 0; i < m_oldTiles.size(); ++i) {
+        if(mask[i]) {
+            m_oldTiles[i]->setOutdated();
+        }
     }
 
-    for(const GlTilePtr &tile : newTiles) {
-        m_tiles.push_back(tile);
-        float z = 0.0f;
-        for (auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend();
-             ++layerIt) {
-            const LayerPtr &layer = *layerIt;
-            m_threadPool.addThreadData(new LayerFillData(tile, layer, z, true));
-            z += 1000.f;
+    // Prefetched data is dropped, old tiles data is freed in Gl context
+    mask = invalidTilesMask(m_prefetchTiles, bounds, m_invalidRegion);
+    std::vector<GlTilePtr> prefetchTiles, outdatedTiles;
+    for(size_t i = 0; i < m_prefetchTiles.size(); ++i) {
+        const GlTilePtr &tile = m_prefetchTiles[i];
+        if(mask[i]) {
+            tile->setOutdated();
+            m_oldTiles.push_back(tile);
+            outdatedTiles.push_back(tile);
+        }
+        else {
+            prefetchTiles.push_back(tile);
         }
     }
+    m_prefetchTiles = std::move(prefetchTiles);
+    removeFillJobs(outdatedTiles);
+
+    mask = invalidTilesMask(m_tiles, bounds, m_invalidRegion);
+    std::vector<GlTilePtr> validTiles;
+    validTiles.reserve(m_tiles.size());
+    for(size_t i = 0; i < m_tiles.size(); ++i) {
+        const GlTilePtr &tile = m_tiles[i];
+        if(mask[i] && layer && tile->filled()) {
+            tile->setDirty();
+            m_layerRefills.push_back({tile, layer});
+            validTiles.push_back(tile);
+        }
+        else if(mask[i]) {
+            tile->setOutdated();
+            m_oldTiles.push_back(tile);
+            newTiles.push_back(GlTilePtr(new GlTile(*tile.get(), true)));
+        }
+        else {
+            validTiles.push_back(tile);
+        }
+    }
+    m_tiles = std::move(validTiles);
+
+    // Queued jobs for replaced tiles are useless now
+    std::vector<GlTilePtr> removedTiles(m_oldTiles.end() - newTiles.size(),
+                                        m_oldTiles.end());
+    removeFillJobs(removedTiles);
+
+    m_tiles.insert(m_tiles.end(), newTiles.begin(), newTiles.end());
+    addFillJobs(newTiles);
 
     m_invalidRegion = bounds;
+    m_frame.invalidate();
 }
 
 bool GlView::setSelectionStyle(enum ngsStyleType styleType,
@@ -335,16 +750,63 @@ bool GlView::saveInternal(CPLJSONObject &root, MapFile * const mapFile)
     return true;
 }
 
+/**
+ * @brief GlView::tileGridChanged Check if the tile grid of the view changed
+ * since the last check. The grid is the same while scale and center move less
+ * than a tile. For rotated view the cells of the viewport corners are checked
+ * too, as the tiles are filtered by the viewport polygon.
+ * @param range Tiles range of current extent
+ * @return True if tiles list should be updated
+ */
+bool GlView::tileGridChanged(const TileRange &range)
+{
+    std::vector<int> corners;
+    double rotate = getRotate(DIR_Z);
+    if(isRotated()) {
+        double tileSize = DEFAULT_BOUNDS.width() / (1 << getZoom());
+        corners.reserve(8);
+        for(const OGRRawPoint &corner : m_rotateCorners) {
+            corners.push_back(static_cast<int>(std::floor(corner.x / tileSize)));
+            corners.push_back(static_cast<int>(std::floor(corner.y / tileSize)));
+        }
+    }
+
+    if(!m_tiles.empty() && range == m_tileRange &&
+            isEqual(rotate, m_tileRangeRotate) && corners == m_tileRangeCorners) {
+        return false;
+    }
+
+    m_tileRange = range;
+    m_tileRangeRotate = rotate;
+    m_tileRangeCorners = std::move(corners);
+    return true;
+}
+
 void GlView::updateTilesList()
 {
     // Get tiles for current extent
     Envelope ext = getExtent();
     ext.resize(TILE_RESIZE);
     //CPLDebug("ngstore", "Zoom is: %d", getZoom());
-    std::vector<TileItem> tileItems = getTilesForExtent(ext, getZoom(), false, // False mean that we use OSM/Google tile scheme in map. Not connected with getYAxisInverted()
-                                                        getXAxisLooped());
+    TileRange range(ext, getZoom(), false, // False mean that we use OSM/Google tile scheme in map. Not connected with getYAxisInverted()
+                    getXAxisLooped());
+    if(!tileGridChanged(range)) {
+        return;
+    }
+
+    // Skip tiles out of rotated viewport
+    std::vector<TileItem> tileItems;
+    tileItems.reserve(range.size());
+    for(const TileItem &tileItem : range) {
+        Envelope tileExt = tileItem.env;
+        tileExt.move(tileItem.tile.crossExtent * DEFAULT_BOUNDS.width(), 0.0);
+        if(isTileVisible(tileExt, TILE_RESIZE)) {
+            tileItems.push_back(tileItem);
+        }
+    }
 
     // Remove out of extent Gl tiles
+    size_t oldTilesCount = m_oldTiles.size();
     auto tileIt = m_tiles.begin();
     while(tileIt != m_tiles.end()) {
         bool markToDelete = true;
@@ -368,15 +830,117 @@ void GlView::updateTilesList()
         }
     }
 
-    // Add new Gl tiles
+    // Drop not started fill jobs for removed tiles
+    if(m_oldTiles.size() > oldTilesCount) {
+        std::vector<GlTilePtr> removedTiles(m_oldTiles.begin() + oldTilesCount,
+                                            m_oldTiles.end());
+        removeFillJobs(removedTiles);
+    }
+
+    // Add new Gl tiles. On pinch zoom the view often goes back to previous
+    // zoom level, so filled tiles of it are taken from old tiles without refill.
     for(const TileItem &tileItem : tileItems) {
-        m_tiles.push_back(GlTilePtr(new GlTile(GLTILE_SIZE, tileItem)));
+        auto oldIt = std::find_if(m_oldTiles.begin(), m_oldTiles.end(),
+                                  [&tileItem](const GlTilePtr &oldTile) {
+            return oldTile->filled() && !oldTile->outdated() &&
+                    oldTile->getTile() == tileItem.tile;
+        });
+        if(oldIt != m_oldTiles.end()) {
+            m_tiles.push_back(*oldIt);
+            m_oldTiles.erase(oldIt);
+            continue;
+        }
+
+        auto prefetchIt = std::find_if(m_prefetchTiles.begin(),
+                                       m_prefetchTiles.end(),
+                                       [&tileItem](const GlTilePtr &tile) {
+            return tile->getTile() == tileItem.tile;
+        });
+        if(prefetchIt != m_prefetchTiles.end()) {
+            m_tiles.push_back(*prefetchIt);
+            m_prefetchTiles.erase(prefetchIt);
+        }
+        else {
+            m_tiles.push_back(GlTilePtr(new GlTile(GLTILE_SIZE, tileItem)));
+        }
     }
 
 //    CPLDebug("ngstore", "Tile count: %ld", m_tiles.size());
 //    CPLDebug("ngstore", "Old tile count: %ld", m_oldTiles.size());
 }
 
+void GlView::addFillJobs(const std::vector<GlTilePtr> &tiles,
+                         double basePriority)
+{
+    // Tiles near the map center are filled first. Inside the tile layers
+    // which will not draw anything go first as they finish immediately and
+    // don't hold the tile from being drawn.
+    OGRRawPoint center = getCenter();
+    double layerCount = static_cast<double>(m_layers.size()) + 1.0;
+    // Tiles of each layer are read at once before filling
+    std::vector<std::vector<GlTilePtr>> layerTiles(m_layers.size());
+    for(const GlTilePtr &tile : tiles) {
+        if(tile->filled() && !tile->dirty()) {
+            continue;
+        }
+
+        const Envelope &env = tile->getExtent();
+        OGRRawPoint tileCenter = env.center();
+        double tileSize = env.width() > 0.0 ? env.width() : 1.0;
+        double distance = ngsDistance(center, tileCenter) / tileSize;
+        // Tiles in one ring around the center have the same priority
+        double priority = basePriority + std::floor(distance) * layerCount;
+
+        unsigned char zoom = tile->getTile().z;
+        float z = 0.0f;
+        double layerOrder = 1.0;
+        size_t layerIndex = 0;
+        for(auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend();
+             ++layerIt, ++layerIndex) {
+            const LayerPtr &layer = *layerIt;
+            GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
+            bool skip = (tile->prefetched() || tile->dirty()) &&
+                    renderLayer && renderLayer->hasData(tile);
+            bool visible = layer->visible() && zoom > layer->minZoom() &&
+                    zoom < layer->maxZoom();
+            double layerPriority = priority + (visible ? layerOrder : 0.0);
+            if(!skip) {
+                m_threadPool.addThreadData(new LayerFillData(tile, layer, z,
+                                                             true,
+                                                             layerPriority));
+                if(visible) {
+                    layerTiles[layerIndex].push_back(tile);
+                }
+            }
+            z += 1000.0f;
+            layerOrder += 1.0;
+        }
+    }
+
+    size_t layerIndex = 0;
+    for(auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend();
+         ++layerIt, ++layerIndex) {
+        if(layerTiles[layerIndex].size() > 1) {
+            m_threadPool.addThreadData(
+                        new LayerTilesReadData(layerTiles[layerIndex], *layerIt,
+                                               true, basePriority - 1.0));
+        }
+    }
+}
+
+void GlView::removeFillJobs(const std::vector<GlTilePtr> &tiles)
+{
+    if(tiles.empty()) {
+        return;
+    }
+    // Stop already running jobs and drop not started ones
+    for(const GlTilePtr &tile : tiles) {
+        tile->cancel();
+    }
+    m_threadPool.removeThreadData(layerDataFillJobFilter,
+                                  const_cast<std::vector<GlTilePtr>*>(&tiles));
+}
+
 void GlView::freeResources()
 {
     std::for_each(m_freeResources.begin(), m_freeResources.end(),
@@ -387,10 +951,11 @@ void GlView::freeResources()
 bool GlView::drawTiles(const Progress &progress)
 {
     MutexHolder holder(m_mutex);
+    GlImage::startFrame();
+    GlBuffer::startFrame();
+    m_drawNumber++;
 //    ngsCheckGLError(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
-    ngsCheckGLError(glDisable(GL_BLEND));
-
-    drawOldTiles();
+    GlState::setEnabled(GL_BLEND, false);
 
     // Preserve current viewport
     GLint viewport[4];
@@ -398,15 +963,37 @@ bool GlView::drawTiles(const Progress &progress)
     glGetIntegerv( GL_VIEWPORT, viewport );
     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &currentFramebuffer);
 
+    // Tiles are composed in off-screen frame to draw it as is next time if
+    // only overlays changed
+    bindFrame(viewport[2], viewport[3]);
+    clearBackground();
+
+    drawOldTiles();
 
+    // First render not filled tiles to their framebuffers, than draw all
+    // tiles to view in one pass, so the tile draw style is prepared once and
+    // matrix uploads are skipped.
+    std::vector<GlTile*> viewTiles;
+    viewTiles.reserve(m_tiles.size());
+    bool tileRendered = false;
     double done = 0.0;
     double totalDrawCalls = m_layers.size() * m_tiles.size() - 0.0000001;
     for(const GlTilePtr& tile : m_tiles) {
         bool drawTile = true;
-        if(tile->filled()) {
+        if(tile->dirty() && hasLayersData(tile)) {
+            // Refilled layers data is ready, render tile again
+            tile->setDirty(false);
+            tile->setFilled(false);
+        }
+
+        if(tile->dirty()) {
+            // Draw previous tile image until layers data refilled
+        }
+        else if(tile->filled()) {
             done += m_layers.size();
         }
         else {
+            tileRendered = true;
             if(tile->bound()) {
                 tile->rebind();
             }
@@ -414,23 +1001,38 @@ bool GlView::drawTiles(const Progress &progress)
                 tile->bind();
             }
 
-            glViewport(0, 0, tile->tileSize(), tile->tileSize());
+            GlState::viewport(0, 0, tile->tileSize(), tile->tileSize());
 
             GlTile::prepareContext();
 
             clearBackground();
 
-            ngsCheckGLError(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-            ngsCheckGLError(glEnable(GL_BLEND));
+            // Alpha is accumulated as coverage, so the semi-transparent layer
+            // frame may be composed with premultiplied colors
+            GlState::blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                                       GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            GlState::setEnabled(GL_BLEND, true);
 
             unsigned char filled = 0;
             for(auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend(); ++layerIt) {
 
                 const LayerPtr &layer = *layerIt;
                 GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
-                if(renderLayer && renderLayer->draw(tile)) {
+                if(!renderLayer) {
+                    continue;
+                }
+                // Overlapped items of semi-transparent layer are drawn to
+                // layer frame opaque, then the frame is blended once
+                bool composite = layer->visible() && layer->opacity() < 1.0f;
+                if(composite) {
+                    beginLayerFrame(tile->tileSize());
+                }
+                if(renderLayer->draw(tile)) {
                     filled++;
                 }
+                if(composite) {
+                    endLayerFrame(*tile, layer->opacity());
+                }
             }
 
             for(auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend(); ++layerIt) {
@@ -446,7 +1048,7 @@ bool GlView::drawTiles(const Progress &progress)
                 // Free layer data
                 for(const LayerPtr &layer : m_layers) {
                     GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
-                    if(renderLayer) {
+                    if(renderLayer && !m_keepTileBuffers) {
                         renderLayer->free(tile);
                     }
                 }
@@ -454,14 +1056,7 @@ bool GlView::drawTiles(const Progress &progress)
                 done += m_layers.size();
             }
 
-            ngsCheckGLError(glDisable(GL_BLEND));
-
-            // Draw tile on view
-            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
-
-            // Make the window the target
-            ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(currentFramebuffer)));
-            ngsCheckGLError(glDisable(GL_DEPTH_TEST));
+            GlState::setEnabled(GL_BLEND, false);
 
             if(filled != m_layers.size()) { // == 0
                 drawTile = false;
@@ -469,16 +1064,127 @@ bool GlView::drawTiles(const Progress &progress)
         }
 
         if(drawTile) { // Don't draw tiles with only background
-            m_fboDrawStyle.setImage(tile->getImageRef());
-            tile->getBuffer().rebind();
-            m_fboDrawStyle.prepare(getSceneMatrix(), getInvViewMatrix(), tile->getBuffer().type());
-            m_fboDrawStyle.draw(tile->getBuffer());
+            tile->setDrawNumber(m_drawNumber);
+            viewTiles.push_back(tile.get());
+        }
+    }
+
+    if(tileRendered) {
+        // Draw tiles on frame
+        GlState::viewport(0, 0, viewport[2], viewport[3]);
+
+        m_frame.rebind();
+        GlState::setEnabled(GL_DEPTH_TEST, false);
+    }
+
+    for(GlTile *tile : viewTiles) {
+        m_fboDrawStyle.setImage(tile->getImageRef());
+        tile->getBuffer().rebind();
+        m_fboDrawStyle.prepare(getSceneMatrix(), getInvViewMatrix(), tile->getBuffer().type());
+        m_fboDrawStyle.draw(tile->getBuffer());
+    }
+
+    // Make the window the target
+    GlState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    ngsCheckGLError(glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(currentFramebuffer)));
+    drawFrame();
+    drawLabels(viewport[2], viewport[3], true);
+    drawOverlays();
+    // Other GL code must not change own vertex arrays
+    GlState::bindVertexArray(0);
+
+//    CPLDebug("ngstore", "Drawing %f of %f", done, totalDrawCalls);
+    if(done >= totalDrawCalls) {
+        m_frame.setValid(getSceneMatrix());
+        freeOldTiles();
+        prefetchTiles();
+        if(isBindingLayers()) {
+            // Layers will be refilled when their datasources are opened
+            progress.onProgress(COD_IN_PROCESS, 1.0, _("Opening layers ..."));
+        }
+        else {
+            progress.onProgress(COD_FINISHED, 1.0, _("Map render finished."));
         }
     }
+    else {
+        double complete = done / totalDrawCalls;
+        progress.onProgress(COD_IN_PROCESS, complete, _("Rendering ..."));
+    }
+
+    trimTiles();
+    return true;
+}
+
+/**
+ * @brief GlView::drawPreserved Draw the off-screen frame of previous draw and
+ * overlays on top of it.
+ * @return false if frame is out of date or view size changed, so tiles must
+ * be drawn.
+ */
+bool GlView::drawPreserved()
+{
+    GLint viewport[4];
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    m_frame.resize(viewport[2], viewport[3]);
+    if(!m_frame.bound() || !m_frame.valid(getSceneMatrix())) {
+        return false;
+    }
+
+    drawFrame();
+    drawLabels(viewport[2], viewport[3], false);
+    drawOverlays();
+    GlState::bindVertexArray(0);
+    return true;
+}
+
+void GlView::bindFrame(GLsizei width, GLsizei height)
+{
+    m_frame.resize(width, height);
+    if(m_frame.bound()) {
+        m_frame.rebind();
+    }
+    else {
+        m_frame.bind();
+    }
+    m_frame.invalidate();
+    GlState::viewport(0, 0, width, height);
+}
+
+void GlView::drawFrame()
+{
+    GlState::setEnabled(GL_BLEND, false);
+    GlState::setEnabled(GL_DEPTH_TEST, false);
+    const glm::mat4 identity(1.0f);
+    m_fboDrawStyle.setImage(m_frame.getImageRef());
+    m_frame.getBuffer().rebind();
+    m_fboDrawStyle.prepare(identity, identity, m_frame.getBuffer().type());
+    m_fboDrawStyle.draw(m_frame.getBuffer());
+}
+
+/**
+ * @brief GlView::drawLabels Draw labels over the frame. Labels are not stored
+ * in tiles, so they are placed once for all tiles without collisions on tile
+ * borders.
+ * @param width View width in pixels.
+ * @param height View height in pixels.
+ * @param place Place labels again if view or layers labels changed.
+ */
+void GlView::drawLabels(GLint width, GLint height, bool place)
+{
+    if(place) {
+        m_labels.update(m_layers, m_tiles, *this, width, height);
+    }
+
+    GlState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GlState::setEnabled(GL_BLEND, true);
+    m_labels.draw(getSceneMatrix(), getInvViewMatrix());
+}
 
+void GlView::drawOverlays()
+{
     // Need to blend overlay alpha with map tiles
-    ngsCheckGLError(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-    ngsCheckGLError(glEnable(GL_BLEND));
+    GlState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GlState::setEnabled(GL_BLEND, true);
 
     for (auto overlayIt = m_overlays.rbegin(); overlayIt != m_overlays.rend(); ++overlayIt) {
         const OverlayPtr &overlay = *overlayIt;
@@ -487,46 +1193,357 @@ bool GlView::drawTiles(const Progress &progress)
             glOverlay->draw();
         }
     }
+}
 
-//    CPLDebug("ngstore", "Drawing %f of %f", done, totalDrawCalls);
-    if(done >= totalDrawCalls) {
-        freeOldTiles();
-        progress.onProgress(COD_FINISHED, 1.0, _("Map render finished."));
+/**
+ * @brief GlView::beginLayerFrame Make the layer frame the render target and
+ * clear it. Run in Gl context.
+ * @param tileSize Tile size in pixels.
+ */
+void GlView::beginLayerFrame(GLsizei tileSize)
+{
+    m_layerFrame.resize(tileSize);
+    if(m_layerFrame.bound()) {
+        m_layerFrame.rebind();
     }
     else {
-        double complete = done / totalDrawCalls;
-        progress.onProgress(COD_IN_PROCESS, complete, _("Rendering ..."));
+        m_layerFrame.bind();
+    }
+    GlState::clearColor({0.0f, 0.0f, 0.0f, 0.0f});
+    ngsCheckGLError(glClear(GL_COLOR_BUFFER_BIT));
+}
+
+/**
+ * @brief GlView::endLayerFrame Blend the layer frame to the tile with layer
+ * opacity and restore the tile render target. Run in Gl context.
+ * @param tile Tile to draw to.
+ * @param opacity Layer opacity from 0 to 1.
+ */
+void GlView::endLayerFrame(const GlTile &tile, float opacity)
+{
+    tile.rebind();
+
+    if(!m_layerProgram) {
+        m_layerProgram = GlProgramCache::instance().program(
+                    layerVertexShaderSource, layerFragmentShaderSource);
+        if(!m_layerProgram) {
+            return;
+        }
     }
 
-    return true;
+    const GlBuffer &frame = m_layerFrame.getBuffer();
+    frame.rebind();
+    m_layerProgram->use();
+    m_layerProgram->setInt(GlProgram::U_TEXTURE, 0);
+    m_layerProgram->setFloat(GlProgram::U_OPACITY, opacity);
+    m_layerProgram->setVertexAttribPointer(GlProgram::A_POSITION, 3,
+                                           5 * sizeof(float), nullptr);
+    m_layerProgram->setVertexAttribPointer(GlProgram::A_TEX_COORD, 2,
+                                           5 * sizeof(float),
+                            reinterpret_cast<const GLvoid*>(3 * sizeof(float)));
+
+    GlState::activeTexture(GL_TEXTURE0);
+    GlState::bindTexture(m_layerFrame.textureId());
+
+    GlState::blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    GlState::setEnabled(GL_DEPTH_TEST, false);
+    ngsCheckGLError(glDrawElements(GL_TRIANGLES, frame.drawCount(),
+                                   frame.indexType(), frame.drawOffset()));
+    GlState::setEnabled(GL_DEPTH_TEST, true);
+    GlState::blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glStats().drawCalls++;
 }
 
 void GlView::drawOldTiles()
 {
+    // Old tiles are drawn scaled to current zoom as placeholders until new
+    // tiles filled. Tiles of zoom levels nearest to current are drawn last.
+    int zoom = getZoom();
+    std::vector<GlTile*> oldTiles;
+    oldTiles.reserve(m_oldTiles.size());
     for(const GlTilePtr &oldTile : m_oldTiles) {
-        if(oldTile->filled()){
-            m_fboDrawStyle.setImage(oldTile->getImageRef());
-            oldTile->getBuffer().rebind();
-            m_fboDrawStyle.prepare(getSceneMatrix(), getInvViewMatrix(),
-                                   oldTile->getBuffer().type());
-            m_fboDrawStyle.draw(oldTile->getBuffer());
+        if(oldTile->filled()) {
+            oldTiles.push_back(oldTile.get());
+        }
+    }
+    std::stable_sort(oldTiles.begin(), oldTiles.end(),
+                     [zoom](const GlTile *a, const GlTile *b) {
+        return std::abs(a->getTile().z - zoom) > std::abs(b->getTile().z - zoom);
+    });
+
+    for(GlTile *oldTile : oldTiles) {
+        oldTile->setDrawNumber(m_drawNumber);
+        m_fboDrawStyle.setImage(oldTile->getImageRef());
+        oldTile->getBuffer().rebind();
+        m_fboDrawStyle.prepare(getSceneMatrix(), getInvViewMatrix(),
+                               oldTile->getBuffer().type());
+        m_fboDrawStyle.draw(oldTile->getBuffer());
+    }
+}
+
+/**
+ * @brief GlView::refillLayers Take aside data of invalidated layers in filled
+ * tiles and start refill. The fill may use the data again if the tile did not
+ * change. Run in Gl context.
+ */
+void GlView::refillLayers()
+{
+    if(m_layerRefills.empty()) {
+        return;
+    }
+
+    std::vector<GlTilePtr> dirtyTiles;
+    for(const LayerRefill &refill : m_layerRefills) {
+        // Tile may go out of view before draw
+        if(std::find(m_tiles.begin(), m_tiles.end(), refill.tile) ==
+                m_tiles.end()) {
+            continue;
+        }
+        GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer,
+                                                    refill.layer);
+        renderLayer->markRefill(refill.tile);
+        if(std::find(dirtyTiles.begin(), dirtyTiles.end(), refill.tile) ==
+                dirtyTiles.end()) {
+            dirtyTiles.push_back(refill.tile);
         }
     }
+    m_layerRefills.clear();
+
+    // Only layers without data are filled for dirty tiles
+    addFillJobs(dirtyTiles);
+}
+
+/**
+ * @brief GlView::hasLayersData Check if all render layers have data for tile.
+ */
+bool GlView::hasLayersData(const GlTilePtr &tile) const
+{
+    for(const LayerPtr &layer : m_layers) {
+        GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
+        if(renderLayer && !renderLayer->hasData(tile)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void GlView::freeOldTiles()
 {
+    freeLayersData(m_oldTiles);
     for(const GlTilePtr &oldTile : m_oldTiles) {
+        freeResource(std::dynamic_pointer_cast<GlObject>(oldTile));
+    }
+    m_oldTiles.clear();
+}
+
+/**
+ * @brief GlView::freeLayersData Free layers data of tiles. Kept layers buffers
+ * must be freed before refill, as fill replaces data without GL context.
+ * @param tiles Tiles to free data
+ */
+void GlView::freeLayersData(const std::vector<GlTilePtr> &tiles)
+{
+    for(const GlTilePtr &tile : tiles) {
         for(const LayerPtr &layer : m_layers) {
             GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
             if(renderLayer) {
-                renderLayer->free(oldTile);
+                renderLayer->free(tile);
             }
         }
+    }
+}
 
-        freeResource(std::dynamic_pointer_cast<GlObject>(oldTile));
+/**
+ * @brief GlView::prefetchTiles Fill layers data for the ring of tiles around
+ * current extent and for the extent tiles of next and previous zoom levels.
+ * Started only if fill pool is idle. The prefetched data is freed first if GL
+ * memory exceeds the limit, memory budget is exceeded or memory was trimmed
+ * on system pressure since the last draw.
+ */
+void GlView::prefetchTiles()
+{
+    const GlStats &glStat = glStats();
+    long long glMemory = glStat.bufferMemory + glStat.textureMemory;
+    MemoryBudget &budget = MemoryBudget::instance();
+    budget.setGlMemory(glMemory);
+    unsigned int trimGeneration = budget.trimGeneration();
+    if(trimGeneration != m_trimGeneration) {
+        m_trimGeneration = trimGeneration;
+        freePrefetchTiles();
+        return;
     }
-    m_oldTiles.clear();
+
+    if(!m_prefetch || (m_prefetchMemoryLimit > 0 &&
+            glMemory > m_prefetchMemoryLimit) || budget.isExceeded()) {
+        freePrefetchTiles();
+        return;
+    }
+
+    if(m_threadPool.dataCount() > 0) {
+        return;
+    }
+
+    unsigned char zoom = getZoom();
+    Envelope ext = getExtent();
+    ext.resize(TILE_RESIZE);
+    double tileSize = pixelSize(zoom) * GLTILE_SIZE;
+    Envelope ringExt(ext.minX() - tileSize, ext.minY() - tileSize,
+                     ext.maxX() + tileSize, ext.maxY() + tileSize);
+    std::vector<TileItem> tileItems = getTilesForExtent(ringExt, zoom, false,
+                                                        getXAxisLooped());
+    std::vector<unsigned char> zooms;
+    if(zoom < std::numeric_limits<unsigned char>::max()) {
+        zooms.push_back(zoom + 1);
+    }
+    if(zoom > 0) {
+        zooms.push_back(zoom - 1);
+    }
+    for(unsigned char prefetchZoom : zooms) {
+        std::vector<TileItem> zoomItems = getTilesForExtent(ext, prefetchZoom,
+                                                            false,
+                                                            getXAxisLooped());
+        tileItems.insert(tileItems.end(), zoomItems.begin(), zoomItems.end());
+    }
+
+    std::vector<GlTilePtr> prefetchTiles;
+    for(const TileItem &tileItem : tileItems) {
+        auto sameTile = [&tileItem](const GlTilePtr &tile) {
+            return tile->getTile() == tileItem.tile;
+        };
+        // Layers data is shared by tile, so it must not be freed with other
+        // lists tiles
+        if(std::find_if(m_tiles.begin(), m_tiles.end(), sameTile) != m_tiles.end() ||
+           std::find_if(m_oldTiles.begin(), m_oldTiles.end(),
+                        sameTile) != m_oldTiles.end()) {
+            continue;
+        }
+
+        auto prefetchIt = std::find_if(m_prefetchTiles.begin(),
+                                       m_prefetchTiles.end(), sameTile);
+        if(prefetchIt != m_prefetchTiles.end()) {
+            prefetchTiles.push_back(*prefetchIt);
+            m_prefetchTiles.erase(prefetchIt);
+        }
+        else {
+            GlTilePtr tile(new GlTile(GLTILE_SIZE, tileItem));
+            tile->setPrefetched();
+            prefetchTiles.push_back(tile);
+        }
+    }
+
+    // Tiles out of new prefetch area
+    freePrefetchTiles();
+    m_prefetchTiles = std::move(prefetchTiles);
+    addFillJobs(m_prefetchTiles, PREFETCH_PRIORITY);
+}
+
+void GlView::freePrefetchTiles()
+{
+    if(m_prefetchTiles.empty()) {
+        return;
+    }
+    removeFillJobs(m_prefetchTiles);
+    freeLayersData(m_prefetchTiles);
+    for(const GlTilePtr &tile : m_prefetchTiles) {
+        freeResource(std::dynamic_pointer_cast<GlObject>(tile));
+    }
+    m_prefetchTiles.clear();
+}
+
+/**
+ * @brief GlView::trimTiles Free GL objects of least recently drawn tiles while
+ * GL memory exceeds the tile memory limit. Old and prefetched tiles are freed
+ * whole. Tiles in view keep their images and only free kept layers buffers,
+ * which are refilled on restyle. If it is not enough, the pooled buffers and
+ * textures are deleted.
+ */
+void GlView::trimTiles()
+{
+    if(m_tileMemoryLimit <= 0) {
+        return;
+    }
+
+    const GlStats &glStat = glStats();
+    long long used = glStat.bufferMemory + glStat.textureMemory;
+    if(used <= m_tileMemoryLimit) {
+        return;
+    }
+
+    // Tile and the list it is removed from, or nullptr if only tile layers
+    // data is freed
+    typedef struct _trimItem {
+        GlTilePtr tile;
+        std::vector<GlTilePtr> *list;
+        size_t size;
+    } TrimItem;
+
+    std::vector<TrimItem> items;
+    for(const GlTilePtr &tile : m_oldTiles) {
+        items.push_back({tile, &m_oldTiles,
+                         tile->memorySize() + layersMemorySize(tile)});
+    }
+    for(const GlTilePtr &tile : m_prefetchTiles) {
+        items.push_back({tile, &m_prefetchTiles,
+                         tile->memorySize() + layersMemorySize(tile)});
+    }
+    if(m_keepTileBuffers) {
+        for(const GlTilePtr &tile : m_tiles) {
+            if(tile->filled() && !tile->dirty()) {
+                items.push_back({tile, nullptr, layersMemorySize(tile)});
+            }
+        }
+    }
+    std::stable_sort(items.begin(), items.end(),
+                     [](const TrimItem &a, const TrimItem &b) {
+        return a.tile->drawNumber() < b.tile->drawNumber();
+    });
+
+    std::vector<GlTilePtr> tiles(1);
+    for(const TrimItem &item : items) {
+        if(used <= m_tileMemoryLimit) {
+            break;
+        }
+        if(item.size == 0) {
+            continue;
+        }
+
+        tiles[0] = item.tile;
+        if(item.list == &m_prefetchTiles) {
+            removeFillJobs(tiles);
+        }
+        freeLayersData(tiles);
+        if(item.list) {
+            freeResource(std::dynamic_pointer_cast<GlObject>(item.tile));
+            item.list->erase(std::find(item.list->begin(), item.list->end(),
+                                       item.tile));
+        }
+        used -= static_cast<long long>(item.size);
+    }
+
+    // Freed objects go to pools, so pools are cleared after them
+    freeResources();
+    if(glStat.bufferMemory + glStat.textureMemory > m_tileMemoryLimit) {
+        GlBuffer::clearPool();
+        GlImage::clearPool();
+    }
+}
+
+/**
+ * @brief GlView::layersMemorySize GL memory of all layers data for tile.
+ * @param tile Tile to check
+ * @return Size in bytes.
+ */
+size_t GlView::layersMemorySize(const GlTilePtr &tile) const
+{
+    size_t out = 0;
+    for(const LayerPtr &layer : m_layers) {
+        GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
+        if(renderLayer) {
+            out += renderLayer->memorySize(tile);
+        }
+    }
+    return out;
 }
 
 void GlView::initView()
@@ -535,7 +1552,8 @@ void GlView::initView()
     m_selectionStyles[ST_LINE] = StylePtr(Style::createStyle("simpleLine", m_textureAtlas));
     m_selectionStyles[ST_FILL] = StylePtr(Style::createStyle("simpleFillBordered", m_textureAtlas));
     createOverlays();
-    m_threadPool.init(getNumberThreads(), layerDataFillJobThreadFunc, MAX_TRIES);
+    m_threadPool.init(getNumberThreads(), layerDataFillJobThreadFunc, MAX_TRIES,
+                      false, WorkerClass::INTERACTIVE);
 
     m_glBkColor.r = float(m_bkColor.R) / 255;
     m_glBkColor.g = float(m_bkColor.G) / 255;
@@ -543,6 +1561,62 @@ void GlView::initView()
     m_glBkColor.a = float(m_bkColor.A) / 255;
 }
 
+bool GlView::setOptions(const Options &options)
+{
+    m_keepTileBuffers = options.asBool("KEEP_TILE_BUFFERS", false);
+    m_prefetch = options.asBool("PREFETCH_TILES", true);
+    m_prefetchMemoryLimit = static_cast<long long>(
+                options.asInt("PREFETCH_MEMORY_LIMIT",
+                              DEFAULT_PREFETCH_MEMORY_LIMIT)) * MB;
+    m_tileMemoryLimit = static_cast<long long>(
+                options.asInt("TILE_MEMORY_LIMIT",
+                              DEFAULT_TILE_MEMORY_LIMIT)) * MB;
+    GlImage::setUploadBudget(options.asInt("TEXTURE_UPLOADS_PER_FRAME", 0),
+                             options.asDouble("TEXTURE_UPLOAD_TIME", 0.0));
+    GlBuffer::setUploadBudget(static_cast<size_t>(
+                std::max(0, options.asInt("BUFFER_UPLOAD_SIZE", 0))) * 1024);
+    return MapView::setOptions(options);
+}
+
+/**
+ * @brief GlView::renderStats Renderer counters of last draw call
+ * @return ngsRenderStats struct
+ */
+ngsRenderStats GlView::renderStats() const
+{
+    ngsRenderStats stats = MapView::renderStats();
+    const GlStats &glStat = glStats();
+    stats.drawCalls = static_cast<int>(glStat.drawCalls);
+    stats.stateChanges = static_cast<int>(glStat.stateChanges);
+    stats.uploadedBytes = static_cast<long long>(glStat.uploadedBytes);
+    stats.bufferMemory = glStat.bufferMemory;
+    stats.textureMemory = glStat.textureMemory;
+
+    for(const GlTilePtr &tile : m_tiles) {
+        if(tile->filled()) {
+            stats.tilesFilled++;
+        }
+        else {
+            stats.tilesPending++;
+        }
+    }
+
+    std::vector<double> latencies;
+    for(const LayerPtr &layer : m_layers) {
+        GlRenderLayer *renderLayer = ngsDynamicCast(GlRenderLayer, layer);
+        if(renderLayer) {
+            std::vector<double> layerLatencies = renderLayer->fillLatencies();
+            latencies.insert(latencies.end(), layerLatencies.begin(),
+                             layerLatencies.end());
+        }
+    }
+    stats.fillLatency50 = GlRenderLayer::percentileValue(latencies, 50.0);
+    stats.fillLatency90 = GlRenderLayer::percentileValue(latencies, 90.0);
+    stats.fillLatency99 = GlRenderLayer::percentileValue(latencies, 99.0);
+
+    return stats;
+}
+
 double GlView::pixelSize(int zoom)
 {
     int tilesInMapOneDim = 1 << zoom;
@@ -1042,18 +2116,18 @@ void GlView::testDrawTile(const TileItem &tile) const
     GlTile glTile(GLTILE_SIZE, tile);
     glTile.bind();
 
-    ngsCheckGLError(glClearColor(1.0f, 0.0f, 1.0f, 1.0f));
+    GlState::clearColor({1.0f, 0.0f, 1.0f, 1.0f});
     ngsCheckGLError(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
     GLint viewport[4];
     glGetIntegerv( GL_VIEWPORT, viewport );
 
-    glViewport(0, 0, GLTILE_SIZE, GLTILE_SIZE);
+    GlState::viewport(0, 0, GLTILE_SIZE, GLTILE_SIZE);
 
     // Draw in first tile
     testDrawPolygons(glTile.getSceneMatrix(), glTile.getInvViewMatrix());
 
-    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    GlState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
     // Draw tile in view
     // Make the window the target
@@ -52,10 +52,29 @@ public:
 protected:
     void clearTiles();
     void updateTilesList();
+    bool tileGridChanged(const TileRange &range);
+    void addFillJobs(const std::vector<GlTilePtr> &tiles,
+                     double basePriority = 0.0);
+    void removeFillJobs(const std::vector<GlTilePtr> &tiles);
     void freeResources();
     bool drawTiles(const Progress &progress);
     void drawOldTiles();
     void freeOldTiles();
+    void freeLayersData(const std::vector<GlTilePtr> &tiles);
+    void invalidateTiles(const Envelope &bounds, const LayerPtr &layer);
+    void refillLayers();
+    bool hasLayersData(const GlTilePtr &tile) const;
+    void prefetchTiles();
+    void freePrefetchTiles();
+    void trimTiles();
+    size_t layersMemorySize(const GlTilePtr &tile) const;
+    bool drawPreserved();
+    void bindFrame(GLsizei width, GLsizei height);
+    void beginLayerFrame(GLsizei tileSize);
+    void endLayerFrame(const GlTile &tile, float opacity);
+    void drawFrame();
+    void drawLabels(GLint width, GLint height, bool place);
+    void drawOverlays();
     void initView();
     double pixelSize(int zoom);
 
@@ -74,7 +93,11 @@ protected:
     // MapView interface
 public:
     virtual bool draw(ngsDrawState state, const Progress &progress) override;
+    virtual bool drawToBuffer(int width, int height, void *buffer,
+                              const Progress &progress) override;
     virtual void invalidate(const Envelope& bounds) override;
+    virtual void invalidateLayer(const Envelope &bounds,
+                                 const LayerPtr &layer) override;
     virtual bool setSelectionStyleName(enum ngsStyleType styleType,
                                        const std::string &name) override;
     virtual bool setSelectionStyle(enum ngsStyleType styleType,
@@ -84,7 +107,8 @@ public:
     virtual bool addIconSet(const std::string &name, const std::string &path,
                             bool ownByMap) override;
     virtual bool removeIconSet(const std::string &name) override;
-
+    virtual bool setOptions(const Options &options) override;
+    virtual ngsRenderStats renderStats() const override;
 
     // MapView interface
 protected:
@@ -94,6 +118,8 @@ protected:
     // static
 protected:
     static bool layerDataFillJobThreadFunc(ThreadData *threadData);
+    static bool layerDataFillJobFilter(const ThreadData *threadData,
+                                       void *tiles);
 
 #ifdef NGS_GL_DEBUG
     // Test functions
@@ -110,12 +136,36 @@ private:
 private:
     GlColor m_glBkColor;
     std::vector<GlObjectPtr> m_freeResources;
-    std::vector<GlTilePtr> m_tiles, m_oldTiles;
+    std::vector<GlTilePtr> m_tiles, m_oldTiles, m_prefetchTiles;
+    GlFrame m_frame;
     TextureAtlas m_textureAtlas;
     Envelope m_invalidRegion;
+    TileRange m_tileRange;
+    double m_tileRangeRotate;
+    std::vector<int> m_tileRangeCorners;
+    /**
+     * @brief The LayerRefill struct Layer data of filled tile to free and
+     * refill on next draw.
+     */
+    typedef struct _layerRefill {
+        GlTilePtr tile;
+        LayerPtr layer;
+    } LayerRefill;
+    std::vector<LayerRefill> m_layerRefills;
     SimpleImageStyle m_fboDrawStyle;
+    GlDensityFrame m_layerFrame;
+    GlProgramPtr m_layerProgram;
     SelectionStyles m_selectionStyles;
+    GlLabels m_labels;
     ThreadPool m_threadPool;
+    bool m_keepTileBuffers;
+    bool m_prefetch;
+    long long m_prefetchMemoryLimit;
+    unsigned int m_trimGeneration;
+    long long m_tileMemoryLimit;
+    unsigned int m_drawNumber;
+    // Programs are loaded to the cache in first draw, GL context is needed
+    bool m_programsLoaded;
 };
 
 }  // namespace ngs
@@ -25,6 +25,9 @@
 #include "ngstore/util/constants.h"
 #include "util/error.h"
 
+// std
+#include <algorithm>
+
 namespace ngs {
 
 constexpr const char *LAYER_NAME_KEY = "name";
@@ -32,6 +35,8 @@ constexpr const char *LAYER_SOURCE_KEY = "src";
 constexpr const char *LAYER_VISIBLE_KEY = "visible";
 constexpr const char *LAYER_MIN_ZOOM_KEY = "min_zoom";
 constexpr const char *LAYER_MAX_ZOOM_KEY = "max_zoom";
+constexpr const char *LAYER_OPACITY_KEY = "opacity";
+constexpr const char *LAYER_SNAPPING_KEY = "snapping";
 
 //------------------------------------------------------------------------------
 // Layer
@@ -43,20 +48,62 @@ Layer::Layer(Map *map, const std::string &name, enum Type type) :
     m_visible(true),
     m_minZoom(-1.0f),
     m_maxZoom(256.0f),
-    m_map(map)
+    m_opacity(1.0f),
+    m_map(map),
+    m_sourceContainer(nullptr),
+    m_bound(true)
 {
 }
 
+/**
+ * @brief Layer::load Load layer properties. The datasource is not opened,
+ * call bind after load.
+ * @param store Layer properties.
+ * @param objectContainer Container to resolve relative source path or null if
+ * path is absolute.
+ * @return True on success.
+ */
 bool Layer::load(const CPLJSONObject &store, ObjectContainer *objectContainer)
 {
-    ngsUnused(objectContainer);
     m_name = store.GetString(LAYER_NAME_KEY, m_name);
     m_visible = store.GetBool(LAYER_VISIBLE_KEY, m_visible);
     m_minZoom = static_cast<float>(store.GetDouble(LAYER_MIN_ZOOM_KEY, m_minZoom));
     m_maxZoom = static_cast<float>(store.GetDouble(LAYER_MAX_ZOOM_KEY, m_maxZoom));
+    setOpacity(static_cast<float>(store.GetDouble(LAYER_OPACITY_KEY, m_opacity)));
+    m_source = store.GetString(LAYER_SOURCE_KEY, "");
+    m_sourceContainer = objectContainer;
+    return true;
+}
+
+/**
+ * @brief Layer::bind Open datasource of loaded layer. Layer draws nothing
+ * until bound. May be executed from separate thread.
+ * @return True if datasource is opened.
+ */
+bool Layer::bind()
+{
+    if(m_bound) {
+        return true;
+    }
+    if(!bindDatasource()) {
+        return false;
+    }
+    m_bound = true;
     return true;
 }
 
+ObjectPtr Layer::sourceObject() const
+{
+    // Check absolute or relative catalog path
+    if(nullptr == m_sourceContainer) { // absolute path
+        CatalogPtr catalog = Catalog::instance();
+        return catalog->getObject(m_source);
+    }
+    // relative path
+    CPLDebug("ngstore", "Layer load %s", m_source.c_str());
+    return Catalog::fromRelativePath(m_source, m_sourceContainer);
+}
+
 CPLJSONObject Layer::save(const ObjectContainer *objectContainer) const
 {
     ngsUnused(objectContainer);
@@ -66,15 +113,24 @@ CPLJSONObject Layer::save(const ObjectContainer *objectContainer) const
     out.Add(LAYER_VISIBLE_KEY, m_visible);
     out.Add(LAYER_MIN_ZOOM_KEY, m_minZoom);
     out.Add(LAYER_MAX_ZOOM_KEY, m_maxZoom);
+    if(m_opacity < 1.0f) {
+        out.Add(LAYER_OPACITY_KEY, m_opacity);
+    }
     return out;
 }
 
+void Layer::setOpacity(float opacity)
+{
+    m_opacity = std::max(0.0f, std::min(opacity, 1.0f));
+}
+
 //------------------------------------------------------------------------------
 // FeatureLayer
 //------------------------------------------------------------------------------
 
 FeatureLayer::FeatureLayer(Map *map, const std::string &name) :
-    Layer(map, name, Type::Vector)
+    Layer(map, name, Type::Vector),
+    m_snapping(false)
 {
 }
 
@@ -85,37 +141,126 @@ bool FeatureLayer::load(const CPLJSONObject &store, ObjectContainer *objectConta
         return false;
     }
 
-    std::string path = store.GetString(LAYER_SOURCE_KEY, "");
-    ObjectPtr fcObject;
-    // Check absolute or relative catalog path
-    if(nullptr == objectContainer) { // absolute path
-        CatalogPtr catalog = Catalog::instance();
-        fcObject = catalog->getObject(path);
-    }
-    else { // relative path
-        CPLDebug("ngstore", "Layer load %s", path.c_str());
-        fcObject = Catalog::fromRelativePath(path, objectContainer);
-    }
+    m_snapping = store.GetBool(LAYER_SNAPPING_KEY, m_snapping);
+    m_bound = false;
+    return true;
+}
 
-    m_featureClass = std::dynamic_pointer_cast<FeatureClassOverview>(fcObject);
+bool FeatureLayer::bindDatasource()
+{
+    m_featureClass = std::dynamic_pointer_cast<FeatureClassOverview>(
+                sourceObject());
     if(m_featureClass) {
         return true;
     }
-    CPLDebug("ngstore", "Layer load %s failed", path.c_str());
+    CPLDebug("ngstore", "Layer load %s failed", m_source.c_str());
     return false;
 }
 
 CPLJSONObject FeatureLayer::save(const ObjectContainer *objectContainer) const
 {
     CPLJSONObject out = Layer::save(objectContainer);
+    // Not yet bound layer keeps the loaded path
+    if(!m_bound) {
+        out.Add(LAYER_SOURCE_KEY, m_source);
+    }
     // Check absolute or relative catalog path
-    if(nullptr == objectContainer) { // absolute path
+    else if(nullptr == objectContainer) { // absolute path
         out.Add(LAYER_SOURCE_KEY, m_featureClass->path());
     }
     else { // relative path
         out.Add(LAYER_SOURCE_KEY,
                 Catalog::toRelativePath(m_featureClass.get(), objectContainer));
     }
+    out.Add(LAYER_SNAPPING_KEY, m_snapping);
+    return out;
+}
+
+/**
+ * @brief FeatureLayer::identify Find features which geometries intersect the
+ * extent. Executed from separate thread.
+ * @param env Extent in map coordinates.
+ * @param cancel Cancel token.
+ * @return Feature identifiers. Hidden features are not excluded.
+ */
+FeatureIDs FeatureLayer::identify(const Envelope &env,
+                                  const CancelToken &cancel) const
+{
+    FeatureIDs out;
+    if(!m_bound || !m_featureClass) {
+        return out;
+    }
+
+    GeometryPtr rect = env.toGeometry(SpatialReferencePtr());
+    for(const FeaturePtr &feature : m_featureClass->featuresInExtent(env, cancel)) {
+        OGRGeometry *geom = feature->GetGeometryRef();
+        if(nullptr != geom && geom->Intersects(rect)) {
+            out.insert(feature->GetFID());
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief FeatureLayer::snap Find the nearest vertex or segment point of layer
+ * features. Layers without cached geometry do not snap.
+ * @param pt Point in map coordinates.
+ * @param tolerance Snap distance in map units.
+ * @param result Nearest point found so far, updated if a better one is found.
+ * @return True if result was updated.
+ */
+bool FeatureLayer::snap(const OGRRawPoint &pt, double tolerance,
+                        SnapResult &result) const
+{
+    ngsUnused(pt);
+    ngsUnused(tolerance);
+    ngsUnused(result);
+    return false;
+}
+
+/**
+ * @brief FeatureLayer::setLabelStyle Set label field and style. Labels are
+ * supported only by renderable layers.
+ * @param style Label style with the field key.
+ * @return False.
+ */
+bool FeatureLayer::setLabelStyle(const CPLJSONObject &style)
+{
+    ngsUnused(style);
+    return false;
+}
+
+/**
+ * @brief FeatureLayer::refineIdentify Check candidate features by exact
+ * geometry.
+ * @param candidates Features which envelopes intersect the extent.
+ * @param env Extent in map coordinates.
+ * @param cancel Cancel token.
+ * @return Feature identifiers which geometries intersect the extent.
+ */
+FeatureIDs FeatureLayer::refineIdentify(const FeatureIDs &candidates,
+                                        const Envelope &env,
+                                        const CancelToken &cancel) const
+{
+    FeatureIDs out;
+    if(!m_bound || !m_featureClass || candidates.empty()) {
+        return out;
+    }
+
+    GeometryPtr rect = env.toGeometry(SpatialReferencePtr());
+    for(GIntBig fid : candidates) {
+        if(cancel.isCanceled()) {
+            return FeatureIDs();
+        }
+        FeaturePtr feature = m_featureClass->getFeature(fid);
+        if(!feature) {
+            continue;
+        }
+        OGRGeometry *geom = feature->GetGeometryRef();
+        if(nullptr != geom && geom->Intersects(rect)) {
+            out.insert(fid);
+        }
+    }
     return out;
 }
 
@@ -135,32 +280,32 @@ bool RasterLayer::load(const CPLJSONObject &store, ObjectContainer *objectContai
         return false;
     }
 
-    std::string path = store.GetString(LAYER_SOURCE_KEY, "");
-    ObjectPtr fcObject;
-    // Check absolute or relative catalog path
-    if(nullptr == objectContainer) { // absolute path
-        CatalogPtr catalog = Catalog::instance();
-        fcObject = catalog->getObject(path);
-    }
-    else { // relative path
-        fcObject = Catalog::fromRelativePath(path, objectContainer);
-    }
+    m_bound = false;
+    return true;
+}
 
-    m_raster = std::dynamic_pointer_cast<Raster>(fcObject);
-    if(m_raster) {
-        return m_raster->open(GDAL_OF_SHARED|GDAL_OF_READONLY|GDAL_OF_VERBOSE_ERROR);
+bool RasterLayer::bindDatasource()
+{
+    RasterPtr raster = std::dynamic_pointer_cast<Raster>(sourceObject());
+    if(!raster) {
+        return errorMessage(_("Raster not found in path: %s"), m_source.c_str());
     }
-    else {
-        errorMessage(_("Raster not found in path: %s"), path.c_str());
+    if(!raster->open(GDAL_OF_SHARED|GDAL_OF_READONLY|GDAL_OF_VERBOSE_ERROR)) {
+        return false;
     }
-    return false;
+    m_raster = raster;
+    return true;
 }
 
 CPLJSONObject RasterLayer::save(const ObjectContainer *objectContainer) const
 {
     CPLJSONObject out = Layer::save(objectContainer);
+    // Not yet bound layer keeps the loaded path
+    if(!m_bound) {
+        out.Add(LAYER_SOURCE_KEY, m_source);
+    }
     // Check absolute or relative catalog path
-    if(nullptr == objectContainer) { // absolute path
+    else if(nullptr == objectContainer) { // absolute path
         out.Add(LAYER_SOURCE_KEY, m_raster->path());
     }
     else { // relative path
@@ -22,6 +22,7 @@
 #define NGSLAYER_H
 
 // stl
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -65,34 +66,56 @@ public:
     virtual bool visible() const { return m_visible; }
     virtual float minZoom() const { return m_minZoom; }
     virtual float maxZoom() const { return m_maxZoom; }
+    /**
+     * @brief opacity Layer opacity from 0 to 1. Layer with opacity less than 1
+     * is drawn to tile at once, so its items do not blend with each other.
+     */
+    virtual float opacity() const { return m_opacity; }
     virtual void setVisible(bool visible) { m_visible = visible; }
     virtual void setMinZoom(float zoom) { m_minZoom = zoom; }
     virtual void setMaxZoom(float zoom) { m_maxZoom = zoom; }
+    virtual void setOpacity(float opacity);
     Map *map() const { return m_map; }
+    bool bind();
+    bool isBound() const { return m_bound; }
+
+protected:
+    /**
+     * @brief bindDatasource Open datasource by the source path stored on load.
+     * May be executed from separate thread.
+     * @return True if datasource is opened.
+     */
+    virtual bool bindDatasource() { return true; }
+    ObjectPtr sourceObject() const;
+
 protected:
     std::string m_name;
     enum Type m_type;
     bool m_visible;
     float m_minZoom, m_maxZoom;
+    float m_opacity;
     Map *m_map;
+    // Source path and container stored on load to open datasource later
+    std::string m_source;
+    ObjectContainer *m_sourceContainer;
+    // Datasource members are read only after the flag is set
+    std::atomic_bool m_bound;
 };
 
 using LayerPtr = std::shared_ptr<Layer>;
-using FeatureIDs = std::set<GIntBig>;
 
 class ISelectableFeatureLayer {
 public:
     virtual ~ISelectableFeatureLayer() = default;
     virtual void setSelectedIds(const FeatureIDs &selectedIds) {
-        m_selectedFIDs.clear();
-        m_selectedFIDs.insert(selectedIds.begin(), selectedIds.end());
+        m_selectedFIDs = selectedIds;
     }
     virtual const FeatureIDs &selectedIds() const { return m_selectedFIDs; }
     virtual bool hasSelectedIds() const { return !m_selectedFIDs.empty(); }
     virtual void setHideIds(const FeatureIDs& hideIds = FeatureIDs()) {
-        m_hideFIDs.clear();
-        m_hideFIDs.insert(hideIds.begin(), hideIds.end());
+        m_hideFIDs = hideIds;
     }
+    virtual const FeatureIDs &hideIds() const { return m_hideFIDs; }
 protected:
     FeatureIDs m_selectedFIDs;
     FeatureIDs m_hideFIDs;
@@ -104,6 +127,32 @@ public:
     virtual bool setStyle(const CPLJSONObject &style) = 0;
     virtual CPLJSONObject style() const = 0;
     virtual std::string styleName() const = 0;
+    virtual double fillLatency(double percentile) const = 0;
+};
+
+/**
+ * @brief The SnapResult struct Nearest point found by snapping. Vertices take
+ * precedence over points on segments.
+ */
+struct SnapResult
+{
+    SnapResult() : distance2(0.0), vertex(false), found(false) {}
+    void update(const OGRRawPoint &pt, double dist2, bool isVertex) {
+        if(found && (vertex && !isVertex)) {
+            return;
+        }
+        if(!found || (isVertex && !vertex) || dist2 < distance2) {
+            point = pt;
+            distance2 = dist2;
+            vertex = isVertex;
+            found = true;
+        }
+    }
+
+    OGRRawPoint point;
+    double distance2;
+    bool vertex;
+    bool found;
 };
 
 /**
@@ -116,18 +165,34 @@ public:
     virtual ~FeatureLayer() override = default;
     virtual void setFeatureClass(const FeatureClassOverviewPtr &featureClass) {
         m_featureClass = featureClass;
+        m_bound = true;
     }
+    virtual FeatureIDs identify(const Envelope &env,
+                                const CancelToken &cancel = CancelToken()) const;
+    virtual void setSnapping(bool snapping) { m_snapping = snapping; }
+    virtual bool snapping() const { return m_snapping; }
+    virtual bool snap(const OGRRawPoint &pt, double tolerance,
+                      SnapResult &result) const;
+    virtual bool setLabelStyle(const CPLJSONObject &style);
+    virtual CPLJSONObject labelStyle() const { return CPLJSONObject(); }
 
     // Layer interface
 public:
     virtual bool load(const CPLJSONObject &store, ObjectContainer *objectContainer) override;
     virtual CPLJSONObject save(const ObjectContainer *objectContainer) const override;
     virtual ObjectPtr datasource() const override {
-        return std::dynamic_pointer_cast<Object>(m_featureClass);
+        return m_bound ? std::dynamic_pointer_cast<Object>(m_featureClass) :
+                         ObjectPtr();
     }
 
+protected:
+    virtual bool bindDatasource() override;
+    FeatureIDs refineIdentify(const FeatureIDs &candidates, const Envelope &env,
+                              const CancelToken &cancel) const;
+
 protected:
     FeatureClassOverviewPtr m_featureClass;
+    bool m_snapping;
 };
 
 /**
@@ -140,6 +205,7 @@ public:
     virtual ~RasterLayer() override = default;
     virtual void setRaster(const RasterPtr &raster) {
         m_raster = raster;
+        m_bound = true;
     }
 
     // Layer interface
@@ -147,9 +213,13 @@ public:
     virtual bool load(const CPLJSONObject &store, ObjectContainer *objectContainer) override;
     virtual CPLJSONObject save(const ObjectContainer *objectContainer) const override;
     virtual ObjectPtr datasource() const override {
-        return std::dynamic_pointer_cast<Object>(m_raster);
+        return m_bound ? std::dynamic_pointer_cast<Object>(m_raster) :
+                         ObjectPtr();
     }
 
+protected:
+    virtual bool bindDatasource() override;
+
 protected:
     RasterPtr m_raster;
 };
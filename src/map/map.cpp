@@ -41,6 +41,7 @@ constexpr const char *MAP_RELATIVEPATHS_KEY = "relative_paths";
 constexpr const char *MAP_EPSG_KEY = "epsg";
 constexpr const char *MAP_BKCOLOR_KEY = "bk_color";
 constexpr const char *MAP_BOUNDS_KEY = "bounds";
+constexpr const char *MAP_LAZY_LAYERS_OPTION = "LAZY_LAYERS";
 
 //------------------------------------------------------------------------------
 // Map
@@ -52,7 +53,11 @@ Map::Map() :
     m_bounds(DEFAULT_BOUNDS),
     m_bkColor(DEFAULT_MAP_BK),
     m_relativePaths(true),
-    m_isClosed(false)
+    m_isClosed(false),
+    m_lazyLayers(false),
+    m_bindThread(nullptr),
+    m_bindingLayers(false),
+    m_stopBinding(false)
 {
 }
 
@@ -64,10 +69,19 @@ Map::Map(const std::string &name, const std::string &description,
     m_bounds(bounds),
     m_bkColor(DEFAULT_MAP_BK),
     m_relativePaths(true),
-    m_isClosed(false)
+    m_isClosed(false),
+    m_lazyLayers(false),
+    m_bindThread(nullptr),
+    m_bindingLayers(false),
+    m_stopBinding(false)
 {
 }
 
+Map::~Map()
+{
+    stopLayersBinding();
+}
+
 bool Map::openInternal(const CPLJSONObject &root, MapFile * const mapFile)
 {
     m_name = root.GetString(MAP_NAME_KEY, DEFAULT_MAP_NAME);
@@ -87,12 +101,20 @@ bool Map::openInternal(const CPLJSONObject &root, MapFile * const mapFile)
                     layerConfig.GetInteger(LAYER_TYPE_KEY, 0));
         // load layer
         LayerPtr layer = createLayer(DEFAULT_LAYER_NAME, type);
-        if(nullptr != layer) {
-            if(layer->load(layerConfig, m_relativePaths ?
-                           mapFile->parent() : nullptr)) {
-                m_layers.push_back(layer);
+        if(nullptr == layer || !layer->load(layerConfig, m_relativePaths ?
+                                            mapFile->parent() : nullptr)) {
+            continue;
+        }
+        if(m_lazyLayers) {
+            // Layer is drawn empty until its datasource is opened
+            m_layers.push_back(layer);
+            if(!layer->isBound()) {
+                m_unboundLayers.push_back(layer);
             }
         }
+        else if(layer->bind()) {
+            m_layers.push_back(layer);
+        }
     }
 
     m_isClosed = false;
@@ -117,8 +139,19 @@ bool Map::saveInternal(CPLJSONObject &root, MapFile * const mapFile)
     return true;
 }
 
-bool Map::open(MapFile * const mapFile)
+/**
+ * @brief Map::open Open map from file.
+ * @param mapFile Map file.
+ * @param options LAZY_LAYERS - if ON, layers datasources are opened in
+ * separate thread after map open and layers are drawn empty until ready.
+ * Layers which datasource failed to open are kept in map. Default OFF.
+ * @return True on success.
+ */
+bool Map::open(MapFile * const mapFile, const Options &options)
 {
+    stopLayersBinding();
+    m_lazyLayers = options.asBool(MAP_LAZY_LAYERS_OPTION, false);
+
     CPLJSONDocument doc;
     std::string mapPath("/vsizip/");
     mapPath += mapFile->path();
@@ -128,7 +161,11 @@ bool Map::open(MapFile * const mapFile)
     }
 
     CPLJSONObject root = doc.GetRoot();
-    return openInternal(root, mapFile);
+    if(!openInternal(root, mapFile)) {
+        return false;
+    }
+    startLayersBinding();
+    return true;
 }
 
 bool Map::save(MapFile * const mapFile)
@@ -149,11 +186,84 @@ bool Map::save(MapFile * const mapFile)
 
 bool Map::close()
 {
+    stopLayersBinding();
     m_layers.clear();
     m_isClosed = true;
     return true;
 }
 
+/**
+ * @brief Map::startLayersBinding Open datasources of layers loaded without
+ * them in separate thread. Bound layers are collected to refill by the view.
+ */
+void Map::startLayersBinding()
+{
+    if(m_unboundLayers.empty()) {
+        return;
+    }
+    m_stopBinding = false;
+    m_bindingLayers = true;
+    m_bindThread = CPLCreateJoinableThread(bindLayersThread, this);
+    if(nullptr == m_bindThread) {
+        bindLayersThread(this);
+    }
+}
+
+void Map::stopLayersBinding()
+{
+    if(nullptr != m_bindThread) {
+        m_stopBinding = true;
+        CPLJoinThread(m_bindThread);
+        m_bindThread = nullptr;
+    }
+    m_bindingLayers = false;
+    m_unboundLayers.clear();
+    MutexHolder holder(m_bindMutex);
+    m_boundLayers.clear();
+}
+
+/**
+ * @brief Map::takeBoundLayers Get layers bound since previous call.
+ * @return Layers which datasources were opened.
+ */
+std::vector<LayerPtr> Map::takeBoundLayers()
+{
+    std::vector<LayerPtr> out;
+    MutexHolder holder(m_bindMutex);
+    out.swap(m_boundLayers);
+    return out;
+}
+
+/**
+ * @brief Map::isBindingLayers Check if layers datasources are opening or
+ * bound layers are not taken yet.
+ * @return True if some layers will change their data.
+ */
+bool Map::isBindingLayers() const
+{
+    if(m_bindingLayers) {
+        return true;
+    }
+    MutexHolder holder(m_bindMutex);
+    return !m_boundLayers.empty();
+}
+
+void Map::bindLayersThread(void *data)
+{
+    Map *map = static_cast<Map*>(data);
+    for(const LayerPtr &layer : map->m_unboundLayers) {
+        if(map->m_stopBinding) {
+            break;
+        }
+        // Layer which datasource failed to open stays empty
+        if(layer->bind()) {
+            MutexHolder holder(map->m_bindMutex);
+            map->m_boundLayers.push_back(layer);
+        }
+    }
+    map->m_bindingLayers = false;
+}
+
 LayerPtr Map::getLayer(int layerId) const
 {
     if(layerId < 0) {
@@ -28,6 +28,8 @@
 
 #include "ds/datastore.h"
 #include "ngstore/codes.h"
+#include "util/mutex.h"
+#include "util/options.h"
 
 namespace ngs {
 
@@ -38,7 +40,7 @@ public:
     Map();
     explicit Map(const std::string& name, const std::string& description,
                  unsigned short epsg, const Envelope &bounds);
-    virtual ~Map() = default;
+    virtual ~Map();
 
     const std::string &name() const { return m_name; }
     void setName(const std::string &name) { m_name = name; }
@@ -55,7 +57,7 @@ public:
     bool isRelativePaths() const { return m_relativePaths; }
     void setRelativePaths(bool relativePaths) { m_relativePaths = relativePaths; }
 
-    bool open(MapFile * const mapFile);
+    bool open(MapFile * const mapFile, const Options &options = Options());
     bool save(MapFile * const mapFile);
 
     virtual bool close();
@@ -68,12 +70,20 @@ public:
     virtual int createLayer(const std::string &name, const ObjectPtr &object);
     virtual bool deleteLayer(Layer *layer);
     virtual bool reorderLayers(Layer *beforeLayer, Layer *movedLayer);
+    bool isBindingLayers() const;
 
 protected:
     virtual LayerPtr createLayer(const std::string &name = DEFAULT_LAYER_NAME,
                                  enum Layer::Type type = Layer::Type::Invalid);
     virtual bool openInternal(const CPLJSONObject &root, MapFile * const mapFile);
     virtual bool saveInternal(CPLJSONObject &root, MapFile * const mapFile);
+    void startLayersBinding();
+    void stopLayersBinding();
+    std::vector<LayerPtr> takeBoundLayers();
+
+    // static
+protected:
+    static void bindLayersThread(void *data);
 
 protected:
     std::string m_name;
@@ -83,6 +93,12 @@ protected:
     std::vector<LayerPtr> m_layers;
     ngsRGBA m_bkColor;
     bool m_relativePaths, m_isClosed;
+    // Layers datasources are opened in separate thread after map open
+    bool m_lazyLayers;
+    std::vector<LayerPtr> m_unboundLayers, m_boundLayers;
+    Mutex m_bindMutex;
+    CPLJoinableThread *m_bindThread;
+    std::atomic_bool m_bindingLayers, m_stopBinding;
 };
 
 }
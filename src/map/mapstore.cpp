@@ -24,6 +24,8 @@
 #include <limits>
 #include <util/error.h>
 
+#include "cpl_multiproc.h"
+
 #include "ngstore/util/constants.h"
 #include "util/notify.h"
 
@@ -62,9 +64,9 @@ char MapStore::createMap(const std::string &name, const std::string &description
     return mapId;
 }
 
-char MapStore::openMap(MapFile * const file)
+char MapStore::openMap(MapFile * const file, const Options &options)
 {
-    if(nullptr == file || !file->open()) {
+    if(nullptr == file || !file->open(options)) {
         return INVALID_MAPID;
     }
 
@@ -162,6 +164,27 @@ bool MapStore::drawMap(char mapId, ngsDrawState state, const Progress &progress)
     return map->draw(state, progress);
 }
 
+bool MapStore::drawMapToBuffer(char mapId, int width, int height,
+                               void *buffer, const Progress &progress)
+{
+    MapViewPtr map = getMap(mapId);
+    if(!map) {
+        return errorMessage(_("Map with id %d not exists"), mapId);
+    }
+    return map->drawToBuffer(width, height, buffer, progress);
+}
+
+bool MapStore::exportMap(char mapId, const std::string &path, int width,
+                         int height, const Envelope &extent,
+                         const Options &options, const Progress &progress)
+{
+    MapViewPtr map = getMap(mapId);
+    if(!map) {
+        return errorMessage(_("Map with id %d not exists"), mapId);
+    }
+    return map->exportImage(path, width, height, extent, options, progress);
+}
+
 void MapStore::invalidateMap(char mapId, const Envelope &bounds)
 {
     MapViewPtr map = getMap(mapId);
@@ -171,6 +194,24 @@ void MapStore::invalidateMap(char mapId, const Envelope &bounds)
     map->invalidate(bounds);
 }
 
+bool MapStore::invalidateMapLayer(char mapId, Layer *layer,
+                                  const Envelope &bounds)
+{
+    MapViewPtr map = getMap(mapId);
+    if(!map) {
+        return errorMessage(_("Map with id %d not exists"), mapId);
+    }
+
+    for(size_t i = 0; i < map->layerCount(); ++i) {
+        LayerPtr mapLayer = map->getLayer(static_cast<int>(i));
+        if(mapLayer.get() == layer) {
+            map->invalidateLayer(bounds, mapLayer);
+            return true;
+        }
+    }
+    return errorMessage(_("Layer is not in map"));
+}
+
 ngsRGBA MapStore::getMapBackgroundColor(char mapId) const
 {
     MapViewPtr map = getMap(mapId);
@@ -382,6 +423,88 @@ bool MapStore::setOptions(char mapId, const Options& options)
     return map->setOptions(options);
 }
 
+ngsRenderStats MapStore::getMapRenderStats(char mapId) const
+{
+    MapViewPtr map = getMap(mapId);
+    if(!map) {
+        return {0, 0, 0, 0, 0, 0.0, 0.0, 0.0, 0, 0};
+    }
+    return map->renderStats();
+}
+
+/**
+ * @brief The IdentifyJob struct Identify state passed to the worker thread.
+ * Layers are kept alive until the job finished even if removed from map.
+ */
+typedef struct _identifyJob {
+    std::vector<LayerPtr> layers;
+    std::vector<FeatureIDs> hideIds;
+    Envelope env;
+    IdentifyCallback callback;
+} IdentifyJob;
+
+static void identifyThread(void *data)
+{
+    IdentifyJob *job = static_cast<IdentifyJob*>(data);
+    std::vector<IdentifyResult> results;
+    for(size_t i = 0; i < job->layers.size(); ++i) {
+        FeatureLayer *featureLayer =
+                ngsDynamicCast(FeatureLayer, job->layers[i]);
+        FeatureIDs ids = featureLayer->identify(job->env);
+        ids.erase(job->hideIds[i]);
+        if(!ids.empty()) {
+            results.push_back({job->layers[i], ids});
+        }
+    }
+    job->callback(results);
+    delete job;
+}
+
+/**
+ * @brief MapStore::identifyMap Find features of visible vector layers under
+ * the display point. Search is executed in the separate thread by already
+ * loaded tiles, exact geometries are read only for the ambiguous features.
+ * @param mapId Map identifier
+ * @param x Display X coordinate
+ * @param y Display Y coordinate
+ * @param tolerance Search radius in display pixels
+ * @param callback Function executed from the separate thread with results.
+ * Results are ordered from the top layer to the bottom one.
+ * @return True if identify started.
+ */
+bool MapStore::identifyMap(char mapId, double x, double y, double tolerance,
+                           const IdentifyCallback &callback) const
+{
+    MapViewPtr map = getMap(mapId);
+    if(!map) {
+        return errorMessage(_("Map with id %d not exists"), mapId);
+    }
+
+    IdentifyJob *job = new IdentifyJob;
+    job->env = map->displayToWorld(Envelope(x - tolerance, y - tolerance,
+                                            x + tolerance, y + tolerance));
+    job->env.fix();
+    job->callback = callback;
+
+    unsigned char zoom = map->getZoom();
+    for(size_t i = map->layerCount(); i > 0; --i) {
+        LayerPtr layer = map->getLayer(static_cast<int>(i - 1));
+        FeatureLayer *featureLayer = ngsDynamicCast(FeatureLayer, layer);
+        if(nullptr == featureLayer || !layer->visible() ||
+                zoom <= layer->minZoom() || zoom >= layer->maxZoom()) {
+            continue;
+        }
+        job->layers.push_back(layer);
+        job->hideIds.push_back(featureLayer->hideIds());
+    }
+
+    if(CPLCreateThread(identifyThread, job) == -1) {
+        delete job;
+        return errorMessage(_("Failed to start identify thread"));
+    }
+    return true;
+}
+
 bool MapStore::setExtentLimits(char mapId, const Envelope &extentLimits)
 {
     MapViewPtr map = getMap(mapId);
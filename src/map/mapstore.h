@@ -21,10 +21,21 @@
 #ifndef NGSMAPSTORE_H
 #define NGSMAPSTORE_H
 
+#include <functional>
+
 #include "catalog/mapfile.h"
 
 namespace ngs {
 
+/**
+ * @brief The IdentifyResult struct Layer features found by identify.
+ */
+typedef struct _identifyResult {
+    LayerPtr layer;
+    FeatureIDs ids;
+} IdentifyResult;
+
+using IdentifyCallback = std::function<void(const std::vector<IdentifyResult>&)>;
 
 /**
  * @brief The MapStore class provides functionality to create, open, close, etc.
@@ -50,7 +61,8 @@ public:
     virtual char createMap(const std::string &name,
                            const std::string &description,
                            unsigned short epsg, const Envelope &bounds);
-    virtual char openMap(MapFile * const file);
+    virtual char openMap(MapFile * const file,
+                         const Options &options = Options());
     virtual bool saveMap(char mapId, MapFile * const file);
     virtual bool closeMap(char mapId);
     virtual bool reopenMap(char mapId, MapFile * const file);
@@ -61,7 +73,13 @@ public:
 
     // Map manipulation
     bool drawMap(char mapId, enum ngsDrawState state, const Progress &progress = Progress());
+    bool drawMapToBuffer(char mapId, int width, int height, void *buffer,
+                         const Progress &progress = Progress());
+    bool exportMap(char mapId, const std::string &path, int width, int height,
+                   const Envelope &extent, const Options &options,
+                   const Progress &progress = Progress());
     void invalidateMap(char mapId, const Envelope &bounds);
+    bool invalidateMapLayer(char mapId, Layer *layer, const Envelope &bounds);
 
     bool setMapSize(char mapId, int width, int height, bool YAxisInverted);
     ngsRGBA getMapBackgroundColor(char mapId) const;
@@ -82,6 +100,9 @@ public:
     bool deleteLayer(char mapId, Layer *layer);
     bool reorderLayers(char mapId, Layer *beforeLayer, Layer *movedLayer);
     bool setOptions(char mapId, const Options &options);
+    ngsRenderStats getMapRenderStats(char mapId) const;
+    bool identifyMap(char mapId, double x, double y, double tolerance,
+                     const IdentifyCallback &callback) const;
     bool setExtentLimits(char mapId, const Envelope &extentLimits);
     OverlayPtr getOverlay(char mapId, enum ngsMapOverlayType type) const;
     bool setOverlayVisible(char mapId, int typeMask, bool visible);
@@ -308,6 +308,7 @@ void MapTransform::setRotateExtent()
     inPt[3] = glm::vec4(m_displayWidht, 0.0f, 0.0f, 1.0f);
 
     pt = m_invWorldToDisplayMatrix * inPt[0];
+    m_rotateCorners[0] = OGRRawPoint(double(pt[0]), double(pt[1]));
     m_rotateExtent.setMinX(double(pt[0]));
     m_rotateExtent.setMaxX(double(pt[0]));
     m_rotateExtent.setMinY(double(pt[1]));
@@ -316,6 +317,7 @@ void MapTransform::setRotateExtent()
 
     for(unsigned char i = 1; i < 4; ++i) {
         pt = m_invWorldToDisplayMatrix * inPt[i];
+        m_rotateCorners[i] = OGRRawPoint(double(pt[0]), double(pt[1]));
         if(double(pt[0]) > m_rotateExtent.maxX())
             m_rotateExtent.setMaxX(double(pt[0]));
         if(double(pt[0]) < m_rotateExtent.minX())
@@ -394,104 +396,198 @@ void MapTransform::setExtentLimits(const Envelope &extentLimit)
 std::vector<TileItem> MapTransform::getTilesForExtent(
         const Envelope &extent, unsigned char zoom, bool reverseY, bool unlimitX)
 {
-    Envelope env;
+    TileRange range(extent, zoom, reverseY, unlimitX);
     std::vector<TileItem> result;
-    if(zoom == 0) { // If zoom 0 - return one tile
-        env = DEFAULT_BOUNDS;
-        TileItem item = { {0, 0, zoom, 0}, env };
-        result.push_back (item);
-        return result;
+    result.reserve(std::min(range.size(), static_cast<size_t>(MAX_TILES_COUNT)));
+    for(const TileItem &item : range) {
+        result.push_back(item);
+        if(result.size() > MAX_TILES_COUNT) { // Limit for tiles array size
+            break;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief MapTransform::isTileVisible Check if tile intersects the viewport.
+ * For rotated view the viewport is a polygon, so the tiles in corners of its
+ * bounding box are skipped.
+ * @param tileExtent Tile extent in world coordinates, moved by tile cross
+ * extent
+ * @param resize Viewport resize factor as in Envelope::resize
+ * @return True if tile intersects viewport
+ */
+bool MapTransform::isTileVisible(const Envelope &tileExtent, double resize) const
+{
+    Envelope viewExtent = m_rotateExtent;
+    viewExtent.resize(resize);
+    if(!viewExtent.intersects(tileExtent)) {
+        return false;
+    }
+    if(!isRotated()) {
+        return true;
+    }
+
+    // Separating axis test. The tile box axes are checked above by the
+    // bounding box, here the viewport edge normals are checked.
+    OGRRawPoint center = ngsGetMiddlePoint(m_rotateCorners[0],
+                                           m_rotateCorners[2]);
+    OGRRawPoint corners[4];
+    for(unsigned char i = 0; i < 4; ++i) {
+        corners[i].x = center.x + (m_rotateCorners[i].x - center.x) * resize;
+        corners[i].y = center.y + (m_rotateCorners[i].y - center.y) * resize;
+    }
+    OGRRawPoint tileCorners[4] = {
+        {tileExtent.minX(), tileExtent.minY()},
+        {tileExtent.minX(), tileExtent.maxY()},
+        {tileExtent.maxX(), tileExtent.maxY()},
+        {tileExtent.maxX(), tileExtent.minY()}
+    };
+    for(unsigned char i = 0; i < 2; ++i) {
+        double nx = corners[i + 1].y - corners[i].y;
+        double ny = corners[i].x - corners[i + 1].x;
+        double polyMin = corners[0].x * nx + corners[0].y * ny;
+        double polyMax = polyMin;
+        double tileMin = tileCorners[0].x * nx + tileCorners[0].y * ny;
+        double tileMax = tileMin;
+        for(unsigned char j = 1; j < 4; ++j) {
+            double proj = corners[j].x * nx + corners[j].y * ny;
+            polyMin = std::min(polyMin, proj);
+            polyMax = std::max(polyMax, proj);
+            proj = tileCorners[j].x * nx + tileCorners[j].y * ny;
+            tileMin = std::min(tileMin, proj);
+            tileMax = std::max(tileMax, proj);
+        }
+        if(tileMax < polyMin || tileMin > polyMax) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// TileRange
+//------------------------------------------------------------------------------
+
+TileRange::TileRange() :
+    m_begX(0),
+    m_endX(0),
+    m_begY(0),
+    m_endY(0),
+    m_zoom(0),
+    m_reverseY(false)
+{
+}
+
+TileRange::TileRange(const Envelope &extent, unsigned char zoom, bool reverseY,
+                     bool unlimitX) :
+    m_zoom(zoom),
+    m_reverseY(reverseY)
+{
+    if(zoom == 0) { // If zoom 0 - one tile
+        m_begX = m_begY = 0;
+        m_endX = m_endY = 1;
+        return;
     }
+
     int tilesInMapOneDim = 1 << zoom;
     double halfTilesInMapOneDim = tilesInMapOneDim * 0.5;
     double tilesSizeOneDim = DEFAULT_BOUNDS.maxX() / halfTilesInMapOneDim;
-    int begX = static_cast<int>(std::floor(extent.minX() / tilesSizeOneDim +
-                                       halfTilesInMapOneDim));
-    int begY = static_cast<int>(std::floor(extent.minY() / tilesSizeOneDim +
-                                       halfTilesInMapOneDim));
-    int endX = static_cast<int>(std::ceil(extent.maxX() / tilesSizeOneDim +
-                                      halfTilesInMapOneDim));
-    int endY = static_cast<int>(std::ceil(extent.maxY() / tilesSizeOneDim +
-                                      halfTilesInMapOneDim));
-    if(begY == endY) {
-        endY++;
+    m_begX = static_cast<int>(std::floor(extent.minX() / tilesSizeOneDim +
+                                         halfTilesInMapOneDim));
+    m_begY = static_cast<int>(std::floor(extent.minY() / tilesSizeOneDim +
+                                         halfTilesInMapOneDim));
+    m_endX = static_cast<int>(std::ceil(extent.maxX() / tilesSizeOneDim +
+                                        halfTilesInMapOneDim));
+    m_endY = static_cast<int>(std::ceil(extent.maxY() / tilesSizeOneDim +
+                                        halfTilesInMapOneDim));
+    if(m_begY == m_endY) {
+        m_endY++;
     }
-    if(begX == endX) {
-        endX++;
+    if(m_begX == m_endX) {
+        m_endX++;
     }
-    if(begY < 0) {
-        begY = 0;
+    if(m_begY < 0) {
+        m_begY = 0;
     }
-    if(endY > tilesInMapOneDim) {
-        endY = tilesInMapOneDim;
+    if(m_endY > tilesInMapOneDim) {
+        m_endY = tilesInMapOneDim;
     }
 
     // This block unlimited X scroll of the map
     if(!unlimitX) {
-        if(begX < 0) {
-            begX = 0;
+        if(m_begX < 0) {
+            m_begX = 0;
         }
-        if(endX > tilesInMapOneDim) {
-            endX = tilesInMapOneDim;
+        if(m_endX > tilesInMapOneDim) {
+            m_endX = tilesInMapOneDim;
         }
     }
     else {
-        if(begX < -tilesInMapOneDim) {
-            begX = -tilesInMapOneDim;
+        if(m_begX < -tilesInMapOneDim) {
+            m_begX = -tilesInMapOneDim;
         }
-        if(endX >= tilesInMapOneDim + tilesInMapOneDim) {
-            endX = tilesInMapOneDim + tilesInMapOneDim;
+        if(m_endX >= tilesInMapOneDim + tilesInMapOneDim) {
+            m_endX = tilesInMapOneDim + tilesInMapOneDim;
         }
     }
 
-    // Normal fill from left bottom corner
-    int realX, realY;
-    char crossExt;
-    size_t reserveSize = static_cast<size_t>((endX - begX) * (endY - begY));
-    if(reserveSize > MAX_TILES_COUNT)
-        reserveSize = MAX_TILES_COUNT;
-    result.reserve(reserveSize);
-    double fullBoundsMinX = DEFAULT_BOUNDS.minX();
-    double fullBoundsMinY = DEFAULT_BOUNDS.minY();
-    for (int x = begX; x < endX; ++x) {
-        realX = x;
-        crossExt = 0;
-        if (realX < 0) {
-            crossExt = -1;
-            realX += tilesInMapOneDim;
-        } else if (realX >= tilesInMapOneDim) {
-            crossExt = 1;
-            realX -= tilesInMapOneDim;
-        }
-        double minX = fullBoundsMinX + realX * tilesSizeOneDim;
-        env.setMinX(minX);
-        env.setMaxX(minX + tilesSizeOneDim);
-
-        for (int y = begY; y < endY; ++y) {
-
-            if (reverseY) {
-                realY = tilesInMapOneDim - y - 1;
-            } else {
-                realY = y;
-            }
-
-            if (realY < 0 || realY >= tilesInMapOneDim) {
-                continue;
-            }
-
-            double minY = fullBoundsMinY + realY * tilesSizeOneDim;
-            env.setMinY(minY);
-            env.setMaxY(minY + tilesSizeOneDim);
-            Tile tile = {realX, realY, zoom, crossExt};
-            result.push_back( { tile, env } );
-
-            if(result.size() > MAX_TILES_COUNT) { // Limit for tiles array size
-                return result;
-            }
-        }
+    if(m_endX < m_begX) {
+        m_endX = m_begX;
+    }
+    if(m_endY < m_begY) {
+        m_endY = m_begY;
     }
+}
 
-    return result;
+size_t TileRange::size() const
+{
+    return static_cast<size_t>(m_endX - m_begX) *
+            static_cast<size_t>(m_endY - m_begY);
+}
+
+/**
+ * @brief TileRange::item Tile by index. Tiles go column by column from left
+ * bottom corner.
+ * @param index Tile index in range
+ * @return Tile and its extent
+ */
+TileItem TileRange::item(size_t index) const
+{
+    if(m_zoom == 0) {
+        return { {0, 0, 0, 0}, DEFAULT_BOUNDS };
+    }
+
+    size_t height = static_cast<size_t>(m_endY - m_begY);
+    int x = m_begX + static_cast<int>(index / height);
+    int y = m_begY + static_cast<int>(index % height);
+
+    int tilesInMapOneDim = 1 << m_zoom;
+    double tilesSizeOneDim = DEFAULT_BOUNDS.width() / tilesInMapOneDim;
+    char crossExt = 0;
+    if(x < 0) {
+        crossExt = -1;
+        x += tilesInMapOneDim;
+    }
+    else if(x >= tilesInMapOneDim) {
+        crossExt = 1;
+        x -= tilesInMapOneDim;
+    }
+    if(m_reverseY) {
+        y = tilesInMapOneDim - y - 1;
+    }
+
+    double minX = DEFAULT_BOUNDS.minX() + x * tilesSizeOneDim;
+    double minY = DEFAULT_BOUNDS.minY() + y * tilesSizeOneDim;
+    return { {x, y, m_zoom, crossExt},
+        Envelope(minX, minY, minX + tilesSizeOneDim, minY + tilesSizeOneDim) };
+}
+
+bool TileRange::operator==(const TileRange &other) const
+{
+    return m_zoom == other.m_zoom && m_reverseY == other.m_reverseY &&
+            m_begX == other.m_begX && m_endX == other.m_endX &&
+            m_begY == other.m_begY && m_endY == other.m_endY;
 }
 
 OGRRawPoint MapTransform::worldToDisplay(const OGRRawPoint &pt) const
@@ -34,6 +34,51 @@
 
 namespace ngs {
 
+/**
+ * @brief The TileRange class Tiles covering the extent on zoom level. Tile
+ * items are computed on iteration, so the range itself allocates nothing and
+ * two ranges may be compared to check if the tile grid changed.
+ */
+class TileRange
+{
+public:
+    class ConstIterator
+    {
+    public:
+        ConstIterator(const TileRange *range, size_t index) :
+            m_range(range), m_index(index) {}
+        TileItem operator*() const { return m_range->item(m_index); }
+        ConstIterator &operator++() { ++m_index; return *this; }
+        bool operator==(const ConstIterator &other) const {
+            return m_index == other.m_index && m_range == other.m_range;
+        }
+        bool operator!=(const ConstIterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const TileRange *m_range;
+        size_t m_index;
+    };
+
+public:
+    TileRange();
+    TileRange(const Envelope &extent, unsigned char zoom, bool reverseY,
+              bool unlimitX);
+    ConstIterator begin() const { return ConstIterator(this, 0); }
+    ConstIterator end() const { return ConstIterator(this, size()); }
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    TileItem item(size_t index) const;
+    bool operator==(const TileRange &other) const;
+    bool operator!=(const TileRange &other) const { return !(*this == other); }
+
+private:
+    int m_begX, m_endX, m_begY, m_endY;
+    unsigned char m_zoom;
+    bool m_reverseY;
+};
+
 class MapTransform
 {
 public:
@@ -70,6 +115,8 @@ public:
         return getTilesForExtent(getExtent(), getZoom(), getYAxisInverted(),
                                  getXAxisLooped());
     }
+    bool isRotated() const { return !isEqual(m_rotate[DIR_Z], 0.0); }
+    bool isTileVisible(const Envelope &tileExtent, double resize = 1.0) const;
     void setExtentLimits(const Envelope &extentLimit);
     void setZoomIncrement(char increment) { m_extraZoom = increment; }
     void setReduceFactor(double factor) { m_reduceFactor = factor; }
@@ -98,6 +145,7 @@ protected:
     double m_rotate[3];
     double m_scale, m_scaleWorld; //m_scaleScene, m_scaleView,
     Envelope m_extent, m_rotateExtent;
+    OGRRawPoint m_rotateCorners[4];
     double m_ratio;
     bool m_YAxisInverted, m_XAxisLooped;
 
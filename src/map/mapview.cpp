@@ -22,15 +22,127 @@
 #include "mapview.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include "api_priv.h"
 #include "catalog/folder.h"
 #include "catalog/mapfile.h"
+#include "ds/coordinatetransformation.h"
 #include "ngstore/util/constants.h"
+#include "util/error.h"
 #include "util/versionutil.h"
 
 namespace ngs {
 
+constexpr int DEFAULT_EXPORT_TILE_SIZE = 2048;
+// Rendered tiles waiting for write, more tiles keep more memory
+constexpr size_t EXPORT_QUEUE_SIZE = 2;
+
+/**
+ * @brief The ExportWriter class Writes rendered RGBA tiles to dataset in the
+ * worker thread, so next tile is rendered while previous one is compressed.
+ * Pixel buffers are reused, so at most EXPORT_QUEUE_SIZE + 1 tiles are in
+ * memory.
+ */
+class ExportWriter
+{
+public:
+    typedef struct _exportTile {
+        int x, y, width, height;
+        std::vector<GByte> pixels;
+    } ExportTile;
+
+public:
+    explicit ExportWriter(GDALDataset *dataset) : m_dataset(dataset),
+        m_stop(false), m_failed(false) {
+        m_thread = std::thread(&ExportWriter::run, this);
+    }
+
+    ~ExportWriter() { finish(); }
+
+    /**
+     * @brief take Get free tile buffer. Waits while all buffers are queued.
+     */
+    ExportTile take() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]() {
+            return m_queue.size() < EXPORT_QUEUE_SIZE || m_failed; });
+        if(m_free.empty()) {
+            return ExportTile();
+        }
+        ExportTile tile = std::move(m_free.back());
+        m_free.pop_back();
+        return tile;
+    }
+
+    bool push(ExportTile &&tile) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_failed) {
+            return false;
+        }
+        m_queue.push_back(std::move(tile));
+        m_cond.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief finish Write queued tiles and stop the thread.
+     * @return False if some tile write failed.
+     */
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_cond.notify_all();
+        }
+        if(m_thread.joinable()) {
+            m_thread.join();
+        }
+        return !m_failed;
+    }
+
+private:
+    void run() {
+        while(true) {
+            ExportTile tile;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this]() {
+                    return !m_queue.empty() || m_stop; });
+                if(m_queue.empty()) {
+                    return;
+                }
+                tile = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            CPLErr result = m_dataset->RasterIO(GF_Write, tile.x, tile.y,
+                tile.width, tile.height, tile.pixels.data(), tile.width,
+                tile.height, GDT_Byte, 4, nullptr, 4, tile.width * 4, 1,
+                nullptr);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(result != CE_None) {
+                m_failed = true;
+            }
+            m_free.push_back(std::move(tile));
+            m_cond.notify_all();
+        }
+    }
+
+private:
+    GDALDataset *m_dataset;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<ExportTile> m_queue;
+    std::vector<ExportTile> m_free;
+    bool m_stop, m_failed;
+};
+
 constexpr const char *MAP_EXTENT_KEY = "extent";
 constexpr const char *MAP_ROTATE_X_KEY = "rotate_x";
 constexpr const char *MAP_ROTATE_Y_KEY = "rotate_y";
@@ -88,6 +200,18 @@ bool MapView::draw(ngsDrawState state, const Progress &progress)
     return true;
 }
 
+/**
+ * @brief MapView::invalidateLayer Invalidate only one layer data in bounds.
+ * By default the whole map is invalidated in bounds.
+ * @param bounds Extent to invalidate
+ * @param layer Changed layer
+ */
+void MapView::invalidateLayer(const Envelope &bounds, const LayerPtr &layer)
+{
+    ngsUnused(layer);
+    invalidate(bounds);
+}
+
 bool MapView::openInternal(const CPLJSONObject &root, MapFile * const mapFile)
 {
     if(!Map::openInternal(root, mapFile))
@@ -297,6 +421,158 @@ bool MapView::setOptions(const Options &options)
     return true;
 }
 
+/**
+ * @brief MapView::drawToBuffer Render map offscreen to RGBA pixels. Not
+ * supported by the base view.
+ * @return false.
+ */
+bool MapView::drawToBuffer(int width, int height, void *buffer,
+                           const Progress &progress)
+{
+    ngsUnused(width);
+    ngsUnused(height);
+    ngsUnused(buffer);
+    ngsUnused(progress);
+    return errorMessage(_("Offscreen draw is not supported by the map"));
+}
+
+/**
+ * @brief MapView::exportImage Render map extent to a raster file by tiles.
+ * Tiles are rendered with drawToBuffer in the calling thread (Gl context must
+ * be current) and written to the dataset in the worker thread, so the memory
+ * is bounded by a few tiles for any image size.
+ * @param path File system path of the new raster.
+ * @param width Image width in pixels.
+ * @param height Image height in pixels.
+ * @param extent Map extent in map spatial reference. It is centered in the
+ * image if its ratio differs from the image ratio.
+ * @param options DRIVER - GDAL driver name (default GTiff), TILE_SIZE -
+ * rendered tile size in pixels (default 2048). Other options are passed to the
+ * driver as creation options.
+ * @param progress Progress and cancel.
+ * @return True on success.
+ */
+bool MapView::exportImage(const std::string &path, int width, int height,
+                          const Envelope &extent, const Options &options,
+                          const Progress &progress)
+{
+    if(width < 1 || height < 1 || !extent.isInit()) {
+        return errorMessage(_("Invalid export size or extent"));
+    }
+
+    std::string driverName = options.asString("DRIVER", "GTiff");
+    GDALDriver *driver =
+            GetGDALDriverManager()->GetDriverByName(driverName.c_str());
+    if(nullptr == driver ||
+            !CPLTestBool(CSLFetchNameValueDef(driver->GetMetadata(),
+                                              GDAL_DCAP_CREATE, "NO"))) {
+        return errorMessage(_("Driver %s does not support create"),
+                            driverName.c_str());
+    }
+    int tileSize = std::max(1, options.asInt("TILE_SIZE",
+                                             DEFAULT_EXPORT_TILE_SIZE));
+
+    CPLStringList createOptions;
+    for(const auto &option : options) {
+        if(option.first != "DRIVER" && option.first != "TILE_SIZE") {
+            createOptions.AddNameValue(option.first.c_str(),
+                                       option.second.text.c_str());
+        }
+    }
+    if(driverName == "GTiff") {
+        // Blocks are completed by each row of rendered tiles
+        if(createOptions.FetchNameValue("TILED") == nullptr) {
+            createOptions.AddNameValue("TILED", "YES");
+        }
+        if(createOptions.FetchNameValue("NUM_THREADS") == nullptr) {
+            createOptions.AddNameValue("NUM_THREADS", "ALL_CPUS");
+        }
+    }
+
+    GDALDatasetPtr dataset = driver->Create(path.c_str(), width, height, 4,
+                                            GDT_Byte, createOptions);
+    if(nullptr == dataset) {
+        return errorMessage(_("Failed to create raster %s. %s"), path.c_str(),
+                            CPLGetLastErrorMsg());
+    }
+
+    // The same pixel size by X and Y as map has one scale
+    double pixelSize = std::max(extent.width() / width,
+                                extent.height() / height);
+    OGRRawPoint center = extent.center();
+    double originX = center.x - width * pixelSize / 2.0;
+    double originY = center.y + height * pixelSize / 2.0;
+    double geoTransform[6] = { originX, pixelSize, 0.0, originY, 0.0,
+                               -pixelSize };
+    dataset->SetGeoTransform(geoTransform);
+    SpatialReferencePtr srs = SpatialReferencePtr::importFromEPSG(epsg());
+    if(nullptr != srs) {
+        dataset->SetSpatialRef(srs);
+    }
+    const GDALColorInterp colors[4] = { GCI_RedBand, GCI_GreenBand,
+                                        GCI_BlueBand, GCI_AlphaBand };
+    for(int band = 0; band < 4; ++band) {
+        dataset->GetRasterBand(band + 1)->SetColorInterpretation(colors[band]);
+    }
+
+    // Tiles extents are set through the map transform, restore it after
+    OGRRawPoint oldCenter = m_center;
+    double oldScale = m_scale;
+    double oldRotate = m_rotate[DIR_Z];
+    m_rotate[DIR_Z] = 0.0;
+    m_scale = 1.0 / (pixelSize * m_reduceFactor);
+
+    int columns = (width + tileSize - 1) / tileSize;
+    int rows = (height + tileSize - 1) / tileSize;
+    double total = static_cast<double>(columns) * rows;
+    bool result = true;
+    ExportWriter writer(dataset);
+    for(int row = 0; row < rows && result; ++row) {
+        for(int column = 0; column < columns && result; ++column) {
+            if(!progress.onProgress(COD_IN_PROCESS, (row * columns + column) / total,
+                                    _("Export map to %s"), path.c_str())) {
+                result = errorMessage(_("Export canceled"));
+                break;
+            }
+
+            ExportWriter::ExportTile tile = writer.take();
+            tile.x = column * tileSize;
+            tile.y = row * tileSize;
+            tile.width = std::min(tileSize, width - tile.x);
+            tile.height = std::min(tileSize, height - tile.y);
+            tile.pixels.resize(static_cast<size_t>(tile.width) * tile.height * 4);
+            m_center = OGRRawPoint(originX + (tile.x + tile.width / 2.0) * pixelSize,
+                                   originY - (tile.y + tile.height / 2.0) * pixelSize);
+
+            result = drawToBuffer(tile.width, tile.height, tile.pixels.data());
+            if(result && !writer.push(std::move(tile))) {
+                result = errorMessage(_("Failed to write raster %s. %s"),
+                                      path.c_str(), CPLGetLastErrorMsg());
+            }
+        }
+    }
+    if(!writer.finish() && result) {
+        result = errorMessage(_("Failed to write raster %s. %s"), path.c_str(),
+                              CPLGetLastErrorMsg());
+    }
+
+    m_center = oldCenter;
+    m_scale = oldScale;
+    m_rotate[DIR_Z] = oldRotate;
+    updateExtent();
+
+    if(result) {
+        progress.onProgress(COD_FINISHED, 1.0, _("Map exported to %s"),
+                            path.c_str());
+    }
+    return result;
+}
+
+ngsRenderStats MapView::renderStats() const
+{
+    return {0, 0, 0, 0, 0, 0.0, 0.0, 0.0, 0, 0};
+}
+
 bool MapView::addIconSet(const std::string &name, const std::string &path,
                          bool ownByMap)
 {
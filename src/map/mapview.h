@@ -42,13 +42,20 @@ public:
             unsigned short epsg, const Envelope &bounds);
     virtual ~MapView() override = default;
     virtual bool draw(enum ngsDrawState state, const Progress &progress = Progress());
+    virtual bool drawToBuffer(int width, int height, void *buffer,
+                              const Progress &progress = Progress());
+    bool exportImage(const std::string &path, int width, int height,
+                     const Envelope &extent, const Options &options,
+                     const Progress &progress = Progress());
     virtual void invalidate(const Envelope &bounds) = 0;
+    virtual void invalidateLayer(const Envelope &bounds, const LayerPtr &layer);
 
     size_t overlayCount() const { return m_overlays.size(); }
     OverlayPtr getOverlay(enum ngsMapOverlayType type) const;
     void setOverlayVisible(int typeMask, bool visible);
     int overlayVisibleMask() const;
     virtual bool setOptions(const Options &options);
+    virtual ngsRenderStats renderStats() const;
     virtual bool setSelectionStyleName(enum ngsStyleType styleType,
                                        const std::string &name) = 0;
     virtual bool setSelectionStyle(enum ngsStyleType styleType,
@@ -80,7 +80,8 @@ void LocationOverlay::setLocation(const ngsCoordinate &location, float direction
 EditLayerOverlay::EditLayerOverlay(MapView *map) : Overlay(map, MOT_EDIT),
     m_editFeatureId(NOT_FOUND),
     m_walkingMode(false),
-    m_crossVisible(false)
+    m_crossVisible(false),
+    m_snapping(false)
 {
     const Settings &settings = Settings::instance();
     m_tolerancePx = settings.getDouble("map/overlay/edit/tolerance", TOLERANCE_PX);
@@ -180,11 +181,11 @@ FeaturePtr EditLayerOverlay::save()
     if(geom) { // Redraw a geometry tile.
         OGREnvelope ogrEnv;
         geom->getEnvelope(&ogrEnv);
-        m_map->invalidate(Envelope(ogrEnv));
+        m_map->invalidateLayer(Envelope(ogrEnv), m_editLayer);
     }
     else {
         // If geometry deleted invalidate it's original envelope.
-        m_map->invalidate(Envelope(-0.5, -0.5, 0.5, 0.5));
+        m_map->invalidateLayer(Envelope(-0.5, -0.5, 0.5, 0.5), m_editLayer);
     }
 
     init();
@@ -203,7 +204,7 @@ void EditLayerOverlay::cancel()
         }
         m_editFeatureId = NOT_FOUND;
         featureLayer->setHideIds(); // Empty hidden ids.
-        m_map->invalidate(Envelope());
+        m_map->invalidateLayer(Envelope(), m_editLayer);
     }
 
     init();
@@ -359,13 +360,12 @@ bool EditLayerOverlay::editGeometry(const LayerPtr &layer, GIntBig featureId)
         return errorMessage(_("Geometry is null"));
     }
 
-    std::set<GIntBig> hideIds;
-    hideIds.insert(m_editFeatureId);
+    FeatureIDs hideIds = { m_editFeatureId };
     featureLayer->setHideIds(hideIds);
 
     OGREnvelope ogrEnv;
     gdalGeom->getEnvelope(&ogrEnv);
-    m_map->invalidate(Envelope(ogrEnv));
+    m_map->invalidateLayer(Envelope(ogrEnv), m_editLayer);
 
     setVisible(true);
     return true;
@@ -464,6 +464,7 @@ bool EditLayerOverlay::setOptions(const Options &options)
 {
     bool cross = options.asBool("CROSS", false);
     setCrossVisible(cross);
+    setSnapping(options.asBool("SNAP", m_snapping));
     return true;
 }
 
@@ -471,6 +472,7 @@ Options EditLayerOverlay::options() const
 {
     Options options;
     options.add("CROSS", (m_crossVisible) ? "ON" : "OFF");
+    options.add("SNAP", (m_snapping) ? "ON" : "OFF");
     return options;
 }
 
@@ -482,8 +484,35 @@ ngsPointId EditLayerOverlay::touch(double x, double y, enum ngsMapTouchType type
 
     // Get tollerance for carrent map scale
     OGRRawPoint mapTolerance = m_map->getMapDistance(m_tolerancePx, m_tolerancePx);
-    return m_editGeometry->touch(mapPt, type,
-                                 (mapTolerance.x + mapTolerance.y) / 2);
+    double tolerance = (mapTolerance.x + mapTolerance.y) / 2;
+    // Dragged point is snapped, touch down selects the point as is
+    if(m_snapping && (type == MTT_ON_MOVE || type == MTT_ON_UP)) {
+        mapPt = snapPoint(mapPt, tolerance);
+    }
+    return m_editGeometry->touch(mapPt, type, tolerance);
+}
+
+/**
+ * @brief EditLayerOverlay::snapPoint Snap point to the nearest vertex or
+ * segment of visible map layers with snapping on.
+ * @param pt Point in map coordinates.
+ * @param tolerance Snap distance in map units.
+ * @return Snapped point or the input point if nothing found within tolerance.
+ */
+OGRRawPoint EditLayerOverlay::snapPoint(const OGRRawPoint &pt,
+                                        double tolerance) const
+{
+    SnapResult result;
+    for(size_t i = 0; i < m_map->layerCount(); ++i) {
+        LayerPtr layer = m_map->getLayer(static_cast<int>(i));
+        FeatureLayer *featureLayer = ngsDynamicCast(FeatureLayer, layer);
+        if(nullptr == featureLayer || !featureLayer->visible() ||
+                !featureLayer->snapping()) {
+            continue;
+        }
+        featureLayer->snap(pt, tolerance, result);
+    }
+    return result.found ? result.point : pt;
 }
 
 void EditLayerOverlay::init()
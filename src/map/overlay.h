@@ -93,6 +93,8 @@ public:
     virtual bool isCrossVisible() const { return m_crossVisible; }
     virtual void setWalkingMode(bool walkingMode) { m_walkingMode = walkingMode; }
     virtual bool isWalkingMode() const { return m_walkingMode; }
+    virtual void setSnapping(bool snapping) { m_snapping = snapping; }
+    virtual bool isSnapping() const { return m_snapping; }
 	
 	virtual bool setStyleName(enum ngsEditStyleType type, const std::string &name) = 0;
     virtual bool setStyle(enum ngsEditStyleType type, const CPLJSONObject &jsonStyle) = 0;
@@ -105,6 +107,7 @@ public:
 
 protected:
     virtual void init();
+    OGRRawPoint snapPoint(const OGRRawPoint &pt, double tolerance) const;
 
 protected:
     LayerPtr m_editLayer;
@@ -114,6 +117,7 @@ protected:
     double m_tolerancePx;
     bool m_walkingMode;
     bool m_crossVisible;
+    bool m_snapping;
 };
 
 /**
@@ -0,0 +1,736 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "styleexpression.h"
+
+// std
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "ds/geometry.h"
+#include "util/error.h"
+
+namespace ngs {
+
+constexpr unsigned int NO_TARGET = std::numeric_limits<unsigned int>::max();
+
+static ExpressionValue nullValue()
+{
+    ExpressionValue out;
+    out.type = ExpressionValue::VT_NULL;
+    out.number = 0.0;
+    out.string = nullptr;
+    out.color = {0, 0, 0, 0};
+    return out;
+}
+
+static ExpressionValue numberValue(double number)
+{
+    ExpressionValue out = nullValue();
+    out.type = ExpressionValue::VT_NUMBER;
+    out.number = number;
+    return out;
+}
+
+static ExpressionValue stringValue(const char *string)
+{
+    ExpressionValue out = nullValue();
+    out.type = ExpressionValue::VT_STRING;
+    out.string = string;
+    return out;
+}
+
+/**
+ * @brief parseColor Parse #RRGGBB or #RRGGBBAA color.
+ */
+static bool parseColor(const char *string, ngsRGBA &out)
+{
+    if(nullptr == string || string[0] != '#') {
+        return false;
+    }
+    size_t len = strlen(string + 1);
+    if(len != 6 && len != 8) {
+        return false;
+    }
+    unsigned char channels[4] = {0, 0, 0, 255};
+    for(size_t i = 0; i < len / 2; ++i) {
+        char hex[3] = {string[1 + i * 2], string[2 + i * 2], 0};
+        char *end = nullptr;
+        long value = std::strtol(hex, &end, 16);
+        if(end != hex + 2) {
+            return false;
+        }
+        channels[i] = static_cast<unsigned char>(value);
+    }
+    out = {channels[0], channels[1], channels[2], channels[3]};
+    return true;
+}
+
+static bool isTrue(const ExpressionValue &value)
+{
+    switch(value.type) {
+    case ExpressionValue::VT_NULL:
+        return false;
+    case ExpressionValue::VT_NUMBER:
+        return value.number != 0.0;
+    default:
+        return true;
+    }
+}
+
+/**
+ * @brief compareValues Compare numbers or strings.
+ * @return Negative, zero or positive as for strcmp, or false if values are not
+ * comparable.
+ */
+static bool compareValues(const ExpressionValue &a, const ExpressionValue &b,
+                          int &result)
+{
+    if(a.type == ExpressionValue::VT_NUMBER &&
+            b.type == ExpressionValue::VT_NUMBER) {
+        result = a.number < b.number ? -1 : (a.number > b.number ? 1 : 0);
+        return true;
+    }
+    if(a.type == ExpressionValue::VT_STRING &&
+            b.type == ExpressionValue::VT_STRING) {
+        result = strcmp(a.string, b.string);
+        return true;
+    }
+    if(a.type == ExpressionValue::VT_NULL &&
+            b.type == ExpressionValue::VT_NULL) {
+        result = 0;
+        return true;
+    }
+    return false;
+}
+
+static ExpressionValue interpolateValues(const ExpressionValue &a,
+                                         const ExpressionValue &b, double t)
+{
+    if(a.type == ExpressionValue::VT_NUMBER &&
+            b.type == ExpressionValue::VT_NUMBER) {
+        return numberValue(a.number + (b.number - a.number) * t);
+    }
+    if(a.type == ExpressionValue::VT_COLOR &&
+            b.type == ExpressionValue::VT_COLOR) {
+        auto channel = [t](unsigned char x, unsigned char y) {
+            return static_cast<unsigned char>(
+                        std::lround(x + (static_cast<double>(y) - x) * t));
+        };
+        ExpressionValue out = a;
+        out.color = {channel(a.color.R, b.color.R),
+                     channel(a.color.G, b.color.G),
+                     channel(a.color.B, b.color.B),
+                     channel(a.color.A, b.color.A)};
+        return out;
+    }
+    return a;
+}
+
+//------------------------------------------------------------------------------
+// ExpressionValue
+//------------------------------------------------------------------------------
+
+bool ExpressionValue::toNumber(double &out) const
+{
+    if(type == VT_NUMBER) {
+        out = number;
+        return true;
+    }
+    if(type == VT_STRING) {
+        char *end = nullptr;
+        out = std::strtod(string, &end);
+        return end != string && *end == '\0';
+    }
+    return false;
+}
+
+bool ExpressionValue::toColor(ngsRGBA &out) const
+{
+    if(type == VT_COLOR) {
+        out = color;
+        return true;
+    }
+    if(type == VT_STRING) {
+        return parseColor(string, out);
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// ExpressionContext
+//------------------------------------------------------------------------------
+
+ExpressionContext::ExpressionContext(double zoom) :
+    m_zoom(zoom),
+    m_feature(nullptr),
+    m_featureDefn(nullptr),
+    m_tile(nullptr),
+    m_tileItem(nullptr),
+    m_fieldMissing(false)
+{
+}
+
+void ExpressionContext::setFeature(const OGRFeature *feature)
+{
+    m_feature = feature;
+    m_strings.clear();
+    const OGRFeatureDefn *defn = feature ? feature->GetDefnRef() : nullptr;
+    if(defn != nullptr && defn != m_featureDefn) {
+        m_fieldIndices.clear();
+        m_featureDefn = defn;
+    }
+}
+
+/**
+ * @brief ExpressionContext::setTileItem Set tile item to evaluate expressions
+ * with. Resets the feature, so it has to be set after the item if the tile
+ * does not store some fields.
+ * @param tile Tile of the item.
+ * @param item Tile item.
+ */
+void ExpressionContext::setTileItem(const FlatVectorTile *tile,
+                                    const FlatVectorTileItem *item)
+{
+    if(tile != m_tile) {
+        m_columnIndices.clear();
+        m_tile = tile;
+    }
+    m_tileItem = item;
+    m_fieldMissing = false;
+    setFeature(nullptr);
+}
+
+ExpressionValue ExpressionContext::tileField(const std::string &name)
+{
+    int column;
+    auto it = m_columnIndices.find(name);
+    if(it == m_columnIndices.end()) {
+        column = m_tile->columnIndex(name);
+        m_columnIndices[name] = column;
+    }
+    else {
+        column = it->second;
+    }
+
+    if(column < 0) {
+        if(name == CLUSTER_COUNT_FIELD) {
+            return numberValue(
+                        static_cast<double>(m_tileItem->ids().size()));
+        }
+        m_fieldMissing = true;
+        return field(name);
+    }
+
+    size_t index = static_cast<size_t>(column);
+    if(m_tileItem->isAttributeNull(index)) {
+        return nullValue();
+    }
+    if((*m_tile->columns())[index].type == TileColumnType::NUMBER) {
+        return numberValue(m_tileItem->attributeNumber(index));
+    }
+    // Tile dictionary strings are valid while the tile is alive
+    return stringValue(m_tileItem->attributeString(index).c_str());
+}
+
+ExpressionValue ExpressionContext::field(const std::string &name)
+{
+    if(nullptr == m_feature) {
+        return nullValue();
+    }
+
+    int index;
+    auto it = m_fieldIndices.find(name);
+    if(it == m_fieldIndices.end()) {
+        index = m_featureDefn->GetFieldIndex(name.c_str());
+        m_fieldIndices[name] = index;
+    }
+    else {
+        index = it->second;
+    }
+
+    if(index < 0 || !m_feature->IsFieldSetAndNotNull(index)) {
+        return nullValue();
+    }
+
+    switch(m_featureDefn->GetFieldDefn(index)->GetType()) {
+    case OFTInteger:
+    case OFTInteger64:
+    case OFTReal:
+        return numberValue(m_feature->GetFieldAsDouble(index));
+    case OFTString:
+        return stringValue(m_feature->GetFieldAsString(index));
+    default:
+        // Other types are formatted to the feature temporary buffer
+        m_strings.push_back(m_feature->GetFieldAsString(index));
+        return stringValue(m_strings.back().c_str());
+    }
+}
+
+//------------------------------------------------------------------------------
+// StyleExpression
+//------------------------------------------------------------------------------
+
+StyleExpression::StyleExpression() :
+    m_featureDependent(false),
+    m_zoomDependent(false)
+{
+}
+
+/**
+ * @brief StyleExpression::isExpression Check if style property is an
+ * expression and not a plain value.
+ * @param json Style property.
+ * @return True if property is JSON array.
+ */
+bool StyleExpression::isExpression(const CPLJSONObject &json)
+{
+    return json.IsValid() && json.GetType() == CPLJSONObject::Type::Array;
+}
+
+/**
+ * @brief StyleExpression::compile Compile JSON expression to instructions.
+ * @param json Expression.
+ * @return True on success.
+ */
+bool StyleExpression::compile(const CPLJSONObject &json)
+{
+    m_code.clear();
+    m_constants.clear();
+    m_tables.clear();
+    m_fields.clear();
+    m_strings.clear();
+    m_featureDependent = false;
+    m_zoomDependent = false;
+    m_json = json;
+    return compileNode(json);
+}
+
+/**
+ * @brief StyleExpression::evaluate Evaluate expression.
+ * @param context Zoom level and feature.
+ * @param out Result value.
+ * @return False if result is null.
+ */
+bool StyleExpression::evaluate(ExpressionContext &context,
+                               ExpressionValue &out) const
+{
+    std::vector<ExpressionValue> &stack = context.m_stack;
+    stack.clear();
+
+    size_t pc = 0;
+    while(pc < m_code.size()) {
+        const Instruction &instruction = m_code[pc++];
+        switch(instruction.code) {
+        case OP_CONST:
+            stack.push_back(m_constants[instruction.arg]);
+            break;
+        case OP_GET:
+            stack.push_back(nullptr != context.m_tileItem ?
+                                context.tileField(m_fields[instruction.arg]) :
+                                context.field(m_fields[instruction.arg]));
+            break;
+        case OP_ZOOM:
+            stack.push_back(numberValue(context.zoom()));
+            break;
+        case OP_MATCH:
+        {
+            ExpressionValue input = stack.back();
+            stack.pop_back();
+            const Table &table = m_tables[instruction.arg];
+            pc = table.target;
+            for(const Stop &stop : table.stops) {
+                int result;
+                if(compareValues(input, stop.input, result) && result == 0) {
+                    pc = stop.target;
+                    break;
+                }
+            }
+            break;
+        }
+        case OP_INTERPOLATE:
+        case OP_STEP:
+        {
+            const Table &table = m_tables[instruction.arg];
+            double input;
+            if(!stack.back().toNumber(input)) {
+                stack.back() = nullValue();
+                break;
+            }
+            size_t index = 0;
+            while(index + 1 < table.stops.size() &&
+                  table.stops[index + 1].input.number <= input) {
+                ++index;
+            }
+            const Stop &stop = table.stops[index];
+            if(instruction.code == OP_STEP || input <= stop.input.number ||
+                    index + 1 == table.stops.size()) {
+                stack.back() = stop.output;
+                break;
+            }
+
+            const Stop &next = table.stops[index + 1];
+            double range = next.input.number - stop.input.number;
+            double progress = input - stop.input.number;
+            double t = table.base == 1.0 ? progress / range :
+                (std::pow(table.base, progress) - 1.0) /
+                (std::pow(table.base, range) - 1.0);
+            stack.back() = interpolateValues(stop.output, next.output, t);
+            break;
+        }
+        case OP_JUMP:
+            pc = instruction.arg;
+            break;
+        case OP_JUMP_IF_FALSE:
+        {
+            bool condition = isTrue(stack.back());
+            stack.pop_back();
+            if(!condition) {
+                pc = instruction.arg;
+            }
+            break;
+        }
+        default:
+        {
+            ExpressionValue b = stack.back();
+            stack.pop_back();
+            ExpressionValue &a = stack.back();
+            int result = 0;
+            bool comparable = compareValues(a, b, result);
+            switch(instruction.code) {
+            case OP_EQUAL:
+                a = numberValue(comparable && result == 0 ? 1.0 : 0.0);
+                break;
+            case OP_NOT_EQUAL:
+                a = numberValue(comparable && result == 0 ? 0.0 : 1.0);
+                break;
+            case OP_LESS:
+                a = numberValue(comparable && result < 0 ? 1.0 : 0.0);
+                break;
+            case OP_LESS_EQUAL:
+                a = numberValue(comparable && result <= 0 ? 1.0 : 0.0);
+                break;
+            case OP_GREATER:
+                a = numberValue(comparable && result > 0 ? 1.0 : 0.0);
+                break;
+            case OP_GREATER_EQUAL:
+                a = numberValue(comparable && result >= 0 ? 1.0 : 0.0);
+                break;
+            default:
+            {
+                double x, y;
+                if(!a.toNumber(x) || !b.toNumber(y)) {
+                    a = nullValue();
+                    break;
+                }
+                switch(instruction.code) {
+                case OP_ADD:
+                    a = numberValue(x + y);
+                    break;
+                case OP_SUBTRACT:
+                    a = numberValue(x - y);
+                    break;
+                case OP_MULTIPLY:
+                    a = numberValue(x * y);
+                    break;
+                default:
+                    a = y == 0.0 ? nullValue() : numberValue(x / y);
+                    break;
+                }
+                break;
+            }
+            }
+            break;
+        }
+        }
+    }
+
+    if(stack.empty()) {
+        return false;
+    }
+    out = stack.back();
+    return out.type != ExpressionValue::VT_NULL;
+}
+
+unsigned int StyleExpression::emit(enum OpCode code, unsigned int arg)
+{
+    m_code.push_back({code, arg});
+    return static_cast<unsigned int>(m_code.size() - 1);
+}
+
+bool StyleExpression::literal(const CPLJSONObject &node, ExpressionValue &out)
+{
+    switch(node.GetType()) {
+    case CPLJSONObject::Type::Null:
+        out = nullValue();
+        return true;
+    case CPLJSONObject::Type::Boolean:
+        out = numberValue(node.ToBool() ? 1.0 : 0.0);
+        return true;
+    case CPLJSONObject::Type::Integer:
+    case CPLJSONObject::Type::Long:
+    case CPLJSONObject::Type::Double:
+        out = numberValue(node.ToDouble());
+        return true;
+    case CPLJSONObject::Type::String:
+        m_strings.push_back(node.ToString());
+        out = stringValue(m_strings.back().c_str());
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool StyleExpression::compileNode(const CPLJSONObject &node)
+{
+    if(!isExpression(node)) {
+        ExpressionValue value;
+        if(!literal(node, value)) {
+            return errorMessage(_("Unsupported style expression value"));
+        }
+        m_constants.push_back(value);
+        emit(OP_CONST, static_cast<unsigned int>(m_constants.size() - 1));
+        return true;
+    }
+
+    CPLJSONArray array = node.ToArray();
+    if(array.Size() == 0 ||
+            array[0].GetType() != CPLJSONObject::Type::String) {
+        return errorMessage(_("Style expression operator expected"));
+    }
+    std::string op = array[0].ToString();
+
+    if(op == "get") {
+        if(array.Size() != 2) {
+            return errorMessage(_("Expression 'get' expects field name"));
+        }
+        m_fields.push_back(array[1].ToString());
+        emit(OP_GET, static_cast<unsigned int>(m_fields.size() - 1));
+        m_featureDependent = true;
+        return true;
+    }
+    if(op == "zoom") {
+        emit(OP_ZOOM);
+        m_zoomDependent = true;
+        return true;
+    }
+    if(op == "match") {
+        return compileMatch(array);
+    }
+    if(op == "interpolate") {
+        return compileStops(array, OP_INTERPOLATE);
+    }
+    if(op == "step") {
+        return compileStops(array, OP_STEP);
+    }
+    if(op == "case") {
+        return compileCase(array);
+    }
+
+    const std::vector<std::pair<std::string, enum OpCode>> binary = {
+        {"==", OP_EQUAL}, {"!=", OP_NOT_EQUAL}, {"<", OP_LESS},
+        {"<=", OP_LESS_EQUAL}, {">", OP_GREATER}, {">=", OP_GREATER_EQUAL},
+        {"+", OP_ADD}, {"-", OP_SUBTRACT}, {"*", OP_MULTIPLY},
+        {"/", OP_DIVIDE}
+    };
+    for(const auto &item : binary) {
+        if(item.first != op) {
+            continue;
+        }
+        if(array.Size() != 3) {
+            return errorMessage(_("Expression '%s' expects two arguments"),
+                                op.c_str());
+        }
+        if(!compileNode(array[1]) || !compileNode(array[2])) {
+            return false;
+        }
+        emit(item.second);
+        return true;
+    }
+
+    return errorMessage(_("Unsupported style expression '%s'"), op.c_str());
+}
+
+bool StyleExpression::compileMatch(const CPLJSONArray &node)
+{
+    int size = node.Size();
+    if(size < 5 || size % 2 == 0) {
+        return errorMessage(
+            _("Expression 'match' expects input, label and output pairs and fallback"));
+    }
+    if(!compileNode(node[1])) {
+        return false;
+    }
+
+    m_tables.push_back({std::vector<Stop>(), NO_TARGET, 1.0});
+    unsigned int tableIndex = static_cast<unsigned int>(m_tables.size() - 1);
+    emit(OP_MATCH, tableIndex);
+
+    std::vector<Stop> stops;
+    std::vector<unsigned int> jumps;
+    for(int i = 2; i < size - 1; i += 2) {
+        unsigned int target = static_cast<unsigned int>(m_code.size());
+        std::vector<CPLJSONObject> labels;
+        if(isExpression(node[i])) {
+            CPLJSONArray labelArray = node[i].ToArray();
+            for(int j = 0; j < labelArray.Size(); ++j) {
+                labels.push_back(labelArray[j]);
+            }
+        }
+        else {
+            labels.push_back(node[i]);
+        }
+
+        for(const CPLJSONObject &label : labels) {
+            Stop stop;
+            if(!literal(label, stop.input)) {
+                return errorMessage(_("Expression 'match' label must be literal"));
+            }
+            stop.output = nullValue();
+            stop.target = target;
+            stops.push_back(stop);
+        }
+
+        if(!compileNode(node[i + 1])) {
+            return false;
+        }
+        jumps.push_back(emit(OP_JUMP));
+    }
+
+    unsigned int fallback = static_cast<unsigned int>(m_code.size());
+    if(!compileNode(node[size - 1])) {
+        return false;
+    }
+
+    unsigned int end = static_cast<unsigned int>(m_code.size());
+    for(unsigned int jump : jumps) {
+        m_code[jump].arg = end;
+    }
+    // Table may be moved by nested expressions, so fill it at the end
+    m_tables[tableIndex].stops = stops;
+    m_tables[tableIndex].target = fallback;
+    return true;
+}
+
+bool StyleExpression::compileStops(const CPLJSONArray &node, enum OpCode code)
+{
+    int size = node.Size();
+    Table table = {std::vector<Stop>(), NO_TARGET, 1.0};
+    int first;
+    if(code == OP_INTERPOLATE) {
+        if(size < 5 || size % 2 == 0 || !isExpression(node[1])) {
+            return errorMessage(
+                _("Expression 'interpolate' expects type, input and stop pairs"));
+        }
+        CPLJSONArray type = node[1].ToArray();
+        std::string name = type.Size() > 0 ? type[0].ToString() : "";
+        if(name == "exponential" && type.Size() == 2) {
+            table.base = type[1].ToDouble();
+        }
+        else if(name != "linear") {
+            return errorMessage(_("Unsupported interpolation type"));
+        }
+        if(!compileNode(node[2])) {
+            return false;
+        }
+        first = 3;
+    }
+    else {
+        if(size < 3 || size % 2 == 0) {
+            return errorMessage(
+                _("Expression 'step' expects input, output and stop pairs"));
+        }
+        if(!compileNode(node[1])) {
+            return false;
+        }
+        Stop stop;
+        stop.input = numberValue(-std::numeric_limits<double>::infinity());
+        if(!literal(node[2], stop.output)) {
+            return errorMessage(_("Expression 'step' output must be literal"));
+        }
+        stop.target = NO_TARGET;
+        table.stops.push_back(stop);
+        first = 3;
+    }
+
+    for(int i = first; i + 1 < size; i += 2) {
+        Stop stop;
+        if(!literal(node[i], stop.input) ||
+                stop.input.type != ExpressionValue::VT_NUMBER) {
+            return errorMessage(_("Expression stop must be number"));
+        }
+        if(!table.stops.empty() &&
+                stop.input.number <= table.stops.back().input.number) {
+            return errorMessage(_("Expression stops must be in ascending order"));
+        }
+        if(!literal(node[i + 1], stop.output)) {
+            return errorMessage(_("Expression stop output must be literal"));
+        }
+        // Colors are interpolated by channels
+        ngsRGBA color;
+        if(stop.output.type == ExpressionValue::VT_STRING &&
+                parseColor(stop.output.string, color)) {
+            stop.output.type = ExpressionValue::VT_COLOR;
+            stop.output.color = color;
+        }
+        stop.target = NO_TARGET;
+        table.stops.push_back(stop);
+    }
+
+    m_tables.push_back(table);
+    emit(code, static_cast<unsigned int>(m_tables.size() - 1));
+    return true;
+}
+
+bool StyleExpression::compileCase(const CPLJSONArray &node)
+{
+    int size = node.Size();
+    if(size < 4 || size % 2 != 0) {
+        return errorMessage(
+            _("Expression 'case' expects condition and output pairs and fallback"));
+    }
+
+    std::vector<unsigned int> jumps;
+    for(int i = 1; i < size - 1; i += 2) {
+        if(!compileNode(node[i])) {
+            return false;
+        }
+        unsigned int next = emit(OP_JUMP_IF_FALSE);
+        if(!compileNode(node[i + 1])) {
+            return false;
+        }
+        jumps.push_back(emit(OP_JUMP));
+        m_code[next].arg = static_cast<unsigned int>(m_code.size());
+    }
+
+    if(!compileNode(node[size - 1])) {
+        return false;
+    }
+
+    unsigned int end = static_cast<unsigned int>(m_code.size());
+    for(unsigned int jump : jumps) {
+        m_code[jump].arg = end;
+    }
+    return true;
+}
+
+} // namespace ngs
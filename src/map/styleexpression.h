@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSSTYLEEXPRESSION_H
+#define NGSSTYLEEXPRESSION_H
+
+// std
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// gdal
+#include "cpl_json.h"
+#include "ogr_feature.h"
+
+#include "ngstore/api.h"
+
+namespace ngs {
+
+class FlatVectorTile;
+class FlatVectorTileItem;
+
+/**
+ * @brief The ExpressionValue struct Result of expression evaluation. String
+ * values point to the expression constants or to the context feature, so they
+ * are valid until the next feature is set.
+ */
+typedef struct _expressionValue {
+    enum ValueType : unsigned char {
+        VT_NULL,
+        VT_NUMBER,
+        VT_STRING,
+        VT_COLOR
+    } type;
+    double number;
+    const char *string;
+    ngsRGBA color;
+
+    bool toNumber(double &out) const;
+    bool toColor(ngsRGBA &out) const;
+} ExpressionValue;
+
+/**
+ * @brief The ExpressionContext class Zoom level and feature to evaluate
+ * expressions with. Keeps feature field indices and evaluation stack between
+ * features, so one context per thread should be reused for all tile items.
+ * Fields are read from the tile item attributes if the tile stores them,
+ * then from the feature. The point_count field is the tile item features
+ * count, it is greater than one for point clusters.
+ */
+class ExpressionContext
+{
+    friend class StyleExpression;
+public:
+    explicit ExpressionContext(double zoom = 0.0);
+    double zoom() const { return m_zoom; }
+    void setFeature(const OGRFeature *feature);
+    void setTileItem(const FlatVectorTile *tile, const FlatVectorTileItem *item);
+    bool isFieldMissing() const { return m_fieldMissing; }
+
+protected:
+    ExpressionValue field(const std::string &name);
+    ExpressionValue tileField(const std::string &name);
+
+private:
+    double m_zoom;
+    const OGRFeature *m_feature;
+    const OGRFeatureDefn *m_featureDefn;
+    std::unordered_map<std::string, int> m_fieldIndices;
+    const FlatVectorTile *m_tile;
+    const FlatVectorTileItem *m_tileItem;
+    std::unordered_map<std::string, int> m_columnIndices;
+    bool m_fieldMissing;
+    std::deque<std::string> m_strings;
+    std::vector<ExpressionValue> m_stack;
+};
+
+/**
+ * @brief The StyleExpression class Style property value computed from feature
+ * attributes and zoom level. Expression is a JSON array and is compiled once
+ * to the stack machine instructions. Supported expressions:
+ *  ["get", "field"], ["zoom"],
+ *  ["match", input, label, output, ..., fallback],
+ *  ["interpolate", ["linear"] | ["exponential", base], input, stop, output, ...],
+ *  ["step", input, output, stop, output, ...],
+ *  ["case", condition, output, ..., fallback],
+ *  ["==", a, b], ["!=", a, b], ["<", a, b], ["<=", a, b], [">", a, b],
+ *  [">=", a, b], ["+", a, b], ["-", a, b], ["*", a, b], ["/", a, b].
+ * Match labels, interpolate and step stops and outputs must be literals.
+ * Color literals are "#RRGGBB" or "#RRGGBBAA" strings.
+ */
+class StyleExpression
+{
+public:
+    StyleExpression();
+    StyleExpression(const StyleExpression &other) = delete;
+    StyleExpression &operator=(const StyleExpression &other) = delete;
+    bool compile(const CPLJSONObject &json);
+    bool evaluate(ExpressionContext &context, ExpressionValue &out) const;
+    bool isFeatureDependent() const { return m_featureDependent; }
+    bool isZoomDependent() const { return m_zoomDependent; }
+    const CPLJSONObject &json() const { return m_json; }
+
+    static bool isExpression(const CPLJSONObject &json);
+
+protected:
+    enum OpCode : unsigned char {
+        OP_CONST,
+        OP_GET,
+        OP_ZOOM,
+        OP_MATCH,
+        OP_INTERPOLATE,
+        OP_STEP,
+        OP_JUMP,
+        OP_JUMP_IF_FALSE,
+        OP_EQUAL,
+        OP_NOT_EQUAL,
+        OP_LESS,
+        OP_LESS_EQUAL,
+        OP_GREATER,
+        OP_GREATER_EQUAL,
+        OP_ADD,
+        OP_SUBTRACT,
+        OP_MULTIPLY,
+        OP_DIVIDE
+    };
+
+    typedef struct _instruction {
+        enum OpCode code;
+        unsigned int arg;
+    } Instruction;
+
+    typedef struct _stop {
+        ExpressionValue input;
+        // Output value or jump target
+        ExpressionValue output;
+        unsigned int target;
+    } Stop;
+
+    typedef struct _table {
+        std::vector<Stop> stops;
+        // Match fallback jump target or interpolation base
+        unsigned int target;
+        double base;
+    } Table;
+
+protected:
+    bool compileNode(const CPLJSONObject &node);
+    bool compileMatch(const CPLJSONArray &node);
+    bool compileStops(const CPLJSONArray &node, enum OpCode code);
+    bool compileCase(const CPLJSONArray &node);
+    bool literal(const CPLJSONObject &node, ExpressionValue &out);
+    unsigned int emit(enum OpCode code, unsigned int arg = 0);
+
+private:
+    CPLJSONObject m_json;
+    std::vector<Instruction> m_code;
+    std::vector<ExpressionValue> m_constants;
+    std::vector<Table> m_tables;
+    std::vector<std::string> m_fields;
+    // Strings are not moved as constants point to them
+    std::deque<std::string> m_strings;
+    bool m_featureDependent, m_zoomDependent;
+};
+
+using StyleExpressionPtr = std::shared_ptr<StyleExpression>;
+
+} // namespace ngs
+
+#endif // NGSSTYLEEXPRESSION_H
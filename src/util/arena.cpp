@@ -0,0 +1,147 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "arena.h"
+
+// std
+#include <algorithm>
+
+#include "cpl_conv.h"
+
+namespace ngs {
+
+constexpr size_t SCRATCH_BLOCK_SIZE = 64 * 1024;
+// Memory kept by the idle arena, the rest is freed on reset
+constexpr size_t SCRATCH_KEEP_SIZE = 1024 * 1024;
+
+/**
+ * @brief ScratchArena::ScratchArena Create empty arena.
+ * @param blockSize Size of the first block. 0 means default size.
+ */
+ScratchArena::ScratchArena(size_t blockSize) :
+    m_block(0),
+    m_offset(0),
+    m_blockSize(0 == blockSize ? SCRATCH_BLOCK_SIZE : blockSize)
+{
+}
+
+ScratchArena::~ScratchArena()
+{
+    for(Block &block : m_blocks) {
+        CPLFree(block.data);
+    }
+}
+
+/**
+ * @brief ScratchArena::allocate Allocate memory in the current block or in
+ * the next one if the current block has no room.
+ * @param size Bytes count.
+ * @param alignment Alignment, power of two.
+ * @return Pointer to memory valid until rewind to the earlier marker or reset.
+ */
+void *ScratchArena::allocate(size_t size, size_t alignment)
+{
+    if(0 == size) {
+        size = 1;
+    }
+
+    while(m_block < m_blocks.size()) {
+        Block &block = m_blocks[m_block];
+        size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+        if(offset + size <= block.size) {
+            m_offset = offset + size;
+            return block.data + offset;
+        }
+        if(m_block + 1 < m_blocks.size() &&
+                m_blocks[m_block + 1].size < size + alignment) {
+            // Blocks after the current one are free, replace the small one
+            CPLFree(m_blocks[m_block + 1].data);
+            m_blocks.erase(m_blocks.begin() +
+                           static_cast<std::ptrdiff_t>(m_block + 1));
+        }
+        if(m_block + 1 >= m_blocks.size()) {
+            break;
+        }
+        m_block++;
+        m_offset = 0;
+    }
+
+    size_t blockSize = m_blocks.empty() ? m_blockSize :
+                                          m_blocks.back().size * 2;
+    blockSize = std::max(blockSize, size + alignment);
+    Block block = { static_cast<GByte*>(CPLMalloc(blockSize)), blockSize };
+    m_blocks.push_back(block);
+    m_block = m_blocks.size() - 1;
+    m_offset = 0;
+    return allocate(size, alignment);
+}
+
+/**
+ * @brief ScratchArena::rewind Free memory allocated after the marker.
+ * @param marker Marker got by mark().
+ */
+void ScratchArena::rewind(const Marker &marker)
+{
+    m_block = marker.block;
+    m_offset = marker.offset;
+}
+
+/**
+ * @brief ScratchArena::reset Free all allocated memory and release blocks
+ * above the kept size. Call between tiles, when no scratch memory is in use.
+ */
+void ScratchArena::reset()
+{
+    m_block = 0;
+    m_offset = 0;
+    size_t kept = 0;
+    size_t count = 0;
+    for(; count < m_blocks.size(); ++count) {
+        kept += m_blocks[count].size;
+        if(kept > SCRATCH_KEEP_SIZE && count > 0) {
+            break;
+        }
+    }
+    for(size_t i = count; i < m_blocks.size(); ++i) {
+        CPLFree(m_blocks[i].data);
+    }
+    m_blocks.resize(count);
+}
+
+size_t ScratchArena::capacity() const
+{
+    size_t out = 0;
+    for(const Block &block : m_blocks) {
+        out += block.size;
+    }
+    return out;
+}
+
+/**
+ * @brief ScratchArena::threadArena Arena of the current thread.
+ * @return Arena reference.
+ */
+ScratchArena &ScratchArena::threadArena()
+{
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+}
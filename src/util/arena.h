@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSARENA_H
+#define NGSARENA_H
+
+// std
+#include <cstddef>
+#include <vector>
+
+#include "cpl_port.h"
+
+namespace ngs {
+
+/**
+ * @brief The ScratchArena class Monotonic allocator for short lived memory of
+ * one thread. Allocation moves the pointer in the current block, deallocation
+ * does nothing, all memory is freed at once by rewind or reset. Blocks are kept
+ * for the next allocations, so the tile fill workers do not go to the heap
+ * (and do not contend on it) once the arena is warm.
+ */
+class ScratchArena
+{
+public:
+    typedef struct _marker {
+        size_t block;
+        size_t offset;
+    } Marker;
+
+public:
+    explicit ScratchArena(size_t blockSize = 0);
+    ~ScratchArena();
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    void *allocate(size_t size, size_t alignment);
+    Marker mark() const { return {m_block, m_offset}; }
+    void rewind(const Marker &marker);
+    void reset();
+    size_t capacity() const;
+
+    static ScratchArena &threadArena();
+
+private:
+    typedef struct _block {
+        GByte *data;
+        size_t size;
+    } Block;
+
+private:
+    std::vector<Block> m_blocks;
+    size_t m_block;
+    size_t m_offset;
+    size_t m_blockSize;
+};
+
+/**
+ * @brief The ScratchArenaScope class Frees the arena memory allocated during
+ * the scope lifetime. Scopes may be nested.
+ */
+class ScratchArenaScope
+{
+public:
+    explicit ScratchArenaScope(ScratchArena &arena = ScratchArena::threadArena()) :
+        m_arena(arena), m_marker(arena.mark()) {}
+    ~ScratchArenaScope() { m_arena.rewind(m_marker); }
+    ScratchArenaScope(const ScratchArenaScope &) = delete;
+    ScratchArenaScope &operator=(const ScratchArenaScope &) = delete;
+    ScratchArena &arena() const { return m_arena; }
+
+private:
+    ScratchArena &m_arena;
+    ScratchArena::Marker m_marker;
+};
+
+/**
+ * @brief The ArenaAllocator class Standard containers allocator on the scratch
+ * arena. The container must not outlive the scope it was created in.
+ */
+template<class T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+public:
+    explicit ArenaAllocator(ScratchArena &arena = ScratchArena::threadArena()) :
+        m_arena(&arena) {}
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+    T *allocate(size_t count) {
+        return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, size_t) {}
+    ScratchArena *arena() const { return m_arena; }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U> &other) const {
+        return m_arena == other.arena();
+    }
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> &other) const {
+        return m_arena != other.arena();
+    }
+
+private:
+    ScratchArena *m_arena;
+};
+
+template<class T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+}
+
+#endif // NGSARENA_H
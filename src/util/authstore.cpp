@@ -20,8 +20,14 @@
  ****************************************************************************/
 #include "authstore.h"
 
+// std
+#include <algorithm>
+#include <atomic>
+
+#include "cpl_atomic_ops.h"
 #include "cpl_http.h"
 #include "cpl_json.h"
+#include "cpl_multiproc.h"
 
 #include "api_priv.h"
 #include "util/error.h"
@@ -29,6 +35,9 @@
 
 namespace ngs {
 
+constexpr int TOKEN_REFRESH_MARGIN = 60; // seconds
+constexpr double TOKEN_REFRESH_RETRY = 30.0; // seconds after failed refresh
+
 /**
  * @brief The HTTPAuthBasic class Basic HTTP authorisation.
  */
@@ -37,11 +46,12 @@ class HTTPAuthBasic : public IHTTPAuth {
 public:
     explicit HTTPAuthBasic(const std::string &login, const std::string &password);
     virtual ~HTTPAuthBasic() override = default;
-    virtual std::string header() override { return "Authorization: Basic " + m_basicAuth; }
+    virtual std::string header() override { return m_header; }
     virtual Properties properties() const override;
 
 private:
     std::string m_basicAuth;
+    std::string m_header;
 };
 
 HTTPAuthBasic::HTTPAuthBasic(const std::string &login, const std::string &password)
@@ -51,6 +61,7 @@ HTTPAuthBasic::HTTPAuthBasic(const std::string &login, const std::string &passwo
                                        reinterpret_cast<const GByte*>(str.data()));
     m_basicAuth = encodedStr;
     CPLFree(encodedStr);
+    m_header = "Authorization: Basic " + m_basicAuth;
 }
 
 Properties HTTPAuthBasic::properties() const
@@ -62,9 +73,27 @@ Properties HTTPAuthBasic::properties() const
 }
 
 /**
- * @brief The HTTPAuthBearer class
+ * @brief The BearerToken struct Immutable token state. Replaced as a whole on
+ * refresh, so readers need no lock.
+ */
+typedef struct _bearerToken {
+    std::string accessToken;
+    std::string updateToken;
+    std::string header;
+    int expiresIn;
+    time_t lastCheck;
+} BearerToken;
+
+using BearerTokenPtr = std::shared_ptr<const BearerToken>;
+
+/**
+ * @brief The HTTPAuthBearer class OAuth bearer authorisation. The token is
+ * renewed in background thread shortly before it expires. Only an already
+ * expired token is renewed in the request thread. After failed renewal the
+ * next one is tried not earlier than TOKEN_REFRESH_RETRY seconds.
  */
-class HTTPAuthBearer : public IHTTPAuth {
+class HTTPAuthBearer : public IHTTPAuth,
+        public std::enable_shared_from_this<HTTPAuthBearer> {
 
 public:
     explicit HTTPAuthBearer(const std::string &url, const std::string &clientId,
@@ -75,14 +104,24 @@ public:
     virtual std::string header() override;
     virtual Properties properties() const override;
 
+private:
+    BearerTokenPtr token() const;
+    void setToken(const std::string &accessToken, const std::string &updateToken,
+                  int expiresIn, time_t lastCheck);
+    std::string refresh();
+    void startRefresh();
+    bool canRefresh(time_t now) const;
+    static int refreshMargin(int expiresIn);
+    static void refreshThread(void *data);
+
 private:
     std::string m_url;
     std::string m_clientId;
-    std::string m_accessToken;
-    std::string m_updateToken;
     std::string m_tokenServer;
-    int m_expiresIn;
-    time_t m_lastCheck;
+    BearerTokenPtr m_token;
+    Mutex m_refreshMutex;
+    volatile int m_refreshing;
+    std::atomic<time_t> m_refreshFailed;
 };
 
 HTTPAuthBearer::HTTPAuthBearer(const std::string &url, const std::string &clientId,
@@ -91,52 +130,104 @@ HTTPAuthBearer::HTTPAuthBearer(const std::string &url, const std::string &client
                                time_t lastCheck) : IHTTPAuth(),
     m_url(url),
     m_clientId(clientId),
-    m_accessToken(accessToken),
-    m_updateToken(updateToken),
     m_tokenServer(tokenServer),
-    m_expiresIn(expiresIn),
-    m_lastCheck(lastCheck)
+    m_refreshing(0),
+    m_refreshFailed(0)
 {
-
+    setToken(accessToken, updateToken, expiresIn, lastCheck);
 }
 
 Properties HTTPAuthBearer::properties() const
 {
+    BearerTokenPtr current = token();
     Properties out;
     out.add("type", "bearer");
     out.add("clientId", m_clientId);
-    out.add("accessToken", m_accessToken);
-    out.add("updateToken", m_updateToken);
+    out.add("accessToken", current->accessToken);
+    out.add("updateToken", current->updateToken);
     out.add("tokenServer", m_tokenServer);
-    out.add("expiresIn", std::to_string(m_expiresIn));
+    out.add("expiresIn", std::to_string(current->expiresIn));
     return out;
 }
 
+BearerTokenPtr HTTPAuthBearer::token() const
+{
+    return std::atomic_load(&m_token);
+}
+
+void HTTPAuthBearer::setToken(const std::string &accessToken,
+                              const std::string &updateToken, int expiresIn,
+                              time_t lastCheck)
+{
+    BearerToken *newToken = new BearerToken;
+    newToken->accessToken = accessToken;
+    newToken->updateToken = updateToken;
+    newToken->header = "Authorization: Bearer " + accessToken;
+    newToken->expiresIn = expiresIn;
+    newToken->lastCheck = lastCheck;
+    std::atomic_store(&m_token, BearerTokenPtr(newToken));
+}
+
+bool HTTPAuthBearer::canRefresh(time_t now) const
+{
+    return difftime(now, m_refreshFailed) >= TOKEN_REFRESH_RETRY;
+}
+
+int HTTPAuthBearer::refreshMargin(int expiresIn)
+{
+    return std::min(TOKEN_REFRESH_MARGIN, expiresIn / 10);
+}
+
 std::string HTTPAuthBearer::header()
 {
     // 1. Check if expires if not return current access token
+    BearerTokenPtr current = token();
+    time_t now = time(nullptr);
+    double seconds = difftime(now, current->lastCheck);
+    if(seconds < current->expiresIn) {
+        if(seconds >= current->expiresIn - refreshMargin(current->expiresIn) &&
+                canRefresh(now)) {
+            startRefresh();
+        }
+        return current->header;
+    }
+
+    // 2. Token is expired, the request has to wait for the new one
+    return refresh();
+}
+
+std::string HTTPAuthBearer::refresh()
+{
+    MutexHolder holder(m_refreshMutex);
+
+    // Token may be updated by other thread while waiting the lock
+    BearerTokenPtr current = token();
     time_t now = time(nullptr);
-    double seconds = difftime(now, m_lastCheck);
-    if(seconds < m_expiresIn) {
-        CPLDebug("ngstore", "Token is not expired. Url: %s", m_url.c_str());
-        return "Authorization: Bearer " + m_accessToken;
+    double seconds = difftime(now, current->lastCheck);
+    if(seconds < current->expiresIn - refreshMargin(current->expiresIn)) {
+        return current->header;
+    }
+    // Server was not reachable recently, do not load it with each request
+    if(!canRefresh(now)) {
+        return current->header;
     }
 
-    // 2. Try to update token
+    // 3. Try to update token
     CPLStringList requestOptions;
     requestOptions.AddNameValue("CUSTOMREQUEST", "POST");
     requestOptions.AddNameValue("POSTFIELDS",
                                 CPLSPrintf("grant_type=refresh_token&client_id=%s&refresh_token=%s",
                                            m_clientId.c_str(),
-                                           m_updateToken.c_str()));
+                                           current->updateToken.c_str()));
 
     CPLHTTPResult *result = CPLHTTPFetch(m_tokenServer.c_str(), requestOptions);
 
-    if(result->nStatus != 0 || result->pszErrBuf != nullptr) {
+    if(nullptr == result || result->nStatus != 0 || result->pszErrBuf != nullptr) {
         CPLHTTPDestroyResult( result );
+        m_refreshFailed = now;
         CPLDebug("ngstore", "Failed to refresh token. Return last not expired. Url: %s",
                  m_url.c_str());
-        return "Authorization: Bearer " + m_accessToken;
+        return current->header;
     }
 
     CPLJSONDocument resultJson;
@@ -157,16 +248,42 @@ std::string HTTPAuthBearer::header()
         return "expired";
     }
 
-    m_accessToken = root.GetString("access_token", m_accessToken);
-    m_updateToken = root.GetString("refresh_token", m_updateToken);
-    m_expiresIn = root.GetInteger("expires_in", m_expiresIn);
-    m_lastCheck = now;
+    setToken(root.GetString("access_token", current->accessToken),
+             root.GetString("refresh_token", current->updateToken),
+             root.GetInteger("expires_in", current->expiresIn), now);
+    m_refreshFailed = 0;
 
     // 5. Return new Auth Header
     CPLDebug("ngstore", "Token updated. Url: %s", m_url.c_str());
     Notify::instance().onNotify(m_url, CC_TOKEN_CHANGED);
 
-    return "Authorization: Bearer " + m_accessToken;
+    return token()->header;
+}
+
+/**
+ * @brief HTTPAuthBearer::startRefresh Renew token in background thread. Only
+ * one renewal is executed at a time.
+ */
+void HTTPAuthBearer::startRefresh()
+{
+    if(!CPLAtomicCompareAndExchange(&m_refreshing, 0, 1)) {
+        return;
+    }
+
+    // Keep auth alive until refresh finished even if removed from store
+    auto self = new std::shared_ptr<HTTPAuthBearer>(shared_from_this());
+    if(CPLCreateThread(refreshThread, self) == -1) {
+        delete self;
+        CPLAtomicCompareAndExchange(&m_refreshing, 1, 0);
+    }
+}
+
+void HTTPAuthBearer::refreshThread(void *data)
+{
+    auto self = static_cast<std::shared_ptr<HTTPAuthBearer>*>(data);
+    (*self)->refresh();
+    CPLAtomicCompareAndExchange(&(*self)->m_refreshing, 1, 0);
+    delete self;
 }
 
 //------------------------------------------------------------------------------
@@ -213,10 +330,10 @@ bool AuthStore::authAdd(const std::string &url, const Options &options)
             lastCheck = now;
         }
 
-        IHTTPAuth *auth = new HTTPAuthBearer(url, clientId, tokenServer,
+        IHTTPAuthPtr auth(new HTTPAuthBearer(url, clientId, tokenServer,
                                              accessToken, updateToken,
-                                             expiresIn, lastCheck);
-        instance().add(url, IHTTPAuthPtr(auth));
+                                             expiresIn, lastCheck));
+        instance().add(url, auth);
         return true;
     }
     else if(options["type"] == "basic")
@@ -266,10 +383,9 @@ bool AuthStore::authAdd(const std::vector<std::string> &urls, const Options &opt
             lastCheck = now;
         }
 
-        IHTTPAuth *auth = new HTTPAuthBearer(urls[0], clientId, tokenServer,
-                                             accessToken, updateToken,
-                                             expiresIn, lastCheck);
-        auto authPtr = IHTTPAuthPtr(auth);
+        IHTTPAuthPtr authPtr(new HTTPAuthBearer(urls[0], clientId, tokenServer,
+                                                accessToken, updateToken,
+                                                expiresIn, lastCheck));
         for(const auto &url : urls) {
             instance().add(url, authPtr);
         }
@@ -304,25 +420,34 @@ std::string AuthStore::authHeader(const std::string &url)
 
 void AuthStore::add(const std::string &url, IHTTPAuthPtr auth)
 {
-    m_auths[url] = auth;
+    MutexHolder holder(m_writeMutex);
+    auto auths = std::make_shared<AuthMap>(*std::atomic_load(&m_auths));
+    (*auths)[url] = auth;
+    std::atomic_store(&m_auths, std::shared_ptr<const AuthMap>(auths));
 }
 
 void AuthStore::remove(const std::string &url)
 {
-    m_auths.erase(url);
+    MutexHolder holder(m_writeMutex);
+    auto auths = std::make_shared<AuthMap>(*std::atomic_load(&m_auths));
+    auths->erase(url);
+    std::atomic_store(&m_auths, std::shared_ptr<const AuthMap>(auths));
 }
 
 Properties AuthStore::properties(const std::string &url)
 {
-    if(m_auths[url] == nullptr) {
+    auto auths = std::atomic_load(&m_auths);
+    auto it = auths->find(url);
+    if(it == auths->end() || it->second == nullptr) {
         return {};
     }
-    return m_auths[url]->properties();
+    return it->second->properties();
 }
 
 std::string AuthStore::header(const std::string &url) const
 {
-    for(auto pair : m_auths) {
+    auto auths = std::atomic_load(&m_auths);
+    for(const auto &pair : *auths) {
         if(STARTS_WITH_CI(url.c_str(), pair.first.c_str())) {
             return pair.second->header();
         }
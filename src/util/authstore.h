@@ -21,8 +21,11 @@
 #ifndef NGSAUTHSTORE_H
 #define NGSAUTHSTORE_H
 
+#include "util/mutex.h"
 #include "util/options.h"
 
+#include <map>
+#include <memory>
 #include <vector>
 
 namespace ngs {
@@ -69,7 +72,10 @@ private:
     static AuthStore &instance();
 
 private:
-    std::map<std::string, IHTTPAuthPtr> m_auths;
+    using AuthMap = std::map<std::string, IHTTPAuthPtr>;
+    // Readers take the snapshot without lock, writers replace it
+    std::shared_ptr<const AuthMap> m_auths = std::make_shared<AuthMap>();
+    Mutex m_writeMutex;
 };
 
 } // namespace ngs
@@ -20,18 +20,24 @@
  ****************************************************************************/
 #include "buffer.h"
 
-#include <cstring>
+// std
+#include <algorithm>
 
 #include "cpl_conv.h"
 
 namespace ngs {
 
-constexpr unsigned int DEFAULT_BUFFER_SIZE = 1024;
+constexpr size_t DEFAULT_BUFFER_SIZE = 1024;
 
-Buffer::Buffer() :
+Buffer::Buffer() : Buffer(DEFAULT_BUFFER_SIZE)
+{
+
+}
+
+Buffer::Buffer(size_t reserveSize) :
     m_size(0),
-    m_mallocSize(DEFAULT_BUFFER_SIZE),
-    m_data(static_cast<GByte*>(CPLMalloc(DEFAULT_BUFFER_SIZE))),
+    m_mallocSize(static_cast<int>(std::max(reserveSize, DEFAULT_BUFFER_SIZE))),
+    m_data(static_cast<GByte*>(CPLMalloc(static_cast<size_t>(m_mallocSize)))),
     m_currentPos(0),
     m_own(true)
 {
@@ -55,160 +61,151 @@ Buffer::~Buffer()
     }
 }
 
-Buffer &Buffer::put(GUInt32 val)
+/**
+ * @brief Buffer::reserve Make capacity at least size bytes. Use before
+ * serialization with known or estimated result size.
+ * @param size Bytes count.
+ */
+void Buffer::reserve(size_t size)
 {
-    size_t size = sizeof(GUInt32);
-    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
-        m_mallocSize += DEFAULT_BUFFER_SIZE;
-        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
+    if(size <= static_cast<size_t>(m_mallocSize)) {
+        return;
     }
 
-    std::memcpy(m_data + m_currentPos, &val, size);
-    m_currentPos += size;
-    m_size += size;
-
-    return *this;
+    if(m_own) {
+        m_data = static_cast<GByte*>(CPLRealloc(m_data, size));
+    }
+    else {
+        // Borrowed memory is never reallocated, copy it to own storage
+        GByte *data = static_cast<GByte*>(CPLMalloc(size));
+        if(m_size > 0) {
+            std::memcpy(data, m_data, static_cast<size_t>(m_size));
+        }
+        m_data = data;
+        m_own = true;
+    }
+    m_mallocSize = static_cast<int>(size);
 }
 
-Buffer &Buffer::put(float val)
+/**
+ * @brief Buffer::ensure Make room for size bytes at current position. Capacity
+ * is at least doubled, so the sequence of puts costs amortized O(1).
+ * @param size Bytes count.
+ */
+void Buffer::ensure(size_t size)
 {
-    size_t size = sizeof(float);
-    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
-        m_mallocSize += DEFAULT_BUFFER_SIZE;
-        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
+    size_t required = m_currentPos + size;
+    if(required <= static_cast<size_t>(m_mallocSize)) {
+        return;
     }
+    reserve(std::max(required, std::max(static_cast<size_t>(m_mallocSize) * 2,
+                                        DEFAULT_BUFFER_SIZE)));
+}
 
-    std::memcpy(m_data + m_currentPos, &val, size);
-    m_currentPos += size;
-    m_size += size;
+Buffer &Buffer::put(GUInt32 val)
+{
+    return putValue(val);
+}
 
-    return *this;
+Buffer &Buffer::put(float val)
+{
+    return putValue(val);
 }
 
 Buffer &Buffer::put(GByte val)
 {
-    size_t size = sizeof(GByte);
-    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
-        m_mallocSize += DEFAULT_BUFFER_SIZE;
-        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
-    }
-
-    std::memcpy(m_data + m_currentPos, &val, size);
-    m_currentPos += size;
-    m_size += size;
-
-    return *this;
+    return putValue(val);
 }
 
 Buffer &Buffer::put(GUInt16 val)
 {
-    size_t size = sizeof(GUInt16);
-    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
-        m_mallocSize += DEFAULT_BUFFER_SIZE;
-        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
-    }
-
-    std::memcpy(m_data + m_currentPos, &val, size);
-    m_currentPos += size;
-    m_size += size;
-
-    return *this;
+    return putValue(val);
 }
 
 Buffer &Buffer::put(GUIntBig val)
 {
-    size_t size = sizeof(GUIntBig);
-    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
-        m_mallocSize += DEFAULT_BUFFER_SIZE;
-        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
-    }
+    return putValue(val);
+}
 
-    std::memcpy(m_data + m_currentPos, &val, size);
-    m_currentPos += size;
-    m_size += size;
+Buffer &Buffer::put(GIntBig val)
+{
+    return putValue(val);
+}
 
+Buffer &Buffer::put(const void *data, size_t size)
+{
+    if(0 == size) {
+        return *this;
+    }
+    ensure(size);
+    std::memcpy(m_data + m_currentPos, data, size);
+    advance(size);
     return *this;
 }
 
-Buffer &Buffer::put(GIntBig val)
+/**
+ * @brief Buffer::get Copy size bytes from current position.
+ * @param data Output memory.
+ * @param size Bytes count.
+ * @return False if buffer has less than size bytes left.
+ */
+bool Buffer::get(void *data, size_t size)
 {
-    size_t size = sizeof(GIntBig);
-    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
-        m_mallocSize += DEFAULT_BUFFER_SIZE;
-        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
+    if(size > remaining()) {
+        return false;
     }
+    if(size > 0) {
+        std::memcpy(data, m_data + m_currentPos, size);
+        m_currentPos += size;
+    }
+    return true;
+}
 
-    std::memcpy(m_data + m_currentPos, &val, size);
+/**
+ * @brief Buffer::view Read size bytes in place without copy. The pointer is
+ * valid until next write to the buffer.
+ * @param size Bytes count.
+ * @return Pointer to data at current position or nullptr if buffer has less
+ * than size bytes left.
+ */
+const GByte *Buffer::view(size_t size)
+{
+    if(size > remaining()) {
+        return nullptr;
+    }
+    const GByte *out = m_data + m_currentPos;
     m_currentPos += size;
-    m_size += size;
-
-    return *this;
+    return out;
 }
 
 GUInt32 Buffer::getULong()
 {
-    GUInt32 val = 0;
-    size_t size = sizeof(GUInt32);
-    if(m_currentPos + size > static_cast<size_t>(m_size))
-        return val;
-    std::memcpy(&val, m_data + m_currentPos, size);
-    m_currentPos += size;
-    return val;
+    return getValue<GUInt32>();
 }
 
 float Buffer::getFloat()
 {
-    float val = 0.0;
-    size_t size = sizeof(float);
-    if(m_currentPos + size > static_cast<size_t>(m_size))
-        return val;
-    std::memcpy(&val, m_data + m_currentPos, size);
-    m_currentPos += size;
-    return val;
+    return getValue<float>();
 }
 
 GByte Buffer::getByte()
 {
-    GByte val = 0;
-    size_t size = sizeof(GByte);
-    if(m_currentPos + size > static_cast<size_t>(m_size))
-        return val;
-    std::memcpy(&val, m_data + m_currentPos, size);
-    m_currentPos += size;
-    return val;
+    return getValue<GByte>();
 }
 
 GUInt16 Buffer::getUShort()
 {
-    GUInt16 val = 0;
-    size_t size = sizeof(GUInt16);
-    if(m_currentPos + size > static_cast<size_t>(m_size))
-        return val;
-    std::memcpy(&val, m_data + m_currentPos, size);
-    m_currentPos += size;
-    return val;
+    return getValue<GUInt16>();
 }
 
 GUIntBig Buffer::getUBig()
 {
-    GUIntBig val = 0;
-    size_t size = sizeof(GUIntBig);
-    if(m_currentPos + size > static_cast<size_t>(m_size))
-        return val;
-    std::memcpy(&val, m_data + m_currentPos, size);
-    m_currentPos += size;
-    return val;
+    return getValue<GUIntBig>();
 }
 
 GIntBig Buffer::getBig()
 {
-    GIntBig val = 0;
-    size_t size = sizeof(GIntBig);
-    if(m_currentPos + size > static_cast<size_t>(m_size))
-        return val;
-    std::memcpy(&val, m_data + m_currentPos, size);
-    m_currentPos += size;
-    return val;
+    return getValue<GIntBig>();
 }
 
 }
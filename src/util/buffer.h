@@ -21,22 +21,36 @@
 #ifndef NGSBUFFER_H
 #define NGSBUFFER_H
 
+// std
+#include <cstring>
 #include <memory>
 
 #include "cpl_port.h"
 
 namespace ngs {
 
+/**
+ * @brief The Buffer class Binary serialization writer/reader. Owned storage
+ * grows geometrically. Borrowed storage (not owned) is read in place and
+ * copied to owned memory on first write beyond its size.
+ */
 class Buffer
 {
 public:
     Buffer();
+    explicit Buffer(size_t reserveSize);
     Buffer(GByte *data, int size, bool own = true);
     ~Buffer();
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
 
     // getters
     GByte *data() const { return m_data; }
     int size() const { return m_size; }
+    size_t capacity() const { return static_cast<size_t>(m_mallocSize); }
+    bool own() const { return m_own; }
+
+    void reserve(size_t size);
 
     Buffer &put(GUInt32 val);
     Buffer &put(float val);
@@ -44,6 +58,18 @@ public:
     Buffer &put(GUInt16 val);
     Buffer &put(GUIntBig val);
     Buffer &put(GIntBig val);
+    Buffer &put(const void *data, size_t size);
+
+    /**
+     * @brief putArray Write count values in one copy.
+     * @param data Values.
+     * @param count Values count.
+     * @return This buffer.
+     */
+    template<typename T>
+    Buffer &putArray(const T *data, size_t count) {
+        return put(data, count * sizeof(T));
+    }
 
     GUInt32 getULong();
     float getFloat();
@@ -51,8 +77,50 @@ public:
     GUInt16 getUShort();
     GUIntBig getUBig();
     GIntBig getBig();
+    bool get(void *data, size_t size);
+
+    /**
+     * @brief getArray Read count values with one bounds check.
+     * @param data Output values.
+     * @param count Values count.
+     * @return False if buffer has less than count values left. Position is
+     * not changed in this case.
+     */
+    template<typename T>
+    bool getArray(T *data, size_t count) {
+        return get(data, count * sizeof(T));
+    }
+
+    const GByte *view(size_t size);
 
     void seek(size_t position) { m_currentPos = position; }
+    size_t position() const { return m_currentPos; }
+    size_t remaining() const {
+        return m_currentPos < static_cast<size_t>(m_size) ?
+                    static_cast<size_t>(m_size) - m_currentPos : 0;
+    }
+
+private:
+    void ensure(size_t size);
+    template<typename T>
+    Buffer &putValue(T val) {
+        ensure(sizeof(T));
+        std::memcpy(m_data + m_currentPos, &val, sizeof(T));
+        advance(sizeof(T));
+        return *this;
+    }
+    template<typename T>
+    T getValue() {
+        T val = 0;
+        get(&val, sizeof(T));
+        return val;
+    }
+    void advance(size_t size) {
+        m_currentPos += size;
+        if(m_currentPos > static_cast<size_t>(m_size)) {
+            m_size = static_cast<int>(m_currentPos);
+        }
+    }
 
 private:
     int m_size;
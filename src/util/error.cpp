@@ -20,14 +20,41 @@
  ****************************************************************************/
 #include "error.h"
 
+// std
+#include <atomic>
+#include <cstdio>
+
 #include "cpl_error.h"
-#include "cpl_multiproc.h"
 #include "cpl_string.h"
 
 namespace ngs {
 
-static CPLLock *hAtomicOpLock = nullptr;
-static std::string gLastMsg;
+constexpr size_t ERROR_MESSAGE_SIZE = 1024;
+constexpr int ERROR_CODE_COUNT = COD_FUNCTION_NOT_AVAILABLE -
+        COD_UNEXPECTED_ERROR + 1;
+
+// Last message of the thread, as CPLGetLastErrorMsg
+static thread_local char tLastMsg[ERROR_MESSAGE_SIZE] = "";
+static std::atomic<unsigned long> gErrorCounts[ERROR_CODE_COUNT];
+
+static void countError(enum ngsCode errorCode)
+{
+    if(errorCode >= COD_UNEXPECTED_ERROR &&
+            errorCode <= COD_FUNCTION_NOT_AVAILABLE) {
+        gErrorCounts[errorCode - COD_UNEXPECTED_ERROR].fetch_add(
+                    1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief postMessage Format message to the thread buffer and post it to GDAL
+ * error handler. Too long messages are truncated.
+ */
+static void postMessage(CPLErr errorClass, const char *fmt, va_list args)
+{
+    std::vsnprintf(tLastMsg, ERROR_MESSAGE_SIZE, fmt, args);
+    CPLError(errorClass, CPLE_AppDefined, "%s", tLastMsg);
+}
 
 int outMessage(enum ngsCode errorCode, const char *fmt, ...)
 {
@@ -36,11 +63,13 @@ int outMessage(enum ngsCode errorCode, const char *fmt, ...)
 
         // Expand the error message
         va_start(args, fmt);
-        CPLErrorV(CE_Failure, CPLE_AppDefined, fmt, args);
+        postMessage(CE_Failure, fmt, args);
         va_end(args);
     }
-    CPLLockHolderD(&hAtomicOpLock, LOCK_SPIN)
-    gLastMsg = CPLGetLastErrorMsg();
+    else {
+        CPLStrlcpy(tLastMsg, CPLGetLastErrorMsg(), ERROR_MESSAGE_SIZE);
+    }
+    countError(errorCode);
     return errorCode;
 }
 
@@ -53,10 +82,9 @@ bool errorMessage(const char *fmt, ...)
 
     // Expand the error message
     va_start(args, fmt);
-    CPLErrorV(CE_Failure, CPLE_AppDefined, fmt, args);
+    postMessage(CE_Failure, fmt, args);
     va_end(args);
-    CPLLockHolderD(&hAtomicOpLock, LOCK_SPIN)
-    gLastMsg = CPLGetLastErrorMsg();
+    countError(COD_UNEXPECTED_ERROR);
     return false;
 }
 
@@ -67,24 +95,51 @@ void warningMessage(const char *fmt, ...)
 
         // Expand the error message
         va_start(args, fmt);
-        CPLErrorV(CE_Warning, CPLE_AppDefined, fmt, args);
+        postMessage(CE_Warning, fmt, args);
         va_end(args);
     }
-    CPLLockHolderD(&hAtomicOpLock, LOCK_SPIN)
-    gLastMsg = CPLGetLastErrorMsg();
+    else {
+        CPLStrlcpy(tLastMsg, CPLGetLastErrorMsg(), ERROR_MESSAGE_SIZE);
+    }
 }
 
+/**
+ * @brief getLastError Last message posted by the current thread.
+ * @return Message valid until the next message of the thread.
+ */
 const char *getLastError()
 {
-    CPLLockHolderD(&hAtomicOpLock, LOCK_SPIN)
-    return gLastMsg.c_str();
+    return tLastMsg;
 }
 
 void resetError()
 {
-    CPLLockHolderD(&hAtomicOpLock, LOCK_SPIN)
-    gLastMsg.clear();
+    tLastMsg[0] = '\0';
     CPLErrorReset();
 }
 
+/**
+ * @brief errorCount Number of errors with the code posted by all threads
+ * since the start or resetErrorCounts. Failures of errorMessage are counted
+ * as COD_UNEXPECTED_ERROR.
+ * @param errorCode Error code.
+ * @return Errors count.
+ */
+unsigned long errorCount(enum ngsCode errorCode)
+{
+    if(errorCode < COD_UNEXPECTED_ERROR ||
+            errorCode > COD_FUNCTION_NOT_AVAILABLE) {
+        return 0;
+    }
+    return gErrorCounts[errorCode - COD_UNEXPECTED_ERROR].load(
+                std::memory_order_relaxed);
+}
+
+void resetErrorCounts()
+{
+    for(std::atomic<unsigned long> &count : gErrorCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
 }
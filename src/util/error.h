@@ -30,6 +30,8 @@ int outMessage(enum ngsCode errorCode, const char *fmt, ...);
 bool errorMessage(const char *fmt, ...);
 void warningMessage(const char *fmt, ...);
 const char *getLastError();
+unsigned long errorCount(enum ngsCode errorCode);
+void resetErrorCounts();
 
 }
 
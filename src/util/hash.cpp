@@ -0,0 +1,178 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "hash.h"
+
+// stl
+#include <cstring>
+
+#include "cpl_string.h"
+
+namespace ngs {
+
+constexpr GUInt64 PRIME1 = 11400714785074694791ULL;
+constexpr GUInt64 PRIME2 = 14029467366897019727ULL;
+constexpr GUInt64 PRIME3 = 1609587929392839161ULL;
+constexpr GUInt64 PRIME4 = 9650029242287828579ULL;
+constexpr GUInt64 PRIME5 = 2870177450012600261ULL;
+
+static inline GUInt64 rotl(GUInt64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline GUInt64 read64(const unsigned char *data)
+{
+    GUInt64 value;
+    std::memcpy(&value, data, sizeof(value));
+    CPL_LSBPTR64(&value);
+    return value;
+}
+
+static inline GUInt32 read32(const unsigned char *data)
+{
+    GUInt32 value;
+    std::memcpy(&value, data, sizeof(value));
+    CPL_LSBPTR32(&value);
+    return value;
+}
+
+static inline GUInt64 round(GUInt64 acc, GUInt64 input)
+{
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline GUInt64 mergeRound(GUInt64 acc, GUInt64 value)
+{
+    acc ^= round(0, value);
+    return acc * PRIME1 + PRIME4;
+}
+
+Hash64::Hash64(GUInt64 seed) :
+    m_seed(seed),
+    m_totalSize(0),
+    m_bufferSize(0)
+{
+    m_v[0] = seed + PRIME1 + PRIME2;
+    m_v[1] = seed + PRIME2;
+    m_v[2] = seed;
+    m_v[3] = seed - PRIME1;
+}
+
+void Hash64::update(const void *data, size_t size)
+{
+    const unsigned char *input = static_cast<const unsigned char*>(data);
+    m_totalSize += size;
+
+    // Fill the stripe buffer left from previous update
+    if(m_bufferSize + size < sizeof(m_buffer)) {
+        std::memcpy(m_buffer + m_bufferSize, input, size);
+        m_bufferSize += size;
+        return;
+    }
+
+    if(m_bufferSize > 0) {
+        size_t fill = sizeof(m_buffer) - m_bufferSize;
+        std::memcpy(m_buffer + m_bufferSize, input, fill);
+        for(int i = 0; i < 4; ++i) {
+            m_v[i] = round(m_v[i], read64(m_buffer + i * 8));
+        }
+        input += fill;
+        size -= fill;
+        m_bufferSize = 0;
+    }
+
+    while(size >= sizeof(m_buffer)) {
+        for(int i = 0; i < 4; ++i) {
+            m_v[i] = round(m_v[i], read64(input + i * 8));
+        }
+        input += sizeof(m_buffer);
+        size -= sizeof(m_buffer);
+    }
+
+    if(size > 0) {
+        std::memcpy(m_buffer, input, size);
+        m_bufferSize = size;
+    }
+}
+
+void Hash64::update(const std::string &value)
+{
+    update(value.data(), value.size());
+}
+
+void Hash64::update(GUInt64 value)
+{
+    CPL_LSBPTR64(&value);
+    update(&value, sizeof(value));
+}
+
+GUInt64 Hash64::digest() const
+{
+    GUInt64 hash;
+    if(m_totalSize >= sizeof(m_buffer)) {
+        hash = rotl(m_v[0], 1) + rotl(m_v[1], 7) + rotl(m_v[2], 12) +
+                rotl(m_v[3], 18);
+        for(int i = 0; i < 4; ++i) {
+            hash = mergeRound(hash, m_v[i]);
+        }
+    }
+    else {
+        hash = m_seed + PRIME5;
+    }
+    hash += m_totalSize;
+
+    const unsigned char *input = m_buffer;
+    size_t size = m_bufferSize;
+    while(size >= 8) {
+        hash ^= round(0, read64(input));
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+        input += 8;
+        size -= 8;
+    }
+    if(size >= 4) {
+        hash ^= static_cast<GUInt64>(read32(input)) * PRIME1;
+        hash = rotl(hash, 23) * PRIME2 + PRIME3;
+        input += 4;
+        size -= 4;
+    }
+    while(size > 0) {
+        hash ^= (*input) * PRIME5;
+        hash = rotl(hash, 11) * PRIME1;
+        input++;
+        size--;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::string Hash64::hexDigest() const
+{
+    return CPLSPrintf("%016llx", static_cast<unsigned long long>(digest()));
+}
+
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSHASH_H
+#define NGSHASH_H
+
+#include <string>
+
+#include "cpl_port.h"
+
+namespace ngs {
+
+/**
+ * @brief The Hash64 class Streaming non-cryptographic 64 bit hash (xxHash64).
+ * Data can be added by parts, the digest is the same as for the whole data.
+ */
+class Hash64
+{
+public:
+    explicit Hash64(GUInt64 seed = 0);
+    void update(const void *data, size_t size);
+    void update(const std::string &value);
+    void update(GUInt64 value);
+    GUInt64 digest() const;
+    std::string hexDigest() const;
+
+protected:
+    GUInt64 m_v[4];
+    GUInt64 m_seed;
+    GUInt64 m_totalSize;
+    unsigned char m_buffer[32];
+    size_t m_bufferSize;
+};
+
+}
+
+#endif // NGSHASH_H
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "memorybudget.h"
+
+// std
+#include <algorithm>
+
+// gdal
+#include "gdal.h"
+
+#include "settings.h"
+
+namespace ngs {
+
+constexpr size_t MB = 1024 * 1024;
+
+std::atomic<GUIntBig> MemoryBudget::m_tick(0);
+
+//------------------------------------------------------------------------------
+// MemoryBudget
+//------------------------------------------------------------------------------
+
+MemoryBudget &MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+/**
+ * @brief MemoryBudget::tick Access counter shared by consumers, so items of
+ * different caches are ordered by their last access.
+ * @return Next tick.
+ */
+GUIntBig MemoryBudget::tick()
+{
+    return m_tick.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+MemoryBudget::MemoryBudget() :
+    m_maxSize(0),
+    m_glMemory(0),
+    m_trimGeneration(0)
+{
+    const Settings &settings = Settings::instance();
+    int maxSize = settings.getInteger("common/memory_budget", 0);
+    if(maxSize > 0) {
+        m_maxSize = static_cast<size_t>(maxSize) * MB;
+    }
+}
+
+void MemoryBudget::addConsumer(MemoryConsumer *consumer)
+{
+    MutexHolder holder(m_mutex);
+    m_consumers.push_back(consumer);
+}
+
+void MemoryBudget::removeConsumer(MemoryConsumer *consumer)
+{
+    MutexHolder holder(m_mutex);
+    m_consumers.erase(std::remove(m_consumers.begin(), m_consumers.end(),
+                                  consumer), m_consumers.end());
+}
+
+void MemoryBudget::setMaxSize(size_t size)
+{
+    m_maxSize = size;
+    enforce();
+}
+
+/**
+ * @brief MemoryBudget::size Memory used by the library caches, GDAL block
+ * cache and GL objects.
+ * @return Size in bytes.
+ */
+size_t MemoryBudget::size() const
+{
+    size_t out = static_cast<size_t>(std::max(GDALGetCacheUsed64(),
+                                              static_cast<GIntBig>(0)));
+    out += static_cast<size_t>(std::max(m_glMemory.load(), 0LL));
+    MutexHolder holder(m_mutex);
+    for(const MemoryConsumer *consumer : m_consumers) {
+        out += consumer->memoryUsed();
+    }
+    return out;
+}
+
+bool MemoryBudget::isExceeded() const
+{
+    size_t maxSize = m_maxSize;
+    return maxSize > 0 && size() > maxSize;
+}
+
+/**
+ * @brief MemoryBudget::setGlMemory Report memory of GL buffers and textures.
+ * Called in GL context thread.
+ * @param size Size in bytes.
+ */
+void MemoryBudget::setGlMemory(long long size)
+{
+    m_glMemory = size;
+}
+
+/**
+ * @brief MemoryBudget::enforce Free the oldest cached data if budget is
+ * exceeded. Consumers call it after adding data, out of their locks.
+ */
+void MemoryBudget::enforce()
+{
+    size_t maxSize = m_maxSize;
+    if(maxSize > 0 && size() > maxSize) {
+        trim(maxSize);
+    }
+}
+
+/**
+ * @brief MemoryBudget::onPressure Free cached data on system memory pressure.
+ * Map views drop prefetched tiles on the next draw.
+ * @param level Pressure level.
+ */
+void MemoryBudget::onPressure(enum ngsMemoryPressure level)
+{
+    trim(level == MP_MODERATE ? size() / 2 : 0);
+    m_trimGeneration++;
+}
+
+/**
+ * @brief MemoryBudget::trim Free cached data until used memory is not greater
+ * than target or nothing is left to free. GDAL blocks go first, as they are
+ * not drawn and GDAL frees them in its own LRU order. Then the least recently
+ * drawn items of all consumers are freed.
+ * @param target Memory size in bytes.
+ */
+void MemoryBudget::trim(size_t target)
+{
+    MutexHolder holder(m_mutex);
+    while(size() > target && GDALFlushCacheBlock()) {
+    }
+
+    while(size() > target) {
+        MemoryConsumer *oldest = nullptr;
+        GUIntBig oldestTick = 0;
+        for(MemoryConsumer *consumer : m_consumers) {
+            GUIntBig tick;
+            if(consumer->oldestAccess(tick) &&
+                    (nullptr == oldest || tick < oldestTick)) {
+                oldest = consumer;
+                oldestTick = tick;
+            }
+        }
+
+        if(nullptr == oldest || oldest->freeOldest() == 0) {
+            break;
+        }
+    }
+}
+
+} // namespace ngs
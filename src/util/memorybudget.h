@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSMEMORYBUDGET_H
+#define NGSMEMORYBUDGET_H
+
+// std
+#include <atomic>
+#include <vector>
+
+#include "cpl_port.h"
+
+#include "mutex.h"
+#include "ngstore/codes.h"
+
+namespace ngs {
+
+/**
+ * @brief The MemoryConsumer class Cache which memory is governed by the
+ * MemoryBudget. Consumer registers itself on creation and frees its least
+ * recently used item on request.
+ */
+class MemoryConsumer
+{
+public:
+    virtual ~MemoryConsumer() = default;
+    virtual size_t memoryUsed() const = 0;
+    virtual bool oldestAccess(GUIntBig &tick) const = 0;
+    virtual size_t freeOldest() = 0;
+};
+
+/**
+ * @brief The MemoryBudget class Accounts memory of the library caches and GDAL
+ * block cache and keeps their total within the budget. Budget is read from
+ * "common/memory_budget" setting in megabytes, 0 disables it. GL memory can
+ * only be freed in GL context, so it is reported by the map views, which drop
+ * prefetched tiles if the budget is exceeded or the memory is trimmed.
+ */
+class MemoryBudget
+{
+public:
+    static MemoryBudget &instance();
+    static GUIntBig tick();
+
+public:
+    void addConsumer(MemoryConsumer *consumer);
+    void removeConsumer(MemoryConsumer *consumer);
+    void setMaxSize(size_t size);
+    size_t maxSize() const { return m_maxSize; }
+    size_t size() const;
+    bool isExceeded() const;
+    void setGlMemory(long long size);
+    void enforce();
+    void onPressure(enum ngsMemoryPressure level);
+    void trim(size_t target);
+    unsigned int trimGeneration() const { return m_trimGeneration; }
+
+private:
+    MemoryBudget();
+    ~MemoryBudget() = default;
+    MemoryBudget(MemoryBudget const&) = delete;
+    MemoryBudget &operator= (MemoryBudget const&) = delete;
+
+private:
+    static std::atomic<GUIntBig> m_tick;
+    std::vector<MemoryConsumer*> m_consumers;
+    std::atomic<size_t> m_maxSize;
+    std::atomic<long long> m_glMemory;
+    std::atomic<unsigned int> m_trimGeneration;
+    mutable Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSMEMORYBUDGET_H
@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSMPSCQUEUE_H
+#define NGSMPSCQUEUE_H
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace ngs {
+
+/**
+ * @brief The MpscQueue class Lock-free multiple producers single consumer
+ * queue. Producers push items to the intrusive stack by compare and swap, the
+ * consumer takes the whole stack at once and visits items in push order. As the
+ * consumer never takes single nodes, the stack has no ABA problem.
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : m_head(nullptr) {}
+    ~MpscQueue() { clear(); }
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    /**
+     * @brief push Add item to the queue. May be run from any thread.
+     * @param value Item to add
+     */
+    void push(T value) {
+        Node *node = new Node(std::move(value));
+        node->next = m_head.load(std::memory_order_relaxed);
+        while(!m_head.compare_exchange_weak(node->next, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @brief drain Take all queued items and pass them to the function in push
+     * order. Must be run from the consumer thread only.
+     * @param func Function taking T& argument
+     * @return Taken items count
+     */
+    template<typename Func>
+    size_t drain(Func func) {
+        Node *node = m_head.exchange(nullptr, std::memory_order_acquire);
+        Node *ordered = nullptr;
+        while(nullptr != node) {
+            Node *next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+
+        size_t count = 0;
+        while(nullptr != ordered) {
+            Node *next = ordered->next;
+            func(ordered->value);
+            delete ordered;
+            ordered = next;
+            ++count;
+        }
+        return count;
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == nullptr;
+    }
+
+    void clear() { drain([](T &) {}); }
+
+private:
+    typedef struct _node {
+        explicit _node(T &&item) : value(std::move(item)), next(nullptr) {}
+        T value;
+        struct _node *next;
+    } Node;
+
+private:
+    std::atomic<Node*> m_head;
+};
+
+} // namespace ngs
+
+#endif // NGSMPSCQUEUE_H
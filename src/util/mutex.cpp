@@ -20,6 +20,12 @@
  ****************************************************************************/
 #include "mutex.h"
 
+// std
+#include <chrono>
+#include <thread>
+
+#include "cpl_error.h"
+
 namespace ngs {
 
 Mutex::Mutex() : m_mutex(CPLCreateMutex())
@@ -53,4 +59,207 @@ MutexHolder::~MutexHolder()
     m_mutex.release();
 }
 
+//------------------------------------------------------------------------------
+// SharedMutex
+//------------------------------------------------------------------------------
+
+constexpr int SPIN_TRIES = 64;
+
+static GUIntBig waitTimeSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<GUIntBig>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+}
+
+static std::chrono::steady_clock::time_point deadline(double timeout)
+{
+    return std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(timeout));
+}
+
+SharedMutex::SharedMutex() :
+    m_readers(0),
+    m_waitingWriters(0),
+    m_writer(false),
+    m_acquired(0),
+    m_contended(0),
+    m_waitTime(0)
+{
+}
+
+/**
+ * @brief SharedMutex::acquire Lock for write.
+ * @param timeout Wait time in seconds.
+ * @return False on timeout.
+ */
+bool SharedMutex::acquire(double timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_acquired++;
+    if(!m_writer && m_readers == 0) {
+        m_writer = true;
+        return true;
+    }
+
+    m_contended++;
+    auto start = std::chrono::steady_clock::now();
+    m_waitingWriters++;
+    bool result = m_writersCond.wait_until(lock, deadline(timeout), [this]() {
+        return !m_writer && m_readers == 0;
+    });
+    m_waitingWriters--;
+    m_waitTime += waitTimeSince(start);
+    if(result) {
+        m_writer = true;
+    }
+    else if(m_waitingWriters == 0 && !m_writer) {
+        m_readersCond.notify_all();
+    }
+    return result;
+}
+
+void SharedMutex::release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_writer = false;
+    if(m_waitingWriters > 0) {
+        m_writersCond.notify_one();
+    }
+    m_readersCond.notify_all();
+}
+
+/**
+ * @brief SharedMutex::acquireShared Lock for read.
+ * @param timeout Wait time in seconds.
+ * @return False on timeout.
+ */
+bool SharedMutex::acquireShared(double timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_acquired++;
+    if(!m_writer && m_waitingWriters == 0) {
+        m_readers++;
+        return true;
+    }
+
+    m_contended++;
+    auto start = std::chrono::steady_clock::now();
+    bool result = m_readersCond.wait_until(lock, deadline(timeout), [this]() {
+        return !m_writer && m_waitingWriters == 0;
+    });
+    m_waitTime += waitTimeSince(start);
+    if(result) {
+        m_readers++;
+    }
+    return result;
+}
+
+void SharedMutex::releaseShared()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(--m_readers == 0 && m_waitingWriters > 0) {
+        m_writersCond.notify_one();
+    }
+}
+
+LockStats SharedMutex::stats() const
+{
+    return {m_acquired.load(), m_contended.load(), m_waitTime.load()};
+}
+
+void SharedMutex::resetStats()
+{
+    m_acquired = 0;
+    m_contended = 0;
+    m_waitTime = 0;
+}
+
+ExclusiveHolder::ExclusiveHolder(const SharedMutex &mutex, double timeout) :
+    m_mutex(const_cast<SharedMutex &>(mutex))
+{
+    m_locked = m_mutex.acquire(timeout);
+    if(!m_locked) {
+        CPLDebug("ngstore", "Write lock wait timeout %f sec", timeout);
+    }
+}
+
+ExclusiveHolder::~ExclusiveHolder()
+{
+    if(m_locked) {
+        m_mutex.release();
+    }
+}
+
+SharedHolder::SharedHolder(const SharedMutex &mutex, double timeout) :
+    m_mutex(const_cast<SharedMutex &>(mutex))
+{
+    m_locked = m_mutex.acquireShared(timeout);
+    if(!m_locked) {
+        CPLDebug("ngstore", "Read lock wait timeout %f sec", timeout);
+    }
+}
+
+SharedHolder::~SharedHolder()
+{
+    if(m_locked) {
+        m_mutex.releaseShared();
+    }
+}
+
+//------------------------------------------------------------------------------
+// SpinLock
+//------------------------------------------------------------------------------
+
+SpinLock::SpinLock() :
+    m_acquired(0),
+    m_contended(0),
+    m_waitTime(0)
+{
+    m_flag.clear();
+}
+
+void SpinLock::acquire()
+{
+    m_acquired.fetch_add(1, std::memory_order_relaxed);
+    if(!m_flag.test_and_set(std::memory_order_acquire)) {
+        return;
+    }
+
+    m_contended.fetch_add(1, std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    int tries = 0;
+    while(m_flag.test_and_set(std::memory_order_acquire)) {
+        if(++tries >= SPIN_TRIES) {
+            tries = 0;
+            std::this_thread::yield();
+        }
+    }
+    m_waitTime.fetch_add(waitTimeSince(start), std::memory_order_relaxed);
+}
+
+LockStats SpinLock::stats() const
+{
+    return {m_acquired.load(), m_contended.load(), m_waitTime.load()};
+}
+
+void SpinLock::resetStats()
+{
+    m_acquired = 0;
+    m_contended = 0;
+    m_waitTime = 0;
+}
+
+SpinLockHolder::SpinLockHolder(const SpinLock &lock) :
+    m_lock(const_cast<SpinLock &>(lock))
+{
+    m_lock.acquire();
+}
+
+SpinLockHolder::~SpinLockHolder()
+{
+    m_lock.release();
+}
+
 }
@@ -21,6 +21,11 @@
 #ifndef NGSMUTEX_H
 #define NGSMUTEX_H
 
+// std
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 #include "cpl_multiproc.h"
 
 namespace ngs {
@@ -51,6 +56,105 @@ protected:
     Mutex &m_mutex;
 };
 
+/**
+ * @brief The LockStats struct Lock contention counters for profiling. Wait
+ * time is in microseconds.
+ */
+typedef struct _lockStats {
+    GUIntBig acquired;
+    GUIntBig contended;
+    GUIntBig waitTime;
+} LockStats;
+
+/**
+ * @brief The SharedMutex class Reader-writer lock for read-mostly data. Many
+ * readers may hold the lock at once, a writer holds it alone. Waiting writer
+ * blocks new readers, so render thread reads do not starve fill writes.
+ */
+class SharedMutex {
+public:
+    SharedMutex();
+    bool acquire(double timeout = 1000.0);
+    void release();
+    bool acquireShared(double timeout = 1000.0);
+    void releaseShared();
+    LockStats stats() const;
+    void resetStats();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_readersCond, m_writersCond;
+    unsigned int m_readers, m_waitingWriters;
+    bool m_writer;
+    std::atomic<GUIntBig> m_acquired, m_contended, m_waitTime;
+};
+
+/**
+ * @brief The ExclusiveHolder class Holds shared mutex for write. If lock was
+ * not acquired in timeout the data is accessed unlocked as with MutexHolder.
+ */
+class ExclusiveHolder
+{
+public:
+    ExclusiveHolder(const SharedMutex &mutex, double timeout = 1000.0);
+    ~ExclusiveHolder();
+    ExclusiveHolder(const ExclusiveHolder &) = delete;
+    ExclusiveHolder &operator=(const ExclusiveHolder &) = delete;
+
+protected:
+    SharedMutex &m_mutex;
+    bool m_locked;
+};
+
+/**
+ * @brief The SharedHolder class Holds shared mutex for read.
+ */
+class SharedHolder
+{
+public:
+    SharedHolder(const SharedMutex &mutex, double timeout = 1000.0);
+    ~SharedHolder();
+    SharedHolder(const SharedHolder &) = delete;
+    SharedHolder &operator=(const SharedHolder &) = delete;
+
+protected:
+    SharedMutex &m_mutex;
+    bool m_locked;
+};
+
+/**
+ * @brief The SpinLock class Busy wait lock for critical sections of a few
+ * instructions. Yields the thread if the lock is not released after several
+ * tries.
+ */
+class SpinLock {
+public:
+    SpinLock();
+    void acquire();
+    void release() { m_flag.clear(std::memory_order_release); }
+    LockStats stats() const;
+    void resetStats();
+
+private:
+    std::atomic_flag m_flag;
+    std::atomic<GUIntBig> m_acquired, m_contended, m_waitTime;
+};
+
+/**
+ * @brief The SpinLockHolder class
+ */
+class SpinLockHolder
+{
+public:
+    explicit SpinLockHolder(const SpinLock &lock);
+    ~SpinLockHolder();
+    SpinLockHolder(const SpinLockHolder &) = delete;
+    SpinLockHolder &operator=(const SpinLockHolder &) = delete;
+
+protected:
+    SpinLock &m_lock;
+};
+
 
 }
 
@@ -20,43 +20,269 @@
  ****************************************************************************/
 #include "notify.h"
 
+// std
+#include <algorithm>
+#include <cstdlib>
+
 namespace ngs {
 
+constexpr const char *FEATURE_SEPARATOR = "#";
+// Time to collect events of a burst before dispatch, in seconds
+constexpr double NOTIFY_COALESCE_TIME = 0.02;
+constexpr double NOTIFY_FLUSH_WAIT = 0.1;
+
+static bool isFeatureEvent(enum ngsChangeCode operation)
+{
+    return operation == CC_CREATE_FEATURE || operation == CC_CHANGE_FEATURE ||
+            operation == CC_DELETE_FEATURE;
+}
+
+/**
+ * @brief splitFeatureUri Split feature uri to the table path and feature id.
+ * @param uri Uri as [table path]#[feature id].
+ * @param table Table path.
+ * @param id Feature id.
+ * @return False if uri is not a feature uri.
+ */
+static bool splitFeatureUri(const std::string &uri, std::string &table,
+                            GIntBig &id)
+{
+    size_t pos = uri.rfind(FEATURE_SEPARATOR);
+    if(pos == std::string::npos || pos + 1 >= uri.size()) {
+        return false;
+    }
+    const char *idStr = uri.c_str() + pos + 1;
+    char *end = nullptr;
+    id = std::strtoll(idStr, &end, 10);
+    if(nullptr == end || *end != '\0' || end == idStr) {
+        return false;
+    }
+    table = uri.substr(0, pos);
+    return true;
+}
+
 Notify &Notify::instance()
 {
     static Notify n;
     return n;
 }
 
-void Notify::addNotifyReceiver(ngsNotifyFunc function, int notifyTypes)
+Notify::Notify() :
+    m_mutex(CPLCreateMutex()),
+    m_cond(CPLCreateCond()),
+    m_thread(nullptr),
+    m_stop(false),
+    m_dispatching(false),
+    m_dispatcherId(0)
 {
-    for(auto it = m_notifyReceivers.begin(); it != m_notifyReceivers.end(); ++it) {
-        if((*it).notifyFunc == function) {
-            (*it).notifyTypes = notifyTypes;
-            return;
-        }
+    // CPLCreateMutex returns acquired mutex
+    CPLReleaseMutex(m_mutex);
+}
+
+Notify::~Notify()
+{
+    stop();
+    CPLDestroyCond(m_cond);
+    CPLDestroyMutex(m_mutex);
+}
+
+/**
+ * @brief Notify::addNotifyReceiver Add or update receiver.
+ * @param function Receiver function.
+ * @param notifyTypes The OR combination of ngsChangeCode.
+ * @param synchronous If true, function is called from the thread made the
+ * change for each event. Otherwise it is called from the dispatcher thread
+ * and subsequent feature events of one table come as one event with uri
+ * [table path]#[min feature id]-[max feature id].
+ */
+void Notify::addNotifyReceiver(ngsNotifyFunc function, int notifyTypes,
+                               bool synchronous)
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    auto it = std::find_if(m_notifyReceivers.begin(), m_notifyReceivers.end(),
+                           [function](const notifyData &data) {
+        return data.notifyFunc == function;
+    });
+    if(it != m_notifyReceivers.end()) {
+        (*it).notifyTypes = notifyTypes;
+        (*it).synchronous = synchronous;
+    }
+    else {
+        m_notifyReceivers.push_back({function, notifyTypes, synchronous});
     }
-    m_notifyReceivers.push_back({function, notifyTypes});
+    CPLReleaseMutex(m_mutex);
 }
 
+/**
+ * @brief Notify::deleteNotifyReceiver Delete receiver. The dispatcher calls
+ * receivers outside the lock, so wait until the events being dispatched are
+ * done. After return the function is not called any more, unless deleted by
+ * the receiver itself.
+ * @param function Receiver function.
+ */
 void Notify::deleteNotifyReceiver(ngsNotifyFunc function)
 {
+    CPLAcquireMutex(m_mutex, 1000.0);
     for(auto it = m_notifyReceivers.begin(); it != m_notifyReceivers.end(); ++it) {
         if((*it).notifyFunc == function) {
             m_notifyReceivers.erase(it);
+            break;
+        }
+    }
+    if(m_dispatcherId != CPLGetPID()) {
+        while(m_dispatching) {
+            CPLCondTimedWait(m_cond, m_mutex, NOTIFY_FLUSH_WAIT);
+        }
+    }
+    CPLReleaseMutex(m_mutex);
+}
+
+void Notify::onNotify(const std::string &uri, ngsChangeCode operation)
+{
+    std::vector<ngsNotifyFunc> syncFuncs;
+    bool async = false;
+    CPLAcquireMutex(m_mutex, 1000.0);
+    for(const notifyData &data : m_notifyReceivers) {
+        if(!(data.notifyTypes & operation)) {
+            continue;
+        }
+        if(data.synchronous) {
+            syncFuncs.push_back(data.notifyFunc);
+        }
+        else {
+            async = true;
+        }
+    }
+    if(async) {
+        enqueue(uri, operation);
+    }
+    CPLReleaseMutex(m_mutex);
+
+    for(ngsNotifyFunc func : syncFuncs) {
+        func(uri.c_str(), operation);
+    }
+}
+
+/**
+ * @brief Notify::enqueue Add event to the queue or merge it to the last one.
+ * Only the last event is merged to keep events order. Mutex must be acquired.
+ */
+void Notify::enqueue(const std::string &uri, ngsChangeCode operation)
+{
+    std::string table;
+    GIntBig id = 0;
+    bool featureEvent = isFeatureEvent(operation) &&
+            splitFeatureUri(uri, table, id);
+    if(featureEvent && !m_events.empty()) {
+        NotifyEvent &last = m_events.back();
+        if(last.count > 0 && last.operation == operation && last.table == table) {
+            last.minId = std::min(last.minId, id);
+            last.maxId = std::max(last.maxId, id);
+            last.count++;
             return;
         }
     }
+
+    m_events.push_back({uri, operation, table, id, id, featureEvent ? 1u : 0u});
+
+    if(nullptr == m_thread && !m_stop) {
+        m_thread = CPLCreateJoinableThread(dispatchThread, this);
+    }
+    CPLCondSignal(m_cond);
 }
 
-void Notify::onNotify(const std::string &uri, ngsChangeCode operation) const
+void Notify::dispatch(const NotifyEvent &event)
 {
-    for(auto it = m_notifyReceivers.begin(); it != m_notifyReceivers.end(); ++it) {
-        if((*it).notifyTypes & operation) {
-            (*it).notifyFunc(uri.c_str(), operation);
+    std::string uri = event.uri;
+    if(event.count > 1) {
+        uri = event.table + FEATURE_SEPARATOR + std::to_string(event.minId) +
+                "-" + std::to_string(event.maxId);
+    }
+
+    CPLAcquireMutex(m_mutex, 1000.0);
+    std::vector<ngsNotifyFunc> funcs;
+    for(const notifyData &data : m_notifyReceivers) {
+        if(!data.synchronous && (data.notifyTypes & event.operation)) {
+            funcs.push_back(data.notifyFunc);
         }
     }
+    CPLReleaseMutex(m_mutex);
+
+    for(ngsNotifyFunc func : funcs) {
+        func(uri.c_str(), event.operation);
+    }
 }
 
+void Notify::dispatchThread(void *data)
+{
+    Notify *notify = static_cast<Notify*>(data);
+    CPLAcquireMutex(notify->m_mutex, 1000.0);
+    notify->m_dispatcherId = CPLGetPID();
+    while(true) {
+        if(notify->m_events.empty()) {
+            if(notify->m_stop) {
+                break;
+            }
+            CPLCondWait(notify->m_cond, notify->m_mutex);
+            continue;
+        }
+
+        if(!notify->m_stop) {
+            // Let the burst come to the queue
+            CPLCondTimedWait(notify->m_cond, notify->m_mutex,
+                             NOTIFY_COALESCE_TIME);
+        }
+
+        std::deque<NotifyEvent> events;
+        events.swap(notify->m_events);
+        notify->m_dispatching = true;
+        CPLReleaseMutex(notify->m_mutex);
+
+        for(const NotifyEvent &event : events) {
+            notify->dispatch(event);
+        }
+
+        CPLAcquireMutex(notify->m_mutex, 1000.0);
+        notify->m_dispatching = false;
+        CPLCondBroadcast(notify->m_cond);
+    }
+    CPLReleaseMutex(notify->m_mutex);
+}
+
+/**
+ * @brief Notify::flush Wait until queued events are dispatched. Must not be
+ * called from the receiver.
+ */
+void Notify::flush()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    while(nullptr != m_thread && (!m_events.empty() || m_dispatching)) {
+        CPLCondTimedWait(m_cond, m_mutex, NOTIFY_FLUSH_WAIT);
+    }
+    CPLReleaseMutex(m_mutex);
+}
+
+/**
+ * @brief Notify::stop Dispatch queued events and stop the dispatcher thread.
+ * The thread is started again by the next event.
+ */
+void Notify::stop()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    m_stop = true;
+    CPLJoinableThread *thread = m_thread;
+    CPLCondBroadcast(m_cond);
+    CPLReleaseMutex(m_mutex);
+
+    if(nullptr != thread) {
+        CPLJoinThread(thread);
+    }
+
+    CPLAcquireMutex(m_mutex, 1000.0);
+    m_thread = nullptr;
+    m_dispatcherId = 0;
+    m_stop = false;
+    CPLReleaseMutex(m_mutex);
+}
 
 }
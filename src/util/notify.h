@@ -21,16 +21,22 @@
 #ifndef NGSNOTIFY_H
 #define NGSNOTIFY_H
 
+// std
+#include <deque>
 #include <string>
 #include <vector>
 
+#include "cpl_multiproc.h"
+
 #include "ngstore/api.h"
 
 namespace ngs {
 
 /**
  * @brief The Notify class to subscribe/unsubscribe to various library
- * notifications.
+ * notifications. Asynchronous receivers are called from the dispatcher thread,
+ * subsequent feature events of one table are coalesced there into one event.
+ * Synchronous receivers are called from the thread made the change.
  */
 class Notify
 {
@@ -38,13 +44,16 @@ public:
     static Notify& instance();
 
 public:
-    void addNotifyReceiver(ngsNotifyFunc function, int notifyTypes);
+    void addNotifyReceiver(ngsNotifyFunc function, int notifyTypes,
+                           bool synchronous = false);
     void deleteNotifyReceiver(ngsNotifyFunc function);
-    void onNotify(const std::string &uri, enum ngsChangeCode operation) const;
+    void onNotify(const std::string &uri, enum ngsChangeCode operation);
+    void flush();
+    void stop();
 
 private:
-    Notify() = default;
-    ~Notify() = default;
+    Notify();
+    ~Notify();
     Notify(Notify const&) = delete;
     Notify& operator= (Notify const&) = delete;
 
@@ -52,9 +61,33 @@ private:
     typedef struct _notifyData {
         ngsNotifyFunc notifyFunc;
         int notifyTypes;
+        bool synchronous;
     } notifyData;
 
+    typedef struct _notifyEvent {
+        std::string uri;
+        enum ngsChangeCode operation;
+        // Coalesced feature events: table path and feature ids range
+        std::string table;
+        GIntBig minId;
+        GIntBig maxId;
+        size_t count;
+    } NotifyEvent;
+
+private:
+    void enqueue(const std::string &uri, enum ngsChangeCode operation);
+    void dispatch(const NotifyEvent &event);
+    static void dispatchThread(void *data);
+
+private:
     std::vector<notifyData> m_notifyReceivers;
+    std::deque<NotifyEvent> m_events;
+    CPLMutex *m_mutex;
+    CPLCond *m_cond;
+    CPLJoinableThread *m_thread;
+    bool m_stop;
+    bool m_dispatching;
+    GIntBig m_dispatcherId;
 };
 
 } // namespace ngs
@@ -20,6 +20,10 @@
  ****************************************************************************/
 #include "options.h"
 
+// std
+#include <cstdlib>
+#include <stdexcept>
+
 #include "stringutil.h"
 
 #include "cpl_multiproc.h"
@@ -29,6 +33,20 @@ namespace ngs {
 
 constexpr short MAX_OPTION_LEN = 255;
 
+static OptionValue optionValue(const std::string &text)
+{
+    OptionValue out;
+    out.text = text;
+    out.number = std::strtol(text.c_str(), nullptr, 10);
+    out.real = CPLAtofM(text.c_str());
+    out.flag = !(text.empty() || compare(text, "OFF") ||
+                 compare(text, "FALSE") || compare(text, "NO") ||
+                 compare(text, "0"));
+    return out;
+}
+
+static const OptionsMap gEmptyOptions;
+
 Options::Options(char **options)
 {
     if(nullptr != options) {
@@ -44,78 +62,95 @@ Options::Options(char **options)
                 }
                 key += option[j];
             }
-            m_options[key] = value;
+            add(key, value);
             i++;
         }
     }
 }
 
+const OptionValue *Options::find(const std::string &key) const
+{
+    if(!m_options) {
+        return nullptr;
+    }
+    auto it = m_options->find(key);
+    if(it == m_options->end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+/**
+ * @brief Options::edit Options map to change. The map shared with other copies
+ * is copied first.
+ * @return Options map.
+ */
+OptionsMap &Options::edit()
+{
+    if(!m_options) {
+        m_options = std::make_shared<OptionsMap>();
+    }
+    else if(m_options.use_count() > 1) {
+        m_options = std::make_shared<OptionsMap>(*m_options);
+    }
+    return *m_options;
+}
+
 std::string Options::asString(const std::string &key,
                               const std::string &defaultOption) const
 {
-    auto it = m_options.find(key);
-    if(it == m_options.end())
+    const OptionValue *value = find(key);
+    if(nullptr == value)
         return defaultOption;
-    return it->second;
+    return value->text;
 }
 
 bool Options::asBool(const std::string &key, bool defaultOption) const
 {
-    auto it = m_options.find(key);
-    if(it == m_options.end())
+    const OptionValue *value = find(key);
+    if(nullptr == value)
         return defaultOption;
-
-    if(it->second.empty())
-        return false;
-    else if(compare(it->second, "OFF"))
-        return false;
-    else if(compare(it->second, "FALSE"))
-        return false;
-    else if(compare(it->second, "NO"))
-        return false;
-    else if(compare(it->second, "0"))
-        return false;
-    return true;
+    return value->flag;
 }
 
 int Options::asInt(const std::string &key, int defaultOption) const
 {
-    auto it = m_options.find(key);
-    if(it == m_options.end())
+    const OptionValue *value = find(key);
+    if(nullptr == value)
         return defaultOption;
-    return std::stoi(it->second);
+    return static_cast<int>(value->number);
 }
 
 long Options::asLong(const std::string &key, long defaultOption) const
 {
-    auto it = m_options.find(key);
-    if(it == m_options.end())
+    const OptionValue *value = find(key);
+    if(nullptr == value)
         return defaultOption;
-    return std::stol(it->second);
+    return value->number;
 }
 
 double Options::asDouble(const std::string &key, double defaultOption) const
 {
-    auto it = m_options.find(key);
-    if(it == m_options.end())
+    const OptionValue *value = find(key);
+    if(nullptr == value)
         return defaultOption;
-    return CPLAtofM(it->second.c_str());
+    return value->real;
 }
 
 CPLStringList Options::asCPLStringList() const
 {
     CPLStringList out;
-    for(auto pair : m_options) {
-        out.AddNameValue(pair.first.c_str(), pair.second.c_str());
+    for(const auto &pair : *this) {
+        out.AddNameValue(pair.first.c_str(), pair.second.text.c_str());
     }
     return out;
 }
 
 void Options::remove(const std::string &key)
 {
-    auto it = m_options.find(key);
-    if(it != m_options.end())
-        m_options.erase(it);
+    if(nullptr == find(key))
+        return;
+    edit().erase(key);
 }
 
 unsigned char getNumberThreads()
@@ -138,58 +173,67 @@ unsigned char getNumberThreads()
 
 void Options::add(const std::string &key, const std::string &value)
 {
-    m_options[key] = value;
+    edit()[key] = optionValue(value);
 }
 
 void Options::add(const std::string &key, const char *value)
 {
-    m_options[key] = value;
+    add(key, std::string(value));
 }
 
 void Options::add(const std::string &key, long value)
 {
-    m_options[key] = std::to_string(value);
+    add(key, std::to_string(value));
 }
 
 void Options::add(const std::string &key, GIntBig value)
 {
-    m_options[key] = std::to_string(value);
+    add(key, std::to_string(value));
 }
 
 void Options::add(const std::string &key, bool value)
 {
-    m_options[key] = value ? "YES" : "NO";
+    add(key, std::string(value ? "YES" : "NO"));
 }
 
 bool  Options::empty() const
 {
-    return m_options.empty();
+    return !m_options || m_options->empty();
 }
 
-std::map< std::string, std::string >::const_iterator  Options::begin() const
+OptionsMap::const_iterator Options::begin() const
 {
-    return m_options.begin();
+    return m_options ? m_options->cbegin() : gEmptyOptions.cbegin();
 }
 
-std::map< std::string, std::string >::const_iterator  Options::end() const
+OptionsMap::const_iterator Options::end() const
 {
-    return m_options.end();
+    return m_options ? m_options->cend() : gEmptyOptions.cend();
 }
 
 void Options::append(const Options &other)
 {
-    m_options.insert(other.m_options.begin(), other.m_options.end());
+    if(other.empty()) {
+        return;
+    }
+    if(empty()) {
+        m_options = other.m_options;
+        return;
+    }
+    edit().insert(other.begin(), other.end());
 }
 
 std::string Options::operator[](std::string key) const
 {
-    return m_options.at(key);
+    const OptionValue *value = find(key);
+    if(nullptr == value)
+        throw std::out_of_range(key);
+    return value->text;
 }
 
 bool Options::hasKey(const std::string &key) const
 {
-    return m_options.count(key) > 0;
+    return nullptr != find(key);
 }
 
 }
-
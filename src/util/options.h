@@ -31,6 +31,24 @@
 
 namespace ngs {
 
+/**
+ * @brief The OptionValue struct Option text with the values parsed once on
+ * option add.
+ */
+typedef struct _optionValue {
+    std::string text;
+    long number;
+    double real;
+    bool flag;
+} OptionValue;
+
+using OptionsMap = std::map<std::string, OptionValue>;
+
+/**
+ * @brief The Options class Key-value options. Copies share the options until
+ * one of them is changed, so options are cheap to pass by value to threads and
+ * jobs. Typed getters return values parsed on add and do not allocate.
+ */
 class Options
 {
 public:
@@ -52,8 +70,8 @@ public:
     void add(const std::string &key, bool value);
     void remove(const std::string &key);
     bool empty() const;
-    std::map< std::string, std::string >::const_iterator begin() const;
-    std::map< std::string, std::string >::const_iterator end() const;
+    OptionsMap::const_iterator begin() const;
+    OptionsMap::const_iterator end() const;
 
     void append(const Options &other);
     std::string operator[](std::string key) const;
@@ -61,7 +79,11 @@ public:
     bool hasKey(const std::string &key) const;
 
 protected:
-    std::map<std::string, std::string> m_options;
+    const OptionValue *find(const std::string &key) const;
+    OptionsMap &edit();
+
+protected:
+    std::shared_ptr<OptionsMap> m_options;
 };
 
 unsigned char getNumberThreads();
@@ -20,17 +20,62 @@
  ****************************************************************************/
 #include "util/progress.h"
 
+// std
+#include <chrono>
+#include <cmath>
+
 #include "cpl_string.h"
 
 namespace ngs {
 
+// Complete change in 1/10000 to execute the callback
+constexpr int PROGRESS_COMPLETE_STEP = 100;
+constexpr long long PROGRESS_TIME_STEP = 250; // ms
+constexpr double PROGRESS_COMPLETE_SCALE = 10000.0;
+
+static long long progressTime()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 Progress::Progress(ngsProgressFunc progressFunc, void *progressArguments ) :
     m_progressFunc(progressFunc),
     m_progressArguments(progressArguments),
     m_totalSteps(1),
     m_step(0)
 {
+    if(nullptr != m_progressFunc) {
+        m_state = std::make_shared<ProgressState>();
+        m_state->canceled = false;
+        m_state->lastComplete = -PROGRESS_COMPLETE_STEP;
+        m_state->lastTime = 0;
+    }
+}
 
+/**
+ * @brief Progress::skipProgress Check if in process message should be
+ * skipped. Other messages are never skipped.
+ * @param status Message status.
+ * @param complete Overall complete value.
+ * @return True if message should be skipped.
+ */
+bool Progress::skipProgress(ngsCode status, double complete) const
+{
+    int scaled = static_cast<int>(complete * PROGRESS_COMPLETE_SCALE);
+    if(status == COD_IN_PROCESS &&
+            std::abs(scaled - m_state->lastComplete) < PROGRESS_COMPLETE_STEP) {
+        long long now = progressTime();
+        if(now - m_state->lastTime < PROGRESS_TIME_STEP) {
+            return true;
+        }
+        m_state->lastTime = now;
+    }
+    else {
+        m_state->lastTime = progressTime();
+    }
+    m_state->lastComplete = scaled;
+    return false;
 }
 
 bool Progress::onProgress(ngsCode status, double complete,
@@ -39,17 +84,35 @@ bool Progress::onProgress(ngsCode status, double complete,
     if(nullptr == m_progressFunc) {
         return true; // No cancel from user
     }
+
+    double newComplete = complete / m_totalSteps + 1.0 / m_totalSteps * m_step;
+    if(status == COD_FINISHED && newComplete < 1.0) {
+        status = COD_IN_PROCESS;
+    }
+    if(skipProgress(status, newComplete)) {
+        return !m_state->canceled;
+    }
+
     va_list args;
     CPLString message;
     va_start( args, format );
     message.vPrintf( format, args );
     va_end( args );
 
-    double newComplete = complete / m_totalSteps + 1.0 / m_totalSteps * m_step;
-    if(status == COD_FINISHED && newComplete < 1.0) {
-        status = COD_IN_PROCESS;
+    if(m_progressFunc(status, newComplete, message, m_progressArguments) != 1) {
+        m_state->canceled = true;
     }
-    return m_progressFunc(status, newComplete, message, m_progressArguments) == 1;
+    return !m_state->canceled;
+}
+
+/**
+ * @brief Progress::isCanceled Check if the callback canceled the operation
+ * without the callback execution. Cheap enough for the per item check.
+ * @return True if canceled.
+ */
+bool Progress::isCanceled() const
+{
+    return m_state && m_state->canceled;
 }
 
 int WINAPI ngsGDALProgress(double complete, const char *message,  void *progressArg) {
@@ -61,7 +124,8 @@ int WINAPI ngsGDALProgress(double complete, const char *message,  void *progress
     if(complete < 1.0) {
         status = COD_IN_PROCESS;
     }
-    return progress->onProgress(status, complete, message) ? 1 : 0;
+    return progress->onProgress(status, complete, "%s",
+                                nullptr == message ? "" : message) ? 1 : 0;
 }
 
 }
@@ -21,12 +21,20 @@
 #ifndef NGSPROGRESS_H
 #define NGSPROGRESS_H
 
+// std
+#include <atomic>
+#include <memory>
+
 #include "ngstore/api.h"
 
 namespace ngs {
 
 /**
  * @brief The Progress class The class for indication progress of some operation.
+ * In process messages are throttled: the callback is executed if the complete
+ * value changed by 1% or some time passed since the last call. The message is
+ * formatted only for the executed callback. Copies of progress share the
+ * throttle and cancel state.
  */
 class Progress
 {
@@ -37,16 +45,52 @@ public:
     virtual bool onProgress(enum ngsCode status,
                             double complete,
                             const char* format, ...) const;
+    bool isCanceled() const;
 
     virtual void setTotalSteps(unsigned char value) { m_totalSteps = value; }
     virtual void setStep(unsigned char value) { m_step = value; }
     unsigned char totalSteps() const { return m_totalSteps; }
     unsigned char step() const { return m_step; }
+
+protected:
+    bool skipProgress(enum ngsCode status, double complete) const;
+
+protected:
+    typedef struct _progressState {
+        std::atomic<bool> canceled;
+        std::atomic<int> lastComplete;
+        std::atomic<long long> lastTime;
+    } ProgressState;
+
 protected:
     ngsProgressFunc m_progressFunc;
     void *m_progressArguments;
     unsigned char m_totalSteps;
     unsigned char m_step;
+    std::shared_ptr<ProgressState> m_state;
+};
+
+/**
+ * @brief The CancelToken class Cooperative cancel of the long running job.
+ * The token remembers the generation value of the job owner at the job start.
+ * The owner cancels all started jobs by incrementing the generation value.
+ * Default token is never canceled.
+ */
+class CancelToken
+{
+public:
+    CancelToken() : m_generation(nullptr), m_startGeneration(0) {}
+    explicit CancelToken(const volatile int *generation) :
+        m_generation(generation),
+        m_startGeneration(nullptr == generation ? 0 : *generation) {}
+    CancelToken(const volatile int *generation, int startGeneration) :
+        m_generation(generation), m_startGeneration(startGeneration) {}
+    bool isCanceled() const {
+        return nullptr != m_generation && *m_generation != m_startGeneration;
+    }
+protected:
+    const volatile int *m_generation;
+    int m_startGeneration;
 };
 
 #ifdef _WIN32
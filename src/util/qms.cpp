@@ -0,0 +1,464 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author:   Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "api_priv.h"
+#include "qms.h"
+
+// std
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+
+#include "error.h"
+#include "stringutil.h"
+#include "url.h"
+
+#include "catalog/file.h"
+#include "catalog/folder.h"
+#include "ds/coordinatetransformation.h"
+#include "ds/geometry.h"
+
+namespace ngs {
+
+constexpr time_t QMS_REVALIDATE_TIME = 3600; // Seconds
+constexpr const char *QMS_DIR = "qms";
+constexpr const char *QMS_LIST_FILE = "geoservices";
+constexpr const char *QMS_FILE_EXT = "json";
+constexpr const char *ETAG_KEY = "etag";
+constexpr const char *LAST_MODIFIED_KEY = "last_modified";
+constexpr const char *DATA_KEY = "data";
+constexpr int QMS_DEFAULT_LIMIT = 20;
+
+static std::string lowerCase(const std::string &text)
+{
+    std::string out(text);
+    std::transform(out.begin(), out.end(), out.begin(), ::tolower);
+    return out;
+}
+
+/**
+ * @brief extentEnvelope Envelope of geoservice extent or query area in degrees.
+ * @param extent WKT or EWKT geometry. WKT without SRID is in degrees.
+ * @param env Output envelope.
+ * @return False if extent is empty or invalid.
+ */
+static bool extentEnvelope(const std::string &extent, OGREnvelope &env)
+{
+    if(extent.empty()) {
+        return false;
+    }
+
+    std::string wkt(extent);
+    int epsg = 4326;
+    if(STARTS_WITH_CI(wkt.c_str(), "SRID=")) {
+        size_t pos = wkt.find(';');
+        if(pos == std::string::npos) {
+            return false;
+        }
+        epsg = atoi(wkt.substr(5, pos - 5).c_str());
+        wkt = wkt.substr(pos + 1);
+    }
+
+    OGRGeometry *geom = nullptr;
+    if(OGRGeometryFactory::createFromWkt(wkt.c_str(), nullptr, &geom) !=
+            OGRERR_NONE || nullptr == geom) {
+        return false;
+    }
+    GeometryPtr holder(geom);
+
+    if(epsg != 4326) {
+        SpatialReferencePtr srs = SpatialReferencePtr::importFromEPSG(epsg);
+        SpatialReferencePtr wgs84 = SpatialReferencePtr::importFromEPSG(4326);
+        if(!srs || !wgs84) {
+            return false;
+        }
+        geom->assignSpatialReference(srs);
+        if(geom->transformTo(wgs84) != OGRERR_NONE) {
+            return false;
+        }
+    }
+    geom->getEnvelope(&env);
+    return true;
+}
+
+/**
+ * @brief servicesArray Geoservices of the list response. Paginated response
+ * is joined to one array.
+ */
+static CPLJSONArray servicesArray(const CPLJSONObject &root)
+{
+    if(root.GetType() == CPLJSONObject::Type::Array) {
+        return CPLJSONArray(root);
+    }
+
+    CPLJSONArray out;
+    CPLJSONObject page = root;
+    while(page.IsValid()) {
+        CPLJSONArray results = page.GetArray("results");
+        for(int i = 0; i < results.Size(); ++i) {
+            out.Add(results[i]);
+        }
+        std::string next = page.GetString("next");
+        if(next.empty()) {
+            break;
+        }
+        page = http::fetchJson(next);
+    }
+    return out;
+}
+
+/**
+ * @brief intersectSorted Keep values present in both sorted lists.
+ */
+static void intersectSorted(std::vector<size_t> &values,
+                            const std::vector<size_t> &other)
+{
+    std::vector<size_t> out;
+    std::set_intersection(values.begin(), values.end(), other.begin(),
+                          other.end(), std::back_inserter(out));
+    values.swap(out);
+}
+
+//------------------------------------------------------------------------------
+// QMSCatalog
+//------------------------------------------------------------------------------
+
+QMSCatalog::QMSCatalog()
+{
+    const char *settingsPath = CPLGetConfigOption("NGS_SETTINGS_PATH", nullptr);
+    if(nullptr != settingsPath) {
+        m_path = File::formFileName(settingsPath, QMS_DIR, "");
+    }
+    m_list.checkTime = 0;
+}
+
+QMSCatalog &QMSCatalog::instance()
+{
+    static QMSCatalog catalog;
+    return catalog;
+}
+
+/**
+ * @brief QMSCatalog::query Find geoservices in cached catalogue.
+ * @param options Query options, the same as QuickMapServices API has: type,
+ * epsg, cumulative_status, search, intersects_extent, ordering, limit and
+ * offset.
+ * @param out Found geoservices from offset, not more than limit.
+ * @param count Count of all found geoservices.
+ * @return False if catalogue is not cached and the server is not available.
+ */
+bool QMSCatalog::query(const Options &options, std::vector<CPLJSONObject> &out,
+                       int &count)
+{
+    MutexHolder holder(m_mutex);
+    if(!updateServices()) {
+        return false;
+    }
+
+    std::vector<size_t> found = candidates(options);
+
+    std::string search = lowerCase(options.asString("search"));
+    OGREnvelope area;
+    bool hasArea = extentEnvelope(options.asString("intersects_extent"), area);
+    if(!search.empty() || hasArea) {
+        auto it = std::remove_if(found.begin(), found.end(), [&](size_t index) {
+            const Service &service = m_services[index];
+            if(!search.empty() &&
+                    service.text.find(search) == std::string::npos) {
+                return true;
+            }
+            // Geoservice without extent covers the world
+            return hasArea && service.hasExtent &&
+                    !service.extent.Intersects(area);
+        });
+        found.erase(it, found.end());
+    }
+
+    std::string ordering = options.asString("ordering");
+    if(!ordering.empty()) {
+        bool descending = ordering[0] == '-';
+        if(descending) {
+            ordering = ordering.substr(1);
+        }
+        std::stable_sort(found.begin(), found.end(), [&](size_t a, size_t b) {
+            const Service &first = m_services[descending ? b : a];
+            const Service &second = m_services[descending ? a : b];
+            if(ordering == "id") {
+                return first.id < second.id;
+            }
+            if(ordering == "created_at") {
+                return first.createdAt < second.createdAt;
+            }
+            if(ordering == "updated_at") {
+                return first.updatedAt < second.updatedAt;
+            }
+            return first.name < second.name;
+        });
+    }
+
+    count = static_cast<int>(found.size());
+    size_t offset = static_cast<size_t>(std::max(0, options.asInt("offset", 0)));
+    size_t limit = static_cast<size_t>(std::max(0, options.asInt("limit",
+                                                      QMS_DEFAULT_LIMIT)));
+    for(size_t i = offset; i < found.size() && i - offset < limit; ++i) {
+        out.push_back(m_services[found[i]].item);
+    }
+    return true;
+}
+
+/**
+ * @brief QMSCatalog::properties Get geoservice details. Details are cached in
+ * memory and on disk.
+ * @param id Geoservice identifier.
+ * @return Geoservice details or invalid object.
+ */
+CPLJSONObject QMSCatalog::properties(int id)
+{
+    MutexHolder holder(m_mutex);
+    auto it = m_properties.find(id);
+    if(it == m_properties.end()) {
+        it = m_properties.insert(std::make_pair(id, CachedDocument())).first;
+    }
+
+    CachedDocument &document = it->second;
+    std::string path = cachePath(QMS_LIST_FILE + std::string("_") +
+                                 std::to_string(id));
+    if(!document.data.IsValid()) {
+        loadDocument(path, document);
+    }
+
+    bool changed = false;
+    revalidate(std::string(QMS_API_URL) + "geoservices/" + std::to_string(id),
+               document, changed);
+    if(changed) {
+        saveDocument(path, document);
+    }
+    return document.data;
+}
+
+/**
+ * @brief QMSCatalog::clear Drop catalogue from memory and disk.
+ */
+void QMSCatalog::clear()
+{
+    MutexHolder holder(m_mutex);
+    m_list = CachedDocument();
+    m_services.clear();
+    m_typeIndex.clear();
+    m_epsgIndex.clear();
+    m_statusIndex.clear();
+    m_properties.clear();
+    if(!m_path.empty() && Folder::isExists(m_path)) {
+        Folder::rmDir(m_path);
+    }
+}
+
+/**
+ * @brief QMSCatalog::revalidate Download document if it is not cached or
+ * check it is not changed if it was checked long ago.
+ * @param url Document URL.
+ * @param document Cached document.
+ * @param changed Set to true if new document was downloaded.
+ * @return False if document is not cached and the server is not available.
+ */
+bool QMSCatalog::revalidate(const std::string &url, CachedDocument &document,
+                            bool &changed) const
+{
+    changed = false;
+    time_t now = time(nullptr);
+    if(document.data.IsValid() &&
+            now - document.checkTime < QMS_REVALIDATE_TIME) {
+        return true;
+    }
+
+    bool notModified = false;
+    http::HTTPResultPtr result = http::fetchIfModified(url, document.etag,
+                                                       document.lastModified,
+                                                       notModified);
+    if(nullptr == result || result->nStatus != 0 ||
+            result->pszErrBuf != nullptr) {
+        if(!document.data.IsValid()) {
+            outMessage(COD_REQUEST_FAILED, nullptr == result ?
+                           _("Unexpected error") : result->pszErrBuf);
+            return false;
+        }
+        // Offline, do not wait for the server on each call
+        document.checkTime = now;
+        return true;
+    }
+
+    document.checkTime = now;
+    if(notModified && document.data.IsValid()) {
+        return true;
+    }
+
+    CPLJSONDocument doc;
+    if(result->nDataLen == 0 || !doc.LoadMemory(result->pabyData,
+                                                result->nDataLen)) {
+        return document.data.IsValid();
+    }
+
+    document.data = doc.GetRoot();
+    document.etag = fromCString(CSLFetchNameValue(result->papszHeaders, "ETag"));
+    document.lastModified =
+            fromCString(CSLFetchNameValue(result->papszHeaders, "Last-Modified"));
+    changed = true;
+    return true;
+}
+
+/**
+ * @brief QMSCatalog::updateServices Load geoservices list from disk on first
+ * call and revalidate it. Index is rebuilt if the list changed.
+ * @return False if the list is not available.
+ */
+bool QMSCatalog::updateServices()
+{
+    std::string path = cachePath(QMS_LIST_FILE);
+    bool loaded = false;
+    if(!m_list.data.IsValid()) {
+        loaded = loadDocument(path, m_list);
+    }
+
+    bool changed = false;
+    if(!revalidate(std::string(QMS_API_URL) + "geoservices/", m_list,
+                   changed)) {
+        return false;
+    }
+
+    if(changed) {
+        m_list.data = servicesArray(m_list.data);
+        saveDocument(path, m_list);
+    }
+
+    if(loaded || changed) {
+        indexServices(CPLJSONArray(m_list.data));
+    }
+    return true;
+}
+
+void QMSCatalog::indexServices(const CPLJSONArray &services)
+{
+    m_services.clear();
+    m_typeIndex.clear();
+    m_epsgIndex.clear();
+    m_statusIndex.clear();
+
+    for(int i = 0; i < services.Size(); ++i) {
+        CPLJSONObject item = services[i];
+        Service service;
+        service.item = item;
+        service.id = item.GetInteger("id");
+        service.epsg = item.GetInteger("epsg", -1);
+        service.type = lowerCase(item.GetString("type"));
+        service.status = lowerCase(item.GetString("cumulative_status",
+                                                  item.GetString("status")));
+        service.name = lowerCase(item.GetString("name"));
+        service.text = service.name + "\n" + lowerCase(item.GetString("desc"));
+        service.createdAt = item.GetString("created_at");
+        service.updatedAt = item.GetString("updated_at");
+        service.hasExtent = extentEnvelope(item.GetString("extent"),
+                                           service.extent);
+
+        size_t index = m_services.size();
+        m_typeIndex[service.type].push_back(index);
+        m_epsgIndex[service.epsg].push_back(index);
+        m_statusIndex[service.status].push_back(index);
+        m_services.push_back(service);
+    }
+}
+
+/**
+ * @brief QMSCatalog::candidates Geoservices matching type, epsg and status
+ * options found in the index.
+ * @return Sorted geoservice indices.
+ */
+std::vector<size_t> QMSCatalog::candidates(const Options &options) const
+{
+    std::vector<size_t> out(m_services.size());
+    for(size_t i = 0; i < out.size(); ++i) {
+        out[i] = i;
+    }
+
+    std::string type = lowerCase(options.asString("type"));
+    if(!type.empty()) {
+        auto it = m_typeIndex.find(type);
+        intersectSorted(out, it == m_typeIndex.end() ?
+                            std::vector<size_t>() : it->second);
+    }
+
+    std::string epsg = options.asString("epsg");
+    if(!epsg.empty()) {
+        auto it = m_epsgIndex.find(atoi(epsg.c_str()));
+        intersectSorted(out, it == m_epsgIndex.end() ?
+                            std::vector<size_t>() : it->second);
+    }
+
+    std::string status = lowerCase(options.asString("cumulative_status"));
+    if(!status.empty()) {
+        auto it = m_statusIndex.find(status);
+        intersectSorted(out, it == m_statusIndex.end() ?
+                            std::vector<size_t>() : it->second);
+    }
+    return out;
+}
+
+std::string QMSCatalog::cachePath(const std::string &name) const
+{
+    if(m_path.empty()) {
+        return "";
+    }
+    return File::formFileName(m_path, name, QMS_FILE_EXT);
+}
+
+bool QMSCatalog::loadDocument(const std::string &path, CachedDocument &document)
+{
+    if(path.empty() || !Folder::isExists(path)) {
+        return false;
+    }
+
+    CPLJSONDocument doc;
+    if(!doc.Load(path)) {
+        return false;
+    }
+    CPLJSONObject root = doc.GetRoot();
+    document.data = root.GetObj(DATA_KEY);
+    document.etag = root.GetString(ETAG_KEY);
+    document.lastModified = root.GetString(LAST_MODIFIED_KEY);
+    document.checkTime = 0; // Revalidate on first use
+    return document.data.IsValid();
+}
+
+void QMSCatalog::saveDocument(const std::string &path,
+                              const CachedDocument &document)
+{
+    if(path.empty() || !Folder::mkDir(CPLGetPath(path.c_str()), true)) {
+        return;
+    }
+
+    CPLJSONDocument doc;
+    CPLJSONObject root = doc.GetRoot();
+    root.Add(ETAG_KEY, document.etag);
+    root.Add(LAST_MODIFIED_KEY, document.lastModified);
+    root.Add(DATA_KEY, document.data);
+    doc.Save(path);
+}
+
+} // namespace ngs
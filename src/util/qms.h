@@ -0,0 +1,108 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author:   Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#ifndef NGSQMS_H
+#define NGSQMS_H
+
+// std
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cpl_json.h"
+#include "ogr_core.h"
+
+#include "mutex.h"
+#include "options.h"
+
+namespace ngs {
+
+constexpr const char *QMS_API_URL = "https://qms.nextgis.com/api/v1/";
+
+/**
+ * @brief The QMSCatalog class Cached QuickMapServices geoservices catalogue.
+ * The full list of geoservices and the requested geoservice details are stored
+ * in "qms" directory of the settings and are revalidated with ETag or
+ * Last-Modified not often than QMS_REVALIDATE_TIME. If the server is not
+ * available, cached data is used. Queries are filtered by in-memory index of
+ * the list.
+ */
+class QMSCatalog
+{
+public:
+    static QMSCatalog &instance();
+
+public:
+    bool query(const Options &options, std::vector<CPLJSONObject> &out,
+               int &count);
+    CPLJSONObject properties(int id);
+    void clear();
+
+private:
+    QMSCatalog();
+    ~QMSCatalog() = default;
+    QMSCatalog(QMSCatalog const&) = delete;
+    QMSCatalog &operator= (QMSCatalog const&) = delete;
+
+private:
+    typedef struct _service {
+        CPLJSONObject item;
+        int id;
+        int epsg;
+        std::string type, status;
+        std::string name, text; // NOTE: Lower case name and description
+        std::string createdAt, updatedAt;
+        OGREnvelope extent; // NOTE: In degrees
+        bool hasExtent;
+    } Service;
+
+    typedef struct _cachedDocument {
+        CPLJSONObject data;
+        std::string etag, lastModified;
+        time_t checkTime;
+    } CachedDocument;
+
+private:
+    bool revalidate(const std::string &url, CachedDocument &document,
+                    bool &changed) const;
+    bool updateServices();
+    void indexServices(const CPLJSONArray &services);
+    std::vector<size_t> candidates(const Options &options) const;
+    std::string cachePath(const std::string &name) const;
+    static bool loadDocument(const std::string &path, CachedDocument &document);
+    static void saveDocument(const std::string &path,
+                             const CachedDocument &document);
+
+private:
+    std::string m_path;
+    CachedDocument m_list;
+    std::vector<Service> m_services;
+    std::map<std::string, std::vector<size_t>> m_typeIndex;
+    std::map<int, std::vector<size_t>> m_epsgIndex;
+    std::map<std::string, std::vector<size_t>> m_statusIndex;
+    std::map<int, CachedDocument> m_properties;
+    Mutex m_mutex;
+};
+
+} // namespace ngs
+
+#endif // NGSQMS_H
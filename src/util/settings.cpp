@@ -22,6 +22,9 @@
 #include "settings.h"
 #include "stringutil.h"
 
+// std
+#include <chrono>
+
 #include "catalog/file.h"
 #include "catalog/folder.h"
 
@@ -34,6 +37,10 @@ namespace ngs {
 
 constexpr const char *SETTINGS_FILE = "settings";
 constexpr const char *SETTINGS_FILE_EXT = "json";
+// Changes are saved when settings are not changed for this time, in seconds
+constexpr double SETTINGS_SAVE_DELAY = 1.0;
+// Constantly changed settings are saved at least once in this time, in seconds
+constexpr double SETTINGS_MAX_SAVE_DELAY = 5.0;
 
 constexpr const char *HTTP_TIMEOUT = "20";
 constexpr const char *HTTP_CONN_TIMEOUT = "10";
@@ -49,8 +56,17 @@ constexpr const char *CACHEMAX = "4";
 constexpr const char *CACHEMAX = "64";
 #endif
 
-Settings::Settings() : m_hasChanges(false)
+Settings::Settings() :
+    m_saveMutex(CPLCreateMutex()),
+    m_saveCond(CPLCreateCond()),
+    m_saveThread(nullptr),
+    m_changeCount(0),
+    m_hasChanges(false),
+    m_stop(false)
 {
+    // CPLCreateMutex returns acquired mutex
+    CPLReleaseMutex(m_saveMutex);
+
     const char* settingsPath = CPLGetConfigOption("NGS_SETTINGS_PATH", nullptr);
     if(!Folder::isExists(settingsPath)) {
         Folder::mkDir(settingsPath);
@@ -66,7 +82,10 @@ Settings::Settings() : m_hasChanges(false)
 
 Settings::~Settings()
 {
+    stopSaveThread();
     save();
+    CPLDestroyCond(m_saveCond);
+    CPLDestroyMutex(m_saveMutex);
 }
 
 Settings &Settings::instance()
@@ -83,32 +102,56 @@ std::string Settings::getConfigOption(const std::string &key,
 
 void Settings::set(const std::string &path, bool val)
 {
-    m_root.Set(path, val);
-    m_hasChanges = true;
+    {
+        ExclusiveHolder holder(m_cacheMutex);
+        m_root.Set(path, val);
+        resetCache(path);
+    }
+    setChanged();
+
+    if(compare(path, "http/use_gzip")) {
+        CPLSetConfigOption("CPL_CURL_GZIP", val ? "YES" : "NO");
+    }
 }
 
 void Settings::set(const std::string &path, double val)
 {
-    m_root.Set(path, val);
-    m_hasChanges = true;
+    {
+        ExclusiveHolder holder(m_cacheMutex);
+        m_root.Set(path, val);
+        resetCache(path);
+    }
+    setChanged();
 }
 
 void Settings::set(const std::string &path, int val)
 {
-    m_root.Set(path, val);
-    m_hasChanges = true;
+    {
+        ExclusiveHolder holder(m_cacheMutex);
+        m_root.Set(path, val);
+        resetCache(path);
+    }
+    setChanged();
 }
 
 void Settings::set(const std::string &path, long val)
 {
-    m_root.Set(path, static_cast<GInt64>(val));
-    m_hasChanges = true;
+    {
+        ExclusiveHolder holder(m_cacheMutex);
+        m_root.Set(path, static_cast<GInt64>(val));
+        resetCache(path);
+    }
+    setChanged();
 }
 
 void Settings::set(const std::string &path, const std::string &val)
 {
-    m_root.Set(path, val);
-    m_hasChanges = true;
+    {
+        ExclusiveHolder holder(m_cacheMutex);
+        m_root.Set(path, val);
+        resetCache(path);
+    }
+    setChanged();
 
     if(compare(path, "common/cachemax")) {
         CPLSetConfigOption("GDAL_CACHEMAX", val.c_str());
@@ -147,50 +190,215 @@ void Settings::set(const std::string &path, const std::string &val)
     }
 }
 
+/**
+ * @brief Settings::cached Get value from cache. The value is read from JSON
+ * and added to cache on first access. Any set() resets the cache.
+ * @param path Value path
+ * @return Value with exists flag unset if value is absent or null.
+ */
+Settings::CachedValuePtr Settings::cached(const std::string &path) const
+{
+    {
+        SharedHolder holder(m_cacheMutex);
+        auto it = m_cache.find(path);
+        if(it != m_cache.end()) {
+            return it->second;
+        }
+    }
+
+    // Value is read and cached in one lock, so concurrent set() can not be
+    // overwritten by the old value
+    ExclusiveHolder holder(m_cacheMutex);
+    auto it = m_cache.find(path);
+    if(it != m_cache.end()) {
+        return it->second;
+    }
+
+    CPLJSONObject object = m_root.GetObj(path);
+    CachedValue *value = new CachedValue;
+    // Null values return defaults as in CPLJSONObject getters
+    value->exists = nullptr != object.GetInternalHandle();
+    value->text = object.ToString("");
+    value->number = object.ToLong(0);
+    value->real = object.ToDouble(0.0);
+    value->flag = object.ToBool(false);
+    CachedValuePtr out(value);
+    m_cache[path] = out;
+    return out;
+}
+
+/**
+ * @brief Settings::resetCache Remove cached values of the path, its parent
+ * objects and children. Must be called with m_cacheMutex held for write.
+ * @param path Changed value path
+ */
+void Settings::resetCache(const std::string &path)
+{
+    auto it = m_cache.begin();
+    while(it != m_cache.end()) {
+        const std::string &key = it->first;
+        bool related = key == path ||
+                (key.size() > path.size() &&
+                 key.compare(0, path.size(), path) == 0 &&
+                 key[path.size()] == '/') ||
+                (path.size() > key.size() &&
+                 path.compare(0, key.size(), key) == 0 &&
+                 path[key.size()] == '/');
+        if(related) {
+            it = m_cache.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief Settings::setChanged Mark settings changed and wake the save thread.
+ */
+void Settings::setChanged()
+{
+    CPLAcquireMutex(m_saveMutex, 1000.0);
+    m_hasChanges = true;
+    ++m_changeCount;
+    if(nullptr == m_saveThread && !m_stop) {
+        m_saveThread = CPLCreateJoinableThread(saveThread, this);
+    }
+    CPLCondSignal(m_saveCond);
+    CPLReleaseMutex(m_saveMutex);
+}
+
+void Settings::saveThread(void *data)
+{
+    Settings *settings = static_cast<Settings*>(data);
+    CPLAcquireMutex(settings->m_saveMutex, 1000.0);
+    while(!settings->m_stop) {
+        if(!settings->m_hasChanges) {
+            CPLCondWait(settings->m_saveCond, settings->m_saveMutex);
+            continue;
+        }
+
+        // Wait for the burst of changes to end
+        auto start = std::chrono::steady_clock::now();
+        GUIntBig changeCount;
+        do {
+            changeCount = settings->m_changeCount;
+            CPLCondTimedWait(settings->m_saveCond, settings->m_saveMutex,
+                             SETTINGS_SAVE_DELAY);
+        } while(!settings->m_stop && changeCount != settings->m_changeCount &&
+                std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count() <
+                SETTINGS_MAX_SAVE_DELAY);
+
+        if(settings->m_stop) {
+            break; // Saved on stop
+        }
+
+        CPLReleaseMutex(settings->m_saveMutex);
+        settings->save();
+        CPLAcquireMutex(settings->m_saveMutex, 1000.0);
+    }
+    CPLReleaseMutex(settings->m_saveMutex);
+}
+
+void Settings::stopSaveThread()
+{
+    CPLAcquireMutex(m_saveMutex, 1000.0);
+    m_stop = true;
+    CPLJoinableThread *thread = m_saveThread;
+    m_saveThread = nullptr;
+    CPLCondBroadcast(m_saveCond);
+    CPLReleaseMutex(m_saveMutex);
+
+    if(nullptr != thread) {
+        CPLJoinThread(thread);
+    }
+}
+
 bool Settings::getBool(const std::string &path, bool defaultVal) const
 {
-    return m_root.GetBool(path, defaultVal);
+    CachedValuePtr value = cached(path);
+    return value->exists ? value->flag : defaultVal;
 }
 
 double Settings::getDouble(const std::string &path, double defaultVal) const
 {
-    return m_root.GetDouble(path, defaultVal);
+    CachedValuePtr value = cached(path);
+    return value->exists ? value->real : defaultVal;
 }
 
 int Settings::getInteger(const std::string &path, int defaultVal) const
 {
-    return m_root.GetInteger(path, defaultVal);
+    CachedValuePtr value = cached(path);
+    return value->exists ? static_cast<int>(value->number) : defaultVal;
 }
 
 long Settings::getLong(const std::string &path, long defaultVal) const
 {
-    return m_root.GetLong(path, defaultVal);
+    CachedValuePtr value = cached(path);
+    return value->exists ? value->number : defaultVal;
 }
 
 std::string Settings::getString(const std::string &path,
                                 const std::string &defaultVal) const
 {
-    return m_root.GetString(path, defaultVal);
+    CachedValuePtr value = cached(path);
+    return value->exists ? value->text : defaultVal;
 }
 
+/**
+ * @brief Settings::save Write changed settings to file now. Settings are
+ * written to temporary file renamed over the settings file, so the file is
+ * never left partially written.
+ * @return True on success or if there are no changes.
+ */
 bool Settings::save()
 {
-    if(m_hasChanges) {
-        bool result = m_settings.Save(m_path);
-        if(result) {
-            m_hasChanges = false;
-        }
+    MutexHolder writeHolder(m_writeMutex);
+    CPLAcquireMutex(m_saveMutex, 1000.0);
+    bool hasChanges = m_hasChanges;
+    m_hasChanges = false;
+    CPLReleaseMutex(m_saveMutex);
+    if(!hasChanges) {
+        return true;
+    }
+
+    std::string data;
+    {
+        SharedHolder holder(m_cacheMutex);
+        data = m_root.Format(CPLJSONObject::Pretty);
+    }
 
-        return result;
+    if(write(data)) {
+        return true;
     }
-    return true;
+
+    CPLAcquireMutex(m_saveMutex, 1000.0);
+    m_hasChanges = true;
+    CPLReleaseMutex(m_saveMutex);
+    return false;
+}
+
+bool Settings::write(const std::string &data) const
+{
+    return File::replaceFile(m_path, data.data(), data.size());
 }
 
 void Settings::init()
 {
     CPLSetConfigOption("GDAL_CACHEMAX", getString("common/cachemax", CACHEMAX).c_str());
     CPLSetConfigOption("GDAL_HTTP_USERAGENT", getString("http/useragent", NGS_USERAGENT).c_str());
-    CPLSetConfigOption("CPL_CURL_GZIP", getString("http/use_gzip", HTTP_USE_GZIP).c_str());
+    // Curl sends Accept-Encoding and decodes compressed responses on the fly
+    // while receiving, so the response buffer is filled once. The value may
+    // be stored as string or as boolean.
+    CPLJSONObject useGzip = m_root.GetObj("http/use_gzip");
+    if(useGzip.GetType() == CPLJSONObject::Type::Boolean) {
+        CPLSetConfigOption("CPL_CURL_GZIP", useGzip.ToBool() ? "YES" : "NO");
+    }
+    else {
+        CPLSetConfigOption("CPL_CURL_GZIP",
+                           getString("http/use_gzip", HTTP_USE_GZIP).c_str());
+    }
     CPLSetConfigOption("GDAL_HTTP_TIMEOUT", getString("http/timeout", HTTP_TIMEOUT).c_str());
     CPLSetConfigOption("GDAL_DRIVER_PATH", "disabled");
 
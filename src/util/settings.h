@@ -22,13 +22,21 @@
 #ifndef NGSSETTINGS_H
 #define NGSSETTINGS_H
 
+// std
+#include <map>
+#include <memory>
+
 #include "cpl_json.h"
 
+#include "mutex.h"
+
 namespace ngs {
 
 /**
  * @brief The Settings class provides persistent platform-independent library
- * settings.
+ * settings. Changes are written to file by background thread when settings
+ * are not changed for a while, so frequent set() calls do not wait for
+ * storage.
  */
 class Settings
 {
@@ -61,11 +69,40 @@ private:
     Settings &operator= (Settings const&) = delete;
     void init();
 
+    /**
+     * @brief The CachedValue struct Settings value parsed on first access.
+     */
+    typedef struct _cachedValue {
+        bool exists;
+        std::string text;
+        long number;
+        double real;
+        bool flag;
+    } CachedValue;
+    using CachedValuePtr = std::shared_ptr<const CachedValue>;
+    CachedValuePtr cached(const std::string &path) const;
+    void resetCache(const std::string &path);
+    void setChanged();
+    bool write(const std::string &data) const;
+    void stopSaveThread();
+    static void saveThread(void *data);
+
 private:
     CPLJSONDocument m_settings;
     CPLJSONObject m_root;
     std::string m_path;
+    mutable std::map<std::string, CachedValuePtr> m_cache;
+    // Guards m_root and m_cache
+    mutable SharedMutex m_cacheMutex;
+    // Write-behind state, guarded by m_saveMutex
+    CPLMutex *m_saveMutex;
+    CPLCond *m_saveCond;
+    CPLJoinableThread *m_saveThread;
+    GUIntBig m_changeCount;
     bool m_hasChanges;
+    bool m_stop;
+    // Serializes file writes, so older data never replaces newer one
+    Mutex m_writeMutex;
 };
 
 }
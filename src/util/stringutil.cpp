@@ -26,15 +26,18 @@
 #include "cpl_multiproc.h"
 #include "cpl_string.h"
 #include "cpl_vsi.h"
+#include "mutex.h"
 #include "settings.h"
 
 // stl
 #include <algorithm>
+#include <cctype>
 #include <iomanip>
 #include <map>
 #include <set>
 #include <sstream>
 
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/md5.h>
 #include <openssl/rand.h>
@@ -111,45 +114,126 @@ std::vector<std::string> fillStringList(char **strings)
     return out;
 }
 
-bool compare(const std::string &first, const std::string &second,
-             bool caseSensetive)
+/**
+ * @brief foldCase ASCII lower case as EQUAL does. Other bytes, including UTF-8
+ * sequences, are compared as is.
+ */
+static inline unsigned char foldCase(char c)
+{
+    unsigned char out = static_cast<unsigned char>(c);
+    return out >= 'A' && out <= 'Z' ? static_cast<unsigned char>(out + 32) : out;
+}
+
+static int compareChars(const char *first, const char *second, size_t count,
+                        bool caseSensetive)
 {
     if(caseSensetive) {
-        return first == second;
+        return count == 0 ? 0 : std::memcmp(first, second, count);
     }
-    else {
-        return EQUAL(first.c_str(), second.c_str());
+    for(size_t i = 0; i < count; ++i) {
+        unsigned char a = foldCase(first[i]);
+        unsigned char b = foldCase(second[i]);
+        if(a != b) {
+            return a < b ? -1 : 1;
+        }
     }
+    return 0;
 }
 
-bool comparePart(const std::string &first, const std::string &second,
-                 unsigned int count, bool caseSensetive)
+bool compare(StringRef first, StringRef second, bool caseSensetive)
+{
+    return first.size() == second.size() &&
+            compareChars(first.data(), second.data(), first.size(),
+                         caseSensetive) == 0;
+}
+
+bool comparePart(StringRef first, StringRef second, unsigned int count,
+                 bool caseSensetive)
 {
     if(first.size() < count || second.size() < count) {
         return false;
     }
-    if(caseSensetive) {
-        return first.substr(0, count) == second.substr(0, count);
-    }
-    else {
-        return EQUALN(first.c_str(), second.c_str(), count);
-    }
+    return compareChars(first.data(), second.data(), count, caseSensetive) == 0;
 }
 
-bool startsWith(const std::string &str, const std::string &part, bool caseSensetive)
+bool startsWith(StringRef str, StringRef part, bool caseSensetive)
 {
     return comparePart(str, part, static_cast<unsigned>(part.size()), caseSensetive);
 }
 
-bool endsWith(const std::string &str, const std::string &part, bool caseSensetive)
+bool endsWith(StringRef str, StringRef part, bool caseSensetive)
 {
     size_t partLen = part.size();
     size_t strLen = str.size();
     if(strLen < partLen) {
         return false;
     }
-    std::string strCmp = str.substr(strLen - partLen);
-    return compare(strCmp, part, caseSensetive);
+    return compareChars(str.data() + strLen - partLen, part.data(), partLen,
+                        caseSensetive) == 0;
+}
+
+/**
+ * @brief toLower Lower case copy of string with the same case folding as
+ * compare uses. Used to make index keys for case insensitive lookups.
+ * @param str String to convert.
+ * @return Lower case string.
+ */
+std::string toLower(StringRef str)
+{
+    std::string out(str.size(), '\0');
+    for(size_t i = 0; i < str.size(); ++i) {
+        out[i] = static_cast<char>(foldCase(str[i]));
+    }
+    return out;
+}
+
+/**
+ * @brief matchPattern Checks if string matches the wildcard pattern. The
+ * pattern may contain '*' for any characters sequence and '?' for any one
+ * character.
+ * @param str String to check.
+ * @param pattern Wildcard pattern. Empty pattern matches any string.
+ * @param caseSensetive Compare case sensitive or not.
+ * @return true if string matches.
+ */
+bool matchPattern(const std::string &str, const std::string &pattern,
+                  bool caseSensetive)
+{
+    if(pattern.empty()) {
+        return true;
+    }
+
+    auto equalChars = [caseSensetive](char a, char b) {
+        return caseSensetive ? a == b :
+                std::tolower(static_cast<unsigned char>(a)) ==
+                std::tolower(static_cast<unsigned char>(b));
+    };
+
+    size_t s = 0, p = 0;
+    size_t starPos = std::string::npos, matchPos = 0;
+    while(s < str.size()) {
+        if(p < pattern.size() && (pattern[p] == '?' ||
+                                  equalChars(pattern[p], str[s]))) {
+            ++s;
+            ++p;
+        }
+        else if(p < pattern.size() && pattern[p] == '*') {
+            starPos = p++;
+            matchPos = s;
+        }
+        else if(starPos != std::string::npos) {
+            p = starPos + 1;
+            s = ++matchPos;
+        }
+        else {
+            return false;
+        }
+    }
+
+    while(p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
 }
 
 static std::string toHex(unsigned char *value, int size)
@@ -196,15 +280,15 @@ std::string random(int size)
     return toHex(key, size);
 }
 
-int compareStrings(const std::string &first, const std::string &second,
-                   bool caseSensetive)
+int compareStrings(StringRef first, StringRef second, bool caseSensetive)
 {
-    if(caseSensetive) {
-        return first.compare(second);
-    }
-    else {
-        return STRCASECMP(first.c_str(), second.c_str());
+    size_t count = std::min(first.size(), second.size());
+    int result = compareChars(first.data(), second.data(), count,
+                              caseSensetive);
+    if(result != 0 || first.size() == second.size()) {
+        return result;
     }
+    return first.size() < second.size() ? -1 : 1;
 }
 
 std::string fromCString(const char *str)
@@ -218,7 +302,80 @@ std::string fromCString(const char *str)
 using EVP_CIPHER_CTX_free_ptr = std::unique_ptr<EVP_CIPHER_CTX,
     decltype(&::EVP_CIPHER_CTX_free)>;
 
+/**
+ * @brief The CryptState struct Key and IV parsed from hex once and decrypted
+ * secrets of the session. Both are reset if CRYPT_KEY or crypt/iv changes.
+ * Plain text is wiped from memory on reset.
+ */
+typedef struct _cryptState {
+    Mutex mutex;
+    std::string keyHex, ivHex;
+    unsigned char key[KEY_SIZE];
+    unsigned char iv[BLOCK_SIZE];
+    bool valid = false;
+    std::map<std::string, std::string> secrets; // cipher text -> plain text
+} CryptState;
+
+static CryptState &cryptState()
+{
+    static CryptState state;
+    return state;
+}
+
+static void wipe(std::string &str)
+{
+    if(!str.empty()) {
+        OPENSSL_cleanse(&str[0], str.size());
+    }
+}
+
+static void resetSecrets(CryptState &state)
+{
+    for(auto &item : state.secrets) {
+        wipe(item.second);
+    }
+    state.secrets.clear();
+}
+
+static bool parseHex(const std::string &hex, unsigned char *out, int size)
+{
+    int count = 0;
+    GByte *data = CPLHexToBinary(hex.c_str(), &count);
+    bool result = count >= size;
+    if(result) {
+        std::memcpy(out, data, static_cast<size_t>(size));
+    }
+    OPENSSL_cleanse(data, static_cast<size_t>(count));
+    CPLFree(data);
+    return result;
+}
+
+/**
+ * @brief updateCryptParams Reparse key and IV if they were changed. Must be
+ * called with state mutex held.
+ */
+static bool updateCryptParams(CryptState &state)
+{
+    std::string iv = Settings::instance().getString("crypt/iv", "");
+    std::string key = CPLGetConfigOption("CRYPT_KEY", defaultKey);
+    if(state.valid && iv == state.ivHex && key == state.keyHex) {
+        return true;
+    }
+
+    resetSecrets(state);
+    state.ivHex = iv;
+    state.keyHex = key;
+    state.valid = parseHex(key, state.key, KEY_SIZE) &&
+            parseHex(iv, state.iv, BLOCK_SIZE);
+    if(!state.valid) {
+        OPENSSL_cleanse(state.key, KEY_SIZE);
+        OPENSSL_cleanse(state.iv, BLOCK_SIZE);
+    }
+    return state.valid;
+}
+
 // Adapted from https://wiki.openssl.org/images/5/5d/Evp-encrypt-cxx.tar.gz
+// EVP selects AES-NI or ARMv8 crypto extensions itself if CPU has them.
 std::string encrypt(const std::string& ptext)
 {
     if(ptext.size() > 256) {
@@ -226,24 +383,16 @@ std::string encrypt(const std::string& ptext)
         return "";
     }
 
-    // Load the necessary cipher
-    EVP_add_cipher(EVP_aes_256_cbc());
+    CryptState &state = cryptState();
+    MutexHolder holder(state.mutex);
+    if(!updateCryptParams(state)) {
+        errorMessage(_("Invalid encryption key or IV"));
+        return "";
+    }
 
     EVP_CIPHER_CTX_free_ptr ctx(EVP_CIPHER_CTX_new(), ::EVP_CIPHER_CTX_free);
-
-    Settings &settings = Settings::instance();
-    std::string iv = settings.getString("crypt/iv", "");
-
-    int count = 0;
-    GByte *pabyiv = CPLHexToBinary(iv.c_str(), &count);
-    GByte *pabykey = CPLHexToBinary(CPLGetConfigOption("CRYPT_KEY", defaultKey), &count);
-
-    int rc = EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_cbc(), nullptr, pabykey,
-                                pabyiv);
-
-    CPLFree(pabyiv);
-    CPLFree(pabykey);
-
+    int rc = EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_cbc(), nullptr,
+                                state.key, state.iv);
     if (rc != 1) {
         errorMessage(_("EVP_EncryptInit_ex failed"));
         return "";
@@ -268,43 +417,46 @@ std::string encrypt(const std::string& ptext)
         return "";
     }
 
-    return toHex(ctext, out_len1 + out_len2);
+    std::string out = toHex(ctext, out_len1 + out_len2);
+    // The same secret will be decrypted later in this session, i.e. on sync
+    state.secrets[out] = ptext;
+    return out;
 }
 
 std::string decrypt(const std::string& ctext)
 {
-    std::string rtext;
-     // Load the necessary cipher
-    EVP_add_cipher(EVP_aes_256_cbc());
-
-    EVP_CIPHER_CTX_free_ptr ctx(EVP_CIPHER_CTX_new(), ::EVP_CIPHER_CTX_free);
-    Settings &settings = Settings::instance();
-    std::string iv = settings.getString("crypt/iv", "");
-
-    int count = 0;
-    GByte *pabyiv = CPLHexToBinary(iv.c_str(), &count);
-    const char *ck = CPLGetConfigOption("CRYPT_KEY", defaultKey);
-    count = 0;
-    GByte *pabykey = CPLHexToBinary(ck, &count);
-    int rc = EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_cbc(), nullptr, pabykey,
-                                pabyiv);
+    CryptState &state = cryptState();
+    MutexHolder holder(state.mutex);
+    if(!updateCryptParams(state)) {
+        errorMessage(_("Invalid encryption key or IV"));
+        return "";
+    }
 
-    CPLFree(pabyiv);
-    CPLFree(pabykey);
+    auto it = state.secrets.find(ctext);
+    if(it != state.secrets.end()) {
+        return it->second;
+    }
 
+    EVP_CIPHER_CTX_free_ptr ctx(EVP_CIPHER_CTX_new(), ::EVP_CIPHER_CTX_free);
+    int rc = EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_cbc(), nullptr,
+                                state.key, state.iv);
     if (rc != 1) {
         errorMessage(_("EVP_DecryptInit_ex failed"));
         return "";
     }
 
+    int count = 0;
     GByte *ctextIn = CPLHexToBinary(ctext.c_str(), &count);
 
     // Recovered text contracts upto BLOCK_SIZE
-    rtext.resize(static_cast<size_t>(count));
+    std::string rtext;
+    rtext.resize(static_cast<size_t>(count) + BLOCK_SIZE);
     int out_len1 = 0;
     rc = EVP_DecryptUpdate(ctx.get(), reinterpret_cast<unsigned char*>(&rtext[0]),
             &out_len1, ctextIn, count);
+    CPLFree(ctextIn);
     if (rc != 1) {
+        wipe(rtext);
         errorMessage(_("EVP_DecryptUpdate failed"));
         return "";
     }
@@ -314,16 +466,29 @@ std::string decrypt(const std::string& ctext)
             &out_len2);
 
     if (rc != 1) {
+        wipe(rtext);
         errorMessage(_("EVP_DecryptFinal_ex failed"));
         return "";
     }
 
     // Set recovered text size now that we know it
     rtext.resize(static_cast<size_t>(out_len1 + out_len2));
-
+    state.secrets[ctext] = rtext;
     return rtext;
 }
 
+void clearCryptCache()
+{
+    CryptState &state = cryptState();
+    MutexHolder holder(state.mutex);
+    resetSecrets(state);
+    OPENSSL_cleanse(state.key, KEY_SIZE);
+    OPENSSL_cleanse(state.iv, BLOCK_SIZE);
+    state.keyHex.clear();
+    state.ivHex.clear();
+    state.valid = false;
+}
+
 std::string deviceId(bool regenerate)
 {
     Settings &settings = Settings::instance();
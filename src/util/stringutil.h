@@ -21,11 +21,35 @@
 #ifndef NGSSTRINGUTIL_H
 #define NGSSTRINGUTIL_H
 
+#include <cstring>
 #include <string>
 #include <vector>
 
 namespace ngs {
 
+/**
+ * @brief The StringRef class Not owning view of characters in place of
+ * std::string_view, which needs C++17. Strings, C strings and literals are
+ * passed to it without copy. Null C string is an empty string.
+ */
+class StringRef
+{
+public:
+    StringRef(const std::string &str) : m_data(str.data()), m_size(str.size()) {}
+    StringRef(const char *str) : m_data(nullptr == str ? "" : str),
+        m_size(nullptr == str ? 0 : std::strlen(str)) {}
+    StringRef(const char *str, size_t size) : m_data(str), m_size(size) {}
+    const char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    char operator[](size_t pos) const { return m_data[pos]; }
+    std::string str() const { return std::string(m_data, m_size); }
+
+private:
+    const char *m_data;
+    size_t m_size;
+};
+
 int constexpr length(const char* str)
 {
     return *str ? 1 + length(str + 1) : 0;
@@ -34,16 +58,16 @@ int constexpr length(const char* str)
 std::string stripUnicode(const std::string &str, const char replaceChar = 'x');
 std::string normalize(const std::string &str, const std::string &lang = "");
 std::vector<std::string> fillStringList(char** strings);
-bool compare(const std::string &first, const std::string &second,
-             bool caseSensetive = false);
-bool comparePart(const std::string &first, const std::string &second,
-             unsigned int count, bool caseSensetive = false);
-int compareStrings(const std::string &first, const std::string &second,
+bool compare(StringRef first, StringRef second, bool caseSensetive = false);
+bool comparePart(StringRef first, StringRef second, unsigned int count,
+                 bool caseSensetive = false);
+int compareStrings(StringRef first, StringRef second,
                    bool caseSensetive = false);
-bool startsWith(const std::string &str, const std::string &part,
-                bool caseSensetive = false);
-bool endsWith(const std::string &str, const std::string &part,
-              bool caseSensetive = false);
+bool startsWith(StringRef str, StringRef part, bool caseSensetive = false);
+bool endsWith(StringRef str, StringRef part, bool caseSensetive = false);
+std::string toLower(StringRef str);
+bool matchPattern(const std::string &str, const std::string &pattern,
+                  bool caseSensetive = false);
 std::string md5(const std::string &val);
 std::string fromCString(const char *str);
 std::string random(int size);
@@ -51,6 +75,7 @@ std::string crypt_salt();
 std::string crypt_key();
 std::string encrypt(const std::string& ptext);
 std::string decrypt(const std::string& ctext);
+void clearCryptCache();
 std::string deviceId(bool regenerate = false);
 bool toBool(const std::string &val);
 
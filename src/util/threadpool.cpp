@@ -20,19 +20,255 @@
  ****************************************************************************/
 #include "threadpool.h"
 
+#if defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cpl_atomic_ops.h"
 #include "cpl_conv.h"
 
+#include "options.h"
+
 namespace ngs {
 
+#if !defined(__APPLE__) && defined(__linux__)
+// Same as Android THREAD_PRIORITY_BACKGROUND
+constexpr int BACKGROUND_WORKER_NICE = 10;
+constexpr int NETWORK_WORKER_NICE = 5;
+#endif
+
+/**
+ * @brief The WorkerData struct Passed to new worker thread.
+ */
+typedef struct _workerData {
+    ThreadPool *pool;
+    unsigned char index;
+} WorkerData;
 
 //------------------------------------------------------------------------------
 // ThreadData
 //------------------------------------------------------------------------------
-ThreadData::ThreadData(bool own) :
+ThreadData::ThreadData(bool own, double priority) :
     m_own(own),
-    m_tries(0)
+    m_tries(0),
+    m_priority(priority)
+{
+
+}
+
+//------------------------------------------------------------------------------
+// ThreadQueue
+//------------------------------------------------------------------------------
+void ThreadQueue::push(ThreadData *data)
+{
+    MutexHolder holder(m_mutex, 15.5);
+    // Keep FIFO order for jobs with equal priority.
+    auto it = m_data.end();
+    while(it != m_data.begin()) {
+        auto prev = it - 1;
+        if((*prev)->priority() <= data->priority()) {
+            break;
+        }
+        it = prev;
+    }
+    m_data.insert(it, data);
+}
+
+ThreadData *ThreadQueue::pop()
+{
+    MutexHolder holder(m_mutex, 15.5);
+    if(m_data.empty()) {
+        return nullptr;
+    }
+    ThreadData *data = m_data.front();
+    m_data.pop_front();
+    return data;
+}
+
+ThreadData *ThreadQueue::steal()
 {
+    // Take the most important job, i.e. center tile, not the farthest one
+    return pop();
+}
+
+int ThreadQueue::remove(poolFilterFunction filter, void *filterData)
+{
+    MutexHolder holder(m_mutex, 25.5);
+    int count = 0;
+    auto it = m_data.begin();
+    while(it != m_data.end()) {
+        ThreadData *data = *it;
+        if(filter(data, filterData)) {
+            if(data && data->isOwn()) {
+                delete data;
+            }
+            it = m_data.erase(it);
+            count++;
+        }
+        else {
+            ++it;
+        }
+    }
+    return count;
+}
+
+int ThreadQueue::clear()
+{
+    MutexHolder holder(m_mutex, 25.5);
+    int count = static_cast<int>(m_data.size());
+    for(ThreadData *data : m_data) {
+        if(data && data->isOwn()) {
+            delete data;
+        }
+    }
+    m_data.clear();
+    return count;
+}
+
+size_t ThreadQueue::size() const
+{
+    MutexHolder holder(m_mutex, 15.5);
+    return m_data.size();
+}
 
+/**
+ * @brief setWorkerPriority Set current thread priority by worker class.
+ * @param workerClass Worker class.
+ */
+static void setWorkerPriority(enum WorkerClass workerClass)
+{
+#if defined(__APPLE__)
+    pthread_set_qos_class_self_np(workerClass == WorkerClass::INTERACTIVE ?
+                                      QOS_CLASS_USER_INITIATED :
+                                      QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+    if(workerClass == WorkerClass::INTERACTIVE) {
+        return;
+    }
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                workerClass == WorkerClass::BACKGROUND ?
+                    BACKGROUND_WORKER_NICE : NETWORK_WORKER_NICE);
+#else
+    (void)workerClass;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// WorkerLimiter
+//------------------------------------------------------------------------------
+WorkerLimiter &WorkerLimiter::instance()
+{
+    static WorkerLimiter limiter;
+    return limiter;
+}
+
+WorkerLimiter::WorkerLimiter() :
+    m_activeWorkers(0),
+    m_maxWorkers(getNumberThreads())
+{
+}
+
+void WorkerLimiter::setMaxWorkers(unsigned char count)
+{
+    m_maxWorkers = count < 1 ? 1 : count;
+}
+
+int WorkerLimiter::limit(enum WorkerClass workerClass) const
+{
+    int maxWorkers = m_maxWorkers;
+    if(workerClass == WorkerClass::BACKGROUND && maxWorkers > 1) {
+        return maxWorkers - 1;
+    }
+    return maxWorkers;
+}
+
+/**
+ * @brief WorkerLimiter::acquire Take the worker slot.
+ * @param workerClass Worker class. Network workers are not counted.
+ * @param force Take the slot even if cap is reached. Used for the first
+ * worker of the pool.
+ * @return True if the worker may start.
+ */
+bool WorkerLimiter::acquire(enum WorkerClass workerClass, bool force)
+{
+    if(workerClass == WorkerClass::NETWORK) {
+        return true;
+    }
+
+    int maxWorkers = limit(workerClass);
+    int active = m_activeWorkers;
+    do {
+        if(!force && active >= maxWorkers) {
+            return false;
+        }
+    } while(!m_activeWorkers.compare_exchange_weak(active, active + 1));
+    return true;
+}
+
+/**
+ * @brief WorkerLimiter::canAcquire Check without taking if the worker slot is
+ * free.
+ * @param workerClass Worker class.
+ * @return True if acquire would succeed now.
+ */
+bool WorkerLimiter::canAcquire(enum WorkerClass workerClass) const
+{
+    return workerClass == WorkerClass::NETWORK ||
+            m_activeWorkers < limit(workerClass);
+}
+
+void WorkerLimiter::release(enum WorkerClass workerClass)
+{
+    if(workerClass != WorkerClass::NETWORK) {
+        m_activeWorkers--;
+    }
+}
+
+/**
+ * @brief WorkerLimiter::shouldYield Check if background worker should quit
+ * to free the slot for interactive workers.
+ * @param workerClass Worker class.
+ * @return True if worker should quit.
+ */
+bool WorkerLimiter::shouldYield(enum WorkerClass workerClass) const
+{
+    return workerClass == WorkerClass::BACKGROUND &&
+            m_activeWorkers > limit(workerClass);
+}
+
+//------------------------------------------------------------------------------
+// WorkerSlots
+//------------------------------------------------------------------------------
+/**
+ * @brief WorkerSlots::WorkerSlots Take free worker slots.
+ * @param workerClass Worker class of the threads.
+ * @param count Wanted threads count.
+ * @param forceFirst Take the first slot even if cap is reached, i.e. if the
+ * work can not be done on the calling thread.
+ */
+WorkerSlots::WorkerSlots(enum WorkerClass workerClass, int count,
+                         bool forceFirst) :
+    m_workerClass(workerClass),
+    m_count(0)
+{
+    WorkerLimiter &limiter = WorkerLimiter::instance();
+    while(m_count < count &&
+          limiter.acquire(workerClass, forceFirst && m_count == 0)) {
+        m_count++;
+    }
+}
+
+WorkerSlots::~WorkerSlots()
+{
+    WorkerLimiter &limiter = WorkerLimiter::instance();
+    for(int i = 0; i < m_count; ++i) {
+        limiter.release(m_workerClass);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -44,7 +280,10 @@ ThreadPool::ThreadPool() :
     m_threadCount(0),
     m_tries(3),
     m_stopOnFirstFail(false),
-    m_failed(false)
+    m_failed(false),
+    m_workerClass(WorkerClass::BACKGROUND),
+    m_dataCount(0),
+    m_nextQueue(0)
 {
 }
 
@@ -54,42 +293,106 @@ ThreadPool::~ThreadPool()
 }
 
 void ThreadPool::init(unsigned char numThreads, poolThreadFunction function,
-                      unsigned char tries, bool stopOnFirstFail)
+                      unsigned char tries, bool stopOnFirstFail,
+                      enum WorkerClass workerClass)
 {
-    m_maxThreadCount = numThreads;
+    // Running workers use the queues, let them quit before the queues change
+    clearThreadData();
+    waitWorkers();
+
+    MutexHolder holder(m_threadMutex, 19.5);
+    m_maxThreadCount = numThreads < 1 ? 1 : numThreads;
     m_function = function;
     m_tries = tries;
     m_stopOnFirstFail = stopOnFirstFail;
+    m_workerClass = workerClass;
+    m_queues.clear();
+    createQueues();
 }
 
 void ThreadPool::addThreadData(ThreadData *data)
 {
-    m_dataMutex.acquire(15.5);
-    m_threadData.push_back(data);
-    m_dataMutex.release();
+    if(nullptr == data) {
+        return;
+    }
+
+    if(m_queues.empty()) {
+        MutexHolder holder(m_threadMutex, 19.5);
+        if(m_queues.empty()) {
+            createQueues();
+        }
+    }
+
+    // Spread jobs between workers queues. Idle workers steal the rest.
+    int queue = CPLAtomicInc(&m_nextQueue);
+    if(queue < 0) {
+        queue = -queue;
+    }
+    CPLAtomicInc(&m_dataCount);
+    m_queues[static_cast<size_t>(queue) % m_queues.size()]->push(data);
 
     newWorker();
 }
 
-void ThreadPool::clearThreadData()
+/**
+ * Must be called with locked m_threadMutex.
+ */
+void ThreadPool::createQueues()
+{
+    for(unsigned char i = 0; i < m_maxThreadCount; ++i) {
+        m_queues.emplace_back(ThreadQueuePtr(new ThreadQueue));
+    }
+    m_workers.assign(m_maxThreadCount, false);
+}
+
+/**
+ * @brief ThreadPool::waitWorkers Wait all workers quit. Workers quit if there
+ * are no jobs, so clear the jobs before.
+ */
+void ThreadPool::waitWorkers()
 {
-    MutexHolder holder(m_dataMutex, 25.5);
-    if(m_threadData.empty()) {
+    while(true) {
+        m_threadMutex.acquire(7.0);
+        bool complete = m_threadCount == 0;
+        m_threadMutex.release();
+        if(complete) {
+            return;
+        }
+        CPLSleep(0.01);
+    }
+}
+
+void ThreadPool::removeThreadData(poolFilterFunction filter, void *filterData)
+{
+    if(nullptr == filter) {
         return;
     }
 
-    for(ThreadData *data : m_threadData) {
-        if(data && data->isOwn()) {
-            delete data;
+    for(const ThreadQueuePtr &queue : m_queues) {
+        int removed = queue->remove(filter, filterData);
+        if(removed > 0) {
+            CPLAtomicAdd(&m_dataCount, -removed);
+        }
+    }
+}
+
+void ThreadPool::clearThreadData()
+{
+    for(const ThreadQueuePtr &queue : m_queues) {
+        int removed = queue->clear();
+        if(removed > 0) {
+            CPLAtomicAdd(&m_dataCount, -removed);
         }
     }
-    m_threadData.clear();
 }
 
 void ThreadPool::waitComplete(const Progress &progress)
 {
     bool complete = false;
     size_t currentDataCount = dataCount();
+    if(currentDataCount == 0) {
+        currentDataCount = 1;
+    }
     while(true) {
 
         m_threadMutex.acquire(7.0);
@@ -109,18 +412,25 @@ void ThreadPool::waitComplete(const Progress &progress)
     }
 }
 
-bool ThreadPool::process()
+ThreadData *ThreadPool::takeThreadData(unsigned char worker)
 {
-    m_dataMutex.acquire(19.5);
-    if(m_threadData.empty()) {
-        m_dataMutex.release();
-        return false;
+    size_t queueCount = m_queues.size();
+    ThreadData *data = m_queues[worker]->pop();
+    for(size_t i = 1; nullptr == data && i < queueCount; ++i) {
+        data = m_queues[(worker + i) % queueCount]->steal();
+    }
+
+    if(nullptr != data) {
+        CPLAtomicAdd(&m_dataCount, -1);
     }
-    ThreadData* data = m_threadData.front();
-    m_threadData.pop_front();
-    m_dataMutex.release();
+    return data;
+}
+
+bool ThreadPool::process(unsigned char worker)
+{
+    ThreadData *data = takeThreadData(worker);
     if(nullptr == data) {
-        return false; // Should never happened.
+        return false;
     }
 
     if(m_function(data)) {
@@ -140,21 +450,29 @@ bool ThreadPool::process()
     }
     else {
         data->increaseTries();
-        MutexHolder holder(m_dataMutex, 19.5);
-        m_threadData.push_back(data);
+        CPLAtomicInc(&m_dataCount);
+        m_queues[worker]->push(data);
+    }
+
+    // Workers not started or quit on CPU workers cap start when slots free.
+    // Check without locks first, it is done after each job.
+    if(m_threadCount < m_maxThreadCount && dataCount() > 0 &&
+            WorkerLimiter::instance().canAcquire(m_workerClass)) {
+        newWorker();
     }
 
     return true;
 }
 
-void ThreadPool::finished()
+void ThreadPool::finished(unsigned char worker)
 {
     m_threadMutex.acquire(19.5);
     m_threadCount--;
+    m_workers[worker] = false;
     m_threadMutex.release();
+    WorkerLimiter::instance().release(m_workerClass);
 
-    MutexHolder holder(m_dataMutex, 19.5);
-    if(m_threadData.empty()) {
+    if(dataCount() == 0) {
         return;
     }
 
@@ -164,23 +482,58 @@ void ThreadPool::finished()
 void ThreadPool::newWorker()
 {
     MutexHolder holder(m_threadMutex, 19.5);
-    if(m_threadCount == m_maxThreadCount) {
+    if(m_threadCount >= m_maxThreadCount) {
         return;
     }
-    CPLCreateThread(threadFunction, this);
-    m_threadCount++;
+
+    // The first worker always starts, so pool does not wait for other pools
+    if(!WorkerLimiter::instance().acquire(m_workerClass, m_threadCount == 0)) {
+        return;
+    }
+
+    for(unsigned char i = 0; i < m_workers.size(); ++i) {
+        if(!m_workers[i]) {
+            WorkerData *workerData = new WorkerData;
+            workerData->pool = this;
+            workerData->index = i;
+            m_workers[i] = true;
+            m_threadCount++;
+            CPLCreateThread(threadFunction, workerData);
+            return;
+        }
+    }
+    WorkerLimiter::instance().release(m_workerClass);
 }
 
 void ThreadPool::threadFunction(void *threadData)
 {
-    ThreadPool *pool = static_cast<ThreadPool*>(threadData);
+    WorkerData *workerData = static_cast<WorkerData*>(threadData);
+    if(nullptr == workerData) {
+        return;
+    }
+
+    ThreadPool *pool = workerData->pool;
+    unsigned char index = workerData->index;
+    delete workerData;
+
     if(nullptr != pool) {
-        while(pool->process()) {
+        setWorkerPriority(pool->m_workerClass);
+        while(!pool->shouldYield() && pool->process(index)) {
             //CPLSleep(0.125);
         }
-        pool->finished();
+        pool->finished(index);
     }
 }
 
+/**
+ * @brief ThreadPool::shouldYield Background worker above the first one quits
+ * between jobs if CPU workers cap is reached.
+ */
+bool ThreadPool::shouldYield() const
+{
+    return m_threadCount > 1 &&
+            WorkerLimiter::instance().shouldYield(m_workerClass);
+}
+
 
 }
@@ -21,7 +21,10 @@
 #ifndef NGSTHREADPOOL_H
 #define NGSTHREADPOOL_H
 
-#include <list>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
 
 #include "cpl_multiproc.h"
 
@@ -36,21 +39,118 @@ namespace ngs {
 class ThreadData
 {
 public:
-    explicit ThreadData(bool own);
+    explicit ThreadData(bool own, double priority = 0.0);
     virtual ~ThreadData() = default;
     bool isOwn() const { return m_own; }
     void increaseTries() { m_tries++; }
     unsigned char tries() const { return m_tries; }
+    /**
+     * @brief priority Job priority. Jobs with less value are executed first.
+     */
+    double priority() const { return m_priority; }
+    void setPriority(double priority) { m_priority = priority; }
 
 protected:
     bool m_own;
     unsigned char m_tries;
+    double m_priority;
 };
 
+typedef bool (*poolFilterFunction)(const ThreadData*, void*);
 
+/**
+ * @brief The WorkerClass enum Priority class of pool workers. Workers get
+ * the thread priority (QoS class on Apple platforms, nice value elsewhere) of
+ * their class, so the OS schedules background work on efficiency cores.
+ */
+enum class WorkerClass {
+    INTERACTIVE,    // Work the user waits for, i.e. render fill
+    BACKGROUND,     // Builds, copies and other long tasks
+    NETWORK         // I/O bound downloads, not counted as CPU workers
+};
+
+/**
+ * @brief The WorkerLimiter class Global cap of CPU workers of all pools and
+ * helper threads taking WorkerSlots. Service and I/O threads are not counted.
+ * Each pool always starts its first worker, so pools waiting for each other do
+ * not dead lock. Further workers start while the cap allows. One slot is kept for
+ * interactive workers, and background workers above the first one of their
+ * pool quit between jobs if the cap is reached.
+ */
+class WorkerLimiter
+{
+public:
+    static WorkerLimiter &instance();
+
+public:
+    void setMaxWorkers(unsigned char count);
+    unsigned char maxWorkers() const { return m_maxWorkers; }
+    int activeWorkers() const { return m_activeWorkers; }
+    bool acquire(enum WorkerClass workerClass, bool force);
+    bool canAcquire(enum WorkerClass workerClass) const;
+    void release(enum WorkerClass workerClass);
+    bool shouldYield(enum WorkerClass workerClass) const;
+
+private:
+    WorkerLimiter();
+    ~WorkerLimiter() = default;
+    WorkerLimiter(WorkerLimiter const&) = delete;
+    WorkerLimiter &operator= (WorkerLimiter const&) = delete;
+    int limit(enum WorkerClass workerClass) const;
+
+private:
+    std::atomic<int> m_activeWorkers;
+    std::atomic<unsigned char> m_maxWorkers;
+};
+
+/**
+ * @brief The WorkerSlots class Worker slots of helper threads started outside
+ * of the pools. Slots are released on destruction, after the threads joined.
+ */
+class WorkerSlots
+{
+public:
+    WorkerSlots(enum WorkerClass workerClass, int count, bool forceFirst = false);
+    ~WorkerSlots();
+    WorkerSlots(WorkerSlots const&) = delete;
+    WorkerSlots &operator= (WorkerSlots const&) = delete;
+    /**
+     * @brief count Number of threads which may be started.
+     */
+    int count() const { return m_count; }
+
+private:
+    enum WorkerClass m_workerClass;
+    int m_count;
+};
+
+/**
+ * @brief The ThreadQueue class Double ended queue of one pool worker ordered by
+ * job priority. The worker takes jobs from the head, idle workers steal the
+ * most important jobs from the head too, so priority order holds pool wide.
+ */
+class ThreadQueue
+{
+public:
+    ThreadQueue() = default;
+    void push(ThreadData *data);
+    ThreadData *pop();
+    ThreadData *steal();
+    int remove(poolFilterFunction filter, void *filterData);
+    int clear();
+    size_t size() const;
+
+protected:
+    std::deque<ThreadData*> m_data;
+    Mutex m_mutex;
+};
+
+using ThreadQueuePtr = std::unique_ptr<ThreadQueue>;
 
 /**
- * @brief The ThreadPool class Pool of threads simultaniously executed
+ * @brief The ThreadPool class Pool of threads simultaniously executed. Each
+ * worker has own job queue and steals jobs from other workers if own queue is
+ * empty.
  */
 class ThreadPool
 {
@@ -59,31 +159,41 @@ public:
     ThreadPool();
     ~ThreadPool();
     void init(unsigned char numThreads, poolThreadFunction function,
-              unsigned char tries = 3, bool stopOnFirstFail = false);
+              unsigned char tries = 3, bool stopOnFirstFail = false,
+              enum WorkerClass workerClass = WorkerClass::BACKGROUND);
     void addThreadData(ThreadData* data);
+    void removeThreadData(poolFilterFunction filter, void *filterData);
     void clearThreadData();
     unsigned char currentWorkerCount() const { return m_threadCount; }
     unsigned char maxWorkerCount() const { return m_maxThreadCount; }
     void waitComplete(const Progress &progress);
-    size_t dataCount() const { return m_threadData.size(); }
+    size_t dataCount() const { return static_cast<size_t>(m_dataCount); }
     bool isFailed() const { return m_failed; }
 
 protected:
-    bool process();
-    void finished();
+    bool process(unsigned char worker);
+    ThreadData *takeThreadData(unsigned char worker);
+    void finished(unsigned char worker);
     void newWorker();
+    void createQueues();
+    void waitWorkers();
+    bool shouldYield() const;
 
     // static
     static void threadFunction(void *threadData);
 
 protected:
-    std::list<ThreadData*> m_threadData;
-    Mutex m_dataMutex, m_threadMutex;
+    std::vector<ThreadQueuePtr> m_queues;
+    std::vector<bool> m_workers;
+    Mutex m_threadMutex;
     poolThreadFunction m_function;
     unsigned char m_maxThreadCount, m_threadCount;
     unsigned char m_tries;
     bool m_stopOnFirstFail;
     bool m_failed;
+    enum WorkerClass m_workerClass;
+    volatile int m_dataCount;
+    volatile int m_nextQueue;
 };
 
 }
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "trace.h"
+
+// std
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+
+namespace ngs {
+
+constexpr size_t TRACE_BUFFER_SIZE = 65536;
+
+std::atomic<bool> Trace::m_enabled(false);
+
+Trace &Trace::instance()
+{
+    static Trace trace;
+    return trace;
+}
+
+Trace::Trace() :
+    m_next(0),
+    m_full(false)
+{
+}
+
+void Trace::setEnabled(bool enabled)
+{
+    if(enabled) {
+        MutexHolder holder(m_mutex);
+        if(m_events.empty()) {
+            m_events.resize(TRACE_BUFFER_SIZE);
+        }
+    }
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Trace::now Trace clock.
+ * @return Microseconds from the steady clock epoch.
+ */
+GIntBig Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Trace::add Add span to the ring buffer. The oldest span is
+ * overwritten if buffer is full.
+ * @param name Span name. Must be valid while trace exists.
+ * @param start Span start, microseconds.
+ * @param duration Span duration, microseconds.
+ */
+void Trace::add(const char *name, GIntBig start, GIntBig duration)
+{
+    unsigned long thread = static_cast<unsigned long>(
+                std::hash<std::thread::id>()(std::this_thread::get_id()));
+    MutexHolder holder(m_mutex);
+    if(m_events.empty()) {
+        return;
+    }
+    m_events[m_next] = {name, start, duration, thread};
+    if(++m_next == m_events.size()) {
+        m_next = 0;
+        m_full = true;
+    }
+}
+
+void Trace::clear()
+{
+    MutexHolder holder(m_mutex);
+    m_next = 0;
+    m_full = false;
+}
+
+/**
+ * @brief Trace::toJSON Spans in Chrome trace event format, oldest first.
+ * @return JSON text.
+ */
+std::string Trace::toJSON() const
+{
+    MutexHolder holder(m_mutex);
+    std::string out("{\"traceEvents\":[");
+    size_t count = m_full ? m_events.size() : m_next;
+    size_t first = m_full ? m_next : 0;
+    for(size_t i = 0; i < count; ++i) {
+        const TraceEvent &event = m_events[(first + i) % m_events.size()];
+        if(i > 0) {
+            out += ",";
+        }
+        out += CPLSPrintf("{\"name\":\"%s\",\"cat\":\"ngstore\",\"ph\":\"X\","
+                          "\"ts\":" CPL_FRMT_GIB ",\"dur\":" CPL_FRMT_GIB ","
+                          "\"pid\":1,\"tid\":%lu}",
+                          event.name, event.start, event.duration,
+                          event.thread);
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
+
+/**
+ * @brief Trace::save Write spans to the file in Chrome trace event format.
+ * @param path File path.
+ * @return True on success.
+ */
+bool Trace::save(const std::string &path) const
+{
+    std::string json = toJSON();
+    VSILFILE *file = VSIFOpenL(path.c_str(), "wb");
+    if(nullptr == file) {
+        return false;
+    }
+    bool result = VSIFWriteL(json.data(), 1, json.size(), file) == json.size();
+    return VSIFCloseL(file) == 0 && result;
+}
+
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2019 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSTRACE_H
+#define NGSTRACE_H
+
+// std
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "cpl_port.h"
+
+#include "mutex.h"
+
+namespace ngs {
+
+/**
+ * @brief The Trace class Collects timed spans of the library hot paths to the
+ * ring buffer. Spans are exported in Chrome trace event format, which is
+ * opened by chrome://tracing and Perfetto UI. Disabled trace costs one relaxed
+ * atomic load per span.
+ */
+class Trace
+{
+public:
+    static Trace &instance();
+    static bool isEnabled() {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+    void setEnabled(bool enabled);
+    void add(const char *name, GIntBig start, GIntBig duration);
+    void clear();
+    bool save(const std::string &path) const;
+    std::string toJSON() const;
+    static GIntBig now();
+
+private:
+    Trace();
+    ~Trace() = default;
+    Trace(Trace const&) = delete;
+    Trace& operator= (Trace const&) = delete;
+
+private:
+    typedef struct _traceEvent {
+        const char *name;
+        GIntBig start;
+        GIntBig duration;
+        unsigned long thread;
+    } TraceEvent;
+
+private:
+    static std::atomic<bool> m_enabled;
+    std::vector<TraceEvent> m_events;
+    size_t m_next;
+    bool m_full;
+    mutable Mutex m_mutex;
+};
+
+/**
+ * @brief The TraceSpan class Adds the span from construction to destruction to
+ * the trace if trace is enabled. Name must be a string literal.
+ */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name) :
+        m_name(Trace::isEnabled() ? name : nullptr),
+        m_start(nullptr == m_name ? 0 : Trace::now()) {}
+    ~TraceSpan() {
+        if(nullptr != m_name) {
+            Trace::instance().add(m_name, m_start, Trace::now() - m_start);
+        }
+    }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *m_name;
+    GIntBig m_start;
+};
+
+}
+
+#define ngsTraceConcat2(a, b) a##b
+#define ngsTraceConcat(a, b) ngsTraceConcat2(a, b)
+#define ngsTraceSpan(name) \
+    ngs::TraceSpan ngsTraceConcat(traceSpan, __LINE__)(name)
+
+#endif // NGSTRACE_H
@@ -20,10 +20,18 @@
  ****************************************************************************/
 #include "url.h"
 
+// std
+#include <cstring>
+#include <deque>
+
+// gdal
+#include "cpl_multiproc.h"
+
 #include "authstore.h"
 #include "catalog/file.h"
 #include "error.h"
 #include "stringutil.h"
+#include "trace.h"
 
 namespace ngs {
 
@@ -61,11 +69,44 @@ HTTPResultPtr::operator CPLHTTPResult *() const
 //
 //------------------------------------------------------------------------------
 
+/**
+ * @brief requestResult Create result structure for API. Headers and data are
+ * moved from the response, not copied.
+ * @param result Response. May be null.
+ * @return Result structure. Must be freed by ngsURLRequestResultFree.
+ */
+ngsURLRequestResult *requestResult(const HTTPResultPtr &result)
+{
+    ngsURLRequestResult *out = new ngsURLRequestResult;
+    out->headers = nullptr;
+    out->dataLen = 0;
+    out->data = nullptr;
+    if(nullptr == result) {
+        out->status = COD_REQUEST_FAILED;
+        return out;
+    }
+
+    out->status = result->nStatus;
+    if(result->nStatus != 0 || result->pszErrBuf != nullptr) {
+        return out;
+    }
+
+    out->headers = result->papszHeaders;
+    out->dataLen = result->nDataLen;
+    out->data = result->pabyData;
+
+    // Transfer own to out, don't delete with result
+    result->papszHeaders = nullptr;
+    result->pabyData = nullptr;
+
+    return out;
+}
+
 ngsURLRequestResult *fetch(const std::string &url, const Progress &progress,
                            const Options &options)
 {
+    ngsTraceSpan("http::fetch");
     resetError();
-    ngsURLRequestResult *out = new ngsURLRequestResult;
     auto requestOptions = options.asCPLStringList();
     requestOptions = addAuthHeaders(url, requestOptions);
 
@@ -78,26 +119,331 @@ ngsURLRequestResult *fetch(const std::string &url, const Progress &progress,
         return nullptr;
     }
     if(result->nStatus != 0 || result->pszErrBuf != nullptr) {
-        outMessage(COD_REQUEST_FAILED, result->pszErrBuf);
-        out->status = result->nStatus;
-        out->headers = nullptr;
-        out->dataLen = 0;
-        out->data = nullptr;
+        outMessage(COD_REQUEST_FAILED, "%s", nullptr == result->pszErrBuf ?
+                       _("Request failed") : result->pszErrBuf);
+    }
+
+    return requestResult(result);
+}
+
+/**
+ * @brief fetchMulti Download several URLs at once. Transfers share one curl
+ * multi handle, so connections are kept alive and reused between URLs and
+ * HTTP/2 streams are multiplexed over one connection if the server supports
+ * it. URLs are expected to be on the same server, authorization headers are
+ * taken for the first one.
+ * @param urls URLs to download
+ * @param maxConnections Maximum simultaneous transfers
+ * @param options CPLHTTPFetch options
+ * @return Results in the same order as URLs. The result may be null if the
+ * request failed.
+ */
+std::vector<HTTPResultPtr> fetchMulti(const std::vector<std::string> &urls,
+                                      int maxConnections,
+                                      const Options &options)
+{
+    ngsTraceSpan("http::fetchMulti");
+    std::vector<HTTPResultPtr> out;
+    if(urls.empty()) {
         return out;
     }
 
-    out->status = result->nStatus;
-    out->headers = result->papszHeaders;
-    out->dataLen = result->nDataLen;
-    out->data = result->pabyData;
+    auto requestOptions = options.asCPLStringList();
+    requestOptions = addAuthHeaders(urls.front(), requestOptions);
+    if(requestOptions.FetchNameValue("HTTP_VERSION") == nullptr) {
+        requestOptions.AddNameValue("HTTP_VERSION", "2TLS");
+    }
 
-    // Transfer own to out, don't delete with result
-    result->papszHeaders = nullptr;
-    result->pabyData = nullptr;
+    std::vector<const char*> urlList;
+    urlList.reserve(urls.size());
+    for(const std::string &url : urls) {
+        urlList.push_back(url.c_str());
+    }
+
+    int count = static_cast<int>(urlList.size());
+    CPLHTTPResult **results = CPLHTTPMultiFetch(urlList.data(), count,
+                                                maxConnections, requestOptions);
+    out.reserve(urls.size());
+    for(int i = 0; i < count; ++i) {
+        out.push_back(HTTPResultPtr(nullptr == results ? nullptr : results[i]));
+    }
+    // Results are owned by out now, free the array only
+    CPLFree(results);
 
     return out;
 }
 
+//------------------------------------------------------------------------------
+// AsyncRequestLoop
+//------------------------------------------------------------------------------
+constexpr int ASYNC_MAX_CONNECTIONS = 8;
+
+typedef struct _asyncRequest {
+    std::string url;
+    CPLStringList options;
+    RequestCallback callback;
+} AsyncRequest;
+
+/**
+ * @brief The AsyncRequestLoop class Executes queued requests on one network
+ * thread. Requests with the same options are sent together through one curl
+ * multi handle, so they share connections.
+ */
+class AsyncRequestLoop
+{
+public:
+    AsyncRequestLoop();
+    ~AsyncRequestLoop();
+    bool add(AsyncRequest &&request);
+    void stop();
+
+private:
+    void loop();
+    void execute(std::vector<AsyncRequest> &batch);
+    static void loopThread(void *data);
+
+private:
+    CPLMutex *m_mutex;
+    CPLCond *m_cond;
+    std::deque<AsyncRequest> m_requests;
+    CPLJoinableThread *m_thread;
+    bool m_stop;
+};
+
+static bool isSameOptions(CSLConstList first, CSLConstList second)
+{
+    if(CSLCount(first) != CSLCount(second)) {
+        return false;
+    }
+    for(int i = 0; nullptr != first && nullptr != first[i]; ++i) {
+        if(!EQUAL(first[i], second[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+AsyncRequestLoop::AsyncRequestLoop() :
+    m_mutex(CPLCreateMutex()),
+    m_cond(CPLCreateCond()),
+    m_thread(nullptr),
+    m_stop(false)
+{
+    // CPLCreateMutex returns acquired mutex
+    CPLReleaseMutex(m_mutex);
+}
+
+AsyncRequestLoop::~AsyncRequestLoop()
+{
+    stop();
+    CPLDestroyCond(m_cond);
+    CPLDestroyMutex(m_mutex);
+}
+
+bool AsyncRequestLoop::add(AsyncRequest &&request)
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    if(nullptr == m_thread) {
+        m_stop = false;
+        m_thread = CPLCreateJoinableThread(loopThread, this);
+        if(nullptr == m_thread) {
+            CPLReleaseMutex(m_mutex);
+            return errorMessage(_("Failed to start network thread"));
+        }
+    }
+    m_requests.push_back(std::move(request));
+    CPLCondBroadcast(m_cond);
+    CPLReleaseMutex(m_mutex);
+    return true;
+}
+
+/**
+ * @brief AsyncRequestLoop::stop Wait current requests and stop network thread.
+ * Callbacks of queued requests are executed with null result.
+ */
+void AsyncRequestLoop::stop()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    m_stop = true;
+    CPLJoinableThread *thread = m_thread;
+    CPLCondBroadcast(m_cond);
+    CPLReleaseMutex(m_mutex);
+
+    if(nullptr != thread) {
+        CPLJoinThread(thread);
+    }
+
+    CPLAcquireMutex(m_mutex, 1000.0);
+    m_thread = nullptr;
+    std::deque<AsyncRequest> canceled;
+    canceled.swap(m_requests);
+    CPLReleaseMutex(m_mutex);
+
+    for(const AsyncRequest &request : canceled) {
+        request.callback(HTTPResultPtr());
+    }
+}
+
+void AsyncRequestLoop::loop()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    while(true) {
+        while(!m_stop && m_requests.empty()) {
+            CPLCondWait(m_cond, m_mutex);
+        }
+        if(m_stop) {
+            break;
+        }
+
+        std::vector<AsyncRequest> batch;
+        batch.push_back(std::move(m_requests.front()));
+        m_requests.pop_front();
+        auto it = m_requests.begin();
+        while(it != m_requests.end() && batch.size() < static_cast<size_t>(ASYNC_MAX_CONNECTIONS)) {
+            if(isSameOptions(it->options.List(), batch.front().options.List())) {
+                batch.push_back(std::move(*it));
+                it = m_requests.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        CPLReleaseMutex(m_mutex);
+
+        execute(batch);
+
+        CPLAcquireMutex(m_mutex, 1000.0);
+    }
+    CPLReleaseMutex(m_mutex);
+}
+
+void AsyncRequestLoop::execute(std::vector<AsyncRequest> &batch)
+{
+    CPLStringList &options = batch.front().options;
+    if(batch.size() == 1) {
+        HTTPResultPtr result = CPLHTTPFetch(batch.front().url.c_str(), options);
+        batch.front().callback(result);
+        return;
+    }
+
+    std::vector<const char*> urlList;
+    urlList.reserve(batch.size());
+    for(const AsyncRequest &request : batch) {
+        urlList.push_back(request.url.c_str());
+    }
+
+    int count = static_cast<int>(urlList.size());
+    CPLHTTPResult **results = CPLHTTPMultiFetch(urlList.data(), count,
+                                                ASYNC_MAX_CONNECTIONS, options);
+    for(int i = 0; i < count; ++i) {
+        HTTPResultPtr result(nullptr == results ? nullptr : results[i]);
+        batch[static_cast<size_t>(i)].callback(result);
+    }
+    CPLFree(results);
+}
+
+void AsyncRequestLoop::loopThread(void *data)
+{
+    static_cast<AsyncRequestLoop*>(data)->loop();
+}
+
+static AsyncRequestLoop &asyncRequestLoop()
+{
+    static AsyncRequestLoop loop;
+    return loop;
+}
+
+/**
+ * @brief fetchAsync Queue request to network thread and return immediately.
+ * @param url URL to request
+ * @param callback Function executed from network thread with the result. The
+ * result is null if the request failed or canceled on library uninit.
+ * @param options CPLHTTPFetch options
+ * @return true if request queued.
+ */
+bool fetchAsync(const std::string &url, RequestCallback callback,
+                const Options &options)
+{
+    if(!callback) {
+        return errorMessage(_("Callback is not set"));
+    }
+
+    auto requestOptions = options.asCPLStringList();
+    requestOptions = addAuthHeaders(url, requestOptions);
+    return asyncRequestLoop().add({url, requestOptions, callback});
+}
+
+/**
+ * @brief fetchFuture Queue request to network thread.
+ * @param url URL to request
+ * @param options CPLHTTPFetch options
+ * @return Future with the result. The result is null if the request failed.
+ */
+std::future<HTTPResultPtr> fetchFuture(const std::string &url,
+                                       const Options &options)
+{
+    auto promise = std::make_shared<std::promise<HTTPResultPtr>>();
+    std::future<HTTPResultPtr> out = promise->get_future();
+    if(!fetchAsync(url, [promise](const HTTPResultPtr &result) {
+                   promise->set_value(result);
+                }, options)) {
+        promise->set_value(HTTPResultPtr());
+    }
+    return out;
+}
+
+/**
+ * @brief stopAsyncRequests Stop network thread. Not executed requests are
+ * canceled. Next asynchronous request starts the thread again.
+ */
+void stopAsyncRequests()
+{
+    asyncRequestLoop().stop();
+}
+
+/**
+ * @brief fetchIfModified Conditional download of the resource cached before.
+ * @param url URL to download
+ * @param etag ETag header of cached resource. May be empty.
+ * @param lastModified Last-Modified header of cached resource. May be empty.
+ * @param notModified Set to true if the server reports the resource is not
+ * changed (304 response without content)
+ * @param options CPLHTTPFetch options
+ * @return Result or null if the request failed.
+ */
+HTTPResultPtr fetchIfModified(const std::string &url, const std::string &etag,
+                              const std::string &lastModified,
+                              bool &notModified, const Options &options)
+{
+    ngsTraceSpan("http::fetchIfModified");
+    auto requestOptions = options.asCPLStringList();
+    std::string headers;
+    if(!etag.empty()) {
+        headers = "If-None-Match: " + etag;
+    }
+    if(!lastModified.empty()) {
+        if(!headers.empty()) {
+            headers += "\r\n";
+        }
+        headers += "If-Modified-Since: " + lastModified;
+    }
+    if(!headers.empty()) {
+        const char *optionHeaders = requestOptions.FetchNameValue("HEADERS");
+        if(nullptr != optionHeaders) {
+            headers += "\r\n" + std::string(optionHeaders);
+        }
+        requestOptions.SetNameValue("HEADERS", headers.c_str());
+    }
+    requestOptions = addAuthHeaders(url, requestOptions);
+
+    HTTPResultPtr result = CPLHTTPFetch(url.c_str(), requestOptions);
+    // GDAL reports 304 response as success without content
+    notModified = !headers.empty() && nullptr != result &&
+            result->nStatus == 0 && result->pszErrBuf == nullptr &&
+            result->nDataLen == 0;
+    return result;
+}
+
 CPLJSONObject fetchJson(const std::string &url, const Progress &progress,
                         const Options &options)
 {
@@ -124,17 +470,47 @@ static size_t ngsWriteFct(void *buffer, size_t size, size_t nmemb, void *reqInfo
     return nmemb;
 }
 
+/**
+ * @brief getFile Download file.
+ * @param url Url to download
+ * @param path File path to save
+ * @param progress Progress and cancel
+ * @param options HTTP options. Additional options:
+ *   RESUME - If file exists, request only the rest of it with HTTP Range and
+ *     append to file. If server does not support ranges, the file is
+ *     downloaded again. Default NO
+ * @return True on success
+ */
 bool getFile(const std::string &url, const std::string &path,
              const Progress &progress, const Options &options)
 {
     resetError();
-    VSILFILE * const fp = VSIFOpenL( path.c_str(), "wb" );
+    Options fileOptions(options);
+    bool resume = fileOptions.asBool("RESUME", false);
+    fileOptions.remove("RESUME");
+
+    vsi_l_offset offset = 0;
+    VSIStatBufL sStat;
+    if(resume && VSIStatL(path.c_str(), &sStat) == 0) {
+        offset = static_cast<vsi_l_offset>(sStat.st_size);
+    }
+
+    VSILFILE * const fp = VSIFOpenL( path.c_str(), offset > 0 ? "ab" : "wb" );
     if( fp == nullptr ) {
         return errorMessage(_("Create file %s failed"), path.c_str());
     }
 
-    auto requestOptions = options.asCPLStringList();
+    auto requestOptions = fileOptions.asCPLStringList();
     requestOptions = addAuthHeaders(url, requestOptions);
+    if(offset > 0) {
+        std::string range = CPLSPrintf("Range: bytes=" CPL_FRMT_GUIB "-",
+                                       static_cast<GUIntBig>(offset));
+        const char *headers = requestOptions.FetchNameValue("HEADERS");
+        if(nullptr != headers) {
+            range += "\r\n" + std::string(headers);
+        }
+        requestOptions.SetNameValue("HEADERS", range.c_str());
+    }
     Progress progressIn(progress);
     HTTPResultPtr result = CPLHTTPFetchEx(url.c_str(), requestOptions,
                                            ngsGDALProgress, &progressIn,
@@ -145,10 +521,22 @@ bool getFile(const std::string &url, const std::string &path,
         outMessage(COD_REQUEST_FAILED, _("Unexpected error"));
         return false;
     }
+    if(offset > 0 && result->pszErrBuf != nullptr &&
+            strstr(result->pszErrBuf, "416") != nullptr) {
+        // Range not satisfiable, file is already complete
+        resetError();
+        return ret;
+    }
     if(result->nStatus != 0 || result->pszErrBuf != nullptr) {
-        outMessage(COD_REQUEST_FAILED, result->pszErrBuf);
+        outMessage(COD_REQUEST_FAILED, "%s", nullptr == result->pszErrBuf ?
+                       _("Request failed") : result->pszErrBuf);
         return false;
     }
+    if(offset > 0 && CSLFetchNameValue(result->papszHeaders,
+                                       "Content-Range") == nullptr) {
+        // Range ignored by server, the full file is appended
+        return getFile(url, path, progress, fileOptions);
+    }
 
     return ret;
 }
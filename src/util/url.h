@@ -31,7 +31,10 @@
 #include "cpl_http.h"
 
 // std
+#include <functional>
+#include <future>
 #include <memory>
+#include <vector>
 
 namespace ngs {
 
@@ -49,15 +52,34 @@ public:
     operator CPLHTTPResult*() const;
 };
 
+/**
+ * Asynchronous request completion function. Executed from network thread, so
+ * it must be short and must not wait other asynchronous requests.
+ */
+using RequestCallback = std::function<void(const HTTPResultPtr &result)>;
+
 //------------------------------------------------------------------------------
+ngsURLRequestResult *requestResult(const HTTPResultPtr &result);
 ngsURLRequestResult *fetch(const std::string &url, const Progress &progress,
                            const Options &options);
 bool getFile(const std::string &url, const std::string &path,
              const Progress &progress = Progress(),
              const Options &options = Options());
+std::vector<HTTPResultPtr> fetchMulti(const std::vector<std::string> &urls,
+                                      int maxConnections,
+                                      const Options &options = Options());
+HTTPResultPtr fetchIfModified(const std::string &url, const std::string &etag,
+                              const std::string &lastModified,
+                              bool &notModified,
+                              const Options &options = Options());
 CPLJSONObject fetchJson(const std::string &url,
                         const Progress &progress = Progress(),
                         const Options &options = Options());
+bool fetchAsync(const std::string &url, RequestCallback callback,
+                const Options &options = Options());
+std::future<HTTPResultPtr> fetchFuture(const std::string &url,
+                                       const Options &options = Options());
+void stopAsyncRequests();
 CPLStringList addAuthHeaders(const std::string &url, CPLStringList &options);
 CPLStringList getGDALHeaders(const std::string &url);
 CPLJSONObject uploadFile(const std::string &url, const std::string &filePath,
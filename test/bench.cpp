@@ -0,0 +1,1471 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+// Benchmarks of tiling, rendering, I/O and network hot paths. The network
+// benchmarks run against mock NextGIS Web server on loopback interface and
+// report requests per iteration and transfer rates as counters. The large
+// store benchmarks run on 1M points, 100k polygons with holes and long tracks
+// at 1, 2, 4 and 8 threads. Their store is generated in tmp folder on first
+// run, --benchmark_large_scale sets the fraction of the feature counts.
+// Usage: ngstore_bench [--benchmark_filter=<substring>]
+//                      [--benchmark_out=<file.json>]
+//                      [--benchmark_min_time=<seconds>]
+//                      [--benchmark_large_scale=<fraction>]
+// Results are printed to stdout and written as JSON in Google Benchmark
+// layout, so the same tools can compare runs between releases.
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// gdal
+#include "cpl_conv.h"
+#include "cpl_json.h"
+#include "gdal_priv.h"
+
+#include "catalog/file.h"
+#include "catalog/folder.h"
+#include "catalog/ngw.h"
+#include "ds/dataset.h"
+#include "ds/datastore.h"
+#include "ds/featureclassovr.h"
+#include "ds/geometry.h"
+#include "ds/store.h"
+#include "ds/tablecursor.h"
+#include "ds/tilecache.h"
+#include "ds/util.h"
+#include "map/gl/layer.h"
+#include "map/gl/style.h"
+#include "map/maptransform.h"
+#include "ngstore/api.h"
+#include "ngstore/version.h"
+#include "util/buffer.h"
+#include "util/threadpool.h"
+
+#ifndef _WIN32
+#include "mockserver.h"
+#endif
+
+using namespace ngs;
+
+//------------------------------------------------------------------------------
+// Harness
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The BenchState class Counts iterations of the benchmark loop and
+ * measures the loop time. Code before the first keepRunning() call is fixture
+ * setup and is not measured, the same as code between pauseTiming() and
+ * resumeTiming() calls in the loop. Counters are reported with the benchmark
+ * result, as Google Benchmark user counters. Benchmark with failed fixture
+ * calls skipWithError() and does not run the loop.
+ */
+class BenchState
+{
+    using Clock = std::chrono::steady_clock;
+public:
+    explicit BenchState(size_t iterations) : m_iterations(iterations),
+        m_count(0), m_startCpu(0), m_stopCpu(0), m_pauseCpu(0),
+        m_pausedCpu(0), m_paused(Clock::duration::zero()) {}
+    bool keepRunning() {
+        if(m_count == 0) {
+            m_start = Clock::now();
+            m_startCpu = std::clock();
+        }
+        if(m_count == m_iterations) {
+            m_stop = Clock::now();
+            m_stopCpu = std::clock();
+            return false;
+        }
+        ++m_count;
+        return true;
+    }
+    void pauseTiming() {
+        m_pause = Clock::now();
+        m_pauseCpu = std::clock();
+    }
+    void resumeTiming() {
+        m_paused += Clock::now() - m_pause;
+        m_pausedCpu += std::clock() - m_pauseCpu;
+    }
+    size_t iterations() const { return m_iterations; }
+    double realTime() const {
+        return std::chrono::duration<double>(m_stop - m_start - m_paused).count();
+    }
+    double cpuTime() const {
+        return static_cast<double>(m_stopCpu - m_startCpu - m_pausedCpu) /
+                CLOCKS_PER_SEC;
+    }
+    void setCounter(const std::string &name, double value) {
+        m_counters[name] = value;
+    }
+    const std::map<std::string, double> &counters() const { return m_counters; }
+    void skipWithError(const std::string &message) { m_error = message; }
+    const std::string &error() const { return m_error; }
+
+private:
+    size_t m_iterations, m_count;
+    Clock::time_point m_start, m_stop, m_pause;
+    std::clock_t m_startCpu, m_stopCpu, m_pauseCpu, m_pausedCpu;
+    Clock::duration m_paused;
+    std::map<std::string, double> m_counters;
+    std::string m_error;
+};
+
+typedef struct _benchCase {
+    std::string name;
+    std::function<void(BenchState&)> func;
+} BenchCase;
+
+static std::vector<BenchCase> &benchCases()
+{
+    static std::vector<BenchCase> cases;
+    return cases;
+}
+
+static void addBench(const std::string &name,
+                     std::function<void(BenchState&)> func)
+{
+    benchCases().push_back({name, func});
+}
+
+/**
+ * @brief runBench Run benchmark with growing iteration count until the loop
+ * takes minTime seconds.
+ */
+static CPLJSONObject runBench(const BenchCase &bench, double minTime)
+{
+    size_t iterations = 1;
+    while(true) {
+        BenchState state(iterations);
+        bench.func(state);
+        if(!state.error().empty()) {
+            CPLJSONObject out;
+            out.Add("name", bench.name);
+            out.Add("run_type", "iteration");
+            out.Add("error_occurred", true);
+            out.Add("error_message", state.error());
+            return out;
+        }
+        double realTime = state.realTime();
+        if(realTime >= minTime || iterations >= 1000000000) {
+            CPLJSONObject out;
+            out.Add("name", bench.name);
+            out.Add("run_type", "iteration");
+            out.Add("iterations", static_cast<GInt64>(iterations));
+            out.Add("real_time", realTime * 1e9 / iterations);
+            out.Add("cpu_time", state.cpuTime() * 1e9 / iterations);
+            out.Add("time_unit", "ns");
+            for(const auto &counter : state.counters()) {
+                out.Add(counter.first, counter.second);
+            }
+            return out;
+        }
+
+        double factor = realTime > 0.0 ? minTime * 1.4 / realTime : 10.0;
+        if(factor > 10.0) {
+            factor = 10.0;
+        }
+        size_t next = static_cast<size_t>(iterations * factor);
+        iterations = next > iterations ? next : iterations + 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Fixtures
+//------------------------------------------------------------------------------
+
+constexpr unsigned char BENCH_ZOOM = 12;
+constexpr double BENCH_X = 4187000.0; // Moscow, EPSG:3857
+constexpr double BENCH_Y = 7509000.0;
+
+/**
+ * @brief The BenchRandom class Fixed seed linear congruential generator, gives
+ * the same fixtures on every platform.
+ */
+class BenchRandom
+{
+public:
+    explicit BenchRandom(GUInt32 seed = 42) : m_state(seed) {}
+    double next() {
+        m_state = m_state * 1664525u + 1013904223u;
+        return static_cast<double>(m_state >> 8) / (1 << 24);
+    }
+
+private:
+    GUInt32 m_state;
+};
+
+static OGRPolygon *createPolygon(BenchRandom &random, double x, double y,
+                                 double radius, int pointCount)
+{
+    OGRLinearRing ring;
+    for(int i = 0; i < pointCount; ++i) {
+        double angle = 2.0 * M_PI * i / pointCount;
+        double r = radius * (0.75 + 0.25 * random.next());
+        ring.addPoint(x + r * std::cos(angle), y + r * std::sin(angle));
+    }
+    ring.closeRings();
+
+    OGRPolygon *polygon = new OGRPolygon;
+    polygon->addRing(&ring);
+    return polygon;
+}
+
+static Envelope benchExtent(double size)
+{
+    return Envelope(BENCH_X - size, BENCH_Y - size,
+                    BENCH_X + size, BENCH_Y + size);
+}
+
+static TileItem benchTile()
+{
+    Envelope extent = benchExtent(1.0);
+    return MapTransform::getTilesForExtent(extent, BENCH_ZOOM, false, true)[0];
+}
+
+static VectorTile createVectorTile(size_t itemCount)
+{
+    BenchRandom random;
+    TileItem tileItem = benchTile();
+    Envelope env = tileItem.env;
+    env.resize(TILE_RESIZE);
+    double step = FeatureClassOverview::pixelSize(BENCH_ZOOM, true);
+    double size = env.width() * 0.5;
+
+    VectorTile vtile;
+    for(size_t i = 0; i < itemCount; ++i) {
+        OGRPolygon *polygon = createPolygon(random,
+            env.minX() + random.next() * env.width(),
+            env.minY() + random.next() * env.height(),
+            size * 0.05 * (0.2 + random.next()), 64);
+        GEOSGeometryPtr geom(new GEOSGeometryWrap(polygon));
+        geom->simplify(step);
+        VectorTileItemArray items;
+        geom->clip(env)->fillTile(static_cast<GIntBig>(i), items);
+        vtile.add(std::move(items));
+        delete polygon;
+    }
+    return vtile;
+}
+
+static OGRLayer *createMemoryLayer(GDALDataset *ds, const char *name,
+                                   size_t featureCount)
+{
+    OGRSpatialReference srs;
+    srs.importFromEPSG(3857);
+    OGRLayer *layer = ds->CreateLayer(name, &srs, wkbPolygon, nullptr);
+    OGRFieldDefn idField("id", OFTInteger);
+    OGRFieldDefn nameField("name", OFTString);
+    layer->CreateField(&idField);
+    layer->CreateField(&nameField);
+
+    BenchRandom random;
+    Envelope extent = benchExtent(20000.0);
+    for(size_t i = 0; i < featureCount; ++i) {
+        OGRFeature *feature = OGRFeature::CreateFeature(layer->GetLayerDefn());
+        feature->SetField(0, static_cast<int>(i));
+        feature->SetField(1, CPLSPrintf("feature %ld", static_cast<long>(i)));
+        feature->SetGeometryDirectly(createPolygon(random,
+            extent.minX() + random.next() * extent.width(),
+            extent.minY() + random.next() * extent.height(),
+            50.0 + random.next() * 200.0, 32));
+        layer->CreateFeature(feature);
+        OGRFeature::DestroyFeature(feature);
+    }
+    return layer;
+}
+
+static GDALDataset *createMemoryDataset()
+{
+    GDALDriver *driver = GetGDALDriverManager()->GetDriverByName("Memory");
+    if(nullptr == driver) {
+        return nullptr;
+    }
+    return driver->Create("bench", 0, 0, 0, GDT_Unknown, nullptr);
+}
+
+/**
+ * @brief The BenchDataset class Dataset over GDAL memory dataset.
+ */
+class BenchDataset : public Dataset
+{
+public:
+    explicit BenchDataset(GDALDataset *ds) :
+        Dataset(nullptr, CAT_CONTAINER_MEM, "bench") { m_DS = ds; }
+};
+
+/**
+ * @brief The BenchFeatureLayer class Gives access to the layer fillers.
+ */
+class BenchFeatureLayer : public GlFeatureLayer
+{
+public:
+    explicit BenchFeatureLayer(const std::string &styleName) :
+        GlFeatureLayer(nullptr) {
+        m_style = StylePtr(Style::createStyle(styleName, TextureAtlas()));
+    }
+    VectorGlObject *polygons(const FlatVectorTile &tile) {
+        return fillPolygons(tile, 0.0f, CancelToken());
+    }
+};
+
+//------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------
+
+static void benchFillTile(BenchState &state, int pointCount, bool simplify)
+{
+    BenchRandom random;
+    TileItem tileItem = benchTile();
+    Envelope env = tileItem.env;
+    env.resize(TILE_RESIZE);
+    OGRPolygon *polygon = createPolygon(random, env.minX() + env.width() * 0.5,
+                                        env.minY() + env.height() * 0.5,
+                                        env.width() * 0.4, pointCount);
+    double step = FeatureClassOverview::pixelSize(BENCH_ZOOM, true);
+
+    while(state.keepRunning()) {
+        GEOSGeometryPtr geom(new GEOSGeometryWrap(polygon));
+        if(simplify) {
+            geom->simplify(step);
+        }
+        VectorTileItemArray items;
+        geom->clip(env)->fillTile(1, items);
+    }
+    delete polygon;
+}
+
+static void benchFillTileParcels(BenchState &state, size_t parcelCount)
+{
+    // Cadastral like tile: many small parcels, some of them with holes
+    BenchRandom random;
+    TileItem tileItem = benchTile();
+    Envelope env = tileItem.env;
+    env.resize(TILE_RESIZE);
+    double size = env.width() * 0.5;
+
+    std::vector<GEOSGeometryPtr> parcels;
+    for(size_t i = 0; i < parcelCount; ++i) {
+        double x = env.minX() + random.next() * env.width();
+        double y = env.minY() + random.next() * env.height();
+        double radius = size * 0.02 * (0.5 + random.next());
+        OGRPolygon *polygon = createPolygon(random, x, y, radius,
+                                            5 + static_cast<int>(i % 8));
+        if(i % 5 == 0) {
+            OGRPolygon *hole = createPolygon(random, x, y, radius * 0.3, 6);
+            polygon->addRing(hole->getExteriorRing());
+            delete hole;
+        }
+        parcels.push_back(GEOSGeometryPtr(new GEOSGeometryWrap(polygon)));
+        delete polygon;
+    }
+
+    while(state.keepRunning()) {
+        VectorTileItemArray items;
+        for(size_t i = 0; i < parcels.size(); ++i) {
+            parcels[i]->fillTile(static_cast<GIntBig>(i), items);
+        }
+    }
+}
+
+static void benchVectorTileSave(BenchState &state)
+{
+    VectorTile vtile = createVectorTile(500);
+    while(state.keepRunning()) {
+        BufferPtr buffer = vtile.save();
+    }
+}
+
+static void benchVectorTileLoad(BenchState &state)
+{
+    BufferPtr buffer = createVectorTile(500).save();
+    while(state.keepRunning()) {
+        buffer->seek(0);
+        VectorTile vtile;
+        vtile.load(*buffer.get());
+    }
+}
+
+static void benchFlatVectorTileLoad(BenchState &state)
+{
+    BufferPtr buffer = createVectorTile(500).save();
+    while(state.keepRunning()) {
+        buffer->seek(0);
+        FlatVectorTile vtile;
+        vtile.load(*buffer.get());
+    }
+}
+
+static void benchFlatVectorTileAttach(BenchState &state)
+{
+    BufferPtr buffer = createVectorTile(500).save();
+    while(state.keepRunning()) {
+        FlatVectorTile vtile;
+        vtile.attach(buffer->data(), static_cast<size_t>(buffer->size()),
+                     buffer);
+    }
+}
+
+static void benchGetTile(BenchState &state, bool cached)
+{
+    GDALDataset *ds = createMemoryDataset();
+    BenchDataset dataset(ds);
+    OGRLayer *layer = createMemoryLayer(ds, "get_tile", 20000);
+    TileCache &cache = TileCache::instance();
+    size_t cacheSize = cache.maxSize();
+    cache.setMaxSize(cached ? 32 * 1024 * 1024 : 0);
+    TileItem tileItem = benchTile();
+    {
+        FeatureClassOverview featureClass(layer, &dataset, CAT_FC_MEM,
+                                          "get_tile");
+        Envelope env = tileItem.env;
+        env.resize(TILE_RESIZE);
+        while(state.keepRunning()) {
+            FlatVectorTile vtile = featureClass.getTile(tileItem.tile, env);
+        }
+    }
+    cache.setMaxSize(cacheSize);
+}
+
+static void benchCopyRows(BenchState &state)
+{
+    GDALDataset *ds = createMemoryDataset();
+    BenchDataset dataset(ds);
+    TablePtr srcTable(new Table(createMemoryLayer(ds, "copy_src", 10000),
+                                nullptr, CAT_TABLE_MEM, "copy_src"));
+    int counter = 0;
+    while(state.keepRunning()) {
+        const char *name = CPLSPrintf("copy_dst_%d", counter++);
+        OGRLayer *dstLayer = ds->CreateLayer(name, nullptr, wkbPolygon, nullptr);
+        OGRFeatureDefn *srcDefn = srcTable->definition();
+        for(int i = 0; i < srcDefn->GetFieldCount(); ++i) {
+            dstLayer->CreateField(srcDefn->GetFieldDefn(i));
+        }
+        {
+            Table dstTable(dstLayer, nullptr, CAT_TABLE_MEM, name);
+            FieldMapPtr fieldMap(srcTable->fields(), dstTable.fields());
+            dstTable.copyRows(srcTable, fieldMap);
+        }
+        ds->DeleteLayer(ds->GetLayerCount() - 1);
+    }
+}
+
+static void benchFillPolygons(BenchState &state)
+{
+    FlatVectorTile vtile(createVectorTile(500));
+    BenchFeatureLayer layer("simpleFill");
+    while(state.keepRunning()) {
+        VectorGlObject *glObject = layer.polygons(vtile);
+        delete glObject;
+    }
+}
+
+static void benchGetTilesForExtent(BenchState &state, unsigned char zoom)
+{
+    Envelope extent = benchExtent(20000.0);
+    while(state.keepRunning()) {
+        std::vector<TileItem> items =
+                MapTransform::getTilesForExtent(extent, zoom, false, true);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Large store benchmarks
+//------------------------------------------------------------------------------
+
+constexpr GIntBig BENCH_LARGE_POINTS = 1000000;
+constexpr GIntBig BENCH_LARGE_POLYGONS = 100000;
+constexpr GIntBig BENCH_LARGE_TRACKS = 100;
+constexpr int BENCH_LARGE_TRACK_POINTS = 10000;
+constexpr GIntBig BENCH_LARGE_CHUNK = 10000;
+constexpr double BENCH_LARGE_EXTENT = 50000.0;
+constexpr double BENCH_LARGE_QUERY_SIZE = 1000.0;
+constexpr int BENCH_LARGE_QUERIES = 256;
+// Each store object has own connection, as in different processes
+constexpr unsigned int BENCH_OPEN_FLAGS = GDAL_OF_UPDATE|GDAL_OF_VERBOSE_ERROR;
+
+static double benchLargeScale = 1.0;
+
+typedef struct _benchLargeLayer {
+    const char *name;
+    const char *geometryType;
+    OGRwkbGeometryType type;
+    GIntBig count;
+} BenchLargeLayer;
+
+static std::vector<BenchLargeLayer> benchLargeLayers()
+{
+    auto scaled = [](GIntBig count) {
+        return std::max(static_cast<GIntBig>(1),
+                        static_cast<GIntBig>(count * benchLargeScale));
+    };
+    return {{"points", "POINT", wkbPoint, scaled(BENCH_LARGE_POINTS)},
+            {"polygons", "POLYGON", wkbPolygon, scaled(BENCH_LARGE_POLYGONS)},
+            {"tracks", "LINESTRING", wkbLineString, scaled(BENCH_LARGE_TRACKS)}};
+}
+
+static OGRPolygon *createComplexPolygon(BenchRandom &random, double x,
+                                        double y, double radius)
+{
+    OGRPolygon *polygon = createPolygon(random, x, y, radius, 96);
+    for(double offset : {-0.3, 0.3}) {
+        OGRPolygon *hole = createPolygon(random, x + radius * offset, y,
+                                         radius * 0.2, 16);
+        polygon->addRing(hole->getExteriorRing());
+        delete hole;
+    }
+    return polygon;
+}
+
+static OGRLineString *createTrack(BenchRandom &random, double x, double y,
+                                  int pointCount)
+{
+    OGRLineString *track = new OGRLineString;
+    track->setNumPoints(pointCount);
+    double heading = 2.0 * M_PI * random.next();
+    for(int i = 0; i < pointCount; ++i) {
+        track->setPoint(i, x, y);
+        heading += (random.next() - 0.5) * 0.5;
+        x += 10.0 * std::cos(heading);
+        y += 10.0 * std::sin(heading);
+    }
+    return track;
+}
+
+static OGRGeometry *createLargeGeometry(BenchRandom &random,
+                                        OGRwkbGeometryType type)
+{
+    Envelope extent = benchExtent(BENCH_LARGE_EXTENT);
+    double x = extent.minX() + random.next() * extent.width();
+    double y = extent.minY() + random.next() * extent.height();
+    switch(type) {
+    case wkbPoint:
+        return new OGRPoint(x, y);
+    case wkbPolygon:
+        return createComplexPolygon(random, x, y, 20.0 + random.next() * 80.0);
+    default:
+        return createTrack(random, x, y, BENCH_LARGE_TRACK_POINTS);
+    }
+}
+
+static std::vector<Envelope> benchLargeQueries()
+{
+    BenchRandom random(7);
+    Envelope extent = benchExtent(BENCH_LARGE_EXTENT - BENCH_LARGE_QUERY_SIZE);
+    std::vector<Envelope> queries;
+    for(int i = 0; i < BENCH_LARGE_QUERIES; ++i) {
+        double x = extent.minX() + random.next() * extent.width();
+        double y = extent.minY() + random.next() * extent.height();
+        queries.push_back(Envelope(x - BENCH_LARGE_QUERY_SIZE,
+                                   y - BENCH_LARGE_QUERY_SIZE,
+                                   x + BENCH_LARGE_QUERY_SIZE,
+                                   y + BENCH_LARGE_QUERY_SIZE));
+    }
+    return queries;
+}
+
+static std::string benchTmpPath(const std::string &name, const char *ext)
+{
+    std::string tmpPath = ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                          nullptr);
+    return File::formFileName(tmpPath, name, ext);
+}
+
+static void deleteBenchStore(const std::string &path)
+{
+    for(const char *suffix : {"", "-wal", "-shm"}) {
+        std::string filePath = path + suffix;
+        if(Folder::isExists(filePath)) {
+            File::deleteFile(filePath);
+        }
+    }
+}
+
+/**
+ * @brief The BenchStore class Store opened without the shared datasets list,
+ * so each object reads through own connection. Gives access to the layers for
+ * overview building.
+ */
+class BenchStore : public DataStore
+{
+public:
+    explicit BenchStore(const std::string &path) :
+        DataStore(nullptr, File::getBaseName(path), path) {}
+    FeatureClassPtr featureClass(const std::string &name) const {
+        return std::dynamic_pointer_cast<FeatureClass>(getChild(name));
+    }
+    OGRLayer *layer(const std::string &name) const {
+        return m_DS->GetLayerByName(name.c_str());
+    }
+    bool destroyOverviews(const std::string &name) {
+        return destroyOverviewsTable(name);
+    }
+};
+
+static bool fillLargeLayer(BenchStore &store, const BenchLargeLayer &layer,
+                           BenchRandom &random)
+{
+    Options options;
+    options.add("GEOMETRY_TYPE", layer.geometryType);
+    options.add("FIELD_COUNT", "2");
+    options.add("FIELD_0_TYPE", "INTEGER");
+    options.add("FIELD_0_NAME", "id");
+    options.add("FIELD_1_TYPE", "STRING");
+    options.add("FIELD_1_NAME", "name");
+    ObjectPtr object = store.create(CAT_FC_GPKG, layer.name, options);
+    FeatureClass *featureClass = ngsDynamicCast(FeatureClass, object);
+    if(nullptr == featureClass) {
+        return false;
+    }
+
+    DatasetBatchOperationHolder holder(&store);
+    for(GIntBig i = 0; i < layer.count; ++i) {
+        if(i % BENCH_LARGE_CHUNK == 0) {
+            if(i > 0) {
+                store.commitTransaction();
+            }
+            store.startTransaction();
+        }
+        FeaturePtr feature = featureClass->createFeature();
+        feature->SetField("id", i);
+        feature->SetField("name", CPLSPrintf("feature " CPL_FRMT_GIB, i));
+        feature->SetGeometryDirectly(createLargeGeometry(random, layer.type));
+        if(!featureClass->insertFeature(feature, false)) {
+            store.rollbackTransaction();
+            return false;
+        }
+    }
+    return store.commitTransaction();
+}
+
+/**
+ * @brief benchLargeStorePath Get path of store with the large layers. The
+ * store is generated once and is reused by next runs with the same scale, as
+ * writing 1M points takes minutes.
+ * @return Store path or empty string if generation failed.
+ */
+static std::string benchLargeStorePath()
+{
+    static std::string storePath;
+    if(!storePath.empty()) {
+        return storePath;
+    }
+
+    std::vector<BenchLargeLayer> layers = benchLargeLayers();
+    std::string path = benchTmpPath(
+                CPLSPrintf("bench_large_" CPL_FRMT_GIB, layers[0].count),
+                DataStore::extension().c_str());
+    if(Folder::isExists(path)) {
+        BenchStore store(path);
+        bool valid = store.open(BENCH_OPEN_FLAGS);
+        for(const BenchLargeLayer &layer : layers) {
+            FeatureClassPtr featureClass = store.featureClass(layer.name);
+            valid = valid && featureClass &&
+                    featureClass->featureCount(true) == layer.count;
+        }
+        if(valid) {
+            storePath = path;
+            return storePath;
+        }
+        store.close();
+        deleteBenchStore(path);
+    }
+
+    std::cout << "Generate " << path << '\n';
+    if(!DataStore::create(path)) {
+        return "";
+    }
+    BenchStore store(path);
+    if(!store.open(BENCH_OPEN_FLAGS)) {
+        return "";
+    }
+    BenchRandom random;
+    for(const BenchLargeLayer &layer : layers) {
+        if(!fillLargeLayer(store, layer, random)) {
+            store.close();
+            deleteBenchStore(path);
+            return "";
+        }
+    }
+    storePath = path;
+    return storePath;
+}
+
+/**
+ * @brief The BenchThreads class Set worker count of the library pools and of
+ * the store read connections pool while the object exists. Background pools
+ * leave one slot of the global workers cap to interactive work, so the cap is
+ * one more.
+ */
+class BenchThreads
+{
+public:
+    explicit BenchThreads(int count) :
+        m_numThreads(CPLGetConfigOption("GDAL_NUM_THREADS", "")),
+        m_maxWorkers(WorkerLimiter::instance().maxWorkers()) {
+        CPLSetConfigOption("GDAL_NUM_THREADS", CPLSPrintf("%d", count));
+        WorkerLimiter::instance().setMaxWorkers(
+                    static_cast<unsigned char>(count + 1));
+    }
+    ~BenchThreads() {
+        CPLSetConfigOption("GDAL_NUM_THREADS", m_numThreads.empty() ?
+                               nullptr : m_numThreads.c_str());
+        WorkerLimiter::instance().setMaxWorkers(m_maxWorkers);
+    }
+
+private:
+    std::string m_numThreads;
+    unsigned char m_maxWorkers;
+};
+
+static void runThreads(int count, const std::function<void(int)> &func)
+{
+    std::vector<std::thread> threads;
+    for(int i = 0; i < count; ++i) {
+        threads.emplace_back(func, i);
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+}
+
+static void benchLargeOpen(BenchState &state, int threads)
+{
+    std::string path = benchLargeStorePath();
+    if(path.empty()) {
+        state.skipWithError("Large store generation failed");
+        return;
+    }
+
+    BenchThreads holder(threads);
+    while(state.keepRunning()) {
+        runThreads(threads, [&path](int) {
+            BenchStore store(path);
+            if(store.open(BENCH_OPEN_FLAGS)) {
+                store.loadChildren();
+            }
+        });
+    }
+    state.setCounter("items_per_second", static_cast<double>(threads) *
+                     state.iterations() / state.realTime());
+}
+
+static void benchLargeIterate(BenchState &state, const std::string &name,
+                              int threads)
+{
+    std::string path = benchLargeStorePath();
+    if(path.empty()) {
+        state.skipWithError("Large store generation failed");
+        return;
+    }
+
+    BenchThreads holder(threads);
+    BenchStore store(path);
+    store.open(BENCH_OPEN_FLAGS);
+    FeatureClassPtr featureClass = store.featureClass(name);
+    GIntBig count = featureClass->featureCount();
+    std::string fid = featureClass->fidColumn();
+
+    // Each thread reads own range of identifiers
+    std::atomic<GIntBig> read(0);
+    while(state.keepRunning()) {
+        runThreads(threads, [&](int index) {
+            GIntBig first = 1 + count * index / threads;
+            GIntBig last = 1 + count * (index + 1) / threads;
+            TableCursorPtr cursor = featureClass->cursor(
+                        CPLSPrintf("%s >= " CPL_FRMT_GIB " AND %s < " CPL_FRMT_GIB,
+                                   fid.c_str(), first, fid.c_str(), last));
+            if(!cursor) {
+                return;
+            }
+            GIntBig rows = 0;
+            while(cursor->next()) {
+                ++rows;
+            }
+            read += rows;
+        });
+    }
+    if(read != count * static_cast<GIntBig>(state.iterations())) {
+        state.skipWithError("Not all features were read");
+        return;
+    }
+    state.setCounter("items_per_second", static_cast<double>(read) /
+                     state.realTime());
+}
+
+static void benchLargeSpatialFilter(BenchState &state, const std::string &name,
+                                    int threads)
+{
+    std::string path = benchLargeStorePath();
+    if(path.empty()) {
+        state.skipWithError("Large store generation failed");
+        return;
+    }
+
+    BenchThreads holder(threads);
+    BenchStore store(path);
+    store.open(BENCH_OPEN_FLAGS);
+    FeatureClassPtr featureClass = store.featureClass(name);
+    std::vector<Envelope> queries = benchLargeQueries();
+
+    std::atomic<GIntBig> read(0);
+    while(state.keepRunning()) {
+        runThreads(threads, [&](int index) {
+            for(size_t i = static_cast<size_t>(index); i < queries.size();
+                i += static_cast<size_t>(threads)) {
+                TableCursorPtr cursor = featureClass->cursor("", queries[i]);
+                if(!cursor) {
+                    continue;
+                }
+                GIntBig rows = 0;
+                while(cursor->next()) {
+                    ++rows;
+                }
+                read += rows;
+            }
+        });
+    }
+    double queryCount = static_cast<double>(queries.size()) * state.iterations();
+    state.setCounter("items_per_second", queryCount / state.realTime());
+    state.setCounter("features_per_query", read / queryCount);
+}
+
+static void benchLargeFeatureCount(BenchState &state, const std::string &name,
+                                   int threads)
+{
+    std::string path = benchLargeStorePath();
+    if(path.empty()) {
+        state.skipWithError("Large store generation failed");
+        return;
+    }
+
+    // Feature count changes the table filter, so each thread has own store
+    BenchThreads holder(threads);
+    std::vector<std::unique_ptr<BenchStore>> stores;
+    std::vector<FeatureClassPtr> featureClasses;
+    for(int i = 0; i < threads; ++i) {
+        stores.emplace_back(new BenchStore(path));
+        stores.back()->open(BENCH_OPEN_FLAGS);
+        featureClasses.push_back(stores.back()->featureClass(name));
+    }
+    std::vector<Envelope> queries = benchLargeQueries();
+
+    while(state.keepRunning()) {
+        runThreads(threads, [&](int index) {
+            FeatureClass *featureClass = featureClasses[index].get();
+            for(size_t i = static_cast<size_t>(index); i < queries.size();
+                i += static_cast<size_t>(threads)) {
+                const Envelope &query = queries[i];
+                featureClass->setSpatialFilter(query.minX(), query.minY(),
+                                               query.maxX(), query.maxY());
+                featureClass->featureCount(true);
+            }
+            featureClass->setSpatialFilter();
+        });
+    }
+    state.setCounter("items_per_second", static_cast<double>(queries.size()) *
+                     state.iterations() / state.realTime());
+}
+
+static void benchLargeCopyFeatures(BenchState &state, int threads)
+{
+    std::string path = benchLargeStorePath();
+    if(path.empty()) {
+        state.skipWithError("Large store generation failed");
+        return;
+    }
+
+    BenchStore store(path);
+    store.open(BENCH_OPEN_FLAGS);
+    FeatureClassPtr srcFClass = store.featureClass("polygons");
+
+    std::string dstPath = benchTmpPath("bench_large_copy",
+                                       DataStore::extension().c_str());
+    deleteBenchStore(dstPath);
+    if(!DataStore::create(dstPath)) {
+        state.skipWithError("Destination store create failed");
+        return;
+    }
+    BenchStore dstStore(dstPath);
+    dstStore.open(BENCH_OPEN_FLAGS);
+
+    Options createOptions;
+    createOptions.add("GEOMETRY_TYPE", "POLYGON");
+    createOptions.add("FIELD_COUNT", "2");
+    createOptions.add("FIELD_0_TYPE", "INTEGER");
+    createOptions.add("FIELD_0_NAME", "id");
+    createOptions.add("FIELD_1_TYPE", "STRING");
+    createOptions.add("FIELD_1_NAME", "name");
+    Options copyOptions;
+    copyOptions.add("COPY_THREADS", static_cast<long>(threads));
+    copyOptions.add("SKIP_INVALID_GEOMETRY", true);
+
+    BenchThreads holder(threads);
+    GIntBig count = srcFClass->featureCount();
+    while(state.keepRunning()) {
+        state.pauseTiming();
+        ObjectPtr object = dstStore.create(CAT_FC_GPKG, "polygons",
+                                           createOptions);
+        FeatureClass *dstFClass = ngsDynamicCast(FeatureClass, object);
+        state.resumeTiming();
+        if(nullptr == dstFClass) {
+            state.skipWithError("Destination feature class create failed");
+            return;
+        }
+        FieldMapPtr fieldMap(srcFClass->fields(), dstFClass->fields());
+        dstFClass->copyFeatures(srcFClass, fieldMap, wkbUnknown, Progress(),
+                                copyOptions);
+        state.pauseTiming();
+        object->destroy();
+        state.resumeTiming();
+    }
+    state.setCounter("items_per_second", static_cast<double>(count) *
+                     state.iterations() / state.realTime());
+}
+
+static void benchLargeCreateOverviews(BenchState &state, int threads)
+{
+    std::string path = benchLargeStorePath();
+    if(path.empty()) {
+        state.skipWithError("Large store generation failed");
+        return;
+    }
+
+    BenchThreads holder(threads);
+    BenchStore store(path);
+    store.open(BENCH_OPEN_FLAGS);
+    Options options;
+    options.add("ZOOM_LEVELS", "6,8,10,12,14");
+    options.add("FORCE", true);
+    {
+        FeatureClassOverview featureClass(store.layer("polygons"), &store,
+                                          CAT_FC_GPKG, "polygons");
+        while(state.keepRunning()) {
+            featureClass.createOverviews(Progress(), options);
+        }
+    }
+    store.destroyOverviews("polygons");
+    state.setCounter("items_per_second", static_cast<double>(
+                         benchLargeLayers()[1].count) * state.iterations() /
+                     state.realTime());
+}
+
+#ifndef _WIN32
+//------------------------------------------------------------------------------
+// Network benchmarks
+//------------------------------------------------------------------------------
+
+constexpr unsigned char BENCH_CACHE_ZOOM = 14;
+
+/**
+ * @brief The BenchNGW class Mock NextGIS Web server and catalog connection to
+ * it.
+ */
+class BenchNGW
+{
+public:
+    BenchNGW(int latency, size_t bandwidth) : m_connection(nullptr) {
+        m_server.setLatency(latency);
+        m_server.setBandwidth(bandwidth);
+        if(!m_server.start()) {
+            return;
+        }
+
+        CatalogObjectH connections =
+                ngsCatalogObjectGet("ngc://GIS Server connections");
+        char **options = nullptr;
+        options = ngsListAddNameIntValue(options, "TYPE", CAT_CONTAINER_NGW);
+        options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+        options = ngsListAddNameValue(options, "login", "guest");
+        options = ngsListAddNameValue(options, "url", m_server.url().c_str());
+        options = ngsListAddNameValue(options, "is_guest", "ON");
+        m_connection = ngsCatalogObjectCreate(connections, "bench_ngw", options);
+        ngsListFree(options);
+    }
+    ~BenchNGW() {
+        if(nullptr != m_connection) {
+            ngsCatalogObjectDelete(m_connection);
+        }
+        m_server.stop();
+    }
+    MockNGWServer &server() { return m_server; }
+    NGWConnection *connection() const {
+        return dynamic_cast<NGWConnection*>(static_cast<Object*>(m_connection));
+    }
+
+    /**
+     * @brief report Set requests per iteration, transferred bytes and items
+     * per second counters. Call resetCounters() after fixture setup.
+     */
+    void report(BenchState &state, double items) const {
+        state.setCounter("requests", static_cast<double>(
+                             m_server.requestCount()) / state.iterations());
+        state.setCounter("bytes_per_second", static_cast<double>(
+                             m_server.bytesSent() + m_server.bytesReceived()) /
+                         state.realTime());
+        state.setCounter("items_per_second", items / state.realTime());
+    }
+    void resetCounters() { m_server.resetCounters(); }
+
+private:
+    MockNGWServer m_server;
+    CatalogObjectH m_connection;
+};
+
+static std::string benchTmpCatalogPath()
+{
+    std::string tmpPath = ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                          nullptr);
+    return ngsCatalogPathFromSystem(tmpPath.c_str());
+}
+
+/**
+ * @brief The BenchSyncLayer class Store point feature class with edit log,
+ * linked to vector layer of mock server. The store is deleted with the
+ * object.
+ */
+class BenchSyncLayer
+{
+public:
+    BenchSyncLayer(const BenchNGW &ngw, const std::string &name) :
+        m_store(nullptr) {
+        if(nullptr == ngw.connection()) {
+            return;
+        }
+
+        CatalogObjectH folder = ngsCatalogObjectGet(
+                    benchTmpCatalogPath().c_str());
+        char **options = nullptr;
+        options = ngsListAddNameIntValue(options, "TYPE", CAT_CONTAINER_NGS);
+        options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+        m_store = ngsCatalogObjectCreate(folder, name.c_str(), options);
+        ngsListFree(options);
+        if(nullptr == m_store) {
+            return;
+        }
+
+        options = nullptr;
+        options = ngsListAddNameIntValue(options, "TYPE", CAT_FC_GPKG);
+        options = ngsListAddNameValue(options, "GEOMETRY_TYPE", "POINT");
+        options = ngsListAddNameValue(options, "FIELD_COUNT", "1");
+        options = ngsListAddNameValue(options, "FIELD_0_TYPE", "STRING");
+        options = ngsListAddNameValue(options, "FIELD_0_NAME", "name");
+        options = ngsListAddNameValue(options, "LOG_EDIT_HISTORY", "ON");
+        CatalogObjectH layer = ngsCatalogObjectCreate(m_store, "points",
+                                                      options);
+        ngsListFree(options);
+        if(nullptr == layer) {
+            return;
+        }
+
+        m_layer = static_cast<Object*>(layer)->pointer();
+        Table *table = this->table();
+        table->setProperty(ngw::NGW_CONNECTION, ngw.connection()->fullName(),
+                           NG_ADDITIONS_KEY);
+        table->setProperty(ngw::NGW_ID, "100", NG_ADDITIONS_KEY);
+        table->setProperty(ngw::SYNC_KEY, ngw::SYNC_BIDIRECTIONAL,
+                           NG_ADDITIONS_KEY);
+    }
+    ~BenchSyncLayer() {
+        m_layer = ObjectPtr();
+        if(nullptr != m_store) {
+            ngsCatalogObjectDelete(m_store);
+        }
+    }
+    const ObjectPtr &layer() const { return m_layer; }
+    Table *table() const { return ngsDynamicCast(Table, m_layer); }
+    StoreObject *storeObject() const {
+        return ngsDynamicCast(StoreObject, m_layer);
+    }
+    GIntBig addFeature(size_t index, GIntBig remoteId, bool logEdits) const {
+        Table *table = this->table();
+        FeaturePtr feature = table->createFeature();
+        feature->SetField("name", CPLSPrintf("feature %ld",
+                                              static_cast<long>(index)));
+        feature->SetGeometryDirectly(new OGRPoint(
+                BENCH_X + static_cast<double>(index % 100) * 10.0,
+                BENCH_Y + static_cast<double>(index / 100) * 10.0));
+        if(remoteId != NOT_FOUND) {
+            StoreObject::setRemoteId(feature, remoteId);
+        }
+        table->insertFeature(feature, logEdits);
+        return feature->GetFID();
+    }
+
+private:
+    CatalogObjectH m_store;
+    ObjectPtr m_layer;
+};
+
+static void benchLoadChildren(BenchState &state, int childCount,
+                              bool revalidate)
+{
+    BenchNGW ngw(0, 0);
+    NGWConnection *connection = ngw.connection();
+    if(nullptr == connection) {
+        state.skipWithError("Mock server connection failed");
+        return;
+    }
+    connection->fillProperties();
+    ngw.server().setChildCount(childCount);
+
+    CPLJSONObject groupJson;
+    groupJson.Add("id", 1);
+    groupJson.Add("cls", "resource_group");
+    groupJson.Add("display_name", "bench");
+    CPLJSONObject resource;
+    resource.Add("resource", groupJson);
+
+    ngw.resetCounters();
+    while(state.keepRunning()) {
+        if(!revalidate) {
+            connection->clearResourceCache();
+        }
+        NGWResourceGroup group(nullptr, "bench", resource, connection);
+        group.loadChildren();
+    }
+    ngw.report(state, static_cast<double>(childCount) * state.iterations());
+}
+
+static void benchSyncLayers(BenchState &state, size_t editCount, int latency)
+{
+    BenchNGW ngw(latency, 0);
+    BenchSyncLayer syncLayer(ngw, "bench_sync");
+    if(!syncLayer.layer()) {
+        state.skipWithError("Sync layer creation failed");
+        return;
+    }
+    ngw.server().setFeatureCount(static_cast<int>(editCount));
+
+    // Every cycle sends new local features and downloads the server ones
+    std::vector<ObjectPtr> layers = { syncLayer.layer() };
+    size_t index = 0;
+    ngw.resetCounters();
+    while(state.keepRunning()) {
+        state.pauseTiming();
+        for(size_t i = 0; i < editCount; ++i) {
+            syncLayer.addFeature(index++, NOT_FOUND, true);
+        }
+        state.resumeTiming();
+        ngw::syncLayers(layers, Progress(), Options());
+    }
+    ngw.report(state, 2.0 * editCount * state.iterations());
+}
+
+static void benchTransferAttachments(BenchState &state, size_t count,
+                                     size_t size, bool upload)
+{
+    BenchNGW ngw(0, 0);
+    BenchSyncLayer syncLayer(ngw, upload ? "bench_att_upload" :
+                                           "bench_att_download");
+    if(!syncLayer.layer()) {
+        state.skipWithError("Sync layer creation failed");
+        return;
+    }
+    ngw.server().setAttachmentSize(size);
+
+    std::string filePath = ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                           nullptr);
+    filePath = File::formFileName(filePath, "bench_attachment", "bin");
+    std::string data(size, 'a');
+    File::writeFile(filePath, data.data(), data.size());
+
+    // Upload sends attachments added to features with remote ids, download
+    // gets attachments with remote ids missing locally.
+    Table *table = syncLayer.table();
+    std::vector<std::pair<GIntBig, GIntBig>> attachments;
+    for(size_t i = 0; i < count; ++i) {
+        GIntBig rid = static_cast<GIntBig>(i + 1);
+        GIntBig fid = syncLayer.addFeature(i, rid, false);
+        GIntBig aid = NOT_FOUND;
+        if(!upload) {
+            aid = table->addAttachment(fid, "attachment.bin", "", filePath,
+                                       Options(), false);
+            syncLayer.storeObject()->setAttachmentRemoteId(aid, rid);
+        }
+        attachments.push_back({fid, aid});
+    }
+
+    Options options;
+    options.add("UPLOAD", upload);
+    options.add("DOWNLOAD", !upload);
+    ngw.resetCounters();
+    while(state.keepRunning()) {
+        state.pauseTiming();
+        for(const auto &attachment : attachments) {
+            if(upload) {
+                table->addAttachment(attachment.first, "attachment.bin", "",
+                                     filePath, Options(), true);
+            }
+            else {
+                File::deleteFile(table->getAttachmentPath(attachment.first,
+                                                          attachment.second));
+            }
+        }
+        state.resumeTiming();
+        ngw::transferAttachments(syncLayer.storeObject(), Progress(), options);
+    }
+    ngw.report(state, static_cast<double>(count) * state.iterations());
+    File::deleteFile(filePath);
+}
+
+static void benchCacheArea(BenchState &state, int tilesPerSide, int latency,
+                           size_t bandwidth)
+{
+    BenchNGW ngw(latency, bandwidth);
+    if(nullptr == ngw.connection()) {
+        state.skipWithError("Mock server start failed");
+        return;
+    }
+
+    CatalogObjectH folder = ngsCatalogObjectGet(benchTmpCatalogPath().c_str());
+    std::string url = ngw.server().url() + "/tile/{z}/{x}/{y}.png";
+    char **options = nullptr;
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_RASTER_TMS);
+    options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+    options = ngsListAddNameValue(options, "url", url.c_str());
+    options = ngsListAddNameValue(options, "epsg", "3857");
+    options = ngsListAddNameValue(options, "z_min", "0");
+    options = ngsListAddNameValue(options, "z_max", "18");
+    CatalogObjectH raster = ngsCatalogObjectCreate(folder, "bench_tiles.wconn",
+                                                   options);
+    ngsListFree(options);
+    if(nullptr == raster || ngsCatalogObjectOpen(raster, nullptr) != 1) {
+        state.skipWithError("TMS raster creation failed");
+        return;
+    }
+
+    // Every iteration downloads new area of tilesPerSide x tilesPerSide tiles
+    double tileSize = DEFAULT_BOUNDS.width() / (1 << BENCH_CACHE_ZOOM);
+    double originX = DEFAULT_BOUNDS.minX() + tileSize *
+            std::floor((BENCH_X - DEFAULT_BOUNDS.minX()) / tileSize);
+    double originY = DEFAULT_BOUNDS.minY() + tileSize *
+            std::floor((BENCH_Y - DEFAULT_BOUNDS.minY()) / tileSize);
+    double step = tileSize * (tilesPerSide + 1);
+    double inset = tileSize * 0.25;
+    int counter = 0;
+    ngw.resetCounters();
+    while(state.keepRunning()) {
+        double minX = originX + step * (counter % 100);
+        double minY = originY - step * (counter / 100);
+        counter++;
+        char **areaOptions = nullptr;
+        areaOptions = ngsListAddNameValue(areaOptions, "MINX",
+                                          CPLSPrintf("%f", minX + inset));
+        areaOptions = ngsListAddNameValue(areaOptions, "MINY",
+                                          CPLSPrintf("%f", minY + inset));
+        areaOptions = ngsListAddNameValue(areaOptions, "MAXX",
+            CPLSPrintf("%f", minX + tileSize * tilesPerSide - inset));
+        areaOptions = ngsListAddNameValue(areaOptions, "MAXY",
+            CPLSPrintf("%f", minY + tileSize * tilesPerSide - inset));
+        areaOptions = ngsListAddNameIntValue(areaOptions, "ZOOM_LEVELS",
+                                             BENCH_CACHE_ZOOM);
+        areaOptions = ngsListAddNameValue(areaOptions, "RESUME", "OFF");
+        ngsRasterCacheArea(raster, areaOptions, nullptr, nullptr);
+        ngsListFree(areaOptions);
+    }
+    ngw.report(state, static_cast<double>(tilesPerSide * tilesPerSide) *
+               state.iterations());
+    ngsCatalogObjectDelete(raster);
+}
+#endif // _WIN32
+
+/**
+ * @brief addScalingBench Add benchmark runs at 1, 2, 4 and 8 threads.
+ */
+static void addScalingBench(const std::string &name,
+                            std::function<void(BenchState&, int)> func)
+{
+    using std::placeholders::_1;
+    for(int threads : {1, 2, 4, 8}) {
+        addBench(name + CPLSPrintf("/threads_%d", threads),
+                 std::bind(func, _1, threads));
+    }
+}
+
+static void registerBenches()
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    addBench("GEOSGeometryWrap/fillTile/polygon_100",
+             std::bind(benchFillTile, _1, 100, false));
+    addBench("GEOSGeometryWrap/fillTile/polygon_5000",
+             std::bind(benchFillTile, _1, 5000, false));
+    addBench("GEOSGeometryWrap/simplifyFillTile/polygon_5000",
+             std::bind(benchFillTile, _1, 5000, true));
+    addBench("GEOSGeometryWrap/fillTile/parcels_2000",
+             std::bind(benchFillTileParcels, _1, 2000));
+    addBench("VectorTile/save/items_500", benchVectorTileSave);
+    addBench("VectorTile/load/items_500", benchVectorTileLoad);
+    addBench("FlatVectorTile/load/items_500", benchFlatVectorTileLoad);
+    addBench("FlatVectorTile/attach/items_500", benchFlatVectorTileAttach);
+    addBench("FeatureClassOverview/getTile/on_the_fly",
+             std::bind(benchGetTile, _1, false));
+    addBench("FeatureClassOverview/getTile/cached",
+             std::bind(benchGetTile, _1, true));
+    addBench("Table/copyRows/rows_10000", benchCopyRows);
+    addBench("GlFeatureLayer/fillPolygons/items_500", benchFillPolygons);
+    addBench("MapTransform/getTilesForExtent/z12",
+             std::bind(benchGetTilesForExtent, _1, 12));
+    addBench("MapTransform/getTilesForExtent/z16",
+             std::bind(benchGetTilesForExtent, _1, 16));
+    addScalingBench("LargeStore/open", benchLargeOpen);
+    addScalingBench("LargeStore/iterate/points_1M",
+                    std::bind(benchLargeIterate, _1, "points", _2));
+    addScalingBench("LargeStore/iterate/polygons_100k",
+                    std::bind(benchLargeIterate, _1, "polygons", _2));
+    addScalingBench("LargeStore/iterate/tracks_100",
+                    std::bind(benchLargeIterate, _1, "tracks", _2));
+    addScalingBench("LargeStore/spatialFilter/points_1M",
+                    std::bind(benchLargeSpatialFilter, _1, "points", _2));
+    addScalingBench("LargeStore/spatialFilter/polygons_100k",
+                    std::bind(benchLargeSpatialFilter, _1, "polygons", _2));
+    addScalingBench("LargeStore/featureCount/points_1M",
+                    std::bind(benchLargeFeatureCount, _1, "points", _2));
+    addScalingBench("LargeStore/copyFeatures/polygons_100k",
+                    benchLargeCopyFeatures);
+    addScalingBench("LargeStore/createOverviews/polygons_100k",
+                    benchLargeCreateOverviews);
+#ifndef _WIN32
+    addBench("NGWResourceGroup/loadChildren/children_1000",
+             std::bind(benchLoadChildren, _1, 1000, false));
+    addBench("NGWResourceGroup/loadChildren/revalidate_1000",
+             std::bind(benchLoadChildren, _1, 1000, true));
+    addBench("NGW/syncLayers/edits_500",
+             std::bind(benchSyncLayers, _1, 500, 0));
+    addBench("NGW/syncLayers/edits_500/latency_50ms",
+             std::bind(benchSyncLayers, _1, 500, 50));
+    addBench("NGW/transferAttachments/upload_32x64k",
+             std::bind(benchTransferAttachments, _1, 32, 64 * 1024, true));
+    addBench("NGW/transferAttachments/download_32x64k",
+             std::bind(benchTransferAttachments, _1, 32, 64 * 1024, false));
+    addBench("Raster/cacheArea/tiles_64",
+             std::bind(benchCacheArea, _1, 8, 0, 0));
+    // 3G like network: 100 ms latency, 1 Mbit/s per connection
+    addBench("Raster/cacheArea/tiles_64/3g",
+             std::bind(benchCacheArea, _1, 8, 100, 128 * 1024));
+#endif // _WIN32
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+
+static const char *argValue(const char *arg, const char *key)
+{
+    size_t len = strlen(key);
+    if(strncmp(arg, key, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter;
+    std::string outPath;
+    double minTime = 0.5;
+    for(int i = 1; i < argc; ++i) {
+        const char *value = nullptr;
+        if((value = argValue(argv[i], "--benchmark_filter")) != nullptr) {
+            filter = value;
+        }
+        else if((value = argValue(argv[i], "--benchmark_out")) != nullptr) {
+            outPath = value;
+        }
+        else if((value = argValue(argv[i], "--benchmark_min_time")) != nullptr) {
+            minTime = CPLAtof(value);
+        }
+        else if((value = argValue(argv[i], "--benchmark_large_scale")) != nullptr) {
+            benchLargeScale = CPLAtof(value);
+        }
+        else {
+            std::cerr << "Unknown argument " << argv[i] << '\n';
+            return 1;
+        }
+    }
+
+    char **options = nullptr;
+    options = ngsListAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    options = ngsListAddNameValue(options, "CACHE_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    if(ngsInit(options) != COD_SUCCESS) {
+        ngsListFree(options);
+        std::cerr << "Library init failed\n";
+        return 1;
+    }
+    ngsListFree(options);
+
+    registerBenches();
+
+    CPLJSONObject context;
+    context.Add("library_version", NGS_VERSION);
+    context.Add("num_cpus", CPLGetNumCPUs());
+    context.Add("min_time", minTime);
+    context.Add("large_scale", benchLargeScale);
+
+    CPLJSONArray results;
+    for(const BenchCase &bench : benchCases()) {
+        if(!filter.empty() && bench.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        CPLJSONObject result = runBench(bench, minTime);
+        if(result.GetBool("error_occurred")) {
+            std::cout << bench.name << "\tERROR: "
+                      << result.GetString("error_message") << '\n';
+        }
+        else {
+            std::cout << bench.name << '\t'
+                      << result.GetDouble("real_time") << " ns\t"
+                      << result.GetLong("iterations") << '\n';
+        }
+        results.Add(result);
+    }
+
+    ngsUnInit();
+
+    if(!outPath.empty()) {
+        CPLJSONDocument doc;
+        CPLJSONObject root = doc.GetRoot();
+        root.Add("context", context);
+        root.Add("benchmarks", results);
+        if(!doc.Save(outPath)) {
+            std::cerr << "Failed to save " << outPath << '\n';
+            return 1;
+        }
+    }
+
+    return 0;
+}
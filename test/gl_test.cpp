@@ -21,10 +21,22 @@
 
 #include "test.h"
 
+#include <cstring>
+#include <thread>
+
 #include "cpl_conv.h"
 
 #include "ds/featureclass.h"
+#include "ds/geometry.h"
+#include "ds/imagecache.h"
+#include "ds/mvt.h"
+#include "ds/tilecache.h"
+#include "map/gl/image.h"
+#include "map/gl/layer.h"
+#include "map/maptransform.h"
+#include "util/arena.h"
 #include "util/buffer.h"
+#include "util/memorybudget.h"
 
 TEST(GlTests, TestTileBuffer) {
     ngs::Buffer buffer1;
@@ -57,6 +69,63 @@ TEST(GlTests, TestTileBuffer) {
     EXPECT_FLOAT_EQ(4.0, fval);
 }
 
+TEST(GlTests, TestBufferArrays) {
+    std::vector<GUInt16> indices(5000);
+    for(size_t i = 0; i < indices.size(); ++i)
+        indices[i] = static_cast<GUInt16>(i);
+
+    ngs::Buffer buffer;
+    buffer.put(static_cast<GUInt32>(indices.size()));
+    buffer.putArray(indices.data(), indices.size());
+    EXPECT_EQ(buffer.size(), static_cast<int>(sizeof(GUInt32) +
+                                              indices.size() * sizeof(GUInt16)));
+    EXPECT_GE(buffer.capacity(), static_cast<size_t>(buffer.size()));
+
+    // Overwrite does not change size
+    buffer.seek(0);
+    buffer.put(static_cast<GUInt32>(indices.size()));
+    EXPECT_EQ(buffer.size(), static_cast<int>(sizeof(GUInt32) +
+                                              indices.size() * sizeof(GUInt16)));
+
+    // Borrowed memory is read in place
+    ngs::Buffer borrowed(buffer.data(), buffer.size(), false);
+    GUInt32 count = borrowed.getULong();
+    std::vector<GUInt16> out(count);
+    EXPECT_TRUE(borrowed.getArray(out.data(), out.size()));
+    EXPECT_EQ(out, indices);
+    EXPECT_FALSE(borrowed.getArray(out.data(), 1));
+
+    // and copied on write beyond its end
+    borrowed.put(static_cast<GUInt16>(1));
+    EXPECT_TRUE(borrowed.own());
+    EXPECT_NE(borrowed.data(), buffer.data());
+    EXPECT_EQ(borrowed.size(), buffer.size() + static_cast<int>(sizeof(GUInt16)));
+}
+
+TEST(GlTests, TestScratchArena) {
+    ngs::ScratchArena arena;
+    {
+        ngs::ScratchArenaScope scope(arena);
+        ngs::ScratchVector<double> values(
+                    (ngs::ArenaAllocator<double>(scope.arena())));
+        for(int i = 0; i < 100000; ++i)
+            values.push_back(i);
+        EXPECT_DOUBLE_EQ(values[99999], 99999.0);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(values.data()) % alignof(double), 0u);
+    }
+
+    // Memory is reused after the scope
+    size_t capacity = arena.capacity();
+    EXPECT_GT(capacity, 100000 * sizeof(double));
+    void *first = arena.allocate(16, 8);
+    arena.rewind({0, 0});
+    EXPECT_EQ(arena.allocate(16, 8), first);
+    EXPECT_EQ(arena.capacity(), capacity);
+
+    arena.reset();
+    EXPECT_LE(arena.capacity(), capacity);
+}
+
 TEST(GlTests, TestTileBufferSaveLoad) {
     ngs::VectorTile vtile0;
 
@@ -112,6 +181,908 @@ TEST(GlTests, TestTileBufferSaveLoad) {
     EXPECT_EQ(vitem4.isIdsPresent(idset2), true);
 }
 
+TEST(GlTests, TestTileQuantizedSaveLoad) {
+    ngs::VectorTile vtile0;
+    ngs::VectorTileItem vitem0;
+    vitem0.addPoint({12345.6f, 65432.1f});
+    vitem0.addPoint({23456.7f, 76543.2f});
+    vitem0.addIndex(0);
+    vitem0.addIndex(1);
+    vitem0.addId(777);
+    vitem0.setValid(true);
+    vtile0.add(vitem0);
+
+    ngs::BufferPtr buffer = vtile0.save(true);
+    EXPECT_LT(buffer->size(), vtile0.save()->size());
+
+    ngs::FlatVectorTile vtile1;
+    ASSERT_EQ(vtile1.attach(buffer->data(),
+                            static_cast<size_t>(buffer->size()), buffer), true);
+    ngs::FlatVectorTile vtile2 = vtile1;
+    ASSERT_EQ(vtile2.itemCount(), 1);
+    ngs::FlatVectorTileItem vitem1 = vtile2.item(0);
+    ASSERT_EQ(vitem1.pointCount(), 2);
+    // Quantization step is the points extent / 65535
+    EXPECT_NEAR(vitem1.point(0).x, 12345.6f, 0.1);
+    EXPECT_NEAR(vitem1.point(0).y, 65432.1f, 0.1);
+    EXPECT_NEAR(vitem1.point(1).x, 23456.7f, 0.1);
+    EXPECT_NEAR(vitem1.point(1).y, 76543.2f, 0.1);
+    EXPECT_EQ(vitem1.indices().size(), 2);
+}
+
+TEST(GlTests, TestTileCompression) {
+    ngs::VectorTile vtile0;
+    ngs::VectorTileItem vitem0;
+    for(int i = 0; i < 100; ++i) {
+        vitem0.addPoint({12345.6f + i, 65432.1f});
+        vitem0.addIndex(static_cast<unsigned short>(i));
+    }
+    vitem0.addId(777);
+    vitem0.setValid(true);
+    vtile0.add(vitem0);
+
+    ngs::BufferPtr blob = vtile0.save(true);
+    ngs::BufferPtr compressed = ngs::compressTileBlob(blob,
+                                    ngs::TileCompression::DEFLATE);
+    EXPECT_LT(compressed->size(), blob->size());
+
+    ngs::BufferPtr raw = ngs::decompressTileBlob(compressed->data(),
+                                     static_cast<size_t>(compressed->size()));
+    ASSERT_NE(raw, nullptr);
+    EXPECT_EQ(raw->size(), blob->size());
+    ngs::FlatVectorTile vtile1;
+    ASSERT_EQ(vtile1.attach(raw->data(), static_cast<size_t>(raw->size()), raw),
+              true);
+    EXPECT_EQ(vtile1.item(0).pointCount(), 100);
+
+    // Not compressed blob
+    EXPECT_EQ(ngs::decompressTileBlob(blob->data(),
+                                      static_cast<size_t>(blob->size())),
+              nullptr);
+}
+
+TEST(GlTests, TestTileMoveAdd) {
+    ngs::VectorTileItemArray items;
+    ngs::VectorTileItem vitem0;
+    vitem0.addPoint({12345.6f, 65432.1f});
+    vitem0.addId(777);
+    vitem0.setValid(true);
+    items.push_back(vitem0);
+
+    ngs::VectorTileItem vitem1;
+    vitem1.addPoint({23456.7f, 76543.2f});
+    items.push_back(vitem1); // Not valid, should be skipped
+
+    ngs::VectorTile vtile;
+    vtile.add(std::move(items));
+    EXPECT_EQ(vtile.itemCount(), 1);
+    EXPECT_EQ(vtile.isValid(), true);
+
+    ngs::VectorTileItemArray moreItems;
+    ngs::VectorTileItem vitem2;
+    vitem2.addPoint({12345.6f, 65432.1f});
+    vitem2.addId(888);
+    vitem2.setValid(true);
+    moreItems.push_back(vitem2);
+    vtile.add(std::move(moreItems), true);
+
+    EXPECT_EQ(vtile.itemCount(), 1);
+    std::set<GIntBig> idset;
+    idset.insert(777);
+    idset.insert(888);
+    EXPECT_EQ(vtile.items()[0].isIdsPresent(idset), true);
+}
+
+TEST(GlTests, TestTileClusterPoints) {
+    ngs::VectorTile vtile;
+    // Three points in the first cell, one in the second and one outside
+    const float coords[5][2] = {{10.0f, 10.0f}, {20.0f, 30.0f},
+                                {30.0f, 20.0f}, {60.0f, 60.0f},
+                                {120.0f, 10.0f}};
+    for(GIntBig i = 0; i < 5; ++i) {
+        ngs::VectorTileItem item;
+        item.addPoint({coords[i][0], coords[i][1]});
+        item.addId(i + 1);
+        item.setValid(true);
+        vtile.add(item);
+    }
+    ngs::VectorTileItem line;
+    line.addPoint({0.0f, 0.0f});
+    line.addPoint({100.0f, 100.0f});
+    line.addId(10);
+    line.setValid(true);
+    vtile.add(line);
+
+    vtile.clusterPoints(ngs::Envelope(0.0, 0.0, 100.0, 100.0), 2);
+    ASSERT_EQ(vtile.itemCount(), 3);
+    EXPECT_EQ(vtile.items()[0].pointCount(), 2); // Line is kept
+    const ngs::VectorTileItem &cluster = vtile.items()[1];
+    EXPECT_EQ(cluster.isIdsPresent(ngs::FeatureIDs({1, 2, 3})), true);
+    EXPECT_FLOAT_EQ(cluster.point(0).x, 20.0f);
+    EXPECT_FLOAT_EQ(cluster.point(0).y, 20.0f);
+    EXPECT_EQ(vtile.items()[2].isIdsPresent(ngs::FeatureIDs({4})), true);
+
+    // Cluster is merged with the new point weighted by its features count
+    ngs::VectorTileItem item;
+    item.addPoint({40.0f, 40.0f});
+    item.addId(6);
+    item.setValid(true);
+    vtile.add(item);
+    vtile.clusterPoints(ngs::Envelope(0.0, 0.0, 100.0, 100.0), 2);
+    ASSERT_EQ(vtile.itemCount(), 3);
+    EXPECT_EQ(vtile.items()[1].isIdsPresent(ngs::FeatureIDs({1, 2, 3, 6})),
+              true);
+    EXPECT_FLOAT_EQ(vtile.items()[1].point(0).x, 25.0f);
+}
+
+TEST(GlTests, TestFlatTileLoad) {
+    ngs::VectorTile vtile;
+
+    ngs::VectorTileItem vitem0;
+    vitem0.addPoint({1.0f, 2.0f});
+    vitem0.addPoint({3.0f, 4.0f});
+    vitem0.addPoint({1.0f, 2.0f});
+    vitem0.addIndex(0);
+    vitem0.addBorderIndex(0, 0);
+    vitem0.addBorderIndex(0, 1);
+    vitem0.addId(777);
+    vitem0.setValid(true);
+    vtile.add(vitem0);
+
+    ngs::VectorTileItem vitem1;
+    vitem1.addPoint({5.0f, 6.0f});
+    vitem1.addId(555);
+    vitem1.setValid(true);
+    vtile.add(vitem1);
+
+    ngs::BufferPtr buffer = vtile.save();
+    buffer->seek(0);
+    ngs::FlatVectorTile ftile;
+    EXPECT_EQ(ftile.load(*buffer.get()), true);
+    EXPECT_EQ(ftile.itemCount(), 2);
+    EXPECT_EQ(ftile.empty(), false);
+
+    ngs::FlatVectorTileItem fitem0 = ftile.item(0);
+    EXPECT_EQ(fitem0.pointCount(), 3);
+    EXPECT_EQ(fitem0.isClosed(), true);
+    EXPECT_EQ(fitem0.indices().size(), 1);
+    EXPECT_EQ(fitem0.borderCount(), 1);
+    EXPECT_EQ(fitem0.borderIndices(0).size(), 2);
+
+    ngs::FlatVectorTileItem fitem1 = ftile.item(1);
+    EXPECT_FLOAT_EQ(fitem1.point(0).x, 5.0f);
+    EXPECT_FLOAT_EQ(fitem1.point(0).y, 6.0f);
+    EXPECT_EQ(fitem1.borderCount(), 0);
+
+    std::set<GIntBig> idset;
+    idset.insert(555);
+    EXPECT_EQ(fitem1.isIdsPresent(idset), true);
+    EXPECT_EQ(fitem0.isIdsPresent(idset, false), false);
+
+    // Item without points is not closed
+    ngs::VectorTileItem emptyItem;
+    EXPECT_EQ(emptyItem.isClosed(), false);
+}
+
+TEST(GlTests, TestFeatureIDs) {
+    GIntBig unsorted[] = {7, 3, 5, 3};
+    ngs::FeatureIDs ids(unsorted, unsorted + 4);
+    EXPECT_EQ(ids.size(), 3);
+    EXPECT_EQ(*ids.begin(), 3);
+    EXPECT_EQ(ids.contains(5), true);
+    EXPECT_EQ(ids.contains(4), false);
+
+    ids.insert(4);
+    ids.insert(9);
+    EXPECT_EQ(ids, ngs::FeatureIDs({3, 4, 5, 7, 9}));
+
+    GIntBig part[] = {4, 9};
+    GIntBig other[] = {1, 6, 9};
+    EXPECT_EQ(ids.includes(part, part + 2), true);
+    EXPECT_EQ(ids.includes(other, other + 3), false);
+    EXPECT_EQ(ids.intersects(other, other + 3), true);
+    EXPECT_EQ(ids.intersects(other, other + 2), false);
+
+    ids.erase(ngs::FeatureIDs({3, 9}));
+    EXPECT_EQ(ids, ngs::FeatureIDs({4, 5, 7}));
+}
+
+TEST(GlTests, TestFlatTileAttach) {
+    ngs::VectorTile vtile;
+    ngs::VectorTileItem vitem;
+    vitem.addPoint({1.0f, 2.0f});
+    vitem.addPoint({3.0f, 4.0f});
+    vitem.addIndex(1);
+    vitem.addBorderIndex(0, 0);
+    vitem.addId(777);
+    vitem.setValid(true);
+    vtile.add(vitem);
+
+    ngs::BufferPtr buffer = vtile.save();
+    ngs::FlatVectorTile ftile;
+    EXPECT_EQ(ftile.attach(buffer->data(), static_cast<size_t>(buffer->size()),
+                           buffer), true);
+    EXPECT_EQ(ftile.itemCount(), 1);
+    ngs::FlatVectorTileItem fitem = ftile.item(0);
+    EXPECT_EQ(fitem.pointCount(), 2);
+    EXPECT_FLOAT_EQ(fitem.point(1).y, 4.0f);
+    EXPECT_EQ(fitem.indices()[0], 1);
+    EXPECT_EQ(fitem.borderCount(), 1);
+    EXPECT_EQ(fitem.ids()[0], 777);
+
+    // Truncated blob is rejected
+    ngs::FlatVectorTile badTile;
+    EXPECT_EQ(badTile.attach(buffer->data(),
+                             static_cast<size_t>(buffer->size()) - 8, buffer),
+              false);
+
+    // Blob of other byte order is rejected
+    std::vector<GIntBig> swapped(static_cast<size_t>(buffer->size()) /
+                                 sizeof(GIntBig));
+    std::memcpy(swapped.data(), buffer->data(),
+                static_cast<size_t>(buffer->size()));
+    GUInt32 swappedMagic = ngs::VECTOR_TILE_SWAPPED_MAGIC;
+    std::memcpy(swapped.data(), &swappedMagic, sizeof(GUInt32));
+    EXPECT_EQ(badTile.attach(reinterpret_cast<const GByte*>(swapped.data()),
+                             static_cast<size_t>(buffer->size()), nullptr),
+              false);
+
+    // Blob with item points out of the points array is rejected. Items go
+    // after 40 bytes header and 8 bytes of one id, point offset is the first.
+    std::vector<GIntBig> corrupted(swapped.size());
+    std::memcpy(corrupted.data(), buffer->data(),
+                static_cast<size_t>(buffer->size()));
+    GByte *corruptedData = reinterpret_cast<GByte*>(corrupted.data());
+    GUInt32 pointOffset = 1;
+    std::memcpy(corruptedData + 48, &pointOffset, sizeof(GUInt32));
+    EXPECT_EQ(badTile.attach(corruptedData, static_cast<size_t>(buffer->size()),
+                             nullptr), false);
+    // Triangle index out of the item points is rejected too
+    std::memcpy(corrupted.data(), buffer->data(),
+                static_cast<size_t>(buffer->size()));
+    EXPECT_EQ(badTile.attach(corruptedData, static_cast<size_t>(buffer->size()),
+                             nullptr), true);
+    // Header counts: items 2, points 3, borders 5, centroids 7, ids 8
+    GUInt32 counts[10];
+    std::memcpy(counts, corruptedData, sizeof(counts));
+    size_t indexPos = sizeof(counts) + counts[8] * sizeof(GIntBig) +
+            counts[2] * 10 * sizeof(GUInt32) +
+            (counts[3] + counts[7]) * 2 * sizeof(float) +
+            (counts[5] + 1) * sizeof(GUInt32);
+    unsigned short badIndex = 2;
+    std::memcpy(corruptedData + indexPos, &badIndex, sizeof(badIndex));
+    ngs::FlatVectorTile badIndexTile;
+    EXPECT_EQ(badIndexTile.attach(corruptedData,
+                                  static_cast<size_t>(buffer->size()), nullptr),
+              false);
+
+    // Editable tile reads the new blob back
+    ngs::VectorTile vtile1;
+    buffer->seek(0);
+    EXPECT_EQ(vtile1.load(*buffer.get()), true);
+    EXPECT_EQ(vtile1.itemCount(), 1);
+    EXPECT_EQ(vtile1.items()[0].pointCount(), 2);
+}
+TEST(GlTests, TestTileAttributes) {
+    std::shared_ptr<ngs::TileColumns> columns(new ngs::TileColumns);
+    columns->push_back({"kind", ngs::TileColumnType::STRING});
+    columns->push_back({"pop", ngs::TileColumnType::NUMBER});
+
+    ngs::VectorTile vtile;
+    for(int i = 0; i < 4; ++i) {
+        std::shared_ptr<ngs::TileAttributes> attributes(
+                    new ngs::TileAttributes);
+        attributes->columns = columns;
+        attributes->values = { i % 2 == 0 ? "even" : "odd",
+                               std::to_string(i * 10) };
+        attributes->nulls = { false, i == 3 };
+
+        ngs::VectorTileItem item;
+        item.addId(i);
+        item.addPoint({static_cast<float>(i), 0.0f});
+        item.setValid(true);
+        item.setAttributes(attributes);
+        vtile.add(item, true);
+    }
+
+    for(bool quantize : {false, true}) {
+        ngs::BufferPtr buffer = vtile.save(quantize);
+        ngs::FlatVectorTile flatTile;
+        ASSERT_EQ(flatTile.attach(buffer->data(),
+                                  static_cast<size_t>(buffer->size()), buffer),
+                  true);
+        ASSERT_EQ(flatTile.itemCount(), 4);
+        ASSERT_EQ(flatTile.columnCount(), 2);
+        EXPECT_EQ(flatTile.columnIndex("pop"), 1);
+        EXPECT_EQ(flatTile.columnIndex("name"), -1);
+
+        ngs::FlatVectorTileItem item = flatTile.item(2);
+        EXPECT_EQ(item.attributeString(0), "even");
+        EXPECT_DOUBLE_EQ(item.attributeNumber(1), 20.0);
+        item = flatTile.item(3);
+        EXPECT_EQ(item.attributeString(0), "odd");
+        EXPECT_TRUE(item.isAttributeNull(1));
+    }
+}
+
+TEST(GlTests, TestMVTEncodeDecode) {
+    ngs::Envelope extent(0.0, 0.0, 4096.0, 4096.0);
+    std::shared_ptr<ngs::TileColumns> columns(new ngs::TileColumns);
+    columns->push_back({"kind", ngs::TileColumnType::STRING});
+    columns->push_back({"pop", ngs::TileColumnType::NUMBER});
+
+    // Points, the last one is a cluster of two features
+    ngs::VectorTile points;
+    for(int i = 0; i < 3; ++i) {
+        std::shared_ptr<ngs::TileAttributes> attributes(
+                    new ngs::TileAttributes);
+        attributes->columns = columns;
+        attributes->values = { i % 2 == 0 ? "even" : "odd",
+                               std::to_string(i * 10 - 5) };
+        attributes->nulls = { false, i == 1 };
+
+        ngs::VectorTileItem item;
+        item.addId(i);
+        if(i == 2) {
+            item.addId(3);
+        }
+        item.addPoint({static_cast<float>(i * 100), 200.0f});
+        item.setValid(true);
+        item.setAttributes(attributes);
+        points.add(item);
+    }
+
+    ngs::BufferPtr buffer = ngs::encodeMVT(ngs::FlatVectorTile(points), extent,
+                                           "points", wkbPoint);
+    ASSERT_NE(buffer, nullptr);
+    ngs::VectorTile decoded;
+    ASSERT_EQ(ngs::decodeMVT(buffer->data(), static_cast<size_t>(buffer->size()),
+                             extent, "points", columns, decoded), true);
+    ASSERT_EQ(decoded.itemCount(), 3);
+    EXPECT_EQ(decoded.items()[2].isIdsPresent(ngs::FeatureIDs({2, 3})), true);
+    EXPECT_FLOAT_EQ(decoded.items()[1].point(0).x, 100.0f);
+    EXPECT_FLOAT_EQ(decoded.items()[1].point(0).y, 200.0f);
+
+    ngs::FlatVectorTile flatTile(decoded);
+    ASSERT_EQ(flatTile.columnCount(), 2);
+    EXPECT_EQ(flatTile.item(0).attributeString(0), "even");
+    EXPECT_DOUBLE_EQ(flatTile.item(0).attributeNumber(1), -5.0);
+    EXPECT_TRUE(flatTile.item(1).isAttributeNull(1));
+
+    // Without columns the layer keys are columns
+    ngs::VectorTile keys;
+    ASSERT_EQ(ngs::decodeMVT(buffer->data(), static_cast<size_t>(buffer->size()),
+                             extent, "", ngs::TileColumnsPtr(), keys), true);
+    flatTile = ngs::FlatVectorTile(keys);
+    EXPECT_EQ(flatTile.columnIndex(ngs::CLUSTER_COUNT_FIELD), 2);
+    EXPECT_DOUBLE_EQ(flatTile.item(2).attributeNumber(2), 2.0);
+
+    // Line
+    ngs::VectorTile lines;
+    ngs::VectorTileItem line;
+    line.addId(10);
+    line.addPoint({0.0f, 0.0f});
+    line.addPoint({100.0f, 100.0f});
+    line.addPoint({200.0f, 0.0f});
+    line.setValid(true);
+    lines.add(line);
+    buffer = ngs::encodeMVT(ngs::FlatVectorTile(lines), extent, "lines",
+                            wkbLineString);
+    ASSERT_NE(buffer, nullptr);
+    decoded = ngs::VectorTile();
+    ASSERT_EQ(ngs::decodeMVT(buffer->data(), static_cast<size_t>(buffer->size()),
+                             extent, "lines", nullptr, decoded), true);
+    ASSERT_EQ(decoded.itemCount(), 1);
+    EXPECT_EQ(decoded.items()[0].pointCount(), 3);
+    EXPECT_FLOAT_EQ(decoded.items()[0].point(2).x, 200.0f);
+
+    // Polygon with hole
+    std::vector<std::vector<ngs::SimplePoint>> rings = {
+        {{0.0f, 0.0f}, {100.0f, 0.0f}, {100.0f, 100.0f}, {0.0f, 100.0f}},
+        {{40.0f, 40.0f}, {40.0f, 60.0f}, {60.0f, 60.0f}, {60.0f, 40.0f}}
+    };
+    ngs::VectorTileItemArray items;
+    ngs::fillPolygonTile(20, rings, items);
+    ngs::VectorTile polygons;
+    polygons.add(items);
+    buffer = ngs::encodeMVT(ngs::FlatVectorTile(polygons), extent, "polygons",
+                            wkbPolygon);
+    ASSERT_NE(buffer, nullptr);
+    decoded = ngs::VectorTile();
+    ASSERT_EQ(ngs::decodeMVT(buffer->data(), static_cast<size_t>(buffer->size()),
+                             extent, "polygons", nullptr, decoded), true);
+    ASSERT_EQ(decoded.itemCount(), 1);
+    EXPECT_EQ(decoded.items()[0].borderIndices().size(), 2);
+    EXPECT_EQ(decoded.items()[0].indices().empty(), false);
+    EXPECT_EQ(decoded.items()[0].isIdsPresent(ngs::FeatureIDs({20})), true);
+
+    // Nothing to encode
+    EXPECT_EQ(ngs::encodeMVT(ngs::FlatVectorTile(), extent, "empty", wkbPoint),
+              nullptr);
+    EXPECT_EQ(ngs::decodeMVT(nullptr, 0, extent, "", nullptr, decoded), false);
+}
+
+TEST(GlTests, TestTileCache) {
+    ngs::VectorTile vtile;
+    ngs::VectorTileItem vitem;
+    vitem.addPoint({1.0f, 2.0f});
+    vitem.addId(777);
+    vitem.setValid(true);
+    vtile.add(vitem);
+    ngs::FlatVectorTile ftile(vtile);
+
+    int owner1 = 0, owner2 = 0;
+    ngs::Tile tile1 = {1, 1, 1, 0};
+    ngs::Tile tile2 = {2, 1, 1, 0};
+    ngs::TileCache &cache = ngs::TileCache::instance();
+    size_t maxSize = cache.maxSize();
+    cache.clear();
+    cache.setMaxSize(1024 * 1024);
+    cache.put(&owner1, tile1, ftile);
+    cache.put(&owner1, tile2, ftile);
+    cache.put(&owner2, tile1, ftile);
+
+    ngs::FlatVectorTile out;
+    EXPECT_EQ(cache.get(&owner1, tile1, out), true);
+    EXPECT_EQ(out.itemCount(), 1);
+    EXPECT_FLOAT_EQ(out.item(0).point(0).y, 2.0f);
+    size_t tileSize = out.dataSize();
+
+    cache.remove(&owner1);
+    EXPECT_EQ(cache.get(&owner1, tile1, out), false);
+    EXPECT_EQ(cache.get(&owner2, tile1, out), true);
+    EXPECT_EQ(cache.size(), tileSize);
+
+    // Least recently used tile is evicted first
+    cache.put(&owner1, tile1, ftile);
+    cache.put(&owner1, tile2, ftile);
+    cache.get(&owner2, tile1, out);
+    cache.setMaxSize(tileSize * 2);
+    EXPECT_EQ(cache.get(&owner1, tile1, out), false);
+    EXPECT_EQ(cache.get(&owner1, tile2, out), true);
+    EXPECT_EQ(cache.get(&owner2, tile1, out), true);
+
+    // Tile read before the owner removal is not put
+    GUIntBig generation = cache.generation(&owner2);
+    cache.remove(&owner2);
+    cache.put(&owner2, tile2, ftile, generation);
+    EXPECT_EQ(cache.get(&owner2, tile2, out), false);
+    cache.put(&owner2, tile2, ftile, cache.generation(&owner2));
+    EXPECT_EQ(cache.get(&owner2, tile2, out), true);
+
+    // Released owner tiles are removed
+    cache.release(&owner2);
+    EXPECT_EQ(cache.get(&owner2, tile2, out), false);
+
+    // Tile read before clear is not put
+    generation = cache.generation(&owner1);
+    cache.clear();
+    cache.put(&owner1, tile1, ftile, generation);
+    EXPECT_EQ(cache.get(&owner1, tile1, out), false);
+
+    cache.clear();
+    cache.setMaxSize(maxSize);
+}
+
+TEST(GlTests, TestImageCache) {
+    ngs::ImageCache &cache = ngs::ImageCache::instance();
+    size_t maxSize = cache.maxSize();
+    cache.clear();
+    cache.setMaxSize(32);
+
+    std::string key1 = ngs::ImageCache::key("/tmp/1.tif", -1, 0, 0, 2, 2, "");
+    std::string key2 = ngs::ImageCache::key("/tmp/1.tif", 0, 0, 0, 2, 2, "");
+    std::vector<GByte> image(16, 7), out(16, 0);
+    cache.put(key1, image.data(), image.size());
+    EXPECT_EQ(cache.get(key1, out.data(), out.size()), true);
+    EXPECT_EQ(out[15], 7);
+    EXPECT_EQ(cache.get(key1, out.data(), 8), false);
+    EXPECT_EQ(cache.get(key2, out.data(), out.size()), false);
+
+    // Least recently used image is evicted first
+    cache.put(key2, image.data(), image.size());
+    cache.get(key1, out.data(), out.size());
+    cache.put(ngs::ImageCache::key("/tmp/2.tif", -1, 0, 0, 2, 2, ""),
+              image.data(), image.size());
+    EXPECT_EQ(cache.size(), 32);
+    EXPECT_EQ(cache.get(key1, out.data(), out.size()), true);
+    EXPECT_EQ(cache.get(key2, out.data(), out.size()), false);
+
+    cache.clear();
+    cache.setMaxSize(maxSize);
+}
+
+TEST(GlTests, TestMemoryBudget) {
+    ngs::VectorTile vtile;
+    ngs::VectorTileItem vitem;
+    vitem.addPoint({1.0f, 2.0f});
+    vitem.addId(777);
+    vitem.setValid(true);
+    vtile.add(vitem);
+    ngs::FlatVectorTile ftile(vtile);
+
+    int owner = 0;
+    ngs::Tile tile = {1, 1, 1, 0};
+    ngs::TileCache &tileCache = ngs::TileCache::instance();
+    ngs::ImageCache &imageCache = ngs::ImageCache::instance();
+    ngs::MemoryBudget &budget = ngs::MemoryBudget::instance();
+    size_t tileCacheSize = tileCache.maxSize();
+    size_t imageCacheSize = imageCache.maxSize();
+    size_t budgetSize = budget.maxSize();
+    tileCache.setMaxSize(1024 * 1024);
+    imageCache.setMaxSize(1024 * 1024);
+    budget.setMaxSize(0);
+    budget.setGlMemory(0);
+    budget.trim(0);
+    EXPECT_EQ(budget.size(), 0);
+
+    std::string key = ngs::ImageCache::key("/tmp/1.tif", -1, 0, 0, 2, 2, "");
+    std::vector<GByte> image(16, 7), out(16, 0);
+    ngs::FlatVectorTile outTile;
+    tileCache.put(&owner, tile, ftile);
+    imageCache.put(key, image.data(), image.size());
+    EXPECT_EQ(budget.size(), tileCache.size() + image.size());
+
+    // Least recently drawn data is freed first whatever cache holds it
+    tileCache.get(&owner, tile, outTile);
+    budget.trim(budget.size() - 1);
+    EXPECT_EQ(imageCache.get(key, out.data(), out.size()), false);
+    EXPECT_EQ(tileCache.get(&owner, tile, outTile), true);
+
+    imageCache.put(key, image.data(), image.size());
+    unsigned int trimGeneration = budget.trimGeneration();
+    budget.onPressure(MP_CRITICAL);
+    EXPECT_EQ(budget.size(), 0);
+    EXPECT_NE(budget.trimGeneration(), trimGeneration);
+
+    // Budget is enforced on put
+    tileCache.put(&owner, tile, ftile);
+    budget.setMaxSize(tileCache.size());
+    imageCache.put(key, image.data(), image.size());
+    EXPECT_EQ(tileCache.get(&owner, tile, outTile), false);
+    EXPECT_EQ(imageCache.get(key, out.data(), out.size()), true);
+
+    budget.setMaxSize(budgetSize);
+    tileCache.clear();
+    tileCache.setMaxSize(tileCacheSize);
+    imageCache.clear();
+    imageCache.setMaxSize(imageCacheSize);
+}
+
+TEST(GlTests, TestColorRamp) {
+    ngs::ColorRamp ramp;
+    ramp.setStops({ { 200.0, { 255, 0, 0, 255 } }, { 0.0, { 0, 0, 0, 255 } } });
+    float values[4] = { -10.0f, 0.0f, 200.0f, -9999.0f };
+    GLubyte rgba[16] = { 0 };
+    ramp.apply(values, 4, rgba, true, -9999.0f);
+    EXPECT_EQ(rgba[0], 0);     // Below range gets first color
+    EXPECT_EQ(rgba[3], 255);
+    EXPECT_EQ(rgba[8], 255);   // Last stop
+    EXPECT_EQ(rgba[15], 0);    // No data is transparent
+
+    // Flat area is lit the same as the light altitude gives
+    float heights[9] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+    GLubyte pixels[36];
+    std::memset(pixels, 200, sizeof(pixels));
+    ngs::applyHillshade(heights, 3, 3, 1.0, 1.0, pixels);
+    EXPECT_EQ(pixels[16] < 200, true);
+    EXPECT_EQ(pixels[16], pixels[0]);
+    EXPECT_EQ(pixels[19], 200); // Alpha is not changed
+}
+
+TEST(GlTests, TestHeatmapStyle) {
+    ngs::HeatmapStyle style;
+    CPLJSONObject empty;
+    EXPECT_EQ(style.load(empty), true);
+    EXPECT_EQ(style.pointVerticesCount(), 1u);
+    EXPECT_EQ(style.save().GetDouble("size"), 20.0);
+    EXPECT_EQ(style.save().GetArray("color_ramp").Size(), 6);
+
+    CPLJSONObject store;
+    store.Add("size", 8.0);
+    store.Add("intensity", 0.5);
+    CPLJSONArray ramp;
+    CPLJSONObject stop;
+    stop.Add("value", 1.0);
+    stop.Add("color", "#FF0000FF");
+    ramp.Add(stop);
+    store.Add("color_ramp", ramp);
+    EXPECT_EQ(style.load(store), true);
+    CPLJSONObject out = style.save();
+    EXPECT_EQ(out.GetDouble("size"), 8.0);
+    EXPECT_EQ(out.GetDouble("intensity"), 0.5);
+    EXPECT_EQ(out.GetArray("color_ramp").Size(), 1);
+    EXPECT_EQ(style.name(), "heatmap");
+}
+
+TEST(GlTests, TestRectClip) {
+    ngs::Envelope env(0.0, 0.0, 10.0, 10.0);
+
+    // Line leaves and enters rectangle
+    std::vector<OGRRawPoint> line = { {-5.0, 5.0}, {5.0, 5.0}, {5.0, 15.0},
+                                      {8.0, 15.0}, {8.0, 5.0} };
+    std::vector<std::vector<OGRRawPoint>> parts;
+    ngs::clipLineByRect(line, env, parts);
+    ASSERT_EQ(parts.size(), 2);
+    EXPECT_DOUBLE_EQ(parts[0].front().x, 0.0);
+    EXPECT_DOUBLE_EQ(parts[0].back().y, 10.0);
+    EXPECT_EQ(parts[1].size(), 2);
+    EXPECT_DOUBLE_EQ(parts[1].front().y, 10.0);
+
+    // Polygon overlapping rectangle corner
+    std::vector<OGRRawPoint> ring = { {5.0, 5.0}, {15.0, 5.0}, {15.0, 15.0},
+                                      {5.0, 15.0}, {5.0, 5.0} };
+    std::vector<OGRRawPoint> clipped;
+    EXPECT_EQ(ngs::clipRingByRect(ring, env, clipped), true);
+    EXPECT_EQ(clipped.size(), 5);
+    for(const OGRRawPoint &pt : clipped) {
+        EXPECT_LE(pt.x, 10.0);
+        EXPECT_LE(pt.y, 10.0);
+    }
+
+    // Polygon out of rectangle
+    ring = { {20.0, 20.0}, {30.0, 20.0}, {30.0, 30.0}, {20.0, 20.0} };
+    EXPECT_EQ(ngs::clipRingByRect(ring, env, clipped), false);
+}
+
+TEST(GlTests, TestGEOSThreadContext) {
+    ngs::GEOSContextHandlePtr handle = ngs::GEOSContextHandlePtr::threadContext();
+    EXPECT_EQ(handle.get(), ngs::GEOSContextHandlePtr::threadContext().get());
+
+    GEOSContextHandle_t otherHandle = nullptr;
+    std::thread other([&otherHandle]() {
+        otherHandle = ngs::GEOSContextHandlePtr::threadContext().get();
+    });
+    other.join();
+    EXPECT_NE(otherHandle, nullptr);
+    EXPECT_NE(otherHandle, handle.get());
+}
+
+TEST(GlTests, TestPolygonFill) {
+    OGRLinearRing exterior;
+    exterior.addPoint(0.0, 0.0);
+    exterior.addPoint(10.0, 0.0);
+    exterior.addPoint(10.0, 10.0);
+    exterior.addPoint(0.0, 10.0);
+    exterior.closeRings();
+    OGRLinearRing hole;
+    hole.addPoint(2.0, 2.0);
+    hole.addPoint(2.0, 4.0);
+    hole.addPoint(4.0, 4.0);
+    hole.addPoint(4.0, 2.0);
+    hole.closeRings();
+    OGRPolygon polygon;
+    polygon.addRing(&exterior);
+    polygon.addRing(&hole);
+
+    ngs::GEOSGeometryWrap geom(&polygon);
+    ngs::VectorTileItemArray items;
+    geom.fillTile(1, items);
+    ASSERT_EQ(items.size(), 1);
+    // Triangles and borders share the ring vertices
+    EXPECT_EQ(items[0].points().size(), 8);
+    EXPECT_EQ(items[0].indices().size(), 24);
+    ASSERT_EQ(items[0].borderIndices().size(), 2);
+    EXPECT_EQ(items[0].borderIndices()[1].front(), 4);
+    EXPECT_EQ(items[0].borderIndices()[1].back(), 4);
+}
+
+TEST(GlTests, TestEnvelopeArray) {
+    ngs::EnvelopeArray envelopes;
+    envelopes.add(ngs::Envelope(0.0, 0.0, 10.0, 10.0));
+    envelopes.add(ngs::Envelope(20.0, 20.0, 30.0, 30.0));
+    envelopes.add(ngs::Envelope(5.0, 5.0, 25.0, 25.0));
+
+    std::vector<GByte> mask;
+    envelopes.intersects(ngs::Envelope(9.0, 9.0, 11.0, 11.0), mask);
+    ASSERT_EQ(mask.size(), 3);
+    EXPECT_EQ(mask[0], 1);
+    EXPECT_EQ(mask[1], 0);
+    EXPECT_EQ(mask[2], 1);
+
+    // Results are added to the mask
+    envelopes.contains(ngs::Envelope(21.0, 21.0, 22.0, 22.0), mask);
+    EXPECT_EQ(mask[1], 1);
+}
+
+TEST(GlTests, TestSnapIndex) {
+    ngs::VectorTile vtile;
+
+    ngs::VectorTileItem line;
+    line.addPoint({0.0f, 0.0f});
+    line.addPoint({10.0f, 0.0f});
+    line.addPoint({10.0f, 10.0f});
+    line.addId(1);
+    line.setValid(true);
+    vtile.add(line);
+
+    ngs::VectorTileItem other;
+    other.addPoint({100.0f, 100.0f});
+    other.addPoint({90.0f, 100.0f});
+    other.addId(2);
+    other.setValid(true);
+    vtile.add(other);
+
+    ngs::BufferPtr buffer = vtile.save();
+    buffer->seek(0);
+    ngs::FlatVectorTile ftile;
+    ASSERT_EQ(ftile.load(*buffer.get()), true);
+    ngs::SnapIndex index(ftile, ST_LINE);
+    ngs::FeatureIDs skipIds;
+
+    // Vertex takes precedence over closer segment
+    ngs::SnapResult result;
+    index.snap(OGRRawPoint(9.0, 0.5), 2.0, skipIds, result);
+    ASSERT_EQ(result.found, true);
+    EXPECT_EQ(result.vertex, true);
+    EXPECT_DOUBLE_EQ(result.point.x, 10.0);
+    EXPECT_DOUBLE_EQ(result.point.y, 0.0);
+
+    ngs::SnapResult segmentResult;
+    index.snap(OGRRawPoint(5.0, 1.0), 2.0, skipIds, segmentResult);
+    ASSERT_EQ(segmentResult.found, true);
+    EXPECT_EQ(segmentResult.vertex, false);
+    EXPECT_DOUBLE_EQ(segmentResult.point.x, 5.0);
+    EXPECT_DOUBLE_EQ(segmentResult.point.y, 0.0);
+
+    ngs::SnapResult farResult;
+    index.snap(OGRRawPoint(50.0, 50.0), 2.0, skipIds, farResult);
+    EXPECT_EQ(farResult.found, false);
+
+    // Hidden features are not snapped
+    skipIds.insert(1);
+    ngs::SnapResult skipResult;
+    index.snap(OGRRawPoint(5.0, 1.0), 2.0, skipIds, skipResult);
+    EXPECT_EQ(skipResult.found, false);
+}
+
+TEST(GlTests, TestLabelPlacement) {
+    std::vector<unsigned int> glyphs = ngs::labelGlyphs("A\xD0\x96\xE2\x82\xAC\xC0");
+    ASSERT_EQ(glyphs.size(), 4);
+    EXPECT_EQ(glyphs[0], 0x41);
+    EXPECT_EQ(glyphs[1], 0x416);
+    EXPECT_EQ(glyphs[2], 0x20AC);
+    EXPECT_EQ(glyphs[3], 0xFFFD);
+
+    ngs::LabelCollisionIndex index;
+    index.reset(256.0, 256.0);
+    EXPECT_EQ(index.insert(ngs::Envelope(10.0, 10.0, 100.0, 30.0)), true);
+    // Overlap in other grid cell
+    EXPECT_EQ(index.insert(ngs::Envelope(90.0, 20.0, 150.0, 40.0)), false);
+    EXPECT_EQ(index.insert(ngs::Envelope(110.0, 20.0, 150.0, 40.0)), true);
+    EXPECT_EQ(index.insert(ngs::Envelope(-20.0, 200.0, 300.0, 220.0)), true);
+
+    index.reset(256.0, 256.0);
+    EXPECT_EQ(index.insert(ngs::Envelope(90.0, 20.0, 150.0, 40.0)), true);
+}
+
+TEST(GlTests, TestTileRange) {
+    ngs::Envelope extent(-1000000.0, -1000000.0, 1000000.0, 1000000.0);
+    ngs::TileRange range(extent, 4, false, true);
+    std::vector<ngs::TileItem> items =
+            ngs::MapTransform::getTilesForExtent(extent, 4, false, true);
+    ASSERT_EQ(range.size(), items.size());
+    size_t index = 0;
+    for(const ngs::TileItem &item : range) {
+        EXPECT_EQ(item.tile, items[index].tile);
+        EXPECT_DOUBLE_EQ(item.env.minX(), items[index].env.minX());
+        EXPECT_DOUBLE_EQ(item.env.maxY(), items[index].env.maxY());
+        ++index;
+    }
+
+    // Same grid while extent moves inside tiles
+    ngs::Envelope moved = extent;
+    moved.move(1000.0, 1000.0);
+    EXPECT_EQ(range, ngs::TileRange(moved, 4, false, true));
+    EXPECT_NE(range, ngs::TileRange(extent, 5, false, true));
+}
+
+TEST(GlTests, TestEditUndoRedo) {
+    ngs::EditLine line;
+    line.init(0.0, 0.0, 1.0, 1.0);
+    line.addPoint(2.0, 2.0);
+    line.addPoint(3.0, 3.0);
+    ASSERT_EQ(line.data().size(), 4);
+
+    EXPECT_TRUE(line.undo());
+    EXPECT_EQ(line.data().size(), 3);
+    EXPECT_TRUE(line.undo());
+    EXPECT_EQ(line.data().size(), 2);
+    EXPECT_FALSE(line.canUndo());
+
+    EXPECT_TRUE(line.redo());
+    EXPECT_TRUE(line.redo());
+    ASSERT_EQ(line.data().size(), 4);
+    EXPECT_DOUBLE_EQ(line.data()[3].x, 3.0);
+    EXPECT_FALSE(line.canRedo());
+
+    // New edit drops redo steps
+    EXPECT_TRUE(line.undo());
+    line.addPoint(4.0, 4.0);
+    EXPECT_FALSE(line.canRedo());
+    EXPECT_TRUE(line.undo());
+    EXPECT_EQ(line.data().size(), 3);
+}
+
+TEST(GlTests, TestEditVertexIndex) {
+    ngs::EditLine line;
+    line.init(0.0, 0.0, 1.0, 0.0);
+    for(int i = 2; i < 1000; ++i) {
+        line.addPoint(i, 0.0, false);
+    }
+
+    ngsPointId id = line.touch(OGRRawPoint(500.1, 0.1), MTT_SINGLE, 0.3);
+    EXPECT_EQ(id.pointId, 500);
+    id = line.touch(OGRRawPoint(500.5, 5.0), MTT_SINGLE, 0.3);
+    EXPECT_EQ(id.pointId, NOT_FOUND);
+
+    // Segment middle point is inserted
+    id = line.touch(OGRRawPoint(250.5, 0.05), MTT_SINGLE, 0.2);
+    EXPECT_EQ(id.pointId, 251);
+    ASSERT_EQ(line.data().size(), 1001);
+    EXPECT_DOUBLE_EQ(line.data()[251].x, 250.5);
+
+    // Moved vertex is found at new place
+    line.touch(OGRRawPoint(250.5, 0.0), MTT_ON_DOWN, 0.2);
+    line.touch(OGRRawPoint(250.5, 3.0), MTT_ON_MOVE, 0.2);
+    line.touch(OGRRawPoint(250.5, 6.0), MTT_ON_UP, 0.2);
+    id = line.touch(OGRRawPoint(250.5, 6.1), MTT_SINGLE, 0.2);
+    EXPECT_EQ(id.pointId, 251);
+}
+
+TEST(GlTests, TestSimplify) {
+    std::vector<OGRRawPoint> line = { {0.0, 0.0}, {1.0, 0.1}, {2.0, -0.1},
+                                      {3.0, 5.0}, {4.0, 6.0}, {5.0, 7.0} };
+    ngs::simplifyDouglasPeucker(line, 0.5, false);
+    ASSERT_EQ(line.size(), 4);
+    EXPECT_DOUBLE_EQ(line[2].x, 3.0);
+    EXPECT_DOUBLE_EQ(line[3].x, 5.0);
+
+    line = { {0.1, 0.1}, {0.2, 0.2}, {1.1, 1.1}, {1.2, 1.2}, {2.1, 0.1} };
+    ngs::snapToGrid(line, 1.0, false);
+    EXPECT_EQ(line.size(), 3);
+}
+
+TEST(GlTests, TestFillTileFromOGR) {
+    OGRLineString line;
+    line.addPoint(0.1, 0.1);
+    line.addPoint(0.2, 0.2);
+    line.addPoint(1.1, 1.1);
+    line.addPoint(1.2, 1.2);
+    line.addPoint(2.1, 0.1);
+
+    // Same items as GEOS simplify and fill
+    ngs::VectorTileItemArray items;
+    EXPECT_EQ(ngs::fillTileFromOGR(1, &line, 1.0,
+                                   ngs::GEOSGeometryWrap::SimplifyType::GRID,
+                                   items), true);
+    ngs::GEOSGeometryWrap geom(&line);
+    geom.simplify(1.0);
+    ngs::VectorTileItemArray geosItems;
+    geom.fillTile(1, geosItems);
+    ASSERT_EQ(items.size(), 1);
+    ASSERT_EQ(geosItems.size(), 1);
+    EXPECT_EQ(items[0].points().size(), 3);
+    EXPECT_EQ(items[0] == geosItems[0], true);
+
+    // Polygons and collapsed lines go through GEOS
+    OGRLinearRing ring;
+    ring.addPoint(0.0, 0.0);
+    ring.addPoint(1.0, 0.0);
+    ring.addPoint(1.0, 1.0);
+    ring.closeRings();
+    OGRPolygon polygon;
+    polygon.addRing(&ring);
+    items.clear();
+    EXPECT_EQ(ngs::fillTileFromOGR(1, &polygon, 1.0,
+                                   ngs::GEOSGeometryWrap::SimplifyType::GRID,
+                                   items), false);
+    EXPECT_EQ(ngs::fillTileFromOGR(1, &line, 10.0,
+                                   ngs::GEOSGeometryWrap::SimplifyType::GRID,
+                                   items), false);
+    EXPECT_EQ(items.empty(), true);
+}
+
 /*
 TEST(GlTests, TestCreate) {
 #ifdef OFFSCREEN_GL
@@ -21,14 +21,30 @@
 
 #include "test.h"
 
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <fstream>
+#include <thread>
 
 // gdal
 #include "cpl_string.h"
 
 #include "api_priv.h"
+#include "ds/coordinatetransformation.h"
+#include "ds/featureclass.h"
 #include "ds/geometry.h"
+#include "ds/memcolumnar.h"
+#include "ds/store.h"
+#include "ds/tablecursor.h"
+#include "map/styleexpression.h"
+#include "util/error.h"
+#include "util/mpscqueue.h"
+#include "util/mutex.h"
+#include "util/progress.h"
+#include "util/stringutil.h"
+#include "util/threadpool.h"
+#include "util/trace.h"
 #include "ngstore/api.h"
 #include "ngstore/version.h"
 
@@ -98,6 +114,321 @@ TEST(BasicTests, TestInlines) {
     EXPECT_EQ(color.A, newColor.A);
 }
 
+static int progressCancelAfter(enum ngsCode /*status*/, double /*complete*/,
+                               const char* /*message*/, void* progressArguments)
+{
+    int *calls = static_cast<int*>(progressArguments);
+    return ++(*calls) < 10 ? TRUE : FALSE;
+}
+
+TEST(BasicTests, TestProgressThrottle) {
+    int calls = 0;
+    ngs::Progress progress(progressCancelAfter, &calls);
+    int canceledAt = -1;
+    for(int i = 0; i < 100000; ++i) {
+        if(!progress.onProgress(COD_IN_PROCESS, i / 100000.0, "Row %d", i)) {
+            canceledAt = i;
+            break;
+        }
+    }
+    // One callback per 1% of complete value
+    EXPECT_EQ(calls, 10);
+    EXPECT_GE(canceledAt, 9000);
+    EXPECT_TRUE(progress.isCanceled());
+
+    // Copy shares the cancel state, warnings are never throttled
+    ngs::Progress copy(progress);
+    EXPECT_TRUE(copy.isCanceled());
+    EXPECT_FALSE(copy.onProgress(COD_WARNING, 0.1, "Warning"));
+    EXPECT_EQ(calls, 11);
+}
+
+TEST(BasicTests, TestErrorState) {
+    unsigned long count = ngsGetErrorCount(COD_REQUEST_FAILED);
+    ngs::resetError();
+    ngs::outMessage(COD_REQUEST_FAILED, "Tile %d failed", 1);
+    EXPECT_STREQ(ngsGetLastErrorMessage(), "Tile 1 failed");
+
+    // Other thread has own last message
+    std::thread worker([]() {
+        EXPECT_STREQ(ngs::getLastError(), "");
+        ngs::outMessage(COD_REQUEST_FAILED, "Tile %d failed", 2);
+    });
+    worker.join();
+    EXPECT_STREQ(ngsGetLastErrorMessage(), "Tile 1 failed");
+    EXPECT_EQ(ngsGetErrorCount(COD_REQUEST_FAILED), count + 2);
+
+    // Long message is truncated
+    std::string longMessage(4096, 'x');
+    ngs::errorMessage("%s", longMessage.c_str());
+    EXPECT_LT(std::string(ngs::getLastError()).size(), longMessage.size());
+    ngs::resetError();
+    EXPECT_STREQ(ngs::getLastError(), "");
+}
+
+TEST(BasicTests, TestTrace) {
+    ngs::Trace::instance().setEnabled(true);
+    ngs::Trace::instance().clear();
+    {
+        ngsTraceSpan("test span");
+    }
+    ngs::Trace::instance().setEnabled(false);
+    {
+        ngsTraceSpan("skipped span");
+    }
+    std::string json = ngs::Trace::instance().toJSON();
+    EXPECT_NE(json.find("\"name\":\"test span\""), std::string::npos);
+    EXPECT_EQ(json.find("skipped span"), std::string::npos);
+    ngs::Trace::instance().clear();
+}
+
+TEST(BasicTests, TestLocks) {
+    ngs::SharedMutex mutex;
+    {
+        ngs::SharedHolder first(mutex);
+        EXPECT_TRUE(mutex.acquireShared(0.1));
+        mutex.releaseShared();
+        EXPECT_FALSE(mutex.acquire(0.05));
+    }
+    EXPECT_GE(mutex.stats().contended, 1u);
+
+    int value = 0;
+    ngs::SpinLock lock;
+    int counter = 0;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 4; ++i) {
+        threads.emplace_back([&mutex, &value, &lock, &counter]() {
+            for(int j = 0; j < 1000; ++j) {
+                {
+                    ngs::ExclusiveHolder holder(mutex);
+                    ++value;
+                }
+                ngs::SpinLockHolder holder(lock);
+                ++counter;
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(value, 4000);
+    EXPECT_EQ(counter, 4000);
+    EXPECT_EQ(lock.stats().acquired, 4000u);
+    lock.resetStats();
+    EXPECT_EQ(lock.stats().acquired, 0u);
+}
+
+TEST(BasicTests, TestMpscQueue) {
+    ngs::MpscQueue<std::pair<int, int>> queue;
+    std::vector<std::thread> producers;
+    for(int i = 0; i < 4; ++i) {
+        producers.emplace_back([&queue, i]() {
+            for(int j = 0; j < 10000; ++j) {
+                queue.push(std::make_pair(i, j));
+            }
+        });
+    }
+
+    // Items of one producer are taken in push order
+    std::vector<int> next(4, 0);
+    size_t count = 0;
+    bool ordered = true;
+    auto check = [&next, &ordered](std::pair<int, int> &item) {
+        ordered = ordered && item.second == next[item.first];
+        next[item.first] = item.second + 1;
+    };
+    while(count < 40000) {
+        count += queue.drain(check);
+    }
+    for(auto &producer : producers) {
+        producer.join();
+    }
+    EXPECT_TRUE(ordered);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(count, 40000u);
+}
+
+TEST(BasicTests, TestWorkerLimiter) {
+    ngs::WorkerLimiter &limiter = ngs::WorkerLimiter::instance();
+    unsigned char maxWorkers = limiter.maxWorkers();
+    int active = limiter.activeWorkers();
+    limiter.setMaxWorkers(static_cast<unsigned char>(active + 2));
+
+    // The last slot is kept for interactive workers
+    EXPECT_TRUE(limiter.acquire(ngs::WorkerClass::BACKGROUND, false));
+    EXPECT_FALSE(limiter.acquire(ngs::WorkerClass::BACKGROUND, false));
+    EXPECT_TRUE(limiter.acquire(ngs::WorkerClass::INTERACTIVE, false));
+    EXPECT_FALSE(limiter.acquire(ngs::WorkerClass::INTERACTIVE, false));
+    EXPECT_TRUE(limiter.acquire(ngs::WorkerClass::NETWORK, false));
+    EXPECT_TRUE(limiter.shouldYield(ngs::WorkerClass::BACKGROUND));
+    EXPECT_FALSE(limiter.shouldYield(ngs::WorkerClass::INTERACTIVE));
+
+    // The first pool worker starts over the cap
+    EXPECT_TRUE(limiter.acquire(ngs::WorkerClass::BACKGROUND, true));
+    EXPECT_EQ(limiter.activeWorkers(), active + 3);
+
+    limiter.release(ngs::WorkerClass::BACKGROUND);
+    limiter.release(ngs::WorkerClass::NETWORK);
+    limiter.release(ngs::WorkerClass::INTERACTIVE);
+    limiter.release(ngs::WorkerClass::BACKGROUND);
+    EXPECT_EQ(limiter.activeWorkers(), active);
+    limiter.setMaxWorkers(maxWorkers);
+}
+
+TEST(BasicTests, TestStringCompare) {
+    std::string name("Layer.SHP");
+    EXPECT_TRUE(ngs::compare(name, "layer.shp"));
+    EXPECT_FALSE(ngs::compare(name, "layer.shp", true));
+    EXPECT_FALSE(ngs::compare(name, "layer.sh"));
+    EXPECT_TRUE(ngs::compare(nullptr, ""));
+    EXPECT_TRUE(ngs::endsWith(name, ".shp"));
+    EXPECT_FALSE(ngs::endsWith(name, ".shp", true));
+    EXPECT_FALSE(ngs::endsWith("shp", ".shp"));
+    EXPECT_TRUE(ngs::startsWith(name, "LAYER"));
+    EXPECT_TRUE(ngs::comparePart(name, "layer.tab", 6));
+    EXPECT_FALSE(ngs::comparePart("lay", "layer", 4));
+    EXPECT_LT(ngs::compareStrings("abc", "ABD"), 0);
+    EXPECT_GT(ngs::compareStrings("abc", "AB"), 0);
+    EXPECT_EQ(ngs::compareStrings("abc", "ABC"), 0);
+    EXPECT_NE(ngs::compareStrings("abc", "ABC", true), 0);
+    // Not ASCII bytes are compared as is
+    EXPECT_TRUE(ngs::compare("\xD0\xA1\xD0\xBB\xD0\xBE\xD0\xB9",
+                             "\xD0\xA1\xD0\xBB\xD0\xBE\xD0\xB9"));
+    EXPECT_EQ(ngs::toLower("Name.TXT"), "name.txt");
+}
+
+TEST(BasicTests, TestCoordinateTransformationArray) {
+    initLib();
+    CoordinateTransformationH ct = ngsCoordinateTransformationCreate(4326, 3857);
+    ASSERT_NE(ct, nullptr);
+    ngsCoordinate coords[2] = {{37.6, 55.7, 0.0}, {0.0, 0.0, 0.0}};
+    ngsCoordinate single = ngsCoordinateTransformationDo(ct, coords[0]);
+    EXPECT_EQ(ngsCoordinateTransformationDoArray(ct, coords, 2), COD_SUCCESS);
+    EXPECT_DOUBLE_EQ(coords[0].X, single.X);
+    EXPECT_DOUBLE_EQ(coords[0].Y, single.Y);
+    EXPECT_NEAR(coords[1].X, 0.0, 0.001);
+    ngsCoordinateTransformationFree(ct);
+
+    // Freed transformation is reused from the cache
+    CoordinateTransformationH cached = ngsCoordinateTransformationCreate(4326,
+                                                                         3857);
+    EXPECT_EQ(cached, ct);
+    ngsCoordinateTransformationFree(cached);
+    ngsUnInit();
+}
+
+TEST(BasicTests, TestMercatorFastPath) {
+    initLib();
+    {
+        ngs::CachedTransformation forward(4326, 3857);
+        ngs::CachedTransformation inverse(3857, 4326);
+        ASSERT_TRUE(forward && inverse);
+        ASSERT_NE(forward->handle(), nullptr);
+        ASSERT_NE(inverse->handle(), nullptr);
+
+        std::vector<double> x, y;
+        for(double lon = -180.0; lon <= 180.0; lon += 7.5) {
+            for(double lat = -85.0; lat <= 85.0; lat += 2.5) {
+                x.push_back(lon);
+                y.push_back(lat);
+            }
+        }
+        int count = static_cast<int>(x.size());
+
+        // Compare with PROJ
+        std::vector<double> projX(x), projY(y);
+        EXPECT_TRUE(forward->transform(count, x.data(), y.data()));
+        forward->handle()->Transform(count, projX.data(), projY.data());
+        for(size_t i = 0; i < x.size(); ++i) {
+            EXPECT_NEAR(x[i], projX[i], 0.000001);
+            EXPECT_NEAR(y[i], projY[i], 0.000001);
+        }
+
+        EXPECT_TRUE(inverse->transform(count, x.data(), y.data()));
+        inverse->handle()->Transform(count, projX.data(), projY.data());
+        for(size_t i = 0; i < x.size(); ++i) {
+            EXPECT_NEAR(x[i], projX[i], 0.000000001);
+            EXPECT_NEAR(y[i], projY[i], 0.000000001);
+        }
+
+        double poleX = 0.0, poleY = 90.0;
+        EXPECT_FALSE(forward->transform(1, &poleX, &poleY));
+    }
+    ngsUnInit();
+}
+
+TEST(BasicTests, TestStyleExpression) {
+    OGRFeatureDefn *defn = new OGRFeatureDefn("test");
+    defn->Reference();
+    OGRFieldDefn typeField("type", OFTString);
+    defn->AddFieldDefn(&typeField);
+    OGRFieldDefn popField("pop", OFTInteger);
+    defn->AddFieldDefn(&popField);
+    {
+        OGRFeature feature(defn);
+        ngs::ExpressionContext context(10.0);
+        ngs::ExpressionValue value;
+        ngsRGBA color;
+
+        CPLJSONDocument doc;
+        ASSERT_TRUE(doc.LoadMemory(
+            "[\"match\", [\"get\", \"type\"], [\"river\", \"lake\"], \"#0000ff\","
+            " \"road\", [\"case\", [\">\", [\"get\", \"pop\"], 100], \"#ff0000\","
+            " \"#00ff00\"], \"#777777\"]"));
+        ngs::StyleExpression match;
+        ASSERT_TRUE(match.compile(doc.GetRoot()));
+        EXPECT_TRUE(match.isFeatureDependent());
+        EXPECT_FALSE(match.isZoomDependent());
+
+        feature.SetField("type", "lake");
+        context.setFeature(&feature);
+        ASSERT_TRUE(match.evaluate(context, value));
+        ASSERT_TRUE(value.toColor(color));
+        EXPECT_EQ(color.B, 255);
+
+        feature.SetField("type", "road");
+        feature.SetField("pop", 150);
+        context.setFeature(&feature);
+        ASSERT_TRUE(match.evaluate(context, value));
+        ASSERT_TRUE(value.toColor(color));
+        EXPECT_EQ(color.R, 255);
+        EXPECT_EQ(color.G, 0);
+
+        feature.SetField("pop", 50);
+        context.setFeature(&feature);
+        ASSERT_TRUE(match.evaluate(context, value));
+        ASSERT_TRUE(value.toColor(color));
+        EXPECT_EQ(color.G, 255);
+
+        feature.SetField("type", "path");
+        context.setFeature(&feature);
+        ASSERT_TRUE(match.evaluate(context, value));
+        ASSERT_TRUE(value.toColor(color));
+        EXPECT_EQ(color.R, 0x77);
+
+        ASSERT_TRUE(doc.LoadMemory(
+            "[\"interpolate\", [\"linear\"], [\"zoom\"], 5, 1, 15, 11]"));
+        ngs::StyleExpression zoom;
+        ASSERT_TRUE(zoom.compile(doc.GetRoot()));
+        EXPECT_FALSE(zoom.isFeatureDependent());
+        EXPECT_TRUE(zoom.isZoomDependent());
+        ASSERT_TRUE(zoom.evaluate(context, value));
+        EXPECT_DOUBLE_EQ(value.number, 6.0);
+
+        ASSERT_TRUE(doc.LoadMemory(
+            "[\"step\", [\"get\", \"pop\"], 1, 50, 2, 150, 3]"));
+        ngs::StyleExpression step;
+        ASSERT_TRUE(step.compile(doc.GetRoot()));
+        ASSERT_TRUE(step.evaluate(context, value));
+        EXPECT_DOUBLE_EQ(value.number, 2.0);
+
+        ASSERT_TRUE(doc.LoadMemory("[\"unknown\", 1]"));
+        ngs::StyleExpression invalid;
+        EXPECT_FALSE(invalid.compile(doc.GetRoot()));
+    }
+    defn->Release();
+}
+
 TEST(CatalogTests, TestCatalogQuery) {
     initLib();
 
@@ -153,6 +484,48 @@ TEST(CatalogTests, TestCatalogQuery) {
     ngsUnInit();
 }
 
+TEST(CatalogTests, TestCatalogQueryPaged) {
+    initLib();
+
+    std::string catalogPath = ngsCatalogPathFromSystem(CPLGetCurrentDir());
+    std::string dataPath = catalogPath + "/data";
+    CatalogObjectH dataObject = ngsCatalogObjectGet(dataPath.c_str());
+    ASSERT_NE(dataObject, nullptr);
+
+    ngsCatalogObjectInfo *pathInfo = ngsCatalogObjectQuery(dataObject, 0);
+    ASSERT_NE(pathInfo, nullptr);
+    int total = 0;
+    while(pathInfo[total].name) {
+        total++;
+    }
+    ngsFree(pathInfo);
+    ASSERT_GE(total, 2);
+
+    // Paging
+    pathInfo = ngsCatalogObjectQueryPaged(dataObject, nullptr, 0, nullptr, 1, 1);
+    ASSERT_NE(pathInfo, nullptr);
+    EXPECT_NE(pathInfo[0].name, nullptr);
+    EXPECT_EQ(pathInfo[1].name, nullptr);
+    ngsFree(pathInfo);
+
+    EXPECT_EQ(ngsCatalogObjectQueryPaged(dataObject, nullptr, 0, nullptr,
+                                         total, 0), nullptr);
+
+    // Name pattern
+    pathInfo = ngsCatalogObjectQueryPaged(dataObject, nullptr, 0, "RAILWAY.*",
+                                          0, 0);
+    ASSERT_NE(pathInfo, nullptr);
+    int count = 0;
+    while(pathInfo[count].name) {
+        EXPECT_EQ(std::string(pathInfo[count].name).compare(0, 8, "railway."), 0);
+        count++;
+    }
+    EXPECT_GE(count, 1);
+    ngsFree(pathInfo);
+
+    ngsUnInit();
+}
+
 TEST(CatalogTests, TestCreate) {
     initLib();
 
@@ -608,6 +981,136 @@ TEST(DataStoreTests, TestCreateFeature) {
 
     EXPECT_EQ(ngsFeatureClassUpdateFeature(featureClass, newFeature, 1), COD_SUCCESS);
 
+    // 2D point ISO WKB: byte order, type and two coordinates
+    int wkbSize = ngsFeatureGetGeometryWKB(newFeature, nullptr, 0);
+    EXPECT_EQ(wkbSize, 21);
+    GByte wkb[21];
+    EXPECT_EQ(ngsFeatureGetGeometryWKB(newFeature, wkb, 8), wkbSize);
+    EXPECT_EQ(ngsFeatureGetGeometryWKB(newFeature, wkb, sizeof(wkb)), wkbSize);
+    double wkbX;
+    memcpy(&wkbX, wkb + 5, sizeof(double));
+    EXPECT_DOUBLE_EQ(wkbX, 37.5);
+
+    long long fids[2];
+    int types[2];
+    const char *descs[2];
+    double vals[2];
+    char valsSet[2];
+    ngsFieldColumn columns[3] = { {0, types, nullptr}, {1, descs, nullptr},
+                                  {2, vals, valsSet} };
+    ngsFeatureClassResetReading(featureClass);
+    EXPECT_EQ(ngsFeatureClassReadColumns(featureClass, fids, columns, 3, 2), 1);
+    EXPECT_EQ(fids[0], fid);
+    EXPECT_EQ(types[0], 500);
+    EXPECT_STREQ(descs[0], "Test");
+    EXPECT_EQ(valsSet[0], 1);
+    EXPECT_DOUBLE_EQ(vals[0], 555.777);
+    EXPECT_EQ(ngsFeatureClassReadColumns(featureClass, fids, columns, 3, 2), 0);
+    ngsFeatureClassResetReading(featureClass);
+
+    GByte page[4096];
+    EXPECT_EQ(ngsFeatureClassReadPage(featureClass, page, 8, 10, 1), -1);
+    EXPECT_EQ(ngsFeatureClassReadPage(featureClass, page, sizeof(page), 10, 1), 1);
+    GUInt32 pageCount;
+    GIntBig pageFid;
+    memcpy(&pageCount, page, sizeof(GUInt32));
+    memcpy(&pageFid, page + sizeof(GUInt32), sizeof(GIntBig));
+    EXPECT_EQ(pageCount, 1);
+    EXPECT_EQ(pageFid, fid);
+    EXPECT_EQ(ngsFeatureClassReadPage(featureClass, page, sizeof(page), 10, 1), 0);
+    ngsFeatureClassResetReading(featureClass);
+
+    // Cursors do not change the table read position and each other
+    ngs::Table *table = dynamic_cast<ngs::Table*>(
+                static_cast<ngs::Object*>(featureClass));
+    ASSERT_NE(table, nullptr);
+    ngs::TableCursorPtr cursor = table->cursor("type = 500", ngs::Envelope(),
+                                               {"desc"});
+    ASSERT_NE(cursor.get(), nullptr);
+    ngs::TableCursorPtr emptyCursor = table->cursor("type = 0");
+    ASSERT_NE(emptyCursor.get(), nullptr);
+    EXPECT_EQ(emptyCursor->next().get(), nullptr);
+    ngs::FeaturePtr cursorFeature = cursor->next();
+    ASSERT_NE(cursorFeature.get(), nullptr);
+    EXPECT_EQ(cursorFeature->GetFID(), fid);
+    EXPECT_STREQ(cursorFeature->GetFieldAsString("desc"), "Test");
+    EXPECT_EQ(cursorFeature->IsFieldSet(cursorFeature->GetFieldIndex("val")), 0);
+    EXPECT_EQ(cursor->next().get(), nullptr);
+    cursor->reset();
+    EXPECT_NE(cursor->next().get(), nullptr);
+    EXPECT_EQ(ngsFeatureClassReadColumns(featureClass, fids, columns, 3, 2), 1);
+    ngsFeatureClassResetReading(featureClass);
+    cursorFeature = ngs::FeaturePtr();
+    cursor.reset();
+    emptyCursor.reset();
+
+    // Count and extent follow edits
+    ngs::FeatureClass *fc = dynamic_cast<ngs::FeatureClass*>(table);
+    ASSERT_NE(fc, nullptr);
+    FeatureH farFeature = ngsFeatureClassCreateFeature(featureClass);
+    ASSERT_NE(farFeature, nullptr);
+    GeometryH farGeom = ngsFeatureCreateGeometry(farFeature);
+    ngsGeometrySetPoint(farGeom, 0, 40.0, 60.0, 0.0, 0.0);
+    ngsFeatureSetGeometry(farFeature, farGeom);
+    EXPECT_EQ(ngsFeatureClassInsertFeature(featureClass, farFeature, 0), COD_SUCCESS);
+    auto farFid = ngsFeatureGetId(farFeature);
+    ngsFeatureFree(farFeature);
+    EXPECT_EQ(ngsFeatureClassCount(featureClass), 2);
+    EXPECT_NEAR(fc->extent().maxX(), 40.0, 0.000001);
+    EXPECT_EQ(ngsFeatureClassDeleteFeature(featureClass, farFid, 0), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassCount(featureClass), 1);
+    EXPECT_EQ(table->featureCount(true), 1);
+    EXPECT_NEAR(fc->extent().maxX(), 37.5, 0.000001);
+    EXPECT_NEAR(fc->extent().maxY(), 55.1, 0.000001);
+
+    EXPECT_EQ(ngsFeatureClassCreateIndex(featureClass, "type"), COD_SUCCESS);
+    EXPECT_NE(ngsFeatureClassCreateIndex(featureClass, "no_field"), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassSetFilter(featureClass, nullptr, "type = 500"),
+              COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassCount(featureClass), 1);
+    EXPECT_EQ(ngsFeatureClassSetFilter(featureClass, nullptr, nullptr),
+              COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassDropIndex(featureClass, "type"), COD_SUCCESS);
+
+    // Remote id map follows edits
+    ngs::StoreObject *storeObject = dynamic_cast<ngs::StoreObject*>(table);
+    ASSERT_NE(storeObject, nullptr);
+    EXPECT_TRUE(storeObject->loadRemoteIds());
+    ngs::FeaturePtr ridFeature = table->getFeature(fid);
+    ASSERT_NE(ridFeature.get(), nullptr);
+    ngs::StoreObject::setRemoteId(ridFeature, 42);
+    EXPECT_TRUE(table->updateFeature(ridFeature, false));
+    ngs::FeaturePtr foundFeature = storeObject->getFeatureByRemoteId(42);
+    ASSERT_NE(foundFeature.get(), nullptr);
+    EXPECT_EQ(foundFeature->GetFID(), fid);
+    EXPECT_EQ(storeObject->getFeatureByRemoteId(43).get(), nullptr);
+    storeObject->clearRemoteIds();
+    EXPECT_NE(storeObject->getFeatureByRemoteId(42).get(), nullptr);
+
+    // Search index follows inserts
+    char **searchFields = CSLAddString(nullptr, "desc");
+    EXPECT_EQ(ngsFeatureClassCreateSearchIndex(featureClass, searchFields,
+                                               nullptr), COD_SUCCESS);
+    CSLDestroy(searchFields);
+    long long *found = ngsFeatureClassSearch(featureClass, "tes", 0, 10);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(found[0], fid);
+    EXPECT_EQ(found[1], -1);
+    ngsFree(found);
+    FeatureH searchFeature = ngsFeatureClassCreateFeature(featureClass);
+    ngsFeatureSetFieldString(searchFeature, 1, "Second test");
+    EXPECT_EQ(ngsFeatureClassInsertFeature(featureClass, searchFeature, 0), COD_SUCCESS);
+    auto searchFid = ngsFeatureGetId(searchFeature);
+    ngsFeatureFree(searchFeature);
+    found = ngsFeatureClassSearch(featureClass, "second TEST", 0, 10);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(found[0], searchFid);
+    EXPECT_EQ(found[1], -1);
+    ngsFree(found);
+    EXPECT_EQ(ngsFeatureClassDeleteFeature(featureClass, searchFid, 0), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassCreateSearchIndex(featureClass, nullptr, nullptr),
+              COD_SUCCESS);
+
     std::string testAttachmentPath = CPLFormFilename(testPath.c_str(),
                                                      "download.cmake", nullptr);
     long long id = ngsFeatureAttachmentAdd(newFeature, "test.txt",
@@ -867,9 +1370,236 @@ TEST(DataStoreTest, TestCreateMemoryDatasource) {
     CatalogObjectH newFC = ngsCatalogObjectGet(CPLString(storePath + "/test_mem.ngmem/new_layer"));
     EXPECT_NE(newFC, nullptr);
 
+    const char *geojson = "{\"type\":\"FeatureCollection\",\"features\":["
+        "{\"type\":\"Feature\",\"properties\":{\"type\":5,\"desc\":\"first\",\"val\":1.5},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[37.6,55.7]}},"
+        "{\"type\":\"Feature\",\"properties\":{\"type\":6,\"desc\":null},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[30.3,59.9]}}]}";
+    VSILFILE *fp = VSIFileFromMemBuffer("/vsimem/test_load.geojson",
+        reinterpret_cast<GByte*>(const_cast<char*>(geojson)), strlen(geojson),
+        FALSE);
+    VSIFCloseL(fp);
+    EXPECT_EQ(ngsFeatureClassLoadGeoJson(newFC, "/vsimem/test_load.geojson",
+                                         nullptr, nullptr, nullptr), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassCount(newFC), 2);
+    VSIUnlink("/vsimem/test_load.geojson");
+
+    // Loaded features are one created range
+    EXPECT_EQ(ngsFeatureClassChangeSequence(newFC), 2);
+    ngsChangeRange *changes = ngsFeatureClassChangesSince(newFC, 0);
+    ASSERT_NE(changes, nullptr);
+    EXPECT_EQ(changes[0].code, CC_CREATE_FEATURE);
+    EXPECT_EQ(changes[0].sequence, 2);
+    EXPECT_EQ(changes[0].toFid - changes[0].fromFid, 1);
+    EXPECT_LT(changes[0].extent.minX, changes[0].extent.maxX);
+    EXPECT_EQ(changes[1].code, CC_NOP);
+    ngsFree(changes);
+    changes = ngsFeatureClassChangesSince(newFC, 2);
+    ASSERT_NE(changes, nullptr);
+    EXPECT_EQ(changes[0].code, CC_NOP);
+    ngsFree(changes);
+
     ngsUnInit();
 }
 
+TEST(DataStoreTest, TestSpatialJoin) {
+    char** options = nullptr;
+    options = ngsListAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsListAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+
+    ngsListFree(options);
+    options = nullptr;
+
+    CPLString testPath = ngsGetCurrentDirectory();
+    CPLString catalogPath = ngsCatalogPathFromSystem(testPath);
+    CPLString storePath = catalogPath + "/tmp";
+    CatalogObjectH store = ngsCatalogObjectGet(storePath);
+
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_CONTAINER_MEM);
+    options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+    EXPECT_NE(ngsCatalogObjectCreate(store, "test_join", options), nullptr);
+    CatalogObjectH newStore = ngsCatalogObjectGet(CPLString(storePath + "/test_join.ngmem"));
+    ASSERT_NE(newStore, nullptr);
+    ngsListFree(options);
+    options = nullptr;
+
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_FC_MEM);
+    options = ngsListAddNameValue(options, "EPSG", "3857");
+    options = ngsListAddNameValue(options, "GEOMETRY_TYPE", "POLYGON");
+    options = ngsListAddNameValue(options, "FIELD_COUNT", "1");
+    options = ngsListAddNameValue(options, "FIELD_0_TYPE", "STRING");
+    options = ngsListAddNameValue(options, "FIELD_0_NAME", "zone");
+    EXPECT_NE(ngsCatalogObjectCreate(newStore, "zones", options), nullptr);
+    ngsListFree(options);
+    options = nullptr;
+
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_FC_MEM);
+    options = ngsListAddNameValue(options, "EPSG", "3857");
+    options = ngsListAddNameValue(options, "GEOMETRY_TYPE", "POINT");
+    options = ngsListAddNameValue(options, "FIELD_COUNT", "1");
+    options = ngsListAddNameValue(options, "FIELD_0_TYPE", "STRING");
+    options = ngsListAddNameValue(options, "FIELD_0_NAME", "zone");
+    EXPECT_NE(ngsCatalogObjectCreate(newStore, "points", options), nullptr);
+    ngsListFree(options);
+
+    CatalogObjectH zones = ngsCatalogObjectGet(CPLString(storePath + "/test_join.ngmem/zones"));
+    CatalogObjectH points = ngsCatalogObjectGet(CPLString(storePath + "/test_join.ngmem/points"));
+    ASSERT_NE(zones, nullptr);
+    ASSERT_NE(points, nullptr);
+
+    const char *zonesJson = "{\"type\":\"FeatureCollection\",\"features\":["
+        "{\"type\":\"Feature\",\"properties\":{\"zone\":\"west\"},"
+        "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[[0,0],[10,0],[10,10],[0,10],[0,0]]]}},"
+        "{\"type\":\"Feature\",\"properties\":{\"zone\":\"east\"},"
+        "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[[10,0],[20,0],[20,10],[10,10],[10,0]]]}}]}";
+    const char *pointsJson = "{\"type\":\"FeatureCollection\",\"features\":["
+        "{\"type\":\"Feature\",\"properties\":{},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[5,5]}},"
+        "{\"type\":\"Feature\",\"properties\":{},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[15,5]}},"
+        "{\"type\":\"Feature\",\"properties\":{\"zone\":\"old\"},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[25,5]}}]}";
+    VSILFILE *fp = VSIFileFromMemBuffer("/vsimem/test_zones.geojson",
+        reinterpret_cast<GByte*>(const_cast<char*>(zonesJson)),
+        strlen(zonesJson), FALSE);
+    VSIFCloseL(fp);
+    fp = VSIFileFromMemBuffer("/vsimem/test_points.geojson",
+        reinterpret_cast<GByte*>(const_cast<char*>(pointsJson)),
+        strlen(pointsJson), FALSE);
+    VSIFCloseL(fp);
+    EXPECT_EQ(ngsFeatureClassLoadGeoJson(zones, "/vsimem/test_zones.geojson",
+                                         nullptr, nullptr, nullptr), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassLoadGeoJson(points, "/vsimem/test_points.geojson",
+                                         nullptr, nullptr, nullptr), COD_SUCCESS);
+    VSIUnlink("/vsimem/test_zones.geojson");
+    VSIUnlink("/vsimem/test_points.geojson");
+
+    EXPECT_EQ(ngsFeatureClassSpatialJoin(points, zones, "zone", "zone", nullptr,
+                                         nullptr, nullptr), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassSpatialJoin(points, zones, "missing", "zone",
+                                         nullptr, nullptr, nullptr), COD_INVALID);
+    EXPECT_EQ(ngsFeatureClassSpatialJoin(zones, points, "zone", "zone", nullptr,
+                                         nullptr, nullptr), COD_INVALID);
+
+    std::map<std::string, int> joined;
+    ngsFeatureClassResetReading(points);
+    FeatureH feature = nullptr;
+    while((feature = ngsFeatureClassNextFeature(points)) != nullptr) {
+        if(ngsFeatureIsFieldSet(feature, 0) == 1) {
+            joined[ngsFeatureGetFieldAsString(feature, 0)]++;
+        }
+        else {
+            joined["null"]++;
+        }
+        ngsFeatureFree(feature);
+    }
+    EXPECT_EQ(joined["west"], 1);
+    EXPECT_EQ(joined["east"], 1);
+    EXPECT_EQ(joined["null"], 1);
+    EXPECT_EQ(joined.count("old"), 0);
+
+    ngsUnInit();
+}
+
+TEST(DataStoreTest, TestCreateColumnarMemoryDatasource) {
+    char** options = nullptr;
+    options = ngsListAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsListAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+
+    ngsListFree(options);
+    options = nullptr;
+
+    CPLString testPath = ngsGetCurrentDirectory();
+    CPLString catalogPath = ngsCatalogPathFromSystem(testPath);
+    CPLString storePath = catalogPath + "/tmp";
+    CatalogObjectH store = ngsCatalogObjectGet(storePath);
+
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_CONTAINER_MEM);
+    options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+    options = ngsListAddNameValue(options, "COLUMNAR", "ON");
+    EXPECT_NE(ngsCatalogObjectCreate(store, "test_columnar", options), nullptr);
+    CatalogObjectH newStore = ngsCatalogObjectGet(CPLString(storePath + "/test_columnar.ngmem"));
+    EXPECT_NE(newStore, nullptr);
+
+    ngsListFree(options);
+    options = nullptr;
+
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_FC_MEM);
+    options = ngsListAddNameValue(options, "EPSG", "4326");
+    options = ngsListAddNameValue(options, "GEOMETRY_TYPE", "POINT");
+    options = ngsListAddNameValue(options, "FIELD_COUNT", "2");
+    options = ngsListAddNameValue(options, "FIELD_0_TYPE", "INTEGER");
+    options = ngsListAddNameValue(options, "FIELD_0_NAME", "type");
+    options = ngsListAddNameValue(options, "FIELD_1_TYPE", "STRING");
+    options = ngsListAddNameValue(options, "FIELD_1_NAME", "desc");
+
+    EXPECT_NE(ngsCatalogObjectCreate(newStore, "new_layer", options), nullptr);
+    ngsListFree(options);
+
+    CatalogObjectH newFC = ngsCatalogObjectGet(CPLString(storePath + "/test_columnar.ngmem/new_layer"));
+    EXPECT_NE(newFC, nullptr);
+
+    const char *geojson = "{\"type\":\"FeatureCollection\",\"features\":["
+        "{\"type\":\"Feature\",\"properties\":{\"type\":5,\"desc\":\"first\"},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[37.6,55.7]}},"
+        "{\"type\":\"Feature\",\"properties\":{\"type\":6,\"desc\":null},"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[30.3,59.9]}}]}";
+    VSILFILE *fp = VSIFileFromMemBuffer("/vsimem/test_columnar.geojson",
+        reinterpret_cast<GByte*>(const_cast<char*>(geojson)), strlen(geojson),
+        FALSE);
+    VSIFCloseL(fp);
+    EXPECT_EQ(ngsFeatureClassLoadGeoJson(newFC, "/vsimem/test_columnar.geojson",
+                                         nullptr, nullptr, nullptr), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassCount(newFC), 2);
+    VSIUnlink("/vsimem/test_columnar.geojson");
+
+    // Spatial filter goes through packed R-tree
+    EXPECT_EQ(ngsFeatureClassSetSpatialFilter(newFC, 37.0, 55.0, 38.0, 56.0),
+              COD_SUCCESS);
+    ngsFeatureClassResetReading(newFC);
+    FeatureH feature = ngsFeatureClassNextFeature(newFC);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(ngsFeatureGetFieldAsInteger(feature, 0), 5);
+    EXPECT_STREQ(ngsFeatureGetFieldAsString(feature, 1), "first");
+    ngsFeatureFree(feature);
+    EXPECT_EQ(ngsFeatureClassNextFeature(newFC), nullptr);
+
+    ngsUnInit();
+}
+
+TEST(DataStoreTest, TestColumnarEmptyBinary) {
+    ngs::ColumnarLayer layer("binary", nullptr, wkbNone);
+    OGRFieldDefn field("data", OFTBinary);
+    ASSERT_EQ(layer.CreateField(&field), OGRERR_NONE);
+
+    // Empty values before any data and after the last data
+    const GByte bytes[] = {1, 2, 3};
+    int sizes[] = {0, 3, 0};
+    for(int size : sizes) {
+        OGRFeature feature(layer.GetLayerDefn());
+        feature.SetField(0, size, bytes);
+        ASSERT_EQ(layer.CreateFeature(&feature), OGRERR_NONE);
+    }
+
+    layer.ResetReading();
+    for(int size : sizes) {
+        ngs::FeaturePtr feature = layer.GetNextFeature();
+        ASSERT_TRUE(feature);
+        int readSize = -1;
+        GByte *data = feature->GetFieldAsBinary(0, &readSize);
+        EXPECT_EQ(readSize, size);
+        if(size > 0) {
+            EXPECT_EQ(std::memcmp(data, bytes, static_cast<size_t>(size)), 0);
+        }
+    }
+}
+
 TEST(DataStoreTests, TestDeleteDataStore) {
     char** options = nullptr;
     options = ngsListAddNameValue(options, "DEBUG_MODE", "ON");
@@ -1053,6 +1783,26 @@ TEST(MiscTests, TestBasicAuth) {
     ngsUnInit();
 }
 
+TEST(MiscTests, TestReturnStrings) {
+    // Returned string is not freed by calls on other threads
+    const char *version = ngsGetVersionString(nullptr);
+    std::thread thread([]() {
+        for(int i = 0; i < 1000; ++i) {
+            ngsGetVersionString("gdal");
+        }
+    });
+    thread.join();
+    EXPECT_STREQ(NGS_VERSION, version);
+
+    // Results of consecutive calls on the same thread are valid together
+    const char *gdalVersion = ngsGetVersionString("gdal");
+    std::string gdalVersionCopy(gdalVersion);
+    for(int i = 0; i < 8; ++i) {
+        ngsGetVersionString(nullptr);
+    }
+    EXPECT_STREQ(gdalVersionCopy.c_str(), gdalVersion);
+}
+
 TEST(MiscTests, TestCrypt) {
     const char *key = ngsGeneratePrivateKey();
     char **options = nullptr;
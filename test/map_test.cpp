@@ -185,6 +185,13 @@ TEST(MapTests, MapOpen) {
 
     EXPECT_EQ(ngsMapLayerCount(mapId), 2);
 
+    // Invalid size and buffer are rejected before any Gl call
+    EXPECT_EQ(ngsMapDrawToBuffer(mapId, 0, 0, nullptr, nullptr, nullptr),
+              COD_DRAW_FAILED);
+    EXPECT_EQ(ngsMapExport(mapId, "/vsimem/export.tif", 0, 0,
+                           {0.0, 0.0, 1.0, 1.0}, nullptr, nullptr, nullptr),
+              COD_DRAW_FAILED);
+
     ngsRGBA bk = ngsMapGetBackgroundColor(mapId);
 
     EXPECT_EQ(bk.R, DEFAULT_MAP_BK.R);
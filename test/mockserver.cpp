@@ -0,0 +1,597 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "mockserver.h"
+
+// std
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// gdal
+#include "cpl_json.h"
+#include "cpl_string.h"
+
+constexpr size_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+constexpr size_t SEND_CHUNK_SIZE = 16 * 1024;
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+static std::string toLower(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+static std::string unescape(const std::string &value)
+{
+    char *unescaped = CPLUnescapeString(value.c_str(), nullptr, CPLES_URL);
+    std::string out(unescaped);
+    CPLFree(unescaped);
+    return out;
+}
+
+static std::map<std::string, std::string> parseQuery(const std::string &query)
+{
+    std::map<std::string, std::string> out;
+    size_t start = 0;
+    while(start < query.size()) {
+        size_t end = query.find('&', start);
+        if(end == std::string::npos) {
+            end = query.size();
+        }
+        std::string item = query.substr(start, end - start);
+        size_t equal = item.find('=');
+        if(equal == std::string::npos) {
+            out[unescape(item)] = "";
+        }
+        else {
+            out[unescape(item.substr(0, equal))] =
+                    unescape(item.substr(equal + 1));
+        }
+        start = end + 1;
+    }
+    return out;
+}
+
+static std::vector<std::string> splitPath(const std::string &path)
+{
+    std::vector<std::string> out;
+    size_t start = 0;
+    while(start < path.size()) {
+        size_t end = path.find('/', start);
+        if(end == std::string::npos) {
+            end = path.size();
+        }
+        if(end > start) {
+            out.push_back(path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return out;
+}
+
+static const char *statusText(int status)
+{
+    switch(status) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default: return "Unknown";
+    }
+}
+
+static MockResponse jsonResponse(const CPLJSONObject &json)
+{
+    return {200, "application/json", {},
+            json.Format(CPLJSONObject::Plain)};
+}
+
+static MockResponse notFound()
+{
+    return {404, "application/json", {}, "{\"message\": \"Not found\"}"};
+}
+
+//------------------------------------------------------------------------------
+// MockHTTPServer
+//------------------------------------------------------------------------------
+
+MockHTTPServer::MockHTTPServer(MockHandler handler) :
+    m_handler(handler),
+    m_socket(-1),
+    m_port(0),
+    m_latency(0),
+    m_bandwidth(0),
+    m_requestCount(0),
+    m_bytesSent(0),
+    m_bytesReceived(0),
+    m_stop(false)
+{
+}
+
+MockHTTPServer::~MockHTTPServer()
+{
+    stop();
+}
+
+/**
+ * @brief MockHTTPServer::start Listen on free port of loopback interface.
+ * @return False if socket can not be bound.
+ */
+bool MockHTTPServer::start()
+{
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if(m_socket < 0) {
+        return false;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if(bind(m_socket, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+            listen(m_socket, 64) != 0 ||
+            getsockname(m_socket, reinterpret_cast<sockaddr*>(&address),
+                        &length) != 0) {
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+    m_port = ntohs(address.sin_port);
+    m_stop = false;
+    m_acceptThread = std::thread(&MockHTTPServer::acceptConnections, this);
+    return true;
+}
+
+void MockHTTPServer::stop()
+{
+    if(m_socket < 0) {
+        return;
+    }
+
+    m_stop = true;
+    shutdown(m_socket, SHUT_RDWR);
+    close(m_socket);
+    m_socket = -1;
+    if(m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+
+    // Wake connection threads blocked in recv
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(int connection : m_connections) {
+            shutdown(connection, SHUT_RDWR);
+        }
+    }
+    for(std::thread &thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    m_connections.clear();
+}
+
+std::string MockHTTPServer::url() const
+{
+    return "http://127.0.0.1:" + std::to_string(m_port);
+}
+
+void MockHTTPServer::resetCounters()
+{
+    m_requestCount = 0;
+    m_bytesSent = 0;
+    m_bytesReceived = 0;
+}
+
+void MockHTTPServer::acceptConnections()
+{
+    while(!m_stop) {
+        int connection = accept(m_socket, nullptr, nullptr);
+        if(connection < 0) {
+            if(m_stop) {
+                break;
+            }
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int noSigPipe = 1;
+        setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe,
+                   sizeof(noSigPipe));
+#endif
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections.push_back(connection);
+        m_threads.push_back(std::thread(&MockHTTPServer::serve, this,
+                                        connection));
+    }
+}
+
+void MockHTTPServer::serve(int socket)
+{
+    std::string buffer;
+    MockRequest request;
+    while(!m_stop && readRequest(socket, buffer, request)) {
+        m_requestCount++;
+        MockResponse response = m_handler(request);
+        bool close = toLower(request.headers["connection"]) == "close";
+        if(!sendResponse(socket, response, request.method == "HEAD", close) ||
+                close) {
+            break;
+        }
+    }
+    shutdown(socket, SHUT_RDWR);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The socket is closed here, so stop() does not shut down reused number
+    auto it = std::find(m_connections.begin(), m_connections.end(), socket);
+    if(it != m_connections.end()) {
+        m_connections.erase(it);
+    }
+    ::close(socket);
+}
+
+bool MockHTTPServer::receive(int socket, std::string &buffer)
+{
+    char data[RECEIVE_BUFFER_SIZE];
+    ssize_t size = recv(socket, data, sizeof(data), 0);
+    if(size <= 0) {
+        return false;
+    }
+    m_bytesReceived += static_cast<size_t>(size);
+    buffer.append(data, static_cast<size_t>(size));
+    return true;
+}
+
+bool MockHTTPServer::readRequest(int socket, std::string &buffer,
+                                 MockRequest &request)
+{
+    size_t headerEnd;
+    while((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if(!receive(socket, buffer)) {
+            return false;
+        }
+    }
+
+    request = MockRequest();
+    std::string header = buffer.substr(0, headerEnd);
+    buffer.erase(0, headerEnd + 4);
+
+    size_t lineEnd = header.find("\r\n");
+    std::string requestLine = header.substr(0, lineEnd);
+    size_t methodEnd = requestLine.find(' ');
+    size_t targetEnd = requestLine.find(' ', methodEnd + 1);
+    if(methodEnd == std::string::npos || targetEnd == std::string::npos) {
+        return false;
+    }
+    request.method = requestLine.substr(0, methodEnd);
+    std::string target = requestLine.substr(methodEnd + 1,
+                                            targetEnd - methodEnd - 1);
+    size_t queryStart = target.find('?');
+    request.path = target.substr(0, queryStart);
+    if(queryStart != std::string::npos) {
+        request.query = parseQuery(target.substr(queryStart + 1));
+    }
+
+    while(lineEnd != std::string::npos) {
+        size_t start = lineEnd + 2;
+        lineEnd = header.find("\r\n", start);
+        std::string line = header.substr(start, lineEnd == std::string::npos ?
+                                             std::string::npos : lineEnd - start);
+        size_t colon = line.find(':');
+        if(colon == std::string::npos) {
+            continue;
+        }
+        size_t valueStart = line.find_first_not_of(' ', colon + 1);
+        request.headers[toLower(line.substr(0, colon))] =
+                valueStart == std::string::npos ? "" : line.substr(valueStart);
+    }
+
+    // libcurl waits for it before sending large bodies
+    if(toLower(request.headers["expect"]) == "100-continue") {
+        const char *continueResponse = "HTTP/1.1 100 Continue\r\n\r\n";
+        if(!sendData(socket, continueResponse, strlen(continueResponse),
+                     false)) {
+            return false;
+        }
+    }
+
+    auto contentLength = request.headers.find("content-length");
+    if(contentLength != request.headers.end()) {
+        size_t length = std::strtoul(contentLength->second.c_str(), nullptr, 10);
+        while(buffer.size() < length) {
+            if(!receive(socket, buffer)) {
+                return false;
+            }
+        }
+        request.body = buffer.substr(0, length);
+        buffer.erase(0, length);
+    }
+    else if(toLower(request.headers["transfer-encoding"]) == "chunked") {
+        while(true) {
+            size_t sizeEnd;
+            while((sizeEnd = buffer.find("\r\n")) == std::string::npos) {
+                if(!receive(socket, buffer)) {
+                    return false;
+                }
+            }
+            size_t size = std::strtoul(buffer.c_str(), nullptr, 16);
+            while(buffer.size() < sizeEnd + 2 + size + 2) {
+                if(!receive(socket, buffer)) {
+                    return false;
+                }
+            }
+            request.body.append(buffer, sizeEnd + 2, size);
+            buffer.erase(0, sizeEnd + 2 + size + 2);
+            if(size == 0) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool MockHTTPServer::sendData(int socket, const char *data, size_t size,
+                              bool throttle)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t sent = 0;
+    while(sent < size) {
+        size_t bandwidth = throttle ? m_bandwidth.load() : 0;
+        size_t chunkSize = std::min(size - sent, SEND_CHUNK_SIZE);
+        if(bandwidth > 0) {
+            // Not more than 10 ms of data per send
+            chunkSize = std::min(chunkSize, std::max<size_t>(1, bandwidth / 100));
+        }
+        ssize_t result = send(socket, data + sent, chunkSize, SEND_FLAGS);
+        if(result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+        m_bytesSent += static_cast<size_t>(result);
+
+        if(bandwidth > 0) {
+            auto due = start + std::chrono::microseconds(
+                        static_cast<long long>(sent * 1000000.0 / bandwidth));
+            std::this_thread::sleep_until(due);
+        }
+    }
+    return true;
+}
+
+bool MockHTTPServer::sendResponse(int socket, const MockResponse &response,
+                                  bool headOnly, bool close)
+{
+    int latency = m_latency;
+    if(latency > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+    }
+
+    std::string header = "HTTP/1.1 " + std::to_string(response.status) + " " +
+            statusText(response.status) + "\r\n";
+    if(!response.contentType.empty()) {
+        header += "Content-Type: " + response.contentType + "\r\n";
+    }
+    header += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    for(const auto &item : response.headers) {
+        header += item.first + ": " + item.second + "\r\n";
+    }
+    header += close ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n";
+
+    if(!sendData(socket, header.data(), header.size(), false)) {
+        return false;
+    }
+    if(headOnly || response.status == 304) {
+        return true;
+    }
+    return sendData(socket, response.body.data(), response.body.size(), true);
+}
+
+//------------------------------------------------------------------------------
+// MockNGWServer
+//------------------------------------------------------------------------------
+
+MockNGWServer::MockNGWServer() :
+    MockHTTPServer([this](const MockRequest &request) {
+        return handle(request);
+    }),
+    m_childCount(100),
+    m_featureCount(1000),
+    m_attachmentSize(64 * 1024),
+    m_tileSize(16 * 1024),
+    m_nextId(1000000)
+{
+}
+
+MockResponse MockNGWServer::handle(const MockRequest &request)
+{
+    std::vector<std::string> path = splitPath(request.path);
+
+    if(request.path == "/api/component/pyramid/route") {
+        CPLJSONObject route;
+        CPLJSONArray search;
+        search.Add("/api/resource/search/");
+        route.Add("resource.search", search);
+        CPLJSONArray version;
+        version.Add("/api/component/pyramid/pkg_version");
+        route.Add("pyramid.pkg_version", version);
+        return jsonResponse(route);
+    }
+
+    if(request.path == "/resource/schema") {
+        CPLJSONObject resources;
+        resources.Add("resource_group", CPLJSONObject());
+        resources.Add("vector_layer", CPLJSONObject());
+        resources.Add("raster_layer", CPLJSONObject());
+        CPLJSONObject schema;
+        schema.Add("resources", resources);
+        return jsonResponse(schema);
+    }
+
+    if(request.path == "/api/component/file_upload/upload" &&
+            request.method == "POST") {
+        CPLJSONObject meta;
+        meta.Add("id", "upload" + std::to_string(m_nextId++));
+        meta.Add("size", static_cast<GInt64>(request.body.size()));
+        meta.Add("mime_type", "application/octet-stream");
+        meta.Add("name", "file");
+        CPLJSONArray uploadMeta;
+        uploadMeta.Add(meta);
+        CPLJSONObject out;
+        out.Add("upload_meta", uploadMeta);
+        return jsonResponse(out);
+    }
+
+    if(path.size() == 4 && path[0] == "tile") {
+        return {200, "image/png", {}, std::string(m_tileSize, '\x7f')};
+    }
+
+    if(path.size() < 2 || path[0] != "api" || path[1] != "resource") {
+        return notFound();
+    }
+
+    // /api/resource/?parent={id}
+    if(path.size() == 2) {
+        return children(request);
+    }
+
+    // /api/resource/{id}/feature/...
+    if(path.size() >= 4 && path[3] == "feature") {
+        if(path.size() == 4) {
+            if(request.method == "GET") {
+                return features(request);
+            }
+            if(request.method == "PATCH") {
+                return patchFeatures(request);
+            }
+            if(request.method == "DELETE") {
+                return {200, "application/json", {}, "{}"};
+            }
+            return {405, "application/json", {}, "{}"};
+        }
+        if(path.size() == 6 && path[5] == "attachment" &&
+                request.method == "POST") {
+            CPLJSONObject out;
+            out.Add("id", static_cast<GInt64>(m_nextId++));
+            return jsonResponse(out);
+        }
+        if(path.size() == 8 && path[5] == "attachment" &&
+                path[7] == "download") {
+            return {200, "application/octet-stream", {},
+                    std::string(m_attachmentSize, '\x55')};
+        }
+    }
+    return notFound();
+}
+
+MockResponse MockNGWServer::children(const MockRequest &request) const
+{
+    int count = m_childCount;
+    std::string etag = "\"children-" + std::to_string(count) + "\"";
+    auto ifNoneMatch = request.headers.find("if-none-match");
+    if(ifNoneMatch != request.headers.end() && ifNoneMatch->second == etag) {
+        return {304, "", {{"ETag", etag}}, ""};
+    }
+
+    auto parent = request.query.find("parent");
+    long long parentId = parent == request.query.end() ? 0 :
+                                  std::atoll(parent->second.c_str());
+    CPLJSONArray out;
+    for(int i = 0; i < count; ++i) {
+        CPLJSONObject resource;
+        resource.Add("id", static_cast<GInt64>(parentId * count + i + 1));
+        resource.Add("cls", "resource_group");
+        resource.Add("display_name", "group " + std::to_string(i));
+        resource.Add("keyname", "");
+        resource.Add("description", "");
+        resource.Add("creation_date", "2020-01-01T00:00:00");
+        resource.Add("children", false);
+        CPLJSONObject parentJson;
+        parentJson.Add("id", static_cast<GInt64>(parentId));
+        resource.Add("parent", parentJson);
+
+        CPLJSONObject resmeta;
+        resmeta.Add("items", CPLJSONObject());
+        CPLJSONObject item;
+        item.Add("resource", resource);
+        item.Add("resmeta", resmeta);
+        out.Add(item);
+    }
+
+    MockResponse response = {200, "application/json", {{"ETag", etag}},
+                             out.Format(CPLJSONObject::Plain)};
+    return response;
+}
+
+MockResponse MockNGWServer::features(const MockRequest &request) const
+{
+    auto value = [&request](const char *key, int defaultValue) {
+        auto it = request.query.find(key);
+        return it == request.query.end() ? defaultValue :
+                                           std::atoi(it->second.c_str());
+    };
+    int total = m_featureCount;
+    int offset = std::max(0, value("offset", 0));
+    int limit = value("limit", total);
+    int end = std::min(total, offset + limit);
+
+    CPLJSONArray out;
+    for(int i = offset; i < end; ++i) {
+        CPLJSONObject fields;
+        fields.Add("name", "feature " + std::to_string(i));
+        CPLJSONObject feature;
+        feature.Add("id", i + 1);
+        feature.Add("geom", CPLSPrintf("POINT (%d %d)", 4187000 + (i % 100) * 10,
+                                       7509000 + (i / 100) * 10));
+        feature.Add("fields", fields);
+        out.Add(feature);
+    }
+    return {200, "application/json", {}, out.Format(CPLJSONObject::Plain)};
+}
+
+MockResponse MockNGWServer::patchFeatures(const MockRequest &request)
+{
+    CPLJSONDocument payload;
+    if(!payload.LoadMemory(request.body)) {
+        return {400, "application/json", {}, "{}"};
+    }
+    CPLJSONArray items = payload.GetRoot().ToArray();
+    CPLJSONArray out;
+    for(int i = 0; i < items.Size(); ++i) {
+        CPLJSONObject item;
+        GInt64 id = items[i].GetLong("id", -1);
+        item.Add("id", id == -1 ? static_cast<GInt64>(m_nextId++) : id);
+        out.Add(item);
+    }
+    return {200, "application/json", {}, out.Format(CPLJSONObject::Plain)};
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSMOCKSERVER_H
+#define NGSMOCKSERVER_H
+
+// std
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct _mockRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers; // Lower case names
+    std::string body;
+} MockRequest;
+
+typedef struct _mockResponse {
+    int status;
+    std::string contentType;
+    std::map<std::string, std::string> headers;
+    std::string body;
+} MockResponse;
+
+using MockHandler = std::function<MockResponse(const MockRequest &request)>;
+
+/**
+ * @brief The MockHTTPServer class Minimal HTTP/1.1 server on loopback
+ * interface. Each connection is served in own thread and is kept alive, as
+ * libcurl reuses connections. The latency is added before each response and
+ * the response body is sent not faster than the bandwidth, so the network of
+ * mobile clients can be reproduced.
+ */
+class MockHTTPServer
+{
+public:
+    explicit MockHTTPServer(MockHandler handler);
+    virtual ~MockHTTPServer();
+    bool start();
+    void stop();
+    std::string url() const;
+    void setLatency(int milliseconds) { m_latency = milliseconds; }
+    void setBandwidth(size_t bytesPerSecond) { m_bandwidth = bytesPerSecond; }
+    size_t requestCount() const { return m_requestCount; }
+    size_t bytesSent() const { return m_bytesSent; }
+    size_t bytesReceived() const { return m_bytesReceived; }
+    void resetCounters();
+
+protected:
+    void acceptConnections();
+    void serve(int socket);
+    bool receive(int socket, std::string &buffer);
+    bool readRequest(int socket, std::string &buffer, MockRequest &request);
+    bool sendData(int socket, const char *data, size_t size, bool throttle);
+    bool sendResponse(int socket, const MockResponse &response,
+                      bool headOnly, bool close);
+
+private:
+    MockHandler m_handler;
+    int m_socket;
+    unsigned short m_port;
+    std::atomic<int> m_latency;
+    std::atomic<size_t> m_bandwidth;
+    std::atomic<size_t> m_requestCount, m_bytesSent, m_bytesReceived;
+    std::atomic<bool> m_stop;
+    std::thread m_acceptThread;
+    std::vector<std::thread> m_threads;
+    std::vector<int> m_connections;
+    std::mutex m_mutex;
+};
+
+/**
+ * @brief The MockNGWServer class NextGIS Web API subset used by catalog
+ * browsing, layers sync, attachments transfer and tiles download:
+ * - /api/component/pyramid/route and /resource/schema
+ * - /api/resource/?parent={id} - childCount resource groups, with ETag
+ * - /api/resource/{id}/feature/ - GET pages of featureCount points, PATCH
+ *   returns identifiers for created features, DELETE
+ * - /api/resource/{id}/feature/{fid}/attachment/ - POST new attachment
+ * - /api/resource/{id}/feature/{fid}/attachment/{aid}/download
+ * - /api/component/file_upload/upload
+ * - /tile/{z}/{x}/{y}.png - tiles of tileSize bytes
+ */
+class MockNGWServer : public MockHTTPServer
+{
+public:
+    MockNGWServer();
+    void setChildCount(int count) { m_childCount = count; }
+    void setFeatureCount(int count) { m_featureCount = count; }
+    void setAttachmentSize(size_t size) { m_attachmentSize = size; }
+    void setTileSize(size_t size) { m_tileSize = size; }
+
+protected:
+    MockResponse handle(const MockRequest &request);
+    MockResponse children(const MockRequest &request) const;
+    MockResponse features(const MockRequest &request) const;
+    MockResponse patchFeatures(const MockRequest &request);
+
+private:
+    std::atomic<int> m_childCount, m_featureCount;
+    std::atomic<size_t> m_attachmentSize, m_tileSize;
+    std::atomic<long long> m_nextId;
+};
+
+#endif // NGSMOCKSERVER_H
@@ -0,0 +1,418 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+// Map render benchmark. Opens map in offscreen EGL context and replays
+// camera path: every viewport is drawn frame by frame, as the map widget
+// does, until all tiles are filled.
+// Usage: ngstore_render_bench --map=<file.ngmd>
+//                             [--path=<camera_path.json>]
+//                             [--size=<width>x<height>]
+//                             [--timeout=<seconds per viewport>]
+//                             [--out=<file.json>]
+// Camera path is JSON object with viewports array:
+// {"viewports": [{"x": 0.0, "y": 0.0, "scale": 1.0}, ...]}
+// Without path the map is panned around its initial center and zoomed in and
+// out. For every viewport the frame times, time to complete, fill latency and
+// memory are reported, the summary has memory high-water marks.
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+// gdal
+#include "cpl_conv.h"
+#include "cpl_json.h"
+
+#include "map/mapstore.h"
+#include "ngstore/api.h"
+#include "ngstore/version.h"
+
+using namespace ngs;
+
+using Clock = std::chrono::steady_clock;
+
+//------------------------------------------------------------------------------
+// Offscreen context
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The OffscreenContext class EGL pbuffer surface with GLES 2 context
+ * made current in the calling thread.
+ */
+class OffscreenContext
+{
+public:
+    OffscreenContext() : m_display(EGL_NO_DISPLAY), m_surface(EGL_NO_SURFACE),
+        m_context(EGL_NO_CONTEXT) {}
+    ~OffscreenContext() {
+        if(m_display == EGL_NO_DISPLAY) {
+            return;
+        }
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       EGL_NO_CONTEXT);
+        if(m_context != EGL_NO_CONTEXT) {
+            eglDestroyContext(m_display, m_context);
+        }
+        if(m_surface != EGL_NO_SURFACE) {
+            eglDestroySurface(m_display, m_surface);
+        }
+        eglTerminate(m_display);
+    }
+
+    bool create(int width, int height) {
+        m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if(m_display == EGL_NO_DISPLAY ||
+                eglInitialize(m_display, nullptr, nullptr) != EGL_TRUE) {
+            m_display = EGL_NO_DISPLAY;
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 16,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        if(eglChooseConfig(m_display, configAttribs, &config, 1,
+                           &numConfigs) != EGL_TRUE || numConfigs < 1) {
+            return false;
+        }
+
+        const EGLint surfaceAttribs[] = {
+            EGL_WIDTH, width,
+            EGL_HEIGHT, height,
+            EGL_NONE
+        };
+        m_surface = eglCreatePbufferSurface(m_display, config, surfaceAttribs);
+        if(m_surface == EGL_NO_SURFACE) {
+            return false;
+        }
+
+        eglBindAPI(EGL_OPENGL_ES_API);
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 2,
+            EGL_NONE
+        };
+        m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT,
+                                     contextAttribs);
+        if(m_context == EGL_NO_CONTEXT) {
+            return false;
+        }
+
+        return eglMakeCurrent(m_display, m_surface, m_surface,
+                              m_context) == EGL_TRUE;
+    }
+
+private:
+    EGLDisplay m_display;
+    EGLSurface m_surface;
+    EGLContext m_context;
+};
+
+//------------------------------------------------------------------------------
+// Camera path
+//------------------------------------------------------------------------------
+
+struct Viewport {
+    double x, y, scale;
+};
+
+static std::vector<Viewport> loadCameraPath(const std::string &path)
+{
+    std::vector<Viewport> out;
+    CPLJSONDocument doc;
+    if(!doc.Load(path)) {
+        return out;
+    }
+    CPLJSONArray viewports = doc.GetRoot().GetArray("viewports");
+    for(int i = 0; i < viewports.Size(); ++i) {
+        CPLJSONObject viewport = viewports[i];
+        out.push_back({viewport.GetDouble("x"), viewport.GetDouble("y"),
+                       viewport.GetDouble("scale", 1.0)});
+    }
+    return out;
+}
+
+/**
+ * @brief defaultCameraPath Pan by half of the screen to the east and back,
+ * then zoom in three times and out again.
+ */
+static std::vector<Viewport> defaultCameraPath(const MapViewPtr &map)
+{
+    std::vector<Viewport> out;
+    OGRRawPoint center = map->getCenter();
+    double scale = map->getScale();
+    double step = map->getExtent().width() / 2;
+    for(int i = 0; i <= 4; ++i) {
+        out.push_back({center.x + step * i, center.y, scale});
+    }
+    for(int i = 3; i >= 0; --i) {
+        out.push_back({center.x + step * i, center.y, scale});
+    }
+    for(int i = 1; i <= 3; ++i) {
+        out.push_back({center.x, center.y, scale * (1 << i)});
+    }
+    for(int i = 2; i >= 0; --i) {
+        out.push_back({center.x, center.y, scale * (1 << i)});
+    }
+    return out;
+}
+
+//------------------------------------------------------------------------------
+// Replay
+//------------------------------------------------------------------------------
+
+static int drawProgress(enum ngsCode status, double /*complete*/,
+                        const char * /*message*/, void *progressArguments)
+{
+    if(status == COD_FINISHED) {
+        *static_cast<bool*>(progressArguments) = true;
+    }
+    return 1;
+}
+
+static double percentile(std::vector<double> values, double rank)
+{
+    if(values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(rank * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static long long maxResidentSize()
+{
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<long long>(usage.ru_maxrss) * 1024;
+}
+
+static const char *argValue(const char *arg, const char *key)
+{
+    size_t len = strlen(key);
+    if(strncmp(arg, key, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string mapPath;
+    std::string cameraPath;
+    std::string outPath;
+    int width = 1024;
+    int height = 768;
+    double timeout = 30.0;
+    for(int i = 1; i < argc; ++i) {
+        const char *value = nullptr;
+        if((value = argValue(argv[i], "--map")) != nullptr) {
+            mapPath = value;
+        }
+        else if((value = argValue(argv[i], "--path")) != nullptr) {
+            cameraPath = value;
+        }
+        else if((value = argValue(argv[i], "--size")) != nullptr) {
+            const char *separator = strchr(value, 'x');
+            width = atoi(value);
+            height = separator != nullptr ? atoi(separator + 1) : width;
+        }
+        else if((value = argValue(argv[i], "--timeout")) != nullptr) {
+            timeout = CPLAtof(value);
+        }
+        else if((value = argValue(argv[i], "--out")) != nullptr) {
+            outPath = value;
+        }
+        else {
+            std::cerr << "Unknown argument " << argv[i] << '\n';
+            return 1;
+        }
+    }
+
+    if(mapPath.empty() || width <= 0 || height <= 0) {
+        std::cerr << "Usage: ngstore_render_bench --map=<file.ngmd> "
+                     "[--path=<camera_path.json>] [--size=<width>x<height>] "
+                     "[--timeout=<seconds>] [--out=<file.json>]\n";
+        return 1;
+    }
+
+    OffscreenContext context;
+    if(!context.create(width, height)) {
+        std::cerr << "Failed to create offscreen EGL context\n";
+        return 1;
+    }
+
+    char **options = nullptr;
+    options = ngsListAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    options = ngsListAddNameValue(options, "CACHE_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    if(ngsInit(options) != COD_SUCCESS) {
+        ngsListFree(options);
+        std::cerr << "Library init failed\n";
+        return 1;
+    }
+    ngsListFree(options);
+
+    if(CPLIsFilenameRelative(mapPath.c_str())) {
+        mapPath = CPLFormFilename(ngsGetCurrentDirectory(), mapPath.c_str(),
+                                  nullptr);
+    }
+    std::string mapCatalogPath = ngsCatalogPathFromSystem(mapPath.c_str());
+    char mapId = ngsMapOpen(mapCatalogPath.c_str());
+    MapViewPtr map = mapId == MapStore::invalidMapId() ? MapViewPtr() :
+                                  MapStore::instance()->getMap(mapId);
+    if(!map) {
+        std::cerr << "Failed to open map " << mapPath << '\n';
+        ngsUnInit();
+        return 1;
+    }
+    ngsMapSetSize(mapId, width, height, 0);
+
+    std::vector<Viewport> viewports = cameraPath.empty() ?
+                defaultCameraPath(map) : loadCameraPath(cameraPath);
+    if(viewports.empty()) {
+        std::cerr << "Camera path " << cameraPath << " has no viewports\n";
+        ngsUnInit();
+        return 1;
+    }
+
+    CPLJSONArray results;
+    std::vector<double> allFrameTimes;
+    long long glMemoryHighWater = 0;
+    long long memoryHighWater = 0;
+    int incomplete = 0;
+    for(size_t i = 0; i < viewports.size(); ++i) {
+        const Viewport &viewport = viewports[i];
+        map->setScaleAndCenter(viewport.scale, viewport.x, viewport.y);
+
+        // The first frame of viewport starts tiles fill, next frames draw
+        // the filled tiles as the map widget does on fill notifications.
+        std::vector<double> frameTimes;
+        bool finished = false;
+        enum ngsDrawState state = DS_NORMAL;
+        auto start = Clock::now();
+        double elapsed = 0.0;
+        while(!finished && elapsed < timeout) {
+            auto frameStart = Clock::now();
+            ngsMapDraw(mapId, state, drawProgress, &finished);
+            glFinish();
+            auto frameStop = Clock::now();
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(
+                                     frameStop - frameStart).count());
+            elapsed = std::chrono::duration<double>(frameStop - start).count();
+            state = DS_PRESERVED;
+
+            ngsRenderStats stats = ngsMapGetRenderStats(mapId);
+            glMemoryHighWater = std::max(glMemoryHighWater,
+                                         stats.bufferMemory +
+                                         stats.textureMemory);
+            memoryHighWater = std::max(memoryHighWater, ngsGetMemoryUsage());
+        }
+        if(!finished) {
+            incomplete++;
+        }
+        allFrameTimes.insert(allFrameTimes.end(), frameTimes.begin(),
+                             frameTimes.end());
+
+        ngsRenderStats stats = ngsMapGetRenderStats(mapId);
+        CPLJSONObject result;
+        result.Add("x", viewport.x);
+        result.Add("y", viewport.y);
+        result.Add("scale", viewport.scale);
+        result.Add("completed", finished);
+        result.Add("time_to_complete", elapsed * 1000);
+        result.Add("frames", static_cast<int>(frameTimes.size()));
+        result.Add("frame_time_50", percentile(frameTimes, 0.5));
+        result.Add("frame_time_90", percentile(frameTimes, 0.9));
+        result.Add("frame_time_max", percentile(frameTimes, 1.0));
+        result.Add("fill_latency_50", stats.fillLatency50);
+        result.Add("fill_latency_90", stats.fillLatency90);
+        result.Add("fill_latency_99", stats.fillLatency99);
+        result.Add("buffer_memory", static_cast<GInt64>(stats.bufferMemory));
+        result.Add("texture_memory", static_cast<GInt64>(stats.textureMemory));
+        results.Add(result);
+
+        std::cout << i << '\t' << elapsed * 1000 << " ms\t"
+                  << frameTimes.size() << " frames"
+                  << (finished ? "" : "\tincomplete") << '\n';
+    }
+
+    ngsMapClose(mapId);
+    ngsUnInit();
+
+    CPLJSONObject summary;
+    summary.Add("viewports", static_cast<int>(viewports.size()));
+    summary.Add("incomplete", incomplete);
+    summary.Add("frames", static_cast<int>(allFrameTimes.size()));
+    summary.Add("frame_time_50", percentile(allFrameTimes, 0.5));
+    summary.Add("frame_time_90", percentile(allFrameTimes, 0.9));
+    summary.Add("frame_time_99", percentile(allFrameTimes, 0.99));
+    summary.Add("gl_memory_high_water", static_cast<GInt64>(glMemoryHighWater));
+    summary.Add("memory_high_water", static_cast<GInt64>(memoryHighWater));
+    summary.Add("max_resident_size", static_cast<GInt64>(maxResidentSize()));
+
+    std::cout << "frame time p50 " << summary.GetDouble("frame_time_50")
+              << " ms, p90 " << summary.GetDouble("frame_time_90")
+              << " ms, GL memory high-water " << glMemoryHighWater << '\n';
+
+    if(!outPath.empty()) {
+        CPLJSONObject runContext;
+        runContext.Add("library_version", NGS_VERSION);
+        runContext.Add("num_cpus", CPLGetNumCPUs());
+        runContext.Add("map", mapPath);
+        runContext.Add("camera_path", cameraPath);
+        runContext.Add("width", width);
+        runContext.Add("height", height);
+
+        CPLJSONDocument doc;
+        CPLJSONObject root = doc.GetRoot();
+        root.Add("context", runContext);
+        root.Add("summary", summary);
+        root.Add("viewports", results);
+        if(!doc.Save(outPath)) {
+            std::cerr << "Failed to save " << outPath << '\n';
+            return 1;
+        }
+    }
+
+    return incomplete == 0 ? 0 : 2;
+}
@@ -23,6 +23,7 @@
 
 #include "ngstore/codes.h"
 #include "catalog/folder.h"
+#include "util/options.h"
 #include "util/settings.h"
 
 // gdal
@@ -78,3 +79,69 @@ TEST(SettingsTests, Settings) {
 
     ngsUnInit();
 }
+
+TEST(SettingsTests, SaveTest) {
+    char **options = nullptr;
+    options = ngsListAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsListAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+
+    ngsListFree(options);
+
+    ngs::Settings &settings = ngs::Settings::instance();
+    settings.set("map/center/x", 1.5);
+    EXPECT_DOUBLE_EQ(settings.getDouble("map/center/x", 0.0), 1.5);
+    settings.set("map/center/x", 2.5);
+    EXPECT_DOUBLE_EQ(settings.getDouble("map/center/x", 0.0), 2.5);
+    // Parent object is replaced, child value must not stay cached
+    settings.set("map/center", std::string("none"));
+    EXPECT_DOUBLE_EQ(settings.getDouble("map/center/x", 0.0), 0.0);
+    settings.set("map/zoom", 3.5);
+
+    EXPECT_TRUE(settings.save());
+    std::string path = ngs::Settings::getConfigOption("NGS_SETTINGS_PATH");
+    CPLJSONDocument doc;
+    ASSERT_TRUE(doc.Load(ngsFormFileName(path.c_str(), "settings", "json")));
+    EXPECT_DOUBLE_EQ(doc.GetRoot().GetDouble("map/zoom", 0.0), 3.5);
+
+    // Existing settings file is replaced
+    settings.set("map/zoom", 4.5);
+    EXPECT_TRUE(settings.save());
+    ASSERT_TRUE(doc.Load(ngsFormFileName(path.c_str(), "settings", "json")));
+    EXPECT_DOUBLE_EQ(doc.GetRoot().GetDouble("map/zoom", 0.0), 4.5);
+
+    ngsUnInit();
+}
+
+TEST(SettingsTests, OptionsTest) {
+    ngs::Options options;
+    options.add("INT", "42");
+    options.add("DOUBLE", "2.5");
+    options.add("FLAG", "NO");
+    options.add("TEXT", "value");
+
+    ngs::Options copy(options);
+    copy.add("INT", 7L);
+    copy.remove("TEXT");
+
+    // Changing the copy does not change the original
+    EXPECT_EQ(options.asInt("INT"), 42);
+    EXPECT_EQ(copy.asInt("INT"), 7);
+    EXPECT_TRUE(options.hasKey("TEXT"));
+    EXPECT_FALSE(copy.hasKey("TEXT"));
+
+    EXPECT_DOUBLE_EQ(options.asDouble("DOUBLE"), 2.5);
+    EXPECT_EQ(options.asBool("FLAG", true), false);
+    EXPECT_EQ(options.asBool("TEXT", false), true);
+    EXPECT_EQ(options.asInt("TEXT", 5), 0);
+    EXPECT_EQ(options.asLong("MISSING", 5), 5);
+    EXPECT_EQ(options.asString("TEXT"), "value");
+
+    ngs::Options empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.begin(), empty.end());
+    empty.append(options);
+    EXPECT_EQ(empty.asInt("INT"), 42);
+}
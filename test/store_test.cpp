@@ -27,6 +27,9 @@
 
 
 #include "ds/datastore.h"
+#include "ds/raster.h"
+#include "ds/tilestore.h"
+#include "util/notify.h"
 
 TEST(StoreTests, TestJSONSAXParser) {
     initLib();
@@ -49,6 +52,156 @@ TEST(StoreTests, TestJSONSAXParser) {
 }
 
 
+TEST(StoreTests, TestTileStore) {
+    initLib();
+
+    std::string path = ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                       nullptr);
+    path = ngsFormFileName(path.c_str(), "test_tiles", "mbtiles");
+    VSIUnlink(path.c_str());
+
+    ngs::TileStore store(path);
+    ngs::Tile tile = { 1, 2, 3, 0 };
+    EXPECT_EQ(store.isFresh(tile), false);
+
+    const GByte tileData[] = { 1, 2, 3, 4 };
+    GIntBig now = static_cast<GIntBig>(time(nullptr));
+    EXPECT_EQ(store.put({ { tile, tileData, 4 } }, now + 60), true);
+    EXPECT_EQ(store.isFresh(tile), true);
+    std::vector<GByte> data;
+    EXPECT_EQ(store.tile(tile, data), true);
+    EXPECT_EQ(data.size(), 4);
+
+    // Replace with expired tile
+    EXPECT_EQ(store.put({ { tile, tileData, 4, "\"v1\"", nullptr } },
+                        now - 60), true);
+    EXPECT_EQ(store.isFresh(tile), false);
+    EXPECT_EQ(store.tile(tile, data), false);
+
+    // Not modified tile gets new expire time
+    std::string etag, lastModified;
+    EXPECT_EQ(store.validators(tile, etag, lastModified), true);
+    EXPECT_STREQ(etag.c_str(), "\"v1\"");
+    EXPECT_EQ(lastModified.empty(), true);
+    EXPECT_EQ(store.touch({ tile }, now + 60), true);
+    EXPECT_EQ(store.isFresh(tile), true);
+
+    // Stopped job keeps done tiles
+    ngs::CacheAreaJob job("test_job");
+    job.addLevel(3, 0, 0, 3, 2);
+    EXPECT_EQ(job.tileCount(), 12);
+    job.setDone({ tile });
+    EXPECT_EQ(store.saveJob(job), true);
+
+    ngs::CacheAreaJob savedJob("test_job");
+    EXPECT_EQ(store.loadJob(savedJob), true);
+    EXPECT_EQ(savedJob.doneCount(), 1);
+    EXPECT_EQ(savedJob.isDone(tile), true);
+    EXPECT_EQ(savedJob.isDone({ 2, 1, 3, 0 }), false);
+    store.deleteJob("test_job");
+    EXPECT_EQ(store.loadJob(savedJob), false);
+
+    store.close();
+    VSIUnlink(path.c_str());
+
+    ngsUnInit();
+}
+
+TEST(StoreTests, TestRasterBlockCache) {
+    initLib();
+
+    GDALDriver *driver = GetGDALDriverManager()->GetDriverByName("MEM");
+    ASSERT_NE(driver, nullptr);
+    ngs::GDALDatasetPtr DS = driver->Create("", 300, 300, 3, GDT_Byte, nullptr);
+    ASSERT_NE(DS, nullptr);
+
+    std::vector<GByte> line(300);
+    for(int band = 1; band <= 3; ++band) {
+        for(int y = 0; y < 300; ++y) {
+            for(int x = 0; x < 300; ++x) {
+                line[x] = static_cast<GByte>(x + y * 3 + band);
+            }
+            DS->GetRasterBand(band)->RasterIO(GF_Write, 0, y, 300, 1,
+                                               line.data(), 300, 1, GDT_Byte,
+                                               0, 0);
+        }
+    }
+
+    // Window crosses four blocks, alpha is not read
+    ngs::RasterBlockCache cache(2);
+    int bands[4] = { 1, 2, 3, 0 };
+    std::vector<GByte> data(100 * 50 * 4, 255);
+    EXPECT_EQ(cache.read(DS, data.data(), -1, 200, 230, 100, 50, GDT_Byte, 4,
+                         bands, true), true);
+    bool equal = true;
+    for(int y = 0; y < 50; ++y) {
+        for(int x = 0; x < 100; ++x) {
+            const GByte *pixel = &data[(y * 100 + x) * 4];
+            for(int band = 1; band <= 3; ++band) {
+                if(pixel[band - 1] !=
+                        static_cast<GByte>(200 + x + (230 + y) * 3 + band)) {
+                    equal = false;
+                }
+            }
+            if(pixel[3] != 255) {
+                equal = false;
+            }
+        }
+    }
+    EXPECT_EQ(equal, true);
+
+    // Window outside raster
+    EXPECT_EQ(cache.read(DS, data.data(), -1, 300, 0, 10, 10, GDT_Byte, 4,
+                         bands, true), false);
+
+    ngsUnInit();
+}
+
+static std::vector<std::pair<std::string, int>> notifyEvents;
+static int notifySyncCount = 0;
+
+static void notifyAsyncFunc(const char *uri, enum ngsChangeCode operation)
+{
+    notifyEvents.push_back(std::make_pair(std::string(uri),
+                                          static_cast<int>(operation)));
+}
+
+static void notifySyncFunc(const char */*uri*/, enum ngsChangeCode /*operation*/)
+{
+    notifySyncCount++;
+}
+
+TEST(StoreTests, TestNotifyCoalesce) {
+    ngs::Notify &notify = ngs::Notify::instance();
+    notify.addNotifyReceiver(notifyAsyncFunc, CC_ALL);
+    notify.addNotifyReceiver(notifySyncFunc, CC_CREATE_FEATURE, true);
+
+    for(int i = 10; i < 110; ++i) {
+        notify.onNotify("ngc://store/layer#" + std::to_string(i),
+                        CC_CREATE_FEATURE);
+    }
+    notify.onNotify("ngc://store/layer#5", CC_DELETE_FEATURE);
+    notify.onNotify("ngc://store/other", CC_CHANGE_OBJECT);
+    EXPECT_EQ(notifySyncCount, 100);
+
+    notify.flush();
+    notify.deleteNotifyReceiver(notifyAsyncFunc);
+    notify.deleteNotifyReceiver(notifySyncFunc);
+    notify.stop();
+
+    // Dispatcher may take the first events before the burst ends
+    ASSERT_GE(notifyEvents.size(), 3u);
+    size_t creates = notifyEvents.size() - 2;
+    EXPECT_EQ(notifyEvents[creates - 1].first.substr(
+                  notifyEvents[creates - 1].first.size() - 3), "109");
+    EXPECT_EQ(notifyEvents[creates].first, "ngc://store/layer#5");
+    EXPECT_EQ(notifyEvents[creates].second, CC_DELETE_FEATURE);
+    EXPECT_EQ(notifyEvents[creates + 1].second, CC_CHANGE_OBJECT);
+    if(creates == 1) {
+        EXPECT_EQ(notifyEvents[0].first, "ngc://store/layer#10-109");
+    }
+}
+
 TEST(MIStoreTests, TestCreate) {
     initLib();
 
@@ -0,0 +1,361 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualisation support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2020 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+// Stress test of tile fills, feature edits, track points ingestion and sync
+// running at the same time. Build with -DSANITIZER=thread or
+// -DSANITIZER=address and run for minutes:
+// NGS_STRESS_DURATION=300 ./stress_test
+// The default duration is 10 seconds, so the test fits to ctest run.
+
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <random>
+#include <set>
+#include <thread>
+
+// gdal
+#include "cpl_conv.h"
+
+#include "catalog/ngw.h"
+#include "ds/datastore.h"
+#include "ds/featureclassovr.h"
+#include "ds/storefeatureclass.h"
+#include "ds/tablecursor.h"
+#include "ds/tilecache.h"
+#include "ds/util.h"
+#include "map/gl/layer.h"
+#include "map/gl/view.h"
+#include "map/maptransform.h"
+
+#ifndef _WIN32
+#include "mockserver.h"
+#endif
+
+constexpr double STRESS_X = 4187000.0; // Moscow, EPSG:3857
+constexpr double STRESS_Y = 7509000.0;
+constexpr double STRESS_SIZE = 2000.0;
+constexpr unsigned char STRESS_ZOOM = 14;
+constexpr int STRESS_FILL_THREADS = 2;
+constexpr int STRESS_INIT_FEATURES = 2000;
+// Own connection of the render side, as GDAL shares datasets per thread only
+constexpr unsigned int STRESS_OPEN_FLAGS = GDAL_OF_UPDATE|GDAL_OF_VERBOSE_ERROR;
+
+/**
+ * @brief The StressStore class Second store connection, the tiles are read
+ * through it as by the map in other thread.
+ */
+class StressStore : public ngs::DataStore
+{
+public:
+    explicit StressStore(const std::string &path) :
+        ngs::DataStore(nullptr, "stress_render", path) {}
+    OGRLayer *layer(const std::string &name) const {
+        return m_DS->GetLayerByName(name.c_str());
+    }
+};
+
+static ngs::Envelope stressExtent()
+{
+    return ngs::Envelope(STRESS_X - STRESS_SIZE, STRESS_Y - STRESS_SIZE,
+                         STRESS_X + STRESS_SIZE, STRESS_Y + STRESS_SIZE);
+}
+
+static OGRPoint *stressPoint(std::mt19937 &random)
+{
+    std::uniform_real_distribution<double> offset(-STRESS_SIZE * 0.9,
+                                                  STRESS_SIZE * 0.9);
+    return new OGRPoint(STRESS_X + offset(random), STRESS_Y + offset(random));
+}
+
+static bool insertPoint(ngs::FeatureClass *featureClass, std::mt19937 &random,
+                        bool logEdits)
+{
+    ngs::FeaturePtr feature = featureClass->createFeature();
+    feature->SetField("name", "stress");
+    feature->SetGeometryDirectly(stressPoint(random));
+    return featureClass->insertFeature(feature, logEdits);
+}
+
+/**
+ * @brief tileIds Get feature identifiers of overview tile.
+ */
+static std::set<GIntBig> tileIds(ngs::FeatureClassOverview *overview,
+                                 const ngs::TileItem &tileItem)
+{
+    ngs::Envelope env = tileItem.env;
+    env.resize(ngs::TILE_RESIZE);
+    ngs::FlatVectorTile vtile = overview->getTile(tileItem.tile, env);
+    std::set<GIntBig> out;
+    for(size_t i = 0; i < vtile.itemCount(); ++i) {
+        ngs::FlatVectorTileItem item = vtile.item(i);
+        out.insert(item.ids().begin(), item.ids().end());
+    }
+    return out;
+}
+
+/**
+ * @brief baseIds Get identifiers of features in tile extent from the store.
+ */
+static std::set<GIntBig> baseIds(ngs::FeatureClass *featureClass,
+                                 const ngs::TileItem &tileItem)
+{
+    ngs::Envelope env = tileItem.env;
+    env.resize(ngs::TILE_RESIZE);
+    std::set<GIntBig> out;
+    ngs::TableCursorPtr cursor = featureClass->cursor("", env);
+    if(!cursor) {
+        return out;
+    }
+    ngs::FeaturePtr feature;
+    while((feature = cursor->next())) {
+        out.insert(feature->GetFID());
+    }
+    return out;
+}
+
+TEST(StressTests, TestConcurrentFillEditSync) {
+    initLib();
+
+    double duration = CPLAtof(CPLGetConfigOption("NGS_STRESS_DURATION", "10"));
+
+    std::string testPath = ngsGetCurrentDirectory();
+    std::string tmpPath = ngsFormFileName(testPath.c_str(), "tmp", nullptr);
+    std::string catalogPath = ngsCatalogPathFromSystem(tmpPath.c_str());
+    CatalogObjectH folder = ngsCatalogObjectGet(catalogPath.c_str());
+    ASSERT_NE(folder, nullptr);
+
+    char **options = nullptr;
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_CONTAINER_NGS);
+    options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+    CatalogObjectH store = ngsCatalogObjectCreate(folder, "stress", options);
+    ngsListFree(options);
+    ASSERT_NE(store, nullptr);
+
+    options = nullptr;
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_FC_GPKG);
+    options = ngsListAddNameValue(options, "GEOMETRY_TYPE", "POINT");
+    options = ngsListAddNameValue(options, "FIELD_COUNT", "1");
+    options = ngsListAddNameValue(options, "FIELD_0_TYPE", "STRING");
+    options = ngsListAddNameValue(options, "FIELD_0_NAME", "name");
+    options = ngsListAddNameValue(options, "LOG_EDIT_HISTORY", "ON");
+    CatalogObjectH points = ngsCatalogObjectCreate(store, "points", options);
+    ngsListFree(options);
+    ASSERT_NE(points, nullptr);
+
+    ngs::DataStore *dataStore = dynamic_cast<ngs::DataStore*>(
+                static_cast<ngs::Object*>(store));
+    ASSERT_NE(dataStore, nullptr);
+    ngs::ObjectPtr pointsObject = static_cast<ngs::Object*>(points)->pointer();
+    ngs::StoreFeatureClass *featureClass =
+            ngsDynamicCast(ngs::StoreFeatureClass, pointsObject);
+    ASSERT_NE(featureClass, nullptr);
+
+    // Initial features cover all the area, so the render side layer extent
+    // does not cut tiles
+    std::mt19937 initRandom(42);
+    for(int i = 0; i < STRESS_INIT_FEATURES; ++i) {
+        ASSERT_TRUE(insertPoint(featureClass, initRandom, false));
+    }
+
+    ngs::TracksTable *tracks = dynamic_cast<ngs::TracksTable*>(
+                dataStore->getTracksTable().get());
+    ASSERT_NE(tracks, nullptr);
+
+#ifndef _WIN32
+    MockNGWServer server;
+    server.setFeatureCount(200);
+    ASSERT_TRUE(server.start());
+    CatalogObjectH connections =
+            ngsCatalogObjectGet("ngc://GIS Server connections");
+    options = nullptr;
+    options = ngsListAddNameIntValue(options, "TYPE", CAT_CONTAINER_NGW);
+    options = ngsListAddNameValue(options, "CREATE_UNIQUE", "ON");
+    options = ngsListAddNameValue(options, "login", "guest");
+    options = ngsListAddNameValue(options, "url", server.url().c_str());
+    options = ngsListAddNameValue(options, "is_guest", "ON");
+    CatalogObjectH connection = ngsCatalogObjectCreate(connections,
+                                                       "stress_ngw", options);
+    ngsListFree(options);
+    ASSERT_NE(connection, nullptr);
+    featureClass->setProperty(ngs::ngw::NGW_CONNECTION,
+                              static_cast<ngs::Object*>(connection)->fullName(),
+                              NG_ADDITIONS_KEY);
+    featureClass->setProperty(ngs::ngw::NGW_ID, "100", NG_ADDITIONS_KEY);
+    featureClass->setProperty(ngs::ngw::SYNC_KEY, ngs::ngw::SYNC_BIDIRECTIONAL,
+                              NG_ADDITIONS_KEY);
+#endif // _WIN32
+
+    // Render side: overview over own connection and Gl layer filled from
+    // several threads, the Gl context thread takes the filled data. The
+    // objects are closed before the store is deleted.
+    {
+        StressStore renderStore(dataStore->path());
+        ASSERT_TRUE(renderStore.open(STRESS_OPEN_FLAGS));
+        ngs::FeatureClassOverviewPtr overview(new ngs::FeatureClassOverview(
+                renderStore.layer("points"), &renderStore, CAT_FC_GPKG, "points"));
+        ngs::GlView view;
+        ngs::GlFeatureLayer glLayer(&view);
+        glLayer.setFeatureClass(overview);
+        std::vector<ngs::TileItem> tiles = ngs::MapTransform::getTilesForExtent(
+                    stressExtent(), STRESS_ZOOM, false, true);
+        ASSERT_FALSE(tiles.empty());
+
+        std::atomic<bool> stop(false);
+        std::atomic<int> fills(0), edits(0), syncs(0), trackPoints(0);
+        std::atomic<int> trackFailures(0), syncFailures(0);
+        std::vector<std::thread> threads;
+
+        for(int i = 0; i < STRESS_FILL_THREADS; ++i) {
+            threads.emplace_back([&, i]() {
+                std::mt19937 random(static_cast<unsigned>(100 + i));
+                std::uniform_int_distribution<size_t> tileIndex(0,
+                                                                tiles.size() - 1);
+                while(!stop) {
+                    ngs::GlTilePtr tile(new ngs::GlTile(256, tiles[tileIndex(random)]));
+                    glLayer.fill(tile, 0.0f, false);
+                    fills++;
+                }
+            });
+        }
+
+        // Gl context thread
+        threads.emplace_back([&]() {
+            std::mt19937 random(200);
+            std::uniform_int_distribution<size_t> tileIndex(0, tiles.size() - 1);
+            while(!stop) {
+                glLayer.applyFills();
+                ngs::GlTilePtr tile(new ngs::GlTile(256, tiles[tileIndex(random)]));
+                if(glLayer.hasData(tile)) {
+                    glLayer.free(tile);
+                }
+                // Edits invalidate cached tiles as the map does on notify
+                ngs::TileCache::instance().remove(overview.get());
+                std::this_thread::sleep_for(std::chrono::milliseconds(16));
+            }
+            glLayer.applyFills();
+        });
+
+        threads.emplace_back([&]() {
+            std::mt19937 random(300);
+            std::uniform_int_distribution<int> operation(0, 9);
+            std::uniform_int_distribution<GIntBig> fid(1, STRESS_INIT_FEATURES);
+            while(!stop) {
+                int op = operation(random);
+                if(op < 6) {
+                    insertPoint(featureClass, random, true);
+                }
+                else if(op < 9) {
+                    ngs::FeaturePtr feature = featureClass->getFeature(fid(random));
+                    if(feature) {
+                        feature->SetGeometryDirectly(stressPoint(random));
+                        featureClass->updateFeature(feature, true);
+                    }
+                }
+                else {
+                    featureClass->deleteFeature(fid(random), true);
+                }
+                edits++;
+            }
+        });
+
+        threads.emplace_back([&]() {
+            long timeStamp = time(nullptr);
+            bool newTrack = true;
+            std::mt19937 random(400);
+            std::uniform_real_distribution<double> offset(-0.001, 0.001);
+            while(!stop) {
+                if(tracks->addPoint("stress", 37.62 + offset(random),
+                                    55.75 + offset(random), 150.0, 5.0f, 1.0f,
+                                    90.0f, timeStamp++, 8, newTrack, false)) {
+                    trackPoints++;
+                }
+                else {
+                    trackFailures++;
+                }
+                newTrack = false;
+                if(trackPoints % 500 == 0) {
+                    tracks->getTracks();
+                    tracks->trackLines(STRESS_ZOOM);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+#ifndef _WIN32
+        threads.emplace_back([&]() {
+            std::vector<ngs::ObjectPtr> layers = { pointsObject };
+            while(!stop) {
+                if(!ngs::ngw::syncLayers(layers, ngs::Progress())) {
+                    syncFailures++;
+                }
+                syncs++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        });
+#endif // _WIN32
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+        stop = true;
+        for(auto &thread : threads) {
+            thread.join();
+        }
+
+        std::cout << "Fills: " << fills << ", edits: " << edits
+                  << ", track points: " << trackPoints << ", syncs: " << syncs
+                  << '\n';
+        EXPECT_GT(fills.load(), 0);
+        EXPECT_GT(edits.load(), 0);
+        EXPECT_EQ(trackFailures.load(), 0);
+
+#ifndef _WIN32
+        // The last sync uploads all the edits
+        EXPECT_EQ(syncFailures.load(), 0);
+        EXPECT_TRUE(ngs::ngw::syncLayers({ pointsObject }, ngs::Progress()));
+        EXPECT_TRUE(featureClass->editOperations().empty());
+#endif // _WIN32
+
+        // Tiles match the base data after edits
+        ngs::TileCache::instance().remove(overview.get());
+        for(const ngs::TileItem &tileItem : tiles) {
+            EXPECT_EQ(tileIds(overview.get(), tileItem),
+                      baseIds(featureClass, tileItem));
+        }
+
+        // All track points are written
+        tracks->getTracks();
+        ngs::FeatureClass *trackPointsLayer = ngsDynamicCast(
+                    ngs::FeatureClass, tracks->getPointsLayer());
+        ASSERT_NE(trackPointsLayer, nullptr);
+        EXPECT_EQ(trackPointsLayer->featureCount(true),
+                  static_cast<GIntBig>(trackPoints.load()));
+    }
+
+#ifndef _WIN32
+    ngsCatalogObjectDelete(connection);
+    server.stop();
+#endif // _WIN32
+    EXPECT_EQ(ngsCatalogObjectDelete(store), COD_SUCCESS);
+
+    ngsUnInit();
+}